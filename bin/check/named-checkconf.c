@@ -17,6 +17,8 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <isc/attributes.h>
 #include <isc/commandline.h>
@@ -48,6 +50,16 @@ static const char *program = "named-checkconf";
 
 static bool loadplugins = true;
 
+/*%
+ * Number of processes loading zones, and the range of zones (in
+ * configuration order) this process loads.
+ */
+#define MAX_JOBS 256
+static unsigned int jobs = 1;
+static size_t zone_first = 0;
+static size_t zone_last = SIZE_MAX;
+static size_t zone_index = 0;
+
 isc_log_t *logc = NULL;
 
 #define CHECK(r)                             \
@@ -64,7 +76,7 @@ usage(void);
 static void
 usage(void) {
 	fprintf(stderr,
-		"usage: %s [-chijlvz] [-p [-x]] [-t directory] "
+		"usage: %s [-chijlvz] [-n jobs] [-p [-x]] [-t directory] "
 		"[named.conf]\n",
 		program);
 	exit(1);
@@ -487,6 +499,11 @@ configure_view(const char *vclass, const char *view, const cfg_obj_t *config,
 	     element = cfg_list_next(element))
 	{
 		const cfg_obj_t *zconfig = cfg_listelt_value(element);
+		size_t index = zone_index++;
+
+		if (index < zone_first || index >= zone_last) {
+			continue;
+		}
 		tresult = configure_zone(vclass, view, zconfig, vconfig, config,
 					 mctx, list);
 		if (tresult != ISC_R_SUCCESS) {
@@ -568,6 +585,124 @@ cleanup:
 	return (result);
 }
 
+/*% count the zones in the configuration */
+static size_t
+count_zones(const cfg_obj_t *config) {
+	const cfg_listelt_t *element;
+	const cfg_obj_t *views = NULL;
+	const cfg_obj_t *zonelist = NULL;
+	size_t count = 0;
+
+	(void)cfg_map_get(config, "view", &views);
+	for (element = cfg_list_first(views); element != NULL;
+	     element = cfg_list_next(element))
+	{
+		const cfg_obj_t *vconfig = cfg_listelt_value(element);
+		const cfg_obj_t *voptions = cfg_tuple_get(vconfig, "options");
+
+		zonelist = NULL;
+		if (voptions != NULL) {
+			(void)cfg_map_get(voptions, "zone", &zonelist);
+		}
+		count += cfg_list_length(zonelist, false);
+	}
+
+	if (views == NULL) {
+		(void)cfg_map_get(config, "zone", &zonelist);
+		count += cfg_list_length(zonelist, false);
+	}
+
+	return (count);
+}
+
+/*% copy a child's output to 'stream' */
+static void
+copy_output(FILE *from, FILE *stream) {
+	char buf[BUFSIZ];
+	size_t n;
+
+	rewind(from);
+	while ((n = fread(buf, 1, sizeof(buf), from)) > 0) {
+		if (fwrite(buf, 1, n, stream) != n) {
+			perror("fwrite");
+			exit(1);
+		}
+	}
+	fflush(stream);
+}
+
+/*%
+ * Load the zones in 'jobs' child processes.  Each child loads a
+ * contiguous run of zones with its output going to temporary files,
+ * which are copied out in order once it has finished, so that the
+ * output is the same as when loading the zones one after another.
+ */
+static isc_result_t
+load_zones_parallel(const cfg_obj_t *config, isc_mem_t *mctx,
+		    bool list_zones) {
+	struct {
+		pid_t pid;
+		FILE *out;
+		FILE *err;
+	} children[MAX_JOBS];
+	size_t nzones = count_zones(config);
+	unsigned int n = ISC_MIN(jobs, ISC_MAX(nzones, 1));
+	isc_result_t result = ISC_R_SUCCESS;
+
+	fflush(stdout);
+	fflush(stderr);
+
+	for (unsigned int i = 0; i < n; i++) {
+		children[i].out = tmpfile();
+		children[i].err = tmpfile();
+		if (children[i].out == NULL || children[i].err == NULL) {
+			perror("tmpfile");
+			exit(1);
+		}
+
+		children[i].pid = fork();
+		if (children[i].pid < 0) {
+			perror("fork");
+			exit(1);
+		}
+		if (children[i].pid == 0) {
+			if (dup2(fileno(children[i].out), STDOUT_FILENO) < 0 ||
+			    dup2(fileno(children[i].err), STDERR_FILENO) < 0)
+			{
+				_exit(2);
+			}
+			zone_first = nzones * i / n;
+			zone_last = nzones * (i + 1) / n;
+			result = load_zones_fromconfig(config, mctx,
+						       list_zones);
+			fflush(stdout);
+			fflush(stderr);
+			_exit((result == ISC_R_SUCCESS) ? 0 : 1);
+		}
+	}
+
+	for (unsigned int i = 0; i < n; i++) {
+		int status;
+
+		while (waitpid(children[i].pid, &status, 0) < 0) {
+			if (errno != EINTR) {
+				perror("waitpid");
+				exit(1);
+			}
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			result = ISC_R_FAILURE;
+		}
+
+		copy_output(children[i].out, stdout);
+		copy_output(children[i].err, stderr);
+		fclose(children[i].out);
+		fclose(children[i].err);
+	}
+
+	return (result);
+}
+
 static void
 output(void *closure, const char *text, int textlen) {
 	UNUSED(closure);
@@ -592,13 +727,14 @@ main(int argc, char **argv) {
 	bool print = false;
 	bool nodeprecate = false;
 	unsigned int flags = 0;
+	char *endp = NULL;
 
 	isc_commandline_errprint = false;
 
 	/*
 	 * Process memory debugging argument first.
 	 */
-#define CMDLINE_FLAGS "cdhijlm:t:pvxz"
+#define CMDLINE_FLAGS "cdhijlm:n:t:pvxz"
 	while ((c = isc_commandline_parse(argc, argv, CMDLINE_FLAGS)) != -1) {
 		switch (c) {
 		case 'm':
@@ -648,6 +784,15 @@ main(int argc, char **argv) {
 		case 'm':
 			break;
 
+		case 'n':
+			jobs = strtoul(isc_commandline_argument, &endp, 10);
+			if (*endp != '\0' || jobs == 0 || jobs > MAX_JOBS) {
+				fprintf(stderr, "%s: -n must be from 1 to %u\n",
+					program, MAX_JOBS);
+				exit(1);
+			}
+			break;
+
 		case 't':
 			result = isc_dir_chroot(isc_commandline_argument);
 			if (result != ISC_R_SUCCESS) {
@@ -733,7 +878,12 @@ main(int argc, char **argv) {
 	}
 
 	if (result == ISC_R_SUCCESS && (load_zones || list_zones)) {
-		result = load_zones_fromconfig(config, mctx, list_zones);
+		if (jobs > 1) {
+			result = load_zones_parallel(config, mctx, list_zones);
+		} else {
+			result = load_zones_fromconfig(config, mctx,
+						       list_zones);
+		}
 		if (result != ISC_R_SUCCESS) {
 			exit_status = 1;
 		}
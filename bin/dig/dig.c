@@ -14,10 +14,14 @@
 /*! \file */
 
 #include <ctype.h>
+#include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <sys/wait.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <isc/app.h>
 #include <isc/attributes.h>
@@ -61,6 +65,15 @@ dig_lookup_t *default_lookup = NULL;
 
 static atomic_uintptr_t batchname = 0;
 static FILE *batchfp = NULL;
+
+/*%
+ * With -j, the lines of the batch file are split between 'jobs'
+ * processes; this one looks up lines [batch_first, batch_last).
+ */
+#define MAX_JOBS 256
+static unsigned int jobs = 1;
+static const char *prebatchname = NULL;
+static unsigned int batch_first = 0, batch_last = UINT_MAX, batch_line = 0;
 static char *argv0;
 static int addresscount = 0;
 
@@ -150,6 +163,8 @@ help(void) {
 	       "address/port)\n"
 	       "                 -c class            (specify query class)\n"
 	       "                 -f filename         (batch mode)\n"
+	       "                 -j jobs             (look up batch in "
+	       "parallel)\n"
 	       "                 -k keyfile          (specify tsig key file)\n"
 	       "                 -m                  (enable memory usage "
 	       "debugging)\n"
@@ -2216,7 +2231,7 @@ exit_or_usage:
  * #true returned if value was used
  */
 static const char *single_dash_opts = "46dhimnruv";
-static const char *dash_opts = "46bcdfhikmnpqrtvyx";
+static const char *dash_opts = "46bcdfhijkmnpqrtvyx";
 static bool
 dash_option(char *option, char *next, dig_lookup_t **lookup,
 	    bool *open_type_class, bool *need_clone, bool config_only, int argc,
@@ -2368,6 +2383,9 @@ dash_option(char *option, char *next, dig_lookup_t **lookup,
 	case 'f':
 		atomic_store(&batchname, (uintptr_t)value);
 		return (value_from_next);
+	case 'j':
+		/* Acted upon in preparse_args() */
+		return (value_from_next);
 	case 'k':
 		strlcpy(keyfile, value, sizeof(keyfile));
 		return (value_from_next);
@@ -2516,6 +2534,30 @@ dash_option(char *option, char *next, dig_lookup_t **lookup,
 	return (false);
 }
 
+/*
+ * Remember the values of the options that are needed before the batch
+ * file is split between processes.
+ */
+static void
+preparse_value(char opt, const char *value) {
+	uint32_t num;
+
+	switch (opt) {
+	case 'f':
+		prebatchname = value;
+		break;
+	case 'j':
+		if (parse_uint(&num, value, MAX_JOBS, "jobs") !=
+			    ISC_R_SUCCESS ||
+		    num == 0)
+		{
+			fatal("couldn't parse jobs");
+		}
+		jobs = num;
+		break;
+	}
+}
+
 /*%
  * Because we may be trying to do memory allocation recording, we're going
  * to need to parse the arguments for the -m *before* we start the main
@@ -2581,6 +2623,7 @@ preparse_args(int argc, char **argv) {
 		}
 		if (strlen(option) > 1U) {
 			/* value in option. */
+			preparse_value(option[0], &option[1]);
 			continue;
 		}
 		/* Dash value is next argument so we need to skip it. */
@@ -2591,9 +2634,126 @@ preparse_args(int argc, char **argv) {
 			fprintf(stderr, "Invalid option: -%s\n", option);
 			usage();
 		}
+		preparse_value(option[0], rv[0]);
 	}
 }
 
+/*
+ * Read the next line of the batch file that is for this process.
+ */
+static bool
+read_batchline(char *batchline, int len) {
+	while (batch_line < batch_last &&
+	       fgets(batchline, len, batchfp) != NULL)
+	{
+		if (batch_line++ >= batch_first) {
+			return (true);
+		}
+	}
+	return (false);
+}
+
+static void
+copy_output(FILE *from, FILE *stream) {
+	char buf[BUFSIZ];
+	size_t n;
+
+	rewind(from);
+	while ((n = fread(buf, 1, sizeof(buf), from)) > 0) {
+		if (fwrite(buf, 1, n, stream) != n) {
+			perror("fwrite");
+			exit(1);
+		}
+	}
+	fflush(stream);
+}
+
+/*%
+ * Split the batch file between 'jobs' child processes, which return to
+ * carry on as dig normally would, each looking up a contiguous run of
+ * its lines with its output going to temporary files.  The parent waits
+ * for them in order and copies their output out, so that it is the same
+ * as when looking up the lines one after another, then exits.
+ *
+ * This has to be done before any threads are started.
+ */
+static void
+run_jobs(void) {
+	struct {
+		pid_t pid;
+		FILE *out;
+		FILE *err;
+	} children[MAX_JOBS];
+	char batchline[MXNAME];
+	unsigned int nlines = 0, n;
+	FILE *fp = NULL;
+	int status = 0;
+
+	fp = fopen(prebatchname, "r");
+	if (fp == NULL) {
+		/* Reported when the batch file is opened for real */
+		return;
+	}
+	while (fgets(batchline, sizeof(batchline), fp) != NULL) {
+		nlines++;
+	}
+	fclose(fp);
+
+	n = ISC_MIN(jobs, nlines);
+	if (n <= 1) {
+		return;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	for (unsigned int i = 0; i < n; i++) {
+		children[i].out = tmpfile();
+		children[i].err = tmpfile();
+		if (children[i].out == NULL || children[i].err == NULL) {
+			perror("tmpfile");
+			exit(1);
+		}
+
+		children[i].pid = fork();
+		if (children[i].pid < 0) {
+			perror("fork");
+			exit(1);
+		}
+		if (children[i].pid == 0) {
+			if (dup2(fileno(children[i].out), STDOUT_FILENO) < 0 ||
+			    dup2(fileno(children[i].err), STDERR_FILENO) < 0)
+			{
+				_exit(10);
+			}
+			batch_first = (uint64_t)nlines * i / n;
+			batch_last = (uint64_t)nlines * (i + 1) / n;
+			return;
+		}
+	}
+
+	for (unsigned int i = 0; i < n; i++) {
+		while (waitpid(children[i].pid, &status, 0) < 0) {
+			if (errno != EINTR) {
+				perror("waitpid");
+				exit(1);
+			}
+		}
+		if (!WIFEXITED(status)) {
+			exitcode = ISC_MAX(exitcode, 10);
+		} else {
+			exitcode = ISC_MAX(exitcode, WEXITSTATUS(status));
+		}
+
+		copy_output(children[i].out, stdout);
+		copy_output(children[i].err, stderr);
+		fclose(children[i].out);
+		fclose(children[i].err);
+	}
+
+	exit(exitcode);
+}
+
 static int
 split_batchline(char *batchline, char **bargv, int len, const char *msg) {
 	int bargc;
@@ -2874,7 +3034,7 @@ parse_args(bool is_batchfile, bool config_only, int argc, char **argv) {
 		}
 		/* XXX Remove code dup from shutdown code */
 	next_line:
-		if (fgets(batchline, sizeof(batchline), batchfp) != 0) {
+		if (read_batchline(batchline, sizeof(batchline))) {
 			debug("batch line %s", batchline);
 			if (batchline[0] == '\r' || batchline[0] == '\n' ||
 			    batchline[0] == '#' || batchline[0] == ';')
@@ -2940,7 +3100,7 @@ query_finished(void) {
 		return;
 	}
 
-	if (fgets(batchline, sizeof(batchline), batchfp) != 0) {
+	if (read_batchline(batchline, sizeof(batchline))) {
 		debug("batch line %s", batchline);
 		bargc = split_batchline(batchline, bargv, 14, "batch argv");
 		bargv[0] = argv0;
@@ -3036,6 +3196,10 @@ dig_setup(int argc, char **argv) {
 
 	progname = argv[0];
 	preparse_args(argc, argv);
+	if (jobs > 1 && prebatchname != NULL && strcmp(prebatchname, "-") != 0)
+	{
+		run_jobs();
+	}
 
 	result = isc_app_start();
 	check_result(result, "isc_app_start");
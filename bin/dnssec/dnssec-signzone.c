@@ -43,6 +43,7 @@
 #include <isc/file.h>
 #include <isc/hash.h>
 #include <isc/hex.h>
+#include <isc/iterated_hash.h>
 #include <isc/managers.h>
 #include <isc/md.h>
 #include <isc/mem.h>
@@ -57,6 +58,7 @@
 #include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/util.h>
 
@@ -66,6 +68,7 @@
 #include <dns/dnssec.h>
 #include <dns/ds.h>
 #include <dns/fixedname.h>
+#include <dns/journal.h>
 #include <dns/keyvalues.h>
 #include <dns/log.h>
 #include <dns/master.h>
@@ -181,6 +184,8 @@ static bool output_stdout = false;
 static bool set_maxttl = false;
 static dns_ttl_t maxttl = 0;
 static bool no_max_check = false;
+static dns_db_t *prevdb = NULL; /* The previously signed zone (-B) */
+static const char *journal = NULL;
 
 #define INCSTAT(counter)            \
 	if (printstats) {           \
@@ -838,27 +843,189 @@ hashlist_add(hashlist_t *l, const unsigned char *hash, size_t len) {
 	l->entries++;
 }
 
+/*%
+ * NSEC3 owner names are not hashed one at a time as they are found.
+ * They are queued with hashqueue_add() and, once HASHQUEUE_SIZE names
+ * have accumulated, hashqueue_flush() hashes the whole batch on up to
+ * 'ntasks' threads, HASHQUEUE_CHUNK names per isc_iterated_hash_batch()
+ * call, before consuming the results in the order the names were
+ * queued: the hashes are either added to the hash list (first pass
+ * of nsec3ify()) or used to build the NSEC3 records (second pass).
+ */
+#define HASHQUEUE_SIZE	4096
+#define HASHQUEUE_CHUNK 8
+
+typedef struct hashitem {
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dns_dbnode_t *node;
+	bool speculative;
+	unsigned int length;
+	unsigned char hash[NSEC3_MAX_HASH_LENGTH + 1];
+} hashitem_t;
+
+typedef struct hashqueue {
+	hashitem_t *items;
+	unsigned int count;
+	atomic_uint_fast32_t next;
+	unsigned int hashalg;
+	unsigned int iterations;
+	const unsigned char *salt;
+	size_t salt_len;
+	hashlist_t *hashlist;
+	bool build;
+	dns_ttl_t ttl;
+} hashqueue_t;
+
+static hashqueue_t hashqueue;
+
 static void
-hashlist_add_dns_name(hashlist_t *l,
-		      /*const*/ dns_name_t *name, unsigned int hashalg,
-		      unsigned int iterations, const unsigned char *salt,
-		      size_t salt_len, bool speculative) {
+addnsec3(dns_dbnode_t *node, const unsigned char *hash, size_t hash_len,
+	 const unsigned char *salt, size_t salt_len, unsigned int iterations,
+	 hashlist_t *hashlist, dns_ttl_t ttl);
+
+static void
+hashqueue_init(hashqueue_t *q, unsigned int hashalg, unsigned int iterations,
+	       const unsigned char *salt, size_t salt_len, hashlist_t *l) {
+	*q = (hashqueue_t){
+		.hashalg = hashalg,
+		.iterations = iterations,
+		.salt = salt,
+		.salt_len = salt_len,
+		.hashlist = l,
+	};
+	q->items = isc_mem_get(mctx, HASHQUEUE_SIZE * sizeof(q->items[0]));
+	atomic_init(&q->next, 0);
+}
+
+static isc_threadresult_t
+hashqueue_work(isc_threadarg_t arg) {
+	hashqueue_t *q = arg;
+	unsigned char *out[HASHQUEUE_CHUNK];
+	const unsigned char *in[HASHQUEUE_CHUNK];
+	int inlength[HASHQUEUE_CHUNK];
+	unsigned int i, n, len;
+	hashitem_t *item;
+
+	for (;;) {
+		i = atomic_fetch_add_relaxed(&q->next, HASHQUEUE_CHUNK);
+		if (i >= q->count) {
+			break;
+		}
+		n = ISC_MIN(HASHQUEUE_CHUNK, q->count - i);
+		for (unsigned int j = 0; j < n; j++) {
+			item = &q->items[i + j];
+			out[j] = item->hash;
+			in[j] = item->name->ndata;
+			inlength[j] = item->name->length;
+		}
+		len = isc_iterated_hash_batch(out, q->hashalg, q->iterations,
+					      q->salt, (int)q->salt_len, in,
+					      inlength, n);
+		for (unsigned int j = 0; j < n; j++) {
+			q->items[i + j].length = len;
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+hashqueue_flush(hashqueue_t *q) {
 	char nametext[DNS_NAME_FORMATSIZE];
 	unsigned char hash[NSEC3_MAX_HASH_LENGTH + 1];
-	unsigned int len;
-	size_t i;
+	isc_thread_t *threads = NULL;
+	unsigned int nthreads, i;
+	hashitem_t *item;
+	size_t j;
 
-	len = isc_iterated_hash(hash, hashalg, iterations, salt, (int)salt_len,
-				name->ndata, name->length);
-	if (verbose) {
-		dns_name_format(name, nametext, sizeof nametext);
-		for (i = 0; i < len; i++) {
-			fprintf(stderr, "%02x", hash[i]);
+	if (q->count == 0) {
+		return;
+	}
+
+	atomic_store_relaxed(&q->next, 0);
+	nthreads = ISC_MIN(ntasks, (q->count + HASHQUEUE_CHUNK - 1) /
+					   HASHQUEUE_CHUNK);
+	if (nthreads > 1) {
+		threads = isc_mem_get(mctx, (nthreads - 1) * sizeof(threads[0]));
+		for (i = 0; i < nthreads - 1; i++) {
+			isc_thread_create(hashqueue_work, q, &threads[i]);
+		}
+	}
+	(void)hashqueue_work(q);
+	if (threads != NULL) {
+		for (i = 0; i < nthreads - 1; i++) {
+			isc_thread_join(threads[i], NULL);
 		}
-		fprintf(stderr, " %s\n", nametext);
+		isc_mem_put(mctx, threads, (nthreads - 1) * sizeof(threads[0]));
 	}
-	hash[len++] = speculative ? 1 : 0;
-	hashlist_add(l, hash, len);
+
+	for (i = 0; i < q->count; i++) {
+		item = &q->items[i];
+		if (item->length == 0) {
+			fatal("failed to compute the NSEC3 hash");
+		}
+		if (q->build) {
+			item->hash[item->length] = 0;
+			addnsec3(item->node, item->hash, item->length, q->salt,
+				 q->salt_len, q->iterations, q->hashlist,
+				 q->ttl);
+			if (item->node != NULL) {
+				dns_db_detachnode(gdb, &item->node);
+			}
+			continue;
+		}
+		if (verbose) {
+			dns_name_format(item->name, nametext, sizeof nametext);
+			for (j = 0; j < item->length; j++) {
+				fprintf(stderr, "%02x", item->hash[j]);
+			}
+			fprintf(stderr, " %s\n", nametext);
+		}
+		memmove(hash, item->hash, item->length);
+		hash[item->length] = item->speculative ? 1 : 0;
+		hashlist_add(q->hashlist, hash, item->length + 1);
+	}
+	q->count = 0;
+}
+
+static void
+hashqueue_add(hashqueue_t *q, const dns_name_t *name, dns_dbnode_t *node,
+	      bool speculative) {
+	hashitem_t *item = &q->items[q->count++];
+
+	item->name = dns_fixedname_initname(&item->fname);
+	dns_name_copy(name, item->name);
+	item->node = NULL;
+	if (node != NULL) {
+		dns_db_attachnode(gdb, node, &item->node);
+	}
+	item->speculative = speculative;
+	item->length = 0;
+
+	if (q->count == HASHQUEUE_SIZE) {
+		hashqueue_flush(q);
+	}
+}
+
+static void
+hashqueue_destroy(hashqueue_t *q) {
+	hashqueue_flush(q);
+	isc_mem_put(mctx, q->items, HASHQUEUE_SIZE * sizeof(q->items[0]));
+	q->items = NULL;
+}
+
+static void
+hashlist_add_dns_name(hashlist_t *l,
+		      /*const*/ dns_name_t *name, unsigned int hashalg,
+		      unsigned int iterations, const unsigned char *salt,
+		      size_t salt_len, bool speculative) {
+	REQUIRE(hashqueue.hashlist == l && !hashqueue.build);
+	REQUIRE(hashqueue.hashalg == hashalg &&
+		hashqueue.iterations == iterations &&
+		hashqueue.salt == salt && hashqueue.salt_len == salt_len);
+
+	hashqueue_add(&hashqueue, name, NULL, speculative);
 }
 
 static int
@@ -2083,31 +2250,38 @@ addnsec3param(const unsigned char *salt, size_t salt_len,
 	dns_db_detachnode(gdb, &node);
 }
 
+/*
+ * Add the NSEC3 record for 'name', whose hash 'hash' has been computed
+ * by hashqueue_flush().
+ */
 static void
-addnsec3(dns_name_t *name, dns_dbnode_t *node, const unsigned char *salt,
-	 size_t salt_len, unsigned int iterations, hashlist_t *hashlist,
-	 dns_ttl_t ttl) {
-	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
+addnsec3(dns_dbnode_t *node, const unsigned char *hash, size_t hash_len,
+	 const unsigned char *salt, size_t salt_len, unsigned int iterations,
+	 hashlist_t *hashlist, dns_ttl_t ttl) {
 	const unsigned char *nexthash;
 	unsigned char nsec3buffer[DNS_NSEC3_BUFFERSIZE];
-	dns_fixedname_t hashname;
+	unsigned char nametext[DNS_NAME_FORMATSIZE];
+	dns_fixedname_t fhashname;
+	dns_name_t *hashname;
 	dns_rdatalist_t rdatalist;
 	dns_rdataset_t rdataset;
 	dns_rdata_t rdata = DNS_RDATA_INIT;
 	isc_result_t result;
 	dns_dbnode_t *nsec3node = NULL;
-	char namebuf[DNS_NAME_FORMATSIZE];
-	size_t hash_len;
-
-	dns_name_format(name, namebuf, sizeof(namebuf));
+	isc_buffer_t namebuffer;
+	isc_region_t region;
 
-	dns_fixedname_init(&hashname);
+	hashname = dns_fixedname_initname(&fhashname);
 	dns_rdataset_init(&rdataset);
 
-	dns_name_downcase(name, name, NULL);
-	result = dns_nsec3_hashname(&hashname, hash, &hash_len, name, gorigin,
-				    dns_hash_sha1, iterations, salt, salt_len);
-	check_result(result, "addnsec3: dns_nsec3_hashname()");
+	DE_CONST(hash, region.base);
+	region.length = (unsigned int)hash_len;
+	isc_buffer_init(&namebuffer, nametext, sizeof(nametext));
+	result = isc_base32hexnp_totext(&region, 1, "", &namebuffer);
+	check_result(result, "addnsec3: isc_base32hexnp_totext()");
+	result = dns_name_fromtext(hashname, &namebuffer, gorigin, 0, NULL);
+	check_result(result, "addnsec3: dns_name_fromtext()");
+
 	nexthash = hashlist_findnext(hashlist, hash);
 	result = dns_nsec3_buildrdata(
 		gdb, gversion, node,
@@ -2122,8 +2296,7 @@ addnsec3(dns_name_t *name, dns_dbnode_t *node, const unsigned char *salt,
 	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
 	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
 	check_result(result, "dns_rdatalist_tordataset()");
-	result = dns_db_findnsec3node(gdb, dns_fixedname_name(&hashname), true,
-				      &nsec3node);
+	result = dns_db_findnsec3node(gdb, hashname, true, &nsec3node);
 	check_result(result, "addnsec3: dns_db_findnode()");
 	result = dns_db_addrdataset(gdb, nsec3node, gversion, 0, &rdataset, 0,
 				    NULL);
@@ -2134,6 +2307,16 @@ addnsec3(dns_name_t *name, dns_dbnode_t *node, const unsigned char *salt,
 	dns_db_detachnode(gdb, &nsec3node);
 }
 
+/*
+ * Queue 'name' for hashing; its NSEC3 record is added by addnsec3()
+ * when the hash queue is flushed.
+ */
+static void
+queuensec3(dns_name_t *name, dns_dbnode_t *node) {
+	dns_name_downcase(name, name, NULL);
+	hashqueue_add(&hashqueue, name, node, false);
+}
+
 /*%
  * Clean out NSEC3 record and RRSIG(NSEC3) that are not in the hash list.
  *
@@ -2392,6 +2575,9 @@ nsec3ify(unsigned int hashalg, dns_iterations_t iterations,
 	nextname = dns_fixedname_initname(&fnextname);
 	zonecut = NULL;
 
+	hashqueue_init(&hashqueue, hashalg, iterations, salt, salt_len,
+		       hashlist);
+
 	/*
 	 * Walk the zone generating the hash names.
 	 */
@@ -2503,6 +2689,7 @@ nsec3ify(unsigned int hashalg, dns_iterations_t iterations,
 		}
 	}
 	dns_dbiterator_destroy(&dbiter);
+	hashqueue_flush(&hashqueue);
 
 	/*
 	 * We have all the hashes now so we can sort them.
@@ -2545,6 +2732,9 @@ nsec3ify(unsigned int hashalg, dns_iterations_t iterations,
 	/*
 	 * Generate / complete the new chain.
 	 */
+	hashqueue.build = true;
+	hashqueue.ttl = zone_soa_min_ttl;
+
 	result = dns_db_createiterator(gdb, DNS_DB_NONSEC3, &dbiter);
 	check_result(result, "dns_db_createiterator()");
 
@@ -2620,8 +2810,7 @@ nsec3ify(unsigned int hashalg, dns_iterations_t iterations,
 		 * We need to pause here to release the lock on the database.
 		 */
 		dns_dbiterator_pause(dbiter);
-		addnsec3(name, node, salt, salt_len, iterations, hashlist,
-			 zone_soa_min_ttl);
+		queuensec3(name, node);
 		dns_db_detachnode(gdb, &node);
 		/*
 		 * Add NSEC3's for empty nodes.  Use closest encloser logic.
@@ -2631,11 +2820,11 @@ nsec3ify(unsigned int hashalg, dns_iterations_t iterations,
 		while (count > nlabels + 1) {
 			count--;
 			dns_name_split(nextname, count, NULL, nextname);
-			addnsec3(nextname, NULL, salt, salt_len, iterations,
-				 hashlist, zone_soa_min_ttl);
+			queuensec3(nextname, NULL);
 		}
 	}
 	dns_dbiterator_destroy(&dbiter);
+	hashqueue_destroy(&hashqueue);
 }
 
 /*%
@@ -2671,6 +2860,212 @@ loadzone(char *file, char *origin, dns_rdataclass_t rdclass, dns_db_t **db) {
 	}
 }
 
+/*%
+ * Return true if 'a' and 'b' contain the same records with the same TTL.
+ */
+static bool
+rdataset_same(dns_rdataset_t *a, dns_rdataset_t *b) {
+	isc_result_t result, bresult;
+
+	if (a->ttl != b->ttl ||
+	    dns_rdataset_count(a) != dns_rdataset_count(b))
+	{
+		return (false);
+	}
+
+	for (result = dns_rdataset_first(a); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(a))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+
+		dns_rdataset_current(a, &rdata);
+		for (bresult = dns_rdataset_first(b); bresult == ISC_R_SUCCESS;
+		     bresult = dns_rdataset_next(b))
+		{
+			dns_rdata_t brdata = DNS_RDATA_INIT;
+
+			dns_rdataset_current(b, &brdata);
+			if (dns_rdata_compare(&rdata, &brdata) == 0) {
+				break;
+			}
+		}
+		if (bresult != ISC_R_SUCCESS) {
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*%
+ * Should 'rdataset', found at 'prevnode' in the previously signed zone,
+ * be carried over to 'node' (which may be NULL) in the zone being
+ * signed?
+ */
+static bool
+reusable(dns_dbversion_t *prevver, dns_dbnode_t *prevnode, dns_dbnode_t *node,
+	 dns_dbversion_t *ver, dns_rdataset_t *rdataset) {
+	dns_rdataset_t prevset, set;
+	dns_rdatatype_t type = rdataset->type;
+	isc_result_t result;
+	bool same;
+
+	if (type == dns_rdatatype_rrsig) {
+		type = rdataset->covers;
+	}
+
+	switch (type) {
+	case dns_rdatatype_nsec3:
+		return (true);
+	case dns_rdatatype_nsec:
+	case dns_rdatatype_nsec3param:
+		return (node != NULL);
+	default:
+		if (rdataset->type != dns_rdatatype_rrsig || node == NULL) {
+			return (false);
+		}
+		break;
+	}
+
+	/*
+	 * Carry over the signatures of an RRset only if it is unchanged.
+	 */
+	dns_rdataset_init(&prevset);
+	dns_rdataset_init(&set);
+	result = dns_db_findrdataset(prevdb, prevnode, prevver, type, 0, 0,
+				     &prevset, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return (false);
+	}
+	result = dns_db_findrdataset(gdb, node, ver, type, 0, 0, &set, NULL);
+	if (result != ISC_R_SUCCESS) {
+		dns_rdataset_disassociate(&prevset);
+		return (false);
+	}
+	same = rdataset_same(&prevset, &set);
+	dns_rdataset_disassociate(&prevset);
+	dns_rdataset_disassociate(&set);
+
+	return (same);
+}
+
+/*%
+ * Seed the zone with the DNSSEC records of its previously signed
+ * version (-B), so that only what has changed gets signed again: the
+ * signatures of each RRset that is the same in both versions are
+ * carried over, and so is the NSEC or NSEC3 chain, which nsecify() or
+ * nsec3ify() then update as they would that of a signed input zone.
+ * Carried over signatures which no longer validate or which are due
+ * for renewal are replaced by signset() as usual.
+ */
+static void
+reusesigs(void) {
+	dns_dbiterator_t *dbiter = NULL;
+	dns_dbversion_t *prevver = NULL, *ver = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	isc_result_t result;
+	unsigned int nreused = 0;
+
+	name = dns_fixedname_initname(&fname);
+
+	dns_db_currentversion(prevdb, &prevver);
+	result = dns_db_newversion(gdb, &ver);
+	check_result(result, "dns_db_newversion()");
+
+	result = dns_db_createiterator(prevdb, 0, &dbiter);
+	check_result(result, "dns_db_createiterator()");
+
+	for (result = dns_dbiterator_first(dbiter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(dbiter))
+	{
+		dns_dbnode_t *prevnode = NULL, *node = NULL;
+		dns_rdatasetiter_t *rdsiter = NULL;
+		dns_rdataset_t rdataset;
+		bool nsec3;
+
+		result = dns_dbiterator_current(dbiter, &prevnode, name);
+		check_dns_dbiterator_current(result);
+		if (!dns_name_issubdomain(name, gorigin)) {
+			dns_db_detachnode(prevdb, &prevnode);
+			continue;
+		}
+
+		result = dns_db_allrdatasets(prevdb, prevnode, prevver, 0, 0,
+					     &rdsiter);
+		check_result(result, "dns_db_allrdatasets()");
+
+		dns_rdataset_init(&rdataset);
+		for (result = dns_rdatasetiter_first(rdsiter);
+		     result == ISC_R_SUCCESS;
+		     result = dns_rdatasetiter_next(rdsiter))
+		{
+			dns_rdatasetiter_current(rdsiter, &rdataset);
+			nsec3 = (rdataset.type == dns_rdatatype_nsec3 ||
+				 rdataset.covers == dns_rdatatype_nsec3);
+			if (node == NULL && !nsec3) {
+				(void)dns_db_findnode(gdb, name, false, &node);
+			}
+			if (!reusable(prevver, prevnode, node, ver, &rdataset))
+			{
+				dns_rdataset_disassociate(&rdataset);
+				continue;
+			}
+			if (node == NULL) {
+				result = dns_db_findnsec3node(gdb, name, true,
+							      &node);
+				check_result(result, "dns_db_findnsec3node()");
+			}
+			result = dns_db_addrdataset(gdb, node, ver, 0,
+						    &rdataset, DNS_DBADD_MERGE,
+						    NULL);
+			if (result == DNS_R_UNCHANGED) {
+				result = ISC_R_SUCCESS;
+			}
+			check_result(result, "dns_db_addrdataset()");
+			if (rdataset.type == dns_rdatatype_rrsig) {
+				nreused += dns_rdataset_count(&rdataset);
+			}
+			dns_rdataset_disassociate(&rdataset);
+		}
+		if (result != ISC_R_NOMORE) {
+			fatal("rdataset iteration failed: %s",
+			      isc_result_totext(result));
+		}
+		dns_rdatasetiter_destroy(&rdsiter);
+		if (node != NULL) {
+			dns_db_detachnode(gdb, &node);
+		}
+		dns_db_detachnode(prevdb, &prevnode);
+	}
+	if (result != ISC_R_NOMORE) {
+		fatal("iterating through the database failed: %s",
+		      isc_result_totext(result));
+	}
+	dns_dbiterator_destroy(&dbiter);
+
+	dns_db_closeversion(gdb, &ver, true);
+	dns_db_closeversion(prevdb, &prevver, false);
+
+	vbprintf(2, "carried over %u signatures from the previous zone\n",
+		 nreused);
+}
+
+/*%
+ * Append the differences between the previously signed zone and the
+ * newly signed one to the journal, as a single IXFR-ready transaction.
+ */
+static void
+writejournal(void) {
+	dns_dbversion_t *prevver = NULL;
+	isc_result_t result;
+
+	dns_db_currentversion(prevdb, &prevver);
+	result = dns_db_diff(mctx, gdb, gversion, prevdb, prevver, journal);
+	check_result(result, "dns_db_diff()");
+	dns_db_closeversion(prevdb, &prevver, false);
+}
+
 /*%
  * Finds all public zone keys in the zone, and attempts to load the
  * private keys from disk.
@@ -3274,6 +3669,12 @@ usage(void) {
 	fprintf(stderr, "\t\tsoa serial format of signed zone file (keep)\n");
 	fprintf(stderr, "\t-D:\n");
 	fprintf(stderr, "\t\toutput only DNSSEC-related records\n");
+	fprintf(stderr, "\t-B previous:\n");
+	fprintf(stderr, "\t\tpreviously signed zone whose signatures "
+			"are reused\n");
+	fprintf(stderr, "\t-J journal:\n");
+	fprintf(stderr, "\t\tjournal of the changes from the previously "
+			"signed zone (outfile + .jnl)\n");
 	fprintf(stderr, "\t-a:\t");
 	fprintf(stderr, "verify generated signatures\n");
 	fprintf(stderr, "\t-c class (IN)\n");
@@ -3359,6 +3760,7 @@ main(int argc, char *argv[]) {
 	char *origin = NULL, *file = NULL, *output = NULL;
 	char *inputformatstr = NULL, *outputformatstr = NULL;
 	char *serialformatstr = NULL;
+	char *prevfile = NULL;
 	char *dskeyfile[MAXDSKEYS];
 	int ndskeys = 0;
 	char *endp;
@@ -3369,6 +3771,8 @@ main(int argc, char *argv[]) {
 	isc_log_t *log = NULL;
 	const char *engine = NULL;
 	bool free_output = false;
+	char *journalbuf = NULL;
+	size_t journalbuflen = 0;
 	int tempfilelen = 0;
 	dns_rdataclass_t rdclass;
 	isc_task_t **tasks = NULL;
@@ -3384,8 +3788,8 @@ main(int argc, char *argv[]) {
 
 	/* Unused letters: Bb G J q Yy (and F is reserved). */
 #define CMDLINE_FLAGS                                                         \
-	"3:AaCc:Dd:E:e:f:FghH:i:I:j:K:k:L:l:m:M:n:N:o:O:PpQqRr:s:ST:tuUv:VX:" \
-	"xzZ:"
+	"3:AaB:Cc:Dd:E:e:f:FghH:i:I:j:J:K:k:L:l:m:M:n:N:o:O:PpQqRr:s:ST:tuU" \
+	"v:VX:xzZ:"
 
 	/*
 	 * Process memory debugging argument first.
@@ -3512,6 +3916,10 @@ main(int argc, char *argv[]) {
 			}
 			break;
 
+		case 'B':
+			prevfile = isc_commandline_argument;
+			break;
+
 		case 'I':
 			inputformatstr = isc_commandline_argument;
 			break;
@@ -3525,6 +3933,10 @@ main(int argc, char *argv[]) {
 			}
 			break;
 
+		case 'J':
+			journal = isc_commandline_argument;
+			break;
+
 		case 'j':
 			endp = NULL;
 			jitter = strtol(isc_commandline_argument, &endp, 0);
@@ -3764,6 +4176,20 @@ main(int argc, char *argv[]) {
 		snprintf(output, size, "%s.signed", file);
 	}
 
+	if (journal != NULL && prevfile == NULL) {
+		fatal("option -J requires -B");
+	}
+
+	if (prevfile != NULL && journal == NULL) {
+		if (output_stdout) {
+			fatal("option -B requires -J when writing to stdout");
+		}
+		journalbuflen = strlen(output) + strlen(".jnl") + 1;
+		journalbuf = isc_mem_allocate(mctx, journalbuflen);
+		snprintf(journalbuf, journalbuflen, "%s.jnl", output);
+		journal = journalbuf;
+	}
+
 	if (inputformatstr != NULL) {
 		if (strcasecmp(inputformatstr, "text") == 0) {
 			inputformat = dns_masterformat_text;
@@ -3792,7 +4218,7 @@ main(int argc, char *argv[]) {
 			outputformat = dns_masterformat_raw;
 			rawversion = strtol(outputformatstr + 4, &end, 10);
 			if (end == outputformatstr + 4 || *end != '\0' ||
-			    rawversion > 1U)
+			    rawversion > 2U)
 			{
 				fprintf(stderr, "unknown raw format version\n");
 				exit(1);
@@ -3839,6 +4265,10 @@ main(int argc, char *argv[]) {
 	loadzone(file, origin, rdclass, &gdb);
 	gorigin = dns_db_origin(gdb);
 	gclass = dns_db_class(gdb);
+	if (prevfile != NULL) {
+		loadzone(prevfile, origin, rdclass, &prevdb);
+		reusesigs();
+	}
 	get_soa_ttls();
 
 	if (set_maxttl && set_keyttl && keyttl > maxttl) {
@@ -3972,6 +4402,23 @@ main(int argc, char *argv[]) {
 		break;
 	}
 
+	if (prevdb != NULL) {
+		dns_dbversion_t *prevver = NULL;
+		uint32_t prevserial, serial;
+
+		dns_db_currentversion(prevdb, &prevver);
+		result = dns_db_getsoaserial(prevdb, prevver, &prevserial);
+		check_result(result, "dns_db_getsoaserial()");
+		dns_db_closeversion(prevdb, &prevver, false);
+		result = dns_db_getsoaserial(gdb, gversion, &serial);
+		check_result(result, "dns_db_getsoaserial()");
+		if (!isc_serial_gt(serial, prevserial)) {
+			fatal("SOA serial %u is not greater than the "
+			      "previous serial %u",
+			      serial, prevserial);
+		}
+	}
+
 	/* Remove duplicates and cap TTLs at maxttl */
 	cleanup_zone();
 
@@ -4097,6 +4544,9 @@ main(int argc, char *argv[]) {
 			header.flags = DNS_MASTERRAW_SOURCESERIALSET;
 			header.sourceserial = serialnum;
 		}
+		if (rawversion == 2U) {
+			header.flags |= DNS_MASTERRAW_CHUNKED;
+		}
 		result = dns_master_dumptostream(mctx, gdb, gversion,
 						 masterstyle, outputformat,
 						 &header, outfp);
@@ -4125,6 +4575,17 @@ main(int argc, char *argv[]) {
 		}
 	}
 
+	if (prevdb != NULL) {
+		if (vresult == ISC_R_SUCCESS) {
+			writejournal();
+			printf("%s\n", journal);
+		}
+		dns_db_detach(&prevdb);
+	}
+	if (journalbuf != NULL) {
+		isc_mem_free(mctx, journalbuf);
+	}
+
 	dns_db_closeversion(gdb, &gversion, false);
 	dns_db_detach(&gdb);
 
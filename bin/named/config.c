@@ -47,12 +47,16 @@
 /*% default configuration */
 static char defaultconf[] = "\
 options {\n\
+	adaptive-recursive-clients no;\n\
 	answer-cookie true;\n\
 	automatic-interface-scan yes;\n\
 	bindkeys-file \"" NAMED_SYSCONFDIR "/bind.keys\";\n\
 #	blackhole {none;};\n"
+			    "	client-ipv4-prefix-length 24;\n"
+			    "	client-ipv6-prefix-length 56;\n"
 			    "	cookie-algorithm siphash24;\n"
 			    "	coresize default;\n\
+	cpu-affinity no;\n\
 	datasize default;\n"
 			    "\
 #	directory <none>\n\
@@ -71,6 +75,7 @@ options {\n\
 	heartbeat-interval 60;\n\
 	interface-interval 60;\n\
 #	keep-response-order {none;};\n\
+	lazy-load-zones no;\n\
 	listen-on {any;};\n\
 	listen-on-v6 {any;};\n\
 #	lock-file \"" NAMED_LOCALSTATEDIR "/run/named/named.lock\";\n\
@@ -78,6 +83,7 @@ options {\n\
 	max-ixfr-ratio 100%;\n\
 	max-rsa-exponent-size 0; /* no limit */\n\
 	max-udp-size 1232;\n\
+	memory-sample-interval 0;\n\
 	memstatistics-file \"named.memstats\";\n\
 	nocookie-udp-size 4096;\n\
 	notify-rate 20;\n\
@@ -99,12 +105,15 @@ options {\n\
 	http-port 80;\n\
 	https-port 443;\n\
 	http-listener-clients 300;\n\
-	http-streams-per-connection 100;\n"
+	http-streams-per-connection 100;\n\
+	http-get-cache-ttl 0;\n"
 #endif
 			    "\
 	prefetch 2 9;\n\
+	prefetch-popular 0;\n\
 	recursing-file \"named.recursing\";\n\
 	recursive-clients 1000;\n\
+	recursive-clients-per-prefix 0;\n\
 	request-nsid false;\n\
 	reserved-sockets 512;\n\
 	resolver-query-timeout 10;\n\
@@ -113,6 +122,7 @@ options {\n\
 	send-cookie true;\n\
 	serial-query-rate 20;\n\
 	server-id none;\n\
+	server-state-interval 300;\n\
 	session-keyalg hmac-sha256;\n\
 #	session-keyfile \"" NAMED_LOCALSTATEDIR "/run/named/session.key\";\n\
 	session-keyname local-ddns;\n\
@@ -121,21 +131,26 @@ options {\n\
 	statistics-file \"named.stats\";\n\
 	tcp-advertised-timeout 300;\n\
 	tcp-clients 150;\n\
+	tcp-clients-per-prefix 0;\n\
+	tcp-evict-idle no;\n\
 	tcp-idle-timeout 300;\n\
 	tcp-initial-timeout 300;\n\
 	tcp-keepalive-timeout 300;\n\
 	tcp-listen-queue 10;\n\
 	tcp-receive-buffer 0;\n\
+	tcp-send-batch 0;\n\
 	tcp-send-buffer 0;\n\
 #	tkey-dhkey <none>\n\
 #	tkey-domain <none>\n\
 #	tkey-gssapi-credential <none>\n\
+	transfer-cache-size 64M;\n\
 	transfer-message-size 20480;\n\
 	transfers-in 10;\n\
 	transfers-out 10;\n\
 	transfers-per-ns 2;\n\
 	trust-anchor-telemetry yes;\n\
 	udp-receive-buffer 0;\n\
+	udp-send-batch 0;\n\
 	udp-send-buffer 0;\n\
 	update-quota 100;\n\
 \n\
@@ -147,7 +162,13 @@ options {\n\
 	allow-recursion { localnets; localhost; };\n\
 	allow-recursion-on { any; };\n\
 	allow-update-forwarding {none;};\n\
+	attach-resolver no;\n\
+	auth-answer-cache-size 0;\n\
 	auth-nxdomain false;\n\
+	cache-dump-interval 300;\n\
+	cache-eviction lru;\n\
+	cache-shards 1;\n\
+	cache-top-domains 0;\n\
 	check-dup-records warn;\n\
 	check-mx warn;\n\
 	check-names primary fail;\n\
@@ -159,6 +180,7 @@ options {\n\
 	dnssec-validation " VALIDATION_DEFAULT "; \n"
 #ifdef HAVE_DNSTAP
 			    "	dnstap-identity hostname;\n"
+			    "	dnstap-sample 1;\n"
 #endif /* ifdef HAVE_DNSTAP */
 			    "\
 	fetch-quota-params 100 0.1 0.3 0.7;\n\
@@ -188,6 +210,7 @@ options {\n\
 	parental-source-v6 *;\n\
 	provide-ixfr true;\n\
 	qname-minimization relaxed;\n\
+	query-latency-statistics no;\n\
 	query-source address *;\n\
 	query-source-v6 address *;\n\
 	recursion true;\n\
@@ -195,9 +218,12 @@ options {\n\
 	request-ixfr true;\n\
 	require-server-cookie no;\n\
 	resolver-nonbackoff-tries 3;\n\
+	resolver-race-threshold 0; /* in milliseconds */\n\
+	resolver-share-fetches no;\n\
 	resolver-retry-interval 800; /* in milliseconds */\n\
 	root-key-sentinel yes;\n\
 	servfail-ttl 1;\n\
+	sort-additional-lookups no;\n\
 #	sortlist <none>\n\
 	stale-answer-client-timeout off;\n\
 	stale-answer-enable false;\n\
@@ -222,6 +248,8 @@ options {\n\
 	check-sibling yes;\n\
 	check-srv-cname warn;\n\
 	check-wildcard yes;\n\
+	compact-denial no;\n\
+	condense-ixfr no;\n\
 	dialup no;\n\
 	dnssec-dnskey-kskonly yes;\n\
 	dnssec-loadkeys-interval 60;\n\
@@ -231,6 +259,7 @@ options {\n\
 #	forwarders <none>\n\
 #	inline-signing no;\n\
 	ixfr-from-differences false;\n\
+	journal-commit-delay 0;\n\
 	max-journal-size default;\n\
 	max-records 0;\n\
 	max-refresh-time 2419200; /* 4 weeks */\n\
@@ -246,8 +275,10 @@ options {\n\
 	notify-delay 5;\n\
 	notify-to-soa no;\n\
 	serial-update-method increment;\n\
+	sig-resigning-rate 0;\n\
 	sig-signing-nodes 100;\n\
 	sig-signing-signatures 10;\n\
+	sig-signing-threads 1;\n\
 	sig-signing-type 65534;\n\
 	sig-validity-interval 30; /* days */\n\
 	dnskey-sig-validity 0; /* default: sig-validity-interval */\n\
@@ -220,6 +220,8 @@ named_control_docommand(isccc_sexpr_t *message, bool readonly,
 		result = named_server_dumpstats(named_g_server);
 	} else if (command_compare(command, NAMED_COMMAND_FLUSH)) {
 		result = named_server_flushcache(named_g_server, lex);
+	} else if (command_compare(command, NAMED_COMMAND_FLUSHDLZ)) {
+		result = named_server_flushdlz(named_g_server, lex);
 	} else if (command_compare(command, NAMED_COMMAND_FLUSHNAME)) {
 		result = named_server_flushnode(named_g_server, lex, false);
 	} else if (command_compare(command, NAMED_COMMAND_FLUSHTREE)) {
@@ -46,6 +46,7 @@ typedef struct dlopen_data {
 	dlz_dlopen_create_t *dlz_create;
 	dlz_dlopen_findzonedb_t *dlz_findzonedb;
 	dlz_dlopen_lookup_t *dlz_lookup;
+	dlz_dlopen_lookup_async_t *dlz_lookup_async;
 	dlz_dlopen_authority_t *dlz_authority;
 	dlz_dlopen_allnodes_t *dlz_allnodes;
 	dlz_dlopen_allowzonexfr_t *dlz_allowzonexfr;
@@ -176,6 +177,28 @@ dlopen_dlz_lookup(const char *zone, const char *name, void *driverarg,
 	return (result);
 }
 
+static isc_result_t
+dlopen_dlz_lookup_async(const char *zone, const char *name, void *driverarg,
+			void *dbdata, dns_sdlzlookup_t *lookup,
+			dns_clientinfomethods_t *methods,
+			dns_clientinfo_t *clientinfo, dns_sdlzlookupdone_t done,
+			void *arg) {
+	dlopen_data_t *cd = (dlopen_data_t *)dbdata;
+	isc_result_t result;
+
+	UNUSED(driverarg);
+
+	if (cd->dlz_lookup_async == NULL) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	MAYBE_LOCK(cd);
+	result = cd->dlz_lookup_async(zone, name, cd->dbdata, lookup, methods,
+				      clientinfo, done, arg);
+	MAYBE_UNLOCK(cd);
+	return (result);
+}
+
 /*
  * Load a symbol from the library
  */
@@ -270,6 +293,8 @@ dlopen_dlz_create(const char *dlzname, unsigned int argc, char *argv[],
 		cd, "dlz_allowzonexfr", false);
 	cd->dlz_allnodes = (dlz_dlopen_allnodes_t *)dl_load_symbol(
 		cd, "dlz_allnodes", (cd->dlz_allowzonexfr != NULL));
+	cd->dlz_lookup_async = (dlz_dlopen_lookup_async_t *)dl_load_symbol(
+		cd, "dlz_lookup_async", false);
 	cd->dlz_authority = (dlz_dlopen_authority_t *)dl_load_symbol(
 		cd, "dlz_authority", false);
 	cd->dlz_newversion = (dlz_dlopen_newversion_t *)dl_load_symbol(
@@ -513,7 +538,7 @@ static dns_sdlzmethods_t dlz_dlopen_methods = {
 	dlopen_dlz_lookup,	 dlopen_dlz_authority,	dlopen_dlz_allnodes,
 	dlopen_dlz_allowzonexfr, dlopen_dlz_newversion, dlopen_dlz_closeversion,
 	dlopen_dlz_configure,	 dlopen_dlz_ssumatch,	dlopen_dlz_addrdataset,
-	dlopen_dlz_subrdataset,	 dlopen_dlz_delrdataset
+	dlopen_dlz_subrdataset,	 dlopen_dlz_delrdataset, dlopen_dlz_lookup_async
 };
 
 /*
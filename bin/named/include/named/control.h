@@ -40,6 +40,7 @@
 #define NAMED_COMMAND_TRACE	   "trace"
 #define NAMED_COMMAND_NOTRACE	   "notrace"
 #define NAMED_COMMAND_FLUSH	   "flush"
+#define NAMED_COMMAND_FLUSHDLZ	   "flushdlz"
 #define NAMED_COMMAND_FLUSHNAME	   "flushname"
 #define NAMED_COMMAND_FLUSHTREE	   "flushtree"
 #define NAMED_COMMAND_STATUS	   "status"
@@ -22,6 +22,7 @@
 #include <isc/magic.h>
 #include <isc/quota.h>
 #include <isc/sockaddr.h>
+#include <isc/time.h>
 #include <isc/tls.h>
 #include <isc/types.h>
 
@@ -42,6 +43,33 @@
 #define NAMED_EVENT_DELZONE (NAMED_EVENTCLASS + 1)
 #define NAMED_EVENT_COMMAND (NAMED_EVENTCLASS + 2)
 #define NAMED_EVENT_TATSEND (NAMED_EVENTCLASS + 3)
+#define NAMED_EVENT_CATZBATCH (NAMED_EVENTCLASS + 4)
+
+/*%
+ * A view that every unsigned query of its class is matched to, found
+ * when the view list changes so that such queries skip ACL matching.
+ */
+typedef struct named_matchview {
+	dns_rdataclass_t rdclass;
+	dns_view_t	*view;
+} named_matchview_t;
+
+#define NAMED_MATCHVIEWS 4
+
+/*%
+ * Phases of startup whose duration is measured.  The keys and the
+ * policy zones are set up as part of the views.
+ */
+typedef enum {
+	named_startup_parse = 0,   /*%< parsing the configuration */
+	named_startup_interfaces,  /*%< scanning the interfaces */
+	named_startup_views,	   /*%< configuring the views */
+	named_startup_keys,	   /*%< loading the trust anchors */
+	named_startup_policyzones, /*%< configuring RPZ and catalog zones */
+	named_startup_zones,	   /*%< loading the zones */
+	named_startup_total,	   /*%< from boot until all zones are loaded */
+	named_startup_max
+} named_startupphase_t;
 
 /*%
  * Name server state.  Better here than in lots of separate global variables.
@@ -72,6 +100,12 @@ struct named_server {
 	dns_loadmgr_t	  *loadmgr;
 	dns_zonemgr_t	  *zonemgr;
 	dns_viewlist_t	   viewlist;
+	named_matchview_t  matchviews[NAMED_MATCHVIEWS];
+	unsigned int	   nmatchviews;
+	dns_view_t	 **indexviews;
+	unsigned int	   nindexviews;
+	dns_aclindex_t	  *clientindex;
+	dns_aclindex_t	  *destindex;
 	dns_kasplist_t	   kasplist;
 	ns_interfacemgr_t *interfacemgr;
 	dns_db_t	  *in_roothints;
@@ -80,13 +114,20 @@ struct named_server {
 	isc_timer_t *heartbeat_timer;
 	isc_timer_t *pps_timer;
 	isc_timer_t *tat_timer;
+	isc_timer_t *serverstate_timer;
 
 	uint32_t interface_interval;
 	uint32_t heartbeat_interval;
+	uint32_t serverstate_interval;
 
 	atomic_int reload_status;
 
 	bool flushonshutdown;
+	bool lazyload; /*%< Start before all zones are loaded */
+	atomic_bool started; /*%< Startup has been reported */
+	atomic_bool timing;  /*%< Startup phases are being measured */
+	isc_time_t  zoneloadstart;
+	uint64_t    startuptimes[named_startup_max]; /*%< Microseconds */
 
 	named_cachelist_t cachelist; /*%< Possibly shared caches
 				      * */
@@ -115,6 +156,10 @@ struct named_server {
 
 	isc_tlsctx_cache_t *tlsctx_server_cache;
 	isc_tlsctx_cache_t *tlsctx_client_cache;
+
+	isc_mutex_t	catzlock;
+	isc_eventlist_t catzchanges; /*%< Pending catalog zone changes */
+	bool		catzbatch;   /*%< Batch event in flight */
 };
 
 #define NAMED_SERVER_MAGIC    ISC_MAGIC('S', 'V', 'E', 'R')
@@ -249,6 +294,13 @@ named_server_flushcache(named_server_t *server, isc_lex_t *lex);
 isc_result_t
 named_server_flushnode(named_server_t *server, isc_lex_t *lex, bool tree);
 
+/*%
+ * Discard the answers cached from the DLZ databases of a view, or of
+ * all views.
+ */
+isc_result_t
+named_server_flushdlz(named_server_t *server, isc_lex_t *lex);
+
 /*%
  * Report the server's status.
  */
@@ -374,6 +426,20 @@ named_server_testgen(isc_lex_t *lex, isc_buffer_t **text);
 isc_result_t
 named_server_mkeys(named_server_t *server, isc_lex_t *lex, isc_buffer_t **text);
 
+/*%
+ * Return the name of startup phase 'phase'.
+ */
+const char *
+named_server_startupphasename(named_startupphase_t phase);
+
+/*%
+ * Return true and copy the durations of the startup phases, in
+ * microseconds, into 'times' once startup is complete.
+ */
+bool
+named_server_startuptimes(named_server_t *server,
+			  uint64_t times[named_startup_max]);
+
 /*%
  * Close and reopen DNSTAP output file.
  */
@@ -1312,6 +1312,12 @@ setup(void) {
 				      isc_result_totext(result));
 	}
 
+	/*
+	 * Now that we won't fork anymore, let the workers queue their
+	 * log messages for a logger thread instead of writing them.
+	 */
+	isc_log_startasync(named_g_lctx);
+
 	named_builtin_init();
 
 	/*
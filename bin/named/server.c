@@ -36,8 +36,10 @@
 #include <isc/hash.h>
 #include <isc/hex.h>
 #include <isc/hmac.h>
+#include <isc/ht.h>
 #include <isc/httpd.h>
 #include <isc/lex.h>
+#include <isc/md.h>
 #include <isc/meminfo.h>
 #include <isc/netmgr.h>
 #include <isc/nonce.h>
@@ -108,10 +110,14 @@
 #include <isccfg/kaspconf.h>
 #include <isccfg/namedconf.h>
 
+#include <ns/answercache.h>
 #include <ns/client.h>
 #include <ns/hooks.h>
 #include <ns/interfacemgr.h>
 #include <ns/listenlist.h>
+#include <ns/querylog.h>
+#include <ns/stats.h>
+#include <ns/xfrout.h>
 
 #include <bind9/check.h>
 
@@ -246,6 +252,8 @@ struct named_cache {
 	bool needflush;
 	bool adbsizeadjusted;
 	dns_rdataclass_t rdclass;
+	bool haveresolverdigest;
+	unsigned char resolverdigest[DNS_ZONE_CFGDIGEST_LENGTH];
 	ISC_LINK(named_cache_t) link;
 };
 
@@ -437,7 +445,7 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	       const cfg_obj_t *vconfig, isc_mem_t *mctx, dns_view_t *view,
 	       dns_viewlist_t *viewlist, dns_kasplist_t *kasplist,
 	       cfg_aclconfctx_t *aclconf, bool added, bool old_rpz_ok,
-	       bool modify);
+	       bool modify, const unsigned char *viewdigest);
 
 static void
 configure_zone_setviewcommit(isc_result_t result, const cfg_obj_t *zconfig,
@@ -453,6 +461,9 @@ add_keydata_zone(dns_view_t *view, const char *directory, isc_mem_t *mctx);
 static void
 end_reserved_dispatches(named_server_t *server, bool all);
 
+static void
+update_matchviews(named_server_t *server);
+
 static void
 newzone_cfgctx_destroy(void **cfgp);
 
@@ -998,6 +1009,23 @@ done:
  * only load keys matching that name. If 'managed' is true, load the key as
  * an initializing key.
  */
+/*
+ * While named is starting, add the time since '*start' to the duration
+ * of startup phase 'phase'.
+ */
+static void
+startup_phase_done(named_startupphase_t phase, const isc_time_t *start) {
+	named_server_t *server = named_g_server;
+	isc_time_t now;
+
+	if (server == NULL || !atomic_load(&server->timing)) {
+		return;
+	}
+
+	TIME_NOW(&now);
+	server->startuptimes[phase] += isc_time_microdiff(&now, start);
+}
+
 static isc_result_t
 load_view_keys(const cfg_obj_t *keys, dns_view_t *view, bool managed,
 	       const dns_name_t *keyname) {
@@ -1839,7 +1867,7 @@ cachelist_find(named_cachelist_t *cachelist, const char *cachename,
 
 static bool
 cache_reusable(dns_view_t *originview, dns_view_t *view,
-	       bool new_zero_no_soattl) {
+	       bool new_zero_no_soattl, unsigned int new_cache_shards) {
 	if (originview->rdclass != view->rdclass ||
 	    originview->checknames != view->checknames ||
 	    dns_resolver_getzeronosoattl(originview->resolver) !=
@@ -1847,7 +1875,8 @@ cache_reusable(dns_view_t *originview, dns_view_t *view,
 	    originview->acceptexpired != view->acceptexpired ||
 	    originview->enablevalidation != view->enablevalidation ||
 	    originview->maxcachettl != view->maxcachettl ||
-	    originview->maxncachettl != view->maxncachettl)
+	    originview->maxncachettl != view->maxncachettl ||
+	    dns_cache_getshards(originview->cache) != new_cache_shards)
 	{
 		return (false);
 	}
@@ -1857,13 +1886,16 @@ cache_reusable(dns_view_t *originview, dns_view_t *view,
 
 static bool
 cache_sharable(dns_view_t *originview, dns_view_t *view,
-	       bool new_zero_no_soattl, uint64_t new_max_cache_size,
-	       uint32_t new_stale_ttl, uint32_t new_stale_refresh_time) {
+	       bool new_zero_no_soattl, unsigned int new_cache_shards,
+	       uint64_t new_max_cache_size, uint32_t new_stale_ttl,
+	       uint32_t new_stale_refresh_time) {
 	/*
 	 * If the cache cannot even reused for the same view, it cannot be
 	 * shared with other views.
 	 */
-	if (!cache_reusable(originview, view, new_zero_no_soattl)) {
+	if (!cache_reusable(originview, view, new_zero_no_soattl,
+			    new_cache_shards))
+	{
 		return (false);
 	}
 
@@ -2819,16 +2851,13 @@ catz_addmodzone_taskaction(isc_task_t *task, isc_event_t *event0) {
 	zoneobj = cfg_listelt_value(cfg_list_first(zlist));
 
 	/* Mark view unfrozen so that zone can be added */
-
-	result = isc_task_beginexclusive(task);
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	dns_view_thaw(ev->view);
 	result = configure_zone(
 		cfg->config, zoneobj, cfg->vconfig, ev->cbd->server->mctx,
 		ev->view, &ev->cbd->server->viewlist,
-		&ev->cbd->server->kasplist, cfg->actx, true, false, ev->mod);
+		&ev->cbd->server->kasplist, cfg->actx, true, false, ev->mod,
+		NULL);
 	dns_view_freeze(ev->view);
-	isc_task_endexclusive(task);
 
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
@@ -2891,8 +2920,7 @@ catz_delzone_taskaction(isc_task_t *task, isc_event_t *event0) {
 	char cname[DNS_NAME_FORMATSIZE];
 	const char *file;
 
-	result = isc_task_beginexclusive(task);
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	UNUSED(task);
 
 	dns_name_format(dns_catz_entry_getname(ev->entry), cname,
 			DNS_NAME_FORMATSIZE);
@@ -2947,7 +2975,6 @@ catz_delzone_taskaction(isc_task_t *task, isc_event_t *event0) {
 		      "zone '%s' deleted",
 		      cname);
 cleanup:
-	isc_task_endexclusive(task);
 	if (zone != NULL) {
 		dns_zone_detach(&zone);
 	}
@@ -2957,11 +2984,56 @@ cleanup:
 	isc_event_free(ISC_EVENT_PTR(&ev));
 }
 
+/*
+ * Apply queued catalog zone changes.  A large catalog update can queue
+ * many thousands of them, and each needs the server to be exclusive;
+ * they are applied in batches of up to CATZ_BATCH_MAX per exclusive
+ * section instead of one each.
+ */
+#define CATZ_BATCH_MAX 256
+
+static void
+catz_batch_taskaction(isc_task_t *task, isc_event_t *event) {
+	named_server_t *server = (named_server_t *)event->ev_arg;
+	isc_eventlist_t changes;
+	isc_event_t *ev = NULL;
+	isc_result_t result;
+	unsigned int count = 0;
+
+	ISC_LIST_INIT(changes);
+
+	LOCK(&server->catzlock);
+	while ((ev = ISC_LIST_HEAD(server->catzchanges)) != NULL &&
+	       count++ < CATZ_BATCH_MAX)
+	{
+		ISC_LIST_UNLINK(server->catzchanges, ev, ev_link);
+		ISC_LIST_APPEND(changes, ev, ev_link);
+	}
+	if (ISC_LIST_EMPTY(server->catzchanges)) {
+		server->catzbatch = false;
+		isc_event_free(&event);
+	} else {
+		/* Let other exclusive work in before the next batch. */
+		isc_task_send(task, &event);
+	}
+	UNLOCK(&server->catzlock);
+
+	result = isc_task_beginexclusive(task);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	while ((ev = ISC_LIST_HEAD(changes)) != NULL) {
+		ISC_LIST_UNLINK(changes, ev, ev_link);
+		ev->ev_action(task, ev);
+	}
+	isc_task_endexclusive(task);
+}
+
 static isc_result_t
 catz_create_chg_task(dns_catz_entry_t *entry, dns_catz_zone_t *origin,
 		     dns_view_t *view, isc_taskmgr_t *taskmgr, void *udata,
 		     isc_eventtype_t type) {
 	catz_chgzone_event_t *event = NULL;
+	named_server_t *server = NULL;
+	isc_event_t *batch = NULL;
 	isc_task_t *task = NULL;
 	isc_result_t result;
 	isc_taskaction_t action = NULL;
@@ -2997,7 +3069,18 @@ catz_create_chg_task(dns_catz_entry_t *entry, dns_catz_zone_t *origin,
 	dns_catz_attach_catz(origin, &event->origin);
 	dns_view_attach(view, &event->view);
 
-	isc_task_send(task, ISC_EVENT_PTR(&event));
+	server = event->cbd->server;
+	LOCK(&server->catzlock);
+	ISC_LIST_APPEND(server->catzchanges, (isc_event_t *)event, ev_link);
+	if (!server->catzbatch) {
+		server->catzbatch = true;
+		batch = isc_event_allocate(server->mctx, server,
+					   NAMED_EVENT_CATZBATCH,
+					   catz_batch_taskaction, server,
+					   sizeof(isc_event_t));
+		isc_task_send(task, &batch);
+	}
+	UNLOCK(&server->catzlock);
 	isc_task_detach(&task);
 
 	return (ISC_R_SUCCESS);
@@ -3367,6 +3450,11 @@ configure_rrl(dns_view_t *view, const cfg_obj_t *config, const cfg_obj_t *map) {
 		rrl->log_only = false;
 	}
 
+	result = dns_rrl_shard(rrl, min_entries);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
 	return (ISC_R_SUCCESS);
 
 cleanup:
@@ -3935,6 +4023,32 @@ configure_dnstap(const cfg_obj_t **maps, dns_view_t *view) {
 	dns_dt_attach(named_g_server->dtenv, &view->dtenv);
 	view->dttypes = dttypes;
 
+	obj = NULL;
+	result = named_config_get(maps, "dnstap-sample", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->dtsample = cfg_obj_asuint32(obj);
+
+	obj = NULL;
+	result = named_config_get(maps, "dnstap-sample-types", &obj);
+	if (result == ISC_R_SUCCESS) {
+		view->dtnqtypes = cfg_list_length(obj, false);
+		view->dtqtypes = isc_mem_get(
+			view->mctx,
+			view->dtnqtypes * sizeof(view->dtqtypes[0]));
+		i = 0;
+		for (element = cfg_list_first(obj); element != NULL;
+		     element = cfg_list_next(element))
+		{
+			isc_textregion_t r;
+
+			obj2 = cfg_listelt_value(element);
+			DE_CONST(cfg_obj_asstring(obj2), r.base);
+			r.length = strlen(r.base);
+			CHECKM(dns_rdatatype_fromtext(&view->dtqtypes[i++], &r),
+			       "invalid 'dnstap-sample-types'");
+		}
+	}
+
 	result = ISC_R_SUCCESS;
 
 cleanup:
@@ -4066,6 +4180,200 @@ algorithm_name(unsigned int alg) {
 	}
 }
 
+static void
+cfgdigest_print(void *closure, const char *text, int textlen) {
+	(void)isc_md_update((isc_md_t *)closure, (const unsigned char *)text,
+			    textlen);
+}
+
+/*
+ * Add every statement in 'map' except zones and views to 'md'.
+ */
+static void
+cfgdigest_map(isc_md_t *md, const cfg_obj_t *map) {
+	const void *clauses = NULL;
+	unsigned int idx;
+	const char *name;
+
+	for (name = cfg_map_firstclause(map->type, &clauses, &idx);
+	     name != NULL; name = cfg_map_nextclause(map->type, &clauses, &idx))
+	{
+		const cfg_obj_t *obj = NULL;
+
+		if (strcasecmp(name, "zone") == 0 ||
+		    strcasecmp(name, "view") == 0 ||
+		    cfg_map_get(map, name, &obj) != ISC_R_SUCCESS)
+		{
+			continue;
+		}
+		(void)isc_md_update(md, (const unsigned char *)name,
+				    strlen(name) + 1);
+		cfg_printx(obj, CFG_PRINTER_ONELINE, cfgdigest_print, md);
+	}
+}
+
+/*
+ * Compute a digest of everything in 'config' and 'vconfig' that the
+ * zones in a view may inherit their configuration from.
+ */
+static isc_result_t
+view_cfgdigest(const cfg_obj_t *config, const cfg_obj_t *vconfig,
+	       unsigned char *digest) {
+	isc_md_t *md = isc_md_new();
+	unsigned int len = 0;
+	isc_result_t result;
+
+	CHECK(isc_md_init(md, ISC_MD_SHA256));
+	cfgdigest_map(md, config);
+	if (vconfig != NULL) {
+		cfg_printx(cfg_tuple_get(vconfig, "name"), 0, cfgdigest_print,
+			   md);
+		cfg_printx(cfg_tuple_get(vconfig, "class"), 0,
+			   cfgdigest_print, md);
+		cfgdigest_map(md, cfg_tuple_get(vconfig, "options"));
+	}
+	CHECK(isc_md_final(md, digest, &len));
+	INSIST(len == DNS_ZONE_CFGDIGEST_LENGTH);
+
+cleanup:
+	isc_md_free(md);
+	return (result);
+}
+
+/*
+ * Compute a digest of 'zconfig' within the view digested by
+ * view_cfgdigest().
+ */
+static isc_result_t
+zone_cfgdigest(const unsigned char *viewdigest, const cfg_obj_t *zconfig,
+	       unsigned char *digest) {
+	isc_md_t *md = isc_md_new();
+	unsigned int len = 0;
+	isc_result_t result;
+
+	CHECK(isc_md_init(md, ISC_MD_SHA256));
+	CHECK(isc_md_update(md, viewdigest, DNS_ZONE_CFGDIGEST_LENGTH));
+	cfg_printx(zconfig, CFG_PRINTER_ONELINE, cfgdigest_print, md);
+	CHECK(isc_md_final(md, digest, &len));
+	INSIST(len == DNS_ZONE_CFGDIGEST_LENGTH);
+
+cleanup:
+	isc_md_free(md);
+	return (result);
+}
+
+/*
+ * View statements that do not change how the view resolves names.
+ */
+static const char *resolver_cfgskip[] = {
+	"allow-query",		"allow-query-on",	"allow-query-cache",
+	"allow-query-cache-on",	"allow-recursion",	"allow-recursion-on",
+	"attach-cache",		"attach-resolver",	"match-clients",
+	"match-destinations",	"match-recursive-only",	"zone",
+	NULL
+};
+
+/*
+ * Compute a digest of the statements in 'vconfig' that may change how
+ * the view resolves names: all of them except resolver_cfgskip[], and
+ * its forward, hint, stub and static-stub zones.  Views in the same
+ * configuration with the same digest can use the same resolver.
+ */
+static isc_result_t
+resolver_cfgdigest(const cfg_obj_t *vconfig, unsigned char *digest) {
+	const cfg_obj_t *voptions = cfg_tuple_get(vconfig, "options");
+	const cfg_obj_t *zonelist = NULL;
+	const cfg_listelt_t *element = NULL;
+	const void *clauses = NULL;
+	isc_md_t *md = isc_md_new();
+	unsigned int idx, len = 0;
+	const char *name;
+	isc_result_t result;
+
+	CHECK(isc_md_init(md, ISC_MD_SHA256));
+	cfg_printx(cfg_tuple_get(vconfig, "class"), 0, cfgdigest_print, md);
+	for (name = cfg_map_firstclause(voptions->type, &clauses, &idx);
+	     name != NULL;
+	     name = cfg_map_nextclause(voptions->type, &clauses, &idx))
+	{
+		const cfg_obj_t *obj = NULL;
+		bool skip = false;
+
+		for (size_t i = 0; !skip && resolver_cfgskip[i] != NULL; i++) {
+			skip = (strcasecmp(name, resolver_cfgskip[i]) == 0);
+		}
+		if (skip || cfg_map_get(voptions, name, &obj) != ISC_R_SUCCESS)
+		{
+			continue;
+		}
+		(void)isc_md_update(md, (const unsigned char *)name,
+				    strlen(name) + 1);
+		cfg_printx(obj, CFG_PRINTER_ONELINE, cfgdigest_print, md);
+	}
+
+	(void)cfg_map_get(voptions, "zone", &zonelist);
+	for (element = cfg_list_first(zonelist); element != NULL;
+	     element = cfg_list_next(element))
+	{
+		const cfg_obj_t *zconfig = cfg_listelt_value(element);
+		const cfg_obj_t *typeobj = NULL;
+		const char *type;
+
+		(void)cfg_map_get(cfg_tuple_get(zconfig, "options"), "type",
+				  &typeobj);
+		if (typeobj == NULL) {
+			continue;
+		}
+		type = cfg_obj_asstring(typeobj);
+		if (strcasecmp(type, "forward") == 0 ||
+		    strcasecmp(type, "hint") == 0 ||
+		    strcasecmp(type, "stub") == 0 ||
+		    strcasecmp(type, "static-stub") == 0)
+		{
+			cfg_printx(zconfig, CFG_PRINTER_ONELINE,
+				   cfgdigest_print, md);
+		}
+	}
+	CHECK(isc_md_final(md, digest, &len));
+	INSIST(len == DNS_ZONE_CFGDIGEST_LENGTH);
+
+cleanup:
+	isc_md_free(md);
+	return (result);
+}
+
+/*
+ * Reserve the dispatches named_zone_configure() would have reserved
+ * for 'zone'.
+ */
+static void
+zone_reservedispatches(dns_zone_t *zone) {
+	dns_zone_t *raw = NULL;
+	dns_zone_t *mayberaw = zone;
+
+	dns_zone_getraw(zone, &raw);
+	if (raw != NULL) {
+		mayberaw = raw;
+	}
+
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getparentalsrc4(zone));
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getparentalsrc6(zone));
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getnotifysrc4(zone));
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getnotifysrc6(zone));
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getxfrsource4(mayberaw));
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getxfrsource6(mayberaw));
+
+	if (raw != NULL) {
+		dns_zone_detach(&raw);
+	}
+}
+
 /*
  * Configure 'view' according to 'vconfig', taking defaults from
  * 'config' where values are missing in 'vconfig'.
@@ -4080,6 +4388,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	       isc_mem_t *mctx, cfg_aclconfctx_t *actx, bool need_hints) {
 	const cfg_obj_t *maps[4];
 	const cfg_obj_t *cfgmaps[3];
+	isc_time_t phasestart;
 	const cfg_obj_t *optionmaps[3];
 	const cfg_obj_t *options = NULL;
 	const cfg_obj_t *voptions = NULL;
@@ -4098,6 +4407,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	const cfg_obj_t *obj, *obj2;
 	const cfg_listelt_t *element = NULL;
 	const cfg_listelt_t *zone_element_latest = NULL;
+	unsigned char viewdigest[DNS_ZONE_CFGDIGEST_LENGTH];
+	bool haveviewdigest;
 	in_port_t port;
 	dns_cache_t *cache = NULL;
 	isc_result_t result;
@@ -4107,6 +4418,12 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	uint32_t lame_ttl, fail_ttl;
 	uint32_t max_stale_ttl = 0;
 	uint32_t stale_refresh_time = 0;
+	uint32_t cache_shards;
+	uint32_t cache_top_domains;
+	dns_cachepolicy_t cache_policy;
+	const char *cache_dump_file = NULL;
+	uint32_t cache_dump_interval;
+	bool newcache = false;
 	dns_tsig_keyring_t *ring = NULL;
 	dns_transport_list_t *transports = NULL;
 	dns_view_t *pview = NULL; /* Production view */
@@ -4116,6 +4433,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	bool rpz_configured = false;
 	bool catz_configured = false;
 	bool shared_cache = false;
+	bool shared_resolver = false;
 	int i = 0, j = 0, k = 0;
 	const char *str;
 	const char *cachename = NULL;
@@ -4184,7 +4502,9 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	if (view->rdclass == dns_rdataclass_in && need_hints &&
 	    named_config_get(maps, "response-policy", &obj) == ISC_R_SUCCESS)
 	{
+		TIME_NOW(&phasestart);
 		CHECK(configure_rpz(view, NULL, maps, obj, &old_rpz_ok));
+		startup_phase_done(named_startup_policyzones, &phasestart);
 		rpz_configured = true;
 	}
 
@@ -4201,7 +4521,9 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	if (view->rdclass == dns_rdataclass_in && need_hints &&
 	    named_config_get(maps, "catalog-zones", &obj) == ISC_R_SUCCESS)
 	{
+		TIME_NOW(&phasestart);
 		CHECK(configure_catz(view, NULL, config, obj));
+		startup_phase_done(named_startup_policyzones, &phasestart);
 		catz_configured = true;
 	}
 
@@ -4218,13 +4540,16 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	/*
 	 * Load zone configuration
 	 */
+	haveviewdigest = (view_cfgdigest(config, vconfig, viewdigest) ==
+			  ISC_R_SUCCESS);
 	for (element = cfg_list_first(zonelist); element != NULL;
 	     element = cfg_list_next(element))
 	{
 		const cfg_obj_t *zconfig = cfg_listelt_value(element);
 		CHECK(configure_zone(config, zconfig, vconfig, mctx, view,
 				     viewlist, kasplist, actx, false,
-				     old_rpz_ok, false));
+				     old_rpz_ok, false,
+				     haveviewdigest ? viewdigest : NULL));
 		zone_element_latest = element;
 	}
 
@@ -4282,6 +4607,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		if (obj != NULL) {
 			dns_dlzdb_t *dlzdb = NULL;
 			const cfg_obj_t *name, *search = NULL;
+			const cfg_obj_t *cachettl = NULL;
 			char *s = isc_mem_strdup(mctx, cfg_obj_asstring(obj));
 
 			if (s == NULL) {
@@ -4306,6 +4632,12 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 				goto cleanup;
 			}
 
+			(void)cfg_map_get(dlz, "lookup-cache-ttl", &cachettl);
+			if (cachettl != NULL) {
+				dns_dlz_setcachettl(
+					dlzdb, cfg_obj_asduration(cachettl));
+			}
+
 			/*
 			 * If the DLZ backend supports configuration,
 			 * and is searchable, then call its configure
@@ -4645,6 +4977,46 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	INSIST(result == ISC_R_SUCCESS);
 	stale_refresh_time = cfg_obj_asduration(obj);
 
+	obj = NULL;
+	result = named_config_get(maps, "cache-shards", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	cache_shards = cfg_obj_asuint32(obj);
+
+	obj = NULL;
+	result = named_config_get(maps, "cache-eviction", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (strcasecmp(cfg_obj_asstring(obj), "slru") == 0) {
+		cache_policy = dns_cachepolicy_slru;
+	} else {
+		cache_policy = dns_cachepolicy_lru;
+	}
+
+	obj = NULL;
+	result = named_config_get(maps, "cache-top-domains", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	cache_top_domains = cfg_obj_asuint32(obj);
+
+	/*
+	 * Only the caches of recursive views are worth saving, and
+	 * this keeps the built-in views from using a file set in the
+	 * global options block.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "recursion", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asboolean(obj)) {
+		obj = NULL;
+		result = named_config_get(maps, "cache-dump-file", &obj);
+		if (result == ISC_R_SUCCESS) {
+			cache_dump_file = cfg_obj_asstring(obj);
+		}
+	}
+
+	obj = NULL;
+	result = named_config_get(maps, "cache-dump-interval", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	cache_dump_interval = cfg_obj_asduration(obj);
+
 	/*
 	 * Configure the view's cache.
 	 *
@@ -4653,7 +5025,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	 * there is not one, then try to reuse an existing cache if possible;
 	 * otherwise create a new cache.
 	 *
-	 * Note that the ADB is not preserved or shared in either case.
+	 * Note that the ADB is not preserved in either case, and is only
+	 * shared by views with "attach-resolver yes".
 	 *
 	 * When a matching view is found, the associated statistics are also
 	 * retrieved and reused.
@@ -4679,8 +5052,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	nsc = cachelist_find(cachelist, cachename, view->rdclass);
 	if (nsc != NULL) {
 		if (!cache_sharable(nsc->primaryview, view, zero_no_soattl,
-				    max_cache_size, max_stale_ttl,
-				    stale_refresh_time))
+				    cache_shards, max_cache_size,
+				    max_stale_ttl, stale_refresh_time))
 		{
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
@@ -4703,7 +5076,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 			}
 			if (pview != NULL) {
 				if (!cache_reusable(pview, view,
-						    zero_no_soattl))
+						    zero_no_soattl,
+						    cache_shards))
 				{
 					isc_log_write(named_g_lctx,
 						      NAMED_LOGCATEGORY_GENERAL,
@@ -4749,9 +5123,10 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 			CHECK(dns_cache_create(cmctx, hmctx, named_g_taskmgr,
 					       named_g_timermgr, view->rdclass,
 					       cachename, "rbt", 0, NULL,
-					       &cache));
+					       cache_shards, &cache));
 			isc_mem_detach(&cmctx);
 			isc_mem_detach(&hmctx);
+			newcache = true;
 		}
 		nsc = isc_mem_get(mctx, sizeof(*nsc));
 		nsc->cache = NULL;
@@ -4760,6 +5135,10 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		nsc->needflush = false;
 		nsc->adbsizeadjusted = false;
 		nsc->rdclass = view->rdclass;
+		nsc->haveresolverdigest =
+			(vconfig != NULL &&
+			 resolver_cfgdigest(vconfig, nsc->resolverdigest) ==
+				 ISC_R_SUCCESS);
 		ISC_LINK_INIT(nsc, link);
 		ISC_LIST_APPEND(*cachelist, nsc, link);
 	}
@@ -4768,6 +5147,27 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	dns_cache_setcachesize(cache, max_cache_size);
 	dns_cache_setservestalettl(cache, max_stale_ttl);
 	dns_cache_setservestalerefresh(cache, stale_refresh_time);
+	dns_cache_setcachepolicy(cache, cache_policy);
+	dns_cache_settopdomains(cache, cache_top_domains);
+
+	if (newcache && cache_dump_file != NULL) {
+		result = dns_cache_load(cache, cache_dump_file);
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER,
+			      (result == ISC_R_SUCCESS ||
+			       result == ISC_R_FILENOTFOUND)
+				      ? ISC_LOG_INFO
+				      : ISC_LOG_WARNING,
+			      "loading cache for view %s from '%s': %s",
+			      view->name, cache_dump_file,
+			      (result == ISC_R_SUCCESS)
+				      ? "started"
+				      : isc_result_totext(result));
+	}
+	CHECK(dns_cache_setdumpfile(cache, cache_dump_file,
+				    cache_dump_interval));
+	CHECK(dns_cache_setsweepers(cache,
+				    isc_nm_getnworkers(named_g_netmgr)));
 
 	dns_cache_detach(&cache);
 
@@ -4779,19 +5179,6 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	/*
 	 * Resolver.
 	 */
-	CHECK(get_view_querysource_dispatch(
-		maps, AF_INET, &dispatch4,
-		(ISC_LIST_PREV(view, link) == NULL)));
-	CHECK(get_view_querysource_dispatch(
-		maps, AF_INET6, &dispatch6,
-		(ISC_LIST_PREV(view, link) == NULL)));
-	if (dispatch4 == NULL && dispatch6 == NULL) {
-		UNEXPECTED_ERROR("unable to obtain either an IPv4 or"
-				 " an IPv6 dispatch");
-		result = ISC_R_UNEXPECTED;
-		goto cleanup;
-	}
-
 	if (resstats == NULL) {
 		CHECK(isc_stats_create(mctx, &resstats,
 				       dns_resstatscounter_max));
@@ -4802,18 +5189,63 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	}
 	dns_view_setresquerystats(view, resquerystats);
 
-	ndisp = 4 * ISC_MIN(named_g_udpdisp, MAX_UDP_DISPATCH);
-	CHECK(dns_view_createresolver(
-		view, named_g_taskmgr, RESOLVER_NTASKS_PERCPU * named_g_cpus,
-		ndisp, named_g_netmgr, named_g_timermgr, resopts,
-		named_g_dispatchmgr, dispatch4, dispatch6));
+	/*
+	 * A view sharing the cache of an earlier view may also use its
+	 * resolver and ADB, if nothing in the two view statements can
+	 * make them resolve names differently.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "attach-resolver", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asboolean(obj) && shared_cache) {
+		unsigned char digest[DNS_ZONE_CFGDIGEST_LENGTH];
+
+		if (vconfig != NULL && nsc->haveresolverdigest &&
+		    resolver_cfgdigest(vconfig, digest) == ISC_R_SUCCESS &&
+		    memcmp(digest, nsc->resolverdigest, sizeof(digest)) == 0 &&
+		    dns_view_attachresolver(view, nsc->primaryview) ==
+			    ISC_R_SUCCESS)
+		{
+			shared_resolver = true;
+		} else {
+			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_WARNING,
+				      "view %s can't use the resolver of "
+				      "view %s due to configuration "
+				      "parameter mismatch",
+				      view->name, nsc->primaryview->name);
+		}
+	}
+
+	if (!shared_resolver) {
+		CHECK(get_view_querysource_dispatch(
+			maps, AF_INET, &dispatch4,
+			(ISC_LIST_PREV(view, link) == NULL)));
+		CHECK(get_view_querysource_dispatch(
+			maps, AF_INET6, &dispatch6,
+			(ISC_LIST_PREV(view, link) == NULL)));
+		if (dispatch4 == NULL && dispatch6 == NULL) {
+			UNEXPECTED_ERROR("unable to obtain either an IPv4 or"
+					 " an IPv6 dispatch");
+			result = ISC_R_UNEXPECTED;
+			goto cleanup;
+		}
+
+		ndisp = 4 * ISC_MIN(named_g_udpdisp, MAX_UDP_DISPATCH);
+		CHECK(dns_view_createresolver(
+			view, named_g_taskmgr,
+			RESOLVER_NTASKS_PERCPU * named_g_cpus, ndisp,
+			named_g_netmgr, named_g_timermgr, resopts,
+			named_g_dispatchmgr, dispatch4, dispatch6));
+	}
 
 	/*
 	 * Set the ADB cache size to 1/8th of the max-cache-size or
-	 * MAX_ADB_SIZE_FOR_CACHESHARE when the cache is shared.
+	 * MAX_ADB_SIZE_FOR_CACHESHARE when the cache is shared.  A
+	 * shared ADB keeps the size set by the view that created it.
 	 */
 	max_adb_size = 0;
-	if (max_cache_size != 0U) {
+	if (max_cache_size != 0U && !shared_resolver) {
 		max_adb_size = max_cache_size / 8;
 		if (max_adb_size == 0U) {
 			max_adb_size = 1; /* Force minimum. */
@@ -4829,7 +5261,9 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 			}
 		}
 	}
-	dns_adb_setadbsize(view->adb, max_adb_size);
+	if (!shared_resolver) {
+		dns_adb_setadbsize(view->adb, max_adb_size);
+	}
 
 	/*
 	 * Set up ADB quotas
@@ -4879,6 +5313,32 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		dns_adb_setquota(view->adb, fps, freq, low, high, discount);
 	}
 
+	/*
+	 * Restore what was learned about the servers queried by this
+	 * view before the last restart or reconfiguration.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "recursion", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asboolean(obj) && !shared_resolver) {
+		obj = NULL;
+		result = named_config_get(maps, "server-state-file", &obj);
+		if (result == ISC_R_SUCCESS) {
+			dns_adb_setstatefile(view->adb, cfg_obj_asstring(obj));
+			result = dns_adb_loadstate(view->adb);
+			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER,
+				      (result == ISC_R_SUCCESS ||
+				       result == ISC_R_FILENOTFOUND)
+					      ? ISC_LOG_INFO
+					      : ISC_LOG_WARNING,
+				      "loading server state for view %s "
+				      "from '%s': %s",
+				      view->name, cfg_obj_asstring(obj),
+				      isc_result_totext(result));
+		}
+	}
+
 	/*
 	 * Set resolver's lame-ttl.
 	 */
@@ -5004,6 +5464,35 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		dns_resolver_setnonbackofftries(view->resolver, resolver_param);
 	}
 
+	obj = NULL;
+	CHECK(named_config_get(maps, "resolver-race-threshold", &obj));
+	dns_resolver_setracethreshold(view->resolver, cfg_obj_asuint32(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "prime-domains", &obj);
+	if (result == ISC_R_SUCCESS && !shared_resolver) {
+		for (element = cfg_list_first(obj); element != NULL;
+		     element = cfg_list_next(element))
+		{
+			dns_fixedname_t fname;
+			dns_name_t *name = dns_fixedname_initname(&fname);
+
+			obj = cfg_listelt_value(element);
+			CHECK(dns_name_fromstring(name, cfg_obj_asstring(obj),
+						  0, NULL));
+			dns_resolver_addprimename(view->resolver, name);
+		}
+	}
+
+	obj = NULL;
+	CHECK(named_config_get(maps, "resolver-share-fetches", &obj));
+	if (cfg_obj_asboolean(obj) && view != nsc->primaryview &&
+	    nsc->primaryview->resolver != NULL && !shared_resolver)
+	{
+		dns_resolver_setsharedfetches(view->resolver,
+					      nsc->primaryview->resolver);
+	}
+
 	/*
 	 * Set supported DNSSEC algorithms.
 	 */
@@ -5052,7 +5541,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	 */
 	alternates = NULL;
 	(void)named_config_get(maps, "dual-stack-servers", &alternates);
-	if (alternates != NULL) {
+	if (alternates != NULL && !shared_resolver) {
 		CHECK(configure_alternates(config, view, alternates));
 	}
 
@@ -5246,6 +5735,11 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	INSIST(result == ISC_R_SUCCESS);
 	view->minimal_any = cfg_obj_asboolean(obj);
 
+	obj = NULL;
+	result = named_config_get(maps, "sort-additional-lookups", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->sortadditional = cfg_obj_asboolean(obj);
+
 	obj = NULL;
 	result = named_config_get(maps, "minimal-responses", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -5266,6 +5760,41 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		}
 	}
 
+	obj = NULL;
+	result = named_config_get(maps, "auth-answer-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asuint32(obj) > 0) {
+		INSIST(view->answercache == NULL);
+		ns_answercache_create(view->mctx, cfg_obj_asuint32(obj),
+				      (ns_answercache_t **)&view->answercache);
+		view->answercache_free = ns_answercache_free;
+	}
+
+	obj = NULL;
+	result = named_config_get(maps, "query-latency-statistics", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asboolean(obj)) {
+		isc_stats_t *latencystats = NULL;
+
+		/*
+		 * Keep counting in the production view's statistics.
+		 */
+		result = dns_viewlist_find(&named_g_server->viewlist,
+					   view->name, view->rdclass, &pview);
+		if (result != ISC_R_NOTFOUND && result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		if (pview != NULL) {
+			dns_view_getlatencystats(pview, &latencystats);
+			dns_view_detach(&pview);
+		}
+		if (latencystats == NULL) {
+			CHECK(ns_latencystats_create(mctx, &latencystats));
+		}
+		dns_view_setlatencystats(view, latencystats);
+		isc_stats_detach(&latencystats);
+	}
+
 	obj = NULL;
 	result = named_config_get(maps, "transfer-format", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -5622,12 +6151,19 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		view->prefetch_eligible = view->prefetch_trigger + 6;
 	}
 
+	obj = NULL;
+	result = named_config_get(maps, "prefetch-popular", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_resolver_setprefetchpopular(view->resolver, cfg_obj_asuint32(obj));
+
 	/*
 	 * For now, there is only one kind of trusted keys, the
 	 * "security roots".
 	 */
+	TIME_NOW(&phasestart);
 	CHECK(configure_view_dnsseckeys(view, vconfig, config, bindkeys,
 					auto_root, mctx));
+	startup_phase_done(named_startup_keys, &phasestart);
 	dns_resolver_resetmustbesecure(view->resolver);
 	obj = NULL;
 	result = named_config_get(maps, "dnssec-must-be-secure", &obj);
@@ -6485,7 +7021,7 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	       const cfg_obj_t *vconfig, isc_mem_t *mctx, dns_view_t *view,
 	       dns_viewlist_t *viewlist, dns_kasplist_t *kasplist,
 	       cfg_aclconfctx_t *aclconf, bool added, bool old_rpz_ok,
-	       bool modify) {
+	       bool modify, const unsigned char *viewdigest) {
 	dns_view_t *pview = NULL; /* Production view */
 	dns_zone_t *zone = NULL;  /* New or reused zone */
 	dns_zone_t *raw = NULL;	  /* New or reused raw zone */
@@ -6511,6 +7047,8 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	bool zone_maybe_inline = false;
 	bool inline_signing = false;
 	bool fullsign = false;
+	unsigned char digest[DNS_ZONE_CFGDIGEST_LENGTH];
+	bool havedigest;
 
 	options = NULL;
 	(void)cfg_map_get(config, "options", &options);
@@ -6884,10 +7422,24 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	}
 
 	/*
-	 * Configure the zone.
+	 * Configure the zone, unless it is being reused and neither its
+	 * own statement nor anything it inherits from has changed since
+	 * it was last configured; with very many zones this is most of
+	 * the time a reconfiguration spends in exclusive mode.
 	 */
-	CHECK(named_zone_configure(config, vconfig, zconfig, aclconf, kasplist,
-				   zone, raw));
+	havedigest = (viewdigest != NULL &&
+		      zone_cfgdigest(viewdigest, zconfig, digest) ==
+			      ISC_R_SUCCESS);
+	if (havedigest && dns_zone_cfgdigestmatch(zone, digest)) {
+		zone_reservedispatches(zone);
+	} else {
+		dns_zone_setcfgdigest(zone, NULL);
+		CHECK(named_zone_configure(config, vconfig, zconfig, aclconf,
+					   kasplist, zone, raw));
+		if (havedigest) {
+			dns_zone_setcfgdigest(zone, digest);
+		}
+	}
 
 	/*
 	 * Add the zone to its view in the new view list.
@@ -7090,8 +7642,40 @@ interface_timer_tick(isc_task_t *task, isc_event_t *event) {
 }
 
 static void
-heartbeat_timer_tick(isc_task_t *task, isc_event_t *event) {
-	named_server_t *server = (named_server_t *)event->ev_arg;
+save_serverstate(named_server_t *server) {
+	dns_view_t *view;
+
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		isc_result_t result;
+
+		if (view->adb == NULL) {
+			continue;
+		}
+		result = dns_adb_savestate(view->adb);
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+				      "error writing server state file "
+				      "for view '%s': %s",
+				      view->name, isc_result_totext(result));
+		}
+	}
+}
+
+static void
+serverstate_timer_tick(isc_task_t *task, isc_event_t *event) {
+	named_server_t *server = (named_server_t *)event->ev_arg;
+
+	UNUSED(task);
+	isc_event_free(&event);
+	save_serverstate(server);
+}
+
+static void
+heartbeat_timer_tick(isc_task_t *task, isc_event_t *event) {
+	named_server_t *server = (named_server_t *)event->ev_arg;
 	dns_view_t *view;
 
 	UNUSED(task);
@@ -8049,7 +8633,7 @@ configure_newzones(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 		CHECK(configure_zone(config, zconfig, vconfig, mctx, view,
 				     &named_g_server->viewlist,
 				     &named_g_server->kasplist, actx, true,
-				     false, false));
+				     false, false, NULL));
 	}
 
 	result = ISC_R_SUCCESS;
@@ -8233,7 +8817,7 @@ configure_newzone(const cfg_obj_t *zconfig, cfg_obj_t *config,
 		  cfg_aclconfctx_t *actx) {
 	return (configure_zone(
 		config, zconfig, vconfig, mctx, view, &named_g_server->viewlist,
-		&named_g_server->kasplist, actx, true, false, false));
+		&named_g_server->kasplist, actx, true, false, false, NULL));
 }
 
 /*%
@@ -8471,6 +9055,7 @@ static isc_result_t
 load_configuration(const char *filename, named_server_t *server,
 		   bool first_time) {
 	cfg_obj_t *config = NULL, *bindkeys = NULL;
+	isc_time_t phasestart;
 	cfg_parser_t *conf_parser = NULL, *bindkeys_parser = NULL;
 	const cfg_listelt_t *element;
 	const cfg_obj_t *builtin_views;
@@ -8499,6 +9084,7 @@ load_configuration(const char *filename, named_server_t *server,
 	isc_result_t result, tresult;
 	uint32_t heartbeat_interval;
 	uint32_t interface_interval;
+	uint32_t serverstate_interval;
 	uint32_t udpsize;
 	uint32_t transfer_message_size;
 	uint32_t recv_tcp_buffer_size;
@@ -8555,6 +9141,7 @@ load_configuration(const char *filename, named_server_t *server,
 	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 		      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
 		      "loading configuration from '%s'", filename);
+	TIME_NOW(&phasestart);
 	CHECK(cfg_parser_create(named_g_mctx, named_g_lctx, &conf_parser));
 	cfg_parser_setcallback(conf_parser, directory_callback, NULL);
 	result = cfg_parse_file(conf_parser, filename, &cfg_type_namedconf,
@@ -8620,6 +9207,11 @@ load_configuration(const char *filename, named_server_t *server,
 	result = named_config_get(maps, "http-streams-per-connection", &obj);
 	INSIST(result == ISC_R_SUCCESS);
 	named_g_http_streams_per_conn = cfg_obj_asuint32(obj);
+
+	obj = NULL;
+	result = named_config_get(maps, "http-get-cache-ttl", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_nm_sethttpgetcachettl(named_g_netmgr, cfg_obj_asuint32(obj));
 #endif
 
 	/*
@@ -8661,6 +9253,7 @@ load_configuration(const char *filename, named_server_t *server,
 			      "instead",
 			      server->bindkeysfile);
 	}
+	startup_phase_done(named_startup_parse, &phasestart);
 
 	/* Ensure exclusive access to configuration data. */
 	if (!exclusive) {
@@ -8728,7 +9321,41 @@ load_configuration(const char *filename, named_server_t *server,
 		softquota = (max * 90) / 100;
 	}
 
-	isc_quota_soft(&server->sctx->recursionquota, softquota);
+	obj = NULL;
+	result = named_config_get(maps, "adaptive-recursive-clients", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_reclimit_configure(&server->sctx->reclimit, cfg_obj_asboolean(obj),
+			      softquota);
+
+	{
+		uint32_t recursion, tcp, prefixlen4, prefixlen6;
+
+		obj = NULL;
+		result = named_config_get(maps, "recursive-clients-per-prefix",
+					  &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		recursion = cfg_obj_asuint32(obj);
+
+		obj = NULL;
+		result = named_config_get(maps, "tcp-clients-per-prefix", &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		tcp = cfg_obj_asuint32(obj);
+
+		obj = NULL;
+		result = named_config_get(maps, "client-ipv4-prefix-length",
+					  &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		prefixlen4 = cfg_obj_asuint32(obj);
+
+		obj = NULL;
+		result = named_config_get(maps, "client-ipv6-prefix-length",
+					  &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		prefixlen6 = cfg_obj_asuint32(obj);
+
+		ns_prefixlimit_configure(server->sctx->prefixlimit, recursion,
+					 tcp, prefixlen4, prefixlen6);
+	}
 
 	/*
 	 * Set "blackhole". Only legal at options level; there is
@@ -8870,6 +9497,21 @@ load_configuration(const char *filename, named_server_t *server,
 
 #undef CAP_IF_NOT_ZERO
 
+	obj = NULL;
+	result = named_config_get(maps, "udp-send-batch", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_nm_setudpsendbatch(named_g_netmgr, cfg_obj_asuint32(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "tcp-send-batch", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_nm_settcpsendbatch(named_g_netmgr, cfg_obj_asuint32(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "tcp-evict-idle", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_nm_settcpevictidle(named_g_netmgr, cfg_obj_asboolean(obj));
+
 	/*
 	 * Configure sets of UDP query source ports.
 	 */
@@ -8966,6 +9608,31 @@ load_configuration(const char *filename, named_server_t *server,
 	server->sctx->transfer_tcp_message_size =
 		(uint16_t)transfer_message_size;
 
+	obj = NULL;
+	result = named_config_get(maps, "transfer-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_xfrcache_setmaxsize(server->sctx->xfrcache,
+			       (size_t)cfg_obj_asuint64(obj));
+
+	/*
+	 * (Re)open the binary query log.
+	 */
+	if (server->sctx->querylog != NULL) {
+		ns_querylog_destroy(&server->sctx->querylog);
+	}
+	obj = NULL;
+	if (named_config_get(maps, "querylog-binary", &obj) == ISC_R_SUCCESS) {
+		const char *path = cfg_obj_asstring(obj);
+
+		result = ns_querylog_create(named_g_mctx, path,
+					    &server->sctx->querylog);
+		if (result != ISC_R_SUCCESS) {
+			cfg_obj_log(obj, named_g_lctx, ISC_LOG_ERROR,
+				    "unable to open binary query log '%s': %s",
+				    path, isc_result_totext(result));
+		}
+	}
+
 	/*
 	 * Configure the zone manager.
 	 */
@@ -9038,6 +9705,26 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 #endif
 
+	obj = NULL;
+	result = named_config_get(maps, "cpu-affinity", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (first_time) {
+		if (cfg_obj_asboolean(obj)) {
+			result = isc_nm_setcpuaffinity(named_g_netmgr);
+			if (result != ISC_R_SUCCESS) {
+				cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+					    "unable to set cpu-affinity: %s",
+					    isc_result_totext(result));
+			}
+		}
+	} else if (cfg_obj_asboolean(obj) !=
+		   isc_nm_getcpuaffinity(named_g_netmgr))
+	{
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "changing cpu-affinity value requires server "
+			    "restart");
+	}
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -9107,7 +9794,9 @@ load_configuration(const char *filename, named_server_t *server,
 	 * to configure the query source, since the dispatcher we use might
 	 * be shared with an interface.
 	 */
+	TIME_NOW(&phasestart);
 	result = ns_interfacemgr_scan(server->interfacemgr, true, true);
+	startup_phase_done(named_startup_interfaces, &phasestart);
 
 	/*
 	 * Check that named is able to TCP listen on at least one
@@ -9169,6 +9858,26 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 	server->heartbeat_interval = heartbeat_interval;
 
+	/*
+	 * Configure the timer saving the servers' state for the views
+	 * with a "server-state-file".
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "server-state-interval", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	serverstate_interval = cfg_obj_asduration(obj);
+	if (serverstate_interval == 0) {
+		CHECK(isc_timer_reset(server->serverstate_timer,
+				      isc_timertype_inactive, NULL, NULL,
+				      true));
+	} else if (server->serverstate_interval != serverstate_interval) {
+		isc_interval_set(&interval, serverstate_interval, 0);
+		CHECK(isc_timer_reset(server->serverstate_timer,
+				      isc_timertype_ticker, NULL, &interval,
+				      false));
+	}
+	server->serverstate_interval = serverstate_interval;
+
 	isc_interval_set(&interval, 1200, 0);
 	CHECK(isc_timer_reset(server->pps_timer, isc_timertype_ticker, NULL,
 			      &interval, false));
@@ -9317,11 +10026,21 @@ load_configuration(const char *filename, named_server_t *server,
 		      "sizing zone task pool based on %d zones", num_zones);
 	CHECK(dns_zonemgr_setsize(named_g_server->zonemgr, num_zones));
 
+	/*
+	 * The views about to be configured replace the current ones;
+	 * save what those learned about servers so the new ones can
+	 * load it.
+	 */
+	if (!first_time) {
+		save_serverstate(server);
+	}
+
 	/*
 	 * Configure and freeze all explicit views.  Explicit
 	 * views that have zones were already created at parsing
 	 * time, but views with no zones must be created here.
 	 */
+	TIME_NOW(&phasestart);
 	for (element = cfg_list_first(views); element != NULL;
 	     element = cfg_list_next(element))
 	{
@@ -9369,6 +10088,7 @@ load_configuration(const char *filename, named_server_t *server,
 		dns_view_detach(&view);
 		view = NULL;
 	}
+	startup_phase_done(named_startup_views, &phasestart);
 
 	/* Now combine the two viewlists into one */
 	ISC_LIST_APPENDLIST(viewlist, builtin_viewlist, link);
@@ -9394,6 +10114,18 @@ load_configuration(const char *filename, named_server_t *server,
 		view->viewlist = &server->viewlist;
 		view = ISC_LIST_NEXT(view, link);
 	}
+	update_matchviews(server);
+
+	/* Only time queries if some view counts query latency */
+	ns_server_setoption(server->sctx, NS_SERVER_LATENCYSTATS, false);
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		if (view->latencystats != NULL) {
+			ns_server_setoption(server->sctx,
+					    NS_SERVER_LATENCYSTATS, true);
+		}
+	}
 
 	/* Swap our new cache list with the production one. */
 	tmpcachelist = server->cachelist;
@@ -9564,6 +10296,11 @@ load_configuration(const char *filename, named_server_t *server,
 		}
 	}
 
+	obj = NULL;
+	result = named_config_get(maps, "memory-sample-interval", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_mem_setsamplerate(ISC_MIN(cfg_obj_asuint64(obj), SIZE_MAX));
+
 	obj = NULL;
 	if (options != NULL &&
 	    cfg_map_get(options, "memstatistics", &obj) == ISC_R_SUCCESS)
@@ -9650,6 +10387,11 @@ load_configuration(const char *filename, named_server_t *server,
 		server->flushonshutdown = false;
 	}
 
+	obj = NULL;
+	result = named_config_get(maps, "lazy-load-zones", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	server->lazyload = cfg_obj_asboolean(obj);
+
 	obj = NULL;
 	result = named_config_get(maps, "answer-cookie", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -9859,6 +10601,90 @@ cleanup:
 	return (result);
 }
 
+static const char *startupphase_names[named_startup_max] = {
+	[named_startup_parse] = "parse",
+	[named_startup_interfaces] = "interfaces",
+	[named_startup_views] = "views",
+	[named_startup_keys] = "keys",
+	[named_startup_policyzones] = "policy-zones",
+	[named_startup_zones] = "zones",
+	[named_startup_total] = "total",
+};
+
+const char *
+named_server_startupphasename(named_startupphase_t phase) {
+	REQUIRE(phase < named_startup_max);
+
+	return (startupphase_names[phase]);
+}
+
+bool
+named_server_startuptimes(named_server_t *server,
+			  uint64_t times[named_startup_max]) {
+	REQUIRE(NAMED_SERVER_VALID(server));
+
+	if (atomic_load(&server->timing) ||
+	    server->startuptimes[named_startup_total] == 0)
+	{
+		return (false);
+	}
+
+	memmove(times, server->startuptimes, sizeof(server->startuptimes));
+	return (true);
+}
+
+/*
+ * Log how long each phase of startup took, once all zones are loaded.
+ */
+static void
+startup_done(named_server_t *server) {
+	char buf[512];
+	int n = 0;
+
+	if (!atomic_load(&server->timing)) {
+		return;
+	}
+
+	startup_phase_done(named_startup_zones, &server->zoneloadstart);
+	startup_phase_done(named_startup_total, &named_g_boottime);
+
+	for (size_t i = 0; i < named_startup_max; i++) {
+		n += snprintf(buf + n, sizeof(buf) - n, "%s%s %" PRIu64 " ms",
+			      i == 0 ? "" : ", ", startupphase_names[i],
+			      server->startuptimes[i] / 1000);
+	}
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO, "startup times: %s",
+		      buf);
+
+	atomic_store(&server->timing, false);
+}
+
+/*
+ * Tell the parent process, if any, that startup is complete.
+ */
+static void
+server_started(named_server_t *server) {
+	bool expected = false;
+
+	if (!atomic_compare_exchange_strong(&server->started, &expected,
+					    true))
+	{
+		return;
+	}
+
+	named_os_started();
+
+#ifdef HAVE_FIPS_MODE
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, ISC_LOG_NOTICE, "FIPS mode is %s",
+		      FIPS_mode() ? "enabled" : "disabled");
+#endif /* ifdef HAVE_FIPS_MODE */
+
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, ISC_LOG_NOTICE, "running");
+}
+
 static isc_result_t
 view_loaded(void *arg) {
 	isc_result_t result;
@@ -9894,6 +10720,7 @@ view_loaded(void *arg) {
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_NOTICE,
 				      "all zones loaded");
+			startup_done(server);
 		}
 
 		for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
@@ -9916,24 +10743,17 @@ view_loaded(void *arg) {
 						isc_result_totext(result));
 				}
 			}
+			if (!reconfig && view->resolver != NULL) {
+				dns_resolver_primenames(view->resolver);
+			}
 		}
 
 		CHECKFATAL(dns_zonemgr_forcemaint(server->zonemgr),
 			   "forcing zone maintenance");
 
-		named_os_started();
-
-#ifdef HAVE_FIPS_MODE
-		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
-			      NAMED_LOGMODULE_SERVER, ISC_LOG_NOTICE,
-			      "FIPS mode is %s",
-			      FIPS_mode() ? "enabled" : "disabled");
-#endif /* ifdef HAVE_FIPS_MODE */
 		atomic_store(&server->reload_status, NAMED_RELOAD_DONE);
 
-		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
-			      NAMED_LOGMODULE_SERVER, ISC_LOG_NOTICE,
-			      "running");
+		server_started(server);
 	}
 
 	return (ISC_R_SUCCESS);
@@ -9946,6 +10766,10 @@ load_zones(named_server_t *server, bool init, bool reconfig) {
 	ns_zoneload_t *zl = NULL;
 	dns_view_t *view = NULL;
 
+	if (init) {
+		TIME_NOW(&server->zoneloadstart);
+	}
+
 	zl = isc_mem_get(server->mctx, sizeof(*zl));
 	zl->server = server;
 	zl->reconfig = reconfig;
@@ -9998,7 +10822,20 @@ cleanup:
 		isc_mem_put(server->mctx, zl, sizeof(*zl));
 	}
 
-	if (init) {
+	if (init && server->lazyload) {
+		/*
+		 * With lazy-load-zones the zones are left to load in the
+		 * background; queries for those that are not yet loaded
+		 * get SERVFAIL in the meantime.
+		 */
+		isc_task_endexclusive(server->task);
+		if (result == ISC_R_SUCCESS) {
+			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_NOTICE,
+				      "zones are loading in the background");
+			server_started(server);
+		}
+	} else if (init) {
 		/*
 		 * If we're setting up the server for the first time, set
 		 * the task manager into privileged mode; this ensures
@@ -10072,6 +10909,12 @@ run_server(isc_task_t *task, isc_event_t *event) {
 				    server, &server->pps_timer),
 		   "creating pps timer");
 
+	CHECKFATAL(isc_timer_create(named_g_timermgr, isc_timertype_inactive,
+				    NULL, NULL, server->task,
+				    serverstate_timer_tick, server,
+				    &server->serverstate_timer),
+		   "creating server state timer");
+
 	CHECKFATAL(
 		cfg_parser_create(named_g_mctx, named_g_lctx, &named_g_parser),
 		"creating default configuration parser");
@@ -10080,6 +10923,7 @@ run_server(isc_task_t *task, isc_event_t *event) {
 				     &named_g_addparser),
 		   "creating additional configuration parser");
 
+	atomic_store(&server->timing, true);
 	CHECKFATAL(load_configuration(named_g_conffile, server, true),
 		   "loading configuration");
 
@@ -10135,6 +10979,7 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 	cfg_parser_destroy(&named_g_addparser);
 
 	(void)named_server_saventa(server);
+	save_serverstate(server);
 
 	for (kasp = ISC_LIST_HEAD(server->kasplist); kasp != NULL;
 	     kasp = kasp_next)
@@ -10155,6 +11000,7 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 			dns_view_detach(&view);
 		}
 	}
+	update_matchviews(server);
 
 	/*
 	 * Shut down all dyndb instances.
@@ -10171,6 +11017,7 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 	isc_timer_destroy(&server->heartbeat_timer);
 	isc_timer_destroy(&server->pps_timer);
 	isc_timer_destroy(&server->tat_timer);
+	isc_timer_destroy(&server->serverstate_timer);
 
 	ns_interfacemgr_detach(&server->interfacemgr);
 
@@ -10195,64 +11042,261 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 	isc_event_free(&event);
 }
 
+static bool
+acl_isany(dns_acl_t *acl) {
+	return (acl == NULL || dns_acl_isany(acl));
+}
+
+static void
+free_viewindex(named_server_t *server) {
+	if (server->indexviews != NULL) {
+		isc_mem_put(server->mctx, server->indexviews,
+			    server->nindexviews * sizeof(dns_view_t *));
+		server->nindexviews = 0;
+	}
+	if (server->clientindex != NULL) {
+		dns_aclindex_destroy(&server->clientindex);
+	}
+	if (server->destindex != NULL) {
+		dns_aclindex_destroy(&server->destindex);
+	}
+}
+
 /*%
- * Find a view that matches the source and destination addresses of a query.
+ * Index the "match-clients" and "match-destinations" ACLs of all views,
+ * so that the views a query's addresses may match are found with two
+ * radix tree searches instead of evaluating the ACLs of each view in
+ * turn.
  */
-static isc_result_t
-get_matching_view(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
-		  dns_message_t *message, dns_aclenv_t *env,
-		  isc_result_t *sigresult, dns_view_t **viewp) {
+static void
+build_viewindex(named_server_t *server) {
+	dns_acl_t **clients = NULL, **destinations = NULL;
+	unsigned int nviews = 0, i;
+	size_t size;
 	dns_view_t *view;
+	isc_result_t result;
 
-	REQUIRE(message != NULL);
-	REQUIRE(sigresult != NULL);
-	REQUIRE(viewp != NULL && *viewp == NULL);
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		nviews++;
+	}
+	if (nviews == 0) {
+		return;
+	}
 
-	for (view = ISC_LIST_HEAD(named_g_server->viewlist); view != NULL;
+	server->indexviews = isc_mem_get(server->mctx,
+					 nviews * sizeof(dns_view_t *));
+	server->nindexviews = nviews;
+	size = nviews * sizeof(dns_acl_t *);
+	clients = isc_mem_get(server->mctx, size);
+	destinations = isc_mem_get(server->mctx, size);
+
+	i = 0;
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
 	     view = ISC_LIST_NEXT(view, link))
 	{
-		if (message->rdclass == view->rdclass ||
-		    message->rdclass == dns_rdataclass_any)
-		{
-			const dns_name_t *tsig = NULL;
+		server->indexviews[i] = view;
+		clients[i] = view->matchclients;
+		destinations[i] = view->matchdestinations;
+		i++;
+	}
+
+	result = dns_aclindex_create(server->mctx, clients, nviews,
+				     &server->clientindex);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_aclindex_create(server->mctx, destinations,
+					     nviews, &server->destindex);
+	}
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_WARNING,
+			      "unable to index view ACLs: %s",
+			      isc_result_totext(result));
+		free_viewindex(server);
+	}
 
-			*sigresult = dns_message_rechecksig(message, view);
-			if (*sigresult == ISC_R_SUCCESS) {
-				dns_tsigkey_t *tsigkey;
+	isc_mem_put(server->mctx, clients, size);
+	isc_mem_put(server->mctx, destinations, size);
+}
 
-				tsigkey = message->tsigkey;
-				tsig = dns_tsigkey_identity(tsigkey);
-			}
+/*%
+ * Rebuild the tables used to find the view of a query: the view index,
+ * and the views that match every unsigned query of their class (the
+ * first view of a class, if it matches any client and any destination
+ * and is not "match-recursive-only").  Must be called whenever
+ * server->viewlist changes.
+ */
+static void
+update_matchviews(named_server_t *server) {
+	dns_rdataclass_t seen[NAMED_MATCHVIEWS];
+	unsigned int nseen = 0, i;
+	dns_view_t *view;
 
-			if (dns_acl_allowed(srcaddr, tsig, view->matchclients,
-					    env) &&
-			    dns_acl_allowed(destaddr, tsig,
-					    view->matchdestinations, env) &&
-			    !(view->matchrecursiveonly &&
-			      (message->flags & DNS_MESSAGEFLAG_RD) == 0))
-			{
-				dns_view_attach(view, viewp);
-				return (ISC_R_SUCCESS);
+	server->nmatchviews = 0;
+	free_viewindex(server);
+	build_viewindex(server);
+
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		for (i = 0; i < nseen; i++) {
+			if (seen[i] == view->rdclass) {
+				break;
 			}
 		}
-	}
+		if (i < nseen) {
+			continue;
+		}
+		if (nseen == NAMED_MATCHVIEWS) {
+			break;
+		}
+		seen[nseen++] = view->rdclass;
 
-	return (ISC_R_NOTFOUND);
+		if (acl_isany(view->matchclients) &&
+		    acl_isany(view->matchdestinations) &&
+		    !view->matchrecursiveonly)
+		{
+			server->matchviews[server->nmatchviews++] =
+				(named_matchview_t){ .rdclass = view->rdclass,
+						     .view = view };
+		}
+	}
 }
 
-void
-named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
-	isc_result_t result;
-	named_server_t *server = isc_mem_get(mctx, sizeof(*server));
+/*%
+ * Check whether 'view' is the one that should answer 'message'.  The
+ * "match-clients" and "match-destinations" ACLs are only evaluated when
+ * 'checkclients' and 'checkdestinations' are true respectively; the
+ * caller has otherwise established that they allow the query.
+ */
+static bool
+view_matches(dns_view_t *view, isc_netaddr_t *srcaddr,
+	     isc_netaddr_t *destaddr, dns_message_t *message,
+	     dns_aclenv_t *env, bool checkclients, bool checkdestinations,
+	     isc_result_t *sigresult) {
+	const dns_name_t *tsig = NULL;
+
+	if (message->rdclass != view->rdclass &&
+	    message->rdclass != dns_rdataclass_any)
+	{
+		return (false);
+	}
 
-	*server = (named_server_t){
-		.mctx = mctx,
-		.statsfile = isc_mem_strdup(mctx, "named.stats"),
-		.bindkeysfile = isc_mem_strdup(mctx, named_g_defaultbindkeys),
-		.dumpfile = isc_mem_strdup(mctx, "named_dump.db"),
-		.secrootsfile = isc_mem_strdup(mctx, "named.secroots"),
-		.recfile = isc_mem_strdup(mctx, "named.recursing"),
-	};
+	*sigresult = dns_message_rechecksig(message, view);
+	if (*sigresult == ISC_R_SUCCESS) {
+		dns_tsigkey_t *tsigkey;
+
+		tsigkey = message->tsigkey;
+		tsig = dns_tsigkey_identity(tsigkey);
+	}
+
+	return ((!checkclients ||
+		 dns_acl_allowed(srcaddr, tsig, view->matchclients, env)) &&
+		(!checkdestinations ||
+		 dns_acl_allowed(destaddr, tsig, view->matchdestinations,
+				 env)) &&
+		!(view->matchrecursiveonly &&
+		  (message->flags & DNS_MESSAGEFLAG_RD) == 0));
+}
+
+/*%
+ * Find a view that matches the source and destination addresses of a query.
+ */
+static isc_result_t
+get_matching_view(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
+		  dns_message_t *message, dns_aclenv_t *env,
+		  isc_result_t *sigresult, dns_view_t **viewp) {
+	named_server_t *server = named_g_server;
+	dns_view_t *view;
+	unsigned int i;
+
+	REQUIRE(message != NULL);
+	REQUIRE(sigresult != NULL);
+	REQUIRE(viewp != NULL && *viewp == NULL);
+
+	/*
+	 * An unsigned query goes to the first view of its class if that
+	 * view matches everything; there is no signature to check
+	 * against each view nor a key identity to match ACLs with.
+	 */
+	if (dns_message_gettsig(message, NULL) == NULL &&
+	    dns_message_getsig0(message, NULL) == NULL)
+	{
+		for (i = 0; i < server->nmatchviews; i++) {
+			if (server->matchviews[i].rdclass == message->rdclass) {
+				view = server->matchviews[i].view;
+				*sigresult = ISC_R_SUCCESS;
+				dns_view_attach(view, viewp);
+				return (ISC_R_SUCCESS);
+			}
+		}
+	}
+
+	/*
+	 * Otherwise only consider the views whose ACLs may match the
+	 * query's addresses, and only evaluate those ACLs that the index
+	 * could not decide.  This also saves verifying the signature
+	 * with the keys of views that could not match anyway.
+	 */
+	if (server->clientindex != NULL) {
+		const uint64_t *clients = NULL, *destinations = NULL;
+
+		clients = dns_aclindex_find(server->clientindex, srcaddr, env);
+		destinations = dns_aclindex_find(server->destindex, destaddr,
+						 env);
+
+		for (i = 0; i < server->nindexviews; i++) {
+			uint64_t bit = UINT64_C(1) << (i % 64);
+
+			if ((clients[i / 64] & destinations[i / 64] & bit) == 0)
+			{
+				continue;
+			}
+
+			view = server->indexviews[i];
+			if (view_matches(
+				    view, srcaddr, destaddr, message, env,
+				    !dns_aclindex_isexact(server->clientindex,
+							  i),
+				    !dns_aclindex_isexact(server->destindex, i),
+				    sigresult))
+			{
+				dns_view_attach(view, viewp);
+				return (ISC_R_SUCCESS);
+			}
+		}
+
+		return (ISC_R_NOTFOUND);
+	}
+
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		if (view_matches(view, srcaddr, destaddr, message, env, true,
+				 true, sigresult))
+		{
+			dns_view_attach(view, viewp);
+			return (ISC_R_SUCCESS);
+		}
+	}
+
+	return (ISC_R_NOTFOUND);
+}
+
+void
+named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
+	isc_result_t result;
+	named_server_t *server = isc_mem_get(mctx, sizeof(*server));
+
+	*server = (named_server_t){
+		.mctx = mctx,
+		.statsfile = isc_mem_strdup(mctx, "named.stats"),
+		.bindkeysfile = isc_mem_strdup(mctx, named_g_defaultbindkeys),
+		.dumpfile = isc_mem_strdup(mctx, "named_dump.db"),
+		.secrootsfile = isc_mem_strdup(mctx, "named.secroots"),
+		.recfile = isc_mem_strdup(mctx, "named.recursing"),
+	};
 
 #ifdef USE_DNSRPS
 	CHECKFATAL(dns_dnsrps_server_create(), "initializing RPZ service "
@@ -10272,6 +11316,8 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 		   "setting up root hints");
 
 	atomic_init(&server->reload_status, NAMED_RELOAD_IN_PROGRESS);
+	atomic_init(&server->started, false);
+	atomic_init(&server->timing, false);
 
 	/*
 	 * Setup the server task, which is responsible for coordinating
@@ -10286,6 +11332,12 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 	CHECKFATAL(ns_server_create(mctx, get_matching_view, &server->sctx),
 		   "creating server context");
 
+	/*
+	 * The TCP client quota is reserved and released by all the
+	 * network threads.
+	 */
+	isc_quota_slice(&server->sctx->tcpquota, mctx, named_g_cpus);
+
 #if defined(HAVE_GEOIP2)
 	/*
 	 * GeoIP must be initialized before the interface
@@ -10335,6 +11387,9 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 
 	ISC_LIST_INIT(server->cachelist);
 
+	isc_mutex_init(&server->catzlock);
+	ISC_LIST_INIT(server->catzchanges);
+
 	server->magic = NAMED_SERVER_MAGIC;
 
 	*serverp = server;
@@ -10390,6 +11445,8 @@ named_server_destroy(named_server_t **serverp) {
 	INSIST(ISC_LIST_EMPTY(server->kasplist));
 	INSIST(ISC_LIST_EMPTY(server->viewlist));
 	INSIST(ISC_LIST_EMPTY(server->cachelist));
+	INSIST(ISC_LIST_EMPTY(server->catzchanges));
+	isc_mutex_destroy(&server->catzlock);
 
 	if (server->tlsctx_server_cache != NULL) {
 		isc_tlsctx_cache_detach(&server->tlsctx_server_cache);
@@ -12220,6 +13277,62 @@ named_server_flushcache(named_server_t *server, isc_lex_t *lex) {
 	return (result);
 }
 
+isc_result_t
+named_server_flushdlz(named_server_t *server, isc_lex_t *lex) {
+	char *ptr;
+	dns_view_t *view;
+	dns_dlzdb_t *dlzdb;
+	bool found = false;
+	isc_result_t result;
+
+	/* Skip the command name. */
+	ptr = next_token(lex, NULL);
+	if (ptr == NULL) {
+		return (ISC_R_UNEXPECTEDEND);
+	}
+
+	/* Look for the view name. */
+	ptr = next_token(lex, NULL);
+
+	result = isc_task_beginexclusive(server->task);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		if (ptr != NULL && strcasecmp(ptr, view->name) != 0) {
+			continue;
+		}
+		found = true;
+		for (dlzdb = ISC_LIST_HEAD(view->dlz_searched); dlzdb != NULL;
+		     dlzdb = ISC_LIST_NEXT(dlzdb, link))
+		{
+			dns_dlz_flushcache(dlzdb);
+		}
+		for (dlzdb = ISC_LIST_HEAD(view->dlz_unsearched);
+		     dlzdb != NULL; dlzdb = ISC_LIST_NEXT(dlzdb, link))
+		{
+			dns_dlz_flushcache(dlzdb);
+		}
+	}
+	isc_task_endexclusive(server->task);
+
+	if (!found) {
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "flushing DLZ caches in view '%s' failed: "
+			      "view not found",
+			      ptr);
+		return (ISC_R_NOTFOUND);
+	}
+
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+		      "flushing DLZ caches in %s%s%s succeeded",
+		      ptr != NULL ? "view '" : "all views",
+		      ptr != NULL ? ptr : "", ptr != NULL ? "'" : "");
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 named_server_flushnode(named_server_t *server, isc_lex_t *lex, bool tree) {
 	char *ptr, *viewname;
@@ -12256,8 +13369,11 @@ named_server_flushnode(named_server_t *server, isc_lex_t *lex, bool tree) {
 	/* Look for the view name. */
 	viewname = next_token(lex, NULL);
 
-	result = isc_task_beginexclusive(server->task);
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	/*
+	 * The ADB, bad caches and cache database all do their own locking,
+	 * and the view list only changes on the server task, so there is
+	 * no need to stop query processing while flushing.
+	 */
 	flushed = true;
 	found = false;
 	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
@@ -12308,7 +13424,6 @@ named_server_flushnode(named_server_t *server, isc_lex_t *lex, bool tree) {
 		}
 		result = ISC_R_FAILURE;
 	}
-	isc_task_endexclusive(server->task);
 	return (result);
 }
 
@@ -12481,58 +13596,32 @@ delete_keynames(dns_tsig_keyring_t *ring, char *target,
 		unsigned int *foundkeys) {
 	char namestr[DNS_NAME_FORMATSIZE];
 	isc_result_t result;
-	dns_rbtnodechain_t chain;
-	dns_name_t foundname;
-	dns_fixedname_t fixedorigin;
-	dns_name_t *origin;
-	dns_rbtnode_t *node;
-	dns_tsigkey_t *tkey;
-
-	dns_name_init(&foundname, NULL);
-	origin = dns_fixedname_initname(&fixedorigin);
-
-again:
-	dns_rbtnodechain_init(&chain);
-	result = dns_rbtnodechain_first(&chain, ring->keys, &foundname, origin);
-	if (result == ISC_R_NOTFOUND) {
-		dns_rbtnodechain_invalidate(&chain);
-		return (ISC_R_SUCCESS);
-	}
-	if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-		dns_rbtnodechain_invalidate(&chain);
-		return (result);
-	}
+	isc_ht_iter_t *it = NULL;
 
-	for (;;) {
-		node = NULL;
-		dns_rbtnodechain_current(&chain, &foundname, origin, &node);
-		tkey = node->data;
-
-		if (tkey != NULL) {
-			if (!tkey->generated) {
-				goto nextkey;
-			}
+	isc_ht_iter_create(ring->keys, &it);
+	result = isc_ht_iter_first(it);
+	while (result == ISC_R_SUCCESS) {
+		dns_tsigkey_t *tkey = NULL;
 
-			dns_name_format(&tkey->name, namestr, sizeof(namestr));
-			if (strcmp(namestr, target) == 0) {
-				(*foundkeys)++;
-				dns_rbtnodechain_invalidate(&chain);
-				(void)dns_rbt_deletename(ring->keys,
-							 &tkey->name, false);
-				goto again;
-			}
+		isc_ht_iter_current(it, (void **)&tkey);
+		if (!tkey->generated) {
+			result = isc_ht_iter_next(it);
+			continue;
 		}
 
-	nextkey:
-		result = dns_rbtnodechain_next(&chain, &foundname, origin);
-		if (result == ISC_R_NOMORE) {
-			break;
-		}
-		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-			dns_rbtnodechain_invalidate(&chain);
-			return (result);
+		dns_name_format(&tkey->name, namestr, sizeof(namestr));
+		if (strcmp(namestr, target) != 0) {
+			result = isc_ht_iter_next(it);
+			continue;
 		}
+
+		(*foundkeys)++;
+		ISC_LIST_UNLINK(ring->lru, tkey, link);
+		ring->generated--;
+		result = isc_ht_iter_delcurrent_next(it);
+		dns_tsigkey_detach(&tkey);
 	}
+	isc_ht_iter_destroy(&it);
 
 	return (ISC_R_SUCCESS);
 }
@@ -12559,8 +13648,7 @@ named_server_tsigdelete(named_server_t *server, isc_lex_t *lex,
 
 	viewname = next_token(lex, text);
 
-	result = isc_task_beginexclusive(server->task);
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	/* The key rings are protected by their own locks. */
 	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
 	     view = ISC_LIST_NEXT(view, link))
 	{
@@ -12571,12 +13659,10 @@ named_server_tsigdelete(named_server_t *server, isc_lex_t *lex,
 			RWUNLOCK(&view->dynamickeys->lock,
 				 isc_rwlocktype_write);
 			if (result != ISC_R_SUCCESS) {
-				isc_task_endexclusive(server->task);
 				return (result);
 			}
 		}
 	}
-	isc_task_endexclusive(server->task);
 
 	snprintf(fbuf, sizeof(fbuf), "%u", foundkeys);
 
@@ -12594,12 +13680,7 @@ list_keynames(dns_view_t *view, dns_tsig_keyring_t *ring, isc_buffer_t **text,
 	char namestr[DNS_NAME_FORMATSIZE];
 	char creatorstr[DNS_NAME_FORMATSIZE];
 	isc_result_t result;
-	dns_rbtnodechain_t chain;
-	dns_name_t foundname;
-	dns_fixedname_t fixedorigin;
-	dns_name_t *origin;
-	dns_rbtnode_t *node;
-	dns_tsigkey_t *tkey;
+	isc_ht_iter_t *it = NULL;
 	const char *viewname;
 
 	if (view != NULL) {
@@ -12608,62 +13689,43 @@ list_keynames(dns_view_t *view, dns_tsig_keyring_t *ring, isc_buffer_t **text,
 		viewname = "(global)";
 	}
 
-	dns_name_init(&foundname, NULL);
-	origin = dns_fixedname_initname(&fixedorigin);
-	dns_rbtnodechain_init(&chain);
-	result = dns_rbtnodechain_first(&chain, ring->keys, &foundname, origin);
-	if (result == ISC_R_NOTFOUND) {
-		dns_rbtnodechain_invalidate(&chain);
-		return (ISC_R_SUCCESS);
-	}
-	if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-		dns_rbtnodechain_invalidate(&chain);
-		return (result);
-	}
-
-	for (;;) {
-		node = NULL;
-		dns_rbtnodechain_current(&chain, &foundname, origin, &node);
-		tkey = node->data;
-
-		if (tkey != NULL) {
-			dns_name_format(&tkey->name, namestr, sizeof(namestr));
-			if (tkey->generated) {
-				dns_name_format(tkey->creator, creatorstr,
-						sizeof(creatorstr));
-				if (*foundkeys != 0) {
-					CHECK(putstr(text, "\n"));
-				}
-				CHECK(putstr(text, "view \""));
-				CHECK(putstr(text, viewname));
-				CHECK(putstr(text, "\"; type \"dynamic\"; key "
-						   "\""));
-				CHECK(putstr(text, namestr));
-				CHECK(putstr(text, "\"; creator \""));
-				CHECK(putstr(text, creatorstr));
-				CHECK(putstr(text, "\";"));
-			} else {
-				if (*foundkeys != 0) {
-					CHECK(putstr(text, "\n"));
-				}
-				CHECK(putstr(text, "view \""));
-				CHECK(putstr(text, viewname));
-				CHECK(putstr(text, "\"; type \"static\"; key "
-						   "\""));
-				CHECK(putstr(text, namestr));
-				CHECK(putstr(text, "\";"));
+	isc_ht_iter_create(ring->keys, &it);
+	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(it))
+	{
+		dns_tsigkey_t *tkey = NULL;
+
+		isc_ht_iter_current(it, (void **)&tkey);
+		dns_name_format(&tkey->name, namestr, sizeof(namestr));
+		if (tkey->generated) {
+			dns_name_format(tkey->creator, creatorstr,
+					sizeof(creatorstr));
+			if (*foundkeys != 0) {
+				CHECK(putstr(text, "\n"));
 			}
-			(*foundkeys)++;
-		}
-		result = dns_rbtnodechain_next(&chain, &foundname, origin);
-		if (result == ISC_R_NOMORE || result == DNS_R_NEWORIGIN) {
-			break;
+			CHECK(putstr(text, "view \""));
+			CHECK(putstr(text, viewname));
+			CHECK(putstr(text, "\"; type \"dynamic\"; key \""));
+			CHECK(putstr(text, namestr));
+			CHECK(putstr(text, "\"; creator \""));
+			CHECK(putstr(text, creatorstr));
+			CHECK(putstr(text, "\";"));
+		} else {
+			if (*foundkeys != 0) {
+				CHECK(putstr(text, "\n"));
+			}
+			CHECK(putstr(text, "view \""));
+			CHECK(putstr(text, viewname));
+			CHECK(putstr(text, "\"; type \"static\"; key \""));
+			CHECK(putstr(text, namestr));
+			CHECK(putstr(text, "\";"));
 		}
+		(*foundkeys)++;
 	}
+	result = ISC_R_SUCCESS;
 
-	return (ISC_R_SUCCESS);
 cleanup:
-	dns_rbtnodechain_invalidate(&chain);
+	isc_ht_iter_destroy(&it);
 	return (result);
 }
 
@@ -13175,13 +14237,17 @@ dumpzone(void *arg, const char *buf, int len) {
 	}
 }
 
+/*
+ * Store 'zconfig' as the configuration of 'zone' in the NZD database, or
+ * delete the zone if 'zconfig' is NULL, as part of transaction 'txn'.
+ * '*changedp' is set to true if the database was modified.
+ */
 static isc_result_t
-nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
-	 const cfg_obj_t *zconfig) {
+nzd_put(MDB_txn *txn, MDB_dbi dbi, dns_zone_t *zone, const cfg_obj_t *zconfig,
+	bool *changedp) {
 	isc_result_t result;
 	int status;
 	dns_view_t *view;
-	bool commit = false;
 	isc_buffer_t *text = NULL;
 	char namebuf[1024];
 	MDB_val key, data;
@@ -13193,7 +14259,7 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 
 	if (zconfig == NULL) {
 		/* We're deleting the zone from the database */
-		status = mdb_del(*txnp, dbi, &key, NULL);
+		status = mdb_del(txn, dbi, &key, NULL);
 		if (status != MDB_SUCCESS && status != MDB_NOTFOUND) {
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
@@ -13203,7 +14269,7 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 			result = ISC_R_FAILURE;
 			goto cleanup;
 		} else if (status != MDB_NOTFOUND) {
-			commit = true;
+			*changedp = true;
 		}
 	} else {
 		/* We're creating or overwriting the zone */
@@ -13238,7 +14304,7 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 		data.mv_data = isc_buffer_base(text);
 		data.mv_size = isc_buffer_usedlength(text);
 
-		status = mdb_put(*txnp, dbi, &key, &data, 0);
+		status = mdb_put(txn, dbi, &key, &data, 0);
 		if (status != MDB_SUCCESS) {
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
@@ -13249,12 +14315,27 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 			goto cleanup;
 		}
 
-		commit = true;
+		*changedp = true;
 	}
 
 	result = ISC_R_SUCCESS;
 
 cleanup:
+	if (text != NULL) {
+		isc_buffer_free(&text);
+	}
+
+	return (result);
+}
+
+static isc_result_t
+nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
+	 const cfg_obj_t *zconfig) {
+	isc_result_t result;
+	int status;
+	bool commit = false;
+
+	result = nzd_put(*txnp, dbi, zone, zconfig, &commit);
 	if (!commit || result != ISC_R_SUCCESS) {
 		(void)mdb_txn_abort(*txnp);
 	} else {
@@ -13270,10 +14351,6 @@ cleanup:
 	}
 	*txnp = NULL;
 
-	if (text != NULL) {
-		isc_buffer_free(&text);
-	}
-
 	return (result);
 }
 
@@ -13677,56 +14754,20 @@ cleanup:
 
 #endif /* HAVE_LMDB */
 
+/*
+ * Check that 'zoneobj' can be added or modified by command 'bn', and look
+ * up the view it is for.
+ */
 static isc_result_t
-newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
-	      cfg_obj_t **zoneconfp, const cfg_obj_t **zoneobjp,
-	      bool *redirectp, isc_buffer_t **text) {
+newzone_check(named_server_t *server, const char *bn,
+	      const cfg_obj_t *zoneobj, dns_view_t **viewp, bool *redirectp,
+	      isc_buffer_t **text) {
 	isc_result_t result;
-	isc_buffer_t argbuf;
 	bool redirect = false;
-	cfg_obj_t *zoneconf = NULL;
-	const cfg_obj_t *zlist = NULL;
-	const cfg_obj_t *zoneobj = NULL;
 	const cfg_obj_t *zoptions = NULL;
 	const cfg_obj_t *obj = NULL;
 	const char *viewname = NULL;
 	dns_rdataclass_t rdclass;
-	dns_view_t *view = NULL;
-	const char *bn = NULL;
-
-	REQUIRE(viewp != NULL && *viewp == NULL);
-	REQUIRE(zoneobjp != NULL && *zoneobjp == NULL);
-	REQUIRE(zoneconfp != NULL && *zoneconfp == NULL);
-	REQUIRE(redirectp != NULL);
-
-	/* Try to parse the argument string */
-	isc_buffer_init(&argbuf, command, (unsigned int)strlen(command));
-	isc_buffer_add(&argbuf, strlen(command));
-
-	if (strncasecmp(command, "add", 3) == 0) {
-		bn = "addzone";
-	} else if (strncasecmp(command, "mod", 3) == 0) {
-		bn = "modzone";
-	} else {
-		UNREACHABLE();
-	}
-
-	/*
-	 * Convert the "addzone" or "modzone" to just "zone", for
-	 * the benefit of the parser
-	 */
-	isc_buffer_forward(&argbuf, 3);
-
-	cfg_parser_reset(named_g_addparser);
-	CHECK(cfg_parse_buffer(named_g_addparser, &argbuf, bn, 0,
-			       &cfg_type_addzoneconf, 0, &zoneconf));
-	CHECK(cfg_map_get(zoneconf, "zone", &zlist));
-	if (!cfg_obj_islist(zlist)) {
-		CHECK(ISC_R_FAILURE);
-	}
-
-	/* For now we only support adding one zone at a time */
-	zoneobj = cfg_listelt_value(cfg_list_first(zlist));
 
 	/* Check the zone type for ones that are not supported by addzone. */
 	zoptions = cfg_tuple_get(zoneobj, "options");
@@ -13771,18 +14812,104 @@ newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
 	if (viewname == NULL || *viewname == '\0') {
 		viewname = "_default";
 	}
-	result = dns_viewlist_find(&server->viewlist, viewname, rdclass, &view);
+	result = dns_viewlist_find(&server->viewlist, viewname, rdclass, viewp);
 	if (result == ISC_R_NOTFOUND) {
 		(void)putstr(text, "no matching view found for '");
 		(void)putstr(text, viewname);
 		(void)putstr(text, "'");
 		goto cleanup;
-	} else if (result != ISC_R_SUCCESS) {
-		goto cleanup;
+	}
+
+	*redirectp = redirect;
+
+cleanup:
+	return (result);
+}
+
+static isc_result_t
+newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
+	      cfg_obj_t **zoneconfp, const cfg_obj_t **zoneobjp,
+	      bool *redirectp, isc_buffer_t **text) {
+	isc_result_t result;
+	isc_buffer_t argbuf;
+	bool redirect = false;
+	cfg_obj_t *zoneconf = NULL;
+	const cfg_obj_t *zlist = NULL;
+	const cfg_listelt_t *elt = NULL;
+	dns_view_t *view = NULL;
+	const char *bn = NULL;
+	unsigned int nzones;
+
+	REQUIRE(viewp != NULL && *viewp == NULL);
+	REQUIRE(zoneobjp != NULL && *zoneobjp == NULL);
+	REQUIRE(zoneconfp != NULL && *zoneconfp == NULL);
+	REQUIRE(redirectp != NULL);
+
+	/* Try to parse the argument string */
+	isc_buffer_init(&argbuf, command, (unsigned int)strlen(command));
+	isc_buffer_add(&argbuf, strlen(command));
+
+	if (strncasecmp(command, "add", 3) == 0) {
+		bn = "addzone";
+	} else if (strncasecmp(command, "mod", 3) == 0) {
+		bn = "modzone";
+	} else {
+		UNREACHABLE();
+	}
+
+	/*
+	 * Convert the "addzone" or "modzone" to just "zone", for
+	 * the benefit of the parser
+	 */
+	isc_buffer_forward(&argbuf, 3);
+
+	cfg_parser_reset(named_g_addparser);
+	CHECK(cfg_parse_buffer(named_g_addparser, &argbuf, bn, 0,
+			       &cfg_type_addzoneconf, 0, &zoneconf));
+	CHECK(cfg_map_get(zoneconf, "zone", &zlist));
+	if (!cfg_obj_islist(zlist)) {
+		CHECK(ISC_R_FAILURE);
+	}
+
+	/*
+	 * addzone takes a batch of zones for a single view, modzone a
+	 * single zone.
+	 */
+	nzones = cfg_list_length(zlist, false);
+	if (nzones > 1 && strcmp(bn, "modzone") == 0) {
+		(void)putstr(text, "only one zone can be modified at a time");
+		CHECK(ISC_R_FAILURE);
+	}
+
+	for (elt = cfg_list_first(zlist); elt != NULL; elt = cfg_list_next(elt))
+	{
+		dns_view_t *zview = NULL;
+		bool zredirect = false;
+
+		CHECK(newzone_check(server, bn, cfg_listelt_value(elt), &zview,
+				    &zredirect, text));
+		if (view == NULL) {
+			view = zview;
+		} else {
+			bool same = (zview == view);
+
+			dns_view_detach(&zview);
+			if (!same) {
+				(void)putstr(text, "all zones added at once "
+						   "must be in the same view");
+				CHECK(ISC_R_FAILURE);
+			}
+		}
+		if (zredirect && nzones > 1) {
+			(void)putstr(text, "redirect zones must be added "
+					   "one at a time");
+			CHECK(ISC_R_FAILURE);
+		}
+		redirect = zredirect;
 	}
 
 	*viewp = view;
-	*zoneobjp = zoneobj;
+	*zoneobjp = cfg_listelt_value(cfg_list_first(zlist));
 	*zoneconfp = zoneconf;
 	*redirectp = redirect;
 
@@ -13859,43 +14986,89 @@ cleanup:
 	return (result);
 }
 
+typedef struct {
+	const cfg_obj_t *zoneobj;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dns_zone_t *zone;
+} ns_addzone_t;
+
+/*
+ * Add the zones in 'zoneconf' to 'view'.  A batch of zones is configured
+ * in a single exclusive-mode section and saved in one go; if any of them
+ * cannot be configured, loaded or saved, none of them are added.
+ */
 static isc_result_t
 do_addzone(named_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
-	   dns_name_t *name, cfg_obj_t *zoneconf, const cfg_obj_t *zoneobj,
-	   bool redirect, isc_buffer_t **text) {
+	   cfg_obj_t *zoneconf, bool redirect, isc_buffer_t **text) {
 	isc_result_t result, tresult;
-	dns_zone_t *zone = NULL;
+	const cfg_obj_t *zlist = NULL;
+	const cfg_listelt_t *elt = NULL;
+	ns_addzone_t *zones = NULL;
+	unsigned int nzones = 0, nconfigured = 0, i;
+	bool exclusive = false;
+	bool configured = true;
 #ifndef HAVE_LMDB
 	FILE *fp = NULL;
-	bool cleanup_config = false;
+	unsigned int nsaved = 0;
 #else /* HAVE_LMDB */
 	MDB_txn *txn = NULL;
 	MDB_dbi dbi;
 	bool locked = false;
+	bool changed = false;
+#endif /* HAVE_LMDB */
 
-	UNUSED(zoneconf);
-#endif
-
-	/* Zone shouldn't already exist */
-	if (redirect) {
-		result = (view->redirect != NULL) ? ISC_R_SUCCESS
-						  : ISC_R_NOTFOUND;
-	} else {
-		result = dns_zt_find(view->zonetable, name, 0, NULL, &zone);
+	CHECK(cfg_map_get(zoneconf, "zone", &zlist));
+	nzones = cfg_list_length(zlist, false);
+	zones = isc_mem_get(server->mctx, nzones * sizeof(zones[0]));
+	for (elt = cfg_list_first(zlist), i = 0; elt != NULL;
+	     elt = cfg_list_next(elt), i++)
+	{
+		zones[i] = (ns_addzone_t){ .zoneobj = cfg_listelt_value(elt) };
+		zones[i].name = dns_fixedname_initname(&zones[i].fname);
 	}
-	if (result == ISC_R_SUCCESS) {
-		result = ISC_R_EXISTS;
-		goto cleanup;
-	} else if (result == DNS_R_PARTIALMATCH) {
-		/* Create our sub-zone anyway */
-		dns_zone_detach(&zone);
-		zone = NULL;
-	} else if (result != ISC_R_NOTFOUND) {
-		goto cleanup;
+	for (i = 0; i < nzones; i++) {
+		const char *zonename = cfg_obj_asstring(
+			cfg_tuple_get(zones[i].zoneobj, "name"));
+		CHECK(dns_name_fromstring(zones[i].name, zonename, 0, NULL));
+	}
+
+	/* Zones shouldn't already exist */
+	for (i = 0; i < nzones; i++) {
+		dns_zone_t *zone = NULL;
+
+		if (redirect) {
+			result = (view->redirect != NULL) ? ISC_R_SUCCESS
+							  : ISC_R_NOTFOUND;
+		} else {
+			result = dns_zt_find(view->zonetable, zones[i].name, 0,
+					     NULL, &zone);
+		}
+		if (zone != NULL) {
+			dns_zone_detach(&zone);
+		}
+		if (result == ISC_R_SUCCESS) {
+			if (nzones > 1) {
+				char namebuf[DNS_NAME_FORMATSIZE];
+
+				dns_name_format(zones[i].name, namebuf,
+						sizeof(namebuf));
+				TCHECK(putstr(text, "zone '"));
+				TCHECK(putstr(text, namebuf));
+				TCHECK(putstr(text, "' already exists"));
+			}
+			CHECK(ISC_R_EXISTS);
+		} else if (result != ISC_R_NOTFOUND &&
+			   result != DNS_R_PARTIALMATCH)
+		{
+			/* A sub-zone of an existing zone can be added */
+			goto cleanup;
+		}
 	}
 
 	result = isc_task_beginexclusive(server->task);
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	exclusive = true;
 
 #ifndef HAVE_LMDB
 	/*
@@ -13903,7 +15076,6 @@ do_addzone(named_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
 	 */
 	result = isc_stdio_open(view->new_zone_file, "a", &fp);
 	if (result != ISC_R_SUCCESS) {
-		isc_task_endexclusive(server->task);
 		TCHECK(putstr(text, "unable to create '"));
 		TCHECK(putstr(text, view->new_zone_file));
 		TCHECK(putstr(text, "': "));
@@ -13919,7 +15091,6 @@ do_addzone(named_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
 	/* Make sure we can open the NZD database */
 	result = nzd_writable(view);
 	if (result != ISC_R_SUCCESS) {
-		isc_task_endexclusive(server->task);
 		TCHECK(putstr(text, "unable to open NZD database for '"));
 		TCHECK(putstr(text, view->new_zone_db));
 		TCHECK(putstr(text, "'"));
@@ -13928,103 +15099,147 @@ do_addzone(named_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
 	}
 #endif /* HAVE_LMDB */
 
-	/* Mark view unfrozen and configure zone */
+	/* Mark view unfrozen and configure zones */
 	dns_view_thaw(view);
-	result = configure_zone(cfg->config, zoneobj, cfg->vconfig,
-				server->mctx, view, &server->viewlist,
-				&server->kasplist, cfg->actx, true, false,
-				false);
+	for (i = 0; i < nzones; i++) {
+		result = configure_zone(cfg->config, zones[i].zoneobj,
+					cfg->vconfig, server->mctx, view,
+					&server->viewlist, &server->kasplist,
+					cfg->actx, true, false, false, NULL);
+		if (result != ISC_R_SUCCESS) {
+			configured = false;
+			break;
+		}
+		nconfigured++;
+	}
 	dns_view_freeze(view);
 
+	exclusive = false;
 	isc_task_endexclusive(server->task);
 
-	if (result != ISC_R_SUCCESS) {
-		TCHECK(putstr(text, "configure_zone failed: "));
-		TCHECK(putstr(text, isc_result_totext(result)));
-		goto cleanup;
-	}
-
-	/* Is it there yet? */
-	if (redirect) {
-		if (view->redirect == NULL) {
-			CHECK(ISC_R_NOTFOUND);
+	/* Are they there yet? */
+	for (i = 0; i < nconfigured; i++) {
+		if (redirect) {
+			if (view->redirect == NULL) {
+				tresult = ISC_R_NOTFOUND;
+			} else {
+				dns_zone_attach(view->redirect,
+						&zones[i].zone);
+				tresult = ISC_R_SUCCESS;
+			}
+		} else {
+			tresult = dns_zt_find(view->zonetable, zones[i].name,
+					      0, NULL, &zones[i].zone);
 		}
-		dns_zone_attach(view->redirect, &zone);
-	} else {
-		result = dns_zt_find(view->zonetable, name, 0, NULL, &zone);
-		if (result != ISC_R_SUCCESS) {
+		if (tresult != ISC_R_SUCCESS) {
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
 				      "added new zone was not found: %s",
-				      isc_result_totext(result));
-			goto cleanup;
+				      isc_result_totext(tresult));
+			if (zones[i].zone != NULL) {
+				/* A partial match found the parent zone */
+				dns_zone_detach(&zones[i].zone);
+			}
+			if (result == ISC_R_SUCCESS) {
+				result = tresult;
+			}
 		}
 	}
+	if (!configured) {
+		TCHECK(putstr(text, "configure_zone failed: "));
+		TCHECK(putstr(text, isc_result_totext(result)));
+	}
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
 
 #ifndef HAVE_LMDB
 	/*
 	 * If there wasn't a previous newzone config, just save the one
 	 * we've created. If there was a previous one, merge the new
-	 * zone into it.
+	 * zones into it.
 	 */
 	if (cfg->nzf_config == NULL) {
 		cfg_obj_attach(zoneconf, &cfg->nzf_config);
+		nsaved = nzones;
 	} else {
-		cfg_obj_t *z;
-		DE_CONST(zoneobj, z);
-		CHECK(cfg_parser_mapadd(cfg->add_parser, cfg->nzf_config, z,
-					"zone"));
+		for (i = 0; i < nzones; i++) {
+			cfg_obj_t *z;
+			DE_CONST(zones[i].zoneobj, z);
+			CHECK(cfg_parser_mapadd(cfg->add_parser,
+						cfg->nzf_config, z, "zone"));
+			nsaved++;
+		}
 	}
-	cleanup_config = true;
 #endif /* HAVE_LMDB */
 
 	/*
-	 * Load the zone from the master file.  If this fails, we'll
+	 * Load the zones from their master files.  If this fails, we'll
 	 * need to undo the configuration we've done already.
 	 */
-	result = dns_zone_load(zone, true);
-	if (result != ISC_R_SUCCESS) {
-		dns_db_t *dbp = NULL;
-
-		TCHECK(putstr(text, "dns_zone_loadnew failed: "));
-		TCHECK(putstr(text, isc_result_totext(result)));
-
-		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
-			      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
-			      "addzone failed; reverting.");
-
-		/* If the zone loaded partially, unload it */
-		if (dns_zone_getdb(zone, &dbp) == ISC_R_SUCCESS) {
-			dns_db_detach(&dbp);
-			dns_zone_unload(zone);
+	for (i = 0; i < nzones; i++) {
+		result = dns_zone_load(zones[i].zone, true);
+		if (result != ISC_R_SUCCESS) {
+			TCHECK(putstr(text, "dns_zone_loadnew failed: "));
+			TCHECK(putstr(text, isc_result_totext(result)));
+			goto cleanup;
 		}
-
-		/* Remove the zone from the zone table */
-		dns_zt_unmount(view->zonetable, zone);
-		goto cleanup;
 	}
 
-	/* Flag the zone as having been added at runtime */
-	dns_zone_setadded(zone, true);
+	/* Flag the zones as having been added at runtime */
+	for (i = 0; i < nzones; i++) {
+		dns_zone_setadded(zones[i].zone, true);
+	}
 
 #ifdef HAVE_LMDB
-	/* Save the new zone configuration into the NZD */
+	/* Save the new zone configurations into the NZD */
 	CHECK(nzd_open(view, 0, &txn, &dbi));
-	CHECK(nzd_save(&txn, dbi, zone, zoneobj));
+	for (i = 0; i < nzones; i++) {
+		CHECK(nzd_put(txn, dbi, zones[i].zone, zones[i].zoneobj,
+			      &changed));
+	}
+	CHECK(nzd_close(&txn, changed));
 #else  /* ifdef HAVE_LMDB */
-	/* Append the zone configuration to the NZF */
-	result = nzf_append(view, zoneobj);
+	if (nzones == 1) {
+		/* Append the zone configuration to the NZF */
+		CHECK(nzf_append(view, zones[0].zoneobj));
+	} else {
+		/* Rewrite the NZF, so that a batch is saved as a whole */
+		LOCK(&view->new_zone_lock);
+		result = nzf_writeconf(cfg->nzf_config, view);
+		UNLOCK(&view->new_zone_lock);
+		CHECK(result);
+	}
 #endif /* HAVE_LMDB */
 
+	for (i = 0; i < nzones; i++) {
+		char namebuf[DNS_NAME_FORMATSIZE];
+
+		dns_name_format(zones[i].name, namebuf, sizeof(namebuf));
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "added zone %s in view %s via %s", namebuf,
+			      view->name, NAMED_COMMAND_ADDZONE);
+	}
+
 cleanup:
+	if (exclusive) {
+		isc_task_endexclusive(server->task);
+	}
+
+	if (result != ISC_R_SUCCESS && nconfigured > 0) {
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "addzone failed; reverting.");
+	}
 
 #ifndef HAVE_LMDB
 	if (fp != NULL) {
 		(void)isc_stdio_close(fp);
 	}
-	if (result != ISC_R_SUCCESS && cleanup_config) {
+	for (i = 0; result != ISC_R_SUCCESS && i < nsaved; i++) {
 		tresult = delete_zoneconf(view, cfg->add_parser,
-					  cfg->nzf_config, name, NULL);
+					  cfg->nzf_config, zones[i].name, NULL);
 		RUNTIME_CHECK(tresult == ISC_R_SUCCESS);
 	}
 #else  /* HAVE_LMDB */
@@ -14036,9 +15251,28 @@ cleanup:
 	}
 #endif /* HAVE_LMDB */
 
-	if (zone != NULL) {
+	for (i = 0; zones != NULL && i < nzones; i++) {
+		dns_zone_t *zone = zones[i].zone;
+		dns_db_t *dbp = NULL;
+
+		if (zone == NULL) {
+			continue;
+		}
+		if (result != ISC_R_SUCCESS) {
+			/* If the zone loaded partially, unload it */
+			if (dns_zone_getdb(zone, &dbp) == ISC_R_SUCCESS) {
+				dns_db_detach(&dbp);
+				dns_zone_unload(zone);
+			}
+
+			/* Remove the zone from the zone table */
+			dns_zt_unmount(view->zonetable, zone);
+		}
 		dns_zone_detach(&zone);
 	}
+	if (zones != NULL) {
+		isc_mem_put(server->mctx, zones, nzones * sizeof(zones[0]));
+	}
 
 	return (result);
 }
@@ -14121,7 +15355,7 @@ do_modzone(named_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
 	result = configure_zone(cfg->config, zoneobj, cfg->vconfig,
 				server->mctx, view, &server->viewlist,
 				&server->kasplist, cfg->actx, true, false,
-				true);
+				true, NULL);
 	dns_view_freeze(view);
 
 	exclusive = false;
@@ -14335,19 +15569,16 @@ named_server_changezone(named_server_t *server, char *command,
 	}
 
 	if (addzone) {
-		CHECK(do_addzone(server, cfg, view, dnsname, zoneconf, zoneobj,
-				 redirect, text));
+		CHECK(do_addzone(server, cfg, view, zoneconf, redirect, text));
 	} else {
 		CHECK(do_modzone(server, cfg, view, dnsname, zonename, zoneobj,
 				 redirect, text));
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "updated zone %s in view %s via %s", zonename,
+			      view->name, NAMED_COMMAND_MODZONE);
 	}
 
-	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
-		      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
-		      "%s zone %s in view %s via %s",
-		      addzone ? "added" : "updated", zonename, view->name,
-		      addzone ? NAMED_COMMAND_ADDZONE : NAMED_COMMAND_MODZONE);
-
 	/* Changing a zone counts as reconfiguration */
 	CHECK(isc_time_now(&named_g_configtime));
 
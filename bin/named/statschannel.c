@@ -18,9 +18,11 @@
 
 #include <isc/buffer.h>
 #include <isc/httpd.h>
+#include <isc/lockstat.h>
 #include <isc/mem.h>
 #include <isc/once.h>
 #include <isc/print.h>
+#include <isc/profile.h>
 #include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/util.h>
@@ -59,7 +61,7 @@
 #define STATS_XML_VERSION	STATS_XML_VERSION_MAJOR "." STATS_XML_VERSION_MINOR
 
 #define STATS_JSON_VERSION_MAJOR "1"
-#define STATS_JSON_VERSION_MINOR "7"
+#define STATS_JSON_VERSION_MINOR "8"
 #define STATS_JSON_VERSION	 STATS_JSON_VERSION_MAJOR "." STATS_JSON_VERSION_MINOR
 
 #define CHECK(m)                               \
@@ -83,6 +85,16 @@ struct named_statschannel {
 	isc_mutex_t lock;
 	dns_acl_t *acl;
 
+	/*
+	 * Counter values at the last /metrics request, locked by the
+	 * channel lock.
+	 */
+	bool metrics_seen;
+	uint64_t nsstat_last[ns_statscounter_max];
+	uint64_t resstat_last[dns_resstatscounter_max];
+	uint64_t zonestat_last[dns_zonestatscounter_max];
+	uint64_t sockstat_last[isc_sockstatscounter_max];
+
 	/* Locked by server task */
 	ISC_LINK(struct named_statschannel) link;
 };
@@ -104,6 +116,91 @@ static isc_once_t once = ISC_ONCE_INIT;
 #undef EXTENDED_STATS
 #endif /* if defined(HAVE_LIBXML2) || defined(HAVE_JSON_C) */
 
+#ifdef EXTENDED_STATS
+/*%
+ * The zones to render: with "?offset=N&limit=M", only M zones are
+ * rendered, starting with the N'th zone across all views in the order
+ * they are walked, so that a server with many zones can be scraped a
+ * page at a time.  A limit of 0 means no limit.
+ */
+typedef struct zonepage {
+	uint64_t offset;
+	uint64_t limit;
+	uint64_t count; /* zones walked so far */
+	void *arg;	/* XML writer or JSON array */
+} zonepage_t;
+
+/*
+ * Return true if the value of 'key' is found in the query string of
+ * the request 'httpd'; copy it to 'value', NUL terminated.
+ */
+static bool
+query_value(const isc_httpd_t *httpd, const char *key, char *value,
+	    size_t size) {
+	size_t qlen, klen = strlen(key);
+	const char *q = isc_httpd_query(httpd, &qlen);
+	const char *end = q + qlen;
+
+	while (q != NULL && q < end) {
+		const char *amp = memchr(q, '&', end - q);
+		const char *next = (amp != NULL) ? amp + 1 : end;
+		size_t len = (amp != NULL) ? (size_t)(amp - q)
+					   : (size_t)(end - q);
+
+		if (len >= klen && strncmp(q, key, klen) == 0 &&
+		    (len == klen || q[klen] == '='))
+		{
+			len = (len == klen) ? 0 : len - klen - 1;
+			if (len >= size) {
+				return (false);
+			}
+			memmove(value, q + klen + 1, len);
+			value[len] = '\0';
+			return (true);
+		}
+		q = next;
+	}
+	return (false);
+}
+
+static uint64_t
+query_number(const isc_httpd_t *httpd, const char *key) {
+	char value[32];
+	char *endp = NULL;
+	uint64_t n;
+
+	if (!query_value(httpd, key, value, sizeof(value))) {
+		return (0);
+	}
+	n = strtoull(value, &endp, 10);
+	return ((*endp == '\0') ? n : 0);
+}
+
+static void
+zonepage_init(const isc_httpd_t *httpd, zonepage_t *page) {
+	*page = (zonepage_t){
+		.offset = query_number(httpd, "offset"),
+		.limit = query_number(httpd, "limit"),
+	};
+}
+
+/*
+ * Return ISC_R_SUCCESS if the next zone is to be rendered,
+ * DNS_R_CONTINUE if it is before the page, or ISC_R_NOMORE if the
+ * page is done.
+ */
+static isc_result_t
+zonepage_next(zonepage_t *page) {
+	uint64_t n = page->count;
+
+	if (page->limit != 0 && n >= page->offset + page->limit) {
+		return (ISC_R_NOMORE);
+	}
+	page->count++;
+	return ((n < page->offset) ? DNS_R_CONTINUE : ISC_R_SUCCESS);
+}
+#endif /* EXTENDED_STATS */
+
 #ifdef EXTENDED_STATS
 static const char *
 user_zonetype(dns_zone_t *zone) {
@@ -158,6 +255,7 @@ static const char *tcpinsizestats_desc[dns_sizecounter_in_max];
 static const char *tcpoutsizestats_desc[dns_sizecounter_out_max];
 static const char *dnstapstats_desc[dns_dnstapcounter_max];
 static const char *gluecachestats_desc[dns_gluecachestatscounter_max];
+static const char *latencystats_desc[ns_latencystatscounter_max];
 #if defined(EXTENDED_STATS)
 static const char *nsstats_xmldesc[ns_statscounter_max];
 static const char *resstats_xmldesc[dns_resstatscounter_max];
@@ -171,6 +269,7 @@ static const char *tcpinsizestats_xmldesc[dns_sizecounter_in_max];
 static const char *tcpoutsizestats_xmldesc[dns_sizecounter_out_max];
 static const char *dnstapstats_xmldesc[dns_dnstapcounter_max];
 static const char *gluecachestats_xmldesc[dns_gluecachestatscounter_max];
+static const char *latencystats_xmldesc[ns_latencystatscounter_max];
 #else /* if defined(EXTENDED_STATS) */
 #define nsstats_xmldesc		NULL
 #define resstats_xmldesc	NULL
@@ -184,8 +283,21 @@ static const char *gluecachestats_xmldesc[dns_gluecachestatscounter_max];
 #define tcpoutsizestats_xmldesc NULL
 #define dnstapstats_xmldesc	NULL
 #define gluecachestats_xmldesc	NULL
+#define latencystats_xmldesc	NULL
 #endif /* EXTENDED_STATS */
 
+/*%
+ * The query latency statistics have a counter for each bucket of the
+ * histogram of each stage, so their descriptions are built from these.
+ */
+static const char *latencystages_desc[ns_latency_max][2] = {
+	{ "view match", "ViewMatch" }, { "database lookup", "Lookup" },
+	{ "recursion", "Recursion" },  { "rendering", "Render" },
+	{ "sending", "Send" },	       { "total", "Total" },
+};
+static char latencystats_text[ns_latencystatscounter_max][32];
+static char latencystats_xmltext[ns_latencystatscounter_max][24];
+
 #define TRY0(a)                       \
 	do {                          \
 		xmlrc = (a);          \
@@ -210,6 +322,7 @@ static int tcpinsizestats_index[dns_sizecounter_in_max];
 static int tcpoutsizestats_index[dns_sizecounter_out_max];
 static int dnstapstats_index[dns_dnstapcounter_max];
 static int gluecachestats_index[dns_gluecachestatscounter_max];
+static int latencystats_index[ns_latencystatscounter_max];
 
 static void
 set_desc(int counter, int maxcounter, const char *fdesc, const char **fdescs,
@@ -352,6 +465,22 @@ init_desc(void) {
 		       "queries dropped due to recursive client limit",
 		       "RecLimitDropped");
 	SET_NSSTATDESC(updatequota, "Update quota exceeded", "UpdateQuota");
+	SET_NSSTATDESC(reclimitlowered,
+		       "adaptive recursive client limit lowered",
+		       "RecLimitLowered");
+	SET_NSSTATDESC(reclimitraised, "adaptive recursive client limit raised",
+		       "RecLimitRaised");
+	SET_NSSTATDESC(xfrcached, "zone transfers sent from transfer cache",
+		       "XfrCached");
+	SET_NSSTATDESC(recursjoined,
+		       "recursive queries answered by an identical query",
+		       "RecursJoined");
+	SET_NSSTATDESC(recursprefixquota,
+		       "recursive queries over the per-prefix limit",
+		       "RecursPrefixQuota");
+	SET_NSSTATDESC(tcpprefixquota,
+		       "TCP connections over the per-prefix limit",
+		       "TCPPrefixQuota");
 
 	INSIST(i == ns_statscounter_max);
 
@@ -445,6 +574,21 @@ init_desc(void) {
 			"ClientQuota");
 	SET_RESSTATDESC(nextitem, "waited for next item", "NextItem");
 	SET_RESSTATDESC(priming, "priming queries", "Priming");
+	SET_RESSTATDESC(prefetchpopular, "popular records prefetched",
+			"PrefetchPopular");
+	SET_RESSTATDESC(queryrace, "queries raced against a slow server",
+			"QueryRace");
+	SET_RESSTATDESC(bucketwait, "fetch bucket lock waits",
+			"BucketLockWaits");
+	SET_RESSTATDESC(bucketchain, "longest fetch bucket chain searched",
+			"BucketChainMax");
+	SET_RESSTATDESC(dispsockreuse, "query sockets reused",
+			"QuerySockReuse");
+	SET_RESSTATDESC(tcpreuse, "TCP connections reused", "QueryTCPReuse");
+	SET_RESSTATDESC(sharedfetch, "fetches joined in another view",
+			"SharedFetch");
+	SET_RESSTATDESC(valcached, "signatures verified earlier",
+			"ValVerifyCached");
 
 	INSIST(i == dns_resstatscounter_max);
 
@@ -626,6 +770,47 @@ init_desc(void) {
 	SET_SOCKSTATDESC(unixactive, "Unix domain sockets active",
 			 "UnixActive");
 	SET_SOCKSTATDESC(rawactive, "Raw sockets active", "RawActive");
+	SET_SOCKSTATDESC(udp4sendbatch, "UDP/IPv4 send batches",
+			 "UDP4SendBatch");
+	SET_SOCKSTATDESC(udp6sendbatch, "UDP/IPv6 send batches",
+			 "UDP6SendBatch");
+	SET_SOCKSTATDESC(udp4sendbatchmsg, "UDP/IPv4 messages sent in batches",
+			 "UDP4SendBatchMsg");
+	SET_SOCKSTATDESC(udp6sendbatchmsg, "UDP/IPv6 messages sent in batches",
+			 "UDP6SendBatchMsg");
+	SET_SOCKSTATDESC(tcp4sendbatch, "TCP/IPv4 send batches",
+			 "TCP4SendBatch");
+	SET_SOCKSTATDESC(tcp6sendbatch, "TCP/IPv6 send batches",
+			 "TCP6SendBatch");
+	SET_SOCKSTATDESC(tcp4sendbatchmsg, "TCP/IPv4 messages sent in batches",
+			 "TCP4SendBatchMsg");
+	SET_SOCKSTATDESC(tcp6sendbatchmsg, "TCP/IPv6 messages sent in batches",
+			 "TCP6SendBatchMsg");
+	SET_SOCKSTATDESC(tcp4tlshandshake, "TCP/IPv4 TLS handshakes completed",
+			 "TCP4TLSHandshake");
+	SET_SOCKSTATDESC(tcp6tlshandshake, "TCP/IPv6 TLS handshakes completed",
+			 "TCP6TLSHandshake");
+	SET_SOCKSTATDESC(tcp4tlsresumed, "TCP/IPv4 TLS sessions resumed",
+			 "TCP4TLSResumed");
+	SET_SOCKSTATDESC(tcp6tlsresumed, "TCP/IPv6 TLS sessions resumed",
+			 "TCP6TLSResumed");
+	SET_SOCKSTATDESC(tcpfirstbyte1ms,
+			 "TCP connections receiving data within 1ms",
+			 "TCPFirstByte1ms");
+	SET_SOCKSTATDESC(tcpfirstbyte10ms,
+			 "TCP connections receiving data within 10ms",
+			 "TCPFirstByte10ms");
+	SET_SOCKSTATDESC(tcpfirstbyte100ms,
+			 "TCP connections receiving data within 100ms",
+			 "TCPFirstByte100ms");
+	SET_SOCKSTATDESC(tcpfirstbyte1s,
+			 "TCP connections receiving data within 1s",
+			 "TCPFirstByte1s");
+	SET_SOCKSTATDESC(tcpfirstbyteslow,
+			 "TCP connections receiving data after 1s",
+			 "TCPFirstByteSlow");
+	SET_SOCKSTATDESC(tcpidleevicted, "TCP idle connections evicted",
+			 "TCPIdleEvicted");
 	INSIST(i == isc_sockstatscounter_max);
 
 	/* Initialize DNSSEC statistics */
@@ -705,6 +890,37 @@ init_desc(void) {
 			      "GLUECACHEinsertsabsent");
 	INSIST(i == dns_gluecachestatscounter_max);
 
+	/* Initialize query latency statistics */
+	for (i = 0; i < ns_latencystatscounter_max; i++) {
+		const char **stage = latencystages_desc[i / NS_LATENCY_BUCKETS];
+		unsigned int bucket = i % NS_LATENCY_BUCKETS;
+
+		latencystats_desc[i] = NULL;
+#if defined(EXTENDED_STATS)
+		latencystats_xmldesc[i] = NULL;
+#endif /* if defined(EXTENDED_STATS) */
+
+		if (bucket < NS_LATENCY_BUCKETS - 1) {
+			snprintf(latencystats_text[i],
+				 sizeof(latencystats_text[i]), "%s < %uus",
+				 stage[0], 1U << bucket);
+			snprintf(latencystats_xmltext[i],
+				 sizeof(latencystats_xmltext[i]), "%s%u",
+				 stage[1], 1U << bucket);
+		} else {
+			snprintf(latencystats_text[i],
+				 sizeof(latencystats_text[i]), "%s %uus+",
+				 stage[0], 1U << (bucket - 1));
+			snprintf(latencystats_xmltext[i],
+				 sizeof(latencystats_xmltext[i]), "%s%u+",
+				 stage[1], 1U << (bucket - 1));
+		}
+		set_desc(i, ns_latencystatscounter_max, latencystats_text[i],
+			 latencystats_desc, latencystats_xmltext[i],
+			 latencystats_xmldesc);
+		latencystats_index[i] = i;
+	}
+
 	/* Sanity check */
 	for (i = 0; i < ns_statscounter_max; i++) {
 		INSIST(nsstats_desc[i] != NULL);
@@ -1788,7 +2004,8 @@ zone_xmlrender(dns_zone_t *zone, void *arg) {
 	char buf[1024 + 32]; /* sufficiently large for zone name and class */
 	dns_rdataclass_t rdclass;
 	uint32_t serial;
-	xmlTextWriterPtr writer = arg;
+	zonepage_t *page = arg;
+	xmlTextWriterPtr writer = page->arg;
 	dns_zonestat_level_t statlevel;
 	int xmlrc;
 	stats_dumparg_t dumparg;
@@ -1800,6 +2017,11 @@ zone_xmlrender(dns_zone_t *zone, void *arg) {
 		return (ISC_R_SUCCESS);
 	}
 
+	result = zonepage_next(page);
+	if (result != ISC_R_SUCCESS) {
+		return ((result == DNS_R_CONTINUE) ? ISC_R_SUCCESS : result);
+	}
+
 	dumparg.type = isc_statsformat_xml;
 	dumparg.arg = writer;
 
@@ -1964,8 +2186,8 @@ cleanup:
 }
 
 static isc_result_t
-generatexml(named_server_t *server, uint32_t flags, int *buflen,
-	    xmlChar **buf) {
+generatexml(named_server_t *server, uint32_t flags, zonepage_t *page,
+	    int *buflen, xmlChar **buf) {
 	char boottime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
 	char configtime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
 	char nowstr[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
@@ -1978,6 +2200,7 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 	dns_stats_t *cacherrstats;
 	uint64_t nsstat_values[ns_statscounter_max];
 	uint64_t resstat_values[dns_resstatscounter_max];
+	uint64_t latencystat_values[ns_latencystatscounter_max];
 	uint64_t adbstat_values[dns_adbstats_max];
 	uint64_t zonestat_values[dns_zonestatscounter_max];
 	uint64_t sockstat_values[isc_sockstatscounter_max];
@@ -1988,6 +2211,7 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 #ifdef HAVE_DNSTAP
 	uint64_t dnstapstat_values[dns_dnstapcounter_max];
 #endif /* ifdef HAVE_DNSTAP */
+	uint64_t startuptimes[named_startup_max];
 	isc_result_t result;
 
 	isc_time_now(&now);
@@ -2027,6 +2251,22 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 	TRY0(xmlTextWriterWriteString(writer, ISC_XMLCHAR PACKAGE_VERSION));
 	TRY0(xmlTextWriterEndElement(writer)); /* version */
 
+	if (named_server_startuptimes(server, startuptimes)) {
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "startup-times"));
+		for (int i = 0; i < named_startup_max; i++) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "phase"));
+			TRY0(xmlTextWriterWriteAttribute(
+				writer, ISC_XMLCHAR "name",
+				ISC_XMLCHAR named_server_startupphasename(i)));
+			TRY0(xmlTextWriterWriteFormatString(
+				writer, "%" PRIu64, startuptimes[i] / 1000));
+			TRY0(xmlTextWriterEndElement(writer)); /* phase */
+		}
+		TRY0(xmlTextWriterEndElement(writer)); /* startup-times */
+	}
+
 	if ((flags & STATS_XML_SERVER) != 0) {
 		dumparg.result = ISC_R_SUCCESS;
 
@@ -2252,8 +2492,13 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 		if ((flags & STATS_XML_ZONES) != 0) {
 			TRY0(xmlTextWriterStartElement(writer,
 						       ISC_XMLCHAR "zones"));
-			CHECK(dns_zt_apply(view->zonetable, isc_rwlocktype_read,
-					   true, NULL, zone_xmlrender, writer));
+			page->arg = writer;
+			result = dns_zt_apply(view->zonetable,
+					      isc_rwlocktype_read, true, NULL,
+					      zone_xmlrender, page);
+			if (result != ISC_R_NOMORE) {
+				CHECK(result);
+			}
 			TRY0(xmlTextWriterEndElement(writer)); /* /zones */
 		}
 
@@ -2288,6 +2533,21 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 		}
 		TRY0(xmlTextWriterEndElement(writer)); /* </resstats> */
 
+		if (view->latencystats != NULL) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "counters"));
+			TRY0(xmlTextWriterWriteAttribute(
+				writer, ISC_XMLCHAR "type",
+				ISC_XMLCHAR "latency"));
+			CHECK(dump_counters(view->latencystats,
+					    isc_statsformat_xml, writer, NULL,
+					    latencystats_xmldesc,
+					    ns_latencystatscounter_max,
+					    latencystats_index,
+					    latencystat_values, 0));
+			TRY0(xmlTextWriterEndElement(writer)); /* </counters> */
+		}
+
 		cacherrstats = dns_db_getrrsetstats(view->cachedb);
 		if (cacherrstats != NULL) {
 			TRY0(xmlTextWriterStartElement(writer,
@@ -2322,6 +2582,8 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 		TRY0(dns_cache_renderxml(view->cache, writer));
 		TRY0(xmlTextWriterEndElement(writer)); /* </cachestats> */
 
+		TRY0(dns_cache_renderdomainsxml(view->cache, writer));
+
 		TRY0(xmlTextWriterEndElement(writer)); /* view */
 
 		view = ISC_LIST_NEXT(view, link);
@@ -2373,15 +2635,17 @@ wrap_xmlfree(isc_buffer_t *buffer, void *arg) {
 }
 
 static isc_result_t
-render_xml(uint32_t flags, void *arg, unsigned int *retcode,
-	   const char **retmsg, const char **mimetype, isc_buffer_t *b,
-	   isc_httpdfree_t **freecb, void **freecb_args) {
+render_xml(const isc_httpd_t *httpd, uint32_t flags, void *arg,
+	   unsigned int *retcode, const char **retmsg, const char **mimetype,
+	   isc_buffer_t *b, isc_httpdfree_t **freecb, void **freecb_args) {
 	unsigned char *msg = NULL;
 	int msglen;
 	named_server_t *server = arg;
+	zonepage_t page;
 	isc_result_t result;
 
-	result = generatexml(server, flags, &msglen, &msg);
+	zonepage_init(httpd, &page);
+	result = generatexml(server, flags, &page, &msglen, &msg);
 
 	if (result == ISC_R_SUCCESS) {
 		*retcode = 200;
@@ -2405,10 +2669,9 @@ render_xml_all(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 	       void *arg, unsigned int *retcode, const char **retmsg,
 	       const char **mimetype, isc_buffer_t *b, isc_httpdfree_t **freecb,
 	       void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_xml(STATS_XML_ALL, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args));
+	return (render_xml(httpd, STATS_XML_ALL, arg, retcode, retmsg, mimetype,
+			   b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -2416,10 +2679,9 @@ render_xml_status(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		  void *arg, unsigned int *retcode, const char **retmsg,
 		  const char **mimetype, isc_buffer_t *b,
 		  isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_xml(STATS_XML_STATUS, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args));
+	return (render_xml(httpd, STATS_XML_STATUS, arg, retcode, retmsg,
+			   mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -2427,10 +2689,9 @@ render_xml_server(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		  void *arg, unsigned int *retcode, const char **retmsg,
 		  const char **mimetype, isc_buffer_t *b,
 		  isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_xml(STATS_XML_SERVER, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args));
+	return (render_xml(httpd, STATS_XML_SERVER, arg, retcode, retmsg,
+			   mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -2438,10 +2699,9 @@ render_xml_zones(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		 void *arg, unsigned int *retcode, const char **retmsg,
 		 const char **mimetype, isc_buffer_t *b,
 		 isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_xml(STATS_XML_ZONES, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args));
+	return (render_xml(httpd, STATS_XML_ZONES, arg, retcode, retmsg,
+			   mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -2449,10 +2709,9 @@ render_xml_net(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 	       void *arg, unsigned int *retcode, const char **retmsg,
 	       const char **mimetype, isc_buffer_t *b, isc_httpdfree_t **freecb,
 	       void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_xml(STATS_XML_NET, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args));
+	return (render_xml(httpd, STATS_XML_NET, arg, retcode, retmsg, mimetype,
+			   b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -2460,10 +2719,9 @@ render_xml_tasks(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		 void *arg, unsigned int *retcode, const char **retmsg,
 		 const char **mimetype, isc_buffer_t *b,
 		 isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_xml(STATS_XML_TASKS, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args));
+	return (render_xml(httpd, STATS_XML_TASKS, arg, retcode, retmsg,
+			   mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -2471,10 +2729,9 @@ render_xml_mem(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 	       void *arg, unsigned int *retcode, const char **retmsg,
 	       const char **mimetype, isc_buffer_t *b, isc_httpdfree_t **freecb,
 	       void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_xml(STATS_XML_MEM, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args));
+	return (render_xml(httpd, STATS_XML_MEM, arg, retcode, retmsg, mimetype,
+			   b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -2482,10 +2739,9 @@ render_xml_traffic(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		   void *arg, unsigned int *retcode, const char **retmsg,
 		   const char **mimetype, isc_buffer_t *b,
 		   isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_xml(STATS_XML_TRAFFIC, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args));
+	return (render_xml(httpd, STATS_XML_TRAFFIC, arg, retcode, retmsg,
+			   mimetype, b, freecb, freecb_args));
 }
 
 #endif /* HAVE_LIBXML2 */
@@ -2551,7 +2807,8 @@ zone_jsonrender(dns_zone_t *zone, void *arg) {
 	char *class_only = NULL;
 	dns_rdataclass_t rdclass;
 	uint32_t serial;
-	json_object *zonearray = (json_object *)arg;
+	zonepage_t *page = arg;
+	json_object *zonearray = (json_object *)page->arg;
 	json_object *zoneobj = NULL;
 	dns_zonestat_level_t statlevel;
 	isc_time_t timestamp;
@@ -2561,6 +2818,11 @@ zone_jsonrender(dns_zone_t *zone, void *arg) {
 		return (ISC_R_SUCCESS);
 	}
 
+	result = zonepage_next(page);
+	if (result != ISC_R_SUCCESS) {
+		return ((result == DNS_R_CONTINUE) ? ISC_R_SUCCESS : result);
+	}
+
 	dns_zone_nameonly(zone, buf, sizeof(buf));
 	zone_name_only = buf;
 
@@ -2749,8 +3011,8 @@ cleanup:
 }
 
 static isc_result_t
-generatejson(named_server_t *server, size_t *msglen, const char **msg,
-	     json_object **rootp, uint32_t flags) {
+generatejson(named_server_t *server, zonepage_t *page, size_t *msglen,
+	     const char **msg, json_object **rootp, uint32_t flags) {
 	dns_view_t *view;
 	isc_result_t result = ISC_R_SUCCESS;
 	json_object *bindstats, *viewlist, *counters, *obj;
@@ -2761,6 +3023,7 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 	json_object *tcpreq6 = NULL, *tcpresp6 = NULL;
 	uint64_t nsstat_values[ns_statscounter_max];
 	uint64_t resstat_values[dns_resstatscounter_max];
+	uint64_t latencystat_values[ns_latencystatscounter_max];
 	uint64_t adbstat_values[dns_adbstats_max];
 	uint64_t zonestat_values[dns_zonestatscounter_max];
 	uint64_t sockstat_values[isc_sockstatscounter_max];
@@ -2771,6 +3034,7 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 #ifdef HAVE_DNSTAP
 	uint64_t dnstapstat_values[dns_dnstapcounter_max];
 #endif /* ifdef HAVE_DNSTAP */
+	uint64_t startuptimes[named_startup_max];
 	stats_dumparg_t dumparg;
 	char boottime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
 	char configtime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
@@ -2814,6 +3078,19 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 	CHECKMEM(obj);
 	json_object_object_add(bindstats, "version", obj);
 
+	if (named_server_startuptimes(server, startuptimes)) {
+		json_object *times = json_object_new_object();
+		CHECKMEM(times);
+		json_object_object_add(bindstats, "startup-times", times);
+
+		for (int i = 0; i < named_startup_max; i++) {
+			obj = json_object_new_int64(startuptimes[i] / 1000);
+			CHECKMEM(obj);
+			json_object_object_add(
+				times, named_server_startupphasename(i), obj);
+		}
+	}
+
 	if ((flags & STATS_JSON_SERVER) != 0) {
 		/* OPCODE counters */
 		counters = json_object_new_object();
@@ -2983,9 +3260,15 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 			CHECKMEM(za);
 
 			if ((flags & STATS_JSON_ZONES) != 0) {
-				CHECK(dns_zt_apply(view->zonetable,
-						   isc_rwlocktype_read, true,
-						   NULL, zone_jsonrender, za));
+				page->arg = za;
+				result = dns_zt_apply(view->zonetable,
+						      isc_rwlocktype_read, true,
+						      NULL, zone_jsonrender,
+						      page);
+				if (result != ISC_R_NOMORE) {
+					CHECK(result);
+				}
+				result = ISC_R_SUCCESS;
 			}
 
 			if (json_object_array_length(za) != 0) {
@@ -3078,6 +3361,33 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 				json_object_object_add(res, "cachestats",
 						       counters);
 
+				result = dns_cache_renderdomainsjson(
+					view->cache, res);
+				if (result != ISC_R_SUCCESS) {
+					goto cleanup;
+				}
+
+				istats = view->latencystats;
+				if (istats != NULL) {
+					counters = json_object_new_object();
+					CHECKMEM(counters);
+
+					result = dump_counters(
+						istats, isc_statsformat_json,
+						counters, NULL,
+						latencystats_xmldesc,
+						ns_latencystatscounter_max,
+						latencystats_index,
+						latencystat_values, 0);
+					if (result != ISC_R_SUCCESS) {
+						json_object_put(counters);
+						goto cleanup;
+					}
+
+					json_object_object_add(v, "latency",
+							       counters);
+				}
+
 				istats = view->adbstats;
 				if (istats != NULL) {
 					counters = json_object_new_object();
@@ -3155,6 +3465,30 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 		json_object_object_add(bindstats, "memory", memory);
 	}
 
+	if ((flags & STATS_JSON_SERVER) != 0) {
+		json_object *profile = json_object_new_object();
+		uint64_t nsecs[isc_profile_max], calls[isc_profile_max];
+
+		CHECKMEM(profile);
+
+		isc_profile_get(nsecs, calls);
+		for (int i = 0; i < isc_profile_max; i++) {
+			json_object *counters = json_object_new_object();
+			CHECKMEM(counters);
+
+			obj = json_object_new_int64(nsecs[i] / 1000);
+			CHECKMEM(obj);
+			json_object_object_add(counters, "usecs", obj);
+			obj = json_object_new_int64(calls[i]);
+			CHECKMEM(obj);
+			json_object_object_add(counters, "calls", obj);
+			json_object_object_add(profile, isc_profile_name(i),
+					       counters);
+		}
+
+		json_object_object_add(bindstats, "profile", profile);
+	}
+
 	if ((flags & STATS_JSON_TRAFFIC) != 0) {
 		traffic = json_object_new_object();
 		CHECKMEM(traffic);
@@ -3310,17 +3644,20 @@ cleanup:
 }
 
 static isc_result_t
-render_json(uint32_t flags, void *arg, unsigned int *retcode,
-	    const char **retmsg, const char **mimetype, isc_buffer_t *b,
-	    isc_httpdfree_t **freecb, void **freecb_args) {
+render_json(const isc_httpd_t *httpd, uint32_t flags, void *arg,
+	    unsigned int *retcode, const char **retmsg, const char **mimetype,
+	    isc_buffer_t *b, isc_httpdfree_t **freecb, void **freecb_args) {
 	isc_result_t result;
 	json_object *bindstats = NULL;
 	named_server_t *server = arg;
+	zonepage_t page;
 	const char *msg = NULL;
 	size_t msglen = 0;
 	char *p;
 
-	result = generatejson(server, &msglen, &msg, &bindstats, flags);
+	zonepage_init(httpd, &page);
+	result = generatejson(server, &page, &msglen, &msg, &bindstats,
+			      flags);
 	if (result == ISC_R_SUCCESS) {
 		*retcode = 200;
 		*retmsg = "OK";
@@ -3344,10 +3681,9 @@ render_json_all(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		void *arg, unsigned int *retcode, const char **retmsg,
 		const char **mimetype, isc_buffer_t *b,
 		isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_ALL, arg, retcode, retmsg, mimetype, b,
-			    freecb, freecb_args));
+	return (render_json(httpd, STATS_JSON_ALL, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -3355,10 +3691,9 @@ render_json_status(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		   void *arg, unsigned int *retcode, const char **retmsg,
 		   const char **mimetype, isc_buffer_t *b,
 		   isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_STATUS, arg, retcode, retmsg, mimetype,
-			    b, freecb, freecb_args));
+	return (render_json(httpd, STATS_JSON_STATUS, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -3366,10 +3701,9 @@ render_json_server(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		   void *arg, unsigned int *retcode, const char **retmsg,
 		   const char **mimetype, isc_buffer_t *b,
 		   isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_SERVER, arg, retcode, retmsg, mimetype,
-			    b, freecb, freecb_args));
+	return (render_json(httpd, STATS_JSON_SERVER, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -3377,10 +3711,9 @@ render_json_zones(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		  void *arg, unsigned int *retcode, const char **retmsg,
 		  const char **mimetype, isc_buffer_t *b,
 		  isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_ZONES, arg, retcode, retmsg, mimetype, b,
-			    freecb, freecb_args));
+	return (render_json(httpd, STATS_JSON_ZONES, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -3388,10 +3721,9 @@ render_json_mem(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		void *arg, unsigned int *retcode, const char **retmsg,
 		const char **mimetype, isc_buffer_t *b,
 		isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_MEM, arg, retcode, retmsg, mimetype, b,
-			    freecb, freecb_args));
+	return (render_json(httpd, STATS_JSON_MEM, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -3399,10 +3731,9 @@ render_json_tasks(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		  void *arg, unsigned int *retcode, const char **retmsg,
 		  const char **mimetype, isc_buffer_t *b,
 		  isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_TASKS, arg, retcode, retmsg, mimetype, b,
-			    freecb, freecb_args));
+	return (render_json(httpd, STATS_JSON_TASKS, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -3410,10 +3741,9 @@ render_json_net(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		void *arg, unsigned int *retcode, const char **retmsg,
 		const char **mimetype, isc_buffer_t *b,
 		isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_NET, arg, retcode, retmsg, mimetype, b,
-			    freecb, freecb_args));
+	return (render_json(httpd, STATS_JSON_NET, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -3421,14 +3751,189 @@ render_json_traffic(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		    void *arg, unsigned int *retcode, const char **retmsg,
 		    const char **mimetype, isc_buffer_t *b,
 		    isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_TRAFFIC, arg, retcode, retmsg, mimetype,
-			    b, freecb, freecb_args));
+	return (render_json(httpd, STATS_JSON_TRAFFIC, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 #endif /* HAVE_JSON_C */
 
+#ifdef EXTENDED_STATS
+static void
+wrap_bufferfree(isc_buffer_t *buffer, void *arg) {
+	isc_buffer_t *b = arg;
+
+	UNUSED(buffer);
+
+	isc_buffer_free(&b);
+}
+
+/*
+ * Append the counters in 'stats' to 'b' in the Prometheus text format,
+ * as the metric 'family' labelled with the counter names.  Unless 'all'
+ * is true, only the counters which changed since the values saved in
+ * 'last' are included; 'last' is then updated.
+ */
+static void
+metrics_dump(isc_buffer_t *b, isc_stats_t *stats, const char *family,
+	     const char *type, const char **desc, int ncounters, int *indices,
+	     uint64_t *values, uint64_t *last, bool all) {
+	stats_dumparg_t dumparg;
+	bool header = false;
+
+	if (stats == NULL) {
+		return;
+	}
+
+	dumparg.type = isc_statsformat_file;
+	dumparg.ncounters = ncounters;
+	dumparg.counterindices = indices;
+	dumparg.countervalues = values;
+
+	memset(values, 0, sizeof(values[0]) * ncounters);
+	isc_stats_dump(stats, generalstat_dump, &dumparg,
+		       ISC_STATSDUMP_VERBOSE);
+
+	for (int i = 0; i < ncounters; i++) {
+		int idx = indices[i];
+
+		if (!all && values[idx] == last[idx]) {
+			continue;
+		}
+		if (!header) {
+			(void)isc_buffer_printf(b, "# TYPE %s %s\n", family,
+						type);
+			header = true;
+		}
+		(void)isc_buffer_printf(b, "%s{name=\"%s\"} %" PRIu64 "\n",
+					family, desc[idx], values[idx]);
+	}
+	memmove(last, values, sizeof(values[0]) * ncounters);
+}
+
+static void
+lockstat_seconds(const isc_lockstat_t *stat, uint64_t nsecs,
+		 uint64_t contended, void *arg) {
+	isc_buffer_t *b = arg;
+
+	UNUSED(contended);
+
+	(void)isc_buffer_printf(
+		b,
+		"bind_lock_wait_seconds_total{kind=\"%s\",site=\"%s:%u\"} "
+		"%" PRIu64 ".%09" PRIu64 "\n",
+		stat->kind, stat->file, stat->line, nsecs / 1000000000,
+		nsecs % 1000000000);
+}
+
+static void
+lockstat_waits(const isc_lockstat_t *stat, uint64_t nsecs,
+	       uint64_t contended, void *arg) {
+	isc_buffer_t *b = arg;
+
+	UNUSED(nsecs);
+
+	(void)isc_buffer_printf(
+		b, "bind_lock_waits_total{kind=\"%s\",site=\"%s:%u\"} %" PRIu64
+		   "\n",
+		stat->kind, stat->file, stat->line, contended);
+}
+
+/*
+ * Render the server-wide counters in the Prometheus text format.  Each
+ * listener remembers the values it last sent, and only the counters
+ * which changed since then are sent again, unless "?all" is given, so
+ * that frequent scrapes of a busy server stay small.
+ */
+static isc_result_t
+render_metrics(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+	       void *arg, unsigned int *retcode, const char **retmsg,
+	       const char **mimetype, isc_buffer_t *b,
+	       isc_httpdfree_t **freecb, void **freecb_args) {
+	named_statschannel_t *listener = arg;
+	named_server_t *server = named_g_server;
+	isc_buffer_t *text = NULL;
+	uint64_t nsstat_values[ns_statscounter_max];
+	uint64_t resstat_values[dns_resstatscounter_max];
+	uint64_t zonestat_values[dns_zonestatscounter_max];
+	uint64_t sockstat_values[isc_sockstatscounter_max];
+	uint64_t profile_nsecs[isc_profile_max];
+	uint64_t profile_calls[isc_profile_max];
+	char value[2];
+	bool all;
+
+	UNUSED(urlinfo);
+
+	isc_buffer_allocate(listener->mctx, &text, 4096);
+	isc_buffer_setautorealloc(text, true);
+
+	LOCK(&listener->lock);
+	all = !listener->metrics_seen ||
+	      query_value(httpd, "all", value, sizeof(value));
+	metrics_dump(text, ns_stats_get(server->sctx->nsstats),
+		     "bind_nsstat_total", "counter", nsstats_xmldesc,
+		     ns_statscounter_max, nsstats_index, nsstat_values,
+		     listener->nsstat_last, all);
+	metrics_dump(text, server->resolverstats, "bind_resstat_total",
+		     "counter", resstats_xmldesc, dns_resstatscounter_max,
+		     resstats_index, resstat_values, listener->resstat_last,
+		     all);
+	metrics_dump(text, server->zonestats, "bind_zonestat_total",
+		     "counter", zonestats_xmldesc, dns_zonestatscounter_max,
+		     zonestats_index, zonestat_values, listener->zonestat_last,
+		     all);
+	/* Some socket statistics, such as "UDP4Active", are gauges. */
+	metrics_dump(text, server->sockstats, "bind_sockstat", "untyped",
+		     sockstats_xmldesc, isc_sockstatscounter_max,
+		     sockstats_index, sockstat_values, listener->sockstat_last,
+		     all);
+	listener->metrics_seen = true;
+	UNLOCK(&listener->lock);
+
+	if (isc_lockstat_enabled()) {
+		(void)isc_buffer_printf(text, "# TYPE "
+					      "bind_lock_wait_seconds_total "
+					      "counter\n");
+		isc_lockstat_foreach(lockstat_seconds, text);
+		(void)isc_buffer_printf(text, "# TYPE bind_lock_waits_total "
+					      "counter\n");
+		isc_lockstat_foreach(lockstat_waits, text);
+	}
+
+	/* These always change on a busy server, so they are always sent. */
+	isc_profile_get(profile_nsecs, profile_calls);
+	(void)isc_buffer_printf(text, "# TYPE bind_profile_seconds_total "
+				      "counter\n");
+	for (int i = 0; i < isc_profile_max; i++) {
+		(void)isc_buffer_printf(
+			text,
+			"bind_profile_seconds_total{subsystem=\"%s\"} "
+			"%" PRIu64 ".%09" PRIu64 "\n",
+			isc_profile_name(i), profile_nsecs[i] / 1000000000,
+			profile_nsecs[i] % 1000000000);
+	}
+	(void)isc_buffer_printf(text, "# TYPE bind_profile_calls_total "
+				      "counter\n");
+	for (int i = 0; i < isc_profile_max; i++) {
+		(void)isc_buffer_printf(
+			text,
+			"bind_profile_calls_total{subsystem=\"%s\"} %" PRIu64
+			"\n",
+			isc_profile_name(i), profile_calls[i]);
+	}
+
+	*retcode = 200;
+	*retmsg = "OK";
+	*mimetype = "text/plain; version=0.0.4";
+	isc_buffer_reinit(b, isc_buffer_base(text), isc_buffer_length(text));
+	isc_buffer_add(b, isc_buffer_usedlength(text));
+	*freecb = wrap_bufferfree;
+	*freecb_args = text;
+
+	return (ISC_R_SUCCESS);
+}
+#endif /* EXTENDED_STATS */
+
 static isc_result_t
 render_xsl(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo, void *args,
 	   unsigned int *retcode, const char **retmsg, const char **mimetype,
@@ -3583,63 +4088,67 @@ add_listener(named_server_t *server, named_statschannel_t **listenerp,
 				  &listener->httpdmgr));
 
 #ifdef HAVE_LIBXML2
-	isc_httpdmgr_addurl(listener->httpdmgr, "/", false, render_xml_all,
-			    server);
-	isc_httpdmgr_addurl(listener->httpdmgr, "/xml", false, render_xml_all,
-			    server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/xml/v" STATS_XML_VERSION_MAJOR, false,
-			    render_xml_all, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/xml/v" STATS_XML_VERSION_MAJOR "/status", false,
-			    render_xml_status, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/xml/v" STATS_XML_VERSION_MAJOR "/server", false,
-			    render_xml_server, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/xml/v" STATS_XML_VERSION_MAJOR "/zones", false,
-			    render_xml_zones, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/xml/v" STATS_XML_VERSION_MAJOR "/net", false,
-			    render_xml_net, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/xml/v" STATS_XML_VERSION_MAJOR "/tasks", false,
-			    render_xml_tasks, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/xml/v" STATS_XML_VERSION_MAJOR "/mem", false,
-			    render_xml_mem, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/xml/v" STATS_XML_VERSION_MAJOR "/traffic", false,
-			    render_xml_traffic, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr, "/", render_xml_all,
+				server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr, "/xml", render_xml_all,
+				server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/xml/v" STATS_XML_VERSION_MAJOR,
+				render_xml_all, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/xml/v" STATS_XML_VERSION_MAJOR "/status",
+				render_xml_status, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/xml/v" STATS_XML_VERSION_MAJOR "/server",
+				render_xml_server, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/xml/v" STATS_XML_VERSION_MAJOR "/zones",
+				render_xml_zones, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/xml/v" STATS_XML_VERSION_MAJOR "/net",
+				render_xml_net, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/xml/v" STATS_XML_VERSION_MAJOR "/tasks",
+				render_xml_tasks, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/xml/v" STATS_XML_VERSION_MAJOR "/mem",
+				render_xml_mem, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/xml/v" STATS_XML_VERSION_MAJOR "/traffic",
+				render_xml_traffic, server);
 #endif /* ifdef HAVE_LIBXML2 */
 #ifdef HAVE_JSON_C
-	isc_httpdmgr_addurl(listener->httpdmgr, "/json", false, render_json_all,
-			    server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/json/v" STATS_JSON_VERSION_MAJOR, false,
-			    render_json_all, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/json/v" STATS_JSON_VERSION_MAJOR "/status", false,
-			    render_json_status, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/json/v" STATS_JSON_VERSION_MAJOR "/server", false,
-			    render_json_server, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/json/v" STATS_JSON_VERSION_MAJOR "/zones", false,
-			    render_json_zones, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/json/v" STATS_JSON_VERSION_MAJOR "/tasks", false,
-			    render_json_tasks, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/json/v" STATS_JSON_VERSION_MAJOR "/net", false,
-			    render_json_net, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/json/v" STATS_JSON_VERSION_MAJOR "/mem", false,
-			    render_json_mem, server);
-	isc_httpdmgr_addurl(listener->httpdmgr,
-			    "/json/v" STATS_JSON_VERSION_MAJOR "/traffic",
-			    false, render_json_traffic, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr, "/json", render_json_all,
+				server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/json/v" STATS_JSON_VERSION_MAJOR,
+				render_json_all, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/json/v" STATS_JSON_VERSION_MAJOR "/status",
+				render_json_status, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/json/v" STATS_JSON_VERSION_MAJOR "/server",
+				render_json_server, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/json/v" STATS_JSON_VERSION_MAJOR "/zones",
+				render_json_zones, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/json/v" STATS_JSON_VERSION_MAJOR "/tasks",
+				render_json_tasks, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/json/v" STATS_JSON_VERSION_MAJOR "/net",
+				render_json_net, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/json/v" STATS_JSON_VERSION_MAJOR "/mem",
+				render_json_mem, server);
+	isc_httpdmgr_addworkurl(listener->httpdmgr,
+				"/json/v" STATS_JSON_VERSION_MAJOR "/traffic",
+				render_json_traffic, server);
 #endif /* ifdef HAVE_JSON_C */
+#ifdef EXTENDED_STATS
+	isc_httpdmgr_addworkurl(listener->httpdmgr, "/metrics", render_metrics,
+				listener);
+#endif /* ifdef EXTENDED_STATS */
 	isc_httpdmgr_addurl(listener->httpdmgr, "/bind9.xsl", true, render_xsl,
 			    server);
 
@@ -3865,6 +4374,15 @@ named_statschannels_shutdown(named_server_t *server) {
 	}
 }
 
+static void
+lockstat_dump(const isc_lockstat_t *stat, uint64_t nsecs, uint64_t contended,
+	      void *arg) {
+	FILE *fp = arg;
+
+	fprintf(fp, "%20" PRIu64 " %20" PRIu64 " %s %s:%u\n", contended,
+		nsecs / 1000, stat->kind, stat->file, stat->line);
+}
+
 isc_result_t
 named_stats_dump(named_server_t *server, FILE *fp) {
 	isc_stdtime_t now;
@@ -3874,6 +4392,7 @@ named_stats_dump(named_server_t *server, FILE *fp) {
 	stats_dumparg_t dumparg;
 	uint64_t nsstat_values[ns_statscounter_max];
 	uint64_t resstat_values[dns_resstatscounter_max];
+	uint64_t latencystat_values[ns_latencystatscounter_max];
 	uint64_t adbstat_values[dns_adbstats_max];
 	uint64_t zonestat_values[dns_zonestatscounter_max];
 	uint64_t sockstat_values[isc_sockstatscounter_max];
@@ -3949,6 +4468,24 @@ named_stats_dump(named_server_t *server, FILE *fp) {
 				    resstat_values, 0);
 	}
 
+	fprintf(fp, "++ Query Latency Statistics ++\n");
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		if (view->latencystats == NULL) {
+			continue;
+		}
+		if (strcmp(view->name, "_default") == 0) {
+			fprintf(fp, "[View: default]\n");
+		} else {
+			fprintf(fp, "[View: %s]\n", view->name);
+		}
+		(void)dump_counters(view->latencystats, isc_statsformat_file,
+				    fp, NULL, latencystats_desc,
+				    ns_latencystatscounter_max,
+				    latencystats_index, latencystat_values, 0);
+	}
+
 	fprintf(fp, "++ Cache Statistics ++\n");
 	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
 	     view = ISC_LIST_NEXT(view, link))
@@ -4017,6 +4554,11 @@ named_stats_dump(named_server_t *server, FILE *fp) {
 			    sockstats_desc, isc_sockstatscounter_max,
 			    sockstats_index, sockstat_values, 0);
 
+	if (isc_lockstat_enabled()) {
+		fprintf(fp, "++ Lock Contention ++\n");
+		isc_lockstat_foreach(lockstat_dump, fp);
+	}
+
 	fprintf(fp, "++ Per Zone Query Statistics ++\n");
 	zone = NULL;
 	for (result = dns_zone_first(server->zonemgr, &zone);
@@ -1410,6 +1410,12 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 			dns_zone_setixfrratio(zone, cfg_obj_aspercentage(obj));
 		}
 
+		obj = NULL;
+		result = named_config_get(maps, "condense-ixfr", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setoption(zone, DNS_ZONEOPT_CONDENSEIXFR,
+				   cfg_obj_asboolean(obj));
+
 		obj = NULL;
 		result = named_config_get(maps, "request-expire", &obj);
 		INSIST(result == ISC_R_SUCCESS);
@@ -1547,6 +1553,11 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		}
 
 		CHECK(configure_zone_ssutable(zoptions, mayberaw, zname));
+
+		obj = NULL;
+		result = named_config_get(maps, "journal-commit-delay", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setjournaldelay(mayberaw, cfg_obj_asuint32(obj));
 	}
 
 	/*
@@ -1631,6 +1642,16 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
 		dns_zone_setsignatures(zone, cfg_obj_asuint32(obj));
 
+		obj = NULL;
+		result = named_config_get(maps, "sig-signing-threads", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setsigningthreads(zone, cfg_obj_asuint32(obj));
+
+		obj = NULL;
+		result = named_config_get(maps, "sig-resigning-rate", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setresigningrate(zone, cfg_obj_asuint32(obj));
+
 		obj = NULL;
 		result = named_config_get(maps, "sig-signing-nodes", &obj);
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
@@ -1661,6 +1682,12 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		 * named-checkconf will error if both are configured.
 		 */
 
+		obj = NULL;
+		result = named_config_get(maps, "compact-denial", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setoption(zone, DNS_ZONEOPT_COMPACTDENIAL,
+				   cfg_obj_asboolean(obj));
+
 		obj = NULL;
 		result = named_config_get(maps, "dnssec-loadkeys-interval",
 					  &obj);
@@ -132,6 +132,8 @@ command is one of the following:\n\
 		Dump cache(s) to the dump file (named_dump.db).\n\
   flush         Flushes all of the server's caches.\n\
   flush [view]	Flushes the server's cache for a view.\n\
+  flushdlz [view]\n\
+		Flush the answers cached from DLZ databases.\n\
   flushname name [view]\n\
 		Flush the given name from the server's cache(s)\n\
   flushtree name [view]\n\
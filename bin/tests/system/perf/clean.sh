@@ -0,0 +1,23 @@
+#!/bin/sh
+
+# Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+#
+# SPDX-License-Identifier: MPL-2.0
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0.  If a copy of the MPL was not distributed with this
+# file, you can obtain one at https://mozilla.org/MPL/2.0/.
+#
+# See the COPYRIGHT file distributed with this work for additional
+# information regarding copyright ownership.
+
+rm -f mdig.out.* queries.*
+rm -f ns*/named.conf
+rm -f ns*/named.lock
+rm -f ns*/named.memstats
+rm -f ns*/named.run*
+rm -f ns*/managed-keys.bind*
+rm -f ns*/signer.out.*
+rm -f ns1/K* ns1/root.db ns1/root.db.signed ns1/dsset-*
+rm -f ns2/K* ns2/*.db ns2/*.db.signed ns2/dsset-*
+rm -f ns3/trusted.conf ns4/trusted.conf ns4/rpz.db
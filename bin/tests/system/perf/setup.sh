@@ -0,0 +1,88 @@
+#!/bin/sh
+
+# Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+#
+# SPDX-License-Identifier: MPL-2.0
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0.  If a copy of the MPL was not distributed with this
+# file, you can obtain one at https://mozilla.org/MPL/2.0/.
+#
+# See the COPYRIGHT file distributed with this work for additional
+# information regarding copyright ownership.
+
+. ../conf.sh
+
+# Number of names in each generated zone and in the policy zone.
+PERF_NAMES=${PERF_NAMES:-20000}
+PERF_RPZ=${PERF_RPZ:-100000}
+
+for server in ns1 ns2 ns3 ns4; do
+	copy_setports $server/named.conf.in $server/named.conf
+done
+
+# genzone origin: a zone served by ns2 with PERF_NAMES address records.
+genzone() {
+	cat <<EOZ
+\$TTL 3600
+@	SOA	ns2 hostmaster 1 3600 1200 604800 3600
+	NS	ns2
+ns2	A	10.53.0.2
+EOZ
+	awk -v n="$PERF_NAMES" 'BEGIN {
+		for (i = 0; i < n; i++) {
+			printf("host%d\tA\t10.%d.%d.%d\n", i,
+			       int(i / 65536) % 256, int(i / 256) % 256,
+			       i % 256);
+		}
+	}'
+}
+
+(
+	cd ns2 || exit 1
+	genzone > plain.db
+	genzone > example.db
+	ksk=$($KEYGEN -q -a ${DEFAULT_ALGORITHM} -f KSK example)
+	zsk=$($KEYGEN -q -a ${DEFAULT_ALGORITHM} example)
+	cat $ksk.key $zsk.key >> example.db
+	$SIGNER -P -g -o example example.db > signer.out.example 2>&1
+)
+
+(
+	cd ns1 || exit 1
+	ksk=$($KEYGEN -q -a ${DEFAULT_ALGORITHM} -f KSK .)
+	zsk=$($KEYGEN -q -a ${DEFAULT_ALGORITHM} .)
+	cat root.db.in ../ns2/dsset-example. $ksk.key $zsk.key > root.db
+	$SIGNER -P -g -o . root.db > signer.out.root 2>&1
+	keyfile_to_static_ds $ksk > ../ns3/trusted.conf
+	cp ../ns3/trusted.conf ../ns4/trusted.conf
+)
+
+# The policy zone rewrites one name in four of the "plain" zone, and
+# holds as many rules again for names that are never queried.
+{
+	cat <<EOZ
+\$TTL 300
+@	SOA	ns4 hostmaster 1 3600 1200 604800 60
+	NS	ns4
+ns4	A	10.53.0.4
+EOZ
+	awk -v n="$PERF_NAMES" -v r="$PERF_RPZ" 'BEGIN {
+		for (i = 0; i < n; i += 4) {
+			printf("host%d.plain\tCNAME\t.\n", i);
+			r--;
+		}
+		for (i = 0; i < r; i++) {
+			printf("unused%d.plain\tCNAME\t.\n", i);
+		}
+	}'
+} > ns4/rpz.db
+
+# Query lists for mdig.
+for zone in plain example; do
+	awk -v n="$PERF_NAMES" -v z="$zone" 'BEGIN {
+		for (i = 0; i < n; i++) {
+			printf("host%d.%s A\n", i, z);
+		}
+	}' > queries.$zone
+done
@@ -0,0 +1,109 @@
+#!/bin/sh
+
+# Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+#
+# SPDX-License-Identifier: MPL-2.0
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0.  If a copy of the MPL was not distributed with this
+# file, you can obtain one at https://mozilla.org/MPL/2.0/.
+#
+# See the COPYRIGHT file distributed with this work for additional
+# information regarding copyright ownership.
+
+set -e
+
+. ../conf.sh
+
+PERF_NAMES=${PERF_NAMES:-20000}
+PERF_QPS=${PERF_QPS:-2000}
+PERF_DURATION=${PERF_DURATION:-10}
+PERF_CLIENTS=${PERF_CLIENTS:-16}
+PERF_RESULTS=${PERF_RESULTS:-perf.json}
+
+# A cold run must not send a name twice, or it ends up measuring the
+# cache.
+cold_duration=$((PERF_NAMES / PERF_QPS))
+[ "$cold_duration" -gt 0 ] || cold_duration=1
+
+commit=$(cd "$TOP_SRCDIR" && git rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+status=0
+n=0
+
+rndccmd() {
+	"$RNDC" -c ../common/rndc.conf -p "$CONTROLPORT" -s "$@"
+}
+
+# bench server queries duration [mdig options...]: run mdig in
+# benchmark mode against 10.53.0.$server.
+bench() {
+	server=$1 queries=$2 duration=$3
+	shift 3
+	$MDIG @10.53.0.$server "$@" +qps=$PERF_QPS +duration=$duration \
+		+clients=$PERF_CLIENTS -f $queries
+}
+
+# scenario name server queries duration [mdig options...]: run one
+# scenario and append its results, along with the resident memory of
+# the server afterwards, to $PERF_RESULTS as a JSON object.
+scenario() {
+	name=$1 server=$2 queries=$3 duration=$4
+	shift 4
+	n=$((n + 1))
+	echo_i "scenario $name ($n)"
+	ret=0
+	bench $server $queries $duration -p "$PORT" "$@" > mdig.out.$name 2>&1 || ret=1
+	rss=$(ps -o rss= -p "$(cat ns$server/named.pid)" | tr -d ' ')
+	awk -v name="$name" -v commit="$commit" -v rss="${rss:-0}" '
+		/^;; Queries sent:/ { sent = $4 }
+		/^;; Responses received:/ { received = $4; qps = $(NF - 1) }
+		/^;; Queries lost:/ { lost = $4 }
+		/^;; Latency \(ms\):/ { mean = $7; max = $9 }
+		/^;; Latency percentiles/ {
+			p50 = $6; p90 = $8; p99 = $10; p999 = $12
+		}
+		END {
+			sub(",", "", mean);
+			if (received == 0) {
+				exit(1);
+			}
+			printf("{\"scenario\":\"%s\",\"commit\":\"%s\",", name,
+			       commit);
+			printf("\"sent\":%d,\"received\":%d,\"lost\":%d,",
+			       sent, received, lost);
+			printf("\"qps\":%s,\"latency_ms\":{\"mean\":%s,", qps,
+			       mean);
+			printf("\"p50\":%s,\"p90\":%s,\"p99\":%s,", p50, p90,
+			       p99);
+			printf("\"p99.9\":%s,\"max\":%s},", p999, max);
+			printf("\"rss_kb\":%d}\n", rss);
+		}' mdig.out.$name >> $PERF_RESULTS || ret=1
+	if [ $ret != 0 ]; then echo_i "failed"; fi
+	status=$((status + ret))
+}
+
+# The -p given with a scenario overrides the default query port.
+scenario authoritative 2 queries.example $PERF_DURATION +norec
+scenario authoritative-tcp 2 queries.example $PERF_DURATION +norec +tcp
+scenario authoritative-dot 2 queries.example $PERF_DURATION +norec +tls \
+	-p "$TLSPORT"
+scenario authoritative-doh 2 queries.example $PERF_DURATION +norec +https \
+	-p "$HTTPSPORT"
+
+rndccmd 10.53.0.3 flush
+scenario recursive-cold 3 queries.plain $cold_duration
+scenario recursive-warm 3 queries.plain $PERF_DURATION
+
+rndccmd 10.53.0.3 flush
+scenario validating-cold 3 queries.example $cold_duration +dnssec
+scenario validating-warm 3 queries.example $PERF_DURATION +dnssec
+
+# Fill the cache first, so that the policy lookups are what is measured.
+bench 4 queries.plain $cold_duration -p "$PORT" > mdig.out.rpz-fill 2>&1 || true
+scenario rpz 4 queries.plain $PERF_DURATION
+
+echo_i "results are in $PERF_RESULTS"
+
+echo_i "exit status: $status"
+[ $status -eq 0 ] || exit 1
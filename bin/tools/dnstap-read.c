@@ -38,11 +38,16 @@
 #include <isc/attributes.h>
 #include <isc/buffer.h>
 #include <isc/commandline.h>
+#include <isc/condition.h>
 #include <isc/hex.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
+#include <isc/parseint.h>
 #include <isc/print.h>
 #include <isc/result.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include <dns/dnstap.h>
@@ -50,6 +55,10 @@
 #include <dns/masterdump.h>
 #include <dns/message.h>
 #include <dns/name.h>
+#include <dns/rcode.h>
+#include <dns/rdataclass.h>
+#include <dns/rdatatype.h>
+#include <dns/time.h>
 
 #include "dnstap.pb-c.h"
 
@@ -58,6 +67,7 @@ bool memrecord = false;
 bool printmessage = false;
 bool hexmessage = false;
 bool yaml = false;
+bool columns = false;
 
 const char *program = "dnstap-read";
 
@@ -71,6 +81,73 @@ const char *program = "dnstap-read";
 		}                                                     \
 	} while (0)
 
+/*
+ * Frames are read in chunks of up to CHUNK_FRAMES frames or CHUNK_SIZE
+ * bytes, decoded by the worker threads, and printed in the order they
+ * were read.  NCHUNKS chunks per thread are in flight.
+ */
+#define CHUNK_FRAMES 4096
+#define CHUNK_SIZE   (1024 * 1024)
+#define NCHUNKS	     4
+#define MAXTHREADS   128
+
+typedef enum {
+	chunk_free,
+	chunk_filled,
+	chunk_working,
+	chunk_done
+} chunkstate_t;
+
+typedef struct chunk {
+	chunkstate_t state;
+	isc_buffer_t *in;  /*%< frames, each preceded by its length */
+	isc_buffer_t *out; /*%< text to print */
+} chunk_t;
+
+static chunk_t *chunks = NULL;
+static unsigned int nchunks = 0;
+static uint64_t next_work = 0;
+static bool reading_done = false;
+static isc_mutex_t lock;
+static isc_condition_t cond;
+
+/*
+ * Filters, applied to the raw frame before it is fully decoded.
+ */
+static uint32_t filter_types = 0; /*%< bit per dnstap message type */
+static dns_fixedname_t filter_fname;
+static dns_name_t *filter_name = NULL;
+static int filter_rcode = -1;
+static int64_t filter_begin = INT64_MIN;
+static int64_t filter_end = INT64_MAX;
+
+/*%
+ * The short names of the dnstap message types, as printed by
+ * dns_dt_datatotext(), indexed by Dnstap.Message.Type.
+ */
+static const char *const typenames[] = {
+	NULL, "AQ", "AR", "RQ", "RR", "CQ", "CR", "FQ",
+	"FR", "SQ", "SR", "TQ", "TR", "UQ", "UR"
+};
+
+/*%
+ * The fields of a dnstap frame needed to filter it or to print it in
+ * columns, found without unpacking the whole frame.  The regions point
+ * into the frame.
+ */
+typedef struct dtscan {
+	uint32_t type; /*%< Dnstap.Message.Type */
+	bool tcp;
+	bool has_time;
+	uint64_t sec;
+	uint32_t nsec;
+	isc_region_t qaddr;
+	isc_region_t raddr;
+	uint32_t qport;
+	uint32_t rport;
+	isc_region_t msg; /*%< query or response message, per type */
+} dtscan_t;
+
 noreturn static void
 fatal(const char *format, ...);
 
@@ -88,63 +165,53 @@ fatal(const char *format, ...) {
 
 static void
 usage(void) {
-	fprintf(stderr, "dnstap-read [-mpxy] [filename]\n");
+	fprintf(stderr, "dnstap-read [-cmpxy] [-j threads] [-t types] "
+			"[-q name] [-r rcode] [-b time] [-e time] "
+			"[filename]\n");
+	fprintf(stderr, "\t-b\tskip messages before time\n");
+	fprintf(stderr, "\t-c\tprint one line of tab-separated columns per "
+			"message\n");
+	fprintf(stderr, "\t-e\tskip messages from time on\n");
+	fprintf(stderr, "\t-j\tnumber of decoding threads\n");
 	fprintf(stderr, "\t-m\ttrace memory allocations\n");
 	fprintf(stderr, "\t-p\tprint the full DNS message\n");
+	fprintf(stderr, "\t-q\tonly print queries for name or below\n");
+	fprintf(stderr, "\t-r\tonly print messages with rcode\n");
+	fprintf(stderr, "\t-t\tonly print message types (e.g. CQ,CR)\n");
 	fprintf(stderr, "\t-x\tuse hex format to print DNS message\n");
 	fprintf(stderr, "\t-y\tprint YAML format (implies -p)\n");
 }
 
 static void
-print_dtdata(dns_dtdata_t *dt) {
+print_dtdata(dns_dtdata_t *dt, isc_buffer_t *out) {
 	isc_result_t result;
-	isc_buffer_t *b = NULL;
 
-	isc_buffer_allocate(mctx, &b, 2048);
-	if (b == NULL) {
-		fatal("out of memory");
-	}
-
-	CHECKM(dns_dt_datatotext(dt, &b), "dns_dt_datatotext");
-	printf("%.*s\n", (int)isc_buffer_usedlength(b),
-	       (char *)isc_buffer_base(b));
+	CHECKM(dns_dt_datatotext(dt, &out), "dns_dt_datatotext");
+	isc_buffer_putstr(out, "\n");
 
 cleanup:
-	if (b != NULL) {
-		isc_buffer_free(&b);
-	}
+	return;
 }
 
 static void
-print_hex(dns_dtdata_t *dt) {
-	isc_buffer_t *b = NULL;
+print_hex(dns_dtdata_t *dt, isc_buffer_t *out) {
 	isc_result_t result;
-	size_t textlen;
 
 	if (dt->msg == NULL) {
 		return;
 	}
 
-	textlen = (dt->msgdata.length * 2) + 1;
-	isc_buffer_allocate(mctx, &b, textlen);
-	if (b == NULL) {
-		fatal("out of memory");
-	}
-
-	result = isc_hex_totext(&dt->msgdata, 0, "", b);
+	result = isc_hex_totext(&dt->msgdata, 0, "", out);
 	CHECKM(result, "isc_hex_totext");
-
-	printf("%.*s\n", (int)isc_buffer_usedlength(b),
-	       (char *)isc_buffer_base(b));
+	isc_buffer_putstr(out, "\n");
 
 cleanup:
-	if (b != NULL) {
-		isc_buffer_free(&b);
-	}
+	return;
 }
 
 static void
-print_packet(dns_dtdata_t *dt, const dns_master_style_t *style) {
+print_packet(dns_dtdata_t *dt, const dns_master_style_t *style,
+	     isc_buffer_t *out) {
 	isc_buffer_t *b = NULL;
 	isc_result_t result;
 
@@ -168,8 +235,8 @@ print_packet(dns_dtdata_t *dt, const dns_master_style_t *style) {
 				textlen *= 2;
 				continue;
 			} else if (result == ISC_R_SUCCESS) {
-				printf("%.*s", (int)isc_buffer_usedlength(b),
-				       (char *)isc_buffer_base(b));
+				isc_buffer_putmem(out, isc_buffer_base(b),
+						  isc_buffer_usedlength(b));
 				isc_buffer_free(&b);
 			} else {
 				isc_buffer_free(&b);
@@ -185,12 +252,15 @@ cleanup:
 	}
 }
 
+/*
+ * Every YAML document starts with "---"; print_output() drops the
+ * first one.
+ */
 static void
-print_yaml(dns_dtdata_t *dt) {
+print_yaml(dns_dtdata_t *dt, isc_buffer_t *out) {
 	Dnstap__Dnstap *frame = dt->frame;
 	Dnstap__Message *m = frame->message;
 	const ProtobufCEnumValue *ftype, *mtype;
-	static bool first = true;
 
 	ftype = protobuf_c_enum_descriptor_get_value(
 		&dnstap__dnstap__type__descriptor, frame->type);
@@ -198,29 +268,26 @@ print_yaml(dns_dtdata_t *dt) {
 		return;
 	}
 
-	if (!first) {
-		printf("---\n");
-	} else {
-		first = false;
-	}
+	isc_buffer_printf(out, "---\n");
 
-	printf("type: %s\n", ftype->name);
+	isc_buffer_printf(out, "type: %s\n", ftype->name);
 
 	if (frame->has_identity) {
-		printf("identity: %.*s\n", (int)frame->identity.len,
-		       frame->identity.data);
+		isc_buffer_printf(out, "identity: %.*s\n",
+				  (int)frame->identity.len,
+				  frame->identity.data);
 	}
 
 	if (frame->has_version) {
-		printf("version: %.*s\n", (int)frame->version.len,
-		       frame->version.data);
+		isc_buffer_printf(out, "version: %.*s\n",
+				  (int)frame->version.len, frame->version.data);
 	}
 
 	if (frame->type != DNSTAP__DNSTAP__TYPE__MESSAGE) {
 		return;
 	}
 
-	printf("message:\n");
+	isc_buffer_printf(out, "message:\n");
 
 	mtype = protobuf_c_enum_descriptor_get_value(
 		&dnstap__message__type__descriptor, m->type);
@@ -228,24 +295,26 @@ print_yaml(dns_dtdata_t *dt) {
 		return;
 	}
 
-	printf("  type: %s\n", mtype->name);
+	isc_buffer_printf(out, "  type: %s\n", mtype->name);
 
 	if (!isc_time_isepoch(&dt->qtime)) {
 		char buf[100];
 		isc_time_formatISO8601(&dt->qtime, buf, sizeof(buf));
-		printf("  query_time: !!timestamp %s\n", buf);
+		isc_buffer_printf(out, "  query_time: !!timestamp %s\n", buf);
 	}
 
 	if (!isc_time_isepoch(&dt->rtime)) {
 		char buf[100];
 		isc_time_formatISO8601(&dt->rtime, buf, sizeof(buf));
-		printf("  response_time: !!timestamp %s\n", buf);
+		isc_buffer_printf(out, "  response_time: !!timestamp %s\n",
+				  buf);
 	}
 
 	if (dt->msgdata.base != NULL) {
-		printf("  message_size: %zub\n", (size_t)dt->msgdata.length);
+		isc_buffer_printf(out, "  message_size: %zub\n",
+				  (size_t)dt->msgdata.length);
 	} else {
-		printf("  message_size: 0b\n");
+		isc_buffer_printf(out, "  message_size: 0b\n");
 	}
 
 	if (m->has_socket_family) {
@@ -254,11 +323,13 @@ print_yaml(dns_dtdata_t *dt) {
 				&dnstap__socket_family__descriptor,
 				m->socket_family);
 		if (type != NULL) {
-			printf("  socket_family: %s\n", type->name);
+			isc_buffer_printf(out, "  socket_family: %s\n",
+					  type->name);
 		}
 	}
 
-	printf("  socket_protocol: %s\n", dt->tcp ? "TCP" : "UDP");
+	isc_buffer_printf(out, "  socket_protocol: %s\n",
+			  dt->tcp ? "TCP" : "UDP");
 
 	if (m->has_query_address) {
 		ProtobufCBinaryData *ip = &m->query_address;
@@ -266,7 +337,7 @@ print_yaml(dns_dtdata_t *dt) {
 
 		(void)inet_ntop(ip->len == 4 ? AF_INET : AF_INET6, ip->data,
 				buf, sizeof(buf));
-		printf("  query_address: \"%s\"\n", buf);
+		isc_buffer_printf(out, "  query_address: \"%s\"\n", buf);
 	}
 
 	if (m->has_response_address) {
@@ -275,15 +346,16 @@ print_yaml(dns_dtdata_t *dt) {
 
 		(void)inet_ntop(ip->len == 4 ? AF_INET : AF_INET6, ip->data,
 				buf, sizeof(buf));
-		printf("  response_address: \"%s\"\n", buf);
+		isc_buffer_printf(out, "  response_address: \"%s\"\n", buf);
 	}
 
 	if (m->has_query_port) {
-		printf("  query_port: %u\n", m->query_port);
+		isc_buffer_printf(out, "  query_port: %u\n", m->query_port);
 	}
 
 	if (m->has_response_port) {
-		printf("  response_port: %u\n", m->response_port);
+		isc_buffer_printf(out, "  response_port: %u\n",
+				  m->response_port);
 	}
 
 	if (m->has_query_zone) {
@@ -301,39 +373,589 @@ print_yaml(dns_dtdata_t *dt) {
 		dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_NONE);
 		result = dns_name_fromwire(name, &b, &dctx, 0, NULL);
 		if (result == ISC_R_SUCCESS) {
-			printf("  query_zone: ");
-			dns_name_print(name, stdout);
-			printf("\n");
+			isc_buffer_printf(out, "  query_zone: ");
+			(void)dns_name_totext(name, false, out);
+			isc_buffer_printf(out, "\n");
 		}
 	}
 
 	if (dt->msg != NULL) {
 		dt->msg->indent.count = 2;
 		dt->msg->indent.string = "  ";
-		printf("  %s:\n", ((dt->type & DNS_DTTYPE_QUERY) != 0)
+		isc_buffer_printf(out, "  %s:\n",
+				  ((dt->type & DNS_DTTYPE_QUERY) != 0)
 					  ? "query_message_data"
 					  : "response_message_data");
 
-		print_packet(dt, &dns_master_style_yaml);
+		print_packet(dt, &dns_master_style_yaml, out);
+
+		isc_buffer_printf(out, "  %s: |\n",
+				  ((dt->type & DNS_DTTYPE_QUERY) != 0)
+					  ? "query_message"
+					  : "response_message");
+		print_packet(dt, &dns_master_style_indent, out);
+	}
+}
+
+/*
+ * Minimal protobuf decoding, enough to find the fields in dtscan_t.
+ */
+
+static bool
+getvarint(isc_region_t *r, uint64_t *valuep) {
+	uint64_t value = 0;
+
+	for (unsigned int shift = 0; shift < 64; shift += 7) {
+		if (r->length == 0) {
+			return (false);
+		}
+		value |= (uint64_t)(r->base[0] & 0x7f) << shift;
+		isc_region_consume(r, 1);
+		if ((r->base[-1] & 0x80) == 0) {
+			*valuep = value;
+			return (true);
+		}
+	}
+	return (false);
+}
+
+/*%
+ * Get the next field from 'r': its number, and either its integer
+ * value or, for length-delimited fields, its contents.
+ */
+static bool
+getfield(isc_region_t *r, uint32_t *fieldp, uint64_t *valuep,
+	 isc_region_t *datap) {
+	uint64_t key, value = 0;
+
+	if (!getvarint(r, &key)) {
+		return (false);
+	}
+
+	switch (key & 0x07) {
+	case 0: /* varint */
+		if (!getvarint(r, &value)) {
+			return (false);
+		}
+		break;
+	case 1: /* 64 bits */
+		if (r->length < 8) {
+			return (false);
+		}
+		for (int i = 7; i >= 0; i--) {
+			value = (value << 8) | r->base[i];
+		}
+		isc_region_consume(r, 8);
+		break;
+	case 2: /* length-delimited */
+		if (!getvarint(r, &value) || value > r->length) {
+			return (false);
+		}
+		datap->base = r->base;
+		datap->length = value;
+		isc_region_consume(r, value);
+		break;
+	case 5: /* 32 bits */
+		if (r->length < 4) {
+			return (false);
+		}
+		for (int i = 3; i >= 0; i--) {
+			value = (value << 8) | r->base[i];
+		}
+		isc_region_consume(r, 4);
+		break;
+	default:
+		return (false);
+	}
+
+	*fieldp = key >> 3;
+	*valuep = value;
+	return (true);
+}
+
+static bool
+scan_message(isc_region_t r, dtscan_t *scan) {
+	isc_region_t data, qmsg = { NULL, 0 }, rmsg = { NULL, 0 };
+	uint64_t value, qsec = 0, rsec = 0;
+	uint32_t field, qnsec = 0, rnsec = 0;
+	bool has_qtime = false, has_rtime = false;
+
+	while (r.length > 0) {
+		if (!getfield(&r, &field, &value, &data)) {
+			return (false);
+		}
+		switch (field) {
+		case 1:
+			scan->type = value;
+			break;
+		case 3:
+			scan->tcp = (value == DNSTAP__SOCKET_PROTOCOL__TCP);
+			break;
+		case 4:
+			scan->qaddr = data;
+			break;
+		case 5:
+			scan->raddr = data;
+			break;
+		case 6:
+			scan->qport = value;
+			break;
+		case 7:
+			scan->rport = value;
+			break;
+		case 8:
+			qsec = value;
+			has_qtime = true;
+			break;
+		case 9:
+			qnsec = value;
+			break;
+		case 10:
+			qmsg = data;
+			break;
+		case 12:
+			rsec = value;
+			has_rtime = true;
+			break;
+		case 13:
+			rnsec = value;
+			break;
+		case 14:
+			rmsg = data;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (scan->type == 0 || scan->type >= ARRAY_SIZE(typenames)) {
+		return (false);
+	}
 
-		printf("  %s: |\n", ((dt->type & DNS_DTTYPE_QUERY) != 0)
-					    ? "query_message"
-					    : "response_message");
-		print_packet(dt, &dns_master_style_indent);
+	/* As in dns_dt_parse(), odd types are queries. */
+	if ((scan->type & 1) != 0) {
+		scan->has_time = has_qtime;
+		scan->sec = qsec;
+		scan->nsec = qnsec;
+		scan->msg = qmsg;
+	} else {
+		scan->has_time = has_rtime;
+		scan->sec = rsec;
+		scan->nsec = rnsec;
+		scan->msg = rmsg;
+	}
+	return (true);
+}
+
+/*%
+ * Find the fields of a Dnstap message frame; return false for other
+ * frames, which dns_dt_parse() rejects too.
+ */
+static bool
+scan_frame(isc_region_t r, dtscan_t *scan) {
+	isc_region_t data, message = { NULL, 0 };
+	uint64_t value, type = 0;
+	uint32_t field;
+
+	memset(scan, 0, sizeof(*scan));
+
+	while (r.length > 0) {
+		if (!getfield(&r, &field, &value, &data)) {
+			return (false);
+		}
+		if (field == 15) {
+			type = value;
+		} else if (field == 14) {
+			message = data;
+		}
+	}
+
+	if (type != DNSTAP__DNSTAP__TYPE__MESSAGE || message.base == NULL) {
+		return (false);
+	}
+	return (scan_message(message, scan));
+}
+
+/*%
+ * Get the question name from the message in 'scan' into 'name', and
+ * its type and class; return false if there is none.
+ */
+static bool
+get_question(const dtscan_t *scan, dns_name_t *name, uint16_t *typep,
+	     uint16_t *classp) {
+	isc_buffer_t b;
+	dns_decompress_t dctx;
+
+	if (scan->msg.length < DNS_MESSAGE_HEADERLEN ||
+	    (scan->msg.base[4] == 0 && scan->msg.base[5] == 0))
+	{
+		return (false);
+	}
+
+	isc_buffer_init(&b, scan->msg.base, scan->msg.length);
+	isc_buffer_add(&b, scan->msg.length);
+	isc_buffer_forward(&b, DNS_MESSAGE_HEADERLEN);
+
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_NONE);
+	if (dns_name_fromwire(name, &b, &dctx, 0, NULL) != ISC_R_SUCCESS ||
+	    isc_buffer_remaininglength(&b) < 4)
+	{
+		return (false);
+	}
+	*typep = isc_buffer_getuint16(&b);
+	*classp = isc_buffer_getuint16(&b);
+	return (true);
+}
+
+static bool
+filter(const dtscan_t *scan) {
+	if (filter_types != 0 && (filter_types & (1 << scan->type)) == 0) {
+		return (false);
+	}
+
+	if (filter_begin != INT64_MIN || filter_end != INT64_MAX) {
+		if (!scan->has_time || (int64_t)scan->sec < filter_begin ||
+		    (int64_t)scan->sec >= filter_end)
+		{
+			return (false);
+		}
+	}
+
+	if (filter_rcode >= 0) {
+		if (scan->msg.length < DNS_MESSAGE_HEADERLEN ||
+		    (scan->msg.base[3] & 0x0f) != filter_rcode)
+		{
+			return (false);
+		}
+	}
+
+	if (filter_name != NULL) {
+		dns_fixedname_t fn;
+		dns_name_t *name = dns_fixedname_initname(&fn);
+		uint16_t type, class;
+
+		if (!get_question(scan, name, &type, &class) ||
+		    !dns_name_issubdomain(name, filter_name))
+		{
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+static void
+print_addr(const isc_region_t *addr, isc_buffer_t *out) {
+	char buf[64];
+
+	if ((addr->length == 4 &&
+	     inet_ntop(AF_INET, addr->base, buf, sizeof(buf)) != NULL) ||
+	    (addr->length == 16 &&
+	     inet_ntop(AF_INET6, addr->base, buf, sizeof(buf)) != NULL))
+	{
+		isc_buffer_putstr(out, buf);
+	} else {
+		isc_buffer_putstr(out, "-");
+	}
+}
+
+/*%
+ * Print one line of tab-separated columns, in the order given by
+ * COLUMNS; missing values are printed as "-".
+ */
+#define COLUMNS                                                      \
+	"time\ttype\tprotocol\tquery_address\tquery_port\t"          \
+	"response_address\tresponse_port\tid\tflags\trcode\tqname\t" \
+	"qclass\tqtype\tsize\n"
+
+static void
+print_columns(const dtscan_t *scan, isc_buffer_t *out) {
+	dns_fixedname_t fn;
+	dns_name_t *name = dns_fixedname_initname(&fn);
+	uint16_t type, class;
+	const unsigned char *msg = scan->msg.base;
+
+	if (scan->has_time) {
+		isc_buffer_printf(out, "%" PRIu64 ".%06u\t", scan->sec,
+				  scan->nsec / 1000);
+	} else {
+		isc_buffer_putstr(out, "-\t");
+	}
+	isc_buffer_printf(out, "%s\t%s\t", typenames[scan->type],
+			  scan->tcp ? "TCP" : "UDP");
+	print_addr(&scan->qaddr, out);
+	isc_buffer_printf(out, "\t%u\t", scan->qport);
+	print_addr(&scan->raddr, out);
+	isc_buffer_printf(out, "\t%u\t", scan->rport);
+
+	if (scan->msg.length >= DNS_MESSAGE_HEADERLEN) {
+		isc_buffer_printf(out, "%u\t%u\t%u\t", (msg[0] << 8) | msg[1],
+				  (msg[2] << 8) | msg[3], msg[3] & 0x0f);
+	} else {
+		isc_buffer_putstr(out, "-\t-\t-\t");
+	}
+
+	if (get_question(scan, name, &type, &class)) {
+		(void)dns_name_totext(name, false, out);
+		isc_buffer_putstr(out, "\t");
+		(void)dns_rdataclass_totext(class, out);
+		isc_buffer_putstr(out, "\t");
+		(void)dns_rdatatype_totext(type, out);
+		isc_buffer_putstr(out, "\t");
+	} else {
+		isc_buffer_putstr(out, "-\t-\t-\t");
+	}
+
+	isc_buffer_printf(out, "%u\n", scan->msg.length);
+}
+
+static void
+process_frame(isc_region_t *input, isc_buffer_t *out) {
+	isc_result_t result;
+	dns_dtdata_t *dt = NULL;
+	dtscan_t scan;
+
+	if (!scan_frame(*input, &scan) || !filter(&scan)) {
+		return;
+	}
+
+	if (columns) {
+		print_columns(&scan, out);
+		return;
+	}
+
+	result = dns_dt_parse(mctx, input, &dt);
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	if (yaml) {
+		print_yaml(dt, out);
+	} else if (hexmessage) {
+		print_dtdata(dt, out);
+		print_hex(dt, out);
+	} else if (printmessage) {
+		print_dtdata(dt, out);
+		print_packet(dt, &dns_master_style_debug, out);
+	} else {
+		print_dtdata(dt, out);
+	}
+
+	dns_dtdata_free(&dt);
+}
+
+static void
+process_chunk(chunk_t *chunk) {
+	isc_buffer_t *in = chunk->in;
+
+	while (isc_buffer_remaininglength(in) > 0) {
+		isc_region_t input;
+
+		input.length = isc_buffer_getuint32(in);
+		input.base = isc_buffer_current(in);
+		isc_buffer_forward(in, input.length);
+
+		process_frame(&input, chunk->out);
+	}
+}
+
+static isc_threadresult_t
+worker(isc_threadarg_t arg) {
+	UNUSED(arg);
+
+	LOCK(&lock);
+	for (;;) {
+		chunk_t *chunk = &chunks[next_work % nchunks];
+
+		if (chunk->state != chunk_filled) {
+			if (reading_done) {
+				break;
+			}
+			WAIT(&cond, &lock);
+			continue;
+		}
+
+		chunk->state = chunk_working;
+		next_work++;
+		UNLOCK(&lock);
+
+		process_chunk(chunk);
+
+		LOCK(&lock);
+		chunk->state = chunk_done;
+		BROADCAST(&cond);
+	}
+	UNLOCK(&lock);
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+print_output(chunk_t *chunk) {
+	static bool first = true;
+	isc_region_t r;
+
+	isc_buffer_usedregion(chunk->out, &r);
+	if (yaml && first && r.length != 0) {
+		/* Drop the leading "---". */
+		isc_region_consume(&r, 4);
+		first = false;
+	}
+	if (r.length != 0) {
+		(void)fwrite(r.base, 1, r.length, stdout);
+	}
+}
+
+/*%
+ * Read the next chunk of frames; return false at the end of the input.
+ */
+static bool
+read_chunk(dns_dthandle_t *handle, chunk_t *chunk) {
+	isc_result_t result;
+	unsigned int nframes = 0;
+
+	isc_buffer_clear(chunk->in);
+	isc_buffer_clear(chunk->out);
+
+	while (nframes < CHUNK_FRAMES &&
+	       isc_buffer_usedlength(chunk->in) < CHUNK_SIZE)
+	{
+		uint8_t *data = NULL;
+		size_t datalen;
+
+		result = dns_dt_getframe(handle, &data, &datalen);
+		if (result == ISC_R_NOMORE) {
+			break;
+		} else if (result != ISC_R_SUCCESS) {
+			fprintf(stderr, "%s: dns_dt_getframe: %s\n", program,
+				isc_result_totext(result));
+			break;
+		}
+
+		isc_buffer_putuint32(chunk->in, datalen);
+		isc_buffer_putmem(chunk->in, data, datalen);
+		nframes++;
+	}
+
+	return (nframes != 0);
+}
+
+/*%
+ * Fill the chunks in turn from the input and print them in the same
+ * order as the workers finish them.
+ */
+static void
+run(dns_dthandle_t *handle) {
+	uint64_t next_read = 0, next_print = 0;
+
+	LOCK(&lock);
+	for (;;) {
+		chunk_t *chunk = &chunks[next_print % nchunks];
+
+		if (next_print < next_read && chunk->state == chunk_done) {
+			UNLOCK(&lock);
+			print_output(chunk);
+			LOCK(&lock);
+			chunk->state = chunk_free;
+			next_print++;
+			continue;
+		}
+
+		chunk = &chunks[next_read % nchunks];
+		if (!reading_done && chunk->state == chunk_free) {
+			bool more;
+
+			UNLOCK(&lock);
+			more = read_chunk(handle, chunk);
+			LOCK(&lock);
+			if (more) {
+				chunk->state = chunk_filled;
+				next_read++;
+			} else {
+				reading_done = true;
+			}
+			BROADCAST(&cond);
+			continue;
+		}
+
+		if (reading_done && next_print == next_read) {
+			break;
+		}
+		WAIT(&cond, &lock);
+	}
+	UNLOCK(&lock);
+}
+
+static void
+parse_time(const char *str, int64_t *timep) {
+	isc_result_t result;
+	uint32_t secs;
+
+	if (strlen(str) == 14) {
+		result = dns_time64_fromtext(str, timep);
+	} else {
+		result = isc_parse_uint32(&secs, str, 10);
+		*timep = secs;
+	}
+	if (result != ISC_R_SUCCESS) {
+		fatal("invalid time '%s': use YYYYMMDDHHMMSS or seconds "
+		      "since the epoch",
+		      str);
+	}
+}
+
+static void
+parse_types(char *str) {
+	char *type, *last = NULL;
+
+	for (type = strtok_r(str, ",", &last); type != NULL;
+	     type = strtok_r(NULL, ",", &last))
+	{
+		size_t i;
+
+		for (i = 1; i < ARRAY_SIZE(typenames); i++) {
+			if (strcasecmp(type, typenames[i]) == 0) {
+				filter_types |= 1 << i;
+				break;
+			}
+		}
+		if (i == ARRAY_SIZE(typenames)) {
+			fatal("unknown message type '%s'", type);
+		}
 	}
 }
 
 int
 main(int argc, char *argv[]) {
 	isc_result_t result;
-	dns_message_t *message = NULL;
-	isc_buffer_t *b = NULL;
-	dns_dtdata_t *dt = NULL;
 	dns_dthandle_t *handle = NULL;
+	isc_thread_t *threads = NULL;
+	uint32_t nthreads = isc_os_ncpus();
 	int rv = 0, ch;
 
-	while ((ch = isc_commandline_parse(argc, argv, "mpxy")) != -1) {
+	while ((ch = isc_commandline_parse(argc, argv, "b:ce:j:mpq:r:t:xy")) !=
+	       -1)
+	{
 		switch (ch) {
+		case 'b':
+			parse_time(isc_commandline_argument, &filter_begin);
+			break;
+		case 'c':
+			columns = true;
+			break;
+		case 'e':
+			parse_time(isc_commandline_argument, &filter_end);
+			break;
+		case 'j':
+			result = isc_parse_uint32(
+				&nthreads, isc_commandline_argument, 10);
+			if (result != ISC_R_SUCCESS || nthreads == 0 ||
+			    nthreads > MAXTHREADS)
+			{
+				fatal("invalid number of threads '%s'",
+				      isc_commandline_argument);
+			}
+			break;
 		case 'm':
 			isc_mem_debugging |= ISC_MEM_DEBUGRECORD;
 			memrecord = true;
@@ -341,6 +963,34 @@ main(int argc, char *argv[]) {
 		case 'p':
 			printmessage = true;
 			break;
+		case 'q':
+			filter_name = dns_fixedname_initname(&filter_fname);
+			result = dns_name_fromstring(filter_name,
+						     isc_commandline_argument,
+						     0, NULL);
+			if (result != ISC_R_SUCCESS) {
+				fatal("invalid name '%s': %s",
+				      isc_commandline_argument,
+				      isc_result_totext(result));
+			}
+			break;
+		case 'r': {
+			isc_textregion_t tr;
+			dns_rcode_t rcode;
+
+			tr.base = isc_commandline_argument;
+			tr.length = strlen(tr.base);
+			result = dns_rcode_fromtext(&rcode, &tr);
+			if (result != ISC_R_SUCCESS || rcode > 15) {
+				fatal("invalid rcode '%s'",
+				      isc_commandline_argument);
+			}
+			filter_rcode = rcode;
+			break;
+		}
+		case 't':
+			parse_types(isc_commandline_argument);
+			break;
 		case 'x':
 			hexmessage = true;
 			break;
@@ -365,63 +1015,50 @@ main(int argc, char *argv[]) {
 	CHECKM(dns_dt_open(argv[0], dns_dtmode_file, mctx, &handle),
 	       "dns_dt_openfile");
 
-	for (;;) {
-		isc_region_t input;
-		uint8_t *data;
-		size_t datalen;
-
-		result = dns_dt_getframe(handle, &data, &datalen);
-		if (result == ISC_R_NOMORE) {
-			break;
-		} else {
-			CHECKM(result, "dns_dt_getframe");
-		}
+	if (columns) {
+		printf(COLUMNS);
+	}
 
-		input.base = data;
-		input.length = datalen;
+	isc_mutex_init(&lock);
+	isc_condition_init(&cond);
+
+	nchunks = NCHUNKS * nthreads;
+	chunks = isc_mem_get(mctx, nchunks * sizeof(chunks[0]));
+	for (unsigned int i = 0; i < nchunks; i++) {
+		chunks[i].state = chunk_free;
+		chunks[i].in = NULL;
+		chunks[i].out = NULL;
+		isc_buffer_allocate(mctx, &chunks[i].in, CHUNK_SIZE);
+		isc_buffer_setautorealloc(chunks[i].in, true);
+		isc_buffer_allocate(mctx, &chunks[i].out, CHUNK_SIZE);
+		isc_buffer_setautorealloc(chunks[i].out, true);
+	}
 
-		if (b != NULL) {
-			isc_buffer_free(&b);
-		}
-		isc_buffer_allocate(mctx, &b, 2048);
-		if (b == NULL) {
-			fatal("out of memory");
-		}
+	threads = isc_mem_get(mctx, nthreads * sizeof(threads[0]));
+	for (unsigned int i = 0; i < nthreads; i++) {
+		isc_thread_create(worker, NULL, &threads[i]);
+	}
 
-		result = dns_dt_parse(mctx, &input, &dt);
-		if (result != ISC_R_SUCCESS) {
-			isc_buffer_free(&b);
-			continue;
-		}
+	run(handle);
 
-		if (yaml) {
-			print_yaml(dt);
-		} else if (hexmessage) {
-			print_dtdata(dt);
-			print_hex(dt);
-		} else if (printmessage) {
-			print_dtdata(dt);
-			print_packet(dt, &dns_master_style_debug);
-		} else {
-			print_dtdata(dt);
-		}
+	for (unsigned int i = 0; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	isc_mem_put(mctx, threads, nthreads * sizeof(threads[0]));
 
-		dns_dtdata_free(&dt);
+	for (unsigned int i = 0; i < nchunks; i++) {
+		isc_buffer_free(&chunks[i].in);
+		isc_buffer_free(&chunks[i].out);
 	}
+	isc_mem_put(mctx, chunks, nchunks * sizeof(chunks[0]));
+
+	isc_condition_destroy(&cond);
+	isc_mutex_destroy(&lock);
 
 cleanup:
-	if (dt != NULL) {
-		dns_dtdata_free(&dt);
-	}
 	if (handle != NULL) {
 		dns_dt_close(&handle);
 	}
-	if (message != NULL) {
-		dns_message_detach(&message);
-	}
-	if (b != NULL) {
-		isc_buffer_free(&b);
-	}
 	isc_mem_destroy(&mctx);
 
 	exit(rv);
@@ -15,16 +15,21 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <isc/app.h>
+#include <isc/atomic.h>
 #include <isc/attributes.h>
 #include <isc/base64.h>
+#include <isc/condition.h>
+#include <isc/event.h>
 #include <isc/hash.h>
 #include <isc/hex.h>
 #include <isc/log.h>
 #include <isc/managers.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/net.h>
 #include <isc/netmgr.h>
 #include <isc/nonce.h>
@@ -37,9 +42,11 @@
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/time.h>
+#include <isc/tls.h>
 #include <isc/util.h>
 
 #include <dns/byaddr.h>
+#include <dns/compress.h>
 #include <dns/dispatch.h>
 #include <dns/events.h>
 #include <dns/fixedname.h>
@@ -84,6 +91,9 @@
 #define TCPTIMEOUT 10
 #define UDPTIMEOUT 5
 #define MAXTRIES   0xffffffff
+#define MAXQPS	   10000000
+#define MAXCLIENTS 256
+#define MAXWORKERS 128
 
 static isc_mem_t *mctx = NULL;
 static dns_requestmgr_t *requestmgr = NULL;
@@ -119,6 +129,17 @@ static in_port_t port = 53;
 static unsigned char cookie_secret[33];
 static int onfly = 0;
 static char hexcookie[81];
+static bool port_set = false;
+static bool tls_mode = false;
+static bool https_mode = false;
+static bool https_get = false;
+#if HAVE_LIBNGHTTP2
+static const char *https_path = ISC_NM_HTTP_DEFAULT_PATH;
+#endif /* HAVE_LIBNGHTTP2 */
+static uint32_t nworkers = 1;
+static uint32_t bench_qps = 0;
+static uint32_t bench_duration = 10;
+static uint32_t bench_clients = 1;
 
 struct query {
 	char textname[MXNAME]; /*% Name we're going to be
@@ -575,18 +596,14 @@ compute_cookie(unsigned char *cookie, size_t len) {
 	memmove(cookie, cookie_secret, 8);
 }
 
-static isc_result_t
-sendquery(struct query *query, isc_task_t *task) {
-	dns_request_t *request = NULL;
+static void
+buildquery(struct query *query, dns_message_t **messagep) {
 	dns_message_t *message = NULL;
 	dns_name_t *qname = NULL;
 	dns_rdataset_t *qrdataset = NULL;
 	isc_result_t result;
 	dns_fixedname_t queryname;
 	isc_buffer_t buf;
-	unsigned int options;
-
-	onfly++;
 
 	dns_fixedname_init(&queryname);
 	isc_buffer_init(&buf, query->textname, strlen(query->textname));
@@ -747,6 +764,20 @@ sendquery(struct query *query, isc_task_t *task) {
 		add_opt(message, query->udpsize, query->edns, flags, opts, i);
 	}
 
+	*messagep = message;
+}
+
+static isc_result_t
+sendquery(struct query *query, isc_task_t *task) {
+	dns_request_t *request = NULL;
+	dns_message_t *message = NULL;
+	isc_result_t result;
+	unsigned int options;
+
+	onfly++;
+
+	buildquery(query, &message);
+
 	options = 0;
 	if (tcp_mode) {
 		options |= DNS_REQUESTOPT_TCP;
@@ -853,6 +884,18 @@ help(void) {
 	       "expanded format)\n"
 	       "                 +[no]split=##       (Split hex/base64 fields "
 	       "into chunks)\n"
+	       "                 +qps=###            (Benchmark: send the "
+	       "queries at ### per second)\n"
+	       "                 +duration=###       (Benchmark length in "
+	       "seconds) [10]\n"
+	       "                 +clients=###        (Benchmark connections) "
+	       "[1]\n"
+	       "                 +workers=###        (Network threads) [1]\n"
+	       "                 +[no]tls            (Benchmark over DoT)\n"
+	       "                 +[no]https[=###]    (Benchmark over DoH "
+	       "using POST)\n"
+	       "                 +[no]https-get[=###] (Benchmark over DoH "
+	       "using GET)\n"
 	       " local opt       is one of:\n"
 	       "                 -c class            (specify query class)\n"
 	       "                 -t type             (specify query type)\n"
@@ -1260,10 +1303,32 @@ plus_option(char *option, struct query *query, bool global) {
 				goto invalid_option;
 			}
 			break;
-		case 'l': /* cl */
-			FULLCHECK("cl");
-			GLOBAL();
-			display_class = state;
+		case 'l':
+			switch (cmd[2]) {
+			case '\0': /* cl */
+				FULLCHECK("cl");
+				GLOBAL();
+				display_class = state;
+				break;
+			case 'i': /* clients */
+				FULLCHECK("clients");
+				GLOBAL();
+				if (value == NULL) {
+					goto need_value;
+				}
+				if (!state) {
+					goto invalid_option;
+				}
+				result = parse_uint(&bench_clients, value,
+						    MAXCLIENTS, "clients");
+				CHECK("parse_uint(clients)", result);
+				if (bench_clients == 0) {
+					bench_clients = 1;
+				}
+				break;
+			default:
+				goto invalid_option;
+			}
 			break;
 		case 'o': /* comments */
 			switch (cmd[2]) {
@@ -1322,6 +1387,22 @@ plus_option(char *option, struct query *query, bool global) {
 			fprintf(stderr, ";; +dscp option is obsolete "
 					"and has no effect");
 			break;
+		case 'u': /* duration */
+			FULLCHECK("duration");
+			GLOBAL();
+			if (value == NULL) {
+				goto need_value;
+			}
+			if (!state) {
+				goto invalid_option;
+			}
+			result = parse_uint(&bench_duration, value, MAXTIMEOUT,
+					    "duration");
+			CHECK("parse_uint(duration)", result);
+			if (bench_duration == 0) {
+				bench_duration = 1;
+			}
+			break;
 		default:
 			goto invalid_option;
 		}
@@ -1409,6 +1490,19 @@ plus_option(char *option, struct query *query, bool global) {
 			goto invalid_option;
 		}
 		break;
+	case 'h': /* https, https-get */
+		FULLCHECK2("https", "https-get");
+		GLOBAL();
+#if HAVE_LIBNGHTTP2
+		https_mode = state;
+		https_get = (strchr(cmd, '-') != NULL);
+		if (value != NULL) {
+			https_path = value;
+		}
+#else
+		fprintf(stderr, ";; DoH support not enabled\n");
+#endif /* HAVE_LIBNGHTTP2 */
+		break;
 	case 'm': /* multiline */
 		FULLCHECK("multiline");
 		GLOBAL();
@@ -1422,9 +1516,28 @@ plus_option(char *option, struct query *query, bool global) {
 		query->nsid = state;
 		break;
 	case 'q':
-		FULLCHECK("question");
-		GLOBAL();
-		display_question = state;
+		switch (cmd[1]) {
+		case 'p': /* qps */
+			FULLCHECK("qps");
+			GLOBAL();
+			if (!state) {
+				bench_qps = 0;
+				break;
+			}
+			if (value == NULL) {
+				goto need_value;
+			}
+			result = parse_uint(&bench_qps, value, MAXQPS, "qps");
+			CHECK("parse_uint(qps)", result);
+			break;
+		case 'u': /* question */
+			FULLCHECK("question");
+			GLOBAL();
+			display_question = state;
+			break;
+		default:
+			goto invalid_option;
+		}
 		break;
 	case 'r':
 		switch (cmd[1]) {
@@ -1554,6 +1667,11 @@ plus_option(char *option, struct query *query, bool global) {
 				query->timeout = 1;
 			}
 			break;
+		case 'l': /* tls */
+			FULLCHECK("tls");
+			GLOBAL();
+			tls_mode = state;
+			break;
 		case 'r':
 			FULLCHECK("tries");
 			if (value == NULL) {
@@ -1624,6 +1742,21 @@ plus_option(char *option, struct query *query, bool global) {
 		GLOBAL();
 		tcp_mode = state;
 		break;
+	case 'w': /* workers */
+		FULLCHECK("workers");
+		GLOBAL();
+		if (value == NULL) {
+			goto need_value;
+		}
+		if (!state) {
+			goto invalid_option;
+		}
+		result = parse_uint(&nworkers, value, MAXWORKERS, "workers");
+		CHECK("parse_uint(workers)", result);
+		if (nworkers == 0) {
+			nworkers = 1;
+		}
+		break;
 	case 'y': /* yaml */
 		FULLCHECK("yaml");
 		yaml = state;
@@ -1779,6 +1912,7 @@ dash_option(const char *option, char *next, struct query *query, bool global,
 		result = parse_uint(&num, value, MAXPORT, "port number");
 		CHECK("parse_uint(port)", result);
 		port = num;
+		port_set = true;
 		return (value_from_next);
 	case 't':
 		tr.base = value;
@@ -1821,7 +1955,9 @@ clone_default_query(void) {
 	}
 
 	if (query->timeout == 0) {
-		query->timeout = tcp_mode ? TCPTIMEOUT : UDPTIMEOUT;
+		query->timeout = (tcp_mode || tls_mode || https_mode)
+					 ? TCPTIMEOUT
+					 : UDPTIMEOUT;
 	}
 
 	return (query);
@@ -2046,6 +2182,602 @@ parse_args(bool is_batchfile, int argc, char **argv) {
 	}
 }
 
+/*
+ * Benchmark mode (+qps): the queries are rendered once and replayed
+ * in a loop at a fixed rate for a fixed time, round robin over the
+ * connections, whether or not the server keeps up.  Latency is measured
+ * from the time each query was due to be sent, so queueing on our side
+ * shows up in the results instead of slowing down the load.
+ */
+
+#define BENCH_EVENTCLASS ISC_EVENTCLASS(0x4D44)
+#define BENCH_EVENT_SEND (BENCH_EVENTCLASS + 0)
+#define BENCH_EVENT_STOP (BENCH_EVENTCLASS + 1)
+
+/*%
+ * Minimum time, in microseconds, the sending loop sleeps; queries that
+ * fall due meanwhile are sent together.
+ */
+#define BENCH_TICK 100
+
+/*%
+ * Latencies, in microseconds, are counted in a histogram with HDR-style
+ * buckets: values below 2^HIST_SUBBITS get a bucket each, and every
+ * larger power of two is split into HIST_HALF buckets, which keeps the
+ * relative error under 2%.
+ */
+#define HIST_SUBBITS 7
+#define HIST_HALF    (1 << (HIST_SUBBITS - 1))
+#define HIST_BUCKETS ((64 - HIST_SUBBITS + 2) * HIST_HALF)
+
+typedef struct benchconn {
+	unsigned int index;
+	int tid;
+	isc_nmhandle_t *handle;
+	isc_task_t *task;
+	uint16_t nextid;
+	bool dead;
+	bool busy; /*%< DoH: a query is in flight */
+	/*%
+	 * When each outstanding query was due, in nanoseconds since the
+	 * start plus one, indexed by query ID; zero if there is none.
+	 * Only used from the connection's thread.
+	 */
+	uint64_t due[65536];
+} benchconn_t;
+
+typedef struct benchevent {
+	ISC_EVENT_COMMON(struct benchevent);
+	uint64_t first;
+	uint64_t last;
+} benchevent_t;
+
+typedef struct benchmsg {
+	isc_region_t region;
+	unsigned char data[];
+} benchmsg_t;
+
+static isc_region_t *bench_wire = NULL;
+static size_t bench_nwire = 0;
+static benchconn_t **bench_conns = NULL;
+static isc_tlsctx_t *bench_tlsctx = NULL;
+static isc_mutex_t bench_lock;
+static isc_condition_t bench_cond;
+static unsigned int bench_connected = 0;
+static unsigned int bench_failed = 0;
+static uint64_t bench_start = 0;
+static uint64_t bench_elapsed = 0;
+static atomic_bool bench_stopping = false;
+static atomic_uint_fast64_t bench_sent = 0;
+static atomic_uint_fast64_t bench_notsent = 0;
+static atomic_uint_fast64_t bench_received = 0;
+static atomic_uint_fast64_t bench_lost = 0;
+static atomic_uint_fast64_t bench_unexpected = 0;
+static atomic_uint_fast64_t bench_senderrors = 0;
+static atomic_uint_fast64_t bench_latency = 0;
+static atomic_uint_fast64_t bench_rcodes[16];
+static atomic_uint_fast64_t bench_hist[HIST_BUCKETS];
+
+static uint64_t
+bench_now(void) {
+	struct timespec ts;
+
+	RUNTIME_CHECK(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+	return ((uint64_t)ts.tv_sec * NS_PER_SEC + ts.tv_nsec);
+}
+
+/*%
+ * When the query with sequence number 'i' is due, in nanoseconds since
+ * the start.
+ */
+static uint64_t
+bench_due(uint64_t i) {
+	return (i / bench_qps * NS_PER_SEC +
+		i % bench_qps * NS_PER_SEC / bench_qps);
+}
+
+/*%
+ * The first query from sequence number 'first' on that goes to
+ * connection 'index'; its next ones follow every 'bench_clients'.
+ */
+static uint64_t
+bench_first(uint64_t first, unsigned int index) {
+	return (first + (index + bench_clients - first % bench_clients) %
+				bench_clients);
+}
+
+static size_t
+hist_index(uint64_t value) {
+	unsigned int shift;
+
+	if (value < 2 * HIST_HALF) {
+		return (value);
+	}
+	shift = 64 - __builtin_clzll(value) - HIST_SUBBITS;
+	return (shift * HIST_HALF + (value >> shift));
+}
+
+/*%
+ * The largest value counted in bucket 'index'.
+ */
+static uint64_t
+hist_value(size_t index) {
+	unsigned int shift;
+
+	if (index < 2 * HIST_HALF) {
+		return (index);
+	}
+	shift = index / HIST_HALF - 1;
+	return (((index - shift * HIST_HALF + 1) << shift) - 1);
+}
+
+static void
+bench_render(struct query *query, isc_region_t *wire) {
+	dns_message_t *message = NULL;
+	dns_compress_t cctx;
+	isc_buffer_t b;
+	unsigned char data[COMMSIZE];
+	isc_result_t result;
+
+	buildquery(query, &message);
+
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_compress_init(&cctx, -1, mctx);
+	CHECK("dns_compress_init", result);
+	result = dns_message_renderbegin(message, &cctx, &b);
+	CHECK("dns_message_renderbegin", result);
+	result = dns_message_rendersection(message, DNS_SECTION_QUESTION, 0);
+	CHECK("dns_message_rendersection", result);
+	result = dns_message_rendersection(message, DNS_SECTION_ADDITIONAL, 0);
+	CHECK("dns_message_rendersection", result);
+	result = dns_message_renderend(message);
+	CHECK("dns_message_renderend", result);
+	dns_compress_invalidate(&cctx);
+
+	wire->length = isc_buffer_usedlength(&b);
+	wire->base = isc_mem_get(mctx, wire->length);
+	memmove(wire->base, data, wire->length);
+
+	dns_message_detach(&message);
+}
+
+static void
+bench_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
+	   void *arg) {
+	benchconn_t *conn = (benchconn_t *)arg;
+	uint64_t now = bench_now() - bench_start;
+	uint64_t due, usecs;
+	uint16_t id;
+
+	if (eresult != ISC_R_SUCCESS) {
+		if (!atomic_load(&bench_stopping)) {
+			fprintf(stderr, ";; connection %u: %s\n", conn->index,
+				isc_result_totext(eresult));
+		}
+		conn->dead = true;
+		return;
+	}
+
+	if (region->length < DNS_MESSAGE_HEADERLEN) {
+		atomic_fetch_add_relaxed(&bench_unexpected, 1);
+		goto next;
+	}
+
+	id = (region->base[0] << 8) | region->base[1];
+	due = conn->due[id];
+	if (due == 0) {
+		atomic_fetch_add_relaxed(&bench_unexpected, 1);
+		goto next;
+	}
+	conn->due[id] = 0;
+
+	usecs = (now - ISC_MIN(now, due - 1)) / NS_PER_US;
+	atomic_fetch_add_relaxed(&bench_hist[hist_index(usecs)], 1);
+	atomic_fetch_add_relaxed(&bench_latency, usecs);
+	atomic_fetch_add_relaxed(&bench_rcodes[region->base[3] & 0x0f], 1);
+	atomic_fetch_add_release(&bench_received, 1);
+
+next:
+	isc_nm_read(handle, bench_recv, conn);
+	conn->busy = false;
+}
+
+static void
+bench_senddone(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
+	benchmsg_t *msg = (benchmsg_t *)arg;
+
+	UNUSED(handle);
+
+	if (eresult != ISC_R_SUCCESS) {
+		atomic_fetch_add_relaxed(&bench_senderrors, 1);
+	}
+	isc_mem_put(mctx, msg, sizeof(*msg) + msg->region.length);
+}
+
+/*%
+ * Send the queries from event->first to event->last that go to this
+ * connection.  Runs on the connection's own thread.
+ */
+static void
+bench_send(isc_task_t *task, isc_event_t *event) {
+	benchevent_t *bevent = (benchevent_t *)event;
+	benchconn_t *conn = (benchconn_t *)event->ev_arg;
+	uint64_t i;
+
+	UNUSED(task);
+
+	for (i = bench_first(bevent->first, conn->index); i < bevent->last;
+	     i += bench_clients)
+	{
+		const isc_region_t *wire = &bench_wire[i % bench_nwire];
+		benchmsg_t *msg = NULL;
+		uint16_t id;
+
+		if (conn->dead || conn->busy) {
+			atomic_fetch_add_relaxed(&bench_notsent, 1);
+			continue;
+		}
+
+		id = conn->nextid++;
+		if (conn->due[id] != 0) {
+			/* Still unanswered 65536 queries later. */
+			atomic_fetch_add_relaxed(&bench_lost, 1);
+		}
+		conn->due[id] = bench_due(i) + 1;
+
+		msg = isc_mem_get(mctx, sizeof(*msg) + wire->length);
+		memmove(msg->data, wire->base, wire->length);
+		msg->data[0] = id >> 8;
+		msg->data[1] = id & 0xff;
+		msg->region.base = msg->data;
+		msg->region.length = wire->length;
+
+		/*
+		 * A DoH connection carries one query at a time.
+		 */
+		conn->busy = https_mode;
+
+		atomic_fetch_add_release(&bench_sent, 1);
+		isc_nm_send(conn->handle, &msg->region, bench_senddone, msg);
+	}
+
+	isc_event_free(&event);
+}
+
+static void
+bench_stop(isc_task_t *task, isc_event_t *event) {
+	benchconn_t *conn = (benchconn_t *)event->ev_arg;
+
+	UNUSED(task);
+
+	conn->dead = true;
+	isc_nmhandle_detach(&conn->handle);
+	isc_event_free(&event);
+}
+
+static void
+bench_connected_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
+	benchconn_t *conn = (benchconn_t *)arg;
+
+	LOCK(&bench_lock);
+	if (eresult == ISC_R_SUCCESS) {
+		conn->tid = isc_nm_tid();
+		isc_nmhandle_attach(handle, &conn->handle);
+		/*
+		 * Lost queries are counted at the end, so the read timeout
+		 * only has to catch a server that stops answering at all.
+		 */
+		isc_nmhandle_settimeout(handle,
+					(bench_duration + MAXTIMEOUT) * 1000U);
+		isc_nm_read(handle, bench_recv, conn);
+		bench_connected++;
+	} else {
+		fprintf(stderr, ";; connection %u failed: %s\n", conn->index,
+			isc_result_totext(eresult));
+		conn->dead = true;
+		bench_failed++;
+	}
+	SIGNAL(&bench_cond);
+	UNLOCK(&bench_lock);
+}
+
+static void
+bench_connect(isc_nm_t *netmgr, benchconn_t *conn, unsigned int timeout) {
+	isc_sockaddr_t local;
+
+	if (have_src) {
+		local = srcaddr;
+	} else if (isc_sockaddr_pf(&dstaddr) == PF_INET) {
+		isc_sockaddr_any(&local);
+	} else {
+		isc_sockaddr_any6(&local);
+	}
+
+	if (https_mode) {
+#if HAVE_LIBNGHTTP2
+		char uri[4096] = { 0 };
+
+		isc_nm_http_makeuri(true, &dstaddr, NULL, port, https_path,
+				    uri, sizeof(uri));
+		isc_nm_httpconnect(netmgr, &local, &dstaddr, uri, !https_get,
+				   bench_connected_cb, conn, bench_tlsctx, NULL,
+				   timeout, 0);
+#endif /* HAVE_LIBNGHTTP2 */
+	} else if (tls_mode) {
+		isc_nm_tlsdnsconnect(netmgr, &local, &dstaddr,
+				     bench_connected_cb, conn, timeout, 0,
+				     bench_tlsctx, NULL);
+	} else if (tcp_mode) {
+		isc_nm_tcpdnsconnect(netmgr, &local, &dstaddr,
+				     bench_connected_cb, conn, timeout, 0);
+	} else {
+		isc_nm_udpconnect(netmgr, &local, &dstaddr, bench_connected_cb,
+				  conn, timeout, 0);
+	}
+}
+
+static const char *
+bench_transport(void) {
+	if (https_mode) {
+		return (https_get ? "DoH (GET)" : "DoH (POST)");
+	} else if (tls_mode) {
+		return ("DoT");
+	} else if (tcp_mode) {
+		return ("TCP");
+	}
+	return ("UDP");
+}
+
+/*%
+ * Connect, send the queries at the configured rate, and wait for the
+ * last responses.  The results are printed by bench_report() once the
+ * network manager has shut down.
+ */
+static void
+bench_run(isc_nm_t *netmgr, isc_taskmgr_t *taskmgr) {
+	struct query *query = NULL;
+	uint64_t total, posted = 0, now, deadline;
+	unsigned int timeout;
+	size_t i;
+
+	for (query = ISC_LIST_HEAD(queries); query != NULL;
+	     query = ISC_LIST_NEXT(query, link))
+	{
+		bench_nwire++;
+	}
+	if (bench_nwire == 0) {
+		fatal("no queries to send");
+	}
+	bench_wire = isc_mem_get(mctx, bench_nwire * sizeof(bench_wire[0]));
+	i = 0;
+	for (query = ISC_LIST_HEAD(queries); query != NULL;
+	     query = ISC_LIST_NEXT(query, link))
+	{
+		bench_render(query, &bench_wire[i++]);
+	}
+	query = ISC_LIST_HEAD(queries);
+	timeout = query->timeout;
+
+	if (tls_mode || https_mode) {
+		RUNCHECK(isc_tlsctx_createclient(&bench_tlsctx));
+#if HAVE_LIBNGHTTP2
+		if (https_mode) {
+			isc_tlsctx_enable_http2client_alpn(bench_tlsctx);
+		} else
+#endif /* HAVE_LIBNGHTTP2 */
+		{
+			isc_tlsctx_enable_dot_client_alpn(bench_tlsctx);
+		}
+	}
+
+	isc_mutex_init(&bench_lock);
+	isc_condition_init(&bench_cond);
+
+	bench_conns = isc_mem_get(mctx,
+				  bench_clients * sizeof(bench_conns[0]));
+	LOCK(&bench_lock);
+	for (i = 0; i < bench_clients; i++) {
+		bench_conns[i] = isc_mem_get(mctx, sizeof(*bench_conns[i]));
+		memset(bench_conns[i], 0, sizeof(*bench_conns[i]));
+		bench_conns[i]->index = i;
+		bench_connect(netmgr, bench_conns[i], timeout * 1000);
+	}
+	while (bench_connected + bench_failed < bench_clients) {
+		WAIT(&bench_cond, &bench_lock);
+	}
+	UNLOCK(&bench_lock);
+	if (bench_connected == 0) {
+		fatal("couldn't connect to '%s'", server);
+	}
+
+	for (i = 0; i < bench_clients; i++) {
+		benchconn_t *conn = bench_conns[i];
+
+		if (!conn->dead) {
+			RUNCHECK(isc_task_create_bound(taskmgr, 0, &conn->task,
+						       conn->tid));
+		}
+	}
+
+	total = (uint64_t)bench_qps * bench_duration;
+	bench_start = bench_now();
+	while (posted < total) {
+		uint64_t due, next;
+
+		now = bench_now() - bench_start;
+		due = now / NS_PER_SEC * bench_qps +
+		      now % NS_PER_SEC * bench_qps / NS_PER_SEC + 1;
+		due = ISC_MIN(due, total);
+
+		for (i = 0; i < bench_clients && posted < due; i++) {
+			benchconn_t *conn = bench_conns[i];
+			benchevent_t *event = NULL;
+
+			if (conn->task == NULL) {
+				/* Never connected. */
+				uint64_t first = bench_first(posted, i);
+				uint64_t n;
+
+				if (first < due) {
+					n = (due - first - 1) / bench_clients;
+					atomic_fetch_add_relaxed(&bench_notsent,
+								 n + 1);
+				}
+				continue;
+			}
+			event = (benchevent_t *)isc_event_allocate(
+				mctx, NULL, BENCH_EVENT_SEND, bench_send, conn,
+				sizeof(*event));
+			event->first = posted;
+			event->last = due;
+			isc_task_send(conn->task, (isc_event_t **)&event);
+		}
+		posted = due;
+
+		next = bench_due(posted);
+		now = bench_now() - bench_start;
+		if (next > now) {
+			usleep(ISC_MAX((next - now) / NS_PER_US, BENCH_TICK));
+		}
+	}
+	bench_elapsed = bench_now() - bench_start;
+
+	/*
+	 * Wait for the outstanding responses.
+	 */
+	deadline = bench_now() + (uint64_t)timeout * NS_PER_SEC;
+	while (bench_now() < deadline &&
+	       atomic_load_acquire(&bench_received) +
+			       atomic_load_acquire(&bench_lost) +
+			       atomic_load_acquire(&bench_notsent) <
+		       total)
+	{
+		usleep(10 * US_PER_MS);
+	}
+	atomic_store(&bench_stopping, true);
+
+	/*
+	 * The handles are released on their own threads, after any
+	 * queries still queued there.
+	 */
+	for (i = 0; i < bench_clients; i++) {
+		benchconn_t *conn = bench_conns[i];
+		isc_event_t *event = NULL;
+
+		if (conn->task == NULL) {
+			continue;
+		}
+		event = isc_event_allocate(mctx, NULL, BENCH_EVENT_STOP,
+					   bench_stop, conn, sizeof(*event));
+		isc_task_send(conn->task, &event);
+		isc_task_detach(&conn->task);
+	}
+}
+
+static void
+print_rate(const char *what, uint64_t count, uint64_t total, uint64_t nsecs) {
+	printf(";; %-22s %" PRIu64, what, count);
+	if (total != 0) {
+		printf(" (%.2f%%)", 100.0 * count / total);
+	}
+	if (nsecs != 0) {
+		printf(", %.1f qps", (double)count * NS_PER_SEC / nsecs);
+	}
+	printf("\n");
+}
+
+/*%
+ * Print the results and free what bench_run() allocated.  Called once
+ * the network manager is gone, so nothing else looks at the
+ * connections any more.
+ */
+static void
+bench_report(void) {
+	static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+	uint64_t total = (uint64_t)bench_qps * bench_duration;
+	uint64_t sent = atomic_load(&bench_sent);
+	uint64_t received = atomic_load(&bench_received);
+	uint64_t lost = atomic_load(&bench_lost);
+	uint64_t count = 0, seen = 0, min = 0, max = 0;
+	size_t i, p = 0;
+
+	for (i = 0; i < bench_clients; i++) {
+		benchconn_t *conn = bench_conns[i];
+
+		for (size_t id = 0; id < ARRAY_SIZE(conn->due); id++) {
+			if (conn->due[id] != 0) {
+				lost++;
+			}
+		}
+		isc_mem_put(mctx, conn, sizeof(*conn));
+	}
+	isc_mem_put(mctx, bench_conns, bench_clients * sizeof(bench_conns[0]));
+	for (i = 0; i < bench_nwire; i++) {
+		isc_mem_put(mctx, bench_wire[i].base, bench_wire[i].length);
+	}
+	isc_mem_put(mctx, bench_wire, bench_nwire * sizeof(bench_wire[0]));
+	if (bench_tlsctx != NULL) {
+		isc_tlsctx_free(&bench_tlsctx);
+	}
+	isc_condition_destroy(&bench_cond);
+	isc_mutex_destroy(&bench_lock);
+
+	printf(";; Transport: %s, %u of %u connections, %u workers\n",
+	       bench_transport(), bench_connected, bench_clients, nworkers);
+	printf(";; Target: %u qps for %u seconds\n", bench_qps,
+	       bench_duration);
+	print_rate("Queries sent:", sent, total, bench_elapsed);
+	print_rate("Queries not sent:", atomic_load(&bench_notsent), total,
+		   0);
+	print_rate("Responses received:", received, sent, bench_elapsed);
+	print_rate("Queries lost:", lost, sent, 0);
+	print_rate("Unexpected responses:", atomic_load(&bench_unexpected), 0,
+		   0);
+	print_rate("Send errors:", atomic_load(&bench_senderrors), 0, 0);
+
+	if (received == 0) {
+		return;
+	}
+
+	printf(";; Response codes:");
+	for (i = 0; i < ARRAY_SIZE(bench_rcodes); i++) {
+		uint64_t n = atomic_load(&bench_rcodes[i]);
+		if (n != 0) {
+			printf(" %s %" PRIu64 " (%.2f%%)", rcode_totext(i), n,
+			       100.0 * n / received);
+		}
+	}
+	printf("\n");
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		uint64_t n = atomic_load(&bench_hist[i]);
+		if (n != 0) {
+			if (count == 0) {
+				min = hist_value(i);
+			}
+			max = hist_value(i);
+			count += n;
+		}
+	}
+	printf(";; Latency (ms): min %.3f, mean %.3f, max %.3f\n",
+	       min / 1000.0,
+	       (double)atomic_load(&bench_latency) / count / 1000.0,
+	       max / 1000.0);
+
+	printf(";; Latency percentiles (ms):");
+	for (i = 0; i < HIST_BUCKETS && p < ARRAY_SIZE(percentiles); i++) {
+		seen += atomic_load(&bench_hist[i]);
+		while (p < ARRAY_SIZE(percentiles) &&
+		       seen >= percentiles[p] / 100.0 * count)
+		{
+			printf(" %g%% %.3f", percentiles[p],
+			       hist_value(i) / 1000.0);
+			p++;
+		}
+	}
+	printf("\n");
+}
+
 /*
  * Try honoring the operating system's preferred ephemeral port range.
  */
@@ -2131,6 +2863,10 @@ main(int argc, char *argv[]) {
 	}
 
 	ns = 0;
+	if (!port_set && (tls_mode || https_mode)) {
+		port = https_mode ? 443 : 853;
+	}
+
 	result = bind9_getaddresses(server, port, &dstaddr, 1, &ns);
 	if (result != ISC_R_SUCCESS) {
 		fatal("couldn't get address for '%s': %s", server,
@@ -2148,7 +2884,7 @@ main(int argc, char *argv[]) {
 		fatal("can't choose between IPv4 and IPv6");
 	}
 
-	isc_managers_create(mctx, 1, 0, &netmgr, &taskmgr, NULL);
+	isc_managers_create(mctx, nworkers, 0, &netmgr, &taskmgr, NULL);
 	RUNCHECK(isc_task_create(taskmgr, 0, &task));
 	RUNCHECK(dns_dispatchmgr_create(mctx, netmgr, &dispatchmgr));
 
@@ -2168,6 +2904,14 @@ main(int argc, char *argv[]) {
 
 	RUNCHECK(dns_view_create(mctx, 0, "_test", &view));
 
+	if (bench_qps != 0) {
+		bench_run(netmgr, taskmgr);
+		goto cleanup;
+	}
+	if (tls_mode || https_mode) {
+		fatal("DoT and DoH are only supported with +qps");
+	}
+
 	query = ISC_LIST_HEAD(queries);
 	RUNCHECK(isc_app_onrun(mctx, task, sendqueries, query));
 
@@ -2199,6 +2943,7 @@ main(int argc, char *argv[]) {
 
 	(void)isc_app_run();
 
+cleanup:
 	dns_view_detach(&view);
 
 	dns_requestmgr_shutdown(requestmgr);
@@ -2212,6 +2957,10 @@ main(int argc, char *argv[]) {
 
 	isc_managers_destroy(&netmgr, &taskmgr, NULL);
 
+	if (bench_qps != 0) {
+		bench_report();
+	}
+
 	dst_lib_destroy();
 
 	isc_log_destroy(&lctx);
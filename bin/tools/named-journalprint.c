@@ -13,27 +13,273 @@
 
 /*! \file */
 
+#include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <isc/commandline.h>
+#include <isc/ht.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/result.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include <dns/journal.h>
 #include <dns/log.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
 #include <dns/types.h>
 
+#define MAXTHREADS 128
+
 const char *progname = NULL;
 
+/*%
+ * Changes to one owner name, keyed by its wire format.
+ */
+typedef struct namecount {
+	uint64_t adds;
+	uint64_t dels;
+	unsigned int length;
+	unsigned char ndata[DNS_NAME_MAXWIRE];
+} namecount_t;
+
+/*%
+ * One thread of the summary, counting the changes from 'begin' to
+ * 'end' with its own journal object.
+ */
+typedef struct summary {
+	isc_mem_t *mctx;
+	const char *file;
+	uint32_t begin;
+	uint32_t end;
+	isc_ht_t *names;
+	uint64_t transactions;
+	uint64_t adds;
+	uint64_t dels;
+	isc_result_t result;
+} summary_t;
+
 static void
 usage(void) {
-	fprintf(stderr, "Usage: %s [-dux] journal\n", progname);
+	fprintf(stderr,
+		"Usage: %s [-dux] [-s first[-last]] [-S] [-j threads] "
+		"journal\n",
+		progname);
 	exit(1);
 }
 
+static void
+count_name(isc_mem_t *mctx, isc_ht_t *names, const unsigned char *ndata,
+	   unsigned int length, uint64_t adds, uint64_t dels) {
+	namecount_t *nc = NULL;
+	isc_result_t result;
+
+	result = isc_ht_find(names, ndata, length, (void **)&nc);
+	if (result != ISC_R_SUCCESS) {
+		nc = isc_mem_get(mctx, sizeof(*nc));
+		*nc = (namecount_t){ .length = length };
+		memmove(nc->ndata, ndata, length);
+		RUNTIME_CHECK(isc_ht_add(names, ndata, length, nc) ==
+			      ISC_R_SUCCESS);
+	}
+	nc->adds += adds;
+	nc->dels += dels;
+}
+
+static isc_threadresult_t
+summary_thread(isc_threadarg_t arg) {
+	summary_t *sum = arg;
+	dns_journal_t *j = NULL;
+	unsigned int n_soa = 0;
+	isc_result_t result;
+
+	result = dns_journal_open(sum->mctx, sum->file, DNS_JOURNAL_READ, &j);
+	if (result != ISC_R_SUCCESS) {
+		goto done;
+	}
+
+	result = dns_journal_iter_init(j, sum->begin, sum->end, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	for (result = dns_journal_first_rr(j); result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(j))
+	{
+		dns_name_t *name = NULL;
+		dns_rdata_t *rdata = NULL;
+		isc_region_t r;
+		uint32_t ttl;
+
+		dns_journal_current_rr(j, &name, &ttl, &rdata);
+
+		/*
+		 * Each transaction is the deletions, led by the old SOA,
+		 * then the additions, led by the new one.
+		 */
+		if (rdata->type == dns_rdatatype_soa) {
+			n_soa = (n_soa == 1) ? 2 : 1;
+			if (n_soa == 1) {
+				sum->transactions++;
+			}
+			continue;
+		}
+		if (n_soa == 0) {
+			result = ISC_R_UNEXPECTED;
+			break;
+		}
+
+		dns_name_toregion(name, &r);
+		if (n_soa == 1) {
+			sum->dels++;
+			count_name(sum->mctx, sum->names, r.base, r.length, 0,
+				   1);
+		} else {
+			sum->adds++;
+			count_name(sum->mctx, sum->names, r.base, r.length, 1,
+				   0);
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+cleanup:
+	dns_journal_destroy(&j);
+done:
+	sum->result = result;
+	return ((isc_threadresult_t)0);
+}
+
+static int
+compare_counts(const void *a, const void *b) {
+	const namecount_t *na = *(const namecount_t *const *)a;
+	const namecount_t *nb = *(const namecount_t *const *)b;
+	uint64_t ta = na->adds + na->dels;
+	uint64_t tb = nb->adds + nb->dels;
+
+	if (ta != tb) {
+		return (ta > tb ? -1 : 1);
+	}
+	if (na->length != nb->length) {
+		return (na->length < nb->length ? -1 : 1);
+	}
+	return (memcmp(na->ndata, nb->ndata, na->length));
+}
+
+/*
+ * Print the number of transactions and of added and deleted records
+ * from 'begin' to 'end', then the changes to each owner name, most
+ * changed first.  The range is split between 'nthreads' threads, each
+ * with its own hash table; the tables are merged at the end.
+ */
+static isc_result_t
+summarize(isc_mem_t *mctx, const char *file, uint32_t begin, uint32_t end,
+	  unsigned int nthreads, FILE *out) {
+	dns_journal_t *j = NULL;
+	uint32_t serials[MAXTHREADS + 1];
+	summary_t sums[MAXTHREADS];
+	isc_thread_t threads[MAXTHREADS];
+	namecount_t **sorted = NULL;
+	isc_ht_iter_t *it = NULL;
+	isc_ht_t *names = NULL;
+	unsigned int nparts = 0;
+	uint64_t transactions = 0, adds = 0, dels = 0;
+	size_t count, n = 0;
+	isc_result_t result;
+
+	result = dns_journal_open(mctx, file, DNS_JOURNAL_READ, &j);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	result = dns_journal_split(j, begin, end, nthreads, serials, &nparts);
+	dns_journal_destroy(&j);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	for (unsigned int i = 0; i < nparts; i++) {
+		sums[i] = (summary_t){ .mctx = mctx,
+				       .file = file,
+				       .begin = serials[i],
+				       .end = serials[i + 1] };
+		isc_ht_init(&sums[i].names, mctx, 12, ISC_HT_CASE_INSENSITIVE);
+		isc_thread_create(summary_thread, &sums[i], &threads[i]);
+	}
+
+	isc_ht_init(&names, mctx, 16, ISC_HT_CASE_INSENSITIVE);
+	for (unsigned int i = 0; i < nparts; i++) {
+		isc_thread_join(threads[i], NULL);
+		if (result == ISC_R_SUCCESS) {
+			result = sums[i].result;
+		}
+		transactions += sums[i].transactions;
+		adds += sums[i].adds;
+		dels += sums[i].dels;
+
+		isc_ht_iter_create(sums[i].names, &it);
+		for (isc_result_t r = isc_ht_iter_first(it);
+		     r == ISC_R_SUCCESS; r = isc_ht_iter_delcurrent_next(it))
+		{
+			namecount_t *nc = NULL;
+
+			isc_ht_iter_current(it, (void **)&nc);
+			count_name(mctx, names, nc->ndata, nc->length,
+				   nc->adds, nc->dels);
+			isc_mem_put(mctx, nc, sizeof(*nc));
+		}
+		isc_ht_iter_destroy(&it);
+		isc_ht_destroy(&sums[i].names);
+	}
+
+	if (result == ISC_R_SUCCESS) {
+		fprintf(out,
+			"transactions %" PRIu64 " added %" PRIu64
+			" deleted %" PRIu64 " names %zu\n",
+			transactions, adds, dels, isc_ht_count(names));
+	}
+
+	count = isc_ht_count(names);
+	if (count > 0) {
+		sorted = isc_mem_get(mctx, count * sizeof(sorted[0]));
+	}
+	isc_ht_iter_create(names, &it);
+	for (isc_result_t r = isc_ht_iter_first(it); r == ISC_R_SUCCESS;
+	     r = isc_ht_iter_delcurrent_next(it))
+	{
+		isc_ht_iter_current(it, (void **)&sorted[n++]);
+	}
+	isc_ht_iter_destroy(&it);
+	isc_ht_destroy(&names);
+
+	if (count > 0) {
+		qsort(sorted, count, sizeof(sorted[0]), compare_counts);
+	}
+	for (size_t i = 0; i < count; i++) {
+		char text[DNS_NAME_FORMATSIZE];
+		isc_region_t r = { sorted[i]->ndata, sorted[i]->length };
+		dns_name_t name;
+
+		if (result == ISC_R_SUCCESS) {
+			dns_name_init(&name, NULL);
+			dns_name_fromregion(&name, &r);
+			dns_name_format(&name, text, sizeof(text));
+			fprintf(out, "%" PRIu64 " %" PRIu64 " %s\n",
+				sorted[i]->adds, sorted[i]->dels, text);
+		}
+		isc_mem_put(mctx, sorted[i], sizeof(*sorted[i]));
+	}
+	if (sorted != NULL) {
+		isc_mem_put(mctx, sorted, count * sizeof(sorted[0]));
+	}
+
+	return (result);
+}
+
 /*
  * Setup logging to use stderr.
  */
@@ -73,11 +319,16 @@ main(int argc, char **argv) {
 	bool compact = false;
 	bool downgrade = false;
 	bool upgrade = false;
+	bool range = false;
+	bool summary = false;
 	unsigned int serial = 0;
+	uint32_t begin = 0, end = 0;
+	bool haveend = false;
+	unsigned int nthreads = 0;
 	char *endp = NULL;
 
 	progname = argv[0];
-	while ((ch = isc_commandline_parse(argc, argv, "c:dux")) != -1) {
+	while ((ch = isc_commandline_parse(argc, argv, "c:dj:s:Sux")) != -1) {
 		switch (ch) {
 		case 'c':
 			compact = true;
@@ -91,6 +342,36 @@ main(int argc, char **argv) {
 		case 'd':
 			downgrade = true;
 			break;
+		case 'j':
+			nthreads = strtoul(isc_commandline_argument, &endp, 0);
+			if (endp == isc_commandline_argument || *endp != 0 ||
+			    nthreads == 0)
+			{
+				fprintf(stderr, "invalid thread count: %s\n",
+					isc_commandline_argument);
+				exit(1);
+			}
+			break;
+		case 's':
+			range = true;
+			begin = strtoul(isc_commandline_argument, &endp, 0);
+			if (endp != isc_commandline_argument && *endp == '-') {
+				const char *last = endp + 1;
+				end = strtoul(last, &endp, 0);
+				haveend = (endp != last);
+				if (!haveend) {
+					endp = isc_commandline_argument;
+				}
+			}
+			if (endp == isc_commandline_argument || *endp != 0) {
+				fprintf(stderr, "invalid serial range: %s\n",
+					isc_commandline_argument);
+				exit(1);
+			}
+			break;
+		case 'S':
+			summary = true;
+			break;
 		case 'u':
 			upgrade = true;
 			break;
@@ -123,8 +404,44 @@ main(int argc, char **argv) {
 		flags = 0;
 		result = dns_journal_compact(mctx, file, serial, flags, 0);
 	} else {
-		result = dns_journal_print(mctx, flags, file, stdout);
-		if (result == DNS_R_NOJOURNAL) {
+		result = ISC_R_SUCCESS;
+		if (!range || !haveend) {
+			dns_journal_t *j = NULL;
+
+			/*
+			 * Default to the whole journal, or to the rest of
+			 * it from the given serial number.
+			 */
+			result = dns_journal_open(mctx, file, DNS_JOURNAL_READ,
+						  &j);
+			if (result == ISC_R_SUCCESS) {
+				if (!range) {
+					begin = dns_journal_first_serial(j);
+				}
+				end = dns_journal_last_serial(j);
+				dns_journal_destroy(&j);
+			} else if (result == ISC_R_NOTFOUND) {
+				result = DNS_R_NOJOURNAL;
+			}
+		}
+		if (result != ISC_R_SUCCESS) {
+			/* Nothing to read. */
+		} else if (summary) {
+			if (nthreads == 0) {
+				nthreads = isc_os_ncpus();
+			}
+			nthreads = ISC_MIN(nthreads, MAXTHREADS);
+			result = summarize(mctx, file, begin, end, nthreads,
+					   stdout);
+		} else {
+			result = dns_journal_printrange(mctx, flags, file,
+							begin, end, stdout);
+		}
+		if (result == ISC_R_RANGE || result == ISC_R_NOTFOUND) {
+			fprintf(stderr,
+				"%s: serial range %u-%u not in journal: %s\n",
+				file, begin, end, isc_result_totext(result));
+		} else if (result != ISC_R_SUCCESS) {
 			fprintf(stderr, "%s\n", isc_result_totext(result));
 		}
 	}
@@ -59,9 +59,12 @@ check_result(isc_result_t result, const char *message) {
 
 static void
 usage(void) {
-	fprintf(stderr, "Usage: %s salt algorithm iterations domain\n",
+	fprintf(stderr,
+		"Usage: %s salt algorithm iterations domain [domain ...]\n",
 		program);
-	fprintf(stderr, "       %s -r algorithm flags iterations salt domain\n",
+	fprintf(stderr,
+		"       %s -r algorithm flags iterations salt domain "
+		"[domain ...]\n",
 		program);
 	exit(1);
 }
@@ -70,15 +73,24 @@ typedef void
 nsec3printer(unsigned algo, unsigned flags, unsigned iters, const char *saltstr,
 	     const char *domain, const char *digest);
 
+/*
+ * Number of domains hashed together by isc_iterated_hash_batch().
+ */
+#define BATCH 8
+
 static void
 nsec3hash(nsec3printer *nsec3print, const char *algostr, const char *flagstr,
-	  const char *iterstr, const char *saltstr, const char *domain) {
-	dns_fixedname_t fixed;
+	  const char *iterstr, const char *saltstr, char **domains,
+	  int ndomains) {
+	dns_fixedname_t fixed[BATCH];
 	dns_name_t *name;
 	isc_buffer_t buffer;
 	isc_region_t region;
 	isc_result_t result;
-	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
+	unsigned char hash[BATCH][NSEC3_MAX_HASH_LENGTH];
+	unsigned char *out[BATCH];
+	const unsigned char *in[BATCH];
+	int inlength[BATCH];
 	unsigned char salt[DNS_NSEC3_SALTSIZE];
 	unsigned char text[1024];
 	unsigned int hash_alg;
@@ -87,6 +99,7 @@ nsec3hash(nsec3printer *nsec3print, const char *algostr, const char *flagstr,
 	unsigned int iterations;
 	unsigned int salt_length;
 	const char dash[] = "-";
+	int i, count;
 
 	if (strcmp(saltstr, "-") == 0) {
 		salt_length = 0;
@@ -116,25 +129,42 @@ nsec3hash(nsec3printer *nsec3print, const char *algostr, const char *flagstr,
 		fatal("iterations to large");
 	}
 
-	name = dns_fixedname_initname(&fixed);
-	isc_buffer_constinit(&buffer, domain, strlen(domain));
-	isc_buffer_add(&buffer, strlen(domain));
-	result = dns_name_fromtext(name, &buffer, dns_rootname, 0, NULL);
-	check_result(result, "dns_name_fromtext() failed");
-
-	dns_name_downcase(name, name, NULL);
-	length = isc_iterated_hash(hash, hash_alg, iterations, salt,
-				   salt_length, name->ndata, name->length);
-	if (length == 0) {
-		fatal("isc_iterated_hash failed");
-	}
-	region.base = hash;
-	region.length = length;
-	isc_buffer_init(&buffer, text, sizeof(text));
-	isc_base32hexnp_totext(&region, 1, "", &buffer);
-	isc_buffer_putuint8(&buffer, '\0');
+	for (; ndomains > 0; domains += count, ndomains -= count) {
+		count = ISC_MIN(ndomains, BATCH);
+
+		for (i = 0; i < count; i++) {
+			name = dns_fixedname_initname(&fixed[i]);
+			isc_buffer_constinit(&buffer, domains[i],
+					     strlen(domains[i]));
+			isc_buffer_add(&buffer, strlen(domains[i]));
+			result = dns_name_fromtext(name, &buffer, dns_rootname,
+						   0, NULL);
+			check_result(result, "dns_name_fromtext() failed");
+
+			dns_name_downcase(name, name, NULL);
+			in[i] = name->ndata;
+			inlength[i] = name->length;
+			out[i] = hash[i];
+		}
 
-	nsec3print(hash_alg, flags, iterations, saltstr, domain, (char *)text);
+		length = isc_iterated_hash_batch(out, hash_alg, iterations,
+						 salt, salt_length, in,
+						 inlength, count);
+		if (length == 0) {
+			fatal("isc_iterated_hash_batch failed");
+		}
+
+		for (i = 0; i < count; i++) {
+			region.base = hash[i];
+			region.length = length;
+			isc_buffer_init(&buffer, text, sizeof(text));
+			isc_base32hexnp_totext(&region, 1, "", &buffer);
+			isc_buffer_putuint8(&buffer, '\0');
+
+			nsec3print(hash_alg, flags, iterations, saltstr,
+				   domains[i], (char *)text);
+		}
+	}
 }
 
 static void
@@ -178,17 +208,17 @@ skip:
 	argv += isc_commandline_index;
 
 	if (rdata_format) {
-		if (argc != 5) {
+		if (argc < 5) {
 			usage();
 		}
 		nsec3hash(nsec3hash_rdata_print, argv[0], argv[1], argv[2],
-			  argv[3], argv[4]);
+			  argv[3], argv + 4, argc - 4);
 	} else {
-		if (argc != 4) {
+		if (argc < 4) {
 			usage();
 		}
 		nsec3hash(nsec3hash_print, argv[1], NULL, argv[2], argv[0],
-			  argv[3]);
+			  argv + 3, argc - 3);
 	}
 	return (0);
 }
@@ -246,6 +246,24 @@ dlz_lookup(const char *zone, const char *name, void *dbdata,
 	   dns_clientinfo_t *clientinfo);
 #endif /* DLZ_DLOPEN_VERSION */
 
+#if DLZ_DLOPEN_VERSION >= 3
+/*
+ * dlz_lookup_async() is optional.  It starts the same lookup as
+ * dlz_lookup() but returns without waiting for the backend; the
+ * records are put later, from any thread, and 'done' is then called
+ * with 'arg' and the result dlz_lookup() would have returned.
+ * 'methods' and 'clientinfo' may only be used before it returns.
+ */
+typedef void
+dlz_lookup_done_t(void *arg, isc_result_t result);
+
+isc_result_t
+dlz_lookup_async(const char *zone, const char *name, void *dbdata,
+		 dns_sdlzlookup_t *lookup, dns_clientinfomethods_t *methods,
+		 dns_clientinfo_t *clientinfo, dlz_lookup_done_t *done,
+		 void *arg);
+#endif /* DLZ_DLOPEN_VERSION >= 3 */
+
 /*
  * dlz_authority() is optional if dlz_lookup() supplies
  * authority information (i.e., SOA, NS) for the dns record
@@ -13,11 +13,13 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "fuzz.h"
@@ -26,6 +28,114 @@
 
 #include <dirent.h>
 
+/*
+ * In benchmark mode ("-b [-n runs]"), the inputs are read into memory
+ * first, then each of them is run 'bench_runs' times.  The totals, and
+ * then the BENCH_SLOWEST slowest inputs, are printed as lines of JSON:
+ * time, bytes and allocations per input, so that parser changes can be
+ * measured and pathological inputs spotted.
+ */
+#define BENCH_SLOWEST 10
+
+typedef struct input {
+	char *name;
+	uint8_t *data;
+	size_t size;
+	uint64_t nsecs; /* per run */
+	uint64_t gets;	/* allocations per run */
+} input_t;
+
+static bool bench = false;
+static unsigned int bench_runs = 100;
+static input_t *inputs = NULL;
+static size_t ninputs = 0;
+
+static void
+add_input(const char *filename, char *data, size_t size) {
+	const char *name = strrchr(filename, '/');
+
+	inputs = realloc(inputs, (ninputs + 1) * sizeof(inputs[0]));
+	if (inputs == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	inputs[ninputs++] = (input_t){
+		.name = strdup((name != NULL) ? name + 1 : filename),
+		.data = (uint8_t *)data,
+		.size = size,
+	};
+}
+
+static uint64_t
+now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static int
+slower_first(const void *a, const void *b) {
+	const input_t *ia = a, *ib = b;
+
+	return ((ia->nsecs < ib->nsecs) - (ia->nsecs > ib->nsecs));
+}
+
+static void
+run_bench(const char *target) {
+	uint64_t nsecs = 0, gets = 0, bytes = 0;
+
+	if (ninputs == 0) {
+		fprintf(stderr, "No inputs\n");
+		return;
+	}
+
+	for (size_t i = 0; i < ninputs; i++) {
+		input_t *in = &inputs[i];
+		uint64_t start, startgets;
+
+		/* The first run fills caches and lazy state. */
+		LLVMFuzzerTestOneInput(in->data, in->size);
+
+		startgets = isc_mem_totalgets();
+		start = now_ns();
+		for (unsigned int r = 0; r < bench_runs; r++) {
+			LLVMFuzzerTestOneInput(in->data, in->size);
+		}
+		in->nsecs = (now_ns() - start) / bench_runs;
+		in->gets = (isc_mem_totalgets() - startgets) / bench_runs;
+
+		nsecs += in->nsecs;
+		gets += in->gets;
+		bytes += in->size;
+	}
+
+	if (nsecs == 0) {
+		nsecs = 1;
+	}
+	printf("{\"benchmark\":\"%s\",\"inputs\":%zu,\"bytes\":%" PRIu64
+	       ",\"runs\":%u,\"ns_per_input\":%.2f,\"inputs_per_sec\":%.0f,"
+	       "\"bytes_per_sec\":%.0f,\"allocs_per_input\":%.2f}\n",
+	       target, ninputs, bytes, bench_runs, (double)nsecs / ninputs,
+	       ninputs * 1e9 / nsecs, bytes * 1e9 / nsecs,
+	       (double)gets / ninputs);
+
+	qsort(inputs, ninputs, sizeof(inputs[0]), slower_first);
+	for (size_t i = 0; i < ninputs && i < BENCH_SLOWEST; i++) {
+		printf("{\"benchmark\":\"%s\",\"input\":\"%s\","
+		       "\"bytes\":%zu,\"ns_per_run\":%" PRIu64
+		       ",\"allocs_per_run\":%" PRIu64 "}\n",
+		       target, inputs[i].name, inputs[i].size, inputs[i].nsecs,
+		       inputs[i].gets);
+	}
+
+	for (size_t i = 0; i < ninputs; i++) {
+		free(inputs[i].name);
+		free(inputs[i].data);
+	}
+	free(inputs);
+}
+
 static void
 test_one_file(const char *filename) {
 	int fd;
@@ -47,7 +157,10 @@ test_one_file(const char *filename) {
 
 	data = malloc(st.st_size);
 	n = read(fd, data, st.st_size);
-	if (n == st.st_size) {
+	if (n == st.st_size && bench) {
+		add_input(filename, data, n);
+		data = NULL;
+	} else if (n == st.st_size) {
 		printf("testing %zd bytes from %s\n", n, filename);
 		fflush(stdout);
 		LLVMFuzzerTestOneInput((const uint8_t *)data, n);
@@ -104,12 +217,33 @@ main(int argc, char **argv) {
 		return 1;
 	}
 
+	target = (target != NULL) ? target + 1 : argv[0];
+	if (strncmp(target, "lt-", 3) == 0) {
+		target += 3;
+	}
+
 	if (argv[1] != NULL && strcmp(argv[1], "-d") == 0) {
 		debug = true;
 		argv++;
 		argc--;
 	}
 
+	if (argv[1] != NULL && strcmp(argv[1], "-b") == 0) {
+		bench = true;
+		argv++;
+		argc--;
+		if (argv[1] != NULL && strcmp(argv[1], "-n") == 0 &&
+		    argv[2] != NULL)
+		{
+			bench_runs = strtoul(argv[2], NULL, 10);
+			if (bench_runs == 0) {
+				bench_runs = 1;
+			}
+			argv += 2;
+			argc -= 2;
+		}
+	}
+
 	if (argv[1] != NULL) {
 		while (argv[1] != NULL) {
 			test_one_file(argv[1]);
@@ -117,18 +251,16 @@ main(int argc, char **argv) {
 			argc--;
 		}
 		POST(argc);
-		return (0);
+	} else {
+		snprintf(corpusdir, sizeof(corpusdir), FUZZDIR "/%s.in",
+			 target);
+		test_all_from(corpusdir);
 	}
 
-	target = (target != NULL) ? target + 1 : argv[0];
-	if (strncmp(target, "lt-", 3) == 0) {
-		target += 3;
+	if (bench) {
+		run_bench(target);
 	}
 
-	snprintf(corpusdir, sizeof(corpusdir), FUZZDIR "/%s.in", target);
-
-	test_all_from(corpusdir);
-
 	return (0);
 }
 
@@ -45,6 +45,7 @@
 #include <isc/util.h>
 
 #include <dns/acl.h>
+#include <dns/cache.h>
 #include <dns/dnstap.h>
 #include <dns/fixedname.h>
 #include <dns/kasp.h>
@@ -1917,6 +1918,63 @@ check_options(const cfg_obj_t *options, const cfg_obj_t *config,
 		}
 	}
 
+	obj = NULL;
+	(void)cfg_map_get(options, "cache-shards", &obj);
+	if (obj != NULL) {
+		uint32_t shards = cfg_obj_asuint32(obj);
+		if (shards < 1 || shards > DNS_CACHE_MAXSHARDS) {
+			cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
+				    "'cache-shards' must be between 1 and %u",
+				    DNS_CACHE_MAXSHARDS);
+			if (result == ISC_R_SUCCESS) {
+				result = ISC_R_RANGE;
+			}
+		}
+	}
+
+	obj = NULL;
+	(void)cfg_map_get(options, "cache-top-domains", &obj);
+	if (obj != NULL && cfg_obj_asuint32(obj) > DNS_CACHE_MAXTOPDOMAINS) {
+		cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
+			    "'cache-top-domains' must not be greater than %u",
+			    DNS_CACHE_MAXTOPDOMAINS);
+		if (result == ISC_R_SUCCESS) {
+			result = ISC_R_RANGE;
+		}
+	}
+
+	obj = NULL;
+	(void)cfg_map_get(options, "client-ipv4-prefix-length", &obj);
+	if (obj != NULL && cfg_obj_asuint32(obj) > 32) {
+		cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
+			    "'client-ipv4-prefix-length' must not be greater "
+			    "than 32");
+		if (result == ISC_R_SUCCESS) {
+			result = ISC_R_RANGE;
+		}
+	}
+
+	obj = NULL;
+	(void)cfg_map_get(options, "client-ipv6-prefix-length", &obj);
+	if (obj != NULL && cfg_obj_asuint32(obj) > 128) {
+		cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
+			    "'client-ipv6-prefix-length' must not be greater "
+			    "than 128");
+		if (result == ISC_R_SUCCESS) {
+			result = ISC_R_RANGE;
+		}
+	}
+
+	obj = NULL;
+	(void)cfg_map_get(options, "prefetch-popular", &obj);
+	if (obj != NULL && cfg_obj_asuint32(obj) > 1000) {
+		cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
+			    "'prefetch-popular' must not be greater than 1000");
+		if (result == ISC_R_SUCCESS) {
+			result = ISC_R_RANGE;
+		}
+	}
+
 	cfg_aclconfctx_create(mctx, &actx);
 
 	obj = NULL;
@@ -5107,6 +5165,9 @@ check_dnstap(const cfg_obj_t *voptions, const cfg_obj_t *config,
 #ifdef HAVE_DNSTAP
 	const cfg_obj_t *options = NULL;
 	const cfg_obj_t *obj = NULL;
+	const cfg_obj_t *maps[2];
+	const cfg_listelt_t *element;
+	isc_result_t result = ISC_R_SUCCESS;
 
 	if (config != NULL) {
 		(void)cfg_map_get(config, "options", &options);
@@ -5128,7 +5189,48 @@ check_dnstap(const cfg_obj_t *voptions, const cfg_obj_t *config,
 			return (ISC_R_FAILURE);
 		}
 	}
-	return (ISC_R_SUCCESS);
+
+	/*
+	 * The sampling options may be set in both the view and the
+	 * global options; check both.
+	 */
+	maps[0] = voptions;
+	maps[1] = options;
+	for (int i = 0; i < 2; i++) {
+		if (maps[i] == NULL) {
+			continue;
+		}
+
+		obj = NULL;
+		(void)cfg_map_get(maps[i], "dnstap-sample", &obj);
+		if (obj != NULL && cfg_obj_asuint32(obj) == 0) {
+			cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
+				    "'dnstap-sample' must be at least 1");
+			result = ISC_R_FAILURE;
+		}
+
+		obj = NULL;
+		(void)cfg_map_get(maps[i], "dnstap-sample-types", &obj);
+		for (element = cfg_list_first(obj); element != NULL;
+		     element = cfg_list_next(element))
+		{
+			const cfg_obj_t *typeobj = cfg_listelt_value(element);
+			isc_textregion_t r;
+			dns_rdatatype_t type;
+
+			DE_CONST(cfg_obj_asstring(typeobj), r.base);
+			r.length = strlen(r.base);
+			if (dns_rdatatype_fromtext(&type, &r) != ISC_R_SUCCESS)
+			{
+				cfg_obj_log(typeobj, logctx, ISC_LOG_ERROR,
+					    "'%s' is not a valid type",
+					    r.base);
+				result = ISC_R_FAILURE;
+			}
+		}
+	}
+
+	return (result);
 #else  /* ifdef HAVE_DNSTAP */
 	UNUSED(voptions);
 	UNUSED(config);
@@ -15,6 +15,7 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include <isc/mem.h>
 #include <isc/once.h>
@@ -861,3 +862,256 @@ dns_acl_merge_ports_transports(dns_acl_t *dest, dns_acl_t *source, bool pos) {
 					    next->encrypted, add_negative);
 	}
 }
+
+/*
+ * An ACL index maps an address to the set of ACLs that may match it.
+ * Every prefix that appears in any of the indexed ACLs is entered into
+ * one radix tree, most specific first, so that a search finds the
+ * longest prefix covering the address.  Whether an ACL that consists
+ * only of IP prefixes matches an address depends only on which of its
+ * prefixes cover the address, i.e. on that longest prefix, so the
+ * result for each such ACL is computed once per prefix when the index
+ * is built.
+ */
+#define DNS_ACLINDEX_MAGIC    ISC_MAGIC('A', 'c', 'l', 'I')
+#define DNS_ACLINDEX_VALID(a) ISC_MAGIC_VALID(a, DNS_ACLINDEX_MAGIC)
+
+struct dns_aclindex {
+	unsigned int	  magic;
+	isc_mem_t	 *mctx;
+	isc_radix_tree_t *radix;
+	unsigned int	  nacls;
+	unsigned int	  words;
+	uint64_t	 *exact;
+	size_t		  nbitmaps;
+	uint64_t	 *bitmaps; /*%< [0] is used for unlisted addresses */
+};
+
+#define ACLINDEX_SET(bitmap, i) \
+	((bitmap)[(i) / 64] |= (UINT64_C(1) << ((i) % 64)))
+
+static bool
+acl_isiponly(const dns_acl_t *acl) {
+	return (acl->length == 0 && ISC_LIST_EMPTY(acl->ports_and_transports));
+}
+
+static int
+prefix_cmp(const void *a, const void *b) {
+	const isc_prefix_t *pa = a, *pb = b;
+
+	return ((int)pb->bitlen - (int)pa->bitlen);
+}
+
+static bool
+acl_prefixallowed(const dns_acl_t *acl, isc_prefix_t *pfx) {
+	isc_radix_node_t *node = NULL;
+	isc_result_t result;
+
+	result = isc_radix_search(acl->iptable->radix, &node, pfx);
+	return (result == ISC_R_SUCCESS &&
+		*(bool *)node->data[ISC_RADIX_FAMILY(pfx)]);
+}
+
+isc_result_t
+dns_aclindex_create(isc_mem_t *mctx, dns_acl_t *const *acls,
+		    unsigned int nacls, dns_aclindex_t **indexp) {
+	isc_result_t result;
+	dns_aclindex_t *index = NULL;
+	isc_prefix_t *prefixes = NULL;
+	size_t nprefixes = 0, maxprefixes = 0, i;
+	unsigned int j;
+	uint64_t *bitmap = NULL;
+
+	REQUIRE(acls != NULL || nacls == 0);
+	REQUIRE(indexp != NULL && *indexp == NULL);
+
+	index = isc_mem_get(mctx, sizeof(*index));
+	*index = (dns_aclindex_t){ .nacls = nacls,
+				   .words = (nacls + 63) / 64 };
+	isc_mem_attach(mctx, &index->mctx);
+	if (index->words == 0) {
+		index->words = 1;
+	}
+
+	result = isc_radix_create(mctx, &index->radix, RADIX_MAXBITS);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	index->exact = isc_mem_get(mctx, index->words * sizeof(uint64_t));
+	memset(index->exact, 0, index->words * sizeof(uint64_t));
+
+	/*
+	 * Collect the prefixes of the ACLs that can be evaluated in
+	 * advance, once for each address family they apply to.
+	 */
+	for (j = 0; j < nacls; j++) {
+		if (acls[j] == NULL || acl_isiponly(acls[j])) {
+			ACLINDEX_SET(index->exact, j);
+		}
+		if (acls[j] != NULL && acl_isiponly(acls[j])) {
+			maxprefixes += RADIX_FAMILIES *
+				       acls[j]->iptable->radix->num_active_node;
+		}
+	}
+	if (maxprefixes > 0) {
+		prefixes = isc_mem_get(mctx, maxprefixes * sizeof(prefixes[0]));
+	}
+	for (j = 0; j < nacls; j++) {
+		isc_radix_node_t *node = NULL;
+
+		if (acls[j] == NULL || !acl_isiponly(acls[j])) {
+			continue;
+		}
+
+		RADIX_WALK (acls[j]->iptable->radix->head, node) {
+			int fam;
+
+			for (fam = 0; fam < RADIX_FAMILIES; fam++) {
+				isc_prefix_t *pfx = NULL;
+
+				if (node->node_num[fam] == -1) {
+					continue;
+				}
+				INSIST(nprefixes < maxprefixes);
+				pfx = &prefixes[nprefixes++];
+				*pfx = (isc_prefix_t){
+					.family = (fam == RADIX_V6) ? AF_INET6
+								    : AF_INET,
+					.bitlen = node->prefix->bitlen,
+				};
+				memmove(&pfx->add, &node->prefix->add,
+					(pfx->bitlen + 7) / 8);
+				isc_refcount_init(&pfx->refcount, 0);
+			}
+		}
+		RADIX_WALK_END;
+	}
+
+	/*
+	 * Longer prefixes get lower node numbers, so that searching the
+	 * index yields the most specific prefix rather than the first.
+	 */
+	if (nprefixes > 0) {
+		qsort(prefixes, nprefixes, sizeof(prefixes[0]), prefix_cmp);
+	}
+
+	index->nbitmaps = nprefixes + 1;
+	index->bitmaps = isc_mem_get(
+		mctx, index->nbitmaps * index->words * sizeof(uint64_t));
+	memset(index->bitmaps, 0,
+	       index->nbitmaps * index->words * sizeof(uint64_t));
+	bitmap = index->bitmaps;
+	for (j = 0; j < nacls; j++) {
+		if (acls[j] == NULL || !acl_isiponly(acls[j])) {
+			ACLINDEX_SET(bitmap, j);
+		}
+	}
+
+	for (i = 0; i < nprefixes; i++) {
+		isc_prefix_t *pfx = &prefixes[i];
+		isc_radix_node_t *node = NULL;
+		int fam = ISC_RADIX_FAMILY(pfx);
+
+		result = isc_radix_insert(index->radix, &node, NULL, pfx);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		if (node->data[fam] != NULL) {
+			continue;
+		}
+
+		bitmap += index->words;
+		for (j = 0; j < nacls; j++) {
+			if (acls[j] == NULL || !acl_isiponly(acls[j]) ||
+			    acl_prefixallowed(acls[j], pfx))
+			{
+				ACLINDEX_SET(bitmap, j);
+			}
+		}
+		node->data[fam] = bitmap;
+	}
+
+	index->magic = DNS_ACLINDEX_MAGIC;
+	*indexp = index;
+	result = ISC_R_SUCCESS;
+
+cleanup:
+	for (i = 0; i < nprefixes; i++) {
+		isc_refcount_destroy(&prefixes[i].refcount);
+	}
+	if (prefixes != NULL) {
+		isc_mem_put(mctx, prefixes, maxprefixes * sizeof(prefixes[0]));
+	}
+	if (result != ISC_R_SUCCESS) {
+		index->magic = DNS_ACLINDEX_MAGIC;
+		dns_aclindex_destroy(&index);
+	}
+	return (result);
+}
+
+void
+dns_aclindex_destroy(dns_aclindex_t **indexp) {
+	dns_aclindex_t *index = NULL;
+
+	REQUIRE(indexp != NULL && DNS_ACLINDEX_VALID(*indexp));
+
+	index = *indexp;
+	*indexp = NULL;
+	index->magic = 0;
+
+	if (index->radix != NULL) {
+		isc_radix_destroy(index->radix, NULL);
+	}
+	if (index->exact != NULL) {
+		isc_mem_put(index->mctx, index->exact,
+			    index->words * sizeof(uint64_t));
+	}
+	if (index->bitmaps != NULL) {
+		isc_mem_put(index->mctx, index->bitmaps,
+			    index->nbitmaps * index->words * sizeof(uint64_t));
+	}
+	isc_mem_putanddetach(&index->mctx, index, sizeof(*index));
+}
+
+const uint64_t *
+dns_aclindex_find(const dns_aclindex_t *index, const isc_netaddr_t *reqaddr,
+		  const dns_aclenv_t *env) {
+	isc_prefix_t pfx;
+	isc_radix_node_t *node = NULL;
+	const isc_netaddr_t *addr = reqaddr;
+	isc_netaddr_t v4addr;
+	isc_result_t result;
+	const uint64_t *bitmap = NULL;
+
+	REQUIRE(DNS_ACLINDEX_VALID(index));
+	REQUIRE(reqaddr != NULL);
+
+	if (env != NULL && env->match_mapped && addr->family == AF_INET6 &&
+	    IN6_IS_ADDR_V4MAPPED(&addr->type.in6))
+	{
+		isc_netaddr_fromv4mapped(&v4addr, addr);
+		addr = &v4addr;
+	}
+
+	NETADDR_TO_PREFIX_T(addr, pfx, (addr->family == AF_INET6) ? 128 : 32);
+
+	result = isc_radix_search(index->radix, &node, &pfx);
+	if (result == ISC_R_SUCCESS) {
+		bitmap = node->data[ISC_RADIX_FAMILY(&pfx)];
+	} else {
+		bitmap = index->bitmaps;
+	}
+
+	isc_refcount_destroy(&pfx.refcount);
+
+	return (bitmap);
+}
+
+bool
+dns_aclindex_isexact(const dns_aclindex_t *index, unsigned int i) {
+	REQUIRE(DNS_ACLINDEX_VALID(index));
+	REQUIRE(i < index->nacls);
+
+	return ((index->exact[i / 64] & (UINT64_C(1) << (i % 64))) != 0);
+}
@@ -20,16 +20,20 @@
  *
  */
 
+#include <arpa/inet.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <stdbool.h>
 
+#include <isc/file.h>
+#include <isc/lex.h>
 #include <isc/mutexblock.h>
 #include <isc/netaddr.h>
 #include <isc/print.h>
 #include <isc/random.h>
 #include <isc/result.h>
 #include <isc/stats.h>
+#include <isc/stdio.h>
 #include <isc/string.h> /* Required for HP/UX (and others?) */
 #include <isc/task.h>
 #include <isc/util.h>
@@ -37,6 +41,7 @@
 #include <dns/adb.h>
 #include <dns/db.h>
 #include <dns/events.h>
+#include <dns/fixedname.h>
 #include <dns/log.h>
 #include <dns/rdata.h>
 #include <dns/rdataset.h>
@@ -124,8 +129,7 @@ struct dns_adb {
 	 * XXXRTH  Have a per-bucket structure that contains all of these?
 	 */
 	unsigned int nnames;
-	isc_mutex_t namescntlock;
-	unsigned int namescnt;
+	atomic_uint_fast32_t namescnt;
 	dns_adbnamelist_t *names;
 	dns_adbnamelist_t *deadnames;
 	isc_mutex_t *namelocks;
@@ -138,8 +142,7 @@ struct dns_adb {
 	 * XXXRTH  Have a per-bucket structure that contains all of these?
 	 */
 	unsigned int nentries;
-	isc_mutex_t entriescntlock;
-	unsigned int entriescnt;
+	atomic_uint_fast32_t entriescnt;
 	dns_adbentrylist_t *entries;
 	dns_adbentrylist_t *deadentries;
 	isc_mutex_t *entrylocks;
@@ -151,15 +154,17 @@ struct dns_adb {
 	atomic_bool shutting_down;
 	isc_eventlist_t whenshutdown;
 	isc_event_t growentries;
-	bool growentries_sent;
+	atomic_bool growentries_sent;
 	isc_event_t grownames;
-	bool grownames_sent;
+	atomic_bool grownames_sent;
 
 	uint32_t quota;
 	uint32_t atr_freq;
 	double atr_low;
 	double atr_high;
 	double atr_discount;
+
+	char *statefile; /*%< see dns_adb_setstatefile() */
 };
 
 /*
@@ -240,6 +245,7 @@ struct dns_adbentry {
 
 	unsigned int flags;
 	unsigned int srtt;
+	unsigned int rttvar;
 	uint16_t udpsize;
 	unsigned int completed;
 	unsigned int timeouts;
@@ -692,7 +698,7 @@ grow_entries(isc_task_t *task, isc_event_t *ev) {
 	 * Only on success do we set adb->growentries_sent to false.
 	 * This will prevent us being continuously being called on error.
 	 */
-	adb->growentries_sent = false;
+	atomic_store_release(&adb->growentries_sent, false);
 	goto done;
 
 cleanup:
@@ -856,7 +862,7 @@ grow_names(isc_task_t *task, isc_event_t *ev) {
 	 * Only on success do we set adb->grownames_sent to false.
 	 * This will prevent us being continuously being called on error.
 	 */
-	adb->grownames_sent = false;
+	atomic_store_release(&adb->grownames_sent, false);
 	goto done;
 
 cleanup:
@@ -1694,6 +1700,7 @@ dec_entry_refcnt(dns_adb_t *adb, bool overmem, dns_adbentry_t *entry, bool lock,
 static dns_adbname_t *
 new_adbname(dns_adb_t *adb, const dns_name_t *dnsname) {
 	dns_adbname_t *name;
+	uint_fast32_t namescnt;
 
 	name = isc_mem_get(adb->mctx, sizeof(*name));
 
@@ -1718,18 +1725,21 @@ new_adbname(dns_adb_t *adb, const dns_name_t *dnsname) {
 	ISC_LIST_INIT(name->finds);
 	ISC_LINK_INIT(name, plink);
 
-	LOCK(&adb->namescntlock);
-	adb->namescnt++;
+	/*
+	 * The counter is atomic so that creating a name does not
+	 * serialize on an ADB-wide lock; only the thread that flips
+	 * 'grownames_sent' schedules the (exclusive) table growth.
+	 */
+	namescnt = atomic_fetch_add_relaxed(&adb->namescnt, 1) + 1;
 	inc_adbstats(adb, dns_adbstats_namescnt);
-	if (!adb->grownames_sent && adb->excl != NULL &&
-	    adb->namescnt > (adb->nnames * 8))
+	if (adb->excl != NULL && namescnt > (adb->nnames * 8) &&
+	    atomic_compare_exchange_strong_acq_rel(&adb->grownames_sent,
+						   &(bool){ false }, true))
 	{
 		isc_event_t *event = &adb->grownames;
 		inc_adb_irefcnt(adb);
 		isc_task_send(adb->excl, &event);
-		adb->grownames_sent = true;
 	}
-	UNLOCK(&adb->namescntlock);
 
 	return (name);
 }
@@ -1737,6 +1747,7 @@ new_adbname(dns_adb_t *adb, const dns_name_t *dnsname) {
 static void
 free_adbname(dns_adb_t *adb, dns_adbname_t **name) {
 	dns_adbname_t *n;
+	uint_fast32_t namescnt;
 
 	INSIST(name != NULL && DNS_ADBNAME_VALID(*name));
 	n = *name;
@@ -1754,10 +1765,9 @@ free_adbname(dns_adb_t *adb, dns_adbname_t **name) {
 	dns_name_free(&n->name, adb->mctx);
 
 	isc_mem_put(adb->mctx, n, sizeof(*n));
-	LOCK(&adb->namescntlock);
-	adb->namescnt--;
+	namescnt = atomic_fetch_sub_relaxed(&adb->namescnt, 1);
+	INSIST(namescnt > 0);
 	dec_adbstats(adb, dns_adbstats_namescnt);
-	UNLOCK(&adb->namescntlock);
 }
 
 static dns_adbnamehook_t *
@@ -1828,6 +1838,7 @@ free_adblameinfo(dns_adb_t *adb, dns_adblameinfo_t **lameinfo) {
 static dns_adbentry_t *
 new_adbentry(dns_adb_t *adb) {
 	dns_adbentry_t *e;
+	uint_fast32_t entriescnt;
 
 	e = isc_mem_get(adb->mctx, sizeof(*e));
 
@@ -1846,6 +1857,7 @@ new_adbentry(dns_adb_t *adb) {
 	e->cookie = NULL;
 	e->cookielen = 0;
 	e->srtt = (isc_random_uniform(0x1f)) + 1;
+	e->rttvar = 0;
 	e->lastage = 0;
 	e->expires = 0;
 	atomic_init(&e->active, 0);
@@ -1854,18 +1866,16 @@ new_adbentry(dns_adb_t *adb) {
 	e->atr = 0.0;
 	ISC_LIST_INIT(e->lameinfo);
 	ISC_LINK_INIT(e, plink);
-	LOCK(&adb->entriescntlock);
-	adb->entriescnt++;
+	entriescnt = atomic_fetch_add_relaxed(&adb->entriescnt, 1) + 1;
 	inc_adbstats(adb, dns_adbstats_entriescnt);
-	if (!adb->growentries_sent && adb->excl != NULL &&
-	    adb->entriescnt > (adb->nentries * 8))
+	if (adb->excl != NULL && entriescnt > (adb->nentries * 8) &&
+	    atomic_compare_exchange_strong_acq_rel(&adb->growentries_sent,
+						   &(bool){ false }, true))
 	{
 		isc_event_t *event = &adb->growentries;
 		inc_adb_irefcnt(adb);
 		isc_task_send(adb->excl, &event);
-		adb->growentries_sent = true;
 	}
-	UNLOCK(&adb->entriescntlock);
 
 	return (e);
 }
@@ -1874,7 +1884,7 @@ static void
 free_adbentry(dns_adb_t *adb, dns_adbentry_t **entry) {
 	dns_adbentry_t *e;
 	dns_adblameinfo_t *li;
-	uint_fast32_t active;
+	uint_fast32_t active, entriescnt;
 
 	INSIST(entry != NULL && DNS_ADBENTRY_VALID(*entry));
 	e = *entry;
@@ -1900,10 +1910,9 @@ free_adbentry(dns_adb_t *adb, dns_adbentry_t **entry) {
 	}
 
 	isc_mem_put(adb->mctx, e, sizeof(*e));
-	LOCK(&adb->entriescntlock);
-	adb->entriescnt--;
+	entriescnt = atomic_fetch_sub_relaxed(&adb->entriescnt, 1);
+	INSIST(entriescnt > 0);
 	dec_adbstats(adb, dns_adbstats_entriescnt);
-	UNLOCK(&adb->entriescntlock);
 }
 
 static dns_adbfind_t *
@@ -2013,6 +2022,7 @@ new_adbaddrinfo(dns_adb_t *adb, dns_adbentry_t *entry, in_port_t port) {
 	ai->sockaddr = entry->sockaddr;
 	isc_sockaddr_setport(&ai->sockaddr, port);
 	ai->srtt = entry->srtt;
+	ai->rttvar = entry->rttvar;
 	ai->flags = entry->flags;
 	ai->entry = entry;
 	ISC_LINK_INIT(ai, publink);
@@ -2516,11 +2526,13 @@ destroy(dns_adb_t *adb) {
 
 	isc_mem_destroy(&adb->hmctx);
 
+	if (adb->statefile != NULL) {
+		isc_mem_free(adb->mctx, adb->statefile);
+	}
+
 	isc_mutex_destroy(&adb->reflock);
 	isc_mutex_destroy(&adb->lock);
 	isc_mutex_destroy(&adb->overmemlock);
-	isc_mutex_destroy(&adb->entriescntlock);
-	isc_mutex_destroy(&adb->namescntlock);
 
 	isc_mem_putanddetach(&adb->mctx, adb, sizeof(dns_adb_t));
 }
@@ -2559,6 +2571,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->hmctx = NULL;
 	adb->view = view;
 	adb->taskmgr = taskmgr;
+	adb->statefile = NULL;
 	adb->next_cleanbucket = 0;
 	ISC_EVENT_INIT(&adb->cevent, sizeof(adb->cevent), 0, NULL, 0, NULL,
 		       NULL, NULL, NULL, NULL);
@@ -2567,7 +2580,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	ISC_LIST_INIT(adb->whenshutdown);
 
 	adb->nentries = nbuckets[0];
-	adb->entriescnt = 0;
+	atomic_init(&adb->entriescnt, 0);
 	adb->entries = NULL;
 	adb->deadentries = NULL;
 	adb->entry_sd = NULL;
@@ -2576,7 +2589,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	ISC_EVENT_INIT(&adb->growentries, sizeof(adb->growentries), 0, NULL,
 		       DNS_EVENT_ADBGROWENTRIES, grow_entries, adb, adb, NULL,
 		       NULL);
-	adb->growentries_sent = false;
+	atomic_init(&adb->growentries_sent, false);
 
 	adb->quota = 0;
 	adb->atr_freq = 0;
@@ -2585,7 +2598,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->atr_discount = 0.0;
 
 	adb->nnames = nbuckets[0];
-	adb->namescnt = 0;
+	atomic_init(&adb->namescnt, 0);
 	adb->names = NULL;
 	adb->deadnames = NULL;
 	adb->name_sd = NULL;
@@ -2594,7 +2607,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	ISC_EVENT_INIT(&adb->grownames, sizeof(adb->grownames), 0, NULL,
 		       DNS_EVENT_ADBGROWNAMES, grow_names, adb, adb, NULL,
 		       NULL);
-	adb->grownames_sent = false;
+	atomic_init(&adb->grownames_sent, false);
 
 	result = isc_taskmgr_excltask(adb->taskmgr, &adb->excl);
 	if (result != ISC_R_SUCCESS) {
@@ -2611,8 +2624,6 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	isc_mutex_init(&adb->lock);
 	isc_mutex_init(&adb->reflock);
 	isc_mutex_init(&adb->overmemlock);
-	isc_mutex_init(&adb->entriescntlock);
-	isc_mutex_init(&adb->namescntlock);
 
 	isc_mem_create(&adb->hmctx);
 	isc_mem_setname(adb->hmctx, "ADB_hashmaps");
@@ -2743,8 +2754,6 @@ fail2:
 
 	isc_mem_destroy(&adb->hmctx);
 
-	isc_mutex_destroy(&adb->namescntlock);
-	isc_mutex_destroy(&adb->entriescntlock);
 	isc_mutex_destroy(&adb->overmemlock);
 	isc_mutex_destroy(&adb->reflock);
 	isc_mutex_destroy(&adb->lock);
@@ -4183,25 +4192,37 @@ dns_adb_agesrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, isc_stdtime_t now) {
 static void
 adjustsrtt(dns_adbaddrinfo_t *addr, unsigned int rtt, unsigned int factor,
 	   isc_stdtime_t now) {
-	uint64_t new_srtt;
+	uint64_t new_srtt, new_rttvar;
 
+	new_rttvar = addr->entry->rttvar;
 	if (factor == DNS_ADB_RTTADJAGE) {
 		if (addr->entry->lastage != now) {
 			new_srtt = addr->entry->srtt;
 			new_srtt <<= 9;
 			new_srtt -= addr->entry->srtt;
 			new_srtt >>= 9;
+			new_rttvar -= new_rttvar >> 9;
 			addr->entry->lastage = now;
 		} else {
 			new_srtt = addr->entry->srtt;
 		}
 	} else {
+		/*
+		 * The mean deviation is smoothed as in RFC 6298, with a
+		 * gain of 1/4, against the srtt before this sample.
+		 */
+		uint64_t delta = (rtt > addr->entry->srtt)
+					 ? rtt - addr->entry->srtt
+					 : addr->entry->srtt - rtt;
+		new_rttvar = (3 * new_rttvar + delta) / 4;
 		new_srtt = ((uint64_t)addr->entry->srtt / 10 * factor) +
 			   ((uint64_t)rtt / 10 * (10 - factor));
 	}
 
 	addr->entry->srtt = (unsigned int)new_srtt;
 	addr->srtt = (unsigned int)new_srtt;
+	addr->entry->rttvar = (unsigned int)new_rttvar;
+	addr->rttvar = (unsigned int)new_rttvar;
 
 	if (addr->entry->expires == 0) {
 		addr->entry->expires = now + ADB_ENTRY_WINDOW;
@@ -4729,3 +4750,305 @@ dns_adb_endudpfetch(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
 	active = atomic_fetch_sub_release(&addr->entry->active, 1);
 	INSIST(active != 0);
 }
+
+#define RETERR(x)                            \
+	do {                                 \
+		result = (x);                \
+		if (result != ISC_R_SUCCESS) \
+			return (result);     \
+	} while (0)
+
+#define TSTR(t) ((t).value.as_textregion.base)
+
+/*
+ * The server state file has one line for every address entry:
+ *
+ *	<address> <port> <flags> <srtt> <edns> <ednsto> <plain> <plainto>
+ *		<udpsize>
+ *
+ * each followed by a line for every name and type the address is
+ * lame for:
+ *
+ *	lame <name> <type> <expire>
+ */
+void
+dns_adb_setstatefile(dns_adb_t *adb, const char *filename) {
+	REQUIRE(DNS_ADB_VALID(adb));
+
+	if (adb->statefile != NULL) {
+		isc_mem_free(adb->mctx, adb->statefile);
+	}
+	if (filename != NULL) {
+		adb->statefile = isc_mem_strdup(adb->mctx, filename);
+	}
+}
+
+static void
+save_entry(FILE *fp, dns_adbentry_t *entry, isc_stdtime_t now) {
+	char addrbuf[ISC_NETADDR_FORMATSIZE];
+	char typebuf[DNS_RDATATYPE_FORMATSIZE];
+	char namebuf[DNS_NAME_FORMATSIZE];
+	isc_netaddr_t netaddr;
+	dns_adblameinfo_t *li;
+
+	isc_netaddr_fromsockaddr(&netaddr, &entry->sockaddr);
+	isc_netaddr_format(&netaddr, addrbuf, sizeof(addrbuf));
+
+	fprintf(fp, "%s %u %u %u %u %u %u %u %u\n", addrbuf,
+		isc_sockaddr_getport(&entry->sockaddr), entry->flags,
+		entry->srtt, entry->edns, entry->ednsto, entry->plain,
+		entry->plainto, entry->udpsize);
+
+	for (li = ISC_LIST_HEAD(entry->lameinfo); li != NULL;
+	     li = ISC_LIST_NEXT(li, plink))
+	{
+		if (li->lame_timer <= now) {
+			continue;
+		}
+		dns_name_format(&li->qname, namebuf, sizeof(namebuf));
+		dns_rdatatype_format(li->qtype, typebuf, sizeof(typebuf));
+		fprintf(fp, "lame %s %s %u\n", namebuf, typebuf,
+			li->lame_timer);
+	}
+}
+
+isc_result_t
+dns_adb_savestate(dns_adb_t *adb) {
+	isc_result_t result;
+	isc_stdtime_t now;
+	char *tempname = NULL;
+	size_t tempnamelen;
+	FILE *fp = NULL;
+
+	REQUIRE(DNS_ADB_VALID(adb));
+
+	if (adb->statefile == NULL) {
+		return (ISC_R_SUCCESS);
+	}
+
+	tempnamelen = strlen(adb->statefile) + 20;
+	tempname = isc_mem_allocate(adb->mctx, tempnamelen);
+	result = isc_file_mktemplate(adb->statefile, tempname, tempnamelen);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	result = isc_file_openunique(tempname, &fp);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	LOCK(&adb->lock);
+	isc_stdtime_get(&now);
+	for (unsigned int i = 0; i < adb->nentries; i++) {
+		dns_adbentry_t *entry;
+
+		LOCK(&adb->entrylocks[i]);
+		for (entry = ISC_LIST_HEAD(adb->entries[i]); entry != NULL;
+		     entry = ISC_LIST_NEXT(entry, plink))
+		{
+			if (entry->expires == 0 || entry->expires > now) {
+				save_entry(fp, entry, now);
+			}
+		}
+		UNLOCK(&adb->entrylocks[i]);
+	}
+	UNLOCK(&adb->lock);
+
+	result = isc_stdio_flush(fp);
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_sync(fp);
+	}
+	if (isc_stdio_close(fp) != ISC_R_SUCCESS && result == ISC_R_SUCCESS) {
+		result = ISC_R_FAILURE;
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = isc_file_rename(tempname, adb->statefile);
+	}
+	if (result != ISC_R_SUCCESS) {
+		(void)isc_file_remove(tempname);
+	}
+
+cleanup:
+	isc_mem_free(adb->mctx, tempname);
+	return (result);
+}
+
+static isc_result_t
+load_number(isc_lex_t *lex, uint32_t max, uint32_t *valuep) {
+	isc_result_t result;
+	isc_token_t token;
+
+	result = isc_lex_getmastertoken(lex, &token, isc_tokentype_number,
+					false);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	if (token.value.as_ulong > max) {
+		return (ISC_R_RANGE);
+	}
+	*valuep = (uint32_t)token.value.as_ulong;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+load_entry(dns_adb_t *adb, isc_lex_t *lex, const char *addr,
+	   isc_sockaddr_t *sockaddr, isc_stdtime_t now) {
+	isc_result_t result;
+	struct in_addr in4;
+	struct in6_addr in6;
+	uint32_t port, flags, srtt, edns, ednsto, plain, plainto, udpsize;
+	dns_adbentry_t *entry;
+	int bucket = DNS_ADB_INVALIDBUCKET;
+
+	RETERR(load_number(lex, UINT16_MAX, &port));
+	if (inet_pton(AF_INET, addr, &in4) == 1) {
+		isc_sockaddr_fromin(sockaddr, &in4, (in_port_t)port);
+	} else if (inet_pton(AF_INET6, addr, &in6) == 1) {
+		isc_sockaddr_fromin6(sockaddr, &in6, (in_port_t)port);
+	} else {
+		return (ISC_R_BADADDRESSFORM);
+	}
+
+	RETERR(load_number(lex, UINT32_MAX, &flags));
+	RETERR(load_number(lex, UINT32_MAX, &srtt));
+	RETERR(load_number(lex, UINT8_MAX, &edns));
+	RETERR(load_number(lex, UINT8_MAX, &ednsto));
+	RETERR(load_number(lex, UINT8_MAX, &plain));
+	RETERR(load_number(lex, UINT8_MAX, &plainto));
+	RETERR(load_number(lex, UINT16_MAX, &udpsize));
+
+	entry = find_entry_and_lock(adb, sockaddr, &bucket, now);
+	if (entry == NULL && !adb->entry_sd[bucket]) {
+		entry = new_adbentry(adb);
+		entry->sockaddr = *sockaddr;
+		entry->flags = flags & ~ENTRY_IS_DEAD;
+		entry->srtt = srtt;
+		entry->edns = (unsigned char)edns;
+		entry->ednsto = (unsigned char)ednsto;
+		entry->plain = (unsigned char)plain;
+		entry->plainto = (unsigned char)plainto;
+		entry->udpsize = (uint16_t)udpsize;
+		entry->expires = now + ADB_ENTRY_WINDOW;
+		link_entry(adb, bucket, entry);
+	}
+	UNLOCK(&adb->entrylocks[bucket]);
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+load_lame(dns_adb_t *adb, isc_lex_t *lex, const isc_sockaddr_t *sockaddr,
+	  isc_stdtime_t now) {
+	isc_result_t result;
+	isc_token_t token;
+	dns_fixedname_t fixed;
+	dns_name_t *qname = dns_fixedname_initname(&fixed);
+	dns_rdatatype_t qtype;
+	uint32_t expire;
+	dns_adbentry_t *entry;
+	dns_adblameinfo_t *li;
+	int bucket = DNS_ADB_INVALIDBUCKET;
+
+	RETERR(isc_lex_getmastertoken(lex, &token, isc_tokentype_string,
+				      false));
+	RETERR(dns_name_fromstring(qname, TSTR(token), 0, NULL));
+	RETERR(isc_lex_getmastertoken(lex, &token, isc_tokentype_string,
+				      false));
+	RETERR(dns_rdatatype_fromtext(&qtype, &token.value.as_textregion));
+	RETERR(load_number(lex, UINT32_MAX, &expire));
+
+	if (expire <= now) {
+		return (ISC_R_SUCCESS);
+	}
+
+	entry = find_entry_and_lock(adb, sockaddr, &bucket, now);
+	if (entry != NULL) {
+		li = new_adblameinfo(adb, qname, qtype);
+		li->lame_timer = expire;
+		ISC_LIST_PREPEND(entry->lameinfo, li, plink);
+	}
+	UNLOCK(&adb->entrylocks[bucket]);
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_adb_loadstate(dns_adb_t *adb) {
+	isc_result_t result;
+	isc_lex_t *lex = NULL;
+	isc_token_t token;
+	isc_stdtime_t now;
+	isc_sockaddr_t sockaddr;
+	bool haveentry = false;
+
+	REQUIRE(DNS_ADB_VALID(adb));
+
+	if (adb->statefile == NULL) {
+		return (ISC_R_SUCCESS);
+	}
+
+	result = isc_lex_create(adb->mctx, 1024, &lex);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	isc_lex_setcomments(lex, ISC_LEXCOMMENT_DNSMASTERFILE);
+	result = isc_lex_openfile(lex, adb->statefile);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	isc_stdtime_get(&now);
+	for (;;) {
+		result = isc_lex_gettoken(lex, ISC_LEXOPT_EOL | ISC_LEXOPT_EOF,
+					  &token);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		if (token.type == isc_tokentype_eof) {
+			break;
+		} else if (token.type == isc_tokentype_eol) {
+			continue;
+		} else if (token.type != isc_tokentype_string) {
+			result = ISC_R_UNEXPECTEDTOKEN;
+			break;
+		}
+
+		if (strcmp(TSTR(token), "lame") == 0) {
+			if (!haveentry) {
+				result = ISC_R_UNEXPECTEDTOKEN;
+				break;
+			}
+			result = load_lame(adb, lex, &sockaddr, now);
+		} else {
+			result = load_entry(adb, lex, TSTR(token),
+					    &sockaddr, now);
+			haveentry = (result == ISC_R_SUCCESS);
+		}
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		result = isc_lex_gettoken(lex, ISC_LEXOPT_EOL | ISC_LEXOPT_EOF,
+					  &token);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		if (token.type != isc_tokentype_eol &&
+		    token.type != isc_tokentype_eof)
+		{
+			result = ISC_R_UNEXPECTEDTOKEN;
+			break;
+		}
+	}
+
+	if (result != ISC_R_SUCCESS) {
+		DP(ISC_LOG_WARNING, "adb: %s:%lu: %s", adb->statefile,
+		   isc_lex_getsourceline(lex), isc_result_totext(result));
+	}
+
+	isc_lex_close(lex);
+
+cleanup:
+	isc_lex_destroy(&lex);
+	return (result);
+}
@@ -18,6 +18,7 @@
 
 #include <isc/buffer.h>
 #include <isc/hash.h>
+#include <isc/list.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
@@ -35,6 +36,19 @@
 
 typedef struct dns_bcentry dns_bcentry_t;
 
+/*%
+ * Entries are also kept on an expiry wheel of BADCACHE_WHEEL one-second
+ * slots, by the second they expire in, so that expired entries can be
+ * removed without scanning the hash table.  An entry that lives longer
+ * than the wheel is passed over once per turn.
+ */
+#define BADCACHE_WHEEL 256
+
+typedef struct badcache_slot {
+	isc_mutex_t lock;
+	ISC_LIST(dns_bcentry_t) entries;
+} badcache_slot_t;
+
 struct dns_badcache {
 	unsigned int magic;
 	isc_rwlock_t lock;
@@ -44,10 +58,12 @@ struct dns_badcache {
 	dns_bcentry_t **table;
 
 	atomic_uint_fast32_t count;
-	atomic_uint_fast32_t sweep;
+	atomic_uint_fast32_t swept; /*%< last second expired on the wheel */
 
 	unsigned int minsize;
 	unsigned int size;
+
+	badcache_slot_t wheel[BADCACHE_WHEEL];
 };
 
 #define BADCACHE_MAGIC	  ISC_MAGIC('B', 'd', 'C', 'a')
@@ -55,6 +71,7 @@ struct dns_badcache {
 
 struct dns_bcentry {
 	dns_bcentry_t *next;
+	ISC_LINK(dns_bcentry_t) wlink;
 	dns_rdatatype_t type;
 	isc_time_t expire;
 	uint32_t flags;
@@ -66,6 +83,121 @@ struct dns_bcentry {
 static void
 badcache_resize(dns_badcache_t *bc, isc_time_t *now);
 
+static badcache_slot_t *
+wheel_slot(dns_badcache_t *bc, const isc_time_t *expire) {
+	return (&bc->wheel[isc_time_seconds(expire) % BADCACHE_WHEEL]);
+}
+
+/*
+ * Put 'bad' on the wheel.  Requires the lock of its hash bucket.
+ */
+static void
+wheel_link(dns_badcache_t *bc, dns_bcentry_t *bad) {
+	badcache_slot_t *slot = wheel_slot(bc, &bad->expire);
+
+	LOCK(&slot->lock);
+	ISC_LIST_APPEND(slot->entries, bad, wlink);
+	UNLOCK(&slot->lock);
+}
+
+/*
+ * Take 'bad' off the wheel.  Requires the lock of its hash bucket.
+ */
+static void
+wheel_unlink(dns_badcache_t *bc, dns_bcentry_t *bad) {
+	badcache_slot_t *slot = wheel_slot(bc, &bad->expire);
+
+	LOCK(&slot->lock);
+	ISC_LIST_UNLINK(slot->entries, bad, wlink);
+	UNLOCK(&slot->lock);
+}
+
+/*
+ * Free 'bad', which has been taken out of its hash chain.  Requires
+ * the lock of its hash bucket.
+ */
+static void
+bcentry_free(dns_badcache_t *bc, dns_bcentry_t *bad) {
+	wheel_unlink(bc, bad);
+	isc_mem_put(bc->mctx, bad, sizeof(*bad));
+	atomic_fetch_sub_relaxed(&bc->count, 1);
+}
+
+static void
+bcentry_setexpire(dns_badcache_t *bc, dns_bcentry_t *bad,
+		  const isc_time_t *expire) {
+	if (isc_time_seconds(expire) != isc_time_seconds(&bad->expire)) {
+		wheel_unlink(bc, bad);
+		bad->expire = *expire;
+		wheel_link(bc, bad);
+	} else {
+		bad->expire = *expire;
+	}
+}
+
+/*
+ * Remove the entries in 'slot' that have expired by 'now'.  The wheel
+ * is walked in the opposite lock order to the hash table, so entries
+ * whose hash bucket is busy are left for the next turn of the wheel,
+ * or for a lookup to remove.  Requires the table lock.
+ */
+static void
+expire_slot(dns_badcache_t *bc, badcache_slot_t *slot, isc_time_t *now) {
+	dns_bcentry_t *bad, *next;
+
+	LOCK(&slot->lock);
+	for (bad = ISC_LIST_HEAD(slot->entries); bad != NULL; bad = next) {
+		dns_bcentry_t **prevp = NULL;
+		unsigned int hash;
+
+		next = ISC_LIST_NEXT(bad, wlink);
+		if (isc_time_compare(&bad->expire, now) >= 0) {
+			continue;
+		}
+
+		hash = bad->hashval % bc->size;
+		if (isc_mutex_trylock(&bc->tlocks[hash]) != ISC_R_SUCCESS) {
+			continue;
+		}
+		for (prevp = &bc->table[hash]; *prevp != bad;
+		     prevp = &(*prevp)->next)
+		{
+			INSIST(*prevp != NULL);
+		}
+		*prevp = bad->next;
+		UNLOCK(&bc->tlocks[hash]);
+
+		ISC_LIST_UNLINK(slot->entries, bad, wlink);
+		isc_mem_put(bc->mctx, bad, sizeof(*bad));
+		atomic_fetch_sub_relaxed(&bc->count, 1);
+	}
+	UNLOCK(&slot->lock);
+}
+
+/*
+ * Expire the slots of the seconds that have passed since this was
+ * last done; at most one thread does this each second.  Requires the
+ * table lock.
+ */
+static void
+badcache_expire(dns_badcache_t *bc, isc_time_t *now) {
+	uint_fast32_t last = atomic_load_relaxed(&bc->swept);
+	uint32_t upto = isc_time_seconds(now) - 1;
+
+	if (last >= upto ||
+	    !atomic_compare_exchange_strong_relaxed(&bc->swept, &last, upto))
+	{
+		return;
+	}
+
+	if (upto - last > BADCACHE_WHEEL) {
+		last = upto - BADCACHE_WHEEL;
+	}
+	while (last++ < upto) {
+		expire_slot(bc, &bc->wheel[last % BADCACHE_WHEEL], now);
+	}
+}
+
 isc_result_t
 dns_badcache_init(isc_mem_t *mctx, unsigned int size, dns_badcache_t **bcp) {
 	dns_badcache_t *bc = NULL;
@@ -88,8 +220,13 @@ dns_badcache_init(isc_mem_t *mctx, unsigned int size, dns_badcache_t **bcp) {
 	bc->size = bc->minsize = size;
 	memset(bc->table, 0, bc->size * sizeof(dns_bcentry_t *));
 
+	for (i = 0; i < BADCACHE_WHEEL; i++) {
+		isc_mutex_init(&bc->wheel[i].lock);
+		ISC_LIST_INIT(bc->wheel[i].entries);
+	}
+
 	atomic_init(&bc->count, 0);
-	atomic_init(&bc->sweep, 0);
+	atomic_init(&bc->swept, 0);
 	bc->magic = BADCACHE_MAGIC;
 
 	*bcp = bc;
@@ -112,6 +249,10 @@ dns_badcache_destroy(dns_badcache_t **bcp) {
 	for (i = 0; i < bc->size; i++) {
 		isc_mutex_destroy(&bc->tlocks[i]);
 	}
+	for (i = 0; i < BADCACHE_WHEEL; i++) {
+		INSIST(ISC_LIST_EMPTY(bc->wheel[i].entries));
+		isc_mutex_destroy(&bc->wheel[i].lock);
+	}
 	isc_mem_put(bc->mctx, bc->table, sizeof(dns_bcentry_t *) * bc->size);
 	isc_mem_put(bc->mctx, bc->tlocks, sizeof(isc_mutex_t) * bc->size);
 	isc_mem_putanddetach(&bc->mctx, bc, sizeof(dns_badcache_t));
@@ -186,8 +327,7 @@ badcache_resize(dns_badcache_t *bc, isc_time_t *now) {
 		for (bad = bc->table[i]; bad != NULL; bad = next) {
 			next = bad->next;
 			if (isc_time_compare(&bad->expire, now) < 0) {
-				isc_mem_put(bc->mctx, bad, sizeof(*bad));
-				atomic_fetch_sub_relaxed(&bc->count, 1);
+				bcentry_free(bc, bad);
 			} else {
 				bad->next = newtable[bad->hashval % newsize];
 				newtable[bad->hashval % newsize] = bad;
@@ -227,6 +367,8 @@ dns_badcache_add(dns_badcache_t *bc, const dns_name_t *name,
 		isc_time_settoepoch(&now);
 	}
 
+	badcache_expire(bc, &now);
+
 	hashval = dns_name_hash(name, false);
 	hash = hashval % bc->size;
 	LOCK(&bc->tlocks[hash]);
@@ -235,7 +377,6 @@ dns_badcache_add(dns_badcache_t *bc, const dns_name_t *name,
 		next = bad->next;
 		if (bad->type == type && dns_name_equal(name, bad->name)) {
 			if (update) {
-				bad->expire = *expire;
 				bad->flags = flags;
 			}
 			break;
@@ -246,8 +387,7 @@ dns_badcache_add(dns_badcache_t *bc, const dns_name_t *name,
 			} else {
 				prev->next = bad->next;
 			}
-			isc_mem_put(bc->mctx, bad, sizeof(*bad));
-			atomic_fetch_sub_relaxed(&bc->count, 1);
+			bcentry_free(bc, bad);
 		} else {
 			prev = bad;
 		}
@@ -268,6 +408,8 @@ dns_badcache_add(dns_badcache_t *bc, const dns_name_t *name,
 		bad->name = dns_fixedname_initname(&bad->fname);
 		dns_name_copy(name, bad->name);
 		bc->table[hash] = bad;
+		ISC_LINK_INIT(bad, wlink);
+		wheel_link(bc, bad);
 
 		count = atomic_fetch_add_relaxed(&bc->count, 1);
 		if ((count > bc->size * 8) ||
@@ -276,7 +418,7 @@ dns_badcache_add(dns_badcache_t *bc, const dns_name_t *name,
 			resize = true;
 		}
 	} else {
-		bad->expire = *expire;
+		bcentry_setexpire(bc, bad, expire);
 	}
 
 	UNLOCK(&bc->tlocks[hash]);
@@ -291,7 +433,6 @@ dns_badcache_find(dns_badcache_t *bc, const dns_name_t *name,
 		  dns_rdatatype_t type, uint32_t *flagp, isc_time_t *now) {
 	dns_bcentry_t *bad, *prev, *next;
 	bool answer = false;
-	unsigned int i;
 	unsigned int hash;
 
 	REQUIRE(VALID_BADCACHE(bc));
@@ -331,8 +472,7 @@ dns_badcache_find(dns_badcache_t *bc, const dns_name_t *name,
 				bc->table[hash] = bad->next;
 			}
 
-			isc_mem_put(bc->mctx, bad, sizeof(*bad));
-			atomic_fetch_sub(&bc->count, 1);
+			bcentry_free(bc, bad);
 			continue;
 		}
 		if (bad->type == type && dns_name_equal(name, bad->name)) {
@@ -345,22 +485,9 @@ dns_badcache_find(dns_badcache_t *bc, const dns_name_t *name,
 		prev = bad;
 	}
 	UNLOCK(&bc->tlocks[hash]);
-skip:
-
-	/*
-	 * Slow sweep to clean out stale records.
-	 */
-	i = atomic_fetch_add(&bc->sweep, 1) % bc->size;
-	if (isc_mutex_trylock(&bc->tlocks[i]) == ISC_R_SUCCESS) {
-		bad = bc->table[i];
-		if (bad != NULL && isc_time_compare(&bad->expire, now) < 0) {
-			bc->table[i] = bad->next;
-			isc_mem_put(bc->mctx, bad, sizeof(*bad));
-			atomic_fetch_sub_relaxed(&bc->count, 1);
-		}
-		UNLOCK(&bc->tlocks[i]);
-	}
 
+	badcache_expire(bc, now);
+skip:
 	RWUNLOCK(&bc->lock, isc_rwlocktype_read);
 	return (answer);
 }
@@ -376,8 +503,7 @@ dns_badcache_flush(dns_badcache_t *bc) {
 	for (i = 0; atomic_load_relaxed(&bc->count) > 0 && i < bc->size; i++) {
 		for (entry = bc->table[i]; entry != NULL; entry = next) {
 			next = entry->next;
-			isc_mem_put(bc->mctx, entry, sizeof(*entry));
-			atomic_fetch_sub_relaxed(&bc->count, 1);
+			bcentry_free(bc, entry);
 		}
 		bc->table[i] = NULL;
 	}
@@ -414,8 +540,7 @@ dns_badcache_flushname(dns_badcache_t *bc, const dns_name_t *name) {
 				prev->next = bad->next;
 			}
 
-			isc_mem_put(bc->mctx, bad, sizeof(*bad));
-			atomic_fetch_sub_relaxed(&bc->count, 1);
+			bcentry_free(bc, bad);
 		} else {
 			prev = bad;
 		}
@@ -459,8 +584,7 @@ dns_badcache_flushtree(dns_badcache_t *bc, const dns_name_t *name) {
 					prev->next = bad->next;
 				}
 
-				isc_mem_put(bc->mctx, bad, sizeof(*bad));
-				atomic_fetch_sub_relaxed(&bc->count, 1);
+				bcentry_free(bc, bad);
 			} else {
 				prev = bad;
 			}
@@ -502,8 +626,7 @@ dns_badcache_print(dns_badcache_t *bc, const char *cachename, FILE *fp) {
 					bc->table[i] = bad->next;
 				}
 
-				isc_mem_put(bc->mctx, bad, sizeof(*bad));
-				atomic_fetch_sub_relaxed(&bc->count, 1);
+				bcentry_free(bc, bad);
 				continue;
 			}
 			prev = bad;
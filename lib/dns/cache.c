@@ -15,6 +15,7 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include <isc/mem.h>
 #include <isc/print.h>
@@ -28,10 +29,12 @@
 #include <isc/util.h>
 
 #include <dns/cache.h>
+#include <dns/callbacks.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/events.h>
 #include <dns/log.h>
+#include <dns/master.h>
 #include <dns/masterdump.h>
 #include <dns/rdata.h>
 #include <dns/rdataset.h>
@@ -48,6 +51,7 @@
 #endif /* HAVE_LIBXML2 */
 
 #include "rbtdb.h"
+#include "sharddb.h"
 
 #define CACHE_MAGIC	   ISC_MAGIC('$', '$', '$', '$')
 #define VALID_CACHE(cache) ISC_MAGIC_VALID(cache, CACHE_MAGIC)
@@ -65,6 +69,19 @@
  */
 #define DNS_CACHE_CLEANERINCREMENT 1000U /*%< Number of nodes. */
 
+/*!
+ * Control the sweepers that delete expired records from the buckets of
+ * the cache database.  Once a second, each one goes through its share of
+ * the buckets deleting SWEEPINCREMENT records at a time, halving or
+ * doubling that increment (within SWEEPMIN and SWEEPMAX) to keep each
+ * step well within SWEEPBUDGET.  After SWEEPBUDGET, the sweeper yields to
+ * the other events of its task and carries on where it stopped.
+ */
+#define DNS_CACHE_SWEEPINCREMENT 100U	/*%< Number of records. */
+#define DNS_CACHE_SWEEPMIN	 10U	/*%< Number of records. */
+#define DNS_CACHE_SWEEPMAX	 10000U /*%< Number of records. */
+#define DNS_CACHE_SWEEPBUDGET	 10000U /*%< Microseconds. */
+
 /***
  ***	Types
  ***/
@@ -119,6 +136,19 @@ struct cache_cleaner {
 	bool replaceiterator;
 };
 
+/*%
+ * A sweeper deletes expired records from every 'nsweepers'th bucket of
+ * the cache database, starting with bucket 'id', on its own task.
+ */
+typedef struct cache_sweeper {
+	dns_cache_t *cache;
+	isc_task_t *task;
+	isc_event_t *event; /*%< Locked by cache->lock; NULL while busy */
+	unsigned int id;
+	unsigned int next;	/*%< Bucket to carry on from */
+	unsigned int increment; /*%< Records to delete at a time */
+} cache_sweeper_t;
+
 /*%
  * The actual cache object.
  */
@@ -140,10 +170,34 @@ struct dns_cache {
 	char *db_type;
 	int db_argc;
 	char **db_argv;
+	unsigned int nshards;
 	size_t size;
 	dns_ttl_t serve_stale_ttl;
 	dns_ttl_t serve_stale_refresh;
+	dns_cachepolicy_t policy;
+	unsigned int topdomains;
 	isc_stats_t *stats;
+
+	/*
+	 * Locked by 'lock'.  'task' and every running dump, load or
+	 * sweep hold a reference in 'live_tasks', so the cache is not
+	 * freed before they are done.  The timers are destroyed when the
+	 * last reference to the cache is detached.
+	 */
+	isc_task_t *task; /*%< Runs the timers, dumps and loads */
+	isc_task_t *dbtask; /*%< Frees the databases */
+	isc_taskmgr_t *taskmgr;
+	char *dumpfile;
+	isc_timer_t *dumptimer;
+	dns_dumpctx_t *dumpctx;
+	dns_loadctx_t *loadctx;
+	dns_db_t *loaddb;
+	dns_rdatacallbacks_t loadcallbacks;
+	isc_timer_t *sweeptimer;
+	cache_sweeper_t *sweepers;
+	unsigned int nsweepers;
+	atomic_bool sweeping;
+	uint64_t sweptlast; /*%< Used by 'task' */
 };
 
 /***
@@ -166,14 +220,34 @@ overmem_cleaning_action(isc_task_t *task, isc_event_t *event);
 static void
 water(void *arg, int mark);
 
+static void
+dump_action(isc_task_t *task, isc_event_t *event);
+
+static void
+sweep_tick(isc_task_t *task, isc_event_t *event);
+
+static void
+cache_shutdown_action(isc_task_t *task, isc_event_t *event);
+
 static isc_result_t
 cache_create_db(dns_cache_t *cache, dns_db_t **db) {
 	isc_result_t result;
-	result = dns_db_create(cache->mctx, cache->db_type, dns_rootname,
-			       dns_dbtype_cache, cache->rdclass, cache->db_argc,
-			       cache->db_argv, db);
+	if (cache->nshards > 1 && strcmp(cache->db_type, "rbt") == 0) {
+		result = dns_sharddb_create(cache->mctx, cache->hmctx,
+					    cache->rdclass, cache->nshards, db);
+	} else {
+		result = dns_db_create(cache->mctx, cache->db_type,
+				       dns_rootname, dns_dbtype_cache,
+				       cache->rdclass, cache->db_argc,
+				       cache->db_argv, db);
+	}
 	if (result == ISC_R_SUCCESS) {
 		dns_db_setservestalettl(*db, cache->serve_stale_ttl);
+		(void)dns_db_setcachepolicy(*db, cache->policy);
+		dns_db_setdomainusage(*db, cache->topdomains > 0);
+		if (cache->dbtask != NULL) {
+			dns_db_settask(*db, cache->dbtask);
+		}
 	}
 	return (result);
 }
@@ -182,17 +256,18 @@ isc_result_t
 dns_cache_create(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 		 isc_timermgr_t *timermgr, dns_rdataclass_t rdclass,
 		 const char *cachename, const char *db_type,
-		 unsigned int db_argc, char **db_argv, dns_cache_t **cachep) {
+		 unsigned int db_argc, char **db_argv, unsigned int nshards,
+		 dns_cache_t **cachep) {
 	isc_result_t result;
 	dns_cache_t *cache;
 	int i, extra = 0;
-	isc_task_t *dbtask;
 
 	REQUIRE(cachep != NULL);
 	REQUIRE(*cachep == NULL);
 	REQUIRE(cmctx != NULL);
 	REQUIRE(hmctx != NULL);
 	REQUIRE(cachename != NULL);
+	REQUIRE(nshards > 0 && nshards <= DNS_CACHE_MAXSHARDS);
 
 	cache = isc_mem_get(cmctx, sizeof(*cache));
 
@@ -210,7 +285,23 @@ dns_cache_create(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	isc_refcount_init(&cache->references, 1);
 	isc_refcount_init(&cache->live_tasks, 1);
 	cache->rdclass = rdclass;
+	cache->nshards = nshards;
 	cache->serve_stale_ttl = 0;
+	cache->policy = dns_cachepolicy_lru;
+	cache->topdomains = 0;
+	cache->task = NULL;
+	cache->dbtask = NULL;
+	cache->taskmgr = taskmgr;
+	cache->dumpfile = NULL;
+	cache->dumptimer = NULL;
+	cache->dumpctx = NULL;
+	cache->loadctx = NULL;
+	cache->loaddb = NULL;
+	cache->sweeptimer = NULL;
+	cache->sweepers = NULL;
+	cache->nsweepers = 0;
+	atomic_init(&cache->sweeping, true);
+	cache->sweptlast = 0;
 
 	cache->stats = NULL;
 	result = isc_stats_create(cmctx, &cache->stats,
@@ -251,21 +342,39 @@ dns_cache_create(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	/*
 	 * Create the database
 	 */
+	if (taskmgr != NULL) {
+		result = isc_task_create(taskmgr, 1, &cache->dbtask);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup_dbargv;
+		}
+		isc_task_setname(cache->dbtask, "cache_dbtask", NULL);
+	}
+
 	cache->db = NULL;
 	result = cache_create_db(cache, &cache->db);
 	if (result != ISC_R_SUCCESS) {
-		goto cleanup_dbargv;
+		goto cleanup_dbtask;
 	}
-	if (taskmgr != NULL) {
-		dbtask = NULL;
-		result = isc_task_create(taskmgr, 1, &dbtask);
+
+	if (taskmgr != NULL && timermgr != NULL) {
+		result = isc_task_create(taskmgr, 1, &cache->task);
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup_db;
 		}
+		isc_task_setname(cache->task, "cache", cache);
 
-		isc_task_setname(dbtask, "cache_dbtask", NULL);
-		dns_db_settask(cache->db, dbtask);
-		isc_task_detach(&dbtask);
+		result = isc_timer_create(timermgr, isc_timertype_inactive,
+					  NULL, NULL, cache->task, dump_action,
+					  cache, &cache->dumptimer);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup_task;
+		}
+		result = isc_timer_create(timermgr, isc_timertype_inactive,
+					  NULL, NULL, cache->task, sweep_tick,
+					  cache, &cache->sweeptimer);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup_timer;
+		}
 	}
 
 	cache->magic = CACHE_MAGIC;
@@ -281,19 +390,47 @@ dns_cache_create(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 					    &cache->cleaner);
 	}
 	if (result != ISC_R_SUCCESS) {
-		goto cleanup_db;
+		goto cleanup_timer;
 	}
 
 	result = dns_db_setcachestats(cache->db, cache->stats);
 	if (result != ISC_R_SUCCESS) {
-		goto cleanup_db;
+		goto cleanup_timer;
+	}
+
+	if (cache->task != NULL) {
+		/*
+		 * The cache is freed by its task after the last timer
+		 * event in progress, if any.
+		 */
+		result = isc_task_onshutdown(cache->task,
+					     cache_shutdown_action, cache);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup_timer;
+		}
+		isc_refcount_increment(&cache->live_tasks);
 	}
 
 	*cachep = cache;
 	return (ISC_R_SUCCESS);
 
+cleanup_timer:
+	if (cache->sweeptimer != NULL) {
+		isc_timer_destroy(&cache->sweeptimer);
+	}
+	if (cache->dumptimer != NULL) {
+		isc_timer_destroy(&cache->dumptimer);
+	}
+cleanup_task:
+	if (cache->task != NULL) {
+		isc_task_detach(&cache->task);
+	}
 cleanup_db:
 	dns_db_detach(&cache->db);
+cleanup_dbtask:
+	if (cache->dbtask != NULL) {
+		isc_task_detach(&cache->dbtask);
+	}
 cleanup_dbargv:
 	for (i = extra; i < cache->db_argc; i++) {
 		if (cache->db_argv[i] != NULL) {
@@ -325,6 +462,27 @@ cache_free(dns_cache_t *cache) {
 
 	isc_mem_clearwater(cache->mctx);
 
+	INSIST(cache->dumptimer == NULL && cache->sweeptimer == NULL);
+	INSIST(cache->dumpctx == NULL && cache->loadctx == NULL);
+	for (unsigned int i = 0; i < cache->nsweepers; i++) {
+		INSIST(cache->sweepers[i].event != NULL);
+		isc_event_free(&cache->sweepers[i].event);
+		isc_task_detach(&cache->sweepers[i].task);
+	}
+	if (cache->sweepers != NULL) {
+		isc_mem_put(cache->mctx, cache->sweepers,
+			    cache->nsweepers * sizeof(cache->sweepers[0]));
+	}
+	if (cache->task != NULL) {
+		isc_task_detach(&cache->task);
+	}
+	if (cache->dbtask != NULL) {
+		isc_task_detach(&cache->dbtask);
+	}
+	if (cache->dumpfile != NULL) {
+		isc_mem_free(cache->mctx, cache->dumpfile);
+	}
+
 	if (cache->cleaner.task != NULL) {
 		isc_task_detach(&cache->cleaner.task);
 	}
@@ -407,10 +565,36 @@ dns_cache_detach(dns_cache_t **cachep) {
 		cache->cleaner.overmem = false;
 
 		/*
-		 * If the cleaner task exists, let it free the cache.
+		 * Stop dumping, loading and sweeping the cache; whatever
+		 * is still running frees the cache when it is done.
+		 */
+		LOCK(&cache->lock);
+		if (cache->dumptimer != NULL) {
+			isc_timer_destroy(&cache->dumptimer);
+		}
+		if (cache->sweeptimer != NULL) {
+			isc_timer_destroy(&cache->sweeptimer);
+		}
+		atomic_store_release(&cache->sweeping, false);
+		if (cache->dumpctx != NULL) {
+			dns_dumpctx_cancel(cache->dumpctx);
+		}
+		if (cache->loadctx != NULL) {
+			dns_loadctx_cancel(cache->loadctx);
+		}
+		UNLOCK(&cache->lock);
+
+		/*
+		 * If the cleaner task or the cache task exist, let them
+		 * free the cache.
 		 */
 		if (isc_refcount_decrement(&cache->live_tasks) > 1) {
-			isc_task_shutdown(cache->cleaner.task);
+			if (cache->cleaner.task != NULL) {
+				isc_task_shutdown(cache->cleaner.task);
+			}
+			if (cache->task != NULL) {
+				isc_task_shutdown(cache->task);
+			}
 		} else {
 			cache_free(cache);
 		}
@@ -937,6 +1121,34 @@ dns_cache_getservestalerefresh(dns_cache_t *cache) {
 	return (result == ISC_R_SUCCESS ? interval : 0);
 }
 
+void
+dns_cache_setcachepolicy(dns_cache_t *cache, dns_cachepolicy_t policy) {
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	cache->policy = policy;
+	UNLOCK(&cache->lock);
+
+	(void)dns_db_setcachepolicy(cache->db, policy);
+}
+
+void
+dns_cache_settopdomains(dns_cache_t *cache, unsigned int count) {
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	cache->topdomains = count;
+	dns_db_setdomainusage(cache->db, count > 0);
+	UNLOCK(&cache->lock);
+}
+
+unsigned int
+dns_cache_getshards(dns_cache_t *cache) {
+	REQUIRE(VALID_CACHE(cache));
+
+	return (cache->nshards);
+}
+
 /*
  * The cleaner task is shutting down; do the necessary cleanup.
  */
@@ -958,9 +1170,407 @@ cleaner_shutdown_action(isc_task_t *task, isc_event_t *event) {
 	/* Make sure we don't reschedule anymore. */
 	(void)isc_task_purge(task, NULL, DNS_EVENT_CACHECLEAN, NULL);
 
-	isc_refcount_decrementz(&cache->live_tasks);
+	if (isc_refcount_decrement(&cache->live_tasks) == 1) {
+		cache_free(cache);
+	}
+}
+
+/*
+ * The cache task is shutting down; the cache is freed here if nothing
+ * else still uses it.
+ */
+static void
+cache_shutdown_action(isc_task_t *task, isc_event_t *event) {
+	dns_cache_t *cache = event->ev_arg;
+
+	UNUSED(task);
+
+	INSIST(event->ev_type == ISC_TASKEVENT_SHUTDOWN);
+	isc_event_free(&event);
+
+	if (isc_refcount_decrement(&cache->live_tasks) == 1) {
+		cache_free(cache);
+	}
+}
+
+/*
+ * Delete expired records from the share of the buckets of 'sweeper',
+ * starting from where it stopped the last time.
+ */
+static void
+sweep_action(isc_task_t *task, isc_event_t *event) {
+	cache_sweeper_t *sweeper = event->ev_arg;
+	dns_cache_t *cache = sweeper->cache;
+	dns_db_t *db = NULL;
+	isc_stdtime_t now;
+	isc_time_t start, t0, t1;
+	unsigned int nbuckets, bucket;
+	uint64_t total = 0;
+	bool done = true;
+
+	INSIST(event->ev_type == DNS_EVENT_CACHESWEEP);
+
+	isc_stdtime_get(&now);
+	isc_time_now(&start);
+
+	LOCK(&cache->lock);
+	dns_db_attach(cache->db, &db);
+	UNLOCK(&cache->lock);
+
+	nbuckets = dns_db_nodelockwaits(db, NULL, 0);
+	for (bucket = sweeper->next; bucket < nbuckets;
+	     bucket += cache->nsweepers)
+	{
+		isc_result_t result = DNS_R_CONTINUE;
+		unsigned int count = 0;
+		uint64_t usecs;
+
+		if (!atomic_load_acquire(&cache->sweeping)) {
+			break;
+		}
+
+		isc_time_now(&t0);
+		while (result == DNS_R_CONTINUE &&
+		       atomic_load_relaxed(&cache->sweeping))
+		{
+			result = dns_db_cleanbucket(db, bucket, now,
+						    sweeper->increment,
+						    &count);
+			isc_time_now(&t1);
+			total += count;
+
+			/*
+			 * Take more records at once while that is cheap,
+			 * and fewer when it holds the bucket for too long.
+			 */
+			usecs = isc_time_microdiff(&t1, &t0);
+			if (result == DNS_R_CONTINUE &&
+			    usecs < DNS_CACHE_SWEEPBUDGET / 16)
+			{
+				sweeper->increment = ISC_MIN(
+					sweeper->increment * 2,
+					DNS_CACHE_SWEEPMAX);
+			} else if (usecs > DNS_CACHE_SWEEPBUDGET / 4) {
+				sweeper->increment = ISC_MAX(
+					sweeper->increment / 2,
+					DNS_CACHE_SWEEPMIN);
+			}
+			t0 = t1;
+
+			if (isc_time_microdiff(&t1, &start) >
+			    DNS_CACHE_SWEEPBUDGET)
+			{
+				break;
+			}
+		}
+
+		if (isc_time_microdiff(&t0, &start) > DNS_CACHE_SWEEPBUDGET) {
+			/*
+			 * Let the other events of the task run, and carry
+			 * on from here afterwards.
+			 */
+			sweeper->next = (result == DNS_R_CONTINUE)
+						? bucket
+						: bucket + cache->nsweepers;
+			done = (sweeper->next >= nbuckets);
+			break;
+		}
+	}
+	dns_db_detach(&db);
+
+	isc_stats_add(cache->stats, dns_cachestatscounter_sweepdeleted, total);
+
+	if (!done && atomic_load_acquire(&cache->sweeping)) {
+		isc_task_send(task, &event);
+		return;
+	}
+
+	sweeper->next = sweeper->id;
+	LOCK(&cache->lock);
+	sweeper->event = event;
+	UNLOCK(&cache->lock);
 
-	cache_free(cache);
+	if (isc_refcount_decrement(&cache->live_tasks) == 1) {
+		cache_free(cache);
+	}
+}
+
+/*
+ * Once a second, compute the sweep rate and start the sweepers that
+ * finished their last round.
+ */
+static void
+sweep_tick(isc_task_t *task, isc_event_t *event) {
+	dns_cache_t *cache = event->ev_arg;
+	uint64_t swept;
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+
+	swept = isc_stats_get_counter(cache->stats,
+				      dns_cachestatscounter_sweepdeleted);
+	isc_stats_set(cache->stats, swept - cache->sweptlast,
+		      dns_cachestatscounter_sweeprate);
+	cache->sweptlast = swept;
+
+	LOCK(&cache->lock);
+	if (cache->sweeptimer == NULL) {
+		UNLOCK(&cache->lock);
+		return;
+	}
+	for (unsigned int i = 0; i < cache->nsweepers; i++) {
+		cache_sweeper_t *sweeper = &cache->sweepers[i];
+
+		if (sweeper->event != NULL) {
+			isc_refcount_increment(&cache->live_tasks);
+			isc_task_send(sweeper->task, &sweeper->event);
+		}
+	}
+	UNLOCK(&cache->lock);
+}
+
+isc_result_t
+dns_cache_setsweepers(dns_cache_t *cache, unsigned int nsweepers) {
+	isc_interval_t i;
+	isc_result_t result;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	if (cache->sweeptimer == NULL) {
+		return ((nsweepers == 0) ? ISC_R_SUCCESS
+					 : ISC_R_NOTIMPLEMENTED);
+	}
+
+	LOCK(&cache->lock);
+	if (nsweepers == 0) {
+		result = isc_timer_reset(cache->sweeptimer,
+					 isc_timertype_inactive, NULL, NULL,
+					 true);
+		UNLOCK(&cache->lock);
+		return (result);
+	}
+
+	/*
+	 * The sweepers are only created once; their number does not
+	 * change afterwards.
+	 */
+	if (cache->sweepers == NULL) {
+		cache->sweepers = isc_mem_get(
+			cache->mctx, nsweepers * sizeof(cache->sweepers[0]));
+		for (unsigned int n = 0; n < nsweepers; n++) {
+			cache_sweeper_t *sweeper = &cache->sweepers[n];
+
+			*sweeper = (cache_sweeper_t){
+				.cache = cache,
+				.id = n,
+				.next = n,
+				.increment = DNS_CACHE_SWEEPINCREMENT,
+			};
+			result = isc_task_create_bound(cache->taskmgr, 1,
+						       &sweeper->task, n);
+			if (result != ISC_R_SUCCESS) {
+				while (n-- > 0) {
+					sweeper = &cache->sweepers[n];
+					isc_event_free(&sweeper->event);
+					isc_task_detach(&sweeper->task);
+				}
+				isc_mem_put(cache->mctx, cache->sweepers,
+					    nsweepers *
+						    sizeof(cache->sweepers[0]));
+				cache->sweepers = NULL;
+				UNLOCK(&cache->lock);
+				return (result);
+			}
+			isc_task_setname(sweeper->task, "cache_sweep", cache);
+			sweeper->event = isc_event_allocate(
+				cache->mctx, sweeper, DNS_EVENT_CACHESWEEP,
+				sweep_action, sweeper, sizeof(isc_event_t));
+		}
+		cache->nsweepers = nsweepers;
+	}
+
+	isc_interval_set(&i, 1, 0);
+	result = isc_timer_reset(cache->sweeptimer, isc_timertype_ticker, NULL,
+				 &i, true);
+	UNLOCK(&cache->lock);
+
+	return (result);
+}
+
+static void
+dump_done(void *arg, isc_result_t result) {
+	dns_cache_t *cache = arg;
+
+	isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE, DNS_LOGMODULE_CACHE,
+		      (result == ISC_R_SUCCESS || result == ISC_R_CANCELED)
+			      ? ISC_LOG_DEBUG(1)
+			      : ISC_LOG_ERROR,
+		      "dumping cache '%s': %s", cache->name,
+		      isc_result_totext(result));
+
+	LOCK(&cache->lock);
+	dns_dumpctx_detach(&cache->dumpctx);
+	UNLOCK(&cache->lock);
+
+	if (isc_refcount_decrement(&cache->live_tasks) == 1) {
+		cache_free(cache);
+	}
+}
+
+static void
+dump_action(isc_task_t *task, isc_event_t *event) {
+	dns_cache_t *cache = event->ev_arg;
+	dns_masterrawheader_t header;
+	isc_result_t result;
+
+	isc_event_free(&event);
+
+	LOCK(&cache->lock);
+	if (cache->dumptimer == NULL || cache->dumpfile == NULL ||
+	    cache->dumpctx != NULL || cache->loadctx != NULL)
+	{
+		/* Don't overwrite the file before it is loaded. */
+		UNLOCK(&cache->lock);
+		return;
+	}
+
+	dns_master_initrawheader(&header);
+	header.flags = DNS_MASTERRAW_CACHE;
+	result = dns_master_dumpasync(cache->mctx, cache->db, NULL,
+				      &dns_master_style_cache, cache->dumpfile,
+				      task, dump_done, cache, &cache->dumpctx,
+				      dns_masterformat_raw, &header);
+	if (result == DNS_R_CONTINUE) {
+		isc_refcount_increment(&cache->live_tasks);
+	} else {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+			      DNS_LOGMODULE_CACHE, ISC_LOG_ERROR,
+			      "dumping cache '%s' to '%s' failed: %s",
+			      cache->name, cache->dumpfile,
+			      isc_result_totext(result));
+	}
+	UNLOCK(&cache->lock);
+}
+
+isc_result_t
+dns_cache_setdumpfile(dns_cache_t *cache, const char *filename,
+		      uint32_t interval) {
+	isc_interval_t i;
+	isc_result_t result;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	if (cache->dumptimer == NULL) {
+		return ((filename == NULL) ? ISC_R_SUCCESS
+					   : ISC_R_NOTIMPLEMENTED);
+	}
+
+	LOCK(&cache->lock);
+	if (cache->dumpfile != NULL) {
+		isc_mem_free(cache->mctx, cache->dumpfile);
+	}
+	if (filename != NULL) {
+		cache->dumpfile = isc_mem_strdup(cache->mctx, filename);
+	}
+
+	if (filename == NULL || interval == 0) {
+		result = isc_timer_reset(cache->dumptimer,
+					 isc_timertype_inactive, NULL, NULL,
+					 true);
+	} else {
+		isc_interval_set(&i, interval, 0);
+		result = isc_timer_reset(cache->dumptimer,
+					 isc_timertype_ticker, NULL, &i, true);
+	}
+	UNLOCK(&cache->lock);
+
+	return (result);
+}
+
+static isc_result_t
+load_add(void *arg, const dns_name_t *owner, dns_rdataset_t *rdataset) {
+	dns_db_t *db = arg;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	result = dns_db_findnode(db, owner, true, &node);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	/*
+	 * Anything the cache learned since the server started is at
+	 * least as fresh, so it is only replaced if it is trusted less.
+	 */
+	result = dns_db_addrdataset(db, node, NULL, 0, rdataset, 0, NULL);
+	if (result == DNS_R_UNCHANGED) {
+		result = ISC_R_SUCCESS;
+	}
+	dns_db_detachnode(db, &node);
+
+	return (result);
+}
+
+static void
+load_done(void *arg, isc_result_t result) {
+	dns_cache_t *cache = arg;
+
+	isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE, DNS_LOGMODULE_CACHE,
+		      (result == ISC_R_SUCCESS || result == ISC_R_CANCELED)
+			      ? ISC_LOG_INFO
+			      : ISC_LOG_ERROR,
+		      "loading cache '%s': %s", cache->name,
+		      isc_result_totext(result));
+
+	LOCK(&cache->lock);
+	dns_loadctx_detach(&cache->loadctx);
+	dns_db_detach(&cache->loaddb);
+	UNLOCK(&cache->lock);
+
+	if (isc_refcount_decrement(&cache->live_tasks) == 1) {
+		cache_free(cache);
+	}
+}
+
+isc_result_t
+dns_cache_load(dns_cache_t *cache, const char *filename) {
+	dns_name_t *root = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(filename != NULL);
+
+	if (cache->task == NULL) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	LOCK(&cache->lock);
+	if (cache->loadctx != NULL) {
+		UNLOCK(&cache->lock);
+		return (ISC_R_INPROGRESS);
+	}
+
+	dns_db_attach(cache->db, &cache->loaddb);
+	dns_rdatacallbacks_init(&cache->loadcallbacks);
+	cache->loadcallbacks.add = load_add;
+	cache->loadcallbacks.add_private = cache->loaddb;
+
+	DE_CONST(dns_rootname, root);
+	result = dns_master_loadfileinc(
+		filename, root, root, cache->rdclass, DNS_MASTER_CACHE, 0,
+		&cache->loadcallbacks, cache->task, load_done, cache,
+		&cache->loadctx, NULL, NULL, cache->mctx, dns_masterformat_raw,
+		0);
+	if (result == DNS_R_CONTINUE) {
+		isc_refcount_increment(&cache->live_tasks);
+		result = ISC_R_SUCCESS;
+	} else {
+		dns_db_detach(&cache->loaddb);
+	}
+	UNLOCK(&cache->lock);
+
+	return (result);
 }
 
 isc_result_t
@@ -1087,6 +1697,15 @@ cleartree(dns_db_t *db, const dns_name_t *name) {
 			goto cleanup;
 		}
 
+		/*
+		 * Release the tree lock while the node is cleared, so that
+		 * flushing a large subtree doesn't hold up the resolver.
+		 */
+		result = dns_dbiterator_pause(iter);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+
 		/*
 		 * If clearnode fails record and move onto the next node.
 		 */
@@ -1142,10 +1761,14 @@ dns_cache_flushnode(dns_cache_t *cache, const dns_name_t *name, bool tree) {
 		return (ISC_R_SUCCESS);
 	}
 
+	/*
+	 * Use our own reference: dns_cache_flush() may replace
+	 * cache->db while we are working.
+	 */
 	if (tree) {
-		result = cleartree(cache->db, name);
+		result = cleartree(db, name);
 	} else {
-		result = dns_db_findnode(cache->db, name, false, &node);
+		result = dns_db_findnode(db, name, false, &node);
 		if (result == ISC_R_NOTFOUND) {
 			result = ISC_R_SUCCESS;
 			goto cleanup_db;
@@ -1153,8 +1776,8 @@ dns_cache_flushnode(dns_cache_t *cache, const dns_name_t *name, bool tree) {
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup_db;
 		}
-		result = clearnode(cache->db, node);
-		dns_db_detachnode(cache->db, &node);
+		result = clearnode(db, node);
+		dns_db_detachnode(db, &node);
 	}
 
 cleanup_db:
@@ -1230,10 +1853,107 @@ getcounters(isc_stats_t *stats, isc_statsformat_t type, int ncounters,
 	isc_stats_dump(stats, getcounter, &dumparg, ISC_STATSDUMP_VERBOSE);
 }
 
+/*
+ * Return the number of node locks in the cache database, the number of
+ * times lookups had to wait for any of them, and the largest number of
+ * waits for a single one.
+ */
+static unsigned int
+getnodelockwaits(dns_cache_t *cache, uint64_t *total, uint64_t *busiest) {
+	dns_db_t *db = NULL;
+	uint64_t *waits = NULL;
+	unsigned int count;
+
+	*total = 0;
+	*busiest = 0;
+
+	LOCK(&cache->lock);
+	dns_db_attach(cache->db, &db);
+	UNLOCK(&cache->lock);
+
+	count = dns_db_nodelockwaits(db, NULL, 0);
+	if (count != 0) {
+		waits = isc_mem_get(cache->mctx, count * sizeof(waits[0]));
+		(void)dns_db_nodelockwaits(db, waits, count);
+		for (unsigned int i = 0; i < count; i++) {
+			*total += waits[i];
+			*busiest = ISC_MAX(*busiest, waits[i]);
+		}
+		isc_mem_put(cache->mctx, waits, count * sizeof(waits[0]));
+	}
+
+	dns_db_detach(&db);
+	return (count);
+}
+
+/*%
+ * The domains using the most memory in a cache, with pointers to them
+ * sorted largest first (the entries themselves cannot be moved, as
+ * their names point into them).
+ */
+typedef struct cache_topdomains {
+	dns_dbdomainusage_t *domains;
+	dns_dbdomainusage_t **sorted;
+	unsigned int size;
+	unsigned int count;
+} cache_topdomains_t;
+
+static int
+compare_domainusage(const void *a, const void *b) {
+	dns_dbdomainusage_t *da = *(dns_dbdomainusage_t *const *)a;
+	dns_dbdomainusage_t *db = *(dns_dbdomainusage_t *const *)b;
+
+	if (da->bytes != db->bytes) {
+		return ((da->bytes > db->bytes) ? -1 : 1);
+	}
+	return (dns_name_compare(dns_fixedname_name(&da->fixed),
+				 dns_fixedname_name(&db->fixed)));
+}
+
+static void
+gettopdomains(dns_cache_t *cache, cache_topdomains_t *td) {
+	dns_db_t *db = NULL;
+
+	*td = (cache_topdomains_t){ 0 };
+
+	LOCK(&cache->lock);
+	td->size = cache->topdomains;
+	dns_db_attach(cache->db, &db);
+	UNLOCK(&cache->lock);
+
+	if (td->size != 0) {
+		td->domains = isc_mem_get(cache->mctx,
+					  td->size * sizeof(td->domains[0]));
+		td->sorted = isc_mem_get(cache->mctx,
+					 td->size * sizeof(td->sorted[0]));
+		dns_db_topdomains(db, td->domains, td->size, &td->count);
+		for (unsigned int i = 0; i < td->count; i++) {
+			td->sorted[i] = &td->domains[i];
+		}
+		qsort(td->sorted, td->count, sizeof(td->sorted[0]),
+		      compare_domainusage);
+	}
+
+	dns_db_detach(&db);
+}
+
+static void
+puttopdomains(dns_cache_t *cache, cache_topdomains_t *td) {
+	if (td->size != 0) {
+		isc_mem_put(cache->mctx, td->domains,
+			    td->size * sizeof(td->domains[0]));
+		isc_mem_put(cache->mctx, td->sorted,
+			    td->size * sizeof(td->sorted[0]));
+	}
+}
+
 void
 dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 	int indices[dns_cachestatscounter_max];
 	uint64_t values[dns_cachestatscounter_max];
+	unsigned int nodelocks;
+	uint64_t waits, busiest;
+	cache_topdomains_t td;
 
 	REQUIRE(VALID_CACHE(cache));
 
@@ -1256,15 +1976,42 @@ dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 	fprintf(fp, "%20" PRIu64 " %s\n",
 		values[dns_cachestatscounter_deletettl],
 		"cache records deleted due to TTL expiration");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_promotions],
+		"cache records protected from memory exhaustion");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_deleteprotected],
+		"protected cache records deleted due to memory exhaustion");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_sweepdeleted],
+		"expired cache records deleted by sweepers");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_sweeprate],
+		"expired cache records deleted by sweepers in the last second");
 	fprintf(fp, "%20" PRIu64 " %s\n",
 		values[dns_cachestatscounter_coveringnsec],
 		"covering nsec returned");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_rehashes],
+		"cache database rehashes");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_rehashtime],
+		"cache database rehash time (usec)");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_rehashslicemax],
+		"cache database longest rehash slice (usec)");
 	fprintf(fp, "%20u %s\n", dns_db_nodecount(cache->db, dns_dbtree_main),
 		"cache database nodes");
 	fprintf(fp, "%20u %s\n", dns_db_nodecount(cache->db, dns_dbtree_nsec),
 		"cache NSEC auxiliary database nodes");
 	fprintf(fp, "%20" PRIu64 " %s\n", (uint64_t)dns_db_hashsize(cache->db),
 		"cache database hash buckets");
+	nodelocks = getnodelockwaits(cache, &waits, &busiest);
+	fprintf(fp, "%20u %s\n", nodelocks, "cache database node locks");
+	fprintf(fp, "%20" PRIu64 " %s\n", waits,
+		"cache database node lock waits");
+	fprintf(fp, "%20" PRIu64 " %s\n", busiest,
+		"cache database busiest node lock waits");
 
 	fprintf(fp, "%20" PRIu64 " %s\n", (uint64_t)isc_mem_total(cache->mctx),
 		"cache tree memory total");
@@ -1281,6 +2028,19 @@ dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 	fprintf(fp, "%20" PRIu64 " %s\n",
 		(uint64_t)isc_mem_maxinuse(cache->hmctx),
 		"cache heap highest memory in use");
+
+	gettopdomains(cache, &td);
+	for (unsigned int i = 0; i < td.count; i++) {
+		dns_dbdomainusage_t *d = td.sorted[i];
+		char buf[DNS_NAME_FORMATSIZE];
+
+		dns_name_format(dns_fixedname_name(&d->fixed), buf,
+				sizeof(buf));
+		fprintf(fp,
+			"%20" PRIu64 " cache bytes used by %s (%u rrsets)\n",
+			d->bytes, buf, d->rdatasets);
+	}
+	puttopdomains(cache, &td);
 }
 
 #ifdef HAVE_LIBXML2
@@ -1308,6 +2068,8 @@ int
 dns_cache_renderxml(dns_cache_t *cache, void *writer0) {
 	int indices[dns_cachestatscounter_max];
 	uint64_t values[dns_cachestatscounter_max];
+	unsigned int nodelocks;
+	uint64_t waits, busiest;
 	int xmlrc;
 	xmlTextWriterPtr writer = (xmlTextWriterPtr)writer0;
 
@@ -1327,14 +2089,32 @@ dns_cache_renderxml(dns_cache_t *cache, void *writer0) {
 			writer));
 	TRY0(renderstat("DeleteTTL", values[dns_cachestatscounter_deletettl],
 			writer));
+	TRY0(renderstat("Promotions", values[dns_cachestatscounter_promotions],
+			writer));
+	TRY0(renderstat("DeleteProtected",
+			values[dns_cachestatscounter_deleteprotected], writer));
+	TRY0(renderstat("SweepDeleted",
+			values[dns_cachestatscounter_sweepdeleted], writer));
+	TRY0(renderstat("SweepRate", values[dns_cachestatscounter_sweeprate],
+			writer));
 	TRY0(renderstat("CoveringNSEC",
 			values[dns_cachestatscounter_coveringnsec], writer));
+	TRY0(renderstat("Rehashes", values[dns_cachestatscounter_rehashes],
+			writer));
+	TRY0(renderstat("RehashTime", values[dns_cachestatscounter_rehashtime],
+			writer));
+	TRY0(renderstat("RehashSliceMax",
+			values[dns_cachestatscounter_rehashslicemax], writer));
 
 	TRY0(renderstat("CacheNodes",
 			dns_db_nodecount(cache->db, dns_dbtree_main), writer));
 	TRY0(renderstat("CacheNSECNodes",
 			dns_db_nodecount(cache->db, dns_dbtree_nsec), writer));
 	TRY0(renderstat("CacheBuckets", dns_db_hashsize(cache->db), writer));
+	nodelocks = getnodelockwaits(cache, &waits, &busiest);
+	TRY0(renderstat("CacheNodeLocks", nodelocks, writer));
+	TRY0(renderstat("CacheNodeLockWaits", waits, writer));
+	TRY0(renderstat("CacheNodeLockWaitsMax", busiest, writer));
 
 	TRY0(renderstat("TreeMemTotal", isc_mem_total(cache->mctx), writer));
 	TRY0(renderstat("TreeMemInUse", isc_mem_inuse(cache->mctx), writer));
@@ -1346,6 +2126,40 @@ dns_cache_renderxml(dns_cache_t *cache, void *writer0) {
 error:
 	return (xmlrc);
 }
+
+int
+dns_cache_renderdomainsxml(dns_cache_t *cache, void *writer0) {
+	cache_topdomains_t td;
+	int xmlrc = 0;
+	xmlTextWriterPtr writer = (xmlTextWriterPtr)writer0;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	gettopdomains(cache, &td);
+	if (td.size == 0) {
+		return (0);
+	}
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "cachedomains"));
+	for (unsigned int i = 0; i < td.count; i++) {
+		dns_dbdomainusage_t *d = td.sorted[i];
+		char buf[DNS_NAME_FORMATSIZE];
+
+		dns_name_format(dns_fixedname_name(&d->fixed), buf,
+				sizeof(buf));
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "domain"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "name",
+						 ISC_XMLCHAR buf));
+		TRY0(renderstat("Bytes", d->bytes, writer));
+		TRY0(renderstat("RRsets", d->rdatasets, writer));
+		TRY0(xmlTextWriterEndElement(writer)); /* domain */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* cachedomains */
+
+error:
+	puttopdomains(cache, &td);
+	return (xmlrc);
+}
 #endif /* ifdef HAVE_LIBXML2 */
 
 #ifdef HAVE_JSON_C
@@ -1362,6 +2176,8 @@ dns_cache_renderjson(dns_cache_t *cache, void *cstats0) {
 	isc_result_t result = ISC_R_SUCCESS;
 	int indices[dns_cachestatscounter_max];
 	uint64_t values[dns_cachestatscounter_max];
+	unsigned int nodelocks;
+	uint64_t waits, busiest;
 	json_object *obj;
 	json_object *cstats = (json_object *)cstats0;
 
@@ -1394,10 +2210,40 @@ dns_cache_renderjson(dns_cache_t *cache, void *cstats0) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "DeleteTTL", obj);
 
+	obj = json_object_new_int64(values[dns_cachestatscounter_promotions]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "Promotions", obj);
+
+	obj = json_object_new_int64(
+		values[dns_cachestatscounter_deleteprotected]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "DeleteProtected", obj);
+
+	obj = json_object_new_int64(values[dns_cachestatscounter_sweepdeleted]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "SweepDeleted", obj);
+
+	obj = json_object_new_int64(values[dns_cachestatscounter_sweeprate]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "SweepRate", obj);
+
 	obj = json_object_new_int64(values[dns_cachestatscounter_coveringnsec]);
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "CoveringNSEC", obj);
 
+	obj = json_object_new_int64(values[dns_cachestatscounter_rehashes]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "Rehashes", obj);
+
+	obj = json_object_new_int64(values[dns_cachestatscounter_rehashtime]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "RehashTime", obj);
+
+	obj = json_object_new_int64(
+		values[dns_cachestatscounter_rehashslicemax]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "RehashSliceMax", obj);
+
 	obj = json_object_new_int64(
 		dns_db_nodecount(cache->db, dns_dbtree_main));
 	CHECKMEM(obj);
@@ -1412,6 +2258,19 @@ dns_cache_renderjson(dns_cache_t *cache, void *cstats0) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "CacheBuckets", obj);
 
+	nodelocks = getnodelockwaits(cache, &waits, &busiest);
+	obj = json_object_new_int64(nodelocks);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "CacheNodeLocks", obj);
+
+	obj = json_object_new_int64(waits);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "CacheNodeLockWaits", obj);
+
+	obj = json_object_new_int64(busiest);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "CacheNodeLockWaitsMax", obj);
+
 	obj = json_object_new_int64(isc_mem_total(cache->mctx));
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "TreeMemTotal", obj);
@@ -1440,4 +2299,55 @@ dns_cache_renderjson(dns_cache_t *cache, void *cstats0) {
 error:
 	return (result);
 }
+
+isc_result_t
+dns_cache_renderdomainsjson(dns_cache_t *cache, void *view0) {
+	isc_result_t result = ISC_R_SUCCESS;
+	cache_topdomains_t td;
+	json_object *domains = NULL;
+	json_object *view = (json_object *)view0;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	gettopdomains(cache, &td);
+	if (td.size == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	domains = json_object_new_array();
+	CHECKMEM(domains);
+	for (unsigned int i = 0; i < td.count; i++) {
+		dns_dbdomainusage_t *d = td.sorted[i];
+		char buf[DNS_NAME_FORMATSIZE];
+		json_object *domain = NULL, *obj = NULL;
+
+		domain = json_object_new_object();
+		CHECKMEM(domain);
+		json_object_array_add(domains, domain);
+
+		dns_name_format(dns_fixedname_name(&d->fixed), buf,
+				sizeof(buf));
+		obj = json_object_new_string(buf);
+		CHECKMEM(obj);
+		json_object_object_add(domain, "name", obj);
+
+		obj = json_object_new_int64(d->bytes);
+		CHECKMEM(obj);
+		json_object_object_add(domain, "Bytes", obj);
+
+		obj = json_object_new_int64(d->rdatasets);
+		CHECKMEM(obj);
+		json_object_object_add(domain, "RRsets", obj);
+	}
+
+	json_object_object_add(view, "cachedomains", domains);
+	domains = NULL;
+
+error:
+	if (domains != NULL) {
+		json_object_put(domains);
+	}
+	puttopdomains(cache, &td);
+	return (result);
+}
 #endif /* ifdef HAVE_JSON_C */
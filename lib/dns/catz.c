@@ -24,12 +24,14 @@
 #include <isc/parseint.h>
 #include <isc/print.h>
 #include <isc/result.h>
+#include <isc/serial.h>
 #include <isc/task.h>
 #include <isc/util.h>
 
 #include <dns/catz.h>
 #include <dns/dbiterator.h>
 #include <dns/events.h>
+#include <dns/journal.h>
 #include <dns/rdatasetiter.h>
 #include <dns/view.h>
 #include <dns/zone.h>
@@ -63,6 +65,8 @@ struct dns_catz_entry {
 	dns_name_t name;
 	dns_catz_options_t opts;
 	isc_refcount_t references;
+	bool have_serial; /*%< 'serial' was set in the catalog */
+	uint32_t serial;
 };
 
 /*%
@@ -94,6 +98,9 @@ struct dns_catz_zone {
 	dns_dbversion_t *dbversion;   /* version we will be updating to */
 	dns_db_t *updb;		      /* zones database we're working on */
 	dns_dbversion_t *updbversion; /* version we're working on */
+	char *journal;		      /* zone's journal, if any */
+	dns_db_t *lastdb;	      /* database of the last update */
+	uint32_t lastserial;	      /* serial of the last update */
 
 	isc_timer_t *updatetimer;
 	isc_event_t updateevent;
@@ -293,6 +300,8 @@ dns_catz_entry_new(isc_mem_t *mctx, const dns_name_t *domain,
 
 	dns_catz_options_init(&nentry->opts);
 	isc_refcount_init(&nentry->references, 1);
+	nentry->have_serial = false;
+	nentry->serial = 0;
 	nentry->magic = DNS_CATZ_ENTRY_MAGIC;
 	*nentryp = nentry;
 }
@@ -315,6 +324,8 @@ dns_catz_entry_copy(dns_catz_zone_t *catz, const dns_catz_entry_t *entry,
 	dns_catz_entry_new(catz->catzs->mctx, &entry->name, &nentry);
 
 	dns_catz_options_copy(catz->catzs->mctx, &entry->opts, &nentry->opts);
+	nentry->have_serial = entry->have_serial;
+	nentry->serial = entry->serial;
 	*nentryp = nentry;
 }
 
@@ -461,19 +472,48 @@ dns_catz_zone_resetdefoptions(dns_catz_zone_t *catz) {
 
 	dns_catz_options_free(&catz->defoptions, catz->catzs->mctx);
 	dns_catz_options_init(&catz->defoptions);
+
+	/*
+	 * The member zones have to be processed again with the new
+	 * defaults, not just those that change.
+	 */
+	LOCK(&catz->lock);
+	if (catz->lastdb != NULL) {
+		dns_db_detach(&catz->lastdb);
+	}
+	UNLOCK(&catz->lock);
+}
+
+void
+dns_catz_zone_setjournal(dns_catz_zone_t *catz, const char *journal) {
+	REQUIRE(DNS_CATZ_ZONE_VALID(catz));
+
+	LOCK(&catz->lock);
+	if (catz->journal != NULL) {
+		isc_mem_free(catz->catzs->mctx, catz->journal);
+	}
+	if (journal != NULL) {
+		catz->journal = isc_mem_strdup(catz->catzs->mctx, journal);
+	}
+	UNLOCK(&catz->lock);
 }
 
 /*%<
  * Merge 'newcatz' into 'catz', calling addzone/delzone/modzone
  * (from catz->catzs->zmm) for appropriate member zones.
  *
+ * If 'changed' is not NULL, 'newcatz' only holds the member zones with
+ * the unique labels in 'changed', and the other member zones of 'catz'
+ * are left as they are.
+ *
  * Requires:
  * \li	'catz' is a valid dns_catz_zone_t.
  * \li	'newcatz' is a valid dns_catz_zone_t.
  *
  */
 static isc_result_t
-dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
+dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz,
+		      isc_ht_t *changed) {
 	isc_result_t result;
 	isc_ht_iter_t *iter1 = NULL, *iter2 = NULL;
 	isc_ht_iter_t *iteradd = NULL, *itermod = NULL;
@@ -606,6 +646,16 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 				LOCK(&catz->lock);
 			}
 		}
+		if (zt_find_result == ISC_R_SUCCESS && parentcatz == catz &&
+		    nentry->have_serial)
+		{
+			/*
+			 * The catalog tells us the serial the primary
+			 * serves, so the member zone can skip its own SOA
+			 * query if it is up to date.
+			 */
+			dns_zone_setprimaryserial(zone, nentry->serial);
+		}
 		if (zt_find_result == ISC_R_SUCCESS ||
 		    zt_find_result == DNS_R_PARTIALMATCH)
 		{
@@ -675,7 +725,46 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 
 	/*
 	 * Then - walk the old zone; only deleted entries should remain.
+	 * When only the changed entries were read, the deleted ones are
+	 * those of the changed entries that remain.
 	 */
+	if (changed != NULL) {
+		isc_ht_iter_t *iter = NULL;
+
+		isc_ht_iter_create(changed, &iter);
+		for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+		     result = isc_ht_iter_next(iter))
+		{
+			dns_catz_entry_t *entry = NULL;
+			unsigned char *key = NULL;
+			size_t keysize;
+
+			isc_ht_iter_currentkey(iter, &key, &keysize);
+			if (isc_ht_find(catz->entries, key, (uint32_t)keysize,
+					(void **)&entry) != ISC_R_SUCCESS)
+			{
+				continue;
+			}
+
+			dns_name_format(&entry->name, zname,
+					DNS_NAME_FORMATSIZE);
+			result = delzone(entry, catz, catz->catzs->view,
+					 catz->catzs->taskmgr,
+					 catz->catzs->zmm->udata);
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_MASTER, ISC_LOG_INFO,
+				      "catz: deleting zone '%s' from catalog "
+				      "'%s' - %s",
+				      zname, czname, isc_result_totext(result));
+			dns_catz_entry_detach(catz, &entry);
+			result = isc_ht_delete(catz->entries, key,
+					       (uint32_t)keysize);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		}
+		isc_ht_iter_destroy(&iter);
+		isc_ht_iter_destroy(&iter2);
+		goto addmod;
+	}
 	for (result = isc_ht_iter_first(iter2); result == ISC_R_SUCCESS;
 	     result = isc_ht_iter_delcurrent_next(iter2))
 	{
@@ -697,6 +786,7 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 	INSIST(isc_ht_count(catz->entries) == 0);
 	isc_ht_destroy(&catz->entries);
 
+addmod:
 	for (result = isc_ht_iter_first(iteradd); result == ISC_R_SUCCESS;
 	     result = isc_ht_iter_delcurrent_next(iteradd))
 	{
@@ -729,8 +819,33 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 			      zname, czname, isc_result_totext(result));
 	}
 
-	catz->entries = newcatz->entries;
-	newcatz->entries = NULL;
+	if (changed != NULL) {
+		isc_ht_iter_t *iter = NULL;
+
+		/*
+		 * The old entries of the changed member zones are gone;
+		 * add the new ones to the others.
+		 */
+		isc_ht_iter_create(newcatz->entries, &iter);
+		for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+		     result = isc_ht_iter_delcurrent_next(iter))
+		{
+			dns_catz_entry_t *entry = NULL;
+			unsigned char *key = NULL;
+			size_t keysize;
+
+			isc_ht_iter_current(iter, (void **)&entry);
+			isc_ht_iter_currentkey(iter, &key, &keysize);
+			result = isc_ht_add(catz->entries, key,
+					    (uint32_t)keysize, entry);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		}
+		INSIST(result == ISC_R_NOMORE);
+		isc_ht_iter_destroy(&iter);
+	} else {
+		catz->entries = newcatz->entries;
+		newcatz->entries = NULL;
+	}
 
 	/*
 	 * We do not need to merge old coo (change of ownership) permission
@@ -986,6 +1101,12 @@ dns__catz_zone_destroy(dns_catz_zone_t *catz) {
 		INSIST(isc_ht_count(catz->coos) == 0);
 		isc_ht_destroy(&catz->coos);
 	}
+	if (catz->journal != NULL) {
+		isc_mem_free(mctx, catz->journal);
+	}
+	if (catz->lastdb != NULL) {
+		dns_db_detach(&catz->lastdb);
+	}
 	catz->magic = 0;
 
 	isc_mutex_destroy(&catz->lock);
@@ -1074,6 +1195,7 @@ typedef enum {
 	CATZ_OPT_PRIMARIES,
 	CATZ_OPT_ALLOW_QUERY,
 	CATZ_OPT_ALLOW_TRANSFER,
+	CATZ_OPT_SERIAL,
 } catz_opt_t;
 
 static bool
@@ -1103,6 +1225,8 @@ catz_get_option(const dns_label_t *option) {
 		return (CATZ_OPT_ALLOW_QUERY);
 	} else if (catz_opt_cmp(option, "allow-transfer")) {
 		return (CATZ_OPT_ALLOW_TRANSFER);
+	} else if (catz_opt_cmp(option, "serial")) {
+		return (CATZ_OPT_SERIAL);
 	} else if (catz_opt_cmp(option, "coo")) {
 		return (CATZ_OPT_COO);
 	} else if (catz_opt_cmp(option, "version")) {
@@ -1281,31 +1405,17 @@ catz_process_zones_entry(dns_catz_zone_t *catz, dns_rdataset_t *value,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Parse a TXT RRset holding a single unsigned 32-bit number.
+ */
 static isc_result_t
-catz_process_version(dns_catz_zone_t *catz, dns_rdataset_t *value) {
+catz_txt_touint32(dns_rdataset_t *value, uint32_t *numberp) {
 	isc_result_t result;
 	dns_rdata_t rdata;
 	dns_rdata_txt_t rdatatxt;
 	dns_rdata_txt_string_t rdatastr;
-	uint32_t tversion;
 	char t[16];
 
-	REQUIRE(DNS_CATZ_ZONE_VALID(catz));
-	REQUIRE(DNS_RDATASET_VALID(value));
-
-	if (value->type != dns_rdatatype_txt) {
-		return (ISC_R_FAILURE);
-	}
-
-	if (dns_rdataset_count(value) != 1) {
-		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
-			      DNS_LOGMODULE_MASTER, ISC_LOG_WARNING,
-			      "catz: 'version' property TXT RRset contains "
-			      "more than one record, which is invalid");
-		catz->broken = true;
-		return (ISC_R_FAILURE);
-	}
-
 	result = dns_rdataset_first(value);
 	if (result != ISC_R_SUCCESS) {
 		return (result);
@@ -1340,23 +1450,76 @@ catz_process_version(dns_catz_zone_t *catz, dns_rdataset_t *value) {
 	}
 	memmove(t, rdatastr.data, rdatastr.length);
 	t[rdatastr.length] = 0;
-	result = isc_parse_uint32(&tversion, t, 10);
-	if (result != ISC_R_SUCCESS) {
-		goto cleanup;
-	}
-	catz->version = tversion;
-	result = ISC_R_SUCCESS;
+	result = isc_parse_uint32(numberp, t, 10);
 
 cleanup:
 	dns_rdata_freestruct(&rdatatxt);
+	return (result);
+}
+
+static isc_result_t
+catz_process_version(dns_catz_zone_t *catz, dns_rdataset_t *value) {
+	isc_result_t result;
+	uint32_t tversion;
+
+	REQUIRE(DNS_CATZ_ZONE_VALID(catz));
+	REQUIRE(DNS_RDATASET_VALID(value));
+
+	if (value->type != dns_rdatatype_txt) {
+		return (ISC_R_FAILURE);
+	}
+
+	if (dns_rdataset_count(value) != 1) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_WARNING,
+			      "catz: 'version' property TXT RRset contains "
+			      "more than one record, which is invalid");
+		catz->broken = true;
+		return (ISC_R_FAILURE);
+	}
+
+	result = catz_txt_touint32(value, &tversion);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
 			      DNS_LOGMODULE_MASTER, ISC_LOG_WARNING,
 			      "catz: invalid record for the catalog "
 			      "zone version property");
 		catz->broken = true;
+		return (result);
 	}
-	return (result);
+	catz->version = tversion;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+catz_process_serial(dns_catz_zone_t *catz, dns_catz_entry_t *entry,
+		    dns_rdataset_t *value) {
+	isc_result_t result;
+	uint32_t serial;
+
+	REQUIRE(DNS_CATZ_ZONE_VALID(catz));
+	REQUIRE(DNS_CATZ_ENTRY_VALID(entry));
+	REQUIRE(DNS_RDATASET_VALID(value));
+
+	if (value->type != dns_rdatatype_txt ||
+	    dns_rdataset_count(value) != 1)
+	{
+		return (ISC_R_FAILURE);
+	}
+
+	result = catz_txt_touint32(value, &serial);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_WARNING,
+			      "catz: invalid record for the member zone "
+			      "serial property");
+		return (result);
+	}
+	entry->have_serial = true;
+	entry->serial = serial;
+
+	return (ISC_R_SUCCESS);
 }
 
 static isc_result_t
@@ -1692,6 +1855,11 @@ catz_process_zones_suboption(dns_catz_zone_t *catz, dns_rdataset_t *value,
 		}
 		return (catz_process_apl(catz, &entry->opts.allow_transfer,
 					 value));
+	case CATZ_OPT_SERIAL:
+		if (prefix.labels != 0) {
+			return (ISC_R_FAILURE);
+		}
+		return (catz_process_serial(catz, entry, value));
 	default:
 		return (ISC_R_FAILURE);
 	}
@@ -2225,10 +2393,332 @@ catz_rdatatype_is_processable(const dns_rdatatype_t type) {
 		type != dns_rdatatype_cdnskey && type != dns_rdatatype_zonemd);
 }
 
+/*
+ * Process the records of 'node', named 'name', into 'newcatz'.
+ */
+static isc_result_t
+catz_process_node(dns_catz_zone_t *newcatz, dns_db_t *db,
+		  dns_dbversion_t *version, dns_dbnode_t *node,
+		  dns_name_t *name) {
+	isc_result_t result;
+	dns_rdatasetiter_t *rdsiter = NULL;
+	dns_rdataset_t rdataset;
+	char cname[DNS_NAME_FORMATSIZE];
+
+	result = dns_db_allrdatasets(db, node, version, 0, 0, &rdsiter);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
+			      "catz: failed to fetch rrdatasets - %s",
+			      isc_result_totext(result));
+		return (result);
+	}
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatasetiter_first(rdsiter);
+	while (result == ISC_R_SUCCESS) {
+		dns_rdatasetiter_current(rdsiter, &rdataset);
+
+		/*
+		 * Skip processing DNSSEC-related and ZONEMD types,
+		 * because we are not interested in them in the context
+		 * of a catalog zone, and processing them will fail
+		 * and produce an unnecessary warning message.
+		 */
+		if (!catz_rdatatype_is_processable(rdataset.type)) {
+			goto next;
+		}
+
+		/*
+		 * Although newcatz->coos is accessed in
+		 * catz_process_coo() in the call-chain below, we don't
+		 * need to hold the newcatz->lock, because the newcatz
+		 * is still local to this thread and function and
+		 * newcatz->coos can't be accessed from the outside
+		 * until dns__catz_zones_merge() has been called.
+		 */
+		result = dns__catz_update_process(newcatz, name, &rdataset);
+		if (result != ISC_R_SUCCESS) {
+			char typebuf[DNS_RDATATYPE_FORMATSIZE];
+			char classbuf[DNS_RDATACLASS_FORMATSIZE];
+
+			dns_name_format(name, cname, DNS_NAME_FORMATSIZE);
+			dns_rdataclass_format(rdataset.rdclass, classbuf,
+					      sizeof(classbuf));
+			dns_rdatatype_format(rdataset.type, typebuf,
+					     sizeof(typebuf));
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_MASTER, ISC_LOG_WARNING,
+				      "catz: invalid record in catalog "
+				      "zone - %s %s %s (%s) - ignoring",
+				      cname, classbuf, typebuf,
+				      isc_result_totext(result));
+		}
+	next:
+		dns_rdataset_disassociate(&rdataset);
+		result = dns_rdatasetiter_next(rdsiter);
+	}
+
+	dns_rdatasetiter_destroy(&rdsiter);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Collect in '*changedp' the unique labels of the member zones with
+ * records in the journal of 'catz' since the last update, if 'db' at
+ * 'serial' follows that update.  Fail if the journal can not be used or
+ * if records other than those of member zones have changed.
+ */
+static isc_result_t
+catz_journal_changes(dns_catz_zone_t *catz, dns_db_t *db, uint32_t serial,
+		     isc_ht_t **changedp) {
+	isc_mem_t *mctx = catz->catzs->mctx;
+	isc_result_t result;
+	dns_journal_t *j = NULL;
+	isc_ht_t *changed = NULL;
+	char *journal = NULL;
+	uint32_t lastserial = 0;
+
+	LOCK(&catz->lock);
+	if (catz->journal != NULL && catz->lastdb == db) {
+		journal = isc_mem_strdup(mctx, catz->journal);
+		lastserial = catz->lastserial;
+	}
+	UNLOCK(&catz->lock);
+
+	if (journal == NULL || !isc_serial_gt(serial, lastserial)) {
+		result = ISC_R_NOTFOUND;
+		goto cleanup;
+	}
+
+	result = dns_journal_open(mctx, journal, DNS_JOURNAL_READ, &j);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	result = dns_journal_iter_init(j, lastserial, serial, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	isc_ht_init(&changed, mctx, 1, ISC_HT_CASE_SENSITIVE);
+	for (result = dns_journal_first_rr(j); result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(j))
+	{
+		dns_name_t *owner = NULL;
+		dns_rdata_t *rdata = NULL;
+		dns_label_t label;
+		unsigned int nlabels;
+		uint32_t ttl;
+
+		dns_journal_current_rr(j, &owner, &ttl, &rdata);
+		if (!catz_rdatatype_is_processable(rdata->type) ||
+		    (dns_name_equal(owner, &catz->name) &&
+		     (rdata->type == dns_rdatatype_soa ||
+		      rdata->type == dns_rdatatype_ns)))
+		{
+			continue;
+		}
+
+		/*
+		 * Member zone records are at or below
+		 * <unique-label>.zones.<catalog zone>.
+		 */
+		nlabels = dns_name_countlabels(owner) -
+			  dns_name_countlabels(&catz->name);
+		if (!dns_name_issubdomain(owner, &catz->name) || nlabels < 2) {
+			result = ISC_R_NOTFOUND;
+			break;
+		}
+		dns_name_getlabel(owner, nlabels - 1, &label);
+		if (catz_get_option(&label) != CATZ_OPT_ZONES) {
+			result = ISC_R_NOTFOUND;
+			break;
+		}
+		dns_name_getlabel(owner, nlabels - 2, &label);
+		result = isc_ht_add(changed, label.base, label.length, NULL);
+		if (result != ISC_R_SUCCESS && result != ISC_R_EXISTS) {
+			break;
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		*changedp = changed;
+		changed = NULL;
+		result = ISC_R_SUCCESS;
+	}
+
+cleanup:
+	if (changed != NULL) {
+		isc_ht_destroy(&changed);
+	}
+	if (j != NULL) {
+		dns_journal_destroy(&j);
+	}
+	if (journal != NULL) {
+		isc_mem_free(mctx, journal);
+	}
+
+	return (result);
+}
+
+/*
+ * Create in '*newcatzp' a new catalog zone holding the member zones of
+ * 'catz' with the unique labels in 'changed', read from 'db', and
+ * everything else copied from 'catz'.
+ */
+static isc_result_t
+catz_update_changed(dns_catz_zone_t *catz, dns_db_t *db,
+		    dns_dbversion_t *version, isc_ht_t *changed,
+		    dns_catz_zone_t **newcatzp) {
+	isc_result_t result;
+	dns_catz_zone_t *newcatz = NULL;
+	dns_dbiterator_t *dbit = NULL;
+	isc_ht_iter_t *iter = NULL;
+	dns_fixedname_t fzones, fmember, fname;
+	dns_name_t *zones = dns_fixedname_initname(&fzones);
+	dns_name_t *member = dns_fixedname_initname(&fmember);
+	dns_name_t *name = dns_fixedname_initname(&fname);
+
+	result = dns_name_fromstring2(zones, "zones", &catz->name, 0, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	result = dns_catz_new_zone(catz->catzs, &newcatz, &catz->name);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	/*
+	 * The version and the global options are the same as in the last
+	 * update; so are the change of ownership permissions of the member
+	 * zones that did not change.
+	 */
+	LOCK(&catz->lock);
+	newcatz->version = catz->version;
+	dns_catz_options_copy(catz->catzs->mctx, &catz->zoneoptions,
+			      &newcatz->zoneoptions);
+	isc_ht_iter_create(catz->entries, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		dns_catz_entry_t *entry = NULL;
+		dns_catz_coo_t *coo = NULL;
+		unsigned char *key = NULL;
+		size_t keysize;
+
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		if (isc_ht_find(changed, key, (uint32_t)keysize, NULL) ==
+		    ISC_R_SUCCESS)
+		{
+			continue;
+		}
+		isc_ht_iter_current(iter, (void **)&entry);
+		if (isc_ht_find(catz->coos, entry->name.ndata,
+				entry->name.length,
+				(void **)&coo) == ISC_R_SUCCESS)
+		{
+			isc_refcount_increment(&coo->references);
+			result = isc_ht_add(newcatz->coos, entry->name.ndata,
+					    entry->name.length, coo);
+			if (result != ISC_R_SUCCESS) {
+				catz_coo_detach(newcatz, &coo);
+			}
+		}
+	}
+	isc_ht_iter_destroy(&iter);
+	UNLOCK(&catz->lock);
+
+	result = dns_db_createiterator(db, DNS_DB_NONSEC3, &dbit);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	isc_ht_iter_create(changed, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		isc_region_t region;
+		dns_name_t label;
+		unsigned char *key = NULL;
+		size_t keysize;
+
+		if (atomic_load(&catz->catzs->shuttingdown)) {
+			result = ISC_R_SHUTTINGDOWN;
+			break;
+		}
+
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		region.base = key;
+		region.length = (unsigned int)keysize;
+		dns_name_init(&label, NULL);
+		dns_name_fromregion(&label, &region);
+		result = dns_name_concatenate(&label, zones, member, NULL);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		/*
+		 * Process the member zone's name and the names below it,
+		 * in the same order as a walk of the whole zone would.
+		 */
+		result = dns_dbiterator_seek(dbit, member);
+		if (result == DNS_R_PARTIALMATCH) {
+			result = ISC_R_SUCCESS;
+		}
+		while (result == ISC_R_SUCCESS) {
+			dns_dbnode_t *node = NULL;
+
+			result = dns_dbiterator_current(dbit, &node, name);
+			if (result != ISC_R_SUCCESS) {
+				break;
+			}
+			result = dns_dbiterator_pause(dbit);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+			if (dns_name_compare(name, member) < 0) {
+				dns_db_detachnode(db, &node);
+				result = dns_dbiterator_next(dbit);
+				continue;
+			}
+			if (!dns_name_issubdomain(name, member)) {
+				dns_db_detachnode(db, &node);
+				break;
+			}
+
+			result = catz_process_node(newcatz, db, version, node,
+						   name);
+			dns_db_detachnode(db, &node);
+			if (result != ISC_R_SUCCESS) {
+				break;
+			}
+			result = dns_dbiterator_next(dbit);
+		}
+		if (result == ISC_R_NOTFOUND || result == ISC_R_NOMORE) {
+			result = ISC_R_SUCCESS;
+		}
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	isc_ht_iter_destroy(&iter);
+	dns_dbiterator_destroy(&dbit);
+
+cleanup:
+	if (result == ISC_R_NOMORE) {
+		*newcatzp = newcatz;
+		return (ISC_R_SUCCESS);
+	}
+
+	dns_catz_detach_catz(&newcatz);
+	return (result);
+}
+
 /*
  * Process an updated database for a catalog zone.
  * It creates a new catz, iterates over database to fill it with content, and
- * then merges new catz into old catz.
+ * then merges new catz into old catz.  If only member zones changed since
+ * the last update of the same database, only those are read.
  */
 static void
 dns__catz_update_cb(void *data) {
@@ -2243,8 +2733,7 @@ dns__catz_update_cb(void *data) {
 	dns_dbiterator_t *updbit = NULL;
 	dns_fixedname_t fixname;
 	dns_name_t *name;
-	dns_rdatasetiter_t *rdsiter = NULL;
-	dns_rdataset_t rdataset;
+	isc_ht_t *changed = NULL;
 	char bname[DNS_NAME_FORMATSIZE];
 	char cname[DNS_NAME_FORMATSIZE];
 	bool is_vers_processed = false;
@@ -2306,6 +2795,32 @@ dns__catz_update_cb(void *data) {
 		      "catz: updating catalog zone '%s' with serial %" PRIu32,
 		      bname, vers);
 
+	/*
+	 * If only member zones have changed since the last update, read
+	 * just those.
+	 */
+	result = catz_journal_changes(oldcatz, updb, vers, &changed);
+	if (result == ISC_R_SUCCESS) {
+		result = catz_update_changed(oldcatz, updb,
+					     oldcatz->updbversion, changed,
+					     &newcatz);
+		if (result == ISC_R_SUCCESS) {
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_MASTER, ISC_LOG_DEBUG(3),
+				      "catz: zone '%s' updated from the "
+				      "journal, %zu member zones changed",
+				      bname, isc_ht_count(changed));
+			name = dns_fixedname_initname(&fixname);
+			goto final;
+		}
+		isc_ht_destroy(&changed);
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_DEBUG(1),
+			      "catz: failed to update zone '%s' from the "
+			      "journal, reading the whole zone - %s",
+			      bname, isc_result_totext(result));
+	}
+
 	result = dns_catz_new_zone(catzs, &newcatz, &updb->origin);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
@@ -2386,70 +2901,13 @@ dns__catz_update_cb(void *data) {
 			continue;
 		}
 
-		result = dns_db_allrdatasets(updb, node, oldcatz->updbversion,
-					     0, 0, &rdsiter);
+		result = catz_process_node(newcatz, updb, oldcatz->updbversion,
+					   node, name);
+		dns_db_detachnode(updb, &node);
 		if (result != ISC_R_SUCCESS) {
-			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
-				      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
-				      "catz: failed to fetch rrdatasets - %s",
-				      isc_result_totext(result));
-			dns_db_detachnode(updb, &node);
 			break;
 		}
 
-		dns_rdataset_init(&rdataset);
-		result = dns_rdatasetiter_first(rdsiter);
-		while (result == ISC_R_SUCCESS) {
-			dns_rdatasetiter_current(rdsiter, &rdataset);
-
-			/*
-			 * Skip processing DNSSEC-related and ZONEMD types,
-			 * because we are not interested in them in the context
-			 * of a catalog zone, and processing them will fail
-			 * and produce an unnecessary warning message.
-			 */
-			if (!catz_rdatatype_is_processable(rdataset.type)) {
-				goto next;
-			}
-
-			/*
-			 * Although newcatz->coos is accessed in
-			 * catz_process_coo() in the call-chain below, we don't
-			 * need to hold the newcatz->lock, because the newcatz
-			 * is still local to this thread and function and
-			 * newcatz->coos can't be accessed from the outside
-			 * until dns__catz_zones_merge() has been called.
-			 */
-			result = dns__catz_update_process(newcatz, name,
-							  &rdataset);
-			if (result != ISC_R_SUCCESS) {
-				char typebuf[DNS_RDATATYPE_FORMATSIZE];
-				char classbuf[DNS_RDATACLASS_FORMATSIZE];
-
-				dns_name_format(name, cname,
-						DNS_NAME_FORMATSIZE);
-				dns_rdataclass_format(rdataset.rdclass,
-						      classbuf,
-						      sizeof(classbuf));
-				dns_rdatatype_format(rdataset.type, typebuf,
-						     sizeof(typebuf));
-				isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
-					      DNS_LOGMODULE_MASTER,
-					      ISC_LOG_WARNING,
-					      "catz: invalid record in catalog "
-					      "zone - %s %s %s (%s) - ignoring",
-					      cname, classbuf, typebuf,
-					      isc_result_totext(result));
-			}
-		next:
-			dns_rdataset_disassociate(&rdataset);
-			result = dns_rdatasetiter_next(rdsiter);
-		}
-
-		dns_rdatasetiter_destroy(&rdsiter);
-
-		dns_db_detachnode(updb, &node);
-
 		if (!is_vers_processed) {
 			is_vers_processed = true;
 			result = dns_dbiterator_first(updbit);
@@ -2502,7 +2960,7 @@ final:
 	/*
 	 * Finally merge new zone into old zone.
 	 */
-	result = dns__catz_zones_merge(oldcatz, newcatz);
+	result = dns__catz_zones_merge(oldcatz, newcatz, changed);
 	dns_catz_detach_catz(&newcatz);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
@@ -2517,6 +2975,16 @@ final:
 		      ISC_LOG_DEBUG(3),
 		      "catz: update_from_db: new zone merged");
 
+	LOCK(&oldcatz->lock);
+	if (oldcatz->lastdb != updb) {
+		if (oldcatz->lastdb != NULL) {
+			dns_db_detach(&oldcatz->lastdb);
+		}
+		dns_db_attach(updb, &oldcatz->lastdb);
+	}
+	oldcatz->lastserial = vers;
+	UNLOCK(&oldcatz->lock);
+
 	/*
 	 * When we're doing reconfig and setting a new catalog zone
 	 * from an existing zone we won't have a chance to set up
@@ -2534,6 +3002,9 @@ final:
 	UNLOCK(&catzs->lock);
 
 exit:
+	if (changed != NULL) {
+		isc_ht_destroy(&changed);
+	}
 	catz->updateresult = result;
 }
 
@@ -2645,7 +3116,7 @@ dns_catz_postreconfig(dns_catz_zones_t *catzs) {
 			result = dns_catz_new_zone(catzs, &newcatz,
 						   &catz->name);
 			INSIST(result == ISC_R_SUCCESS);
-			dns__catz_zones_merge(catz, newcatz);
+			dns__catz_zones_merge(catz, newcatz, NULL);
 			dns_catz_detach_catz(&newcatz);
 
 			/* Make sure that we have an empty catalog zone. */
@@ -20,9 +20,11 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/mem.h>
 #include <isc/once.h>
+#include <isc/profile.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
 #include <isc/string.h>
@@ -68,6 +70,8 @@ static isc_once_t once = ISC_ONCE_INIT;
 
 static dns_dbimplementation_t rbtimp;
 
+static atomic_uint_fast32_t generation = 0;
+
 static void
 initialize(void) {
 	isc_rwlock_init(&implock, 0, 0);
@@ -406,6 +410,7 @@ dns_db_closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
 	(db->methods->closeversion)(db, versionp, commit);
 
 	if (commit) {
+		dns_db_newgeneration();
 		for (listener = ISC_LIST_HEAD(db->update_listeners);
 		     listener != NULL; listener = ISC_LIST_NEXT(listener, link))
 		{
@@ -476,6 +481,8 @@ dns_db_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	    dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
 	    dns_dbnode_t **nodep, dns_name_t *foundname,
 	    dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	isc_result_t result;
+
 	/*
 	 * Find the best match for 'name' and 'type' in version 'version'
 	 * of 'db'.
@@ -491,15 +498,20 @@ dns_db_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 		(DNS_RDATASET_VALID(sigrdataset) &&
 		 !dns_rdataset_isassociated(sigrdataset)));
 
+	isc_profile_enter(isc_profile_db);
 	if (db->methods->find != NULL) {
-		return ((db->methods->find)(db, name, version, type, options,
-					    now, nodep, foundname, rdataset,
-					    sigrdataset));
+		result = (db->methods->find)(db, name, version, type, options,
+					     now, nodep, foundname, rdataset,
+					     sigrdataset);
 	} else {
-		return ((db->methods->findext)(db, name, version, type, options,
-					       now, nodep, foundname, NULL,
-					       NULL, rdataset, sigrdataset));
+		result = (db->methods->findext)(db, name, version, type,
+						options, now, nodep, foundname,
+						NULL, NULL, rdataset,
+						sigrdataset);
 	}
+	isc_profile_leave(isc_profile_db);
+
+	return (result);
 }
 
 isc_result_t
@@ -508,6 +520,8 @@ dns_db_findext(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	       dns_dbnode_t **nodep, dns_name_t *foundname,
 	       dns_clientinfomethods_t *methods, dns_clientinfo_t *clientinfo,
 	       dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	isc_result_t result;
+
 	/*
 	 * Find the best match for 'name' and 'type' in version 'version'
 	 * of 'db', passing in 'arg'.
@@ -523,15 +537,19 @@ dns_db_findext(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 		(DNS_RDATASET_VALID(sigrdataset) &&
 		 !dns_rdataset_isassociated(sigrdataset)));
 
+	isc_profile_enter(isc_profile_db);
 	if (db->methods->findext != NULL) {
-		return ((db->methods->findext)(
+		result = (db->methods->findext)(
 			db, name, version, type, options, now, nodep, foundname,
-			methods, clientinfo, rdataset, sigrdataset));
+			methods, clientinfo, rdataset, sigrdataset);
 	} else {
-		return ((db->methods->find)(db, name, version, type, options,
-					    now, nodep, foundname, rdataset,
-					    sigrdataset));
+		result = (db->methods->find)(db, name, version, type, options,
+					     now, nodep, foundname, rdataset,
+					     sigrdataset);
 	}
+	isc_profile_leave(isc_profile_db);
+
+	return (result);
 }
 
 isc_result_t
@@ -695,6 +713,8 @@ isc_result_t
 dns_db_addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		   isc_stdtime_t now, dns_rdataset_t *rdataset,
 		   unsigned int options, dns_rdataset_t *addedrdataset) {
+	isc_result_t result;
+
 	/*
 	 * Add 'rdataset' to 'node' in version 'version' of 'db'.
 	 */
@@ -713,8 +733,12 @@ dns_db_addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		(DNS_RDATASET_VALID(addedrdataset) &&
 		 !dns_rdataset_isassociated(addedrdataset)));
 
-	return ((db->methods->addrdataset)(db, node, version, now, rdataset,
-					   options, addedrdataset));
+	isc_profile_enter(isc_profile_db);
+	result = (db->methods->addrdataset)(db, node, version, now, rdataset,
+					    options, addedrdataset);
+	isc_profile_leave(isc_profile_db);
+
+	return (result);
 }
 
 isc_result_t
@@ -828,6 +852,28 @@ dns_db_hashsize(dns_db_t *db) {
 	return ((db->methods->hashsize)(db));
 }
 
+void
+dns_db_setsizehint(dns_db_t *db, size_t nodes) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) == 0);
+
+	if (db->methods->setsizehint != NULL) {
+		(db->methods->setsizehint)(db, nodes);
+	}
+}
+
+unsigned int
+dns_db_nodelockwaits(dns_db_t *db, uint64_t *waits, unsigned int nwaits) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(waits != NULL || nwaits == 0);
+
+	if (db->methods->nodelockwaits == NULL) {
+		return (0);
+	}
+
+	return ((db->methods->nodelockwaits)(db, waits, nwaits));
+}
+
 void
 dns_db_settask(dns_db_t *db, isc_task_t *task) {
 	REQUIRE(DNS_DB_VALID(db));
@@ -1052,6 +1098,16 @@ dns_db_updatenotify_unregister(dns_db_t *db, dns_dbupdate_callback_t fn,
 	return (ISC_R_NOTFOUND);
 }
 
+uint32_t
+dns_db_generation(void) {
+	return (atomic_load_acquire(&generation));
+}
+
+void
+dns_db_newgeneration(void) {
+	atomic_fetch_add_release(&generation, 1);
+}
+
 isc_result_t
 dns_db_nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name) {
 	REQUIRE(db != NULL);
@@ -1108,6 +1164,70 @@ dns_db_getservestalerefresh(dns_db_t *db, uint32_t *interval) {
 	return (ISC_R_NOTIMPLEMENTED);
 }
 
+void
+dns_db_findpopular(dns_db_t *db, isc_stdtime_t now, dns_ttl_t window,
+		   unsigned int minhits, dns_dbpopular_t *popular,
+		   unsigned int size, unsigned int *countp) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) != 0);
+	REQUIRE(popular != NULL || size == 0);
+	REQUIRE(countp != NULL && *countp <= size);
+
+	if (db->methods->findpopular != NULL) {
+		(db->methods->findpopular)(db, now, window, minhits, popular,
+					   size, countp);
+	}
+}
+
+isc_result_t
+dns_db_cleanbucket(dns_db_t *db, unsigned int bucket, isc_stdtime_t now,
+		   unsigned int limit, unsigned int *countp) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) != 0);
+	REQUIRE(countp != NULL);
+
+	*countp = 0;
+	if (db->methods->cleanbucket != NULL) {
+		return ((db->methods->cleanbucket)(db, bucket, now, limit,
+						   countp));
+	}
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+void
+dns_db_setdomainusage(dns_db_t *db, bool enable) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) != 0);
+
+	if (db->methods->setdomainusage != NULL) {
+		(db->methods->setdomainusage)(db, enable);
+	}
+}
+
+void
+dns_db_topdomains(dns_db_t *db, dns_dbdomainusage_t *top, unsigned int size,
+		  unsigned int *countp) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) != 0);
+	REQUIRE(top != NULL || size == 0);
+	REQUIRE(countp != NULL && *countp <= size);
+
+	if (db->methods->topdomains != NULL) {
+		(db->methods->topdomains)(db, top, size, countp);
+	}
+}
+
+isc_result_t
+dns_db_setcachepolicy(dns_db_t *db, dns_cachepolicy_t policy) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) != 0);
+
+	if (db->methods->setcachepolicy != NULL) {
+		return ((db->methods->setcachepolicy)(db, policy));
+	}
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 isc_result_t
 dns_db_setgluecachestats(dns_db_t *db, isc_stats_t *stats) {
 	REQUIRE(dns_db_iszone(db));
@@ -26,8 +26,10 @@
 #include <isc/netmgr.h>
 #include <isc/portset.h>
 #include <isc/print.h>
+#include <isc/profile.h>
 #include <isc/random.h>
 #include <isc/stats.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/time.h>
 #include <isc/util.h>
@@ -41,6 +43,20 @@
 
 typedef ISC_LIST(dns_dispentry_t) dns_displist_t;
 
+/*%
+ * An idle connected UDP socket kept for reuse (see dispsock_get()).
+ */
+typedef struct dispsock dispsock_t;
+struct dispsock {
+	unsigned int magic;
+	isc_nmhandle_t *handle;
+	isc_sockaddr_t local;
+	isc_sockaddr_t peer;
+	unsigned int uses;	/*%< queries sent on the socket so far */
+	isc_stdtime_t expires;	/*%< when to stop reusing it */
+	ISC_LINK(dispsock_t) link;
+};
+
 typedef struct dns_qid {
 	unsigned int magic;
 	isc_mutex_t lock;
@@ -96,6 +112,8 @@ struct dns_dispentry {
 	dispatch_cb_t response;
 	void *arg;
 	bool reading;
+	bool reusable; /*%< UDP socket got a matching response */
+	unsigned int uses;
 	isc_result_t result;
 	ISC_LINK(dns_dispentry_t) link;
 	ISC_LINK(dns_dispentry_t) alink;
@@ -130,6 +148,9 @@ struct dns_dispatch {
 	unsigned int requests; /*%< how many requests we have */
 
 	unsigned int timedout;
+
+	ISC_LIST(dispsock_t) idle; /*%< UDP sockets for reuse, oldest first */
+	unsigned int nidle;
 };
 
 #define QID_MAGIC    ISC_MAGIC('Q', 'i', 'd', ' ')
@@ -160,6 +181,33 @@ struct dns_dispatch {
 #define DNS_QID_INCREMENT 16433
 #endif /* ifndef DNS_QID_INCREMENT */
 
+/*%
+ * A connected UDP socket that got a matching response is kept by its
+ * dispatch, and reused by later queries to the same server, saving the
+ * socket(), bind() and connect() calls of a new one.  So that the port
+ * of a query stays hard to guess, a socket is used for at most
+ * DNS_DISPATCH_SOCKREUSE queries and kept idle for at most
+ * DNS_DISPATCH_SOCKIDLE seconds, and a dispatch keeps at most
+ * DNS_DISPATCH_MAXIDLE idle sockets.
+ */
+#ifndef DNS_DISPATCH_SOCKREUSE
+#define DNS_DISPATCH_SOCKREUSE 8
+#endif /* ifndef DNS_DISPATCH_SOCKREUSE */
+#ifndef DNS_DISPATCH_SOCKIDLE
+#define DNS_DISPATCH_SOCKIDLE 2
+#endif /* ifndef DNS_DISPATCH_SOCKIDLE */
+#ifndef DNS_DISPATCH_MAXIDLE
+#define DNS_DISPATCH_MAXIDLE 64
+#endif /* ifndef DNS_DISPATCH_MAXIDLE */
+
+/*%
+ * How long (in milliseconds) a TCP connection with no outstanding
+ * queries is kept open for reuse, see dns_dispatch_gettcp().
+ */
+#ifndef DNS_DISPATCH_TCPIDLE
+#define DNS_DISPATCH_TCPIDLE 2000
+#endif /* ifndef DNS_DISPATCH_TCPIDLE */
+
 #if DNS_DISPATCH_TRACE
 #define dns_dispentry_ref(ptr) \
 	dns_dispentry__ref(ptr, __func__, __FILE__, __LINE__)
@@ -394,10 +442,115 @@ setup_socket(dns_dispatch_t *disp, dns_dispentry_t *resp,
 		*portp = port;
 	}
 	resp->port = port;
+	resp->uses = 1;
 
 	return (ISC_R_SUCCESS);
 }
 
+/*%
+ * Take the most recently used idle socket connected to 'dest', if any,
+ * for 'resp'.  The caller must hold the disp->lock.
+ */
+static bool
+dispsock_get(dns_dispatch_t *disp, dns_dispentry_t *resp,
+	     const isc_sockaddr_t *dest) {
+	dispsock_t *dispsock = NULL;
+	isc_stdtime_t now;
+
+	isc_stdtime_get(&now);
+	for (dispsock = ISC_LIST_TAIL(disp->idle); dispsock != NULL;
+	     dispsock = ISC_LIST_PREV(dispsock, link))
+	{
+		if (dispsock->expires < now) {
+			/* The ones before are older still. */
+			return (false);
+		}
+		if (isc_sockaddr_equal(&dispsock->peer, dest)) {
+			break;
+		}
+	}
+	if (dispsock == NULL) {
+		return (false);
+	}
+
+	ISC_LIST_UNLINK(disp->idle, dispsock, link);
+	disp->nidle--;
+
+	resp->handle = dispsock->handle;
+	resp->local = dispsock->local;
+	resp->peer = *dest;
+	resp->port = isc_sockaddr_getport(&dispsock->local);
+	resp->uses = dispsock->uses + 1;
+
+	dispsock->magic = 0;
+	isc_mem_put(disp->mgr->mctx, dispsock, sizeof(*dispsock));
+
+	inc_stats(disp->mgr, dns_resstatscounter_dispsockreuse);
+
+	return (true);
+}
+
+static void
+dispsock_free(dns_dispatchmgr_t *mgr, dispsock_t **dispsockp) {
+	dispsock_t *dispsock = *dispsockp;
+
+	REQUIRE(VALID_DISPSOCK(dispsock));
+
+	*dispsockp = NULL;
+	dispsock->magic = 0;
+	isc_nmhandle_detach(&dispsock->handle);
+	isc_mem_put(mgr->mctx, dispsock, sizeof(*dispsock));
+}
+
+/*%
+ * Keep the UDP socket of 'resp' for reuse, if it may be reused again,
+ * and drop the idle sockets that have expired or are too many.
+ */
+static void
+dispsock_put(dns_dispatch_t *disp, dns_dispentry_t *resp) {
+	dispsock_t *dispsock = NULL, *next = NULL;
+	ISC_LIST(dispsock_t) expired = ISC_LIST_INITIALIZER;
+	isc_stdtime_t now;
+
+	if (resp->uses >= DNS_DISPATCH_SOCKREUSE) {
+		isc_nmhandle_detach(&resp->handle);
+		return;
+	}
+
+	isc_stdtime_get(&now);
+	dispsock = isc_mem_get(disp->mgr->mctx, sizeof(*dispsock));
+	*dispsock = (dispsock_t){
+		.handle = resp->handle,
+		.local = resp->local,
+		.peer = resp->peer,
+		.uses = resp->uses,
+		.expires = now + DNS_DISPATCH_SOCKIDLE,
+		.link = ISC_LINK_INITIALIZER,
+		.magic = DISPSOCK_MAGIC,
+	};
+	resp->handle = NULL;
+
+	LOCK(&disp->lock);
+	ISC_LIST_APPEND(disp->idle, dispsock, link);
+	disp->nidle++;
+	while ((dispsock = ISC_LIST_HEAD(disp->idle)) != NULL &&
+	       (dispsock->expires < now || disp->nidle > DNS_DISPATCH_MAXIDLE))
+	{
+		ISC_LIST_UNLINK(disp->idle, dispsock, link);
+		disp->nidle--;
+		ISC_LIST_APPEND(expired, dispsock, link);
+	}
+	UNLOCK(&disp->lock);
+
+	for (dispsock = ISC_LIST_HEAD(expired); dispsock != NULL;
+	     dispsock = next)
+	{
+		next = ISC_LIST_NEXT(dispsock, link);
+		ISC_LIST_UNLINK(expired, dispsock, link);
+		dispsock_free(disp->mgr, &dispsock);
+	}
+}
+
 /*
  * Find an entry for query ID 'id', socket address 'dest', and port number
  * 'port'.
@@ -451,7 +604,11 @@ dispentry_destroy(dns_dispentry_t *resp) {
 
 	dispentry_log(resp, LVL(90), "destroying");
 
-	if (resp->handle != NULL) {
+	if (resp->handle != NULL && resp->reusable) {
+		dispentry_log(resp, LVL(90), "keeping handle %p for reuse",
+			      resp->handle);
+		dispsock_put(disp, resp);
+	} else if (resp->handle != NULL) {
 		dispentry_log(resp, LVL(90), "detaching handle %p from %p",
 			      resp->handle, &resp->handle);
 		isc_nmhandle_detach(&resp->handle);
@@ -518,6 +675,7 @@ udp_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 	LOCK(&disp->lock);
 	INSIST(resp->reading);
 	resp->reading = false;
+	resp->reusable = false;
 
 	response = resp->response;
 
@@ -601,8 +759,10 @@ udp_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 	}
 
 	/*
-	 * We have the right resp, so call the caller back.
+	 * We have the right resp, so call the caller back.  The socket
+	 * works, so it can be used for another query to the server.
 	 */
+	resp->reusable = true;
 	goto done;
 
 next:
@@ -635,7 +795,9 @@ done:
 	if (response != NULL) {
 		dispentry_log(resp, LVL(90), "UDP read callback on %p: %s",
 			      handle, isc_result_totext(eresult));
+		isc_profile_enter(isc_profile_resolver);
 		response(eresult, region, resp->arg);
+		isc_profile_leave(isc_profile_resolver);
 	}
 
 	dns_dispentry_detach(&resp); /* DISPENTRY003 */
@@ -749,7 +911,9 @@ tcp_recv_done(dns_dispentry_t *resp, isc_result_t eresult,
 	dispentry_log(resp, LVL(90), "read callback: %s",
 		      isc_result_totext(eresult));
 
+	isc_profile_enter(isc_profile_resolver);
 	resp->response(eresult, region, resp->arg);
+	isc_profile_leave(isc_profile_resolver);
 	dns_dispentry_detach(&resp); /* DISPENTRY009 */
 }
 
@@ -809,6 +973,14 @@ tcp_recv(isc_nmhandle_t *handle, isc_result_t result, isc_region_t *region,
 	 */
 	switch (result) {
 	case ISC_R_TIMEDOUT:
+		if (ISC_LIST_EMPTY(disp->active)) {
+			/*
+			 * The idle connection was not reused in time.
+			 */
+			dispatch_log(disp, LVL(90), "closing idle TCP");
+			result = ISC_R_CANCELED;
+			break;
+		}
 		/*
 		 * Time out the oldest response in the active queue.
 		 */
@@ -1143,6 +1315,7 @@ dispatch_allocate(dns_dispatchmgr_t *mgr, isc_socktype_t type,
 		.link = ISC_LINK_INITIALIZER,
 		.active = ISC_LIST_INITIALIZER,
 		.pending = ISC_LIST_INITIALIZER,
+		.idle = ISC_LIST_INITIALIZER,
 		.tid = isc_nm_tid(),
 		.magic = DISPATCH_MAGIC,
 	};
@@ -1259,11 +1432,11 @@ dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
 			/* A dispatch in indeterminate state, skip it */
 			break;
 		case DNS_DISPATCHSTATE_CONNECTED:
-			if (ISC_LIST_EMPTY(disp->active)) {
-				/* Ignore dispatch with no responses */
+			if (ISC_LIST_EMPTY(disp->active) && !disp->reading) {
+				/* Ignore dispatch that is being closed */
 				break;
 			}
-			/* We found a connected dispatch */
+			/* We found a connected (possibly idle) dispatch */
 			dns_dispatch_attach(disp, &disp_connected);
 			break;
 		case DNS_DISPATCHSTATE_CONNECTING:
@@ -1404,6 +1577,13 @@ dispatch_destroy(dns_dispatch_t *disp) {
 		isc_nmhandle_detach(&disp->handle);
 	}
 
+	while (!ISC_LIST_EMPTY(disp->idle)) {
+		dispsock_t *dispsock = ISC_LIST_HEAD(disp->idle);
+		ISC_LIST_UNLINK(disp->idle, dispsock, link);
+		disp->nidle--;
+		dispsock_free(mgr, &dispsock);
+	}
+
 	isc_mutex_destroy(&disp->lock);
 
 	isc_mem_put(mgr->mctx, disp, sizeof(*disp));
@@ -1478,7 +1658,11 @@ dns_dispatch_add(dns_dispatch_t *disp, unsigned int options,
 #endif
 	isc_refcount_init(&resp->references, 1); /* DISPENTRY000 */
 
-	if (disp->socktype == isc_socktype_udp) {
+	if (disp->socktype == isc_socktype_udp &&
+	    dispsock_get(disp, resp, dest))
+	{
+		localport = resp->port;
+	} else if (disp->socktype == isc_socktype_udp) {
 		isc_result_t result = setup_socket(disp, resp, dest,
 						   &localport);
 		if (result != ISC_R_SUCCESS) {
@@ -1525,6 +1709,9 @@ dns_dispatch_add(dns_dispatch_t *disp, unsigned int options,
 	UNLOCK(&qid->lock);
 
 	if (!ok) {
+		if (resp->handle != NULL) {
+			isc_nmhandle_detach(&resp->handle);
+		}
 		isc_mem_put(disp->mgr->mctx, resp, sizeof(*resp));
 		UNLOCK(&disp->lock);
 		return (ISC_R_NOMORE);
@@ -1687,40 +1874,23 @@ tcp_dispentry_cancel(dns_dispentry_t *resp, isc_result_t result) {
 		if (ISC_LIST_EMPTY(disp->active)) {
 			INSIST(disp->handle != NULL);
 
-#if DISPATCH_TCP_KEEPALIVE
 			/*
-			 * This is an experimental code that keeps the TCP
-			 * connection open for 1 second before it is finally
-			 * closed.  By keeping the TCP connection open, it can
-			 * be reused by dns_request that uses
-			 * dns_dispatch_gettcp() to join existing TCP
-			 * connections.
-			 *
-			 * It is disabled for now, because it changes the
-			 * behaviour, but I am keeping the code here for future
-			 * reference when we improve the dns_dispatch to reuse
-			 * the TCP connections also in the resolver.
-			 *
-			 * The TCP connection reuse should be seamless and not
-			 * require any extra handling on the client side though.
+			 * Keep the idle TCP connection open for a while, so
+			 * that it can be reused by the next query to the same
+			 * server through dns_dispatch_gettcp().  The pending
+			 * read holds the dispatch until the idle timeout
+			 * fires or the connection is closed by the server.
 			 */
 			isc_nmhandle_cleartimeout(disp->handle);
-			isc_nmhandle_settimeout(disp->handle, 1000);
+			isc_nmhandle_settimeout(disp->handle,
+						DNS_DISPATCH_TCPIDLE);
 
 			if (!disp->reading) {
 				dispentry_log(resp, LVL(90),
-					      "final 1 second timeout on %p",
+					      "idle timeout on %p",
 					      disp->handle);
 				tcp_startrecv(NULL, disp, NULL);
 			}
-#else
-			if (disp->reading) {
-				dispentry_log(resp, LVL(90),
-					      "canceling read on %p",
-					      disp->handle);
-				isc_nm_cancelread(disp->handle);
-			}
-#endif
 		}
 		break;
 
@@ -1957,6 +2127,28 @@ detach:
 
 static void
 udp_dispatch_connect(dns_dispatch_t *disp, dns_dispentry_t *resp) {
+	if (resp->handle != NULL) {
+		/*
+		 * Reusing a connected socket (see dispsock_get()); we
+		 * are already connected, so call the connected cb.
+		 */
+		LOCK(&disp->lock);
+		resp->state = DNS_DISPATCHSTATE_CONNECTED;
+		TIME_NOW(&resp->start);
+		isc_nmhandle_settimeout(resp->handle, resp->timeout);
+		dispentry_log(resp, LVL(90), "reusing handle %p, use %u",
+			      resp->handle, resp->uses);
+		dns_dispentry_ref(resp); /* DISPENTRY003 */
+		isc_nm_read(resp->handle, udp_recv, resp);
+		resp->reading = true;
+		UNLOCK(&disp->lock);
+
+		dispentry_log(resp, LVL(90), "connect callback: %s",
+			      isc_result_totext(ISC_R_SUCCESS));
+		resp->connected(ISC_R_SUCCESS, NULL, resp->arg);
+		return;
+	}
+
 	LOCK(&disp->lock);
 	resp->state = DNS_DISPATCHSTATE_CONNECTING;
 	TIME_NOW(&resp->start);
@@ -2012,6 +2204,14 @@ tcp_dispatch_connect(dns_dispatch_t *disp, dns_dispentry_t *resp) {
 		resp->state = DNS_DISPATCHSTATE_CONNECTED;
 		TIME_NOW(&resp->start);
 
+		/*
+		 * If the connection was idle, the pending read still
+		 * runs with the idle timeout; use ours instead.
+		 */
+		if (disp->reading && ISC_LIST_EMPTY(disp->active)) {
+			isc_nmhandle_settimeout(disp->handle, resp->timeout);
+		}
+
 		/* Add the resp to the reading list */
 		ISC_LIST_APPEND(disp->active, resp, alink);
 		dispentry_log(resp, LVL(90), "already connected; attaching");
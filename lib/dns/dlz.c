@@ -535,3 +535,30 @@ dns_dlz_ssumatch(dns_dlzdb_t *dlzdatabase, const dns_name_t *signer,
 				    impl->driverarg, dlzdatabase->dbdata);
 	return (r);
 }
+
+void
+dns_dlz_setcachettl(dns_dlzdb_t *dlzdb, dns_ttl_t ttl) {
+	dns_dlzimplementation_t *impl;
+
+	REQUIRE(DNS_DLZ_VALID(dlzdb));
+	REQUIRE(dlzdb->implementation != NULL);
+
+	impl = dlzdb->implementation;
+	if (impl->methods->setcachettl != NULL) {
+		impl->methods->setcachettl(impl->driverarg, dlzdb->dbdata,
+					   ttl);
+	}
+}
+
+void
+dns_dlz_flushcache(dns_dlzdb_t *dlzdb) {
+	dns_dlzimplementation_t *impl;
+
+	REQUIRE(DNS_DLZ_VALID(dlzdb));
+	REQUIRE(dlzdb->implementation != NULL);
+
+	impl = dlzdb->implementation;
+	if (impl->methods->flushcache != NULL) {
+		impl->methods->flushcache(impl->driverarg, dlzdb->dbdata);
+	}
+}
@@ -13,13 +13,11 @@
 
 /*! \file */
 
-#include <ctype.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
 
 #include <isc/buffer.h>
-#include <isc/dir.h>
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/result.h>
@@ -1407,9 +1405,9 @@ dns_dnssec_findmatchingkeys(const dns_name_t *origin, const char *directory,
 			    isc_stdtime_t now, isc_mem_t *mctx,
 			    dns_dnsseckeylist_t *keylist) {
 	isc_result_t result = ISC_R_SUCCESS;
-	bool dir_open = false;
 	dns_dnsseckeylist_t list;
-	isc_dir_t dir;
+	isc_buffer_t *files = NULL;
+	const char *file = NULL;
 	dns_dnsseckey_t *key = NULL;
 	dst_key_t *dstkey = NULL;
 	char namebuf[DNS_NAME_FORMATSIZE];
@@ -1418,7 +1416,6 @@ dns_dnssec_findmatchingkeys(const dns_name_t *origin, const char *directory,
 
 	REQUIRE(keylist != NULL);
 	ISC_LIST_INIT(list);
-	isc_dir_init(&dir);
 
 	isc_buffer_init(&b, namebuf, sizeof(namebuf) - 1);
 	RETERR(dns_name_tofilenametext(origin, false, &b));
@@ -1428,57 +1425,28 @@ dns_dnssec_findmatchingkeys(const dns_name_t *origin, const char *directory,
 	if (directory == NULL) {
 		directory = ".";
 	}
-	RETERR(isc_dir_open(&dir, directory));
-	dir_open = true;
 
-	while (isc_dir_read(&dir) == ISC_R_SUCCESS) {
-		if (dir.entry.name[0] != 'K' || dir.entry.length < len + 1 ||
-		    dir.entry.name[len + 1] != '+' ||
-		    strncasecmp(dir.entry.name + 1, namebuf, len) != 0)
-		{
-			continue;
-		}
+	/*
+	 * The files are named "K<name>+<alg>+<id>.private".
+	 */
+	result = dst_key_privatefiles(directory, namebuf, mctx, &files);
+	if (result == ISC_R_NOTFOUND) {
+		return (ISC_R_NOTFOUND);
+	}
+	RETERR(result);
 
+	for (file = isc_buffer_base(files);
+	     file < (char *)isc_buffer_used(files); file += strlen(file) + 1)
+	{
 		alg = 0;
-		for (i = len + 1 + 1; i < dir.entry.length; i++) {
-			if (!isdigit((unsigned char)dir.entry.name[i])) {
-				break;
-			}
+		for (i = len + 1 + 1; i < len + 1 + 1 + 3; i++) {
 			alg *= 10;
-			alg += dir.entry.name[i] - '0';
-		}
-
-		/*
-		 * Did we not read exactly 3 digits?
-		 * Did we overflow?
-		 * Did we correctly terminate?
-		 */
-		if (i != len + 1 + 1 + 3 || i >= dir.entry.length ||
-		    dir.entry.name[i] != '+')
-		{
-			continue;
-		}
-
-		for (i++; i < dir.entry.length; i++) {
-			if (!isdigit((unsigned char)dir.entry.name[i])) {
-				break;
-			}
-		}
-
-		/*
-		 * Did we not read exactly 5 more digits?
-		 * Did we overflow?
-		 * Did we correctly terminate?
-		 */
-		if (i != len + 1 + 1 + 3 + 1 + 5 || i >= dir.entry.length ||
-		    strcmp(dir.entry.name + i, ".private") != 0)
-		{
-			continue;
+			alg += file[i] - '0';
 		}
 
 		dstkey = NULL;
 		result = dst_key_fromnamedfile(
-			dir.entry.name, directory,
+			file, directory,
 			DST_TYPE_PUBLIC | DST_TYPE_PRIVATE | DST_TYPE_STATE,
 			mctx, &dstkey);
 
@@ -1500,8 +1468,7 @@ dns_dnssec_findmatchingkeys(const dns_name_t *origin, const char *directory,
 				      DNS_LOGMODULE_DNSSEC, ISC_LOG_WARNING,
 				      "dns_dnssec_findmatchingkeys: "
 				      "error reading key file %s: %s",
-				      dir.entry.name,
-				      isc_result_totext(result));
+				      file, isc_result_totext(result));
 			continue;
 		}
 
@@ -1525,8 +1492,8 @@ dns_dnssec_findmatchingkeys(const dns_name_t *origin, const char *directory,
 	}
 
 failure:
-	if (dir_open) {
-		isc_dir_close(&dir);
+	if (files != NULL) {
+		isc_buffer_free(&files);
 	}
 	INSIST(key == NULL);
 	while ((key = ISC_LIST_HEAD(list)) != NULL) {
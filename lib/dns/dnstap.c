@@ -56,6 +56,7 @@
 
 #include <isc/buffer.h>
 #include <isc/file.h>
+#include <isc/hash.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
@@ -84,8 +85,24 @@
 #define DTENV_MAGIC	 ISC_MAGIC('D', 't', 'n', 'v')
 #define VALID_DTENV(env) ISC_MAGIC_VALID(env, DTENV_MAGIC)
 
-#define DNSTAP_CONTENT_TYPE	"protobuf:dnstap.Dnstap"
-#define DNSTAP_INITIAL_BUF_SIZE 256
+#define DNSTAP_CONTENT_TYPE "protobuf:dnstap.Dnstap"
+
+/*%
+ * Frames of up to DT_SLABSIZE bytes are packed into preallocated slabs,
+ * DT_SLABS per pool, with each thread using pool 'isc_tid_v % DT_POOLS'.
+ * A slab is claimed by setting 'busy' and handed back by the fstrm I/O
+ * thread once the frame has been written, so no lock is taken; larger
+ * frames, and frames packed while all the slabs of the pool are in
+ * flight, are malloc()ed.
+ */
+#define DT_POOLS    32
+#define DT_SLABS    32
+#define DT_SLABSIZE 1024
+
+typedef struct dt_slab {
+	atomic_bool busy;
+	uint8_t data[DT_SLABSIZE];
+} dt_slab_t;
 
 struct dns_dtmsg {
 	void *buf;
@@ -122,6 +139,7 @@ struct dns_dtenv {
 	int rolls;
 	isc_log_rollsuffix_t suffix;
 	isc_stats_t *stats;
+	dt_slab_t *slabs; /* DT_POOLS * DT_SLABS */
 };
 
 #define CHECK(x)                             \
@@ -134,6 +152,7 @@ struct dns_dtenv {
 typedef struct ioq {
 	unsigned int generation;
 	struct fstrm_iothr_queue *ioq;
+	unsigned int slab; /* next slab to try in this thread's pool */
 } dt__ioq_t;
 
 static thread_local dt__ioq_t dt_ioq = { 0 };
@@ -170,6 +189,11 @@ dns_dt_create(isc_mem_t *mctx, dns_dtmode_t mode, const char *path,
 	env->reopen_queued = false;
 	env->path = isc_mem_strdup(env->mctx, path);
 	isc_refcount_init(&env->refcount, 1);
+	env->slabs = isc_mem_get(env->mctx,
+				 DT_POOLS * DT_SLABS * sizeof(env->slabs[0]));
+	for (size_t i = 0; i < DT_POOLS * DT_SLABS; i++) {
+		atomic_init(&env->slabs[i].busy, false);
+	}
 	CHECK(isc_stats_create(env->mctx, &env->stats, dns_dnstapcounter_max));
 
 	fwopt = fstrm_writer_options_init();
@@ -240,6 +264,8 @@ cleanup:
 		if (env->stats != NULL) {
 			isc_stats_detach(&env->stats);
 		}
+		isc_mem_put(env->mctx, env->slabs,
+			    DT_POOLS * DT_SLABS * sizeof(env->slabs[0]));
 		isc_mem_putanddetach(&env->mctx, env, sizeof(dns_dtenv_t));
 	}
 
@@ -505,6 +531,8 @@ destroy(dns_dtenv_t *env) {
 	if (env->stats != NULL) {
 		isc_stats_detach(&env->stats);
 	}
+	isc_mem_put(env->mctx, env->slabs,
+		    DT_POOLS * DT_SLABS * sizeof(env->slabs[0]));
 
 	isc_mem_putanddetach(&env->mctx, env, sizeof(*env));
 }
@@ -521,36 +549,69 @@ dns_dt_detach(dns_dtenv_t **envp) {
 	}
 }
 
+static dt_slab_t *
+get_slab(dns_dtenv_t *env) {
+	dt_slab_t *pool = &env->slabs[(isc_tid_v % DT_POOLS) * DT_SLABS];
+
+	for (size_t i = 0; i < DT_SLABS; i++) {
+		dt_slab_t *slab = &pool[dt_ioq.slab++ % DT_SLABS];
+		bool busy = false;
+
+		if (atomic_compare_exchange_strong_acq_rel(&slab->busy, &busy,
+							   true))
+		{
+			return (slab);
+		}
+	}
+
+	return (NULL);
+}
+
+/*%
+ * Called by the fstrm I/O thread when it is done with a frame.
+ */
+static void
+free_dt(void *buf, void *arg) {
+	dt_slab_t *slab = arg;
+
+	if (slab != NULL) {
+		atomic_store_release(&slab->busy, false);
+	} else {
+		free(buf);
+	}
+}
+
 static isc_result_t
-pack_dt(const Dnstap__Dnstap *d, void **buf, size_t *sz) {
-	ProtobufCBufferSimple sbuf;
+pack_dt(dns_dtenv_t *env, const Dnstap__Dnstap *d, void **buf, size_t *sz,
+	dt_slab_t **slabp) {
+	dt_slab_t *slab = NULL;
+	size_t size;
 
 	REQUIRE(d != NULL);
 	REQUIRE(sz != NULL);
 
-	memset(&sbuf, 0, sizeof(sbuf));
-	sbuf.base.append = protobuf_c_buffer_simple_append;
-	sbuf.len = 0;
-	sbuf.alloced = DNSTAP_INITIAL_BUF_SIZE;
-
-	/* Need to use malloc() here because protobuf uses free() */
-	sbuf.data = malloc(sbuf.alloced);
-	if (sbuf.data == NULL) {
-		return (ISC_R_NOMEMORY);
+	size = dnstap__dnstap__get_packed_size(d);
+	if (size <= DT_SLABSIZE) {
+		slab = get_slab(env);
 	}
-	sbuf.must_free_data = 1;
-
-	*sz = dnstap__dnstap__pack_to_buffer(d, (ProtobufCBuffer *)&sbuf);
-	if (sbuf.data == NULL) {
-		return (ISC_R_FAILURE);
+	if (slab != NULL) {
+		*buf = slab->data;
+	} else {
+		/* Need to use malloc() here because fstrm uses free() */
+		*buf = malloc(size);
+		if (*buf == NULL) {
+			return (ISC_R_NOMEMORY);
+		}
 	}
-	*buf = sbuf.data;
+
+	*sz = dnstap__dnstap__pack(d, *buf);
+	*slabp = slab;
 
 	return (ISC_R_SUCCESS);
 }
 
 static void
-send_dt(dns_dtenv_t *env, void *buf, size_t len) {
+send_dt(dns_dtenv_t *env, void *buf, size_t len, dt_slab_t *slab) {
 	struct fstrm_iothr_queue *ioq;
 	fstrm_res res;
 
@@ -562,17 +623,16 @@ send_dt(dns_dtenv_t *env, void *buf, size_t len) {
 
 	ioq = dt_queue(env);
 	if (ioq == NULL) {
-		free(buf);
+		free_dt(buf, slab);
 		return;
 	}
 
-	res = fstrm_iothr_submit(env->iothr, ioq, buf, len, fstrm_free_wrapper,
-				 NULL);
+	res = fstrm_iothr_submit(env->iothr, ioq, buf, len, free_dt, slab);
 	if (res != fstrm_res_success) {
 		if (env->stats != NULL) {
 			isc_stats_increment(env->stats, dns_dnstapcounter_drop);
 		}
-		free(buf);
+		free_dt(buf, slab);
 	} else {
 		if (env->stats != NULL) {
 			isc_stats_increment(env->stats,
@@ -680,6 +740,62 @@ setaddr(dns_dtmsg_t *dm, isc_sockaddr_t *sa, bool tcp,
 	*has_port = 1;
 }
 
+/*%
+ * Decide whether the transaction of the message in 'buf' is logged in
+ * 'view'.  Sampling is done on the message ID and the port of the
+ * query address, which are the same for a query and its response, so
+ * that either both or neither are logged.
+ */
+static bool
+sample(dns_view_t *view, isc_sockaddr_t *qaddr, isc_buffer_t *buf) {
+	unsigned char *msg = isc_buffer_base(buf);
+	unsigned int len = isc_buffer_usedlength(buf);
+
+	if (len < DNS_MESSAGE_HEADERLEN) {
+		return (view->dtsample == 1 && view->dtqtypes == NULL);
+	}
+
+	if (view->dtqtypes != NULL) {
+		dns_rdatatype_t qtype;
+		unsigned int i = DNS_MESSAGE_HEADERLEN;
+
+		/* Skip the question name. */
+		while (i < len && msg[i] != 0 && (msg[i] & 0xc0) == 0) {
+			i += msg[i] + 1;
+		}
+		if (i < len && (msg[i] & 0xc0) == 0xc0) {
+			i++;
+		}
+		if (i + 3 > len) {
+			return (false);
+		}
+		qtype = (msg[i + 1] << 8) | msg[i + 2];
+
+		for (i = 0; i < view->dtnqtypes; i++) {
+			if (view->dtqtypes[i] == qtype) {
+				break;
+			}
+		}
+		if (i == view->dtnqtypes) {
+			return (false);
+		}
+	}
+
+	if (view->dtsample > 1) {
+		uint32_t key = (msg[0] << 24) | (msg[1] << 16);
+
+		if (qaddr != NULL) {
+			key |= isc_sockaddr_getport(qaddr);
+		}
+		if (isc_hash32(&key, sizeof(key), true) % view->dtsample != 0)
+		{
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
 /*%
  * Invoke dns_dt_reopen() and re-allow dnstap output file rolling.  This
  * function is run in the context of the task stored in the 'reopen_task' field
@@ -768,6 +884,7 @@ dns_dt_send(dns_view_t *view, dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
 	    isc_time_t *qtime, isc_time_t *rtime, isc_buffer_t *buf) {
 	isc_time_t now, *t;
 	dns_dtmsg_t dm;
+	dt_slab_t *slab = NULL;
 
 	REQUIRE(DNS_VIEW_VALID(view));
 
@@ -779,6 +896,12 @@ dns_dt_send(dns_view_t *view, dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
 		return;
 	}
 
+	if ((view->dtsample > 1 || view->dtqtypes != NULL) &&
+	    !sample(view, qaddr, buf))
+	{
+		return;
+	}
+
 	REQUIRE(VALID_DTENV(view->dtenv));
 
 	if (view->dtenv->max_size != 0) {
@@ -875,8 +998,10 @@ dns_dt_send(dns_view_t *view, dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
 			&dm.m.has_response_port);
 	}
 
-	if (pack_dt(&dm.d, &dm.buf, &dm.len) == ISC_R_SUCCESS) {
-		send_dt(view->dtenv, dm.buf, dm.len);
+	if (pack_dt(view->dtenv, &dm.d, &dm.buf, &dm.len, &slab) ==
+	    ISC_R_SUCCESS)
+	{
+		send_dt(view->dtenv, dm.buf, dm.len, slab);
 	}
 }
 
@@ -29,6 +29,7 @@
 
 /*! \file */
 
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
@@ -40,8 +41,11 @@
 #include <isc/buffer.h>
 #include <isc/dir.h>
 #include <isc/file.h>
+#include <isc/hash.h>
+#include <isc/ht.h>
 #include <isc/lex.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/once.h>
 #include <isc/os.h>
 #include <isc/print.h>
@@ -142,6 +146,48 @@ static dst_func_t *dst_t_func[DST_MAX_ALGS];
 
 static bool dst_initialized = false;
 
+/*
+ * Public keys returned by dst_key_fromdns_cached() are shared,
+ * process-wide, by owner name, class and DNSKEY rdata, so that keys
+ * used over and over (such as those of the root and the TLDs) are only
+ * parsed once.  The table has KEYCACHE_SETS sets of KEYCACHE_WAYS
+ * entries each, kept in least recently used order.
+ */
+#define KEYCACHE_SETS  1024
+#define KEYCACHE_WAYS  4
+#define KEYCACHE_LOCKS 64 /* must divide KEYCACHE_SETS */
+
+typedef struct keycache {
+	dst_key_t *key;
+	uint32_t hashval;
+	unsigned int length;
+	unsigned char *data;
+} keycache_t;
+
+static keycache_t keycache_table[KEYCACHE_SETS][KEYCACHE_WAYS];
+static isc_mutex_t keycache_locks[KEYCACHE_LOCKS];
+static isc_mem_t *keycache_mctx = NULL;
+
+/*
+ * Listings of key directories, so that finding the private key files
+ * of one zone does not mean reading the whole directory again.  Each
+ * listing maps the lower-cased name in the "K<name>+<alg>+<id>.private"
+ * files to a buffer of their NUL-terminated file names, and is read
+ * again when the directory's modification time changes.
+ */
+#define PRIVATE_SUFFIX_LEN 18 /* "+<alg>+<id>.private" */
+
+typedef struct keydir keydir_t;
+struct keydir {
+	char *path;
+	isc_time_t modtime;
+	isc_ht_t *names;
+	ISC_LINK(keydir_t) link;
+};
+
+static ISC_LIST(keydir_t) keydirs;
+static isc_mutex_t keydirs_lock;
+
 void
 gss_log(int level, const char *fmt, ...) ISC_FORMAT_PRINTF(2, 3);
 
@@ -169,6 +215,14 @@ frombuffer(const dns_name_t *name, unsigned int alg, unsigned int flags,
 static isc_result_t
 algorithm_status(unsigned int alg);
 
+static void
+keycache_init(isc_mem_t *mctx);
+static void
+keycache_destroy(void);
+
+static void
+keydirs_destroy(void);
+
 static isc_result_t
 addsuffix(char *filename, int len, const char *dirname, const char *ofilename,
 	  const char *suffix);
@@ -198,6 +252,9 @@ dst_lib_init(isc_mem_t *mctx, const char *engine) {
 	UNUSED(engine);
 
 	memset(dst_t_func, 0, sizeof(dst_t_func));
+	keycache_init(mctx);
+	ISC_LIST_INIT(keydirs);
+	isc_mutex_init(&keydirs_lock);
 	RETERR(dst__hmacmd5_init(&dst_t_func[DST_ALG_HMACMD5]));
 	RETERR(dst__hmacsha1_init(&dst_t_func[DST_ALG_HMACSHA1]));
 	RETERR(dst__hmacsha224_init(&dst_t_func[DST_ALG_HMACSHA224]));
@@ -241,6 +298,8 @@ void
 dst_lib_destroy(void) {
 	int i;
 	RUNTIME_CHECK(dst_initialized);
+	keydirs_destroy();
+	keycache_destroy();
 	dst_initialized = false;
 
 	for (i = 0; i < DST_MAX_ALGS; i++) {
@@ -794,6 +853,100 @@ dst_key_fromdns(const dns_name_t *name, dns_rdataclass_t rdclass,
 	return (ISC_R_SUCCESS);
 }
 
+static int
+keycache_find(keycache_t *set, uint32_t hashval, const dns_name_t *name,
+	      dns_rdataclass_t rdclass, const isc_region_t *r) {
+	for (int i = 0; i < KEYCACHE_WAYS; i++) {
+		if (set[i].key != NULL && set[i].hashval == hashval &&
+		    set[i].length == r->length &&
+		    set[i].key->key_class == rdclass &&
+		    memcmp(set[i].data, r->base, r->length) == 0 &&
+		    dns_name_caseequal(set[i].key->key_name, name))
+		{
+			return (i);
+		}
+	}
+
+	return (-1);
+}
+
+/*
+ * Move entry 'i' of 'set' to the front and take a reference to its key.
+ */
+static void
+keycache_use(keycache_t *set, int i, dst_key_t **keyp) {
+	keycache_t entry = set[i];
+
+	memmove(&set[1], &set[0], i * sizeof(set[0]));
+	set[0] = entry;
+	dst_key_attach(entry.key, keyp);
+}
+
+isc_result_t
+dst_key_fromdns_cached(const dns_name_t *name, dns_rdataclass_t rdclass,
+		       isc_buffer_t *source, dst_key_t **keyp) {
+	isc_result_t result;
+	isc_region_t r;
+	uint32_t hashval;
+	keycache_t *set;
+	isc_mutex_t *lock;
+	keycache_t evicted = { .key = NULL };
+	dst_key_t *key = NULL;
+	int i;
+
+	REQUIRE(dst_initialized);
+	REQUIRE(keyp != NULL && *keyp == NULL);
+
+	isc_buffer_remainingregion(source, &r);
+	hashval = dns_name_hash(name, true) ^
+		  isc_hash32(r.base, r.length, true);
+	set = keycache_table[hashval % KEYCACHE_SETS];
+	lock = &keycache_locks[hashval % KEYCACHE_LOCKS];
+
+	LOCK(lock);
+	i = keycache_find(set, hashval, name, rdclass, &r);
+	if (i >= 0) {
+		keycache_use(set, i, keyp);
+		UNLOCK(lock);
+		isc_buffer_forward(source, r.length);
+		return (ISC_R_SUCCESS);
+	}
+	UNLOCK(lock);
+
+	result = dst_key_fromdns(name, rdclass, source, keycache_mctx, &key);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	LOCK(lock);
+	i = keycache_find(set, hashval, name, rdclass, &r);
+	if (i >= 0) {
+		/* Someone else parsed the same key in the meantime. */
+		keycache_use(set, i, keyp);
+		UNLOCK(lock);
+		dst_key_free(&key);
+		return (ISC_R_SUCCESS);
+	}
+	evicted = set[KEYCACHE_WAYS - 1];
+	memmove(&set[1], &set[0], (KEYCACHE_WAYS - 1) * sizeof(set[0]));
+	set[0] = (keycache_t){
+		.key = key,
+		.hashval = hashval,
+		.length = r.length,
+		.data = isc_mem_get(keycache_mctx, r.length),
+	};
+	memmove(set[0].data, r.base, r.length);
+	dst_key_attach(key, keyp);
+	UNLOCK(lock);
+
+	if (evicted.key != NULL) {
+		isc_mem_put(keycache_mctx, evicted.data, evicted.length);
+		dst_key_free(&evicted.key);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 dst_key_frombuffer(const dns_name_t *name, unsigned int alg, unsigned int flags,
 		   unsigned int protocol, dns_rdataclass_t rdclass,
@@ -2387,6 +2540,241 @@ frombuffer(const dns_name_t *name, unsigned int alg, unsigned int flags,
 	return (ISC_R_SUCCESS);
 }
 
+static void
+keycache_init(isc_mem_t *mctx) {
+	memset(keycache_table, 0, sizeof(keycache_table));
+	for (size_t i = 0; i < KEYCACHE_LOCKS; i++) {
+		isc_mutex_init(&keycache_locks[i]);
+	}
+	isc_mem_attach(mctx, &keycache_mctx);
+}
+
+static void
+keycache_destroy(void) {
+	if (keycache_mctx == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < KEYCACHE_SETS; i++) {
+		for (size_t j = 0; j < KEYCACHE_WAYS; j++) {
+			keycache_t *entry = &keycache_table[i][j];
+			if (entry->key != NULL) {
+				isc_mem_put(keycache_mctx, entry->data,
+					    entry->length);
+				dst_key_free(&entry->key);
+			}
+		}
+	}
+	for (size_t i = 0; i < KEYCACHE_LOCKS; i++) {
+		isc_mutex_destroy(&keycache_locks[i]);
+	}
+	isc_mem_detach(&keycache_mctx);
+}
+
+/*
+ * If 'file' is named "K<name>+<alg>+<id>.private", return the length
+ * of <name>.
+ */
+static size_t
+privatefile_namelen(const char *file, size_t length) {
+	const char *suffix = NULL;
+
+	if (length <= 1 + PRIVATE_SUFFIX_LEN || file[0] != 'K') {
+		return (0);
+	}
+
+	suffix = file + length - PRIVATE_SUFFIX_LEN;
+	if (suffix[0] != '+' || suffix[4] != '+' ||
+	    strcmp(suffix + 10, ".private") != 0)
+	{
+		return (0);
+	}
+	for (size_t i = 1; i < 10; i++) {
+		if (i != 4 && !isdigit((unsigned char)suffix[i])) {
+			return (0);
+		}
+	}
+
+	return (length - 1 - PRIVATE_SUFFIX_LEN);
+}
+
+static void
+keydir_free(keydir_t **kdp) {
+	keydir_t *kd = *kdp;
+	isc_ht_iter_t *it = NULL;
+	isc_result_t result;
+
+	*kdp = NULL;
+
+	isc_ht_iter_create(kd->names, &it);
+	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_delcurrent_next(it))
+	{
+		isc_buffer_t *files = NULL;
+
+		isc_ht_iter_current(it, (void **)&files);
+		isc_buffer_free(&files);
+	}
+	isc_ht_iter_destroy(&it);
+	isc_ht_destroy(&kd->names);
+
+	isc_mem_free(keycache_mctx, kd->path);
+	isc_mem_put(keycache_mctx, kd, sizeof(*kd));
+}
+
+static isc_result_t
+keydir_read(const char *path, keydir_t **kdp) {
+	keydir_t *kd = NULL;
+	isc_dir_t dir;
+	isc_result_t result;
+
+	isc_dir_init(&dir);
+	result = isc_dir_open(&dir, path);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	kd = isc_mem_get(keycache_mctx, sizeof(*kd));
+	*kd = (keydir_t){ .path = isc_mem_strdup(keycache_mctx, path) };
+	ISC_LINK_INIT(kd, link);
+	isc_ht_init(&kd->names, keycache_mctx, 6, ISC_HT_CASE_SENSITIVE);
+
+	while (isc_dir_read(&dir) == ISC_R_SUCCESS) {
+		unsigned char name[NAME_MAX];
+		isc_buffer_t *files = NULL;
+		size_t len = privatefile_namelen(dir.entry.name,
+						 dir.entry.length);
+
+		if (len == 0) {
+			continue;
+		}
+		for (size_t i = 0; i < len; i++) {
+			name[i] = tolower((unsigned char)dir.entry.name[i + 1]);
+		}
+
+		if (isc_ht_find(kd->names, name, len, (void **)&files) !=
+		    ISC_R_SUCCESS)
+		{
+			isc_buffer_allocate(keycache_mctx, &files,
+					    dir.entry.length + 1);
+			isc_buffer_setautorealloc(files, true);
+			result = isc_ht_add(kd->names, name, len, files);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		}
+		isc_buffer_putmem(files, (unsigned char *)dir.entry.name,
+				  dir.entry.length + 1);
+	}
+	isc_dir_close(&dir);
+
+	*kdp = kd;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+keydirs_destroy(void) {
+	keydir_t *kd = NULL;
+
+	while ((kd = ISC_LIST_HEAD(keydirs)) != NULL) {
+		ISC_LIST_UNLINK(keydirs, kd, link);
+		keydir_free(&kd);
+	}
+	isc_mutex_destroy(&keydirs_lock);
+}
+
+isc_result_t
+dst_key_privatefiles(const char *directory, const char *name,
+		     isc_mem_t *mctx, isc_buffer_t **filesp) {
+	char path[PATH_MAX];
+	unsigned char key[NAME_MAX];
+	size_t len = strlen(name);
+	isc_time_t now, modtime;
+	keydir_t *kd = NULL;
+	isc_buffer_t *files = NULL;
+	isc_region_t r;
+	bool keep = true;
+	isc_result_t result;
+
+	REQUIRE(dst_initialized);
+	REQUIRE(directory != NULL);
+	REQUIRE(name != NULL);
+	REQUIRE(filesp != NULL && *filesp == NULL);
+
+	if (len == 0 || len > sizeof(key)) {
+		return (ISC_R_NOTFOUND);
+	}
+	for (size_t i = 0; i < len; i++) {
+		key[i] = tolower((unsigned char)name[i]);
+	}
+
+	/*
+	 * A relative directory is kept under its absolute path, as the
+	 * working directory may change.
+	 */
+	if (isc_file_isabsolute(directory)) {
+		if (strlcpy(path, directory, sizeof(path)) >= sizeof(path)) {
+			return (ISC_R_NOSPACE);
+		}
+	} else {
+		result = isc_file_absolutepath(directory, path, sizeof(path));
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	isc_time_now(&now);
+	result = isc_file_getmodtime(path, &modtime);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	LOCK(&keydirs_lock);
+	for (kd = ISC_LIST_HEAD(keydirs); kd != NULL;
+	     kd = ISC_LIST_NEXT(kd, link))
+	{
+		if (strcmp(kd->path, path) == 0) {
+			break;
+		}
+	}
+	if (kd != NULL && isc_time_compare(&kd->modtime, &modtime) != 0) {
+		ISC_LIST_UNLINK(keydirs, kd, link);
+		keydir_free(&kd);
+	}
+	if (kd == NULL) {
+		result = keydir_read(path, &kd);
+		if (result != ISC_R_SUCCESS) {
+			goto unlock;
+		}
+		kd->modtime = modtime;
+
+		/*
+		 * A file added in the same timestamp tick as the last
+		 * change we saw would not change the modification time,
+		 * so a listing of a directory changed in the last second
+		 * is only used once.
+		 */
+		keep = isc_time_seconds(&modtime) + 1 < isc_time_seconds(&now);
+		if (keep) {
+			ISC_LIST_APPEND(keydirs, kd, link);
+		}
+	}
+
+	result = isc_ht_find(kd->names, key, len, (void **)&files);
+	if (result == ISC_R_SUCCESS) {
+		isc_buffer_usedregion(files, &r);
+		isc_buffer_allocate(mctx, filesp, r.length);
+		isc_buffer_putmem(*filesp, r.base, r.length);
+	} else {
+		result = ISC_R_NOTFOUND;
+	}
+
+	if (!keep) {
+		keydir_free(&kd);
+	}
+
+unlock:
+	UNLOCK(&keydirs_lock);
+	return (result);
+}
+
 static isc_result_t
 algorithm_status(unsigned int alg) {
 	REQUIRE(dst_initialized);
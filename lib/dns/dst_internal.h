@@ -38,6 +38,7 @@
 #include <openssl/objects.h>
 #include <openssl/rsa.h>
 
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/hmac.h>
 #include <isc/lang.h>
@@ -101,6 +102,8 @@ struct dst_key {
 		EVP_PKEY *pkey;
 		dst_hmac_key_t *hmac_key;
 	} keydata; /*%< pointer to key in crypto pkg fmt */
+	atomic_uintptr_t verifyctx; /*%< initialized verify context
+				     *   (EVP_MD_CTX), copied per use */
 
 	isc_stdtime_t times[DST_MAX_TIMES + 1]; /*%< timing metadata */
 	bool timeset[DST_MAX_TIMES + 1];	/*%< data set? */
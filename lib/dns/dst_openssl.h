@@ -24,6 +24,8 @@
 #include <isc/log.h>
 #include <isc/result.h>
 
+#include <dst/dst.h>
+
 #if !HAVE_BN_GENCB_NEW
 /*
  * These are new in OpenSSL 1.1.0.  BN_GENCB _cb needs to be declared in
@@ -59,6 +61,24 @@ isc_result_t
 dst__openssl_toresult3(isc_logcategory_t *category, const char *funcname,
 		       isc_result_t fallback);
 
+int
+dst__openssl_verifyinit(dst_key_t *key, const EVP_MD *type,
+			EVP_MD_CTX *evp_md_ctx);
+/*%<
+ * Initialize 'evp_md_ctx' to verify signatures made with 'key' and
+ * digest 'type' (which may be NULL for one-shot algorithms such as
+ * EdDSA).  The first call for a key remembers the initialized context
+ * in the key, and later calls copy that instead of setting up the
+ * OpenSSL key context from scratch.  Returns the OpenSSL status of the
+ * underlying EVP_DigestVerifyInit().
+ */
+
+void
+dst__openssl_verifyfree(dst_key_t *key);
+/*%<
+ * Release the verify context remembered by dst__openssl_verifyinit().
+ */
+
 #if !defined(OPENSSL_NO_ENGINE) && OPENSSL_API_LEVEL < 30000
 ENGINE *
 dst__openssl_getengine(const char *engine);
@@ -0,0 +1,567 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/ascii.h>
+#include <isc/ht.h>
+#include <isc/mem.h>
+#include <isc/refcount.h>
+#include <isc/result.h>
+#include <isc/rwlock.h>
+#include <isc/util.h>
+
+#include <dns/ecs.h>
+#include <dns/ecscache.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#define ECSCACHE_MAGIC	  ISC_MAGIC('E', 'C', 'S', 'c')
+#define VALID_ECSCACHE(c) ISC_MAGIC_VALID(c, ECSCACHE_MAGIC)
+
+#define ECSENTRY_MAGIC	  ISC_MAGIC('E', 'C', 'S', 'e')
+#define VALID_ECSENTRY(e) ISC_MAGIC_VALID(e, ECSENTRY_MAGIC)
+
+/*%
+ * Keys are the family, the scope prefix length, the address bytes
+ * covered by the scope, the type and the owner name in lower case.
+ */
+#define ECSCACHE_KEYSIZE (2 + 16 + 2 + DNS_NAME_MAXWIRE)
+
+/*%
+ * Largest rdataset we store, counting rdata only.
+ */
+#define ECSCACHE_MAXDATA 65535
+
+typedef struct ecsentry ecsentry_t;
+
+struct ecsentry {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	size_t size;
+	isc_stdtime_t expire;
+	unsigned int family;
+	unsigned int scope;
+	dns_rdatalist_t rdatalist;
+	unsigned char *key;
+	unsigned int keylen;
+	/* Followed by the rdata structures, the key and the rdata. */
+};
+
+struct dns_ecscache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_rwlock_t rwlock;
+	/* Locked by rwlock. */
+	isc_ht_t *table;
+	/*
+	 * Number of entries for each scope prefix length, so that
+	 * lookups only probe the lengths in use.
+	 */
+	unsigned int count4[33];
+	unsigned int count6[129];
+};
+
+static void
+ecsentry_disassociate(dns_rdataset_t *rdataset);
+static isc_result_t
+ecsentry_first(dns_rdataset_t *rdataset);
+static isc_result_t
+ecsentry_next(dns_rdataset_t *rdataset);
+static void
+ecsentry_current(dns_rdataset_t *rdataset, dns_rdata_t *rdata);
+static void
+ecsentry_clone(dns_rdataset_t *source, dns_rdataset_t *target);
+static unsigned int
+ecsentry_count(dns_rdataset_t *rdataset);
+
+static dns_rdatasetmethods_t methods = {
+	ecsentry_disassociate,
+	ecsentry_first,
+	ecsentry_next,
+	ecsentry_current,
+	ecsentry_clone,
+	ecsentry_count,
+	NULL, /* addnoqname */
+	NULL, /* getnoqname */
+	NULL, /* addclosest */
+	NULL, /* getclosest */
+	NULL, /* settrust */
+	NULL, /* expire */
+	NULL, /* clearprefetch */
+	NULL, /* setownercase */
+	NULL, /* getownercase */
+	NULL  /* addglue */
+};
+
+static void
+ecsentry_detach(ecsentry_t **entryp) {
+	ecsentry_t *entry = *entryp;
+
+	*entryp = NULL;
+
+	REQUIRE(VALID_ECSENTRY(entry));
+
+	if (isc_refcount_decrement(&entry->references) == 1) {
+		isc_refcount_destroy(&entry->references);
+		entry->magic = 0;
+		isc_mem_putanddetach(&entry->mctx, entry, entry->size);
+	}
+}
+
+/*
+ * Build the key for 'name' and 'type' in the subnet of 'addr' (or of
+ * no address when 'addr' is NULL) with prefix length 'scope'.
+ */
+static unsigned int
+make_key(unsigned char *key, const dns_name_t *name, dns_rdatatype_t type,
+	 const isc_netaddr_t *addr, unsigned int scope) {
+	unsigned int len = 0;
+
+	if (addr == NULL || scope == 0) {
+		key[len++] = 0;
+		key[len++] = 0;
+	} else {
+		const unsigned char *bytes = (const unsigned char *)&addr->type;
+		unsigned int nbytes = (scope + 7) / 8;
+
+		key[len++] = (addr->family == AF_INET) ? 4 : 6;
+		key[len++] = scope;
+		memmove(key + len, bytes, nbytes);
+		if (scope % 8 != 0) {
+			key[len + nbytes - 1] &= 0xff << (8 - scope % 8);
+		}
+		len += nbytes;
+	}
+
+	key[len++] = type >> 8;
+	key[len++] = type & 0xff;
+
+	isc_ascii_lowercopy(key + len, name->ndata, name->length);
+	len += name->length;
+
+	INSIST(len <= ECSCACHE_KEYSIZE);
+	return (len);
+}
+
+static unsigned int *
+scope_count(dns_ecscache_t *cache, ecsentry_t *entry) {
+	switch (entry->family) {
+	case AF_INET:
+		return (&cache->count4[entry->scope]);
+	case AF_INET6:
+		return (&cache->count6[entry->scope]);
+	default:
+		return (NULL);
+	}
+}
+
+/*
+ * Remove 'entry' from the table.  Caller holds the write lock.
+ */
+static void
+remove_entry(dns_ecscache_t *cache, ecsentry_t *entry) {
+	unsigned int *count = scope_count(cache, entry);
+	isc_result_t result;
+
+	result = isc_ht_delete(cache->table, entry->key, entry->keylen);
+	INSIST(result == ISC_R_SUCCESS);
+	if (count != NULL) {
+		INSIST(*count > 0);
+		(*count)--;
+	}
+	ecsentry_detach(&entry);
+}
+
+void
+dns_ecscache_create(isc_mem_t *mctx, dns_ecscache_t **cachep) {
+	dns_ecscache_t *cache = NULL;
+
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (dns_ecscache_t){ .magic = ECSCACHE_MAGIC };
+
+	isc_mem_attach(mctx, &cache->mctx);
+	isc_rwlock_init(&cache->rwlock, 0, 0);
+	isc_ht_init(&cache->table, mctx, 8, ISC_HT_CASE_SENSITIVE);
+
+	*cachep = cache;
+}
+
+void
+dns_ecscache_destroy(dns_ecscache_t **cachep) {
+	dns_ecscache_t *cache = NULL;
+	isc_ht_iter_t *it = NULL;
+	isc_result_t result;
+
+	REQUIRE(cachep != NULL && VALID_ECSCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+	cache->magic = 0;
+
+	isc_ht_iter_create(cache->table, &it);
+	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_delcurrent_next(it))
+	{
+		ecsentry_t *entry = NULL;
+
+		isc_ht_iter_current(it, (void **)&entry);
+		ecsentry_detach(&entry);
+	}
+	isc_ht_iter_destroy(&it);
+
+	isc_ht_destroy(&cache->table);
+	isc_rwlock_destroy(&cache->rwlock);
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+isc_result_t
+dns_ecscache_add(dns_ecscache_t *cache, const dns_name_t *name,
+		 const dns_ecs_t *ecs, dns_rdataset_t *rdataset,
+		 isc_stdtime_t now) {
+	unsigned char key[ECSCACHE_KEYSIZE];
+	unsigned int keylen, scope, nrdata = 0;
+	size_t datalen = 0, size;
+	ecsentry_t *entry = NULL, *old = NULL;
+	dns_rdata_t *rdatas = NULL;
+	unsigned char *data = NULL;
+	unsigned int *count = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_ECSCACHE(cache));
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(ecs != NULL);
+	REQUIRE(ecs->addr.family == AF_INET || ecs->addr.family == AF_INET6);
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(dns_rdataset_isassociated(rdataset));
+
+	if (rdataset->ttl == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	scope = ISC_MIN(ecs->scope, ecs->source);
+	REQUIRE(scope <= ((ecs->addr.family == AF_INET) ? 32 : 128));
+
+	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+
+		dns_rdataset_current(rdataset, &rdata);
+		datalen += rdata.length;
+		nrdata++;
+	}
+	if (datalen > ECSCACHE_MAXDATA) {
+		return (ISC_R_NOSPACE);
+	}
+
+	keylen = make_key(key, name, rdataset->type, &ecs->addr, scope);
+
+	size = sizeof(*entry) + nrdata * sizeof(dns_rdata_t) + keylen + datalen;
+	entry = isc_mem_get(cache->mctx, size);
+	*entry = (ecsentry_t){
+		.magic = ECSENTRY_MAGIC,
+		.size = size,
+		.expire = now + rdataset->ttl,
+		.family = (scope == 0) ? 0 : ecs->addr.family,
+		.scope = scope,
+		.keylen = keylen,
+	};
+	isc_mem_attach(cache->mctx, &entry->mctx);
+	isc_refcount_init(&entry->references, 1);
+
+	rdatas = (dns_rdata_t *)(entry + 1);
+	entry->key = (unsigned char *)(rdatas + nrdata);
+	memmove(entry->key, key, keylen);
+	data = entry->key + keylen;
+
+	dns_rdatalist_init(&entry->rdatalist);
+	entry->rdatalist.rdclass = rdataset->rdclass;
+	entry->rdatalist.type = rdataset->type;
+	entry->rdatalist.covers = rdataset->covers;
+	entry->rdatalist.ttl = rdataset->ttl;
+
+	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		isc_region_t region;
+
+		dns_rdataset_current(rdataset, &rdata);
+		dns_rdata_toregion(&rdata, &region);
+		memmove(data, region.base, region.length);
+		region.base = data;
+		data += region.length;
+
+		dns_rdata_init(rdatas);
+		dns_rdata_fromregion(rdatas, rdata.rdclass, rdata.type,
+				     &region);
+		ISC_LIST_APPEND(entry->rdatalist.rdata, rdatas, link);
+		rdatas++;
+	}
+
+	RWLOCK(&cache->rwlock, isc_rwlocktype_write);
+	result = isc_ht_find(cache->table, key, keylen, (void **)&old);
+	if (result == ISC_R_SUCCESS) {
+		remove_entry(cache, old);
+	}
+	result = isc_ht_add(cache->table, key, keylen, entry);
+	INSIST(result == ISC_R_SUCCESS);
+	count = scope_count(cache, entry);
+	if (count != NULL) {
+		(*count)++;
+	}
+	RWUNLOCK(&cache->rwlock, isc_rwlocktype_write);
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_ecscache_find(dns_ecscache_t *cache, const dns_name_t *name,
+		  dns_rdatatype_t type, const isc_netaddr_t *client,
+		  isc_stdtime_t now, dns_rdataset_t *rdataset,
+		  unsigned int *scopep) {
+	unsigned char key[ECSCACHE_KEYSIZE];
+	unsigned char stale[ECSCACHE_KEYSIZE];
+	unsigned int keylen, stalelen = 0;
+	unsigned int *counts = NULL;
+	int scope;
+	ecsentry_t *entry = NULL;
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	REQUIRE(VALID_ECSCACHE(cache));
+	REQUIRE(client != NULL);
+	REQUIRE(client->family == AF_INET || client->family == AF_INET6);
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(!dns_rdataset_isassociated(rdataset));
+
+	RWLOCK(&cache->rwlock, isc_rwlocktype_read);
+
+	/*
+	 * Probe from the longest scope in use down to scope 0, which is
+	 * stored without an address and applies to every client.
+	 */
+	if (client->family == AF_INET) {
+		counts = cache->count4;
+		scope = 32;
+	} else {
+		counts = cache->count6;
+		scope = 128;
+	}
+	for (; scope >= 0; scope--) {
+		ecsentry_t *found = NULL;
+
+		if (scope > 0 && counts[scope] == 0) {
+			continue;
+		}
+
+		keylen = make_key(key, name, type, client, scope);
+		if (isc_ht_find(cache->table, key, keylen, (void **)&found) !=
+		    ISC_R_SUCCESS)
+		{
+			continue;
+		}
+
+		if (found->expire <= now) {
+			if (stalelen == 0) {
+				memmove(stale, key, keylen);
+				stalelen = keylen;
+			}
+			continue;
+		}
+
+		entry = found;
+		isc_refcount_increment(&entry->references);
+		break;
+	}
+
+	RWUNLOCK(&cache->rwlock, isc_rwlocktype_read);
+
+	if (entry != NULL) {
+		rdataset->methods = &methods;
+		rdataset->rdclass = entry->rdatalist.rdclass;
+		rdataset->type = entry->rdatalist.type;
+		rdataset->covers = entry->rdatalist.covers;
+		rdataset->ttl = entry->expire - now;
+		rdataset->trust = dns_trust_answer;
+		rdataset->private1 = entry;
+		rdataset->private2 = NULL;
+		if (scopep != NULL) {
+			*scopep = entry->scope;
+		}
+		result = ISC_R_SUCCESS;
+	}
+
+	if (stalelen != 0) {
+		ecsentry_t *found = NULL;
+
+		RWLOCK(&cache->rwlock, isc_rwlocktype_write);
+		if (isc_ht_find(cache->table, stale, stalelen,
+				(void **)&found) == ISC_R_SUCCESS &&
+		    found->expire <= now)
+		{
+			remove_entry(cache, found);
+		}
+		RWUNLOCK(&cache->rwlock, isc_rwlocktype_write);
+	}
+
+	return (result);
+}
+
+void
+dns_ecscache_clean(dns_ecscache_t *cache, isc_stdtime_t now) {
+	isc_ht_iter_t *it = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_ECSCACHE(cache));
+
+	RWLOCK(&cache->rwlock, isc_rwlocktype_write);
+	isc_ht_iter_create(cache->table, &it);
+	result = isc_ht_iter_first(it);
+	while (result == ISC_R_SUCCESS) {
+		ecsentry_t *entry = NULL;
+		unsigned int *count = NULL;
+
+		isc_ht_iter_current(it, (void **)&entry);
+		if (entry->expire > now) {
+			result = isc_ht_iter_next(it);
+			continue;
+		}
+
+		count = scope_count(cache, entry);
+		if (count != NULL) {
+			INSIST(*count > 0);
+			(*count)--;
+		}
+		result = isc_ht_iter_delcurrent_next(it);
+		ecsentry_detach(&entry);
+	}
+	isc_ht_iter_destroy(&it);
+	RWUNLOCK(&cache->rwlock, isc_rwlocktype_write);
+}
+
+static void
+ecsentry_disassociate(dns_rdataset_t *rdataset) {
+	ecsentry_t *entry = NULL;
+
+	REQUIRE(rdataset != NULL);
+	REQUIRE(rdataset->methods == &methods);
+
+	rdataset->methods = NULL;
+	entry = rdataset->private1;
+	rdataset->private1 = NULL;
+
+	ecsentry_detach(&entry);
+}
+
+/*
+ * The rdata of an entry never change once it is in the table, so the
+ * iterators need no locking.
+ */
+static isc_result_t
+ecsentry_first(dns_rdataset_t *rdataset) {
+	ecsentry_t *entry = NULL;
+
+	REQUIRE(rdataset != NULL);
+	REQUIRE(rdataset->methods == &methods);
+
+	entry = rdataset->private1;
+	rdataset->private2 = ISC_LIST_HEAD(entry->rdatalist.rdata);
+
+	if (rdataset->private2 == NULL) {
+		return (ISC_R_NOMORE);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+ecsentry_next(dns_rdataset_t *rdataset) {
+	dns_rdata_t *rdata = NULL;
+
+	REQUIRE(rdataset != NULL);
+	REQUIRE(rdataset->methods == &methods);
+
+	rdata = rdataset->private2;
+	if (rdata == NULL) {
+		return (ISC_R_NOMORE);
+	}
+
+	rdataset->private2 = ISC_LIST_NEXT(rdata, link);
+
+	if (rdataset->private2 == NULL) {
+		return (ISC_R_NOMORE);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+ecsentry_current(dns_rdataset_t *rdataset, dns_rdata_t *rdata) {
+	dns_rdata_t *list_rdata = NULL;
+
+	REQUIRE(rdataset != NULL);
+	REQUIRE(rdataset->methods == &methods);
+
+	list_rdata = rdataset->private2;
+	INSIST(list_rdata != NULL);
+
+	dns_rdata_clone(list_rdata, rdata);
+}
+
+static void
+ecsentry_clone(dns_rdataset_t *source, dns_rdataset_t *target) {
+	ecsentry_t *entry = NULL;
+
+	REQUIRE(source != NULL);
+	REQUIRE(target != NULL);
+	REQUIRE(source->methods == &methods);
+
+	entry = source->private1;
+	isc_refcount_increment(&entry->references);
+
+	*target = *source;
+
+	/*
+	 * Reset iterator state.
+	 */
+	target->private2 = NULL;
+}
+
+static unsigned int
+ecsentry_count(dns_rdataset_t *rdataset) {
+	ecsentry_t *entry = NULL;
+	dns_rdata_t *rdata = NULL;
+	unsigned int count = 0;
+
+	REQUIRE(rdataset != NULL);
+	REQUIRE(rdataset->methods == &methods);
+
+	entry = rdataset->private1;
+	for (rdata = ISC_LIST_HEAD(entry->rdatalist.rdata); rdata != NULL;
+	     rdata = ISC_LIST_NEXT(rdata, link))
+	{
+		count++;
+	}
+
+	return (count);
+}
@@ -263,6 +263,46 @@ funname(const char *s, char *buf) {
 	return (buf);
 }
 
+/*
+ * The types that make up most of the rdata parsed and rendered by a
+ * server, in decreasing order of frequency.  Each switch tests for
+ * these first with direct comparisons, which are predicted far better
+ * than the indirect jump the full switch compiles to.  Class specific
+ * types are only fast-pathed for class IN.
+ */
+static const int hottypes[] = { 1 /* A */, 28 /* AAAA */, 46 /* RRSIG */,
+				2 /* NS */, 5 /* CNAME */ };
+
+static void
+dohottypes(const char *function, const char *args, const char *tsw,
+	   const char *csw, const char *result) {
+	struct tt *tt;
+	char buf1[TYPECLASSBUF], buf2[TYPECLASSBUF];
+
+	for (size_t i = 0; i < sizeof(hottypes) / sizeof(hottypes[0]); i++) {
+		for (tt = types; tt != NULL; tt = tt->next) {
+			if (tt->type != hottypes[i]) {
+				continue;
+			}
+			if (tt->rdclass == 0) {
+				printf("\tif (%s == %d) {%s %s_%s(%s); } else "
+				       "\\\n",
+				       tsw, tt->type, result, function,
+				       funname(tt->typebuf, buf1), args);
+				break;
+			}
+			if (tt->rdclass == 1) {
+				printf("\tif (%s == %d && %s == 1) {%s "
+				       "%s_%s_%s(%s); } else \\\n",
+				       tsw, tt->type, csw, result, function,
+				       funname(tt->classbuf, buf1),
+				       funname(tt->typebuf, buf2), args);
+				break;
+			}
+		}
+	}
+}
+
 static void
 doswitch(const char *name, const char *function, const char *args,
 	 const char *tsw, const char *csw, const char *res) {
@@ -280,6 +320,7 @@ doswitch(const char *name, const char *function, const char *args,
 	for (tt = types; tt != NULL; tt = tt->next) {
 		if (first) {
 			printf("\n#define %s \\\n", name);
+			dohottypes(function, args, tsw, csw, result);
 			printf("\tswitch (%s) { \\\n" /*}*/, tsw);
 			first = 0;
 		}
@@ -36,66 +36,75 @@
 #include <dns/log.h>
 
 /*
- * This structure preserves state from the previous GeoIP lookup,
- * so that successive lookups for the same data from the same IP
- * address will not require repeated database lookups.
- * This should improve performance somewhat.
+ * These structures preserve state from recent GeoIP lookups, so that
+ * successive lookups for the same data from the same IP address will
+ * not require repeated database lookups.
  *
- * For all lookups we preserve pointers to the MMDB_lookup_result_s
- * and MMDB_entry_s structures, a pointer to the database from which
- * the lookup was answered, and a copy of the request address.
+ * For each lookup we preserve the MMDB_lookup_result_s and
+ * MMDB_entry_s structures, a pointer to the database from which the
+ * lookup was answered, and a copy of the request address.  Addresses
+ * that are not in the database are remembered as well.
  *
- * If the next geoip ACL lookup is for the same database and from the
- * same address, we can reuse the MMDB entry without repeating the lookup.
- * This is for the case when a single query has to process multiple
- * geoip ACLs: for example, when there are multiple views with
- * match-clients statements that search for different countries.
+ * If a later geoip ACL lookup is for the same database and from the
+ * same address, we can reuse the MMDB entry without repeating the
+ * lookup.  This is for the case when a single query has to process
+ * multiple geoip ACLs: for example, when there are multiple views
+ * with match-clients statements that search for different countries,
+ * possibly in different databases.  Keeping several entries also
+ * helps when queries from a few busy clients are interleaved.
  *
- * (XXX: Currently the persistent state is stored in thread specific
- * memory, but it could more simply be stored in the client object.
- * Also multiple entries could be stored in case the ACLs require
- * searching in more than one GeoIP database.)
+ * The state is stored in thread specific memory, so no locking is
+ * needed; the least recently used entry is replaced on a miss.
  */
 
+#define GEOIP_STATE_SIZE 16
+
 typedef struct geoip_state {
 	uint16_t subtype;
 	const MMDB_s *db;
 	isc_netaddr_t addr;
+	bool found;
+	uint64_t used;
 	MMDB_lookup_result_s mmresult;
 	MMDB_entry_s entry;
 } geoip_state_t;
 
-static thread_local geoip_state_t geoip_state = { 0 };
-
-static void
-set_state(const MMDB_s *db, const isc_netaddr_t *addr,
-	  MMDB_lookup_result_s mmresult, MMDB_entry_s entry) {
-	geoip_state.db = db;
-	geoip_state.addr = *addr;
-	geoip_state.mmresult = mmresult;
-	geoip_state.entry = entry;
-}
+static thread_local geoip_state_t geoip_state[GEOIP_STATE_SIZE];
+static thread_local uint64_t geoip_clock = 0;
 
 static geoip_state_t *
 get_entry_for(MMDB_s *const db, const isc_netaddr_t *addr) {
 	isc_sockaddr_t sa;
 	MMDB_lookup_result_s match;
+	geoip_state_t *state = &geoip_state[0];
 	int err;
 
-	if (db == geoip_state.db && isc_netaddr_equal(addr, &geoip_state.addr))
-	{
-		return (&geoip_state);
+	for (size_t i = 0; i < GEOIP_STATE_SIZE; i++) {
+		geoip_state_t *s = &geoip_state[i];
+
+		if (s->db == db && isc_netaddr_equal(addr, &s->addr)) {
+			s->used = ++geoip_clock;
+			return (s->found ? s : NULL);
+		}
+		if (s->used < state->used) {
+			state = s;
+		}
 	}
 
 	isc_sockaddr_fromnetaddr(&sa, addr, 0);
 	match = MMDB_lookup_sockaddr(db, &sa.type.sa, &err);
-	if (err != MMDB_SUCCESS || !match.found_entry) {
+	if (err != MMDB_SUCCESS) {
 		return (NULL);
 	}
 
-	set_state(db, addr, match, match.entry);
+	state->db = db;
+	state->addr = *addr;
+	state->found = match.found_entry;
+	state->used = ++geoip_clock;
+	state->mmresult = match;
+	state->entry = match.entry;
 
-	return (&geoip_state);
+	return (state->found ? state : NULL);
 }
 
 static dns_geoip_subtype_t
@@ -334,4 +334,51 @@ dns_acl_merge_ports_transports(dns_acl_t *dest, dns_acl_t *source, bool pos);
  *\li		'source' is a valid ACL object.
  */
 
+isc_result_t
+dns_aclindex_create(isc_mem_t *mctx, dns_acl_t *const *acls,
+		    unsigned int nacls, dns_aclindex_t **indexp);
+/*%<
+ * Build an index over the 'nacls' ACLs in 'acls' that finds, in a single
+ * radix tree search, which of them match an address.  A NULL entry in
+ * 'acls' matches every address.  The ACLs are not referenced by the
+ * index and may change or be freed afterwards.
+ *
+ * Requires:
+ *\li	'acls' is not NULL, unless 'nacls' is zero.
+ *\li	'indexp' is not NULL and '*indexp' is NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_aclindex_destroy(dns_aclindex_t **indexp);
+/*%<
+ * Destroy an ACL index.
+ */
+
+const uint64_t *
+dns_aclindex_find(const dns_aclindex_t *index, const isc_netaddr_t *reqaddr,
+		  const dns_aclenv_t *env);
+/*%<
+ * Return a bitmap of (nacls + 63) / 64 words, in which bit (i % 64) of
+ * word (i / 64) is set if the i'th indexed ACL may match 'reqaddr'.
+ *
+ * For an ACL for which dns_aclindex_isexact() is true, the bit is set if
+ * and only if dns_acl_allowed() would allow 'reqaddr' with any signer.
+ * Other ACLs contain elements other than IP prefixes (such as key names,
+ * "localnets" or GeoIP) or port and transport restrictions; their bit
+ * is always set and the caller must evaluate them itself.
+ *
+ * 'env' is only used for its "match-mapped-addresses" setting.
+ */
+
+bool
+dns_aclindex_isexact(const dns_aclindex_t *index, unsigned int i);
+/*%<
+ * Return true if the result of dns_aclindex_find() for the i'th indexed
+ * ACL is final.
+ */
+
 ISC_LANG_ENDDECLS
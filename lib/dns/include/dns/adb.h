@@ -219,6 +219,7 @@ struct dns_adbaddrinfo {
 
 	isc_sockaddr_t sockaddr; /*%< [rw] */
 	unsigned int   srtt;	 /*%< [rw] microsecs */
+	unsigned int   rttvar;	 /*%< [rw] microsecs, mean deviation */
 
 	unsigned int	flags; /*%< [rw] */
 	dns_adbentry_t *entry; /*%< private */
@@ -530,7 +531,8 @@ void
 dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int rtt,
 		   unsigned int factor);
 /*%<
- * Mix the round trip time into the existing smoothed rtt.
+ * Mix the round trip time into the existing smoothed rtt, and its
+ * difference from that into the smoothed mean deviation ('rttvar').
  *
  * Requires:
  *
@@ -776,6 +778,51 @@ dns_adb_setquota(dns_adb_t *adb, uint32_t quota, uint32_t freq, double low,
  *\li	'adb' is valid.
  */
 
+void
+dns_adb_setstatefile(dns_adb_t *adb, const char *filename);
+/*%<
+ * Set the file that dns_adb_savestate() and dns_adb_loadstate() use to
+ * keep what the ADB has learned about servers (EDNS support, UDP size,
+ * cookie flags, smoothed RTT, and lameness) across restarts.  If
+ * 'filename' is NULL, the state is not saved or loaded.
+ *
+ * Requires:
+ *\li	'adb' is valid.
+ */
+
+isc_result_t
+dns_adb_savestate(dns_adb_t *adb);
+/*%<
+ * Write the state of every unexpired address entry to a temporary file
+ * that then replaces the state file.  Server cookies are not saved, as
+ * they may not be valid for the client cookie sent after a restart.
+ *
+ * Requires:
+ *\li	'adb' is valid.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS, including when no state file is set.
+ *\li	Errors writing or renaming the file.
+ */
+
+isc_result_t
+dns_adb_loadstate(dns_adb_t *adb);
+/*%<
+ * Create address entries from the state file for addresses not already
+ * known to 'adb'.  Restored entries expire like those created by
+ * dns_adb_findaddrinfo() unless they are used, and lameness that has
+ * expired since the file was written is ignored.  Loading stops at the
+ * first malformed line; entries read before it are kept.
+ *
+ * Requires:
+ *\li	'adb' is valid.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS, including when no state file is set.
+ *\li	#ISC_R_FILENOTFOUND
+ *\li	Other errors reading or parsing the file.
+ */
+
 bool
 dns_adbentry_overquota(dns_adbentry_t *entry);
 /*%<
@@ -52,6 +52,12 @@
 
 ISC_LANG_BEGINDECLS
 
+/*% Largest number of shards a cache database may be split into */
+#define DNS_CACHE_MAXSHARDS 64
+
+/*% Largest number of domains reported by dns_cache_settopdomains() */
+#define DNS_CACHE_MAXTOPDOMAINS 1000
+
 /***
  ***	Functions
  ***/
@@ -59,7 +65,8 @@ isc_result_t
 dns_cache_create(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 		 isc_timermgr_t *timermgr, dns_rdataclass_t rdclass,
 		 const char *cachename, const char *db_type,
-		 unsigned int db_argc, char **db_argv, dns_cache_t **cachep);
+		 unsigned int db_argc, char **db_argv, unsigned int nshards,
+		 dns_cache_t **cachep);
 /*%<
  * Create a new DNS cache.
  *
@@ -83,6 +90,11 @@ dns_cache_create(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
  *
  *\li	'cachename' is a valid string.  This must not be NULL.
  *
+ *\li	1 <= 'nshards' <= #DNS_CACHE_MAXSHARDS.  If 'nshards' is greater
+ *	than one and 'db_type' is "rbt", the cache database is made of
+ *	'nshards' databases that each have their own locks (see
+ *	lib/dns/sharddb.h).
+ *
  *\li	'cachep' is a valid pointer, and *cachep == NULL
  *
  * Ensures:
@@ -223,10 +235,112 @@ dns_cache_getservestalerefresh(dns_cache_t *cache);
  *\li	'cache' to be valid.
  */
 
+void
+dns_cache_setcachepolicy(dns_cache_t *cache, dns_cachepolicy_t policy);
+/*%<
+ * Sets the policy used to choose the entries purged when the cache runs
+ * out of memory (see dns_db_setcachepolicy()).  The policy is kept when
+ * the cache is flushed.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+void
+dns_cache_settopdomains(dns_cache_t *cache, unsigned int count);
+/*%<
+ * Sets the number of domains using the most memory that are reported
+ * with the cache statistics.  The memory used by the rdatasets added
+ * to the cache is accounted to their domain (see
+ * dns_db_setdomainusage()) while 'count' is not zero.  The setting is
+ * kept when the cache is flushed.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+isc_result_t
+dns_cache_setdumpfile(dns_cache_t *cache, const char *filename,
+		      uint32_t interval);
+/*%<
+ * Sets the file the cache is dumped to every 'interval' seconds, in the
+ * "raw" format with the absolute expiry time and trust level of every
+ * RRset (see #DNS_MASTERRAW_CACHE), so that it can be loaded with
+ * dns_cache_load() after a restart.  Each dump is written in the
+ * background by a task of the cache, a few names at a time, to a
+ * temporary file that then replaces 'filename'.  No dump is started
+ * while the cache is still being loaded.
+ *
+ * If 'filename' is NULL or 'interval' is zero, the cache is not dumped.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED if 'filename' is not NULL and the cache was
+ *	created without a task manager and a timer manager.
+ */
+
+isc_result_t
+dns_cache_load(dns_cache_t *cache, const char *filename);
+/*%<
+ * Starts loading a cache dump written as set by dns_cache_setdumpfile()
+ * into 'cache'.  The file is loaded in the background by a task of the
+ * cache while the cache is in use.  RRsets that have expired since
+ * they were dumped are discarded, and cached RRsets that are trusted at
+ * least as much are kept.  The outcome is logged when loading finishes.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'filename' is not NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS if the load was started.
+ *\li	#ISC_R_FILENOTFOUND
+ *\li	#ISC_R_INPROGRESS if the cache is already being loaded.
+ *\li	#ISC_R_NOTIMPLEMENTED if the cache was created without a task
+ *	manager and a timer manager.
+ *\li	Other errors opening the file.
+ */
+
+isc_result_t
+dns_cache_setsweepers(dns_cache_t *cache, unsigned int nsweepers);
+/*%<
+ * Starts deleting the expired records of the cache in the background,
+ * once a second, with 'nsweepers' tasks bound to different threads.
+ * Each one takes its own share of the node-lock buckets of the cache
+ * database (see dns_db_cleanbucket()), deleting a number of records at
+ * a time that is adjusted so that it holds a bucket only briefly.  The
+ * number of records deleted is reported by dns_cache_dumpstats().
+ *
+ * The sweepers are created by the first call; later calls only restart
+ * them.  If 'nsweepers' is zero, the sweepers are stopped.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED if 'nsweepers' is not zero and the cache was
+ *	created without a task manager and a timer manager.
+ */
+
+unsigned int
+dns_cache_getshards(dns_cache_t *cache);
+/*%<
+ * Gets the number of shards the cache was created with.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
 isc_result_t
 dns_cache_flush(dns_cache_t *cache);
 /*%<
- * Flushes all data from the cache.
+ * Flushes all data from the cache.  The cache is switched to a new,
+ * empty database at once; the old one is freed in the background by
+ * the cache's database task when its last reference is released.
  *
  * Returns:
  *\li	#ISC_R_SUCCESS
@@ -289,6 +403,13 @@ dns_cache_renderxml(dns_cache_t *cache, void *writer0);
 /*
  * Render cache statistics and status in XML for 'writer'.
  */
+
+int
+dns_cache_renderdomainsxml(dns_cache_t *cache, void *writer0);
+/*
+ * Render the domains using the most memory in the cache in XML for
+ * 'writer', if they are reported (see dns_cache_settopdomains()).
+ */
 #endif /* HAVE_LIBXML2 */
 
 #ifdef HAVE_JSON_C
@@ -297,6 +418,14 @@ dns_cache_renderjson(dns_cache_t *cache, void *cstats0);
 /*
  * Render cache statistics and status in JSON
  */
+
+isc_result_t
+dns_cache_renderdomainsjson(dns_cache_t *cache, void *view0);
+/*
+ * Add the domains using the most memory in the cache to the JSON
+ * object 'view0' as "cachedomains", if they are reported (see
+ * dns_cache_settopdomains()).
+ */
 #endif /* HAVE_JSON_C */
 
 ISC_LANG_ENDDECLS
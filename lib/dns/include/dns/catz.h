@@ -249,6 +249,17 @@ dns_catz_zone_resetdefoptions(dns_catz_zone_t *catz);
  * \li	'catz' is a valid dns_catz_zone_t.
  */
 
+void
+dns_catz_zone_setjournal(dns_catz_zone_t *catz, const char *journal);
+/*%<
+ * Set the journal file of the catalog zone 'catz'.  When it is set, an
+ * update that only changes member zones reads just those member zones
+ * from the database, as found from the journal.
+ *
+ * Requires:
+ * \li	'catz' is a valid dns_catz_zone_t.
+ */
+
 isc_result_t
 dns_catz_generate_masterfilename(dns_catz_zone_t *catz, dns_catz_entry_t *entry,
 				 isc_buffer_t **buffer);
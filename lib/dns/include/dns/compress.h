@@ -16,6 +16,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/buffer.h>
 #include <isc/lang.h>
 #include <isc/region.h>
 
@@ -49,20 +50,25 @@ ISC_LANG_BEGINDECLS
  * DNS_COMPRESS_TABLESIZE must be a power of 2. The compress code
  * utilizes this assumption.
  */
-#define DNS_COMPRESS_TABLEBITS	  6
+#define DNS_COMPRESS_TABLEBITS	  8
 #define DNS_COMPRESS_TABLESIZE	  (1U << DNS_COMPRESS_TABLEBITS)
 #define DNS_COMPRESS_TABLEMASK	  (DNS_COMPRESS_TABLESIZE - 1)
-#define DNS_COMPRESS_INITIALNODES 24
-#define DNS_COMPRESS_ARENA_SIZE	  640
+#define DNS_COMPRESS_INITIALNODES 64
 
 typedef struct dns_compressnode dns_compressnode_t;
 
+/*%
+ * The names already in the message form a suffix trie: each node is
+ * one label, stored in the message at 'offset', whose parent is the
+ * node for the rest of the name.  Nodes are chained in the hash table
+ * by their label and parent, and are referred to by index + 1 so that
+ * 0 means none (or the root, for 'parent').
+ */
 struct dns_compressnode {
-	dns_compressnode_t *next;
-	uint16_t	    offset;
-	uint16_t	    count;
-	isc_region_t	    r;
-	dns_name_t	    name;
+	uint16_t next;	 /*%< Next node in the hash chain. */
+	uint16_t parent; /*%< Node for the parent suffix. */
+	uint16_t offset; /*%< Message offset of the label. */
+	uint16_t hash;	 /*%< Hash of the label and parent. */
 };
 
 struct dns_compress {
@@ -70,13 +76,13 @@ struct dns_compress {
 	unsigned int allowed; /*%< Allowed methods. */
 	int	     edns;    /*%< Edns version or -1. */
 	/*% Global compression table. */
-	dns_compressnode_t *table[DNS_COMPRESS_TABLESIZE];
-	/*% Preallocated arena for names. */
-	unsigned char arena[DNS_COMPRESS_ARENA_SIZE];
-	off_t	      arena_off;
+	uint16_t table[DNS_COMPRESS_TABLESIZE];
+	/*% Trie nodes, initially 'initialnodes'. */
+	dns_compressnode_t *nodes;
 	/*% Preallocated nodes for the table. */
 	dns_compressnode_t initialnodes[DNS_COMPRESS_INITIALNODES];
 	uint16_t	   count; /*%< Number of nodes. */
+	uint16_t	   size;  /*%< Size of 'nodes'. */
 	isc_mem_t	  *mctx;  /*%< Memory context. */
 };
 
@@ -189,13 +195,16 @@ dns_compress_getedns(dns_compress_t *cctx);
  */
 
 bool
-dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
-			dns_name_t *prefix, uint16_t *offset);
+dns_compress_findglobal(dns_compress_t *cctx, const isc_buffer_t *buffer,
+			const dns_name_t *name, dns_name_t *prefix,
+			uint16_t *offset);
 /*%<
- *	Finds longest possible match of 'name' in the global compression table.
+ *	Finds longest possible match of 'name' in the global compression table,
+ *	comparing its labels with those already rendered in 'buffer'.
  *
  *	Requires:
  *\li		'cctx' to be initialized.
+ *\li		'buffer' to be the buffer the message is rendered into.
  *\li		'name' to be a absolute name.
  *\li		'prefix' to be initialized.
  *\li		'offset' to point to an uint16_t.
@@ -208,17 +217,18 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
  */
 
 void
-dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
-		 const dns_name_t *prefix, uint16_t offset);
+dns_compress_add(dns_compress_t *cctx, const isc_buffer_t *buffer,
+		 const dns_name_t *name, const dns_name_t *prefix,
+		 uint16_t offset);
 /*%<
- *	Add compression pointers for 'name' to the compression table,
- *	not replacing existing pointers.
+ *	Add compression pointers for 'name', which has been rendered in
+ *	'buffer' at 'offset', to the compression table, not replacing
+ *	existing pointers.
  *
  *	Requires:
  *\li		'cctx' initialized
  *
- *\li		'name' must be initialized and absolute, and must remain
- *		valid until the message compression is complete.
+ *\li		'name' must be initialized and absolute.
  *
  *\li		'prefix' must be a prefix returned by
  *		dns_compress_findglobal(), or the same as 'name'.
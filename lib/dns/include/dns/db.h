@@ -185,6 +185,19 @@ typedef struct dns_dbmethods {
 	isc_result_t (*setservestalerefresh)(dns_db_t *db, uint32_t interval);
 	isc_result_t (*getservestalerefresh)(dns_db_t *db, uint32_t *interval);
 	isc_result_t (*setgluecachestats)(dns_db_t *db, isc_stats_t *stats);
+	void (*setsizehint)(dns_db_t *db, size_t nodes);
+	unsigned int (*nodelockwaits)(dns_db_t *db, uint64_t *waits,
+				      unsigned int nwaits);
+	isc_result_t (*setcachepolicy)(dns_db_t *db, dns_cachepolicy_t policy);
+	void (*findpopular)(dns_db_t *db, isc_stdtime_t now, dns_ttl_t window,
+			    unsigned int minhits, dns_dbpopular_t *popular,
+			    unsigned int size, unsigned int *countp);
+	isc_result_t (*cleanbucket)(dns_db_t *db, unsigned int bucket,
+				    isc_stdtime_t now, unsigned int limit,
+				    unsigned int *countp);
+	void (*setdomainusage)(dns_db_t *db, bool enable);
+	void (*topdomains)(dns_db_t *db, dns_dbdomainusage_t *top,
+			   unsigned int size, unsigned int *countp);
 } dns_dbmethods_t;
 
 typedef isc_result_t (*dns_dbcreatefunc_t)(isc_mem_t	    *mctx,
@@ -228,6 +241,25 @@ struct dns_dbonupdatelistener {
 	ISC_LINK(dns_dbonupdatelistener_t) link;
 };
 
+/*%
+ * A cached rdataset found by dns_db_findpopular().
+ */
+struct dns_dbpopular {
+	dns_fixedname_t fixed;
+	dns_rdatatype_t type;
+	unsigned int	hits;
+};
+
+/*%
+ * The memory used by the cached rdatasets below a domain, as reported
+ * by dns_db_topdomains().
+ */
+struct dns_dbdomainusage {
+	dns_fixedname_t fixed;
+	uint64_t	bytes;
+	unsigned int	rdatasets;
+};
+
 /*@{*/
 /*%
  * Options that can be specified for dns_db_find().
@@ -794,7 +826,10 @@ dns_db_findext(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
  *	NSEC record that potentially covers 'name' if a answer cannot
  *	be found.  Note the returned NSEC needs to be checked to ensure
  *	that it is correct.  This only affects answers returned from the
- *	cache.
+ *	cache.  If the cache only has an NSEC3 record at the owner name
+ *	that would precede 'name', that NSEC3 record is returned instead;
+ *	so when 'name' is a hashed owner name, this finds the NSEC3 record
+ *	that potentially covers it.
  *
  * \li	If the #DNS_DBFIND_FORCENSEC3 option is set, then we are looking
  *	in the NSEC3 tree and not the main tree.  Without this option being
@@ -1388,6 +1423,39 @@ dns_db_hashsize(dns_db_t *db);
  *      0 if not implemented.
  */
 
+void
+dns_db_setsizehint(dns_db_t *db, size_t nodes);
+/*%<
+ * Tell 'db' that it is about to be loaded with roughly 'nodes' names, so
+ * that it can size its internal structures (such as the number of node
+ * locks and the name hash table) to suit.  The hint is ignored by
+ * implementations that do not support it, and once the database has
+ * been loaded or used.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid zone database.
+ */
+
+unsigned int
+dns_db_nodelockwaits(dns_db_t *db, uint64_t *waits, unsigned int nwaits);
+/*%<
+ * For database implementations that stripe their nodes over a set of
+ * locks, report how many times a lookup or update had to wait for each
+ * lock.  The counts for the first 'nwaits' locks are stored in 'waits'.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ *
+ * \li	'waits' points to an array of at least 'nwaits' elements, or
+ *	'nwaits' is 0.
+ *
+ * Returns:
+ * \li	The number of node locks in the database, or 0 if not
+ *	implemented.
+ */
+
 void
 dns_db_settask(dns_db_t *db, isc_task_t *task);
 /*%<
@@ -1666,6 +1734,26 @@ dns_db_updatenotify_unregister(dns_db_t *db, dns_dbupdate_callback_t fn,
  *
  */
 
+uint32_t
+dns_db_generation(void);
+/*%<
+ * Return the current zone data generation.  The generation is a
+ * process-wide counter which changes whenever the data served from a
+ * zone may have changed: a version of a zone database being committed,
+ * a zone database being attached to or detached from its zone, or a
+ * zone being added to or removed from a zone table.
+ *
+ * Callers that keep data derived from zone contents can record the
+ * generation before looking the data up and discard it once the
+ * generation has moved on.
+ */
+
+void
+dns_db_newgeneration(void);
+/*%<
+ * Advance the zone data generation; see dns_db_generation().
+ */
+
 isc_result_t
 dns_db_nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name);
 /*%<
@@ -1741,6 +1829,101 @@ dns_db_getservestalerefresh(dns_db_t *db, uint32_t *interval);
  * \li	#ISC_R_NOTIMPLEMENTED - Not supported by this DB implementation.
  */
 
+void
+dns_db_findpopular(dns_db_t *db, isc_stdtime_t now, dns_ttl_t window,
+		   unsigned int minhits, dns_dbpopular_t *popular,
+		   unsigned int size, unsigned int *countp);
+/*%<
+ * Find the cached rdatasets that expire within 'window' seconds of
+ * 'now', are eligible for prefetching (see #DNS_DBADD_PREFETCH), and
+ * have been looked up at least 'minhits' times since they were added.
+ * The 'size' ones that were looked up the most are kept in 'popular',
+ * in no particular order; '*countp' is the number of entries in use.
+ *
+ * The first '*countp' entries of 'popular' are kept or replaced, so
+ * that the most popular rdatasets of several databases can be
+ * collected into the same array.  Databases that do not count lookups
+ * leave 'popular' unchanged.
+ *
+ * Requires:
+ * \li	'db' is a valid cache database.
+ * \li	'popular' holds 'size' entries, the first '*countp' of which are
+ *	valid.
+ */
+
+isc_result_t
+dns_db_cleanbucket(dns_db_t *db, unsigned int bucket, isc_stdtime_t now,
+		   unsigned int limit, unsigned int *countp);
+/*%<
+ * Delete up to 'limit' of the rdatasets that had expired by 'now' from
+ * the cache, among the nodes protected by the node lock 'bucket' (the
+ * locks are numbered as in dns_db_nodelockwaits()).  The number of
+ * rdatasets deleted is stored in '*countp'.
+ *
+ * This lets the expired entries of a cache be cleaned by several
+ * workers at once, each taking its own share of the buckets.  Like the
+ * cleaning done when rdatasets are added, stale rdatasets are kept for
+ * the serve-stale TTL unless the cache is out of memory.
+ *
+ * Requires:
+ * \li	'db' is a valid cache database.
+ * \li	'countp' is not NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS if nothing more can be cleaned in 'bucket' now.
+ * \li	#DNS_R_CONTINUE if 'limit' rdatasets were deleted, and there may
+ *	be more.
+ * \li	#ISC_R_RANGE if there is no such bucket.
+ * \li	#ISC_R_NOTIMPLEMENTED if the database does not support it.
+ */
+
+void
+dns_db_setdomainusage(dns_db_t *db, bool enable);
+/*%<
+ * Start or stop accounting the memory used by the rdatasets added to
+ * the cache to their domain, which is made of the last two labels of
+ * the owner name.  Rdatasets that were added while accounting was
+ * stopped are not counted.  Databases that do not support it ignore
+ * the call.
+ *
+ * Requires:
+ * \li	'db' is a valid cache database.
+ */
+
+void
+dns_db_topdomains(dns_db_t *db, dns_dbdomainusage_t *top, unsigned int size,
+		  unsigned int *countp);
+/*%<
+ * Find the 'size' domains whose cached rdatasets use the most memory
+ * (see dns_db_setdomainusage()) and keep them in 'top', in no
+ * particular order; '*countp' is the number of entries in use.
+ *
+ * As with dns_db_findpopular(), the first '*countp' entries of 'top'
+ * are kept or replaced, so that the largest domains of several
+ * databases can be collected into the same array.
+ *
+ * Requires:
+ * \li	'db' is a valid cache database.
+ * \li	'top' holds 'size' entries, the first '*countp' of which are
+ *	valid.
+ */
+
+isc_result_t
+dns_db_setcachepolicy(dns_db_t *db, dns_cachepolicy_t policy);
+/*%<
+ * Sets the policy used to choose the entries purged from the cache when
+ * it runs out of memory: 'dns_cachepolicy_lru' purges the least recently
+ * used entries, 'dns_cachepolicy_slru' purges the least recently used
+ * of the entries that have been looked up fewer than twice first.
+ *
+ * Requires:
+ * \li	'db' is a valid cache database.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED - Not supported by this DB implementation.
+ */
+
 isc_result_t
 dns_db_setgluecachestats(dns_db_t *db, isc_stats_t *stats);
 /*%<
@@ -188,6 +188,22 @@ typedef bool (*dns_dlzssumatch_t)(const dns_name_t    *signer,
  * called to authorize update requests
  */
 
+typedef void (*dns_dlzsetcachettl_t)(void *driverarg, void *dbdata,
+				     dns_ttl_t ttl);
+/*%<
+ * Method prototype.  Drivers implementing the DLZ interface may
+ * optionally supply a setcachettl method.  If supplied, it is called
+ * after the create method to set for how long, at most, answers from
+ * the database may be cached; zero disables caching.
+ */
+
+typedef void (*dns_dlzflushcache_t)(void *driverarg, void *dbdata);
+/*%<
+ * Method prototype.  Drivers implementing the DLZ interface may
+ * optionally supply a flushcache method.  If supplied, it is called
+ * to discard any answers cached from the database.
+ */
+
 /*% the methods supplied by a DLZ driver */
 typedef struct dns_dlzmethods {
 	dns_dlzcreate_t	      create;
@@ -196,6 +212,8 @@ typedef struct dns_dlzmethods {
 	dns_dlzallowzonexfr_t allowzonexfr;
 	dns_dlzconfigure_t    configure;
 	dns_dlzssumatch_t     ssumatch;
+	dns_dlzsetcachettl_t  setcachettl;
+	dns_dlzflushcache_t   flushcache;
 } dns_dlzmethods_t;
 
 /*% information about a DLZ driver */
@@ -330,4 +348,18 @@ dns_dlz_ssumatch(dns_dlzdb_t *dlzdatabase, const dns_name_t *signer,
  * call a DLZ drivers ssumatch method, if supplied. Otherwise return false
  */
 
+void
+dns_dlz_setcachettl(dns_dlzdb_t *dlzdb, dns_ttl_t ttl);
+/*%<
+ * Allow answers from 'dlzdb' to be cached for up to 'ttl' seconds, or
+ * disable caching if 'ttl' is zero.  Does nothing if the driver has no
+ * setcachettl method.
+ */
+
+void
+dns_dlz_flushcache(dns_dlzdb_t *dlzdb);
+/*%<
+ * Discard the answers cached from 'dlzdb', if the driver caches any.
+ */
+
 ISC_LANG_ENDDECLS
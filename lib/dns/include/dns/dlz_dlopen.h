@@ -67,6 +67,24 @@ dlz_dlopen_lookup_t(const char *zone, const char *name, void *dbdata,
 		    dns_sdlzlookup_t *lookup, dns_clientinfomethods_t *methods,
 		    dns_clientinfo_t *clientinfo);
 
+/*
+ * dlz_dlopen_lookup_async() is optional.  It starts the lookup that
+ * dlz_dlopen_lookup() would do and returns at once; the records are put
+ * later, from any thread, and then 'done' is called with 'arg' and the
+ * result of the lookup.  'methods' and 'clientinfo' may only be used
+ * before it returns.  Answers are only looked up asynchronously when
+ * the "dlz" statement sets "lookup-cache-ttl".
+ */
+typedef void
+dlz_dlopen_lookup_done_t(void *arg, isc_result_t result);
+
+typedef isc_result_t
+dlz_dlopen_lookup_async_t(const char *zone, const char *name, void *dbdata,
+			  dns_sdlzlookup_t *lookup,
+			  dns_clientinfomethods_t *methods,
+			  dns_clientinfo_t	  *clientinfo,
+			  dlz_dlopen_lookup_done_t *done, void *arg);
+
 /*
  * dlz_dlopen_authority is optional() if dlz_dlopen_lookup()
  * supplies authority information for the dns record
@@ -127,6 +127,32 @@ dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
  *	DNS_R_DISALLOWED	if there is no match.
  */
 
+bool
+dns_dns64_clientok(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
+		   const dns_name_t *reqsigner, dns_aclenv_t *env,
+		   unsigned int flags);
+/*
+ * Return true if 'dns64' applies to the client described by 'reqaddr',
+ * 'reqsigner', 'env' and 'flags'.  This is the part of
+ * dns_dns64_aaaafroma() that does not depend on the A record, so a
+ * caller synthesising from several A records only needs to call it
+ * once per dns64 record.
+ *
+ * Requires:
+ *	'dns64'		to be valid.
+ *	'reqaddr'	to be valid.
+ *	'reqsigner'	to be NULL or valid.
+ *	'env'		to be valid.
+ */
+
+isc_result_t
+dns_dns64_map(const dns_dns64_t *dns64, dns_aclenv_t *env,
+	      const unsigned char *a, unsigned char *aaaa);
+/*
+ * Like dns_dns64_aaaafroma(), for a client already accepted by
+ * dns_dns64_clientok().
+ */
+
 dns_dns64_t *
 dns_dns64_next(dns_dns64_t *dns64);
 /*
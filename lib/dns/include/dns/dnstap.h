@@ -276,6 +276,11 @@ dns_dt_send(dns_view_t *view, dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
  * times; if NULL, they are set to the current time); and 'buf' (the
  * DNS message being logged, in wire format).
  *
+ * 'zone' and 'buf' are only used during the call: they are packed
+ * directly into the dnstap frame, which is the only copy made, so the
+ * caller should pass the buffer that was sent or received rather than
+ * rendering the message again.
+ *
  * Requires:
  *
  *\li	'view' is a valid view, and 'view->dtenv' is NULL or is a
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file dns/ecscache.h
+ * \brief
+ * A cache of answers that apply only to part of the address space,
+ * as returned by authoritative servers in response to queries with an
+ * EDNS Client Subnet (ECS) option (RFC 7871).
+ *
+ * Each answer is stored for the client subnet it was sent for,
+ * narrowed to the scope prefix length of the response.  A lookup for a
+ * client address returns the answer with the longest matching scope.
+ * Answers with a scope of 0 apply to every client.
+ *
+ * The cache holds one answer per name, type and scoped subnet; adding
+ * another replaces it.  Expired answers are never returned, and are
+ * removed by lookups and by dns_ecscache_clean().
+ */
+
+#include <stdbool.h>
+
+#include <isc/lang.h>
+#include <isc/netaddr.h>
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+void
+dns_ecscache_create(isc_mem_t *mctx, dns_ecscache_t **cachep);
+/*%<
+ * Create an empty ECS cache.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	'cachep' is not NULL and '*cachep' is NULL.
+ */
+
+void
+dns_ecscache_destroy(dns_ecscache_t **cachep);
+/*%<
+ * Destroy an ECS cache.  Rdatasets returned by dns_ecscache_find()
+ * stay valid until they are disassociated.
+ *
+ * Requires:
+ *\li	'cachep' points to a valid ECS cache.
+ */
+
+isc_result_t
+dns_ecscache_add(dns_ecscache_t *cache, const dns_name_t *name,
+		 const dns_ecs_t *ecs, dns_rdataset_t *rdataset,
+		 isc_stdtime_t now);
+/*%<
+ * Store 'rdataset', owned by 'name', as the answer for the clients in
+ * the subnet 'ecs->addr'/'ecs->scope'.  A scope longer than
+ * 'ecs->source' is treated as 'ecs->source', since the answer cannot
+ * be more specific than the question.  The answer expires after the
+ * TTL of 'rdataset'.
+ *
+ * Requires:
+ *\li	'cache' is a valid ECS cache.
+ *\li	'name' is a valid absolute name.
+ *\li	'ecs->addr' is an IPv4 or IPv6 address.
+ *\li	'rdataset' is a valid, associated rdataset.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOSPACE		the rdataset is too large to store
+ */
+
+isc_result_t
+dns_ecscache_find(dns_ecscache_t *cache, const dns_name_t *name,
+		  dns_rdatatype_t type, const isc_netaddr_t *client,
+		  isc_stdtime_t now, dns_rdataset_t *rdataset,
+		  unsigned int *scopep);
+/*%<
+ * Find the answer of 'type' for 'name' whose subnet contains 'client'
+ * and has the longest scope.  On success, 'rdataset' is associated
+ * with it, with the remaining TTL, and if 'scopep' is not NULL, the
+ * scope prefix length of the answer is stored there.
+ *
+ * Requires:
+ *\li	'cache' is a valid ECS cache.
+ *\li	'client' is an IPv4 or IPv6 address.
+ *\li	'rdataset' is a valid, disassociated rdataset.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND
+ */
+
+void
+dns_ecscache_clean(dns_ecscache_t *cache, isc_stdtime_t now);
+/*%<
+ * Remove every answer that has expired at 'now'.
+ *
+ * Requires:
+ *\li	'cache' is a valid ECS cache.
+ */
+
+ISC_LANG_ENDDECLS
@@ -82,6 +82,10 @@
 #define DNS_EVENT_TRYSTALE	     (ISC_EVENTCLASS_DNS + 59)
 #define DNS_EVENT_ZONEFLUSH	     (ISC_EVENTCLASS_DNS + 60)
 #define DNS_EVENT_CHECKDSSENDTOADDR  (ISC_EVENTCLASS_DNS + 61)
+#define DNS_EVENT_RBTREHASH	     (ISC_EVENTCLASS_DNS + 62)
+#define DNS_EVENT_CACHESWEEP	     (ISC_EVENTCLASS_DNS + 63)
+#define DNS_EVENT_VALIDATORVERIFIED  (ISC_EVENTCLASS_DNS + 64)
+#define DNS_EVENT_ZONETIMER	     (ISC_EVENTCLASS_DNS + 65)
 
 #define DNS_EVENT_FIRSTEVENT (ISC_EVENTCLASS_DNS + 0)
 #define DNS_EVENT_LASTEVENT  (ISC_EVENTCLASS_DNS + 65535)
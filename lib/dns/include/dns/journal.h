@@ -42,15 +42,18 @@
  ***/
 #define DNS_JOURNALOPT_RESIGN 0x00000001
 
-#define DNS_JOURNAL_READ   0x00000000 /* false */
-#define DNS_JOURNAL_CREATE 0x00000001 /* true */
-#define DNS_JOURNAL_WRITE  0x00000002
+#define DNS_JOURNAL_READ      0x00000000 /* false */
+#define DNS_JOURNAL_CREATE    0x00000001 /* true */
+#define DNS_JOURNAL_WRITE     0x00000002
+#define DNS_JOURNAL_DEFERSYNC 0x00000004
 
 #define DNS_JOURNAL_SIZE_MAX INT32_MAX
 #define DNS_JOURNAL_SIZE_MIN 4096
 
 /*% Print transaction header data */
 #define DNS_JOURNAL_PRINTXHDR 0x0001
+/*% Print all transactions, ignoring the serial number range */
+#define DNS_JOURNAL_PRINTALL 0x0002
 
 /*% Rewrite whole journal file instead of compacting */
 #define DNS_JOURNAL_COMPACTALL 0x0001
@@ -112,6 +115,11 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
  * the journal if it does not exist.
  * DNS_JOURNAL_WRITE open the journal for reading and writing.
  * DNS_JOURNAL_READ open the journal for reading only.
+ *
+ * DNS_JOURNAL_DEFERSYNC, together with DNS_JOURNAL_CREATE or
+ * DNS_JOURNAL_WRITE, makes dns_journal_commit() leave the committed
+ * transactions out of the journal header until dns_journal_sync()
+ * is called or the journal is destroyed.
  */
 
 void
@@ -161,6 +169,22 @@ dns_journal_commit(dns_journal_t *j);
  *      sequence.
  */
 
+isc_result_t
+dns_journal_sync(dns_journal_t *j);
+/*%<
+ * Commit the transactions of journal file 'j' to stable storage and
+ * make them visible to readers of the file.  This is done by
+ * dns_journal_commit() unless the journal was opened with
+ * DNS_JOURNAL_DEFERSYNC, so that several transactions can be
+ * committed with a single sync.
+ *
+ * If a transaction is open, only the transactions committed before
+ * it are synced.
+ *
+ * Requires:
+ * \li     'j' is open for writing.
+ */
+
 isc_result_t
 dns_journal_write_transaction(dns_journal_t *j, dns_diff_t *diff);
 /*%
@@ -223,6 +247,32 @@ dns_journal_iter_init(dns_journal_t *j, uint32_t begin_serial,
  *			this particular serial number does not exist.
  */
 
+isc_result_t
+dns_journal_split(dns_journal_t *j, uint32_t begin_serial, uint32_t end_serial,
+		  unsigned int nparts, uint32_t *serials, unsigned int *npartsp);
+/*%<
+ * Divide the transactions from 'begin_serial' to 'end_serial' into at
+ * most 'nparts' runs of roughly the same size in bytes, so that they
+ * can be iterated over in parallel with one journal object per run.
+ * Run 'i' goes from 'serials[i]' to 'serials[i + 1]'; 'serials[0]' is
+ * 'begin_serial', and the number of runs 'n' is stored in '*npartsp',
+ * with 'serials[n]' set to 'end_serial'.
+ *
+ * Only transaction headers are read.
+ *
+ * Requires:
+ *\li	'j' is a valid journal opened for reading.
+ *\li	'nparts' > 0.
+ *\li	'serials' has room for 'nparts' + 1 serial numbers.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_RANGE		a serial number is outside the journal
+ *\li	ISC_R_NOTFOUND		a serial number is not the start or the
+ *				end of a transaction
+ *\li	others
+ */
+
 /*@{*/
 isc_result_t
 dns_journal_first_rr(dns_journal_t *j);
@@ -279,7 +329,24 @@ dns_journal_rollforward(dns_journal_t *j, dns_db_t *db, unsigned int options);
 isc_result_t
 dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 		  FILE *file);
-/* For debugging not general use */
+isc_result_t
+dns_journal_printrange(isc_mem_t *mctx, uint32_t flags, const char *filename,
+		       uint32_t begin_serial, uint32_t end_serial, FILE *file);
+/*%<
+ * Print the journal 'filename' to 'file'.  dns_journal_printrange()
+ * only prints the transactions from 'begin_serial' to 'end_serial',
+ * unless DNS_JOURNAL_PRINTALL is set in 'flags'.
+ *
+ * For debugging not general use.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	DNS_R_NOJOURNAL		the journal does not exist
+ *\li	ISC_R_RANGE		a serial number is outside the journal
+ *\li	ISC_R_NOTFOUND		a serial number is not the start or the
+ *				end of a transaction
+ *\li	others
+ */
 
 isc_result_t
 dns_db_diff(isc_mem_t *mctx, dns_db_t *dba, dns_dbversion_t *dbvera,
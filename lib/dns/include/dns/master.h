@@ -59,6 +59,7 @@
 #define DNS_MASTER_KEY	    0x00004000 /*%< Loading a key zone master file. */
 #define DNS_MASTER_NOTTL    0x00008000 /*%< Don't require ttl. */
 #define DNS_MASTER_CHECKTTL 0x00010000 /*%< Check max-zone-ttl */
+#define DNS_MASTER_CACHE    0x00020000 /*%< Only accept a raw cache dump */
 
 ISC_LANG_BEGINDECLS
 
@@ -68,7 +69,20 @@ ISC_LANG_BEGINDECLS
  * encoding, we directly read/write each field so that the encoded data
  * is always "packed", regardless of the hardware architecture.
  */
-#define DNS_RAWFORMAT_VERSION 1
+#define DNS_RAWFORMAT_VERSION 2
+
+/*
+ * In version 2 of the raw format, the RRsets following the header are
+ * stored in chunks of at most DNS_RAWFORMAT_CHUNKSIZE bytes; an RRset
+ * may span chunks.  Each chunk starts with:
+ *
+ *	uint32_t  length of the RRset data in the chunk
+ *	uint32_t  length of the chunk data as stored; if it is smaller
+ *		  than the former, the data is zlib compressed
+ *	uint64_t  CRC-64 of the RRset data in the chunk
+ */
+#define DNS_RAWFORMAT_CHUNKSIZE	   65536
+#define DNS_RAWFORMAT_CHUNKHDRSIZE 16
 
 /*
  * Flags to indicate the status of the data in the raw file header
@@ -76,6 +90,8 @@ ISC_LANG_BEGINDECLS
 #define DNS_MASTERRAW_COMPAT	      0x01
 #define DNS_MASTERRAW_SOURCESERIALSET 0x02
 #define DNS_MASTERRAW_LASTXFRINSET    0x04
+#define DNS_MASTERRAW_CACHE	      0x08 /*%< Dump of a cache database */
+#define DNS_MASTERRAW_CHUNKED	      0x10 /*%< Write format version 2 */
 
 /* Common header */
 struct dns_masterrawheader {
@@ -100,9 +116,12 @@ typedef struct {
 	dns_rdataclass_t rdclass; /* 16-bit class */
 	dns_rdatatype_t	 type;	  /* 16-bit type */
 	dns_rdatatype_t	 covers;  /* same as type */
-	dns_ttl_t	 ttl;	  /* 32-bit TTL */
+	dns_ttl_t	 ttl;	  /* 32-bit TTL, or the absolute
+				   * expiry time if
+				   * DNS_MASTERRAW_CACHE is set */
 	uint32_t	 nrdata;  /* number of RRs in this set */
-	/* followed by encoded owner name, and then rdata */
+	/* followed by the 16-bit trust level if DNS_MASTERRAW_CACHE
+	 * is set, the encoded owner name, and then rdata */
 } dns_masterrawrdataset_t;
 
 /*
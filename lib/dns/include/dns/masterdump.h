@@ -259,7 +259,10 @@ dns_master_dumptostream(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
  * 'style' specifies the file style (e.g., &dns_master_style_default).
  *
  * If 'format' is dns_masterformat_raw, then 'header' can contain
- * information to be written to the file header.
+ * information to be written to the file header.  If DNS_MASTERRAW_CACHE
+ * is set in its flags, 'db' must be a cache database; the RRsets are
+ * then written with their absolute expiry times and trust levels, and
+ * negative, stale and expired RRsets are omitted.
  *
  * Temporary dynamic memory may be allocated from 'mctx'.
  *
@@ -296,7 +299,10 @@ dns_master_dump(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
  * 'style' specifies the file style (e.g., &dns_master_style_default).
  *
  * If 'format' is dns_masterformat_raw, then 'header' can contain
- * information to be written to the file header.
+ * information to be written to the file header.  If DNS_MASTERRAW_CACHE
+ * is set in its flags, 'db' must be a cache database; the RRsets are
+ * then written with their absolute expiry times and trust levels, and
+ * negative, stale and expired RRsets are omitted.
  *
  * Temporary dynamic memory may be allocated from 'mctx'.
  *
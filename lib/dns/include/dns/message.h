@@ -163,6 +163,12 @@
 
 #define DNS_MESSAGE_HEADERLEN 12 /*%< 6 uint16_t's */
 
+/*%
+ * Number of EDNS options remembered by dns_message_getednsopt(); the
+ * rest of a longer OPT record is searched each time.
+ */
+#define DNS_MESSAGE_EDNSOPTS 8
+
 #define DNS_MESSAGE_MAGIC      ISC_MAGIC('M', 'S', 'G', '@')
 #define DNS_MESSAGE_VALID(msg) ISC_MAGIC_VALID(msg, DNS_MESSAGE_MAGIC)
 
@@ -235,6 +241,7 @@ typedef int dns_messagetextflag_t;
 /* Obsolete: DNS_MESSAGERENDER_FILTER_AAAA	0x0020	*/
 
 typedef struct dns_msgblock dns_msgblock_t;
+typedef ISC_LIST(dns_msgblock_t) dns_msgblocklist_t;
 
 struct dns_sortlist_arg {
 	dns_aclenv_t	       *env;
@@ -268,6 +275,18 @@ struct dns_message {
 	dns_rdataset_t *sig0;
 	dns_rdataset_t *tsig;
 
+	/*
+	 * Where each option of the OPT record is, filled in by the first
+	 * call to dns_message_getednsopt().  'nednsopts' is -1 until then.
+	 */
+	struct {
+		uint16_t code;
+		uint16_t offset;
+		uint16_t length;
+	} ednsopts[DNS_MESSAGE_EDNSOPTS];
+	int	 nednsopts;
+	uint16_t ednsopts_rest;
+
 	int	     state;
 	unsigned int from_to_wire     : 2;
 	unsigned int header_ok	      : 1;
@@ -300,9 +319,9 @@ struct dns_message {
 	isc_bufferlist_t scratchpad;
 	isc_bufferlist_t cleanup;
 
-	ISC_LIST(dns_msgblock_t) rdatas;
-	ISC_LIST(dns_msgblock_t) rdatalists;
-	ISC_LIST(dns_msgblock_t) offsets;
+	dns_msgblocklist_t rdatas;
+	dns_msgblocklist_t rdatalists;
+	dns_msgblocklist_t offsets;
 
 	ISC_LIST(dns_rdata_t) freerdata;
 	ISC_LIST(dns_rdatalist_t) freerdatalist;
@@ -690,6 +709,54 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t section,
  *				   are records remaining for this section.
  */
 
+bool
+dns_message_sectionfits(dns_message_t *msg, dns_section_t section);
+/*%<
+ * Check, without rendering anything, whether 'section' could fit into
+ * the space left in the render buffer.  The check adds up a lower bound
+ * on the wire size of each record (the rdata length, plus a compressed
+ * owner name and the fixed record fields), so it is cheap compared to
+ * dns_message_rendersection(); rdata of types whose names may be
+ * compressed only counts towards the fixed part.
+ *
+ * Requires:
+ *\li	'msg' be valid.
+ *
+ *\li	'section' be a valid section.
+ *
+ *\li	dns_message_renderbegin() was called.
+ *
+ * Returns:
+ *\li	false if dns_message_rendersection() is certain to return
+ *	#ISC_R_NOSPACE for 'section'; true otherwise.
+ */
+
+isc_result_t
+dns_message_renderwire(dns_message_t *msg, const isc_region_t *wire,
+		       const unsigned int counts[DNS_SECTION_MAX]);
+/*%<
+ * Copy previously rendered sections into the buffer in place of calling
+ * dns_message_rendersection() for each of them.  'wire' holds the
+ * sections of a message as they followed its header, and 'counts' the
+ * number of records in each of them.  The wire data must have been
+ * rendered at the same offset, so that any compression pointers in it
+ * remain valid.
+ *
+ * Anything rendered afterwards by dns_message_renderend() (OPT, TSIG,
+ * SIG(0)) is appended as usual.
+ *
+ * Requires:
+ *\li	'msg' be valid.
+ *
+ *\li	dns_message_renderbegin() was called and no sections have been
+ *	rendered yet.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		-- the sections were copied.
+ *\li	#ISC_R_NOSPACE		-- Not enough room in the buffer;
+ *				   nothing was written.
+ */
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target);
 /*%<
@@ -1162,6 +1229,31 @@ dns_message_setopt(dns_message_t *msg, dns_rdataset_t *opt);
  *\li	#ISC_R_NOSPACE		-- there is no space for the OPT record.
  */
 
+isc_result_t
+dns_message_getednsopt(dns_message_t *msg, uint16_t code,
+		       isc_region_t *region);
+/*%<
+ * Find the first EDNS option with option code 'code' in the OPT record
+ * of 'msg', and point 'region' at its data.
+ *
+ * The options are indexed in a single pass over the OPT record the
+ * first time this is called, so looking up several options, or the
+ * same option repeatedly, does not decode the record again.
+ *
+ * Requires:
+ *
+ *\li	'msg' is a valid message.
+ *
+ *\li	'region' is not NULL.
+ *
+ * Returns:
+ *
+ *\li	#ISC_R_SUCCESS		-- the option was found.
+ *
+ *\li	#ISC_R_NOTFOUND		-- there is no OPT record, or no such
+ *				   option in it.
+ */
+
 dns_rdataset_t *
 dns_message_gettsig(dns_message_t *msg, const dns_name_t **owner);
 /*%<
@@ -1539,6 +1631,25 @@ dns_message_clonebuffer(dns_message_t *msg);
  * \li   msg be a valid message.
  */
 
+void
+dns_message_savebuffer(dns_message_t *msg, unsigned char *base,
+		       unsigned int length);
+/*%<
+ * Like dns_message_clonebuffer(), but copy the query or saved buffer
+ * into the caller-supplied storage at 'base' if it fits in 'length'
+ * bytes; anything that does not fit is copied onto the heap as
+ * dns_message_clonebuffer() would.  This lets a caller that reuses
+ * 'msg' for many requests keep a single preallocated buffer instead
+ * of allocating a copy for each request.
+ *
+ * The storage must remain valid until 'msg' is reset or destroyed;
+ * it is never freed by the message.
+ *
+ * Requires:
+ * \li   msg be a valid message.
+ * \li   base != NULL or length == 0.
+ */
+
 isc_result_t
 dns_message_minttl(dns_message_t *msg, const dns_section_t sectionid,
 		   dns_ttl_t *pttl);
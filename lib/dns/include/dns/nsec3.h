@@ -93,6 +93,22 @@ dns_nsec3_hashname(dns_fixedname_t *result,
  * the raw hash is stored there.
  */
 
+#define DNS_NSEC3_HASHNAMES_MAX 8
+
+isc_result_t
+dns_nsec3_hashnames(dns_fixedname_t *results, const dns_name_t **names,
+		    unsigned int count, const dns_name_t *origin,
+		    dns_hash_t hashalg, unsigned int iterations,
+		    const unsigned char *salt, size_t saltlength);
+/*%<
+ * Like dns_nsec3_hashname(), but make the hashed domain names of the
+ * 'count' names in 'names' at once, storing them in 'results'.  The
+ * names are hashed together with isc_iterated_hash_batch().
+ *
+ * Requires:
+ *	'count' is between 1 and DNS_NSEC3_HASHNAMES_MAX.
+ */
+
 unsigned int
 dns_nsec3_hashlength(dns_hash_t hash);
 /*%<
@@ -112,6 +128,14 @@ dns_nsec3_addnsec3(dns_db_t *db, dns_dbversion_t *version,
 		   const dns_rdata_nsec3param_t *nsec3param, dns_ttl_t nsecttl,
 		   bool unsecure, dns_diff_t *diff);
 
+isc_result_t
+dns_nsec3_addnsec3hash(dns_db_t *db, dns_dbversion_t *version,
+		       const dns_name_t		    *name,
+		       const dns_rdata_nsec3param_t *nsec3param,
+		       dns_ttl_t nsecttl, bool unsecure,
+		       const unsigned char *hash, size_t hashlength,
+		       dns_diff_t *diff);
+
 isc_result_t
 dns_nsec3_addnsec3s(dns_db_t *db, dns_dbversion_t *version,
 		    const dns_name_t *name, dns_ttl_t nsecttl, bool unsecure,
@@ -129,6 +153,10 @@ dns_nsec3_addnsec3sx(dns_db_t *db, dns_dbversion_t *version,
  * dns_nsec3_addnsec3() will only add records to the chain identified by
  * 'nsec3param'.
  *
+ * dns_nsec3_addnsec3hash() is similar to dns_nsec3_addnsec3() but uses
+ * 'hash', the NSEC3 hash of 'name' already computed with the parameters
+ * of 'nsec3param', instead of hashing 'name' again.
+ *
  * 'unsecure' should be set to reflect if this is a potentially
  * unsecure delegation (no DS record).
  *
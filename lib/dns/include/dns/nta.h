@@ -27,6 +27,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/lang.h>
 #include <isc/magic.h>
@@ -52,7 +53,9 @@ struct dns_ntatable {
 	isc_timermgr_t *timermgr;
 	isc_task_t     *task;
 	/* Protected by atomics */
-	isc_refcount_t references;
+	isc_refcount_t	     references;
+	atomic_uint_fast32_t count; /*%< NTAs in the table; changed
+				     * with rwlock held for writing */
 	/* Locked by rwlock. */
 	dns_rbt_t *table;
 	bool	   shuttingdown;
@@ -100,8 +100,14 @@ struct dns_rbtnode {
 	/*@}*/
 
 	/* node needs to be cleaned from rpz */
-	unsigned int rpz : 1;
-	unsigned int	 : 0; /* end of bitfields c/o tree lock */
+	uint8_t rpz : 1;
+	uint8_t	    : 0; /* end of bitfields c/o tree lock */
+
+	/*%
+	 * Set when the node is created (see dns_rbt_setshard()) and never
+	 * changed, so it can be read without any lock.
+	 */
+	uint8_t shard;
 
 	/*%
 	 * These are needed for hashing. The 'uppernode' points to the
@@ -112,6 +118,13 @@ struct dns_rbtnode {
 	dns_rbtnode_t *uppernode;
 	dns_rbtnode_t *hashnext;
 
+	/*%
+	 * The absolute name of the node, kept only by trees for which
+	 * dns_rbt_setfullnames() was called, else NULL.  Set when the
+	 * node is added to the tree and never changed.
+	 */
+	unsigned char *fullname;
+
 	dns_rbtnode_t *parent;
 	dns_rbtnode_t *left;
 	dns_rbtnode_t *right;
@@ -147,8 +160,16 @@ struct dns_rbtnode {
 	uint8_t dirty : 1;
 	uint8_t wild  : 1;
 	uint8_t	      : 0;	/* end of bitfields c/o node lock */
-	uint16_t       locknum; /* note that this is not in the bitfield */
-	isc_refcount_t references;
+	uint16_t locknum; /* note that this is not in the bitfield */
+
+	/*
+	 * The isc_refcount_*() macros already treat the count as a
+	 * 32-bit value, but isc_refcount_t is a "fast" type that is
+	 * twice that wide on LP64 platforms.  Using the least 32-bit
+	 * atomic lets the count fill the padding after 'locknum', which
+	 * makes every node eight bytes smaller.
+	 */
+	atomic_uint_least32_t references;
 	/*@}*/
 };
 
@@ -370,6 +391,28 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep);
  *\li   #ISC_R_NOMEMORY Resource Limit: Out of Memory
  */
 
+isc_result_t
+dns_rbt_addnodefrom(dns_rbt_t *rbt, dns_rbtnode_t *finger,
+		    const dns_name_t *name, dns_rbtnode_t **nodep);
+/*%<
+ * Just like dns_rbt_addnode, but first try to add 'name' right after
+ * 'finger', which is typically the node that was added last.  When
+ * names are added in DNSSEC canonical order, as in a sorted zone file
+ * or a zone transfer, that is almost always where they belong, and
+ * the search from the top of the tree of trees is skipped.  If 'name'
+ * does not go next to 'finger', or 'finger' is NULL, the tree is
+ * searched as usual.
+ *
+ * Requires:
+ *\li   rbt is a valid rbt structure.
+ *\li   'finger' is NULL or a node that is in 'rbt'.
+ *\li   dns_name_isabsolute(name) == TRUE
+ *\li   nodep != NULL && *nodep == NULL
+ *
+ * Returns:
+ *\li   As for dns_rbt_addnode().
+ */
+
 isc_result_t
 dns_rbt_findname(dns_rbt_t *rbt, const dns_name_t *name, unsigned int options,
 		 dns_name_t *foundname, void **data);
@@ -671,6 +714,83 @@ dns_rbt_hashsize(dns_rbt_t *rbt);
  * \li  rbt is a valid rbt manager.
  */
 
+void
+dns_rbt_setrehashaction(dns_rbt_t *rbt, void (*action)(void *), void *arg);
+/*%<
+ * Take over rehashing the 'rbt' hash table.
+ *
+ * By default, when adding a node makes the hash table too full, a
+ * larger table is allocated and the buckets of the old one are moved
+ * to it one at a time, each time another node is added.  If 'action'
+ * is not NULL, adding nodes no longer does any of this; instead
+ * 'action' is called with 'arg' the first time the table needs to
+ * grow, from within dns_rbt_addnode() or dns_rbt_addname(), and the
+ * caller is then expected to call dns_rbt_rehash() until it returns
+ * ISC_R_SUCCESS.  Lookups find nodes in either table until then.
+ *
+ * 'action' must not call back into the RBT library.
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager.
+ */
+
+isc_result_t
+dns_rbt_rehash(dns_rbt_t *rbt, unsigned int quantum);
+/*%<
+ * Grow the 'rbt' hash table if it is too full, and move up to
+ * 'quantum' buckets from the old table to the new one.  The caller
+ * must have exclusive access to 'rbt', as for dns_rbt_addnode().
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager.
+ * \li  'quantum' is greater than zero.
+ *
+ * Returns:
+ * \li  ISC_R_SUCCESS if no rehash is in progress any longer.
+ * \li  ISC_R_QUOTA if 'quantum' buckets have been moved and more remain.
+ */
+
+void
+dns_rbt_sizehint(dns_rbt_t *rbt, size_t count);
+/*%<
+ * Grow the 'rbt' hash table at once to the size it would reach by
+ * itself once 'count' nodes have been added, so that loading that
+ * many names does not go through every intermediate size.  The table
+ * is never made smaller.  The caller must have exclusive access to
+ * 'rbt', as for dns_rbt_addnode().
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager.
+ */
+
+void
+dns_rbt_setshard(dns_rbt_t *rbt, unsigned int shard);
+/*%<
+ * Set the value stored in the 'shard' field of every node that 'rbt'
+ * creates from now on.  It is 0 unless set; the tree itself does not
+ * use it, but a database made of several trees can use it to find the
+ * tree a node belongs to.
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager.
+ *
+ * \li  shard <= UINT8_MAX.
+ */
+
+void
+dns_rbt_setfullnames(dns_rbt_t *rbt);
+/*%<
+ * Make 'rbt' store the absolute name of every node it creates from now
+ * on, so that dns_rbt_findnode(), dns_rbt_fullnamefromnode() and the
+ * node chain functions can copy a node's name instead of assembling it
+ * from the labels stored along its path.  This costs a copy of each
+ * name, and so is meant for trees that are searched far more often
+ * than they grow, such as authoritative zone data.
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager with no nodes.
+ */
+
 void
 dns_rbt_destroy(dns_rbt_t **rbtp);
 isc_result_t
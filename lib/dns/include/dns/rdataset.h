@@ -581,9 +581,12 @@ dns_rdataset_addglue(dns_rdataset_t *rdataset, dns_dbversion_t *version,
  * In case a successful result is not returned, the caller should try to
  * add glue directly to the message by iterating for additional data.
  *
+ * For an rdataset from a cache database, 'version' is ignored and the
+ * addresses of the NS targets are taken from the cache.
+ *
  * Requires:
  * \li	'rdataset' is a valid NS rdataset.
- * \li	'version' is the DB version.
+ * \li	'version' is the DB version, or NULL for a cache database.
  * \li	'msg' is the DNS message to which the glue should be added.
  *
  * Returns:
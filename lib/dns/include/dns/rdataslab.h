@@ -85,6 +85,19 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
  *\li	XXX others
  */
 
+typedef void *(*dns_rdataslab_alloc_t)(void *arg, unsigned int size);
+
+isc_result_t
+dns_rdataslab_fromrdatasetalloc(dns_rdataset_t *rdataset, isc_mem_t *mctx,
+				isc_region_t *region, unsigned int reservelen,
+				dns_rdataslab_alloc_t alloc, void *arg);
+/*%<
+ * Like dns_rdataslab_fromrdataset(), but if 'alloc' is not NULL the
+ * slab is allocated by calling it with 'arg' and the size needed, and
+ * 'mctx' is only used for temporary memory.  The caller is then
+ * responsible for releasing the slab in the matching way.
+ */
+
 unsigned int
 dns_rdataslab_size(unsigned char *slab, unsigned int reservelen);
 /*%<
@@ -178,6 +178,9 @@ dns_resolver_create(dns_view_t *view, isc_taskmgr_t *taskmgr,
  *\li	Generally, applications should not create a resolver directly, but
  *	should instead call dns_view_createresolver().
  *
+ *\li	Fetch contexts are kept in at least 'ntasks' buckets, each with
+ *	its own lock; the buckets share 'ntasks' tasks.
+ *
  * Requires:
  *
  *\li	'view' is a valid view.
@@ -241,6 +244,32 @@ dns_resolver_prime(dns_resolver_t *res);
  *\li	'res' is a valid, frozen resolver.
  */
 
+void
+dns_resolver_addprimename(dns_resolver_t *res, const dns_name_t *name);
+/*%<
+ * Add 'name' to the names whose NS, DS and DNSKEY records are fetched,
+ * in parallel, each time the resolver has successfully been primed.
+ * For the root name only the DNSKEY records are fetched.
+ *
+ * Requires:
+ *
+ *\li	'res' is a valid resolver that is not frozen.
+ *
+ *\li	'name' is an absolute name.
+ */
+
+void
+dns_resolver_primenames(dns_resolver_t *res);
+/*%<
+ * If names were added with dns_resolver_addprimename(), prime the
+ * resolver now, so that they are fetched without waiting for the
+ * first query that needs the root.
+ *
+ * Requires:
+ *
+ *\li	'res' is a valid, frozen resolver.
+ */
+
 void
 dns_resolver_whenshutdown(dns_resolver_t *res, isc_task_t *task,
 			  isc_event_t **eventp);
@@ -601,6 +630,41 @@ dns_resolver_setnonbackofftries(dns_resolver_t *resolver, unsigned int tries);
  * \li  tries > 0.
  */
 
+unsigned int
+dns_resolver_getracethreshold(dns_resolver_t *resolver);
+
+void
+dns_resolver_setracethreshold(dns_resolver_t *resolver, unsigned int threshold);
+/*%<
+ * Sets the estimated 90th percentile round trip time, in milliseconds,
+ * above which a query to a server is raced against the same query to
+ * the next best server (when not forwarding).  The first answer is
+ * used and the other query is canceled.  0 (the default) disables
+ * racing; larger values are silently capped at 9000 ms.
+ *
+ * Requires:
+ * \li	resolver to be valid.
+ */
+
+void
+dns_resolver_setsharedfetches(dns_resolver_t *resolver, dns_resolver_t *peer);
+/*%<
+ * Make 'resolver' join fetches that are already running in 'peer'
+ * instead of starting identical ones, so that views sharing a cache
+ * send a single upstream query for the same name and type.  Fetches
+ * with explicit nameservers or DNS_FETCHOPT_UNSHARED are never joined.
+ *
+ * The answer is taken as 'peer' resolves it, so this should only be
+ * used when both views resolve identically (the same forwarders,
+ * trust anchors, and server settings).
+ *
+ * Requires:
+ * \li	resolver and peer to be valid, and distinct.
+ * \li	resolver is not frozen.
+ * \li	peer does not share fetches with another resolver itself.
+ * \li	both resolvers' views use the same cache.
+ */
+
 unsigned int
 dns_resolver_getoptions(dns_resolver_t *resolver);
 /*%<
@@ -686,6 +750,20 @@ dns_resolver_getmaxqueries(dns_resolver_t *resolver);
  * \li	resolver to be valid.
  */
 
+void
+dns_resolver_setprefetchpopular(dns_resolver_t *resolver, unsigned int count);
+/*%<
+ * Set the number of popular cached rdatasets refreshed every second
+ * before they expire.  Once a second, the resolver starts fetches for
+ * the 'count' rdatasets of the view's cache that were looked up the
+ * most (at least twice) among those that expire within the view's
+ * prefetch trigger and are eligible for prefetching, less the number
+ * of such fetches still running.  0 (the default) disables this.
+ *
+ * Requires:
+ * \li	resolver to be valid.
+ */
+
 void
 dns_resolver_setquotaresponse(dns_resolver_t *resolver, dns_quotatype_t which,
 			      isc_result_t resp);
@@ -128,6 +128,23 @@ struct dns_rpz_triggers {
 	dns_rpz_trigger_counter_t nsipv6;
 };
 
+/*
+ * A cached result of a name trigger lookup.
+ */
+typedef struct dns_rpz_namecache dns_rpz_namecache_t;
+struct dns_rpz_namecache {
+	uint64_t	gen;
+	dns_rpz_zbits_t found;
+	dns_rpz_type_t	type;
+	unsigned int	length;
+	unsigned char	ndata[DNS_NAME_MAXWIRE];
+};
+
+/*
+ * Number of entries in each thread's table of name trigger lookups.
+ */
+#define DNS_RPZ_NAMECACHE_SIZE 512
+
 /*
  * A single response policy zone.
  */
@@ -151,7 +168,6 @@ struct dns_rpz_zone {
 	dns_rpz_policy_t policy; /* DNS_RPZ_POLICY_GIVEN or override */
 
 	uint32_t  min_update_interval;	/* minimal interval between updates */
-	isc_ht_t *nodes;		/* entries in zone */
 	dns_rpz_zones_t *rpzs;		/* owner */
 	isc_time_t	 lastupdated;	/* last time the zone was processed */
 	bool		 updatepending; /* there is an update pending */
@@ -164,6 +180,9 @@ struct dns_rpz_zone {
 	bool		 addsoa;	/* add soa to the additional section */
 	isc_timer_t	*updatetimer;
 	isc_event_t	 updateevent;
+	char		*journal;	/* zone's journal file, if any */
+	dns_db_t	*lastdb;	/* database last processed */
+	dns_dbversion_t *lastversion;	/* version last processed */
 };
 
 /*
@@ -271,6 +290,15 @@ struct dns_rpz_zones {
 	dns_rpz_cidr_node_t *cidr;
 	dns_rbt_t	    *rbt;
 
+	/*
+	 * Results of recent name trigger lookups, one table per network
+	 * manager thread.  'namegen' is bumped under 'search_lock' when
+	 * the summary data changes, invalidating them all.
+	 */
+	dns_rpz_namecache_t *namecache;
+	unsigned int	     nnamecaches;
+	uint64_t	     namegen;
+
 	/*
 	 * DNSRPZ librpz configuration string and handle on librpz connection
 	 */
@@ -401,6 +429,16 @@ dns_rpz_new_zone(dns_rpz_zones_t *rpzs, dns_rpz_zone_t **rpzp);
 isc_result_t
 dns_rpz_dbupdate_callback(dns_db_t *db, void *fn_arg);
 
+void
+dns_rpz_setjournal(dns_rpz_zone_t *rpz, const char *journal);
+/*%<
+ * Tell 'rpz' the name of its zone's journal file, or NULL if there is
+ * none.  When a new version of the zone follows the last one processed
+ * and the journal holds the changes between them, the summary data is
+ * updated from the names in those changes instead of by walking the
+ * whole zone.
+ */
+
 void
 dns_rpz_zones_shutdown(dns_rpz_zones_t *rpzs);
 
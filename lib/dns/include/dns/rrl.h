@@ -192,6 +192,12 @@ struct dns_rrl_rate {
 	const char *str;
 };
 
+/*
+ * Tables of at least twice this many entries are split into shards.
+ */
+#define DNS_RRL_SHARD_ENTRIES 1000
+#define DNS_RRL_MAX_SHARDS    16
+
 /*
  * Per-view query rate limit parameters and a pointer to database.
  */
@@ -246,6 +252,14 @@ struct dns_rrl {
 	ISC_LIST(dns_rrl_qname_buf_t) qname_free;
 #define DNS_RRL_QNAMES (1 << DNS_RRL_QNAMES_BITS)
 	dns_rrl_qname_buf_t *qnames[DNS_RRL_QNAMES];
+
+	/*
+	 * Large tables are split by client address into shards with
+	 * their own locks.  Each shard is a dns_rrl_t with a copy of the
+	 * parameters above.
+	 */
+	int	   nshards;
+	dns_rrl_t *shards[DNS_RRL_MAX_SHARDS];
 };
 
 typedef enum {
@@ -260,10 +274,35 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	const dns_name_t *qname, isc_result_t resp_result, isc_stdtime_t now,
 	bool wouldlog, char *log_buf, unsigned int log_buf_len);
 
+bool
+dns_rrl_dropping(dns_view_t *view, const isc_sockaddr_t *client_addr,
+		 isc_stdtime_t now);
+/*%<
+ * Return true if the all-per-second limit of the view is already
+ * dropping every response to 'client_addr', whatever the response,
+ * and debit the limit for this request as dns_rrl() would.  The
+ * caller can then drop the request without working out a response.
+ * Always false if the limits only log.
+ *
+ * A false result debits nothing; the response should be passed to
+ * dns_rrl() as usual.
+ */
+
 void
 dns_rrl_view_destroy(dns_view_t *view);
 
 isc_result_t
 dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries);
 
+isc_result_t
+dns_rrl_shard(dns_rrl_t *rrl, int min_entries);
+/*%<
+ * Split the table of 'rrl' into shards, each holding the entries for
+ * a subset of client addresses under its own lock, so that queries
+ * from different clients are rate limited in parallel.  The shards
+ * share 'max_entries' between them.  Small tables are left alone.
+ *
+ * Call this once the parameters of 'rrl' are set.
+ */
+
 ISC_LANG_ENDDECLS
@@ -198,6 +198,28 @@ typedef isc_result_t (*dns_sdlzlookupfunc_t)(const char *zone, const char *name,
  * from the caller.
  */
 
+typedef void (*dns_sdlzlookupdone_t)(void *arg, isc_result_t result);
+
+typedef isc_result_t (*dns_sdlzlookupasyncfunc_t)(
+	const char *zone, const char *name, void *driverarg, void *dbdata,
+	dns_sdlzlookup_t *lookup, dns_clientinfomethods_t *methods,
+	dns_clientinfo_t *clientinfo, dns_sdlzlookupdone_t done, void *arg);
+
+/*%<
+ * Method prototype.  Drivers implementing the SDLZ interface may
+ * supply an asynchronous lookup method.  It starts the same lookup as
+ * the lookup method and returns without waiting for the backend.  The
+ * records are then put into 'lookup', from any thread, after which
+ * 'done' is called exactly once with 'arg' and the result the lookup
+ * method would have returned.  'methods' and 'clientinfo' may only be
+ * used before this method returns.  The driver lock is not held when
+ * 'done' is called, so the driver must serialize its own completions.
+ *
+ * If this method returns anything other than ISC_R_SUCCESS, 'done' is
+ * not called; ISC_R_NOTIMPLEMENTED stops further asynchronous lookups
+ * from being tried on the database.
+ */
+
 typedef isc_result_t (*dns_sdlznewversion_t)(const char *zone, void *driverarg,
 					     void *dbdata, void **versionp);
 /*%<
@@ -287,6 +309,7 @@ typedef struct dns_sdlzmethods {
 	dns_sdlzmodrdataset_t	addrdataset;
 	dns_sdlzmodrdataset_t	subtractrdataset;
 	dns_sdlzdelrdataset_t	delrdataset;
+	dns_sdlzlookupasyncfunc_t lookupasync;
 } dns_sdlzmethods_t;
 
 isc_result_t
@@ -353,4 +376,36 @@ dns_sdlz_setdb_t dns_sdlz_setdb;
  * Create the database pointers for a writeable SDLZ zone
  */
 
+bool
+dns_sdlz_canlookupasync(dns_db_t *db, const dns_name_t *name);
+/*%<
+ * Return true if 'db' is an SDLZ database whose driver may look up
+ * 'name' asynchronously, and whose answer for 'name' is not already
+ * cached.  An asynchronous lookup is only useful when its answer can
+ * be cached for the synchronous lookup that follows it.
+ */
+
+isc_result_t
+dns_sdlz_lookupasync(dns_db_t *db, const dns_name_t *name,
+		     dns_clientinfomethods_t *methods,
+		     dns_clientinfo_t *clientinfo, dns_sdlzlookupdone_t done,
+		     void *arg);
+/*%<
+ * Start an asynchronous lookup of 'name' in 'db', whose answer is
+ * added to the lookup cache; 'done' is then called with 'arg', from
+ * any thread.  Wildcards are not looked up.
+ *
+ * Requires:
+ *\li	'db' is an SDLZ database.
+ *\li	'name' is at or below the origin of 'db'.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS, and 'done' will be called.
+ *\li	#ISC_R_EXISTS if the answer is already cached.
+ *\li	#ISC_R_DISABLED if answers from 'db' are not cached.
+ *\li	#ISC_R_NOTIMPLEMENTED if the driver has no asynchronous lookup.
+ *
+ * 'done' is not called unless #ISC_R_SUCCESS is returned.
+ */
+
 ISC_LANG_ENDDECLS
@@ -72,7 +72,15 @@ enum {
 	dns_resstatscounter_clientquota = 43,
 	dns_resstatscounter_nextitem = 44,
 	dns_resstatscounter_priming = 45,
-	dns_resstatscounter_max = 46,
+	dns_resstatscounter_prefetchpopular = 46,
+	dns_resstatscounter_queryrace = 47,
+	dns_resstatscounter_bucketwait = 48,
+	dns_resstatscounter_bucketchain = 49,
+	dns_resstatscounter_dispsockreuse = 50,
+	dns_resstatscounter_tcpreuse = 51,
+	dns_resstatscounter_sharedfetch = 52,
+	dns_resstatscounter_valcached = 53,
+	dns_resstatscounter_max = 54,
 
 	/*
 	 * DNSSEC stats.
@@ -123,8 +131,15 @@ enum {
 	dns_cachestatscounter_deletelru = 5,
 	dns_cachestatscounter_deletettl = 6,
 	dns_cachestatscounter_coveringnsec = 7,
+	dns_cachestatscounter_rehashes = 8,
+	dns_cachestatscounter_rehashtime = 9,
+	dns_cachestatscounter_rehashslicemax = 10,
+	dns_cachestatscounter_promotions = 11,
+	dns_cachestatscounter_deleteprotected = 12,
+	dns_cachestatscounter_sweepdeleted = 13,
+	dns_cachestatscounter_sweeprate = 14,
 
-	dns_cachestatscounter_max = 8,
+	dns_cachestatscounter_max = 15,
 
 	/*%
 	 * Query statistics counters (obsolete).
@@ -552,6 +567,24 @@ dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
  *\li	anything else	-- failure
  */
 
+isc_result_t
+dns_rdatatypestats_create_sharded(isc_mem_t *mctx, dns_stats_t **statsp);
+/*%<
+ * Like dns_rdatatypestats_create(), but with counters created by
+ * isc_stats_create_sharded(), for server-wide statistics updated for
+ * every query.
+ *
+ * Requires:
+ *\li	'mctx' must be a valid memory context.
+ *
+ *\li	'statsp' != NULL && '*statsp' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS	-- all ok
+ *
+ *\li	anything else	-- failure
+ */
+
 isc_result_t
 dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 /*%<
@@ -572,6 +605,7 @@ isc_result_t
 dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 /*%<
  * Create a statistics counter structure per opcode.
+ * The counters are sharded per thread; see isc_stats_create_sharded().
  *
  * Requires:
  *\li	'mctx' must be a valid memory context.
@@ -588,6 +622,7 @@ isc_result_t
 dns_rcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 /*%<
  * Create a statistics counter structure per assigned rcode.
+ * The counters are sharded per thread; see isc_stats_create_sharded().
  *
  * Requires:
  *\li	'mctx' must be a valid memory context.
@@ -17,6 +17,7 @@
 
 #include <stdbool.h>
 
+#include <isc/ht.h>
 #include <isc/lang.h>
 #include <isc/refcount.h>
 #include <isc/rwlock.h>
@@ -54,7 +55,7 @@ extern const dns_name_t *dns_tsig_hmacsha512_name;
 #define DNS_TSIG_FUDGE 300
 
 struct dns_tsig_keyring {
-	dns_rbt_t   *keys;
+	isc_ht_t    *keys;
 	unsigned int writecount;
 	isc_rwlock_t lock;
 	isc_mem_t   *mctx;
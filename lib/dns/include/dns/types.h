@@ -31,6 +31,7 @@
 typedef struct dns_acl	       dns_acl_t;
 typedef struct dns_aclelement  dns_aclelement_t;
 typedef struct dns_aclenv      dns_aclenv_t;
+typedef struct dns_aclindex    dns_aclindex_t;
 typedef struct dns_adb	       dns_adb_t;
 typedef struct dns_adbaddrinfo dns_adbaddrinfo_t;
 typedef ISC_LIST(dns_adbaddrinfo_t) dns_adbaddrinfolist_t;
@@ -59,6 +60,8 @@ typedef struct dns_dbiterator	       dns_dbiterator_t;
 typedef void			       dns_dbload_t;
 typedef void			       dns_dbnode_t;
 typedef struct dns_dbonupdatelistener  dns_dbonupdatelistener_t;
+typedef struct dns_dbdomainusage       dns_dbdomainusage_t;
+typedef struct dns_dbpopular	       dns_dbpopular_t;
 typedef void			       dns_dbversion_t;
 typedef struct dns_dlzimplementation   dns_dlzimplementation_t;
 typedef struct dns_dlzdb	       dns_dlzdb_t;
@@ -82,6 +85,7 @@ typedef struct dns_dtmsg	   dns_dtmsg_t;
 typedef uint16_t		   dns_dtmsgtype_t;
 typedef struct dns_dumpctx	   dns_dumpctx_t;
 typedef struct dns_ecs		   dns_ecs_t;
+typedef struct dns_ecscache	   dns_ecscache_t;
 typedef struct dns_ednsopt	   dns_ednsopt_t;
 typedef struct dns_fetch	   dns_fetch_t;
 typedef struct dns_fixedname	   dns_fixedname_t;
@@ -188,6 +192,11 @@ typedef enum {
 	dns_dbtree_nsec3 = 2
 } dns_dbtree_t;
 
+typedef enum {
+	dns_cachepolicy_lru = 0,
+	dns_cachepolicy_slru = 1
+} dns_cachepolicy_t;
+
 typedef enum {
 	dns_notifytype_no = 0,
 	dns_notifytype_yes = 1,
@@ -53,6 +53,7 @@
 #include <isc/mutex.h>
 
 #include <dns/fixedname.h>
+#include <dns/rdata.h>
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h> /* for dns_rdata_rrsig_t */
 #include <dns/types.h>
@@ -143,6 +144,10 @@ struct dns_validator {
 	dns_fixedname_t	      fname;
 	dns_fixedname_t	      wild;
 	dns_fixedname_t	      closest;
+	dns_fixedname_t	      vwild;   /*%< for an offloaded verify */
+	dns_rdata_t	      vsig;    /*%< for an offloaded verify */
+	isc_result_t	      vresult; /*%< of an offloaded verify */
+	isc_event_t	      vevent;  /*%< resumes an offloaded verify */
 	ISC_LINK(dns_validator_t) link;
 	bool	      mustbesecure;
 	unsigned int  depth;
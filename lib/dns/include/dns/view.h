@@ -110,6 +110,7 @@ struct dns_view {
 	isc_stats_t *adbstats;
 	isc_stats_t *resstats;
 	dns_stats_t *resquerystats;
+	isc_stats_t *latencystats;
 	bool	     cacheshared;
 
 	/* Configurable data. */
@@ -125,6 +126,7 @@ struct dns_view {
 	bool		      auth_nxdomain;
 	bool		      use_glue_cache;
 	bool		      minimal_any;
+	bool		      sortadditional;
 	dns_minimaltype_t     minimalresponses;
 	bool		      enablevalidation;
 	bool		      acceptexpired;
@@ -238,6 +240,10 @@ struct dns_view {
 	dns_dtenv_t    *dtenv;	 /* Dnstap environment */
 	dns_dtmsgtype_t dttypes; /* Dnstap message types
 				  * to log */
+	uint32_t	 dtsample;  /* Log 1 in 'dtsample' transactions */
+	dns_rdatatype_t *dtqtypes;  /* If not NULL, only log these
+				     * query types */
+	unsigned int	 dtnqtypes; /* Number of 'dtqtypes' */
 
 	/* Registered module instances */
 	void *plugins;
@@ -246,6 +252,10 @@ struct dns_view {
 	/* Hook table */
 	void *hooktable; /* ns_hooktable */
 	void (*hooktable_free)(isc_mem_t *, void **);
+
+	/* Rendered authoritative responses */
+	void *answercache; /* ns_answercache */
+	void (*answercache_free)(isc_mem_t *, void **);
 };
 
 #define DNS_VIEW_MAGIC	     ISC_MAGIC('V', 'i', 'e', 'w')
@@ -420,6 +430,31 @@ dns_view_createresolver(dns_view_t *view, isc_taskmgr_t *taskmgr,
  *\li	Any error that dns_resolver_create() can return.
  */
 
+isc_result_t
+dns_view_attachresolver(dns_view_t *view, dns_view_t *source);
+/*%<
+ * Make 'view' use the resolver, address database and request manager
+ * of 'source' instead of creating its own.  'view' does not shut them
+ * down: they keep working for as long as 'source' does.
+ *
+ * This is only correct if both views resolve names identically; in
+ * particular, the resolver looks names up in the forwarding table,
+ * trust anchors and cache of 'source'.
+ *
+ * Requires:
+ *
+ *\li	'view' is a valid, unfrozen view without a resolver.
+ *
+ *\li	'source' is a valid view of the same class.
+ *
+ * Returns:
+ *
+ *\li   	#ISC_R_SUCCESS
+ *
+ *\li	#ISC_R_SHUTTINGDOWN if 'source' has no resolver, or it is shutting
+ *	down.
+ */
+
 void
 dns_view_setcache(dns_view_t *view, dns_cache_t *cache, bool shared);
 /*%<
@@ -1102,6 +1137,32 @@ dns_view_getresquerystats(dns_view_t *view, dns_stats_t **statsp);
  *\li	'statsp' != NULL && '*statsp' != NULL
  */
 
+void
+dns_view_setlatencystats(dns_view_t *view, isc_stats_t *stats);
+/*%<
+ * Set a query latency statistics counter set 'stats' for 'view'.  Once the
+ * statistic set is installed, the time spent in each stage of processing
+ * the view's queries is counted.
+ *
+ * Requires:
+ * \li	'view' is valid and is not frozen.
+ *
+ *\li	stats is a valid statistics created by ns_latencystats_create().
+ */
+
+void
+dns_view_getlatencystats(dns_view_t *view, isc_stats_t **statsp);
+/*%<
+ * Get the query latency statistics counter set for 'view'.  If a statistics
+ * set is set '*statsp' will be attached to the set; otherwise, '*statsp'
+ * will be untouched.
+ *
+ * Requires:
+ * \li	'view' is valid.
+ *
+ *\li	'statsp' != NULL && '*statsp' != NULL
+ */
+
 bool
 dns_view_iscacheshared(dns_view_t *view);
 /*%<
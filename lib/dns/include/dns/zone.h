@@ -99,6 +99,8 @@ typedef enum {
 	DNS_ZONEOPT_CHECKSPF = 1 << 27,		/*%< check SPF records */
 	DNS_ZONEOPT_CHECKTTL = 1 << 28,		/*%< check max-zone-ttl */
 	DNS_ZONEOPT_AUTOEMPTY = 1 << 29,	/*%< automatic empty zone */
+	DNS_ZONEOPT_CONDENSEIXFR = 1 << 30,	/*%< condense-ixfr */
+	DNS_ZONEOPT_COMPACTDENIAL = 1ULL << 31, /*%< compact-denial */
 	DNS_ZONEOPT___MAX = UINT64_MAX, /* trick to make the ENUM 64-bit wide */
 } dns_zoneopt_t;
 
@@ -589,6 +591,19 @@ dns_zone_refresh(dns_zone_t *zone);
  *\li	'zone' to be a valid zone.
  */
 
+void
+dns_zone_setprimaryserial(dns_zone_t *zone, uint32_t serial);
+/*%<
+ *	Tell a secondary or mirror zone that its primary is known, by
+ *	other means than an SOA query (e.g. a catalog zone), to serve
+ *	'serial'.  If 'serial' is newer than the zone's, a refresh is
+ *	started; if it is the same, the next refresh check is scheduled
+ *	as if one had just succeeded.  Otherwise nothing is done.
+ *
+ * Require
+ *\li	'zone' to be a valid zone.
+ */
+
 isc_result_t
 dns_zone_flush(dns_zone_t *zone);
 /*%<
@@ -1234,6 +1249,81 @@ dns_zone_getjournalsize(dns_zone_t *zone);
  *\li	'zone' to be a valid zone.
  */
 
+void
+dns_zone_setjournaldelay(dns_zone_t *zone, uint32_t delay);
+uint32_t
+dns_zone_getjournaldelay(dns_zone_t *zone);
+/*%<
+ *	Set/get the time, in milliseconds, for which transactions written
+ *	by dns_zone_writejournal() may wait to be synced to disk together
+ *	with the ones that follow them.  Zero (the default) syncs each
+ *	transaction as it is written.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ */
+
+isc_result_t
+dns_zone_writejournal(dns_zone_t *zone, dns_diff_t *diff);
+/*%<
+ *	Write 'diff' to the journal of 'zone' as a single transaction.
+ *
+ *	If a journal delay is set, the transaction is synced when the
+ *	delay started by the first unsynced transaction expires, or
+ *	earlier if the journal is needed for something else; use
+ *	dns_zone_sendaftersync() to find out when.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'diff' is a complete transaction, as for
+ *	dns_journal_write_transaction().
+ */
+
+void
+dns_zone_queueupdate(dns_zone_t *zone, isc_event_t **eventp);
+/*%<
+ *	Send the dynamic update event '*eventp' to the task of 'zone', or,
+ *	if an update sent there has not yet taken the updates queued
+ *	behind it, queue it to be taken with them.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone that is managed by a zone manager.
+ *\li	'eventp' points to a valid event.
+ *
+ * Ensures:
+ *\li	'*eventp' is NULL.
+ */
+
+void
+dns_zone_takeupdates(dns_zone_t *zone, unsigned int max,
+		     isc_eventlist_t *events);
+/*%<
+ *	Move up to 'max' of the events queued by dns_zone_queueupdate() to
+ *	'events', so that they can be processed together.  This must be
+ *	called by the handler of each update event sent to the zone task;
+ *	if more events remain, the first of them is sent there in turn.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'events' is a valid list.
+ */
+
+void
+dns_zone_sendaftersync(dns_zone_t *zone, isc_task_t *task,
+		       isc_event_t **eventp);
+/*%<
+ *	Send '*eventp' to 'task' once all the transactions written to
+ *	the journal of 'zone' by dns_zone_writejournal() so far have been
+ *	synced, which may be immediately.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'eventp' points to a valid event.
+ *
+ * Ensures:
+ *\li	'*eventp' is NULL.
+ */
+
 isc_result_t
 dns_zone_notifyreceive(dns_zone_t *zone, isc_sockaddr_t *from,
 		       isc_sockaddr_t *to, dns_message_t *msg);
@@ -2200,6 +2290,52 @@ dns_zone_getsignatures(dns_zone_t *zone);
  * Get the number of signatures that will be generated per quantum.
  */
 
+void
+dns_zone_setsigningthreads(dns_zone_t *zone, uint32_t threads);
+/*%<
+ * Set the number of threads that generate signatures in parallel when
+ * signing the zone with a new key, between 1 and 64.  Each thread
+ * generates up to the number of signatures set with
+ * dns_zone_setsignatures() per quantum.  The same threads compute
+ * the NSEC3 hashes of owner names when building a new NSEC3 chain.
+ */
+
+void
+dns_zone_setresigningrate(dns_zone_t *zone, uint32_t rate);
+/*%<
+ * Set the maximum number of RRsets per second that incremental
+ * re-signing of the zone may re-sign.  0 means no limit.
+ */
+
+#define DNS_ZONE_DENIALMAXSIGS 4
+
+isc_result_t
+dns_zone_signdenial(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
+		    const dns_name_t *name, dns_rdataset_t *rdataset,
+		    isc_buffer_t *buffer, dns_rdata_t *sigs,
+		    unsigned int *nsigsp);
+/*%<
+ * Sign 'rdataset', an NSEC RRset owned by 'name' that was synthesized
+ * to answer a query with compact denial of existence, with the active
+ * zone-signing keys of 'zone', storing up to DNS_ZONE_DENIALMAXSIGS
+ * RRSIG records in 'sigs' and their data in 'buffer'.
+ *
+ * The keys are loaded from the key directory at most once an hour,
+ * and the signatures of recently synthesized records are cached until
+ * they are due for re-signing.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'rdataset' to be a valid NSEC rdataset.
+ *\li	'sigs' to point to an array of DNS_ZONE_DENIALMAXSIGS rdata.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND	if the zone has no active zone-signing key.
+ *\li	#ISC_R_NOSPACE	if 'buffer' is too small.
+ *\li	Other errors are possible.
+ */
+
 isc_result_t
 dns_zone_signwithkey(dns_zone_t *zone, dns_secalg_t algorithm, uint16_t keyid,
 		     bool deleteit);
@@ -2308,6 +2444,30 @@ dns_zone_getautomatic(dns_zone_t *zone);
  * \li	'zone' to be valid.
  */
 
+#define DNS_ZONE_CFGDIGEST_LENGTH 32
+
+void
+dns_zone_setcfgdigest(dns_zone_t *zone, const unsigned char *digest);
+/*%
+ * Record an opaque digest, DNS_ZONE_CFGDIGEST_LENGTH bytes long, of the
+ * configuration the zone was last set up from; if 'digest' is NULL,
+ * forget it.
+ *
+ * Requires:
+ * \li	'zone' to be valid.
+ */
+
+bool
+dns_zone_cfgdigestmatch(dns_zone_t *zone, const unsigned char *digest);
+/*%
+ * Returns true if 'digest' matches the one last recorded with
+ * dns_zone_setcfgdigest().
+ *
+ * Requires:
+ * \li	'zone' to be valid.
+ * \li	'digest' is not NULL.
+ */
+
 isc_result_t
 dns_zone_dlzpostload(dns_zone_t *zone, dns_db_t *db);
 /*%
@@ -419,6 +419,31 @@ dst_key_fromnamedfile(const char *filename, const char *dirname, int type,
  * \li	If successful, *keyp will contain a valid key.
  */
 
+isc_result_t
+dst_key_privatefiles(const char *directory, const char *name,
+		     isc_mem_t *mctx, isc_buffer_t **filesp);
+/*%<
+ * Find the private key files "K<name>+<alg>+<id>.private" in
+ * 'directory', comparing 'name' without regard to case.  The listing
+ * of 'directory' is cached and only read again once the directory has
+ * been modified.
+ *
+ * Requires:
+ * \li	"directory" and "name" are not NULL; "name" is the file name text
+ *	of a domain name.
+ * \li	"mctx" is a valid memory context
+ * \li	"filesp" is not NULL and "*filesp" is NULL.
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	ISC_R_NOTFOUND if there are no such files
+ * \li	any other result indicates failure to read 'directory'
+ *
+ * Ensures:
+ * \li	If successful, *filesp is a new buffer holding the NUL-terminated
+ *	file names one after the other; free it with isc_buffer_free().
+ */
+
 isc_result_t
 dst_key_read_public(const char *filename, int type, isc_mem_t *mctx,
 		    dst_key_t **keyp);
@@ -495,6 +520,29 @@ dst_key_fromdns(const dns_name_t *name, dns_rdataclass_t rdclass,
  *	pointer in data will be advanced.
  */
 
+isc_result_t
+dst_key_fromdns_cached(const dns_name_t *name, dns_rdataclass_t rdclass,
+		       isc_buffer_t *source, dst_key_t **keyp);
+/*%<
+ * Like dst_key_fromdns(), but the key is looked up in, and added to, a
+ * process-wide cache of parsed public keys, so that a DNSKEY seen again
+ * is not parsed again.  The key returned is shared and must not be
+ * modified; release it with dst_key_free() as usual.
+ *
+ * Requires:
+ * \li	"name" is a valid absolute dns name.
+ * \li	"source" is a valid buffer.  There must be at least 4 bytes available.
+ * \li	"keyp" is not NULL and "*keyp" is NULL.
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	any other result indicates failure
+ *
+ * Ensures:
+ * \li	If successful, *keyp will contain a valid key, and the consumed
+ *	pointer in data will be advanced.
+ */
+
 isc_result_t
 dst_key_todns(const dst_key_t *key, isc_buffer_t *target);
 /*%<
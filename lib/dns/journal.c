@@ -15,6 +15,8 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <isc/dir.h>
@@ -264,6 +266,8 @@ typedef struct {
 
 #define POS_VALID(pos)	    ((pos).offset != 0)
 #define POS_INVALIDATE(pos) ((pos).offset = 0, (pos).serial = 0)
+#define POS_EQUAL(a, b) \
+	((a).serial == (b).serial && (a).offset == (b).offset)
 
 typedef struct {
 	unsigned char format[16];
@@ -328,11 +332,16 @@ struct dns_journal {
 				      *   mode is allowed */
 	bool recovered;		     /*%< A recoverable error was found
 				      *   while reading the journal */
+	bool defersync;		     /*%< Commit writes to the file only
+				      *   when synced */
 	char *filename;		     /*%< Journal file name */
 	FILE *fp;		     /*%< File handle */
+	unsigned char *map;	     /*%< Whole file, when read-only */
+	size_t mapsize;		     /*%< Size of 'map' */
 	isc_offset_t offset;	     /*%< Current file offset */
 	journal_xhdr_t curxhdr;	     /*%< Current transaction header */
 	journal_header_t header;     /*%< In-core journal header */
+	journal_pos_t synced;	     /*%< End of the journal on disk */
 	unsigned char *rawindex;     /*%< In-core buffer for journal index
 				      * in on-disk format */
 	journal_pos_t *index;	     /*%< In-core journal index */
@@ -416,6 +425,11 @@ static isc_result_t
 journal_seek(dns_journal_t *j, uint32_t offset) {
 	isc_result_t result;
 
+	if (j->map != NULL) {
+		j->offset = offset;
+		return (ISC_R_SUCCESS);
+	}
+
 	result = isc_stdio_seek(j->fp, (off_t)offset, SEEK_SET);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
@@ -431,6 +445,17 @@ static isc_result_t
 journal_read(dns_journal_t *j, void *mem, size_t nbytes) {
 	isc_result_t result;
 
+	if (j->map != NULL) {
+		if ((size_t)j->offset > j->mapsize ||
+		    j->mapsize - (size_t)j->offset < nbytes)
+		{
+			return (ISC_R_NOMORE);
+		}
+		memmove(mem, j->map + j->offset, nbytes);
+		j->offset += (isc_offset_t)nbytes;
+		return (ISC_R_SUCCESS);
+	}
+
 	result = isc_stdio_read(mem, 1, nbytes, j->fp, NULL);
 	if (result != ISC_R_SUCCESS) {
 		if (result == ISC_R_EOF) {
@@ -660,6 +685,29 @@ journal_open(isc_mem_t *mctx, const char *filename, bool writable, bool create,
 
 	j->fp = fp;
 
+	/*
+	 * A journal opened for reading is mapped, so that reading it
+	 * takes no system calls; named may append to the file, but only
+	 * the part covered by the header read below is used.  If the
+	 * file can't be mapped, it is read with stdio.
+	 */
+	if (!writable) {
+		struct stat sb;
+
+		if (fstat(fileno(fp), &sb) == 0 && sb.st_size > 0 &&
+		    (uintmax_t)sb.st_size <= SIZE_MAX)
+		{
+			void *map = mmap(NULL, (size_t)sb.st_size, PROT_READ,
+					 MAP_PRIVATE, fileno(fp), 0);
+			if (map != MAP_FAILED) {
+				(void)posix_madvise(map, (size_t)sb.st_size,
+						    POSIX_MADV_SEQUENTIAL);
+				j->map = map;
+				j->mapsize = (size_t)sb.st_size;
+			}
+		}
+	}
+
 	/*
 	 * Set magic early so that seek/read can succeed.
 	 */
@@ -696,6 +744,7 @@ journal_open(isc_mem_t *mctx, const char *filename, bool writable, bool create,
 		FAIL(ISC_R_UNEXPECTED);
 	}
 	journal_header_decode(&rawheader, &j->header);
+	j->synced = j->header.end;
 
 	/*
 	 * If there is an index, read the raw index into a dynamically
@@ -756,6 +805,9 @@ failure:
 			    j->header.index_size * sizeof(journal_pos_t));
 	}
 	isc_mem_free(j->mctx, j->filename);
+	if (j->map != NULL) {
+		(void)munmap(j->map, j->mapsize);
+	}
 	if (j->fp != NULL) {
 		(void)isc_stdio_close(j->fp);
 	}
@@ -791,6 +843,9 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
 		result = journal_open(mctx, backup, writable, writable, false,
 				      journalp);
 	}
+	if (result == ISC_R_SUCCESS && writable) {
+		(*journalp)->defersync = ((mode & DNS_JOURNAL_DEFERSYNC) != 0);
+	}
 	return (result);
 }
 
@@ -1093,6 +1148,282 @@ index_invalidate(dns_journal_t *j, uint32_t serial) {
 	}
 }
 
+/*
+ * The dense index.
+ *
+ * The index in the journal header is sparse, so finding a transaction
+ * means reading transaction headers forward from the closest index
+ * entry.  A separate file next to the journal ("<zone>.jdx") records
+ * the position of every transaction, followed by the end of the
+ * journal, so that any transaction can be found with a binary search.
+ *
+ * The file is only a hint.  It is used if its first position is the
+ * beginning of the journal and it contains the end of the journal,
+ * and every position found in it is checked against the transaction
+ * header stored there.  It is extended as transactions are committed
+ * and rewritten when it does not match the journal.
+ */
+static const char dindex_magic[16] = ";BIND JDX V1\n";
+
+static bool
+dindex_name(const char *filename, char *buf, size_t size) {
+	size_t namelen = strlen(filename);
+	int n;
+
+	if (namelen > 4U && strcmp(filename + namelen - 4, ".jnl") == 0) {
+		namelen -= 4;
+	}
+	n = snprintf(buf, size, "%.*s.jdx", (int)namelen, filename);
+	return (n > 0 && (size_t)n < size);
+}
+
+static isc_result_t
+dindex_read(FILE *fp, uint32_t i, journal_pos_t *pos) {
+	isc_result_t result;
+	journal_rawpos_t raw;
+
+	result = isc_stdio_seek(fp,
+				(off_t)sizeof(dindex_magic) +
+					(off_t)i * sizeof(raw),
+				SEEK_SET);
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_read(&raw, sizeof(raw), 1, fp, NULL);
+	}
+	if (result == ISC_R_SUCCESS) {
+		journal_pos_decode(&raw, pos);
+	}
+	return (result);
+}
+
+/*
+ * Open the dense index file of 'j' and check its header.  Store
+ * the number of positions it holds at '*countp'.
+ */
+static isc_result_t
+dindex_open(dns_journal_t *j, const char *mode, FILE **fpp,
+	    uint32_t *countp) {
+	isc_result_t result;
+	char name[PATH_MAX];
+	char magic[sizeof(dindex_magic)];
+	FILE *fp = NULL;
+	off_t size;
+
+	if (!dindex_name(j->filename, name, sizeof(name))) {
+		return (ISC_R_NOSPACE);
+	}
+	CHECK(isc_stdio_open(name, mode, &fp));
+	CHECK(isc_stdio_read(magic, sizeof(magic), 1, fp, NULL));
+	if (memcmp(magic, dindex_magic, sizeof(magic)) != 0) {
+		CHECK(ISC_R_INVALIDFILE);
+	}
+	CHECK(isc_stdio_seek(fp, 0, SEEK_END));
+	CHECK(isc_stdio_tell(fp, &size));
+	size -= sizeof(magic);
+	if (size % sizeof(journal_rawpos_t) != 0 ||
+	    size / sizeof(journal_rawpos_t) > UINT32_MAX)
+	{
+		CHECK(ISC_R_INVALIDFILE);
+	}
+	*countp = (uint32_t)(size / sizeof(journal_rawpos_t));
+	*fpp = fp;
+	return (ISC_R_SUCCESS);
+
+failure:
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+	}
+	return (result);
+}
+
+/*
+ * Find the first of the 'count' positions in 'fp' whose serial
+ * number is not less than 'serial'; the serial numbers are increasing
+ * from 'base'.
+ */
+static isc_result_t
+dindex_search(FILE *fp, uint32_t count, uint32_t base, uint32_t serial,
+	      journal_pos_t *pos) {
+	isc_result_t result;
+	uint32_t lo = 0, hi = count;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		CHECK(dindex_read(fp, mid, pos));
+		if (pos->serial - base < serial - base) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (lo == count) {
+		return (ISC_R_NOTFOUND);
+	}
+	return (dindex_read(fp, lo, pos));
+
+failure:
+	return (result);
+}
+
+/*
+ * Look up the transaction starting at 'serial' in the dense index.
+ * Returns ISC_R_NOTFOUND if the index matches the journal but has no
+ * such transaction, and another error if the index can't be used.
+ */
+static isc_result_t
+dindex_find(dns_journal_t *j, uint32_t serial, journal_pos_t *pos) {
+	isc_result_t result;
+	FILE *fp = NULL;
+	uint32_t count;
+	journal_pos_t first, end, found;
+	journal_xhdr_t xhdr;
+
+	if (j->header_ver1) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	CHECK(dindex_open(j, "rb", &fp, &count));
+	if (count < 2) {
+		CHECK(ISC_R_INVALIDFILE);
+	}
+	CHECK(dindex_read(fp, 0, &first));
+	if (!POS_EQUAL(first, j->header.begin)) {
+		CHECK(ISC_R_INVALIDFILE);
+	}
+
+	/*
+	 * Positions after the end of the journal as we know it may
+	 * have been added by a writer since the header was read.
+	 */
+	CHECK(dindex_search(fp, count, first.serial, j->header.end.serial,
+			    &end));
+	if (!POS_EQUAL(end, j->header.end)) {
+		CHECK(ISC_R_INVALIDFILE);
+	}
+	CHECK(dindex_search(fp, count, first.serial, serial, &found));
+	if (found.serial != serial) {
+		CHECK(ISC_R_NOTFOUND);
+	}
+
+	/*
+	 * Make sure the position really is the start of that transaction.
+	 */
+	CHECK(journal_seek(j, found.offset));
+	CHECK(journal_read_xhdr(j, &xhdr));
+	if (xhdr.serial0 != serial) {
+		CHECK(ISC_R_INVALIDFILE);
+	}
+
+	*pos = found;
+
+failure:
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+	}
+	return (result);
+}
+
+/*
+ * Write a new dense index for 'j' by reading all of its transaction
+ * headers.
+ */
+static void
+dindex_rebuild(dns_journal_t *j) {
+	isc_result_t result;
+	char name[PATH_MAX];
+	char tmpname[PATH_MAX];
+	FILE *fp = NULL;
+	journal_pos_t pos;
+	journal_rawpos_t raw;
+
+	if (!dindex_name(j->filename, name, sizeof(name))) {
+		return;
+	}
+	result = isc_file_mktemplate(name, tmpname, sizeof(tmpname));
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+	CHECK(isc_file_openunique(tmpname, &fp));
+	CHECK(isc_stdio_write(dindex_magic, sizeof(dindex_magic), 1, fp,
+			      NULL));
+
+	pos = j->header.begin;
+	for (;;) {
+		journal_pos_encode(&raw, &pos);
+		CHECK(isc_stdio_write(&raw, sizeof(raw), 1, fp, NULL));
+		result = journal_next(j, &pos);
+		if (result == ISC_R_NOMORE) {
+			break;
+		}
+		CHECK(result);
+	}
+
+	CHECK(isc_stdio_flush(fp));
+	result = isc_stdio_close(fp);
+	fp = NULL;
+	CHECK(result);
+	CHECK(isc_file_rename(tmpname, name));
+	return;
+
+failure:
+	isc_log_write(JOURNAL_DEBUG_LOGARGS(3),
+		      "%s: unable to write dense index: %s", j->filename,
+		      isc_result_totext(result));
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+	}
+	(void)isc_file_remove(tmpname);
+	(void)isc_file_remove(name);
+}
+
+/*
+ * Record the transactions of 'j' that follow 'from' in the dense
+ * index, rebuilding it if it doesn't end at 'from'.
+ */
+static void
+dindex_add(dns_journal_t *j, const journal_pos_t *from) {
+	isc_result_t result;
+	FILE *fp = NULL;
+	uint32_t count;
+	journal_pos_t first, last, pos;
+	journal_rawpos_t raw;
+
+	if (j->header_ver1) {
+		return;
+	}
+
+	CHECK(dindex_open(j, "rb+", &fp, &count));
+	if (count == 0) {
+		CHECK(ISC_R_INVALIDFILE);
+	}
+	CHECK(dindex_read(fp, 0, &first));
+	CHECK(dindex_read(fp, count - 1, &last));
+	if (!POS_EQUAL(first, j->header.begin) || !POS_EQUAL(last, *from)) {
+		CHECK(ISC_R_INVALIDFILE);
+	}
+	CHECK(isc_stdio_seek(fp, 0, SEEK_END));
+	pos = *from;
+	for (;;) {
+		result = journal_next(j, &pos);
+		if (result == ISC_R_NOMORE) {
+			break;
+		}
+		CHECK(result);
+		journal_pos_encode(&raw, &pos);
+		CHECK(isc_stdio_write(&raw, sizeof(raw), 1, fp, NULL));
+	}
+	result = isc_stdio_close(fp);
+	fp = NULL;
+	CHECK(result);
+	return;
+
+failure:
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+	}
+	dindex_rebuild(j);
+}
+
 /*
  * Try to find a transaction with initial serial number 'serial'
  * in the journal 'j'.
@@ -1130,6 +1461,11 @@ journal_find(dns_journal_t *j, uint32_t serial, journal_pos_t *pos) {
 		return (ISC_R_SUCCESS);
 	}
 
+	result = dindex_find(j, serial, pos);
+	if (result == ISC_R_SUCCESS || result == ISC_R_NOTFOUND) {
+		return (result);
+	}
+
 	current_pos = j->header.begin;
 	index_find(j, serial, &current_pos);
 
@@ -1362,11 +1698,6 @@ dns_journal_commit(dns_journal_t *j) {
 	}
 #endif /* ifdef notyet */
 
-	/*
-	 * Commit the transaction data to stable storage.
-	 */
-	CHECK(journal_fsync(j));
-
 	if (j->state == JOURNAL_STATE_TRANSACTION) {
 		isc_offset_t offset;
 		offset = (j->x.pos[1].offset - j->x.pos[0].offset) -
@@ -1388,15 +1719,53 @@ dns_journal_commit(dns_journal_t *j) {
 		j->header.begin = j->x.pos[0];
 	}
 	j->header.end = j->x.pos[1];
-	journal_header_encode(&j->header, &rawheader);
-	CHECK(journal_seek(j, 0));
-	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
 
 	/*
 	 * Update the index.
 	 */
 	index_add(j, &j->x.pos[0]);
 
+	/*
+	 * We no longer have a transaction open.
+	 */
+	j->state = JOURNAL_STATE_WRITE;
+
+	if (!j->defersync) {
+		CHECK(dns_journal_sync(j));
+	}
+
+	result = ISC_R_SUCCESS;
+
+failure:
+	return (result);
+}
+
+isc_result_t
+dns_journal_sync(dns_journal_t *j) {
+	isc_result_t result;
+	journal_rawheader_t rawheader;
+
+	REQUIRE(DNS_JOURNAL_VALID(j));
+	REQUIRE(j->state == JOURNAL_STATE_WRITE ||
+		j->state == JOURNAL_STATE_TRANSACTION);
+
+	if (POS_EQUAL(j->synced, j->header.end)) {
+		return (ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Commit the transaction data to stable storage before
+	 * the header refers to it.
+	 */
+	CHECK(journal_fsync(j));
+
+	/*
+	 * Update the journal header.
+	 */
+	journal_header_encode(&j->header, &rawheader);
+	CHECK(journal_seek(j, 0));
+	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
+
 	/*
 	 * Convert the index into on-disk format and write
 	 * it to disk.
@@ -1408,10 +1777,8 @@ dns_journal_commit(dns_journal_t *j) {
 	 */
 	CHECK(journal_fsync(j));
 
-	/*
-	 * We no longer have a transaction open.
-	 */
-	j->state = JOURNAL_STATE_WRITE;
+	dindex_add(j, &j->synced);
+	j->synced = j->header.end;
 
 	result = ISC_R_SUCCESS;
 
@@ -1442,6 +1809,12 @@ dns_journal_destroy(dns_journal_t **journalp) {
 	j = *journalp;
 	*journalp = NULL;
 
+	if (j->defersync && (j->state == JOURNAL_STATE_WRITE ||
+			     j->state == JOURNAL_STATE_TRANSACTION))
+	{
+		(void)dns_journal_sync(j);
+	}
+
 	j->it.result = ISC_R_FAILURE;
 	dns_name_invalidate(&j->it.name);
 	dns_decompress_invalidate(&j->it.dctx);
@@ -1462,6 +1835,9 @@ dns_journal_destroy(dns_journal_t **journalp) {
 	if (j->filename != NULL) {
 		isc_mem_free(j->mctx, j->filename);
 	}
+	if (j->map != NULL) {
+		(void)munmap(j->map, j->mapsize);
+	}
 	if (j->fp != NULL) {
 		(void)isc_stdio_close(j->fp);
 	}
@@ -1469,6 +1845,102 @@ dns_journal_destroy(dns_journal_t **journalp) {
 	isc_mem_putanddetach(&j->mctx, j, sizeof(*j));
 }
 
+/*%
+ * The number of changes that dns_journal_rollforward() reduces to
+ * their net effect and applies to the database at a time.
+ */
+#define JOURNAL_ROLLFORWARD_BATCH 65536
+
+typedef struct {
+	dns_difftuple_t *tuple;
+	size_t seq; /* Position in the journal */
+} rollforward_change_t;
+
+/*
+ * Order changes by record, and the changes to each record in the order
+ * they were made.
+ */
+static int
+rollforward_compare(const void *av, const void *bv) {
+	const rollforward_change_t *a = av, *b = bv;
+	int order;
+
+	order = dns_name_compare(&a->tuple->name, &b->tuple->name);
+	if (order == 0) {
+		order = dns_rdata_compare(&a->tuple->rdata, &b->tuple->rdata);
+	}
+	if (order == 0 && a->tuple->ttl != b->tuple->ttl) {
+		order = (a->tuple->ttl < b->tuple->ttl) ? -1 : 1;
+	}
+	if (order == 0) {
+		order = (a->seq < b->seq) ? -1 : 1;
+	}
+	return (order);
+}
+
+/*
+ * Reduce the 'count' changes read from the journal into 'diff' to
+ * their net effect: the deletions, followed by the additions.
+ *
+ * The changes to a record alternate between deleting and adding it,
+ * so an even number of changes cancels out and an odd number leaves
+ * the first one.
+ */
+static void
+rollforward_condense(dns_diff_t *diff, size_t count) {
+	rollforward_change_t *array = NULL;
+	dns_diff_t adds;
+	size_t i, k;
+
+	if (count < 2) {
+		return;
+	}
+
+	array = isc_mem_get(diff->mctx, count * sizeof(array[0]));
+	for (i = 0; i < count; i++) {
+		dns_difftuple_t *tuple = ISC_LIST_HEAD(diff->tuples);
+		INSIST(tuple != NULL);
+		ISC_LIST_UNLINK(diff->tuples, tuple, link);
+		array[i] = (rollforward_change_t){ .tuple = tuple, .seq = i };
+	}
+	INSIST(ISC_LIST_EMPTY(diff->tuples));
+	qsort(array, count, sizeof(array[0]), rollforward_compare);
+
+	dns_diff_init(diff->mctx, &adds);
+	i = 0;
+	while (i < count) {
+		dns_difftuple_t *first = array[i].tuple;
+
+		for (k = i + 1; k < count; k++) {
+			dns_difftuple_t *t = array[k].tuple;
+			if (!dns_name_equal(&t->name, &first->name) ||
+			    dns_rdata_compare(&t->rdata, &first->rdata) != 0 ||
+			    t->ttl != first->ttl)
+			{
+				break;
+			}
+		}
+		if ((k - i) % 2 != 0) {
+			if (first->op == DNS_DIFFOP_DEL ||
+			    first->op == DNS_DIFFOP_DELRESIGN)
+			{
+				ISC_LIST_APPEND(diff->tuples, first, link);
+			} else {
+				ISC_LIST_APPEND(adds.tuples, first, link);
+			}
+			array[i].tuple = NULL;
+		}
+		for (; i < k; i++) {
+			if (array[i].tuple != NULL) {
+				dns_difftuple_free(&array[i].tuple);
+			}
+		}
+	}
+	ISC_LIST_APPENDLIST(diff->tuples, adds.tuples, link);
+
+	isc_mem_put(diff->mctx, array, count * sizeof(array[0]));
+}
+
 /*
  * Roll the open journal 'j' into the database 'db'.
  * A new database version will be created.
@@ -1579,10 +2051,11 @@ dns_journal_rollforward(dns_journal_t *j, dns_db_t *db, unsigned int options) {
 					   &tuple));
 		dns_diff_append(&diff, &tuple);
 
-		if (++n_put > 100) {
+		if (++n_put >= JOURNAL_ROLLFORWARD_BATCH) {
 			isc_log_write(JOURNAL_DEBUG_LOGARGS(3),
 				      "%s: applying diff to database (%u)",
 				      j->filename, db_serial);
+			rollforward_condense(&diff, n_put);
 			(void)dns_diff_print(&diff, NULL);
 			CHECK(dns_diff_apply(&diff, db, ver));
 			dns_diff_clear(&diff);
@@ -1598,6 +2071,7 @@ dns_journal_rollforward(dns_journal_t *j, dns_db_t *db, unsigned int options) {
 		isc_log_write(JOURNAL_DEBUG_LOGARGS(3),
 			      "%s: applying final diff to database (%u)",
 			      j->filename, db_serial);
+		rollforward_condense(&diff, n_put);
 		(void)dns_diff_print(&diff, NULL);
 		CHECK(dns_diff_apply(&diff, db, ver));
 		dns_diff_clear(&diff);
@@ -1626,11 +2100,17 @@ failure:
 isc_result_t
 dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 		  FILE *file) {
+	return (dns_journal_printrange(mctx, flags | DNS_JOURNAL_PRINTALL,
+				       filename, 0, 0, file));
+}
+
+isc_result_t
+dns_journal_printrange(isc_mem_t *mctx, uint32_t flags, const char *filename,
+		       uint32_t begin_serial, uint32_t end_serial,
+		       FILE *file) {
 	dns_journal_t *j = NULL;
-	isc_buffer_t source;   /* Transaction data from disk */
-	isc_buffer_t target;   /* Ditto after _fromwire check */
-	uint32_t start_serial; /* Database SOA serial */
-	uint32_t end_serial;   /* Last journal SOA serial */
+	isc_buffer_t source; /* Transaction data from disk */
+	isc_buffer_t target; /* Ditto after _fromwire check */
 	isc_result_t result;
 	dns_diff_t diff;
 	unsigned int n_soa = 0;
@@ -1650,6 +2130,11 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 		return (result);
 	}
 
+	if ((flags & DNS_JOURNAL_PRINTALL) != 0) {
+		begin_serial = dns_journal_first_serial(j);
+		end_serial = dns_journal_last_serial(j);
+	}
+
 	if (printxhdr) {
 		fprintf(file, "Journal format = %sHeader version = %d\n",
 			j->header.format + 1, j->header_ver1 ? 1 : 2);
@@ -1678,10 +2163,11 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 	isc_buffer_init(&source, NULL, 0);
 	isc_buffer_init(&target, NULL, 0);
 
-	start_serial = dns_journal_first_serial(j);
-	end_serial = dns_journal_last_serial(j);
-
-	CHECK(dns_journal_iter_init(j, start_serial, end_serial, NULL));
+	result = dns_journal_iter_init(j, begin_serial, end_serial, NULL);
+	if (result == ISC_R_RANGE || result == ISC_R_NOTFOUND) {
+		goto cleanup;
+	}
+	CHECK(result);
 
 	for (result = dns_journal_first_rr(j); result == ISC_R_SUCCESS;
 	     result = dns_journal_next_rr(j))
@@ -1926,6 +2412,47 @@ failure:
 	return (j->it.result);
 }
 
+isc_result_t
+dns_journal_split(dns_journal_t *j, uint32_t begin_serial, uint32_t end_serial,
+		  unsigned int nparts, uint32_t *serials,
+		  unsigned int *npartsp) {
+	isc_result_t result;
+	journal_pos_t bpos, epos, pos;
+	unsigned int n = 0;
+
+	REQUIRE(DNS_JOURNAL_VALID(j));
+	REQUIRE(nparts > 0);
+	REQUIRE(serials != NULL && npartsp != NULL);
+
+	CHECK(journal_find(j, begin_serial, &bpos));
+	CHECK(journal_find(j, end_serial, &epos));
+
+	/*
+	 * Walk the transaction headers, starting a new part after each
+	 * equal share of the bytes between 'bpos' and 'epos'.
+	 */
+	pos = bpos;
+	serials[n++] = bpos.serial;
+	while (n < nparts && pos.serial != epos.serial) {
+		CHECK(journal_next(j, &pos));
+		if (pos.serial == epos.serial) {
+			break;
+		}
+		if ((uint64_t)(pos.offset - bpos.offset) * nparts >=
+		    (uint64_t)(epos.offset - bpos.offset) * n)
+		{
+			serials[n++] = pos.serial;
+		}
+	}
+	serials[n] = epos.serial;
+
+	*npartsp = (bpos.serial == epos.serial) ? 0 : n;
+	result = ISC_R_SUCCESS;
+
+failure:
+	return (result);
+}
+
 isc_result_t
 dns_journal_first_rr(dns_journal_t *j) {
 	isc_result_t result;
@@ -2475,6 +3002,7 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 	unsigned int indexend;
 	char newname[PATH_MAX];
 	char backup[PATH_MAX];
+	char dindex[PATH_MAX];
 	bool is_backup = false;
 	bool rewrite = false;
 	bool downgrade = false;
@@ -2812,6 +3340,13 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 		}
 	}
 
+	/*
+	 * The dense index refers to the old journal.
+	 */
+	if (dindex_name(filename, dindex, sizeof(dindex))) {
+		(void)isc_file_remove(dindex);
+	}
+
 	result = ISC_R_SUCCESS;
 
 failure:
@@ -16,7 +16,12 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif /* HAVE_ZLIB */
+
 #include <isc/atomic.h>
+#include <isc/crc64.h>
 #include <isc/event.h>
 #include <isc/lex.h>
 #include <isc/magic.h>
@@ -135,6 +140,10 @@ struct dns_loadctx {
 	FILE *f;
 	bool first;
 	dns_masterrawheader_t header;
+	dns_trust_t trust; /*%< of the RRsets being committed */
+	unsigned char *chunk; /*%< format version 2: current chunk */
+	size_t chunklen;
+	size_t chunkpos;
 
 	/* Which fixed buffers we are using? */
 	unsigned int loop_cnt; /*% records per quantum,
@@ -450,6 +459,9 @@ loadctx_destroy(dns_loadctx_t *lctx) {
 					 isc_result_totext(result));
 		}
 	}
+	if (lctx->chunk != NULL) {
+		isc_mem_put(lctx->mctx, lctx->chunk, DNS_RAWFORMAT_CHUNKSIZE);
+	}
 
 	/* isc_lex_destroy() will close all open streams */
 	if (lctx->lex != NULL && !lctx->keep_lex) {
@@ -581,6 +593,7 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx, unsigned int options,
 	lctx->include_cb = include_cb;
 	lctx->include_arg = include_arg;
 	isc_stdtime_get(&lctx->now);
+	lctx->trust = dns_trust_ultimate;
 
 	lctx->top = dns_fixedname_initname(&lctx->fixed_top);
 	dns_name_toregion(top, &r);
@@ -589,6 +602,9 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx, unsigned int options,
 	lctx->f = NULL;
 	lctx->first = true;
 	dns_master_initrawheader(&lctx->header);
+	lctx->chunk = NULL;
+	lctx->chunklen = 0;
+	lctx->chunkpos = 0;
 
 	lctx->loop_cnt = (done != NULL) ? 100 : 0;
 	lctx->callbacks = callbacks;
@@ -2227,21 +2243,146 @@ cleanup:
 	return (result);
 }
 
+/*
+ * Read the next chunk of a raw format version 2 file, check it and
+ * decompress it if needed.
+ */
+static isc_result_t
+raw_readchunk(dns_loadctx_t *lctx) {
+	unsigned char hdr[DNS_RAWFORMAT_CHUNKHDRSIZE];
+	unsigned char *zdata = NULL;
+	uint32_t datalen, storedlen;
+	uint64_t crc, want;
+	isc_buffer_t b;
+	size_t n;
+	isc_result_t result;
+
+	/*
+	 * The end of the file is only expected between chunks.
+	 */
+	result = isc_stdio_read(hdr, 1, sizeof(hdr), lctx->f, &n);
+	if (result == ISC_R_EOF && n != 0) {
+		result = ISC_R_UNEXPECTEDEND;
+	}
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	isc_buffer_init(&b, hdr, sizeof(hdr));
+	isc_buffer_add(&b, sizeof(hdr));
+	datalen = isc_buffer_getuint32(&b);
+	storedlen = isc_buffer_getuint32(&b);
+	want = (uint64_t)isc_buffer_getuint32(&b) << 32;
+	want |= isc_buffer_getuint32(&b);
+
+	if (datalen == 0 || datalen > DNS_RAWFORMAT_CHUNKSIZE ||
+	    storedlen == 0 || storedlen > datalen)
+	{
+		return (ISC_R_RANGE);
+	}
+
+	if (lctx->chunk == NULL) {
+		lctx->chunk = isc_mem_get(lctx->mctx, DNS_RAWFORMAT_CHUNKSIZE);
+	}
+	lctx->chunklen = lctx->chunkpos = 0;
+
+	if (storedlen == datalen) {
+		result = isc_stdio_read(lctx->chunk, 1, datalen, lctx->f, NULL);
+		if (result == ISC_R_EOF) {
+			result = ISC_R_UNEXPECTEDEND;
+		}
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	} else {
+#ifdef HAVE_ZLIB
+		uLongf destlen = datalen;
+		int zret;
+
+		zdata = isc_mem_get(lctx->mctx, storedlen);
+		result = isc_stdio_read(zdata, 1, storedlen, lctx->f, NULL);
+		if (result == ISC_R_EOF) {
+			result = ISC_R_UNEXPECTEDEND;
+		}
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		zret = uncompress(lctx->chunk, &destlen, zdata, storedlen);
+		if (zret != Z_OK || destlen != datalen) {
+			result = ISC_R_RANGE;
+			goto cleanup;
+		}
+#else  /* HAVE_ZLIB */
+		(*lctx->callbacks->error)(lctx->callbacks,
+					  "dns_master_load: compressed raw "
+					  "files require zlib support");
+		return (ISC_R_NOTIMPLEMENTED);
+#endif /* HAVE_ZLIB */
+	}
+
+	isc_crc64_init(&crc);
+	isc_crc64_update(&crc, lctx->chunk, datalen);
+	isc_crc64_final(&crc);
+	if (crc != want) {
+		result = DNS_R_BADCKSUM;
+		goto cleanup;
+	}
+	lctx->chunklen = datalen;
+
+cleanup:
+	if (zdata != NULL) {
+		isc_mem_put(lctx->mctx, zdata, storedlen);
+	}
+	return (result);
+}
+
+/*
+ * Read 'len' bytes of RRset data from a raw master file.
+ */
+static isc_result_t
+raw_read(dns_loadctx_t *lctx, void *data, size_t len) {
+	unsigned char *p = data;
+	isc_result_t result;
+
+	if (lctx->header.version < 2) {
+		return (isc_stdio_read(data, 1, len, lctx->f, NULL));
+	}
+
+	while (len > 0) {
+		size_t n;
+
+		if (lctx->chunkpos == lctx->chunklen) {
+			result = raw_readchunk(lctx);
+			if (result == ISC_R_EOF && p != data) {
+				result = ISC_R_UNEXPECTEDEND;
+			}
+			if (result != ISC_R_SUCCESS) {
+				return (result);
+			}
+		}
+		n = ISC_MIN(len, lctx->chunklen - lctx->chunkpos);
+		memmove(p, lctx->chunk + lctx->chunkpos, n);
+		lctx->chunkpos += n;
+		p += n;
+		len -= n;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 /*
  * Fill/check exists buffer with 'len' bytes.  Track remaining bytes to be
  * read when incrementally filling the buffer.
  */
 static isc_result_t
-read_and_check(bool do_read, isc_buffer_t *buffer, size_t len, FILE *f,
-	       uint32_t *totallen) {
+read_and_check(bool do_read, isc_buffer_t *buffer, size_t len,
+	       dns_loadctx_t *lctx, uint32_t *totallen) {
 	isc_result_t result;
 
 	REQUIRE(totallen != NULL);
 
 	if (do_read) {
 		INSIST(isc_buffer_availablelength(buffer) >= len);
-		result = isc_stdio_read(isc_buffer_used(buffer), 1, len, f,
-					NULL);
+		result = raw_read(lctx, isc_buffer_used(buffer), len);
 		if (result != ISC_R_SUCCESS) {
 			return (result);
 		}
@@ -2301,6 +2442,7 @@ load_header(dns_loadctx_t *lctx) {
 	case 0:
 		remainder = sizeof(header.dumptime);
 		break;
+	case 1:
 	case DNS_RAWFORMAT_VERSION:
 		remainder = sizeof(header) - commonlen;
 		break;
@@ -2320,12 +2462,20 @@ load_header(dns_loadctx_t *lctx) {
 
 	isc_buffer_add(&target, (unsigned int)remainder);
 	header.dumptime = isc_buffer_getuint32(&target);
-	if (header.version == DNS_RAWFORMAT_VERSION) {
+	if (header.version >= 1) {
 		header.flags = isc_buffer_getuint32(&target);
 		header.sourceserial = isc_buffer_getuint32(&target);
 		header.lastxfrin = isc_buffer_getuint32(&target);
 	}
 
+	if ((lctx->options & DNS_MASTER_CACHE) != 0 &&
+	    (header.flags & DNS_MASTERRAW_CACHE) == 0)
+	{
+		(*callbacks->error)(callbacks, "dns_master_load: "
+					       "not a cache dump");
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
 	lctx->first = false;
 	lctx->header = header;
 
@@ -2363,6 +2513,7 @@ load_raw(dns_loadctx_t *lctx) {
 	isc_buffer_t target, buf;
 	unsigned char *target_mem = NULL;
 	dns_decompress_t dctx;
+	bool cache;
 
 	callbacks = lctx->callbacks;
 	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_NONE);
@@ -2373,6 +2524,7 @@ load_raw(dns_loadctx_t *lctx) {
 			return (result);
 		}
 	}
+	cache = ((lctx->header.flags & DNS_MASTERRAW_CACHE) != 0);
 
 	ISC_LIST_INIT(head);
 	ISC_LIST_INIT(dummy);
@@ -2402,12 +2554,12 @@ load_raw(dns_loadctx_t *lctx) {
 		uint32_t totallen;
 		size_t minlen, readlen;
 		bool sequential_read = false;
+		bool expired = false;
 
 		/* Read the data length */
 		isc_buffer_clear(&target);
 		INSIST(isc_buffer_availablelength(&target) >= sizeof(totallen));
-		result = isc_stdio_read(target.base, 1, sizeof(totallen),
-					lctx->f, NULL);
+		result = raw_read(lctx, target.base, sizeof(totallen));
 		if (result == ISC_R_EOF) {
 			result = ISC_R_SUCCESS;
 			done = true;
@@ -2426,6 +2578,9 @@ load_raw(dns_loadctx_t *lctx) {
 		minlen = sizeof(totallen) + sizeof(uint16_t) +
 			 sizeof(uint16_t) + sizeof(uint16_t) +
 			 sizeof(uint32_t) + sizeof(uint32_t);
+		if (cache) {
+			minlen += sizeof(uint16_t);
+		}
 		if (totallen < minlen) {
 			result = ISC_R_RANGE;
 			goto cleanup;
@@ -2455,7 +2610,7 @@ load_raw(dns_loadctx_t *lctx) {
 			 */
 			readlen = totallen;
 		}
-		result = isc_stdio_read(target.base, 1, readlen, lctx->f, NULL);
+		result = raw_read(lctx, target.base, readlen);
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup;
 		}
@@ -2477,11 +2632,29 @@ load_raw(dns_loadctx_t *lctx) {
 			result = ISC_R_RANGE;
 			goto cleanup;
 		}
+		if (cache) {
+			/*
+			 * Cache dumps record when each RRset expires, and
+			 * how much it was trusted.  RRsets that have expired
+			 * since the dump are read, but not committed.
+			 */
+			uint16_t trust = isc_buffer_getuint16(&target);
+			if (trust > dns_trust_ultimate) {
+				result = ISC_R_RANGE;
+				goto cleanup;
+			}
+			lctx->trust = trust;
+			if (rdatalist.ttl <= lctx->now) {
+				expired = true;
+			} else {
+				rdatalist.ttl -= lctx->now;
+			}
+		}
 		INSIST(isc_buffer_consumedlength(&target) <= readlen);
 
 		/* Owner name: length followed by name */
 		result = read_and_check(sequential_read, &target,
-					sizeof(namelen), lctx->f, &totallen);
+					sizeof(namelen), lctx, &totallen);
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup;
 		}
@@ -2492,7 +2665,7 @@ load_raw(dns_loadctx_t *lctx) {
 		}
 
 		result = read_and_check(sequential_read, &target, namelen,
-					lctx->f, &totallen);
+					lctx, &totallen);
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup;
 		}
@@ -2543,9 +2716,12 @@ load_raw(dns_loadctx_t *lctx) {
 				INSIST(i > 0); /* detect an infinite loop */
 
 				/* Partial Commit. */
-				ISC_LIST_APPEND(head, &rdatalist, link);
-				result = commit(callbacks, lctx, &head, name,
-						NULL, 0);
+				result = ISC_R_SUCCESS;
+				if (!expired) {
+					ISC_LIST_APPEND(head, &rdatalist, link);
+					result = commit(callbacks, lctx, &head,
+							name, NULL, 0);
+				}
 				for (j = 0; j < i; j++) {
 					ISC_LIST_UNLINK(rdatalist.rdata,
 							&rdata[j], link);
@@ -2565,8 +2741,7 @@ load_raw(dns_loadctx_t *lctx) {
 
 			/* rdata length */
 			result = read_and_check(sequential_read, &target,
-						sizeof(rdlen), lctx->f,
-						&totallen);
+						sizeof(rdlen), lctx, &totallen);
 			if (result != ISC_R_SUCCESS) {
 				goto cleanup;
 			}
@@ -2574,7 +2749,7 @@ load_raw(dns_loadctx_t *lctx) {
 
 			/* rdata */
 			result = read_and_check(sequential_read, &target, rdlen,
-						lctx->f, &totallen);
+						lctx, &totallen);
 			if (result != ISC_R_SUCCESS) {
 				goto cleanup;
 			}
@@ -2606,10 +2781,11 @@ load_raw(dns_loadctx_t *lctx) {
 			goto cleanup;
 		}
 
-		ISC_LIST_APPEND(head, &rdatalist, link);
-
 		/* Commit this RRset.  rdatalist will be unlinked. */
-		result = commit(callbacks, lctx, &head, name, NULL, 0);
+		if (!expired) {
+			ISC_LIST_APPEND(head, &rdatalist, link);
+			result = commit(callbacks, lctx, &head, name, NULL, 0);
+		}
 
 		for (i = 0; i < rdcount; i++) {
 			ISC_LIST_UNLINK(rdatalist.rdata, &rdata[i], link);
@@ -3077,7 +3253,7 @@ commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
 		dns_rdataset_init(&dataset);
 		RUNTIME_CHECK(dns_rdatalist_tordataset(this, &dataset) ==
 			      ISC_R_SUCCESS);
-		dataset.trust = dns_trust_ultimate;
+		dataset.trust = lctx->trust;
 		/*
 		 * If this is a secure dynamic zone set the re-signing time.
 		 */
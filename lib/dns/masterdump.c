@@ -17,8 +17,13 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif /* HAVE_ZLIB */
+
 #include <isc/atomic.h>
 #include <isc/buffer.h>
+#include <isc/crc64.h>
 #include <isc/event.h>
 #include <isc/file.h>
 #include <isc/magic.h>
@@ -104,6 +109,10 @@ typedef struct dns_totext_ctx {
 	bool current_ttl_valid;
 	dns_ttl_t serve_stale_ttl;
 	dns_indent_t indent;
+	bool rawcache;	   /*%< Writing a DNS_MASTERRAW_CACHE dump */
+	isc_stdtime_t now; /*%< Time of the dump, if 'rawcache' */
+	unsigned char *chunk; /*%< Raw format version 2 chunk being filled */
+	size_t chunklen;
 } dns_totext_ctx_t;
 
 const dns_master_style_t dns_master_style_keyzone = {
@@ -267,6 +276,7 @@ struct dns_dumpctx {
 	isc_result_t result;
 	char *file;
 	char *tmpfile;
+	char *iobuf;
 	dns_masterformat_t format;
 	dns_masterrawheader_t header;
 	isc_result_t (*dumpsets)(isc_mem_t *mctx, const dns_name_t *name,
@@ -441,6 +451,10 @@ totext_ctx_init(const dns_master_style_t *style, const dns_indent_t *indentctx,
 	ctx->current_ttl = 0;
 	ctx->current_ttl_valid = false;
 	ctx->serve_stale_ttl = 0;
+	ctx->rawcache = false;
+	ctx->now = 0;
+	ctx->chunk = NULL;
+	ctx->chunklen = 0;
 	ctx->indent = *indentctx;
 
 	return (ISC_R_SUCCESS);
@@ -1171,9 +1185,95 @@ again:
 /*
  * Dump given RRsets in the "raw" format.
  */
+/*
+ * Write out the raw format version 2 chunk in 'ctx', compressed if that
+ * makes it smaller.
+ */
+static isc_result_t
+raw_flushchunk(isc_mem_t *mctx, dns_totext_ctx_t *ctx, FILE *f) {
+	unsigned char hdr[DNS_RAWFORMAT_CHUNKHDRSIZE];
+	unsigned char *data = ctx->chunk;
+	size_t datalen = ctx->chunklen;
+	unsigned char *zdata = NULL;
+	size_t zlen = 0;
+	isc_buffer_t b;
+	uint64_t crc;
+	isc_result_t result;
+#ifdef HAVE_ZLIB
+	uLongf destlen;
+#endif /* HAVE_ZLIB */
+
+	if (ctx->chunklen == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	isc_crc64_init(&crc);
+	isc_crc64_update(&crc, ctx->chunk, ctx->chunklen);
+	isc_crc64_final(&crc);
+
+#ifdef HAVE_ZLIB
+	destlen = compressBound(ctx->chunklen);
+	zlen = destlen;
+	zdata = isc_mem_get(mctx, zlen);
+	if (compress2(zdata, &destlen, ctx->chunk, ctx->chunklen,
+		      Z_BEST_SPEED) == Z_OK &&
+	    destlen < ctx->chunklen)
+	{
+		data = zdata;
+		datalen = destlen;
+	}
+#endif /* HAVE_ZLIB */
+
+	isc_buffer_init(&b, hdr, sizeof(hdr));
+	isc_buffer_putuint32(&b, (uint32_t)ctx->chunklen);
+	isc_buffer_putuint32(&b, (uint32_t)datalen);
+	isc_buffer_putuint32(&b, (uint32_t)(crc >> 32));
+	isc_buffer_putuint32(&b, (uint32_t)crc);
+
+	result = isc_stdio_write(hdr, 1, sizeof(hdr), f, NULL);
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_write(data, 1, datalen, f, NULL);
+	}
+	if (zdata != NULL) {
+		isc_mem_put(mctx, zdata, zlen);
+	}
+	ctx->chunklen = 0;
+
+	return (result);
+}
+
+/*
+ * Write 'len' bytes of RRset data to a raw master file, through the
+ * chunk in 'ctx' when writing format version 2.
+ */
+static isc_result_t
+raw_write(isc_mem_t *mctx, dns_totext_ctx_t *ctx, const unsigned char *data,
+	  size_t len, FILE *f) {
+	if (ctx->chunk == NULL) {
+		return (isc_stdio_write(data, 1, len, f, NULL));
+	}
+
+	while (len > 0) {
+		size_t n = ISC_MIN(len,
+				   DNS_RAWFORMAT_CHUNKSIZE - ctx->chunklen);
+
+		memmove(ctx->chunk + ctx->chunklen, data, n);
+		ctx->chunklen += n;
+		data += n;
+		len -= n;
+
+		if (ctx->chunklen == DNS_RAWFORMAT_CHUNKSIZE) {
+			RETERR(raw_flushchunk(mctx, ctx, f));
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 dump_rdataset_raw(isc_mem_t *mctx, const dns_name_t *name,
-		  dns_rdataset_t *rdataset, isc_buffer_t *buffer, FILE *f) {
+		  dns_rdataset_t *rdataset, dns_totext_ctx_t *ctx,
+		  isc_buffer_t *buffer, FILE *f) {
 	isc_result_t result;
 	uint32_t totallen;
 	uint16_t dlen;
@@ -1196,15 +1296,24 @@ restart:
 	 * can store all of them in the initial buffer.
 	 */
 	isc_buffer_availableregion(buffer, &r_hdr);
-	INSIST(r_hdr.length >= sizeof(dns_masterrawrdataset_t));
+	INSIST(r_hdr.length >=
+	       sizeof(dns_masterrawrdataset_t) + sizeof(uint16_t));
 	isc_buffer_putuint32(buffer, totallen);		 /* XXX: leave space */
 	isc_buffer_putuint16(buffer, rdataset->rdclass); /* 16-bit class */
 	isc_buffer_putuint16(buffer, rdataset->type);	 /* 16-bit type */
 	isc_buffer_putuint16(buffer, rdataset->covers);	 /* same as type */
-	isc_buffer_putuint32(buffer, rdataset->ttl);	 /* 32-bit TTL */
+	if (ctx->rawcache) {
+		/* 32-bit expiry time */
+		isc_buffer_putuint32(buffer, ctx->now + rdataset->ttl);
+	} else {
+		isc_buffer_putuint32(buffer, rdataset->ttl); /* 32-bit TTL */
+	}
 	isc_buffer_putuint32(buffer, dns_rdataset_count(rdataset));
+	if (ctx->rawcache) {
+		isc_buffer_putuint16(buffer, rdataset->trust);
+	}
 	totallen = isc_buffer_usedlength(buffer);
-	INSIST(totallen <= sizeof(dns_masterrawrdataset_t));
+	INSIST(totallen <= sizeof(dns_masterrawrdataset_t) + sizeof(uint16_t));
 
 	dns_name_toregion(name, &r);
 	INSIST(isc_buffer_availablelength(buffer) >= (sizeof(dlen) + r.length));
@@ -1264,7 +1373,7 @@ restart:
 	/*
 	 * Write the buffer contents to the raw master file.
 	 */
-	result = isc_stdio_write(r.base, 1, (size_t)r.length, f, NULL);
+	result = raw_write(mctx, ctx, r.base, (size_t)r.length, f);
 
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR("raw master file write failed: %s",
@@ -1298,8 +1407,19 @@ dump_rdatasets_raw(isc_mem_t *mctx, const dns_name_t *owner_name,
 		    (ctx->style.flags & DNS_STYLEFLAG_NCACHE) == 0)
 		{
 			/* Omit negative cache entries */
+		} else if (ctx->rawcache &&
+			   (rdataset.attributes &
+			    (DNS_RDATASETATTR_NEGATIVE |
+			     DNS_RDATASETATTR_STALE |
+			     DNS_RDATASETATTR_ANCIENT)) != 0)
+		{
+			/*
+			 * Omit what could not be reloaded as it was:
+			 * the raw format has no negative entries, and
+			 * the expiry time of stale ones has passed.
+			 */
 		} else {
-			result = dump_rdataset_raw(mctx, name, &rdataset,
+			result = dump_rdataset_raw(mctx, name, &rdataset, ctx,
 						   buffer, f);
 		}
 		dns_rdataset_disassociate(&rdataset);
@@ -1327,6 +1447,13 @@ dump_rdatasets_raw(isc_mem_t *mctx, const dns_name_t *owner_name,
  */
 static const int initial_buffer_length = 1200;
 
+/*
+ * Size of the stdio buffer for the files opened by dns_master_dump()
+ * and dns_master_dumpasync(), so that the dump is written in large
+ * blocks rather than in the few kilobytes stdio uses by default.
+ */
+static const size_t dump_iobuf_length = 1024 * 1024;
+
 static isc_result_t
 dumptostream(dns_dumpctx_t *dctx);
 
@@ -1348,6 +1475,9 @@ dumpctx_destroy(dns_dumpctx_t *dctx) {
 	if (dctx->tmpfile != NULL) {
 		isc_mem_free(dctx->mctx, dctx->tmpfile);
 	}
+	if (dctx->iobuf != NULL) {
+		isc_mem_put(dctx->mctx, dctx->iobuf, dump_iobuf_length);
+	}
 	isc_mem_putanddetach(&dctx->mctx, dctx, sizeof(*dctx));
 }
 
@@ -1566,6 +1696,7 @@ dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	atomic_init(&dctx->canceled, false);
 	dctx->file = NULL;
 	dctx->tmpfile = NULL;
+	dctx->iobuf = NULL;
 	dctx->format = format;
 	if (header == NULL) {
 		dns_master_initrawheader(&dctx->header);
@@ -1593,6 +1724,14 @@ dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	isc_stdtime_get(&dctx->now);
 	dns_db_attach(db, &dctx->db);
 
+	if (format == dns_masterformat_raw &&
+	    (dctx->header.flags & DNS_MASTERRAW_CACHE) != 0)
+	{
+		REQUIRE(dns_db_iscache(db));
+		dctx->tctx.rawcache = true;
+		dctx->tctx.now = dctx->now;
+	}
+
 	dctx->do_date = dns_db_iscache(dctx->db);
 	if (dctx->do_date) {
 		(void)dns_db_getservestalettl(dctx->db,
@@ -1677,13 +1816,18 @@ writeheader(dns_dumpctx_t *dctx) {
 		rawversion = 1;
 		if ((dctx->header.flags & DNS_MASTERRAW_COMPAT) != 0) {
 			rawversion = 0;
+		} else if ((dctx->header.flags & DNS_MASTERRAW_CHUNKED) != 0) {
+			rawversion = DNS_RAWFORMAT_VERSION;
+			dctx->tctx.chunk = isc_mem_get(dctx->mctx,
+						       DNS_RAWFORMAT_CHUNKSIZE);
+			dctx->tctx.chunklen = 0;
 		}
 
 		isc_buffer_putuint32(&buffer, dctx->format);
 		isc_buffer_putuint32(&buffer, rawversion);
 		isc_buffer_putuint32(&buffer, now32);
 
-		if (rawversion == 1) {
+		if (rawversion >= 1) {
 			isc_buffer_putuint32(&buffer, dctx->header.flags);
 			isc_buffer_putuint32(&buffer,
 					     dctx->header.sourceserial);
@@ -1777,9 +1921,17 @@ dumptostream(dns_dumpctx_t *dctx) {
 	if (result == ISC_R_NOMORE) {
 		result = ISC_R_SUCCESS;
 	}
+	if (result == ISC_R_SUCCESS && dctx->tctx.chunk != NULL) {
+		result = raw_flushchunk(dctx->mctx, &dctx->tctx, dctx->f);
+	}
 cleanup:
 	RUNTIME_CHECK(dns_dbiterator_pause(dctx->dbiter) == ISC_R_SUCCESS);
 	isc_mem_put(dctx->mctx, buffer.base, buffer.length);
+	if (dctx->tctx.chunk != NULL) {
+		isc_mem_put(dctx->mctx, dctx->tctx.chunk,
+			    DNS_RAWFORMAT_CHUNKSIZE);
+		dctx->tctx.chunk = NULL;
+	}
 	return (result);
 }
 
@@ -1837,6 +1989,19 @@ dns_master_dumptostream(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	return (result);
 }
 
+/*
+ * Give the file 'dctx' writes to, which must not have been used yet,
+ * a large buffer owned by 'dctx'.
+ */
+static void
+setiobuf(dns_dumpctx_t *dctx) {
+	dctx->iobuf = isc_mem_get(dctx->mctx, dump_iobuf_length);
+	if (setvbuf(dctx->f, dctx->iobuf, _IOFBF, dump_iobuf_length) != 0) {
+		isc_mem_put(dctx->mctx, dctx->iobuf, dump_iobuf_length);
+		dctx->iobuf = NULL;
+	}
+}
+
 static isc_result_t
 opentmp(isc_mem_t *mctx, dns_masterformat_t format, const char *file,
 	char **tempp, FILE **fp) {
@@ -1906,6 +2071,7 @@ dns_master_dumpasync(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 		goto cleanup;
 	}
 
+	setiobuf(dctx);
 	isc_task_attach(task, &dctx->task);
 	dctx->done = done;
 	dctx->done_arg = done_arg;
@@ -1953,11 +2119,13 @@ dns_master_dump(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 		goto cleanup;
 	}
 
+	setiobuf(dctx);
 	result = dumptostream(dctx);
 	INSIST(result != DNS_R_CONTINUE);
-	dns_dumpctx_detach(&dctx);
 
+	/* The file must be closed before 'dctx' frees its buffer. */
 	result = closeandrename(f, result, tempname, filename);
+	dns_dumpctx_detach(&dctx);
 
 cleanup:
 	isc_mem_free(mctx, tempname);
@@ -116,6 +116,19 @@ hexdump(const char *msg, const char *msg2, void *base, size_t len) {
 #define RDATASET_FILLCOUNT 4
 #define RDATASET_FREEMAX   8 * RDATASET_FILLCOUNT
 
+/*%
+ * Upper bounds on the storage a message keeps across resets, see
+ * msgblock_resetlist() and scratchpad_reset().
+ */
+/*%
+ * Largest EDNS padding block size; the OPT rdata built with a PAD
+ * option has room for this much padding after it.
+ */
+#define PADDING_MAX 512
+
+#define RETAIN_MAXBLOCK	     256
+#define RETAIN_MAXSCRATCHPAD 65535
+
 /*%
  * Text representation of the different items, for message_totext
  * functions.
@@ -185,6 +198,9 @@ msgblock_reset(dns_msgblock_t *);
 static void
 msgblock_free(isc_mem_t *, dns_msgblock_t *, unsigned int);
 
+static void
+msgblock_resetlist(isc_mem_t *, dns_msgblocklist_t *, unsigned int, bool);
+
 static void
 logfmtpacket(dns_message_t *message, const char *description,
 	     const isc_sockaddr_t *address, isc_logcategory_t *category,
@@ -251,6 +267,44 @@ msgblock_free(isc_mem_t *mctx, dns_msgblock_t *block,
 	isc_mem_put(mctx, block, length);
 }
 
+/*
+ * Release the message blocks in 'list'.  Unless 'everything' is set,
+ * one block is kept for the next message: if this message needed more
+ * than one, they are replaced by a single block large enough for all
+ * of them (up to RETAIN_MAXBLOCK elements), so that a message of a
+ * similar size is handled next time without allocating.
+ */
+static void
+msgblock_resetlist(isc_mem_t *mctx, dns_msgblocklist_t *list,
+		   unsigned int sizeof_type, bool everything) {
+	dns_msgblock_t *msgblock = ISC_LIST_HEAD(*list);
+	unsigned int count = 0;
+
+	if (msgblock == NULL) {
+		return;
+	}
+
+	if (!everything && ISC_LIST_NEXT(msgblock, link) == NULL) {
+		msgblock_reset(msgblock);
+		return;
+	}
+
+	while (msgblock != NULL) {
+		count += msgblock->count;
+		ISC_LIST_UNLINK(*list, msgblock, link);
+		msgblock_free(mctx, msgblock, sizeof_type);
+		msgblock = ISC_LIST_HEAD(*list);
+	}
+
+	if (!everything) {
+		if (count > RETAIN_MAXBLOCK) {
+			count = RETAIN_MAXBLOCK;
+		}
+		msgblock = msgblock_allocate(mctx, sizeof_type, count);
+		ISC_LIST_APPEND(*list, msgblock, link);
+	}
+}
+
 /*
  * Allocate a new dynamic buffer, and attach it to this message as the
  * "current" buffer.  (which is always the last on the list, for our
@@ -373,6 +427,7 @@ msginitprivate(dns_message_t *m) {
 		m->counts[i] = 0;
 	}
 	m->opt = NULL;
+	m->nednsopts = -1;
 	m->sig0 = NULL;
 	m->sig0name = NULL;
 	m->tsig = NULL;
@@ -473,6 +528,7 @@ msgresetopt(dns_message_t *msg) {
 		dns_rdataset_disassociate(msg->opt);
 		isc_mempool_put(msg->rdspool, msg->opt);
 		msg->opt = NULL;
+		msg->nednsopts = -1;
 		msg->cc_ok = 0;
 		msg->cc_bad = 0;
 	}
@@ -522,10 +578,10 @@ msgresetsigs(dns_message_t *msg, bool replying) {
  */
 static void
 msgreset(dns_message_t *msg, bool everything) {
-	dns_msgblock_t *msgblock, *next_msgblock;
 	isc_buffer_t *dynbuf, *next_dynbuf;
 	dns_rdata_t *rdata;
 	dns_rdatalist_t *rdatalist;
+	unsigned int length = 0;
 
 	msgresetnames(msg, 0);
 	msgresetopt(msg);
@@ -551,58 +607,38 @@ msgreset(dns_message_t *msg, bool everything) {
 		rdatalist = ISC_LIST_HEAD(msg->freerdatalist);
 	}
 
+	/*
+	 * Keep one scratchpad buffer, enlarged to hold everything this
+	 * message needed, so that names and rdata of a message of a
+	 * similar size fit in it next time.
+	 */
 	dynbuf = ISC_LIST_HEAD(msg->scratchpad);
 	INSIST(dynbuf != NULL);
-	if (!everything) {
+	if (!everything && ISC_LIST_NEXT(dynbuf, link) == NULL) {
 		isc_buffer_clear(dynbuf);
-		dynbuf = ISC_LIST_NEXT(dynbuf, link);
+		dynbuf = NULL;
 	}
 	while (dynbuf != NULL) {
 		next_dynbuf = ISC_LIST_NEXT(dynbuf, link);
+		length += isc_buffer_length(dynbuf);
 		ISC_LIST_UNLINK(msg->scratchpad, dynbuf, link);
 		isc_buffer_free(&dynbuf);
 		dynbuf = next_dynbuf;
 	}
-
-	msgblock = ISC_LIST_HEAD(msg->rdatas);
-	if (!everything && msgblock != NULL) {
-		msgblock_reset(msgblock);
-		msgblock = ISC_LIST_NEXT(msgblock, link);
-	}
-	while (msgblock != NULL) {
-		next_msgblock = ISC_LIST_NEXT(msgblock, link);
-		ISC_LIST_UNLINK(msg->rdatas, msgblock, link);
-		msgblock_free(msg->mctx, msgblock, sizeof(dns_rdata_t));
-		msgblock = next_msgblock;
-	}
-
-	/*
-	 * rdatalists could be empty.
-	 */
-
-	msgblock = ISC_LIST_HEAD(msg->rdatalists);
-	if (!everything && msgblock != NULL) {
-		msgblock_reset(msgblock);
-		msgblock = ISC_LIST_NEXT(msgblock, link);
-	}
-	while (msgblock != NULL) {
-		next_msgblock = ISC_LIST_NEXT(msgblock, link);
-		ISC_LIST_UNLINK(msg->rdatalists, msgblock, link);
-		msgblock_free(msg->mctx, msgblock, sizeof(dns_rdatalist_t));
-		msgblock = next_msgblock;
+	if (!everything && length > 0) {
+		if (length > RETAIN_MAXSCRATCHPAD) {
+			length = RETAIN_MAXSCRATCHPAD;
+		}
+		isc_buffer_allocate(msg->mctx, &dynbuf, length);
+		ISC_LIST_APPEND(msg->scratchpad, dynbuf, link);
 	}
 
-	msgblock = ISC_LIST_HEAD(msg->offsets);
-	if (!everything && msgblock != NULL) {
-		msgblock_reset(msgblock);
-		msgblock = ISC_LIST_NEXT(msgblock, link);
-	}
-	while (msgblock != NULL) {
-		next_msgblock = ISC_LIST_NEXT(msgblock, link);
-		ISC_LIST_UNLINK(msg->offsets, msgblock, link);
-		msgblock_free(msg->mctx, msgblock, sizeof(dns_offsets_t));
-		msgblock = next_msgblock;
-	}
+	msgblock_resetlist(msg->mctx, &msg->rdatas, sizeof(dns_rdata_t),
+			   everything);
+	msgblock_resetlist(msg->mctx, &msg->rdatalists,
+			   sizeof(dns_rdatalist_t), everything);
+	msgblock_resetlist(msg->mctx, &msg->offsets, sizeof(dns_offsets_t),
+			   everything);
 
 	if (msg->tsigkey != NULL) {
 		dns_tsigkey_detach(&msg->tsigkey);
@@ -1569,6 +1605,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			dns_rcode_t ercode;
 
 			msg->opt = rdataset;
+			msg->nednsopts = -1;
 			rdataset = NULL;
 			free_rdataset = false;
 			ercode = (dns_rcode_t)((msg->opt->ttl &
@@ -2159,6 +2196,119 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t sectionid,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Types whose rdata contains names that dns_rdata_towire() may compress,
+ * so that their rdata length is not a lower bound on their wire size.
+ */
+static bool
+rdata_compressible(const dns_rdataset_t *rdataset) {
+	switch (rdataset->type) {
+	case dns_rdatatype_ns:
+	case dns_rdatatype_md:
+	case dns_rdatatype_mf:
+	case dns_rdatatype_cname:
+	case dns_rdatatype_soa:
+	case dns_rdatatype_mb:
+	case dns_rdatatype_mg:
+	case dns_rdatatype_mr:
+	case dns_rdatatype_ptr:
+	case dns_rdatatype_minfo:
+	case dns_rdatatype_mx:
+	case dns_rdatatype_lp:
+		return (true);
+	case dns_rdatatype_a:
+		return (rdataset->rdclass == dns_rdataclass_ch);
+	default:
+		return (false);
+	}
+}
+
+bool
+dns_message_sectionfits(dns_message_t *msg, dns_section_t sectionid) {
+	dns_name_t *name = NULL;
+	dns_rdataset_t *rdataset = NULL;
+	unsigned int space, needed = 0;
+
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(msg->buffer != NULL);
+	REQUIRE(VALID_NAMED_SECTION(sectionid));
+
+	space = msg->buffer->length - msg->buffer->used;
+	if (space < msg->reserved) {
+		return (false);
+	}
+	space -= msg->reserved;
+
+	for (name = ISC_LIST_HEAD(msg->sections[sectionid]); name != NULL;
+	     name = ISC_LIST_NEXT(name, link))
+	{
+		/*
+		 * An owner name takes at least a compression pointer,
+		 * or a single byte for the root name.
+		 */
+		unsigned int owner = ISC_MIN(name->length, 2);
+
+		for (rdataset = ISC_LIST_HEAD(name->list); rdataset != NULL;
+		     rdataset = ISC_LIST_NEXT(rdataset, link))
+		{
+			bool compressible;
+			isc_result_t result;
+
+			if ((rdataset->attributes &
+			     (DNS_RDATASETATTR_RENDERED |
+			      DNS_RDATASETATTR_NEGATIVE |
+			      DNS_RDATASETATTR_QUESTION)) != 0)
+			{
+				continue;
+			}
+
+			compressible = rdata_compressible(rdataset);
+			for (result = dns_rdataset_first(rdataset);
+			     result == ISC_R_SUCCESS;
+			     result = dns_rdataset_next(rdataset))
+			{
+				dns_rdata_t rdata = DNS_RDATA_INIT;
+
+				/* type, class, ttl and rdata length */
+				needed += owner + 10;
+				if (!compressible) {
+					dns_rdataset_current(rdataset, &rdata);
+					needed += rdata.length;
+				}
+				if (needed > space) {
+					return (false);
+				}
+			}
+		}
+	}
+
+	return (true);
+}
+
+isc_result_t
+dns_message_renderwire(dns_message_t *msg, const isc_region_t *wire,
+		       const unsigned int counts[DNS_SECTION_MAX]) {
+	int i;
+
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(msg->buffer != NULL);
+	REQUIRE(isc_buffer_usedlength(msg->buffer) == DNS_MESSAGE_HEADERLEN);
+	REQUIRE(wire != NULL && counts != NULL);
+
+	if (isc_buffer_availablelength(msg->buffer) <
+	    wire->length + msg->reserved)
+	{
+		return (ISC_R_NOSPACE);
+	}
+
+	isc_buffer_putmem(msg->buffer, wire->base, wire->length);
+	for (i = 0; i < DNS_SECTION_MAX; i++) {
+		msg->counts[i] = counts[i];
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target) {
 	uint16_t tmp;
@@ -2192,6 +2342,58 @@ dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target) {
 			     (uint16_t)msg->counts[DNS_SECTION_ADDITIONAL]);
 }
 
+/*
+ * Size the trailing PAD option of the OPT record about to be rendered
+ * so that the whole message, including the space still reserved for a
+ * TSIG or SIG(0), ends on a multiple of the padding block size.  The
+ * final length is known before the OPT is written, so the padding goes
+ * out with it in one pass.
+ *
+ * padding_off is the length of the OPT rdata up to and including the
+ * 0-length PAD at its end; dns_message_buildopt() left room for
+ * PADDING_MAX zeroes after it.
+ */
+static isc_result_t
+setpad(dns_message_t *msg) {
+	dns_rdatalist_t *rdatalist = NULL;
+	dns_rdata_t *rdata = NULL;
+	unsigned int used, optlen, available;
+	uint16_t padsize = 0;
+
+	dns_rdatalist_fromrdataset(msg->opt, &rdatalist);
+	rdata = ISC_LIST_HEAD(rdatalist->rdata);
+	if (rdata == NULL || msg->padding_off < 4 ||
+	    rdata->data[msg->padding_off - 4] != 0 ||
+	    rdata->data[msg->padding_off - 3] != DNS_OPT_PAD)
+	{
+		return (ISC_R_UNEXPECTED);
+	}
+
+	/* Root owner name, type, class, TTL and rdlength */
+	optlen = 1 + 10 + msg->padding_off;
+	used = isc_buffer_usedlength(msg->buffer);
+	if (msg->padding != 0) {
+		padsize = (used + optlen + msg->reserved) % msg->padding;
+	}
+	if (padsize != 0) {
+		padsize = msg->padding - padsize;
+	}
+
+	/* Stay below the available length */
+	available = isc_buffer_availablelength(msg->buffer);
+	if (available < optlen + msg->reserved) {
+		padsize = 0;
+	} else if (padsize > available - optlen - msg->reserved) {
+		padsize = available - optlen - msg->reserved;
+	}
+
+	rdata->data[msg->padding_off - 2] = (padsize & 0xff00U) >> 8;
+	rdata->data[msg->padding_off - 1] = padsize & 0x00ffU;
+	rdata->length = msg->padding_off + padsize;
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 dns_message_renderend(dns_message_t *msg) {
 	isc_buffer_t tmpbuf;
@@ -2240,6 +2442,12 @@ dns_message_renderend(dns_message_t *msg) {
 	if (msg->opt != NULL) {
 		dns_message_renderrelease(msg, msg->opt_reserved);
 		msg->opt_reserved = 0;
+		if (msg->padding_off > 0) {
+			result = setpad(msg);
+			if (result != ISC_R_SUCCESS) {
+				return (result);
+			}
+		}
 		/*
 		 * Set the extended rcode.  Cast msg->rcode to dns_ttl_t
 		 * so that we do a unsigned shift.
@@ -2259,56 +2467,6 @@ dns_message_renderend(dns_message_t *msg) {
 		}
 	}
 
-	/*
-	 * Deal with EDNS padding.
-	 *
-	 * padding_off is the length of the OPT with the 0-length PAD
-	 * at the end.
-	 */
-	if (msg->padding_off > 0) {
-		unsigned char *cp = isc_buffer_used(msg->buffer);
-		unsigned int used, remaining;
-		uint16_t len, padsize = 0;
-
-		/* Check PAD */
-		if ((cp[-4] != 0) || (cp[-3] != DNS_OPT_PAD) || (cp[-2] != 0) ||
-		    (cp[-1] != 0))
-		{
-			return (ISC_R_UNEXPECTED);
-		}
-
-		/*
-		 * Zero-fill the PAD to the computed size;
-		 * patch PAD length and OPT rdlength
-		 */
-
-		/* Aligned used length + reserved to padding block */
-		used = isc_buffer_usedlength(msg->buffer);
-		if (msg->padding != 0) {
-			padsize = ((uint16_t)used + msg->reserved) %
-				  msg->padding;
-		}
-		if (padsize != 0) {
-			padsize = msg->padding - padsize;
-		}
-		/* Stay below the available length */
-		remaining = isc_buffer_availablelength(msg->buffer);
-		if (padsize > remaining) {
-			padsize = remaining;
-		}
-
-		isc_buffer_add(msg->buffer, padsize);
-		memset(cp, 0, padsize);
-		cp[-2] = (unsigned char)((padsize & 0xff00U) >> 8);
-		cp[-1] = (unsigned char)(padsize & 0x00ffU);
-		cp -= msg->padding_off;
-		len = ((uint16_t)(cp[-2])) << 8;
-		len |= ((uint16_t)(cp[-1]));
-		len += padsize;
-		cp[-2] = (unsigned char)((len & 0xff00U) >> 8);
-		cp[-1] = (unsigned char)(len & 0x00ffU);
-	}
-
 	/*
 	 * If we're adding a TSIG record, generate and render it.
 	 */
@@ -2789,6 +2947,7 @@ dns_message_setopt(dns_message_t *msg, dns_rdataset_t *opt) {
 	}
 
 	msg->opt = opt;
+	msg->nednsopts = -1;
 
 	return (ISC_R_SUCCESS);
 
@@ -2798,6 +2957,86 @@ cleanup:
 	return (result);
 }
 
+/*
+ * Record where the options of the OPT record are, up to
+ * DNS_MESSAGE_EDNSOPTS of them, and where the unindexed rest starts.
+ */
+static void
+index_ednsopts(dns_message_t *msg, const dns_rdata_t *rdata) {
+	unsigned int offset = 0;
+
+	msg->nednsopts = 0;
+	while (rdata->length - offset >= 4 &&
+	       msg->nednsopts < DNS_MESSAGE_EDNSOPTS)
+	{
+		unsigned int code = (rdata->data[offset] << 8) |
+				    rdata->data[offset + 1];
+		unsigned int length = (rdata->data[offset + 2] << 8) |
+				      rdata->data[offset + 3];
+
+		if (length > rdata->length - offset - 4) {
+			break;
+		}
+		msg->ednsopts[msg->nednsopts].code = code;
+		msg->ednsopts[msg->nednsopts].offset = offset + 4;
+		msg->ednsopts[msg->nednsopts].length = length;
+		msg->nednsopts++;
+		offset += 4 + length;
+	}
+	msg->ednsopts_rest = offset;
+}
+
+isc_result_t
+dns_message_getednsopt(dns_message_t *msg, uint16_t code,
+		       isc_region_t *region) {
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	unsigned int offset;
+
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(region != NULL);
+
+	if (msg->opt == NULL || dns_rdataset_first(msg->opt) != ISC_R_SUCCESS)
+	{
+		return (ISC_R_NOTFOUND);
+	}
+	dns_rdataset_current(msg->opt, &rdata);
+
+	if (msg->nednsopts < 0) {
+		index_ednsopts(msg, &rdata);
+	}
+
+	for (int i = 0; i < msg->nednsopts; i++) {
+		if (msg->ednsopts[i].code == code) {
+			region->base = rdata.data + msg->ednsopts[i].offset;
+			region->length = msg->ednsopts[i].length;
+			return (ISC_R_SUCCESS);
+		}
+	}
+
+	/*
+	 * Options beyond the index, if any, are searched linearly.
+	 */
+	offset = msg->ednsopts_rest;
+	while (rdata.length - offset >= 4) {
+		unsigned int optcode = (rdata.data[offset] << 8) |
+				       rdata.data[offset + 1];
+		unsigned int length = (rdata.data[offset + 2] << 8) |
+				      rdata.data[offset + 3];
+
+		if (length > rdata.length - offset - 4) {
+			break;
+		}
+		if (optcode == code) {
+			region->base = rdata.data + offset + 4;
+			region->length = length;
+			return (ISC_R_SUCCESS);
+		}
+		offset += 4 + length;
+	}
+
+	return (ISC_R_NOTFOUND);
+}
+
 dns_rdataset_t *
 dns_message_gettsig(dns_message_t *msg, const dns_name_t **owner) {
 	/*
@@ -4645,7 +4884,7 @@ dns_message_buildopt(dns_message_t *message, dns_rdataset_t **rdatasetp,
 			goto cleanup;
 		}
 
-		isc_buffer_allocate(message->mctx, &buf, len);
+		isc_buffer_allocate(message->mctx, &buf, len + PADDING_MAX);
 
 		for (i = 0; i < count; i++) {
 			if (ednsopts[i].code == DNS_OPT_PAD &&
@@ -4662,10 +4901,15 @@ dns_message_buildopt(dns_message_t *message, dns_rdataset_t **rdatasetp,
 			}
 		}
 
-		/* Padding must be the final option */
+		/*
+		 * Padding must be the final option.  Its zeroes are
+		 * written here once; dns_message_renderend() only sets
+		 * how many of them are sent.
+		 */
 		if (seenpad) {
 			isc_buffer_putuint16(buf, DNS_OPT_PAD);
 			isc_buffer_putuint16(buf, 0);
+			memset(isc_buffer_used(buf), 0, PADDING_MAX);
 		}
 		rdata->data = isc_buffer_base(buf);
 		rdata->length = len;
@@ -4718,8 +4962,8 @@ dns_message_setpadding(dns_message_t *msg, uint16_t padding) {
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 
 	/* Avoid silly large padding */
-	if (padding > 512) {
-		padding = 512;
+	if (padding > PADDING_MAX) {
+		padding = PADDING_MAX;
 	}
 	msg->padding = padding;
 }
@@ -4742,6 +4986,49 @@ dns_message_clonebuffer(dns_message_t *msg) {
 	}
 }
 
+void
+dns_message_savebuffer(dns_message_t *msg, unsigned char *base,
+		       unsigned int length) {
+	bool used;
+
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(base != NULL || length == 0);
+
+	/*
+	 * The storage may already hold the buffer from an earlier call.
+	 */
+	used = (base == NULL || msg->saved.base == base ||
+		msg->query.base == base);
+
+	if (msg->free_saved == 0 && msg->saved.base != NULL &&
+	    msg->saved.base != base)
+	{
+		if (!used && msg->saved.length <= length) {
+			msg->saved.base = memmove(base, msg->saved.base,
+						  msg->saved.length);
+			used = true;
+		} else {
+			msg->saved.base = memmove(
+				isc_mem_get(msg->mctx, msg->saved.length),
+				msg->saved.base, msg->saved.length);
+			msg->free_saved = 1;
+		}
+	}
+	if (msg->free_query == 0 && msg->query.base != NULL &&
+	    msg->query.base != base)
+	{
+		if (!used && msg->query.length <= length) {
+			msg->query.base = memmove(base, msg->query.base,
+						  msg->query.length);
+		} else {
+			msg->query.base = memmove(
+				isc_mem_get(msg->mctx, msg->query.length),
+				msg->query.base, msg->query.length);
+			msg->free_query = 1;
+		}
+	}
+}
+
 static isc_result_t
 message_authority_soa_min(dns_message_t *msg, dns_ttl_t *pttl) {
 	isc_result_t result;
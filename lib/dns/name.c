@@ -18,6 +18,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+#include <isc/ascii.h>
 #include <isc/buffer.h>
 #include <isc/hash.h>
 #include <isc/mem.h>
@@ -561,43 +562,10 @@ dns_name_fullcompare(const dns_name_t *name1, const dns_name_t *name2,
 			count = count2;
 		}
 
-		/* Loop unrolled for performance */
-		while (count > 3) {
-			chdiff = (int)maptolower[label1[0]] -
-				 (int)maptolower[label2[0]];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
-			chdiff = (int)maptolower[label1[1]] -
-				 (int)maptolower[label2[1]];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
-			chdiff = (int)maptolower[label1[2]] -
-				 (int)maptolower[label2[2]];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
-			chdiff = (int)maptolower[label1[3]] -
-				 (int)maptolower[label2[3]];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
-			count -= 4;
-			label1 += 4;
-			label2 += 4;
-		}
-		while (count-- > 0) {
-			chdiff = (int)maptolower[*label1++] -
-				 (int)maptolower[*label2++];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
+		chdiff = isc_ascii_lowercmp(label1, label2, count);
+		if (chdiff != 0) {
+			*orderp = chdiff;
+			goto done;
 		}
 		if (cdiff != 0) {
 			*orderp = cdiff;
@@ -648,9 +616,7 @@ dns_name_compare(const dns_name_t *name1, const dns_name_t *name2) {
 
 bool
 dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
-	unsigned int l, count;
-	unsigned char c;
-	unsigned char *label1, *label2;
+	unsigned int l;
 
 	/*
 	 * Are 'name1' and 'name2' equal?
@@ -683,47 +649,12 @@ dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
 		return (false);
 	}
 
-	label1 = name1->ndata;
-	label2 = name2->ndata;
-	while (l-- > 0) {
-		count = *label1++;
-		if (count != *label2++) {
-			return (false);
-		}
-
-		INSIST(count <= 63); /* no bitstring support */
-
-		/* Loop unrolled for performance */
-		while (count > 3) {
-			c = maptolower[label1[0]];
-			if (c != maptolower[label2[0]]) {
-				return (false);
-			}
-			c = maptolower[label1[1]];
-			if (c != maptolower[label2[1]]) {
-				return (false);
-			}
-			c = maptolower[label1[2]];
-			if (c != maptolower[label2[2]]) {
-				return (false);
-			}
-			c = maptolower[label1[3]];
-			if (c != maptolower[label2[3]]) {
-				return (false);
-			}
-			count -= 4;
-			label1 += 4;
-			label2 += 4;
-		}
-		while (count-- > 0) {
-			c = maptolower[*label1++];
-			if (c != maptolower[*label2++]) {
-				return (false);
-			}
-		}
-	}
-
-	return (true);
+	/*
+	 * Label lengths are never ASCII letters, so with equal lengths
+	 * and label counts the names can be compared as a whole.
+	 */
+	return (isc_ascii_lowerequal(name1->ndata, name2->ndata,
+				     name1->length));
 }
 
 bool
@@ -758,8 +689,8 @@ dns_name_caseequal(const dns_name_t *name1, const dns_name_t *name2) {
 
 int
 dns_name_rdatacompare(const dns_name_t *name1, const dns_name_t *name2) {
-	unsigned int l1, l2, l, count1, count2, count;
-	unsigned char c1, c2;
+	unsigned int l1, l2, l, count1, count2;
+	int diff;
 	unsigned char *label1, *label2;
 
 	/*
@@ -791,17 +722,12 @@ dns_name_rdatacompare(const dns_name_t *name1, const dns_name_t *name2) {
 		if (count1 != count2) {
 			return ((count1 < count2) ? -1 : 1);
 		}
-		count = count1;
-		while (count > 0) {
-			count--;
-			c1 = maptolower[*label1++];
-			c2 = maptolower[*label2++];
-			if (c1 < c2) {
-				return (-1);
-			} else if (c1 > c2) {
-				return (1);
-			}
+		diff = isc_ascii_lowercmp(label1, label2, count1);
+		if (diff != 0) {
+			return ((diff < 0) ? -1 : 1);
 		}
+		label1 += count1;
+		label2 += count1;
 	}
 
 	/*
@@ -1667,11 +1593,10 @@ dns_name_downcase(const dns_name_t *source, dns_name_t *name,
 		nlen--;
 		if (count < 64) {
 			INSIST(nlen >= count);
-			while (count > 0) {
-				*ndata++ = maptolower[(*sndata++)];
-				nlen--;
-				count--;
-			}
+			isc_ascii_lowercopy(ndata, sndata, count);
+			ndata += count;
+			sndata += count;
+			nlen -= count;
 		} else {
 			FATAL_ERROR("Unexpected label type %02x", count);
 			/* Does not return. */
@@ -1969,7 +1894,7 @@ dns_name_towire2(const dns_name_t *name, dns_compress_t *cctx,
 	if ((name->attributes & DNS_NAMEATTR_NOCOMPRESS) == 0 &&
 	    (methods & DNS_COMPRESS_GLOBAL14) != 0)
 	{
-		gf = dns_compress_findglobal(cctx, name, &gp, &go);
+		gf = dns_compress_findglobal(cctx, target, name, &gp, &go);
 	} else {
 		gf = false;
 	}
@@ -2004,7 +1929,7 @@ dns_name_towire2(const dns_name_t *name, dns_compress_t *cctx,
 		}
 		isc_buffer_putuint16(target, go | 0xc000);
 		if (gp.length != 0) {
-			dns_compress_add(cctx, name, &gp, offset);
+			dns_compress_add(cctx, target, name, &gp, offset);
 			if (comp_offsetp != NULL) {
 				*comp_offsetp = offset;
 			}
@@ -2021,7 +1946,7 @@ dns_name_towire2(const dns_name_t *name, dns_compress_t *cctx,
 				      (size_t)name->length);
 		}
 		isc_buffer_add(target, name->length);
-		dns_compress_add(cctx, name, name, offset);
+		dns_compress_add(cctx, target, name, name, offset);
 		if (comp_offsetp != NULL) {
 			*comp_offsetp = offset;
 		}
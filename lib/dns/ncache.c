@@ -293,9 +293,10 @@ dns_ncache_towire(dns_rdataset_t *rdataset, dns_compress_t *cctx,
 	isc_result_t result;
 	isc_region_t remaining, tavailable;
 	isc_buffer_t source, savedbuffer, rdlen;
-	dns_name_t name;
+	dns_name_t name, prevname;
 	dns_rdatatype_t type;
 	unsigned int i, rcount, count;
+	uint16_t offset = 0xffff;
 
 	/*
 	 * Convert the negative caching rdataset 'rdataset' to wire format,
@@ -309,6 +310,7 @@ dns_ncache_towire(dns_rdataset_t *rdataset, dns_compress_t *cctx,
 
 	savedbuffer = *target;
 	count = 0;
+	dns_name_init(&prevname, NULL);
 
 	result = dns_rdataset_first(rdataset);
 	while (result == ISC_R_SUCCESS) {
@@ -322,6 +324,19 @@ dns_ncache_towire(dns_rdataset_t *rdataset, dns_compress_t *cctx,
 		isc_buffer_forward(&source, name.length);
 		remaining.length -= name.length;
 
+		/*
+		 * Once an owner name has been rendered, its records
+		 * (and those of the next set, typically the signatures,
+		 * if it has the same owner) point back at it instead of
+		 * going through the compression table again.
+		 */
+		if (prevname.length != name.length ||
+		    memcmp(prevname.ndata, name.ndata, name.length) != 0)
+		{
+			offset = 0xffff;
+		}
+		prevname = name;
+
 		INSIST(remaining.length >= 5);
 		type = isc_buffer_getuint16(&source);
 		isc_buffer_forward(&source, 1);
@@ -353,7 +368,7 @@ dns_ncache_towire(dns_rdataset_t *rdataset, dns_compress_t *cctx,
 			 * Write the name.
 			 */
 			dns_compress_setmethods(cctx, DNS_COMPRESS_GLOBAL14);
-			result = dns_name_towire(&name, cctx, target);
+			result = dns_name_towire2(&name, cctx, target, &offset);
 			if (result != ISC_R_SUCCESS) {
 				goto rollback;
 			}
@@ -239,6 +239,28 @@ dns_nsec3_generate_salt(unsigned char *salt, size_t saltlen) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Convert a raw NSEC3 hash to the owner name of the NSEC3 record.
+ */
+static isc_result_t
+hash_toname(dns_fixedname_t *result, const unsigned char *hash, size_t len,
+	    const dns_name_t *origin) {
+	unsigned char nametext[DNS_NAME_FORMATSIZE];
+	isc_buffer_t namebuffer;
+	isc_region_t region;
+
+	/* convert the hash to base32hex non-padded */
+	DE_CONST(hash, region.base);
+	region.length = (unsigned int)len;
+	isc_buffer_init(&namebuffer, nametext, sizeof nametext);
+	isc_base32hexnp_totext(&region, 1, "", &namebuffer);
+
+	/* convert the hex to a domain name */
+	dns_fixedname_init(result);
+	return (dns_name_fromtext(dns_fixedname_name(result), &namebuffer,
+				  origin, 0, NULL));
+}
+
 isc_result_t
 dns_nsec3_hashname(dns_fixedname_t *result,
 		   unsigned char rethash[NSEC3_MAX_HASH_LENGTH],
@@ -247,11 +269,8 @@ dns_nsec3_hashname(dns_fixedname_t *result,
 		   unsigned int iterations, const unsigned char *salt,
 		   size_t saltlength) {
 	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
-	unsigned char nametext[DNS_NAME_FORMATSIZE];
 	dns_fixedname_t fixed;
 	dns_name_t *downcased;
-	isc_buffer_t namebuffer;
-	isc_region_t region;
 	size_t len;
 
 	if (rethash == NULL) {
@@ -275,16 +294,47 @@ dns_nsec3_hashname(dns_fixedname_t *result,
 		*hash_length = len;
 	}
 
-	/* convert the hash to base32hex non-padded */
-	region.base = rethash;
-	region.length = (unsigned int)len;
-	isc_buffer_init(&namebuffer, nametext, sizeof nametext);
-	isc_base32hexnp_totext(&region, 1, "", &namebuffer);
+	return (hash_toname(result, rethash, len, origin));
+}
 
-	/* convert the hex to a domain name */
-	dns_fixedname_init(result);
-	return (dns_name_fromtext(dns_fixedname_name(result), &namebuffer,
-				  origin, 0, NULL));
+isc_result_t
+dns_nsec3_hashnames(dns_fixedname_t *results, const dns_name_t **names,
+		    unsigned int count, const dns_name_t *origin,
+		    dns_hash_t hashalg, unsigned int iterations,
+		    const unsigned char *salt, size_t saltlength) {
+	unsigned char hashes[DNS_NSEC3_HASHNAMES_MAX][NSEC3_MAX_HASH_LENGTH];
+	unsigned char *out[DNS_NSEC3_HASHNAMES_MAX];
+	const unsigned char *in[DNS_NSEC3_HASHNAMES_MAX];
+	int inlength[DNS_NSEC3_HASHNAMES_MAX];
+	dns_fixedname_t fixed[DNS_NSEC3_HASHNAMES_MAX];
+	isc_result_t result;
+	unsigned int i;
+	size_t len;
+
+	REQUIRE(count > 0 && count <= DNS_NSEC3_HASHNAMES_MAX);
+
+	for (i = 0; i < count; i++) {
+		dns_name_t *downcased = dns_fixedname_initname(&fixed[i]);
+		dns_name_downcase(names[i], downcased, NULL);
+		in[i] = downcased->ndata;
+		inlength[i] = downcased->length;
+		out[i] = hashes[i];
+	}
+
+	len = isc_iterated_hash_batch(out, hashalg, iterations, salt,
+				      (int)saltlength, in, inlength, count);
+	if (len == 0U) {
+		return (DNS_R_BADALG);
+	}
+
+	for (i = 0; i < count; i++) {
+		result = hash_toname(&results[i], hashes[i], len, origin);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
 }
 
 unsigned int
@@ -536,11 +586,11 @@ failure:
 	return (result);
 }
 
-isc_result_t
-dns_nsec3_addnsec3(dns_db_t *db, dns_dbversion_t *version,
-		   const dns_name_t *name,
-		   const dns_rdata_nsec3param_t *nsec3param, dns_ttl_t nsecttl,
-		   bool unsecure, dns_diff_t *diff) {
+static isc_result_t
+addnsec3(dns_db_t *db, dns_dbversion_t *version, const dns_name_t *name,
+	 const dns_rdata_nsec3param_t *nsec3param, dns_ttl_t nsecttl,
+	 bool unsecure, const unsigned char *namehash, size_t namehashlength,
+	 dns_diff_t *diff) {
 	dns_dbiterator_t *dbit = NULL;
 	dns_dbnode_t *node = NULL;
 	dns_dbnode_t *newnode = NULL;
@@ -596,8 +646,17 @@ dns_nsec3_addnsec3(dns_db_t *db, dns_dbversion_t *version,
 	 * remain pointing to itself.
 	 */
 	next_length = sizeof(nexthash);
-	CHECK(dns_nsec3_hashname(&fixed, nexthash, &next_length, name, origin,
-				 hash, iterations, salt, salt_length));
+	if (namehash != NULL) {
+		INSIST(namehashlength <= sizeof(nexthash));
+		memset(nexthash, 0, sizeof(nexthash));
+		memmove(nexthash, namehash, namehashlength);
+		next_length = namehashlength;
+		CHECK(hash_toname(&fixed, nexthash, next_length, origin));
+	} else {
+		CHECK(dns_nsec3_hashname(&fixed, nexthash, &next_length, name,
+					 origin, hash, iterations, salt,
+					 salt_length));
+	}
 	INSIST(next_length <= sizeof(nexthash));
 
 	/*
@@ -902,6 +961,28 @@ failure:
 	return (result);
 }
 
+isc_result_t
+dns_nsec3_addnsec3(dns_db_t *db, dns_dbversion_t *version,
+		   const dns_name_t *name,
+		   const dns_rdata_nsec3param_t *nsec3param, dns_ttl_t nsecttl,
+		   bool unsecure, dns_diff_t *diff) {
+	return (addnsec3(db, version, name, nsec3param, nsecttl, unsecure,
+			 NULL, 0, diff));
+}
+
+isc_result_t
+dns_nsec3_addnsec3hash(dns_db_t *db, dns_dbversion_t *version,
+		       const dns_name_t *name,
+		       const dns_rdata_nsec3param_t *nsec3param,
+		       dns_ttl_t nsecttl, bool unsecure,
+		       const unsigned char *hash, size_t hashlength,
+		       dns_diff_t *diff) {
+	REQUIRE(hash != NULL);
+
+	return (addnsec3(db, version, name, nsec3param, nsecttl, unsecure,
+			 hash, hashlength, diff));
+}
+
 /*%
  * Add NSEC3 records for "name", recording the change in "diff".
  * The existing NSEC3 records are removed.
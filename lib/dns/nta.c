@@ -133,6 +133,7 @@ dns_ntatable_create(dns_view_t *view, isc_taskmgr_t *taskmgr,
 
 	ntatable->view = view;
 	isc_refcount_init(&ntatable->references, 1);
+	atomic_init(&ntatable->count, 0);
 
 	ntatable->magic = NTATABLE_MAGIC;
 	*ntatablep = ntatable;
@@ -364,6 +365,7 @@ dns_ntatable_add(dns_ntatable_t *ntatable, const dns_name_t *name, bool force,
 		}
 		node->data = nta;
 		nta = NULL;
+		atomic_fetch_add_release(&ntatable->count, 1);
 	} else if (result == ISC_R_EXISTS) {
 		dns_nta_t *n = node->data;
 		if (n == NULL) {
@@ -372,6 +374,7 @@ dns_ntatable_add(dns_ntatable_t *ntatable, const dns_name_t *name, bool force,
 			}
 			node->data = nta;
 			nta = NULL;
+			atomic_fetch_add_release(&ntatable->count, 1);
 		} else {
 			n->expiry = nta->expiry;
 			nta_detach(view->mctx, &nta);
@@ -406,6 +409,9 @@ deletenode(dns_ntatable_t *ntatable, const dns_name_t *name) {
 		if (node->data != NULL) {
 			result = dns_rbt_deletenode(ntatable->table, node,
 						    false);
+			if (result == ISC_R_SUCCESS) {
+				atomic_fetch_sub_release(&ntatable->count, 1);
+			}
 		} else {
 			result = ISC_R_NOTFOUND;
 		}
@@ -445,6 +451,16 @@ dns_ntatable_covered(dns_ntatable_t *ntatable, isc_stdtime_t now,
 		return (false);
 	}
 
+	/*
+	 * Most views have no NTAs at all; don't take the lock for
+	 * every validation just to find that out.  An NTA being added
+	 * right now is missed just as if this lookup had taken the
+	 * lock first.
+	 */
+	if (atomic_load_acquire(&ntatable->count) == 0) {
+		return (false);
+	}
+
 	foundname = dns_fixedname_initname(&fn);
 
 relock:
@@ -203,6 +203,57 @@ done:
 	return (result);
 }
 
+int
+dst__openssl_verifyinit(dst_key_t *key, const EVP_MD *type,
+			EVP_MD_CTX *evp_md_ctx) {
+	EVP_MD_CTX *tmpl = (EVP_MD_CTX *)atomic_load_acquire(&key->verifyctx);
+	uintptr_t expected = 0;
+
+	if (tmpl != NULL) {
+		if (EVP_MD_CTX_copy_ex(evp_md_ctx, tmpl) == 1) {
+			return (1);
+		}
+		ERR_clear_error();
+	}
+
+	if (EVP_DigestVerifyInit(evp_md_ctx, NULL, type, NULL,
+				 key->keydata.pkey) != 1)
+	{
+		return (0);
+	}
+
+	if (tmpl != NULL) {
+		return (1);
+	}
+
+	/*
+	 * Keep a copy of the freshly initialized context for the next
+	 * verification with this key.  Not every provider can duplicate
+	 * its contexts; if this one can't, we just keep initializing.
+	 */
+	tmpl = EVP_MD_CTX_new();
+	if (tmpl != NULL && EVP_MD_CTX_copy_ex(tmpl, evp_md_ctx) == 1 &&
+	    atomic_compare_exchange_strong_acq_rel(&key->verifyctx, &expected,
+						   (uintptr_t)tmpl))
+	{
+		return (1);
+	}
+	EVP_MD_CTX_free(tmpl);
+	ERR_clear_error();
+
+	return (1);
+}
+
+void
+dst__openssl_verifyfree(dst_key_t *key) {
+	EVP_MD_CTX *tmpl = (EVP_MD_CTX *)atomic_exchange_acq_rel(
+		&key->verifyctx, (uintptr_t)0);
+
+	if (tmpl != NULL) {
+		EVP_MD_CTX_free(tmpl);
+	}
+}
+
 #if !defined(OPENSSL_NO_ENGINE) && OPENSSL_API_LEVEL < 30000
 ENGINE *
 dst__openssl_getengine(const char *engine) {
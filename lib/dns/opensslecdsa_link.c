@@ -193,9 +193,7 @@ opensslecdsa_createctx(dst_key_t *key, dst_context_t *dctx) {
 						       ISC_R_FAILURE));
 		}
 	} else {
-		if (EVP_DigestVerifyInit(evp_md_ctx, NULL, type, NULL,
-					 dctx->key->keydata.pkey) != 1)
-		{
+		if (dst__openssl_verifyinit(dctx->key, type, evp_md_ctx) != 1) {
 			EVP_MD_CTX_destroy(evp_md_ctx);
 			DST_RET(dst__openssl_toresult3(dctx->category,
 						       "EVP_DigestVerifyInit",
@@ -328,18 +326,40 @@ err:
 	return (ret);
 }
 
+/*
+ * Append the DER encoding of the 'len' octet big-endian unsigned
+ * integer at 'src' to 'dst', returning the number of octets written.
+ * ECDSA integers are at most 48 octets, so the length always fits in
+ * a single octet.
+ */
+static size_t
+ecdsa_der_integer(unsigned char *dst, const unsigned char *src, size_t len) {
+	size_t n = 0;
+
+	while (len > 1 && *src == 0) {
+		src++;
+		len--;
+	}
+
+	dst[n++] = 0x02; /* INTEGER */
+	dst[n++] = (unsigned char)(len + ((*src & 0x80) != 0 ? 1 : 0));
+	if ((*src & 0x80) != 0) {
+		dst[n++] = 0x00;
+	}
+	memmove(dst + n, src, len);
+
+	return (n + len);
+}
+
 static isc_result_t
 opensslecdsa_verify(dst_context_t *dctx, const isc_region_t *sig) {
 	isc_result_t ret;
 	dst_key_t *key = dctx->key;
 	int status;
-	unsigned char *cp = sig->base;
-	ECDSA_SIG *ecdsasig = NULL;
 	EVP_MD_CTX *evp_md_ctx = dctx->ctxdata.evp_md_ctx;
-	size_t siglen, sigder_len = 0, sigder_alloced = 0;
-	unsigned char *sigder = NULL;
-	unsigned char *sigder_copy;
-	BIGNUM *r = NULL, *s = NULL;
+	size_t siglen, sigder_len;
+	/* SEQUENCE { INTEGER r, INTEGER s }, each up to 1 + 48 octets */
+	unsigned char sigder[2 + 2 * (2 + 1 + DNS_SIG_ECDSA384SIZE / 2)];
 
 	REQUIRE(key->key_alg == DST_ALG_ECDSA256 ||
 		key->key_alg == DST_ALG_ECDSA384);
@@ -352,35 +372,20 @@ opensslecdsa_verify(dst_context_t *dctx, const isc_region_t *sig) {
 	}
 
 	if (sig->length != siglen) {
-		DST_RET(DST_R_VERIFYFAILURE);
-	}
-
-	ecdsasig = ECDSA_SIG_new();
-	if (ecdsasig == NULL) {
-		DST_RET(ISC_R_NOMEMORY);
+		return (DST_R_VERIFYFAILURE);
 	}
-	r = BN_bin2bn(cp, siglen / 2, NULL);
-	cp += siglen / 2;
-	s = BN_bin2bn(cp, siglen / 2, NULL);
-	/* cp += siglen / 2; */
-	ECDSA_SIG_set0(ecdsasig, r, s);
 
-	status = i2d_ECDSA_SIG(ecdsasig, NULL);
-	if (status < 0) {
-		DST_RET(dst__openssl_toresult3(dctx->category, "i2d_ECDSA_SIG",
-					       DST_R_VERIFYFAILURE));
-	}
-
-	sigder_len = (size_t)status;
-	sigder = isc_mem_get(dctx->mctx, sigder_len);
-	sigder_alloced = sigder_len;
-
-	sigder_copy = sigder;
-	status = i2d_ECDSA_SIG(ecdsasig, &sigder_copy);
-	if (status < 0) {
-		DST_RET(dst__openssl_toresult3(dctx->category, "i2d_ECDSA_SIG",
-					       DST_R_VERIFYFAILURE));
-	}
+	/*
+	 * Build the DER signature directly rather than going through
+	 * ECDSA_SIG and a pair of BIGNUMs for every verification.
+	 */
+	sigder_len = 2;
+	sigder_len += ecdsa_der_integer(sigder + sigder_len, sig->base,
+					siglen / 2);
+	sigder_len += ecdsa_der_integer(sigder + sigder_len,
+					sig->base + siglen / 2, siglen / 2);
+	sigder[0] = 0x30; /* SEQUENCE */
+	sigder[1] = (unsigned char)(sigder_len - 2);
 
 	status = EVP_DigestVerifyFinal(evp_md_ctx, sigder, sigder_len);
 
@@ -398,14 +403,6 @@ opensslecdsa_verify(dst_context_t *dctx, const isc_region_t *sig) {
 		break;
 	}
 
-err:
-	if (ecdsasig != NULL) {
-		ECDSA_SIG_free(ecdsasig);
-	}
-	if (sigder != NULL && sigder_alloced != 0) {
-		isc_mem_put(dctx->mctx, sigder, sigder_alloced);
-	}
-
 	return (ret);
 }
 
@@ -633,6 +630,7 @@ static void
 opensslecdsa_destroy(dst_key_t *key) {
 	EVP_PKEY *pkey = key->keydata.pkey;
 
+	dst__openssl_verifyfree(key);
 	if (pkey != NULL) {
 		EVP_PKEY_free(pkey);
 		key->keydata.pkey = NULL;
@@ -212,7 +212,6 @@ openssleddsa_verify(dst_context_t *dctx, const isc_region_t *sig) {
 	dst_key_t *key = dctx->key;
 	int status;
 	isc_region_t tbsreg;
-	EVP_PKEY *pkey = key->keydata.pkey;
 	EVP_MD_CTX *ctx = EVP_MD_CTX_new();
 	isc_buffer_t *buf = (isc_buffer_t *)dctx->ctxdata.generic;
 	unsigned int siglen = 0;
@@ -244,7 +243,7 @@ openssleddsa_verify(dst_context_t *dctx, const isc_region_t *sig) {
 
 	isc_buffer_usedregion(buf, &tbsreg);
 
-	if (EVP_DigestVerifyInit(ctx, NULL, NULL, NULL, pkey) != 1) {
+	if (dst__openssl_verifyinit(key, NULL, ctx) != 1) {
 		DST_RET(dst__openssl_toresult3(
 			dctx->category, "EVP_DigestVerifyInit", ISC_R_FAILURE));
 	}
@@ -370,6 +369,7 @@ static void
 openssleddsa_destroy(dst_key_t *key) {
 	EVP_PKEY *pkey = key->keydata.pkey;
 
+	dst__openssl_verifyfree(key);
 	EVP_PKEY_free(pkey);
 	key->keydata.pkey = NULL;
 }
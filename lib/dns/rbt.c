@@ -89,6 +89,11 @@ struct dns_rbt {
 	dns_rbtnode_t **hashtable[2];
 	uint8_t hindex;
 	uint32_t hiter;
+	void (*rehash_action)(void *);
+	void *rehash_arg;
+	bool rehash_requested;
+	uint8_t shard;
+	bool fullnames;
 };
 
 #define RED   0
@@ -182,6 +187,22 @@ NODENAME(dns_rbtnode_t *node, dns_name_t *name) {
 	name->attributes |= DNS_NAMEATTR_READONLY;
 }
 
+/*
+ * The absolute name kept by dns_rbt_setfullnames() is stored as
+ *
+ *	<length>{1}<labels>{1}<offsets>{1..128}<name_data>{1..255}
+ */
+#define FULLNAME_SIZE(fullname) (2 + (fullname)[1] + (fullname)[0])
+
+static void
+FULLNAME(dns_rbtnode_t *node, dns_name_t *name) {
+	name->length = node->fullname[0];
+	name->labels = node->fullname[1];
+	name->offsets = node->fullname + 2;
+	name->ndata = name->offsets + name->labels;
+	name->attributes = DNS_NAMEATTR_ABSOLUTE | DNS_NAMEATTR_READONLY;
+}
+
 #ifdef DEBUG
 /*
  * A little something to help out in GDB.
@@ -229,7 +250,7 @@ dns__rbtnode_getdistance(dns_rbtnode_t *node) {
  * Forward declarations.
  */
 static isc_result_t
-create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep);
+create_node(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep);
 
 static void
 hashtable_new(dns_rbt_t *rbt, uint8_t index, uint8_t bits);
@@ -376,6 +397,22 @@ dns_rbt_nodecount(dns_rbt_t *rbt) {
 	return (rbt->nodecount);
 }
 
+void
+dns_rbt_setshard(dns_rbt_t *rbt, unsigned int shard) {
+	REQUIRE(VALID_RBT(rbt));
+	REQUIRE(shard <= UINT8_MAX);
+
+	rbt->shard = (uint8_t)shard;
+}
+
+void
+dns_rbt_setfullnames(dns_rbt_t *rbt) {
+	REQUIRE(VALID_RBT(rbt));
+	REQUIRE(rbt->nodecount == 0);
+
+	rbt->fullnames = true;
+}
+
 size_t
 dns_rbt_hashsize(dns_rbt_t *rbt) {
 	REQUIRE(VALID_RBT(rbt));
@@ -391,11 +428,27 @@ static isc_result_t
 chain_name(dns_rbtnodechain_t *chain, dns_name_t *name,
 	   bool include_chain_end) {
 	dns_name_t nodename;
+	dns_rbtnode_t *last = NULL;
 	isc_result_t result = ISC_R_SUCCESS;
 	int i;
 
 	dns_name_init(&nodename, NULL);
 
+	/*
+	 * The name being built is the absolute name of the deepest node
+	 * in it; if that was kept, just copy it.
+	 */
+	if (include_chain_end && chain->end != NULL) {
+		last = chain->end;
+	} else if (chain->level_count > 0) {
+		last = chain->levels[chain->level_count - 1];
+	}
+	if (last != NULL && last->fullname != NULL) {
+		FULLNAME(last, &nodename);
+		dns_name_copy(&nodename, name);
+		return (ISC_R_SUCCESS);
+	}
+
 	if (include_chain_end && chain->end != NULL) {
 		NODENAME(chain->end, &nodename);
 		dns_name_copy(&nodename, name);
@@ -502,7 +555,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	dns_name_clone(name, add_name);
 
 	if (rbt->root == NULL) {
-		result = create_node(rbt->mctx, add_name, &new_current);
+		result = create_node(rbt, add_name, &new_current);
 		if (result == ISC_R_SUCCESS) {
 			rbt->nodecount++;
 			new_current->is_root = 1;
@@ -626,8 +679,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 				 */
 				dns_name_split(&current_name, common_labels,
 					       prefix, suffix);
-				result = create_node(rbt->mctx, suffix,
-						     &new_current);
+				result = create_node(rbt, suffix, &new_current);
 
 				if (result != ISC_R_SUCCESS) {
 					break;
@@ -736,7 +788,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	} while (child != NULL);
 
 	if (result == ISC_R_SUCCESS) {
-		result = create_node(rbt->mctx, add_name, &new_current);
+		result = create_node(rbt, add_name, &new_current);
 	}
 
 	if (result == ISC_R_SUCCESS) {
@@ -755,6 +807,176 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	return (result);
 }
 
+/*
+ * Add 'name' to a new, empty level below 'upper', or next to 'finger'
+ * on the level that 'finger' is on.  'ulabels' is the number of labels
+ * in the full name of the node that owns that level.  ISC_R_NOTFOUND
+ * means that 'name' does not go right after 'finger', and the tree
+ * has to be searched.
+ */
+static isc_result_t
+addnear(dns_rbt_t *rbt, dns_rbtnode_t *upper, dns_rbtnode_t *finger,
+	unsigned int ulabels, const dns_name_t *name, dns_rbtnode_t **nodep) {
+	dns_rbtnode_t **root = NULL, *parent = NULL, *succ = NULL;
+	dns_rbtnode_t *new_node = NULL;
+	dns_name_t prefix, nodename;
+	dns_offsets_t prefix_offsets;
+	dns_namereln_t reln;
+	unsigned int common;
+	isc_result_t result;
+	int order = 1;
+
+	dns_name_init(&prefix, prefix_offsets);
+	dns_name_getlabelsequence(name, 0, dns_name_countlabels(name) - ulabels,
+				  &prefix);
+
+	if (finger != NULL) {
+		/*
+		 * 'name' must sort after 'finger' and before its successor
+		 * on the level, without sharing a suffix with either of
+		 * them; otherwise it might belong on a lower level, or
+		 * further along this one.
+		 */
+		dns_name_init(&nodename, NULL);
+		NODENAME(finger, &nodename);
+		reln = dns_name_fullcompare(&prefix, &nodename, &order,
+					    &common);
+		if (reln != dns_namereln_none || order < 0) {
+			return (ISC_R_NOTFOUND);
+		}
+
+		if (RIGHT(finger) != NULL) {
+			succ = RIGHT(finger);
+			while (LEFT(succ) != NULL) {
+				succ = LEFT(succ);
+			}
+		} else {
+			succ = finger;
+			while (!IS_ROOT(succ) && RIGHT(PARENT(succ)) == succ) {
+				succ = PARENT(succ);
+			}
+			succ = IS_ROOT(succ) ? NULL : PARENT(succ);
+		}
+
+		if (succ != NULL) {
+			NODENAME(succ, &nodename);
+			reln = dns_name_fullcompare(&prefix, &nodename, &order,
+						    &common);
+			if (reln != dns_namereln_none || order > 0) {
+				return (ISC_R_NOTFOUND);
+			}
+		}
+
+		if (RIGHT(finger) == NULL) {
+			parent = finger;
+			order = 1;
+		} else {
+			parent = succ;
+			order = -1;
+		}
+		root = (upper == NULL) ? &rbt->root : &DOWN(upper);
+		INSIST(IS_ROOT(*root));
+	} else {
+		INSIST(upper != NULL && DOWN(upper) == NULL);
+		parent = upper;
+		root = &DOWN(upper);
+	}
+
+	result = create_node(rbt, &prefix, &new_node);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	UPPERNODE(new_node) = upper;
+	addonlevel(new_node, parent, order, root);
+	rbt->nodecount++;
+	*nodep = new_node;
+	hash_node(rbt, new_node, name);
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_rbt_addnodefrom(dns_rbt_t *rbt, dns_rbtnode_t *finger,
+		    const dns_name_t *name, dns_rbtnode_t **nodep) {
+	dns_fixedname_t ffull;
+	dns_name_t *full = NULL;
+	dns_name_t current, upper, nodename;
+	dns_namereln_t reln;
+	unsigned int common, ulabels;
+	isc_result_t result;
+	int order;
+
+	REQUIRE(VALID_RBT(rbt));
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(nodep != NULL && *nodep == NULL);
+	REQUIRE(finger == NULL || DNS_RBTNODE_VALID(finger));
+
+	if (finger == NULL) {
+		goto search;
+	}
+
+	full = dns_fixedname_initname(&ffull);
+	result = dns_rbt_fullnamefromnode(finger, full);
+	if (result != ISC_R_SUCCESS) {
+		goto search;
+	}
+
+	reln = dns_name_fullcompare(name, full, &order, &common);
+	if (reln == dns_namereln_equal) {
+		*nodep = finger;
+		return (ISC_R_EXISTS);
+	}
+	if (reln == dns_namereln_subdomain) {
+		if (DOWN(finger) != NULL) {
+			goto search;
+		}
+		return (addnear(rbt, finger, NULL, dns_name_countlabels(full),
+				name, nodep));
+	}
+
+	/*
+	 * Walk up from 'finger' to the first level that 'name' belongs
+	 * to, and try to add it next to the node in the chain there.
+	 */
+	dns_name_init(&current, NULL);
+	dns_name_init(&upper, NULL);
+	dns_name_init(&nodename, NULL);
+	dns_name_clone(full, &current);
+	for (dns_rbtnode_t *node = finger; node != NULL;
+	     node = UPPERNODE(node))
+	{
+		NODENAME(node, &nodename);
+		ulabels = dns_name_countlabels(&current) -
+			  dns_name_countlabels(&nodename);
+		if (ulabels == 0) {
+			INSIST(UPPERNODE(node) == NULL);
+		} else {
+			dns_name_getlabelsequence(
+				&current, dns_name_countlabels(&nodename),
+				ulabels, &upper);
+			if (dns_name_equal(name, &upper)) {
+				*nodep = UPPERNODE(node);
+				return (ISC_R_EXISTS);
+			}
+			if (!dns_name_issubdomain(name, &upper)) {
+				dns_name_clone(&upper, &current);
+				continue;
+			}
+		}
+
+		result = addnear(rbt, UPPERNODE(node), node, ulabels, name,
+				 nodep);
+		if (result != ISC_R_NOTFOUND) {
+			return (result);
+		}
+		break;
+	}
+
+search:
+	return (dns_rbt_addnode(rbt, name, nodep));
+}
+
 /*
  * Add a name to the tree of trees, associating it with some data.
  */
@@ -1497,6 +1719,13 @@ dns_rbt_fullnamefromnode(dns_rbtnode_t *node, dns_name_t *name) {
 	REQUIRE(name->buffer != NULL);
 
 	dns_name_init(&current, NULL);
+
+	if (node->fullname != NULL) {
+		FULLNAME(node, &current);
+		dns_name_copy(&current, name);
+		return (ISC_R_SUCCESS);
+	}
+
 	dns_name_reset(name);
 
 	do {
@@ -1538,7 +1767,7 @@ dns_rbt_formatnodename(dns_rbtnode_t *node, char *printname,
 }
 
 static isc_result_t
-create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
+create_node(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	dns_rbtnode_t *node;
 	isc_region_t region;
 	unsigned int labels;
@@ -1554,7 +1783,7 @@ create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	 * Allocate space for the node structure, the name, and the offsets.
 	 */
 	nodelen = sizeof(dns_rbtnode_t) + region.length + labels + 1;
-	node = isc_mem_get(mctx, nodelen);
+	node = isc_mem_get(rbt->mctx, nodelen);
 	memset(node, 0, nodelen);
 
 	node->is_root = 0;
@@ -1564,6 +1793,7 @@ create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	DOWN(node) = NULL;
 	DATA(node) = NULL;
 	node->rpz = 0;
+	node->shard = rbt->shard;
 
 	HASHNEXT(node) = NULL;
 	HASHVAL(node) = 0;
@@ -1748,15 +1978,52 @@ hashtable_is_overcommited(dns_rbt_t *rbt) {
 		(HASHSIZE(rbt->hashbits[rbt->hindex]) * RBT_HASH_OVERCOMMIT));
 }
 
+static bool
+rehash_wanted(dns_rbt_t *rbt) {
+	return (rehashing_in_progress(rbt) ||
+		(hashtable_is_overcommited(rbt) &&
+		 rehash_bits(rbt, rbt->nodecount) >
+			 rbt->hashbits[rbt->hindex]));
+}
+
 /*
  * Add a node to the hash table. Rehash the hashtable if the node count
- * rises above a critical level.
+ * rises above a critical level, or ask the owner of the tree to do it
+ * if it has set a rehash action.
  */
+/*
+ * Keep a copy of the absolute name of 'node', which has just been
+ * linked into the tree.  It is assembled from the node names rather
+ * than taken from the name being added, so that it has exactly the
+ * case dns_rbt_fullnamefromnode() would give it.
+ */
+static void
+save_fullname(dns_rbt_t *rbt, dns_rbtnode_t *node) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	unsigned char *fullname = NULL;
+
+	RUNTIME_CHECK(dns_rbt_fullnamefromnode(node, name) == ISC_R_SUCCESS);
+
+	fullname = isc_mem_get(rbt->mctx, 2 + name->labels + name->length);
+	fullname[0] = name->length;
+	fullname[1] = name->labels;
+	memmove(fullname + 2, name->offsets, name->labels);
+	memmove(fullname + 2 + name->labels, name->ndata, name->length);
+
+	node->fullname = fullname;
+}
+
 static void
 hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, const dns_name_t *name) {
 	REQUIRE(DNS_RBTNODE_VALID(node));
 
-	if (rehashing_in_progress(rbt)) {
+	if (rbt->rehash_action != NULL) {
+		if (!rbt->rehash_requested && rehash_wanted(rbt)) {
+			rbt->rehash_requested = true;
+			(rbt->rehash_action)(rbt->rehash_arg);
+		}
+	} else if (rehashing_in_progress(rbt)) {
 		/* Rehash in progress */
 		hashtable_rehash_one(rbt);
 	} else if (hashtable_is_overcommited(rbt)) {
@@ -1765,6 +2032,67 @@ hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, const dns_name_t *name) {
 	}
 
 	hash_add_node(rbt, node, name);
+
+	if (rbt->fullnames && node->fullname == NULL) {
+		save_fullname(rbt, node);
+	}
+}
+
+void
+dns_rbt_setrehashaction(dns_rbt_t *rbt, void (*action)(void *), void *arg) {
+	REQUIRE(VALID_RBT(rbt));
+
+	rbt->rehash_action = action;
+	rbt->rehash_arg = arg;
+	rbt->rehash_requested = false;
+}
+
+isc_result_t
+dns_rbt_rehash(dns_rbt_t *rbt, unsigned int quantum) {
+	REQUIRE(VALID_RBT(rbt));
+	REQUIRE(quantum > 0);
+
+	if (!rehashing_in_progress(rbt) && rehash_wanted(rbt)) {
+		/* This moves the first bucket. */
+		maybe_rehash(rbt, rbt->nodecount);
+		quantum--;
+	}
+
+	while (quantum-- > 0 && rehashing_in_progress(rbt)) {
+		hashtable_rehash_one(rbt);
+	}
+
+	if (rehashing_in_progress(rbt)) {
+		return (ISC_R_QUOTA);
+	}
+
+	rbt->rehash_requested = false;
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_rbt_sizehint(dns_rbt_t *rbt, size_t count) {
+	uint32_t newbits;
+
+	REQUIRE(VALID_RBT(rbt));
+
+	/*
+	 * Size the table so that it would not need to grow again before
+	 * 'count' nodes have been added.
+	 */
+	newbits = ISC_MIN(rehash_bits(rbt, count / RBT_HASH_OVERCOMMIT),
+			  RBT_HASH_MAX_BITS - 1);
+	if (newbits <= rbt->hashbits[rbt->hindex]) {
+		return;
+	}
+
+	while (rehashing_in_progress(rbt)) {
+		hashtable_rehash_one(rbt);
+	}
+	hashtable_rehash(rbt, newbits);
+	while (rehashing_in_progress(rbt)) {
+		hashtable_rehash_one(rbt);
+	}
 }
 
 /*
@@ -2229,6 +2557,10 @@ freenode(dns_rbt_t *rbt, dns_rbtnode_t **nodep) {
 	dns_rbtnode_t *node = *nodep;
 	*nodep = NULL;
 
+	if (node->fullname != NULL) {
+		isc_mem_put(rbt->mctx, node->fullname,
+			    FULLNAME_SIZE(node->fullname));
+	}
 	isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
 
 	rbt->nodecount--;
@@ -25,9 +25,11 @@
 #include <isc/hash.h>
 #include <isc/heap.h>
 #include <isc/hex.h>
+#include <isc/ht.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/once.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
@@ -132,7 +134,7 @@ typedef isc_rwlock_t nodelock_t;
 
 #define NODE_INITLOCK(l)    isc_rwlock_init((l), 0, 0)
 #define NODE_DESTROYLOCK(l) isc_rwlock_destroy(l)
-#define NODE_LOCK(l, t)	    RWLOCK((l), (t))
+#define NODE_LOCK(l, t)	    node_lock((l), (t))
 #define NODE_UNLOCK(l, t)   RWUNLOCK((l), (t))
 #define NODE_TRYUPGRADE(l)  isc_rwlock_tryupgrade(l)
 #define NODE_DOWNGRADE(l)   isc_rwlock_downgrade(l)
@@ -151,6 +153,25 @@ typedef isc_rwlock_t nodelock_t;
 /*% Time after which we update LRU for all other records, 10 minutes */
 #define DNS_RBTDB_LRUUPDATE_REGULAR 600
 
+/*%
+ * With the "slru" cache policy, a cache entry that has been looked up
+ * this many times since it was added (or moved back to probation) is
+ * moved to the protected part of its LRU list.
+ */
+#define RBTDB_SLRU_PROMOTE 2
+
+/*%
+ * Lookups of a cache entry are counted up to this many.
+ */
+#define RBTDB_HITS_MAX 255
+
+/*%
+ * Percentage of the LRU entries of a bucket that may be protected.
+ * Beyond it, the least recently used protected entries are moved back
+ * to probation when the cache runs out of memory.
+ */
+#define RBTDB_SLRU_PROTECTED 80
+
 /*
  * Allow clients with a virtual time of up to 5 minutes in the past to see
  * records that would have otherwise have expired.
@@ -173,10 +194,8 @@ typedef struct rdatasetheader {
 	rbtdb_rdatatype_t type;
 	atomic_uint_least16_t attributes;
 	dns_trust_t trust;
-	atomic_uint_fast32_t last_refresh_fail_ts;
-	struct noqname *noqname;
-	struct noqname *closest;
 	unsigned int resign_lsb : 1;
+	unsigned int arena	: 1; /*%< slab belongs to the db arena */
 	/*%<
 	 * We don't use the LIST macros, because the LIST structure has
 	 * both head and tail pointers, and is doubly linked.
@@ -204,7 +223,6 @@ typedef struct rdatasetheader {
 	 */
 
 	dns_rbtnode_t *node;
-	isc_stdtime_t last_used;
 	ISC_LINK(struct rdatasetheader) link;
 
 	unsigned int heap_index;
@@ -220,6 +238,35 @@ typedef struct rdatasetheader {
 	unsigned char upper[32];
 } rdatasetheader_t;
 
+/*%
+ * Fields that only the cache uses.  In a cache database they are kept
+ * immediately in front of every rdatasetheader_t (see CACHEDATA());
+ * zone headers are allocated without them.
+ */
+typedef struct rdatasetcache {
+	/*%
+	 * Locked by the owning node's lock.
+	 */
+	atomic_uint_fast32_t last_refresh_fail_ts;
+	struct noqname *noqname;
+	struct noqname *closest;
+	isc_stdtime_t last_used;
+	/*%
+	 * Lookups since the header was added or put back on probation,
+	 * up to RBTDB_HITS_MAX (counted under the node read lock), and
+	 * whether it is on the protected list.
+	 */
+	atomic_uint_least16_t hits;
+	bool protected;
+	/*%
+	 * The domain the header is accounted to (see domain_add()), or
+	 * NULL.  Set before the header is linked into the database.
+	 */
+	struct rbtdb_domain *domain;
+} rdatasetcache_t;
+
+#define CACHEDATA(header) ((rdatasetcache_t *)(header)-1)
+
 typedef ISC_LIST(rdatasetheader_t) rdatasetheaderlist_t;
 typedef ISC_LIST(dns_rbtnode_t) rbtnodelist_t;
 
@@ -311,9 +358,16 @@ typedef ISC_LIST(dns_rbtnode_t) rbtnodelist_t;
 	 ((header)->rdh_ttl == (now) && ZEROTTL(header)))
 
 #define DEFAULT_NODE_LOCK_COUNT	    7 /*%< Should be prime. */
+#define MAX_NODE_LOCK_COUNT	    1021 /*%< Largest prime below 1024. */
+#define NODES_PER_NODE_LOCK	    1024
+#define NODE_LOCKS_PER_CPU	    4
+#define REHASH_QUANTUM		    1024 /*%< Buckets per rehash slice. */
 #define RBTDB_GLUE_TABLE_INIT_BITS  2U
 #define RBTDB_GLUE_TABLE_MAX_BITS   32U
 #define RBTDB_GLUE_TABLE_OVERCOMMIT 3
+#define RBTDB_GLUE_TABLE_CACHE_MAX  4096U
+#define ARENA_CHUNK_SIZE	    (64 * 1024)
+#define ARENA_ALIGN		    8
 
 #define GOLDEN_RATIO_32 0x61C88647
 #define HASHSIZE(bits)	(UINT64_C(1) << (bits))
@@ -336,10 +390,10 @@ hash_32(uint32_t val, unsigned int bits) {
  * There is a tradeoff issue about configuring this value: if this is too
  * small, it may cause heavier contention between threads; if this is too large,
  * LRU purge algorithm won't work well (entries tend to be purged prematurely).
- * The default value should work well for most environments, but this can
- * also be configurable at compilation time via the
- * DNS_RBTDB_CACHE_NODE_LOCK_COUNT variable.  This value must be larger than
- * 1 due to the assumption of overmem_purge().
+ * By default one bucket per CPU is used, but no fewer than
+ * DEFAULT_CACHE_NODE_LOCK_COUNT; the count can instead be fixed at
+ * compilation time via the DNS_RBTDB_CACHE_NODE_LOCK_COUNT variable.  This
+ * value must be larger than 1 due to the assumption of overmem_purge().
  */
 #ifdef DNS_RBTDB_CACHE_NODE_LOCK_COUNT
 #if DNS_RBTDB_CACHE_NODE_LOCK_COUNT <= 1
@@ -357,8 +411,29 @@ typedef struct {
 	isc_refcount_t references;
 	/* Locked by lock. */
 	bool exiting;
+	/* Updated atomically: times NODE_LOCK() had to wait for 'lock'. */
+	atomic_uint_fast64_t waits;
+	/*
+	 * Updated atomically: the last time a lookup in the bucket failed
+	 * to refresh stale data (see stale_wanted()).
+	 */
+	atomic_uint_fast32_t stalefail;
 } rbtdb_nodelock_t;
 
+STATIC_ASSERT(offsetof(rbtdb_nodelock_t, lock) == 0,
+	      "node lock must be the first member of rbtdb_nodelock_t");
+
+static void
+node_lock(nodelock_t *lock, isc_rwlocktype_t type) {
+	rbtdb_nodelock_t *nodelock = (rbtdb_nodelock_t *)lock;
+
+	if (isc_rwlock_trylock(lock, type) == ISC_R_SUCCESS) {
+		return;
+	}
+	atomic_fetch_add_relaxed(&nodelock->waits, 1);
+	RWLOCK(lock, type);
+}
+
 typedef struct rbtdb_changed {
 	dns_rbtnode_t *node;
 	bool dirty;
@@ -380,8 +455,27 @@ typedef struct rbtdb_glue_table_node {
 	struct rbtdb_glue_table_node *next;
 	dns_rbtnode_t *node;
 	rbtdb_glue_t *glue_list;
+	/* Cache DB only */
+	rdatasetheader_t *header;
+	isc_stdtime_t expire;
+	uint_fast32_t generation;
 } rbtdb_glue_table_node_t;
 
+/*%
+ * A committed zone version remembers, for the nodes with a wildcard
+ * child, the wildcard node that is active in the version, if any, so
+ * that a name matched by a wildcard needs neither a second tree lookup
+ * nor a walk to the next name to find it.  The cache is direct-mapped;
+ * a slot is filled once and kept as long as the version, which does not
+ * change.  Both nodes of an entry are referenced.
+ */
+#define RBTDB_WILDCACHE_SIZE 64
+
+typedef struct rbtdb_wildcache {
+	dns_rbtnode_t *node;  /* the node with the wildcard child */
+	dns_rbtnode_t *wnode; /* the active wildcard node, or NULL */
+} rbtdb_wildcache_t;
+
 typedef enum {
 	rdataset_ttl_fresh,
 	rdataset_ttl_stale,
@@ -424,10 +518,28 @@ typedef struct rbtdb_version {
 	size_t glue_table_bits;
 	size_t glue_table_nodecount;
 	rbtdb_glue_table_node_t **glue_table;
+
+	isc_rwlock_t wild_rwlock;
+	rbtdb_wildcache_t *wildcache;
 } rbtdb_version_t;
 
 typedef ISC_LIST(rbtdb_version_t) rbtdb_versionlist_t;
 
+/*%
+ * A chunk of memory from which a zone database being loaded carves its
+ * rdataslabs, instead of allocating each of them separately.  Slabs in
+ * the arena are not released one by one; the chunks are freed together
+ * with the database.
+ */
+typedef struct rbtdb_arena rbtdb_arena_t;
+struct rbtdb_arena {
+	rbtdb_arena_t *next;
+	size_t size;
+	size_t used;
+};
+
+#define ARENA_HDRSIZE ISC_ALIGN(sizeof(rbtdb_arena_t), ARENA_ALIGN)
+
 struct dns_rbtdb {
 	/* Unlocked. */
 	dns_db_t common;
@@ -443,6 +555,7 @@ struct dns_rbtdb {
 	dns_stats_t *rrsetstats;     /* cache DB only */
 	isc_stats_t *cachestats;     /* cache DB only */
 	isc_stats_t *gluecachestats; /* zone DB only */
+	atomic_uint_fast32_t glue_generation; /* cache DB only */
 	/* Locked by lock. */
 	unsigned int active;
 	isc_refcount_t references;
@@ -477,6 +590,29 @@ struct dns_rbtdb {
 	 */
 	rdatasetheaderlist_t *rdatasets;
 
+	/*
+	 * With the "slru" policy (see update_header()), headers that have
+	 * been looked up repeatedly move from rdatasets[i] (probation) to
+	 * protected[i], and are only purged for lack of memory when there
+	 * is nothing left on probation.  'lrucount' counts the headers on
+	 * both lists of a bucket and 'protectedcount' those on
+	 * protected[i].  Locked by the node lock of the bucket.
+	 */
+	rdatasetheaderlist_t *protected;
+	unsigned int *lrucount;
+	unsigned int *protectedcount;
+	atomic_bool slru;
+
+	/*%
+	 * Memory used by the headers below each domain (see
+	 * domain_add()), kept while 'domainusage' is set.  The table is
+	 * created the first time accounting is enabled and is locked by
+	 * 'domain_lock', which is taken after the node locks.
+	 */
+	isc_mutex_t domain_lock;
+	isc_ht_t *domains;
+	atomic_bool domainusage;
+
 	/*%
 	 * Temporary storage for stale cache nodes and dynamically deleted
 	 * nodes that await being cleaned up.
@@ -492,6 +628,9 @@ struct dns_rbtdb {
 	isc_mem_t *hmctx;
 	isc_heap_t **heaps;
 
+	/* Only used while loading a zone DB. */
+	rbtdb_arena_t *arena;
+
 	/* Locked by tree_lock. */
 	dns_rbt_t *tree;
 	dns_rbt_t *nsec;
@@ -531,6 +670,16 @@ typedef struct {
 typedef struct {
 	dns_rbtdb_t *rbtdb;
 	isc_stdtime_t now;
+
+	/*
+	 * Master files list the RRsets of an owner name together, so
+	 * the node of the previous one is remembered to spare looking
+	 * it up again, and to add the next name from if the file is
+	 * sorted (zone DB only).
+	 */
+	dns_rbtnode_t *lastnode;
+	bool lastnsec3;
+	dns_fixedname_t lastname;
 } rbtdb_load_t;
 
 static void
@@ -554,10 +703,17 @@ static isc_result_t
 rdataset_getclosest(dns_rdataset_t *rdataset, dns_name_t *name,
 		    dns_rdataset_t *neg, dns_rdataset_t *negsig);
 static bool
-need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now);
+need_headerupdate(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
+		  isc_stdtime_t now);
+static bool
+header_hit(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, isc_stdtime_t now);
 static void
 update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, isc_stdtime_t now);
 static void
+lru_insert(dns_rbtdb_t *rbtdb, rdatasetheader_t *header);
+static void
+lru_unlink(dns_rbtdb_t *rbtdb, rdatasetheader_t *header);
+static void
 expire_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, bool tree_locked,
 	      expire_t reason);
 static void
@@ -571,6 +727,8 @@ resign_delete(dns_rbtdb_t *rbtdb, rbtdb_version_t *version,
 static void
 prune_tree(isc_task_t *task, isc_event_t *event);
 static void
+rehash_trees(isc_task_t *task, isc_event_t *event);
+static void
 rdataset_settrust(dns_rdataset_t *rdataset, dns_trust_t trust);
 static void
 rdataset_expire(dns_rdataset_t *rdataset);
@@ -585,6 +743,10 @@ rdataset_addglue(dns_rdataset_t *rdataset, dns_dbversion_t *version,
 		 dns_message_t *msg);
 static void
 free_gluetable(rbtdb_version_t *version);
+static void
+free_wildcache(rbtdb_version_t *version);
+static void
+detachnode(dns_db_t *db, dns_dbnode_t **targetp);
 static isc_result_t
 nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name);
 
@@ -712,6 +874,8 @@ static void
 setnsec3parameters(dns_db_t *db, rbtdb_version_t *version);
 static void
 setownercase(rdatasetheader_t *header, const dns_name_t *name);
+static void
+free_domains(dns_rbtdb_t *rbtdb);
 
 /*%
  * 'init_count' is used to initialize 'newheader->count' which inturn
@@ -740,6 +904,15 @@ static atomic_uint_fast32_t init_count = 0;
  *      Database Lock
  *
  * Failure to follow this hierarchy can result in deadlock.
+ *
+ * Readers cannot skip these locks: empty nodes are deleted from the tree
+ * (or queued on the deadnodes lists) by decrement_reference() once their
+ * reference count drops to zero, and rdataset headers are freed by
+ * clean_zone_node() when a version is closed and by the cache cleaning
+ * code.  Nothing defers that reclamation until all readers are done, so
+ * a reader walking the tree or a header chain without tree_lock and the
+ * node lock could follow a pointer to freed memory.  A lookup from
+ * zone_find() takes tree_lock and one node lock, both for reading.
  */
 
 /*
@@ -933,6 +1106,158 @@ set_index(void *what, unsigned int idx) {
 	h->heap_index = idx;
 }
 
+static unsigned int
+next_prime(unsigned int n) {
+	for (;; n++) {
+		unsigned int d;
+
+		for (d = 2; d * d <= n && n % d != 0; d++) {
+			continue;
+		}
+		if (n > 1 && d * d > n) {
+			return (n);
+		}
+	}
+}
+
+/*%
+ * Choose the number of buckets (node locks, LRU lists, heaps and dead node
+ * lists) for a new database.  Caches get at least one bucket per CPU,
+ * unless the count was fixed at compile time.  Zones expected to hold
+ * 'nodes' nodes get one bucket per NODES_PER_NODE_LOCK nodes, but no more
+ * than NODE_LOCKS_PER_CPU per CPU, as more would not reduce contention.
+ */
+static unsigned int
+node_lock_count(bool cache, size_t nodes) {
+	unsigned int ncpus = isc_os_ncpus();
+	size_t count;
+
+	if (cache) {
+#ifdef DNS_RBTDB_CACHE_NODE_LOCK_COUNT
+		return (DEFAULT_CACHE_NODE_LOCK_COUNT);
+#else  /* ifdef DNS_RBTDB_CACHE_NODE_LOCK_COUNT */
+		count = ISC_MAX(DEFAULT_CACHE_NODE_LOCK_COUNT, ncpus);
+#endif /* ifdef DNS_RBTDB_CACHE_NODE_LOCK_COUNT */
+	} else {
+		count = ISC_MIN(nodes / NODES_PER_NODE_LOCK,
+				(size_t)ncpus * NODE_LOCKS_PER_CPU);
+		count = ISC_MAX(count, DEFAULT_NODE_LOCK_COUNT);
+	}
+
+	return (ISC_MIN(next_prime(count), MAX_NODE_LOCK_COUNT));
+}
+
+static void
+create_buckets(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, isc_mem_t *hmctx) {
+	unsigned int count = rbtdb->node_lock_count;
+	bool (*sooner)(void *, void *);
+
+	INSIST(count < (1 << DNS_RBT_LOCKLENGTH));
+	INSIST(count > 1 || !IS_CACHE(rbtdb));
+
+	rbtdb->node_locks = isc_mem_get(mctx, count * sizeof(rbtdb_nodelock_t));
+	for (unsigned int i = 0; i < count; i++) {
+		NODE_INITLOCK(&rbtdb->node_locks[i].lock);
+		isc_refcount_init(&rbtdb->node_locks[i].references, 0);
+		rbtdb->node_locks[i].exiting = false;
+		atomic_init(&rbtdb->node_locks[i].waits, 0);
+		atomic_init(&rbtdb->node_locks[i].stalefail, 0);
+	}
+
+	rbtdb->rdatasets = NULL;
+	rbtdb->protected = NULL;
+	rbtdb->lrucount = NULL;
+	rbtdb->protectedcount = NULL;
+	if (IS_CACHE(rbtdb)) {
+		rbtdb->rdatasets = isc_mem_get(
+			mctx, count * sizeof(rdatasetheaderlist_t));
+		rbtdb->protected = isc_mem_get(
+			mctx, count * sizeof(rdatasetheaderlist_t));
+		rbtdb->lrucount = isc_mem_get(mctx,
+					      count * sizeof(unsigned int));
+		rbtdb->protectedcount = isc_mem_get(
+			mctx, count * sizeof(unsigned int));
+		for (unsigned int i = 0; i < count; i++) {
+			ISC_LIST_INIT(rbtdb->rdatasets[i]);
+			ISC_LIST_INIT(rbtdb->protected[i]);
+			rbtdb->lrucount[i] = 0;
+			rbtdb->protectedcount[i] = 0;
+		}
+	}
+
+	/*
+	 * Create the heaps.
+	 */
+	rbtdb->heaps = isc_mem_get(hmctx, count * sizeof(isc_heap_t *));
+	sooner = IS_CACHE(rbtdb) ? ttl_sooner : resign_sooner;
+	for (unsigned int i = 0; i < count; i++) {
+		rbtdb->heaps[i] = NULL;
+		isc_heap_create(hmctx, sooner, set_index, 0, &rbtdb->heaps[i]);
+	}
+
+	/*
+	 * Create deadnode lists.
+	 */
+	rbtdb->deadnodes = isc_mem_get(mctx, count * sizeof(rbtnodelist_t));
+	for (unsigned int i = 0; i < count; i++) {
+		ISC_LIST_INIT(rbtdb->deadnodes[i]);
+	}
+
+	rbtdb->active = count;
+}
+
+static void
+free_buckets(dns_rbtdb_t *rbtdb) {
+	unsigned int count = rbtdb->node_lock_count;
+
+	for (unsigned int i = 0; i < count; i++) {
+		isc_refcount_destroy(&rbtdb->node_locks[i].references);
+		NODE_DESTROYLOCK(&rbtdb->node_locks[i].lock);
+	}
+
+	/*
+	 * Clean up LRU / re-signing order lists.
+	 */
+	if (rbtdb->rdatasets != NULL) {
+		for (unsigned int i = 0; i < count; i++) {
+			INSIST(ISC_LIST_EMPTY(rbtdb->rdatasets[i]));
+			INSIST(ISC_LIST_EMPTY(rbtdb->protected[i]));
+			INSIST(rbtdb->lrucount[i] == 0);
+		}
+		isc_mem_put(rbtdb->common.mctx, rbtdb->rdatasets,
+			    count * sizeof(rdatasetheaderlist_t));
+		isc_mem_put(rbtdb->common.mctx, rbtdb->protected,
+			    count * sizeof(rdatasetheaderlist_t));
+		isc_mem_put(rbtdb->common.mctx, rbtdb->lrucount,
+			    count * sizeof(unsigned int));
+		isc_mem_put(rbtdb->common.mctx, rbtdb->protectedcount,
+			    count * sizeof(unsigned int));
+	}
+	/*
+	 * Clean up dead node buckets.
+	 */
+	if (rbtdb->deadnodes != NULL) {
+		for (unsigned int i = 0; i < count; i++) {
+			INSIST(ISC_LIST_EMPTY(rbtdb->deadnodes[i]));
+		}
+		isc_mem_put(rbtdb->common.mctx, rbtdb->deadnodes,
+			    count * sizeof(rbtnodelist_t));
+	}
+	/*
+	 * Clean up heap objects.
+	 */
+	if (rbtdb->heaps != NULL) {
+		for (unsigned int i = 0; i < count; i++) {
+			isc_heap_destroy(&rbtdb->heaps[i]);
+		}
+		isc_mem_put(rbtdb->hmctx, rbtdb->heaps,
+			    count * sizeof(isc_heap_t *));
+	}
+
+	isc_mem_put(rbtdb->common.mctx, rbtdb->node_locks,
+		    count * sizeof(rbtdb_nodelock_t));
+}
+
 /*%
  * Work out how many nodes can be deleted in the time between two
  * requests to the nameserver.  Smooth the resulting number and use it
@@ -988,6 +1313,49 @@ adjust_quantum(unsigned int old, isc_time_t *start) {
 	return (nodes);
 }
 
+/*
+ * Allocate 'size' bytes for a slab from the arena of a zone database
+ * that is being loaded.  Larger slabs than fit in a chunk get a chunk
+ * of their own, behind the current one.
+ */
+static void *
+arena_alloc(void *arg, unsigned int size) {
+	dns_rbtdb_t *rbtdb = arg;
+	rbtdb_arena_t *arena = rbtdb->arena;
+	size_t need = ISC_ALIGN((size_t)size, ARENA_ALIGN);
+	unsigned char *base = NULL;
+
+	if (arena == NULL || arena->size - arena->used < need) {
+		size_t asize = ISC_MAX(ARENA_CHUNK_SIZE, ARENA_HDRSIZE + need);
+
+		arena = isc_mem_get(rbtdb->common.mctx, asize);
+		arena->size = asize;
+		arena->used = ARENA_HDRSIZE;
+		if (rbtdb->arena != NULL && asize > ARENA_CHUNK_SIZE) {
+			arena->next = rbtdb->arena->next;
+			rbtdb->arena->next = arena;
+		} else {
+			arena->next = rbtdb->arena;
+			rbtdb->arena = arena;
+		}
+	}
+
+	base = (unsigned char *)arena + arena->used;
+	arena->used += need;
+
+	return (base);
+}
+
+static void
+free_arena(dns_rbtdb_t *rbtdb) {
+	rbtdb_arena_t *arena = NULL;
+
+	while ((arena = rbtdb->arena) != NULL) {
+		rbtdb->arena = arena->next;
+		isc_mem_put(rbtdb->common.mctx, arena, arena->size);
+	}
+}
+
 static void
 free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 	unsigned int i;
@@ -1007,6 +1375,7 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 		isc_refcount_decrementz(&rbtdb->current_version->references);
 		UNLINK(rbtdb->open_versions, rbtdb->current_version, link);
 		isc_rwlock_destroy(&rbtdb->current_version->glue_rwlock);
+		isc_rwlock_destroy(&rbtdb->current_version->wild_rwlock);
 		isc_refcount_destroy(&rbtdb->current_version->references);
 		isc_rwlock_destroy(&rbtdb->current_version->rwlock);
 		isc_mem_put(rbtdb->common.mctx, rbtdb->current_version,
@@ -1087,42 +1456,9 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 	if (dns_name_dynamic(&rbtdb->common.origin)) {
 		dns_name_free(&rbtdb->common.origin, rbtdb->common.mctx);
 	}
-	for (i = 0; i < rbtdb->node_lock_count; i++) {
-		isc_refcount_destroy(&rbtdb->node_locks[i].references);
-		NODE_DESTROYLOCK(&rbtdb->node_locks[i].lock);
-	}
-
-	/*
-	 * Clean up LRU / re-signing order lists.
-	 */
-	if (rbtdb->rdatasets != NULL) {
-		for (i = 0; i < rbtdb->node_lock_count; i++) {
-			INSIST(ISC_LIST_EMPTY(rbtdb->rdatasets[i]));
-		}
-		isc_mem_put(rbtdb->common.mctx, rbtdb->rdatasets,
-			    rbtdb->node_lock_count *
-				    sizeof(rdatasetheaderlist_t));
-	}
-	/*
-	 * Clean up dead node buckets.
-	 */
-	if (rbtdb->deadnodes != NULL) {
-		for (i = 0; i < rbtdb->node_lock_count; i++) {
-			INSIST(ISC_LIST_EMPTY(rbtdb->deadnodes[i]));
-		}
-		isc_mem_put(rbtdb->common.mctx, rbtdb->deadnodes,
-			    rbtdb->node_lock_count * sizeof(rbtnodelist_t));
-	}
-	/*
-	 * Clean up heap objects.
-	 */
-	if (rbtdb->heaps != NULL) {
-		for (i = 0; i < rbtdb->node_lock_count; i++) {
-			isc_heap_destroy(&rbtdb->heaps[i]);
-		}
-		isc_mem_put(rbtdb->hmctx, rbtdb->heaps,
-			    rbtdb->node_lock_count * sizeof(isc_heap_t *));
-	}
+	free_buckets(rbtdb);
+	free_arena(rbtdb);
+	free_domains(rbtdb);
 
 	if (rbtdb->rrsetstats != NULL) {
 		dns_stats_detach(&rbtdb->rrsetstats);
@@ -1134,8 +1470,6 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 		isc_stats_detach(&rbtdb->gluecachestats);
 	}
 
-	isc_mem_put(rbtdb->common.mctx, rbtdb->node_locks,
-		    rbtdb->node_lock_count * sizeof(rbtdb_nodelock_t));
 	isc_rwlock_destroy(&rbtdb->tree_lock);
 	isc_refcount_destroy(&rbtdb->references);
 	if (rbtdb->task != NULL) {
@@ -1168,12 +1502,13 @@ maybe_free_rbtdb(dns_rbtdb_t *rbtdb) {
 	}
 
 	/*
-	 * The current version's glue table needs to be freed early
-	 * so the nodes are dereferenced before we check the active
-	 * node count below.
+	 * The current version's glue table and wildcard cache need to
+	 * be freed early so the nodes are dereferenced before we check
+	 * the active node count below.
 	 */
 	if (rbtdb->current_version != NULL) {
 		free_gluetable(rbtdb->current_version);
+		free_wildcache(rbtdb->current_version);
 	}
 
 	/*
@@ -1259,6 +1594,9 @@ allocate_version(isc_mem_t *mctx, rbtdb_serial_t serial,
 	version->glue_table = isc_mem_get(mctx, size);
 	memset(version->glue_table, 0, size);
 
+	isc_rwlock_init(&version->wild_rwlock, 0, 0);
+	version->wildcache = NULL;
+
 	version->writer = writer;
 	version->commit_ok = false;
 	ISC_LIST_INIT(version->changed_list);
@@ -1373,23 +1711,156 @@ free_noqname(isc_mem_t *mctx, struct noqname **noqname) {
 	*noqname = NULL;
 }
 
+/*%
+ * Return the number of bytes an rdatasetheader_t allocation in 'rbtdb'
+ * has in front of the header itself.
+ */
+static size_t
+header_prefix(dns_rbtdb_t *rbtdb) {
+	return (IS_CACHE(rbtdb) ? sizeof(rdatasetcache_t) : 0);
+}
+
+/*%
+ * Return the size of the allocation holding 'header', including the
+ * prefix and the slab.
+ */
+static size_t
+rdataset_size(dns_rbtdb_t *rbtdb, rdatasetheader_t *header) {
+	if (!NONEXISTENT(header)) {
+		return (header_prefix(rbtdb) +
+			dns_rdataslab_size((unsigned char *)header,
+					   sizeof(*header)));
+	}
+
+	return (header_prefix(rbtdb) + sizeof(*header));
+}
+
+/*%
+ * The memory used by the cached rdatasets below one domain.  A name is
+ * accounted to the domain made of its last two labels, which is where
+ * the delegation of most names is, without having to look it up on
+ * every addition; the key is that domain in lower case wire format.
+ */
+typedef struct rbtdb_domain {
+	uint64_t bytes;
+	unsigned int rdatasets;
+	unsigned int length;
+	unsigned char key[];
+} rbtdb_domain_t;
+
+/*%
+ * Account 'header', which is about to be added at 'name', to its
+ * domain.
+ */
+static void
+domain_add(dns_rbtdb_t *rbtdb, const dns_name_t *name,
+	   rdatasetheader_t *header) {
+	dns_fixedname_t fixed;
+	dns_name_t suffix;
+	dns_name_t *domain = NULL;
+	unsigned int labels = dns_name_countlabels(name);
+	rbtdb_domain_t *d = NULL;
+	isc_region_t r;
+	isc_result_t result;
+
+	dns_name_init(&suffix, NULL);
+	dns_name_getlabelsequence(name, labels - ISC_MIN(labels, 3),
+				  ISC_MIN(labels, 3), &suffix);
+	domain = dns_fixedname_initname(&fixed);
+	result = dns_name_downcase(&suffix, domain, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	dns_name_toregion(domain, &r);
+
+	LOCK(&rbtdb->domain_lock);
+	result = isc_ht_find(rbtdb->domains, r.base, r.length, (void **)&d);
+	if (result != ISC_R_SUCCESS) {
+		d = isc_mem_get(rbtdb->common.mctx, sizeof(*d) + r.length);
+		*d = (rbtdb_domain_t){ .length = r.length };
+		memmove(d->key, r.base, r.length);
+		result = isc_ht_add(rbtdb->domains, d->key, d->length, d);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	d->bytes += rdataset_size(rbtdb, header);
+	d->rdatasets++;
+	UNLOCK(&rbtdb->domain_lock);
+
+	CACHEDATA(header)->domain = d;
+}
+
+/*%
+ * Take 'header', which is being freed, off its domain, and forget the
+ * domain when nothing is left below it.
+ */
+static void
+domain_remove(dns_rbtdb_t *rbtdb, rdatasetheader_t *header) {
+	rbtdb_domain_t *d = CACHEDATA(header)->domain;
+	isc_result_t result;
+
+	LOCK(&rbtdb->domain_lock);
+	INSIST(d->rdatasets > 0);
+	d->bytes -= rdataset_size(rbtdb, header);
+	if (--d->rdatasets == 0) {
+		result = isc_ht_delete(rbtdb->domains, d->key, d->length);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		isc_mem_put(rbtdb->common.mctx, d, sizeof(*d) + d->length);
+	}
+	UNLOCK(&rbtdb->domain_lock);
+
+	CACHEDATA(header)->domain = NULL;
+}
+
+static void
+free_domains(dns_rbtdb_t *rbtdb) {
+	isc_ht_iter_t *it = NULL;
+	isc_result_t result;
+
+	if (rbtdb->domains != NULL) {
+		isc_ht_iter_create(rbtdb->domains, &it);
+		for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+		     result = isc_ht_iter_delcurrent_next(it))
+		{
+			rbtdb_domain_t *d = NULL;
+
+			isc_ht_iter_current(it, (void **)&d);
+			isc_mem_put(rbtdb->common.mctx, d,
+				    sizeof(*d) + d->length);
+		}
+		isc_ht_iter_destroy(&it);
+		isc_ht_destroy(&rbtdb->domains);
+	}
+	isc_mutex_destroy(&rbtdb->domain_lock);
+}
+
 static void
 init_rdataset(dns_rbtdb_t *rbtdb, rdatasetheader_t *h) {
 	ISC_LINK_INIT(h, link);
 	h->heap_index = 0;
+	h->arena = 0;
 	atomic_init(&h->attributes, 0);
-	atomic_init(&h->last_refresh_fail_ts, 0);
 
 	STATIC_ASSERT((sizeof(h->attributes) == 2),
 		      "The .attributes field of rdatasetheader_t needs to be "
 		      "16-bit int type exactly.");
+	STATIC_ASSERT((sizeof(rdatasetcache_t) % sizeof(void *)) == 0,
+		      "rdatasetcache_t must keep the rdatasetheader_t that "
+		      "follows it aligned.");
+
+	if (IS_CACHE(rbtdb)) {
+		rdatasetcache_t *c = CACHEDATA(h);
+
+		atomic_init(&c->last_refresh_fail_ts, 0);
+		c->noqname = NULL;
+		c->closest = NULL;
+		c->last_used = 0;
+		atomic_init(&c->hits, 0);
+		c->protected = false;
+		c->domain = NULL;
+	}
 
 #if TRACE_HEADER
 	if (IS_CACHE(rbtdb) && rbtdb->common.rdclass == dns_rdataclass_in) {
 		fprintf(stderr, "initialized header: %p\n", h);
 	}
-#else  /* if TRACE_HEADER */
-	UNUSED(rbtdb);
 #endif /* if TRACE_HEADER */
 }
 
@@ -1407,8 +1878,10 @@ update_newheader(rdatasetheader_t *newh, rdatasetheader_t *old) {
 static rdatasetheader_t *
 new_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx) {
 	rdatasetheader_t *h;
+	unsigned char *base;
 
-	h = isc_mem_get(mctx, sizeof(*h));
+	base = isc_mem_get(mctx, header_prefix(rbtdb) + sizeof(*h));
+	h = (rdatasetheader_t *)(base + header_prefix(rbtdb));
 
 #if TRACE_HEADER
 	if (IS_CACHE(rbtdb) && rbtdb->common.rdclass == dns_rdataclass_in) {
@@ -1432,7 +1905,7 @@ free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset) {
 	idx = rdataset->node->locknum;
 	if (ISC_LINK_LINKED(rdataset, link)) {
 		INSIST(IS_CACHE(rbtdb));
-		ISC_LIST_UNLINK(rbtdb->rdatasets[idx], rdataset, link);
+		lru_unlink(rbtdb, rdataset);
 	}
 
 	if (rdataset->heap_index != 0) {
@@ -1440,21 +1913,27 @@ free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset) {
 	}
 	rdataset->heap_index = 0;
 
-	if (rdataset->noqname != NULL) {
-		free_noqname(mctx, &rdataset->noqname);
-	}
-	if (rdataset->closest != NULL) {
-		free_noqname(mctx, &rdataset->closest);
-	}
+	if (IS_CACHE(rbtdb)) {
+		rdatasetcache_t *c = CACHEDATA(rdataset);
 
-	if (NONEXISTENT(rdataset)) {
-		size = sizeof(*rdataset);
-	} else {
-		size = dns_rdataslab_size((unsigned char *)rdataset,
-					  sizeof(*rdataset));
+		if (c->noqname != NULL) {
+			free_noqname(mctx, &c->noqname);
+		}
+		if (c->closest != NULL) {
+			free_noqname(mctx, &c->closest);
+		}
+		if (c->domain != NULL) {
+			domain_remove(rbtdb, rdataset);
+		}
 	}
 
-	isc_mem_put(mctx, rdataset, size);
+	if (!rdataset->arena) {
+		unsigned char *base = (unsigned char *)rdataset -
+				      header_prefix(rbtdb);
+
+		size = rdataset_size(rbtdb, rdataset);
+		isc_mem_put(mctx, base, size);
+	}
 }
 
 static void
@@ -2180,6 +2659,95 @@ prune_tree(isc_task_t *task, isc_event_t *event) {
 	detach((dns_db_t **)&rbtdb);
 }
 
+/*%
+ * Called by the RBT library, with tree_lock held for writing, when the
+ * hash table of one of the trees needs to grow.
+ */
+static void
+send_to_rehash_trees(void *arg) {
+	dns_rbtdb_t *rbtdb = arg;
+	isc_event_t *ev;
+	dns_db_t *db = NULL;
+
+	ev = isc_event_allocate(rbtdb->common.mctx, NULL, DNS_EVENT_RBTREHASH,
+				rehash_trees, NULL, sizeof(isc_event_t));
+	attach((dns_db_t *)rbtdb, &db);
+	ev->ev_sender = db;
+	isc_task_send(rbtdb->task, &ev);
+}
+
+/*%
+ * Let the database task grow the hash tables of a cache, a slice at a
+ * time, rather than have the RBT library do it while adding nodes on
+ * behalf of queries.  Loading adds nodes without holding tree_lock, so
+ * it keeps rehashing inline.
+ *
+ * The caller must hold tree_lock for writing.
+ */
+static void
+set_rehash_action(dns_rbtdb_t *rbtdb) {
+	void (*action)(void *) = NULL;
+
+	if (IS_CACHE(rbtdb) && rbtdb->task != NULL &&
+	    (rbtdb->attributes & RBTDB_ATTR_LOADING) == 0)
+	{
+		action = send_to_rehash_trees;
+	}
+
+	dns_rbt_setrehashaction(rbtdb->tree, action, rbtdb);
+	dns_rbt_setrehashaction(rbtdb->nsec, action, rbtdb);
+	dns_rbt_setrehashaction(rbtdb->nsec3, action, rbtdb);
+}
+
+static void
+rehash_trees(isc_task_t *task, isc_event_t *event) {
+	dns_rbtdb_t *rbtdb = event->ev_sender;
+	dns_rbt_t *trees[3];
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_time_t start, end;
+	uint64_t usecs = 0;
+
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	if ((rbtdb->attributes & RBTDB_ATTR_LOADING) == 0) {
+		trees[0] = rbtdb->tree;
+		trees[1] = rbtdb->nsec;
+		trees[2] = rbtdb->nsec3;
+
+		isc_time_now(&start);
+		for (size_t i = 0; i < ARRAY_SIZE(trees); i++) {
+			if (dns_rbt_rehash(trees[i], REHASH_QUANTUM) ==
+			    ISC_R_QUOTA)
+			{
+				result = ISC_R_QUOTA;
+			}
+		}
+		isc_time_now(&end);
+		usecs = isc_time_microdiff(&end, &start);
+	}
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+
+	if (rbtdb->cachestats != NULL) {
+		isc_stats_add(rbtdb->cachestats,
+			      dns_cachestatscounter_rehashtime, usecs);
+		isc_stats_update_if_greater(
+			rbtdb->cachestats,
+			dns_cachestatscounter_rehashslicemax, usecs);
+		if (result == ISC_R_SUCCESS) {
+			isc_stats_increment(rbtdb->cachestats,
+					    dns_cachestatscounter_rehashes);
+		}
+	}
+
+	if (result == ISC_R_QUOTA) {
+		/* Let other events run before the next slice. */
+		isc_task_send(task, &event);
+		return;
+	}
+
+	isc_event_free(&event);
+	detach((dns_db_t **)&rbtdb);
+}
+
 static void
 make_least_version(dns_rbtdb_t *rbtdb, rbtdb_version_t *version,
 		   rbtdb_changedlist_t *cleanup_list) {
@@ -2575,6 +3143,8 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
 		INSIST(EMPTY(cleanup_version->changed_list));
 		free_gluetable(cleanup_version);
 		isc_rwlock_destroy(&cleanup_version->glue_rwlock);
+		free_wildcache(cleanup_version);
+		isc_rwlock_destroy(&cleanup_version->wild_rwlock);
 		isc_rwlock_destroy(&cleanup_version->rwlock);
 		isc_mem_put(rbtdb->common.mctx, cleanup_version,
 			    sizeof(*cleanup_version));
@@ -3093,11 +3663,16 @@ bind_rdataset(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node, rdatasetheader_t *header,
 	/*
 	 * Add noqname proof.
 	 */
-	rdataset->private6 = header->noqname;
+	if (IS_CACHE(rbtdb)) {
+		rdataset->private6 = CACHEDATA(header)->noqname;
+		rdataset->private7 = CACHEDATA(header)->closest;
+	} else {
+		rdataset->private6 = NULL;
+		rdataset->private7 = NULL;
+	}
 	if (rdataset->private6 != NULL) {
 		rdataset->attributes |= DNS_RDATASETATTR_NOQNAME;
 	}
-	rdataset->private7 = header->closest;
 	if (rdataset->private7 != NULL) {
 		rdataset->attributes |= DNS_RDATASETATTR_CLOSEST;
 	}
@@ -3405,6 +3980,108 @@ activeemptynode(rbtdb_search_t *search, const dns_name_t *qname,
 	return (answer);
 }
 
+#define WILDCACHE_SLOT(node) \
+	(((uintptr_t)(node) / sizeof(dns_rbtnode_t)) % RBTDB_WILDCACHE_SIZE)
+
+/*
+ * Look up the wildcard below 'node' in the search's version, setting
+ * '*wnodep' to the active wildcard node or NULL.
+ */
+static bool
+wildcache_find(rbtdb_search_t *search, dns_rbtnode_t *node,
+	       dns_rbtnode_t **wnodep) {
+	rbtdb_version_t *version = search->rbtversion;
+	rbtdb_wildcache_t *entry = NULL;
+	bool found = false;
+
+	if (version->writer) {
+		return (false);
+	}
+
+	RWLOCK(&version->wild_rwlock, isc_rwlocktype_read);
+	if (version->wildcache != NULL) {
+		entry = &version->wildcache[WILDCACHE_SLOT(node)];
+		if (entry->node == node) {
+			*wnodep = entry->wnode;
+			found = true;
+		}
+	}
+	RWUNLOCK(&version->wild_rwlock, isc_rwlocktype_read);
+
+	return (found);
+}
+
+/*
+ * Remember 'wnode', which may be NULL, as the active wildcard below
+ * 'node' in the search's version, unless the slot is already taken.
+ *
+ * Caller must be holding the tree lock and MUST NOT be holding
+ * any node locks.
+ */
+static void
+wildcache_add(rbtdb_search_t *search, dns_rbtnode_t *node,
+	      dns_rbtnode_t *wnode) {
+	dns_rbtdb_t *rbtdb = search->rbtdb;
+	rbtdb_version_t *version = search->rbtversion;
+	rbtdb_wildcache_t *entry = NULL;
+	nodelock_t *lock = NULL;
+
+	if (version->writer) {
+		return;
+	}
+
+	RWLOCK(&version->wild_rwlock, isc_rwlocktype_write);
+	if (version->wildcache == NULL) {
+		version->wildcache = isc_mem_get(
+			rbtdb->common.mctx,
+			RBTDB_WILDCACHE_SIZE * sizeof(*version->wildcache));
+		memset(version->wildcache, 0,
+		       RBTDB_WILDCACHE_SIZE * sizeof(*version->wildcache));
+	}
+	entry = &version->wildcache[WILDCACHE_SLOT(node)];
+	if (entry->node == NULL) {
+		lock = &rbtdb->node_locks[node->locknum].lock;
+		NODE_LOCK(lock, isc_rwlocktype_read);
+		new_reference(rbtdb, node, isc_rwlocktype_read);
+		NODE_UNLOCK(lock, isc_rwlocktype_read);
+		entry->node = node;
+
+		if (wnode != NULL) {
+			lock = &rbtdb->node_locks[wnode->locknum].lock;
+			NODE_LOCK(lock, isc_rwlocktype_read);
+			new_reference(rbtdb, wnode, isc_rwlocktype_read);
+			NODE_UNLOCK(lock, isc_rwlocktype_read);
+		}
+		entry->wnode = wnode;
+	}
+	RWUNLOCK(&version->wild_rwlock, isc_rwlocktype_write);
+}
+
+static void
+free_wildcache(rbtdb_version_t *version) {
+	dns_rbtdb_t *rbtdb = version->rbtdb;
+
+	RWLOCK(&version->wild_rwlock, isc_rwlocktype_write);
+	if (version->wildcache != NULL) {
+		for (size_t i = 0; i < RBTDB_WILDCACHE_SIZE; i++) {
+			rbtdb_wildcache_t *entry = &version->wildcache[i];
+
+			if (entry->node != NULL) {
+				detachnode((dns_db_t *)rbtdb,
+					   (dns_dbnode_t **)&entry->node);
+			}
+			if (entry->wnode != NULL) {
+				detachnode((dns_db_t *)rbtdb,
+					   (dns_dbnode_t **)&entry->wnode);
+			}
+		}
+		isc_mem_put(rbtdb->common.mctx, version->wildcache,
+			    RBTDB_WILDCACHE_SIZE * sizeof(*version->wildcache));
+		version->wildcache = NULL;
+	}
+	RWUNLOCK(&version->wild_rwlock, isc_rwlocktype_write);
+}
+
 static isc_result_t
 find_wildcard(rbtdb_search_t *search, dns_rbtnode_t **nodep,
 	      const dns_name_t *qname) {
@@ -3495,6 +4172,20 @@ find_wildcard(rbtdb_search_t *search, dns_rbtnode_t **nodep,
 			}
 
 			wnode = NULL;
+			if (wildcache_find(search, node, &wnode)) {
+				if (wnode != NULL) {
+					if (activeemptynode(search, qname,
+							    wname))
+					{
+						return (ISC_R_NOTFOUND);
+					}
+					*nodep = wnode;
+					break;
+				}
+				result = ISC_R_NOTFOUND;
+				goto next;
+			}
+
 			dns_rbtnodechain_init(&wchain);
 			result = dns_rbt_findnode(
 				rbtdb->tree, wname, NULL, &wnode, &wchain,
@@ -3523,6 +4214,7 @@ find_wildcard(rbtdb_search_t *search, dns_rbtnode_t **nodep,
 				if (header != NULL ||
 				    activeempty(search, &wchain, wname))
 				{
+					wildcache_add(search, node, wnode);
 					if (activeemptynode(search, qname,
 							    wname))
 					{
@@ -3537,9 +4229,12 @@ find_wildcard(rbtdb_search_t *search, dns_rbtnode_t **nodep,
 					*nodep = wnode;
 					break;
 				}
-			} else if (result != ISC_R_NOTFOUND &&
-				   result != DNS_R_PARTIALMATCH)
+				wildcache_add(search, node, NULL);
+			} else if (result == ISC_R_NOTFOUND ||
+				   result == DNS_R_PARTIALMATCH)
 			{
+				wildcache_add(search, node, NULL);
+			} else {
 				/*
 				 * An error has occurred.  Bail out.
 				 */
@@ -3547,6 +4242,7 @@ find_wildcard(rbtdb_search_t *search, dns_rbtnode_t **nodep,
 			}
 		}
 
+	next:
 		if (active) {
 			/*
 			 * The level node is active.  Any wildcarding
@@ -4479,6 +5175,31 @@ zone_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 	return (ISC_R_NOTIMPLEMENTED);
 }
 
+/*%
+ * Return true if 'search' may return the stale rdatasets at 'node'.
+ * Plain lookups with "stale-refresh-time" enabled only can when a
+ * refresh failed recently; every such failure is recorded in the
+ * bucket of the node, so that lookups in buckets without one can skip
+ * the stale rdatasets without looking at each of them.
+ */
+static bool
+stale_wanted(rbtdb_search_t *search, dns_rbtnode_t *node) {
+	dns_rbtdb_t *rbtdb = search->rbtdb;
+	isc_stdtime_t fail;
+
+	if ((search->options & (DNS_DBFIND_STALEOK | DNS_DBFIND_STALESTART |
+				DNS_DBFIND_STALETIMEOUT)) != 0)
+	{
+		return (true);
+	}
+	if ((search->options & DNS_DBFIND_STALEENABLED) == 0) {
+		return (false);
+	}
+
+	fail = atomic_load_relaxed(&rbtdb->node_locks[node->locknum].stalefail);
+	return (fail != 0 && search->now < fail + rbtdb->serve_stale_refresh);
+}
+
 static bool
 check_stale_header(dns_rbtnode_t *node, rdatasetheader_t *header,
 		   isc_rwlocktype_t *locktype, nodelock_t *lock,
@@ -4486,6 +5207,20 @@ check_stale_header(dns_rbtnode_t *node, rdatasetheader_t *header,
 	if (!ACTIVE(header, search->now)) {
 		dns_ttl_t stale = header->rdh_ttl +
 				  STALE_TTL(header, search->rbtdb);
+		rdatasetcache_t *c = CACHEDATA(header);
+
+		/*
+		 * Skip a header already known to be stale without touching
+		 * its attributes when the search cannot use it, so that the
+		 * lookups of fresh data do not write to every stale header
+		 * they pass.
+		 */
+		if (STALE(header) && KEEPSTALE(search->rbtdb) &&
+		    stale > search->now && !stale_wanted(search, node))
+		{
+			*header_prev = header;
+			return (true);
+		}
 		/*
 		 * If this data is in the stale window keep it and if
 		 * DNS_DBFIND_STALEOK is not set we tell the caller to
@@ -4506,14 +5241,17 @@ check_stale_header(dns_rbtnode_t *node, rdatasetheader_t *header,
 			 * failed.
 			 */
 			if ((search->options & DNS_DBFIND_STALESTART) != 0) {
-				atomic_store_release(
-					&header->last_refresh_fail_ts,
+				atomic_store_release(&c->last_refresh_fail_ts,
+						     search->now);
+				atomic_store_relaxed(
+					&search->rbtdb->node_locks[node->locknum]
+						 .stalefail,
 					search->now);
 			} else if ((search->options &
 				    DNS_DBFIND_STALEENABLED) != 0 &&
 				   search->now <
 					   (atomic_load_acquire(
-						    &header->last_refresh_fail_ts) +
+						    &c->last_refresh_fail_ts) +
 					    search->rbtdb->serve_stale_refresh))
 			{
 				/*
@@ -4672,7 +5410,7 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
 	isc_result_t result = ISC_R_NOTFOUND;
 	dns_name_t name;
 	dns_rbtdb_t *rbtdb;
-	bool done;
+	bool done, update;
 	nodelock_t *lock;
 	isc_rwlocktype_t locktype;
 
@@ -4766,22 +5504,28 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
 					      search->now, locktype,
 					      sigrdataset);
 			}
-			if (need_headerupdate(found, search->now) ||
-			    (foundsig != NULL &&
-			     need_headerupdate(foundsig, search->now)))
+			update = header_hit(rbtdb, found, search->now);
+			if (foundsig != NULL &&
+			    header_hit(rbtdb, foundsig, search->now))
 			{
+				update = true;
+			}
+			if (update) {
 				if (locktype != isc_rwlocktype_write) {
 					NODE_UNLOCK(lock, locktype);
 					NODE_LOCK(lock, isc_rwlocktype_write);
 					locktype = isc_rwlocktype_write;
 					POST(locktype);
 				}
-				if (need_headerupdate(found, search->now)) {
+				if (need_headerupdate(search->rbtdb, found,
+						      search->now))
+				{
 					update_header(search->rbtdb, found,
 						      search->now);
 				}
 				if (foundsig != NULL &&
-				    need_headerupdate(foundsig, search->now))
+				    need_headerupdate(search->rbtdb, foundsig,
+						      search->now))
 				{
 					update_header(search->rbtdb, foundsig,
 						      search->now);
@@ -4809,6 +5553,11 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
  * the potential NSEC owner. If found, we update 'foundname', 'nodep',
  * 'rdataset' and 'sigrdataset', and return DNS_R_COVERINGNSEC.
  * Otherwise, return ISC_R_NOTFOUND.
+ *
+ * The owners of cached NSEC3 records are in the auxiliary NSEC tree
+ * too, so if the potential owner only has an NSEC3 record, that is
+ * returned instead.  When `name` is a hashed owner name, this finds
+ * the NSEC3 record that may cover it with a single lookup.
  */
 static isc_result_t
 find_coveringnsec(rbtdb_search_t *search, const dns_name_t *name,
@@ -4825,6 +5574,7 @@ find_coveringnsec(rbtdb_search_t *search, const dns_name_t *name,
 	nodelock_t *lock = NULL;
 	rbtdb_rdatatype_t matchtype, sigmatchtype;
 	rdatasetheader_t *found = NULL, *foundsig = NULL;
+	rdatasetheader_t *found3 = NULL, *foundsig3 = NULL;
 	rdatasetheader_t *header = NULL;
 	rdatasetheader_t *header_next = NULL, *header_prev = NULL;
 
@@ -4899,9 +5649,17 @@ find_coveringnsec(rbtdb_search_t *search, const dns_name_t *name,
 			if (found != NULL) {
 				break;
 			}
+		} else if (header->type == dns_rdatatype_nsec3) {
+			found3 = header;
+		} else if (header->type == RBTDB_RDATATYPE_SIGNSEC3) {
+			foundsig3 = header;
 		}
 		header_prev = header;
 	}
+	if (found == NULL && found3 != NULL) {
+		found = found3;
+		foundsig = foundsig3;
+	}
 	if (found != NULL) {
 		bind_rdataset(search->rbtdb, node, found, now, locktype,
 			      rdataset);
@@ -5053,7 +5811,7 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 			 * non-stale rdataset at this node.
 			 */
 			empty_node = false;
-			if (header->noqname != NULL &&
+			if (CACHEDATA(header)->noqname != NULL &&
 			    header->trust == dns_trust_secure)
 			{
 				found_noqname = true;
@@ -5170,14 +5928,16 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 			}
 			bind_rdataset(search.rbtdb, node, nsecheader,
 				      search.now, locktype, rdataset);
-			if (need_headerupdate(nsecheader, search.now)) {
+			if (header_hit(search.rbtdb, nsecheader, search.now)) {
 				update = nsecheader;
 			}
 			if (nsecsig != NULL) {
 				bind_rdataset(search.rbtdb, node, nsecsig,
 					      search.now, locktype,
 					      sigrdataset);
-				if (need_headerupdate(nsecsig, search.now)) {
+				if (header_hit(search.rbtdb, nsecsig,
+					       search.now))
+				{
 					updatesig = nsecsig;
 				}
 			}
@@ -5212,14 +5972,16 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 			}
 			bind_rdataset(search.rbtdb, node, nsheader, search.now,
 				      locktype, rdataset);
-			if (need_headerupdate(nsheader, search.now)) {
+			if (header_hit(search.rbtdb, nsheader, search.now)) {
 				update = nsheader;
 			}
 			if (nssig != NULL) {
 				bind_rdataset(search.rbtdb, node, nssig,
 					      search.now, locktype,
 					      sigrdataset);
-				if (need_headerupdate(nssig, search.now)) {
+				if (header_hit(search.rbtdb, nssig,
+					       search.now))
+				{
 					updatesig = nssig;
 				}
 			}
@@ -5273,13 +6035,13 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	{
 		bind_rdataset(search.rbtdb, node, found, search.now, locktype,
 			      rdataset);
-		if (need_headerupdate(found, search.now)) {
+		if (header_hit(search.rbtdb, found, search.now)) {
 			update = found;
 		}
 		if (!NEGATIVE(found) && foundsig != NULL) {
 			bind_rdataset(search.rbtdb, node, foundsig, search.now,
 				      locktype, sigrdataset);
-			if (need_headerupdate(foundsig, search.now)) {
+			if (header_hit(search.rbtdb, foundsig, search.now)) {
 				updatesig = foundsig;
 			}
 		}
@@ -5294,10 +6056,14 @@ node_exit:
 		locktype = isc_rwlocktype_write;
 		POST(locktype);
 	}
-	if (update != NULL && need_headerupdate(update, search.now)) {
+	if (update != NULL &&
+	    need_headerupdate(search.rbtdb, update, search.now))
+	{
 		update_header(search.rbtdb, update, search.now);
 	}
-	if (updatesig != NULL && need_headerupdate(updatesig, search.now)) {
+	if (updatesig != NULL &&
+	    need_headerupdate(search.rbtdb, updatesig, search.now))
+	{
 		update_header(search.rbtdb, updatesig, search.now);
 	}
 
@@ -5341,6 +6107,7 @@ cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 	unsigned int rbtoptions = DNS_RBTFIND_EMPTYDATA;
 	isc_rwlocktype_t locktype;
 	bool dcnull = (dcname == NULL);
+	bool update;
 
 	search.rbtdb = (dns_rbtdb_t *)db;
 
@@ -5466,19 +6233,23 @@ cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 			      locktype, sigrdataset);
 	}
 
-	if (need_headerupdate(found, search.now) ||
-	    (foundsig != NULL && need_headerupdate(foundsig, search.now)))
+	update = header_hit(search.rbtdb, found, search.now);
+	if (foundsig != NULL && header_hit(search.rbtdb, foundsig, search.now))
 	{
+		update = true;
+	}
+	if (update) {
 		if (locktype != isc_rwlocktype_write) {
 			NODE_UNLOCK(lock, locktype);
 			NODE_LOCK(lock, isc_rwlocktype_write);
 			locktype = isc_rwlocktype_write;
 			POST(locktype);
 		}
-		if (need_headerupdate(found, search.now)) {
+		if (need_headerupdate(search.rbtdb, found, search.now)) {
 			update_header(search.rbtdb, found, search.now);
 		}
-		if (foundsig != NULL && need_headerupdate(foundsig, search.now))
+		if (foundsig != NULL &&
+		    need_headerupdate(search.rbtdb, foundsig, search.now))
 		{
 			update_header(search.rbtdb, foundsig, search.now);
 		}
@@ -6146,6 +6917,25 @@ update_recordsandxfrsize(bool add, rbtdb_version_t *rbtversion,
 	RWUNLOCK(&rbtversion->rwlock, isc_rwlocktype_write);
 }
 
+/*
+ * Move the noqname and closest encloser proofs of 'newheader' to the
+ * cache header 'header' when it has none of its own.
+ */
+static void
+merge_proofs(rdatasetheader_t *header, rdatasetheader_t *newheader) {
+	rdatasetcache_t *c = CACHEDATA(header);
+	rdatasetcache_t *newc = CACHEDATA(newheader);
+
+	if (c->noqname == NULL && newc->noqname != NULL) {
+		c->noqname = newc->noqname;
+		newc->noqname = NULL;
+	}
+	if (c->closest == NULL && newc->closest != NULL) {
+		c->closest = newc->closest;
+		newc->closest = NULL;
+	}
+}
+
 /*
  * write lock on rbtnode must be held.
  */
@@ -6444,18 +7234,7 @@ find_header:
 			if (header->rdh_ttl > newheader->rdh_ttl) {
 				set_ttl(rbtdb, header, newheader->rdh_ttl);
 			}
-			if (header->noqname == NULL &&
-			    newheader->noqname != NULL)
-			{
-				header->noqname = newheader->noqname;
-				newheader->noqname = NULL;
-			}
-			if (header->closest == NULL &&
-			    newheader->closest != NULL)
-			{
-				header->closest = newheader->closest;
-				newheader->closest = NULL;
-			}
+			merge_proofs(header, newheader);
 			free_rdataset(rbtdb, rbtdb->common.mctx, newheader);
 			if (addedrdataset != NULL) {
 				bind_rdataset(rbtdb, rbtnode, header, now,
@@ -6496,18 +7275,7 @@ find_header:
 			if (header->rdh_ttl > newheader->rdh_ttl) {
 				set_ttl(rbtdb, header, newheader->rdh_ttl);
 			}
-			if (header->noqname == NULL &&
-			    newheader->noqname != NULL)
-			{
-				header->noqname = newheader->noqname;
-				newheader->noqname = NULL;
-			}
-			if (header->closest == NULL &&
-			    newheader->closest != NULL)
-			{
-				header->closest = newheader->closest;
-				newheader->closest = NULL;
-			}
+			merge_proofs(header, newheader);
 			free_rdataset(rbtdb, rbtdb->common.mctx, newheader);
 			if (addedrdataset != NULL) {
 				bind_rdataset(rbtdb, rbtnode, header, now,
@@ -6522,13 +7290,7 @@ find_header:
 			newheader->down = NULL;
 			idx = newheader->node->locknum;
 			if (IS_CACHE(rbtdb)) {
-				if (ZEROTTL(newheader)) {
-					ISC_LIST_APPEND(rbtdb->rdatasets[idx],
-							newheader, link);
-				} else {
-					ISC_LIST_PREPEND(rbtdb->rdatasets[idx],
-							 newheader, link);
-				}
+				lru_insert(rbtdb, newheader);
 				INSIST(rbtdb->heaps != NULL);
 				isc_heap_insert(rbtdb->heaps[idx], newheader);
 			} else if (RESIGN(newheader)) {
@@ -6563,13 +7325,7 @@ find_header:
 			if (IS_CACHE(rbtdb)) {
 				INSIST(rbtdb->heaps != NULL);
 				isc_heap_insert(rbtdb->heaps[idx], newheader);
-				if (ZEROTTL(newheader)) {
-					ISC_LIST_APPEND(rbtdb->rdatasets[idx],
-							newheader, link);
-				} else {
-					ISC_LIST_PREPEND(rbtdb->rdatasets[idx],
-							 newheader, link);
-				}
+				lru_insert(rbtdb, newheader);
 			} else if (RESIGN(newheader)) {
 				resign_insert(rbtdb, idx, newheader);
 				resign_delete(rbtdb, rbtversion, header);
@@ -6617,13 +7373,7 @@ find_header:
 		idx = newheader->node->locknum;
 		if (IS_CACHE(rbtdb)) {
 			isc_heap_insert(rbtdb->heaps[idx], newheader);
-			if (ZEROTTL(newheader)) {
-				ISC_LIST_APPEND(rbtdb->rdatasets[idx],
-						newheader, link);
-			} else {
-				ISC_LIST_PREPEND(rbtdb->rdatasets[idx],
-						 newheader, link);
-			}
+			lru_insert(rbtdb, newheader);
 		} else if (RESIGN(newheader)) {
 			resign_insert(rbtdb, idx, newheader);
 			resign_delete(rbtdb, rbtversion, header);
@@ -6738,7 +7488,7 @@ addnoqname(dns_rbtdb_t *rbtdb, rdatasetheader_t *newheader,
 	noqname->negsig = r.base;
 	dns_rdataset_disassociate(&neg);
 	dns_rdataset_disassociate(&negsig);
-	newheader->noqname = noqname;
+	CACHEDATA(newheader)->noqname = noqname;
 	return (ISC_R_SUCCESS);
 
 cleanup:
@@ -6783,7 +7533,7 @@ addclosest(dns_rbtdb_t *rbtdb, rdatasetheader_t *newheader,
 	closest->negsig = r.base;
 	dns_rdataset_disassociate(&neg);
 	dns_rdataset_disassociate(&negsig);
-	newheader->closest = closest;
+	CACHEDATA(newheader)->closest = closest;
 	return (ISC_R_SUCCESS);
 
 cleanup:
@@ -6795,16 +7545,6 @@ cleanup:
 
 static dns_dbmethods_t zone_methods;
 
-static size_t
-rdataset_size(rdatasetheader_t *header) {
-	if (!NONEXISTENT(header)) {
-		return (dns_rdataslab_size((unsigned char *)header,
-					   sizeof(*header)));
-	}
-
-	return (sizeof(*header));
-}
-
 static isc_result_t
 addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	    isc_stdtime_t now, dns_rdataset_t *rdataset, unsigned int options,
@@ -6853,8 +7593,9 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		now = 0;
 	}
 
-	result = dns_rdataslab_fromrdataset(rdataset, rbtdb->common.mctx,
-					    &region, sizeof(rdatasetheader_t));
+	result = dns_rdataslab_fromrdataset(
+		rdataset, rbtdb->common.mctx, &region,
+		header_prefix(rbtdb) + sizeof(rdatasetheader_t));
 	if (result != ISC_R_SUCCESS) {
 		return (result);
 	}
@@ -6863,7 +7604,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	nodefullname(db, node, name);
 	dns_rdataset_getownercase(rdataset, name);
 
-	newheader = (rdatasetheader_t *)region.base;
+	newheader = (rdatasetheader_t *)(region.base + header_prefix(rbtdb));
 	init_rdataset(rbtdb, newheader);
 	setownercase(newheader, name);
 	set_ttl(rbtdb, newheader, rdataset->ttl + now);
@@ -6873,12 +7614,15 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	if (rdataset->ttl == 0U) {
 		RDATASET_ATTR_SET(newheader, RDATASET_ATTR_ZEROTTL);
 	}
-	newheader->noqname = NULL;
-	newheader->closest = NULL;
 	atomic_init(&newheader->count,
 		    atomic_fetch_add_relaxed(&init_count, 1));
 	newheader->trust = rdataset->trust;
-	newheader->last_used = now;
+	if (IS_CACHE(rbtdb)) {
+		CACHEDATA(newheader)->last_used = now;
+		if (atomic_load_relaxed(&rbtdb->domainusage)) {
+			domain_add(rbtdb, name, newheader);
+		}
+	}
 	newheader->node = rbtnode;
 	if (rbtversion != NULL) {
 		newheader->serial = rbtversion->serial;
@@ -6941,11 +7685,13 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	}
 
 	/*
-	 * Add to the auxiliary NSEC tree if we're adding an NSEC record.
+	 * Add to the auxiliary NSEC tree if we're adding an NSEC record,
+	 * or an NSEC3 record to a cache.
 	 */
 	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	if (rbtnode->nsec != DNS_RBT_NSEC_HAS_NSEC &&
-	    rdataset->type == dns_rdatatype_nsec)
+	    (rdataset->type == dns_rdatatype_nsec ||
+	     (IS_CACHE(rbtdb) && rdataset->type == dns_rdatatype_nsec3)))
 	{
 		newnsec = true;
 	} else {
@@ -6969,7 +7715,8 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	}
 
 	if (cache_is_overmem) {
-		overmem_purge(rbtdb, rbtnode->locknum, rdataset_size(newheader),
+		overmem_purge(rbtdb, rbtnode->locknum,
+			      rdataset_size(rbtdb, newheader),
 			      tree_locked);
 	}
 
@@ -7044,6 +7791,17 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	}
 
+	/*
+	 * Cached glue that found no addresses for a name is rebuilt once
+	 * any addresses have been added.
+	 */
+	if (result == ISC_R_SUCCESS && IS_CACHE(rbtdb) &&
+	    (rdataset->type == dns_rdatatype_a ||
+	     rdataset->type == dns_rdatatype_aaaa))
+	{
+		atomic_fetch_add_release(&rbtdb->glue_generation, 1);
+	}
+
 	/*
 	 * Update the zone's secure status.  If version is non-NULL
 	 * this is deferred until closeversion() is called.
@@ -7099,11 +7857,8 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	atomic_init(&newheader->attributes, 0);
 	newheader->serial = rbtversion->serial;
 	newheader->trust = 0;
-	newheader->noqname = NULL;
-	newheader->closest = NULL;
 	atomic_init(&newheader->count,
 		    atomic_fetch_add_relaxed(&init_count, 1));
-	newheader->last_used = 0;
 	newheader->node = rbtnode;
 	if ((rdataset->attributes & DNS_RDATASETATTR_RESIGN) != 0) {
 		RDATASET_ATTR_SET(newheader, RDATASET_ATTR_RESIGN);
@@ -7208,13 +7963,10 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 				    RDATASET_ATTR_NONEXISTENT);
 			newheader->trust = 0;
 			newheader->serial = rbtversion->serial;
-			newheader->noqname = NULL;
-			newheader->closest = NULL;
 			atomic_init(&newheader->count, 0);
 			newheader->node = rbtnode;
 			newheader->resign = 0;
 			newheader->resign_lsb = 0;
-			newheader->last_used = 0;
 		} else {
 			free_rdataset(rbtdb, rbtdb->common.mctx, newheader);
 			goto unlock;
@@ -7311,15 +8063,12 @@ deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	newheader->type = RBTDB_RDATATYPE_VALUE(type, covers);
 	atomic_init(&newheader->attributes, RDATASET_ATTR_NONEXISTENT);
 	newheader->trust = 0;
-	newheader->noqname = NULL;
-	newheader->closest = NULL;
 	if (rbtversion != NULL) {
 		newheader->serial = rbtversion->serial;
 	} else {
 		newheader->serial = 0;
 	}
 	atomic_init(&newheader->count, 0);
-	newheader->last_used = 0;
 	newheader->node = rbtnode;
 
 	nodefullname(db, node, nodename);
@@ -7349,12 +8098,12 @@ deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
  * load a non-NSEC3 node in the main tree and optionally to the auxiliary NSEC
  */
 static isc_result_t
-loadnode(dns_rbtdb_t *rbtdb, const dns_name_t *name, dns_rbtnode_t **nodep,
-	 bool hasnsec) {
+loadnode(dns_rbtdb_t *rbtdb, const dns_name_t *name, dns_rbtnode_t *finger,
+	 dns_rbtnode_t **nodep, bool hasnsec) {
 	isc_result_t noderesult, nsecresult, tmpresult;
 	dns_rbtnode_t *nsecnode = NULL, *node = NULL;
 
-	noderesult = dns_rbt_addnode(rbtdb->tree, name, &node);
+	noderesult = dns_rbt_addnodefrom(rbtdb->tree, finger, name, &node);
 	if (!hasnsec) {
 		goto done;
 	}
@@ -7433,9 +8182,20 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 	isc_result_t result;
 	isc_region_t region;
 	rdatasetheader_t *newheader;
+	bool nsec3 = (rdataset->type == dns_rdatatype_nsec3 ||
+		      rdataset->covers == dns_rdatatype_nsec3);
+	dns_rbtnode_t *finger = NULL;
+	bool samenode;
 
 	REQUIRE(rdataset->rdclass == rbtdb->common.rdclass);
 
+	if (loadctx->lastnsec3 == nsec3) {
+		finger = loadctx->lastnode;
+	}
+	samenode = (finger != NULL &&
+		    dns_name_equal(name,
+				   dns_fixedname_name(&loadctx->lastname)));
+
 	/*
 	 * SOA records are only allowed at top of zone.
 	 */
@@ -7445,9 +8205,7 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 		return (DNS_R_NOTZONETOP);
 	}
 
-	if (rdataset->type != dns_rdatatype_nsec3 &&
-	    rdataset->covers != dns_rdatatype_nsec3)
-	{
+	if (!nsec3 && !samenode) {
 		add_empty_wildcards(rbtdb, name, false);
 	}
 
@@ -7464,24 +8222,32 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 		if (rdataset->type == dns_rdatatype_nsec3) {
 			return (DNS_R_INVALIDNSEC3);
 		}
-		result = add_wildcard_magic(rbtdb, name, false);
-		if (result != ISC_R_SUCCESS) {
-			return (result);
+		if (!samenode) {
+			result = add_wildcard_magic(rbtdb, name, false);
+			if (result != ISC_R_SUCCESS) {
+				return (result);
+			}
 		}
 	}
 
 	node = NULL;
-	if (rdataset->type == dns_rdatatype_nsec3 ||
-	    rdataset->covers == dns_rdatatype_nsec3)
-	{
-		result = dns_rbt_addnode(rbtdb->nsec3, name, &node);
+	if (samenode && rdataset->type != dns_rdatatype_nsec) {
+		/*
+		 * Nodes are neither deleted nor moved while a zone is
+		 * being loaded.  NSEC still goes through loadnode() so
+		 * that the auxiliary NSEC tree gets its node.
+		 */
+		node = loadctx->lastnode;
+		result = ISC_R_EXISTS;
+	} else if (nsec3) {
+		result = dns_rbt_addnodefrom(rbtdb->nsec3, finger, name, &node);
 		if (result == ISC_R_SUCCESS) {
 			node->nsec = DNS_RBT_NSEC_NSEC3;
 		}
 	} else if (rdataset->type == dns_rdatatype_nsec) {
-		result = loadnode(rbtdb, name, &node, true);
+		result = loadnode(rbtdb, name, finger, &node, true);
 	} else {
-		result = loadnode(rbtdb, name, &node, false);
+		result = loadnode(rbtdb, name, finger, &node, false);
 	}
 	if (result != ISC_R_SUCCESS && result != ISC_R_EXISTS) {
 		return (result);
@@ -7489,14 +8255,27 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 	if (result == ISC_R_SUCCESS) {
 		node->locknum = node->hashval % rbtdb->node_lock_count;
 	}
+	if (!IS_CACHE(rbtdb) && !samenode) {
+		loadctx->lastnode = node;
+		loadctx->lastnsec3 = nsec3;
+		dns_name_copy(name, dns_fixedname_name(&loadctx->lastname));
+	}
 
-	result = dns_rdataslab_fromrdataset(rdataset, rbtdb->common.mctx,
-					    &region, sizeof(rdatasetheader_t));
+	if (IS_CACHE(rbtdb)) {
+		result = dns_rdataslab_fromrdataset(
+			rdataset, rbtdb->common.mctx, &region,
+			header_prefix(rbtdb) + sizeof(rdatasetheader_t));
+	} else {
+		result = dns_rdataslab_fromrdatasetalloc(
+			rdataset, rbtdb->common.mctx, &region,
+			sizeof(rdatasetheader_t), arena_alloc, rbtdb);
+	}
 	if (result != ISC_R_SUCCESS) {
 		return (result);
 	}
-	newheader = (rdatasetheader_t *)region.base;
+	newheader = (rdatasetheader_t *)(region.base + header_prefix(rbtdb));
 	init_rdataset(rbtdb, newheader);
+	newheader->arena = !IS_CACHE(rbtdb);
 	set_ttl(rbtdb, newheader, rdataset->ttl + loadctx->now); /* XXX overflow
 								  * check */
 	newheader->type = RBTDB_RDATATYPE_VALUE(rdataset->type,
@@ -7504,11 +8283,8 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 	atomic_init(&newheader->attributes, 0);
 	newheader->trust = rdataset->trust;
 	newheader->serial = 1;
-	newheader->noqname = NULL;
-	newheader->closest = NULL;
 	atomic_init(&newheader->count,
 		    atomic_fetch_add_relaxed(&init_count, 1));
-	newheader->last_used = 0;
 	newheader->node = node;
 	setownercase(newheader, name);
 
@@ -7557,14 +8333,20 @@ beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	} else {
 		loadctx->now = 0;
 	}
+	loadctx->lastnode = NULL;
+	loadctx->lastnsec3 = false;
+	dns_fixedname_init(&loadctx->lastname);
 
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
 
 	REQUIRE((rbtdb->attributes &
 		 (RBTDB_ATTR_LOADED | RBTDB_ATTR_LOADING)) == 0);
 	rbtdb->attributes |= RBTDB_ATTR_LOADING;
+	set_rehash_action(rbtdb);
 
 	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 
 	callbacks->add = loading_addrdataset;
 	callbacks->add_private = loadctx;
@@ -7583,6 +8365,7 @@ endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	REQUIRE(loadctx != NULL);
 	REQUIRE(loadctx->rbtdb == rbtdb);
 
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
 
 	REQUIRE((rbtdb->attributes & RBTDB_ATTR_LOADING) != 0);
@@ -7590,6 +8373,8 @@ endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 
 	rbtdb->attributes &= ~RBTDB_ATTR_LOADING;
 	rbtdb->attributes |= RBTDB_ATTR_LOADED;
+	set_rehash_action(rbtdb);
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 
 	/*
 	 * If there's a KEY rdataset at the zone origin containing a
@@ -7728,6 +8513,7 @@ settask(dns_db_t *db, isc_task_t *task) {
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
 	if (rbtdb->task != NULL) {
 		isc_task_detach(&rbtdb->task);
@@ -7735,7 +8521,9 @@ settask(dns_db_t *db, isc_task_t *task) {
 	if (task != NULL) {
 		isc_task_attach(task, &rbtdb->task);
 	}
+	set_rehash_action(rbtdb);
 	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 }
 
 static bool
@@ -8100,57 +8888,369 @@ getservestalerefresh(dns_db_t *db, uint32_t *interval) {
 	return (ISC_R_SUCCESS);
 }
 
-static dns_dbmethods_t zone_methods = { attach,
-					detach,
-					beginload,
-					endload,
-					dump,
-					currentversion,
-					newversion,
-					attachversion,
-					closeversion,
-					findnode,
-					zone_find,
-					zone_findzonecut,
-					attachnode,
-					detachnode,
-					expirenode,
-					printnode,
-					createiterator,
-					zone_findrdataset,
-					allrdatasets,
-					addrdataset,
-					subtractrdataset,
-					deleterdataset,
-					issecure,
-					nodecount,
-					ispersistent,
-					overmem,
-					settask,
-					getoriginnode,
-					NULL, /* transfernode */
-					getnsec3parameters,
-					findnsec3node,
-					setsigningtime,
-					getsigningtime,
-					resigned,
-					isdnssec,
-					NULL, /* getrrsetstats */
-					NULL, /* rpz_attach */
-					NULL, /* rpz_ready */
-					NULL, /* findnodeext */
-					NULL, /* findext */
-					NULL, /* setcachestats */
-					hashsize,
-					nodefullname,
-					getsize,
-					NULL, /* setservestalettl */
-					NULL, /* getservestalettl */
-					NULL, /* setservestalerefresh */
-					NULL, /* getservestalerefresh */
-					setgluecachestats };
+static isc_result_t
+setcachepolicy(dns_db_t *db, dns_cachepolicy_t policy) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
 
-static dns_dbmethods_t cache_methods = { attach,
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+
+	atomic_store_relaxed(&rbtdb->slru, policy == dns_cachepolicy_slru);
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Offer 'header' to the 'size' most popular rdatasets in 'popular',
+ * replacing the least popular one when the array is full.
+ *
+ * Caller must hold the tree lock and the node lock.
+ */
+static void
+popular_add(rdatasetheader_t *header, unsigned int hits,
+	    dns_dbpopular_t *popular, unsigned int size,
+	    unsigned int *countp) {
+	dns_dbpopular_t *p = NULL;
+	isc_result_t result;
+
+	if (*countp < size) {
+		p = &popular[(*countp)++];
+	} else {
+		for (unsigned int i = 0; i < size; i++) {
+			if (popular[i].hits < hits &&
+			    (p == NULL || popular[i].hits < p->hits))
+			{
+				p = &popular[i];
+			}
+		}
+		if (p == NULL) {
+			return;
+		}
+	}
+
+	result = dns_rbt_fullnamefromnode(header->node,
+					  dns_fixedname_initname(&p->fixed));
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	p->type = header->type;
+	p->hits = hits;
+}
+
+/*%
+ * Walk the TTL heap of a bucket from element 'idx' down, skipping the
+ * subtrees whose first element expires after 'expire'.
+ */
+static void
+popular_walk(isc_heap_t *heap, unsigned int idx, isc_stdtime_t now,
+	     isc_stdtime_t expire, unsigned int minhits,
+	     dns_dbpopular_t *popular, unsigned int size,
+	     unsigned int *countp) {
+	rdatasetheader_t *header = isc_heap_element(heap, idx);
+	unsigned int hits;
+
+	if (header == NULL || header->rdh_ttl > expire) {
+		return;
+	}
+
+	hits = atomic_load_relaxed(&CACHEDATA(header)->hits);
+	if (header->rdh_ttl > now && hits >= minhits && PREFETCH(header) &&
+	    RDATASET_ATTR_GET(header, (RDATASET_ATTR_NONEXISTENT |
+				       RDATASET_ATTR_ANCIENT |
+				       RDATASET_ATTR_STALE |
+				       RDATASET_ATTR_NEGATIVE)) == 0 &&
+	    RBTDB_RDATATYPE_BASE(header->type) != dns_rdatatype_rrsig)
+	{
+		popular_add(header, hits, popular, size, countp);
+	}
+
+	popular_walk(heap, idx * 2, now, expire, minhits, popular, size,
+		     countp);
+	popular_walk(heap, idx * 2 + 1, now, expire, minhits, popular, size,
+		     countp);
+}
+
+static void
+findpopular(dns_db_t *db, isc_stdtime_t now, dns_ttl_t window,
+	    unsigned int minhits, dns_dbpopular_t *popular, unsigned int size,
+	    unsigned int *countp) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+
+	if (size == 0) {
+		return;
+	}
+
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	for (unsigned int i = 0; i < rbtdb->node_lock_count; i++) {
+		NODE_LOCK(&rbtdb->node_locks[i].lock, isc_rwlocktype_read);
+		popular_walk(rbtdb->heaps[i], 1, now, now + window, minhits,
+			     popular, size, countp);
+		NODE_UNLOCK(&rbtdb->node_locks[i].lock, isc_rwlocktype_read);
+	}
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+}
+
+static void
+setdomainusage(dns_db_t *db, bool enable) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+
+	LOCK(&rbtdb->domain_lock);
+	if (enable && rbtdb->domains == NULL) {
+		isc_ht_init(&rbtdb->domains, rbtdb->common.mctx, 10,
+			    ISC_HT_CASE_SENSITIVE);
+	}
+	atomic_store_relaxed(&rbtdb->domainusage, enable);
+	UNLOCK(&rbtdb->domain_lock);
+}
+
+static void
+topdomains(dns_db_t *db, dns_dbdomainusage_t *top, unsigned int size,
+	   unsigned int *countp) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	isc_ht_iter_t *it = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+
+	if (size == 0) {
+		return;
+	}
+
+	LOCK(&rbtdb->domain_lock);
+	if (rbtdb->domains == NULL) {
+		UNLOCK(&rbtdb->domain_lock);
+		return;
+	}
+
+	isc_ht_iter_create(rbtdb->domains, &it);
+	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(it))
+	{
+		rbtdb_domain_t *d = NULL;
+		dns_dbdomainusage_t *p = NULL;
+		dns_name_t name;
+		isc_region_t r;
+
+		isc_ht_iter_current(it, (void **)&d);
+		if (*countp < size) {
+			p = &top[(*countp)++];
+		} else {
+			for (unsigned int i = 0; i < size; i++) {
+				if (top[i].bytes < d->bytes &&
+				    (p == NULL || top[i].bytes < p->bytes))
+				{
+					p = &top[i];
+				}
+			}
+			if (p == NULL) {
+				continue;
+			}
+		}
+
+		dns_name_init(&name, NULL);
+		r.base = d->key;
+		r.length = d->length;
+		dns_name_fromregion(&name, &r);
+		dns_name_copy(&name, dns_fixedname_initname(&p->fixed));
+		p->bytes = d->bytes;
+		p->rdatasets = d->rdatasets;
+	}
+	isc_ht_iter_destroy(&it);
+	UNLOCK(&rbtdb->domain_lock);
+}
+
+/*%
+ * Return true if nothing has been stored in, or referenced from, 'rbtdb'
+ * yet, so that its buckets can still be replaced.
+ */
+static bool
+buckets_unused(dns_rbtdb_t *rbtdb) {
+	if ((rbtdb->attributes & (RBTDB_ATTR_LOADED | RBTDB_ATTR_LOADING)) !=
+		    0 ||
+	    rbtdb->future_version != NULL || rbtdb->current_serial != 1 ||
+	    isc_refcount_current(&rbtdb->references) != 1)
+	{
+		return (false);
+	}
+
+	for (unsigned int i = 0; i < rbtdb->node_lock_count; i++) {
+		if (isc_refcount_current(&rbtdb->node_locks[i].references) !=
+			    0 ||
+		    !ISC_LIST_EMPTY(rbtdb->deadnodes[i]) ||
+		    isc_heap_element(rbtdb->heaps[i], 1) != NULL)
+		{
+			return (false);
+		}
+	}
+
+	/*
+	 * Only the origin nodes created by dns_rbtdb_create() may exist.
+	 */
+	return (dns_rbt_nodecount(rbtdb->tree) == 1 &&
+		dns_rbt_nodecount(rbtdb->nsec) == 0 &&
+		dns_rbt_nodecount(rbtdb->nsec3) == 1);
+}
+
+static void
+setsizehint(dns_db_t *db, size_t nodes) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	unsigned int count;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(!IS_CACHE(rbtdb));
+
+	count = node_lock_count(false, nodes);
+
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
+	if (buckets_unused(rbtdb)) {
+		dns_rbt_sizehint(rbtdb->tree, nodes);
+	}
+	if (count != rbtdb->node_lock_count && buckets_unused(rbtdb)) {
+		free_buckets(rbtdb);
+		rbtdb->node_lock_count = count;
+		create_buckets(rbtdb, rbtdb->common.mctx, rbtdb->hmctx);
+
+		rbtdb->origin_node->locknum = rbtdb->origin_node->hashval %
+					      count;
+		rbtdb->nsec3_origin_node->locknum =
+			rbtdb->nsec3_origin_node->hashval % count;
+	}
+	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+}
+
+/*%
+ * Expire the rdatasets at the top of the TTL heap of 'bucket', as
+ * addrdataset() does one at a time.  An rdataset that is already
+ * ancient is still in use, and stays at the top of the heap until it
+ * is released, so cleaning stops there.
+ */
+static isc_result_t
+cleanbucket(dns_db_t *db, unsigned int bucket, isc_stdtime_t now,
+	    unsigned int limit, unsigned int *countp) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	isc_result_t result = DNS_R_CONTINUE;
+	unsigned int count = 0;
+	bool overmem;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+
+	if (bucket >= rbtdb->node_lock_count) {
+		return (ISC_R_RANGE);
+	}
+
+	overmem = isc_mem_isovermem(rbtdb->common.mctx);
+
+	NODE_LOCK(&rbtdb->node_locks[bucket].lock, isc_rwlocktype_write);
+	while (count < limit) {
+		rdatasetheader_t *header = NULL;
+		dns_ttl_t rdh_ttl;
+
+		header = isc_heap_element(rbtdb->heaps[bucket], 1);
+		if (header == NULL || ANCIENT(header)) {
+			result = ISC_R_SUCCESS;
+			break;
+		}
+
+		/* Only account for stale TTL if cache is not overmem */
+		rdh_ttl = header->rdh_ttl;
+		if (!overmem) {
+			rdh_ttl += STALE_TTL(header, rbtdb);
+		}
+		if (rdh_ttl >= now - RBTDB_VIRTUAL) {
+			result = ISC_R_SUCCESS;
+			break;
+		}
+
+		expire_header(rbtdb, header, false, expire_ttl);
+		count++;
+	}
+	NODE_UNLOCK(&rbtdb->node_locks[bucket].lock, isc_rwlocktype_write);
+
+	*countp = count;
+	return (result);
+}
+
+static unsigned int
+nodelockwaits(dns_db_t *db, uint64_t *waits, unsigned int nwaits) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(waits != NULL || nwaits == 0);
+
+	for (unsigned int i = 0; i < nwaits && i < rbtdb->node_lock_count;
+	     i++)
+	{
+		waits[i] = atomic_load_relaxed(&rbtdb->node_locks[i].waits);
+	}
+
+	return (rbtdb->node_lock_count);
+}
+
+static dns_dbmethods_t zone_methods = { attach,
+					detach,
+					beginload,
+					endload,
+					dump,
+					currentversion,
+					newversion,
+					attachversion,
+					closeversion,
+					findnode,
+					zone_find,
+					zone_findzonecut,
+					attachnode,
+					detachnode,
+					expirenode,
+					printnode,
+					createiterator,
+					zone_findrdataset,
+					allrdatasets,
+					addrdataset,
+					subtractrdataset,
+					deleterdataset,
+					issecure,
+					nodecount,
+					ispersistent,
+					overmem,
+					settask,
+					getoriginnode,
+					NULL, /* transfernode */
+					getnsec3parameters,
+					findnsec3node,
+					setsigningtime,
+					getsigningtime,
+					resigned,
+					isdnssec,
+					NULL, /* getrrsetstats */
+					NULL, /* rpz_attach */
+					NULL, /* rpz_ready */
+					NULL, /* findnodeext */
+					NULL, /* findext */
+					NULL, /* setcachestats */
+					hashsize,
+					nodefullname,
+					getsize,
+					NULL, /* setservestalettl */
+					NULL, /* getservestalettl */
+					NULL, /* setservestalerefresh */
+					NULL, /* getservestalerefresh */
+					setgluecachestats,
+					setsizehint,
+					nodelockwaits,
+					NULL, /* setcachepolicy */
+					NULL, /* findpopular */
+					NULL, /* cleanbucket */
+					NULL, /* setdomainusage */
+					NULL /* topdomains */ };
+
+static dns_dbmethods_t cache_methods = { attach,
 					 detach,
 					 beginload,
 					 endload,
@@ -8198,7 +9298,14 @@ static dns_dbmethods_t cache_methods = { attach,
 					 getservestalettl,
 					 setservestalerefresh,
 					 getservestalerefresh,
-					 NULL };
+					 NULL, /* setgluecachestats */
+					 NULL, /* setsizehint */
+					 nodelockwaits,
+					 setcachepolicy,
+					 findpopular,
+					 cleanbucket,
+					 setdomainusage,
+					 topdomains };
 
 isc_result_t
 dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
@@ -8206,9 +9313,7 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 		 void *driverarg, dns_db_t **dbp) {
 	dns_rbtdb_t *rbtdb;
 	isc_result_t result;
-	int i;
 	dns_name_t name;
-	bool (*sooner)(void *, void *);
 	isc_mem_t *hmctx = mctx;
 
 	/* Keep the compiler happy. */
@@ -8244,74 +9349,28 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 
 	isc_rwlock_init(&rbtdb->tree_lock, 0, 0);
 
-	/*
-	 * Initialize node_lock_count in a generic way to support future
-	 * extension which allows the user to specify this value on creation.
-	 * Note that when specified for a cache DB it must be larger than 1
-	 * as commented with the definition of DEFAULT_CACHE_NODE_LOCK_COUNT.
-	 */
-	if (rbtdb->node_lock_count == 0) {
-		if (IS_CACHE(rbtdb)) {
-			rbtdb->node_lock_count = DEFAULT_CACHE_NODE_LOCK_COUNT;
-		} else {
-			rbtdb->node_lock_count = DEFAULT_NODE_LOCK_COUNT;
-		}
-	} else if (rbtdb->node_lock_count < 2 && IS_CACHE(rbtdb)) {
-		result = ISC_R_RANGE;
-		goto cleanup_tree_lock;
-	}
-	INSIST(rbtdb->node_lock_count < (1 << DNS_RBT_LOCKLENGTH));
-	rbtdb->node_locks = isc_mem_get(mctx, rbtdb->node_lock_count *
-						      sizeof(rbtdb_nodelock_t));
-
 	rbtdb->cachestats = NULL;
 	rbtdb->gluecachestats = NULL;
+	atomic_init(&rbtdb->glue_generation, 0);
+	atomic_init(&rbtdb->slru, false);
+	isc_mutex_init(&rbtdb->domain_lock);
+	rbtdb->domains = NULL;
+	atomic_init(&rbtdb->domainusage, false);
 
 	rbtdb->rrsetstats = NULL;
 	if (IS_CACHE(rbtdb)) {
 		result = dns_rdatasetstats_create(mctx, &rbtdb->rrsetstats);
 		if (result != ISC_R_SUCCESS) {
-			goto cleanup_node_locks;
-		}
-		rbtdb->rdatasets = isc_mem_get(
-			mctx,
-			rbtdb->node_lock_count * sizeof(rdatasetheaderlist_t));
-		for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
-			ISC_LIST_INIT(rbtdb->rdatasets[i]);
+			goto cleanup_tree_lock;
 		}
-	} else {
-		rbtdb->rdatasets = NULL;
-	}
-
-	/*
-	 * Create the heaps.
-	 */
-	rbtdb->heaps = isc_mem_get(hmctx, rbtdb->node_lock_count *
-						  sizeof(isc_heap_t *));
-	for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
-		rbtdb->heaps[i] = NULL;
-	}
-	sooner = IS_CACHE(rbtdb) ? ttl_sooner : resign_sooner;
-	for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
-		isc_heap_create(hmctx, sooner, set_index, 0, &rbtdb->heaps[i]);
 	}
 
 	/*
-	 * Create deadnode lists.
+	 * Zone databases start with the default number of buckets; the
+	 * zone may ask for more with dns_db_setsizehint() before loading.
 	 */
-	rbtdb->deadnodes = isc_mem_get(mctx, rbtdb->node_lock_count *
-						     sizeof(rbtnodelist_t));
-	for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
-		ISC_LIST_INIT(rbtdb->deadnodes[i]);
-	}
-
-	rbtdb->active = rbtdb->node_lock_count;
-
-	for (i = 0; i < (int)(rbtdb->node_lock_count); i++) {
-		NODE_INITLOCK(&rbtdb->node_locks[i].lock);
-		isc_refcount_init(&rbtdb->node_locks[i].references, 0);
-		rbtdb->node_locks[i].exiting = false;
-	}
+	rbtdb->node_lock_count = node_lock_count(IS_CACHE(rbtdb), 0);
+	create_buckets(rbtdb, mctx, hmctx);
 
 	/*
 	 * Attach to the mctx.  The database will persist so long as there
@@ -8365,6 +9424,13 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	 * change.
 	 */
 	if (!IS_CACHE(rbtdb)) {
+		/*
+		 * Zone data is looked up far more often than it changes,
+		 * so have the trees that hold owner names keep them whole.
+		 */
+		dns_rbt_setfullnames(rbtdb->tree);
+		dns_rbt_setfullnames(rbtdb->nsec3);
+
 		rbtdb->origin_node = NULL;
 		result = dns_rbt_addnode(rbtdb->tree, &rbtdb->common.origin,
 					 &rbtdb->origin_node);
@@ -8448,17 +9514,39 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 
 	return (ISC_R_SUCCESS);
 
-cleanup_node_locks:
-	isc_mem_put(mctx, rbtdb->node_locks,
-		    rbtdb->node_lock_count * sizeof(rbtdb_nodelock_t));
-
 cleanup_tree_lock:
+	isc_mutex_destroy(&rbtdb->domain_lock);
 	isc_rwlock_destroy(&rbtdb->tree_lock);
 	RBTDB_DESTROYLOCK(&rbtdb->lock);
 	isc_mem_put(mctx, rbtdb, sizeof(*rbtdb));
 	return (result);
 }
 
+void
+dns_rbtdb_makeshard(dns_db_t *db, unsigned int shard,
+		    dns_stats_t *rrsetstats) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+	REQUIRE(rrsetstats != NULL);
+
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
+	INSIST(dns_rbt_nodecount(rbtdb->tree) == 0 &&
+	       dns_rbt_nodecount(rbtdb->nsec) == 0 &&
+	       dns_rbt_nodecount(rbtdb->nsec3) == 0);
+
+	dns_rbt_setshard(rbtdb->tree, shard);
+	dns_rbt_setshard(rbtdb->nsec, shard);
+	dns_rbt_setshard(rbtdb->nsec3, shard);
+
+	dns_stats_detach(&rbtdb->rrsetstats);
+	dns_stats_attach(rrsetstats, &rbtdb->rrsetstats);
+	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+}
+
 /*
  * Slabbed Rdataset Methods
  */
@@ -9603,8 +10691,22 @@ free_gluelist(rbtdb_glue_t *glue_list, dns_rbtdb_t *rbtdb) {
 }
 
 static void
-free_gluetable(rbtdb_version_t *version) {
-	dns_rbtdb_t *rbtdb;
+free_gluetable_node(dns_rbtdb_t *rbtdb, rbtdb_glue_table_node_t *cur) {
+	if (IS_CACHE(rbtdb)) {
+		/* Cache entries hold a reference to their NS node. */
+		detachnode((dns_db_t *)rbtdb, (dns_dbnode_t **)&cur->node);
+	} else {
+		/* isc_refcount_decrement(&cur->node->references); */
+		cur->node = NULL;
+	}
+	free_gluelist(cur->glue_list, rbtdb);
+	cur->glue_list = NULL;
+	isc_mem_put(rbtdb->common.mctx, cur, sizeof(*cur));
+}
+
+static void
+free_gluetable(rbtdb_version_t *version) {
+	dns_rbtdb_t *rbtdb;
 	size_t size, i;
 
 	RWLOCK(&version->glue_rwlock, isc_rwlocktype_write);
@@ -9617,11 +10719,7 @@ free_gluetable(rbtdb_version_t *version) {
 		cur = version->glue_table[i];
 		while (cur != NULL) {
 			cur_next = cur->next;
-			/* isc_refcount_decrement(&cur->node->references); */
-			cur->node = NULL;
-			free_gluelist(cur->glue_list, rbtdb);
-			cur->glue_list = NULL;
-			isc_mem_put(rbtdb->common.mctx, cur, sizeof(*cur));
+			free_gluetable_node(rbtdb, cur);
 			cur = cur_next;
 		}
 		version->glue_table[i] = NULL;
@@ -9819,6 +10917,478 @@ glue_nsdname_cb(void *arg, const dns_name_t *name, dns_rdatatype_t qtype,
 	return (result);
 }
 
+/*
+ * Cached glue for cache databases.
+ *
+ * A cache has no versions whose data stays fixed, so each entry is
+ * keyed by the NS rdataset header it was built for (holding a reference
+ * to its node so that the header cannot be freed and its address
+ * reused), expires with the data it was built from, and each name's
+ * addresses are checked against the current data at their node before
+ * the entry is used.  Building an entry for a name with no usable
+ * addresses, or with addresses that need validating before they can be
+ * used, yields a marker telling the caller to look the addresses up
+ * itself; it is rebuilt once addresses have been added to the cache.
+ */
+#define CACHEGLUE_A	   0
+#define CACHEGLUE_SIGA	   1
+#define CACHEGLUE_AAAA	   2
+#define CACHEGLUE_SIGAAAA  3
+#define CACHEGLUE_SLOTS	   4
+#define CACHEGLUE_NEGATIVE (-2)
+#define CACHEGLUE_OTHER	   (-1)
+
+typedef struct {
+	dns_rbtdb_t *rbtdb;
+	isc_stdtime_t now;
+	isc_stdtime_t expire;
+	bool cacheable;
+	rbtdb_glue_t *glue_list;
+	rbtdb_glue_t **glue_tail;
+} rbtdb_cacheglue_ctx_t;
+
+static int
+cache_glue_slot(rbtdb_rdatatype_t type) {
+	switch (type) {
+	case dns_rdatatype_a:
+		return (CACHEGLUE_A);
+	case RBTDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, dns_rdatatype_a):
+		return (CACHEGLUE_SIGA);
+	case dns_rdatatype_aaaa:
+		return (CACHEGLUE_AAAA);
+	case RBTDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, dns_rdatatype_aaaa):
+		return (CACHEGLUE_SIGAAAA);
+	case RBTDB_RDATATYPE_NCACHEANY:
+	case RBTDB_RDATATYPE_VALUE(0, dns_rdatatype_a):
+	case RBTDB_RDATATYPE_VALUE(0, dns_rdatatype_aaaa):
+		return (CACHEGLUE_NEGATIVE);
+	default:
+		return (CACHEGLUE_OTHER);
+	}
+}
+
+static dns_rdataset_t *
+cache_glue_rdataset(rbtdb_glue_t *glue, int slot) {
+	switch (slot) {
+	case CACHEGLUE_A:
+		return (&glue->rdataset_a);
+	case CACHEGLUE_SIGA:
+		return (&glue->sigrdataset_a);
+	case CACHEGLUE_AAAA:
+		return (&glue->rdataset_aaaa);
+	case CACHEGLUE_SIGAAAA:
+		return (&glue->sigrdataset_aaaa);
+	default:
+		UNREACHABLE();
+	}
+}
+
+static isc_result_t
+cache_glue_nsdname_cb(void *arg, const dns_name_t *name, dns_rdatatype_t qtype,
+		      dns_rdataset_t *unused) {
+	rbtdb_cacheglue_ctx_t *ctx = arg;
+	dns_rbtdb_t *rbtdb = ctx->rbtdb;
+	dns_fixedname_t fixed;
+	dns_name_t *foundname = dns_fixedname_initname(&fixed);
+	dns_rbtnode_t *node = NULL;
+	rdatasetheader_t *header = NULL;
+	rdatasetheader_t *found[CACHEGLUE_SLOTS] = { NULL };
+	rbtdb_glue_t *glue = NULL;
+	nodelock_t *lock = NULL;
+	isc_result_t result;
+	int slot;
+
+	UNUSED(unused);
+
+	/*
+	 * NS records want addresses in additional records.
+	 */
+	INSIST(qtype == dns_rdatatype_a);
+
+	if (!ctx->cacheable) {
+		return (ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Find the name the way query_additional_cb() does when it looks
+	 * for additional data in the cache.
+	 */
+	result = cache_find((dns_db_t *)rbtdb, name, NULL, dns_rdatatype_any,
+			    DNS_DBFIND_GLUEOK | DNS_DBFIND_ADDITIONALOK,
+			    ctx->now, (dns_dbnode_t **)&node, foundname, NULL,
+			    NULL);
+	if (result != ISC_R_SUCCESS) {
+		ctx->cacheable = false;
+		goto cleanup;
+	}
+
+	lock = &rbtdb->node_locks[node->locknum].lock;
+	NODE_LOCK(lock, isc_rwlocktype_read);
+
+	for (header = node->data; header != NULL; header = header->next) {
+		if (!EXISTS(header) || ANCIENT(header) ||
+		    !ACTIVE(header, ctx->now))
+		{
+			continue;
+		}
+		slot = cache_glue_slot(header->type);
+		if (slot == CACHEGLUE_NEGATIVE ||
+		    (slot >= 0 && DNS_TRUST_PENDING(header->trust)))
+		{
+			ctx->cacheable = false;
+		} else if (slot >= 0) {
+			found[slot] = header;
+		}
+	}
+	if (found[CACHEGLUE_A] == NULL && found[CACHEGLUE_AAAA] == NULL) {
+		ctx->cacheable = false;
+	}
+	for (slot = CACHEGLUE_A; slot <= CACHEGLUE_AAAA; slot += 2) {
+		/*
+		 * Signed glue is validated by the caller before use.
+		 */
+		if (found[slot] != NULL && found[slot + 1] != NULL &&
+		    DNS_TRUST_GLUE(found[slot]->trust))
+		{
+			ctx->cacheable = false;
+		}
+	}
+
+	if (ctx->cacheable) {
+		glue = isc_mem_get(rbtdb->common.mctx, sizeof(*glue));
+		glue->next = NULL;
+		dns_name_copy(foundname,
+			      dns_fixedname_initname(&glue->fixedname));
+		for (slot = 0; slot < CACHEGLUE_SLOTS; slot++) {
+			dns_rdataset_init(cache_glue_rdataset(glue, slot));
+			if (found[slot] == NULL) {
+				continue;
+			}
+			bind_rdataset(rbtdb, node, found[slot], ctx->now,
+				      isc_rwlocktype_read,
+				      cache_glue_rdataset(glue, slot));
+			if (found[slot]->rdh_ttl < ctx->expire) {
+				ctx->expire = found[slot]->rdh_ttl;
+			}
+		}
+	}
+
+	NODE_UNLOCK(lock, isc_rwlocktype_read);
+
+	if (glue != NULL) {
+		*ctx->glue_tail = glue;
+		ctx->glue_tail = &glue->next;
+	}
+
+cleanup:
+	if (node != NULL) {
+		detachnode((dns_db_t *)rbtdb, (dns_dbnode_t **)&node);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Check that the addresses in 'glue' are still the current data at
+ * their node.
+ */
+static bool
+cache_glue_current(dns_rbtdb_t *rbtdb, rbtdb_glue_t *glue, isc_stdtime_t now) {
+	rdatasetheader_t *expected[CACHEGLUE_SLOTS] = { NULL };
+	rdatasetheader_t *header = NULL;
+	dns_rbtnode_t *node = NULL;
+	nodelock_t *lock = NULL;
+	bool current = true;
+	int slot;
+
+	for (slot = 0; slot < CACHEGLUE_SLOTS; slot++) {
+		dns_rdataset_t *rdataset = cache_glue_rdataset(glue, slot);
+
+		if (dns_rdataset_isassociated(rdataset)) {
+			header = rdataset->private3;
+			node = rdataset->private2;
+			expected[slot] = header - 1;
+		}
+	}
+	INSIST(node != NULL);
+
+	lock = &rbtdb->node_locks[node->locknum].lock;
+	NODE_LOCK(lock, isc_rwlocktype_read);
+
+	for (header = node->data; header != NULL && current;
+	     header = header->next)
+	{
+		if (!EXISTS(header) || ANCIENT(header) || !ACTIVE(header, now))
+		{
+			continue;
+		}
+		slot = cache_glue_slot(header->type);
+		if (slot == CACHEGLUE_NEGATIVE ||
+		    (slot >= 0 && header != expected[slot]))
+		{
+			current = false;
+		} else if (slot >= 0) {
+			expected[slot] = NULL;
+		}
+	}
+
+	NODE_UNLOCK(lock, isc_rwlocktype_read);
+
+	for (slot = 0; slot < CACHEGLUE_SLOTS; slot++) {
+		if (expected[slot] != NULL) {
+			current = false;
+		}
+	}
+
+	return (current);
+}
+
+/*%
+ * Add the addresses in 'glue' to the additional section of 'msg', unless
+ * they are already in the message, with their TTLs as of 'now'.
+ */
+static void
+cache_glue_addname(rbtdb_glue_t *glue, isc_stdtime_t now, dns_message_t *msg) {
+	dns_name_t *gluename = dns_fixedname_name(&glue->fixedname);
+	dns_name_t *name = NULL;
+	bool newname = false;
+	isc_result_t result;
+	int slot;
+
+	for (slot = CACHEGLUE_A; slot <= CACHEGLUE_AAAA; slot += 2) {
+		dns_rdataset_t *source = cache_glue_rdataset(glue, slot);
+		dns_rdataset_t *sigsource = cache_glue_rdataset(glue, slot + 1);
+		dns_rdataset_t *rdataset = NULL, *sigrdataset = NULL;
+		rdatasetheader_t *header = NULL;
+		dns_section_t section;
+		dns_name_t *mname = NULL;
+
+		if (!dns_rdataset_isassociated(source)) {
+			continue;
+		}
+
+		result = DNS_R_NXDOMAIN;
+		for (section = DNS_SECTION_ANSWER;
+		     section <= DNS_SECTION_ADDITIONAL; section++)
+		{
+			result = dns_message_findname(msg, section, gluename,
+						      source->type, 0, NULL,
+						      NULL);
+			if (result == ISC_R_SUCCESS) {
+				break;
+			}
+		}
+		if (result == ISC_R_SUCCESS) {
+			continue;
+		}
+
+		if (name == NULL) {
+			result = dns_message_findname(
+				msg, DNS_SECTION_ADDITIONAL, gluename,
+				dns_rdatatype_any, 0, &mname, NULL);
+			if (result == ISC_R_SUCCESS) {
+				name = mname;
+			} else {
+				result = dns_message_gettempname(msg, &name);
+				if (result != ISC_R_SUCCESS) {
+					return;
+				}
+				dns_name_copy(gluename, name);
+				newname = true;
+			}
+		}
+
+		result = dns_message_gettemprdataset(msg, &rdataset);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		if (dns_rdataset_isassociated(sigsource)) {
+			result = dns_message_gettemprdataset(msg, &sigrdataset);
+			if (result != ISC_R_SUCCESS) {
+				dns_message_puttemprdataset(msg, &rdataset);
+				break;
+			}
+		}
+
+		header = (rdatasetheader_t *)source->private3 - 1;
+		dns_rdataset_clone(source, rdataset);
+		rdataset->ttl = header->rdh_ttl - now;
+		ISC_LIST_APPEND(name->list, rdataset, link);
+
+		if (sigrdataset != NULL) {
+			header = (rdatasetheader_t *)sigsource->private3 - 1;
+			dns_rdataset_clone(sigsource, sigrdataset);
+			sigrdataset->ttl = header->rdh_ttl - now;
+			ISC_LIST_APPEND(name->list, sigrdataset, link);
+		}
+	}
+
+	if (newname) {
+		if (ISC_LIST_EMPTY(name->list)) {
+			dns_message_puttempname(msg, &name);
+		} else {
+			dns_message_addname(msg, name, DNS_SECTION_ADDITIONAL);
+		}
+	}
+}
+
+static isc_result_t
+cache_addglue(dns_rdataset_t *rdataset, dns_message_t *msg) {
+	dns_rbtdb_t *rbtdb = rdataset->private1;
+	dns_rbtnode_t *node = rdataset->private2;
+	rdatasetheader_t *header = (rdatasetheader_t *)rdataset->private3 - 1;
+	rbtdb_version_t *version = rbtdb->current_version;
+	rbtdb_glue_table_node_t *cur = NULL, **curp = NULL, *stale = NULL;
+	rbtdb_cacheglue_ctx_t ctx;
+	rbtdb_glue_t *ge = NULL;
+	isc_result_t result = ISC_R_NOTFOUND;
+	isc_stdtime_t now;
+	uint_fast32_t generation;
+	bool found = false;
+	bool restarted = false;
+	uint64_t hash;
+	uint32_t idx;
+	size_t i;
+
+	isc_stdtime_get(&now);
+
+	hash = isc_hash_function(&node, sizeof(node), true);
+
+restart:
+	RWLOCK(&version->glue_rwlock, isc_rwlocktype_read);
+
+	idx = hash_32(hash, version->glue_table_bits);
+
+	for (cur = version->glue_table[idx]; cur != NULL; cur = cur->next) {
+		if (cur->node == node && cur->header == header) {
+			break;
+		}
+	}
+
+	if (cur != NULL && cur->expire > now) {
+		if (cur->glue_list == (void *)-1) {
+			/*
+			 * The caller has to look the addresses up, unless
+			 * some have been added since we last tried.
+			 */
+			found = (cur->generation ==
+				 atomic_load_acquire(&rbtdb->glue_generation));
+			result = ISC_R_NOTFOUND;
+		} else {
+			found = true;
+			for (ge = cur->glue_list; ge != NULL && found;
+			     ge = ge->next)
+			{
+				found = cache_glue_current(rbtdb, ge, now);
+			}
+			if (found) {
+				for (ge = cur->glue_list; ge != NULL;
+				     ge = ge->next)
+				{
+					cache_glue_addname(ge, now, msg);
+				}
+				result = ISC_R_SUCCESS;
+			}
+		}
+	}
+
+	RWUNLOCK(&version->glue_rwlock, isc_rwlocktype_read);
+
+	if (found) {
+		return (result);
+	}
+
+	if (restarted) {
+		return (ISC_R_FAILURE);
+	}
+
+	/*
+	 * No usable entry was found.  Build one, replace any previous
+	 * entry for the node with it and restart.  The cache is searched
+	 * without holding the glue table lock.
+	 */
+	generation = atomic_load_acquire(&rbtdb->glue_generation);
+	ctx = (rbtdb_cacheglue_ctx_t){ .rbtdb = rbtdb,
+				       .now = now,
+				       .expire = header->rdh_ttl,
+				       .cacheable = true };
+	ctx.glue_tail = &ctx.glue_list;
+
+	(void)dns_rdataset_additionaldata(rdataset, dns_rootname,
+					  cache_glue_nsdname_cb, &ctx);
+
+	cur = isc_mem_get(rbtdb->common.mctx, sizeof(*cur));
+	*cur = (rbtdb_glue_table_node_t){ .header = header,
+					  .expire = ctx.expire,
+					  .generation = generation };
+	if (ctx.cacheable && ctx.glue_list != NULL) {
+		cur->glue_list = ctx.glue_list;
+	} else {
+		free_gluelist(ctx.glue_list, rbtdb);
+		cur->glue_list = (void *)-1;
+	}
+
+	NODE_LOCK(&rbtdb->node_locks[node->locknum].lock,
+		  isc_rwlocktype_read);
+	new_reference(rbtdb, node, isc_rwlocktype_read);
+	NODE_UNLOCK(&rbtdb->node_locks[node->locknum].lock,
+		    isc_rwlocktype_read);
+	cur->node = node;
+
+	RWLOCK(&version->glue_rwlock, isc_rwlocktype_write);
+
+	if (version->glue_table_nodecount >= RBTDB_GLUE_TABLE_CACHE_MAX) {
+		/*
+		 * Keep the table bounded, as the node references held by
+		 * its entries stop the nodes from being cleaned.
+		 */
+		for (i = 0; i < HASHSIZE(version->glue_table_bits); i++) {
+			while (version->glue_table[i] != NULL) {
+				rbtdb_glue_table_node_t *next =
+					version->glue_table[i]->next;
+				version->glue_table[i]->next = stale;
+				stale = version->glue_table[i];
+				version->glue_table[i] = next;
+			}
+		}
+		version->glue_table_nodecount = 0;
+	} else {
+		idx = hash_32(hash, version->glue_table_bits);
+		curp = &version->glue_table[idx];
+		while (*curp != NULL) {
+			if ((*curp)->node == node) {
+				rbtdb_glue_table_node_t *old = *curp;
+				*curp = old->next;
+				old->next = stale;
+				stale = old;
+				version->glue_table_nodecount--;
+			} else {
+				curp = &(*curp)->next;
+			}
+		}
+	}
+
+	maybe_rehash_gluetable(version);
+	idx = hash_32(hash, version->glue_table_bits);
+
+	cur->next = version->glue_table[idx];
+	version->glue_table[idx] = cur;
+	version->glue_table_nodecount++;
+
+	RWUNLOCK(&version->glue_rwlock, isc_rwlocktype_write);
+
+	while (stale != NULL) {
+		cur = stale;
+		stale = stale->next;
+		free_gluetable_node(rbtdb, cur);
+	}
+
+	restarted = true;
+	goto restart;
+
+	/* UNREACHABLE */
+}
+
 static isc_result_t
 rdataset_addglue(dns_rdataset_t *rdataset, dns_dbversion_t *version,
 		 dns_message_t *msg) {
@@ -9835,8 +11405,16 @@ rdataset_addglue(dns_rdataset_t *rdataset, dns_dbversion_t *version,
 	uint64_t hash;
 
 	REQUIRE(rdataset->type == dns_rdatatype_ns);
+
+	if (IS_CACHE(rbtdb)) {
+		return (cache_addglue(rdataset, msg));
+	}
+	if (rbtversion == NULL) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
 	REQUIRE(rbtdb == rbtversion->rbtdb);
-	REQUIRE(!IS_CACHE(rbtdb) && !IS_STUB(rbtdb));
+	REQUIRE(!IS_STUB(rbtdb));
 
 	/*
 	 * The glue table cache that forms a part of the DB version
@@ -10034,6 +11612,9 @@ no_glue:
 	 */
 	/* isc_refcount_increment0(&node->references); */
 	cur->node = node;
+	cur->header = NULL;
+	cur->expire = 0;
+	cur->generation = 0;
 
 	if (ctx.glue_list == NULL) {
 		/*
@@ -10087,7 +11668,8 @@ no_glue:
  * Caller must hold the node (read or write) lock.
  */
 static bool
-need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now) {
+need_headerupdate(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
+		  isc_stdtime_t now) {
 	if (RDATASET_ATTR_GET(header, (RDATASET_ATTR_NONEXISTENT |
 				       RDATASET_ATTR_ANCIENT |
 				       RDATASET_ATTR_ZEROTTL)) != 0)
@@ -10095,7 +11677,19 @@ need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now) {
 		return (false);
 	}
 
+	/*
+	 * A header that is due to be protected is moved at once.
+	 */
+	if (atomic_load_relaxed(&rbtdb->slru) &&
+	    !CACHEDATA(header)->protected &&
+	    atomic_load_relaxed(&CACHEDATA(header)->hits) >= RBTDB_SLRU_PROMOTE)
+	{
+		return (true);
+	}
+
 #if DNS_RBTDB_LIMITLRUUPDATE
+	isc_stdtime_t last_used = CACHEDATA(header)->last_used;
+
 	if (header->type == dns_rdatatype_ns ||
 	    (header->trust == dns_trust_glue &&
 	     (header->type == dns_rdatatype_a ||
@@ -10105,14 +11699,14 @@ need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now) {
 		 * Glue records are updated if at least DNS_RBTDB_LRUUPDATE_GLUE
 		 * seconds have passed since the previous update time.
 		 */
-		return (header->last_used + DNS_RBTDB_LRUUPDATE_GLUE <= now);
+		return (last_used + DNS_RBTDB_LRUUPDATE_GLUE <= now);
 	}
 
 	/*
 	 * Other records are updated if DNS_RBTDB_LRUUPDATE_REGULAR seconds
 	 * have passed.
 	 */
-	return (header->last_used + DNS_RBTDB_LRUUPDATE_REGULAR <= now);
+	return (last_used + DNS_RBTDB_LRUUPDATE_REGULAR <= now);
 #else
 	UNUSED(now);
 
@@ -10120,36 +11714,153 @@ need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now) {
 #endif /* if DNS_RBTDB_LIMITLRUUPDATE */
 }
 
+/*%
+ * Record that a cache lookup returned 'header', and return whether its
+ * LRU entry needs updating (see need_headerupdate()).  The count is
+ * used by the "slru" policy and by findpopular().
+ *
+ * Caller must hold the node (read or write) lock.
+ */
+static bool
+header_hit(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, isc_stdtime_t now) {
+	rdatasetcache_t *c = CACHEDATA(header);
+
+	if (atomic_load_relaxed(&c->hits) < RBTDB_HITS_MAX) {
+		atomic_fetch_add_relaxed(&c->hits, 1);
+	}
+
+	return (need_headerupdate(rbtdb, header, now));
+}
+
+/*%
+ * Put a new cache header on probation: at the head of the LRU list of
+ * its bucket, or at the tail if it has a zero TTL.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+lru_insert(dns_rbtdb_t *rbtdb, rdatasetheader_t *header) {
+	unsigned int idx = header->node->locknum;
+
+	if (ZEROTTL(header)) {
+		ISC_LIST_APPEND(rbtdb->rdatasets[idx], header, link);
+	} else {
+		ISC_LIST_PREPEND(rbtdb->rdatasets[idx], header, link);
+	}
+	rbtdb->lrucount[idx]++;
+}
+
+/*%
+ * Remove a cache header from whichever LRU list it is on.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+lru_unlink(dns_rbtdb_t *rbtdb, rdatasetheader_t *header) {
+	rdatasetcache_t *c = CACHEDATA(header);
+	unsigned int idx = header->node->locknum;
+
+	if (c->protected) {
+		ISC_LIST_UNLINK(rbtdb->protected[idx], header, link);
+		rbtdb->protectedcount[idx]--;
+		c->protected = false;
+	} else {
+		ISC_LIST_UNLINK(rbtdb->rdatasets[idx], header, link);
+	}
+	rbtdb->lrucount[idx]--;
+}
+
 /*%
  * Update the timestamp of a given cache entry and move it to the head
  * of the corresponding LRU list.
  *
+ * An entry that has been looked up RBTDB_SLRU_PROMOTE times while on
+ * probation is moved to the protected list, so that names looked up
+ * only once (such as the random names of a flood of queries for
+ * nonexistent names) are purged before it (see overmem_purge()).
+ *
  * Caller must hold the node (write) lock.
  *
  * Note that the we do NOT touch the heap here, as the TTL has not changed.
  */
 static void
 update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, isc_stdtime_t now) {
+	rdatasetcache_t *c = CACHEDATA(header);
+	unsigned int idx = header->node->locknum;
+
 	INSIST(IS_CACHE(rbtdb));
 
 	/* To be checked: can we really assume this? XXXMLG */
 	INSIST(ISC_LINK_LINKED(header, link));
 
-	ISC_LIST_UNLINK(rbtdb->rdatasets[header->node->locknum], header, link);
-	header->last_used = now;
-	ISC_LIST_PREPEND(rbtdb->rdatasets[header->node->locknum], header, link);
+	c->last_used = now;
+
+	if (!c->protected &&
+	    (!atomic_load_relaxed(&rbtdb->slru) ||
+	     atomic_load_relaxed(&c->hits) < RBTDB_SLRU_PROMOTE))
+	{
+		ISC_LIST_UNLINK(rbtdb->rdatasets[idx], header, link);
+		ISC_LIST_PREPEND(rbtdb->rdatasets[idx], header, link);
+		return;
+	}
+
+	if (c->protected) {
+		ISC_LIST_UNLINK(rbtdb->protected[idx], header, link);
+	} else {
+		ISC_LIST_UNLINK(rbtdb->rdatasets[idx], header, link);
+		c->protected = true;
+		rbtdb->protectedcount[idx]++;
+		if (rbtdb->cachestats != NULL) {
+			isc_stats_increment(rbtdb->cachestats,
+					    dns_cachestatscounter_promotions);
+		}
+	}
+	ISC_LIST_PREPEND(rbtdb->protected[idx], header, link);
+}
+
+/*%
+ * Move the least recently used protected headers of bucket 'idx' back
+ * to probation while more than RBTDB_SLRU_PROTECTED percent of the
+ * headers of the bucket are protected.  A bucket with nothing on
+ * probation is left alone, as its protected headers would only be
+ * purged at once.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+lru_demote(dns_rbtdb_t *rbtdb, unsigned int idx) {
+	if (ISC_LIST_EMPTY(rbtdb->rdatasets[idx])) {
+		return;
+	}
+
+	while (rbtdb->protectedcount[idx] * 100 >
+	       rbtdb->lrucount[idx] * RBTDB_SLRU_PROTECTED)
+	{
+		rdatasetheader_t *oldest = ISC_LIST_TAIL(rbtdb->protected[idx]);
+
+		ISC_LIST_UNLINK(rbtdb->protected[idx], oldest, link);
+		rbtdb->protectedcount[idx]--;
+		CACHEDATA(oldest)->protected = false;
+		atomic_store_relaxed(&CACHEDATA(oldest)->hits, 0);
+		ISC_LIST_PREPEND(rbtdb->rdatasets[idx], oldest, link);
+	}
 }
 
 static size_t
-expire_lru_headers(dns_rbtdb_t *rbtdb, unsigned int locknum, size_t purgesize,
-		   bool tree_locked) {
+expire_lru_headers(dns_rbtdb_t *rbtdb, rdatasetheaderlist_t *list,
+		   size_t purgesize, bool tree_locked) {
 	rdatasetheader_t *header, *header_prev;
 	size_t purged = 0;
 
-	for (header = ISC_LIST_TAIL(rbtdb->rdatasets[locknum]);
+	for (header = ISC_LIST_TAIL(*list);
 	     header != NULL && purged <= purgesize; header = header_prev)
 	{
 		header_prev = ISC_LIST_PREV(header, link);
+		if (CACHEDATA(header)->protected && rbtdb->cachestats != NULL) {
+			isc_stats_increment(
+				rbtdb->cachestats,
+				dns_cachestatscounter_deleteprotected);
+		}
 		/*
 		 * Unlink the entry at this point to avoid checking it
 		 * again even if it's currently used someone else and
@@ -10157,8 +11868,8 @@ expire_lru_headers(dns_rbtdb_t *rbtdb, unsigned int locknum, size_t purgesize,
 		 * referenced any more (so unlinking is safe) since the
 		 * TTL was reset to 0.
 		 */
-		ISC_LIST_UNLINK(rbtdb->rdatasets[locknum], header, link);
-		size_t header_size = rdataset_size(header);
+		lru_unlink(rbtdb, header);
+		size_t header_size = rdataset_size(rbtdb, header);
 		expire_header(rbtdb, header, tree_locked, expire_lru);
 		purged += header_size;
 	}
@@ -10176,6 +11887,12 @@ expire_lru_headers(dns_rbtdb_t *rbtdb, unsigned int locknum, size_t purgesize,
  * belong.  Otherwise, we might purge entries of the same name of different RR
  * types while adding RRsets from a single response (consider the case where
  * we're adding A and AAAA glue records of the same NS name).
+ *
+ * Entries on probation are purged from all the buckets before any
+ * protected entry is.  So that the protected entries that are no longer
+ * used eventually go, a bucket is first rebalanced to keep no more than
+ * RBTDB_SLRU_PROTECTED percent of its entries protected; the entries
+ * moved back to probation have to be looked up again to be protected.
  */
 static void
 overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start, size_t purgesize,
@@ -10183,18 +11900,27 @@ overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start, size_t purgesize,
 	unsigned int locknum;
 	size_t purged = 0;
 
-	for (locknum = (locknum_start + 1) % rbtdb->node_lock_count;
-	     locknum != locknum_start && purged <= purgesize;
-	     locknum = (locknum + 1) % rbtdb->node_lock_count)
-	{
-		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
-			  isc_rwlocktype_write);
+	for (int pass = 0; pass < 2 && purged <= purgesize; pass++) {
+		rdatasetheaderlist_t *lists = (pass == 0) ? rbtdb->rdatasets
+							  : rbtdb->protected;
 
-		purged += expire_lru_headers(rbtdb, locknum, purgesize - purged,
-					     tree_locked);
+		for (locknum = (locknum_start + 1) % rbtdb->node_lock_count;
+		     locknum != locknum_start && purged <= purgesize;
+		     locknum = (locknum + 1) % rbtdb->node_lock_count)
+		{
+			NODE_LOCK(&rbtdb->node_locks[locknum].lock,
+				  isc_rwlocktype_write);
 
-		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
-			    isc_rwlocktype_write);
+			if (pass == 0) {
+				lru_demote(rbtdb, locknum);
+			}
+			purged += expire_lru_headers(rbtdb, &lists[locknum],
+						     purgesize - purged,
+						     tree_locked);
+
+			NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
+				    isc_rwlocktype_write);
+		}
 	}
 }
 
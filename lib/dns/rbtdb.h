@@ -46,4 +46,20 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *base, dns_dbtype_t type,
  * \li argc == 0 or argv[0] is a valid memory context.
  */
 
+void
+dns_rbtdb_makeshard(dns_db_t *db, unsigned int shard, dns_stats_t *rrsetstats);
+/*%<
+ * Turn the newly created cache database 'db' into shard number 'shard'
+ * of a sharded cache (see sharddb.h): every node it creates records
+ * 'shard', and its RRset counts are kept in 'rrsetstats', which the
+ * shards share, instead of in statistics of its own.
+ *
+ * Requires:
+ *
+ * \li 'db' is a cache database created by dns_rbtdb_create() that has
+ *     not been used yet.
+ *
+ * \li 'shard' <= UINT8_MAX and 'rrsetstats' is valid.
+ */
+
 ISC_LANG_ENDDECLS
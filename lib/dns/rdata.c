@@ -940,6 +940,164 @@ failure:
 	return (result);
 }
 
+/*
+ * Parse the rdata of some of the most common types, starting from
+ * 'first', the token that dns_rdata_fromtext() has already read.  This
+ * saves pushing that token back and lexing it a second time, which is
+ * a good part of the work of loading a large zone.
+ *
+ * If 'first' cannot be handled here, nothing has been consumed or
+ * written and ISC_R_NOTIMPLEMENTED is returned; the type's own parser
+ * then deals with it, and reports any error.  Once 'first' has been
+ * used, this behaves exactly as the type's own parser would.
+ */
+static isc_result_t
+fromtext_first(dns_rdataclass_t rdclass, dns_rdatatype_t type,
+	       isc_lex_t *lexer, isc_token_t *first, const dns_name_t *origin,
+	       unsigned int options, isc_buffer_t *target,
+	       dns_rdatacallbacks_t *callbacks) {
+	isc_token_t token;
+	dns_name_t name;
+	isc_buffer_t buffer;
+	isc_region_t region;
+	unsigned char addr[16];
+	unsigned int used = isc_buffer_usedlength(target);
+	unsigned int addrlen;
+	uint32_t value;
+	bool ok;
+
+	if (origin == NULL) {
+		origin = dns_rootname;
+	}
+
+	switch (type) {
+	case dns_rdatatype_a:
+	case dns_rdatatype_aaaa:
+		if (rdclass != dns_rdataclass_in ||
+		    first->type != isc_tokentype_string)
+		{
+			break;
+		}
+		addrlen = (type == dns_rdatatype_a) ? 4 : 16;
+		if (inet_pton((addrlen == 4) ? AF_INET : AF_INET6,
+			      DNS_AS_STR(*first), addr) != 1)
+		{
+			break;
+		}
+		isc_buffer_availableregion(target, &region);
+		if (region.length < addrlen) {
+			break;
+		}
+		memmove(region.base, addr, addrlen);
+		isc_buffer_add(target, addrlen);
+		return (ISC_R_SUCCESS);
+
+	case dns_rdatatype_ns:
+	case dns_rdatatype_cname:
+		if (first->type != isc_tokentype_string) {
+			break;
+		}
+		dns_name_init(&name, NULL);
+		buffer_fromregion(&buffer, &first->value.as_region);
+		if (dns_name_fromtext(&name, &buffer, origin, options,
+				      target) != ISC_R_SUCCESS)
+		{
+			break;
+		}
+		ok = true;
+		if (type == dns_rdatatype_ns &&
+		    (options & DNS_RDATA_CHECKNAMES) != 0)
+		{
+			ok = dns_name_ishostname(&name, false);
+		}
+		if (!ok && (options & DNS_RDATA_CHECKNAMESFAIL) != 0) {
+			break;
+		}
+		if (!ok && callbacks != NULL) {
+			warn_badname(&name, lexer, callbacks);
+		}
+		return (ISC_R_SUCCESS);
+
+	case dns_rdatatype_mx:
+		/*
+		 * Only take a plain decimal preference, which is what
+		 * the lexer would have returned as a number.
+		 */
+		if (first->type != isc_tokentype_string ||
+		    first->value.as_textregion.length > 5 ||
+		    strspn(DNS_AS_STR(*first), decdigits) !=
+			    first->value.as_textregion.length)
+		{
+			break;
+		}
+		value = (uint32_t)strtoul(DNS_AS_STR(*first), NULL, 10);
+		if (value > 0xffffU ||
+		    uint16_tobuffer(value, target) != ISC_R_SUCCESS)
+		{
+			break;
+		}
+
+		RETERR(isc_lex_getmastertoken(lexer, &token,
+					      isc_tokentype_string, false));
+
+		ok = true;
+		if ((options & DNS_RDATA_CHECKMX) != 0) {
+			ok = check_mx(&token);
+		}
+		if (!ok && (options & DNS_RDATA_CHECKMXFAIL) != 0) {
+			RETTOK(DNS_R_MXISADDRESS);
+		}
+		if (!ok && callbacks != NULL) {
+			warn_badmx(&token, lexer, callbacks);
+		}
+
+		dns_name_init(&name, NULL);
+		buffer_fromregion(&buffer, &token.value.as_region);
+		RETTOK(dns_name_fromtext(&name, &buffer, origin, options,
+					 target));
+		ok = true;
+		if ((options & DNS_RDATA_CHECKNAMES) != 0) {
+			ok = dns_name_ishostname(&name, false);
+		}
+		if (!ok && (options & DNS_RDATA_CHECKNAMESFAIL) != 0) {
+			RETTOK(DNS_R_BADNAME);
+		}
+		if (!ok && callbacks != NULL) {
+			warn_badname(&name, lexer, callbacks);
+		}
+		return (ISC_R_SUCCESS);
+
+	case dns_rdatatype_txt:
+		if ((first->type != isc_tokentype_string &&
+		     first->type != isc_tokentype_qstring) ||
+		    txt_fromtext(&first->value.as_textregion, target) !=
+			    ISC_R_SUCCESS)
+		{
+			break;
+		}
+		for (;;) {
+			RETERR(isc_lex_getmastertoken(
+				lexer, &token, isc_tokentype_qstring, true));
+			if (token.type != isc_tokentype_qstring &&
+			    token.type != isc_tokentype_string)
+			{
+				break;
+			}
+			RETTOK(txt_fromtext(&token.value.as_textregion,
+					    target));
+		}
+		/* Let upper layer handle eol/eof. */
+		isc_lex_ungettoken(lexer, &token);
+		return (ISC_R_SUCCESS);
+
+	default:
+		break;
+	}
+
+	target->used = used;
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 isc_result_t
 dns_rdata_fromtext(dns_rdata_t *rdata, dns_rdataclass_t rdclass,
 		   dns_rdatatype_t type, isc_lex_t *lexer,
@@ -958,6 +1116,7 @@ dns_rdata_fromtext(dns_rdata_t *rdata, dns_rdataclass_t rdclass,
 	isc_result_t tresult;
 	unsigned int length;
 	bool unknown;
+	bool parsed = false;
 
 	REQUIRE(origin == NULL || dns_name_isabsolute(origin));
 	if (rdata != NULL) {
@@ -1011,10 +1170,16 @@ dns_rdata_fromtext(dns_rdata_t *rdata, dns_rdataclass_t rdclass,
 			options |= DNS_RDATA_UNKNOWNESCAPE;
 		}
 	} else {
-		isc_lex_ungettoken(lexer, &token);
+		result = fromtext_first(rdclass, type, lexer, &token, origin,
+					options, target, callbacks);
+		if (result == ISC_R_NOTIMPLEMENTED) {
+			isc_lex_ungettoken(lexer, &token);
+		} else {
+			parsed = true;
+		}
 	}
 
-	if (!unknown) {
+	if (!unknown && !parsed) {
 		FROMTEXTSWITCH
 
 		/*
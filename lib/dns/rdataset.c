@@ -16,6 +16,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <isc/buffer.h>
 #include <isc/mem.h>
@@ -302,6 +303,63 @@ swap_rdata(dns_rdata_t *in, unsigned int a, unsigned int b) {
 	in[b] = rdata;
 }
 
+/*
+ * Stable sort of 'out' by key.  Sortlists produce few distinct keys for
+ * a handful of records, for which this beats qsort() and its calls
+ * through towire_compare(); it also keeps the random or cyclic order
+ * of records with the same key.
+ */
+static void
+sort_keys(struct towire_sort *out, unsigned int count) {
+	if (count > MAX_SHUFFLE) {
+		qsort(out, count, sizeof(out[0]), towire_compare);
+		return;
+	}
+
+	for (unsigned int i = 1; i < count; i++) {
+		struct towire_sort cur = out[i];
+		unsigned int j = i;
+
+		while (j > 0 && out[j - 1].key > cur.key) {
+			out[j] = out[j - 1];
+			j--;
+		}
+		out[j] = cur;
+	}
+}
+
+/*
+ * Return true if rdata of this type and class is rendered by copying it
+ * verbatim: there are no embedded names for towire to compress or to
+ * record as compression targets, other than the RRSIG signer, which is
+ * never compressed.
+ */
+static bool
+towire_verbatim(dns_rdatatype_t type, dns_rdataclass_t rdclass) {
+	switch (type) {
+	case dns_rdatatype_a:
+		return (rdclass == dns_rdataclass_in);
+	case dns_rdatatype_aaaa:
+	case dns_rdatatype_txt:
+	case dns_rdatatype_spf:
+	case dns_rdatatype_dnskey:
+	case dns_rdatatype_cdnskey:
+	case dns_rdatatype_ds:
+	case dns_rdatatype_cds:
+	case dns_rdatatype_rrsig:
+	case dns_rdatatype_nsec3:
+	case dns_rdatatype_nsec3param:
+	case dns_rdatatype_tlsa:
+	case dns_rdatatype_sshfp:
+	case dns_rdatatype_caa:
+	case dns_rdatatype_openpgpkey:
+	case dns_rdatatype_zonemd:
+		return (true);
+	default:
+		return (false);
+	}
+}
+
 static isc_result_t
 towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 	     dns_compress_t *cctx, isc_buffer_t *target,
@@ -309,16 +367,16 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 	     unsigned int options, unsigned int *countp, void **state) {
 	isc_region_t r;
 	isc_result_t result;
-	unsigned int i, count = 0, added;
+	unsigned int i, count = 0, added, rotate = 0;
 	isc_buffer_t savedbuffer, rdlen, rrbuffer;
 	unsigned int headlen;
 	bool question = false;
-	bool shuffle = false, sort = false;
+	bool shuffle = false, sort = false, verbatim;
 	bool want_random, want_cyclic;
 	dns_rdata_t in_fixed[MAX_SHUFFLE];
-	dns_rdata_t *in = in_fixed;
+	dns_rdata_t *in = NULL;
 	struct towire_sort out_fixed[MAX_SHUFFLE];
-	struct towire_sort *out = out_fixed;
+	struct towire_sort *out = NULL;
 	dns_fixedname_t fixed;
 	dns_name_t *name;
 	uint16_t offset;
@@ -371,24 +429,22 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 		if (order != NULL) {
 			sort = true;
 		}
-		if (want_random || want_cyclic) {
+		if (want_random) {
 			shuffle = true;
+		} else if (want_cyclic &&
+			   rdataset->count != DNS_RDATASET_COUNT_UNDEFINED)
+		{
+			rotate = rdataset->count % count;
 		}
 	}
 
-	if ((shuffle || sort)) {
+	if (shuffle || sort) {
+		uint32_t seed = 0;
+
+		in = in_fixed;
 		if (count > MAX_SHUFFLE) {
 			in = isc_mem_get(cctx->mctx, count * sizeof(*in));
-			out = isc_mem_get(cctx->mctx, count * sizeof(*out));
-			if (in == NULL || out == NULL) {
-				shuffle = sort = false;
-			}
 		}
-	}
-
-	if ((shuffle || sort)) {
-		uint32_t seed = 0;
-		unsigned int j = 0;
 
 		/*
 		 * First we get handles to all of the rdata.
@@ -406,32 +462,36 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 		}
 		INSIST(i == count);
 
-		if (want_random) {
+		if (shuffle) {
 			seed = isc_random32();
+			for (i = 0; i < count - 1; i++) {
+				swap_rdata(in, i, i + seed % (count - i));
+			}
 		}
 
-		if (want_cyclic &&
-		    (rdataset->count != DNS_RDATASET_COUNT_UNDEFINED))
-		{
-			j = rdataset->count % count;
-		}
-
-		for (i = 0; i < count; i++) {
-			if (want_random) {
-				swap_rdata(in, j, j + seed % (count - j));
+		/*
+		 * Sortlist order, starting from the cyclic or random order.
+		 */
+		if (sort) {
+			out = out_fixed;
+			if (count > MAX_SHUFFLE) {
+				out = isc_mem_get(cctx->mctx,
+						  count * sizeof(*out));
 			}
-
-			out[i].key = (sort) ? (*order)(&in[j], order_arg) : 0;
-			out[i].rdata = &in[j];
-			if (++j == count) {
-				j = 0;
+			for (i = 0; i < count; i++) {
+				out[i].rdata = &in[(rotate + i) % count];
+				out[i].key = (*order)(out[i].rdata, order_arg);
 			}
+			sort_keys(out, count);
 		}
+	} else {
 		/*
-		 * Sortlist order.
+		 * Cyclic order without a sortlist needs no handles: start
+		 * 'rotate' records in and wrap around.
 		 */
-		if (sort) {
-			qsort(out, count, sizeof(out[0]), towire_compare);
+		for (i = 0; i < rotate; i++) {
+			result = dns_rdataset_next(rdataset);
+			INSIST(result == ISC_R_SUCCESS);
 		}
 	}
 
@@ -446,6 +506,8 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 
 	name->attributes |= owner_name->attributes & DNS_NAMEATTR_NOCOMPRESS;
 
+	verbatim = towire_verbatim(rdataset->type, rdataset->rdclass);
+
 	do {
 		/*
 		 * Copy out the name, type, class, ttl.
@@ -483,15 +545,35 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 			/*
 			 * Copy out the rdata
 			 */
-			if (shuffle || sort) {
+			if (sort) {
 				rdata = *(out[i].rdata);
+			} else if (shuffle) {
+				rdata = in[i];
 			} else {
 				dns_rdata_reset(&rdata);
 				dns_rdataset_current(rdataset, &rdata);
 			}
-			result = dns_rdata_towire(&rdata, cctx, target);
-			if (result != ISC_R_SUCCESS) {
-				goto rollback;
+			if (verbatim &&
+			    (rdata.flags & DNS_RDATA_UPDATE) == 0)
+			{
+				/*
+				 * The owner name is a pointer after the
+				 * first record, so this is the whole
+				 * record: copy the rdata as it is stored.
+				 */
+				isc_buffer_availableregion(target, &r);
+				if (r.length < rdata.length) {
+					result = ISC_R_NOSPACE;
+					goto rollback;
+				}
+				memmove(r.base, rdata.data, rdata.length);
+				isc_buffer_add(target, rdata.length);
+			} else {
+				result = dns_rdata_towire(&rdata, cctx,
+							  target);
+				if (result != ISC_R_SUCCESS) {
+					goto rollback;
+				}
 			}
 			INSIST((target->used >= rdlen.used + 2) &&
 			       (target->used - rdlen.used - 2 < 65536));
@@ -508,6 +590,16 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 			} else {
 				result = ISC_R_SUCCESS;
 			}
+		} else if (rotate != 0) {
+			i++;
+			if (i == count) {
+				result = ISC_R_NOMORE;
+			} else {
+				result = dns_rdataset_next(rdataset);
+				if (result == ISC_R_NOMORE) {
+					result = dns_rdataset_first(rdataset);
+				}
+			}
 		} else {
 			result = dns_rdataset_next(rdataset);
 		}
@@ -112,9 +112,26 @@ fillin_offsets(unsigned char *offsetbase, unsigned int *offsettable,
 }
 #endif /* if DNS_RDATASET_FIXED */
 
+static unsigned char *
+slab_alloc(isc_mem_t *mctx, dns_rdataslab_alloc_t alloc, void *arg,
+	   unsigned int size) {
+	if (alloc != NULL) {
+		return ((alloc)(arg, size));
+	}
+	return (isc_mem_get(mctx, size));
+}
+
 isc_result_t
 dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 			   isc_region_t *region, unsigned int reservelen) {
+	return (dns_rdataslab_fromrdatasetalloc(rdataset, mctx, region,
+						reservelen, NULL, NULL));
+}
+
+isc_result_t
+dns_rdataslab_fromrdatasetalloc(dns_rdataset_t *rdataset, isc_mem_t *mctx,
+				isc_region_t *region, unsigned int reservelen,
+				dns_rdataslab_alloc_t alloc, void *arg) {
 	/*
 	 * Use &removed as a sentinel pointer for duplicate
 	 * rdata as rdata.data == NULL is valid.
@@ -147,7 +164,7 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 		if (rdataset->type != 0) {
 			return (ISC_R_FAILURE);
 		}
-		rawbuf = isc_mem_get(mctx, buflen);
+		rawbuf = slab_alloc(mctx, alloc, arg, buflen);
 		region->base = rawbuf;
 		region->length = buflen;
 		rawbuf += reservelen;
@@ -269,7 +286,7 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 	 * Allocate the memory, set up a buffer, start copying in
 	 * data.
 	 */
-	rawbuf = isc_mem_get(mctx, buflen);
+	rawbuf = slab_alloc(mctx, alloc, arg, buflen);
 
 #if DNS_RDATASET_FIXED
 	/* Allocate temporary offset table. */
@@ -20,6 +20,7 @@
 #include <isc/mem.h>
 #include <isc/netmgr.h>
 #include <isc/result.h>
+#include <isc/stdtime.h>
 #include <isc/task.h>
 #include <isc/thread.h>
 #include <isc/util.h>
@@ -45,6 +46,21 @@ typedef ISC_LIST(dns_request_t) dns_requestlist_t;
 
 #define DNS_REQUEST_NLOCKS 7
 
+/*%
+ * UDP dispatches for explicit source addresses, such as those of
+ * notify-source and transfer-source, are kept for reuse, so that not
+ * every request has to check the address and set up a new dispatch.
+ * Those not used for DNS_REQUEST_UDPIDLE seconds are released.
+ */
+#define DNS_REQUEST_UDPPOOL 16
+#define DNS_REQUEST_UDPIDLE 600
+
+typedef struct requestmgr_udp {
+	dns_dispatch_t *dispatch;
+	isc_sockaddr_t local;
+	isc_stdtime_t lastused;
+} requestmgr_udp_t;
+
 struct dns_requestmgr {
 	unsigned int magic;
 	isc_refcount_t references;
@@ -62,6 +78,7 @@ struct dns_requestmgr {
 	unsigned int hash;
 	isc_mutex_t locks[DNS_REQUEST_NLOCKS];
 	dns_requestlist_t requests;
+	requestmgr_udp_t udppool[DNS_REQUEST_UDPPOOL];
 };
 
 struct dns_request {
@@ -317,6 +334,11 @@ mgr_destroy(dns_requestmgr_t *requestmgr) {
 	if (requestmgr->dispatchv6 != NULL) {
 		dns_dispatch_detach(&requestmgr->dispatchv6);
 	}
+	for (i = 0; i < DNS_REQUEST_UDPPOOL; i++) {
+		if (requestmgr->udppool[i].dispatch != NULL) {
+			dns_dispatch_detach(&requestmgr->udppool[i].dispatch);
+		}
+	}
 	if (requestmgr->dispatchmgr != NULL) {
 		dns_dispatchmgr_detach(&requestmgr->dispatchmgr);
 	}
@@ -420,6 +442,64 @@ tcp_dispatch(bool newtcp, dns_requestmgr_t *requestmgr,
 	return (result);
 }
 
+/*
+ * Get the pooled UDP dispatch for 'srcaddr', creating it if needed in
+ * a free slot or in place of the least recently used one.
+ */
+static isc_result_t
+udp_pooled_dispatch(dns_requestmgr_t *requestmgr,
+		    const isc_sockaddr_t *srcaddr, dns_dispatch_t **dispatchp) {
+	isc_result_t result;
+	requestmgr_udp_t *slot = NULL;
+	dns_dispatch_t *disp = NULL;
+	isc_stdtime_t now;
+
+	isc_stdtime_get(&now);
+
+	LOCK(&requestmgr->lock);
+	for (size_t i = 0; i < DNS_REQUEST_UDPPOOL; i++) {
+		requestmgr_udp_t *udp = &requestmgr->udppool[i];
+
+		if (udp->dispatch != NULL &&
+		    udp->lastused + DNS_REQUEST_UDPIDLE < now)
+		{
+			dns_dispatch_detach(&udp->dispatch);
+		}
+		if (udp->dispatch == NULL) {
+			if (slot == NULL || slot->dispatch != NULL) {
+				slot = udp;
+			}
+			continue;
+		}
+		if (isc_sockaddr_equal(&udp->local, srcaddr)) {
+			udp->lastused = now;
+			dns_dispatch_attach(udp->dispatch, dispatchp);
+			UNLOCK(&requestmgr->lock);
+			return (ISC_R_SUCCESS);
+		}
+		if (slot == NULL ||
+		    (slot->dispatch != NULL && udp->lastused < slot->lastused))
+		{
+			slot = udp;
+		}
+	}
+
+	result = dns_dispatch_createudp(requestmgr->dispatchmgr, srcaddr,
+					&disp);
+	if (result == ISC_R_SUCCESS) {
+		if (slot->dispatch != NULL) {
+			dns_dispatch_detach(&slot->dispatch);
+		}
+		*slot = (requestmgr_udp_t){ .local = *srcaddr,
+					    .lastused = now };
+		dns_dispatch_attach(disp, &slot->dispatch);
+		*dispatchp = disp;
+	}
+	UNLOCK(&requestmgr->lock);
+
+	return (result);
+}
+
 static isc_result_t
 udp_dispatch(dns_requestmgr_t *requestmgr, const isc_sockaddr_t *srcaddr,
 	     const isc_sockaddr_t *destaddr, dns_dispatch_t **dispatchp) {
@@ -445,8 +525,15 @@ udp_dispatch(dns_requestmgr_t *requestmgr, const isc_sockaddr_t *srcaddr,
 		return (ISC_R_SUCCESS);
 	}
 
-	return (dns_dispatch_createudp(requestmgr->dispatchmgr, srcaddr,
-				       dispatchp));
+	/*
+	 * A fixed source port can not be shared by concurrent requests.
+	 */
+	if (isc_sockaddr_getport(srcaddr) != 0) {
+		return (dns_dispatch_createudp(requestmgr->dispatchmgr, srcaddr,
+					       dispatchp));
+	}
+
+	return (udp_pooled_dispatch(requestmgr, srcaddr, dispatchp));
 }
 
 static isc_result_t
@@ -21,9 +21,11 @@
 #include <isc/counter.h>
 #include <isc/log.h>
 #include <isc/print.h>
+#include <isc/profile.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
+#include <isc/rwlock.h>
 #include <isc/siphash.h>
 #include <isc/stats.h>
 #include <isc/string.h>
@@ -216,11 +218,36 @@
  */
 #define NS_PROCESSING_LIMIT 20
 
+/*
+ * Cached rdatasets looked up fewer times than this are never refreshed
+ * by dns_resolver_setprefetchpopular(), however few others there are.
+ */
+#define PREFETCH_POPULAR_MINHITS 2
+
+/*
+ * Estimated 90th percentile of the round trip time to a server, in
+ * microseconds.  With roughly normally distributed RTTs the mean
+ * deviation is 0.8 standard deviations, and the 90th percentile lies
+ * 1.28 standard deviations above the mean.
+ */
+#define RTT_P90(a) ((uint64_t)(a)->srtt + (uint64_t)(a)->rttvar * 8 / 5)
+
 STATIC_ASSERT(NS_PROCESSING_LIMIT > NS_RR_LIMIT,
 	      "The maximum number of NS RRs processed for each delegation "
 	      "(NS_PROCESSING_LIMIT) must be larger than the large delegation "
 	      "threshold (NS_RR_LIMIT).");
 
+/*
+ * The minimum number of fetch context buckets.  Each bucket has its own
+ * lock and list of fetch contexts, but there are only 'ntasks' tasks,
+ * which the buckets share round-robin; so there can be many more buckets
+ * than tasks, keeping the lists short and the locks uncontended when
+ * many different names are being resolved at once.
+ */
+#ifndef RES_FCTX_BUCKETS
+#define RES_FCTX_BUCKETS 1021
+#endif /* ifndef RES_FCTX_BUCKETS */
+
 /* Hash table for zone counters */
 #ifndef RES_DOMAIN_HASH_BITS
 #define RES_DOMAIN_HASH_BITS 12
@@ -304,6 +331,8 @@ struct tried {
 #define RESQUERY_CANCELED(q)   (((q)->attributes & RESQUERY_ATTR_CANCELED) != 0)
 #define RESQUERY_SENDING(q)    ((q)->sends > 0)
 
+typedef struct fctxcount fctxcount_t;
+
 typedef enum {
 	fetchstate_init = 0, /*%< Start event has not run yet. */
 	fetchstate_active,
@@ -327,6 +356,7 @@ struct fetchctx {
 	unsigned int options;
 	unsigned int bucketnum;
 	unsigned int dbucketnum;
+	fctxcount_t *counter;
 	char *info;
 	isc_mem_t *mctx;
 	isc_stdtime_t now;
@@ -519,19 +549,24 @@ typedef struct fctxbucket {
 	atomic_bool exiting;
 } fctxbucket_t;
 
-typedef struct fctxcount fctxcount_t;
+/*%
+ * Fetches per zone.  A counter is only added to and removed from its
+ * bucket with the bucket's write lock; once found with the read lock,
+ * it is counted with atomic operations, so that the fetches for a busy
+ * zone do not serialize on the bucket.
+ */
 struct fctxcount {
 	dns_fixedname_t dfname;
 	dns_name_t *domain;
-	uint32_t count;
-	uint32_t allowed;
-	uint32_t dropped;
-	isc_stdtime_t logged;
+	atomic_uint_fast32_t count;
+	atomic_uint_fast32_t allowed;
+	atomic_uint_fast32_t dropped;
+	atomic_uint_fast32_t logged;
 	ISC_LINK(fctxcount_t) link;
 };
 
 typedef struct zonebucket {
-	isc_mutex_t lock;
+	isc_rwlock_t lock;
 	ISC_LIST(fctxcount_t) list;
 } zonebucket_t;
 
@@ -547,6 +582,15 @@ typedef struct alternate {
 	ISC_LINK(struct alternate) link;
 } alternate_t;
 
+/*%
+ * A name whose NS, DS and DNSKEY records are fetched each time the root
+ * has been primed.
+ */
+typedef struct primename {
+	dns_name_t name;
+	ISC_LINK(struct primename) link;
+} primename_t;
+
 struct dns_resolver {
 	/* Unlocked. */
 	unsigned int magic;
@@ -569,6 +613,7 @@ struct dns_resolver {
 	zonebucket_t *dbuckets;
 	uint32_t lame_ttl;
 	ISC_LIST(alternate_t) alternates;
+	ISC_LIST(primename_t) primenames;
 	uint16_t udpsize;
 	dns_rbt_t *algorithms;
 	dns_rbt_t *digests;
@@ -576,6 +621,7 @@ struct dns_resolver {
 	unsigned int spillatmax;
 	unsigned int spillatmin;
 	isc_timer_t *spillattimer;
+	isc_eventpool_t *fetchevents;
 	bool zero_no_soa_ttl;
 	unsigned int query_timeout;
 	unsigned int maxdepth;
@@ -585,6 +631,8 @@ struct dns_resolver {
 	/* Additions for serve-stale feature. */
 	unsigned int retryinterval; /* in milliseconds */
 	unsigned int nonbackofftries;
+	unsigned int racethreshold; /* in milliseconds */
+	dns_resolver_t *sharedfetches; /* resolver whose fetches we join */
 
 	/* Atomic */
 	isc_refcount_t references;
@@ -596,6 +644,7 @@ struct dns_resolver {
 	isc_eventlist_t whenshutdown;
 	isc_refcount_t activebuckets;
 	unsigned int spillat; /* clients-per-query */
+	unsigned int prefetchpopular;
 
 	dns_badcache_t *badcache; /* Bad cache. */
 
@@ -604,6 +653,9 @@ struct dns_resolver {
 
 	/* Atomic. */
 	atomic_uint_fast32_t nfctx;
+	atomic_uint_fast32_t nprefetch;
+
+	isc_timer_t *prefetchtimer;
 };
 
 #define RES_MAGIC	    ISC_MAGIC('R', 'e', 's', '!')
@@ -665,6 +717,8 @@ resquery_connected(isc_result_t eresult, isc_region_t *region, void *arg);
 static void
 fctx_try(fetchctx_t *fctx, bool retrying, bool badcache);
 static void
+fctx_race(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo);
+static void
 fctx_shutdown(fetchctx_t *fctx);
 static isc_result_t
 fctx_minimize_qname(fetchctx_t *fctx);
@@ -722,6 +776,8 @@ resume_qmin(isc_task_t *task, isc_event_t *event);
  * 1. resquery_response():
  *    - Initialize a respctx_t structure (rctx_respinit()).
  *    - Check for dispatcher failure (rctx_dispfail()).
+ *    - Drop a response for a different question before parsing it
+ *      (rctx_question()).
  *    - Parse the response (rctx_parse()).
  *    - Log the response (rctx_logpacket()).
  *    - Check the parsed response for an OPT record and handle
@@ -909,6 +965,9 @@ rctx_opt(respctx_t *rctx);
 static void
 rctx_edns(respctx_t *rctx);
 
+static isc_result_t
+rctx_question(respctx_t *rctx);
+
 static isc_result_t
 rctx_parse(respctx_t *rctx);
 
@@ -1583,48 +1642,99 @@ fctx_cancelqueries(fetchctx_t *fctx, bool no_response, bool age_untried) {
 }
 
 static void
-fcount_logspill(fetchctx_t *fctx, fctxcount_t *counter, bool final) {
+fcount_logspill(fctxcount_t *counter, bool final) {
 	char dbuf[DNS_NAME_FORMATSIZE];
 	isc_stdtime_t now;
+	uint_fast32_t logged;
 
 	if (!isc_log_wouldlog(dns_lctx, ISC_LOG_INFO)) {
 		return;
 	}
 
 	/* Do not log a message if there were no dropped fetches. */
-	if (counter->dropped == 0) {
+	if (atomic_load_relaxed(&counter->dropped) == 0) {
 		return;
 	}
 
-	/* Do not log the cumulative message if the previous log is recent. */
+	/*
+	 * Do not log the cumulative message if the previous log is recent,
+	 * or if another thread is logging it now.
+	 */
 	isc_stdtime_get(&now);
-	if (!final && counter->logged > now - 60) {
+	logged = atomic_load_relaxed(&counter->logged);
+	if (!final &&
+	    (logged > now - 60 ||
+	     !atomic_compare_exchange_strong_acq_rel(&counter->logged, &logged,
+						     now)))
+	{
 		return;
 	}
 
-	dns_name_format(fctx->domain, dbuf, sizeof(dbuf));
+	dns_name_format(counter->domain, dbuf, sizeof(dbuf));
 
 	if (!final) {
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_SPILL,
 			      DNS_LOGMODULE_RESOLVER, ISC_LOG_INFO,
 			      "too many simultaneous fetches for %s "
-			      "(allowed %d spilled %d)",
-			      dbuf, counter->allowed, counter->dropped);
+			      "(allowed %" PRIuFAST32 " spilled %" PRIuFAST32
+			      ")",
+			      dbuf, atomic_load_relaxed(&counter->allowed),
+			      atomic_load_relaxed(&counter->dropped));
 	} else {
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_SPILL,
 			      DNS_LOGMODULE_RESOLVER, ISC_LOG_INFO,
 			      "fetch counters for %s now being discarded "
-			      "(allowed %d spilled %d; cumulative since "
-			      "initial trigger event)",
-			      dbuf, counter->allowed, counter->dropped);
+			      "(allowed %" PRIuFAST32 " spilled %" PRIuFAST32
+			      "; cumulative since initial trigger event)",
+			      dbuf, atomic_load_relaxed(&counter->allowed),
+			      atomic_load_relaxed(&counter->dropped));
 	}
+}
 
-	counter->logged = now;
+/*
+ * Requires the bucket lock.
+ */
+static fctxcount_t *
+fcount_find(zonebucket_t *dbucket, const dns_name_t *domain) {
+	fctxcount_t *counter = NULL;
+
+	for (counter = ISC_LIST_HEAD(dbucket->list); counter != NULL;
+	     counter = ISC_LIST_NEXT(counter, link))
+	{
+		if (dns_name_equal(counter->domain, domain)) {
+			break;
+		}
+	}
+
+	return (counter);
+}
+
+/*
+ * Count a fetch with 'counter', unless the zone is at its limit.
+ * Requires the bucket lock, which keeps the counter in place.
+ */
+static isc_result_t
+fcount_add(fetchctx_t *fctx, fctxcount_t *counter, bool force) {
+	uint_fast32_t spill = atomic_load_acquire(&fctx->res->zspill);
+	uint_fast32_t count = atomic_load_relaxed(&counter->count);
+
+	do {
+		if (!force && spill != 0 && count >= spill) {
+			atomic_fetch_add_relaxed(&counter->dropped, 1);
+			fcount_logspill(counter, false);
+			return (ISC_R_QUOTA);
+		}
+	} while (!atomic_compare_exchange_weak_acq_rel(&counter->count, &count,
+						       count + 1));
+	atomic_fetch_add_relaxed(&counter->allowed, 1);
+
+	fctx->counter = counter;
+	return (ISC_R_SUCCESS);
 }
 
 static isc_result_t
 fcount_incr(fetchctx_t *fctx, bool force) {
-	isc_result_t result = ISC_R_SUCCESS;
+	isc_result_t result;
 	zonebucket_t *dbucket = NULL;
 	fctxcount_t *counter = NULL;
 	uint32_t hashval;
@@ -1634,43 +1744,46 @@ fcount_incr(fetchctx_t *fctx, bool force) {
 	REQUIRE(fctx->res != NULL);
 
 	INSIST(fctx->dbucketnum == RES_NOBUCKET);
+	INSIST(fctx->counter == NULL);
+
+	/*
+	 * In forward-only mode the queries go to the forwarders, not to
+	 * the domain's servers, so they are not counted; otherwise every
+	 * fetch below the forwarded domain (usually the root) would share
+	 * one counter and its lock.
+	 */
+	if (fctx->fwdpolicy == dns_fwdpolicy_only) {
+		return (ISC_R_SUCCESS);
+	}
+
 	hashval = dns_name_fullhash(fctx->domain, false);
 	dbucketnum = hash_32(hashval, fctx->res->dhashbits);
 
 	dbucket = &fctx->res->dbuckets[dbucketnum];
 
-	LOCK(&dbucket->lock);
-	for (counter = ISC_LIST_HEAD(dbucket->list); counter != NULL;
-	     counter = ISC_LIST_NEXT(counter, link))
-	{
-		if (dns_name_equal(counter->domain, fctx->domain)) {
-			break;
-		}
-	}
-
-	if (counter == NULL) {
-		counter = isc_mem_get(fctx->res->mctx, sizeof(*counter));
-		*counter = (fctxcount_t){
-			.count = 1,
-			.allowed = 1,
-		};
-
-		counter->domain = dns_fixedname_initname(&counter->dfname);
-		ISC_LINK_INIT(counter, link);
-		dns_name_copy(fctx->domain, counter->domain);
-		ISC_LIST_APPEND(dbucket->list, counter, link);
+	RWLOCK(&dbucket->lock, isc_rwlocktype_read);
+	counter = fcount_find(dbucket, fctx->domain);
+	if (counter != NULL) {
+		result = fcount_add(fctx, counter, force);
+		RWUNLOCK(&dbucket->lock, isc_rwlocktype_read);
 	} else {
-		uint_fast32_t spill = atomic_load_acquire(&fctx->res->zspill);
-		if (!force && spill != 0 && counter->count >= spill) {
-			counter->dropped++;
-			fcount_logspill(fctx, counter, false);
-			result = ISC_R_QUOTA;
-		} else {
-			counter->count++;
-			counter->allowed++;
+		RWUNLOCK(&dbucket->lock, isc_rwlocktype_read);
+
+		RWLOCK(&dbucket->lock, isc_rwlocktype_write);
+		counter = fcount_find(dbucket, fctx->domain);
+		if (counter == NULL) {
+			counter = isc_mem_get(fctx->res->mctx,
+					      sizeof(*counter));
+			*counter = (fctxcount_t){ .link = { 0 } };
+			counter->domain =
+				dns_fixedname_initname(&counter->dfname);
+			ISC_LINK_INIT(counter, link);
+			dns_name_copy(fctx->domain, counter->domain);
+			ISC_LIST_APPEND(dbucket->list, counter, link);
 		}
+		result = fcount_add(fctx, counter, force);
+		RWUNLOCK(&dbucket->lock, isc_rwlocktype_write);
 	}
-	UNLOCK(&dbucket->lock);
 
 	if (result == ISC_R_SUCCESS) {
 		fctx->dbucketnum = dbucketnum;
@@ -1691,29 +1804,35 @@ fcount_decr(fetchctx_t *fctx) {
 	}
 
 	dbucket = &fctx->res->dbuckets[fctx->dbucketnum];
+	counter = fctx->counter;
+	fctx->dbucketnum = RES_NOBUCKET;
+	fctx->counter = NULL;
 
-	LOCK(&dbucket->lock);
-	for (counter = ISC_LIST_HEAD(dbucket->list); counter != NULL;
-	     counter = ISC_LIST_NEXT(counter, link))
-	{
-		if (dns_name_equal(counter->domain, fctx->domain)) {
-			break;
-		}
+	INSIST(atomic_load_relaxed(&counter->count) != 0);
+	if (atomic_fetch_sub_release(&counter->count, 1) > 1) {
+		return;
 	}
 
-	if (counter != NULL) {
-		INSIST(counter->count != 0);
-		counter->count--;
-		fctx->dbucketnum = RES_NOBUCKET;
-
-		if (counter->count == 0) {
-			fcount_logspill(fctx, counter, true);
-			ISC_LIST_UNLINK(dbucket->list, counter, link);
-			isc_mem_put(fctx->res->mctx, counter, sizeof(*counter));
+	/*
+	 * This was the last fetch, unless another has started since;
+	 * another thread may also have freed the counter meanwhile, so
+	 * look for it in the bucket before touching it.
+	 */
+	RWLOCK(&dbucket->lock, isc_rwlocktype_write);
+	for (fctxcount_t *c = ISC_LIST_HEAD(dbucket->list); c != NULL;
+	     c = ISC_LIST_NEXT(c, link))
+	{
+		if (c == counter) {
+			if (atomic_load_acquire(&counter->count) == 0) {
+				fcount_logspill(counter, true);
+				ISC_LIST_UNLINK(dbucket->list, counter, link);
+				isc_mem_put(fctx->res->mctx, counter,
+					    sizeof(*counter));
+			}
+			break;
 		}
 	}
-
-	UNLOCK(&dbucket->lock);
+	RWUNLOCK(&dbucket->lock, isc_rwlocktype_write);
 }
 
 static void
@@ -2206,14 +2325,26 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 		}
 		isc_sockaddr_setport(&addr, 0);
 
-		result = dns_dispatch_createtcp(res->dispatchmgr, &addr,
-						&addrinfo->sockaddr,
-						&query->dispatch);
-		if (result != ISC_R_SUCCESS) {
-			goto cleanup_query;
-		}
+		/*
+		 * Pipeline the query over an open (or idle) connection
+		 * to the same server, if there is one.
+		 */
+		result = dns_dispatch_gettcp(res->dispatchmgr,
+					     &addrinfo->sockaddr, &addr,
+					     &query->dispatch);
+		if (result == ISC_R_SUCCESS) {
+			inc_stats(res, dns_resstatscounter_tcpreuse);
+			FCTXTRACE("reusing TCP connection");
+		} else {
+			result = dns_dispatch_createtcp(res->dispatchmgr, &addr,
+							&addrinfo->sockaddr,
+							&query->dispatch);
+			if (result != ISC_R_SUCCESS) {
+				goto cleanup_query;
+			}
 
-		FCTXTRACE("connecting via TCP");
+			FCTXTRACE("connecting via TCP");
+		}
 	} else {
 		if (have_addr) {
 			result = dns_dispatch_createudp(res->dispatchmgr, &addr,
@@ -2474,10 +2605,8 @@ resquery_send(resquery_t *query) {
 	uint16_t hint = 0, udpsize = 0; /* No EDNS */
 #ifdef HAVE_DNSTAP
 	isc_sockaddr_t localaddr, *la = NULL;
-	unsigned char zone[DNS_NAME_MAXWIRE];
 	dns_dtmsgtype_t dtmsgtype;
 	isc_region_t zr;
-	isc_buffer_t zb;
 #endif /* HAVE_DNSTAP */
 
 	QTRACE("send");
@@ -2829,13 +2958,8 @@ resquery_send(resquery_t *query) {
 	}
 
 #ifdef HAVE_DNSTAP
-	memset(&zr, 0, sizeof(zr));
-	isc_buffer_init(&zb, zone, sizeof(zone));
-	dns_compress_setmethods(&cctx, DNS_COMPRESS_NONE);
-	result = dns_name_towire(fctx->domain, &cctx, &zb);
-	if (result == ISC_R_SUCCESS) {
-		isc_buffer_usedregion(&zb, &zr);
-	}
+	/* The domain is absolute, so this is its wire form. */
+	dns_name_toregion(fctx->domain, &zr);
 #endif /* HAVE_DNSTAP */
 
 	dns_compress_invalidate(&cctx);
@@ -2873,7 +2997,9 @@ resquery_send(resquery_t *query) {
 
 #ifdef HAVE_DNSTAP
 	/*
-	 * Log the outgoing query via dnstap.
+	 * Log the outgoing query via dnstap.  Finding the local address
+	 * may take a system call, so skip it if the view does not log
+	 * this type.
 	 */
 	if ((fctx->qmessage->flags & DNS_MESSAGEFLAG_RD) != 0) {
 		dtmsgtype = DNS_DTTYPE_FQ;
@@ -2881,13 +3007,17 @@ resquery_send(resquery_t *query) {
 		dtmsgtype = DNS_DTTYPE_RQ;
 	}
 
-	result = dns_dispentry_getlocaladdress(query->dispentry, &localaddr);
-	if (result == ISC_R_SUCCESS) {
-		la = &localaddr;
-	}
+	if ((fctx->res->view->dttypes & dtmsgtype) != 0) {
+		result = dns_dispentry_getlocaladdress(query->dispentry,
+						       &localaddr);
+		if (result == ISC_R_SUCCESS) {
+			la = &localaddr;
+		}
 
-	dns_dt_send(fctx->res->view, dtmsgtype, la, &query->addrinfo->sockaddr,
-		    tcp, &zr, &query->start, NULL, &buffer);
+		dns_dt_send(fctx->res->view, dtmsgtype, la,
+			    &query->addrinfo->sockaddr, tcp, &zr,
+			    &query->start, NULL, &buffer);
+	}
 #endif /* HAVE_DNSTAP */
 
 	return (ISC_R_SUCCESS);
@@ -4259,9 +4389,52 @@ fctx_try(fetchctx_t *fctx, bool retrying, bool badcache) {
 	result = fctx_query(fctx, addrinfo, fctx->options);
 	if (result != ISC_R_SUCCESS) {
 		fctx_done_detach(&fctx, result);
-	} else if (retrying) {
+		return;
+	}
+	if (retrying) {
 		inc_stats(res, dns_resstatscounter_retry);
 	}
+
+	fctx_race(fctx, addrinfo);
+}
+
+/*
+ * If the estimated 90th percentile RTT of the server that was just
+ * queried exceeds the resolver's race threshold, send the same query
+ * to the next best server too.  Whichever answers first is used; the
+ * other query is then canceled with the rest of fctx->queries, and its
+ * server's RTT is penalized as if it had not answered.
+ */
+static void
+fctx_race(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo) {
+	dns_resolver_t *res = fctx->res;
+	dns_adbaddrinfo_t *race = NULL;
+	isc_result_t result;
+
+	if (res->racethreshold == 0 || fctx->forwarding ||
+	    RTT_P90(addrinfo) <= (uint64_t)res->racethreshold * US_PER_MS)
+	{
+		return;
+	}
+
+	race = fctx_nextaddress(fctx);
+	while (race != NULL && dns_adbentry_overquota(race->entry)) {
+		race = fctx_nextaddress(fctx);
+	}
+	if (race == NULL) {
+		return;
+	}
+
+	result = isc_counter_increment(fctx->qc);
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	FCTXTRACE("racing a slow server");
+	result = fctx_query(fctx, race, fctx->options);
+	if (result == ISC_R_SUCCESS) {
+		inc_stats(res, dns_resstatscounter_queryrace);
+	}
 }
 
 static void
@@ -4637,6 +4810,7 @@ fctx_start(isc_task_t *task, isc_event_t *event) {
 	/*
 	 * Normal fctx startup.
 	 */
+	isc_profile_enter(isc_profile_resolver);
 	fctx->state = fetchstate_active;
 
 	/*
@@ -4654,6 +4828,7 @@ fctx_start(isc_task_t *task, isc_event_t *event) {
 	} else {
 		fctx_try(fctx, false, false);
 	}
+	isc_profile_leave(isc_profile_resolver);
 }
 
 /*
@@ -4675,8 +4850,8 @@ fctx_add_event(fetchctx_t *fctx, isc_task_t *task, const isc_sockaddr_t *client,
 	 * actually send the event.
 	 */
 	isc_task_attach(task, &(isc_task_t *){ NULL });
-	event = (dns_fetchevent_t *)isc_event_allocate(
-		fctx->res->mctx, task, event_type, action, arg, sizeof(*event));
+	event = (dns_fetchevent_t *)isc_event_poolallocate(
+		fctx->res->fetchevents, task, event_type, action, arg);
 	event->result = DNS_R_SERVFAIL;
 	event->qtype = fctx->type;
 	event->db = NULL;
@@ -5818,7 +5993,7 @@ validated(isc_task_t *task, isc_event_t *event) {
 answer_response:
 
 	/*
-	 * Cache any SOA/NS/NSEC records that happened to be validated.
+	 * Cache any SOA/NS/NSEC/NSEC3 records that happened to be validated.
 	 */
 	result = dns_message_firstname(message, DNS_SECTION_AUTHORITY);
 	while (result == ISC_R_SUCCESS) {
@@ -5829,7 +6004,8 @@ answer_response:
 		{
 			if ((rdataset->type != dns_rdatatype_ns &&
 			     rdataset->type != dns_rdatatype_soa &&
-			     rdataset->type != dns_rdatatype_nsec) ||
+			     rdataset->type != dns_rdatatype_nsec &&
+			     rdataset->type != dns_rdatatype_nsec3) ||
 			    rdataset->trust != dns_trust_secure)
 			{
 				continue;
@@ -7731,6 +7907,15 @@ resquery_response(isc_result_t eresult, isc_region_t *region, void *arg) {
 		return;
 	}
 
+	/*
+	 * Check the question before doing anything else with the
+	 * response, so that spoofed answers are dropped cheaply.
+	 */
+	result = rctx_question(&rctx);
+	if (result == ISC_R_COMPLETE) {
+		return;
+	}
+
 	if (query->tsig != NULL) {
 		result = dns_message_setquerytsig(query->rmessage, query->tsig);
 		if (result != ISC_R_SUCCESS) {
@@ -8238,6 +8423,71 @@ rctx_timedout(respctx_t *rctx) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * rctx_question():
+ * Read the question straight from the wire and, if it is a single
+ * question for a different name or type than the one we asked, keep
+ * waiting for another response without parsing this one.  Anything
+ * unusual (no or several questions, a name that cannot be read, a
+ * different class) is left to rctx_parse() and same_question().
+ */
+static isc_result_t
+rctx_question(respctx_t *rctx) {
+	fetchctx_t *fctx = rctx->fctx;
+	isc_buffer_t source;
+	isc_region_t r;
+	dns_decompress_t dctx;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_rdatatype_t type;
+	dns_rdataclass_t rdclass;
+	isc_result_t result;
+
+	isc_buffer_usedregion(&rctx->buffer, &r);
+	if (r.length < DNS_MESSAGE_HEADERLEN ||
+	    (r.base[4] << 8 | r.base[5]) != 1)
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	isc_buffer_init(&source, r.base, r.length);
+	isc_buffer_add(&source, r.length);
+	isc_buffer_forward(&source, DNS_MESSAGE_HEADERLEN);
+
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_NONE);
+	result = dns_name_fromwire(name, &source, &dctx, 0, NULL);
+	dns_decompress_invalidate(&dctx);
+	if (result != ISC_R_SUCCESS || isc_buffer_remaininglength(&source) < 4)
+	{
+		return (ISC_R_SUCCESS);
+	}
+	type = isc_buffer_getuint16(&source);
+	rdclass = isc_buffer_getuint16(&source);
+
+	if (rdclass != fctx->res->rdclass ||
+	    (type == fctx->type && dns_name_equal(name, fctx->name)))
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	if (isc_log_wouldlog(dns_lctx, ISC_LOG_NOTICE)) {
+		char namebuf[DNS_NAME_FORMATSIZE];
+		char classbuf[DNS_RDATACLASS_FORMATSIZE];
+		char typebuf[DNS_RDATATYPE_FORMATSIZE];
+
+		dns_name_format(name, namebuf, sizeof(namebuf));
+		dns_rdataclass_format(rdclass, classbuf, sizeof(classbuf));
+		dns_rdatatype_format(type, typebuf, sizeof(typebuf));
+		log_formerr(fctx, "question section mismatch: got %s/%s/%s",
+			    namebuf, classbuf, typebuf);
+	}
+
+	FCTXTRACE("question section mismatch");
+	rctx->nextitem = true;
+	rctx_done(rctx, DNS_R_FORMERR);
+	return (ISC_R_COMPLETE);
+}
+
 /*
  * rctx_parse():
  * Parse the response message.
@@ -9802,6 +10052,21 @@ rctx_nextserver(respctx_t *rctx, dns_message_t *message,
 		fctx_cancelqueries(fctx, true, false);
 		fctx_cleanup(fctx);
 		retrying = false;
+	} else if (fctx->res->racethreshold != 0) {
+		bool racing;
+
+		/*
+		 * If a query raced against this one is still
+		 * outstanding, wait for it rather than trying yet
+		 * another server.
+		 */
+		LOCK(&fctx->res->buckets[fctx->bucketnum].lock);
+		racing = !ISC_LIST_EMPTY(fctx->queries);
+		UNLOCK(&fctx->res->buckets[fctx->bucketnum].lock);
+		if (racing) {
+			FCTXTRACE("waiting for racing query");
+			return;
+		}
 	}
 
 	/*
@@ -9981,11 +10246,8 @@ rctx_logpacket(respctx_t *rctx) {
 	isc_result_t result;
 	fetchctx_t *fctx = rctx->fctx;
 	isc_sockaddr_t localaddr, *la = NULL;
-	unsigned char zone[DNS_NAME_MAXWIRE];
 	dns_dtmsgtype_t dtmsgtype;
-	dns_compress_t cctx;
 	isc_region_t zr;
-	isc_buffer_t zb;
 #endif /* HAVE_DNSTAP */
 
 	dns_message_logfmtpacket(
@@ -9998,24 +10260,18 @@ rctx_logpacket(respctx_t *rctx) {
 	/*
 	 * Log the response via dnstap.
 	 */
-	memset(&zr, 0, sizeof(zr));
-	result = dns_compress_init(&cctx, -1, fctx->res->mctx);
-	if (result == ISC_R_SUCCESS) {
-		isc_buffer_init(&zb, zone, sizeof(zone));
-		dns_compress_setmethods(&cctx, DNS_COMPRESS_NONE);
-		result = dns_name_towire(fctx->domain, &cctx, &zb);
-		if (result == ISC_R_SUCCESS) {
-			isc_buffer_usedregion(&zb, &zr);
-		}
-		dns_compress_invalidate(&cctx);
-	}
-
 	if ((fctx->qmessage->flags & DNS_MESSAGEFLAG_RD) != 0) {
 		dtmsgtype = DNS_DTTYPE_FR;
 	} else {
 		dtmsgtype = DNS_DTTYPE_RR;
 	}
 
+	if ((fctx->res->view->dttypes & dtmsgtype) == 0) {
+		return;
+	}
+
+	dns_name_toregion(fctx->domain, &zr);
+
 	result = dns_dispentry_getlocaladdress(rctx->query->dispentry,
 					       &localaddr);
 	if (result == ISC_R_SUCCESS) {
@@ -10215,6 +10471,7 @@ static void
 destroy(dns_resolver_t *res) {
 	unsigned int i;
 	alternate_t *a;
+	primename_t *pn;
 
 	isc_refcount_destroy(&res->references);
 	REQUIRE(!atomic_load_acquire(&res->priming));
@@ -10236,7 +10493,7 @@ destroy(dns_resolver_t *res) {
 		    res->nbuckets * sizeof(fctxbucket_t));
 	for (i = 0; i < HASHSIZE(res->dhashbits); i++) {
 		INSIST(ISC_LIST_EMPTY(res->dbuckets[i].list));
-		isc_mutex_destroy(&res->dbuckets[i].lock);
+		isc_rwlock_destroy(&res->dbuckets[i].lock);
 	}
 	isc_mem_put(res->mctx, res->dbuckets,
 		    HASHSIZE(res->dhashbits) * sizeof(zonebucket_t));
@@ -10253,11 +10510,21 @@ destroy(dns_resolver_t *res) {
 		}
 		isc_mem_put(res->mctx, a, sizeof(*a));
 	}
+	while ((pn = ISC_LIST_HEAD(res->primenames)) != NULL) {
+		ISC_LIST_UNLINK(res->primenames, pn, link);
+		dns_name_free(&pn->name, res->mctx);
+		isc_mem_put(res->mctx, pn, sizeof(*pn));
+	}
 	dns_resolver_reset_algorithms(res);
 	dns_resolver_reset_ds_digests(res);
+	if (res->sharedfetches != NULL) {
+		dns_resolver_detach(&res->sharedfetches);
+	}
 	dns_badcache_destroy(&res->badcache);
 	dns_resolver_resetmustbesecure(res);
 	isc_timer_destroy(&res->spillattimer);
+	isc_timer_destroy(&res->prefetchtimer);
+	isc_eventpool_detach(&res->fetchevents);
 	res->magic = 0;
 	isc_mem_putanddetach(&res->mctx, res, sizeof(*res));
 }
@@ -10313,6 +10580,120 @@ spillattimer_countdown(isc_task_t *task, isc_event_t *event) {
 	isc_event_free(&event);
 }
 
+static void
+prefetch_popular_done(isc_task_t *task, isc_event_t *event) {
+	dns_fetchevent_t *fevent = (dns_fetchevent_t *)event;
+	dns_resolver_t *res = event->ev_arg;
+	dns_fetch_t *fetch = fevent->fetch;
+
+	REQUIRE(event->ev_type == DNS_EVENT_FETCHDONE);
+	REQUIRE(VALID_RESOLVER(res));
+
+	UNUSED(task);
+
+	if (fevent->node != NULL) {
+		dns_db_detachnode(fevent->db, &fevent->node);
+	}
+	if (fevent->db != NULL) {
+		dns_db_detach(&fevent->db);
+	}
+	if (dns_rdataset_isassociated(fevent->rdataset)) {
+		dns_rdataset_disassociate(fevent->rdataset);
+	}
+	INSIST(fevent->sigrdataset == NULL);
+
+	isc_mem_put(res->mctx, fevent->rdataset, sizeof(*fevent->rdataset));
+
+	isc_event_free(&event);
+	atomic_fetch_sub_relaxed(&res->nprefetch, 1);
+	dns_resolver_destroyfetch(&fetch);
+}
+
+/*
+ * Refresh the rdataset 'type' at 'name' in 'db' before it expires, and
+ * stop it from being prefetched again, as query_prefetch() does.
+ */
+static void
+prefetch_start(dns_resolver_t *res, dns_db_t *db, isc_stdtime_t now,
+	       const dns_name_t *name, dns_rdatatype_t type) {
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t *rdataset = NULL;
+	dns_fetch_t *fetch = NULL;
+	isc_result_t result;
+
+	result = dns_db_findnode(db, name, false, &node);
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+	rdataset = isc_mem_get(res->mctx, sizeof(*rdataset));
+	dns_rdataset_init(rdataset);
+	result = dns_db_findrdataset(db, node, NULL, type, 0, now, rdataset,
+				     NULL);
+	dns_db_detachnode(db, &node);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(res->mctx, rdataset, sizeof(*rdataset));
+		return;
+	}
+	dns_rdataset_clearprefetch(rdataset);
+	dns_rdataset_disassociate(rdataset);
+
+	atomic_fetch_add_relaxed(&res->nprefetch, 1);
+	result = dns_resolver_createfetch(
+		res, name, type, NULL, NULL, NULL, NULL, 0,
+		DNS_FETCHOPT_PREFETCH, 0, NULL, res->buckets[0].task,
+		prefetch_popular_done, res, rdataset, NULL, &fetch);
+	if (result != ISC_R_SUCCESS) {
+		atomic_fetch_sub_relaxed(&res->nprefetch, 1);
+		isc_mem_put(res->mctx, rdataset, sizeof(*rdataset));
+		return;
+	}
+	inc_stats(res, dns_resstatscounter_prefetchpopular);
+}
+
+/*
+ * Once a second, refresh the most popular rdatasets of the cache that
+ * are about to expire, up to 'prefetchpopular' fetches at a time.
+ */
+static void
+prefetch_popular(isc_task_t *task, isc_event_t *event) {
+	dns_resolver_t *res = event->ev_arg;
+	dns_dbpopular_t *popular = NULL;
+	dns_db_t *db = NULL;
+	unsigned int size, count = 0, running;
+	isc_stdtime_t now;
+
+	REQUIRE(VALID_RESOLVER(res));
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+
+	LOCK(&res->lock);
+	size = res->prefetchpopular;
+	UNLOCK(&res->lock);
+
+	running = atomic_load_relaxed(&res->nprefetch);
+	if (atomic_load_acquire(&res->exiting) || size <= running ||
+	    res->view->prefetch_trigger == 0 || res->view->cachedb == NULL)
+	{
+		return;
+	}
+	size -= running;
+
+	isc_stdtime_get(&now);
+	dns_db_attach(res->view->cachedb, &db);
+	popular = isc_mem_get(res->mctx, size * sizeof(popular[0]));
+	dns_db_findpopular(db, now, res->view->prefetch_trigger,
+			   PREFETCH_POPULAR_MINHITS, popular, size, &count);
+	for (unsigned int i = 0; i < count; i++) {
+		prefetch_start(res, db, now,
+			       dns_fixedname_name(&popular[i].fixed),
+			       popular[i].type);
+	}
+	isc_mem_put(res->mctx, popular, size * sizeof(popular[0]));
+	dns_db_detach(&db);
+}
+
 isc_result_t
 dns_resolver_create(dns_view_t *view, isc_taskmgr_t *taskmgr,
 		    unsigned int ntasks, unsigned int ndisp, isc_nm_t *nm,
@@ -10323,6 +10704,7 @@ dns_resolver_create(dns_view_t *view, isc_taskmgr_t *taskmgr,
 	char name[sizeof("res4294967295")];
 	dns_resolver_t *res = NULL;
 	isc_task_t *task = NULL;
+	unsigned int nbuckets;
 
 	/*
 	 * Create a resolver.
@@ -10353,7 +10735,7 @@ dns_resolver_create(dns_view_t *view, isc_taskmgr_t *taskmgr,
 				 .query_timeout = DEFAULT_QUERY_TIMEOUT,
 				 .maxdepth = DEFAULT_RECURSION_DEPTH,
 				 .maxqueries = DEFAULT_MAX_QUERIES,
-				 .nbuckets = ntasks,
+				 .nbuckets = ISC_MAX(ntasks, RES_FCTX_BUCKETS),
 				 .dhashbits = RES_DOMAIN_HASH_BITS };
 
 	atomic_init(&res->activebuckets, res->nbuckets);
@@ -10369,6 +10751,7 @@ dns_resolver_create(dns_view_t *view, isc_taskmgr_t *taskmgr,
 	atomic_init(&res->nfctx, 0);
 	ISC_LIST_INIT(res->whenshutdown);
 	ISC_LIST_INIT(res->alternates);
+	ISC_LIST_INIT(res->primenames);
 
 	result = dns_badcache_init(res->mctx, DNS_RESOLVER_BADCACHESIZE,
 				   &res->badcache);
@@ -10381,27 +10764,33 @@ dns_resolver_create(dns_view_t *view, isc_taskmgr_t *taskmgr,
 			      dns_resstatscounter_buckets);
 	}
 
+	nbuckets = res->nbuckets;
 	res->buckets = isc_mem_get(view->mctx,
 				   res->nbuckets * sizeof(res->buckets[0]));
-	for (uint32_t i = 0; i < ntasks; i++) {
+	for (uint32_t i = 0; i < res->nbuckets; i++) {
 		res->buckets[i] = (fctxbucket_t){ 0 };
 
 		isc_mutex_init(&res->buckets[i].lock);
 
-		/*
-		 * Since we have a pool of tasks we bind them to task
-		 * queues to spread the load evenly
-		 */
-		result = isc_task_create_bound(taskmgr, 0,
-					       &res->buckets[i].task, i);
-		if (result != ISC_R_SUCCESS) {
-			ntasks = i;
-			isc_mutex_destroy(&res->buckets[i].lock);
-			goto cleanup_buckets;
-		}
+		if (i < ntasks) {
+			/*
+			 * Since we have a pool of tasks we bind them to
+			 * task queues to spread the load evenly
+			 */
+			result = isc_task_create_bound(
+				taskmgr, 0, &res->buckets[i].task, i);
+			if (result != ISC_R_SUCCESS) {
+				nbuckets = i;
+				isc_mutex_destroy(&res->buckets[i].lock);
+				goto cleanup_buckets;
+			}
 
-		snprintf(name, sizeof(name), "res%" PRIu32, i);
-		isc_task_setname(res->buckets[i].task, name, res);
+			snprintf(name, sizeof(name), "res%" PRIu32, i);
+			isc_task_setname(res->buckets[i].task, name, res);
+		} else {
+			isc_task_attach(res->buckets[i % ntasks].task,
+					&res->buckets[i].task);
+		}
 
 		ISC_LIST_INIT(res->buckets[i].fctxs);
 		atomic_init(&res->buckets[i].exiting, false);
@@ -10413,7 +10802,7 @@ dns_resolver_create(dns_view_t *view, isc_taskmgr_t *taskmgr,
 	for (size_t i = 0; i < HASHSIZE(res->dhashbits); i++) {
 		res->dbuckets[i] = (zonebucket_t){ .list = { 0 } };
 		ISC_LIST_INIT(res->dbuckets[i].list);
-		isc_mutex_init(&res->dbuckets[i].lock);
+		isc_rwlock_init(&res->dbuckets[i].lock, 0, 0);
 	}
 
 	if (dispatchv4 != NULL) {
@@ -10438,11 +10827,23 @@ dns_resolver_create(dns_view_t *view, isc_taskmgr_t *taskmgr,
 	result = isc_timer_create(timermgr, isc_timertype_inactive, NULL, NULL,
 				  task, spillattimer_countdown, res,
 				  &res->spillattimer);
+	if (result != ISC_R_SUCCESS) {
+		isc_task_detach(&task);
+		goto cleanup_primelock;
+	}
+
+	result = isc_timer_create(timermgr, isc_timertype_inactive, NULL, NULL,
+				  task, prefetch_popular, res,
+				  &res->prefetchtimer);
 	isc_task_detach(&task);
 	if (result != ISC_R_SUCCESS) {
+		isc_timer_destroy(&res->spillattimer);
 		goto cleanup_primelock;
 	}
 
+	isc_eventpool_create(res->mctx, sizeof(dns_fetchevent_t),
+			     &res->fetchevents);
+
 	res->magic = RES_MAGIC;
 
 	*resp = res;
@@ -10461,13 +10862,13 @@ cleanup_primelock:
 	}
 
 	for (size_t i = 0; i < HASHSIZE(res->dhashbits); i++) {
-		isc_mutex_destroy(&res->dbuckets[i].lock);
+		isc_rwlock_destroy(&res->dbuckets[i].lock);
 	}
 	isc_mem_put(view->mctx, res->dbuckets,
 		    HASHSIZE(res->dhashbits) * sizeof(zonebucket_t));
 
 cleanup_buckets:
-	for (size_t i = 0; i < ntasks; i++) {
+	for (size_t i = 0; i < nbuckets; i++) {
 		isc_mutex_destroy(&res->buckets[i].lock);
 		isc_task_shutdown(res->buckets[i].task);
 		isc_task_detach(&res->buckets[i].task);
@@ -10483,6 +10884,104 @@ cleanup_res:
 	return (result);
 }
 
+static void
+primename_done(isc_task_t *task, isc_event_t *event) {
+	dns_resolver_t *res;
+	dns_fetchevent_t *fevent;
+	dns_fetch_t *fetch;
+	primename_t *pn;
+
+	REQUIRE(event->ev_type == DNS_EVENT_FETCHDONE);
+	fevent = (dns_fetchevent_t *)event;
+	fetch = fevent->fetch;
+	pn = event->ev_arg;
+	res = fetch->res;
+	REQUIRE(VALID_RESOLVER(res));
+
+	UNUSED(task);
+
+	if (fevent->result != ISC_R_SUCCESS &&
+	    isc_log_wouldlog(dns_lctx, ISC_LOG_DEBUG(1)))
+	{
+		char namebuf[DNS_NAME_FORMATSIZE];
+		char typebuf[DNS_RDATATYPE_FORMATSIZE];
+
+		dns_name_format(&pn->name, namebuf, sizeof(namebuf));
+		dns_rdatatype_format(fevent->qtype, typebuf, sizeof(typebuf));
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RESOLVER,
+			      DNS_LOGMODULE_RESOLVER, ISC_LOG_DEBUG(1),
+			      "priming fetch for %s/%s failed: %s", namebuf,
+			      typebuf, isc_result_totext(fevent->result));
+	}
+
+	if (fevent->node != NULL) {
+		dns_db_detachnode(fevent->db, &fevent->node);
+	}
+	if (fevent->db != NULL) {
+		dns_db_detach(&fevent->db);
+	}
+	if (dns_rdataset_isassociated(fevent->rdataset)) {
+		dns_rdataset_disassociate(fevent->rdataset);
+	}
+	isc_mem_put(res->mctx, fevent->rdataset, sizeof(*fevent->rdataset));
+
+	isc_event_free(&event);
+	dns_resolver_destroyfetch(&fetch);
+}
+
+/*
+ * Start fetches, in parallel, for the NS, DS and DNSKEY records of the
+ * names added with dns_resolver_addprimename(), so that they are in
+ * the cache before the first queries that need them.  The root NS
+ * set has just been primed, and the root has no DS.
+ */
+static void
+prime_names(dns_resolver_t *res) {
+	static const dns_rdatatype_t types[] = { dns_rdatatype_dnskey,
+						 dns_rdatatype_ns,
+						 dns_rdatatype_ds };
+	unsigned int count = 0;
+
+	for (primename_t *pn = ISC_LIST_HEAD(res->primenames); pn != NULL;
+	     pn = ISC_LIST_NEXT(pn, link))
+	{
+		size_t ntypes = dns_name_equal(&pn->name, dns_rootname)
+					? 1
+					: ARRAY_SIZE(types);
+
+		for (size_t i = 0; i < ntypes; i++) {
+			dns_rdataset_t *rdataset = NULL;
+			dns_fetch_t *fetch = NULL;
+			isc_task_t *task = res->buckets[count % res->nbuckets]
+						   .task;
+			isc_result_t result;
+
+			if (atomic_load_acquire(&res->exiting)) {
+				return;
+			}
+
+			rdataset = isc_mem_get(res->mctx, sizeof(*rdataset));
+			dns_rdataset_init(rdataset);
+			result = dns_resolver_createfetch(
+				res, &pn->name, types[i], NULL, NULL, NULL,
+				NULL, 0, 0, 0, NULL, task, primename_done, pn,
+				rdataset, NULL, &fetch);
+			if (result != ISC_R_SUCCESS) {
+				isc_mem_put(res->mctx, rdataset,
+					    sizeof(*rdataset));
+				continue;
+			}
+			count++;
+		}
+	}
+
+	if (count > 0) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RESOLVER,
+			      DNS_LOGMODULE_RESOLVER, ISC_LOG_INFO,
+			      "resolver priming: started %u fetches", count);
+	}
+}
+
 static void
 prime_done(isc_task_t *task, isc_event_t *event) {
 	dns_resolver_t *res;
@@ -10516,6 +11015,9 @@ prime_done(isc_task_t *task, isc_event_t *event) {
 		dns_root_checkhints(res->view, res->view->hints, db);
 		dns_db_detach(&db);
 	}
+	if (fevent->result == ISC_R_SUCCESS) {
+		prime_names(res);
+	}
 
 	if (fevent->node != NULL) {
 		dns_db_detachnode(fevent->db, &fevent->node);
@@ -10582,6 +11084,31 @@ dns_resolver_prime(dns_resolver_t *res) {
 	}
 }
 
+void
+dns_resolver_addprimename(dns_resolver_t *res, const dns_name_t *name) {
+	primename_t *pn;
+
+	REQUIRE(VALID_RESOLVER(res));
+	REQUIRE(!res->frozen);
+	REQUIRE(dns_name_isabsolute(name));
+
+	pn = isc_mem_get(res->mctx, sizeof(*pn));
+	dns_name_init(&pn->name, NULL);
+	dns_name_dup(name, res->mctx, &pn->name);
+	ISC_LINK_INIT(pn, link);
+	ISC_LIST_APPEND(res->primenames, pn, link);
+}
+
+void
+dns_resolver_primenames(dns_resolver_t *res) {
+	REQUIRE(VALID_RESOLVER(res));
+	REQUIRE(res->frozen);
+
+	if (!ISC_LIST_EMPTY(res->primenames)) {
+		dns_resolver_prime(res);
+	}
+}
+
 void
 dns_resolver_freeze(dns_resolver_t *res) {
 	/*
@@ -10675,6 +11202,10 @@ dns_resolver_shutdown(dns_resolver_t *res) {
 					 isc_timertype_inactive, NULL, NULL,
 					 true);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		result = isc_timer_reset(res->prefetchtimer,
+					 isc_timertype_inactive, NULL, NULL,
+					 true);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	}
 }
 
@@ -10736,6 +11267,23 @@ log_fetch(const dns_name_t *name, dns_rdatatype_t type) {
 		      typebuf);
 }
 
+/*
+ * Look up in the cache what is known about NS records at the name made
+ * of the last 'labels' labels of the fetch name.  A cached negative
+ * answer means that an earlier minimization step (or an earlier fetch)
+ * already found out there is no zone cut there.
+ */
+static isc_result_t
+qmin_findns(fetchctx_t *fctx, unsigned int labels) {
+	dns_fixedname_t fixed, ffixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_name_t *fname = dns_fixedname_initname(&ffixed);
+
+	dns_name_split(fctx->name, labels, NULL, name);
+	return (dns_db_find(fctx->cache, name, NULL, dns_rdatatype_ns, 0,
+			    fctx->now, NULL, fname, NULL, NULL));
+}
+
 static isc_result_t
 fctx_minimize_qname(fetchctx_t *fctx) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -10776,8 +11324,31 @@ fctx_minimize_qname(fetchctx_t *fctx) {
 		} else {
 			fctx->qmin_labels = nlabels;
 		}
-	} else if (fctx->qmin_labels > DNS_QMIN_MAXLABELS) {
-		fctx->qmin_labels = DNS_MAX_LABELS + 1;
+	} else {
+		/*
+		 * Skip the labels the cache already knows are not zone
+		 * cuts, querying for them would only get the same
+		 * negative answer again.  If the name is known not to
+		 * exist at all, there's nothing left to minimize.
+		 */
+		while (fctx->qmin_labels < nlabels &&
+		       fctx->qmin_labels <= DNS_QMIN_MAXLABELS)
+		{
+			isc_result_t fresult = qmin_findns(fctx,
+							   fctx->qmin_labels);
+			if (fresult == DNS_R_NCACHENXRRSET) {
+				fctx->qmin_labels++;
+			} else {
+				if (fresult == DNS_R_NCACHENXDOMAIN) {
+					fctx->qmin_labels = DNS_MAX_LABELS + 1;
+				}
+				break;
+			}
+		}
+
+		if (fctx->qmin_labels > DNS_QMIN_MAXLABELS) {
+			fctx->qmin_labels = DNS_MAX_LABELS + 1;
+		}
 	}
 
 	if (fctx->qmin_labels < nlabels) {
@@ -10845,6 +11416,8 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	unsigned int spillat;
 	unsigned int spillatmin;
 	bool dodestroy = false;
+	dns_resolver_t *peer = NULL;
+	unsigned int peerbucket = 0;
 
 	UNUSED(forwarders);
 
@@ -10880,7 +11453,11 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	spillat = res->spillat;
 	spillatmin = res->spillatmin;
 	UNLOCK(&res->lock);
-	LOCK(&res->buckets[bucketnum].lock);
+	if (isc_mutex_trylock(&res->buckets[bucketnum].lock) != ISC_R_SUCCESS)
+	{
+		inc_stats(res, dns_resstatscounter_bucketwait);
+		LOCK(&res->buckets[bucketnum].lock);
+	}
 
 	if (atomic_load(&res->buckets[bucketnum].exiting)) {
 		result = ISC_R_SHUTTINGDOWN;
@@ -10888,13 +11465,50 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	}
 
 	if ((options & DNS_FETCHOPT_UNSHARED) == 0) {
+		isc_statscounter_t chain = 0;
+
 		for (fctx = ISC_LIST_HEAD(res->buckets[bucketnum].fctxs);
 		     fctx != NULL; fctx = ISC_LIST_NEXT(fctx, link))
 		{
+			chain++;
 			if (fctx_match(fctx, name, type, options)) {
 				break;
 			}
 		}
+		if (res->view->resstats != NULL) {
+			isc_stats_update_if_greater(res->view->resstats,
+						    dns_resstatscounter_bucketchain,
+						    chain);
+		}
+	}
+
+	/*
+	 * If there's no such fetch in this resolver, try to join one
+	 * running in the resolver we share fetches with.  The peer
+	 * never shares its fetches with anyone else, so the lock
+	 * order is always ours first, then the peer's.
+	 */
+	if (fctx == NULL && (options & DNS_FETCHOPT_UNSHARED) == 0 &&
+	    domain == NULL && res->sharedfetches != NULL &&
+	    !atomic_load_acquire(&res->sharedfetches->exiting))
+	{
+		peer = res->sharedfetches;
+		peerbucket = dns_name_fullhash(name, false) % peer->nbuckets;
+		LOCK(&peer->buckets[peerbucket].lock);
+		if (!atomic_load(&peer->buckets[peerbucket].exiting)) {
+			fctx = ISC_LIST_HEAD(peer->buckets[peerbucket].fctxs);
+			while (fctx != NULL &&
+			       !fctx_match(fctx, name, type, options))
+			{
+				fctx = ISC_LIST_NEXT(fctx, link);
+			}
+		}
+		if (fctx != NULL) {
+			inc_stats(res, dns_resstatscounter_sharedfetch);
+		} else {
+			UNLOCK(&peer->buckets[peerbucket].lock);
+			peer = NULL;
+		}
 	}
 
 	/*
@@ -10974,6 +11588,9 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	}
 
 unlock:
+	if (peer != NULL) {
+		UNLOCK(&peer->buckets[peerbucket].lock);
+	}
 	UNLOCK(&res->buckets[bucketnum].lock);
 
 	if (dodestroy) {
@@ -11085,8 +11702,13 @@ dns_resolver_destroyfetch(dns_fetch_t **fetchp) {
 
 	fetch->magic = 0;
 
+	/*
+	 * The fetch may have joined a fetch context of the resolver
+	 * it shares fetches with, so lock the bucket of the resolver
+	 * that owns the fetch context.
+	 */
 	bucketnum = fctx->bucketnum;
-	LOCK(&res->buckets[bucketnum].lock);
+	LOCK(&fctx->res->buckets[bucketnum].lock);
 
 	/*
 	 * Sanity check: the caller should have gotten its event before
@@ -11101,7 +11723,7 @@ dns_resolver_destroyfetch(dns_fetch_t **fetchp) {
 			RUNTIME_CHECK(event->fetch != fetch);
 		}
 	}
-	UNLOCK(&res->buckets[bucketnum].lock);
+	UNLOCK(&fctx->res->buckets[bucketnum].lock);
 
 	isc_mem_putanddetach(&fetch->mctx, fetch, sizeof(*fetch));
 
@@ -11572,6 +12194,28 @@ dns_resolver_setclientsperquery(dns_resolver_t *resolver, uint32_t min,
 	UNLOCK(&resolver->lock);
 }
 
+void
+dns_resolver_setprefetchpopular(dns_resolver_t *resolver, unsigned int count) {
+	isc_interval_t interval;
+	isc_result_t result;
+
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	LOCK(&resolver->lock);
+	if (count != resolver->prefetchpopular &&
+	    !atomic_load_acquire(&resolver->exiting))
+	{
+		isc_interval_set(&interval, 1, 0);
+		result = isc_timer_reset(resolver->prefetchtimer,
+					 (count > 0) ? isc_timertype_ticker
+						     : isc_timertype_inactive,
+					 NULL, &interval, true);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	resolver->prefetchpopular = count;
+	UNLOCK(&resolver->lock);
+}
+
 void
 dns_resolver_setfetchesperzone(dns_resolver_t *resolver, uint32_t clients) {
 	REQUIRE(VALID_RESOLVER(resolver));
@@ -11661,17 +12305,19 @@ dns_resolver_dumpfetches(dns_resolver_t *resolver, isc_statsformat_t format,
 
 	for (size_t i = 0; i < HASHSIZE(resolver->dhashbits); i++) {
 		fctxcount_t *fc;
-		LOCK(&resolver->dbuckets[i].lock);
+		RWLOCK(&resolver->dbuckets[i].lock, isc_rwlocktype_read);
 		for (fc = ISC_LIST_HEAD(resolver->dbuckets[i].list); fc != NULL;
 		     fc = ISC_LIST_NEXT(fc, link))
 		{
 			dns_name_print(fc->domain, fp);
 			fprintf(fp,
-				": %u active (%u spilled, %u "
-				"allowed)\n",
-				fc->count, fc->dropped, fc->allowed);
+				": %" PRIuFAST32 " active (%" PRIuFAST32
+				" spilled, %" PRIuFAST32 " allowed)\n",
+				atomic_load_relaxed(&fc->count),
+				atomic_load_relaxed(&fc->dropped),
+				atomic_load_relaxed(&fc->allowed));
 		}
-		UNLOCK(&resolver->dbuckets[i].lock);
+		RWUNLOCK(&resolver->dbuckets[i].lock, isc_rwlocktype_read);
 	}
 }
 
@@ -11722,3 +12368,33 @@ dns_resolver_setnonbackofftries(dns_resolver_t *resolver, unsigned int tries) {
 
 	resolver->nonbackofftries = tries;
 }
+
+unsigned int
+dns_resolver_getracethreshold(dns_resolver_t *resolver) {
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	return (resolver->racethreshold);
+}
+
+void
+dns_resolver_setracethreshold(dns_resolver_t *resolver,
+			      unsigned int threshold) {
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	resolver->racethreshold = ISC_MIN(threshold,
+					  MAX_SINGLE_QUERY_TIMEOUT);
+}
+
+void
+dns_resolver_setsharedfetches(dns_resolver_t *resolver, dns_resolver_t *peer) {
+	REQUIRE(VALID_RESOLVER(resolver));
+	REQUIRE(VALID_RESOLVER(peer));
+	REQUIRE(!resolver->frozen);
+	REQUIRE(resolver != peer && peer->sharedfetches == NULL);
+	REQUIRE(resolver->view->cachedb == peer->view->cachedb);
+
+	if (resolver->sharedfetches != NULL) {
+		dns_resolver_detach(&resolver->sharedfetches);
+	}
+	dns_resolver_attach(peer, &resolver->sharedfetches);
+}
@@ -17,14 +17,17 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+#include <isc/ascii.h>
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/net.h>
+#include <isc/netmgr.h>
 #include <isc/netaddr.h>
 #include <isc/print.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
+#include <isc/serial.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/util.h>
@@ -34,6 +37,7 @@
 #include <dns/dnsrps.h>
 #include <dns/events.h>
 #include <dns/fixedname.h>
+#include <dns/journal.h>
 #include <dns/log.h>
 #include <dns/rbt.h>
 #include <dns/rdata.h>
@@ -1479,6 +1483,20 @@ dns_rpz_new_zones(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 		goto cleanup_task;
 	}
 
+	if (!rpzs->p.dnsrps_enabled &&
+	    isc_task_getnetmgr(rpzs->updater) != NULL)
+	{
+		size_t size;
+
+		rpzs->nnamecaches =
+			isc_nm_getnworkers(isc_task_getnetmgr(rpzs->updater));
+		size = rpzs->nnamecaches * DNS_RPZ_NAMECACHE_SIZE *
+		       sizeof(rpzs->namecache[0]);
+		rpzs->namecache = isc_mem_get(mctx, size);
+		memset(rpzs->namecache, 0, size);
+		rpzs->namegen = 1;
+	}
+
 	isc_mem_attach(mctx, &rpzs->mctx);
 
 	*rpzsp = rpzs;
@@ -1533,8 +1551,6 @@ dns_rpz_new_zone(dns_rpz_zones_t *rpzs, dns_rpz_zone_t **rpzp) {
 	 * simplifies dns__rpz_timer_cb().
 	 */
 
-	isc_ht_init(&rpz->nodes, rpzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
-
 	dns_name_init(&rpz->origin, NULL);
 	dns_name_init(&rpz->client_ip, NULL);
 	dns_name_init(&rpz->ip, NULL);
@@ -1649,6 +1665,20 @@ unlock:
 	return (result);
 }
 
+void
+dns_rpz_setjournal(dns_rpz_zone_t *rpz, const char *journal) {
+	REQUIRE(DNS_RPZ_ZONE_VALID(rpz));
+
+	LOCK(&rpz->rpzs->maint_lock);
+	if (rpz->journal != NULL) {
+		isc_mem_free(rpz->rpzs->mctx, rpz->journal);
+	}
+	if (journal != NULL) {
+		rpz->journal = isc_mem_strdup(rpz->rpzs->mctx, journal);
+	}
+	UNLOCK(&rpz->rpzs->maint_lock);
+}
+
 static void
 update_rpz_done_cb(void *data, isc_result_t result) {
 	dns_rpz_zone_t *rpz = (dns_rpz_zone_t *)data;
@@ -1707,19 +1737,114 @@ done:
 	dns_rpz_unref_rpzs(rpz->rpzs);
 }
 
+/*
+ * Set '*presentp' to whether 'name' owns any data in 'version' of 'db'.
+ * Empty non-terminals do not count.
+ */
 static isc_result_t
-update_nodes(dns_rpz_zone_t *rpz, isc_ht_t *newnodes) {
+name_present(dns_db_t *db, dns_dbversion_t *version, const dns_name_t *name,
+	     bool *presentp) {
 	isc_result_t result;
-	dns_dbiterator_t *updbit = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_rdatasetiter_t *rdsiter = NULL;
+
+	*presentp = false;
+
+	if (db == NULL) {
+		return (ISC_R_SUCCESS);
+	}
+
+	result = dns_db_findnode(db, name, false, &node);
+	if (result == ISC_R_NOTFOUND) {
+		return (ISC_R_SUCCESS);
+	}
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	result = dns_db_allrdatasets(db, node, version, 0, 0, &rdsiter);
+	if (result == ISC_R_SUCCESS) {
+		*presentp = (dns_rdatasetiter_first(rdsiter) == ISC_R_SUCCESS);
+		dns_rdatasetiter_destroy(&rdsiter);
+	}
+	dns_db_detachnode(db, &node);
+
+	return (result);
+}
+
+/*
+ * Bring the summary data for 'name' in line with the version being
+ * processed: add it if it owns data now but did not in the version
+ * last processed, and delete it if it no longer does.  Adding or
+ * deleting a name that is already in the wanted state is harmless, so
+ * this can be repeated after a failed update.
+ */
+static isc_result_t
+update_name(dns_rpz_zone_t *rpz, dns_name_t *name, const char *domain) {
+	isc_result_t result;
+	char namebuf[DNS_NAME_FORMATSIZE];
+	bool present, known;
+
+	result = name_present(rpz->updb, rpz->updbversion, name, &present);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	result = name_present(rpz->lastdb, rpz->lastversion, name, &known);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	if (present && !known) {
+		dns_name_downcase(name, name, NULL);
+
+		/*
+		 * Only the single rpz updates are serialized, so we need
+		 * to lock here because we can be processing more updates
+		 * to different rpz zones at the same time
+		 */
+		LOCK(&rpz->rpzs->maint_lock);
+		result = rpz_add(rpz, name);
+		UNLOCK(&rpz->rpzs->maint_lock);
+
+		if (result != ISC_R_SUCCESS) {
+			dns_name_format(name, namebuf, sizeof(namebuf));
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
+				      "rpz: %s: adding node %s "
+				      "to RPZ error %s",
+				      domain, namebuf,
+				      isc_result_totext(result));
+		} else if (isc_log_wouldlog(dns_lctx, ISC_LOG_DEBUG(3))) {
+			dns_name_format(name, namebuf, sizeof(namebuf));
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_MASTER, ISC_LOG_DEBUG(3),
+				      "rpz: %s: adding node %s", domain,
+				      namebuf);
+		}
+	} else if (!present && known) {
+		dns_name_downcase(name, name, NULL);
+
+		LOCK(&rpz->rpzs->maint_lock);
+		rpz_del(rpz, name);
+		UNLOCK(&rpz->rpzs->maint_lock);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Call update_name() for every name in 'db'.
+ */
+static isc_result_t
+update_nodes(dns_rpz_zone_t *rpz, dns_db_t *db, const char *domain) {
+	isc_result_t result;
+	dns_dbiterator_t *dbit = NULL;
 	dns_name_t *name = NULL;
 	dns_fixedname_t fixname;
-	char domain[DNS_NAME_FORMATSIZE];
-
-	dns_name_format(&rpz->origin, domain, DNS_NAME_FORMATSIZE);
 
 	name = dns_fixedname_initname(&fixname);
 
-	result = dns_db_createiterator(rpz->updb, DNS_DB_NONSEC3, &updbit);
+	result = dns_db_createiterator(db, DNS_DB_NONSEC3, &dbit);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
 			      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
@@ -1728,7 +1853,7 @@ update_nodes(dns_rpz_zone_t *rpz, isc_ht_t *newnodes) {
 		return (result);
 	}
 
-	result = dns_dbiterator_first(updbit);
+	result = dns_dbiterator_first(dbit);
 	if (result != ISC_R_SUCCESS && result != ISC_R_NOMORE) {
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
 			      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
@@ -1738,8 +1863,6 @@ update_nodes(dns_rpz_zone_t *rpz, isc_ht_t *newnodes) {
 	}
 
 	while (result == ISC_R_SUCCESS) {
-		char namebuf[DNS_NAME_FORMATSIZE];
-		dns_rdatasetiter_t *rdsiter = NULL;
 		dns_dbnode_t *node = NULL;
 
 		result = dns__rpz_shuttingdown(rpz->rpzs);
@@ -1747,7 +1870,7 @@ update_nodes(dns_rpz_zone_t *rpz, isc_ht_t *newnodes) {
 			goto cleanup;
 		}
 
-		result = dns_dbiterator_current(updbit, &node, name);
+		result = dns_dbiterator_current(dbit, &node, name);
 		if (result != ISC_R_SUCCESS) {
 			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
 				      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
@@ -1755,88 +1878,22 @@ update_nodes(dns_rpz_zone_t *rpz, isc_ht_t *newnodes) {
 				      domain, isc_result_totext(result));
 			goto cleanup;
 		}
+		dns_db_detachnode(db, &node);
 
-		result = dns_dbiterator_pause(updbit);
+		result = dns_dbiterator_pause(dbit);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 
-		result = dns_db_allrdatasets(rpz->updb, node, rpz->updbversion,
-					     0, 0, &rdsiter);
+		result = update_name(rpz, name, domain);
 		if (result != ISC_R_SUCCESS) {
 			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
 				      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
-				      "rpz: %s: failed to fetch "
-				      "rrdatasets - %s",
+				      "rpz: %s: error %s while checking "
+				      "rdatasets",
 				      domain, isc_result_totext(result));
-			dns_db_detachnode(rpz->updb, &node);
 			goto cleanup;
 		}
 
-		result = dns_rdatasetiter_first(rdsiter);
-
-		dns_rdatasetiter_destroy(&rdsiter);
-		dns_db_detachnode(rpz->updb, &node);
-
-		if (result != ISC_R_SUCCESS) { /* skip empty non-terminal */
-			if (result != ISC_R_NOMORE) {
-				isc_log_write(
-					dns_lctx, DNS_LOGCATEGORY_GENERAL,
-					DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
-					"rpz: %s: error %s while creating "
-					"rdatasetiter",
-					domain, isc_result_totext(result));
-			}
-			goto next;
-		}
-
-		dns_name_downcase(name, name, NULL);
-
-		/* Add entry to the new nodes table */
-		result = isc_ht_add(newnodes, name->ndata, name->length, rpz);
-		if (result != ISC_R_SUCCESS) {
-			dns_name_format(name, namebuf, sizeof(namebuf));
-			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
-				      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
-				      "rpz: %s, adding node %s to HT error %s",
-				      domain, namebuf,
-				      isc_result_totext(result));
-			goto next;
-		}
-
-		/* Does the entry exist in the old nodes table? */
-		result = isc_ht_find(rpz->nodes, name->ndata, name->length,
-				     NULL);
-		if (result == ISC_R_SUCCESS) { /* found */
-			isc_ht_delete(rpz->nodes, name->ndata, name->length);
-			goto next;
-		}
-
-		/*
-		 * Only the single rpz updates are serialized, so we need to
-		 * lock here because we can be processing more updates to
-		 * different rpz zones at the same time
-		 */
-		LOCK(&rpz->rpzs->maint_lock);
-		result = rpz_add(rpz, name);
-		UNLOCK(&rpz->rpzs->maint_lock);
-
-		if (result != ISC_R_SUCCESS) {
-			dns_name_format(name, namebuf, sizeof(namebuf));
-			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
-				      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
-				      "rpz: %s: adding node %s "
-				      "to RPZ error %s",
-				      domain, namebuf,
-				      isc_result_totext(result));
-		} else if (isc_log_wouldlog(dns_lctx, ISC_LOG_DEBUG(3))) {
-			dns_name_format(name, namebuf, sizeof(namebuf));
-			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
-				      DNS_LOGMODULE_MASTER, ISC_LOG_DEBUG(3),
-				      "rpz: %s: adding node %s", domain,
-				      namebuf);
-		}
-
-	next:
-		result = dns_dbiterator_next(updbit);
+		result = dns_dbiterator_next(dbit);
 	}
 	INSIST(result != ISC_R_SUCCESS);
 	if (result == ISC_R_NOMORE) {
@@ -1844,24 +1901,65 @@ update_nodes(dns_rpz_zone_t *rpz, isc_ht_t *newnodes) {
 	}
 
 cleanup:
-	dns_dbiterator_destroy(&updbit);
+	dns_dbiterator_destroy(&dbit);
 
 	return (result);
 }
 
+/*
+ * Update the summary data from the names changed in the zone's journal
+ * between serials 'begin' and 'end', rather than walking the whole
+ * zone.  This makes frequent small updates of a large policy zone
+ * cheap.  On failure, the caller falls back to update_nodes().
+ */
 static isc_result_t
-cleanup_nodes(dns_rpz_zone_t *rpz) {
+update_from_journal(dns_rpz_zone_t *rpz, const char *journal, uint32_t begin,
+		    uint32_t end, const char *domain) {
 	isc_result_t result;
+	isc_mem_t *mctx = rpz->rpzs->mctx;
+	dns_journal_t *j = NULL;
+	isc_ht_t *changed = NULL;
 	isc_ht_iter_t *iter = NULL;
-	dns_name_t *name = NULL;
 	dns_fixedname_t fixname;
+	dns_name_t *name = dns_fixedname_initname(&fixname);
 
-	name = dns_fixedname_initname(&fixname);
+	result = dns_journal_open(mctx, journal, DNS_JOURNAL_READ, &j);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	result = dns_journal_iter_init(j, begin, end, NULL);
+	if (result != ISC_R_SUCCESS) {
+		dns_journal_destroy(&j);
+		return (result);
+	}
 
-	isc_ht_iter_create(rpz->nodes, &iter);
+	/*
+	 * Collect the distinct owner names first: a name is usually
+	 * both deleted and added when its data changes.
+	 */
+	isc_ht_init(&changed, mctx, 1, ISC_HT_CASE_SENSITIVE);
+	for (result = dns_journal_first_rr(j); result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(j))
+	{
+		dns_name_t *owner = NULL;
+		dns_rdata_t *rdata = NULL;
+		uint32_t ttl;
+
+		dns_journal_current_rr(j, &owner, &ttl, &rdata);
+		dns_name_downcase(owner, name, NULL);
+		result = isc_ht_add(changed, name->ndata, name->length, NULL);
+		if (result != ISC_R_SUCCESS && result != ISC_R_EXISTS) {
+			break;
+		}
+	}
+	dns_journal_destroy(&j);
+	if (result != ISC_R_NOMORE) {
+		goto cleanup;
+	}
 
+	isc_ht_iter_create(changed, &iter);
 	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_delcurrent_next(iter))
+	     result = isc_ht_iter_next(iter))
 	{
 		isc_region_t region;
 		unsigned char *key = NULL;
@@ -1877,16 +1975,18 @@ cleanup_nodes(dns_rpz_zone_t *rpz) {
 		region.length = (unsigned int)keysize;
 		dns_name_fromregion(name, &region);
 
-		LOCK(&rpz->rpzs->maint_lock);
-		rpz_del(rpz, name);
-		UNLOCK(&rpz->rpzs->maint_lock);
+		result = update_name(rpz, name, domain);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
 	}
-	INSIST(result != ISC_R_SUCCESS);
+	isc_ht_iter_destroy(&iter);
+
+cleanup:
 	if (result == ISC_R_NOMORE) {
 		result = ISC_R_SUCCESS;
 	}
-
-	isc_ht_iter_destroy(&iter);
+	isc_ht_destroy(&changed);
 
 	return (result);
 }
@@ -1910,32 +2010,82 @@ static void
 update_rpz_cb(void *data) {
 	dns_rpz_zone_t *rpz = (dns_rpz_zone_t *)data;
 	isc_result_t result = ISC_R_SUCCESS;
-	isc_ht_t *newnodes = NULL;
-
-	REQUIRE(rpz->nodes != NULL);
+	char *journal = NULL;
+	char domain[DNS_NAME_FORMATSIZE];
+	uint32_t serial, lastserial;
 
 	result = dns__rpz_shuttingdown(rpz->rpzs);
 	if (result != ISC_R_SUCCESS) {
 		goto shuttingdown;
 	}
 
-	isc_ht_init(&newnodes, rpz->rpzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
+	dns_name_format(&rpz->origin, domain, DNS_NAME_FORMATSIZE);
 
-	result = update_nodes(rpz, newnodes);
-	if (result != ISC_R_SUCCESS) {
-		goto cleanup;
+	/*
+	 * If the last update was of an earlier version of the same
+	 * database, only the names in the journal since then can have
+	 * changed.
+	 */
+	LOCK(&rpz->rpzs->maint_lock);
+	if (rpz->journal != NULL) {
+		journal = isc_mem_strdup(rpz->rpzs->mctx, rpz->journal);
 	}
+	UNLOCK(&rpz->rpzs->maint_lock);
 
-	result = cleanup_nodes(rpz);
-	if (result != ISC_R_SUCCESS) {
-		goto cleanup;
+	if (journal != NULL && rpz->lastdb == rpz->updb &&
+	    dns_db_getsoaserial(rpz->lastdb, rpz->lastversion, &lastserial) ==
+		    ISC_R_SUCCESS &&
+	    dns_db_getsoaserial(rpz->updb, rpz->updbversion, &serial) ==
+		    ISC_R_SUCCESS &&
+	    isc_serial_gt(serial, lastserial))
+	{
+		result = update_from_journal(rpz, journal, lastserial, serial,
+					     domain);
+		isc_mem_free(rpz->rpzs->mctx, journal);
+		if (result == ISC_R_SUCCESS) {
+			goto done;
+		}
+		if (result == ISC_R_SHUTTINGDOWN) {
+			goto shuttingdown;
+		}
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_DEBUG(1),
+			      "rpz: %s: journal not usable for update "
+			      "(%s), walking the whole zone",
+			      domain, isc_result_totext(result));
+	} else if (journal != NULL) {
+		isc_mem_free(rpz->rpzs->mctx, journal);
 	}
 
-	/* Finalize the update */
-	ISC_SWAP(rpz->nodes, newnodes);
+	/*
+	 * Compare every name in the new version with the last version
+	 * processed.  The nodes of a name deleted since then are still
+	 * in the database while that version is open, but if this is a
+	 * new database, the names only in the old one must be visited
+	 * there.
+	 */
+	result = update_nodes(rpz, rpz->updb, domain);
+	if (result == ISC_R_SUCCESS && rpz->lastdb != NULL &&
+	    rpz->lastdb != rpz->updb)
+	{
+		result = update_nodes(rpz, rpz->lastdb, domain);
+	}
+	if (result != ISC_R_SUCCESS) {
+		goto shuttingdown;
+	}
 
-cleanup:
-	isc_ht_destroy(&newnodes);
+done:
+	/*
+	 * The version just processed is the base for the next update.
+	 * After a failure the old base is kept, and the next update
+	 * repeats the work.
+	 */
+	if (rpz->lastdb != NULL) {
+		dns_db_closeversion(rpz->lastdb, &rpz->lastversion, false);
+		dns_db_detach(&rpz->lastdb);
+	}
+	dns_db_attach(rpz->updb, &rpz->lastdb);
+	dns_db_attachversion(rpz->updb, rpz->updbversion, &rpz->lastversion);
 
 shuttingdown:
 	rpz->updateresult = result;
@@ -2089,7 +2239,14 @@ dns_rpz_zone_destroy(dns_rpz_zone_t **rpzp) {
 			true);
 	isc_timer_destroy(&rpz->updatetimer);
 
-	isc_ht_destroy(&rpz->nodes);
+	if (rpz->lastdb != NULL) {
+		dns_db_closeversion(rpz->lastdb, &rpz->lastversion, false);
+		dns_db_detach(&rpz->lastdb);
+	}
+
+	if (rpz->journal != NULL) {
+		isc_mem_free(rpzs->mctx, rpz->journal);
+	}
 
 	isc_mem_put(rpzs->mctx, rpz, sizeof(*rpz));
 }
@@ -2120,6 +2277,11 @@ dns__rpz_zones_destroy(dns_rpz_zones_t *rpzs) {
 	if (rpzs->rbt != NULL) {
 		dns_rbt_destroy(&rpzs->rbt);
 	}
+	if (rpzs->namecache != NULL) {
+		isc_mem_put(rpzs->mctx, rpzs->namecache,
+			    rpzs->nnamecaches * DNS_RPZ_NAMECACHE_SIZE *
+				    sizeof(rpzs->namecache[0]));
+	}
 	isc_task_destroy(&rpzs->updater);
 	isc_mutex_destroy(&rpzs->maint_lock);
 	isc_rwlock_destroy(&rpzs->search_lock);
@@ -2183,6 +2345,7 @@ rpz_add(dns_rpz_zone_t *rpz, const dns_name_t *src_name) {
 	case DNS_RPZ_TYPE_QNAME:
 	case DNS_RPZ_TYPE_NSDNAME:
 		result = add_name(rpz, rpz_type, src_name);
+		rpzs->namegen++;
 		break;
 	case DNS_RPZ_TYPE_CLIENT_IP:
 	case DNS_RPZ_TYPE_IP:
@@ -2400,6 +2563,7 @@ rpz_del(dns_rpz_zone_t *rpz, const dns_name_t *src_name) {
 	case DNS_RPZ_TYPE_QNAME:
 	case DNS_RPZ_TYPE_NSDNAME:
 		del_name(rpz, rpz_type, src_name);
+		rpzs->namegen++;
 		break;
 	case DNS_RPZ_TYPE_CLIENT_IP:
 	case DNS_RPZ_TYPE_IP:
@@ -2549,6 +2713,7 @@ dns_rpz_find_name(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 	const dns_rpz_nm_data_t *nm_data = NULL;
 	dns_rpz_zbits_t found_zbits;
 	dns_rbtnodechain_t chain;
+	dns_rpz_namecache_t *entry = NULL;
 	isc_result_t result;
 	int i;
 
@@ -2558,10 +2723,31 @@ dns_rpz_find_name(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 
 	found_zbits = 0;
 
+	/*
+	 * Each network manager thread has its own table of recent
+	 * results, so it needs no locking of its own.
+	 */
+	if (rpzs->namecache != NULL && isc_nm_tid() >= 0 &&
+	    (unsigned int)isc_nm_tid() < rpzs->nnamecaches)
+	{
+		entry = &rpzs->namecache[isc_nm_tid() * DNS_RPZ_NAMECACHE_SIZE +
+					 dns_name_hash(trig_name, false) %
+						 DNS_RPZ_NAMECACHE_SIZE];
+	}
+
 	dns_rbtnodechain_init(&chain);
 
 	RWLOCK(&rpzs->search_lock, isc_rwlocktype_read);
 
+	if (entry != NULL && entry->gen == rpzs->namegen &&
+	    entry->type == rpz_type && entry->length == trig_name->length &&
+	    isc_ascii_lowerequal(entry->ndata, trig_name->ndata,
+				 trig_name->length))
+	{
+		found_zbits = entry->found;
+		goto unlock;
+	}
+
 	nmnode = NULL;
 	result = dns_rbt_findnode(rpzs->rbt, trig_name, NULL, &nmnode, &chain,
 				  DNS_RBTFIND_EMPTYDATA, NULL, NULL);
@@ -2646,9 +2832,19 @@ dns_rpz_find_name(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 			      DNS_LOGMODULE_RBTDB, DNS_RPZ_ERROR_LEVEL,
 			      "dns_rpz_find_name(%s) failed: %s", namebuf,
 			      isc_result_totext(result));
+		entry = NULL;
 		break;
 	}
 
+	if (entry != NULL) {
+		entry->gen = rpzs->namegen;
+		entry->type = rpz_type;
+		entry->found = found_zbits;
+		entry->length = trig_name->length;
+		memmove(entry->ndata, trig_name->ndata, trig_name->length);
+	}
+
+unlock:
 	RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_read);
 
 	dns_rbtnodechain_invalidate(&chain);
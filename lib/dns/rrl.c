@@ -22,6 +22,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/hash.h>
 #include <isc/mem.h>
 #include <isc/net.h>
 #include <isc/netaddr.h>
@@ -1043,6 +1044,60 @@ log_stops(dns_rrl_t *rrl, isc_stdtime_t now, int limit, char *log_buf,
 	rrl->last_logged = e;
 }
 
+/*
+ * Estimate total query per second rate when scaling by qps, and
+ * the resulting scale for the limits.
+ */
+static void
+get_scale(dns_rrl_t *rrl, isc_stdtime_t now, double *qpsp, double *scalep) {
+	double qps;
+	int secs;
+
+	if (rrl->qps_scale == 0) {
+		*qpsp = 0.0;
+		*scalep = 1.0;
+		return;
+	}
+
+	LOCK(&rrl->lock);
+	++rrl->qps_responses;
+	secs = delta_rrl_time(rrl->qps_time, now);
+	if (secs <= 0) {
+		qps = rrl->qps;
+	} else {
+		qps = (1.0 * rrl->qps_responses) / secs;
+		if (secs >= rrl->window) {
+			if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DEBUG3)) {
+				isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
+					      DNS_LOGMODULE_REQUEST,
+					      DNS_RRL_LOG_DEBUG3,
+					      "%d responses/%d seconds"
+					      " = %d qps",
+					      rrl->qps_responses, secs,
+					      (int)qps);
+			}
+			rrl->qps = qps;
+			rrl->qps_responses = 0;
+			rrl->qps_time = now;
+		} else if (qps < rrl->qps) {
+			qps = rrl->qps;
+		}
+	}
+	UNLOCK(&rrl->lock);
+
+	*qpsp = qps;
+	*scalep = rrl->qps_scale / qps;
+}
+
+static unsigned int
+get_shard(const dns_rrl_t *rrl, const isc_sockaddr_t *client_addr) {
+	dns_rrl_key_t key;
+
+	make_key(rrl, &key, client_addr, NULL, dns_rdatatype_none, NULL, 0,
+		 DNS_RRL_RTYPE_ALL);
+	return (isc_hash32(key.s.ip, sizeof(key.s.ip), true) % rrl->nshards);
+}
+
 /*
  * Main rate limit interface.
  */
@@ -1055,7 +1110,6 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	dns_rrl_rtype_t rtype;
 	dns_rrl_entry_t *e;
 	isc_netaddr_t netclient;
-	int secs;
 	double qps, scale;
 	int exempt_match;
 	isc_result_t result;
@@ -1073,44 +1127,17 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		}
 	}
 
-	LOCK(&rrl->lock);
+	get_scale(rrl, now, &qps, &scale);
 
 	/*
-	 * Estimate total query per second rate when scaling by qps.
+	 * All of the entries for a client are in the same shard.
 	 */
-	if (rrl->qps_scale == 0) {
-		qps = 0.0;
-		scale = 1.0;
-	} else {
-		++rrl->qps_responses;
-		secs = delta_rrl_time(rrl->qps_time, now);
-		if (secs <= 0) {
-			qps = rrl->qps;
-		} else {
-			qps = (1.0 * rrl->qps_responses) / secs;
-			if (secs >= rrl->window) {
-				if (isc_log_wouldlog(dns_lctx,
-						     DNS_RRL_LOG_DEBUG3))
-				{
-					isc_log_write(dns_lctx,
-						      DNS_LOGCATEGORY_RRL,
-						      DNS_LOGMODULE_REQUEST,
-						      DNS_RRL_LOG_DEBUG3,
-						      "%d responses/%d seconds"
-						      " = %d qps",
-						      rrl->qps_responses, secs,
-						      (int)qps);
-				}
-				rrl->qps = qps;
-				rrl->qps_responses = 0;
-				rrl->qps_time = now;
-			} else if (qps < rrl->qps) {
-				qps = rrl->qps;
-			}
-		}
-		scale = rrl->qps_scale / qps;
+	if (rrl->nshards != 0) {
+		rrl = rrl->shards[get_shard(rrl, client_addr)];
 	}
 
+	LOCK(&rrl->lock);
+
 	/*
 	 * Do maintenance once per second.
 	 */
@@ -1280,23 +1307,80 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	return (rrl_result);
 }
 
-void
-dns_rrl_view_destroy(dns_view_t *view) {
-	dns_rrl_t *rrl;
-	dns_rrl_block_t *b;
-	dns_rrl_hash_t *h;
+bool
+dns_rrl_dropping(dns_view_t *view, const isc_sockaddr_t *client_addr,
+		 isc_stdtime_t now) {
+	dns_rrl_t *rrl, *shard;
+	dns_rrl_entry_t *e;
+	isc_netaddr_t netclient;
+	double qps, scale;
+	int exempt_match, age;
+	isc_result_t result;
 	char log_buf[DNS_RRL_LOG_BUF_LEN];
-	int i;
+	bool dropping = false;
 
 	rrl = view->rrl;
-	if (rrl == NULL) {
-		return;
+	if (rrl->log_only || rrl->all_per_second.r == 0) {
+		return (false);
+	}
+	if (rrl->exempt != NULL) {
+		isc_netaddr_fromsockaddr(&netclient, client_addr);
+		result = dns_acl_match(&netclient, NULL, rrl->exempt,
+				       view->aclenv, &exempt_match, NULL);
+		if (result == ISC_R_SUCCESS && exempt_match > 0) {
+			return (false);
+		}
+	}
+
+	shard = rrl;
+	if (rrl->nshards != 0) {
+		shard = rrl->shards[get_shard(rrl, client_addr)];
 	}
-	view->rrl = NULL;
 
 	/*
-	 * Assume the caller takes care of locking the view and anything else.
+	 * Only look at an existing entry, and leave it alone unless it
+	 * has no tokens left even after crediting the time since it was
+	 * last used.  Otherwise dns_rrl() will debit it as usual.
 	 */
+	LOCK(&shard->lock);
+	e = get_entry(shard, client_addr, NULL, 0, dns_rdatatype_none, NULL,
+		      DNS_RRL_RTYPE_ALL, now, false, log_buf, sizeof(log_buf));
+	if (e != NULL) {
+		age = get_age(shard, e, now);
+		dropping = (age <= shard->window &&
+			    response_balance(shard, e, age) <= 0);
+	}
+	UNLOCK(&shard->lock);
+
+	if (!dropping) {
+		return (false);
+	}
+
+	/*
+	 * Debit the entry as dns_rrl() would.  This drops the response:
+	 * the all-per-second limit never slips.  The entry may have been
+	 * stolen or credited in the meantime, so look again.
+	 */
+	get_scale(rrl, now, &qps, &scale);
+
+	LOCK(&shard->lock);
+	e = get_entry(shard, client_addr, NULL, 0, dns_rdatatype_none, NULL,
+		      DNS_RRL_RTYPE_ALL, now, false, log_buf, sizeof(log_buf));
+	dropping = (e != NULL &&
+		    debit_rrl_entry(shard, e, qps, scale, client_addr, now,
+				    log_buf, sizeof(log_buf)) ==
+			    DNS_RRL_RESULT_DROP);
+	UNLOCK(&shard->lock);
+
+	return (dropping);
+}
+
+static void
+destroy_rrl(dns_rrl_t *rrl) {
+	dns_rrl_block_t *b;
+	dns_rrl_hash_t *h;
+	char log_buf[DNS_RRL_LOG_BUF_LEN];
+	int i;
 
 	if (rrl->num_logged > 0) {
 		log_stops(rrl, 0, INT32_MAX, log_buf, sizeof(log_buf));
@@ -1336,32 +1420,123 @@ dns_rrl_view_destroy(dns_view_t *view) {
 	isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
 }
 
-isc_result_t
-dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries) {
+void
+dns_rrl_view_destroy(dns_view_t *view) {
 	dns_rrl_t *rrl;
-	isc_result_t result;
+	int i;
 
-	*rrlp = NULL;
+	rrl = view->rrl;
+	if (rrl == NULL) {
+		return;
+	}
+	view->rrl = NULL;
+
+	/*
+	 * Assume the caller takes care of locking the view and anything else.
+	 */
+
+	for (i = 0; i < rrl->nshards; ++i) {
+		destroy_rrl(rrl->shards[i]);
+	}
+	destroy_rrl(rrl);
+}
+
+static isc_result_t
+new_rrl(isc_mem_t *mctx, int max_entries, int min_entries, dns_rrl_t **rrlp) {
+	dns_rrl_t *rrl;
+	isc_result_t result;
 
-	rrl = isc_mem_get(view->mctx, sizeof(*rrl));
+	rrl = isc_mem_get(mctx, sizeof(*rrl));
 	memset(rrl, 0, sizeof(*rrl));
-	isc_mem_attach(view->mctx, &rrl->mctx);
+	isc_mem_attach(mctx, &rrl->mctx);
 	isc_mutex_init(&rrl->lock);
 	isc_stdtime_get(&rrl->ts_bases[0]);
-
-	view->rrl = rrl;
+	rrl->max_entries = max_entries;
 
 	result = expand_entries(rrl, min_entries);
 	if (result != ISC_R_SUCCESS) {
-		dns_rrl_view_destroy(view);
+		destroy_rrl(rrl);
 		return (result);
 	}
 	result = expand_rrl_hash(rrl, 0);
 	if (result != ISC_R_SUCCESS) {
-		dns_rrl_view_destroy(view);
+		destroy_rrl(rrl);
 		return (result);
 	}
 
 	*rrlp = rrl;
 	return (ISC_R_SUCCESS);
 }
+
+isc_result_t
+dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries) {
+	dns_rrl_t *rrl = NULL;
+	isc_result_t result;
+
+	*rrlp = NULL;
+
+	result = new_rrl(view->mctx, 0, min_entries, &rrl);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	view->rrl = rrl;
+
+	*rrlp = rrl;
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_rrl_shard(dns_rrl_t *rrl, int min_entries) {
+	dns_rrl_t *shard;
+	isc_result_t result;
+	int i, n;
+
+	REQUIRE(rrl->nshards == 0);
+
+	/*
+	 * An unlimited table stays in one piece, since the shards could
+	 * not share the limit.
+	 */
+	n = ISC_MIN(rrl->max_entries / DNS_RRL_SHARD_ENTRIES,
+		    DNS_RRL_MAX_SHARDS);
+	if (n < 2) {
+		return (ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < n; ++i) {
+		shard = NULL;
+		result = new_rrl(rrl->mctx, rrl->max_entries / n,
+				 ISC_MAX(min_entries / n, 1), &shard);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+
+		shard->log_only = rrl->log_only;
+		shard->responses_per_second = rrl->responses_per_second;
+		shard->referrals_per_second = rrl->referrals_per_second;
+		shard->nodata_per_second = rrl->nodata_per_second;
+		shard->nxdomains_per_second = rrl->nxdomains_per_second;
+		shard->errors_per_second = rrl->errors_per_second;
+		shard->all_per_second = rrl->all_per_second;
+		shard->slip = rrl->slip;
+		shard->window = rrl->window;
+		shard->qps_scale = rrl->qps_scale;
+		shard->ipv4_prefixlen = rrl->ipv4_prefixlen;
+		shard->ipv4_mask = rrl->ipv4_mask;
+		shard->ipv6_prefixlen = rrl->ipv6_prefixlen;
+		memmove(shard->ipv6_mask, rrl->ipv6_mask,
+			sizeof(shard->ipv6_mask));
+
+		rrl->shards[rrl->nshards++] = shard;
+	}
+
+	return (ISC_R_SUCCESS);
+
+cleanup:
+	while (rrl->nshards > 0) {
+		destroy_rrl(rrl->shards[--rrl->nshards]);
+		rrl->shards[rrl->nshards] = NULL;
+	}
+	return (result);
+}
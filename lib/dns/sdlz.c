@@ -52,7 +52,9 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include <isc/atomic.h>
 #include <isc/buffer.h>
+#include <isc/ht.h>
 #include <isc/lex.h>
 #include <isc/log.h>
 #include <isc/magic.h>
@@ -62,6 +64,7 @@
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
@@ -86,6 +89,47 @@
  * Private Types
  */
 
+/*
+ * A record put by a driver's lookup method, kept so that it can be
+ * replayed through dns_sdlz_putrr() when the answer is cached.  The
+ * type and data strings follow the structure.
+ */
+typedef struct sdlz_cacherr sdlz_cacherr_t;
+struct sdlz_cacherr {
+	size_t size;
+	dns_ttl_t ttl;
+	char *type;
+	char *data;
+	ISC_LINK(sdlz_cacherr_t) link;
+};
+
+/*
+ * A cached result of a driver's findzone or lookup method.
+ */
+typedef struct sdlz_cacheentry {
+	isc_result_t result;
+	dns_ttl_t ttl; /* lowest TTL of the records */
+	isc_stdtime_t expire;
+	ISC_LIST(sdlz_cacherr_t) rrs;
+} sdlz_cacheentry_t;
+
+/*
+ * The per-"dlz" statement data handed to the DLZ layer as 'dbdata';
+ * the driver's own dbdata is kept in it, along with the lookup cache.
+ */
+typedef struct sdlz_instance {
+	isc_mem_t *mctx;
+	void *dbdata;
+
+	/* Atomic */
+	atomic_bool noasync; /* the driver has no asynchronous lookup */
+
+	/* Locked by cachelock */
+	isc_rwlock_t cachelock;
+	dns_ttl_t cachettl; /* 0 when caching is disabled */
+	isc_ht_t *cache;
+} sdlz_instance_t;
+
 struct dns_sdlzimplementation {
 	const dns_sdlzmethods_t *methods;
 	isc_mem_t *mctx;
@@ -100,6 +144,7 @@ struct dns_sdlz_db {
 	dns_db_t common;
 	void *dbdata;
 	dns_sdlzimplementation_t *dlzimp;
+	sdlz_instance_t *inst;
 
 	/* Atomic */
 	isc_refcount_t references;
@@ -118,6 +163,7 @@ struct dns_sdlzlookup {
 	dns_name_t *name;
 	ISC_LINK(dns_sdlzlookup_t) link;
 	dns_rdatacallbacks_t callbacks;
+	sdlz_cacheentry_t *capture; /* records put are also added here */
 
 	/* Atomic */
 	isc_refcount_t references;
@@ -162,6 +208,12 @@ typedef struct sdlz_rdatasetiter {
 /* This is a reasonable value */
 #define SDLZ_DEFAULT_TTL (60 * 60 * 24)
 
+/*
+ * Upper bound on the number of cached driver answers per instance;
+ * expired answers are purged when it is reached.
+ */
+#define SDLZ_CACHE_MAXENTRIES 65536
+
 #ifdef __COVERITY__
 #define MAYBE_LOCK(imp)	  LOCK(&imp->driverlock)
 #define MAYBE_UNLOCK(imp) UNLOCK(&imp->driverlock)
@@ -257,6 +309,225 @@ initial_size(const char *data) {
 	return (len * 64 + 64);
 }
 
+/*
+ * Lookup cache.  Answers from the driver's findzone and lookup methods
+ * are cached per instance, keyed on the method, the zone and the name,
+ * for at most the configured time and never longer than the lowest
+ * TTL of the records returned.  The driver is assumed to give the same
+ * answer to every client; caching is only enabled on request.
+ */
+
+#define SDLZ_CACHE_KEYSIZE (2 * (DNS_NAME_MAXTEXT + 1) + 1)
+
+static uint32_t
+cache_key(unsigned char *key, char kind, const char *zone, const char *name) {
+	size_t zlen = (zone != NULL) ? strlen(zone) : 0;
+	size_t nlen = strlen(name);
+
+	INSIST(zlen + nlen + 2 <= SDLZ_CACHE_KEYSIZE);
+
+	key[0] = kind;
+	if (zlen != 0) {
+		memmove(key + 1, zone, zlen);
+	}
+	key[zlen + 1] = '\0';
+	memmove(key + zlen + 2, name, nlen);
+
+	return ((uint32_t)(zlen + nlen + 2));
+}
+
+static void
+cache_freeentry(isc_mem_t *mctx, sdlz_cacheentry_t **entryp) {
+	sdlz_cacheentry_t *entry = *entryp;
+	sdlz_cacherr_t *rr = NULL;
+
+	*entryp = NULL;
+
+	while ((rr = ISC_LIST_HEAD(entry->rrs)) != NULL) {
+		ISC_LIST_UNLINK(entry->rrs, rr, link);
+		isc_mem_put(mctx, rr, rr->size);
+	}
+	isc_mem_put(mctx, entry, sizeof(*entry));
+}
+
+static void
+cache_addrr(isc_mem_t *mctx, sdlz_cacheentry_t *entry, const char *type,
+	    dns_ttl_t ttl, const char *data) {
+	sdlz_cacherr_t *rr = NULL;
+	size_t tlen = strlen(type) + 1;
+	size_t dlen = strlen(data) + 1;
+	size_t size = sizeof(*rr) + tlen + dlen;
+
+	rr = isc_mem_get(mctx, size);
+	*rr = (sdlz_cacherr_t){ .size = size, .ttl = ttl };
+	rr->type = (char *)(rr + 1);
+	memmove(rr->type, type, tlen);
+	rr->data = rr->type + tlen;
+	memmove(rr->data, data, dlen);
+	ISC_LINK_INIT(rr, link);
+	ISC_LIST_APPEND(entry->rrs, rr, link);
+
+	entry->ttl = ISC_MIN(entry->ttl, ttl);
+}
+
+/*
+ * Requires the cache write lock.  Remove the expired entries, or all
+ * of them if 'all' is true.
+ */
+static void
+cache_purge(sdlz_instance_t *inst, isc_stdtime_t now, bool all) {
+	isc_ht_iter_t *it = NULL;
+	isc_result_t result;
+
+	isc_ht_iter_create(inst->cache, &it);
+	result = isc_ht_iter_first(it);
+	while (result == ISC_R_SUCCESS) {
+		sdlz_cacheentry_t *entry = NULL;
+
+		isc_ht_iter_current(it, (void **)&entry);
+		if (all || entry->expire <= now) {
+			cache_freeentry(inst->mctx, &entry);
+			result = isc_ht_iter_delcurrent_next(it);
+		} else {
+			result = isc_ht_iter_next(it);
+		}
+	}
+	isc_ht_iter_destroy(&it);
+}
+
+/*
+ * Look for an unexpired answer for 'key'.  On a hit, replay its records
+ * into 'lookup' (if not NULL), store the driver's result in '*resultp'
+ * and return true.  On a miss, '*entryp' is set to a new entry for the
+ * caller to fill in and pass to cache_add(), or to NULL if caching is
+ * disabled.
+ */
+static bool
+cache_find(sdlz_instance_t *inst, const unsigned char *key, uint32_t keylen,
+	   dns_sdlzlookup_t *lookup, isc_result_t *resultp,
+	   sdlz_cacheentry_t **entryp) {
+	sdlz_cacheentry_t *entry = NULL;
+	sdlz_cacherr_t *rr = NULL;
+	isc_result_t result;
+	isc_stdtime_t now;
+	bool enabled;
+
+	isc_stdtime_get(&now);
+
+	RWLOCK(&inst->cachelock, isc_rwlocktype_read);
+	enabled = (inst->cache != NULL);
+	if (enabled &&
+	    isc_ht_find(inst->cache, key, keylen, (void **)&entry) ==
+		    ISC_R_SUCCESS &&
+	    entry->expire > now)
+	{
+		result = entry->result;
+		for (rr = ISC_LIST_HEAD(entry->rrs);
+		     rr != NULL && lookup != NULL && result == ISC_R_SUCCESS;
+		     rr = ISC_LIST_NEXT(rr, link))
+		{
+			result = dns_sdlz_putrr(lookup, rr->type, rr->ttl,
+						rr->data);
+		}
+		RWUNLOCK(&inst->cachelock, isc_rwlocktype_read);
+		*resultp = result;
+		return (true);
+	}
+	RWUNLOCK(&inst->cachelock, isc_rwlocktype_read);
+
+	if (enabled) {
+		entry = isc_mem_get(inst->mctx, sizeof(*entry));
+		*entry = (sdlz_cacheentry_t){ .ttl = UINT32_MAX };
+		ISC_LIST_INIT(entry->rrs);
+		*entryp = entry;
+	}
+	return (false);
+}
+
+/*
+ * Cache the answer in '*entryp' for 'key', unless the driver failed.
+ */
+static void
+cache_add(sdlz_instance_t *inst, const unsigned char *key, uint32_t keylen,
+	  sdlz_cacheentry_t **entryp, isc_result_t result) {
+	sdlz_cacheentry_t *entry = *entryp;
+	sdlz_cacheentry_t *old = NULL;
+	isc_stdtime_t now;
+
+	*entryp = NULL;
+
+	/* Errors are not cached, the backend may recover at any time. */
+	if (result != ISC_R_SUCCESS && result != ISC_R_NOTFOUND) {
+		cache_freeentry(inst->mctx, &entry);
+		return;
+	}
+
+	isc_stdtime_get(&now);
+	entry->result = result;
+
+	RWLOCK(&inst->cachelock, isc_rwlocktype_write);
+	if (inst->cache != NULL) {
+		entry->expire = now + ISC_MIN(inst->cachettl, entry->ttl);
+		if (isc_ht_find(inst->cache, key, keylen, (void **)&old) ==
+		    ISC_R_SUCCESS)
+		{
+			(void)isc_ht_delete(inst->cache, key, keylen);
+			cache_freeentry(inst->mctx, &old);
+		}
+		if (isc_ht_count(inst->cache) >= SDLZ_CACHE_MAXENTRIES) {
+			cache_purge(inst, now, false);
+		}
+		if (isc_ht_count(inst->cache) < SDLZ_CACHE_MAXENTRIES) {
+			result = isc_ht_add(inst->cache, key, keylen, entry);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			entry = NULL;
+		}
+	}
+	RWUNLOCK(&inst->cachelock, isc_rwlocktype_write);
+
+	if (entry != NULL) {
+		cache_freeentry(inst->mctx, &entry);
+	}
+}
+
+static bool
+cache_has(sdlz_instance_t *inst, const unsigned char *key, uint32_t keylen) {
+	sdlz_cacheentry_t *entry = NULL;
+	isc_stdtime_t now;
+	bool found;
+
+	isc_stdtime_get(&now);
+
+	RWLOCK(&inst->cachelock, isc_rwlocktype_read);
+	found = (inst->cache != NULL &&
+		 isc_ht_find(inst->cache, key, keylen, (void **)&entry) ==
+			 ISC_R_SUCCESS &&
+		 entry->expire > now);
+	RWUNLOCK(&inst->cachelock, isc_rwlocktype_read);
+
+	return (found);
+}
+
+static bool
+cache_enabled(sdlz_instance_t *inst) {
+	bool enabled;
+
+	RWLOCK(&inst->cachelock, isc_rwlocktype_read);
+	enabled = (inst->cache != NULL);
+	RWUNLOCK(&inst->cachelock, isc_rwlocktype_read);
+
+	return (enabled);
+}
+
+static void
+cache_flush(sdlz_instance_t *inst) {
+	RWLOCK(&inst->cachelock, isc_rwlocktype_write);
+	if (inst->cache != NULL) {
+		cache_purge(inst, 0, true);
+	}
+	RWUNLOCK(&inst->cachelock, isc_rwlocktype_write);
+}
+
 /*
  * Rdataset Iterator Methods. These methods were "borrowed" from the SDB
  * driver interface.  See the SDB driver interface documentation for more info.
@@ -446,6 +717,9 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
 		sdlz_log(ISC_LOG_ERROR, "sdlz closeversion on origin %s failed",
 			 origin);
 	}
+	if (commit) {
+		cache_flush(sdlz->inst);
+	}
 
 	sdlz->future_version = NULL;
 }
@@ -463,6 +737,7 @@ createnode(dns_sdlz_db_t *sdlz, dns_sdlznode_t **nodep) {
 	ISC_LINK_INIT(node, link);
 	node->name = NULL;
 	dns_rdatacallbacks_init(&node->callbacks);
+	node->capture = NULL;
 
 	isc_refcount_init(&node->references, 1);
 	node->magic = SDLZLOOKUP_MAGIC;
@@ -513,28 +788,19 @@ destroynode(dns_sdlznode_t *node) {
 	detach(&db);
 }
 
+/*
+ * Convert 'name', relative to the origin if the driver wants it so,
+ * and the origin to lowercase text for the driver.  Both buffers must
+ * hold DNS_NAME_MAXTEXT + 1 bytes.
+ */
 static isc_result_t
-getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
-	    unsigned int options, dns_clientinfomethods_t *methods,
-	    dns_clientinfo_t *clientinfo, dns_dbnode_t **nodep) {
-	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)db;
-	dns_sdlznode_t *node = NULL;
+sdlz_nametotext(dns_sdlz_db_t *sdlz, const dns_name_t *name, char *namestr,
+		char *zonestr) {
 	isc_result_t result;
 	isc_buffer_t b;
-	char namestr[DNS_NAME_MAXTEXT + 1];
 	isc_buffer_t b2;
-	char zonestr[DNS_NAME_MAXTEXT + 1];
-	bool isorigin;
-	dns_sdlzauthorityfunc_t authority;
-
-	REQUIRE(VALID_SDLZDB(sdlz));
-	REQUIRE(nodep != NULL && *nodep == NULL);
-
-	if (sdlz->dlzimp->methods->newversion == NULL) {
-		REQUIRE(!create);
-	}
 
-	isc_buffer_init(&b, namestr, sizeof(namestr));
+	isc_buffer_init(&b, namestr, DNS_NAME_MAXTEXT + 1);
 	if ((sdlz->dlzimp->flags & DNS_SDLZFLAG_RELATIVEOWNER) != 0) {
 		dns_name_t relname;
 		unsigned int labels;
@@ -555,13 +821,81 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 	}
 	isc_buffer_putuint8(&b, 0);
 
-	isc_buffer_init(&b2, zonestr, sizeof(zonestr));
+	isc_buffer_init(&b2, zonestr, DNS_NAME_MAXTEXT + 1);
 	result = dns_name_totext(&sdlz->common.origin, true, &b2);
 	if (result != ISC_R_SUCCESS) {
 		return (result);
 	}
 	isc_buffer_putuint8(&b2, 0);
 
+	/* make sure strings are always lowercase */
+	dns_sdlz_tolower(zonestr);
+	dns_sdlz_tolower(namestr);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Call the driver's lookup method for 'name' in 'zone', or replay the
+ * records of a cached answer into 'node'.  Changes not yet committed
+ * are never cached.
+ */
+static isc_result_t
+sdlz_lookup(dns_sdlz_db_t *sdlz, const char *zone, const char *name,
+	    dns_sdlznode_t *node, dns_clientinfomethods_t *methods,
+	    dns_clientinfo_t *clientinfo) {
+	unsigned char key[SDLZ_CACHE_KEYSIZE];
+	uint32_t keylen;
+	sdlz_cacheentry_t *entry = NULL;
+	isc_result_t result;
+
+	keylen = cache_key(key, 'L', zone, name);
+	if (sdlz->future_version == NULL &&
+	    cache_find(sdlz->inst, key, keylen, node, &result, &entry))
+	{
+		return (result);
+	}
+
+	node->capture = entry;
+	MAYBE_LOCK(sdlz->dlzimp);
+	result = sdlz->dlzimp->methods->lookup(zone, name,
+					       sdlz->dlzimp->driverarg,
+					       sdlz->dbdata, node, methods,
+					       clientinfo);
+	MAYBE_UNLOCK(sdlz->dlzimp);
+	node->capture = NULL;
+
+	if (entry != NULL) {
+		cache_add(sdlz->inst, key, keylen, &entry, result);
+	}
+	return (result);
+}
+
+static isc_result_t
+getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
+	    unsigned int options, dns_clientinfomethods_t *methods,
+	    dns_clientinfo_t *clientinfo, dns_dbnode_t **nodep) {
+	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)db;
+	dns_sdlznode_t *node = NULL;
+	isc_result_t result;
+	isc_buffer_t b;
+	char namestr[DNS_NAME_MAXTEXT + 1];
+	char zonestr[DNS_NAME_MAXTEXT + 1];
+	bool isorigin;
+	dns_sdlzauthorityfunc_t authority;
+
+	REQUIRE(VALID_SDLZDB(sdlz));
+	REQUIRE(nodep != NULL && *nodep == NULL);
+
+	if (sdlz->dlzimp->methods->newversion == NULL) {
+		REQUIRE(!create);
+	}
+
+	result = sdlz_nametotext(sdlz, name, namestr, zonestr);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
 	result = createnode(sdlz, &node);
 	if (result != ISC_R_SUCCESS) {
 		return (result);
@@ -569,16 +903,9 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 
 	isorigin = dns_name_equal(name, &sdlz->common.origin);
 
-	/* make sure strings are always lowercase */
-	dns_sdlz_tolower(zonestr);
-	dns_sdlz_tolower(namestr);
-
-	MAYBE_LOCK(sdlz->dlzimp);
-
 	/* try to lookup the host (namestr) */
-	result = sdlz->dlzimp->methods->lookup(
-		zonestr, namestr, sdlz->dlzimp->driverarg, sdlz->dbdata, node,
-		methods, clientinfo);
+	result = sdlz_lookup(sdlz, zonestr, namestr, node, methods,
+			     clientinfo);
 
 	/*
 	 * If the name was not found and DNS_DBFIND_NOWILD is not
@@ -611,7 +938,6 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 				result = dns_name_concatenate(
 					dns_wildcardname, fname, fname, NULL);
 				if (result != ISC_R_SUCCESS) {
-					MAYBE_UNLOCK(sdlz->dlzimp);
 					return (result);
 				}
 				wild = fname;
@@ -620,22 +946,18 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 			isc_buffer_init(&b, wildstr, sizeof(wildstr));
 			result = dns_name_totext(wild, true, &b);
 			if (result != ISC_R_SUCCESS) {
-				MAYBE_UNLOCK(sdlz->dlzimp);
 				return (result);
 			}
 			isc_buffer_putuint8(&b, 0);
 
-			result = sdlz->dlzimp->methods->lookup(
-				zonestr, wildstr, sdlz->dlzimp->driverarg,
-				sdlz->dbdata, node, methods, clientinfo);
+			result = sdlz_lookup(sdlz, zonestr, wildstr, node,
+					     methods, clientinfo);
 			if (result == ISC_R_SUCCESS) {
 				break;
 			}
 		}
 	}
 
-	MAYBE_UNLOCK(sdlz->dlzimp);
-
 	if (result == ISC_R_NOTFOUND && (isorigin || create)) {
 		result = ISC_R_SUCCESS;
 	}
@@ -1490,7 +1812,8 @@ dns_sdlzcreateDBP(isc_mem_t *mctx, void *driverarg, void *dbdata,
 	sdlzdb->common.attributes = 0;
 	sdlzdb->common.rdclass = rdclass;
 	sdlzdb->common.mctx = NULL;
-	sdlzdb->dbdata = dbdata;
+	sdlzdb->inst = dbdata;
+	sdlzdb->dbdata = sdlzdb->inst->dbdata;
 	isc_refcount_init(&sdlzdb->references, 1);
 
 	/* attach to the memory context */
@@ -1520,6 +1843,7 @@ dns_sdlzallowzonexfr(void *driverarg, void *dbdata, isc_mem_t *mctx,
 	isc_netaddr_t netaddr;
 	isc_result_t result;
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst = dbdata;
 
 	/*
 	 * Perform checks to make sure data is as we expect it to be.
@@ -1557,8 +1881,8 @@ dns_sdlzallowzonexfr(void *driverarg, void *dbdata, isc_mem_t *mctx,
 		isc_result_t rresult = ISC_R_SUCCESS;
 
 		MAYBE_LOCK(imp);
-		result = imp->methods->allowzonexfr(imp->driverarg, dbdata,
-						    namestr, clientstr);
+		result = imp->methods->allowzonexfr(
+			imp->driverarg, inst->dbdata, namestr, clientstr);
 		MAYBE_UNLOCK(imp);
 		/*
 		 * if zone is supported and transfers are (or might be)
@@ -1581,6 +1905,7 @@ static isc_result_t
 dns_sdlzcreate(isc_mem_t *mctx, const char *dlzname, unsigned int argc,
 	       char *argv[], void *driverarg, void **dbdata) {
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst = NULL;
 	isc_result_t result = ISC_R_NOTFOUND;
 
 	/* Write debugging message to log */
@@ -1592,23 +1917,30 @@ dns_sdlzcreate(isc_mem_t *mctx, const char *dlzname, unsigned int argc,
 	REQUIRE(driverarg != NULL);
 	REQUIRE(dlzname != NULL);
 	REQUIRE(dbdata != NULL);
-	UNUSED(mctx);
 
 	imp = driverarg;
 
+	inst = isc_mem_get(mctx, sizeof(*inst));
+	*inst = (sdlz_instance_t){ .mctx = NULL };
+	isc_rwlock_init(&inst->cachelock, 0, 0);
+	isc_mem_attach(mctx, &inst->mctx);
+
 	/* If the create method exists, call it. */
 	if (imp->methods->create != NULL) {
 		MAYBE_LOCK(imp);
 		result = imp->methods->create(dlzname, argc, argv,
-					      imp->driverarg, dbdata);
+					      imp->driverarg, &inst->dbdata);
 		MAYBE_UNLOCK(imp);
 	}
 
 	/* Write debugging message to log */
 	if (result == ISC_R_SUCCESS) {
 		sdlz_log(ISC_LOG_DEBUG(2), "SDLZ driver loaded successfully.");
+		*dbdata = inst;
 	} else {
 		sdlz_log(ISC_LOG_ERROR, "SDLZ driver failed to load.");
+		isc_rwlock_destroy(&inst->cachelock);
+		isc_mem_putanddetach(&inst->mctx, inst, sizeof(*inst));
 	}
 
 	return (result);
@@ -1617,6 +1949,7 @@ dns_sdlzcreate(isc_mem_t *mctx, const char *dlzname, unsigned int argc,
 static void
 dns_sdlzdestroy(void *driverdata, void **dbdata) {
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst = (sdlz_instance_t *)dbdata;
 
 	/* Write debugging message to log */
 	sdlz_log(ISC_LOG_DEBUG(2), "Unloading SDLZ driver.");
@@ -1626,9 +1959,16 @@ dns_sdlzdestroy(void *driverdata, void **dbdata) {
 	/* If the destroy method exists, call it. */
 	if (imp->methods->destroy != NULL) {
 		MAYBE_LOCK(imp);
-		imp->methods->destroy(imp->driverarg, dbdata);
+		imp->methods->destroy(imp->driverarg, inst->dbdata);
 		MAYBE_UNLOCK(imp);
 	}
+
+	if (inst->cache != NULL) {
+		cache_purge(inst, 0, true);
+		isc_ht_destroy(&inst->cache);
+	}
+	isc_rwlock_destroy(&inst->cachelock);
+	isc_mem_putanddetach(&inst->mctx, inst, sizeof(*inst));
 }
 
 static isc_result_t
@@ -1638,8 +1978,12 @@ dns_sdlzfindzone(void *driverarg, void *dbdata, isc_mem_t *mctx,
 		 dns_db_t **dbp) {
 	isc_buffer_t b;
 	char namestr[DNS_NAME_MAXTEXT + 1];
+	unsigned char key[SDLZ_CACHE_KEYSIZE];
+	uint32_t keylen;
+	sdlz_cacheentry_t *entry = NULL;
 	isc_result_t result;
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst = dbdata;
 
 	/*
 	 * Perform checks to make sure data is as we expect it to be.
@@ -1661,11 +2005,20 @@ dns_sdlzfindzone(void *driverarg, void *dbdata, isc_mem_t *mctx,
 	/* make sure strings are always lowercase */
 	dns_sdlz_tolower(namestr);
 
-	/* Call SDLZ driver's find zone method */
-	MAYBE_LOCK(imp);
-	result = imp->methods->findzone(imp->driverarg, dbdata, namestr,
-					methods, clientinfo);
-	MAYBE_UNLOCK(imp);
+	/*
+	 * Call SDLZ driver's find zone method, unless the answer is
+	 * cached; this is called for every label of every query name.
+	 */
+	keylen = cache_key(key, 'Z', NULL, namestr);
+	if (!cache_find(inst, key, keylen, NULL, &result, &entry)) {
+		MAYBE_LOCK(imp);
+		result = imp->methods->findzone(imp->driverarg, inst->dbdata,
+						namestr, methods, clientinfo);
+		MAYBE_UNLOCK(imp);
+		if (entry != NULL) {
+			cache_add(inst, key, keylen, &entry, result);
+		}
+	}
 
 	/*
 	 * if zone is supported build a 'bind' database driver
@@ -1684,6 +2037,7 @@ dns_sdlzconfigure(void *driverarg, void *dbdata, dns_view_t *view,
 		  dns_dlzdb_t *dlzdb) {
 	isc_result_t result;
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst = dbdata;
 
 	REQUIRE(driverarg != NULL);
 
@@ -1693,7 +2047,7 @@ dns_sdlzconfigure(void *driverarg, void *dbdata, dns_view_t *view,
 	if (imp->methods->configure != NULL) {
 		MAYBE_LOCK(imp);
 		result = imp->methods->configure(view, dlzdb, imp->driverarg,
-						 dbdata);
+						 inst->dbdata);
 		MAYBE_UNLOCK(imp);
 	} else {
 		result = ISC_R_SUCCESS;
@@ -1707,6 +2061,7 @@ dns_sdlzssumatch(const dns_name_t *signer, const dns_name_t *name,
 		 const isc_netaddr_t *tcpaddr, dns_rdatatype_t type,
 		 const dst_key_t *key, void *driverarg, void *dbdata) {
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst = dbdata;
 	char b_signer[DNS_NAME_FORMATSIZE];
 	char b_name[DNS_NAME_FORMATSIZE];
 	char b_addr[ISC_NETADDR_FORMATSIZE];
@@ -1760,14 +2115,41 @@ dns_sdlzssumatch(const dns_name_t *signer, const dns_name_t *name,
 	ret = imp->methods->ssumatch(b_signer, b_name, b_addr, b_type, b_key,
 				     token_len,
 				     token_len != 0 ? token_region.base : NULL,
-				     imp->driverarg, dbdata);
+				     imp->driverarg, inst->dbdata);
 	MAYBE_UNLOCK(imp);
 	return (ret);
 }
 
-static dns_dlzmethods_t sdlzmethods = { dns_sdlzcreate,	   dns_sdlzdestroy,
-					dns_sdlzfindzone,  dns_sdlzallowzonexfr,
-					dns_sdlzconfigure, dns_sdlzssumatch };
+static void
+dns_sdlzsetcachettl(void *driverarg, void *dbdata, dns_ttl_t ttl) {
+	sdlz_instance_t *inst = dbdata;
+
+	UNUSED(driverarg);
+
+	RWLOCK(&inst->cachelock, isc_rwlocktype_write);
+	inst->cachettl = ttl;
+	if (ttl == 0 && inst->cache != NULL) {
+		cache_purge(inst, 0, true);
+		isc_ht_destroy(&inst->cache);
+	} else if (ttl != 0 && inst->cache == NULL) {
+		isc_ht_init(&inst->cache, inst->mctx, 10,
+			    ISC_HT_CASE_SENSITIVE);
+	}
+	RWUNLOCK(&inst->cachelock, isc_rwlocktype_write);
+}
+
+static void
+dns_sdlzflushcache(void *driverarg, void *dbdata) {
+	UNUSED(driverarg);
+
+	cache_flush(dbdata);
+}
+
+static dns_dlzmethods_t sdlzmethods = {
+	dns_sdlzcreate,	     dns_sdlzdestroy,	  dns_sdlzfindzone,
+	dns_sdlzallowzonexfr, dns_sdlzconfigure,   dns_sdlzssumatch,
+	dns_sdlzsetcachettl, dns_sdlzflushcache
+};
 
 /*
  * Public functions.
@@ -1878,6 +2260,11 @@ dns_sdlz_putrr(dns_sdlzlookup_t *lookup, const char *type, dns_ttl_t ttl,
 	ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
 	ISC_LIST_APPEND(lookup->buffers, rdatabuf, link);
 
+	if (lookup->capture != NULL) {
+		cache_addrr(lookup->sdlz->inst->mctx, lookup->capture, type,
+			    ttl, data);
+	}
+
 	if (lex != NULL) {
 		isc_lex_destroy(&lex);
 	}
@@ -2084,3 +2471,139 @@ dns_sdlz_setdb(dns_dlzdb_t *dlzdatabase, dns_rdataclass_t rdclass,
 				   dlzdatabase->dbdata, name, rdclass, dbp);
 	return (result);
 }
+
+/*
+ * An asynchronous lookup in progress.
+ */
+typedef struct sdlz_async {
+	isc_mem_t *mctx;
+	sdlz_instance_t *inst;
+	dns_sdlznode_t *node;
+	sdlz_cacheentry_t *entry;
+	unsigned char key[SDLZ_CACHE_KEYSIZE];
+	uint32_t keylen;
+	dns_sdlzlookupdone_t done;
+	void *arg;
+} sdlz_async_t;
+
+static void
+sdlz_async_free(sdlz_async_t **asyncp) {
+	sdlz_async_t *async = *asyncp;
+
+	*asyncp = NULL;
+
+	if (async->entry != NULL) {
+		cache_freeentry(async->inst->mctx, &async->entry);
+	}
+	async->node->capture = NULL;
+	isc_refcount_decrementz(&async->node->references);
+	destroynode(async->node);
+	isc_mem_putanddetach(&async->mctx, async, sizeof(*async));
+}
+
+static void
+sdlz_lookupasync_done(void *arg, isc_result_t result) {
+	sdlz_async_t *async = arg;
+	dns_sdlzlookupdone_t done = async->done;
+	void *donearg = async->arg;
+
+	async->node->capture = NULL;
+	cache_add(async->inst, async->key, async->keylen, &async->entry,
+		  result);
+	sdlz_async_free(&async);
+
+	done(donearg, result);
+}
+
+bool
+dns_sdlz_canlookupasync(dns_db_t *db, const dns_name_t *name) {
+	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)db;
+	char namestr[DNS_NAME_MAXTEXT + 1];
+	char zonestr[DNS_NAME_MAXTEXT + 1];
+	unsigned char key[SDLZ_CACHE_KEYSIZE];
+	uint32_t keylen;
+
+	if (!VALID_SDLZDB(sdlz) || sdlz->dlzimp->methods->lookupasync == NULL ||
+	    atomic_load_relaxed(&sdlz->inst->noasync) ||
+	    sdlz->future_version != NULL || !cache_enabled(sdlz->inst))
+	{
+		return (false);
+	}
+
+	if (sdlz_nametotext(sdlz, name, namestr, zonestr) != ISC_R_SUCCESS) {
+		return (false);
+	}
+	keylen = cache_key(key, 'L', zonestr, namestr);
+
+	return (!cache_has(sdlz->inst, key, keylen));
+}
+
+isc_result_t
+dns_sdlz_lookupasync(dns_db_t *db, const dns_name_t *name,
+		     dns_clientinfomethods_t *methods,
+		     dns_clientinfo_t *clientinfo, dns_sdlzlookupdone_t done,
+		     void *arg) {
+	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)db;
+	char namestr[DNS_NAME_MAXTEXT + 1];
+	char zonestr[DNS_NAME_MAXTEXT + 1];
+	sdlz_async_t *async = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_SDLZDB(sdlz));
+	REQUIRE(dns_name_issubdomain(name, &sdlz->common.origin));
+	REQUIRE(done != NULL);
+
+	if (sdlz->dlzimp->methods->lookupasync == NULL) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	result = sdlz_nametotext(sdlz, name, namestr, zonestr);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	async = isc_mem_get(sdlz->common.mctx, sizeof(*async));
+	*async = (sdlz_async_t){
+		.inst = sdlz->inst,
+		.done = done,
+		.arg = arg,
+	};
+	isc_mem_attach(sdlz->common.mctx, &async->mctx);
+	async->keylen = cache_key(async->key, 'L', zonestr, namestr);
+
+	/* Without a cache, the answer would be thrown away. */
+	if (cache_find(async->inst, async->key, async->keylen, NULL, &result,
+		       &async->entry))
+	{
+		result = ISC_R_EXISTS;
+	} else if (async->entry == NULL) {
+		result = ISC_R_DISABLED;
+	}
+	if (result == ISC_R_EXISTS || result == ISC_R_DISABLED) {
+		isc_mem_putanddetach(&async->mctx, async, sizeof(*async));
+		return (result);
+	}
+
+	result = createnode(sdlz, &async->node);
+	if (result != ISC_R_SUCCESS) {
+		cache_freeentry(async->inst->mctx, &async->entry);
+		isc_mem_putanddetach(&async->mctx, async, sizeof(*async));
+		return (result);
+	}
+	async->node->capture = async->entry;
+
+	MAYBE_LOCK(sdlz->dlzimp);
+	result = sdlz->dlzimp->methods->lookupasync(
+		zonestr, namestr, sdlz->dlzimp->driverarg, sdlz->dbdata,
+		async->node, methods, clientinfo, sdlz_lookupasync_done, async);
+	MAYBE_UNLOCK(sdlz->dlzimp);
+
+	if (result != ISC_R_SUCCESS) {
+		if (result == ISC_R_NOTIMPLEMENTED) {
+			atomic_store_relaxed(&sdlz->inst->noasync, true);
+		}
+		sdlz_async_free(&async);
+	}
+
+	return (result);
+}
@@ -0,0 +1,1090 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/refcount.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#include <dns/cache.h>
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/masterdump.h>
+#include <dns/name.h>
+#include <dns/rbt.h>
+#include <dns/stats.h>
+
+#include "rbtdb.h"
+#include "sharddb.h"
+
+#define SHARDDB_MAGIC	     ISC_MAGIC('S', 'h', 'D', 'B')
+#define VALID_SHARDDB(sdb)   ((sdb) != NULL && (sdb)->common.impmagic == SHARDDB_MAGIC)
+
+/*%
+ * A name is placed by a hash of its last KEY_LABELS labels, counting
+ * the root label.
+ */
+#define KEY_LABELS 3
+
+typedef struct {
+	/* Unlocked. */
+	dns_db_t common;
+	isc_refcount_t references;
+	dns_stats_t *rrsetstats;
+	unsigned int nshards;
+	dns_db_t **shards;
+} dns_sharddb_t;
+
+typedef struct {
+	dns_dbiterator_t *iterator;
+	isc_result_t result; /*%< of the last move of 'iterator' */
+	dns_fixedname_t fname;
+	dns_name_t *name; /*%< where 'iterator' is, if 'result' is success */
+} sharddb_part_t;
+
+/*%
+ * The iterator keeps one iterator per shard, each of them paused on the
+ * first name it has that has not been returned yet.  The cursor is on
+ * the part with the smallest of those names (the lowest numbered one,
+ * if several shards have this name).
+ */
+typedef struct {
+	dns_dbiterator_t common;
+	unsigned int nparts;
+	sharddb_part_t *parts;
+	sharddb_part_t *current;
+} sharddb_dbiterator_t;
+
+static dns_dbmethods_t sharddb_methods;
+
+static void
+dbiterator_destroy(dns_dbiterator_t **iteratorp);
+static isc_result_t
+dbiterator_first(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_last(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_seek(dns_dbiterator_t *iterator, const dns_name_t *name);
+static isc_result_t
+dbiterator_prev(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_next(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_current(dns_dbiterator_t *iterator, dns_dbnode_t **nodep,
+		   dns_name_t *name);
+static isc_result_t
+dbiterator_pause(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name);
+
+static dns_dbiteratormethods_t dbiterator_methods = {
+	dbiterator_destroy, dbiterator_first, dbiterator_last,
+	dbiterator_seek,    dbiterator_prev,  dbiterator_next,
+	dbiterator_current, dbiterator_pause, dbiterator_origin
+};
+
+/*%
+ * Return the shard that the suffix of 'name' made of its last 'labels'
+ * labels is placed in.
+ */
+static unsigned int
+suffix_shard(dns_sharddb_t *sdb, const dns_name_t *name,
+	     unsigned int labels) {
+	dns_name_t suffix;
+	unsigned int count = dns_name_countlabels(name);
+
+	INSIST(labels <= count);
+
+	dns_name_init(&suffix, NULL);
+	dns_name_getlabelsequence(name, count - labels, labels, &suffix);
+	return (dns_name_fullhash(&suffix, false) % sdb->nshards);
+}
+
+static unsigned int
+key_labels(const dns_name_t *name) {
+	return (ISC_MIN(dns_name_countlabels(name), KEY_LABELS));
+}
+
+static dns_db_t *
+name_shard(dns_sharddb_t *sdb, const dns_name_t *name) {
+	return (sdb->shards[suffix_shard(sdb, name, key_labels(name))]);
+}
+
+static dns_db_t *
+node_shard(dns_sharddb_t *sdb, dns_dbnode_t *node) {
+	unsigned int shard = ((dns_rbtnode_t *)node)->shard;
+
+	INSIST(shard < sdb->nshards);
+	return (sdb->shards[shard]);
+}
+
+/*%
+ * The shard of a name holds all of its ancestors that have at least
+ * as many labels as its key.  Return in 'shards' the shards to search,
+ * in order, for a delegation above it: its own shard, then those of
+ * its shorter ancestors that are in other shards.
+ */
+static unsigned int
+search_shards(dns_sharddb_t *sdb, const dns_name_t *name,
+	      unsigned int shards[KEY_LABELS]) {
+	unsigned int count = 0;
+
+	for (unsigned int labels = key_labels(name); labels > 0; labels--) {
+		unsigned int shard = suffix_shard(sdb, name, labels);
+		bool seen = false;
+
+		for (unsigned int i = 0; i < count; i++) {
+			if (shards[i] == shard) {
+				seen = true;
+				break;
+			}
+		}
+		if (!seen) {
+			shards[count++] = shard;
+		}
+	}
+
+	return (count);
+}
+
+static void
+free_sharddb(dns_sharddb_t *sdb) {
+	for (unsigned int i = 0; i < sdb->nshards; i++) {
+		if (sdb->shards[i] != NULL) {
+			dns_db_detach(&sdb->shards[i]);
+		}
+	}
+	isc_mem_put(sdb->common.mctx, sdb->shards,
+		    sdb->nshards * sizeof(sdb->shards[0]));
+	if (sdb->rrsetstats != NULL) {
+		dns_stats_detach(&sdb->rrsetstats);
+	}
+	isc_refcount_destroy(&sdb->references);
+	sdb->common.magic = 0;
+	sdb->common.impmagic = 0;
+	dns_name_free(&sdb->common.origin, sdb->common.mctx);
+	isc_mem_putanddetach(&sdb->common.mctx, sdb, sizeof(*sdb));
+}
+
+static void
+attach(dns_db_t *source, dns_db_t **targetp) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)source;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	isc_refcount_increment(&sdb->references);
+
+	*targetp = source;
+}
+
+static void
+detach(dns_db_t **dbp) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)(*dbp);
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	*dbp = NULL;
+
+	if (isc_refcount_decrement(&sdb->references) == 1) {
+		free_sharddb(sdb);
+	}
+}
+
+static isc_result_t
+beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	UNUSED(db);
+	UNUSED(callbacks);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+static isc_result_t
+endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	UNUSED(db);
+	UNUSED(callbacks);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+static isc_result_t
+dump(dns_db_t *db, dns_dbversion_t *version, const char *filename,
+     dns_masterformat_t masterformat) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	return (dns_master_dump(sdb->common.mctx, db, version,
+				&dns_master_style_default, filename,
+				masterformat, NULL));
+}
+
+/*
+ * A cache has no versions; dns_db_currentversion() still has to return
+ * one, which is borrowed from the first shard.  The shards are never
+ * passed a version.
+ */
+static void
+currentversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	dns_db_currentversion(sdb->shards[0], versionp);
+}
+
+static isc_result_t
+newversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	UNUSED(db);
+	UNUSED(versionp);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+static void
+attachversion(dns_db_t *db, dns_dbversion_t *source,
+	      dns_dbversion_t **targetp) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	dns_db_attachversion(sdb->shards[0], source, targetp);
+}
+
+static void
+closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	dns_db_closeversion(sdb->shards[0], versionp, commit);
+}
+
+static isc_result_t
+findnodeext(dns_db_t *db, const dns_name_t *name, bool create,
+	    dns_clientinfomethods_t *methods, dns_clientinfo_t *clientinfo,
+	    dns_dbnode_t **nodep) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	return (dns_db_findnodeext(name_shard(sdb, name), name, create,
+				   methods, clientinfo, nodep));
+}
+
+static isc_result_t
+findext(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
+	dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
+	dns_dbnode_t **nodep, dns_name_t *foundname,
+	dns_clientinfomethods_t *methods, dns_clientinfo_t *clientinfo,
+	dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+	unsigned int shards[KEY_LABELS], count;
+	isc_result_t result;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	UNUSED(version);
+
+	count = search_shards(sdb, name, shards);
+	result = dns_db_findext(sdb->shards[shards[0]], name, NULL, type,
+				options, now, nodep, foundname, methods,
+				clientinfo, rdataset, sigrdataset);
+
+	/*
+	 * The other shards cannot have 'name' itself, nor the NSEC
+	 * records next to it, but may have a delegation above it.
+	 */
+	options &= ~DNS_DBFIND_COVERINGNSEC;
+	for (unsigned int i = 1; i < count && result == ISC_R_NOTFOUND; i++) {
+		result = dns_db_findext(sdb->shards[shards[i]], name, NULL,
+					type, options, now, nodep, foundname,
+					methods, clientinfo, rdataset,
+					sigrdataset);
+	}
+
+	return (result);
+}
+
+static isc_result_t
+findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
+	    isc_stdtime_t now, dns_dbnode_t **nodep, dns_name_t *foundname,
+	    dns_name_t *dcname, dns_rdataset_t *rdataset,
+	    dns_rdataset_t *sigrdataset) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+	unsigned int shards[KEY_LABELS], count;
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	count = search_shards(sdb, name, shards);
+	for (unsigned int i = 0; i < count && result == ISC_R_NOTFOUND; i++) {
+		result = dns_db_findzonecut(sdb->shards[shards[i]], name,
+					    options, now, nodep, foundname,
+					    dcname, rdataset, sigrdataset);
+	}
+
+	return (result);
+}
+
+static void
+attachnode(dns_db_t *db, dns_dbnode_t *source, dns_dbnode_t **targetp) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	dns_db_attachnode(node_shard(sdb, source), source, targetp);
+}
+
+static void
+detachnode(dns_db_t *db, dns_dbnode_t **targetp) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	dns_db_detachnode(node_shard(sdb, *targetp), targetp);
+}
+
+static isc_result_t
+expirenode(dns_db_t *db, dns_dbnode_t *node, isc_stdtime_t now) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	return (dns_db_expirenode(node_shard(sdb, node), node, now));
+}
+
+static void
+printnode(dns_db_t *db, dns_dbnode_t *node, FILE *out) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	dns_db_printnode(node_shard(sdb, node), node, out);
+}
+
+static isc_result_t
+createiterator(dns_db_t *db, unsigned int options,
+	       dns_dbiterator_t **iteratorp) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+	sharddb_dbiterator_t *sdbiter;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	sdbiter = isc_mem_get(sdb->common.mctx, sizeof(*sdbiter));
+	*sdbiter = (sharddb_dbiterator_t){
+		.common.methods = &dbiterator_methods,
+		.common.magic = DNS_DBITERATOR_MAGIC,
+		.nparts = sdb->nshards,
+	};
+	dns_db_attach(db, &sdbiter->common.db);
+
+	sdbiter->parts = isc_mem_get(sdb->common.mctx,
+				     sdb->nshards * sizeof(sdbiter->parts[0]));
+	for (unsigned int i = 0; i < sdb->nshards; i++) {
+		sharddb_part_t *part = &sdbiter->parts[i];
+
+		part->iterator = NULL;
+		part->result = ISC_R_NOMORE;
+		part->name = dns_fixedname_initname(&part->fname);
+	}
+
+	/*
+	 * Names are compared across shards, so they are always absolute.
+	 */
+	options &= ~DNS_DB_RELATIVENAMES;
+	for (unsigned int i = 0; i < sdb->nshards; i++) {
+		result = dns_db_createiterator(sdb->shards[i], options,
+					       &sdbiter->parts[i].iterator);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+
+	if (result != ISC_R_SUCCESS) {
+		dns_dbiterator_t *iterator = (dns_dbiterator_t *)sdbiter;
+		dbiterator_destroy(&iterator);
+		return (result);
+	}
+
+	*iteratorp = (dns_dbiterator_t *)sdbiter;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	     dns_rdatatype_t type, dns_rdatatype_t covers, isc_stdtime_t now,
+	     dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	UNUSED(version);
+
+	return (dns_db_findrdataset(node_shard(sdb, node), node, NULL, type,
+				    covers, now, rdataset, sigrdataset));
+}
+
+static isc_result_t
+allrdatasets(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	     unsigned int options, isc_stdtime_t now,
+	     dns_rdatasetiter_t **iteratorp) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	UNUSED(version);
+
+	return (dns_db_allrdatasets(node_shard(sdb, node), node, NULL, options,
+				    now, iteratorp));
+}
+
+static isc_result_t
+addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	    isc_stdtime_t now, dns_rdataset_t *rdataset, unsigned int options,
+	    dns_rdataset_t *addedrdataset) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	UNUSED(version);
+
+	return (dns_db_addrdataset(node_shard(sdb, node), node, NULL, now,
+				   rdataset, options, addedrdataset));
+}
+
+static isc_result_t
+subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+		 dns_rdataset_t *rdataset, unsigned int options,
+		 dns_rdataset_t *newrdataset) {
+	UNUSED(db);
+	UNUSED(node);
+	UNUSED(version);
+	UNUSED(rdataset);
+	UNUSED(options);
+	UNUSED(newrdataset);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+static isc_result_t
+deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	       dns_rdatatype_t type, dns_rdatatype_t covers) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	UNUSED(version);
+
+	return (dns_db_deleterdataset(node_shard(sdb, node), node, NULL, type,
+				      covers));
+}
+
+static bool
+issecure(dns_db_t *db) {
+	UNUSED(db);
+
+	return (false);
+}
+
+static unsigned int
+nodecount(dns_db_t *db, dns_dbtree_t tree) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+	unsigned int count = 0;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	for (unsigned int i = 0; i < sdb->nshards; i++) {
+		count += dns_db_nodecount(sdb->shards[i], tree);
+	}
+
+	return (count);
+}
+
+static bool
+ispersistent(dns_db_t *db) {
+	UNUSED(db);
+
+	return (false);
+}
+
+static void
+overmem(dns_db_t *db, bool over) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	for (unsigned int i = 0; i < sdb->nshards; i++) {
+		dns_db_overmem(sdb->shards[i], over);
+	}
+}
+
+static void
+settask(dns_db_t *db, isc_task_t *task) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	for (unsigned int i = 0; i < sdb->nshards; i++) {
+		dns_db_settask(sdb->shards[i], task);
+	}
+}
+
+static isc_result_t
+getoriginnode(dns_db_t *db, dns_dbnode_t **nodep) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	return (dns_db_getoriginnode(name_shard(sdb, &sdb->common.origin),
+				     nodep));
+}
+
+static bool
+isdnssec(dns_db_t *db) {
+	UNUSED(db);
+
+	return (false);
+}
+
+static dns_stats_t *
+getrrsetstats(dns_db_t *db) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	return (sdb->rrsetstats);
+}
+
+static isc_result_t
+setcachestats(dns_db_t *db, isc_stats_t *stats) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	for (unsigned int i = 0; i < sdb->nshards && result == ISC_R_SUCCESS;
+	     i++)
+	{
+		result = dns_db_setcachestats(sdb->shards[i], stats);
+	}
+
+	return (result);
+}
+
+static size_t
+hashsize(dns_db_t *db) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+	size_t size = 0;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	for (unsigned int i = 0; i < sdb->nshards; i++) {
+		size += dns_db_hashsize(sdb->shards[i]);
+	}
+
+	return (size);
+}
+
+static isc_result_t
+nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	return (dns_db_nodefullname(node_shard(sdb, node), node, name));
+}
+
+static isc_result_t
+setservestalettl(dns_db_t *db, dns_ttl_t ttl) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	for (unsigned int i = 0; i < sdb->nshards && result == ISC_R_SUCCESS;
+	     i++)
+	{
+		result = dns_db_setservestalettl(sdb->shards[i], ttl);
+	}
+
+	return (result);
+}
+
+static isc_result_t
+getservestalettl(dns_db_t *db, dns_ttl_t *ttl) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	return (dns_db_getservestalettl(sdb->shards[0], ttl));
+}
+
+static isc_result_t
+setservestalerefresh(dns_db_t *db, uint32_t interval) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	for (unsigned int i = 0; i < sdb->nshards && result == ISC_R_SUCCESS;
+	     i++)
+	{
+		result = dns_db_setservestalerefresh(sdb->shards[i], interval);
+	}
+
+	return (result);
+}
+
+static isc_result_t
+getservestalerefresh(dns_db_t *db, uint32_t *interval) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	return (dns_db_getservestalerefresh(sdb->shards[0], interval));
+}
+
+static void
+findpopular(dns_db_t *db, isc_stdtime_t now, dns_ttl_t window,
+	    unsigned int minhits, dns_dbpopular_t *popular, unsigned int size,
+	    unsigned int *countp) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	for (unsigned int i = 0; i < sdb->nshards; i++) {
+		dns_db_findpopular(sdb->shards[i], now, window, minhits,
+				   popular, size, countp);
+	}
+}
+
+static void
+setdomainusage(dns_db_t *db, bool enable) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	for (unsigned int i = 0; i < sdb->nshards; i++) {
+		dns_db_setdomainusage(sdb->shards[i], enable);
+	}
+}
+
+/*
+ * The shard of a name is chosen by its last two labels, which is also
+ * the domain it is accounted to, so every domain is only counted in
+ * one shard.
+ */
+static void
+topdomains(dns_db_t *db, dns_dbdomainusage_t *top, unsigned int size,
+	   unsigned int *countp) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	for (unsigned int i = 0; i < sdb->nshards; i++) {
+		dns_db_topdomains(sdb->shards[i], top, size, countp);
+	}
+}
+
+/*
+ * The buckets of the shards are numbered one shard after the other, as
+ * in nodelockwaits().
+ */
+static isc_result_t
+cleanbucket(dns_db_t *db, unsigned int bucket, isc_stdtime_t now,
+	    unsigned int limit, unsigned int *countp) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	for (unsigned int i = 0; i < sdb->nshards; i++) {
+		unsigned int n = dns_db_nodelockwaits(sdb->shards[i], NULL, 0);
+
+		if (bucket < n) {
+			return (dns_db_cleanbucket(sdb->shards[i], bucket, now,
+						   limit, countp));
+		}
+		bucket -= n;
+	}
+
+	return (ISC_R_RANGE);
+}
+
+static isc_result_t
+setcachepolicy(dns_db_t *db, dns_cachepolicy_t policy) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+
+	for (unsigned int i = 0; i < sdb->nshards && result == ISC_R_SUCCESS;
+	     i++)
+	{
+		result = dns_db_setcachepolicy(sdb->shards[i], policy);
+	}
+
+	return (result);
+}
+
+/*
+ * The node locks of the shards are reported one shard after the other.
+ */
+static unsigned int
+nodelockwaits(dns_db_t *db, uint64_t *waits, unsigned int nwaits) {
+	dns_sharddb_t *sdb = (dns_sharddb_t *)db;
+	unsigned int count = 0;
+
+	REQUIRE(VALID_SHARDDB(sdb));
+	REQUIRE(waits != NULL || nwaits == 0);
+
+	for (unsigned int i = 0; i < sdb->nshards; i++) {
+		unsigned int n = 0;
+
+		if (count < nwaits) {
+			n = nwaits - count;
+		}
+		count += dns_db_nodelockwaits(sdb->shards[i],
+					      (n > 0) ? waits + count : NULL,
+					      n);
+	}
+
+	return (count);
+}
+
+static dns_dbmethods_t sharddb_methods = {
+	attach,
+	detach,
+	beginload,
+	endload,
+	dump,
+	currentversion,
+	newversion,
+	attachversion,
+	closeversion,
+	NULL, /* findnode */
+	NULL, /* find */
+	findzonecut,
+	attachnode,
+	detachnode,
+	expirenode,
+	printnode,
+	createiterator,
+	findrdataset,
+	allrdatasets,
+	addrdataset,
+	subtractrdataset,
+	deleterdataset,
+	issecure,
+	nodecount,
+	ispersistent,
+	overmem,
+	settask,
+	getoriginnode,
+	NULL, /* transfernode */
+	NULL, /* getnsec3parameters */
+	NULL, /* findnsec3node */
+	NULL, /* setsigningtime */
+	NULL, /* getsigningtime */
+	NULL, /* resigned */
+	isdnssec,
+	getrrsetstats,
+	NULL, /* rpz_attach */
+	NULL, /* rpz_ready */
+	findnodeext,
+	findext,
+	setcachestats,
+	hashsize,
+	nodefullname,
+	NULL, /* getsize */
+	setservestalettl,
+	getservestalettl,
+	setservestalerefresh,
+	getservestalerefresh,
+	NULL, /* setgluecachestats */
+	NULL, /* setsizehint */
+	nodelockwaits,
+	setcachepolicy,
+	findpopular,
+	cleanbucket,
+	setdomainusage,
+	topdomains,
+};
+
+isc_result_t
+dns_sharddb_create(isc_mem_t *mctx, isc_mem_t *hmctx,
+		   dns_rdataclass_t rdclass, unsigned int nshards,
+		   dns_db_t **dbp) {
+	dns_sharddb_t *sdb;
+	isc_result_t result;
+	char *argv[1] = { (char *)hmctx };
+
+	REQUIRE(mctx != NULL && hmctx != NULL);
+	REQUIRE(nshards > 1 && nshards <= DNS_CACHE_MAXSHARDS);
+	REQUIRE(dbp != NULL && *dbp == NULL);
+
+	sdb = isc_mem_get(mctx, sizeof(*sdb));
+	*sdb = (dns_sharddb_t){
+		.common.methods = &sharddb_methods,
+		.common.attributes = DNS_DBATTR_CACHE,
+		.common.rdclass = rdclass,
+		.nshards = nshards,
+	};
+	isc_mem_attach(mctx, &sdb->common.mctx);
+	ISC_LIST_INIT(sdb->common.update_listeners);
+	dns_name_init(&sdb->common.origin, NULL);
+	dns_name_dup(dns_rootname, mctx, &sdb->common.origin);
+	isc_refcount_init(&sdb->references, 1);
+
+	sdb->shards = isc_mem_get(mctx, nshards * sizeof(sdb->shards[0]));
+	for (unsigned int i = 0; i < nshards; i++) {
+		sdb->shards[i] = NULL;
+	}
+
+	result = dns_rdatasetstats_create(mctx, &sdb->rrsetstats);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	for (unsigned int i = 0; i < nshards; i++) {
+		result = dns_db_create(mctx, "rbt", dns_rootname,
+				       dns_dbtype_cache, rdclass, 1, argv,
+				       &sdb->shards[i]);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		dns_rbtdb_makeshard(sdb->shards[i], i, sdb->rrsetstats);
+	}
+
+	sdb->common.magic = DNS_DB_MAGIC;
+	sdb->common.impmagic = SHARDDB_MAGIC;
+
+	*dbp = (dns_db_t *)sdb;
+
+	return (ISC_R_SUCCESS);
+
+cleanup:
+	free_sharddb(sdb);
+	return (result);
+}
+
+/*
+ * Database iterator.
+ */
+
+/*%
+ * Record where 'part' is after a move that returned 'result', and
+ * release the tree lock of its shard, so that the iterator never holds
+ * the locks of two shards at once.
+ */
+static isc_result_t
+part_moved(sharddb_part_t *part, isc_result_t result) {
+	if (result == ISC_R_SUCCESS) {
+		dns_dbnode_t *node = NULL;
+
+		result = dns_dbiterator_current(part->iterator, &node,
+						part->name);
+		if (result == DNS_R_NEWORIGIN) {
+			result = ISC_R_SUCCESS;
+		}
+		if (node != NULL) {
+			dns_db_detachnode(part->iterator->db, &node);
+		}
+	}
+	(void)dns_dbiterator_pause(part->iterator);
+
+	part->result = result;
+	return (result);
+}
+
+/*%
+ * Move 'part' to the first name at or after 'name'.
+ */
+static isc_result_t
+part_seek(sharddb_part_t *part, const dns_name_t *name) {
+	isc_result_t result;
+
+	/*
+	 * After a partial match the iterator is on the name before
+	 * 'name', if there is one.
+	 */
+	result = dns_dbiterator_seek(part->iterator, name);
+	if (result == ISC_R_NOTFOUND) {
+		result = dns_dbiterator_first(part->iterator);
+	} else if (result == DNS_R_PARTIALMATCH) {
+		result = dns_dbiterator_next(part->iterator);
+	}
+	result = part_moved(part, result);
+
+	while (result == ISC_R_SUCCESS &&
+	       dns_name_compare(part->name, name) < 0)
+	{
+		result = part_moved(part, dns_dbiterator_next(part->iterator));
+	}
+
+	return (result);
+}
+
+/*%
+ * Put the cursor on the part with the smallest name, or return
+ * ISC_R_NOMORE if all of them are done.  Errors other than ISC_R_NOMORE
+ * in any part are returned instead.
+ */
+static isc_result_t
+select_current(sharddb_dbiterator_t *sdbiter) {
+	sharddb_part_t *best = NULL;
+
+	sdbiter->current = NULL;
+	for (unsigned int i = 0; i < sdbiter->nparts; i++) {
+		sharddb_part_t *part = &sdbiter->parts[i];
+
+		if (part->result == ISC_R_NOMORE) {
+			continue;
+		}
+		if (part->result != ISC_R_SUCCESS) {
+			return (part->result);
+		}
+		if (best == NULL || dns_name_compare(part->name, best->name) < 0)
+		{
+			best = part;
+		}
+	}
+
+	if (best == NULL) {
+		return (ISC_R_NOMORE);
+	}
+
+	sdbiter->current = best;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+dbiterator_destroy(dns_dbiterator_t **iteratorp) {
+	sharddb_dbiterator_t *sdbiter = (sharddb_dbiterator_t *)(*iteratorp);
+	dns_db_t *db = NULL;
+
+	*iteratorp = NULL;
+
+	for (unsigned int i = 0; i < sdbiter->nparts; i++) {
+		if (sdbiter->parts[i].iterator != NULL) {
+			dns_dbiterator_destroy(&sdbiter->parts[i].iterator);
+		}
+	}
+
+	dns_db_attach(sdbiter->common.db, &db);
+	dns_db_detach(&sdbiter->common.db);
+
+	isc_mem_put(db->mctx, sdbiter->parts,
+		    sdbiter->nparts * sizeof(sdbiter->parts[0]));
+	isc_mem_put(db->mctx, sdbiter, sizeof(*sdbiter));
+	dns_db_detach(&db);
+}
+
+static isc_result_t
+dbiterator_first(dns_dbiterator_t *iterator) {
+	sharddb_dbiterator_t *sdbiter = (sharddb_dbiterator_t *)iterator;
+
+	for (unsigned int i = 0; i < sdbiter->nparts; i++) {
+		sharddb_part_t *part = &sdbiter->parts[i];
+
+		(void)part_moved(part, dns_dbiterator_first(part->iterator));
+	}
+
+	return (select_current(sdbiter));
+}
+
+static isc_result_t
+dbiterator_last(dns_dbiterator_t *iterator) {
+	UNUSED(iterator);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+static isc_result_t
+dbiterator_seek(dns_dbiterator_t *iterator, const dns_name_t *name) {
+	sharddb_dbiterator_t *sdbiter = (sharddb_dbiterator_t *)iterator;
+
+	for (unsigned int i = 0; i < sdbiter->nparts; i++) {
+		(void)part_seek(&sdbiter->parts[i], name);
+	}
+
+	return (select_current(sdbiter));
+}
+
+static isc_result_t
+dbiterator_prev(dns_dbiterator_t *iterator) {
+	UNUSED(iterator);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+static isc_result_t
+dbiterator_next(dns_dbiterator_t *iterator) {
+	sharddb_dbiterator_t *sdbiter = (sharddb_dbiterator_t *)iterator;
+	sharddb_part_t *part = sdbiter->current;
+
+	if (part == NULL) {
+		return (ISC_R_NOMORE);
+	}
+
+	(void)part_moved(part, dns_dbiterator_next(part->iterator));
+
+	return (select_current(sdbiter));
+}
+
+static isc_result_t
+dbiterator_current(dns_dbiterator_t *iterator, dns_dbnode_t **nodep,
+		   dns_name_t *name) {
+	sharddb_dbiterator_t *sdbiter = (sharddb_dbiterator_t *)iterator;
+	sharddb_part_t *part = sdbiter->current;
+	isc_result_t result;
+
+	REQUIRE(part != NULL);
+
+	result = dns_dbiterator_current(part->iterator, nodep, NULL);
+	(void)dns_dbiterator_pause(part->iterator);
+	if (result == DNS_R_NEWORIGIN) {
+		result = ISC_R_SUCCESS;
+	}
+	if (result == ISC_R_SUCCESS && name != NULL) {
+		dns_name_copy(part->name, name);
+	}
+
+	return (result);
+}
+
+static isc_result_t
+dbiterator_pause(dns_dbiterator_t *iterator) {
+	UNUSED(iterator);
+
+	/*
+	 * The parts are paused after every move.
+	 */
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name) {
+	UNUSED(iterator);
+
+	dns_name_copy(dns_rootname, name);
+	return (ISC_R_SUCCESS);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+#include <isc/lang.h>
+
+#include <dns/types.h>
+
+/*****
+***** Module Info
+*****/
+
+/*! \file
+ * \brief
+ * Sharded cache database.
+ *
+ * A sharded cache is a cache database made of several independent
+ * "rbt" cache databases (shards), each with its own tree lock, node
+ * locks, LRU lists and TTL heaps.  A name is kept in the shard chosen
+ * by a hash of its last two labels, so that all the names below a
+ * second level domain are kept together, and inserting a new name only
+ * takes the tree lock of one shard.
+ *
+ * Every node records the shard it belongs to, so the operations on a
+ * node are passed directly to that shard.  Lookups of a name search its
+ * own shard first; if that one knows no delegation for the name, the
+ * shards of the shorter ancestors (the top level domain and the root)
+ * are searched for one.
+ *
+ * Notes:
+ *
+ *\li	Database iterators merge the iterators of the shards, so names
+ *	are still returned in DNSSEC order, but only forwards:
+ *	dns_dbiterator_last() and dns_dbiterator_prev() are not
+ *	implemented.  Names are always absolute, and an empty node may be
+ *	returned once for every shard that has it.
+ *	dns_dbiterator_seek() moves to the first name at or after 'name'
+ *	and returns #ISC_R_SUCCESS whether or not that is 'name' itself.
+ *
+ *\li	A covering NSEC record is only looked for in the shard of the
+ *	name being looked up.
+ */
+
+ISC_LANG_BEGINDECLS
+
+isc_result_t
+dns_sharddb_create(isc_mem_t *mctx, isc_mem_t *hmctx,
+		   dns_rdataclass_t rdclass, unsigned int nshards,
+		   dns_db_t **dbp);
+/*%<
+ * Create a cache database for class 'rdclass' made of 'nshards' "rbt"
+ * cache databases.  The shards allocate memory from 'mctx', and their
+ * heaps from 'hmctx', so memory limits set on 'mctx' apply to the
+ * whole cache.
+ *
+ * Requires:
+ *
+ * \li 'mctx' and 'hmctx' are valid memory contexts.
+ *
+ * \li 1 < 'nshards' <= #DNS_CACHE_MAXSHARDS.
+ *
+ * \li 'dbp' != NULL and '*dbp' == NULL.
+ */
+
+ISC_LANG_ENDDECLS
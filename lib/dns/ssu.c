@@ -15,6 +15,7 @@
 
 #include <stdbool.h>
 
+#include <isc/ht.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/netaddr.h>
@@ -48,15 +49,33 @@ struct dns_ssurule {
 	dns_ssuruletype_t *types;     /*%< the data types.  Can include */
 				      /*   ANY. if NULL, defaults to all */
 				      /*   types except SIG, SOA, and NS */
+	unsigned int seq;	      /*%< position in the table */
 	ISC_LINK(dns_ssurule_t) link;
+	ISC_LINK(dns_ssurule_t) ilink;
 };
 
+/*%
+ * The indexed rules of one identity, in table order.
+ */
+typedef struct ssuidentity {
+	ISC_LIST(dns_ssurule_t) rules;
+} ssuidentity_t;
+
+/*%
+ * Rules that can only match a signer equal to their identity are also
+ * indexed by identity in 'identities', so that checking an update does
+ * not have to go through the rules of every other identity.  All the
+ * other rules are listed in 'others'.
+ */
 struct dns_ssutable {
 	unsigned int magic;
 	isc_mem_t *mctx;
 	isc_refcount_t references;
 	dns_dlzdb_t *dlzdatabase;
 	ISC_LIST(dns_ssurule_t) rules;
+	unsigned int nrules;
+	isc_ht_t *identities;
+	ISC_LIST(dns_ssurule_t) others;
 };
 
 void
@@ -71,6 +90,10 @@ dns_ssutable_create(isc_mem_t *mctx, dns_ssutable_t **tablep) {
 	table->mctx = NULL;
 	isc_mem_attach(mctx, &table->mctx);
 	ISC_LIST_INIT(table->rules);
+	table->nrules = 0;
+	table->identities = NULL;
+	isc_ht_init(&table->identities, mctx, 4, ISC_HT_CASE_INSENSITIVE);
+	ISC_LIST_INIT(table->others);
 	table->magic = SSUTABLEMAGIC;
 	*tablep = table;
 }
@@ -78,10 +101,24 @@ dns_ssutable_create(isc_mem_t *mctx, dns_ssutable_t **tablep) {
 static void
 destroy(dns_ssutable_t *table) {
 	isc_mem_t *mctx;
+	isc_ht_iter_t *it = NULL;
+	isc_result_t result;
 
 	REQUIRE(VALID_SSUTABLE(table));
 
 	mctx = table->mctx;
+
+	isc_ht_iter_create(table->identities, &it);
+	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_delcurrent_next(it))
+	{
+		ssuidentity_t *ident = NULL;
+		isc_ht_iter_current(it, (void **)&ident);
+		isc_mem_put(mctx, ident, sizeof(*ident));
+	}
+	isc_ht_iter_destroy(&it);
+	isc_ht_destroy(&table->identities);
+
 	while (!ISC_LIST_EMPTY(table->rules)) {
 		dns_ssurule_t *rule = ISC_LIST_HEAD(table->rules);
 		if (rule->identity != NULL) {
@@ -130,6 +167,50 @@ dns_ssutable_detach(dns_ssutable_t **tablep) {
 	}
 }
 
+/*
+ * Whether 'rule' can only match a signer equal to its identity.
+ */
+static bool
+isindexed(const dns_ssurule_t *rule) {
+	switch (rule->matchtype) {
+	case dns_ssumatchtype_local:
+	case dns_ssumatchtype_name:
+	case dns_ssumatchtype_self:
+	case dns_ssumatchtype_selfsub:
+	case dns_ssumatchtype_selfwild:
+	case dns_ssumatchtype_subdomain:
+	case dns_ssumatchtype_wildcard:
+		return (!dns_name_iswildcard(rule->identity));
+	default:
+		return (false);
+	}
+}
+
+static void
+addrule(dns_ssutable_t *table, dns_ssurule_t *rule) {
+	ssuidentity_t *ident = NULL;
+	isc_result_t result;
+
+	rule->seq = table->nrules++;
+	ISC_LIST_INITANDAPPEND(table->rules, rule, link);
+
+	if (!isindexed(rule)) {
+		ISC_LIST_INITANDAPPEND(table->others, rule, ilink);
+		return;
+	}
+
+	result = isc_ht_find(table->identities, rule->identity->ndata,
+			     rule->identity->length, (void **)&ident);
+	if (result != ISC_R_SUCCESS) {
+		ident = isc_mem_get(table->mctx, sizeof(*ident));
+		ISC_LIST_INIT(ident->rules);
+		result = isc_ht_add(table->identities, rule->identity->ndata,
+				    rule->identity->length, ident);
+		INSIST(result == ISC_R_SUCCESS);
+	}
+	ISC_LIST_INITANDAPPEND(ident->rules, rule, ilink);
+}
+
 void
 dns_ssutable_addrule(dns_ssutable_t *table, bool grant,
 		     const dns_name_t *identity, dns_ssumatchtype_t matchtype,
@@ -177,7 +258,7 @@ dns_ssutable_addrule(dns_ssutable_t *table, bool grant,
 	}
 
 	rule->magic = SSURULEMAGIC;
-	ISC_LIST_INITANDAPPEND(table->rules, rule, link);
+	addrule(table, rule);
 }
 
 static bool
@@ -276,297 +357,332 @@ stf_from_address(dns_name_t *stfself, const isc_netaddr_t *tcpaddr) {
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 }
 
-bool
-dns_ssutable_checkrules(dns_ssutable_t *table, const dns_name_t *signer,
-			const dns_name_t *name, const isc_netaddr_t *addr,
-			bool tcp, dns_aclenv_t *env, dns_rdatatype_t type,
-			const dns_name_t *target, const dst_key_t *key,
-			const dns_ssurule_t **rulep) {
+/*
+ * Check whether 'rule' applies to the update of 'type' at 'name'.
+ */
+static bool
+rulematches(dns_ssutable_t *table, dns_ssurule_t *rule,
+	    const dns_name_t *signer, const dns_name_t *name,
+	    const isc_netaddr_t *addr, bool tcp, dns_aclenv_t *env,
+	    dns_rdatatype_t type, const dns_name_t *target,
+	    const dst_key_t *key) {
 	dns_fixedname_t fixed;
 	dns_name_t *stfself;
 	dns_name_t *tcpself;
 	dns_name_t *wildcard;
-	dns_ssurule_t *rule;
 	const dns_name_t *tname;
 	int match;
 	isc_result_t result;
 	unsigned int i;
 
-	REQUIRE(VALID_SSUTABLE(table));
-	REQUIRE(signer == NULL || dns_name_isabsolute(signer));
-	REQUIRE(dns_name_isabsolute(name));
-	REQUIRE(addr == NULL || env != NULL);
-
-	if (signer == NULL && addr == NULL) {
-		return (false);
-	}
-
-	for (rule = ISC_LIST_HEAD(table->rules); rule != NULL;
-	     rule = ISC_LIST_NEXT(rule, link))
-	{
-		switch (rule->matchtype) {
-		case dns_ssumatchtype_local:
-		case dns_ssumatchtype_name:
-		case dns_ssumatchtype_self:
-		case dns_ssumatchtype_selfsub:
-		case dns_ssumatchtype_selfwild:
-		case dns_ssumatchtype_subdomain:
-		case dns_ssumatchtype_wildcard:
-			if (signer == NULL) {
-				continue;
+	switch (rule->matchtype) {
+	case dns_ssumatchtype_local:
+	case dns_ssumatchtype_name:
+	case dns_ssumatchtype_self:
+	case dns_ssumatchtype_selfsub:
+	case dns_ssumatchtype_selfwild:
+	case dns_ssumatchtype_subdomain:
+	case dns_ssumatchtype_wildcard:
+		if (signer == NULL) {
+			return (false);
+		}
+		if (dns_name_iswildcard(rule->identity)) {
+			if (!dns_name_matcheswildcard(signer, rule->identity)) {
+				return (false);
 			}
-			if (dns_name_iswildcard(rule->identity)) {
-				if (!dns_name_matcheswildcard(signer,
-							      rule->identity))
-				{
-					continue;
-				}
-			} else {
-				if (!dns_name_equal(signer, rule->identity)) {
-					continue;
-				}
+		} else {
+			if (!dns_name_equal(signer, rule->identity)) {
+				return (false);
 			}
+		}
+		break;
+	case dns_ssumatchtype_selfkrb5:
+	case dns_ssumatchtype_selfms:
+	case dns_ssumatchtype_selfsubkrb5:
+	case dns_ssumatchtype_selfsubms:
+	case dns_ssumatchtype_subdomainkrb5:
+	case dns_ssumatchtype_subdomainms:
+	case dns_ssumatchtype_subdomainselfkrb5rhs:
+	case dns_ssumatchtype_subdomainselfmsrhs:
+		if (signer == NULL) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_tcpself:
+	case dns_ssumatchtype_6to4self:
+		if (!tcp || addr == NULL) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_external:
+	case dns_ssumatchtype_dlz:
+		break;
+	}
+
+	switch (rule->matchtype) {
+	case dns_ssumatchtype_name:
+		if (!dns_name_equal(name, rule->name)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_subdomain:
+		if (!dns_name_issubdomain(name, rule->name)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_local:
+		if (addr == NULL) {
+			return (false);
+		}
+		if (!dns_name_issubdomain(name, rule->name)) {
+			return (false);
+		}
+		RWLOCK(&env->rwlock, isc_rwlocktype_read);
+		dns_acl_match(addr, NULL, env->localhost, NULL, &match, NULL);
+		RWUNLOCK(&env->rwlock, isc_rwlocktype_read);
+		if (match == 0) {
+			if (signer != NULL) {
+				isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+					      DNS_LOGMODULE_SSU,
+					      ISC_LOG_WARNING,
+					      "update-policy local: "
+					      "match on session "
+					      "key not from "
+					      "localhost");
+			}
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_wildcard:
+		if (!dns_name_matcheswildcard(name, rule->name)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_self:
+		if (!dns_name_equal(signer, name)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_selfsub:
+		if (!dns_name_issubdomain(name, signer)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_selfwild:
+		wildcard = dns_fixedname_initname(&fixed);
+		result = dns_name_concatenate(dns_wildcardname, signer,
+					      wildcard, NULL);
+		if (result != ISC_R_SUCCESS) {
+			return (false);
+		}
+		if (!dns_name_matcheswildcard(name, wildcard)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_selfkrb5:
+		if (dst_gssapi_identitymatchesrealmkrb5(signer, name,
+							rule->identity, false))
+		{
 			break;
-		case dns_ssumatchtype_selfkrb5:
-		case dns_ssumatchtype_selfms:
-		case dns_ssumatchtype_selfsubkrb5:
-		case dns_ssumatchtype_selfsubms:
-		case dns_ssumatchtype_subdomainkrb5:
-		case dns_ssumatchtype_subdomainms:
-		case dns_ssumatchtype_subdomainselfkrb5rhs:
-		case dns_ssumatchtype_subdomainselfmsrhs:
-			if (signer == NULL) {
-				continue;
-			}
+		}
+		return (false);
+	case dns_ssumatchtype_selfms:
+		if (dst_gssapi_identitymatchesrealmms(signer, name,
+						      rule->identity, false))
+		{
 			break;
-		case dns_ssumatchtype_tcpself:
-		case dns_ssumatchtype_6to4self:
-			if (!tcp || addr == NULL) {
-				continue;
-			}
+		}
+		return (false);
+	case dns_ssumatchtype_selfsubkrb5:
+		if (dst_gssapi_identitymatchesrealmkrb5(signer, name,
+							rule->identity, true))
+		{
 			break;
-		case dns_ssumatchtype_external:
-		case dns_ssumatchtype_dlz:
+		}
+		return (false);
+	case dns_ssumatchtype_selfsubms:
+		if (dst_gssapi_identitymatchesrealmms(signer, name,
+						      rule->identity, true))
+		{
 			break;
 		}
-
+		return (false);
+	case dns_ssumatchtype_subdomainkrb5:
+	case dns_ssumatchtype_subdomainselfkrb5rhs:
+		if (!dns_name_issubdomain(name, rule->name)) {
+			return (false);
+		}
+		tname = NULL;
 		switch (rule->matchtype) {
-		case dns_ssumatchtype_name:
-			if (!dns_name_equal(name, rule->name)) {
-				continue;
+		case dns_ssumatchtype_subdomainselfkrb5rhs:
+			if (type == dns_rdatatype_ptr) {
+				tname = target;
 			}
-			break;
-		case dns_ssumatchtype_subdomain:
-			if (!dns_name_issubdomain(name, rule->name)) {
-				continue;
+			if (type == dns_rdatatype_srv) {
+				tname = target;
 			}
 			break;
-		case dns_ssumatchtype_local:
-			if (addr == NULL) {
-				continue;
-			}
-			if (!dns_name_issubdomain(name, rule->name)) {
-				continue;
-			}
-			RWLOCK(&env->rwlock, isc_rwlocktype_read);
-			dns_acl_match(addr, NULL, env->localhost, NULL, &match,
-				      NULL);
-			RWUNLOCK(&env->rwlock, isc_rwlocktype_read);
-			if (match == 0) {
-				if (signer != NULL) {
-					isc_log_write(dns_lctx,
-						      DNS_LOGCATEGORY_GENERAL,
-						      DNS_LOGMODULE_SSU,
-						      ISC_LOG_WARNING,
-						      "update-policy local: "
-						      "match on session "
-						      "key not from "
-						      "localhost");
-				}
-				continue;
-			}
+		default:
 			break;
-		case dns_ssumatchtype_wildcard:
-			if (!dns_name_matcheswildcard(name, rule->name)) {
-				continue;
-			}
+		}
+		if (dst_gssapi_identitymatchesrealmkrb5(signer, tname,
+							rule->identity, false))
+		{
 			break;
-		case dns_ssumatchtype_self:
-			if (!dns_name_equal(signer, name)) {
-				continue;
+		}
+		return (false);
+	case dns_ssumatchtype_subdomainms:
+	case dns_ssumatchtype_subdomainselfmsrhs:
+		if (!dns_name_issubdomain(name, rule->name)) {
+			return (false);
+		}
+		tname = NULL;
+		switch (rule->matchtype) {
+		case dns_ssumatchtype_subdomainselfmsrhs:
+			if (type == dns_rdatatype_ptr) {
+				tname = target;
 			}
-			break;
-		case dns_ssumatchtype_selfsub:
-			if (!dns_name_issubdomain(name, signer)) {
-				continue;
+			if (type == dns_rdatatype_srv) {
+				tname = target;
 			}
 			break;
-		case dns_ssumatchtype_selfwild:
-			wildcard = dns_fixedname_initname(&fixed);
-			result = dns_name_concatenate(dns_wildcardname, signer,
-						      wildcard, NULL);
-			if (result != ISC_R_SUCCESS) {
-				continue;
-			}
-			if (!dns_name_matcheswildcard(name, wildcard)) {
-				continue;
-			}
+		default:
 			break;
-		case dns_ssumatchtype_selfkrb5:
-			if (dst_gssapi_identitymatchesrealmkrb5(
-				    signer, name, rule->identity, false))
-			{
-				break;
-			}
-			continue;
-		case dns_ssumatchtype_selfms:
-			if (dst_gssapi_identitymatchesrealmms(
-				    signer, name, rule->identity, false))
-			{
-				break;
-			}
-			continue;
-		case dns_ssumatchtype_selfsubkrb5:
-			if (dst_gssapi_identitymatchesrealmkrb5(
-				    signer, name, rule->identity, true))
-			{
-				break;
-			}
-			continue;
-		case dns_ssumatchtype_selfsubms:
-			if (dst_gssapi_identitymatchesrealmms(
-				    signer, name, rule->identity, true))
+		}
+		if (dst_gssapi_identitymatchesrealmms(signer, tname,
+						      rule->identity, false))
+		{
+			break;
+		}
+		return (false);
+	case dns_ssumatchtype_tcpself:
+		tcpself = dns_fixedname_initname(&fixed);
+		reverse_from_address(tcpself, addr);
+		if (dns_name_iswildcard(rule->identity)) {
+			if (!dns_name_matcheswildcard(tcpself,
+						      rule->identity))
 			{
-				break;
-			}
-			continue;
-		case dns_ssumatchtype_subdomainkrb5:
-		case dns_ssumatchtype_subdomainselfkrb5rhs:
-			if (!dns_name_issubdomain(name, rule->name)) {
-				continue;
+				return (false);
 			}
-			tname = NULL;
-			switch (rule->matchtype) {
-			case dns_ssumatchtype_subdomainselfkrb5rhs:
-				if (type == dns_rdatatype_ptr) {
-					tname = target;
-				}
-				if (type == dns_rdatatype_srv) {
-					tname = target;
-				}
-				break;
-			default:
-				break;
+		} else {
+			if (!dns_name_equal(tcpself, rule->identity)) {
+				return (false);
 			}
-			if (dst_gssapi_identitymatchesrealmkrb5(
-				    signer, tname, rule->identity, false))
+		}
+		if (!dns_name_equal(tcpself, name)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_6to4self:
+		stfself = dns_fixedname_initname(&fixed);
+		stf_from_address(stfself, addr);
+		if (dns_name_iswildcard(rule->identity)) {
+			if (!dns_name_matcheswildcard(stfself,
+						      rule->identity))
 			{
-				break;
+				return (false);
 			}
-			continue;
-		case dns_ssumatchtype_subdomainms:
-		case dns_ssumatchtype_subdomainselfmsrhs:
-			if (!dns_name_issubdomain(name, rule->name)) {
-				continue;
-			}
-			tname = NULL;
-			switch (rule->matchtype) {
-			case dns_ssumatchtype_subdomainselfmsrhs:
-				if (type == dns_rdatatype_ptr) {
-					tname = target;
-				}
-				if (type == dns_rdatatype_srv) {
-					tname = target;
-				}
-				break;
-			default:
-				break;
+		} else {
+			if (!dns_name_equal(stfself, rule->identity)) {
+				return (false);
 			}
-			if (dst_gssapi_identitymatchesrealmms(
-				    signer, tname, rule->identity, false))
+		}
+		if (!dns_name_equal(stfself, name)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_external:
+		if (!dns_ssu_external_match(rule->identity, signer, name, addr,
+					    type, key, table->mctx))
+		{
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_dlz:
+		if (!dns_dlz_ssumatch(table->dlzdatabase, signer, name, addr,
+				      type, key))
+		{
+			return (false);
+		}
+		break;
+	}
+
+	if (rule->ntypes == 0) {
+		/*
+		 * If this is a DLZ rule, then the DLZ ssu
+		 * checks will have already checked the type.
+		 */
+		if (rule->matchtype != dns_ssumatchtype_dlz &&
+		    !isusertype(type))
+		{
+			return (false);
+		}
+	} else {
+		for (i = 0; i < rule->ntypes; i++) {
+			if (rule->types[i].type == dns_rdatatype_any ||
+			    rule->types[i].type == type)
 			{
 				break;
 			}
-			continue;
-		case dns_ssumatchtype_tcpself:
-			tcpself = dns_fixedname_initname(&fixed);
-			reverse_from_address(tcpself, addr);
-			if (dns_name_iswildcard(rule->identity)) {
-				if (!dns_name_matcheswildcard(tcpself,
-							      rule->identity))
-				{
-					continue;
-				}
-			} else {
-				if (!dns_name_equal(tcpself, rule->identity)) {
-					continue;
-				}
-			}
-			if (!dns_name_equal(tcpself, name)) {
-				continue;
-			}
-			break;
-		case dns_ssumatchtype_6to4self:
-			stfself = dns_fixedname_initname(&fixed);
-			stf_from_address(stfself, addr);
-			if (dns_name_iswildcard(rule->identity)) {
-				if (!dns_name_matcheswildcard(stfself,
-							      rule->identity))
-				{
-					continue;
-				}
-			} else {
-				if (!dns_name_equal(stfself, rule->identity)) {
-					continue;
-				}
-			}
-			if (!dns_name_equal(stfself, name)) {
-				continue;
-			}
-			break;
-		case dns_ssumatchtype_external:
-			if (!dns_ssu_external_match(rule->identity, signer,
-						    name, addr, type, key,
-						    table->mctx))
-			{
-				continue;
-			}
-			break;
-		case dns_ssumatchtype_dlz:
-			if (!dns_dlz_ssumatch(table->dlzdatabase, signer, name,
-					      addr, type, key))
-			{
-				continue;
-			}
-			break;
 		}
+		if (i == rule->ntypes) {
+			return (false);
+		}
+	}
 
-		if (rule->ntypes == 0) {
-			/*
-			 * If this is a DLZ rule, then the DLZ ssu
-			 * checks will have already checked the type.
-			 */
-			if (rule->matchtype != dns_ssumatchtype_dlz &&
-			    !isusertype(type))
-			{
-				continue;
-			}
+	return (true);
+}
+
+bool
+dns_ssutable_checkrules(dns_ssutable_t *table, const dns_name_t *signer,
+			const dns_name_t *name, const isc_netaddr_t *addr,
+			bool tcp, dns_aclenv_t *env, dns_rdatatype_t type,
+			const dns_name_t *target, const dst_key_t *key,
+			const dns_ssurule_t **rulep) {
+	dns_ssurule_t *rule = NULL, *other = NULL;
+	ssuidentity_t *ident = NULL;
+
+	REQUIRE(VALID_SSUTABLE(table));
+	REQUIRE(signer == NULL || dns_name_isabsolute(signer));
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(addr == NULL || env != NULL);
+
+	if (signer == NULL && addr == NULL) {
+		return (false);
+	}
+
+	if (signer != NULL &&
+	    isc_ht_find(table->identities, signer->ndata, signer->length,
+			(void **)&ident) == ISC_R_SUCCESS)
+	{
+		rule = ISC_LIST_HEAD(ident->rules);
+	}
+	other = ISC_LIST_HEAD(table->others);
+
+	/*
+	 * Only the rules for the signer's identity and the rules that are
+	 * not indexed can match; check them in table order.
+	 */
+	while (rule != NULL || other != NULL) {
+		dns_ssurule_t *next = NULL;
+
+		if (other == NULL || (rule != NULL && rule->seq < other->seq)) {
+			next = rule;
+			rule = ISC_LIST_NEXT(rule, ilink);
 		} else {
-			for (i = 0; i < rule->ntypes; i++) {
-				if (rule->types[i].type == dns_rdatatype_any ||
-				    rule->types[i].type == type)
-				{
-					break;
-				}
-			}
-			if (i == rule->ntypes) {
-				continue;
-			}
+			next = other;
+			other = ISC_LIST_NEXT(other, ilink);
+		}
+
+		if (!rulematches(table, next, signer, name, addr, tcp, env,
+				 type, target, key))
+		{
+			continue;
 		}
-		if (rule->grant && rulep != NULL) {
-			*rulep = rule;
+		if (next->grant && rulep != NULL) {
+			*rulep = next;
 		}
-		return (rule->grant);
+		return (next->grant);
 	}
 
 	return (false);
@@ -663,7 +779,7 @@ dns_ssutable_createdlz(isc_mem_t *mctx, dns_ssutable_t **tablep,
 	rule->types = NULL;
 	rule->magic = SSURULEMAGIC;
 
-	ISC_LIST_INITANDAPPEND(table->rules, rule, link);
+	addrule(table, rule);
 	*tablep = table;
 }
 
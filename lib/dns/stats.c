@@ -168,7 +168,7 @@ dns_stats_detach(dns_stats_t **statsp) {
  */
 static isc_result_t
 create_stats(isc_mem_t *mctx, dns_statstype_t type, int ncounters,
-	     dns_stats_t **statsp) {
+	     bool sharded, dns_stats_t **statsp) {
 	dns_stats_t *stats;
 	isc_result_t result;
 
@@ -177,7 +177,12 @@ create_stats(isc_mem_t *mctx, dns_statstype_t type, int ncounters,
 	stats->counters = NULL;
 	isc_refcount_init(&stats->references, 1);
 
-	result = isc_stats_create(mctx, &stats->counters, ncounters);
+	if (sharded) {
+		result = isc_stats_create_sharded(mctx, &stats->counters,
+						  ncounters);
+	} else {
+		result = isc_stats_create(mctx, &stats->counters, ncounters);
+	}
 	if (result != ISC_R_SUCCESS) {
 		goto clean_mutex;
 	}
@@ -200,7 +205,8 @@ isc_result_t
 dns_generalstats_create(isc_mem_t *mctx, dns_stats_t **statsp, int ncounters) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, dns_statstype_general, ncounters, statsp));
+	return (create_stats(mctx, dns_statstype_general, ncounters, false,
+			     statsp));
 }
 
 isc_result_t
@@ -212,7 +218,15 @@ dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	 * plus one additional for other RRtypes.
 	 */
 	return (create_stats(mctx, dns_statstype_rdtype,
-			     (RDTYPECOUNTER_MAXTYPE + 1), statsp));
+			     (RDTYPECOUNTER_MAXTYPE + 1), false, statsp));
+}
+
+isc_result_t
+dns_rdatatypestats_create_sharded(isc_mem_t *mctx, dns_stats_t **statsp) {
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	return (create_stats(mctx, dns_statstype_rdtype,
+			     (RDTYPECOUNTER_MAXTYPE + 1), true, statsp));
 }
 
 isc_result_t
@@ -220,14 +234,14 @@ dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	return (create_stats(mctx, dns_statstype_rdataset,
-			     (RDTYPECOUNTER_MAXVAL + 1), statsp));
+			     (RDTYPECOUNTER_MAXVAL + 1), false, statsp));
 }
 
 isc_result_t
 dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, dns_statstype_opcode, 16, statsp));
+	return (create_stats(mctx, dns_statstype_opcode, 16, true, statsp));
 }
 
 isc_result_t
@@ -235,7 +249,7 @@ dns_rcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	return (create_stats(mctx, dns_statstype_rcode, dns_rcode_badcookie + 1,
-			     statsp));
+			     true, statsp));
 }
 
 isc_result_t
@@ -248,7 +262,7 @@ dns_dnssecsignstats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	 */
 	return (create_stats(mctx, dns_statstype_dnssec,
 			     dnssecsign_num_keys * dnssecsign_block_size,
-			     statsp));
+			     false, statsp));
 }
 
 /*%
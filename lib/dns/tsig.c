@@ -18,6 +18,7 @@
 #include <stdlib.h>
 
 #include <isc/buffer.h>
+#include <isc/ht.h>
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/refcount.h>
@@ -31,7 +32,6 @@
 #include <dns/keyvalues.h>
 #include <dns/log.h>
 #include <dns/message.h>
-#include <dns/rbt.h>
 #include <dns/rdata.h>
 #include <dns/rdatalist.h>
 #include <dns/rdataset.h>
@@ -172,13 +172,23 @@ tsig_log(dns_tsigkey_t *key, int level, const char *fmt, ...) {
 	}
 }
 
+/*
+ * The keyring is a hash table keyed on the key name in wire format,
+ * compared without regard to case; it holds a reference to each key.
+ */
 static void
 remove_fromring(dns_tsigkey_t *tkey) {
+	isc_result_t result;
+
 	if (tkey->generated) {
 		ISC_LIST_UNLINK(tkey->ring->lru, tkey, link);
 		tkey->ring->generated--;
 	}
-	(void)dns_rbt_deletename(tkey->ring->keys, &tkey->name, false);
+	result = isc_ht_delete(tkey->ring->keys, tkey->name.ndata,
+			       tkey->name.length);
+	if (result == ISC_R_SUCCESS) {
+		dns_tsigkey_detach(&tkey);
+	}
 }
 
 static void
@@ -222,7 +232,7 @@ keyring_add(dns_tsig_keyring_t *ring, const dns_name_t *name,
 		ring->writecount = 0;
 	}
 
-	result = dns_rbt_addname(ring->keys, name, tkey);
+	result = isc_ht_add(ring->keys, name->ndata, name->length, tkey);
 	if (result == ISC_R_SUCCESS) {
 		if (tkey->generated) {
 			/*
@@ -386,58 +396,54 @@ cleanup_name:
 static void
 cleanup_ring(dns_tsig_keyring_t *ring) {
 	isc_result_t result;
-	dns_rbtnodechain_t chain;
-	dns_name_t foundname;
-	dns_fixedname_t fixedorigin;
-	dns_name_t *origin;
+	isc_ht_iter_t *it = NULL;
 	isc_stdtime_t now;
-	dns_rbtnode_t *node;
-	dns_tsigkey_t *tkey;
 
-	/*
-	 * Start up a new iterator each time.
-	 */
 	isc_stdtime_get(&now);
-	dns_name_init(&foundname, NULL);
-	origin = dns_fixedname_initname(&fixedorigin);
-
-again:
-	dns_rbtnodechain_init(&chain);
-	result = dns_rbtnodechain_first(&chain, ring->keys, &foundname, origin);
-	if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-		dns_rbtnodechain_invalidate(&chain);
-		return;
-	}
 
-	for (;;) {
-		node = NULL;
-		dns_rbtnodechain_current(&chain, &foundname, origin, &node);
-		tkey = node->data;
-		if (tkey != NULL) {
-			if (tkey->generated &&
-			    isc_refcount_current(&tkey->refs) == 1 &&
-			    tkey->inception != tkey->expire &&
-			    tkey->expire < now)
-			{
-				tsig_log(tkey, 2, "tsig expire: deleting");
-				/* delete the key */
-				dns_rbtnodechain_invalidate(&chain);
-				remove_fromring(tkey);
-				goto again;
-			}
-		}
-		result = dns_rbtnodechain_next(&chain, &foundname, origin);
-		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-			dns_rbtnodechain_invalidate(&chain);
-			return;
+	isc_ht_iter_create(ring->keys, &it);
+	result = isc_ht_iter_first(it);
+	while (result == ISC_R_SUCCESS) {
+		dns_tsigkey_t *tkey = NULL;
+
+		isc_ht_iter_current(it, (void **)&tkey);
+		if (tkey->generated &&
+		    isc_refcount_current(&tkey->refs) == 1 &&
+		    tkey->inception != tkey->expire && tkey->expire < now)
+		{
+			tsig_log(tkey, 2, "tsig expire: deleting");
+			ISC_LIST_UNLINK(ring->lru, tkey, link);
+			ring->generated--;
+			result = isc_ht_iter_delcurrent_next(it);
+			dns_tsigkey_detach(&tkey);
+		} else {
+			result = isc_ht_iter_next(it);
 		}
 	}
+	isc_ht_iter_destroy(&it);
 }
 
 static void
 destroyring(dns_tsig_keyring_t *ring) {
+	isc_result_t result;
+	isc_ht_iter_t *it = NULL;
+
 	isc_refcount_destroy(&ring->references);
-	dns_rbt_destroy(&ring->keys);
+
+	isc_ht_iter_create(ring->keys, &it);
+	result = isc_ht_iter_first(it);
+	while (result == ISC_R_SUCCESS) {
+		dns_tsigkey_t *tkey = NULL;
+
+		isc_ht_iter_current(it, (void **)&tkey);
+		if (tkey->generated && ISC_LINK_LINKED(tkey, link)) {
+			ISC_LIST_UNLINK(ring->lru, tkey, link);
+		}
+		result = isc_ht_iter_delcurrent_next(it);
+		dns_tsigkey_detach(&tkey);
+	}
+	isc_ht_iter_destroy(&it);
+	isc_ht_destroy(&ring->keys);
 	isc_rwlock_destroy(&ring->lock);
 	isc_mem_putanddetach(&ring->mctx, ring, sizeof(dns_tsig_keyring_t));
 }
@@ -598,13 +604,8 @@ dump_key(dns_tsigkey_t *tkey, FILE *fp) {
 isc_result_t
 dns_tsigkeyring_dumpanddetach(dns_tsig_keyring_t **ringp, FILE *fp) {
 	isc_result_t result;
-	dns_rbtnodechain_t chain;
-	dns_name_t foundname;
-	dns_fixedname_t fixedorigin;
-	dns_name_t *origin;
+	isc_ht_iter_t *it = NULL;
 	isc_stdtime_t now;
-	dns_rbtnode_t *node;
-	dns_tsigkey_t *tkey;
 	dns_tsig_keyring_t *ring;
 
 	REQUIRE(ringp != NULL && *ringp != NULL);
@@ -617,35 +618,21 @@ dns_tsigkeyring_dumpanddetach(dns_tsig_keyring_t **ringp, FILE *fp) {
 	}
 
 	isc_stdtime_get(&now);
-	dns_name_init(&foundname, NULL);
-	origin = dns_fixedname_initname(&fixedorigin);
-	dns_rbtnodechain_init(&chain);
-	result = dns_rbtnodechain_first(&chain, ring->keys, &foundname, origin);
-	if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-		dns_rbtnodechain_invalidate(&chain);
-		goto destroy;
-	}
-
-	for (;;) {
-		node = NULL;
-		dns_rbtnodechain_current(&chain, &foundname, origin, &node);
-		tkey = node->data;
-		if (tkey != NULL && tkey->generated && tkey->expire >= now) {
+	isc_ht_iter_create(ring->keys, &it);
+	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(it))
+	{
+		dns_tsigkey_t *tkey = NULL;
+
+		isc_ht_iter_current(it, (void **)&tkey);
+		if (tkey->generated && tkey->expire >= now) {
 			dump_key(tkey, fp);
 		}
-		result = dns_rbtnodechain_next(&chain, &foundname, origin);
-		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-			dns_rbtnodechain_invalidate(&chain);
-			if (result == ISC_R_NOMORE) {
-				result = ISC_R_SUCCESS;
-			}
-			goto destroy;
-		}
 	}
+	isc_ht_iter_destroy(&it);
 
-destroy:
 	destroyring(ring);
-	return (result);
+	return (ISC_R_SUCCESS);
 }
 
 const dns_name_t *
@@ -1772,8 +1759,9 @@ dns_tsigkey_find(dns_tsigkey_t **tsigkey, const dns_name_t *name,
 	isc_stdtime_get(&now);
 	RWLOCK(&ring->lock, isc_rwlocktype_read);
 	key = NULL;
-	result = dns_rbt_findname(ring->keys, name, 0, NULL, (void *)&key);
-	if (result == DNS_R_PARTIALMATCH || result == ISC_R_NOTFOUND) {
+	result = isc_ht_find(ring->keys, name->ndata, name->length,
+			     (void **)&key);
+	if (result != ISC_R_SUCCESS) {
 		RWUNLOCK(&ring->lock, isc_rwlocktype_read);
 		return (ISC_R_NOTFOUND);
 	}
@@ -1809,26 +1797,8 @@ dns_tsigkey_find(dns_tsigkey_t **tsigkey, const dns_name_t *name,
 	return (ISC_R_SUCCESS);
 }
 
-static void
-free_tsignode(void *node, void *_unused) {
-	dns_tsigkey_t *key;
-
-	REQUIRE(node != NULL);
-
-	UNUSED(_unused);
-
-	key = node;
-	if (key->generated) {
-		if (ISC_LINK_LINKED(key, link)) {
-			ISC_LIST_UNLINK(key->ring->lru, key, link);
-		}
-	}
-	dns_tsigkey_detach(&key);
-}
-
 isc_result_t
 dns_tsigkeyring_create(isc_mem_t *mctx, dns_tsig_keyring_t **ringp) {
-	isc_result_t result;
 	dns_tsig_keyring_t *ring;
 
 	REQUIRE(mctx != NULL);
@@ -1839,12 +1809,7 @@ dns_tsigkeyring_create(isc_mem_t *mctx, dns_tsig_keyring_t **ringp) {
 
 	isc_rwlock_init(&ring->lock, 0, 0);
 	ring->keys = NULL;
-	result = dns_rbt_create(mctx, free_tsignode, NULL, &ring->keys);
-	if (result != ISC_R_SUCCESS) {
-		isc_rwlock_destroy(&ring->lock);
-		isc_mem_put(mctx, ring, sizeof(dns_tsig_keyring_t));
-		return (result);
-	}
+	isc_ht_init(&ring->keys, mctx, 4, ISC_HT_CASE_INSENSITIVE);
 
 	ring->writecount = 0;
 	ring->mctx = NULL;
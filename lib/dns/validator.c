@@ -17,8 +17,15 @@
 #include <isc/base32.h>
 #include <isc/md.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/netmgr.h>
+#include <isc/once.h>
 #include <isc/print.h>
+#include <isc/profile.h>
 #include <isc/result.h>
+#include <isc/serial.h>
+#include <isc/stats.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/util.h>
@@ -39,6 +46,7 @@
 #include <dns/rdataset.h>
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
+#include <dns/stats.h>
 #include <dns/validator.h>
 #include <dns/view.h>
 
@@ -71,6 +79,7 @@
 	0x0004			  /*%< We have found a key and \
 				   * have attempted a verify. */
 #define VALATTR_INSECURITY 0x0010 /*%< Attempting proveunsecure. */
+#define VALATTR_OFFLOADED  0x0020 /*%< Verify running in a helper thread. */
 
 /*!
  * NSEC proofs to be looked for.
@@ -98,8 +107,36 @@
 #define FOUNDCLOSEST(val)    ((val->attributes & VALATTR_FOUNDCLOSEST) != 0)
 #define FOUNDOPTOUT(val)     ((val->attributes & VALATTR_FOUNDOPTOUT) != 0)
 
-#define SHUTDOWN(v) (((v)->attributes & VALATTR_SHUTDOWN) != 0)
-#define CANCELED(v) (((v)->attributes & VALATTR_CANCELED) != 0)
+#define SHUTDOWN(v)  (((v)->attributes & VALATTR_SHUTDOWN) != 0)
+#define CANCELED(v)  (((v)->attributes & VALATTR_CANCELED) != 0)
+#define OFFLOADED(v) (((v)->attributes & VALATTR_OFFLOADED) != 0)
+
+/*%
+ * Signatures that verified successfully are remembered, process-wide,
+ * by a digest of everything the outcome depends on: the owner name,
+ * the RRset in canonical order, the RRSIG, the DNSKEY and the view's
+ * maximum key size.  Another validation of the same data, e.g. after
+ * a refetch or in another view, can then skip the public key
+ * operation.  An entry is kept for at most VERIFIED_TTL seconds, and
+ * never past the expiration of the signature.
+ *
+ * The table has VERIFIED_SETS sets of VERIFIED_WAYS entries each, kept
+ * in least recently used order.
+ */
+#define VERIFIED_SETS	   4096
+#define VERIFIED_WAYS	   4
+#define VERIFIED_LOCKS	   64 /* must divide VERIFIED_SETS */
+#define VERIFIED_TTL	   300
+#define VERIFIED_DIGESTLEN 16
+
+typedef struct {
+	unsigned char digest[VERIFIED_DIGESTLEN];
+	isc_stdtime_t expire;
+} verified_t;
+
+static verified_t verified_table[VERIFIED_SETS][VERIFIED_WAYS];
+static isc_mutex_t verified_locks[VERIFIED_LOCKS];
+static isc_once_t verified_once = ISC_ONCE_INIT;
 
 #define NEGATIVE(r) (((r)->attributes & DNS_RDATASETATTR_NEGATIVE) != 0)
 #define NXDOMAIN(r) (((r)->attributes & DNS_RDATASETATTR_NXDOMAIN) != 0)
@@ -1137,8 +1174,8 @@ select_signing_key(dns_validator_t *val, dns_rdataset_t *rdataset) {
 		isc_buffer_init(&b, rdata.data, rdata.length);
 		isc_buffer_add(&b, rdata.length);
 		INSIST(val->key == NULL);
-		result = dst_key_fromdns(&siginfo->signer, rdata.rdclass, &b,
-					 val->view->mctx, &val->key);
+		result = dst_key_fromdns_cached(&siginfo->signer, rdata.rdclass,
+						&b, &val->key);
 		if (result == ISC_R_SUCCESS) {
 			if (siginfo->algorithm ==
 				    (dns_secalg_t)dst_key_alg(val->key) &&
@@ -1447,25 +1484,247 @@ selfsigned_dnskey(dns_validator_t *val) {
 	return (answer);
 }
 
+static void
+verified_initialize(void) {
+	for (size_t i = 0; i < VERIFIED_LOCKS; i++) {
+		isc_mutex_init(&verified_locks[i]);
+	}
+}
+
+static int
+verified_compare(const void *rdata1, const void *rdata2) {
+	return (dns_rdata_compare((const dns_rdata_t *)rdata1,
+				  (const dns_rdata_t *)rdata2));
+}
+
 /*%
- * Attempt to verify the rdataset using the given key and rdata (RRSIG).
- * The signature was good and from a wildcard record and the QNAME does
- * not match the wildcard we need to look for a NOQNAME proof.
- *
- * Returns:
- * \li	ISC_R_SUCCESS if the verification succeeds.
- * \li	Others if the verification fails.
+ * Compute the digest identifying the verification of the rdataset
+ * with 'key' and the RRSIG 'rdata'.  The RRset is digested in DNSSEC
+ * canonical order, like it is signed, so that the digest does not
+ * depend on the order the records happen to be stored in.
  */
 static isc_result_t
-verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
-       uint16_t keyid) {
+verified_digest(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+		unsigned char *digest) {
 	isc_result_t result;
+	isc_md_t *md = NULL;
+	isc_mem_t *mctx = val->view->mctx;
+	dns_rdataset_t rdataset;
+	dns_rdata_t *rdatas = NULL;
+	unsigned int count, nrdatas, i = 0;
 	dns_fixedname_t fixed;
-	bool ignore = false;
-	dns_name_t *wild;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	isc_region_t r;
+	isc_buffer_t b, hb;
+	unsigned char keybuf[DST_KEY_MAXSIZE];
+	unsigned char buf[ISC_MAX_MD_SIZE];
+	unsigned char hdr[8];
+	unsigned int len = 0;
+
+	isc_buffer_init(&b, keybuf, sizeof(keybuf));
+	result = dst_key_todns(key, &b);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	count = dns_rdataset_count(val->event->rdataset);
+	if (count == 0) {
+		return (ISC_R_NOTFOUND);
+	}
+	rdatas = isc_mem_get(mctx, count * sizeof(rdatas[0]));
+	dns_rdataset_init(&rdataset);
+	dns_rdataset_clone(val->event->rdataset, &rdataset);
+	for (result = dns_rdataset_first(&rdataset);
+	     result == ISC_R_SUCCESS && i < count;
+	     result = dns_rdataset_next(&rdataset))
+	{
+		dns_rdata_init(&rdatas[i]);
+		dns_rdataset_current(&rdataset, &rdatas[i++]);
+	}
+	dns_rdataset_disassociate(&rdataset);
+	nrdatas = i;
+	qsort(rdatas, nrdatas, sizeof(rdatas[0]), verified_compare);
+
+	md = isc_md_new();
+	if (md == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+	result = isc_md_init(md, ISC_MD_SHA256);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	dns_name_downcase(val->event->name, name, NULL);
+	dns_name_toregion(name, &r);
+	result = isc_md_update(md, r.base, r.length);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	isc_buffer_init(&hb, hdr, sizeof(hdr));
+	isc_buffer_putuint16(&hb, val->event->rdataset->rdclass);
+	isc_buffer_putuint16(&hb, val->event->rdataset->type);
+	isc_buffer_putuint32(&hb, val->view->maxbits);
+	result = isc_md_update(md, hdr, sizeof(hdr));
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	isc_buffer_usedregion(&b, &r);
+	result = isc_md_update(md, r.base, r.length);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	dns_rdata_toregion(rdata, &r);
+	result = isc_md_update(md, r.base, r.length);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	for (i = 0; i < nrdatas; i++) {
+		dns_rdata_toregion(&rdatas[i], &r);
+		isc_buffer_init(&hb, hdr, sizeof(hdr));
+		isc_buffer_putuint16(&hb, r.length);
+		result = isc_md_update(md, hdr, 2);
+		if (result == ISC_R_SUCCESS) {
+			result = isc_md_update(md, r.base, r.length);
+		}
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	result = isc_md_final(md, buf, &len);
+	if (result == ISC_R_SUCCESS) {
+		INSIST(len >= VERIFIED_DIGESTLEN);
+		memmove(digest, buf, VERIFIED_DIGESTLEN);
+	}
+
+cleanup:
+	if (md != NULL) {
+		isc_md_free(md);
+	}
+	isc_mem_put(mctx, rdatas, count * sizeof(rdatas[0]));
+	return (result);
+}
+
+static verified_t *
+verified_set(const unsigned char *digest, isc_mutex_t **lockp) {
+	uint32_t hash = digest[0] | digest[1] << 8 | digest[2] << 16;
+
+	RUNTIME_CHECK(isc_once_do(&verified_once, verified_initialize) ==
+		      ISC_R_SUCCESS);
+
+	*lockp = &verified_locks[hash % VERIFIED_LOCKS];
+	return (verified_table[hash % VERIFIED_SETS]);
+}
+
+/*%
+ * Look up 'digest', moving a live entry to the front of its set.
+ */
+static bool
+verified_find(const unsigned char *digest, isc_stdtime_t now) {
+	isc_mutex_t *lock = NULL;
+	verified_t *set = verified_set(digest, &lock);
+	bool found = false;
+
+	LOCK(lock);
+	for (size_t i = 0; i < VERIFIED_WAYS; i++) {
+		if (isc_serial_lt(now, set[i].expire) &&
+		    memcmp(set[i].digest, digest, VERIFIED_DIGESTLEN) == 0)
+		{
+			verified_t entry = set[i];
+			memmove(&set[1], &set[0], i * sizeof(set[0]));
+			set[0] = entry;
+			found = true;
+			break;
+		}
+	}
+	UNLOCK(lock);
+
+	return (found);
+}
+
+/*%
+ * Add 'digest' at the front of its set, evicting the least recently
+ * used entry.
+ */
+static void
+verified_add(const unsigned char *digest, isc_stdtime_t now,
+	     dns_rdata_t *rdata) {
+	isc_mutex_t *lock = NULL;
+	verified_t *set = verified_set(digest, &lock);
+	dns_rdata_rrsig_t sig;
+	isc_stdtime_t expire = now + VERIFIED_TTL;
+
+	if (dns_rdata_tostruct(rdata, &sig, NULL) == ISC_R_SUCCESS &&
+	    isc_serial_lt(sig.timeexpire, expire))
+	{
+		expire = sig.timeexpire;
+	}
+
+	LOCK(lock);
+	memmove(&set[1], &set[0], (VERIFIED_WAYS - 1) * sizeof(set[0]));
+	memmove(set[0].digest, digest, VERIFIED_DIGESTLEN);
+	set[0].expire = expire;
+	UNLOCK(lock);
+}
+
+static void
+verified_hit(dns_validator_t *val, uint16_t keyid) {
+	validator_log(val, ISC_LOG_DEBUG(3),
+		      "verify rdataset (keyid=%u): already verified", keyid);
+	if (val->view->resstats != NULL) {
+		isc_stats_increment(val->view->resstats,
+				    dns_resstatscounter_valcached);
+	}
+}
+
+/*%
+ * Has the rdataset already been verified with this key and RRSIG?
+ */
+static bool
+verify_cached(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata) {
+	unsigned char digest[VERIFIED_DIGESTLEN];
+	isc_stdtime_t now;
+
+	if (verified_digest(val, key, rdata, digest) != ISC_R_SUCCESS) {
+		return (false);
+	}
+	isc_stdtime_get(&now);
+	if (!verified_find(digest, now)) {
+		return (false);
+	}
+	verified_hit(val, val->siginfo->keyid);
+	return (true);
+}
+
+/*%
+ * Attempt to verify the rdataset using the given key and rdata (RRSIG),
+ * setting 'wild' to the wildcard name if the signature was made from
+ * a wildcard.
+ *
+ * This only reads the validator, so it can be run from a helper thread
+ * while the validator is waiting, see verify_offload().
+ */
+static isc_result_t
+verify_sig(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+	   uint16_t keyid, dns_name_t *wild) {
+	isc_result_t result;
+	unsigned char digest[VERIFIED_DIGESTLEN];
+	bool cacheable, ignore = false;
+	isc_stdtime_t now;
+
+	isc_stdtime_get(&now);
+	cacheable = (verified_digest(val, key, rdata, digest) ==
+		     ISC_R_SUCCESS);
+	if (cacheable && verified_find(digest, now)) {
+		verified_hit(val, keyid);
+		return (ISC_R_SUCCESS);
+	}
 
-	val->attributes |= VALATTR_TRIEDVERIFY;
-	wild = dns_fixedname_initname(&fixed);
 again:
 	result = dns_dnssec_verify(val->event->name, val->event->rdataset, key,
 				   ignore, val->view->maxbits, val->view->mctx,
@@ -1493,6 +1752,20 @@ again:
 			      "verify rdataset (keyid=%u): %s", keyid,
 			      isc_result_totext(result));
 	}
+
+	if (cacheable && !ignore && result == ISC_R_SUCCESS) {
+		verified_add(digest, now, rdata);
+	}
+
+	return (result);
+}
+
+/*%
+ * The signature was good and from a wildcard record and the QNAME does
+ * not match the wildcard we need to look for a NOQNAME proof.
+ */
+static isc_result_t
+verify_wildcard(dns_validator_t *val, isc_result_t result, dns_name_t *wild) {
 	if (result == DNS_R_FROMWILDCARD) {
 		if (!dns_name_equal(val->event->name, wild)) {
 			dns_name_t *closest;
@@ -1513,6 +1786,136 @@ again:
 	return (result);
 }
 
+/*%
+ * Attempt to verify the rdataset using the given key and rdata (RRSIG).
+ * The signature was good and from a wildcard record and the QNAME does
+ * not match the wildcard we need to look for a NOQNAME proof.
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS if the verification succeeds.
+ * \li	Others if the verification fails.
+ */
+static isc_result_t
+verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+       uint16_t keyid) {
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_name_t *wild = dns_fixedname_initname(&fixed);
+
+	val->attributes |= VALATTR_TRIEDVERIFY;
+	result = verify_sig(val, key, rdata, keyid, wild);
+	return (verify_wildcard(val, result, wild));
+}
+
+/*%
+ * Verify the rdataset with the RRSIG 'rdata', trying val->key and then
+ * the other keys in val->keyset with the same key tag and algorithm.
+ */
+static isc_result_t
+verify_keys(dns_validator_t *val, dns_rdata_t *rdata, dns_name_t *wild) {
+	isc_result_t result;
+
+	do {
+		result = verify_sig(val, val->key, rdata, val->siginfo->keyid,
+				    wild);
+		if (result == ISC_R_SUCCESS || result == DNS_R_FROMWILDCARD) {
+			break;
+		}
+	} while (select_signing_key(val, val->keyset) == ISC_R_SUCCESS);
+
+	return (result);
+}
+
+/*
+ * This runs in a libuv threadpool thread.
+ */
+static void
+verify_work(void *arg) {
+	dns_validator_t *val = arg;
+
+	val->vresult = verify_keys(val, &val->vsig,
+				   dns_fixedname_name(&val->vwild));
+}
+
+static void
+verify_resume(isc_task_t *task, isc_event_t *event) {
+	dns_validator_t *val = event->ev_arg;
+	isc_result_t result;
+	bool want_destroy;
+
+	UNUSED(task);
+	REQUIRE(event->ev_type == DNS_EVENT_VALIDATORVERIFIED);
+	REQUIRE(event == &val->vevent);
+
+	isc_event_free(&event);
+
+	LOCK(&val->lock);
+	INSIST(OFFLOADED(val));
+	if (CANCELED(val)) {
+		val->attributes &= ~VALATTR_OFFLOADED;
+		validator_done(val, ISC_R_CANCELED);
+	} else {
+		result = validate_answer(val, true);
+		if (result != DNS_R_WAIT) {
+			validator_done(val, result);
+		}
+	}
+	want_destroy = exit_check(val);
+	UNLOCK(&val->lock);
+
+	if (want_destroy) {
+		destroy(val);
+	}
+}
+
+/*
+ * This runs in the network manager thread that offloaded the verify.
+ */
+static void
+verify_done(void *arg, isc_result_t result) {
+	dns_validator_t *val = arg;
+	isc_event_t *event = &val->vevent;
+
+	if (result != ISC_R_SUCCESS) {
+		val->vresult = result;
+	}
+
+	/*
+	 * Only one verify is offloaded at a time, so the event embedded
+	 * in the validator is free.
+	 */
+	ISC_EVENT_INIT(event, sizeof(*event), 0, NULL,
+		       DNS_EVENT_VALIDATORVERIFIED, verify_resume, val, val,
+		       NULL, NULL);
+	isc_task_send(val->task, &event);
+}
+
+/*%
+ * Public key operations can take a while, so when running in a network
+ * manager thread, move the verification of the RRSIG 'rdata' to the
+ * libuv threadpool, leaving the thread free for other work; the
+ * validation then continues in verify_resume().
+ *
+ * Returns true if the verification was offloaded.
+ */
+static bool
+verify_offload(dns_validator_t *val, dns_rdata_t *rdata) {
+	if (isc_nm_tid() < 0 || isc_task_getnetmgr(val->task) == NULL) {
+		return (false);
+	}
+
+	dns_rdata_init(&val->vsig);
+	dns_rdata_clone(rdata, &val->vsig);
+	dns_fixedname_init(&val->vwild);
+	val->attributes |= VALATTR_OFFLOADED;
+
+	validator_log(val, ISC_LOG_DEBUG(3), "offloading verify");
+	isc_nm_work_offload(isc_task_getnetmgr(val->task), verify_work,
+			    verify_done, val);
+
+	return (true);
+}
+
 /*%
  * Attempts positive response validation of a normal RRset.
  *
@@ -1549,6 +1952,16 @@ validate_answer(dns_validator_t *val, bool resume) {
 	{
 		dns_rdata_reset(&rdata);
 		dns_rdataset_current(event->sigrdataset, &rdata);
+		if (OFFLOADED(val)) {
+			/*
+			 * The signature was verified by verify_work().
+			 */
+			val->attributes &= ~VALATTR_OFFLOADED;
+			vresult = verify_wildcard(
+				val, val->vresult,
+				dns_fixedname_name(&val->vwild));
+			goto verified;
+		}
 		if (val->siginfo == NULL) {
 			val->siginfo = isc_mem_get(val->view->mctx,
 						   sizeof(*val->siginfo));
@@ -1589,19 +2002,18 @@ validate_answer(dns_validator_t *val, bool resume) {
 			continue;
 		}
 
-		do {
-			isc_result_t tresult;
-			vresult = verify(val, val->key, &rdata,
-					 val->siginfo->keyid);
-			if (vresult == ISC_R_SUCCESS) {
-				break;
-			}
+		val->attributes |= VALATTR_TRIEDVERIFY;
+		if (verify_cached(val, val->key, &rdata)) {
+			vresult = ISC_R_SUCCESS;
+		} else if (verify_offload(val, &rdata)) {
+			return (DNS_R_WAIT);
+		} else {
+			dns_name_t *wild = dns_fixedname_initname(&val->vwild);
+			vresult = verify_wildcard(
+				val, verify_keys(val, &rdata, wild), wild);
+		}
 
-			tresult = select_signing_key(val, val->keyset);
-			if (tresult != ISC_R_SUCCESS) {
-				break;
-			}
-		} while (1);
+	verified:
 		if (vresult != ISC_R_SUCCESS) {
 			validator_log(val, ISC_LOG_DEBUG(3),
 				      "failed to verify rdataset");
@@ -3038,6 +3450,8 @@ validator_start(isc_task_t *task, isc_event_t *event) {
 		return;
 	}
 
+	isc_profile_enter(isc_profile_validator);
+
 	validator_log(val, ISC_LOG_DEBUG(3), "starting");
 
 	LOCK(&val->lock);
@@ -3136,6 +3550,8 @@ validator_start(isc_task_t *task, isc_event_t *event) {
 	if (want_destroy) {
 		destroy(val);
 	}
+
+	isc_profile_leave(isc_profile_validator);
 }
 
 isc_result_t
@@ -174,6 +174,7 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass, const char *name,
 	view->adbstats = NULL;
 	view->resstats = NULL;
 	view->resquerystats = NULL;
+	view->latencystats = NULL;
 	view->cacheshared = false;
 	ISC_LIST_INIT(view->dns64);
 	view->dns64cnt = 0;
@@ -189,6 +190,7 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass, const char *name,
 	view->acceptexpired = false;
 	view->use_glue_cache = false;
 	view->minimal_any = false;
+	view->sortadditional = false;
 	view->minimalresponses = dns_minimal_no;
 	view->transfer_format = dns_one_answer;
 	view->cacheacl = NULL;
@@ -260,11 +262,16 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass, const char *name,
 	view->v6bias = 0;
 	view->dtenv = NULL;
 	view->dttypes = 0;
+	view->dtsample = 1;
+	view->dtqtypes = NULL;
+	view->dtnqtypes = 0;
 
 	view->plugins = NULL;
 	view->plugins_free = NULL;
 	view->hooktable = NULL;
 	view->hooktable_free = NULL;
+	view->answercache = NULL;
+	view->answercache_free = NULL;
 
 	isc_mutex_init(&view->new_zone_lock);
 
@@ -557,6 +564,9 @@ destroy(dns_view_t *view) {
 	if (view->resquerystats != NULL) {
 		dns_stats_detach(&view->resquerystats);
 	}
+	if (view->latencystats != NULL) {
+		isc_stats_detach(&view->latencystats);
+	}
 	if (view->secroots_priv != NULL) {
 		dns_keytable_detach(&view->secroots_priv);
 	}
@@ -580,6 +590,10 @@ destroy(dns_view_t *view) {
 		dns_dt_detach(&view->dtenv);
 	}
 #endif /* HAVE_DNSTAP */
+	if (view->dtqtypes != NULL) {
+		isc_mem_put(view->mctx, view->dtqtypes,
+			    view->dtnqtypes * sizeof(view->dtqtypes[0]));
+	}
 	dns_view_setnewzones(view, false, NULL, NULL, 0ULL);
 	if (view->new_zone_file != NULL) {
 		isc_mem_free(view->mctx, view->new_zone_file);
@@ -617,6 +631,9 @@ destroy(dns_view_t *view) {
 	if (view->plugins != NULL && view->plugins_free != NULL) {
 		view->plugins_free(view->mctx, &view->plugins);
 	}
+	if (view->answercache != NULL && view->answercache_free != NULL) {
+		view->answercache_free(view->mctx, &view->answercache);
+	}
 	isc_mem_putanddetach(&view->mctx, view, sizeof(*view));
 }
 
@@ -879,6 +896,31 @@ dns_view_createresolver(dns_view_t *view, isc_taskmgr_t *taskmgr,
 	return (ISC_R_SUCCESS);
 }
 
+isc_result_t
+dns_view_attachresolver(dns_view_t *view, dns_view_t *source) {
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(!view->frozen);
+	REQUIRE(view->resolver == NULL);
+	REQUIRE(DNS_VIEW_VALID(source));
+	REQUIRE(source->rdclass == view->rdclass);
+
+	if (source->resolver == NULL || RESSHUTDOWN(source) ||
+	    ADBSHUTDOWN(source) || REQSHUTDOWN(source))
+	{
+		return (ISC_R_SHUTTINGDOWN);
+	}
+
+	/*
+	 * The shutdown attributes stay set, so that view_flushanddetach()
+	 * leaves the resolver, ADB and request manager to 'source'.
+	 */
+	dns_resolver_attach(source->resolver, &view->resolver);
+	dns_adb_attach(source->adb, &view->adb);
+	dns_requestmgr_attach(source->requestmgr, &view->requestmgr);
+
+	return (ISC_R_SUCCESS);
+}
+
 void
 dns_view_setcache(dns_view_t *view, dns_cache_t *cache, bool shared) {
 	REQUIRE(DNS_VIEW_VALID(view));
@@ -894,6 +936,25 @@ dns_view_setcache(dns_view_t *view, dns_cache_t *cache, bool shared) {
 	INSIST(DNS_DB_VALID(view->cachedb));
 }
 
+void
+dns_view_setlatencystats(dns_view_t *view, isc_stats_t *stats) {
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(!view->frozen);
+	REQUIRE(view->latencystats == NULL);
+
+	isc_stats_attach(stats, &view->latencystats);
+}
+
+void
+dns_view_getlatencystats(dns_view_t *view, isc_stats_t **statsp) {
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	if (view->latencystats != NULL) {
+		isc_stats_attach(view->latencystats, statsp);
+	}
+}
+
 bool
 dns_view_iscacheshared(dns_view_t *view) {
 	REQUIRE(DNS_VIEW_VALID(view));
@@ -90,6 +90,25 @@ typedef enum {
 	XFRST_AXFR_END
 } xfrin_state_t;
 
+/*%
+ * Maximum number of received tuples that may be waiting to be applied
+ * to the database before we stop reading from the primary.
+ */
+#define XFRIN_MAXPENDING 16384
+
+/*%
+ * A batch of changes waiting to be applied to the database by a worker
+ * thread, optionally followed by committing the load (AXFR) or the
+ * current version (IXFR).
+ */
+typedef struct xfrin_work xfrin_work_t;
+struct xfrin_work {
+	dns_diff_t diff;
+	unsigned int difflen;
+	bool commit;
+	ISC_LINK(xfrin_work_t) link;
+};
+
 /*%
  * Incoming zone transfer context.
  */
@@ -108,6 +127,8 @@ struct dns_xfrin_ctx {
 	isc_refcount_t recvs;	 /*%< Receive in progress */
 
 	atomic_bool shuttingdown;
+	atomic_bool failed;   /*%< xfrin_fail() was called */
+	atomic_bool finished; /*%< xfrin_finish() was called */
 
 	isc_result_t shutdown_result;
 
@@ -146,6 +167,20 @@ struct dns_xfrin_ctx {
 	dns_diff_t diff; /*%< Pending database changes */
 	int difflen;	 /*%< Number of pending tuples */
 
+	/*%
+	 * Batches waiting to be applied by a worker thread; at most one
+	 * ('current') is being applied at any time.  The queue is only
+	 * touched from the network manager thread that reads the
+	 * responses.
+	 */
+	ISC_LIST(xfrin_work_t) work;
+	xfrin_work_t *current;
+	atomic_bool applying;
+	isc_result_t workresult;
+	unsigned int worklen;	/*%< Number of queued tuples */
+	bool readpending;	/*%< Next read waits for the queue */
+	bool endpending;	/*%< Transfer end waits for the queue */
+
 	xfrin_state_t state;
 	uint32_t end_serial;
 	bool is_ixfr;
@@ -216,7 +251,7 @@ static isc_result_t
 axfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op, dns_name_t *name,
 	     dns_ttl_t ttl, dns_rdata_t *rdata);
 static isc_result_t
-axfr_apply(dns_xfrin_ctx_t *xfr);
+axfr_apply(dns_xfrin_ctx_t *xfr, dns_diff_t *diff);
 static isc_result_t
 axfr_commit(dns_xfrin_ctx_t *xfr);
 static isc_result_t
@@ -225,7 +260,7 @@ axfr_finalize(dns_xfrin_ctx_t *xfr);
 static isc_result_t
 ixfr_init(dns_xfrin_ctx_t *xfr);
 static isc_result_t
-ixfr_apply(dns_xfrin_ctx_t *xfr);
+ixfr_apply(dns_xfrin_ctx_t *xfr, dns_diff_t *diff);
 static isc_result_t
 ixfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op, dns_name_t *name,
 	     dns_ttl_t ttl, dns_rdata_t *rdata);
@@ -236,6 +271,13 @@ static isc_result_t
 xfr_rr(dns_xfrin_ctx_t *xfr, dns_name_t *name, uint32_t ttl,
        dns_rdata_t *rdata);
 
+static void
+xfrin_queue(dns_xfrin_ctx_t *xfr, bool commit);
+static void
+xfrin_work_next(dns_xfrin_ctx_t *xfr);
+static void
+xfrin_work_clear(dns_xfrin_ctx_t *xfr);
+
 static isc_result_t
 xfrin_start(dns_xfrin_ctx_t *xfr);
 
@@ -258,6 +300,12 @@ static void
 xfrin_idledout(struct isc_task *, struct isc_event *);
 static void
 xfrin_fail(dns_xfrin_ctx_t *xfr, isc_result_t result, const char *msg);
+static void
+xfrin_finish(dns_xfrin_ctx_t *xfr);
+static isc_result_t
+xfrin_end(dns_xfrin_ctx_t *xfr);
+static void
+xfrin_read(dns_xfrin_ctx_t *xfr);
 static isc_result_t
 render(dns_message_t *msg, isc_mem_t *mctx, isc_buffer_t *buf);
 
@@ -299,6 +347,7 @@ failure:
 static isc_result_t
 axfr_makedb(dns_xfrin_ctx_t *xfr, dns_db_t **dbp) {
 	isc_result_t result;
+	dns_db_t *zonedb = NULL;
 
 	result = dns_db_create(xfr->mctx, /* XXX */
 			       "rbt",	  /* XXX guess */
@@ -306,6 +355,16 @@ axfr_makedb(dns_xfrin_ctx_t *xfr, dns_db_t **dbp) {
 			       NULL, /* XXX guess */
 			       dbp);
 	if (result == ISC_R_SUCCESS) {
+		/*
+		 * Expect the new version to be about as large as the
+		 * one it replaces.
+		 */
+		if (dns_zone_getdb(xfr->zone, &zonedb) == ISC_R_SUCCESS) {
+			dns_db_setsizehint(*dbp, dns_db_nodecount(
+							 zonedb,
+							 dns_dbtree_main));
+			dns_db_detach(&zonedb);
+		}
 		dns_zone_rpz_enable_db(xfr->zone, *dbp);
 		dns_zone_catz_enable_db(xfr->zone, *dbp);
 	}
@@ -327,25 +386,21 @@ axfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op, dns_name_t *name,
 	CHECK(dns_difftuple_create(xfr->diff.mctx, op, name, ttl, rdata,
 				   &tuple));
 	dns_diff_append(&xfr->diff, &tuple);
-	if (++xfr->difflen > 100) {
-		CHECK(axfr_apply(xfr));
-	}
+	xfr->difflen++;
 	result = ISC_R_SUCCESS;
 failure:
 	return (result);
 }
 
 /*
- * Store a set of AXFR RRs in the database.
+ * Store a set of AXFR RRs in the database.  Runs on a worker thread.
  */
 static isc_result_t
-axfr_apply(dns_xfrin_ctx_t *xfr) {
+axfr_apply(dns_xfrin_ctx_t *xfr, dns_diff_t *diff) {
 	isc_result_t result;
 	uint64_t records;
 
-	CHECK(dns_diff_load(&xfr->diff, xfr->axfr.add, xfr->axfr.add_private));
-	xfr->difflen = 0;
-	dns_diff_clear(&xfr->diff);
+	CHECK(dns_diff_load(diff, xfr->axfr.add, xfr->axfr.add_private));
 	if (xfr->maxrecords != 0U) {
 		result = dns_db_getsize(xfr->db, xfr->ver, &records, NULL);
 		if (result == ISC_R_SUCCESS && records > xfr->maxrecords) {
@@ -362,7 +417,6 @@ static isc_result_t
 axfr_commit(dns_xfrin_ctx_t *xfr) {
 	isc_result_t result;
 
-	CHECK(axfr_apply(xfr));
 	CHECK(dns_db_endload(xfr->db, &xfr->axfr));
 	CHECK(dns_zone_verifydb(xfr->zone, xfr->db, NULL));
 
@@ -429,19 +483,17 @@ ixfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op, dns_name_t *name,
 	CHECK(dns_difftuple_create(xfr->diff.mctx, op, name, ttl, rdata,
 				   &tuple));
 	dns_diff_append(&xfr->diff, &tuple);
-	if (++xfr->difflen > 100) {
-		CHECK(ixfr_apply(xfr));
-	}
+	xfr->difflen++;
 	result = ISC_R_SUCCESS;
 failure:
 	return (result);
 }
 
 /*
- * Apply a set of IXFR changes to the database.
+ * Apply a set of IXFR changes to the database.  Runs on a worker thread.
  */
 static isc_result_t
-ixfr_apply(dns_xfrin_ctx_t *xfr) {
+ixfr_apply(dns_xfrin_ctx_t *xfr, dns_diff_t *diff) {
 	isc_result_t result;
 	uint64_t records;
 
@@ -451,7 +503,7 @@ ixfr_apply(dns_xfrin_ctx_t *xfr) {
 			CHECK(dns_journal_begin_transaction(xfr->ixfr.journal));
 		}
 	}
-	CHECK(dns_diff_apply(&xfr->diff, xfr->db, xfr->ver));
+	CHECK(dns_diff_apply(diff, xfr->db, xfr->ver));
 	if (xfr->maxrecords != 0U) {
 		result = dns_db_getsize(xfr->db, xfr->ver, &records, NULL);
 		if (result == ISC_R_SUCCESS && records > xfr->maxrecords) {
@@ -460,13 +512,11 @@ ixfr_apply(dns_xfrin_ctx_t *xfr) {
 		}
 	}
 	if (xfr->ixfr.journal != NULL) {
-		result = dns_journal_writediff(xfr->ixfr.journal, &xfr->diff);
+		result = dns_journal_writediff(xfr->ixfr.journal, diff);
 		if (result != ISC_R_SUCCESS) {
 			goto failure;
 		}
 	}
-	dns_diff_clear(&xfr->diff);
-	xfr->difflen = 0;
 	result = ISC_R_SUCCESS;
 failure:
 	return (result);
@@ -476,7 +526,6 @@ static isc_result_t
 ixfr_commit(dns_xfrin_ctx_t *xfr) {
 	isc_result_t result;
 
-	CHECK(ixfr_apply(xfr));
 	if (xfr->ver != NULL) {
 		CHECK(dns_zone_verifydb(xfr->zone, xfr->db, xfr->ver));
 		/* XXX enter ready-to-commit state here */
@@ -491,6 +540,167 @@ failure:
 	return (result);
 }
 
+/**************************************************************************/
+/*
+ * Applying changes to the database
+ *
+ * Received records are collected in xfr->diff and handed over as a
+ * batch at the end of each message and at each commit point.  The
+ * batches are applied in order by a worker thread, one at a time, so
+ * that the next messages can be received and parsed meanwhile.
+ */
+
+static isc_result_t
+xfrin_apply(dns_xfrin_ctx_t *xfr, xfrin_work_t *work) {
+	isc_result_t result;
+
+	if (xfr->is_ixfr) {
+		CHECK(ixfr_apply(xfr, &work->diff));
+		if (work->commit) {
+			CHECK(ixfr_commit(xfr));
+		}
+	} else {
+		CHECK(axfr_apply(xfr, &work->diff));
+		if (work->commit) {
+			CHECK(axfr_commit(xfr));
+		}
+	}
+	result = ISC_R_SUCCESS;
+failure:
+	return (result);
+}
+
+static void
+xfrin_work_cb(void *arg) {
+	dns_xfrin_ctx_t *xfr = (dns_xfrin_ctx_t *)arg;
+
+	xfr->workresult = xfrin_apply(xfr, xfr->current);
+}
+
+static void
+xfrin_work_free(dns_xfrin_ctx_t *xfr, xfrin_work_t **workp) {
+	xfrin_work_t *work = *workp;
+
+	*workp = NULL;
+	INSIST(xfr->worklen >= work->difflen);
+	xfr->worklen -= work->difflen;
+	dns_diff_clear(&work->diff);
+	isc_mem_put(xfr->mctx, work, sizeof(*work));
+}
+
+static void
+xfrin_work_clear(dns_xfrin_ctx_t *xfr) {
+	xfrin_work_t *work = NULL;
+
+	while ((work = ISC_LIST_HEAD(xfr->work)) != NULL) {
+		ISC_LIST_UNLINK(xfr->work, work, link);
+		xfrin_work_free(xfr, &work);
+	}
+}
+
+static void
+xfrin_work_done(void *arg, isc_result_t result) {
+	dns_xfrin_ctx_t *xfr = (dns_xfrin_ctx_t *)arg;
+
+	REQUIRE(VALID_XFRIN(xfr));
+
+	xfrin_work_free(xfr, &xfr->current);
+	if (result == ISC_R_SUCCESS) {
+		result = xfr->workresult;
+	}
+	atomic_store(&xfr->applying, false);
+
+	if (result != ISC_R_SUCCESS) {
+		xfrin_fail(xfr, result, "failed while applying changes");
+	}
+
+	if (atomic_load(&xfr->failed)) {
+		xfrin_work_clear(xfr);
+		if (xfr->readpending) {
+			/* No read was issued, so nothing will cancel it */
+			dns_xfrin_ctx_t *recv_xfr = xfr;
+			xfr->readpending = false;
+			isc_nmhandle_detach(&xfr->readhandle);
+			dns_xfrin_detach(&recv_xfr);
+		}
+		xfrin_finish(xfr);
+	} else if (!ISC_LIST_EMPTY(xfr->work)) {
+		xfrin_work_next(xfr);
+	} else if (xfr->endpending) {
+		xfr->endpending = false;
+		result = xfrin_end(xfr);
+		if (result != ISC_R_SUCCESS) {
+			xfrin_fail(xfr, result,
+				   "failed while receiving responses");
+		}
+	}
+
+	if (xfr->readpending && xfr->worklen <= XFRIN_MAXPENDING) {
+		xfr->readpending = false;
+		xfrin_read(xfr);
+	}
+
+	dns_xfrin_detach(&xfr);
+}
+
+/*
+ * Start applying the next batch, unless one is already being applied.
+ */
+static void
+xfrin_work_next(dns_xfrin_ctx_t *xfr) {
+	dns_xfrin_ctx_t *work_xfr = NULL;
+
+	if (xfr->current != NULL || ISC_LIST_EMPTY(xfr->work)) {
+		return;
+	}
+
+	/*
+	 * Pairs with xfrin_fail(): either it sees 'applying' and leaves
+	 * xfrin_finish() to xfrin_work_done(), or we see 'failed'.
+	 */
+	atomic_store(&xfr->applying, true);
+	if (atomic_load(&xfr->failed)) {
+		atomic_store(&xfr->applying, false);
+		xfrin_work_clear(xfr);
+		xfrin_finish(xfr);
+		return;
+	}
+
+	xfr->current = ISC_LIST_HEAD(xfr->work);
+	ISC_LIST_UNLINK(xfr->work, xfr->current, link);
+
+	dns_xfrin_attach(xfr, &work_xfr);
+	isc_nm_work_offload(xfr->netmgr, xfrin_work_cb, xfrin_work_done,
+			    work_xfr);
+}
+
+/*
+ * Hand the pending tuples over to the worker; with 'commit' the
+ * batch also ends the current IXFR version or the AXFR load.
+ */
+static void
+xfrin_queue(dns_xfrin_ctx_t *xfr, bool commit) {
+	xfrin_work_t *work = NULL;
+
+	if (xfr->difflen == 0 && !commit) {
+		return;
+	}
+
+	work = isc_mem_get(xfr->mctx, sizeof(*work));
+	*work = (xfrin_work_t){
+		.difflen = xfr->difflen,
+		.commit = commit,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	dns_diff_init(xfr->mctx, &work->diff);
+	ISC_LIST_APPENDLIST(work->diff.tuples, xfr->diff.tuples, link);
+	xfr->worklen += xfr->difflen;
+	xfr->difflen = 0;
+
+	ISC_LIST_APPEND(xfr->work, work, link);
+	xfrin_work_next(xfr);
+}
+
 /**************************************************************************/
 /*
  * Common AXFR/IXFR protocol code
@@ -638,7 +848,7 @@ redo:
 		if (rdata->type == dns_rdatatype_soa) {
 			uint32_t soa_serial = dns_soa_getserial(rdata);
 			if (soa_serial == xfr->end_serial) {
-				CHECK(ixfr_commit(xfr));
+				xfrin_queue(xfr, true);
 				xfr->state = XFRST_IXFR_END;
 				break;
 			} else if (soa_serial != xfr->ixfr.current_serial) {
@@ -648,7 +858,7 @@ redo:
 					  xfr->ixfr.current_serial, soa_serial);
 				FAIL(DNS_R_FORMERR);
 			} else {
-				CHECK(ixfr_commit(xfr));
+				xfrin_queue(xfr, true);
 				xfr->state = XFRST_IXFR_DELSOA;
 				goto redo;
 			}
@@ -683,7 +893,7 @@ redo:
 					  "mismatch");
 				FAIL(DNS_R_FORMERR);
 			}
-			CHECK(axfr_commit(xfr));
+			xfrin_queue(xfr, true);
 			xfr->state = XFRST_AXFR_END;
 			break;
 		}
@@ -837,6 +1047,7 @@ xfrin_reset(dns_xfrin_ctx_t *xfr) {
 
 	REQUIRE(xfr->readhandle == NULL);
 	REQUIRE(xfr->sendhandle == NULL);
+	REQUIRE(xfr->current == NULL && ISC_LIST_EMPTY(xfr->work));
 
 	if (xfr->lasttsig != NULL) {
 		isc_buffer_free(&xfr->lasttsig);
@@ -880,17 +1091,36 @@ xfrin_fail(dns_xfrin_ctx_t *xfr, isc_result_t result, const char *msg) {
 			}
 		}
 		xfrin_cancelio(xfr);
+		xfr->shutdown_result = result;
+
 		/*
-		 * Close the journal.
+		 * If a worker thread is still applying changes, the
+		 * journal is in use; xfrin_work_done() will finish up.
 		 */
-		if (xfr->ixfr.journal != NULL) {
-			dns_journal_destroy(&xfr->ixfr.journal);
+		atomic_store(&xfr->failed, true);
+		if (!atomic_load(&xfr->applying)) {
+			xfrin_finish(xfr);
 		}
-		if (xfr->done != NULL) {
-			(xfr->done)(xfr->zone, result);
-			xfr->done = NULL;
-		}
-		xfr->shutdown_result = result;
+	}
+}
+
+static void
+xfrin_finish(dns_xfrin_ctx_t *xfr) {
+	if (!atomic_compare_exchange_strong(&xfr->finished, &(bool){ false },
+					    true))
+	{
+		return;
+	}
+
+	/*
+	 * Close the journal.
+	 */
+	if (xfr->ixfr.journal != NULL) {
+		dns_journal_destroy(&xfr->ixfr.journal);
+	}
+	if (xfr->done != NULL) {
+		(xfr->done)(xfr->zone, xfr->shutdown_result);
+		xfr->done = NULL;
 	}
 }
 
@@ -927,12 +1157,16 @@ xfrin_create(isc_mem_t *mctx, dns_zone_t *zone, dns_db_t *db, isc_nm_t *netmgr,
 	isc_refcount_init(&xfr->recvs, 0);
 
 	atomic_init(&xfr->shuttingdown, false);
+	atomic_init(&xfr->failed, false);
+	atomic_init(&xfr->finished, false);
+	atomic_init(&xfr->applying, false);
 
 	if (db != NULL) {
 		dns_db_attach(db, &xfr->db);
 	}
 
 	dns_diff_init(xfr->mctx, &xfr->diff);
+	ISC_LIST_INIT(xfr->work);
 
 	if (reqtype == dns_rdatatype_soa) {
 		xfr->state = XFRST_SOAQUERY;
@@ -1800,45 +2034,31 @@ xfrin_recv_done(isc_nmhandle_t *handle, isc_result_t result,
 		CHECK(xfrin_send_request(xfr));
 		break;
 	case XFRST_AXFR_END:
-		CHECK(axfr_finalize(xfr));
-		FALLTHROUGH;
 	case XFRST_IXFR_END:
 		/*
-		 * Close the journal.
-		 */
-		if (xfr->ixfr.journal != NULL) {
-			dns_journal_destroy(&xfr->ixfr.journal);
-		}
-
-		/*
-		 * Inform the caller we succeeded.
+		 * Finish once the worker has applied everything;
+		 * the last batch was queued when the final SOA arrived.
 		 */
-		if (xfr->done != NULL) {
-			(xfr->done)(xfr->zone, ISC_R_SUCCESS);
-			xfr->done = NULL;
+		if (xfr->current != NULL || !ISC_LIST_EMPTY(xfr->work)) {
+			xfr->endpending = true;
+			break;
 		}
-
-		atomic_store(&xfr->shuttingdown, true);
-		(void)isc_timer_reset(xfr->max_time_timer,
-				      isc_timertype_inactive, NULL, NULL, true);
-		xfr->shutdown_result = ISC_R_SUCCESS;
+		CHECK(xfrin_end(xfr));
 		break;
 	default:
 		/*
-		 * Read the next message.
+		 * Hand this message's records to the worker, and read
+		 * the next message unless too many are still waiting.
 		 */
 		/* The readhandle is still attached */
 		/* The recv_xfr is still attached */
 		dns_message_detach(&msg);
-		isc_refcount_increment0(&xfr->recvs);
-		isc_nm_read(xfr->handle, xfrin_recv_done, xfr);
-		isc_time_t next;
-		isc_interval_t interval;
-		isc_interval_set(&interval, dns_zone_getidlein(xfr->zone), 0);
-		isc_time_nowplusinterval(&next, &interval);
-		result = isc_timer_reset(xfr->max_idle_timer,
-					 isc_timertype_once, &next, NULL, true);
-		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		xfrin_queue(xfr, false);
+		if (xfr->worklen > XFRIN_MAXPENDING) {
+			xfr->readpending = true;
+			return;
+		}
+		xfrin_read(xfr);
 		return;
 	}
 
@@ -1854,6 +2074,61 @@ failure:
 	dns_xfrin_detach(&xfr); /* recv_xfr */
 }
 
+/*
+ * Successful end of the transfer: replace the zone database (AXFR)
+ * and tell the caller.
+ */
+static isc_result_t
+xfrin_end(dns_xfrin_ctx_t *xfr) {
+	isc_result_t result;
+
+	if (xfr->state == XFRST_AXFR_END) {
+		CHECK(axfr_finalize(xfr));
+	}
+
+	/*
+	 * Close the journal.
+	 */
+	if (xfr->ixfr.journal != NULL) {
+		dns_journal_destroy(&xfr->ixfr.journal);
+	}
+
+	/*
+	 * Inform the caller we succeeded.
+	 */
+	if (xfr->done != NULL) {
+		(xfr->done)(xfr->zone, ISC_R_SUCCESS);
+		xfr->done = NULL;
+	}
+
+	atomic_store(&xfr->shuttingdown, true);
+	(void)isc_timer_reset(xfr->max_time_timer, isc_timertype_inactive,
+			      NULL, NULL, true);
+	xfr->shutdown_result = ISC_R_SUCCESS;
+	result = ISC_R_SUCCESS;
+failure:
+	return (result);
+}
+
+/*
+ * Read the next message.  The caller holds xfr->readhandle and the
+ * recv_xfr reference, which xfrin_recv_done() will release.
+ */
+static void
+xfrin_read(dns_xfrin_ctx_t *xfr) {
+	isc_result_t result;
+	isc_time_t next;
+	isc_interval_t interval;
+
+	isc_refcount_increment0(&xfr->recvs);
+	isc_nm_read(xfr->handle, xfrin_recv_done, xfr);
+	isc_interval_set(&interval, dns_zone_getidlein(xfr->zone), 0);
+	isc_time_nowplusinterval(&next, &interval);
+	result = isc_timer_reset(xfr->max_idle_timer, isc_timertype_once,
+				 &next, NULL, true);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+}
+
 static void
 xfrin_destroy(dns_xfrin_ctx_t *xfr) {
 	uint64_t msecs;
@@ -1864,6 +2139,7 @@ xfrin_destroy(dns_xfrin_ctx_t *xfr) {
 
 	/* Safe-guards */
 	REQUIRE(atomic_load(&xfr->shuttingdown));
+	REQUIRE(xfr->current == NULL);
 	isc_refcount_destroy(&xfr->references);
 	isc_refcount_destroy(&xfr->connects);
 	isc_refcount_destroy(&xfr->recvs);
@@ -1917,6 +2193,7 @@ xfrin_destroy(dns_xfrin_ctx_t *xfr) {
 	}
 
 	dns_diff_clear(&xfr->diff);
+	xfrin_work_clear(xfr);
 
 	if (xfr->ixfr.journal != NULL) {
 		dns_journal_destroy(&xfr->ixfr.journal);
@@ -19,11 +19,15 @@
 
 #include <isc/atomic.h>
 #include <isc/file.h>
+#include <isc/heap.h>
 #include <isc/hex.h>
+#include <isc/ht.h>
 #include <isc/md.h>
 #include <isc/mutex.h>
+#include <isc/netmgr.h>
 #include <isc/pool.h>
 #include <isc/print.h>
+#include <isc/profile.h>
 #include <isc/random.h>
 #include <isc/ratelimiter.h>
 #include <isc/refcount.h>
@@ -166,6 +170,8 @@
 #endif			   /* ifndef DNS_DUMP_DELAY */
 
 typedef struct dns_notify dns_notify_t;
+typedef struct dns_notifypeer dns_notifypeer_t;
+typedef struct dns_xfrinpeer dns_xfrinpeer_t;
 typedef struct dns_checkds dns_checkds_t;
 typedef struct dns_stub dns_stub_t;
 typedef struct dns_load dns_load_t;
@@ -248,6 +254,18 @@ struct dns_keymgmt {
 	uint32_t bits;
 };
 
+/*%
+ * An event to be sent once the journal transactions written before it
+ * have been synced.
+ */
+typedef struct dns_journalwait {
+	isc_task_t *task;
+	isc_event_t *event;
+	ISC_LINK(struct dns_journalwait) link;
+} dns_journalwait_t;
+
+typedef ISC_LIST(dns_journalwait_t) dns_journalwaitlist_t;
+
 struct dns_zone {
 	/* Unlocked */
 	unsigned int magic;
@@ -264,7 +282,11 @@ struct dns_zone {
 	/* Locked */
 	dns_zonemgr_t *zmgr;
 	ISC_LINK(dns_zone_t) link; /* Used by zmgr. */
-	isc_timer_t *timer;
+	/* Maintenance schedule; locked by timerzmgr->timerlock. */
+	dns_zonemgr_t *timerzmgr;
+	isc_task_t *timertask;
+	isc_time_t timerdue;
+	unsigned int timerindex;
 	isc_refcount_t irefs;
 	dns_name_t origin;
 	char *masterfile;
@@ -276,6 +298,21 @@ struct dns_zone {
 	const dns_master_style_t *masterstyle;
 	char *journal;
 	int32_t journalsize;
+	/*%
+	 * Journal transactions written by dns_zone_writejournal() and
+	 * not yet synced; locked by 'jlock'.
+	 */
+	isc_mutex_t jlock;
+	uint32_t journaldelay; /* milliseconds */
+	dns_journal_t *pendingjournal;
+	isc_timer_t *journaltimer;
+	dns_journalwaitlist_t journalwaits;
+	bool journalshutdown;
+	/*%
+	 * Dynamic updates waiting behind the one sent to the zone task.
+	 */
+	isc_eventlist_t updates;
+	bool updatesent;
 	dns_rdataclass_t rdclass;
 	dns_zonetype_t type;
 	atomic_uint_fast64_t flags;
@@ -286,6 +323,7 @@ struct dns_zone {
 	isc_time_t refreshtime;
 	isc_time_t dumptime;
 	isc_time_t loadtime;
+	isc_time_t loadstart; /* when loading from the file began */
 	isc_time_t notifytime;
 	isc_time_t resigntime;
 	isc_time_t keywarntime;
@@ -371,6 +409,19 @@ struct dns_zone {
 	uint32_t sigvalidityinterval;
 	uint32_t keyvalidityinterval;
 	uint32_t sigresigninginterval;
+	uint32_t resignrate;
+	uint32_t resigntokens;
+	isc_stdtime_t resignrefill;
+	bool resignbacklog;
+	/*%
+	 * Keys and signature cache used to sign NSEC records synthesized
+	 * for compact denial of existence; locked by 'denlock'.
+	 */
+	isc_mutex_t denlock;
+	dst_key_t *denkeys[DNS_MAXZONEKEYS];
+	unsigned int ndenkeys;
+	isc_stdtime_t denkeysrefresh;
+	struct densig *densigs;
 	dns_view_t *view;
 	dns_view_t *prev_view;
 	dns_kasp_t *kasp;
@@ -386,6 +437,12 @@ struct dns_zone {
 	 */
 	ISC_LINK(dns_zone_t) statelink;
 	dns_zonelist_t *statelist;
+	/*%
+	 * The primary the zone is waiting to transfer from or transferring
+	 * from, and when it started waiting.  Locked by the zone manager.
+	 */
+	dns_xfrinpeer_t *xfrinpeer;
+	isc_time_t xfrinqueued;
 	/*%
 	 * Statistics counters about zone management.
 	 */
@@ -426,6 +483,7 @@ struct dns_zone {
 	 */
 	uint32_t signatures;
 	uint32_t nodes;
+	uint32_t signthreads;
 	dns_rdatatype_t privatetype;
 
 	/*%
@@ -443,6 +501,12 @@ struct dns_zone {
 	 */
 	bool automatic;
 
+	/*%
+	 * Digest of the configuration the zone was set up from.
+	 */
+	bool cfgdigestset;
+	unsigned char cfgdigest[DNS_ZONE_CFGDIGEST_LENGTH];
+
 	/*%
 	 * response policy data to be relayed to the database
 	 */
@@ -590,6 +654,44 @@ typedef enum {
 #define UNREACH_CACHE_SIZE 10U
 #define UNREACH_HOLD_TIME  600 /* 10 minutes */
 
+#define SIGNJOB_MAXTHREADS 64
+
+/*%
+ * NOTIFY messages in flight to a single destination start at
+ * NOTIFY_WINDOW_INIT; the window grows as they are answered, up to
+ * NOTIFY_WINDOW_MAX, and is halved when one times out.
+ */
+#define NOTIFY_WINDOW_INIT 4
+#define NOTIFY_WINDOW_MAX  64
+
+/*%
+ * While NOTIFY messages are answered, the rate they are sent at is
+ * raised step by step up to NOTIFY_RATE_BOOST times the configured
+ * rate; it falls back when one times out.
+ */
+#define NOTIFY_RATE_BOOST 10
+
+#define DENSIG_SLOTS	    256
+#define DENSIG_RDATASIZE    (DNS_NAME_MAXWIRE + 32)
+#define DENSIG_SIGSIZE	    2048
+#define DENKEYS_REFRESH	    3600
+
+/*%
+ * A cached set of signatures over a synthesized NSEC record, in a
+ * slot selected by the hash of its owner name.
+ */
+struct densig {
+	bool valid;
+	dns_fixedname_t fname;
+	unsigned int rdlen;
+	unsigned char rdata[DENSIG_RDATASIZE];
+	dns_ttl_t ttl;
+	isc_stdtime_t refresh;
+	unsigned int nsigs;
+	unsigned int siglen[DNS_ZONE_DENIALMAXSIGS];
+	unsigned char sigdata[DENSIG_SIGSIZE];
+};
+
 #define CHECK(op)                            \
 	do {                                 \
 		result = (op);               \
@@ -624,11 +726,16 @@ struct dns_zonemgr {
 	isc_rwlock_t rwlock;
 	isc_mutex_t iolock;
 	isc_rwlock_t urlock;
+	isc_mutex_t timerlock;
+	isc_mutex_t notifylock;
 
 	/* Locked by rwlock. */
 	dns_zonelist_t zones;
-	dns_zonelist_t waiting_for_xfrin;
 	dns_zonelist_t xfrin_in_progress;
+	isc_ht_t *xfrinpeers;
+	ISC_LIST(dns_xfrinpeer_t) xfrinready;
+	uint32_t nxfrsin;
+	uint32_t nxfrswaiting;
 
 	/* Configuration data. */
 	uint32_t transfersin;
@@ -639,6 +746,13 @@ struct dns_zonemgr {
 	unsigned int serialqueryrate;
 	unsigned int startupserialqueryrate;
 
+	/* Locked by notifylock. */
+	isc_ht_t *notifypeers;
+	unsigned int notifyratecur;
+	unsigned int notifyacks;
+	unsigned int startupnotifyratecur;
+	unsigned int startupnotifyacks;
+
 	/* Locked by iolock */
 	uint32_t iolimit;
 	uint32_t ioactive;
@@ -649,6 +763,11 @@ struct dns_zonemgr {
 	/* LRU cache */
 	struct dns_unreachable unreachable[UNREACH_CACHE_SIZE];
 
+	/* Locked by timerlock. */
+	isc_heap_t *timerheap;
+	isc_timer_t *timer;
+	isc_time_t timernext;
+
 	dns_keymgmt_t *keymgmt;
 
 	isc_tlsctx_cache_t *tlsctx_cache;
@@ -671,11 +790,40 @@ struct dns_notify {
 	dns_transport_t *transport;
 	ISC_LINK(dns_notify_t) link;
 	isc_event_t *event;
+	dns_notifypeer_t *peer;
+	ISC_LINK(dns_notify_t) peerlink;
 };
 
 #define DNS_NOTIFY_NOSOA   0x0001U
 #define DNS_NOTIFY_STARTUP 0x0002U
 
+/*%
+ * NOTIFY state per destination address, shared by all zones.  A NOTIFY
+ * that has passed the rate limiter waits on 'pending' while 'window'
+ * messages to the destination are already in flight.
+ */
+struct dns_notifypeer {
+	unsigned int window;
+	unsigned int ssthresh;
+	unsigned int acks;
+	unsigned int inflight;
+	ISC_LIST(dns_notify_t) pending;
+};
+
+/*%
+ * Incoming transfer state per primary address, shared by all zones.
+ * Zones waiting for transfer quota are queued on 'waiting' in order;
+ * a primary with waiting zones is on the zone manager's 'xfrinready'
+ * list, which is served round robin.
+ */
+struct dns_xfrinpeer {
+	char key[ISC_NETADDR_FORMATSIZE];
+	isc_netaddr_t addr;
+	uint32_t inprogress;
+	dns_zonelist_t waiting;
+	ISC_LINK(dns_xfrinpeer_t) link;
+};
+
 /*%
  * Hold checkds state.
  */
@@ -857,6 +1005,8 @@ dnssec_log(dns_zone_t *zone, int level, const char *fmt, ...)
 	ISC_FORMAT_PRINTF(3, 4);
 static void
 queue_xfrin(dns_zone_t *zone);
+static void
+denkeys_free(dns_zone_t *zone);
 static isc_result_t
 update_one_rr(dns_db_t *db, dns_dbversion_t *ver, dns_diff_t *diff,
 	      dns_diffop_t op, dns_name_t *name, dns_ttl_t ttl,
@@ -949,8 +1099,18 @@ static isc_result_t
 zmgr_start_xfrin_ifquota(dns_zonemgr_t *zmgr, dns_zone_t *zone);
 static void
 zmgr_resume_xfrs(dns_zonemgr_t *zmgr, bool multi);
+static dns_xfrinpeer_t *
+xfrinpeer_get(dns_zonemgr_t *zmgr, const isc_netaddr_t *addr);
+static void
+zmgr_xfrin_unlink(dns_zonemgr_t *zmgr, dns_zone_t *zone);
 static void
 zonemgr_free(dns_zonemgr_t *zmgr);
+static void
+zonemgr_timer(isc_task_t *task, isc_event_t *event);
+static void
+zone_timer_register(dns_zonemgr_t *zmgr, dns_zone_t *zone, isc_task_t *task);
+static void
+zone_timer_unregister(dns_zone_t *zone);
 static isc_result_t
 zonemgr_getio(dns_zonemgr_t *zmgr, bool high, isc_task_t *task,
 	      isc_taskaction_t action, void *arg, dns_io_t **iop);
@@ -995,6 +1155,8 @@ static void
 setrl(isc_ratelimiter_t *rl, unsigned int *rate, unsigned int value);
 static void
 zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial);
+static void
+zone_journal_sync(dns_zone_t *zone);
 static isc_result_t
 zone_journal_rollforward(dns_zone_t *zone, dns_db_t *db, bool *needdump,
 			 bool *fixjournal);
@@ -1127,6 +1289,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 			 .notifydelay = 5,
 			 .signatures = 10,
 			 .nodes = 100,
+			 .signthreads = 1,
 			 .privatetype = (dns_rdatatype_t)0xffffU,
 			 .rpz_num = DNS_RPZ_INVALID_NUM,
 			 .requestixfr = true,
@@ -1145,6 +1308,8 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	zone->mctx = NULL;
 	isc_mem_attach(mctx, &zone->mctx);
 	isc_mutex_init(&zone->lock);
+	isc_mutex_init(&zone->jlock);
+	isc_mutex_init(&zone->denlock);
 	ZONEDB_INITLOCK(&zone->dblock);
 	/* XXX MPA check that all elements are initialised */
 #ifdef DNS_ZONE_CHECKLOCK
@@ -1166,6 +1331,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	isc_time_settoepoch(&zone->refreshtime);
 	isc_time_settoepoch(&zone->dumptime);
 	isc_time_settoepoch(&zone->loadtime);
+	isc_time_settoepoch(&zone->loadstart);
 	isc_time_settoepoch(&zone->resigntime);
 	isc_time_settoepoch(&zone->keywarntime);
 	isc_time_settoepoch(&zone->signingtime);
@@ -1188,6 +1354,8 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	ISC_LIST_INIT(zone->forwards);
 	ISC_LIST_INIT(zone->rss_events);
 	ISC_LIST_INIT(zone->rss_post);
+	ISC_LIST_INIT(zone->journalwaits);
+	ISC_LIST_INIT(zone->updates);
 
 	result = isc_stats_create(mctx, &zone->gluecachestats,
 				  dns_gluecachestatscounter_max);
@@ -1209,6 +1377,8 @@ free_refs:
 	isc_refcount_destroy(&zone->erefs);
 	isc_refcount_destroy(&zone->irefs);
 	ZONEDB_DESTROYLOCK(&zone->dblock);
+	isc_mutex_destroy(&zone->denlock);
+	isc_mutex_destroy(&zone->jlock);
 	isc_mutex_destroy(&zone->lock);
 	isc_mem_putanddetach(&zone->mctx, zone, sizeof(*zone));
 	return (result);
@@ -1239,7 +1409,7 @@ zone_free(dns_zone_t *zone) {
 	isc_refcount_destroy(&zone->erefs);
 	isc_refcount_destroy(&zone->irefs);
 	REQUIRE(!LOCKED_ZONE(zone));
-	REQUIRE(zone->timer == NULL);
+	REQUIRE(zone->timerzmgr == NULL);
 	REQUIRE(zone->zmgr == NULL);
 
 	/*
@@ -1391,8 +1561,20 @@ zone_free(dns_zone_t *zone) {
 		isc_stats_detach(&zone->gluecachestats);
 	}
 
+	INSIST(zone->pendingjournal == NULL);
+	INSIST(ISC_LIST_EMPTY(zone->journalwaits));
+	INSIST(ISC_LIST_EMPTY(zone->updates));
+
+	denkeys_free(zone);
+	if (zone->densigs != NULL) {
+		isc_mem_put(zone->mctx, zone->densigs,
+			    DENSIG_SLOTS * sizeof(zone->densigs[0]));
+	}
+
 	/* last stuff */
 	ZONEDB_DESTROYLOCK(&zone->dblock);
+	isc_mutex_destroy(&zone->denlock);
+	isc_mutex_destroy(&zone->jlock);
 	isc_mutex_destroy(&zone->lock);
 	zone->magic = 0;
 	isc_mem_putanddetach(&zone->mctx, zone, sizeof(*zone));
@@ -1948,6 +2130,7 @@ dns_zone_rpz_enable_db(dns_zone_t *zone, dns_db_t *db) {
 		return;
 	}
 	REQUIRE(zone->rpzs != NULL);
+	dns_rpz_setjournal(zone->rpzs->zones[zone->rpz_num], zone->journal);
 	result = dns_db_updatenotify_register(db, dns_rpz_dbupdate_callback,
 					      zone->rpzs->zones[zone->rpz_num]);
 	REQUIRE(result == ISC_R_SUCCESS);
@@ -1972,6 +2155,11 @@ dns_zone_catz_enable_db(dns_zone_t *zone, dns_db_t *db) {
 	REQUIRE(db != NULL);
 
 	if (zone->catzs != NULL) {
+		dns_catz_zone_t *catz = dns_catz_get_zone(zone->catzs,
+							  &zone->origin);
+		if (catz != NULL) {
+			dns_catz_zone_setjournal(catz, zone->journal);
+		}
 		dns_db_updatenotify_register(db, dns_catz_dbupdate_callback,
 					     zone->catzs);
 	}
@@ -2343,6 +2531,16 @@ zone_load(dns_zone_t *zone, unsigned int flags, bool locked) {
 	}
 	dns_db_settask(db, zone->task);
 
+	/*
+	 * When reloading, expect the zone to be about as large as it was.
+	 */
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	if (zone->db != NULL) {
+		dns_db_setsizehint(db,
+				   dns_db_nodecount(zone->db, dns_dbtree_main));
+	}
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+
 	if (zone->type == dns_zone_primary ||
 	    zone->type == dns_zone_secondary || zone->type == dns_zone_mirror)
 	{
@@ -2357,6 +2555,7 @@ zone_load(dns_zone_t *zone, unsigned int flags, bool locked) {
 
 	if (!dns_db_ispersistent(db)) {
 		if (zone->masterfile != NULL || zone->stream != NULL) {
+			TIME_NOW(&zone->loadstart);
 			result = zone_startload(db, zone, loadtime);
 		} else {
 			result = DNS_R_NOMASTERFILE;
@@ -4514,6 +4713,7 @@ zone_journal(dns_zone_t *zone, dns_diff_t *diff, uint32_t *sourceserial,
 	unsigned int mode = DNS_JOURNAL_CREATE | DNS_JOURNAL_WRITE;
 
 	ENTER;
+	zone_journal_sync(zone);
 	journalfile = dns_zone_getjournal(zone);
 	if (journalfile != NULL) {
 		result = dns_journal_open(zone->mctx, journalfile, mode,
@@ -4885,7 +5085,7 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 	unsigned int nscount = 0;
 	unsigned int errors = 0;
 	uint32_t serial, oldserial, refresh, retry, expire, minimum, soattl;
-	isc_time_t now;
+	isc_time_t now, loadstart;
 	bool needdump = false;
 	bool fixjournal = false;
 	bool hasinclude = DNS_ZONE_FLAG(zone, DNS_ZONEFLG_HASINCLUDE);
@@ -4900,6 +5100,8 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 	}
 
 	TIME_NOW(&now);
+	loadstart = zone->loadstart;
+	isc_time_settoepoch(&zone->loadstart);
 
 	/*
 	 * Initiate zone transfer?  We may need a error code that
@@ -5398,6 +5600,11 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 			      "loaded serial %u%s", serial,
 			      dns_db_issecure(db) ? " (DNSSEC signed)" : "");
 	}
+	if (!isc_time_isepoch(&loadstart)) {
+		dns_zone_logc(zone, DNS_LOGCATEGORY_ZONELOAD, ISC_LOG_DEBUG(1),
+			      "loading took %" PRIu64 " ms",
+			      isc_time_microdiff(&now, &loadstart) / 1000);
+	}
 
 	if (!had_db && zone->type == dns_zone_mirror) {
 		dns_zone_logc(zone, DNS_LOGCATEGORY_ZONELOAD, ISC_LOG_INFO,
@@ -6930,11 +7137,215 @@ failure:
 	return (result);
 }
 
+/*
+ * Run 'work' for every index below 'count' using up to 'nthreads'
+ * threads, including the calling one, and return when all are done.
+ * Used to spread the CPU-bound part of a quantum (signing, NSEC3
+ * hashing) over several threads while the zone task still applies
+ * the results in order.
+ */
+typedef void (*forkjoin_work_t)(void *arg, uint_fast32_t i);
+
+typedef struct {
+	forkjoin_work_t work;
+	void *arg;
+	uint_fast32_t count;
+	atomic_uint_fast32_t next;
+} forkjoin_t;
+
+static isc_threadresult_t
+forkjoin_thread(isc_threadarg_t arg) {
+	forkjoin_t *fj = (forkjoin_t *)arg;
+	uint_fast32_t i;
+
+	while ((i = atomic_fetch_add_relaxed(&fj->next, 1)) < fj->count) {
+		(fj->work)(fj->arg, i);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+forkjoin_run(isc_mem_t *mctx, unsigned int nthreads, uint_fast32_t count,
+	     forkjoin_work_t work, void *arg) {
+	forkjoin_t fj = { .work = work, .arg = arg, .count = count };
+	isc_thread_t *threads = NULL;
+	unsigned int nextra = 0;
+	unsigned int i;
+
+	if (count == 0) {
+		return;
+	}
+
+	atomic_init(&fj.next, 0);
+
+	nextra = ISC_MIN(nthreads, count) - 1;
+	if (nextra > 0) {
+		threads = isc_mem_get(mctx, nextra * sizeof(threads[0]));
+		for (i = 0; i < nextra; i++) {
+			isc_thread_create(forkjoin_thread, &fj, &threads[i]);
+		}
+	}
+	(void)forkjoin_thread(&fj);
+	for (i = 0; i < nextra; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	if (threads != NULL) {
+		isc_mem_put(mctx, threads, nextra * sizeof(threads[0]));
+	}
+}
+
+/*
+ * When zone_sign() or zone_resigninc() may use more than one thread,
+ * sign_a_node() and add_sigs() do not sign RRsets themselves but queue
+ * them as sign jobs; at the end of the quantum the signatures are
+ * computed in parallel, and then added to the zone in the order they
+ * were queued.  With keys held in an HSM this keeps several signing
+ * operations in flight at once.
+ */
+typedef struct signjob signjob_t;
+typedef ISC_LIST(signjob_t) signjoblist_t;
+
+struct signjob {
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dns_rdataset_t rdataset;
+	dst_key_t *key;
+	isc_stdtime_t inception;
+	isc_stdtime_t expire;
+	isc_mem_t *mctx;
+	isc_result_t result;
+	dns_rdata_t rdata;
+	unsigned char data[1024];
+	ISC_LINK(signjob_t) link;
+};
+
+static void
+signjob_queue(signjoblist_t *jobs, const dns_name_t *name,
+	      dns_rdataset_t *rdataset, dst_key_t *key,
+	      isc_stdtime_t inception, isc_stdtime_t expire, isc_mem_t *mctx) {
+	signjob_t *job = isc_mem_get(mctx, sizeof(*job));
+
+	*job = (signjob_t){
+		.key = key,
+		.inception = inception,
+		.expire = expire,
+		.mctx = mctx,
+		.result = ISC_R_UNSET,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	job->name = dns_fixedname_initname(&job->fname);
+	dns_name_copy(name, job->name);
+	dns_rdataset_init(&job->rdataset);
+	dns_rdataset_clone(rdataset, &job->rdataset);
+	dns_rdata_init(&job->rdata);
+	ISC_LIST_APPEND(*jobs, job, link);
+}
+
+static bool
+signjob_find(signjoblist_t *jobs, const dns_name_t *name,
+	     dns_rdatatype_t type) {
+	signjob_t *job = NULL;
+
+	for (job = ISC_LIST_HEAD(*jobs); job != NULL;
+	     job = ISC_LIST_NEXT(job, link))
+	{
+		if (job->rdataset.type == type &&
+		    dns_name_equal(job->name, name))
+		{
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+static void
+signjob_freeall(signjoblist_t *jobs) {
+	signjob_t *job = NULL;
+
+	while ((job = ISC_LIST_HEAD(*jobs)) != NULL) {
+		ISC_LIST_UNLINK(*jobs, job, link);
+		dns_rdataset_disassociate(&job->rdataset);
+		isc_mem_put(job->mctx, job, sizeof(*job));
+	}
+}
+
+static void
+signjob_work(void *arg, uint_fast32_t i) {
+	signjob_t *job = ((signjob_t **)arg)[i];
+	isc_buffer_t buffer;
+
+	isc_buffer_init(&buffer, job->data, sizeof(job->data));
+	job->result = dns_dnssec_sign(job->name, &job->rdataset, job->key,
+				      &job->inception, &job->expire, job->mctx,
+				      &buffer, &job->rdata);
+}
+
+/*
+ * Compute the signatures for 'jobs' using up to 'nthreads' threads,
+ * including the calling one, and add them to 'diff'.
+ */
+static isc_result_t
+signjob_run(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *version,
+	    signjoblist_t *jobs, unsigned int nthreads, dns_diff_t *diff) {
+	signjob_t **array = NULL;
+	uint_fast32_t count = 0;
+	dns_stats_t *dnssecsignstats;
+	isc_result_t result = ISC_R_SUCCESS;
+	signjob_t *job = NULL;
+	uint_fast32_t i;
+
+	for (job = ISC_LIST_HEAD(*jobs); job != NULL;
+	     job = ISC_LIST_NEXT(job, link))
+	{
+		count++;
+	}
+	if (count == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	array = isc_mem_get(zone->mctx, count * sizeof(array[0]));
+	for (i = 0, job = ISC_LIST_HEAD(*jobs); job != NULL;
+	     job = ISC_LIST_NEXT(job, link))
+	{
+		array[i++] = job;
+	}
+
+	forkjoin_run(zone->mctx, nthreads, count, signjob_work, array);
+
+	dnssecsignstats = dns_zone_getdnssecsignstats(zone);
+	for (i = 0; i < count; i++) {
+		job = array[i];
+		CHECK(job->result);
+		/* Update the database and journal with the RRSIG. */
+		CHECK(update_one_rr(db, version, diff, DNS_DIFFOP_ADDRESIGN,
+				    job->name, job->rdataset.ttl,
+				    &job->rdata));
+
+		/* Update DNSSEC sign statistics. */
+		if (dnssecsignstats != NULL) {
+			dns_dnssecsignstats_increment(
+				dnssecsignstats, ID(job->key), ALG(job->key),
+				dns_dnssecsignstats_sign);
+			dns_dnssecsignstats_increment(
+				dnssecsignstats, ID(job->key), ALG(job->key),
+				dns_dnssecsignstats_refresh);
+		}
+	}
+
+failure:
+	isc_mem_put(zone->mctx, array, count * sizeof(array[0]));
+	signjob_freeall(jobs);
+	return (result);
+}
+
 static isc_result_t
 add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name, dns_zone_t *zone,
 	 dns_rdatatype_t type, dns_diff_t *diff, dst_key_t **keys,
 	 unsigned int nkeys, isc_mem_t *mctx, isc_stdtime_t inception,
-	 isc_stdtime_t expire, bool check_ksk, bool keyset_kskonly) {
+	 isc_stdtime_t expire, bool check_ksk, bool keyset_kskonly,
+	 signjoblist_t *jobs) {
 	isc_result_t result;
 	dns_dbnode_t *node = NULL;
 	dns_stats_t *dnssecsignstats;
@@ -7159,6 +7570,12 @@ add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name, dns_zone_t *zone,
 			continue;
 		}
 
+		if (jobs != NULL) {
+			signjob_queue(jobs, name, &rdataset, keys[i],
+				      inception, expire, mctx);
+			continue;
+		}
+
 		/* Calculate the signature, creating a RRSIG RDATA. */
 		isc_buffer_clear(&buffer);
 		CHECK(dns_dnssec_sign(name, &rdataset, keys[i], &inception,
@@ -7197,6 +7614,32 @@ failure:
 	return (result);
 }
 
+/*
+ * Return the number of RRsets that zone_resigninc() may re-sign now,
+ * refilling the zone's budget at 'resignrate' RRsets per second.
+ */
+static uint32_t
+resign_budget(dns_zone_t *zone, isc_stdtime_t now) {
+	uint64_t tokens;
+
+	if (zone->resignrate == 0) {
+		return (UINT32_MAX);
+	}
+
+	if (now > zone->resignrefill) {
+		tokens = zone->resigntokens +
+			 (uint64_t)(now - zone->resignrefill) *
+				 zone->resignrate;
+		zone->resigntokens = (uint32_t)ISC_MIN(tokens,
+						       zone->resignrate);
+		zone->resignrefill = now;
+	} else if (zone->resigntokens > zone->resignrate) {
+		zone->resigntokens = zone->resignrate;
+	}
+
+	return (zone->resigntokens);
+}
+
 static void
 zone_resigninc(dns_zone_t *zone) {
 	const char *me = "zone_resigninc";
@@ -7216,9 +7659,18 @@ zone_resigninc(dns_zone_t *zone) {
 	unsigned int i;
 	unsigned int nkeys = 0;
 	unsigned int resign;
+	uint32_t budget, resigned = 0;
+	bool backlog = false, throttled = false;
+	signjoblist_t signjobs;
+	signjoblist_t *jobs = NULL;
 
 	ENTER;
 
+	ISC_LIST_INIT(signjobs);
+	if (zone->signthreads > 1) {
+		jobs = &signjobs;
+	}
+
 	dns_rdataset_init(&rdataset);
 	dns_diff_init(zone->mctx, &_sig_diff);
 	zonediff_init(&zonediff, &_sig_diff);
@@ -7296,6 +7748,7 @@ zone_resigninc(dns_zone_t *zone) {
 		expire = fullexpire = soaexpire - 1;
 	}
 	stop = now + 5;
+	budget = resign_budget(zone, now);
 
 	check_ksk = DNS_ZONE_OPTION(zone, DNS_ZONEOPT_UPDATECHECKKSK);
 	keyset_kskonly = DNS_ZONE_OPTION(zone, DNS_ZONEOPT_DNSKEYKSKONLY);
@@ -7323,11 +7776,40 @@ zone_resigninc(dns_zone_t *zone) {
 		/* XXXMPA increase number of RRsets signed pre call */
 		if ((covers == dns_rdatatype_soa &&
 		     dns_name_equal(name, &zone->origin)) ||
-		    i++ > zone->signatures || resign > stop)
+		    resign > stop)
 		{
 			break;
 		}
 
+		/*
+		 * More RRsets are due than we may re-sign in this call:
+		 * remember that we are behind so that the backlog gets
+		 * spread over the re-signing window.
+		 */
+		if (i++ > zone->signatures * zone->signthreads ||
+		    resigned >= budget)
+		{
+			backlog = true;
+			throttled = (resigned >= budget);
+			break;
+		}
+		resigned++;
+
+		/*
+		 * Don't queue the same RRset twice: if it is due again,
+		 * sign what has been queued so far first.
+		 */
+		if (jobs != NULL && signjob_find(jobs, name, covers)) {
+			result = signjob_run(zone, db, version, jobs,
+					     zone->signthreads, zonediff.diff);
+			if (result != ISC_R_SUCCESS) {
+				dns_zone_log(zone, ISC_LOG_ERROR,
+					     "zone_resigninc:signjob_run -> %s",
+					     isc_result_totext(result));
+				break;
+			}
+		}
+
 		result = del_sigs(zone, db, version, name, covers, &zonediff,
 				  zone_keys, nkeys, now, true);
 		if (result != ISC_R_SUCCESS) {
@@ -7338,16 +7820,19 @@ zone_resigninc(dns_zone_t *zone) {
 		}
 
 		/*
-		 * If re-signing is over 5 minutes late use 'fullexpire'
-		 * to redistribute the signature over the complete
-		 * re-signing window, otherwise only add a small amount
-		 * of jitter.
+		 * If re-signing is over 5 minutes late, or the previous
+		 * call could not keep up with the RRsets that were due,
+		 * use 'fullexpire' to redistribute the signature over the
+		 * complete re-signing window, otherwise only add a small
+		 * amount of jitter.
 		 */
 		result = add_sigs(db, version, name, zone, covers,
 				  zonediff.diff, zone_keys, nkeys, zone->mctx,
 				  inception,
-				  resign > (now - 300) ? expire : fullexpire,
-				  check_ksk, keyset_kskonly);
+				  (resign > (now - 300) && !zone->resignbacklog)
+					  ? expire
+					  : fullexpire,
+				  check_ksk, keyset_kskonly, jobs);
 		if (result != ISC_R_SUCCESS) {
 			dns_zone_log(zone, ISC_LOG_ERROR,
 				     "zone_resigninc:add_sigs -> %s",
@@ -7371,6 +7856,17 @@ zone_resigninc(dns_zone_t *zone) {
 		goto failure;
 	}
 
+	if (jobs != NULL) {
+		result = signjob_run(zone, db, version, jobs,
+				     zone->signthreads, zonediff.diff);
+		if (result != ISC_R_SUCCESS) {
+			dns_zone_log(zone, ISC_LOG_ERROR,
+				     "zone_resigninc:signjob_run -> %s",
+				     isc_result_totext(result));
+			goto failure;
+		}
+	}
+
 	result = del_sigs(zone, db, version, &zone->origin, dns_rdatatype_soa,
 			  &zonediff, zone_keys, nkeys, now, true);
 	if (result != ISC_R_SUCCESS) {
@@ -7409,7 +7905,8 @@ zone_resigninc(dns_zone_t *zone) {
 	 */
 	result = add_sigs(db, version, &zone->origin, zone, dns_rdatatype_soa,
 			  zonediff.diff, zone_keys, nkeys, zone->mctx,
-			  inception, soaexpire, check_ksk, keyset_kskonly);
+			  inception, soaexpire, check_ksk, keyset_kskonly,
+			  NULL);
 	if (result != ISC_R_SUCCESS) {
 		dns_zone_log(zone, ISC_LOG_ERROR,
 			     "zone_resigninc:add_sigs -> %s",
@@ -7424,6 +7921,7 @@ zone_resigninc(dns_zone_t *zone) {
 	dns_db_closeversion(db, &version, true);
 
 failure:
+	signjob_freeall(&signjobs);
 	dns_diff_clear(&_sig_diff);
 	for (i = 0; i < nkeys; i++) {
 		dst_key_free(&zone_keys[i]);
@@ -7435,9 +7933,26 @@ failure:
 		dns_db_detach(&db);
 	}
 
+	if (zone->resignrate != 0) {
+		zone->resigntokens -= ISC_MIN(resigned, zone->resigntokens);
+	}
+	zone->resignbacklog = backlog;
+
 	LOCK_ZONE(zone);
 	if (result == ISC_R_SUCCESS) {
 		set_resigntime(zone);
+		if (throttled) {
+			/*
+			 * Out of budget: wait for it to be refilled.
+			 */
+			isc_interval_t ival;
+			isc_time_t next;
+			isc_interval_set(&ival, 1, 0);
+			isc_time_nowplusinterval(&next, &ival);
+			if (isc_time_compare(&zone->resigntime, &next) < 0) {
+				zone->resigntime = next;
+			}
+		}
 		zone_needdump(zone, DNS_DUMP_DELAY);
 		DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_NEEDNOTIFY);
 	} else {
@@ -7647,7 +8162,7 @@ sign_a_node(dns_db_t *db, dns_zone_t *zone, dns_name_t *name,
 	    bool build_nsec, dst_key_t *key, isc_stdtime_t inception,
 	    isc_stdtime_t expire, dns_ttl_t nsecttl, bool is_ksk, bool is_zsk,
 	    bool keyset_kskonly, bool is_bottom_of_zone, dns_diff_t *diff,
-	    int32_t *signatures, isc_mem_t *mctx) {
+	    int32_t *signatures, signjoblist_t *jobs, isc_mem_t *mctx) {
 	isc_result_t result;
 	dns_rdatasetiter_t *iterator = NULL;
 	dns_rdataset_t rdataset;
@@ -7762,6 +8277,13 @@ sign_a_node(dns_db_t *db, dns_zone_t *zone, dns_name_t *name,
 			goto next_rdataset;
 		}
 
+		if (jobs != NULL) {
+			signjob_queue(jobs, name, &rdataset, key, inception,
+				      expire, mctx);
+			(*signatures)--;
+			goto next_rdataset;
+		}
+
 		/* Calculate the signature, creating a RRSIG RDATA. */
 		isc_buffer_clear(&buffer);
 		CHECK(dns_dnssec_sign(name, &rdataset, key, &inception, &expire,
@@ -8347,7 +8869,7 @@ dns__zone_updatesigs(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *version,
 		result = add_sigs(db, version, &tuple->name, zone,
 				  tuple->rdata.type, zonediff->diff, zone_keys,
 				  nkeys, zone->mctx, inception, exp, check_ksk,
-				  keyset_kskonly);
+				  keyset_kskonly, NULL);
 		if (result != ISC_R_SUCCESS) {
 			dns_zone_log(zone, ISC_LOG_ERROR,
 				     "dns__zone_updatesigs:add_sigs -> %s",
@@ -8371,6 +8893,116 @@ dns__zone_updatesigs(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *version,
  * Incrementally build and sign a new NSEC3 chain using the parameters
  * requested.
  */
+/*
+ * When zone_nsec3chain() may use more than one thread, the NSEC3 hashes
+ * of the nodes that the chain being built will visit next are computed
+ * in parallel, ahead of dns_nsec3_addnsec3hash() needing them.
+ */
+#define NSEC3PREHASH_MAX 1024
+
+typedef struct {
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
+	size_t hashlength;
+	isc_result_t result;
+} nsec3prehash_t;
+
+typedef struct {
+	const dns_nsec3chain_t *chain;
+	nsec3prehash_t *entries;
+	unsigned int size;
+	unsigned int count;
+	unsigned int cursor;
+} nsec3prehashes_t;
+
+static void
+nsec3prehash_work(void *arg, uint_fast32_t i) {
+	nsec3prehashes_t *prehashes = (nsec3prehashes_t *)arg;
+	nsec3prehash_t *entry = &prehashes->entries[i];
+	const dns_rdata_nsec3param_t *param = &prehashes->chain->nsec3param;
+	dns_fixedname_t fixed;
+
+	entry->hashlength = sizeof(entry->hash);
+	entry->result = dns_nsec3_hashname(
+		&fixed, entry->hash, &entry->hashlength, entry->name,
+		dns_rootname, param->hash, param->iterations, param->salt,
+		param->salt_length);
+}
+
+/*
+ * Return the precomputed hash of 'name' in 'chain', hashing 'name' and
+ * the nodes following it first if it is not known yet.
+ */
+static const nsec3prehash_t *
+nsec3prehash_get(dns_zone_t *zone, dns_db_t *db, nsec3prehashes_t *prehashes,
+		 const dns_nsec3chain_t *chain, const dns_name_t *name) {
+	dns_dbiterator_t *dbit = NULL;
+	dns_dbnode_t *node = NULL;
+	nsec3prehash_t *entry = NULL;
+	isc_result_t result;
+	unsigned int i;
+
+	if (prehashes->chain == chain) {
+		for (i = prehashes->cursor; i < prehashes->count; i++) {
+			entry = &prehashes->entries[i];
+			if (dns_name_equal(entry->name, name)) {
+				prehashes->cursor = i + 1;
+				return (entry->result == ISC_R_SUCCESS ? entry
+								       : NULL);
+			}
+		}
+	}
+
+	if (prehashes->entries == NULL) {
+		prehashes->size = ISC_MIN(zone->nodes, NSEC3PREHASH_MAX);
+		prehashes->entries = isc_mem_get(
+			zone->mctx,
+			prehashes->size * sizeof(prehashes->entries[0]));
+	}
+	prehashes->chain = chain;
+	prehashes->count = 0;
+	prehashes->cursor = 0;
+
+	result = dns_db_createiterator(db, DNS_DB_NONSEC3, &dbit);
+	if (result != ISC_R_SUCCESS) {
+		return (NULL);
+	}
+	result = dns_dbiterator_seek(dbit, name);
+	while (result == ISC_R_SUCCESS && prehashes->count < prehashes->size) {
+		entry = &prehashes->entries[prehashes->count++];
+		entry->name = dns_fixedname_initname(&entry->fname);
+		dns_dbiterator_current(dbit, &node, entry->name);
+		dns_db_detachnode(db, &node);
+		result = dns_dbiterator_next(dbit);
+	}
+	dns_dbiterator_destroy(&dbit);
+
+	forkjoin_run(zone->mctx, zone->signthreads, prehashes->count,
+		     nsec3prehash_work, prehashes);
+
+	if (prehashes->count == 0) {
+		return (NULL);
+	}
+	entry = &prehashes->entries[0];
+	if (!dns_name_equal(entry->name, name) ||
+	    entry->result != ISC_R_SUCCESS)
+	{
+		return (NULL);
+	}
+	prehashes->cursor = 1;
+	return (entry);
+}
+
+static void
+nsec3prehash_free(dns_zone_t *zone, nsec3prehashes_t *prehashes) {
+	if (prehashes->entries != NULL) {
+		isc_mem_put(zone->mctx, prehashes->entries,
+			    prehashes->size * sizeof(prehashes->entries[0]));
+		prehashes->entries = NULL;
+	}
+}
+
 static void
 zone_nsec3chain(dns_zone_t *zone) {
 	const char *me = "zone_nsec3chain";
@@ -8388,6 +9020,8 @@ zone_nsec3chain(dns_zone_t *zone) {
 	dns_rdataset_t rdataset;
 	dns_nsec3chain_t *nsec3chain = NULL, *nextnsec3chain;
 	dns_nsec3chainlist_t cleanup;
+	nsec3prehashes_t prehashes = { .chain = NULL };
+	const nsec3prehash_t *prehash = NULL;
 	dst_key_t *zone_keys[DNS_MAXZONEKEYS];
 	int32_t signatures;
 	bool check_ksk, keyset_kskonly;
@@ -8644,9 +9278,21 @@ zone_nsec3chain(dns_zone_t *zone) {
 		 * Process one node.
 		 */
 		dns_dbiterator_pause(nsec3chain->dbiterator);
-		result = dns_nsec3_addnsec3(
-			db, version, name, &nsec3chain->nsec3param,
-			zone_nsecttl(zone), unsecure, &nsec3_diff);
+		prehash = NULL;
+		if (zone->signthreads > 1) {
+			prehash = nsec3prehash_get(zone, db, &prehashes,
+						   nsec3chain, name);
+		}
+		if (prehash != NULL) {
+			result = dns_nsec3_addnsec3hash(
+				db, version, name, &nsec3chain->nsec3param,
+				zone_nsecttl(zone), unsecure, prehash->hash,
+				prehash->hashlength, &nsec3_diff);
+		} else {
+			result = dns_nsec3_addnsec3(
+				db, version, name, &nsec3chain->nsec3param,
+				zone_nsecttl(zone), unsecure, &nsec3_diff);
+		}
 		if (result != ISC_R_SUCCESS) {
 			dnssec_log(zone, ISC_LOG_ERROR,
 				   "zone_nsec3chain:"
@@ -9122,7 +9768,8 @@ skip_removals:
 
 	result = add_sigs(db, version, &zone->origin, zone, dns_rdatatype_soa,
 			  zonediff.diff, zone_keys, nkeys, zone->mctx,
-			  inception, soaexpire, check_ksk, keyset_kskonly);
+			  inception, soaexpire, check_ksk, keyset_kskonly,
+			  NULL);
 	if (result != ISC_R_SUCCESS) {
 		dnssec_log(zone, ISC_LOG_ERROR,
 			   "zone_nsec3chain:add_sigs -> %s",
@@ -9228,6 +9875,7 @@ failure:
 	dns_diff_clear(&nsec3_diff);
 	dns_diff_clear(&nsec_diff);
 	dns_diff_clear(&_sig_diff);
+	nsec3prehash_free(zone, &prehashes);
 
 	if (iterator != NULL) {
 		dns_rdatasetiter_destroy(&iterator);
@@ -9505,6 +10153,7 @@ zone_sign(dns_zone_t *zone) {
 	unsigned int i, j;
 	unsigned int nkeys = 0;
 	uint32_t nodes;
+	signjoblist_t signjobs;
 
 	ENTER;
 
@@ -9515,6 +10164,7 @@ zone_sign(dns_zone_t *zone) {
 	dns_diff_init(zone->mctx, &post_diff);
 	zonediff_init(&zonediff, &_sig_diff);
 	ISC_LIST_INIT(cleanup);
+	ISC_LIST_INIT(signjobs);
 
 	/*
 	 * Updates are disabled.  Pause for 1 minute.
@@ -9586,7 +10236,7 @@ zone_sign(dns_zone_t *zone) {
 	 * for this quantum.
 	 */
 	nodes = zone->nodes;
-	signatures = zone->signatures;
+	signatures = zone->signatures * zone->signthreads;
 	signing = ISC_LIST_HEAD(zone->signing);
 	first = true;
 
@@ -9853,7 +10503,9 @@ zone_sign(dns_zone_t *zone) {
 				build_nsec, zone_keys[i], inception, expire,
 				zone_nsecttl(zone), is_ksk, is_zsk,
 				(both && keyset_kskonly), is_bottom_of_zone,
-				zonediff.diff, &signatures, zone->mctx));
+				zonediff.diff, &signatures,
+				zone->signthreads > 1 ? &signjobs : NULL,
+				zone->mctx));
 			/*
 			 * If we are adding we are done.  Look for other keys
 			 * of the same algorithm if deleting.
@@ -9938,6 +10590,12 @@ zone_sign(dns_zone_t *zone) {
 		first = true;
 	}
 
+	/*
+	 * Compute the signatures queued by sign_a_node().
+	 */
+	CHECK(signjob_run(zone, db, version, &signjobs, zone->signthreads,
+			  zonediff.diff));
+
 	if (ISC_LIST_HEAD(post_diff.tuples) != NULL) {
 		result = dns__zone_updatesigs(&post_diff, db, version,
 					      zone_keys, nkeys, zone, inception,
@@ -9987,7 +10645,8 @@ zone_sign(dns_zone_t *zone) {
 	 */
 	result = add_sigs(db, version, &zone->origin, zone, dns_rdatatype_soa,
 			  zonediff.diff, zone_keys, nkeys, zone->mctx,
-			  inception, soaexpire, check_ksk, keyset_kskonly);
+			  inception, soaexpire, check_ksk, keyset_kskonly,
+			  NULL);
 	if (result != ISC_R_SUCCESS) {
 		dnssec_log(zone, ISC_LOG_ERROR, "zone_sign:add_sigs -> %s",
 			   isc_result_totext(result));
@@ -10068,6 +10727,7 @@ cleanup:
 		signing = ISC_LIST_HEAD(cleanup);
 	}
 
+	signjob_freeall(&signjobs);
 	dns_diff_clear(&_sig_diff);
 
 	for (i = 0; i < nkeys; i++) {
@@ -11704,10 +12364,61 @@ dns_zone_refresh(dns_zone_t *zone) {
 	UNLOCK_ZONE(zone);
 }
 
-static isc_result_t
-zone_journal_rollforward(dns_zone_t *zone, dns_db_t *db, bool *needdump,
-			 bool *fixjournal) {
-	dns_journal_t *journal = NULL;
+void
+dns_zone_setprimaryserial(dns_zone_t *zone, uint32_t serial) {
+	const char me[] = "dns_zone_setprimaryserial";
+	isc_result_t result = DNS_R_NOTLOADED;
+	isc_time_t now;
+	uint32_t oldserial = 0;
+	unsigned int soacount = 0;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	if ((zone->type != dns_zone_secondary &&
+	     zone->type != dns_zone_mirror) ||
+	    !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NOREFRESH) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_REFRESH))
+	{
+		UNLOCK_ZONE(zone);
+		return;
+	}
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	if (zone->db != NULL) {
+		result = zone_get_from_db(zone, zone->db, NULL, &soacount,
+					  NULL, &oldserial, NULL, NULL, NULL,
+					  NULL, NULL);
+	}
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+	if (result != ISC_R_SUCCESS || soacount == 0) {
+		UNLOCK_ZONE(zone);
+		return;
+	}
+
+	if (isc_serial_gt(serial, oldserial)) {
+		dns_zone_log(zone, ISC_LOG_INFO,
+			     "primary has serial %u > ours (%u), refreshing",
+			     serial, oldserial);
+		zone_refresh(zone);
+	} else if (isc_serial_eq(serial, oldserial)) {
+		/*
+		 * Treat this as a successful refresh check and skip
+		 * the next SOA query.
+		 */
+		zone_debuglog(zone, me, 1, "serial %u is current", serial);
+		TIME_NOW(&now);
+		DNS_ZONE_JITTER_ADD(&now, zone->refresh, &zone->refreshtime);
+		zone_settimer(zone, &now);
+	}
+	UNLOCK_ZONE(zone);
+}
+
+static isc_result_t
+zone_journal_rollforward(dns_zone_t *zone, dns_db_t *db, bool *needdump,
+			 bool *fixjournal) {
+	dns_journal_t *journal = NULL;
 	unsigned int options;
 	isc_result_t result;
 
@@ -11720,6 +12431,7 @@ zone_journal_rollforward(dns_zone_t *zone, dns_db_t *db, bool *needdump,
 		options = 0;
 	}
 
+	zone_journal_sync(zone);
 	result = dns_journal_open(zone->mctx, zone->journal, DNS_JOURNAL_READ,
 				  &journal);
 	if (result == ISC_R_NOTFOUND) {
@@ -11793,6 +12505,8 @@ zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial) {
 		INSIST(LOCKED_ZONE(zone->secure));
 	}
 
+	zone_journal_sync(zone);
+
 	journalsize = zone->journalsize;
 	if (journalsize == -1) {
 		journalsize = DNS_JOURNAL_SIZE_MAX;
@@ -12177,6 +12891,9 @@ dumptostream(dns_zone_t *zone, FILE *fd, const dns_master_style_t *style,
 		rawdata.flags = DNS_MASTERRAW_SOURCESERIALSET;
 		rawdata.sourceserial = zone->sourceserial;
 	}
+	if (rawversion == 2) {
+		rawdata.flags |= DNS_MASTERRAW_CHUNKED;
+	}
 	result = dns_master_dumptostream(zone->mctx, db, version, style, format,
 					 &rawdata, fd);
 	dns_db_closeversion(db, &version, false);
@@ -12441,12 +13158,163 @@ notify_isself(dns_zone_t *zone, isc_sockaddr_t *dst) {
 	return (isself);
 }
 
+/*
+ * Find or create the NOTIFY state for 'dst'.
+ *
+ * Requires zmgr->notifylock.
+ */
+static dns_notifypeer_t *
+notifypeer_get(dns_zonemgr_t *zmgr, const isc_sockaddr_t *dst) {
+	char key[ISC_SOCKADDR_FORMATSIZE];
+	dns_notifypeer_t *peer = NULL;
+	isc_result_t result;
+
+	isc_sockaddr_format(dst, key, sizeof(key));
+	result = isc_ht_find(zmgr->notifypeers, (unsigned char *)key,
+			     strlen(key), (void **)&peer);
+	if (result == ISC_R_SUCCESS) {
+		return (peer);
+	}
+
+	peer = isc_mem_get(zmgr->mctx, sizeof(*peer));
+	*peer = (dns_notifypeer_t){
+		.window = NOTIFY_WINDOW_INIT,
+		.ssthresh = NOTIFY_WINDOW_MAX,
+	};
+	ISC_LIST_INIT(peer->pending);
+	result = isc_ht_add(zmgr->notifypeers, (unsigned char *)key,
+			    strlen(key), peer);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	return (peer);
+}
+
+/*
+ * Called once 'notify' has passed the rate limiter.  Return true if it
+ * can be sent now; otherwise it waits until a NOTIFY in flight to the
+ * same destination completes, and notify_release() sends it again.
+ */
+static bool
+notify_admit(dns_notify_t *notify) {
+	dns_zonemgr_t *zmgr = notify->zone->zmgr;
+	dns_notifypeer_t *peer = NULL;
+	bool admitted = true;
+
+	if (notify->peer != NULL) {
+		/* Already given a slot by notify_release(). */
+		return (true);
+	}
+
+	LOCK(&zmgr->notifylock);
+	peer = notifypeer_get(zmgr, &notify->dst);
+	notify->peer = peer;
+	if (peer->inflight < peer->window) {
+		peer->inflight++;
+	} else {
+		ISC_LIST_APPEND(peer->pending, notify, peerlink);
+		admitted = false;
+	}
+	UNLOCK(&zmgr->notifylock);
+
+	return (admitted);
+}
+
+/*
+ * Give up the slot held by 'notify', and start as many of the NOTIFY
+ * messages waiting for the same destination as its window allows.
+ */
+static void
+notify_release(dns_notify_t *notify) {
+	dns_zonemgr_t *zmgr = notify->zone->zmgr;
+	dns_notifypeer_t *peer = notify->peer;
+	dns_notify_t *next = NULL;
+
+	LOCK(&zmgr->notifylock);
+	if (ISC_LINK_LINKED(notify, peerlink)) {
+		ISC_LIST_UNLINK(peer->pending, notify, peerlink);
+	} else {
+		INSIST(peer->inflight > 0);
+		peer->inflight--;
+	}
+	while (peer->inflight < peer->window &&
+	       (next = ISC_LIST_HEAD(peer->pending)) != NULL)
+	{
+		isc_event_t *e = NULL;
+
+		ISC_LIST_UNLINK(peer->pending, next, peerlink);
+		peer->inflight++;
+		e = isc_event_allocate(next->mctx, NULL,
+				       DNS_EVENT_NOTIFYSENDTOADDR,
+				       notify_send_toaddr, next,
+				       sizeof(isc_event_t));
+		isc_task_send(next->zone->task, &e);
+	}
+	UNLOCK(&zmgr->notifylock);
+
+	notify->peer = NULL;
+}
+
+/*
+ * Adapt the window of the destination of 'notify', and the rate of
+ * the rate limiter it went through, to the outcome of its request:
+ * both grow while NOTIFY messages are answered, and are halved when
+ * one times out.
+ */
+static void
+notify_ack(dns_notify_t *notify, isc_result_t result) {
+	dns_zonemgr_t *zmgr = notify->zone->zmgr;
+	dns_notifypeer_t *peer = notify->peer;
+	bool startup = (notify->flags & DNS_NOTIFY_STARTUP) != 0;
+	isc_ratelimiter_t *rl = startup ? zmgr->startupnotifyrl
+					: zmgr->notifyrl;
+	unsigned int *rate = startup ? &zmgr->startupnotifyratecur
+				     : &zmgr->notifyratecur;
+	unsigned int *acks = startup ? &zmgr->startupnotifyacks
+				     : &zmgr->notifyacks;
+	unsigned int base;
+
+	if (peer == NULL) {
+		return;
+	}
+
+	LOCK(&zmgr->notifylock);
+	base = startup ? zmgr->startupnotifyrate : zmgr->notifyrate;
+	if (result == ISC_R_SUCCESS) {
+		if (peer->window < peer->ssthresh) {
+			peer->window++;
+		} else if (++peer->acks >= peer->window) {
+			peer->acks = 0;
+			peer->window++;
+		}
+		peer->window = ISC_MIN(peer->window, NOTIFY_WINDOW_MAX);
+
+		if (++(*acks) >= *rate && *rate < base * NOTIFY_RATE_BOOST) {
+			*acks = 0;
+			setrl(rl, rate, *rate + base);
+		}
+	} else if (result == ISC_R_TIMEDOUT) {
+		peer->ssthresh = ISC_MAX(peer->window / 2, 1);
+		peer->window = peer->ssthresh;
+		peer->acks = 0;
+
+		*acks = 0;
+		if (*rate > base) {
+			setrl(rl, rate, ISC_MAX(*rate / 2, base));
+		}
+	}
+	UNLOCK(&zmgr->notifylock);
+}
+
 static void
 notify_destroy(dns_notify_t *notify, bool locked) {
 	isc_mem_t *mctx;
 
 	REQUIRE(DNS_NOTIFY_VALID(notify));
 
+	if (notify->peer != NULL) {
+		notify_release(notify);
+	}
+
 	if (notify->zone != NULL) {
 		if (!locked) {
 			LOCK_ZONE(notify->zone);
@@ -12499,6 +13367,7 @@ notify_create(isc_mem_t *mctx, unsigned int flags, dns_notify_t **notifyp) {
 	isc_sockaddr_any(&notify->dst);
 	dns_name_init(&notify->ns, NULL);
 	ISC_LINK_INIT(notify, link);
+	ISC_LINK_INIT(notify, peerlink);
 	notify->magic = NOTIFY_MAGIC;
 	*notifyp = notify;
 	return (ISC_R_SUCCESS);
@@ -12642,6 +13511,11 @@ notify_send_toaddr(isc_task_t *task, isc_event_t *event) {
 		goto cleanup;
 	}
 
+	if (!notify_admit(notify)) {
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+
 	result = notify_createmessage(notify->zone, notify->flags, &message);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup;
@@ -13918,46 +14792,32 @@ done:
  */
 static void
 get_edns_expire(dns_zone_t *zone, dns_message_t *message, uint32_t *expirep) {
-	isc_result_t result;
-	uint32_t expire;
-	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_region_t region;
 	isc_buffer_t optbuf;
-	uint16_t optcode;
-	uint16_t optlen;
+	uint32_t expire;
 
 	REQUIRE(expirep != NULL);
 	REQUIRE(message != NULL);
 
-	if (message->opt == NULL) {
+	/*
+	 * A EDNS EXPIRE response has a length of 4.
+	 */
+	if (dns_message_getednsopt(message, DNS_OPT_EXPIRE, &region) !=
+		    ISC_R_SUCCESS ||
+	    region.length != 4)
+	{
 		return;
 	}
 
-	result = dns_rdataset_first(message->opt);
-	if (result == ISC_R_SUCCESS) {
-		dns_rdataset_current(message->opt, &rdata);
-		isc_buffer_init(&optbuf, rdata.data, rdata.length);
-		isc_buffer_add(&optbuf, rdata.length);
-		while (isc_buffer_remaininglength(&optbuf) >= 4) {
-			optcode = isc_buffer_getuint16(&optbuf);
-			optlen = isc_buffer_getuint16(&optbuf);
-			/*
-			 * A EDNS EXPIRE response has a length of 4.
-			 */
-			if (optcode != DNS_OPT_EXPIRE || optlen != 4) {
-				isc_buffer_forward(&optbuf, optlen);
-				continue;
-			}
-			expire = isc_buffer_getuint32(&optbuf);
-			dns_zone_log(zone, ISC_LOG_DEBUG(1),
-				     "got EDNS EXPIRE of %u", expire);
-			/*
-			 * Trim *expirep?
-			 */
-			if (expire < *expirep) {
-				*expirep = expire;
-			}
-			break;
-		}
+	isc_buffer_init(&optbuf, region.base, region.length);
+	isc_buffer_add(&optbuf, region.length);
+	expire = isc_buffer_getuint32(&optbuf);
+	dns_zone_log(zone, ISC_LOG_DEBUG(1), "got EDNS EXPIRE of %u", expire);
+	/*
+	 * Trim *expirep?
+	 */
+	if (expire < *expirep) {
+		*expirep = expire;
 	}
 }
 
@@ -15006,17 +15866,12 @@ zone_shutdown(isc_task_t *task, isc_event_t *event) {
 	 */
 	if (zone->zmgr != NULL) {
 		RWLOCK(&zone->zmgr->rwlock, isc_rwlocktype_write);
-		if (zone->statelist == &zone->zmgr->waiting_for_xfrin) {
-			ISC_LIST_UNLINK(zone->zmgr->waiting_for_xfrin, zone,
-					statelink);
-			linked = true;
-			zone->statelist = NULL;
-		}
 		if (zone->statelist == &zone->zmgr->xfrin_in_progress) {
-			ISC_LIST_UNLINK(zone->zmgr->xfrin_in_progress, zone,
-					statelink);
-			zone->statelist = NULL;
+			zmgr_xfrin_unlink(zone->zmgr, zone);
 			zmgr_resume_xfrs(zone->zmgr, false);
+		} else if (zone->statelist != NULL) {
+			zmgr_xfrin_unlink(zone->zmgr, zone);
+			linked = true;
 		}
 		RWUNLOCK(&zone->zmgr->rwlock, isc_rwlocktype_write);
 	}
@@ -15080,10 +15935,18 @@ zone_shutdown(isc_task_t *task, isc_event_t *event) {
 
 	forward_cancel(zone);
 
-	if (zone->timer != NULL) {
-		isc_timer_destroy(&zone->timer);
+	if (zone->timerzmgr != NULL) {
+		zone_timer_unregister(zone);
+	}
+
+	zone_journal_sync(zone);
+	LOCK(&zone->jlock);
+	zone->journalshutdown = true;
+	if (zone->journaltimer != NULL) {
+		isc_timer_destroy(&zone->journaltimer);
 		isc_refcount_decrement(&zone->irefs);
 	}
+	UNLOCK(&zone->jlock);
 
 	/*
 	 * We have now canceled everything set the flag to allow exit_check()
@@ -15136,16 +15999,179 @@ zone_timer(isc_task_t *task, isc_event_t *event) {
 
 	ENTER;
 
+	isc_profile_enter(isc_profile_zone);
 	zone_maintenance(zone);
+	isc_profile_leave(isc_profile_zone);
+
+	isc_event_free(&event);
+	dns_zone_idetach(&zone);
+}
+
+/*
+ * Zone maintenance deadlines are kept in a single heap owned by the
+ * zone manager instead of one isc_timer per zone: with hundreds of
+ * thousands of zones the per-zone timers swamp the timer manager,
+ * and most of them are rescheduled far more often than they fire.
+ * A single zone manager timer is armed for the earliest deadline;
+ * when it fires every zone that is due is sent to its own task.
+ */
+static bool
+zone_timer_higher(void *v1, void *v2) {
+	dns_zone_t *z1 = v1;
+	dns_zone_t *z2 = v2;
+
+	return (isc_time_compare(&z1->timerdue, &z2->timerdue) < 0);
+}
+
+static void
+zone_timer_index(void *what, unsigned int idx) {
+	dns_zone_t *zone = what;
+
+	zone->timerindex = idx;
+}
+
+/*
+ * Arm the zone manager timer for the head of the heap.
+ *
+ * 'zmgr->timerlock' locked by caller.
+ */
+static void
+zonemgr_timer_arm(dns_zonemgr_t *zmgr) {
+	dns_zone_t *zone;
+	isc_result_t result;
+
+	if (zmgr->timer == NULL) {
+		return;
+	}
+
+	zone = isc_heap_element(zmgr->timerheap, 1);
+	if (zone == NULL) {
+		if (isc_time_isepoch(&zmgr->timernext)) {
+			return;
+		}
+		isc_time_settoepoch(&zmgr->timernext);
+		result = isc_timer_reset(zmgr->timer, isc_timertype_inactive,
+					 NULL, NULL, true);
+	} else {
+		if (isc_time_compare(&zone->timerdue, &zmgr->timernext) == 0) {
+			return;
+		}
+		zmgr->timernext = zone->timerdue;
+		result = isc_timer_reset(zmgr->timer, isc_timertype_once,
+					 &zmgr->timernext, NULL, true);
+	}
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_ZONE, ISC_LOG_ERROR,
+			      "could not reset zone manager timer: %s",
+			      isc_result_totext(result));
+	}
+}
+
+static void
+zonemgr_timer(isc_task_t *task, isc_event_t *event) {
+	dns_zonemgr_t *zmgr = (dns_zonemgr_t *)event->ev_arg;
+	dns_zone_t *zone;
+	isc_event_t *e;
+	isc_time_t now;
+
+	UNUSED(task);
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
 
 	isc_event_free(&event);
+
+	TIME_NOW(&now);
+
+	LOCK(&zmgr->timerlock);
+	isc_time_settoepoch(&zmgr->timernext);
+	while ((zone = isc_heap_element(zmgr->timerheap, 1)) != NULL &&
+	       isc_time_compare(&zone->timerdue, &now) <= 0)
+	{
+		isc_heap_delete(zmgr->timerheap, 1);
+		INSIST(zone->timerindex == 0);
+
+		/*
+		 * The zone is registered and so holds an iref that
+		 * cannot go away while we hold the timer lock; the
+		 * event takes one of its own.
+		 */
+		isc_refcount_increment(&zone->irefs);
+		e = isc_event_allocate(zone->mctx, zmgr, DNS_EVENT_ZONETIMER,
+				       zone_timer, zone, sizeof(*e));
+		isc_task_send(zone->timertask, &e);
+	}
+	zonemgr_timer_arm(zmgr);
+	UNLOCK(&zmgr->timerlock);
+}
+
+static void
+zone_timer_register(dns_zonemgr_t *zmgr, dns_zone_t *zone, isc_task_t *task) {
+	REQUIRE(zone->timerzmgr == NULL);
+
+	dns_zonemgr_attach(zmgr, &zone->timerzmgr);
+	isc_task_attach(task, &zone->timertask);
+	zone->timerindex = 0;
+
+	/*
+	 * The schedule "holds" a iref.
+	 */
+	isc_refcount_increment0(&zone->irefs);
+}
+
+static void
+zone_timer_unregister(dns_zone_t *zone) {
+	dns_zonemgr_t *zmgr = zone->timerzmgr;
+
+	LOCK(&zmgr->timerlock);
+	if (zone->timerindex != 0) {
+		isc_heap_delete(zmgr->timerheap, zone->timerindex);
+		zonemgr_timer_arm(zmgr);
+	}
+	UNLOCK(&zmgr->timerlock);
+
+	isc_task_detach(&zone->timertask);
+	dns_zonemgr_detach(&zone->timerzmgr);
+	isc_refcount_decrement(&zone->irefs);
+}
+
+/*
+ * Move 'zone' to its new place in the zone manager's schedule, or
+ * take it out altogether if 'due' is NULL.
+ */
+static void
+zone_timer_schedule(dns_zone_t *zone, const isc_time_t *due) {
+	dns_zonemgr_t *zmgr = zone->timerzmgr;
+	int order;
+
+	if (zmgr == NULL) {
+		return;
+	}
+
+	LOCK(&zmgr->timerlock);
+	if (due == NULL) {
+		if (zone->timerindex != 0) {
+			isc_heap_delete(zmgr->timerheap, zone->timerindex);
+		}
+	} else if (zone->timerindex == 0) {
+		zone->timerdue = *due;
+		isc_heap_insert(zmgr->timerheap, zone);
+	} else {
+		order = isc_time_compare(due, &zone->timerdue);
+		zone->timerdue = *due;
+		if (order < 0) {
+			isc_heap_increased(zmgr->timerheap, zone->timerindex);
+		} else if (order > 0) {
+			isc_heap_decreased(zmgr->timerheap, zone->timerindex);
+		}
+	}
+	zonemgr_timer_arm(zmgr);
+	UNLOCK(&zmgr->timerlock);
 }
 
 static void
 zone_settimer(dns_zone_t *zone, isc_time_t *now) {
 	const char me[] = "zone_settimer";
 	isc_time_t next;
-	isc_result_t result;
 
 	REQUIRE(DNS_ZONE_VALID(zone));
 	REQUIRE(LOCKED_ZONE(zone));
@@ -15291,24 +16317,12 @@ zone_settimer(dns_zone_t *zone, isc_time_t *now) {
 
 	if (isc_time_isepoch(&next)) {
 		zone_debuglog(zone, me, 10, "settimer inactive");
-		result = isc_timer_reset(zone->timer, isc_timertype_inactive,
-					 NULL, NULL, true);
-		if (result != ISC_R_SUCCESS) {
-			dns_zone_log(zone, ISC_LOG_ERROR,
-				     "could not deactivate zone timer: %s",
-				     isc_result_totext(result));
-		}
+		zone_timer_schedule(zone, NULL);
 	} else {
 		if (isc_time_compare(&next, now) <= 0) {
 			next = *now;
 		}
-		result = isc_timer_reset(zone->timer, isc_timertype_once, &next,
-					 NULL, true);
-		if (result != ISC_R_SUCCESS) {
-			dns_zone_log(zone, ISC_LOG_ERROR,
-				     "could not reset zone timer: %s",
-				     isc_result_totext(result));
-		}
+		zone_timer_schedule(zone, &next);
 	}
 }
 
@@ -15929,50 +16943,258 @@ dns_zone_getjournalsize(dns_zone_t *zone) {
 	return (zone->journalsize);
 }
 
-static void
-zone_namerd_tostr(dns_zone_t *zone, char *buf, size_t length) {
-	isc_result_t result = ISC_R_FAILURE;
-	isc_buffer_t buffer;
+void
+dns_zone_setjournaldelay(dns_zone_t *zone, uint32_t delay) {
+	REQUIRE(DNS_ZONE_VALID(zone));
 
-	REQUIRE(buf != NULL);
-	REQUIRE(length > 1U);
+	LOCK(&zone->jlock);
+	zone->journaldelay = delay;
+	UNLOCK(&zone->jlock);
+}
 
-	/*
-	 * Leave space for terminating '\0'.
-	 */
-	isc_buffer_init(&buffer, buf, (unsigned int)length - 1);
-	if (zone->type != dns_zone_redirect && zone->type != dns_zone_key) {
-		if (dns_name_dynamic(&zone->origin)) {
-			result = dns_name_totext(&zone->origin, true, &buffer);
-		}
-		if (result != ISC_R_SUCCESS &&
-		    isc_buffer_availablelength(&buffer) >=
-			    (sizeof("<UNKNOWN>") - 1))
-		{
-			isc_buffer_putstr(&buffer, "<UNKNOWN>");
-		}
+uint32_t
+dns_zone_getjournaldelay(dns_zone_t *zone) {
+	uint32_t delay;
 
-		if (isc_buffer_availablelength(&buffer) > 0) {
-			isc_buffer_putstr(&buffer, "/");
-		}
-		(void)dns_rdataclass_totext(zone->rdclass, &buffer);
-	}
+	REQUIRE(DNS_ZONE_VALID(zone));
 
-	if (zone->view != NULL && strcmp(zone->view->name, "_bind") != 0 &&
-	    strcmp(zone->view->name, "_default") != 0 &&
-	    strlen(zone->view->name) < isc_buffer_availablelength(&buffer))
-	{
-		isc_buffer_putstr(&buffer, "/");
-		isc_buffer_putstr(&buffer, zone->view->name);
-	}
-	if (inline_secure(zone) && 9U < isc_buffer_availablelength(&buffer)) {
-		isc_buffer_putstr(&buffer, " (signed)");
-	}
-	if (inline_raw(zone) && 11U < isc_buffer_availablelength(&buffer)) {
-		isc_buffer_putstr(&buffer, " (unsigned)");
-	}
+	LOCK(&zone->jlock);
+	delay = zone->journaldelay;
+	UNLOCK(&zone->jlock);
 
-	buf[isc_buffer_usedlength(&buffer)] = '\0';
+	return (delay);
+}
+
+/*
+ * Sync the journal transactions written by dns_zone_writejournal(),
+ * and send the events waiting for them.
+ */
+static void
+zone_journal_sync(dns_zone_t *zone) {
+	isc_result_t result;
+	dns_journalwait_t *wait = NULL;
+	dns_journalwaitlist_t waits;
+
+	ISC_LIST_INIT(waits);
+
+	LOCK(&zone->jlock);
+	if (zone->pendingjournal != NULL) {
+		result = dns_journal_sync(zone->pendingjournal);
+		if (result != ISC_R_SUCCESS) {
+			dns_zone_log(zone, ISC_LOG_ERROR,
+				     "journal sync failed: %s",
+				     isc_result_totext(result));
+		}
+		dns_journal_destroy(&zone->pendingjournal);
+	}
+	if (zone->journaltimer != NULL) {
+		(void)isc_timer_reset(zone->journaltimer,
+				      isc_timertype_inactive, NULL, NULL,
+				      true);
+	}
+	ISC_LIST_APPENDLIST(waits, zone->journalwaits, link);
+	UNLOCK(&zone->jlock);
+
+	while ((wait = ISC_LIST_HEAD(waits)) != NULL) {
+		ISC_LIST_UNLINK(waits, wait, link);
+		isc_task_sendanddetach(&wait->task, &wait->event);
+		isc_mem_put(zone->mctx, wait, sizeof(*wait));
+	}
+}
+
+static void
+zone_journal_timer(isc_task_t *task, isc_event_t *event) {
+	dns_zone_t *zone = event->ev_arg;
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+	zone_journal_sync(zone);
+}
+
+isc_result_t
+dns_zone_writejournal(dns_zone_t *zone, dns_diff_t *diff) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_interval_t interval;
+	unsigned int mode = DNS_JOURNAL_CREATE | DNS_JOURNAL_DEFERSYNC;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK(&zone->jlock);
+	if (zone->journaldelay == 0 || zone->journalshutdown ||
+	    zone->journal == NULL || zone->zmgr == NULL || zone->task == NULL)
+	{
+		UNLOCK(&zone->jlock);
+		return (zone_journal(zone, diff, NULL,
+				     "dns_zone_writejournal"));
+	}
+
+	if (zone->journaltimer == NULL) {
+		result = isc_timer_create(zone->zmgr->timermgr,
+					  isc_timertype_inactive, NULL, NULL,
+					  zone->task, zone_journal_timer, zone,
+					  &zone->journaltimer);
+		if (result != ISC_R_SUCCESS) {
+			goto unlock;
+		}
+		isc_refcount_increment(&zone->irefs);
+	}
+
+	/*
+	 * The first transaction starts the delay after which it and
+	 * any that follow are synced together.
+	 */
+	if (zone->pendingjournal == NULL) {
+		result = dns_journal_open(zone->mctx, zone->journal, mode,
+					  &zone->pendingjournal);
+		if (result != ISC_R_SUCCESS) {
+			dns_zone_log(zone, ISC_LOG_ERROR,
+				     "dns_zone_writejournal:"
+				     "dns_journal_open -> %s",
+				     isc_result_totext(result));
+			goto unlock;
+		}
+		isc_interval_set(&interval, zone->journaldelay / 1000,
+				 (zone->journaldelay % 1000) * 1000000);
+		result = isc_timer_reset(zone->journaltimer,
+					 isc_timertype_once, NULL, &interval,
+					 true);
+		if (result != ISC_R_SUCCESS) {
+			dns_journal_destroy(&zone->pendingjournal);
+			goto unlock;
+		}
+	}
+
+	result = dns_journal_write_transaction(zone->pendingjournal, diff);
+	if (result != ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "dns_zone_writejournal:"
+			     "dns_journal_write_transaction -> %s",
+			     isc_result_totext(result));
+		/*
+		 * Sync the transactions written before this one; the
+		 * events waiting for them are sent when the timer fires.
+		 */
+		dns_journal_destroy(&zone->pendingjournal);
+	}
+
+unlock:
+	UNLOCK(&zone->jlock);
+	return (result);
+}
+
+void
+dns_zone_queueupdate(dns_zone_t *zone, isc_event_t **eventp) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(eventp != NULL && *eventp != NULL);
+
+	LOCK_ZONE(zone);
+	INSIST(zone->task != NULL);
+	if (zone->updatesent) {
+		ISC_LIST_APPEND(zone->updates, *eventp, ev_link);
+		*eventp = NULL;
+	} else {
+		zone->updatesent = true;
+		isc_task_send(zone->task, eventp);
+	}
+	UNLOCK_ZONE(zone);
+}
+
+void
+dns_zone_takeupdates(dns_zone_t *zone, unsigned int max,
+		     isc_eventlist_t *events) {
+	isc_event_t *event = NULL;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(events != NULL);
+
+	LOCK_ZONE(zone);
+	while (max-- > 0 && (event = ISC_LIST_HEAD(zone->updates)) != NULL) {
+		ISC_LIST_UNLINK(zone->updates, event, ev_link);
+		ISC_LIST_APPEND(*events, event, ev_link);
+	}
+
+	/*
+	 * Hand any that are left over to the zone task in turn.
+	 */
+	event = ISC_LIST_HEAD(zone->updates);
+	if (event != NULL) {
+		ISC_LIST_UNLINK(zone->updates, event, ev_link);
+		isc_task_send(zone->task, &event);
+	} else {
+		zone->updatesent = false;
+	}
+	UNLOCK_ZONE(zone);
+}
+
+void
+dns_zone_sendaftersync(dns_zone_t *zone, isc_task_t *task,
+		       isc_event_t **eventp) {
+	dns_journalwait_t *wait = NULL;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(eventp != NULL && *eventp != NULL);
+
+	LOCK(&zone->jlock);
+	if (zone->pendingjournal == NULL && ISC_LIST_EMPTY(zone->journalwaits))
+	{
+		UNLOCK(&zone->jlock);
+		isc_task_send(task, eventp);
+		return;
+	}
+	wait = isc_mem_get(zone->mctx, sizeof(*wait));
+	*wait = (dns_journalwait_t){ .event = *eventp };
+	ISC_LINK_INIT(wait, link);
+	isc_task_attach(task, &wait->task);
+	ISC_LIST_APPEND(zone->journalwaits, wait, link);
+	*eventp = NULL;
+	UNLOCK(&zone->jlock);
+}
+
+static void
+zone_namerd_tostr(dns_zone_t *zone, char *buf, size_t length) {
+	isc_result_t result = ISC_R_FAILURE;
+	isc_buffer_t buffer;
+
+	REQUIRE(buf != NULL);
+	REQUIRE(length > 1U);
+
+	/*
+	 * Leave space for terminating '\0'.
+	 */
+	isc_buffer_init(&buffer, buf, (unsigned int)length - 1);
+	if (zone->type != dns_zone_redirect && zone->type != dns_zone_key) {
+		if (dns_name_dynamic(&zone->origin)) {
+			result = dns_name_totext(&zone->origin, true, &buffer);
+		}
+		if (result != ISC_R_SUCCESS &&
+		    isc_buffer_availablelength(&buffer) >=
+			    (sizeof("<UNKNOWN>") - 1))
+		{
+			isc_buffer_putstr(&buffer, "<UNKNOWN>");
+		}
+
+		if (isc_buffer_availablelength(&buffer) > 0) {
+			isc_buffer_putstr(&buffer, "/");
+		}
+		(void)dns_rdataclass_totext(zone->rdclass, &buffer);
+	}
+
+	if (zone->view != NULL && strcmp(zone->view->name, "_bind") != 0 &&
+	    strcmp(zone->view->name, "_default") != 0 &&
+	    strlen(zone->view->name) < isc_buffer_availablelength(&buffer))
+	{
+		isc_buffer_putstr(&buffer, "/");
+		isc_buffer_putstr(&buffer, zone->view->name);
+	}
+	if (inline_secure(zone) && 9U < isc_buffer_availablelength(&buffer)) {
+		isc_buffer_putstr(&buffer, " (signed)");
+	}
+	if (inline_raw(zone) && 11U < isc_buffer_availablelength(&buffer)) {
+		isc_buffer_putstr(&buffer, " (unsigned)");
+	}
+
+	buf[isc_buffer_usedlength(&buffer)] = '\0';
 }
 
 static void
@@ -16340,6 +17562,7 @@ fail:
 			   "notify to %s: retries exceeded", addrbuf);
 	}
 done:
+	notify_ack(notify, revent->result);
 	notify_destroy(notify, false);
 	isc_event_free(&event);
 	dns_message_detach(&message);
@@ -16607,6 +17830,7 @@ nextevent:
 		 * If that fails, then we'll fall back to a direct comparison
 		 * between raw and secure zones.
 		 */
+		zone_journal_sync(zone->rss_raw);
 		CHECK(dns_journal_open(zone->rss_raw->mctx,
 				       zone->rss_raw->journal,
 				       DNS_JOURNAL_WRITE, &rjournal));
@@ -16708,6 +17932,7 @@ nextevent:
 	}
 
 	if (rjournal == NULL) {
+		zone_journal_sync(zone->rss_raw);
 		CHECK(dns_journal_open(zone->rss_raw->mctx,
 				       zone->rss_raw->journal,
 				       DNS_JOURNAL_WRITE, &rjournal));
@@ -17536,6 +18761,7 @@ zone_attachdb(dns_zone_t *zone, dns_db_t *db) {
 	REQUIRE(zone->db == NULL && db != NULL);
 
 	dns_db_attach(db, &zone->db);
+	dns_db_newgeneration();
 }
 
 /* The caller must hold the dblock as a writer. */
@@ -17546,6 +18772,7 @@ zone_detachdb(dns_zone_t *zone) {
 	dns_zone_rpz_disable_db(zone, zone->db);
 	dns_zone_catz_disable_db(zone, zone->db);
 	dns_db_detach(&zone->db);
+	dns_db_newgeneration();
 }
 
 static void
@@ -17820,8 +19047,7 @@ again:
 	{
 		UNLOCK_ZONE(zone);
 		RWLOCK(&zone->zmgr->rwlock, isc_rwlocktype_write);
-		ISC_LIST_UNLINK(zone->zmgr->xfrin_in_progress, zone, statelink);
-		zone->statelist = NULL;
+		zmgr_xfrin_unlink(zone->zmgr, zone);
 		zmgr_resume_xfrs(zone->zmgr, false);
 		RWUNLOCK(&zone->zmgr->rwlock, isc_rwlocktype_write);
 		LOCK_ZONE(zone);
@@ -18001,15 +19227,28 @@ queue_xfrin(dns_zone_t *zone) {
 	const char me[] = "queue_xfrin";
 	isc_result_t result;
 	dns_zonemgr_t *zmgr = zone->zmgr;
+	dns_xfrinpeer_t *peer = NULL;
+	isc_netaddr_t primaryip;
 
 	ENTER;
 
 	INSIST(zone->statelist == NULL);
 
+	LOCK_ZONE(zone);
+	isc_netaddr_fromsockaddr(&primaryip, &zone->primaryaddr);
+	UNLOCK_ZONE(zone);
+
 	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
-	ISC_LIST_APPEND(zmgr->waiting_for_xfrin, zone, statelink);
+	peer = xfrinpeer_get(zmgr, &primaryip);
+	if (ISC_LIST_EMPTY(peer->waiting)) {
+		ISC_LIST_APPEND(zmgr->xfrinready, peer, link);
+	}
+	ISC_LIST_APPEND(peer->waiting, zone, statelink);
 	isc_refcount_increment0(&zone->irefs);
-	zone->statelist = &zmgr->waiting_for_xfrin;
+	zone->statelist = &peer->waiting;
+	zone->xfrinpeer = peer;
+	TIME_NOW(&zone->xfrinqueued);
+	zmgr->nxfrswaiting++;
 	result = zmgr_start_xfrin_ifquota(zmgr, zone);
 	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
 
@@ -18778,8 +20017,12 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	zmgr->startupnotifyrl = NULL;
 	zmgr->startuprefreshrl = NULL;
 	ISC_LIST_INIT(zmgr->zones);
-	ISC_LIST_INIT(zmgr->waiting_for_xfrin);
 	ISC_LIST_INIT(zmgr->xfrin_in_progress);
+	ISC_LIST_INIT(zmgr->xfrinready);
+	zmgr->xfrinpeers = NULL;
+	isc_ht_init(&zmgr->xfrinpeers, mctx, 4, ISC_HT_CASE_SENSITIVE);
+	zmgr->nxfrsin = 0;
+	zmgr->nxfrswaiting = 0;
 	memset(zmgr->unreachable, 0, sizeof(zmgr->unreachable));
 	for (size_t i = 0; i < UNREACH_CACHE_SIZE; i++) {
 		atomic_init(&zmgr->unreachable[i].expire, 0);
@@ -18799,10 +20042,25 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	}
 
 	isc_task_setname(zmgr->task, "zmgr", zmgr);
+
+	/* Zone maintenance schedule. */
+	isc_mutex_init(&zmgr->timerlock);
+	zmgr->timerheap = NULL;
+	isc_heap_create(mctx, zone_timer_higher, zone_timer_index, 0,
+			&zmgr->timerheap);
+	isc_time_settoepoch(&zmgr->timernext);
+	zmgr->timer = NULL;
+	result = isc_timer_create(timermgr, isc_timertype_inactive, NULL, NULL,
+				  zmgr->task, zonemgr_timer, zmgr,
+				  &zmgr->timer);
+	if (result != ISC_R_SUCCESS) {
+		goto free_timerheap;
+	}
+
 	result = isc_ratelimiter_create(mctx, timermgr, zmgr->task,
 					&zmgr->checkdsrl);
 	if (result != ISC_R_SUCCESS) {
-		goto free_task;
+		goto free_timer;
 	}
 
 	result = isc_ratelimiter_create(mctx, timermgr, zmgr->task,
@@ -18851,6 +20109,14 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	zmgr->tlsctx_cache = NULL;
 	isc_rwlock_init(&zmgr->tlsctx_cache_rwlock, 0, 0);
 
+	isc_mutex_init(&zmgr->notifylock);
+	zmgr->notifypeers = NULL;
+	isc_ht_init(&zmgr->notifypeers, mctx, 4, ISC_HT_CASE_SENSITIVE);
+	zmgr->notifyratecur = zmgr->notifyrate;
+	zmgr->notifyacks = 0;
+	zmgr->startupnotifyratecur = zmgr->startupnotifyrate;
+	zmgr->startupnotifyacks = 0;
+
 	zmgr->magic = ZONEMGR_MAGIC;
 
 	*zmgrp = zmgr;
@@ -18868,7 +20134,11 @@ free_notifyrl:
 	isc_ratelimiter_detach(&zmgr->notifyrl);
 free_checkdsrl:
 	isc_ratelimiter_detach(&zmgr->checkdsrl);
-free_task:
+free_timer:
+	isc_timer_destroy(&zmgr->timer);
+free_timerheap:
+	isc_heap_destroy(&zmgr->timerheap);
+	isc_mutex_destroy(&zmgr->timerlock);
 	isc_task_detach(&zmgr->task);
 free_urlock:
 	isc_rwlock_destroy(&zmgr->urlock);
@@ -18910,8 +20180,6 @@ dns_zonemgr_createzone(dns_zonemgr_t *zmgr, dns_zone_t **zonep) {
 
 isc_result_t
 dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
-	isc_result_t result;
-
 	REQUIRE(DNS_ZONE_VALID(zone));
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
 
@@ -18922,7 +20190,7 @@ dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
 	LOCK_ZONE(zone);
 	REQUIRE(zone->task == NULL);
-	REQUIRE(zone->timer == NULL);
+	REQUIRE(zone->timerzmgr == NULL);
 	REQUIRE(zone->zmgr == NULL);
 
 	isc_taskpool_gettask(zmgr->zonetasks, &zone->task);
@@ -18936,18 +20204,13 @@ dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 	isc_task_setname(zone->task, "zone", zone);
 	isc_task_setname(zone->loadtask, "loadzone", zone);
 
-	result = isc_timer_create(zmgr->timermgr, isc_timertype_inactive, NULL,
-				  NULL, zone->task, zone_timer, zone,
-				  &zone->timer);
-
-	if (result != ISC_R_SUCCESS) {
-		goto cleanup_tasks;
-	}
-
 	/*
-	 * The timer "holds" a iref.
+	 * Zone maintenance (refreshes, notifies, dumps, signing) must
+	 * not hold up query processing on the same thread.
 	 */
-	isc_refcount_increment0(&zone->irefs);
+	isc_task_setbackground(zone->task, true);
+
+	zone_timer_register(zmgr, zone, zone->task);
 
 	zonemgr_keymgmt_add(zmgr, zone, &zone->kfio);
 	INSIST(zone->kfio != NULL);
@@ -18956,16 +20219,9 @@ dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 	zone->zmgr = zmgr;
 	isc_refcount_increment(&zmgr->refs);
 
-	goto unlock;
-
-cleanup_tasks:
-	isc_task_detach(&zone->loadtask);
-	isc_task_detach(&zone->task);
-
-unlock:
 	UNLOCK_ZONE(zone);
 	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
-	return (result);
+	return (ISC_R_SUCCESS);
 }
 
 void
@@ -19064,6 +20320,12 @@ dns_zonemgr_shutdown(dns_zonemgr_t *zmgr) {
 	isc_ratelimiter_shutdown(zmgr->startupnotifyrl);
 	isc_ratelimiter_shutdown(zmgr->startuprefreshrl);
 
+	LOCK(&zmgr->timerlock);
+	if (zmgr->timer != NULL) {
+		isc_timer_destroy(&zmgr->timer);
+	}
+	UNLOCK(&zmgr->timerlock);
+
 	if (zmgr->task != NULL) {
 		isc_task_destroy(&zmgr->task);
 	}
@@ -19132,6 +20394,15 @@ dns_zonemgr_setsize(dns_zonemgr_t *zmgr, int num_zones) {
 	if (ntasks < 10) {
 		ntasks = 10;
 	}
+	/*
+	 * The tasks in a pool are bound to the network threads in turn,
+	 * so have at least one per thread; otherwise, loading hundreds
+	 * of zones at startup would leave most of the threads idle.
+	 */
+	if (zmgr->netmgr != NULL) {
+		ntasks = ISC_MAX(ntasks,
+				 (int)isc_nm_getnworkers(zmgr->netmgr));
+	}
 	if (nmctx < 2) {
 		nmctx = 2;
 	}
@@ -19186,13 +20457,38 @@ dns_zonemgr_setsize(dns_zonemgr_t *zmgr, int num_zones) {
 static void
 zonemgr_free(dns_zonemgr_t *zmgr) {
 	isc_mem_t *mctx;
+	isc_ht_iter_t *it = NULL;
+	isc_result_t result;
 
 	INSIST(ISC_LIST_EMPTY(zmgr->zones));
 
 	zmgr->magic = 0;
 
+	isc_ht_iter_create(zmgr->notifypeers, &it);
+	result = isc_ht_iter_first(it);
+	while (result == ISC_R_SUCCESS) {
+		dns_notifypeer_t *peer = NULL;
+
+		isc_ht_iter_current(it, (void **)&peer);
+		INSIST(ISC_LIST_EMPTY(peer->pending));
+		isc_mem_put(zmgr->mctx, peer, sizeof(*peer));
+		result = isc_ht_iter_delcurrent_next(it);
+	}
+	isc_ht_iter_destroy(&it);
+	isc_ht_destroy(&zmgr->notifypeers);
+	isc_mutex_destroy(&zmgr->notifylock);
+
+	INSIST(isc_ht_count(zmgr->xfrinpeers) == 0);
+	isc_ht_destroy(&zmgr->xfrinpeers);
+
 	isc_refcount_destroy(&zmgr->refs);
 	isc_mutex_destroy(&zmgr->iolock);
+	if (zmgr->timer != NULL) {
+		isc_timer_destroy(&zmgr->timer);
+	}
+	INSIST(isc_heap_element(zmgr->timerheap, 1) == NULL);
+	isc_heap_destroy(&zmgr->timerheap);
+	isc_mutex_destroy(&zmgr->timerlock);
 	isc_ratelimiter_detach(&zmgr->checkdsrl);
 	isc_ratelimiter_detach(&zmgr->notifyrl);
 	isc_ratelimiter_detach(&zmgr->refreshrl);
@@ -19256,45 +20552,129 @@ dns_zonemgr_gettimermgr(dns_zonemgr_t *zmgr) {
 }
 
 /*
- * Try to start a new incoming zone transfer to fill a quota
- * slot that was just vacated.
+ * Find or create the incoming transfer state for the primary 'addr'.
+ *
+ * Requires:
+ *	The zone manager is write locked by the caller.
+ */
+static dns_xfrinpeer_t *
+xfrinpeer_get(dns_zonemgr_t *zmgr, const isc_netaddr_t *addr) {
+	dns_xfrinpeer_t *peer = NULL;
+	char key[ISC_NETADDR_FORMATSIZE];
+	isc_result_t result;
+
+	isc_netaddr_format(addr, key, sizeof(key));
+	result = isc_ht_find(zmgr->xfrinpeers, (unsigned char *)key,
+			     strlen(key), (void **)&peer);
+	if (result == ISC_R_SUCCESS) {
+		return (peer);
+	}
+
+	peer = isc_mem_get(zmgr->mctx, sizeof(*peer));
+	*peer = (dns_xfrinpeer_t){ .addr = *addr };
+	strlcpy(peer->key, key, sizeof(peer->key));
+	ISC_LIST_INIT(peer->waiting);
+	ISC_LINK_INIT(peer, link);
+	result = isc_ht_add(zmgr->xfrinpeers, (unsigned char *)peer->key,
+			    strlen(peer->key), peer);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	return (peer);
+}
+
+/*
+ * Take 'zone' out of the queue of its primary, or out of the transfers
+ * in progress, and forget the primary once nothing refers to it.
+ *
+ * Requires:
+ *	The zone manager is write locked by the caller.
+ */
+static void
+zmgr_xfrin_unlink(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
+	dns_xfrinpeer_t *peer = zone->xfrinpeer;
+	isc_result_t result;
+
+	INSIST(peer != NULL);
+
+	if (zone->statelist == &zmgr->xfrin_in_progress) {
+		INSIST(peer->inprogress > 0 && zmgr->nxfrsin > 0);
+		ISC_LIST_UNLINK(zmgr->xfrin_in_progress, zone, statelink);
+		peer->inprogress--;
+		zmgr->nxfrsin--;
+	} else {
+		INSIST(zone->statelist == &peer->waiting);
+		ISC_LIST_UNLINK(peer->waiting, zone, statelink);
+		zmgr->nxfrswaiting--;
+		if (ISC_LIST_EMPTY(peer->waiting)) {
+			ISC_LIST_UNLINK(zmgr->xfrinready, peer, link);
+		}
+	}
+	zone->statelist = NULL;
+	zone->xfrinpeer = NULL;
+
+	if (peer->inprogress == 0 && ISC_LIST_EMPTY(peer->waiting)) {
+		result = isc_ht_delete(zmgr->xfrinpeers,
+				       (unsigned char *)peer->key,
+				       strlen(peer->key));
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		isc_mem_put(zmgr->mctx, peer, sizeof(*peer));
+	}
+}
+
+/*
+ * Try to start new incoming zone transfers to fill the quota slots
+ * that were just vacated; if 'multi' is false, only one is started.
+ *
+ * The primaries with zones waiting are served round robin: each turn
+ * tries the zone that has waited longest for the primary at the head
+ * of the ready list, which then goes to the back.  A pass ends after
+ * every primary has had a turn, so a primary which is at its own quota
+ * costs one check rather than one per queued zone.
  *
  * Requires:
  *	The zone manager is locked by the caller.
  */
 static void
 zmgr_resume_xfrs(dns_zonemgr_t *zmgr, bool multi) {
-	dns_zone_t *zone;
-	dns_zone_t *next;
+	while (!ISC_LIST_EMPTY(zmgr->xfrinready)) {
+		dns_xfrinpeer_t *last = ISC_LIST_TAIL(zmgr->xfrinready);
+		dns_xfrinpeer_t *peer = NULL;
+		bool started = false;
 
-	for (zone = ISC_LIST_HEAD(zmgr->waiting_for_xfrin); zone != NULL;
-	     zone = next)
-	{
-		isc_result_t result;
-		next = ISC_LIST_NEXT(zone, statelink);
-		result = zmgr_start_xfrin_ifquota(zmgr, zone);
-		if (result == ISC_R_SUCCESS) {
-			if (multi) {
-				continue;
+		do {
+			isc_result_t result;
+			dns_zone_t *zone = NULL;
+
+			if (zmgr->nxfrsin >= zmgr->transfersin) {
+				return;
 			}
-			/*
-			 * We successfully filled the slot.  We're done.
-			 */
-			break;
-		} else if (result == ISC_R_QUOTA) {
-			/*
-			 * Not enough quota.  This is probably the per-server
-			 * quota, because we usually get called when a unit of
-			 * global quota has just been freed.  Try the next
-			 * zone, it may succeed if it uses another primary.
-			 */
-			continue;
-		} else {
-			dns_zone_logc(zone, DNS_LOGCATEGORY_XFER_IN,
-				      ISC_LOG_DEBUG(1),
-				      "starting zone transfer: %s",
-				      isc_result_totext(result));
-			break;
+
+			peer = ISC_LIST_HEAD(zmgr->xfrinready);
+			zone = ISC_LIST_HEAD(peer->waiting);
+			ISC_LIST_UNLINK(zmgr->xfrinready, peer, link);
+			ISC_LIST_APPEND(zmgr->xfrinready, peer, link);
+
+			result = zmgr_start_xfrin_ifquota(zmgr, zone);
+			if (result == ISC_R_SUCCESS) {
+				if (!multi) {
+					/*
+					 * We successfully filled the slot.
+					 * We're done.
+					 */
+					return;
+				}
+				started = true;
+			} else if (result != ISC_R_QUOTA) {
+				dns_zone_logc(zone, DNS_LOGCATEGORY_XFER_IN,
+					      ISC_LOG_DEBUG(1),
+					      "starting zone transfer: %s",
+					      isc_result_totext(result));
+				return;
+			}
+		} while (peer != last);
+
+		if (!started) {
+			return;
 		}
 	}
 }
@@ -19314,12 +20694,14 @@ zmgr_resume_xfrs(dns_zonemgr_t *zmgr, bool multi) {
  */
 static isc_result_t
 zmgr_start_xfrin_ifquota(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
+	dns_xfrinpeer_t *xpeer = zone->xfrinpeer;
 	dns_peer_t *peer = NULL;
-	isc_netaddr_t primaryip;
-	uint32_t nxfrsin, nxfrsperns;
-	dns_zone_t *x;
 	uint32_t maxtransfersin, maxtransfersperns;
 	isc_event_t *e;
+	isc_time_t now;
+	uint64_t waited;
+
+	INSIST(xpeer != NULL && zone->statelist == &xpeer->waiting);
 
 	/*
 	 * If we are exiting just pretend we got quota so the zone will
@@ -19335,8 +20717,7 @@ zmgr_start_xfrin_ifquota(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 	 * Find any configured information about the server we'd
 	 * like to transfer this zone from.
 	 */
-	isc_netaddr_fromsockaddr(&primaryip, &zone->primaryaddr);
-	(void)dns_peerlist_peerbyaddr(zone->view->peers, &primaryip, &peer);
+	(void)dns_peerlist_peerbyaddr(zone->view->peers, &xpeer->addr, &peer);
 	UNLOCK_ZONE(zone);
 
 	/*
@@ -19350,34 +20731,12 @@ zmgr_start_xfrin_ifquota(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 		(void)dns_peer_gettransfers(peer, &maxtransfersperns);
 	}
 
-	/*
-	 * Count the total number of transfers that are in progress,
-	 * and the number of transfers in progress from this primary.
-	 * We linearly scan a list of all transfers; if this turns
-	 * out to be too slow, we could hash on the primary address.
-	 */
-	nxfrsin = nxfrsperns = 0;
-	for (x = ISC_LIST_HEAD(zmgr->xfrin_in_progress); x != NULL;
-	     x = ISC_LIST_NEXT(x, statelink))
-	{
-		isc_netaddr_t xip;
-
-		LOCK_ZONE(x);
-		isc_netaddr_fromsockaddr(&xip, &x->primaryaddr);
-		UNLOCK_ZONE(x);
-
-		nxfrsin++;
-		if (isc_netaddr_equal(&xip, &primaryip)) {
-			nxfrsperns++;
-		}
-	}
-
 	/* Enforce quota. */
-	if (nxfrsin >= maxtransfersin) {
+	if (zmgr->nxfrsin >= maxtransfersin) {
 		return (ISC_R_QUOTA);
 	}
 
-	if (nxfrsperns >= maxtransfersperns) {
+	if (xpeer->inprogress >= maxtransfersperns) {
 		return (ISC_R_QUOTA);
 	}
 
@@ -19391,13 +20750,27 @@ gotquota:
 			       got_transfer_quota, zone, sizeof(isc_event_t));
 
 	LOCK_ZONE(zone);
-	INSIST(zone->statelist == &zmgr->waiting_for_xfrin);
-	ISC_LIST_UNLINK(zmgr->waiting_for_xfrin, zone, statelink);
+	ISC_LIST_UNLINK(xpeer->waiting, zone, statelink);
+	zmgr->nxfrswaiting--;
+	if (ISC_LIST_EMPTY(xpeer->waiting)) {
+		ISC_LIST_UNLINK(zmgr->xfrinready, xpeer, link);
+	}
 	ISC_LIST_APPEND(zmgr->xfrin_in_progress, zone, statelink);
 	zone->statelist = &zmgr->xfrin_in_progress;
+	xpeer->inprogress++;
+	zmgr->nxfrsin++;
 	isc_task_send(zone->task, &e);
-	dns_zone_logc(zone, DNS_LOGCATEGORY_XFER_IN, ISC_LOG_INFO,
-		      "Transfer started.");
+	TIME_NOW(&now);
+	waited = isc_time_microdiff(&now, &zone->xfrinqueued) / 1000;
+	if (waited == 0) {
+		dns_zone_logc(zone, DNS_LOGCATEGORY_XFER_IN, ISC_LOG_INFO,
+			      "Transfer started.");
+	} else {
+		dns_zone_logc(zone, DNS_LOGCATEGORY_XFER_IN, ISC_LOG_INFO,
+			      "Transfer started after waiting %" PRIu64
+			      " ms for quota.",
+			      waited);
+	}
 	UNLOCK_ZONE(zone);
 
 	return (ISC_R_SUCCESS);
@@ -19610,14 +20983,22 @@ void
 dns_zonemgr_setnotifyrate(dns_zonemgr_t *zmgr, unsigned int value) {
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
 
+	LOCK(&zmgr->notifylock);
 	setrl(zmgr->notifyrl, &zmgr->notifyrate, value);
+	zmgr->notifyratecur = zmgr->notifyrate;
+	zmgr->notifyacks = 0;
+	UNLOCK(&zmgr->notifylock);
 }
 
 void
 dns_zonemgr_setstartupnotifyrate(dns_zonemgr_t *zmgr, unsigned int value) {
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
 
+	LOCK(&zmgr->notifylock);
 	setrl(zmgr->startupnotifyrl, &zmgr->startupnotifyrate, value);
+	zmgr->startupnotifyratecur = zmgr->startupnotifyrate;
+	zmgr->startupnotifyacks = 0;
+	UNLOCK(&zmgr->notifylock);
 }
 
 void
@@ -19970,18 +21351,10 @@ dns_zonemgr_getcount(dns_zonemgr_t *zmgr, int state) {
 	RWLOCK(&zmgr->rwlock, isc_rwlocktype_read);
 	switch (state) {
 	case DNS_ZONESTATE_XFERRUNNING:
-		for (zone = ISC_LIST_HEAD(zmgr->xfrin_in_progress);
-		     zone != NULL; zone = ISC_LIST_NEXT(zone, statelink))
-		{
-			count++;
-		}
+		count = zmgr->nxfrsin;
 		break;
 	case DNS_ZONESTATE_XFERDEFERRED:
-		for (zone = ISC_LIST_HEAD(zmgr->waiting_for_xfrin);
-		     zone != NULL; zone = ISC_LIST_NEXT(zone, statelink))
-		{
-			count++;
-		}
+		count = zmgr->nxfrswaiting;
 		break;
 	case DNS_ZONESTATE_SOAQUERY:
 		for (zone = ISC_LIST_HEAD(zmgr->zones); zone != NULL;
@@ -20221,6 +21594,266 @@ dns_zone_getsignatures(dns_zone_t *zone) {
 	return (zone->signatures);
 }
 
+void
+dns_zone_setresigningrate(dns_zone_t *zone, uint32_t rate) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	zone->resignrate = rate;
+}
+
+void
+dns_zone_setsigningthreads(dns_zone_t *zone, uint32_t threads) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	if (threads > SIGNJOB_MAXTHREADS) {
+		threads = SIGNJOB_MAXTHREADS;
+	} else if (threads == 0) {
+		threads = 1;
+	}
+	zone->signthreads = threads;
+}
+
+static void
+denkeys_free(dns_zone_t *zone) {
+	for (unsigned int i = 0; i < zone->ndenkeys; i++) {
+		dst_key_free(&zone->denkeys[i]);
+	}
+	zone->ndenkeys = 0;
+}
+
+/*%
+ * Can 'keys[i]' sign synthesized NSEC records?  It must be an active
+ * zone-signing key; a KSK is used only when its algorithm has no ZSK.
+ */
+static bool
+denkey_use(dns_zone_t *zone, dst_key_t **keys, unsigned int nkeys,
+	   unsigned int i, isc_stdtime_t now) {
+	dst_key_t *key = keys[i];
+	isc_stdtime_t when;
+	bool zsk = false;
+
+	if (!dst_key_isprivate(key) || dst_key_inactive(key) || REVOKE(key)) {
+		return (false);
+	}
+
+	if (dns_zone_getkasp(zone) != NULL) {
+		if (dst_key_getbool(key, DST_BOOL_ZSK, &zsk) != ISC_R_SUCCESS) {
+			zsk = !KSK(key);
+		}
+		return (zsk && dst_key_is_signing(key, DST_BOOL_ZSK, now,
+						  &when));
+	}
+
+	if (!KSK(key)) {
+		return (true);
+	}
+	for (unsigned int j = 0; j < nkeys; j++) {
+		if (j != i && ALG(keys[j]) == ALG(key) && !KSK(keys[j]) &&
+		    dst_key_isprivate(keys[j]) && !dst_key_inactive(keys[j]) &&
+		    !REVOKE(keys[j]))
+		{
+			return (false);
+		}
+	}
+	return (true);
+}
+
+/*%
+ * Reload the zone-signing keys used for compact denial if they are
+ * older than DENKEYS_REFRESH.  Requires 'zone->denlock' to be held.
+ */
+static isc_result_t
+denkeys_refresh(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
+		isc_stdtime_t now) {
+	isc_result_t result;
+	dst_key_t *keys[DNS_MAXZONEKEYS];
+	unsigned int nkeys = 0;
+
+	if (zone->ndenkeys > 0 && now < zone->denkeysrefresh) {
+		return (ISC_R_SUCCESS);
+	}
+
+	result = dns__zone_findkeys(zone, db, ver, now, zone->mctx,
+				    DNS_MAXZONEKEYS, keys, &nkeys);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	denkeys_free(zone);
+	for (unsigned int i = 0; i < nkeys; i++) {
+		if (zone->ndenkeys < DNS_ZONE_DENIALMAXSIGS &&
+		    denkey_use(zone, keys, nkeys, i, now))
+		{
+			dst_key_attach(keys[i],
+				       &zone->denkeys[zone->ndenkeys++]);
+		}
+	}
+	for (unsigned int i = 0; i < nkeys; i++) {
+		dst_key_free(&keys[i]);
+	}
+
+	/*
+	 * The cached signatures may have been made with retired keys.
+	 */
+	if (zone->densigs != NULL) {
+		for (unsigned int i = 0; i < DENSIG_SLOTS; i++) {
+			zone->densigs[i].valid = false;
+		}
+	}
+	zone->denkeysrefresh = now + DENKEYS_REFRESH;
+
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Copy the signatures in 'entry' into 'buffer' and 'sigs'.
+ */
+static isc_result_t
+densig_copy(struct densig *entry, isc_buffer_t *buffer, dns_rdata_t *sigs,
+	    unsigned int *nsigsp) {
+	unsigned char *data = entry->sigdata;
+	isc_region_t r;
+
+	for (unsigned int i = 0; i < entry->nsigs; i++) {
+		isc_buffer_availableregion(buffer, &r);
+		if (r.length < entry->siglen[i]) {
+			return (ISC_R_NOSPACE);
+		}
+		memmove(r.base, data, entry->siglen[i]);
+		r.length = entry->siglen[i];
+		isc_buffer_add(buffer, r.length);
+		dns_rdata_init(&sigs[i]);
+		dns_rdata_fromregion(&sigs[i], dns_rdataclass_in,
+				     dns_rdatatype_rrsig, &r);
+		data += entry->siglen[i];
+	}
+	*nsigsp = entry->nsigs;
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_zone_signdenial(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
+		    const dns_name_t *name, dns_rdataset_t *rdataset,
+		    isc_buffer_t *buffer, dns_rdata_t *sigs,
+		    unsigned int *nsigsp) {
+	isc_result_t result;
+	dst_key_t *keys[DNS_ZONE_DENIALMAXSIGS];
+	unsigned int nkeys = 0, nsigs = 0;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	struct densig *entry = NULL;
+	isc_stdtime_t now, inception, expire, refresh;
+	uint32_t validity, resign;
+	unsigned int slot;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(rdataset->type == dns_rdatatype_nsec);
+	REQUIRE(sigs != NULL && nsigsp != NULL);
+
+	*nsigsp = 0;
+
+	result = dns_rdataset_first(rdataset);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	dns_rdataset_current(rdataset, &rdata);
+	slot = dns_name_hash(name, false) % DENSIG_SLOTS;
+
+	isc_stdtime_get(&now);
+
+	LOCK(&zone->denlock);
+	result = denkeys_refresh(zone, db, ver, now);
+	if (result != ISC_R_SUCCESS) {
+		UNLOCK(&zone->denlock);
+		return (result);
+	}
+	if (zone->ndenkeys == 0) {
+		UNLOCK(&zone->denlock);
+		return (ISC_R_NOTFOUND);
+	}
+	if (zone->densigs == NULL) {
+		zone->densigs = isc_mem_get(zone->mctx,
+					    DENSIG_SLOTS *
+						    sizeof(zone->densigs[0]));
+		memset(zone->densigs, 0,
+		       DENSIG_SLOTS * sizeof(zone->densigs[0]));
+	}
+	entry = &zone->densigs[slot];
+	if (entry->valid && now < entry->refresh &&
+	    entry->ttl == rdataset->ttl && entry->rdlen == rdata.length &&
+	    memcmp(entry->rdata, rdata.data, rdata.length) == 0 &&
+	    dns_name_equal(dns_fixedname_name(&entry->fname), name))
+	{
+		result = densig_copy(entry, buffer, sigs, nsigsp);
+		UNLOCK(&zone->denlock);
+		return (result);
+	}
+	for (unsigned int i = 0; i < zone->ndenkeys; i++) {
+		dst_key_attach(zone->denkeys[i], &keys[nkeys++]);
+	}
+	UNLOCK(&zone->denlock);
+
+	/*
+	 * Backdate the inception time by an hour to allow for clock
+	 * skew, as is done when signing the zone itself.
+	 */
+	validity = dns_zone_getsigvalidityinterval(zone);
+	resign = dns_zone_getsigresigninginterval(zone);
+	inception = now - 3600;
+	expire = now + validity;
+	refresh = now + ((resign < validity) ? validity - resign
+					     : validity / 2);
+
+	for (unsigned int i = 0; i < nkeys; i++) {
+		dns_rdata_init(&sigs[nsigs]);
+		result = dns_dnssec_sign(name, rdataset, keys[i], &inception,
+					 &expire, zone->mctx, buffer,
+					 &sigs[nsigs]);
+		if (result != ISC_R_SUCCESS) {
+			goto failure;
+		}
+		nsigs++;
+	}
+	*nsigsp = nsigs;
+
+	/*
+	 * Cache the signatures unless they, or the record they cover,
+	 * do not fit in a slot.
+	 */
+	if (rdata.length <= sizeof(entry->rdata)) {
+		unsigned int total = 0;
+
+		for (unsigned int i = 0; i < nsigs; i++) {
+			total += sigs[i].length;
+		}
+		if (total <= sizeof(entry->sigdata)) {
+			unsigned char *data = entry->sigdata;
+
+			LOCK(&zone->denlock);
+			entry->valid = true;
+			dns_name_copy(name, dns_fixedname_initname(
+						    &entry->fname));
+			entry->rdlen = rdata.length;
+			memmove(entry->rdata, rdata.data, rdata.length);
+			entry->ttl = rdataset->ttl;
+			entry->refresh = refresh;
+			entry->nsigs = nsigs;
+			for (unsigned int i = 0; i < nsigs; i++) {
+				entry->siglen[i] = sigs[i].length;
+				memmove(data, sigs[i].data, sigs[i].length);
+				data += sigs[i].length;
+			}
+			UNLOCK(&zone->denlock);
+		}
+	}
+
+failure:
+	for (unsigned int i = 0; i < nkeys; i++) {
+		dst_key_free(&keys[i]);
+	}
+	return (result);
+}
+
 void
 dns_zone_setprivatetype(dns_zone_t *zone, dns_rdatatype_t type) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -20497,7 +22130,7 @@ tickle_apex_rrset(dns_rdatatype_t rrtype, dns_zone_t *zone, dns_db_t *db,
 		result = add_sigs(db, ver, &zone->origin, zone, rrtype,
 				  zonediff->diff, keys, nkeys, zone->mctx,
 				  inception, keyexpire, check_ksk,
-				  keyset_kskonly);
+				  keyset_kskonly, NULL);
 		if (result != ISC_R_SUCCESS) {
 			dnssec_log(zone, ISC_LOG_ERROR,
 				   "sign_apex:add_sigs -> %s",
@@ -22353,6 +23986,33 @@ dns_zone_getautomatic(dns_zone_t *zone) {
 	return (zone->automatic);
 }
 
+void
+dns_zone_setcfgdigest(dns_zone_t *zone, const unsigned char *digest) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	zone->cfgdigestset = (digest != NULL);
+	if (digest != NULL) {
+		memmove(zone->cfgdigest, digest, sizeof(zone->cfgdigest));
+	}
+	UNLOCK_ZONE(zone);
+}
+
+bool
+dns_zone_cfgdigestmatch(dns_zone_t *zone, const unsigned char *digest) {
+	bool match;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(digest != NULL);
+
+	LOCK_ZONE(zone);
+	match = zone->cfgdigestset &&
+		memcmp(zone->cfgdigest, digest, sizeof(zone->cfgdigest)) == 0;
+	UNLOCK_ZONE(zone);
+
+	return (match);
+}
+
 void
 dns_zone_setadded(dns_zone_t *zone, bool added) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -22472,7 +24132,6 @@ dns_zone_getserialupdatemethod(dns_zone_t *zone) {
  */
 isc_result_t
 dns_zone_link(dns_zone_t *zone, dns_zone_t *raw) {
-	isc_result_t result;
 	dns_zonemgr_t *zmgr;
 
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -22497,17 +24156,7 @@ dns_zone_link(dns_zone_t *zone, dns_zone_t *raw) {
 	LOCK_ZONE(zone);
 	LOCK_ZONE(raw);
 
-	result = isc_timer_create(zmgr->timermgr, isc_timertype_inactive, NULL,
-				  NULL, zone->task, zone_timer, raw,
-				  &raw->timer);
-	if (result != ISC_R_SUCCESS) {
-		goto unlock;
-	}
-
-	/*
-	 * The timer "holds" a iref.
-	 */
-	isc_refcount_increment0(&raw->irefs);
+	zone_timer_register(zmgr, raw, zone->task);
 
 	/* dns_zone_attach(raw, &zone->raw); */
 	isc_refcount_increment(&raw->erefs);
@@ -22523,11 +24172,10 @@ dns_zone_link(dns_zone_t *zone, dns_zone_t *raw) {
 	raw->zmgr = zmgr;
 	isc_refcount_increment(&zmgr->refs);
 
-unlock:
 	UNLOCK_ZONE(raw);
 	UNLOCK_ZONE(zone);
 	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
-	return (result);
+	return (ISC_R_SUCCESS);
 }
 
 void
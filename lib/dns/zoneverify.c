@@ -19,14 +19,17 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <isc/atomic.h>
 #include <isc/base32.h>
 #include <isc/buffer.h>
 #include <isc/heap.h>
 #include <isc/iterated_hash.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/region.h>
 #include <isc/result.h>
+#include <isc/thread.h>
 #include <isc/types.h>
 #include <isc/util.h>
 
@@ -52,6 +55,25 @@
 
 #include <dst/dst.h>
 
+/*
+ * When more than one thread is available, verifyset() does not check
+ * the signatures of an RRset itself but queues a verification job.
+ * Once VERIFYJOB_BATCH jobs have been queued, verifyjob_flush() checks
+ * them in parallel: each thread takes the next job from a shared atomic
+ * index and stores the algorithms it could validate in the job itself,
+ * so no locking is needed to collect the results, which are then
+ * reported in the order the jobs were queued.
+ */
+#define VERIFYJOB_BATCH 1024
+
+typedef struct verifyjob {
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dns_rdataset_t rdataset;
+	dns_rdataset_t sigrdataset;
+	unsigned char set_algorithms[256];
+} verifyjob_t;
+
 typedef struct vctx {
 	isc_mem_t *mctx;
 	dns_zone_t *zone;
@@ -79,6 +101,12 @@ typedef struct vctx {
 	unsigned char act_algorithms[256];
 	isc_heap_t *expected_chains;
 	isc_heap_t *found_chains;
+	unsigned int nthreads;
+	dst_key_t **dstkeys;
+	size_t nkeys;
+	verifyjob_t *jobs;
+	unsigned int njobs;
+	atomic_uint_fast32_t nextjob;
 } vctx_t;
 
 struct nsec3_chain_fixed {
@@ -804,12 +832,182 @@ verifynsec3s(const vctx_t *vctx, const dns_name_t *name,
 	return (result);
 }
 
+/*%
+ * Record in 'set_algorithms' the algorithms for which 'sigrdataset'
+ * contains a valid signature of 'rdataset'.
+ */
+static void
+checksigs(const vctx_t *vctx, dns_rdataset_t *rdataset,
+	  dns_rdataset_t *sigrdataset, const dns_name_t *name,
+	  dst_key_t **dstkeys, size_t nkeys, unsigned char *set_algorithms) {
+	isc_result_t result;
+
+	for (result = dns_rdataset_first(sigrdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(sigrdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdata_rrsig_t sig;
+
+		dns_rdataset_current(sigrdataset, &rdata);
+		result = dns_rdata_tostruct(&rdata, &sig, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		if (rdataset->ttl != sig.originalttl) {
+			continue;
+		}
+		if ((set_algorithms[sig.algorithm] != 0) ||
+		    (vctx->act_algorithms[sig.algorithm] == 0))
+		{
+			continue;
+		}
+		if (goodsig(vctx, &rdata, name, dstkeys, nkeys, rdataset)) {
+			dns_rdataset_settrust(rdataset, dns_trust_secure);
+			dns_rdataset_settrust(sigrdataset, dns_trust_secure);
+			set_algorithms[sig.algorithm] = 1;
+		}
+	}
+}
+
+/*%
+ * Report the signatures in 'sigrdataset' whose original TTL does not
+ * match that of 'rdataset', and the active algorithms missing from
+ * 'set_algorithms'.
+ */
+static void
+reportsigs(vctx_t *vctx, dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset,
+	   const dns_name_t *name, const unsigned char *set_algorithms) {
+	char namebuf[DNS_NAME_FORMATSIZE];
+	char algbuf[DNS_SECALG_FORMATSIZE];
+	char typebuf[DNS_RDATATYPE_FORMATSIZE];
+	isc_result_t result;
+
+	for (result = dns_rdataset_first(sigrdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(sigrdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdata_rrsig_t sig;
+
+		dns_rdataset_current(sigrdataset, &rdata);
+		result = dns_rdata_tostruct(&rdata, &sig, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		if (rdataset->ttl != sig.originalttl) {
+			dns_name_format(name, namebuf, sizeof(namebuf));
+			dns_rdatatype_format(rdataset->type, typebuf,
+					     sizeof(typebuf));
+			zoneverify_log_error(vctx,
+					     "TTL mismatch for "
+					     "%s %s keytag %u",
+					     namebuf, typebuf, sig.keyid);
+		}
+	}
+
+	if (memcmp(set_algorithms, vctx->act_algorithms,
+		   sizeof(vctx->act_algorithms)) != 0)
+	{
+		dns_name_format(name, namebuf, sizeof(namebuf));
+		dns_rdatatype_format(rdataset->type, typebuf, sizeof(typebuf));
+		for (size_t i = 0; i < ARRAY_SIZE(vctx->act_algorithms); i++) {
+			if ((vctx->act_algorithms[i] != 0) &&
+			    (set_algorithms[i] == 0))
+			{
+				dns_secalg_format(i, algbuf, sizeof(algbuf));
+				zoneverify_log_error(vctx,
+						     "No correct %s signature "
+						     "for %s %s",
+						     algbuf, namebuf, typebuf);
+				vctx->bad_algorithms[i] = 1;
+			}
+		}
+	}
+}
+
+static isc_threadresult_t
+verifyjob_run(isc_threadarg_t arg) {
+	vctx_t *vctx = arg;
+	verifyjob_t *job = NULL;
+	uint_fast32_t i;
+
+	for (;;) {
+		i = atomic_fetch_add_relaxed(&vctx->nextjob, 1);
+		if (i >= vctx->njobs) {
+			break;
+		}
+		job = &vctx->jobs[i];
+		checksigs(vctx, &job->rdataset, &job->sigrdataset, job->name,
+			  vctx->dstkeys, vctx->nkeys, job->set_algorithms);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+/*%
+ * Check the signatures of all the queued verification jobs, using up
+ * to 'vctx->nthreads' threads, then report the results.
+ */
+static void
+verifyjob_flush(vctx_t *vctx) {
+	isc_thread_t *threads = NULL;
+	unsigned int nextra, i;
+	verifyjob_t *job = NULL;
+
+	if (vctx->njobs == 0) {
+		return;
+	}
+
+	atomic_store_relaxed(&vctx->nextjob, 0);
+	nextra = ISC_MIN(vctx->nthreads, vctx->njobs) - 1;
+	if (nextra > 0) {
+		threads = isc_mem_get(vctx->mctx, nextra * sizeof(threads[0]));
+		for (i = 0; i < nextra; i++) {
+			isc_thread_create(verifyjob_run, vctx, &threads[i]);
+		}
+	}
+	(void)verifyjob_run(vctx);
+	for (i = 0; i < nextra; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	if (threads != NULL) {
+		isc_mem_put(vctx->mctx, threads, nextra * sizeof(threads[0]));
+	}
+
+	for (i = 0; i < vctx->njobs; i++) {
+		job = &vctx->jobs[i];
+		reportsigs(vctx, &job->rdataset, &job->sigrdataset, job->name,
+			   job->set_algorithms);
+		dns_rdataset_disassociate(&job->rdataset);
+		dns_rdataset_disassociate(&job->sigrdataset);
+	}
+	vctx->njobs = 0;
+}
+
+static void
+verifyjob_add(vctx_t *vctx, dns_rdataset_t *rdataset,
+	      dns_rdataset_t *sigrdataset, const dns_name_t *name) {
+	verifyjob_t *job = NULL;
+
+	if (vctx->jobs == NULL) {
+		size_t size = VERIFYJOB_BATCH * sizeof(vctx->jobs[0]);
+		vctx->jobs = isc_mem_get(vctx->mctx, size);
+	}
+
+	job = &vctx->jobs[vctx->njobs++];
+	job->name = dns_fixedname_initname(&job->fname);
+	dns_name_copy(name, job->name);
+	dns_rdataset_init(&job->rdataset);
+	dns_rdataset_clone(rdataset, &job->rdataset);
+	dns_rdataset_init(&job->sigrdataset);
+	dns_rdataset_clone(sigrdataset, &job->sigrdataset);
+	memset(job->set_algorithms, 0, sizeof(job->set_algorithms));
+
+	if (vctx->njobs == VERIFYJOB_BATCH) {
+		verifyjob_flush(vctx);
+	}
+}
+
 static isc_result_t
 verifyset(vctx_t *vctx, dns_rdataset_t *rdataset, const dns_name_t *name,
 	  dns_dbnode_t *node, dst_key_t **dstkeys, size_t nkeys) {
 	unsigned char set_algorithms[256] = { 0 };
 	char namebuf[DNS_NAME_FORMATSIZE];
-	char algbuf[DNS_SECALG_FORMATSIZE];
 	char typebuf[DNS_RDATATYPE_FORMATSIZE];
 	dns_rdataset_t sigrdataset;
 	dns_rdatasetiter_t *rdsiter = NULL;
@@ -847,57 +1045,15 @@ verifyset(vctx_t *vctx, dns_rdataset_t *rdataset, const dns_name_t *name,
 		goto done;
 	}
 
-	for (result = dns_rdataset_first(&sigrdataset); result == ISC_R_SUCCESS;
-	     result = dns_rdataset_next(&sigrdataset))
-	{
-		dns_rdata_t rdata = DNS_RDATA_INIT;
-		dns_rdata_rrsig_t sig;
-
-		dns_rdataset_current(&sigrdataset, &rdata);
-		result = dns_rdata_tostruct(&rdata, &sig, NULL);
-		RUNTIME_CHECK(result == ISC_R_SUCCESS);
-		if (rdataset->ttl != sig.originalttl) {
-			dns_name_format(name, namebuf, sizeof(namebuf));
-			dns_rdatatype_format(rdataset->type, typebuf,
-					     sizeof(typebuf));
-			zoneverify_log_error(vctx,
-					     "TTL mismatch for "
-					     "%s %s keytag %u",
-					     namebuf, typebuf, sig.keyid);
-			continue;
-		}
-		if ((set_algorithms[sig.algorithm] != 0) ||
-		    (vctx->act_algorithms[sig.algorithm] == 0))
-		{
-			continue;
-		}
-		if (goodsig(vctx, &rdata, name, dstkeys, nkeys, rdataset)) {
-			dns_rdataset_settrust(rdataset, dns_trust_secure);
-			dns_rdataset_settrust(&sigrdataset, dns_trust_secure);
-			set_algorithms[sig.algorithm] = 1;
-		}
+	if (vctx->nthreads > 1) {
+		verifyjob_add(vctx, rdataset, &sigrdataset, name);
+	} else {
+		checksigs(vctx, rdataset, &sigrdataset, name, dstkeys, nkeys,
+			  set_algorithms);
+		reportsigs(vctx, rdataset, &sigrdataset, name, set_algorithms);
 	}
 	result = ISC_R_SUCCESS;
 
-	if (memcmp(set_algorithms, vctx->act_algorithms,
-		   sizeof(set_algorithms)) != 0)
-	{
-		dns_name_format(name, namebuf, sizeof(namebuf));
-		dns_rdatatype_format(rdataset->type, typebuf, sizeof(typebuf));
-		for (size_t i = 0; i < ARRAY_SIZE(set_algorithms); i++) {
-			if ((vctx->act_algorithms[i] != 0) &&
-			    (set_algorithms[i] == 0))
-			{
-				dns_secalg_format(i, algbuf, sizeof(algbuf));
-				zoneverify_log_error(vctx,
-						     "No correct %s signature "
-						     "for %s %s",
-						     algbuf, namebuf, typebuf);
-				vctx->bad_algorithms[i] = 1;
-			}
-		}
-	}
-
 done:
 	if (dns_rdataset_isassociated(&sigrdataset)) {
 		dns_rdataset_disassociate(&sigrdataset);
@@ -1301,6 +1457,13 @@ vctx_init(vctx_t *vctx, isc_mem_t *mctx, dns_zone_t *zone, dns_db_t *db,
 
 	vctx->found_chains = NULL;
 	isc_heap_create(mctx, chain_compare, NULL, 1024, &vctx->found_chains);
+
+	/*
+	 * Within named, verification runs on a worker thread that is
+	 * shared with other zones; only standalone tools use more threads.
+	 */
+	vctx->nthreads = (zone == NULL) ? isc_os_ncpus() : 1;
+	atomic_init(&vctx->nextjob, 0);
 }
 
 static void
@@ -1333,6 +1496,11 @@ vctx_destroy(vctx_t *vctx) {
 	isc_heap_destroy(&vctx->expected_chains);
 	isc_heap_foreach(vctx->found_chains, free_element_heap, vctx->mctx);
 	isc_heap_destroy(&vctx->found_chains);
+	if (vctx->jobs != NULL) {
+		INSIST(vctx->njobs == 0);
+		isc_mem_put(vctx->mctx, vctx->jobs,
+			    VERIFYJOB_BATCH * sizeof(vctx->jobs[0]));
+	}
 }
 
 static isc_result_t
@@ -1724,6 +1892,8 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 			nkeys++;
 		}
 	}
+	vctx->dstkeys = dstkeys;
+	vctx->nkeys = nkeys;
 
 	result = dns_db_createiterator(vctx->db, DNS_DB_NONSEC3, &dbiter);
 	if (result != ISC_R_SUCCESS) {
@@ -1867,7 +2037,7 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 	if (result != ISC_R_SUCCESS) {
 		zoneverify_log_error(vctx, "dns_db_createiterator(): %s",
 				     isc_result_totext(result));
-		return (result);
+		goto done;
 	}
 
 	for (result = dns_dbiterator_first(dbiter); result == ISC_R_SUCCESS;
@@ -1898,6 +2068,9 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 	result = ISC_R_SUCCESS;
 
 done:
+	verifyjob_flush(vctx);
+	vctx->dstkeys = NULL;
+	vctx->nkeys = 0;
 	while (nkeys-- > 0U) {
 		dst_key_free(&dstkeys[nkeys]);
 	}
@@ -16,8 +16,10 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/ascii.h>
 #include <isc/atomic.h>
 #include <isc/file.h>
+#include <isc/ht.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/result.h>
@@ -25,6 +27,7 @@
 #include <isc/task.h>
 #include <isc/util.h>
 
+#include <dns/db.h>
 #include <dns/log.h>
 #include <dns/name.h>
 #include <dns/rbt.h>
@@ -55,6 +58,7 @@ struct dns_zt {
 
 	/* Locked by lock. */
 	dns_rbt_t *table;
+	isc_ht_t *origins; /*%< zones by lowercased wire-format origin */
 };
 
 struct zt_freeze_params {
@@ -68,6 +72,32 @@ struct zt_freeze_params {
 static void
 auto_detach(void *, void *);
 
+/*%
+ * Store 'name' in 'key' (at least DNS_NAME_MAXWIRE bytes long) in
+ * lowercase wire format, and the offset of each of its labels in
+ * 'offsets' (if not NULL).  Return the number of labels.
+ */
+static unsigned int
+zt_key(const dns_name_t *name, unsigned char *key, unsigned char *offsets) {
+	unsigned int i = 0, labels = 0;
+
+	while (i < name->length) {
+		unsigned int count = name->ndata[i];
+
+		if (offsets != NULL) {
+			offsets[labels] = i;
+		}
+		labels++;
+		key[i++] = count;
+		while (count-- > 0) {
+			key[i] = isc_ascii_tolower(name->ndata[i]);
+			i++;
+		}
+	}
+
+	return (labels);
+}
+
 static isc_result_t
 load(dns_zone_t *zone, void *uap);
 
@@ -95,6 +125,9 @@ dns_zt_create(isc_mem_t *mctx, dns_rdataclass_t rdclass, dns_zt_t **ztp) {
 		goto cleanup_zt;
 	}
 
+	zt->origins = NULL;
+	isc_ht_init(&zt->origins, mctx, 8, ISC_HT_CASE_SENSITIVE);
+
 	isc_rwlock_init(&zt->rwlock, 0, 0);
 	zt->mctx = NULL;
 	isc_mem_attach(mctx, &zt->mctx);
@@ -121,16 +154,24 @@ dns_zt_mount(dns_zt_t *zt, dns_zone_t *zone) {
 	isc_result_t result;
 	dns_zone_t *dummy = NULL;
 	dns_name_t *name;
+	unsigned char key[DNS_NAME_MAXWIRE];
 
 	REQUIRE(VALID_ZT(zt));
 
 	name = dns_zone_getorigin(zone);
+	(void)zt_key(name, key, NULL);
 
 	RWLOCK(&zt->rwlock, isc_rwlocktype_write);
 
 	result = dns_rbt_addname(zt->table, name, zone);
 	if (result == ISC_R_SUCCESS) {
+		if (dns_name_isabsolute(name)) {
+			RUNTIME_CHECK(isc_ht_add(zt->origins, key,
+						 name->length,
+						 zone) == ISC_R_SUCCESS);
+		}
 		dns_zone_attach(zone, &dummy);
+		dns_db_newgeneration();
 	}
 
 	RWUNLOCK(&zt->rwlock, isc_rwlocktype_write);
@@ -142,20 +183,64 @@ isc_result_t
 dns_zt_unmount(dns_zt_t *zt, dns_zone_t *zone) {
 	isc_result_t result;
 	dns_name_t *name;
+	unsigned char key[DNS_NAME_MAXWIRE];
 
 	REQUIRE(VALID_ZT(zt));
 
 	name = dns_zone_getorigin(zone);
+	(void)zt_key(name, key, NULL);
 
 	RWLOCK(&zt->rwlock, isc_rwlocktype_write);
 
 	result = dns_rbt_deletename(zt->table, name, false);
+	if (result == ISC_R_SUCCESS) {
+		(void)isc_ht_delete(zt->origins, key, name->length);
+		dns_db_newgeneration();
+	}
 
 	RWUNLOCK(&zt->rwlock, isc_rwlocktype_write);
 
 	return (result);
 }
 
+/*%
+ * Find the deepest zone at or above the absolute name 'name' by looking
+ * up its suffixes in the origins table, most specific first.  This is
+ * one hash lookup per label instead of a walk down the tree.
+ *
+ * Requires the zone table lock.
+ */
+static isc_result_t
+zt_findorigin(dns_zt_t *zt, const dns_name_t *name, unsigned int options,
+	      dns_name_t *foundname, dns_zone_t **zonep) {
+	unsigned char key[DNS_NAME_MAXWIRE];
+	dns_offsets_t offsets;
+	unsigned int labels, i = 0;
+
+	labels = zt_key(name, key, offsets);
+	if ((options & DNS_ZTFIND_NOEXACT) != 0) {
+		i++;
+	}
+
+	for (; i < labels; i++) {
+		void *data = NULL;
+		isc_result_t result;
+
+		result = isc_ht_find(zt->origins, key + offsets[i],
+				     name->length - offsets[i], &data);
+		if (result == ISC_R_SUCCESS) {
+			*zonep = data;
+			if (foundname != NULL) {
+				dns_name_copy(dns_zone_getorigin(data),
+					      foundname);
+			}
+			return ((i == 0) ? ISC_R_SUCCESS : DNS_R_PARTIALMATCH);
+		}
+	}
+
+	return (ISC_R_NOTFOUND);
+}
+
 isc_result_t
 dns_zt_find(dns_zt_t *zt, const dns_name_t *name, unsigned int options,
 	    dns_name_t *foundname, dns_zone_t **zonep) {
@@ -171,8 +256,12 @@ dns_zt_find(dns_zt_t *zt, const dns_name_t *name, unsigned int options,
 
 	RWLOCK(&zt->rwlock, isc_rwlocktype_read);
 
-	result = dns_rbt_findname(zt->table, name, rbtoptions, foundname,
-				  (void **)(void *)&dummy);
+	if (dns_name_isabsolute(name)) {
+		result = zt_findorigin(zt, name, options, foundname, &dummy);
+	} else {
+		result = dns_rbt_findname(zt->table, name, rbtoptions,
+					  foundname, (void **)(void *)&dummy);
+	}
 	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH) {
 		/*
 		 * If DNS_ZTFIND_MIRROR is set and the zone which was
@@ -232,6 +321,7 @@ zt_destroy(dns_zt_t *zt) {
 				   NULL);
 	}
 
+	isc_ht_destroy(&zt->origins);
 	dns_rbt_destroy(&zt->table);
 	isc_rwlock_destroy(&zt->rwlock);
 	zt->magic = 0;
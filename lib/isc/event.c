@@ -16,9 +16,33 @@
  */
 
 #include <isc/event.h>
+#include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/refcount.h>
 #include <isc/util.h>
 
+#define EVENTPOOL_MAGIC	   ISC_MAGIC('E', 'v', 'P', 'l')
+#define VALID_EVENTPOOL(p) ISC_MAGIC_VALID(p, EVENTPOOL_MAGIC)
+
+/*%
+ * The pool is shared by all threads, each using one of EVENTPOOL_SLOTS
+ * slots, and keeps up to EVENTPOOL_FREEMAX spare events in its depot.
+ */
+#define EVENTPOOL_SLOTS	  16
+#define EVENTPOOL_FREEMAX 1024
+
+/*%
+ * Every event allocated from the pool holds a reference to it, so the
+ * pool outlives its owner until the last event has been freed.
+ */
+struct isc_eventpool {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	size_t size;
+	isc_mempool_t *mpctx;
+};
+
 /***
  *** Events.
  ***/
@@ -77,6 +101,77 @@ isc_event_constallocate(isc_mem_t *mctx, void *sender, isc_eventtype_t type,
 	return (event);
 }
 
+static void
+eventpool_destroy(isc_eventpool_t *pool) {
+	pool->magic = 0;
+	isc_refcount_destroy(&pool->references);
+	isc_mempool_destroy(&pool->mpctx);
+	isc_mem_putanddetach(&pool->mctx, pool, sizeof(*pool));
+}
+
+static void
+eventpool_detach(isc_eventpool_t **poolp) {
+	isc_eventpool_t *pool = *poolp;
+
+	*poolp = NULL;
+	if (isc_refcount_decrement(&pool->references) == 1) {
+		eventpool_destroy(pool);
+	}
+}
+
+static void
+pool_destroy(isc_event_t *event) {
+	isc_eventpool_t *pool = event->ev_destroy_arg;
+
+	isc_mempool_put(pool->mpctx, event);
+	eventpool_detach(&pool);
+}
+
+void
+isc_eventpool_create(isc_mem_t *mctx, size_t size, isc_eventpool_t **poolp) {
+	isc_eventpool_t *pool = NULL;
+
+	REQUIRE(size >= sizeof(struct isc_event));
+	REQUIRE(poolp != NULL && *poolp == NULL);
+
+	pool = isc_mem_get(mctx, sizeof(*pool));
+	*pool = (isc_eventpool_t){ .size = size };
+	isc_mem_attach(mctx, &pool->mctx);
+	isc_refcount_init(&pool->references, 1);
+	isc_mempool_create(mctx, size, &pool->mpctx);
+	isc_mempool_setname(pool->mpctx, "events");
+	isc_mempool_setfreemax(pool->mpctx, EVENTPOOL_FREEMAX);
+	isc_mempool_setshared(pool->mpctx, EVENTPOOL_SLOTS);
+	pool->magic = EVENTPOOL_MAGIC;
+
+	*poolp = pool;
+}
+
+void
+isc_eventpool_detach(isc_eventpool_t **poolp) {
+	REQUIRE(poolp != NULL && VALID_EVENTPOOL(*poolp));
+
+	eventpool_detach(poolp);
+}
+
+isc_event_t *
+isc_event_poolallocate(isc_eventpool_t *pool, void *sender,
+		       isc_eventtype_t type, isc_taskaction_t action,
+		       void *arg) {
+	isc_event_t *event;
+
+	REQUIRE(VALID_EVENTPOOL(pool));
+	REQUIRE(action != NULL);
+
+	event = isc_mempool_get(pool->mpctx);
+	isc_refcount_increment(&pool->references);
+
+	ISC_EVENT_INIT(event, pool->size, 0, NULL, type, action, arg, sender,
+		       pool_destroy, pool);
+
+	return (event);
+}
+
 void
 isc_event_free(isc_event_t **eventp) {
 	isc_event_t *event;
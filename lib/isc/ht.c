@@ -14,6 +14,11 @@
 #include <inttypes.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif /* if defined(__SSE2__) */
+
+#include <isc/endian.h>
 #include <isc/hash.h>
 #include <isc/ht.h>
 #include <isc/magic.h>
@@ -22,216 +27,284 @@
 #include <isc/types.h>
 #include <isc/util.h>
 
-typedef struct isc_ht_node isc_ht_node_t;
+/*
+ * The hashtable uses open addressing in the style of the "Swiss tables"
+ * (Abseil's flat_hash_map).  Next to the array of slots, there is an
+ * array with a control byte for every slot: a free slot is marked as
+ * empty, or as deleted if it once held an entry; a used slot holds the
+ * low 7 bits of the hash value of its key.  The slots are divided into
+ * groups, whose control bytes are all compared with the wanted 7 bits at
+ * once, using SSE2 or 64-bit arithmetic.  Only the slots that match are
+ * looked at, so a lookup rarely touches more than one slot.
+ *
+ * The remaining bits of the hash value select the first group to look
+ * at; the next groups are probed quadratically.  A lookup stops at the
+ * first group with an empty slot.  To keep this correct, a deleted slot
+ * can only be marked as empty if its group already has an empty slot.
+ *
+ * Keys of up to HT_INLINE_KEY bytes are stored in the slot itself, and
+ * longer ones are allocated separately.  When the used and deleted slots
+ * would exceed 7/8 of the table, the entries are moved to a new table,
+ * twice as large unless most of the used slots were deleted.
+ */
 
 #define ISC_HT_MAGIC	 ISC_MAGIC('H', 'T', 'a', 'b')
 #define ISC_HT_VALID(ht) ISC_MAGIC_VALID(ht, ISC_HT_MAGIC)
 
-#define HT_NO_BITS    0
-#define HT_MIN_BITS   1
-#define HT_MAX_BITS   32
-#define HT_OVERCOMMIT 3
+#define HT_MIN_BITS	 1
+#define HT_MAX_BITS	 32
+#define HT_MAX_INIT_BITS 12
+#define HT_INLINE_KEY	 16
 
-#define HT_NEXTTABLE(idx)      ((idx == 0) ? 1 : 0)
-#define TRY_NEXTTABLE(idx, ht) (idx == ht->hindex && rehashing_in_progress(ht))
+#define HASHSIZE(bits) (UINT64_C(1) << (bits))
 
-#define GOLDEN_RATIO_32 0x61C88647
+#define CTRL_EMPTY   0x80
+#define CTRL_DELETED 0xfe
+#define CTRL_FULL(c) (((c)&0x80) == 0)
 
-#define HASHSIZE(bits) (UINT64_C(1) << (bits))
+#define H1(hashval) ((hashval) >> 7)
+#define H2(hashval) ((uint8_t)((hashval)&0x7f))
+
+#define MAX_LOAD(size) ((size) - (size) / 8)
+
+#if defined(__SSE2__)
+
+#define GROUP_SIZE 16
+
+/* One bit for each slot in the group */
+typedef uint32_t groupmask_t;
+
+static groupmask_t
+group_match(const uint8_t *ctrl, uint8_t c) {
+	__m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+	return ((groupmask_t)_mm_movemask_epi8(
+		_mm_cmpeq_epi8(_mm_set1_epi8((char)c), group)));
+}
+
+static groupmask_t
+group_match_empty(const uint8_t *ctrl) {
+	return (group_match(ctrl, CTRL_EMPTY));
+}
+
+static groupmask_t
+group_match_free(const uint8_t *ctrl) {
+	__m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+	return ((groupmask_t)_mm_movemask_epi8(group));
+}
+
+static unsigned int
+groupmask_first(groupmask_t mask) {
+	return (__builtin_ctz(mask));
+}
+
+#else /* if defined(__SSE2__) */
+
+#define GROUP_SIZE 8
+
+#define LSBS UINT64_C(0x0101010101010101)
+#define MSBS UINT64_C(0x8080808080808080)
+
+/* The high bit of each byte for each slot in the group */
+typedef uint64_t groupmask_t;
+
+static uint64_t
+group_load(const uint8_t *ctrl) {
+	uint64_t group;
+
+	memmove(&group, ctrl, sizeof(group));
+
+	return (le64toh(group));
+}
+
+/*
+ * This can also match a byte that follows a matching byte, which is
+ * harmless, as the keys of the matching slots are compared anyway.
+ */
+static groupmask_t
+group_match(const uint8_t *ctrl, uint8_t c) {
+	uint64_t x = group_load(ctrl) ^ (LSBS * c);
+
+	return ((x - LSBS) & ~x & MSBS);
+}
+
+static groupmask_t
+group_match_empty(const uint8_t *ctrl) {
+	uint64_t group = group_load(ctrl);
 
-struct isc_ht_node {
+	/* Empty has the high bit set, deleted also has bit 1 set */
+	return (group & ~(group << 6) & MSBS);
+}
+
+static groupmask_t
+group_match_free(const uint8_t *ctrl) {
+	return (group_load(ctrl) & MSBS);
+}
+
+static unsigned int
+groupmask_first(groupmask_t mask) {
+	return (__builtin_ctzll(mask) / 8);
+}
+
+#endif /* if defined(__SSE2__) */
+
+typedef struct isc_ht_slot {
 	void *value;
-	isc_ht_node_t *next;
 	uint32_t hashval;
-	size_t keysize;
-	unsigned char key[];
-};
+	uint32_t keysize;
+	union {
+		unsigned char key[HT_INLINE_KEY];
+		unsigned char *keyp;
+	};
+} isc_ht_slot_t;
+
+#define SLOT_KEY(slot) \
+	(((slot)->keysize <= HT_INLINE_KEY) ? (slot)->key : (slot)->keyp)
 
 struct isc_ht {
 	unsigned int magic;
 	isc_mem_t *mctx;
 	size_t count;
+	size_t deleted;
 	bool case_sensitive;
-	size_t size[2];
-	uint8_t hashbits[2];
-	isc_ht_node_t **table[2];
-	uint8_t hindex;
-	uint32_t hiter; /* rehashing iterator */
+	size_t size; /* a power of 2, at least GROUP_SIZE */
+	uint8_t *ctrl;
+	isc_ht_slot_t *slots;
 };
 
 struct isc_ht_iter {
 	isc_ht_t *ht;
 	size_t i;
-	uint8_t hindex;
-	isc_ht_node_t *cur;
+	isc_ht_slot_t *cur;
 };
 
-static isc_ht_node_t *
-isc__ht_find(const isc_ht_t *ht, const unsigned char *key,
-	     const uint32_t keysize, const uint32_t hashval, const uint8_t idx);
-static void
-isc__ht_add(isc_ht_t *ht, const unsigned char *key, const uint32_t keysize,
-	    const uint32_t hashval, const uint8_t idx, void *value);
-static isc_result_t
-isc__ht_delete(isc_ht_t *ht, const unsigned char *key, const uint32_t keysize,
-	       const uint32_t hashval, const uint8_t idx);
-
-static uint32_t
-rehash_bits(isc_ht_t *ht, size_t newcount);
-
-static void
-hashtable_new(isc_ht_t *ht, const uint8_t idx, const uint8_t bits);
-static void
-hashtable_free(isc_ht_t *ht, const uint8_t idx);
-static void
-hashtable_rehash(isc_ht_t *ht, uint32_t newbits);
-static void
-hashtable_rehash_one(isc_ht_t *ht);
-static void
-maybe_rehash(isc_ht_t *ht, size_t newcount);
-
 static isc_result_t
 isc__ht_iter_next(isc_ht_iter_t *it);
 
 static bool
-isc__ht_node_match(isc_ht_node_t *node, const uint32_t hashval,
+isc__ht_slot_match(const isc_ht_slot_t *slot, const uint32_t hashval,
 		   const uint8_t *key, uint32_t keysize) {
-	return (node->hashval == hashval && node->keysize == keysize &&
-		memcmp(node->key, key, keysize) == 0);
+	return (slot->hashval == hashval && slot->keysize == keysize &&
+		memcmp(SLOT_KEY(slot), key, keysize) == 0);
 }
 
-static uint32_t
-hash_32(uint32_t val, unsigned int bits) {
-	REQUIRE(bits <= HT_MAX_BITS);
-	/* High bits are more random. */
-	return (val * GOLDEN_RATIO_32 >> (32 - bits));
-}
+/*
+ * Return the index of the slot holding 'key', or ht->size if there is
+ * none.
+ */
+static size_t
+isc__ht_find(const isc_ht_t *ht, const unsigned char *key,
+	     const uint32_t keysize, const uint32_t hashval) {
+	size_t gmask = ht->size / GROUP_SIZE - 1;
+	size_t g = H1(hashval) & gmask;
 
-static bool
-rehashing_in_progress(const isc_ht_t *ht) {
-	return (ht->table[HT_NEXTTABLE(ht->hindex)] != NULL);
-}
+	for (size_t probe = 1;; probe++) {
+		const uint8_t *ctrl = &ht->ctrl[g * GROUP_SIZE];
+		groupmask_t mask = group_match(ctrl, H2(hashval));
 
-static bool
-hashtable_is_overcommited(isc_ht_t *ht) {
-	return (ht->count >= (ht->size[ht->hindex] * HT_OVERCOMMIT));
-}
+		while (mask != 0) {
+			size_t i = g * GROUP_SIZE + groupmask_first(mask);
+
+			if (isc__ht_slot_match(&ht->slots[i], hashval, key,
+					       keysize))
+			{
+				return (i);
+			}
+			mask &= mask - 1;
+		}
 
-static uint32_t
-rehash_bits(isc_ht_t *ht, size_t newcount) {
-	uint32_t newbits = ht->hashbits[ht->hindex];
+		if (group_match_empty(ctrl) != 0) {
+			return (ht->size);
+		}
 
-	while (newcount >= HASHSIZE(newbits) && newbits <= HT_MAX_BITS) {
-		newbits += 1;
+		INSIST(probe <= gmask);
+		g = (g + probe) & gmask;
 	}
-
-	return (newbits);
 }
 
 /*
- * Rebuild the hashtable to reduce the load factor
+ * Return the index of the first free slot for 'hashval'.
  */
-static void
-hashtable_rehash(isc_ht_t *ht, uint32_t newbits) {
-	uint8_t oldindex = ht->hindex;
-	uint32_t oldbits = ht->hashbits[oldindex];
-	uint8_t newindex = HT_NEXTTABLE(oldindex);
+static size_t
+isc__ht_find_free(const isc_ht_t *ht, const uint32_t hashval) {
+	size_t gmask = ht->size / GROUP_SIZE - 1;
+	size_t g = H1(hashval) & gmask;
 
-	REQUIRE(ht->hashbits[oldindex] >= HT_MIN_BITS);
-	REQUIRE(ht->hashbits[oldindex] <= HT_MAX_BITS);
-	REQUIRE(ht->table[oldindex] != NULL);
+	for (size_t probe = 1;; probe++) {
+		groupmask_t mask = group_match_free(&ht->ctrl[g * GROUP_SIZE]);
 
-	REQUIRE(newbits <= HT_MAX_BITS);
-	REQUIRE(ht->hashbits[newindex] == HT_NO_BITS);
-	REQUIRE(ht->table[newindex] == NULL);
-
-	REQUIRE(newbits > oldbits);
-
-	hashtable_new(ht, newindex, newbits);
+		if (mask != 0) {
+			return (g * GROUP_SIZE + groupmask_first(mask));
+		}
 
-	ht->hindex = newindex;
+		INSIST(probe <= gmask);
+		g = (g + probe) & gmask;
+	}
+}
 
-	hashtable_rehash_one(ht);
+static void
+hashtable_new(isc_ht_t *ht, size_t size) {
+	ht->size = size;
+	ht->ctrl = isc_mem_get(ht->mctx, size);
+	memset(ht->ctrl, CTRL_EMPTY, size);
+	ht->slots = isc_mem_get(ht->mctx, size * sizeof(ht->slots[0]));
 }
 
 static void
-hashtable_rehash_one(isc_ht_t *ht) {
-	isc_ht_node_t **newtable = ht->table[ht->hindex];
-	uint32_t oldsize = ht->size[HT_NEXTTABLE(ht->hindex)];
-	isc_ht_node_t **oldtable = ht->table[HT_NEXTTABLE(ht->hindex)];
-	isc_ht_node_t *node = NULL;
-	isc_ht_node_t *nextnode;
-
-	/* Find first non-empty node */
-	while (ht->hiter < oldsize && oldtable[ht->hiter] == NULL) {
-		ht->hiter++;
-	}
+hashtable_free(isc_ht_t *ht, uint8_t *ctrl, isc_ht_slot_t *slots,
+	       size_t size) {
+	isc_mem_put(ht->mctx, ctrl, size);
+	isc_mem_put(ht->mctx, slots, size * sizeof(slots[0]));
+}
 
-	/* Rehashing complete */
-	if (ht->hiter == oldsize) {
-		hashtable_free(ht, HT_NEXTTABLE(ht->hindex));
-		ht->hiter = 0;
-		return;
-	}
+/*
+ * Move the entries to a new table of 'newsize' slots, dropping the
+ * deleted slots.
+ */
+static void
+hashtable_rehash(isc_ht_t *ht, size_t newsize) {
+	uint8_t *oldctrl = ht->ctrl;
+	isc_ht_slot_t *oldslots = ht->slots;
+	size_t oldsize = ht->size;
 
-	/* Move the first non-empty node from old hashtable to new hashtable */
-	for (node = oldtable[ht->hiter]; node != NULL; node = nextnode) {
-		uint32_t hash = hash_32(node->hashval,
-					ht->hashbits[ht->hindex]);
-		nextnode = node->next;
-		node->next = newtable[hash];
-		newtable[hash] = node;
-	}
+	REQUIRE(ht->count < MAX_LOAD(newsize));
 
-	oldtable[ht->hiter] = NULL;
+	hashtable_new(ht, newsize);
+	ht->deleted = 0;
 
-	ht->hiter++;
-}
+	for (size_t i = 0; i < oldsize; i++) {
+		size_t j;
 
-static void
-maybe_rehash(isc_ht_t *ht, size_t newcount) {
-	uint32_t newbits = rehash_bits(ht, newcount);
+		if (!CTRL_FULL(oldctrl[i])) {
+			continue;
+		}
 
-	if (ht->hashbits[ht->hindex] < newbits && newbits <= HT_MAX_BITS) {
-		hashtable_rehash(ht, newbits);
+		j = isc__ht_find_free(ht, oldslots[i].hashval);
+		ht->ctrl[j] = oldctrl[i];
+		ht->slots[j] = oldslots[i];
 	}
+
+	hashtable_free(ht, oldctrl, oldslots, oldsize);
 }
 
 static void
-hashtable_new(isc_ht_t *ht, const uint8_t idx, const uint8_t bits) {
-	size_t size;
-	REQUIRE(ht->hashbits[idx] == HT_NO_BITS);
-	REQUIRE(ht->table[idx] == NULL);
-	REQUIRE(bits >= HT_MIN_BITS);
-	REQUIRE(bits <= HT_MAX_BITS);
-
-	ht->hashbits[idx] = bits;
-	ht->size[idx] = HASHSIZE(ht->hashbits[idx]);
+maybe_rehash(isc_ht_t *ht) {
+	size_t newsize = ht->size;
 
-	size = ht->size[idx] * sizeof(isc_ht_node_t *);
-
-	ht->table[idx] = isc_mem_get(ht->mctx, size);
-	memset(ht->table[idx], 0, size);
-}
+	if (ht->count + ht->deleted < MAX_LOAD(ht->size)) {
+		return;
+	}
 
-static void
-hashtable_free(isc_ht_t *ht, const uint8_t idx) {
-	size_t size = ht->size[idx] * sizeof(isc_ht_node_t *);
-
-	for (size_t i = 0; i < ht->size[idx]; i++) {
-		isc_ht_node_t *node = ht->table[idx][i];
-		while (node != NULL) {
-			isc_ht_node_t *next = node->next;
-			ht->count--;
-			isc_mem_put(ht->mctx, node,
-				    sizeof(*node) + node->keysize);
-			node = next;
-		}
+	/*
+	 * Grow the table, unless dropping the deleted slots leaves
+	 * plenty of room.
+	 */
+	if (ht->count >= MAX_LOAD(ht->size) / 2) {
+		newsize *= 2;
 	}
 
-	isc_mem_put(ht->mctx, ht->table[idx], size);
-	ht->hashbits[idx] = HT_NO_BITS;
-	ht->table[idx] = NULL;
+	hashtable_rehash(ht, newsize);
 }
 
 void
@@ -242,7 +315,7 @@ isc_ht_init(isc_ht_t **htp, isc_mem_t *mctx, uint8_t bits,
 
 	REQUIRE(htp != NULL && *htp == NULL);
 	REQUIRE(mctx != NULL);
-	REQUIRE(bits >= 1 && bits <= HT_MAX_BITS);
+	REQUIRE(bits >= HT_MIN_BITS && bits <= HT_MAX_BITS);
 
 	ht = isc_mem_get(mctx, sizeof(*ht));
 	*ht = (isc_ht_t){
@@ -251,7 +324,12 @@ isc_ht_init(isc_ht_t **htp, isc_mem_t *mctx, uint8_t bits,
 
 	isc_mem_attach(mctx, &ht->mctx);
 
-	hashtable_new(ht, 0, bits);
+	/*
+	 * The table grows as needed, so don't allocate a huge one just
+	 * because it was asked for.
+	 */
+	bits = ISC_MIN(bits, HT_MAX_INIT_BITS);
+	hashtable_new(ht, ISC_MAX(HASHSIZE(bits), GROUP_SIZE));
 
 	ht->magic = ISC_HT_MAGIC;
 
@@ -269,98 +347,70 @@ isc_ht_destroy(isc_ht_t **htp) {
 	*htp = NULL;
 	ht->magic = 0;
 
-	for (size_t i = 0; i <= 1; i++) {
-		if (ht->table[i] != NULL) {
-			hashtable_free(ht, i);
+	for (size_t i = 0; i < ht->size; i++) {
+		isc_ht_slot_t *slot = &ht->slots[i];
+
+		if (!CTRL_FULL(ht->ctrl[i])) {
+			continue;
+		}
+		if (slot->keysize > HT_INLINE_KEY) {
+			isc_mem_put(ht->mctx, slot->keyp, slot->keysize);
 		}
+		ht->count--;
 	}
 
 	INSIST(ht->count == 0);
 
-	isc_mem_putanddetach(&ht->mctx, ht, sizeof(*ht));
-}
+	hashtable_free(ht, ht->ctrl, ht->slots, ht->size);
 
-static void
-isc__ht_add(isc_ht_t *ht, const unsigned char *key, const uint32_t keysize,
-	    const uint32_t hashval, const uint8_t idx, void *value) {
-	isc_ht_node_t *node;
-	uint32_t hash;
-
-	hash = hash_32(hashval, ht->hashbits[idx]);
-
-	node = isc_mem_get(ht->mctx, sizeof(*node) + keysize);
-	*node = (isc_ht_node_t){
-		.keysize = keysize,
-		.hashval = hashval,
-		.next = ht->table[idx][hash],
-		.value = value,
-	};
-
-	memmove(node->key, key, keysize);
-
-	ht->count++;
-	ht->table[idx][hash] = node;
+	isc_mem_putanddetach(&ht->mctx, ht, sizeof(*ht));
 }
 
 isc_result_t
 isc_ht_add(isc_ht_t *ht, const unsigned char *key, const uint32_t keysize,
 	   void *value) {
+	isc_ht_slot_t *slot = NULL;
 	uint32_t hashval;
+	size_t i;
 
 	REQUIRE(ISC_HT_VALID(ht));
 	REQUIRE(key != NULL && keysize > 0);
 
-	if (rehashing_in_progress(ht)) {
-		/* Rehash in progress */
-		hashtable_rehash_one(ht);
-	} else if (hashtable_is_overcommited(ht)) {
-		/* Rehash requested */
-		maybe_rehash(ht, ht->count);
-	}
-
 	hashval = isc_hash32(key, keysize, ht->case_sensitive);
 
-	if (isc__ht_find(ht, key, keysize, hashval, ht->hindex) != NULL) {
+	if (isc__ht_find(ht, key, keysize, hashval) != ht->size) {
 		return (ISC_R_EXISTS);
 	}
 
-	isc__ht_add(ht, key, keysize, hashval, ht->hindex, value);
+	maybe_rehash(ht);
 
-	return (ISC_R_SUCCESS);
-}
-
-static isc_ht_node_t *
-isc__ht_find(const isc_ht_t *ht, const unsigned char *key,
-	     const uint32_t keysize, const uint32_t hashval,
-	     const uint8_t idx) {
-	uint32_t hash;
-	uint8_t findex = idx;
-
-nexttable:
-	hash = hash_32(hashval, ht->hashbits[findex]);
-	for (isc_ht_node_t *node = ht->table[findex][hash]; node != NULL;
-	     node = node->next)
-	{
-		if (isc__ht_node_match(node, hashval, key, keysize)) {
-			return (node);
-		}
+	i = isc__ht_find_free(ht, hashval);
+	if (ht->ctrl[i] == CTRL_DELETED) {
+		ht->deleted--;
 	}
-	if (TRY_NEXTTABLE(findex, ht)) {
-		/*
-		 * Rehashing in progress, check the other table
-		 */
-		findex = HT_NEXTTABLE(findex);
-		goto nexttable;
+	ht->ctrl[i] = H2(hashval);
+
+	slot = &ht->slots[i];
+	*slot = (isc_ht_slot_t){
+		.value = value,
+		.hashval = hashval,
+		.keysize = keysize,
+	};
+	if (keysize > HT_INLINE_KEY) {
+		slot->keyp = isc_mem_get(ht->mctx, keysize);
 	}
+	memmove(SLOT_KEY(slot), key, keysize);
 
-	return (NULL);
+	ht->count++;
+
+	return (ISC_R_SUCCESS);
 }
 
 isc_result_t
 isc_ht_find(const isc_ht_t *ht, const unsigned char *key,
 	    const uint32_t keysize, void **valuep) {
 	uint32_t hashval;
-	isc_ht_node_t *node;
+	size_t i;
 
 	REQUIRE(ISC_HT_VALID(ht));
 	REQUIRE(key != NULL && keysize > 0);
@@ -368,73 +418,60 @@ isc_ht_find(const isc_ht_t *ht, const unsigned char *key,
 
 	hashval = isc_hash32(key, keysize, ht->case_sensitive);
 
-	node = isc__ht_find(ht, key, keysize, hashval, ht->hindex);
-	if (node == NULL) {
+	i = isc__ht_find(ht, key, keysize, hashval);
+	if (i == ht->size) {
 		return (ISC_R_NOTFOUND);
 	}
 
 	if (valuep != NULL) {
-		*valuep = node->value;
+		*valuep = ht->slots[i].value;
 	}
 	return (ISC_R_SUCCESS);
 }
 
-static isc_result_t
-isc__ht_delete(isc_ht_t *ht, const unsigned char *key, const uint32_t keysize,
-	       const uint32_t hashval, const uint8_t idx) {
-	isc_ht_node_t *prev = NULL;
-	uint32_t hash;
-
-	hash = hash_32(hashval, ht->hashbits[idx]);
-
-	for (isc_ht_node_t *node = ht->table[idx][hash]; node != NULL;
-	     prev = node, node = node->next)
-	{
-		if (isc__ht_node_match(node, hashval, key, keysize)) {
-			if (prev == NULL) {
-				ht->table[idx][hash] = node->next;
-			} else {
-				prev->next = node->next;
-			}
-			isc_mem_put(ht->mctx, node,
-				    sizeof(*node) + node->keysize);
-			ht->count--;
+static void
+isc__ht_delete(isc_ht_t *ht, size_t i) {
+	isc_ht_slot_t *slot = &ht->slots[i];
+	const uint8_t *group = &ht->ctrl[i - i % GROUP_SIZE];
 
-			return (ISC_R_SUCCESS);
-		}
+	INSIST(CTRL_FULL(ht->ctrl[i]));
+
+	if (slot->keysize > HT_INLINE_KEY) {
+		isc_mem_put(ht->mctx, slot->keyp, slot->keysize);
+	}
+
+	/*
+	 * If the group has an empty slot, no lookup has ever gone past
+	 * it, so this slot can be marked as empty too.
+	 */
+	if (group_match_empty(group) != 0) {
+		ht->ctrl[i] = CTRL_EMPTY;
+	} else {
+		ht->ctrl[i] = CTRL_DELETED;
+		ht->deleted++;
 	}
 
-	return (ISC_R_NOTFOUND);
+	ht->count--;
 }
 
 isc_result_t
 isc_ht_delete(isc_ht_t *ht, const unsigned char *key, const uint32_t keysize) {
 	uint32_t hashval;
-	uint8_t hindex;
-	isc_result_t result;
+	size_t i;
 
 	REQUIRE(ISC_HT_VALID(ht));
 	REQUIRE(key != NULL && keysize > 0);
 
-	if (rehashing_in_progress(ht)) {
-		/* Rehash in progress */
-		hashtable_rehash_one(ht);
-	}
-
-	hindex = ht->hindex;
 	hashval = isc_hash32(key, keysize, ht->case_sensitive);
-nexttable:
-	result = isc__ht_delete(ht, key, keysize, hashval, hindex);
-
-	if (result == ISC_R_NOTFOUND && TRY_NEXTTABLE(hindex, ht)) {
-		/*
-		 * Rehashing in progress, check the other table
-		 */
-		hindex = HT_NEXTTABLE(hindex);
-		goto nexttable;
+
+	i = isc__ht_find(ht, key, keysize, hashval);
+	if (i == ht->size) {
+		return (ISC_R_NOTFOUND);
 	}
 
-	return (result);
+	isc__ht_delete(ht, i);
+
+	return (ISC_R_SUCCESS);
 }
 
 void
@@ -447,7 +484,6 @@ isc_ht_iter_create(isc_ht_t *ht, isc_ht_iter_t **itp) {
 	it = isc_mem_get(ht->mctx, sizeof(isc_ht_iter_t));
 	*it = (isc_ht_iter_t){
 		.ht = ht,
-		.hindex = ht->hindex,
 	};
 
 	*itp = it;
@@ -468,13 +504,8 @@ isc_ht_iter_destroy(isc_ht_iter_t **itp) {
 
 isc_result_t
 isc_ht_iter_first(isc_ht_iter_t *it) {
-	isc_ht_t *ht;
-
 	REQUIRE(it != NULL);
 
-	ht = it->ht;
-
-	it->hindex = ht->hindex;
 	it->i = 0;
 
 	return (isc__ht_iter_next(it));
@@ -484,24 +515,16 @@ static isc_result_t
 isc__ht_iter_next(isc_ht_iter_t *it) {
 	isc_ht_t *ht = it->ht;
 
-	while (it->i < ht->size[it->hindex] &&
-	       ht->table[it->hindex][it->i] == NULL)
-	{
+	while (it->i < ht->size && !CTRL_FULL(ht->ctrl[it->i])) {
 		it->i++;
 	}
 
-	if (it->i < ht->size[it->hindex]) {
-		it->cur = ht->table[it->hindex][it->i];
-
+	if (it->i < ht->size) {
+		it->cur = &ht->slots[it->i];
 		return (ISC_R_SUCCESS);
 	}
 
-	if (TRY_NEXTTABLE(it->hindex, ht)) {
-		it->hindex = HT_NEXTTABLE(it->hindex);
-		it->i = 0;
-		return (isc__ht_iter_next(it));
-	}
-
+	it->cur = NULL;
 	return (ISC_R_NOMORE);
 }
 
@@ -510,12 +533,6 @@ isc_ht_iter_next(isc_ht_iter_t *it) {
 	REQUIRE(it != NULL);
 	REQUIRE(it->cur != NULL);
 
-	it->cur = it->cur->next;
-
-	if (it->cur != NULL) {
-		return (ISC_R_SUCCESS);
-	}
-
 	it->i++;
 
 	return (isc__ht_iter_next(it));
@@ -523,26 +540,16 @@ isc_ht_iter_next(isc_ht_iter_t *it) {
 
 isc_result_t
 isc_ht_iter_delcurrent_next(isc_ht_iter_t *it) {
-	isc_result_t result = ISC_R_SUCCESS;
-	isc_ht_node_t *dnode = NULL;
-	uint8_t dindex;
-	isc_ht_t *ht;
-	isc_result_t dresult;
+	size_t i;
 
 	REQUIRE(it != NULL);
 	REQUIRE(it->cur != NULL);
 
-	ht = it->ht;
-	dnode = it->cur;
-	dindex = it->hindex;
-
-	result = isc_ht_iter_next(it);
-
-	dresult = isc__ht_delete(ht, dnode->key, dnode->keysize, dnode->hashval,
-				 dindex);
-	INSIST(dresult == ISC_R_SUCCESS);
+	/* Deleting doesn't move the other entries. */
+	i = it->i;
+	isc__ht_delete(it->ht, i);
 
-	return (result);
+	return (isc_ht_iter_next(it));
 }
 
 void
@@ -561,7 +568,7 @@ isc_ht_iter_currentkey(isc_ht_iter_t *it, unsigned char **key,
 	REQUIRE(it->cur != NULL);
 	REQUIRE(key != NULL && *key == NULL);
 
-	*key = it->cur->key;
+	*key = SLOT_KEY(it->cur);
 	*keysize = it->cur->keysize;
 }
 
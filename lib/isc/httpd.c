@@ -82,6 +82,7 @@ struct isc_httpdurl {
 	isc_httpdaction_t *action;
 	void *action_arg;
 	bool isstatic;
+	bool offload; /*%< render in the netmgr work thread pool */
 	isc_time_t loadtime;
 	ISC_LINK(isc_httpdurl_t) link;
 };
@@ -136,6 +137,7 @@ typedef struct isc_httpd_sendreq {
 	isc_mem_t *mctx;
 	isc_httpd_t *httpd;
 	isc_nmhandle_t *handle;
+	isc_httpdurl_t *url; /*%< NULL if not found */
 
 	/*%
 	 * Transmit data state.
@@ -749,23 +751,11 @@ httpd_compress(isc_httpd_sendreq_t *req) {
 }
 #endif /* ifdef HAVE_ZLIB */
 
-static void
-prepare_response(isc_httpdmgr_t *mgr, isc_httpd_t *httpd,
-		 isc_httpd_sendreq_t **reqp) {
-	isc_httpd_sendreq_t *req = NULL;
-	isc_time_t now;
-	char datebuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
+static isc_httpdurl_t *
+find_url(isc_httpdmgr_t *mgr, isc_httpd_t *httpd) {
 	const char *path = "/";
 	size_t path_len = 1;
-	bool is_compressed = false;
 	isc_httpdurl_t *url = NULL;
-	isc_result_t result;
-
-	REQUIRE(VALID_HTTPD(httpd));
-	REQUIRE(reqp != NULL && *reqp == NULL);
-
-	isc_time_now(&now);
-	isc_time_formathttptimestamp(&now, datebuf, sizeof(datebuf));
 
 	if (httpd->up.field_set & (1 << ISC_UF_PATH)) {
 		path = &httpd->path[httpd->up.field_data[ISC_UF_PATH].off];
@@ -782,7 +772,20 @@ prepare_response(isc_httpdmgr_t *mgr, isc_httpd_t *httpd,
 	}
 	UNLOCK(&mgr->lock);
 
-	req = isc__httpd_sendreq_new(httpd);
+	return (url);
+}
+
+/*
+ * Fill in the response body.  This may run in the netmgr work thread
+ * pool: the request it answers stays in httpd->recvbuf, as the
+ * connection is not read from until the response has been sent.
+ */
+static void
+render_response(isc_httpd_sendreq_t *req) {
+	isc_httpd_t *httpd = req->httpd;
+	isc_httpdmgr_t *mgr = httpd->mgr;
+	isc_httpdurl_t *url = req->url;
+	isc_result_t result;
 
 	if (url == NULL) {
 		result = mgr->render_404(httpd, NULL, NULL, &req->retcode,
@@ -802,6 +805,21 @@ prepare_response(isc_httpdmgr_t *mgr, isc_httpd_t *httpd,
 					 &req->freecb_arg);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	}
+}
+
+static void
+prepare_response(isc_httpd_sendreq_t *req) {
+	isc_httpd_t *httpd = req->httpd;
+	isc_httpdurl_t *url = req->url;
+	isc_time_t now;
+	char datebuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
+	bool is_compressed = false;
+	isc_result_t result;
+
+	REQUIRE(VALID_HTTPD(httpd));
+
+	isc_time_now(&now);
+	isc_time_formathttptimestamp(&now, datebuf, sizeof(datebuf));
 
 #ifdef HAVE_ZLIB
 	if ((httpd->flags & HTTPD_ACCEPT_DEFLATE) != 0) {
@@ -813,7 +831,9 @@ prepare_response(isc_httpdmgr_t *mgr, isc_httpd_t *httpd,
 #endif /* ifdef HAVE_ZLIB */
 
 	httpd_response(httpd, req);
-	if ((httpd->flags & HTTPD_KEEPALIVE) != 0) {
+	if ((httpd->flags & HTTPD_CLOSE) != 0) {
+		httpd_addheader(req, "Connection", "close");
+	} else if ((httpd->flags & HTTPD_KEEPALIVE) != 0) {
 		httpd_addheader(req, "Connection", "Keep-Alive");
 	}
 	httpd_addheader(req, "Content-Type", req->mimetype);
@@ -874,14 +894,36 @@ prepare_response(isc_httpdmgr_t *mgr, isc_httpd_t *httpd,
 	}
 	httpd->recvlen -= httpd->consume;
 	httpd->consume = 0;
+}
+
+static void
+send_response(isc_httpd_sendreq_t *req) {
+	isc_region_t r;
+
+	prepare_response(req);
 
 	/*
-	 * We don't need to attach to httpd here because it gets only cleaned
-	 * when the last handle has been detached
+	 * Determine total response size.
 	 */
-	req->httpd = httpd;
+	isc_buffer_usedregion(req->sendbuffer, &r);
 
-	*reqp = req;
+	isc_nm_send(req->handle, &r, httpd_senddone, req);
+}
+
+static void
+render_work(void *arg) {
+	render_response(arg);
+}
+
+static void
+render_done(void *arg, isc_result_t result) {
+	isc_httpd_sendreq_t *req = arg;
+
+	if (result != ISC_R_SUCCESS) {
+		/* The work was not run. */
+		render_response(req);
+	}
+	send_response(req);
 }
 
 static void
@@ -891,7 +933,6 @@ httpd_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	isc_httpdmgr_t *mgr = arg;
 	isc_httpd_t *httpd = NULL;
 	isc_httpd_sendreq_t *req = NULL;
-	isc_region_t r;
 	size_t last_len = 0;
 
 	httpd = isc_nmhandle_getdata(handle);
@@ -947,15 +988,28 @@ httpd_request(isc_nmhandle_t *handle, isc_result_t eresult,
 		goto close_readhandle;
 	}
 
-	prepare_response(mgr, httpd, &req);
+	req = isc__httpd_sendreq_new(httpd);
+	/*
+	 * We don't need to attach to httpd here because it gets only cleaned
+	 * when the last handle has been detached
+	 */
+	req->httpd = httpd;
+	req->url = find_url(mgr, httpd);
+	isc_nmhandle_attach(httpd->handle, &req->handle);
 
 	/*
-	 * Determine total response size.
+	 * Expensive URLs are rendered in the work thread pool, so that
+	 * they don't hold up the network thread, and the response is sent
+	 * from render_done() back in this thread.
 	 */
-	isc_buffer_usedregion(req->sendbuffer, &r);
+	if (req->url != NULL && req->url->offload) {
+		isc_nm_work_offload(httpd->handle->sock->mgr, render_work,
+				    render_done, req);
+		return;
+	}
 
-	isc_nmhandle_attach(httpd->handle, &req->handle);
-	isc_nm_send(httpd->handle, &r, httpd_senddone, req);
+	render_response(req);
+	send_response(req);
 	return;
 
 close_readhandle:
@@ -1061,9 +1115,9 @@ detach:
 	isc__httpd_sendreq_free(req);
 }
 
-isc_result_t
-isc_httpdmgr_addurl(isc_httpdmgr_t *httpdmgr, const char *url, bool isstatic,
-		    isc_httpdaction_t *func, void *arg) {
+static isc_result_t
+httpdmgr_addurl(isc_httpdmgr_t *httpdmgr, const char *url, bool isstatic,
+		bool offload, isc_httpdaction_t *func, void *arg) {
 	isc_httpdurl_t *item;
 
 	REQUIRE(VALID_HTTPDMGR(httpdmgr));
@@ -1080,6 +1134,7 @@ isc_httpdmgr_addurl(isc_httpdmgr_t *httpdmgr, const char *url, bool isstatic,
 	item->action = func;
 	item->action_arg = arg;
 	item->isstatic = isstatic;
+	item->offload = offload;
 	isc_time_now(&item->loadtime);
 
 	ISC_LINK_INIT(item, link);
@@ -1091,6 +1146,20 @@ isc_httpdmgr_addurl(isc_httpdmgr_t *httpdmgr, const char *url, bool isstatic,
 	return (ISC_R_SUCCESS);
 }
 
+isc_result_t
+isc_httpdmgr_addurl(isc_httpdmgr_t *httpdmgr, const char *url, bool isstatic,
+		    isc_httpdaction_t *func, void *arg) {
+	return (httpdmgr_addurl(httpdmgr, url, isstatic, false, func, arg));
+}
+
+isc_result_t
+isc_httpdmgr_addworkurl(isc_httpdmgr_t *httpdmgr, const char *url,
+			isc_httpdaction_t *func, void *arg) {
+	REQUIRE(url != NULL);
+
+	return (httpdmgr_addurl(httpdmgr, url, false, true, func, arg));
+}
+
 void
 isc_httpd_setfinishhook(void (*fn)(void)) {
 #if ENABLE_AFL
@@ -1114,3 +1183,17 @@ const isc_time_t *
 isc_httpd_if_modified_since(const isc_httpd_t *httpd) {
 	return ((const isc_time_t *)&httpd->if_modified_since);
 }
+
+const char *
+isc_httpd_query(const isc_httpd_t *httpd, size_t *lenp) {
+	REQUIRE(VALID_HTTPD(httpd));
+	REQUIRE(lenp != NULL);
+
+	if ((httpd->up.field_set & (1 << ISC_UF_QUERY)) == 0) {
+		*lenp = 0;
+		return (NULL);
+	}
+
+	*lenp = httpd->up.field_data[ISC_UF_QUERY].len;
+	return (&httpd->path[httpd->up.field_data[ISC_UF_QUERY].off]);
+}
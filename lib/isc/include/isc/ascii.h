@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/ascii.h
+ * \brief Case-insensitive ASCII comparison and copying.
+ *
+ * DNS names compare without regard to the case of ASCII letters, and
+ * only of ASCII letters.  These functions handle eight bytes at a
+ * time, converting them to lower case with a few arithmetic operations
+ * on a 64-bit word ("SIMD within a register") instead of a table
+ * lookup per byte.  This needs no instruction set extensions or
+ * run-time CPU detection, and compilers can vectorize the loops
+ * further where the target allows it.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+/*%
+ * Convert a single byte to lower case.
+ */
+static inline uint8_t
+isc_ascii_tolower(uint8_t c) {
+	return (c + ('a' - 'A') * (c >= 'A' && c <= 'Z'));
+}
+
+/*%
+ * Convert the eight bytes in 'octets' to lower case.
+ *
+ * The high bit of each byte is used as a flag: adding to the low seven
+ * bits of each byte cannot carry into the next byte, so a pair of
+ * additions tells which bytes lie between 'A' and 'Z', and the 0x20
+ * bit is set in those bytes only.
+ */
+static inline uint64_t
+isc_ascii_tolower8(uint64_t octets) {
+	uint64_t all_bytes = 0x0101010101010101;
+	uint64_t heptets = octets & (0x7F * all_bytes);
+	uint64_t is_gt_Z = heptets + (0x7F - 'Z') * all_bytes;
+	uint64_t is_ge_A = heptets + (0x80 - 'A') * all_bytes;
+	uint64_t is_ascii = ~octets;
+	uint64_t is_upper = is_ascii & (is_ge_A ^ is_gt_Z) & (0x80 * all_bytes);
+
+	return (octets | (is_upper >> 2));
+}
+
+static inline uint64_t
+isc__ascii_load8(const uint8_t *ptr) {
+	uint64_t bytes;
+
+	memmove(&bytes, ptr, sizeof(bytes));
+	return (bytes);
+}
+
+/*%
+ * Return true if the 'len' bytes at 'a' and 'b' are equal, ignoring
+ * the case of ASCII letters.
+ */
+static inline bool
+isc_ascii_lowerequal(const uint8_t *a, const uint8_t *b, unsigned int len) {
+	while (len >= 8) {
+		if (isc_ascii_tolower8(isc__ascii_load8(a)) !=
+		    isc_ascii_tolower8(isc__ascii_load8(b)))
+		{
+			return (false);
+		}
+		a += 8;
+		b += 8;
+		len -= 8;
+	}
+	while (len-- > 0) {
+		if (isc_ascii_tolower(*a++) != isc_ascii_tolower(*b++)) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+/*%
+ * Compare the 'len' bytes at 'a' and 'b', ignoring the case of ASCII
+ * letters, and return the difference between the first pair of bytes
+ * that differ after conversion to lower case, or 0 if there is none.
+ */
+static inline int
+isc_ascii_lowercmp(const uint8_t *a, const uint8_t *b, unsigned int len) {
+	while (len >= 8) {
+		if (isc_ascii_tolower8(isc__ascii_load8(a)) !=
+		    isc_ascii_tolower8(isc__ascii_load8(b)))
+		{
+			break;
+		}
+		a += 8;
+		b += 8;
+		len -= 8;
+	}
+	while (len-- > 0) {
+		int diff = (int)isc_ascii_tolower(*a++) -
+			   (int)isc_ascii_tolower(*b++);
+		if (diff != 0) {
+			return (diff);
+		}
+	}
+	return (0);
+}
+
+/*%
+ * Copy 'len' bytes from 'src' to 'dst', converting ASCII letters to
+ * lower case.
+ */
+static inline void
+isc_ascii_lowercopy(uint8_t *dst, const uint8_t *src, unsigned int len) {
+	while (len >= 8) {
+		uint64_t bytes = isc_ascii_tolower8(isc__ascii_load8(src));
+		memmove(dst, &bytes, sizeof(bytes));
+		dst += 8;
+		src += 8;
+		len -= 8;
+	}
+	while (len-- > 0) {
+		*dst++ = isc_ascii_tolower(*src++);
+	}
+}
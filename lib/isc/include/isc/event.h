@@ -111,7 +111,49 @@ isc_event_constallocate(isc_mem_t *mctx, void *sender, isc_eventtype_t type,
  *\li	NULL if unable to allocate memory.
  */
 
+void
+isc_eventpool_create(isc_mem_t *mctx, size_t size, isc_eventpool_t **poolp);
+/*%<
+ * Create a pool of events of 'size' bytes, for a component that sends
+ * many events of the same type.  Events are allocated from the pool by
+ * isc_event_poolallocate(), and return to it when isc_event_free() is
+ * called; any thread may do either.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	'size' >= sizeof(struct isc_event)
+ *\li	'poolp' != NULL && '*poolp' == NULL
+ */
+
+void
+isc_eventpool_detach(isc_eventpool_t **poolp);
+/*%<
+ * Give up the creator's reference to the pool.  The pool is destroyed
+ * once every event allocated from it has been freed.
+ *
+ * Requires:
+ *\li	'poolp' points to a valid event pool.
+ */
+
+isc_event_t *
+isc_event_poolallocate(isc_eventpool_t *pool, void *sender,
+		       isc_eventtype_t type, isc_taskaction_t action,
+		       void *arg);
+/*%<
+ * Like isc_event_allocate(), but take the event from 'pool'; its size
+ * is the size the pool was created with.
+ *
+ * Requires:
+ *\li	'pool' is a valid event pool.
+ *\li	'action' to be non NULL
+ */
+
 void
 isc_event_free(isc_event_t **);
+/*%<
+ * Free an event by calling its destructor, if any.  Events embedded in
+ * other structures and initialized with ISC_EVENT_INIT() and a NULL
+ * destructor are left alone, so they can be sent again.
+ */
 
 ISC_LANG_ENDDECLS
@@ -80,6 +80,18 @@ isc_result_t
 isc_hmac_init(isc_hmac_t *hmac, const void *key, const size_t keylen,
 	      const isc_md_type_t *type);
 
+/**
+ * isc_hmac_copy:
+ * @to: HMAC context
+ * @from: HMAC context
+ *
+ * This function sets @to to the state of @from, so that a context set up
+ * with isc_hmac_init() once can be copied for every message instead of
+ * deriving the key schedule again.  @from is not modified.
+ */
+isc_result_t
+isc_hmac_copy(isc_hmac_t *to, const isc_hmac_t *from);
+
 /**
  * isc_hmac_reset:
  * @hmac: HMAC context
@@ -27,7 +27,8 @@ typedef struct isc_ht_iter isc_ht_iter_t;
 enum { ISC_HT_CASE_SENSITIVE = 0x00, ISC_HT_CASE_INSENSITIVE = 0x01 };
 
 /*%
- * Initialize hashtable at *htp, using memory context and size of (1<<bits)
+ * Initialize hashtable at *htp, using memory context and an initial size
+ * of (1<<bits), capped at 4096 entries; the hashtable grows as needed.
  *
  * If 'options' contains ISC_HT_CASE_INSENSITIVE, then upper- and lower-case
  * letters in key values will generate the same hash values; this can be used
@@ -171,7 +172,8 @@ isc_ht_iter_current(isc_ht_iter_t *it, void **valuep);
 
 /*%
  * Set 'key' and 'keysize to the current key and keysize for the value
- * under the iterator
+ * under the iterator.  The key is only valid until the hashtable is
+ * next modified.
  *
  * Requires:
  *\li	'it' is non NULL.
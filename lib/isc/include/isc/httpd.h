@@ -50,6 +50,15 @@ isc_result_t
 isc_httpdmgr_addurl(isc_httpdmgr_t *httpdmgr, const char *url, bool isstatic,
 		    isc_httpdaction_t *func, void *arg);
 
+isc_result_t
+isc_httpdmgr_addworkurl(isc_httpdmgr_t *httpdmgr, const char *url,
+			isc_httpdaction_t *func, void *arg);
+/*%<
+ * Like isc_httpdmgr_addurl(), for a URL which is expensive to render:
+ * 'func' is called in the netmgr work thread pool instead of in the
+ * network thread, so it must be thread-safe.
+ */
+
 void
 isc_httpd_setfinishhook(void (*fn)(void));
 
@@ -61,3 +70,11 @@ isc_httpdurl_loadtime(const isc_httpdurl_t *url);
 
 const isc_time_t *
 isc_httpd_if_modified_since(const isc_httpd_t *httpd);
+
+const char *
+isc_httpd_query(const isc_httpd_t *httpd, size_t *lenp);
+/*%<
+ * Return the query string of the request, without the leading '?',
+ * and store its length in '*lenp'; the string is not NUL terminated.
+ * Return NULL if the request has no query string.
+ */
@@ -35,4 +35,30 @@ isc_iterated_hash(unsigned char *out, const unsigned int hashalg,
 		  const int saltlength, const unsigned char *in,
 		  const int inlength);
 
+unsigned int
+isc_iterated_hash_batch(unsigned char *out[], const unsigned int hashalg,
+			const int iterations, const unsigned char *salt,
+			const int saltlength, const unsigned char *in[],
+			const int inlength[], const unsigned int count);
+/*%<
+ * Compute the iterated hash of each of the 'count' inputs 'in[i]' of
+ * 'inlength[i]' bytes into 'out[i]', using the same 'hashalg',
+ * 'iterations' and 'salt' for all of them.  The inputs are hashed
+ * several at a time with a multi-buffer implementation of SHA-1 when
+ * the compiler supports vector types and OpenSSL is not in FIPS mode.
+ *
+ * Returns the length of each hash, or 0 on failure.
+ */
+
+void
+isc__iterated_hash_initialize(void);
+void
+isc__iterated_hash_shutdown(void);
+/*%<
+ * Set up and release the per-thread hashing state used by
+ * isc_iterated_hash().  isc_iterated_hash() initializes the state on
+ * first use; threads started with isc_thread_create() release it when
+ * they exit.
+ */
+
 ISC_LANG_ENDDECLS
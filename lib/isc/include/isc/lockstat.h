@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/lockstat.h
+ *
+ * \brief Lock contention statistics.
+ *
+ * When built with --enable-lock-profile (USE_LOCK_PROFILE), every
+ * LOCK() and RWLOCK() call site first tries to take the lock without
+ * waiting.  If that fails, the time spent waiting for the lock is
+ * added to the counters of the call site, which is registered here the
+ * first time it waits.  Uncontended locking only costs the extra
+ * trylock, and does not touch any shared counter.
+ *
+ * Otherwise, LOCK() and RWLOCK() are unchanged and no call site is ever
+ * registered.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/lang.h>
+
+typedef struct isc_lockstat isc_lockstat_t;
+
+struct isc_lockstat {
+	const char	    *file;
+	unsigned int	     line;
+	const char	    *kind; /*%< "mutex" or "rwlock" */
+	atomic_bool	     registered;
+	atomic_uint_fast64_t contended;
+	atomic_uint_fast64_t nsecs;
+	isc_lockstat_t	    *next;
+};
+
+#define ISC_LOCKSTAT_INITIALIZER(k)                           \
+	{                                                     \
+		.file = __FILE__, .line = __LINE__, .kind = k \
+	}
+
+typedef void (*isc_lockstat_cb_t)(const isc_lockstat_t *stat, uint64_t nsecs,
+				  uint64_t contended, void *arg);
+
+ISC_LANG_BEGINDECLS
+
+uint64_t
+isc_lockstat_start(void);
+/*%<
+ * Return the current time, to be passed to isc_lockstat_record() once
+ * the lock is taken.
+ */
+
+void
+isc_lockstat_record(isc_lockstat_t *stat, uint64_t start);
+/*%<
+ * Count a wait for the lock at the call site 'stat', which started at
+ * 'start'.
+ */
+
+bool
+isc_lockstat_enabled(void);
+/*%<
+ * Return true if the library was built with lock profiling.
+ */
+
+void
+isc_lockstat_foreach(isc_lockstat_cb_t cb, void *arg);
+/*%<
+ * Call 'cb' for each call site which has waited for a lock so far, with
+ * its total wait time in nanoseconds and the number of waits.  Call
+ * sites registered while this runs may or may not be visited.
+ */
+
+ISC_LANG_ENDDECLS
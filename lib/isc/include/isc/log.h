@@ -278,6 +278,8 @@ isc_log_destroy(isc_log_t **lctxp);
  *\li	*lctx is a valid logging context.
  *
  * Ensures:
+ *\li	Messages queued in asynchronous mode have been written.
+ *
  *\li	All of the memory associated with the logging context is returned
  *	to the free memory pool.
  *
@@ -842,6 +844,26 @@ isc_logfile_roll(isc_logfile_t *file);
  *\li	file is not NULL.
  */
 
+void
+isc_log_startasync(isc_log_t *lctx);
+/*%<
+ * Switch the logging context to asynchronous mode.  Each thread then
+ * formats its messages into a queue of its own, without taking any
+ * lock, and a logger thread writes them to the channels in batches.
+ * When the queue of a thread is full, its messages are dropped, and
+ * the number of dropped messages is logged later.
+ *
+ * Critical messages, and messages too long to queue, are still written
+ * synchronously, after the messages queued before them.
+ *
+ * Notes:
+ *\li	The logger thread is not inherited by fork(), so a program that
+ *	daemonizes must call this afterwards.
+ *
+ * Requires:
+ *\li	lctx is a valid context that is not in asynchronous mode.
+ */
+
 void
 isc_log_setforcelog(bool v);
 /*%<
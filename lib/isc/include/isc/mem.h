@@ -267,6 +267,33 @@ isc_mem_maxmalloced(isc_mem_t *ctx);
  * allocated in 'mctx' at any time.
  */
 
+uint64_t
+isc_mem_totalgets(void);
+/*%<
+ * Get the number of allocations made so far by all the memory contexts
+ * that still exist.
+ */
+
+void
+isc_mem_setsamplerate(size_t rate);
+/*%<
+ * Sample about one allocation per 'rate' bytes allocated, in all memory
+ * contexts, recording the stack of each sampled allocation until it is
+ * freed.  The allocation sites with the most sampled memory in use are
+ * included in the statistics of each context.  Zero, the default,
+ * disables sampling; allocations sampled before are still accounted for
+ * until they are freed.
+ *
+ * Memory pool items are not sampled.
+ */
+
+size_t
+isc_mem_sampled(isc_mem_t *mctx);
+/*%<
+ * Get the number of bytes in use in 'mctx', estimated from the sampled
+ * allocations.
+ */
+
 bool
 isc_mem_isovermem(isc_mem_t *mctx);
 /*%<
@@ -482,6 +509,24 @@ isc_mempool_setfillcount(isc_mempool_t *restrict mpctx,
  *\li	limit > 0
  */
 
+void
+isc_mempool_setshared(isc_mempool_t *restrict mpctx, unsigned int nslots);
+/*%<
+ * Make the pool safe to use from any thread, so that a single pool can
+ * serve all the workers.
+ *
+ * The pool caches free items in magazines of a fixed number of items.
+ * Each thread uses the two magazines of slot 'isc_tid_v % nslots', and
+ * exchanges a full or empty magazine with a shared depot only when
+ * both of its own are full or empty, so most gets and puts only take
+ * the uncontended lock of their own slot.  The depot holds at most
+ * 'freemax' items; the fillcount is not used.
+ *
+ * Requires:
+ *\li	mpctx is a valid pool that has not been used yet.
+ *\li	nslots > 0
+ */
+
 #if defined(UNIT_TESTING) && defined(malloc)
 /*
  * cmocka.h redefined malloc as a macro, we #undef it
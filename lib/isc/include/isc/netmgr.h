@@ -477,6 +477,29 @@ isc_nm_setnetbuffers(isc_nm_t *mgr, int32_t recv_tcp, int32_t send_tcp,
  * \li	'mgr' is a valid netmgr.
  */
 
+unsigned int
+isc_nm_getnworkers(isc_nm_t *mgr);
+/*%<
+ * Return the number of network threads that 'mgr' runs tasks and
+ * network events on.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
+void
+isc_nm_taskstats(isc_nm_t *mgr, int tid, uint32_t *queuedp, uint64_t *stolenp);
+/*%<
+ * Get the task scheduling counters of network thread 'tid': the number
+ * of task events waiting in its queues, and the number of task events
+ * it has taken over from the queues of other threads.  Either pointer
+ * may be NULL.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ * \li	0 <= 'tid' < isc_nm_getnworkers(mgr).
+ */
+
 bool
 isc_nm_getloadbalancesockets(isc_nm_t *mgr);
 void
@@ -488,6 +511,30 @@ isc_nm_setloadbalancesockets(isc_nm_t *mgr, bool enabled);
  * \li	'mgr' is a valid netmgr.
  */
 
+bool
+isc_nm_getcpuaffinity(isc_nm_t *mgr);
+isc_result_t
+isc_nm_setcpuaffinity(isc_nm_t *mgr);
+/*%<
+ * Pin each network thread to its own CPU, chosen in order from the set
+ * of CPUs the calling thread is allowed to run on.  When load balancing
+ * of the sockets is also enabled, UDP listeners created afterwards ask
+ * the kernel to deliver each packet to the socket served by the thread
+ * pinned to the CPU that received it, so that a query is processed on
+ * the same CPU as the NIC receive queue it arrived on.
+ *
+ * isc_nm_getcpuaffinity() returns true after a successful call to
+ * isc_nm_setcpuaffinity().
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_FAILURE		the request was refused
+ *\li	#ISC_R_NOTIMPLEMENTED	thread affinity is not supported
+ */
+
 void
 isc_nm_gettimeouts(isc_nm_t *mgr, uint32_t *initial, uint32_t *idle,
 		   uint32_t *keepalive, uint32_t *advertised);
@@ -509,6 +556,58 @@ isc_nm_maxudp(isc_nm_t *mgr, uint32_t maxudp);
  * size.
  */
 
+void
+isc_nm_setudpsendbatch(isc_nm_t *mgr, uint32_t depth);
+uint32_t
+isc_nm_getudpsendbatch(isc_nm_t *mgr);
+/*%<
+ * Get and set the maximum number of outgoing UDP messages that each
+ * network thread may queue before sending them all at once using
+ * sendmmsg(2); the queue is also flushed at the end of every event loop
+ * iteration.  Values larger than the compiled-in limit are silently
+ * reduced; 0 or 1 disables the batching.  On platforms without
+ * sendmmsg(2) the setting is ignored.
+ *
+ * Responses of equal size sent to the same peer are further coalesced
+ * into a single buffer using UDP generic segmentation offload
+ * (UDP_SEGMENT) where supported.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
+void
+isc_nm_settcpsendbatch(isc_nm_t *mgr, uint32_t depth);
+uint32_t
+isc_nm_gettcpsendbatch(isc_nm_t *mgr);
+/*%<
+ * Get and set the maximum number of outgoing DNS messages that each
+ * network thread may queue on its accepted TCP DNS connections before
+ * they are written out; the messages queued for the same connection
+ * are written with a single writev(2) call.  The queue is also flushed
+ * at the end of every event loop iteration, so responses to pipelined
+ * queries that are ready at the same time leave in as few segments as
+ * possible.  Values larger than the compiled-in limit are silently
+ * reduced; 0 or 1 disables the batching.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
+void
+isc_nm_settcpevictidle(isc_nm_t *mgr, bool evict);
+bool
+isc_nm_gettcpevictidle(isc_nm_t *mgr);
+/*%<
+ * Get and set whether a TCP DNS listener that cannot accept a new
+ * connection because its quota is exhausted closes the least recently
+ * active connection of the same network thread that has no queries in
+ * progress, so that the new connection can take its place.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
 void
 isc_nm_setstats(isc_nm_t *mgr, isc_stats_t *stats);
 /*%<
@@ -678,6 +777,23 @@ isc_nm_http_set_endpoints(isc_nmsocket_t	  *listener,
  * \li	'eps' is a valid pointer to an HTTP endpoints set.
  */
 
+void
+isc_nm_sethttpgetcachettl(isc_nm_t *mgr, uint32_t ttl);
+uint32_t
+isc_nm_gethttpgetcachettl(isc_nm_t *mgr);
+/*%<
+ * Get and set the maximum time, in seconds, the responses to the DNS
+ * queries received via HTTP GET requests are cached for.  Each network
+ * thread keeps a small cache of the responses, keyed on the local
+ * address, the request path and the query string, and answers the
+ * identical requests from it without invoking the endpoint callback.
+ * A response is cached for the time set with isc_nm_set_maxage(), but
+ * no longer than 'ttl'; 0 disables the cache.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
 #endif /* HAVE_LIBNGHTTP2 */
 
 void
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/profile.h
+ *
+ * \brief Always-on accounting of the time threads spend in each of the
+ * major subsystems.
+ *
+ * The entry points of each subsystem are bracketed with
+ * isc_profile_enter() and isc_profile_leave().  Time is charged to the
+ * innermost subsystem only, so a query which looks up the cache is
+ * charged partly to "query" and partly to "db", and the totals of all
+ * subsystems add up to the time spent in any of them.
+ *
+ * The totals are kept in a small number of shared slots picked by
+ * thread id, and read with isc_profile_get().
+ */
+
+#include <inttypes.h>
+
+#include <isc/lang.h>
+
+typedef enum {
+	isc_profile_netmgr = 0,	   /*%< network I/O and event dispatch */
+	isc_profile_query = 1,	   /*%< authoritative and recursive queries */
+	isc_profile_resolver = 2,  /*%< fetches and their responses */
+	isc_profile_validator = 3, /*%< DNSSEC validation */
+	isc_profile_db = 4,	   /*%< database lookups and additions */
+	isc_profile_zone = 5,	   /*%< zone maintenance */
+	isc_profile_max = 6
+} isc_profile_t;
+
+ISC_LANG_BEGINDECLS
+
+void
+isc_profile_enter(isc_profile_t category);
+/*%<
+ * Start charging the time of this thread to 'category', until the
+ * matching isc_profile_leave() or the next isc_profile_enter().
+ */
+
+void
+isc_profile_leave(isc_profile_t category);
+/*%<
+ * Stop charging the time of this thread to 'category', and go back to
+ * the subsystem which was entered before it, if any.
+ *
+ * Requires:
+ *\li	'category' is the innermost subsystem entered by this thread.
+ */
+
+void
+isc_profile_get(uint64_t *nsecs, uint64_t *calls);
+/*%<
+ * Store the total time in nanoseconds spent in each subsystem, and the
+ * number of times each was entered, in 'nsecs' and 'calls'.
+ *
+ * Requires:
+ *\li	'nsecs' and 'calls' have room for isc_profile_max values.
+ */
+
+const char *
+isc_profile_name(isc_profile_t category);
+/*%<
+ * Return the name of 'category', e.g. "query".
+ */
+
+ISC_LANG_ENDDECLS
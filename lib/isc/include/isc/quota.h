@@ -34,6 +34,7 @@
 #include <isc/lang.h>
 #include <isc/magic.h>
 #include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/types.h>
 
 /*****
@@ -52,6 +53,12 @@ struct isc_quota_cb {
 	ISC_LINK(isc_quota_cb_t) link;
 };
 
+/*% isc_quota_slice - the spare capacity of a sliced quota held by a thread */
+typedef struct isc_quota_slice {
+	atomic_int_fast32_t avail;
+	uint8_t __padding[ISC_OS_CACHELINE_SIZE - sizeof(atomic_int_fast32_t)];
+} isc_quota_slice_t;
+
 /*% isc_quota structure */
 struct isc_quota {
 	int		     magic;
@@ -62,6 +69,9 @@ struct isc_quota {
 	isc_mutex_t	     cblock;
 	ISC_LIST(isc_quota_cb_t) cbs;
 	ISC_LINK(isc_quota_t) link;
+	isc_mem_t	  *mctx;
+	isc_quota_slice_t *slices;
+	unsigned int	   nslices;
 };
 
 void
@@ -76,6 +86,23 @@ isc_quota_destroy(isc_quota_t *quota);
  * Destroy a quota object.
  */
 
+void
+isc_quota_slice(isc_quota_t *quota, isc_mem_t *mctx, unsigned int nslices);
+/*%<
+ * Split the quota into 'nslices' slices, so that the threads reserving
+ * and releasing it do not all contend for a single counter.  Each thread
+ * reserves the quota from its own slice first and takes the spare
+ * capacity of the other slices when its own is exhausted; the released
+ * quota is returned to the slice of the releasing thread, so the spare
+ * capacity moves to the threads that need it.  The quota is still
+ * enforced as a whole, but isc_quota_getused() has to sum up all the
+ * slices and the soft quota is checked against that sum.
+ *
+ * Requires:
+ * \li	'quota' is a valid quota, not in use and not sliced yet.
+ * \li	'nslices' is greater than zero.
+ */
+
 void
 isc_quota_soft(isc_quota_t *quota, unsigned int soft);
 /*%<
@@ -74,6 +74,16 @@ struct isc_rwlock {
 
 	/* Unlocked. */
 	unsigned int write_quota;
+
+#if USE_BRAVO_RWLOCK
+	/*
+	 * While 'rbias' is set, readers announce themselves in a per-thread
+	 * slot of a global table instead of updating 'cnt_and_flag'; see
+	 * rwlock.c for details.
+	 */
+	atomic_bool	     rbias;
+	atomic_uint_fast64_t inhibit_until;
+#endif /* USE_BRAVO_RWLOCK */
 };
 
 #endif /* USE_PTHREAD_RWLOCK */
@@ -100,7 +100,29 @@ enum {
 	isc_sockstatscounter_rawrecvfail = 60,
 	isc_sockstatscounter_rawactive = 61,
 
-	isc_sockstatscounter_max = 62
+	isc_sockstatscounter_udp4sendbatch = 62,
+	isc_sockstatscounter_udp6sendbatch = 63,
+	isc_sockstatscounter_udp4sendbatchmsg = 64,
+	isc_sockstatscounter_udp6sendbatchmsg = 65,
+
+	isc_sockstatscounter_tcp4sendbatch = 66,
+	isc_sockstatscounter_tcp6sendbatch = 67,
+	isc_sockstatscounter_tcp4sendbatchmsg = 68,
+	isc_sockstatscounter_tcp6sendbatchmsg = 69,
+
+	isc_sockstatscounter_tcp4tlshandshake = 70,
+	isc_sockstatscounter_tcp6tlshandshake = 71,
+	isc_sockstatscounter_tcp4tlsresumed = 72,
+	isc_sockstatscounter_tcp6tlsresumed = 73,
+
+	isc_sockstatscounter_tcpfirstbyte1ms = 74,
+	isc_sockstatscounter_tcpfirstbyte10ms = 75,
+	isc_sockstatscounter_tcpfirstbyte100ms = 76,
+	isc_sockstatscounter_tcpfirstbyte1s = 77,
+	isc_sockstatscounter_tcpfirstbyteslow = 78,
+	isc_sockstatscounter_tcpidleevicted = 79,
+
+	isc_sockstatscounter_max = 80
 };
 
 ISC_LANG_BEGINDECLS
@@ -132,6 +154,31 @@ isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters);
  *\li	anything else	-- failure
  */
 
+isc_result_t
+isc_stats_create_sharded(isc_mem_t *mctx, isc_stats_t **statsp,
+			 int ncounters);
+/*%<
+ * Like isc_stats_create(), but each thread updates its own copy of the
+ * counters, so that threads counting the same event don't contend on
+ * one cache line.  The copies are only summed when the counters are
+ * read or dumped.  This costs more memory, so it is meant for
+ * server-wide statistics that are updated for every query.
+ *
+ * A counter updated with isc_stats_update_if_greater() should not also
+ * be updated with isc_stats_increment(), isc_stats_decrement() or
+ * isc_stats_add().
+ *
+ * Requires:
+ *\li	'mctx' must be a valid memory context.
+ *
+ *\li	'statsp' != NULL && '*statsp' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS	-- all ok
+ *
+ *\li	anything else	-- failure
+ */
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp);
 /*%<
@@ -183,6 +230,18 @@ isc_stats_decrement(isc_stats_t *stats, isc_statscounter_t counter);
  *\li	'stats' is a valid isc_stats_t.
  */
 
+void
+isc_stats_add(isc_stats_t *stats, isc_statscounter_t counter, uint64_t val);
+/*%<
+ * Add 'val' to the counter-th counter of stats.
+ *
+ * Requires:
+ *\li	'stats' is a valid isc_stats_t.
+ *
+ *\li	counter is less than the maximum available ID for the stats specified
+ *	on creation.
+ */
+
 void
 isc_stats_dump(isc_stats_t *stats, isc_stats_dumper_t dump_fn, void *arg,
 	       unsigned int options);
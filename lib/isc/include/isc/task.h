@@ -576,6 +576,29 @@ isc_task_privileged(isc_task_t *task);
  *\li	'task' is a valid task.
  */
 
+void
+isc_task_setbackground(isc_task_t *task, bool background);
+/*%<
+ * Set or unset the task's "background" flag depending on the value of
+ * 'background'.
+ *
+ * Events for background tasks are run after the pending network events
+ * and events for other tasks, so that maintenance work does not delay
+ * query processing.
+ *
+ * Requires:
+ *\li	'task' is a valid task.
+ */
+
+bool
+isc_task_getbackground(isc_task_t *task);
+/*%<
+ * Returns the current value of the task's background flag.
+ *
+ * Requires:
+ *\li	'task' is a valid task.
+ */
+
 /*****
  ***** Task Manager.
  *****/
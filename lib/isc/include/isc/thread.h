@@ -48,6 +48,17 @@ isc_thread_yield(void);
 void
 isc_thread_setname(isc_thread_t thread, const char *name);
 
+isc_result_t
+isc_thread_setaffinity(isc_thread_t thread, int cpu);
+/*%<
+ * Restrict 'thread' to run only on CPU number 'cpu'.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_FAILURE		the request was refused
+ *\li	#ISC_R_NOTIMPLEMENTED	thread affinity is not supported
+ */
+
 #define isc_thread_self (uintptr_t) pthread_self
 
 ISC_LANG_ENDDECLS
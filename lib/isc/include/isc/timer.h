@@ -38,6 +38,10 @@
  * an 'inactive' timer and then change it into a 'ticker' or
  * 'once' timer.
  *
+ * Timers are run by the network manager workers; each worker runs the
+ * timers that were created on it.  They have a resolution of one
+ * millisecond.
+ *
  *\li MP:
  *	The module ensures appropriate synchronization of data structures it
  *	creates and manipulates.
@@ -160,6 +160,19 @@ isc_tlsctx_session_tickets(isc_tlsctx_t *ctx, const bool use);
  * \li	'ctx' != NULL.
  */
 
+#define ISC_TLS_TICKET_KEY_LIFETIME 3600
+
+void
+isc_tls_ticket_keys_rotate(void);
+/*%<
+ * Replace the key used to protect new session tickets issued by the server
+ * TLS contexts.  The keys are shared by all server contexts in the
+ * process, including the ones created later, and the current key is also
+ * rotated automatically once it is older than ISC_TLS_TICKET_KEY_LIFETIME
+ * seconds.  Tickets protected with the previous key are still accepted
+ * (and renewed); older tickets cause a full handshake.
+ */
+
 isc_tls_t *
 isc_tls_create(isc_tlsctx_t *ctx);
 /*%<
@@ -585,3 +598,20 @@ isc_tlsctx_set_random_session_id_context(isc_tlsctx_t *ctx);
  * Requires:
  *\li   'ctx' - a valid non-NULL pointer;
  */
+
+void
+isc_tlsctx_set_session_id_context(isc_tlsctx_t *ctx, const char *name,
+				  const char *ca_file);
+/*%<
+ * Set context within which session can be reused to a value derived
+ * from the name of the TLS configuration and the CA bundle file used to
+ * verify client certificates (if any). Unlike
+ * isc_tlsctx_set_random_session_id_context(), the value stays the same
+ * when the context is recreated with the same configuration, so the
+ * sessions established before reconfiguration can still be resumed.
+ *
+ * Requires:
+ *\li   'ctx' - a valid non-NULL pointer;
+ *\li   'name' - a valid non-NULL pointer;
+ *\li   'ca_file' - a valid pointer or 'NULL'.
+ */
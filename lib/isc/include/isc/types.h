@@ -42,6 +42,7 @@ typedef struct isc_consttextregion isc_consttextregion_t; /*%< Const Text Region
 typedef struct isc_counter isc_counter_t;		  /*%< Counter */
 typedef struct isc_event   isc_event_t;			  /*%< Event */
 typedef ISC_LIST(isc_event_t) isc_eventlist_t;		  /*%< Event List */
+typedef struct isc_eventpool isc_eventpool_t;		  /*%< Event Pool */
 typedef unsigned int	 isc_eventtype_t;		  /*%< Event Type */
 typedef struct isc_hash	 isc_hash_t;			  /*%< Hash */
 typedef struct isc_httpd isc_httpd_t;			  /*%< HTTP client */
@@ -135,6 +135,24 @@
 
 #include <isc/result.h> /* Contractual promise. */
 
+#if USE_LOCK_PROFILE
+#include <isc/lockstat.h>
+
+#define LOCK(lp)                                                            \
+	do {                                                                \
+		static isc_lockstat_t _stat =                               \
+			ISC_LOCKSTAT_INITIALIZER("mutex");                  \
+		ISC_UTIL_TRACE(fprintf(stderr, "LOCKING %p %s %d\n", (lp),  \
+				       __FILE__, __LINE__));                \
+		if (isc_mutex_trylock((lp)) != ISC_R_SUCCESS) {             \
+			uint64_t _start = isc_lockstat_start();             \
+			RUNTIME_CHECK(isc_mutex_lock((lp)) == ISC_R_SUCCESS); \
+			isc_lockstat_record(&_stat, _start);                \
+		}                                                           \
+		ISC_UTIL_TRACE(fprintf(stderr, "LOCKED %p %s %d\n", (lp),   \
+				       __FILE__, __LINE__));                \
+	} while (0)
+#else /* USE_LOCK_PROFILE */
 #define LOCK(lp)                                                           \
 	do {                                                               \
 		ISC_UTIL_TRACE(fprintf(stderr, "LOCKING %p %s %d\n", (lp), \
@@ -143,6 +161,7 @@
 		ISC_UTIL_TRACE(fprintf(stderr, "LOCKED %p %s %d\n", (lp),  \
 				       __FILE__, __LINE__));               \
 	} while (0)
+#endif /* USE_LOCK_PROFILE */
 #define UNLOCK(lp)                                                          \
 	do {                                                                \
 		RUNTIME_CHECK(isc_mutex_unlock((lp)) == ISC_R_SUCCESS);     \
@@ -182,6 +201,23 @@
 
 #define WAITUNTIL(cvp, lp, tp) isc_condition_waituntil((cvp), (lp), (tp))
 
+#if USE_LOCK_PROFILE
+#define RWLOCK(lp, t)                                                         \
+	do {                                                                  \
+		static isc_lockstat_t _stat =                                 \
+			ISC_LOCKSTAT_INITIALIZER("rwlock");                   \
+		ISC_UTIL_TRACE(fprintf(stderr, "RWLOCK %p, %d %s %d\n", (lp), \
+				       (t), __FILE__, __LINE__));             \
+		if (isc_rwlock_trylock((lp), (t)) != ISC_R_SUCCESS) {         \
+			uint64_t _start = isc_lockstat_start();               \
+			RUNTIME_CHECK(isc_rwlock_lock((lp), (t)) ==           \
+				      ISC_R_SUCCESS);                         \
+			isc_lockstat_record(&_stat, _start);                  \
+		}                                                             \
+		ISC_UTIL_TRACE(fprintf(stderr, "RWLOCKED %p, %d %s %d\n",     \
+				       (lp), (t), __FILE__, __LINE__));       \
+	} while (0)
+#else /* USE_LOCK_PROFILE */
 #define RWLOCK(lp, t)                                                         \
 	do {                                                                  \
 		ISC_UTIL_TRACE(fprintf(stderr, "RWLOCK %p, %d %s %d\n", (lp), \
@@ -190,6 +226,7 @@
 		ISC_UTIL_TRACE(fprintf(stderr, "RWLOCKED %p, %d %s %d\n",     \
 				       (lp), (t), __FILE__, __LINE__));       \
 	} while (0)
+#endif /* USE_LOCK_PROFILE */
 #define RWUNLOCK(lp, t)                                                       \
 	do {                                                                  \
 		ISC_UTIL_TRACE(fprintf(stderr, "RWUNLOCK %p, %d %s %d\n",     \
@@ -11,8 +11,11 @@
  * information regarding copyright ownership.
  */
 
+#include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
+#include <openssl/crypto.h>
 #include <openssl/opensslv.h>
 
 #include <isc/iterated_hash.h>
@@ -65,11 +68,32 @@ isc_iterated_hash(unsigned char *out, const unsigned int hashalg,
 	return (SHA_DIGEST_LENGTH);
 }
 
+void
+isc__iterated_hash_initialize(void) {
+	/* empty */
+}
+
+void
+isc__iterated_hash_shutdown(void) {
+	/* empty */
+}
+
 #else
 
+#include <openssl/err.h>
 #include <openssl/evp.h>
 
-#include <isc/md.h>
+#include <isc/thread.h>
+
+/*
+ * Fetching the SHA-1 implementation from the OpenSSL 3 provider is
+ * expensive compared to hashing a single owner name, so every thread
+ * fetches it once and keeps an initialized context to copy from.
+ */
+static thread_local bool initialized = false;
+static thread_local EVP_MD_CTX *mdctx = NULL;
+static thread_local EVP_MD_CTX *basectx = NULL;
+static thread_local EVP_MD *md = NULL;
 
 int
 isc_iterated_hash(unsigned char *out, const unsigned int hashalg,
@@ -82,36 +106,32 @@ isc_iterated_hash(unsigned char *out, const unsigned int hashalg,
 	size_t len;
 	unsigned int outlength = 0;
 	const unsigned char *buf;
-	EVP_MD_CTX *ctx;
-	;
-	EVP_MD *md;
 
 	if (hashalg != 1) {
 		return (0);
 	}
 
-	ctx = EVP_MD_CTX_new();
-	RUNTIME_CHECK(ctx != NULL);
-	md = EVP_MD_fetch(NULL, "SHA1", NULL);
-	RUNTIME_CHECK(md != NULL);
+	if (!initialized) {
+		isc__iterated_hash_initialize();
+	}
 
 	buf = in;
 	len = inlength;
 
 	do {
-		if (EVP_DigestInit_ex(ctx, md, NULL) != 1) {
+		if (EVP_MD_CTX_copy_ex(mdctx, basectx) != 1) {
 			goto fail;
 		}
 
-		if (EVP_DigestUpdate(ctx, buf, len) != 1) {
+		if (EVP_DigestUpdate(mdctx, buf, len) != 1) {
 			goto fail;
 		}
 
-		if (EVP_DigestUpdate(ctx, salt, saltlength) != 1) {
+		if (EVP_DigestUpdate(mdctx, salt, saltlength) != 1) {
 			goto fail;
 		}
 
-		if (EVP_DigestFinal_ex(ctx, out, &outlength) != 1) {
+		if (EVP_DigestFinal_ex(mdctx, out, &outlength) != 1) {
 			goto fail;
 		}
 
@@ -119,16 +139,267 @@ isc_iterated_hash(unsigned char *out, const unsigned int hashalg,
 		len = outlength;
 	} while (n++ < iterations);
 
-	EVP_MD_CTX_free(ctx);
-	EVP_MD_free(md);
-
 	return (outlength);
 
 fail:
-	EVP_MD_CTX_free(ctx);
+	ERR_clear_error();
+	return (0);
+}
+
+void
+isc__iterated_hash_initialize(void) {
+	if (initialized) {
+		return;
+	}
+
+	basectx = EVP_MD_CTX_new();
+	RUNTIME_CHECK(basectx != NULL);
+	mdctx = EVP_MD_CTX_new();
+	RUNTIME_CHECK(mdctx != NULL);
+	md = EVP_MD_fetch(NULL, "SHA1", NULL);
+	RUNTIME_CHECK(md != NULL);
+	RUNTIME_CHECK(EVP_DigestInit_ex(basectx, md, NULL) == 1);
+
+	initialized = true;
+}
+
+void
+isc__iterated_hash_shutdown(void) {
+	if (!initialized) {
+		return;
+	}
+
 	EVP_MD_free(md);
+	md = NULL;
+	EVP_MD_CTX_free(mdctx);
+	mdctx = NULL;
+	EVP_MD_CTX_free(basectx);
+	basectx = NULL;
 
-	return (0);
+	initialized = false;
 }
 
 #endif
+
+/*
+ * Multi-buffer SHA-1: hash SHA1X4_LANES independent messages at once by
+ * keeping one 32-bit word of every lane in a vector.  The compiler turns
+ * the vector operations into SSE2, NEON or plain scalar code, whatever
+ * the target provides.  Every NSEC3 iteration after the first hashes
+ * a message of the same length in every lane, so the lanes stay busy.
+ */
+#define SHA1_LENGTH 20
+
+#if defined(__GNUC__) || defined(__clang__)
+
+#define SHA1X4_LANES  4
+#define SHA1_BLOCK    64
+#define SHA1X4_BUFFER (9 * SHA1_BLOCK)
+
+typedef uint32_t sha1x4_t __attribute__((vector_size(SHA1X4_LANES * 4)));
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+typedef struct {
+	unsigned char buf[SHA1X4_BUFFER];
+	unsigned int nblocks;
+} sha1x4_msg_t;
+
+static void
+sha1x4_pad(sha1x4_msg_t *msg, size_t len) {
+	uint64_t bits = (uint64_t)len * 8;
+	size_t total = (len + 9 + SHA1_BLOCK - 1) & ~(size_t)(SHA1_BLOCK - 1);
+	size_t i;
+
+	INSIST(total <= sizeof(msg->buf));
+
+	msg->buf[len] = 0x80;
+	memset(msg->buf + len + 1, 0, total - len - 9);
+	for (i = 0; i < 8; i++) {
+		msg->buf[total - 1 - i] = (unsigned char)(bits >> (8 * i));
+	}
+	msg->nblocks = total / SHA1_BLOCK;
+}
+
+static void
+sha1x4_compress(sha1x4_t state[5], sha1x4_msg_t msgs[SHA1X4_LANES],
+		unsigned int block) {
+	sha1x4_t w[16], a, b, c, d, e, f, k, t, mask;
+	unsigned int i, l;
+
+	for (l = 0; l < SHA1X4_LANES; l++) {
+		unsigned int blk = ISC_MIN(block, msgs[l].nblocks - 1);
+		const unsigned char *p = msgs[l].buf + blk * SHA1_BLOCK;
+
+		mask[l] = (block < msgs[l].nblocks) ? UINT32_MAX : 0;
+		for (i = 0; i < 16; i++, p += 4) {
+			w[i][l] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+				  (uint32_t)p[2] << 8 | (uint32_t)p[3];
+		}
+	}
+
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+
+	for (i = 0; i < 80; i++) {
+		if (i >= 16) {
+			t = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^
+			    w[(i + 2) & 15] ^ w[i & 15];
+			w[i & 15] = ROL(t, 1);
+		}
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = (sha1x4_t){ 0 } + 0x5a827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = (sha1x4_t){ 0 } + 0x6ed9eba1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = (sha1x4_t){ 0 } + 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d;
+			k = (sha1x4_t){ 0 } + 0xca62c1d6;
+		}
+		t = ROL(a, 5) + f + e + k + w[i & 15];
+		e = d;
+		d = c;
+		c = ROL(b, 30);
+		b = a;
+		a = t;
+	}
+
+	state[0] += a & mask;
+	state[1] += b & mask;
+	state[2] += c & mask;
+	state[3] += d & mask;
+	state[4] += e & mask;
+}
+
+static void
+sha1x4(sha1x4_msg_t msgs[SHA1X4_LANES],
+       unsigned char out[SHA1X4_LANES][SHA1_LENGTH]) {
+	sha1x4_t state[5];
+	unsigned int i, l, nblocks = 0;
+
+	state[0] = (sha1x4_t){ 0 } + 0x67452301;
+	state[1] = (sha1x4_t){ 0 } + 0xefcdab89;
+	state[2] = (sha1x4_t){ 0 } + 0x98badcfe;
+	state[3] = (sha1x4_t){ 0 } + 0x10325476;
+	state[4] = (sha1x4_t){ 0 } + 0xc3d2e1f0;
+
+	for (l = 0; l < SHA1X4_LANES; l++) {
+		nblocks = ISC_MAX(nblocks, msgs[l].nblocks);
+	}
+	for (i = 0; i < nblocks; i++) {
+		sha1x4_compress(state, msgs, i);
+	}
+
+	for (l = 0; l < SHA1X4_LANES; l++) {
+		for (i = 0; i < 5; i++) {
+			out[l][i * 4] = (unsigned char)(state[i][l] >> 24);
+			out[l][i * 4 + 1] = (unsigned char)(state[i][l] >> 16);
+			out[l][i * 4 + 2] = (unsigned char)(state[i][l] >> 8);
+			out[l][i * 4 + 3] = (unsigned char)state[i][l];
+		}
+	}
+}
+
+static void
+iterated_hashx4(unsigned char *out[], const int iterations,
+		const unsigned char *salt, const int saltlength,
+		const unsigned char *in[], const int inlength[],
+		unsigned int count) {
+	sha1x4_msg_t msgs[SHA1X4_LANES];
+	unsigned char digest[SHA1X4_LANES][SHA1_LENGTH];
+	unsigned int l;
+	int n = 0;
+
+	/*
+	 * Unused lanes repeat the first message.
+	 */
+	for (l = 0; l < SHA1X4_LANES; l++) {
+		unsigned int src = (l < count) ? l : 0;
+
+		memmove(msgs[l].buf, in[src], inlength[src]);
+		memmove(msgs[l].buf + inlength[src], salt, saltlength);
+		sha1x4_pad(&msgs[l], inlength[src] + saltlength);
+	}
+	sha1x4(msgs, digest);
+
+	if (iterations > 0) {
+		for (l = 0; l < SHA1X4_LANES; l++) {
+			memmove(msgs[l].buf + SHA1_LENGTH, salt, saltlength);
+			sha1x4_pad(&msgs[l], SHA1_LENGTH + saltlength);
+		}
+	}
+	while (n++ < iterations) {
+		for (l = 0; l < SHA1X4_LANES; l++) {
+			memmove(msgs[l].buf, digest[l], SHA1_LENGTH);
+		}
+		sha1x4(msgs, digest);
+	}
+
+	for (l = 0; l < count; l++) {
+		memmove(out[l], digest[l], SHA1_LENGTH);
+	}
+}
+
+#endif /* defined(__GNUC__) || defined(__clang__) */
+
+unsigned int
+isc_iterated_hash_batch(unsigned char *out[], const unsigned int hashalg,
+			const int iterations, const unsigned char *salt,
+			const int saltlength, const unsigned char *in[],
+			const int inlength[], const unsigned int count) {
+	unsigned int i;
+	bool multi = true;
+
+	REQUIRE(out != NULL);
+	REQUIRE(in != NULL && inlength != NULL);
+
+	if (hashalg != 1) {
+		return (0);
+	}
+
+#ifdef HAVE_FIPS_MODE
+	/*
+	 * Leave hashing to the FIPS provider.
+	 */
+	if (FIPS_mode() != 0) {
+		multi = false;
+	}
+#endif /* HAVE_FIPS_MODE */
+
+#if defined(__GNUC__) || defined(__clang__)
+	for (i = 0; multi && i < count; i++) {
+		if (inlength[i] < 0 || saltlength < 0 ||
+		    (size_t)inlength[i] + saltlength + 9 > SHA1X4_BUFFER ||
+		    (size_t)SHA1_LENGTH + saltlength + 9 > SHA1X4_BUFFER)
+		{
+			multi = false;
+		}
+	}
+	if (multi) {
+		for (i = 0; i < count; i += SHA1X4_LANES) {
+			iterated_hashx4(out + i, iterations, salt, saltlength,
+					in + i, inlength + i,
+					ISC_MIN(count - i, SHA1X4_LANES));
+		}
+		return (SHA1_LENGTH);
+	}
+#else
+	UNUSED(multi);
+#endif /* defined(__GNUC__) || defined(__clang__) */
+
+	for (i = 0; i < count; i++) {
+		int len = isc_iterated_hash(out[i], hashalg, iterations, salt,
+					    saltlength, in[i], inlength[i]);
+		if (len == 0) {
+			return (0);
+		}
+	}
+	return (count > 0 ? SHA1_LENGTH : 0);
+}
@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 
 #include <isc/buffer.h>
 #include <isc/file.h>
@@ -34,10 +35,12 @@
 typedef struct inputsource {
 	isc_result_t result;
 	bool is_file;
+	bool is_regular;
 	bool need_close;
 	bool at_eof;
 	bool last_was_eol;
 	isc_buffer_t *pushback;
+	unsigned int tokenstart;
 	unsigned int ignored;
 	void *input;
 	char *name;
@@ -190,6 +193,7 @@ new_source(isc_lex_t *lex, bool is_file, bool need_close, void *input,
 	source = isc_mem_get(lex->mctx, sizeof(*source));
 	source->result = ISC_R_SUCCESS;
 	source->is_file = is_file;
+	source->is_regular = !is_file;
 	source->need_close = need_close;
 	source->at_eof = false;
 	source->last_was_eol = lex->last_was_eol;
@@ -198,10 +202,25 @@ new_source(isc_lex_t *lex, bool is_file, bool need_close, void *input,
 	source->pushback = NULL;
 	isc_buffer_allocate(lex->mctx, &source->pushback,
 			    (unsigned int)lex->max_token);
+	source->tokenstart = 0;
 	source->ignored = 0;
 	source->line = 1;
 	ISC_LIST_INITANDPREPEND(lex->sources, source, link);
 
+	/*
+	 * Input from a regular file can be read ahead in bulk; anything
+	 * else may be interactive, and is read a character at a time.
+	 */
+	if (is_file) {
+		struct stat sb;
+
+		if (fstat(fileno((FILE *)input), &sb) == 0 &&
+		    S_ISREG(sb.st_mode))
+		{
+			source->is_regular = true;
+		}
+	}
+
 	return (ISC_R_SUCCESS);
 }
 
@@ -318,27 +337,126 @@ pushback(inputsource *source, int c) {
 	}
 }
 
-static isc_result_t
-pushandgrow(isc_lex_t *lex, inputsource *source, int c) {
-	if (isc_buffer_availablelength(source->pushback) == 0) {
+/*
+ * Make room for more input in the pushback buffer, discarding what
+ * precedes the current token, or growing the buffer if the token
+ * fills it.
+ */
+static void
+makeroom(isc_lex_t *lex, inputsource *source) {
+	isc_buffer_t *pb = source->pushback;
+
+	if (isc_buffer_availablelength(pb) > 0) {
+		return;
+	}
+
+	if (source->tokenstart > 0) {
+		unsigned int n = source->tokenstart;
+
+		memmove(pb->base, (unsigned char *)pb->base + n, pb->used - n);
+		pb->used -= n;
+		pb->current -= n;
+		source->ignored = (source->ignored > n) ? source->ignored - n
+							: 0;
+		source->tokenstart = 0;
+	} else {
 		isc_buffer_t *tbuf = NULL;
 		unsigned int oldlen;
 		isc_region_t used;
 		isc_result_t result;
 
-		oldlen = isc_buffer_length(source->pushback);
+		oldlen = isc_buffer_length(pb);
 		isc_buffer_allocate(lex->mctx, &tbuf, oldlen * 2);
-		isc_buffer_usedregion(source->pushback, &used);
+		isc_buffer_usedregion(pb, &used);
 		result = isc_buffer_copyregion(tbuf, &used);
 		INSIST(result == ISC_R_SUCCESS);
-		tbuf->current = source->pushback->current;
+		tbuf->current = pb->current;
 		isc_buffer_free(&source->pushback);
 		source->pushback = tbuf;
 	}
-	isc_buffer_putuint8(source->pushback, (uint8_t)c);
+}
+
+/*
+ * Append more input to the pushback buffer, or set 'at_eof' if there
+ * is none.  Regular files and buffers are read in bulk, so that the
+ * token loop below mostly works on characters already in memory.
+ */
+static isc_result_t
+readmore(isc_lex_t *lex, inputsource *source) {
+	unsigned char *dst;
+	size_t avail, n = 0;
+
+	makeroom(lex, source);
+	dst = isc_buffer_used(source->pushback);
+	avail = isc_buffer_availablelength(source->pushback);
+
+	if (source->is_file) {
+		FILE *stream = source->input;
+
+		if (source->is_regular) {
+			n = fread(dst, 1, avail, stream);
+		} else {
+#if defined(HAVE_FLOCKFILE) && defined(HAVE_GETC_UNLOCKED)
+			int c = getc_unlocked(stream);
+#else  /* if defined(HAVE_FLOCKFILE) && defined(HAVE_GETC_UNLOCKED) */
+			int c = getc(stream);
+#endif /* if defined(HAVE_FLOCKFILE) && defined(HAVE_GETC_UNLOCKED) */
+			if (c != EOF) {
+				*dst = (unsigned char)c;
+				n = 1;
+			}
+		}
+		if (n == 0 && ferror(stream)) {
+			return (isc__errno2result(errno));
+		}
+	} else {
+		isc_buffer_t *buffer = source->input;
+
+		n = ISC_MIN(isc_buffer_remaininglength(buffer), avail);
+		memmove(dst, isc_buffer_current(buffer), n);
+		isc_buffer_forward(buffer, (unsigned int)n);
+	}
+
+	if (n == 0) {
+		source->at_eof = true;
+	} else {
+		isc_buffer_add(source->pushback, (unsigned int)n);
+	}
+
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Return true if 'c' would simply be appended to a string token being
+ * read with 'options', without ending it or changing state.
+ */
+static bool
+plainchar(isc_lex_t *lex, unsigned int options, unsigned char c) {
+	switch (c) {
+	case ' ':
+	case '\t':
+	case '\r':
+	case '\n':
+	case '\\':
+		return (false);
+	case '=':
+		if ((options & ISC_LEXOPT_VPAIR) != 0) {
+			return (false);
+		}
+		break;
+	case ';':
+	case '/':
+	case '#':
+		if (lex->comment_ok && lex->comments != 0) {
+			return (false);
+		}
+		break;
+	default:
+		break;
+	}
+	return (!lex->specials[c]);
+}
+
 isc_result_t
 isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 	inputsource *source;
@@ -348,8 +466,6 @@ isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 	bool escaped = false;
 	lexstate state = lexstate_start;
 	lexstate saved_state = lexstate_start;
-	isc_buffer_t *buffer;
-	FILE *stream;
 	char *curr, *prev;
 	size_t remaining;
 	uint32_t as_ulong;
@@ -399,7 +515,16 @@ isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 		return (ISC_R_EOF);
 	}
 
-	isc_buffer_compact(source->pushback);
+	/*
+	 * What was consumed before this token is no longer needed.  It is
+	 * only discarded when that is free, or when room is needed for
+	 * more input; until then the token starts at 'tokenstart'.
+	 */
+	if (isc_buffer_remaininglength(source->pushback) == 0) {
+		isc_buffer_clear(source->pushback);
+	}
+	source->tokenstart = source->pushback->current;
+	source->ignored = source->tokenstart;
 
 	saved_options = options;
 	if ((options & ISC_LEXOPT_DNSMULTILINE) != 0 && lex->paren_count > 0) {
@@ -420,42 +545,10 @@ isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 
 	do {
 		if (isc_buffer_remaininglength(source->pushback) == 0) {
-			if (source->is_file) {
-				stream = source->input;
-
-#if defined(HAVE_FLOCKFILE) && defined(HAVE_GETC_UNLOCKED)
-				c = getc_unlocked(stream);
-#else  /* if defined(HAVE_FLOCKFILE) && defined(HAVE_GETC_UNLOCKED) */
-				c = getc(stream);
-#endif /* if defined(HAVE_FLOCKFILE) && defined(HAVE_GETC_UNLOCKED) */
-				if (c == EOF) {
-					if (ferror(stream)) {
-						source->result =
-							isc__errno2result(
-								errno);
-						result = source->result;
-						goto done;
-					}
-					source->at_eof = true;
-				}
-			} else {
-				buffer = source->input;
-
-				if (buffer->current == buffer->used) {
-					c = EOF;
-					source->at_eof = true;
-				} else {
-					c = *((unsigned char *)buffer->base +
-					      buffer->current);
-					buffer->current++;
-				}
-			}
-			if (c != EOF) {
-				source->result = pushandgrow(lex, source, c);
-				if (source->result != ISC_R_SUCCESS) {
-					result = source->result;
-					goto done;
-				}
+			source->result = readmore(lex, source);
+			if (source->result != ISC_R_SUCCESS) {
+				result = source->result;
+				goto done;
 			}
 		}
 
@@ -757,6 +850,29 @@ isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 			*curr++ = c;
 			*curr = '\0';
 			remaining--;
+			if (state == lexstate_string && !escaped) {
+				/*
+				 * Take the rest of a run of ordinary
+				 * characters that is already buffered in
+				 * one go.
+				 */
+				isc_buffer_t *pb = source->pushback;
+				unsigned char *p = isc_buffer_current(pb);
+				size_t n = 0;
+				size_t max = ISC_MIN(
+					isc_buffer_remaininglength(pb),
+					remaining);
+
+				while (n < max && plainchar(lex, options, p[n]))
+				{
+					n++;
+				}
+				memmove(curr, p, n);
+				curr += n;
+				*curr = '\0';
+				remaining -= n;
+				isc_buffer_forward(pb, (unsigned int)n);
+			}
 			break;
 		case lexstate_maybecomment:
 			if (c == '*' && (lex->comments & ISC_LEXCOMMENT_C) != 0)
@@ -1029,12 +1145,12 @@ isc_lex_ungettoken(isc_lex_t *lex, isc_token_t *tokenp) {
 	source = HEAD(lex->sources);
 	REQUIRE(source != NULL);
 	REQUIRE(tokenp != NULL);
-	REQUIRE(isc_buffer_consumedlength(source->pushback) != 0 ||
+	REQUIRE(source->pushback->current != source->tokenstart ||
 		tokenp->type == isc_tokentype_eof);
 
 	UNUSED(tokenp);
 
-	isc_buffer_first(source->pushback);
+	source->pushback->current = source->tokenstart;
 	lex->paren_count = lex->saved_paren_count;
 	source->line = source->saved_line;
 	source->at_eof = false;
@@ -1048,7 +1164,7 @@ isc_lex_getlasttokentext(isc_lex_t *lex, isc_token_t *tokenp, isc_region_t *r) {
 	source = HEAD(lex->sources);
 	REQUIRE(source != NULL);
 	REQUIRE(tokenp != NULL);
-	REQUIRE(isc_buffer_consumedlength(source->pushback) != 0 ||
+	REQUIRE(source->pushback->current != source->tokenstart ||
 		tokenp->type == isc_tokentype_eof);
 
 	UNUSED(tokenp);
@@ -13,6 +13,7 @@
 
 /*! \file */
 
+#include <isc/iterated_hash.h>
 #include <isc/mem.h>
 #include <isc/os.h>
 #include <isc/tls.h>
@@ -48,6 +49,7 @@ isc__initialize(void) {
 
 void
 isc__shutdown(void) {
+	isc__iterated_hash_shutdown();
 	isc__trampoline_shutdown();
 	isc__tls_shutdown();
 	isc__mem_shutdown();
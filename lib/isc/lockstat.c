@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include <isc/atomic.h>
+#include <isc/lockstat.h>
+#include <isc/util.h>
+
+/*
+ * Call sites are pushed on this list, and never removed.
+ */
+static atomic_uintptr_t sites = 0;
+
+uint64_t
+isc_lockstat_start(void) {
+	struct timespec ts;
+
+	RUNTIME_CHECK(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+void
+isc_lockstat_record(isc_lockstat_t *stat, uint64_t start) {
+	uint64_t now = isc_lockstat_start();
+
+	REQUIRE(stat != NULL);
+
+	atomic_fetch_add_relaxed(&stat->nsecs, now - start);
+	atomic_fetch_add_relaxed(&stat->contended, 1);
+
+	if (!atomic_load_relaxed(&stat->registered) &&
+	    atomic_compare_exchange_strong(&stat->registered, &(bool){ false },
+					   true))
+	{
+		uintptr_t head = atomic_load_acquire(&sites);
+
+		do {
+			stat->next = (isc_lockstat_t *)head;
+		} while (!atomic_compare_exchange_weak_acq_rel(
+			&sites, &head, (uintptr_t)stat));
+	}
+}
+
+bool
+isc_lockstat_enabled(void) {
+#if USE_LOCK_PROFILE
+	return (true);
+#else  /* USE_LOCK_PROFILE */
+	return (false);
+#endif /* USE_LOCK_PROFILE */
+}
+
+void
+isc_lockstat_foreach(isc_lockstat_cb_t cb, void *arg) {
+	isc_lockstat_t *stat = NULL;
+
+	REQUIRE(cb != NULL);
+
+	stat = (isc_lockstat_t *)atomic_load_acquire(&sites);
+	while (stat != NULL) {
+		cb(stat, atomic_load_relaxed(&stat->nsecs),
+		   atomic_load_relaxed(&stat->contended), arg);
+		stat = stat->next;
+	}
+}
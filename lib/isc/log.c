@@ -22,13 +22,16 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <isc/align.h>
 #include <isc/atomic.h>
+#include <isc/condition.h>
 #include <isc/dir.h>
 #include <isc/errno.h>
 #include <isc/file.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
 #include <isc/stat.h>
@@ -56,6 +59,14 @@ static thread_local bool forcelog = false;
  */
 #define LOG_BUFFER_SIZE (8 * 1024)
 
+/*%
+ * In asynchronous mode, every thread queues its messages in a ring of
+ * LOG_RING_SIZE records.  Messages that don't fit in a record are
+ * written synchronously.
+ */
+#define LOG_RING_SIZE	256
+#define LOG_RECORD_SIZE 512
+
 /*!
  * This is the structure that holds each named channel.  A simple linked
  * list chains all of the channels together, so an individual channel is
@@ -104,6 +115,35 @@ struct isc_logmessage {
 	ISC_LINK(isc_logmessage_t) link;
 };
 
+/*!
+ * A message queued by isc_log_doit() in asynchronous mode, formatted
+ * but not yet written to any channel.
+ */
+typedef struct isc_logrecord {
+	isc_logcategory_t *category;
+	isc_logmodule_t *module;
+	int level;
+	bool write_once;
+	bool forced;
+	isc_time_t time;
+	char text[LOG_RECORD_SIZE];
+} isc_logrecord_t;
+
+/*!
+ * The ring of records queued by one thread.  Only that thread adds
+ * records at 'tail'; they are removed at 'head' with the log context
+ * lock held, either by the logger thread or by a thread writing a
+ * message synchronously.
+ */
+typedef struct isc_logring isc_logring_t;
+
+struct isc_logring {
+	alignas(ISC_OS_CACHELINE_SIZE) atomic_uint_fast32_t head;
+	alignas(ISC_OS_CACHELINE_SIZE) atomic_uint_fast32_t tail;
+	isc_logring_t *next;
+	isc_logrecord_t records[LOG_RING_SIZE];
+};
+
 /*!
  * The isc_logconfig structure is used to store the configurable information
  * about where messages are actually supposed to be sent -- the information
@@ -158,6 +198,19 @@ struct isc_log {
 	ISC_LIST(isc_logmessage_t) messages;
 	atomic_bool dynamic;
 	atomic_int_fast32_t highest_level;
+	/* Asynchronous mode */
+	atomic_bool async;
+	uint_fast64_t generation;
+	isc_thread_t thread;
+	atomic_uintptr_t rings;
+	atomic_bool sleeping;
+	atomic_uint_fast64_t dropped;
+	/* Locked by isc_log lock. */
+	uint_fast64_t reported;
+	isc_mutex_t async_lock;
+	/* Locked by isc_log async_lock. */
+	isc_condition_t async_cond;
+	bool shuttingdown;
 };
 
 /*!
@@ -208,6 +261,14 @@ static isc_logchannellist_t default_channel;
  */
 isc_log_t *isc_lctx = NULL;
 
+/*!
+ * The ring of the current thread, valid for the asynchronous log
+ * context with the same generation.
+ */
+static atomic_uint_fast64_t log_generation = 0;
+static thread_local isc_logring_t *log_ring_v = NULL;
+static thread_local uint_fast64_t log_ring_gen = 0;
+
 /*!
  * Forward declarations.
  */
@@ -229,6 +290,9 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 	     isc_logmodule_t *module, int level, bool write_once,
 	     const char *format, va_list args) ISC_FORMAT_PRINTF(6, 0);
 
+static void
+log_drain(isc_log_t *lctx, isc_logconfig_t *lcfg);
+
 /*@{*/
 /*!
  * Convenience macros.
@@ -273,6 +337,16 @@ isc_log_create(isc_mem_t *mctx, isc_log_t **lctxp, isc_logconfig_t **lcfgp) {
 	isc_mutex_init(&lctx->lock);
 	isc_rwlock_init(&lctx->lcfg_rwl, 0, 0);
 
+	atomic_init(&lctx->async, false);
+	lctx->generation = 0;
+	atomic_init(&lctx->rings, (uintptr_t)NULL);
+	atomic_init(&lctx->sleeping, false);
+	atomic_init(&lctx->dropped, 0);
+	lctx->reported = 0;
+	isc_mutex_init(&lctx->async_lock);
+	isc_condition_init(&lctx->async_cond);
+	lctx->shuttingdown = false;
+
 	/*
 	 * Normally setting the magic number is the last step done
 	 * in a creation function, but a valid log context is needed
@@ -394,6 +468,27 @@ isc_log_destroy(isc_log_t **lctxp) {
 	*lctxp = NULL;
 	mctx = lctx->mctx;
 
+	/* Write out the queued messages */
+	if (atomic_load_acquire(&lctx->async)) {
+		isc_logring_t *ring = NULL;
+
+		LOCK(&lctx->async_lock);
+		lctx->shuttingdown = true;
+		SIGNAL(&lctx->async_cond);
+		UNLOCK(&lctx->async_lock);
+		isc_thread_join(lctx->thread, NULL);
+
+		atomic_store_release(&lctx->async, false);
+		ring = (isc_logring_t *)atomic_load_acquire(&lctx->rings);
+		while (ring != NULL) {
+			isc_logring_t *next = ring->next;
+			isc_mem_put_aligned(mctx, ring, sizeof(*ring),
+					    ISC_OS_CACHELINE_SIZE);
+			ring = next;
+		}
+		atomic_store_release(&lctx->rings, (uintptr_t)NULL);
+	}
+
 	/* Stop the logging as a first thing */
 	atomic_store_release(&lctx->debug_level, 0);
 	atomic_store_release(&lctx->highest_level, 0);
@@ -410,6 +505,8 @@ isc_log_destroy(isc_log_t **lctxp) {
 
 	isc_rwlock_destroy(&lctx->lcfg_rwl);
 	isc_mutex_destroy(&lctx->lock);
+	isc_condition_destroy(&lctx->async_cond);
+	isc_mutex_destroy(&lctx->async_lock);
 
 	while ((message = ISC_LIST_HEAD(lctx->messages)) != NULL) {
 		ISC_LIST_UNLINK(lctx->messages, message, link);
@@ -1499,10 +1596,18 @@ isc_log_wouldlog(isc_log_t *lctx, int level) {
 	return (false);
 }
 
+/*
+ * Write the formatted message 'text' to the channels configured for
+ * 'category' and 'module'.  If 'timep' is NULL, the message is stamped
+ * with the current time.  In a 'batch', file channels are flushed by
+ * the caller.
+ *
+ * Requires the log context lock and the configuration lock.
+ */
 static void
-isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
-	     isc_logmodule_t *module, int level, bool write_once,
-	     const char *format, va_list args) {
+log_output(isc_log_t *lctx, isc_logconfig_t *lcfg, isc_logcategory_t *category,
+	   isc_logmodule_t *module, int level, bool write_once, bool forced,
+	   const isc_time_t *timep, bool batch, const char *text) {
 	int syslog_level;
 	const char *time_string;
 	char local_time[64];
@@ -1511,6 +1616,7 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 	char level_string[24] = { 0 };
 	struct stat statbuf;
 	bool matched = false;
+	bool checked = false;
 	bool printtime, iso8601, utc, printtag, printcolon;
 	bool printcategory, printmodule, printlevel, buffered;
 	isc_logchannel_t *channel;
@@ -1518,39 +1624,10 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 	int_fast32_t dlevel;
 	isc_result_t result;
 
-	REQUIRE(lctx == NULL || VALID_CONTEXT(lctx));
-	REQUIRE(category != NULL);
-	REQUIRE(module != NULL);
-	REQUIRE(level != ISC_LOG_DYNAMIC);
-	REQUIRE(format != NULL);
-
-	/*
-	 * Programs can use libraries that use this logging code without
-	 * wanting to do any logging, thus the log context is allowed to
-	 * be non-existent.
-	 */
-	if (lctx == NULL) {
-		return;
-	}
-
-	REQUIRE(category->id < lctx->category_count);
-	REQUIRE(module->id < lctx->module_count);
-
-	if (!isc_log_wouldlog(lctx, level)) {
-		return;
-	}
-
 	local_time[0] = '\0';
 	iso8601l_string[0] = '\0';
 	iso8601z_string[0] = '\0';
 
-	RDLOCK(&lctx->lcfg_rwl);
-	LOCK(&lctx->lock);
-
-	lctx->buffer[0] = '\0';
-
-	isc_logconfig_t *lcfg = lctx->logconfig;
-
 	category_channels = ISC_LIST_HEAD(lcfg->channellists[category->id]);
 
 	/*
@@ -1599,7 +1676,7 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 		channel = category_channels->channel;
 		category_channels = ISC_LIST_NEXT(category_channels, link);
 
-		if (!forcelog) {
+		if (!forced) {
 			dlevel = atomic_load_acquire(&lctx->debug_level);
 			if (((channel->flags & ISC_LOG_DEBUGONLY) != 0) &&
 			    dlevel == 0)
@@ -1621,7 +1698,11 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 		{
 			isc_time_t isctime;
 
-			TIME_NOW(&isctime);
+			if (timep != NULL) {
+				isctime = *timep;
+			} else {
+				TIME_NOW(&isctime);
+			}
 
 			isc_time_formattimestamp(&isctime, local_time,
 						 sizeof(local_time));
@@ -1648,15 +1729,11 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 		}
 
 		/*
-		 * Only format the message once.
+		 * Only check for duplicates once.
 		 */
-		if (lctx->buffer[0] == '\0') {
-			(void)vsnprintf(lctx->buffer, sizeof(lctx->buffer),
-					format, args);
+		if (!checked) {
+			checked = true;
 
-			/*
-			 * Check for duplicates.
-			 */
 			if (write_once) {
 				isc_logmessage_t *message, *next;
 				isc_time_t oldest;
@@ -1724,16 +1801,13 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 					 * duplicate filtering interval
 					 * ...
 					 */
-					if (strcmp(lctx->buffer,
-						   message->text) == 0)
-					{
+					if (strcmp(text, message->text) == 0) {
 						/*
 						 * ... and it is a
-						 * duplicate. Unlock the
-						 * mutex and get the
+						 * duplicate.  Get the
 						 * hell out of Dodge.
 						 */
-						goto unlock;
+						return;
 					}
 
 					message = ISC_LIST_NEXT(message, link);
@@ -1743,12 +1817,12 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 				 * It wasn't in the duplicate interval,
 				 * so add it to the message list.
 				 */
-				size = sizeof(isc_logmessage_t) +
-				       strlen(lctx->buffer) + 1;
+				size = sizeof(isc_logmessage_t) + strlen(text) +
+				       1;
 				message = isc_mem_get(lctx->mctx, size);
 				message->text = (char *)(message + 1);
 				size -= sizeof(isc_logmessage_t);
-				strlcpy(message->text, lctx->buffer, size);
+				strlcpy(message->text, text, size);
 				TIME_NOW(&message->time);
 				ISC_LINK_INIT(message, link);
 				ISC_LIST_APPEND(lctx->messages, message, link);
@@ -1843,9 +1917,9 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 							      : "no_module")
 					    : "",
 				printmodule ? ": " : "",
-				printlevel ? level_string : "", lctx->buffer);
+				printlevel ? level_string : "", text);
 
-			if (!buffered) {
+			if (!buffered && !batch) {
 				fflush(FILE_STREAM(channel));
 			}
 
@@ -1890,19 +1964,273 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 							      : "no_module")
 					    : "",
 				printmodule ? ": " : "",
-				printlevel ? level_string : "", lctx->buffer);
+				printlevel ? level_string : "", text);
 			break;
 
 		case ISC_LOG_TONULL:
 			break;
 		}
 	} while (1);
+}
+
+
+/*
+ * Write out the messages queued by every thread, then flush the file
+ * channels written in the batch.
+ *
+ * Requires the log context lock and the configuration lock.
+ */
+static void
+log_drain(isc_log_t *lctx, isc_logconfig_t *lcfg) {
+	isc_logring_t *ring = NULL;
+	isc_logchannel_t *channel = NULL;
+	uint_fast64_t dropped;
+	bool written = false;
+
+	ring = (isc_logring_t *)atomic_load_acquire(&lctx->rings);
+	for (; ring != NULL; ring = ring->next) {
+		uint_fast32_t head = atomic_load_relaxed(&ring->head);
+		uint_fast32_t tail = atomic_load_acquire(&ring->tail);
+
+		while (head != tail) {
+			isc_logrecord_t *record =
+				&ring->records[head % LOG_RING_SIZE];
+
+			log_output(lctx, lcfg, record->category,
+				   record->module, record->level,
+				   record->write_once, record->forced,
+				   &record->time, true, record->text);
+			atomic_store_release(&ring->head, ++head);
+			written = true;
+		}
+	}
+
+	dropped = atomic_load_relaxed(&lctx->dropped);
+	if (dropped != lctx->reported) {
+		char text[64];
+
+		snprintf(text, sizeof(text),
+			 "%" PRIuFAST64 " log messages dropped: queue full",
+			 dropped - lctx->reported);
+		lctx->reported = dropped;
+		log_output(lctx, lcfg, ISC_LOGCATEGORY_GENERAL,
+			   ISC_LOGMODULE_OTHER, ISC_LOG_WARNING, false, false,
+			   NULL, true, text);
+		written = true;
+	}
+
+	if (!written) {
+		return;
+	}
+
+	for (channel = ISC_LIST_HEAD(lcfg->channels); channel != NULL;
+	     channel = ISC_LIST_NEXT(channel, link))
+	{
+		if ((channel->type == ISC_LOG_TOFILE ||
+		     channel->type == ISC_LOG_TOFILEDESC) &&
+		    (channel->flags & ISC_LOG_BUFFERED) == 0 &&
+		    FILE_STREAM(channel) != NULL)
+		{
+			fflush(FILE_STREAM(channel));
+		}
+	}
+}
+
+static bool
+log_pending(isc_log_t *lctx) {
+	isc_logring_t *ring = NULL;
+
+	ring = (isc_logring_t *)atomic_load(&lctx->rings);
+	for (; ring != NULL; ring = ring->next) {
+		if (atomic_load(&ring->tail) != atomic_load(&ring->head)) {
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+/*
+ * The logger thread: sleep until messages are queued, then write them
+ * out in a batch.
+ */
+static isc_threadresult_t
+log_run(isc_threadarg_t arg) {
+	isc_log_t *lctx = arg;
+
+	LOCK(&lctx->async_lock);
+	while (true) {
+		/*
+		 * 'sleeping' is set before checking the rings, and the
+		 * writers check it after queueing, so either we see their
+		 * message or they see that we need a signal.
+		 */
+		atomic_store(&lctx->sleeping, true);
+		if (!log_pending(lctx)) {
+			if (lctx->shuttingdown) {
+				break;
+			}
+			WAIT(&lctx->async_cond, &lctx->async_lock);
+		}
+		atomic_store(&lctx->sleeping, false);
+		UNLOCK(&lctx->async_lock);
+
+		RDLOCK(&lctx->lcfg_rwl);
+		LOCK(&lctx->lock);
+		log_drain(lctx, lctx->logconfig);
+		UNLOCK(&lctx->lock);
+		RDUNLOCK(&lctx->lcfg_rwl);
+
+		LOCK(&lctx->async_lock);
+	}
+	UNLOCK(&lctx->async_lock);
+
+	return ((isc_threadresult_t)0);
+}
+
+/*
+ * Get the ring of the current thread, creating it on first use.
+ */
+static isc_logring_t *
+log_getring(isc_log_t *lctx) {
+	isc_logring_t *ring = NULL;
+	uintptr_t next;
+
+	if (log_ring_gen == lctx->generation) {
+		return (log_ring_v);
+	}
+
+	ring = isc_mem_get_aligned(lctx->mctx, sizeof(*ring),
+				   ISC_OS_CACHELINE_SIZE);
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+
+	next = atomic_load_acquire(&lctx->rings);
+	do {
+		ring->next = (isc_logring_t *)next;
+	} while (!atomic_compare_exchange_weak(&lctx->rings, &next,
+					       (uintptr_t)ring));
+
+	log_ring_v = ring;
+	log_ring_gen = lctx->generation;
+
+	return (ring);
+}
+
+/*
+ * Queue a message for the logger thread.  Returns false if the message
+ * is too long to queue, and must be written synchronously.
+ */
+static bool
+log_enqueue(isc_log_t *lctx, isc_logcategory_t *category,
+	    isc_logmodule_t *module, int level, bool write_once,
+	    const char *format, va_list args) {
+	isc_logring_t *ring = log_getring(lctx);
+	isc_logrecord_t *record = NULL;
+	uint_fast32_t tail = atomic_load_relaxed(&ring->tail);
+	va_list ap;
+	int n;
+
+	if (tail - atomic_load_acquire(&ring->head) == LOG_RING_SIZE) {
+		atomic_fetch_add_relaxed(&lctx->dropped, 1);
+		return (true);
+	}
+
+	record = &ring->records[tail % LOG_RING_SIZE];
+	va_copy(ap, args);
+	n = vsnprintf(record->text, sizeof(record->text), format, ap);
+	va_end(ap);
+	if (n < 0 || (size_t)n >= sizeof(record->text)) {
+		return (false);
+	}
+
+	record->category = category;
+	record->module = module;
+	record->level = level;
+	record->write_once = write_once;
+	record->forced = forcelog;
+	TIME_NOW(&record->time);
+
+	atomic_store(&ring->tail, tail + 1);
+	if (atomic_load(&lctx->sleeping)) {
+		LOCK(&lctx->async_lock);
+		SIGNAL(&lctx->async_cond);
+		UNLOCK(&lctx->async_lock);
+	}
+
+	return (true);
+}
+
+static void
+isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
+	     isc_logmodule_t *module, int level, bool write_once,
+	     const char *format, va_list args) {
+	bool async;
+
+	REQUIRE(lctx == NULL || VALID_CONTEXT(lctx));
+	REQUIRE(category != NULL);
+	REQUIRE(module != NULL);
+	REQUIRE(level != ISC_LOG_DYNAMIC);
+	REQUIRE(format != NULL);
+
+	/*
+	 * Programs can use libraries that use this logging code without
+	 * wanting to do any logging, thus the log context is allowed to
+	 * be non-existent.
+	 */
+	if (lctx == NULL) {
+		return;
+	}
+
+	REQUIRE(category->id < lctx->category_count);
+	REQUIRE(module->id < lctx->module_count);
+
+	if (!isc_log_wouldlog(lctx, level)) {
+		return;
+	}
+
+	/*
+	 * Critical messages are written synchronously, as the program
+	 * may be about to exit.
+	 */
+	async = atomic_load_acquire(&lctx->async);
+	if (async && level > ISC_LOG_CRITICAL &&
+	    log_enqueue(lctx, category, module, level, write_once, format,
+			args))
+	{
+		return;
+	}
+
+	RDLOCK(&lctx->lcfg_rwl);
+	LOCK(&lctx->lock);
+
+	/*
+	 * Write out the queued messages first, to keep the messages of
+	 * this thread in order.
+	 */
+	if (async) {
+		log_drain(lctx, lctx->logconfig);
+	}
+
+	(void)vsnprintf(lctx->buffer, sizeof(lctx->buffer), format, args);
+	log_output(lctx, lctx->logconfig, category, module, level,
+		   write_once, forcelog, NULL, false, lctx->buffer);
 
-unlock:
 	UNLOCK(&lctx->lock);
 	RDUNLOCK(&lctx->lcfg_rwl);
 }
 
+void
+isc_log_startasync(isc_log_t *lctx) {
+	REQUIRE(VALID_CONTEXT(lctx));
+	REQUIRE(!atomic_load_acquire(&lctx->async));
+
+	lctx->generation = atomic_fetch_add_relaxed(&log_generation, 1) + 1;
+	isc_thread_create(log_run, lctx, &lctx->thread);
+	isc_thread_setname(lctx->thread, "isc-log");
+	atomic_store_release(&lctx->async, true);
+}
+
 void
 isc_log_setforcelog(bool v) {
 	forcelog = v;
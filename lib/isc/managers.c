@@ -46,7 +46,7 @@ isc_managers_create(isc_mem_t *mctx, size_t workers, size_t quantum,
 
 	REQUIRE(timermgrp == NULL || *timermgrp == NULL);
 	if (timermgrp != NULL) {
-		result = isc__timermgr_create(mctx, &timermgr);
+		result = isc__timermgr_create(mctx, netmgr, &timermgr);
 		if (result != ISC_R_SUCCESS) {
 			UNEXPECTED_ERROR("isc_timermgr_create() failed: %s",
 					 isc_result_totext(result));
@@ -100,18 +100,20 @@ isc_managers_destroy(isc_nm_t **netmgrp, isc_taskmgr_t **taskmgrp,
 	}
 
 	/*
-	 * 4. Finish destruction of the netmgr, and wait until all
-	 * references have been released.
+	 * 4. Clean up the timer manager, whose timers are run by the
+	 * netmgr workers.  The timers are gone with the tasks they
+	 * post to.
 	 */
-	if (netmgrp != NULL) {
-		isc__netmgr_destroy(netmgrp);
+	if (timermgrp != NULL) {
+		INSIST(*timermgrp != NULL);
+		isc__timermgr_destroy(timermgrp);
 	}
 
 	/*
-	 * 5. Clean up the remaining managers.
+	 * 5. Finish destruction of the netmgr, and wait until all
+	 * references have been released.
 	 */
-	if (timermgrp != NULL) {
-		INSIST(*timermgrp != NULL);
-		isc__timermgr_destroy(timermgrp);
+	if (netmgrp != NULL) {
+		isc__netmgr_destroy(netmgrp);
 	}
 }
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 
 #include <isc/align.h>
+#include <isc/backtrace.h>
 #include <isc/hash.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
@@ -29,8 +30,10 @@
 #include <isc/once.h>
 #include <isc/os.h>
 #include <isc/print.h>
+#include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/types.h>
 #include <isc/util.h>
 
@@ -78,6 +81,13 @@ unsigned int isc_mem_defaultflags = ISC_MEMFLAG_DEFAULT;
 #define DEBUG_TABLE_COUNT    512U
 #define STATS_BUCKETS	     512U
 #define STATS_BUCKET_SIZE    32U
+#define STATS_SLOTS	     16U
+#define STATS_SLOT_FLUSH     (32 * 1024)
+#define SAMPLE_DEPTH	     16U
+#define SAMPLE_BUCKETS	     1024U
+#define SAMPLE_SITES	     256U
+#define SAMPLE_FILTER_BITS   20
+#define SAMPLE_TOP	     20U
 
 /*
  * Types.
@@ -111,6 +121,45 @@ struct stats {
 	atomic_size_t totalgets;
 };
 
+/*%
+ * The changes to 'inuse' (and 'malloced') and 'total' made by the
+ * threads that share a slot and have not been added to the context
+ * yet.  Each slot has its own cache line, so that the threads do not
+ * contend for the context counters on every get and put.
+ */
+struct stats_slot {
+	atomic_int_fast64_t inuse;
+	atomic_uint_fast64_t total;
+	uint8_t __padding[ISC_OS_CACHELINE_SIZE - sizeof(atomic_int_fast64_t) -
+			  sizeof(atomic_uint_fast64_t)];
+};
+
+/*%
+ * An allocation site, identified by the stack of the allocation, with
+ * the estimated number of bytes allocated there that are still in use.
+ */
+typedef struct sample_site sample_site_t;
+struct sample_site {
+	sample_site_t *next;
+	uint32_t hashval;
+	int depth;
+	void *stack[SAMPLE_DEPTH];
+	size_t bytes;
+	size_t count;
+};
+
+/*%
+ * A sampled allocation that is still in use.  It stands for 'weight'
+ * bytes allocated at 'site'.
+ */
+typedef struct sample sample_t;
+struct sample {
+	sample_t *next;
+	const void *ptr;
+	size_t weight;
+	sample_site_t *site;
+};
+
 #define MEM_MAGIC	 ISC_MAGIC('M', 'e', 'm', 'C')
 #define VALID_CONTEXT(c) ISC_MAGIC_VALID(c, MEM_MAGIC)
 
@@ -128,12 +177,28 @@ static isc_mutex_t contextslock;
  */
 static uint64_t totallost;
 
+/*%
+ * Allocation sampling: about one allocation per 'sample_rate' bytes is
+ * recorded with its stack, so that the memory in use can be attributed
+ * to allocation sites at a cost low enough for production.  Zero
+ * disables sampling.
+ *
+ * Each thread counts down the bytes until its next sample.  Frees only
+ * look up the sample tables when the filter, counting the live samples
+ * by address hash, says the address may have been sampled.
+ */
+static atomic_size_t sample_rate = 0;
+static atomic_size_t samples_live = 0;
+static atomic_uint_fast8_t sample_filter[1 << SAMPLE_FILTER_BITS];
+static thread_local int64_t sample_countdown = 0;
+
 struct isc_mem {
 	unsigned int magic;
 	unsigned int flags;
 	isc_mutex_t lock;
 	bool checkfree;
 	struct stats stats[STATS_BUCKETS + 1];
+	struct stats_slot slots[STATS_SLOTS];
 	isc_refcount_t references;
 	char name[16];
 	atomic_size_t total;
@@ -155,12 +220,41 @@ struct isc_mem {
 	size_t debuglistcnt;
 #endif /* if ISC_MEM_TRACKLINES */
 
+	/*%< Allocation sampling, locked by 'samplelock'. */
+	isc_mutex_t samplelock;
+	sample_t **samples; /*%< live samples by address */
+	sample_site_t **sites;
+	size_t samplecnt;
+	size_t sitecnt;
+
 	ISC_LINK(isc_mem_t) link;
 };
 
 #define MEMPOOL_MAGIC	 ISC_MAGIC('M', 'E', 'M', 'p')
 #define VALID_MEMPOOL(c) ISC_MAGIC_VALID(c, MEMPOOL_MAGIC)
 
+/*%
+ * Number of items held by a magazine of a shared pool.
+ */
+#define MAGAZINE_SIZE 32
+
+typedef struct magazine magazine_t;
+struct magazine {
+	magazine_t *next;
+	size_t rounds;
+	void *round[MAGAZINE_SIZE];
+};
+
+/*%
+ * The magazines of a shared pool used by the threads that map to this
+ * slot.  'previous' is always either full or empty.
+ */
+typedef struct mempool_slot {
+	alignas(ISC_OS_CACHELINE_SIZE) isc_mutex_t lock;
+	magazine_t *loaded;
+	magazine_t *previous;
+} mempool_slot_t;
+
 struct isc_mempool {
 	/* always unlocked */
 	unsigned int magic;
@@ -176,6 +270,16 @@ struct isc_mempool {
 	size_t gets; /*%< # of requests to this pool */
 	/*%< Debugging only. */
 	char name[16]; /*%< printed name in stats reports */
+	/*%< Shared pools only. */
+	mempool_slot_t *slots;	 /*%< per-thread magazines */
+	unsigned int nslots;	 /*%< # of slots */
+	isc_mutex_t depotlock;	 /*%< protects the depot */
+	magazine_t *full;	 /*%< full magazines in the depot */
+	magazine_t *empty;	 /*%< empty magazines in the depot */
+	size_t nfull;		 /*%< # of full magazines */
+	atomic_size_t shared_allocated;
+	atomic_size_t shared_freecount;
+	atomic_size_t shared_gets;
 };
 
 /*
@@ -391,20 +495,59 @@ mem_realloc(isc_mem_t *ctx, void *old_ptr, size_t old_size, size_t new_size,
 		 ? &ctx->stats[STATS_BUCKETS]        \
 		 : &ctx->stats[size / STATS_BUCKET_SIZE])
 
+#define stats_slot(ctx) (&(ctx)->slots[isc_tid_v % STATS_SLOTS])
+
+/*!
+ * Move the changes collected in 'slot' to the context counters.
+ */
+static void
+slot_flush(isc_mem_t *ctx, struct stats_slot *slot) {
+	int_fast64_t inuse = atomic_exchange_relaxed(&slot->inuse, 0);
+	uint_fast64_t total = atomic_exchange_relaxed(&slot->total, 0);
+
+	atomic_fetch_add_relaxed(&ctx->total, total);
+	atomic_fetch_add_release(&ctx->inuse, (size_t)inuse);
+
+	if (inuse > 0) {
+		increment_malloced(ctx, inuse);
+	} else {
+		decrement_malloced(ctx, -inuse);
+	}
+}
+
+/*!
+ * Sum of the changes to 'inuse' not yet added to the context.
+ */
+static size_t
+slots_inuse(isc_mem_t *ctx) {
+	int_fast64_t inuse = 0;
+
+	for (size_t i = 0; i < STATS_SLOTS; i++) {
+		inuse += atomic_load_relaxed(&ctx->slots[i].inuse);
+	}
+
+	return ((size_t)inuse);
+}
+
 /*!
  * Update internal counters after a memory get.
  */
 static void
 mem_getstats(isc_mem_t *ctx, size_t size) {
 	struct stats *stats = stats_bucket(ctx, size);
+	struct stats_slot *slot = stats_slot(ctx);
+	uint_fast64_t total;
+	int_fast64_t inuse;
 
-	atomic_fetch_add_relaxed(&ctx->total, size);
-	atomic_fetch_add_release(&ctx->inuse, size);
+	total = atomic_fetch_add_relaxed(&slot->total, size) + size;
+	inuse = atomic_fetch_add_relaxed(&slot->inuse, size) + size;
 
 	atomic_fetch_add_relaxed(&stats->gets, 1);
 	atomic_fetch_add_relaxed(&stats->totalgets, 1);
 
-	increment_malloced(ctx, size);
+	if (total >= STATS_SLOT_FLUSH || inuse >= STATS_SLOT_FLUSH) {
+		slot_flush(ctx, slot);
+	}
 }
 
 /*!
@@ -413,18 +556,271 @@ mem_getstats(isc_mem_t *ctx, size_t size) {
 static void
 mem_putstats(isc_mem_t *ctx, void *ptr, size_t size) {
 	struct stats *stats = stats_bucket(ctx, size);
-	atomic_size_t s, g;
+	struct stats_slot *slot = stats_slot(ctx);
+	int_fast64_t inuse;
+	atomic_size_t g;
 
 	UNUSED(ptr);
 
-	s = atomic_fetch_sub_release(&ctx->inuse, size);
-	INSIST(s >= size);
+	inuse = atomic_fetch_sub_relaxed(&slot->inuse, size) - size;
 
 	g = atomic_fetch_sub_release(&stats->gets, 1);
 	INSIST(g >= 1);
 
-	decrement_malloced(ctx, size);
+	if (inuse <= -STATS_SLOT_FLUSH) {
+		slot_flush(ctx, slot);
+	}
+}
+
+static size_t
+sample_filterslot(const void *ptr) {
+	uint64_t h = ((uintptr_t)ptr >> 4) * UINT64_C(0x9e3779b97f4a7c15);
+
+	return (h >> (64 - SAMPLE_FILTER_BITS));
+}
+
+/*
+ * The filter counters saturate: a slot that has reached the maximum
+ * stays there, which only costs some needless lookups.
+ */
+static void
+sample_filteradd(const void *ptr, int delta) {
+	atomic_uint_fast8_t *slot = &sample_filter[sample_filterslot(ptr)];
+	uint_fast8_t old = atomic_load_relaxed(slot);
+
+	do {
+		if (old == UINT8_MAX) {
+			return;
+		}
+	} while (!atomic_compare_exchange_weak_relaxed(slot, &old,
+							old + delta));
+}
+
+static void
+sample_reset(void) {
+	size_t rate = atomic_load_relaxed(&sample_rate);
+
+	sample_countdown = rate / 2 + isc_random_uniform(ISC_MIN(rate,
+								 UINT32_MAX));
+}
+
+static void
+sample_record(isc_mem_t *ctx, const void *ptr, size_t size, size_t rate) {
+	sample_site_t *site = NULL;
+	sample_t *sample = NULL;
+	void *stack[SAMPLE_DEPTH + 2];
+	int depth;
+	uint32_t hashval;
+	size_t idx;
+
+	/*
+	 * Leave out the frames of the memory context code itself.
+	 */
+	depth = isc_backtrace(stack, SAMPLE_DEPTH + 2) - 2;
+	if (depth <= 0) {
+		depth = 0;
+		hashval = 0;
+	} else {
+		hashval = isc_hash32(&stack[2], depth * sizeof(stack[0]),
+				     true);
+	}
+
+	sample = mallocx(sizeof(*sample), 0);
+	INSIST(sample != NULL);
+
+	LOCK(&ctx->samplelock);
+
+	if (ctx->samples == NULL) {
+		ctx->samples = mallocx(SAMPLE_BUCKETS * sizeof(sample_t *), 0);
+		ctx->sites = mallocx(SAMPLE_SITES * sizeof(sample_site_t *), 0);
+		INSIST(ctx->samples != NULL && ctx->sites != NULL);
+		memset(ctx->samples, 0, SAMPLE_BUCKETS * sizeof(sample_t *));
+		memset(ctx->sites, 0, SAMPLE_SITES * sizeof(sample_site_t *));
+	}
+
+	idx = hashval % SAMPLE_SITES;
+	for (site = ctx->sites[idx]; site != NULL; site = site->next) {
+		if (site->hashval == hashval && site->depth == depth &&
+		    memcmp(site->stack, &stack[2],
+			   depth * sizeof(stack[0])) == 0)
+		{
+			break;
+		}
+	}
+	if (site == NULL) {
+		site = mallocx(sizeof(*site), 0);
+		INSIST(site != NULL);
+		*site = (sample_site_t){
+			.next = ctx->sites[idx],
+			.hashval = hashval,
+			.depth = depth,
+		};
+		if (depth > 0) {
+			memmove(site->stack, &stack[2],
+				depth * sizeof(stack[0]));
+		}
+		ctx->sites[idx] = site;
+		ctx->sitecnt++;
+	}
+
+	/*
+	 * An allocation of 'size' bytes is sampled with a probability of
+	 * about size / rate, so it stands for 'rate' bytes unless it is
+	 * larger than that.
+	 */
+	idx = sample_filterslot(ptr) % SAMPLE_BUCKETS;
+	*sample = (sample_t){
+		.next = ctx->samples[idx],
+		.ptr = ptr,
+		.weight = ISC_MAX(size, rate),
+		.site = site,
+	};
+	ctx->samples[idx] = sample;
+	ctx->samplecnt++;
+	site->bytes += sample->weight;
+	site->count++;
+
+	sample_filteradd(ptr, 1);
+	atomic_fetch_add_relaxed(&samples_live, 1);
+
+	UNLOCK(&ctx->samplelock);
+}
+
+/*
+ * Requires 'samplelock'.
+ */
+static void
+sample_unlink(isc_mem_t *ctx, sample_t **samplep) {
+	sample_t *sample = *samplep;
+
+	*samplep = sample->next;
+	ctx->samplecnt--;
+	sample->site->bytes -= sample->weight;
+	sample->site->count--;
+
+	sample_filteradd(sample->ptr, -1);
+	atomic_fetch_sub_relaxed(&samples_live, 1);
+
+	sdallocx(sample, sizeof(*sample), 0);
+}
+
+static void
+sample_remove(isc_mem_t *ctx, const void *ptr) {
+	sample_t **samplep = NULL;
+
+	LOCK(&ctx->samplelock);
+	if (ctx->samples != NULL) {
+		samplep = &ctx->samples[sample_filterslot(ptr) %
+					SAMPLE_BUCKETS];
+		while (*samplep != NULL && (*samplep)->ptr != ptr) {
+			samplep = &(*samplep)->next;
+		}
+		if (*samplep != NULL) {
+			sample_unlink(ctx, samplep);
+		}
+	}
+	UNLOCK(&ctx->samplelock);
+}
+
+/*!
+ * Called after a memory get.
+ */
+static void
+sample_get(isc_mem_t *ctx, const void *ptr, size_t size) {
+	size_t rate = atomic_load_relaxed(&sample_rate);
+
+	if (rate == 0) {
+		return;
+	}
+
+	sample_countdown -= size;
+	if (sample_countdown > 0) {
+		return;
+	}
+
+	sample_reset();
+	sample_record(ctx, ptr, size, rate);
+}
+
+/*!
+ * Called before a memory put.
+ */
+static void
+sample_put(isc_mem_t *ctx, const void *ptr) {
+	if (atomic_load_relaxed(&samples_live) == 0) {
+		return;
+	}
+	if (atomic_load_relaxed(&sample_filter[sample_filterslot(ptr)]) == 0)
+	{
+		return;
+	}
+
+	sample_remove(ctx, ptr);
+}
+
+static void
+sample_destroy(isc_mem_t *ctx) {
+	if (ctx->samples == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < SAMPLE_BUCKETS; i++) {
+		while (ctx->samples[i] != NULL) {
+			sample_unlink(ctx, &ctx->samples[i]);
+		}
+	}
+	for (size_t i = 0; i < SAMPLE_SITES; i++) {
+		sample_site_t *site = NULL;
+		while ((site = ctx->sites[i]) != NULL) {
+			ctx->sites[i] = site->next;
+			sdallocx(site, sizeof(*site), 0);
+		}
+	}
+
+	sdallocx(ctx->samples, SAMPLE_BUCKETS * sizeof(sample_t *), 0);
+	sdallocx(ctx->sites, SAMPLE_SITES * sizeof(sample_site_t *), 0);
+	ctx->samples = NULL;
+	ctx->sites = NULL;
+	ctx->sitecnt = 0;
+}
+
+#if defined(HAVE_LIBXML2) || defined(HAVE_JSON_C)
+/*
+ * Copy the SAMPLE_TOP sites with the most bytes in use to 'top', largest
+ * first, and return how many there are.
+ */
+static size_t
+sample_topsites(isc_mem_t *ctx, sample_site_t *top) {
+	size_t n = 0;
+
+	LOCK(&ctx->samplelock);
+	for (size_t i = 0; ctx->sites != NULL && i < SAMPLE_SITES; i++) {
+		for (sample_site_t *site = ctx->sites[i]; site != NULL;
+		     site = site->next)
+		{
+			size_t j;
+
+			if (site->count == 0 ||
+			    (n == SAMPLE_TOP && site->bytes <= top[n - 1].bytes))
+			{
+				continue;
+			}
+			if (n < SAMPLE_TOP) {
+				n++;
+			}
+			for (j = n - 1; j > 0 && top[j - 1].bytes < site->bytes;
+			     j--)
+			{
+				top[j] = top[j - 1];
+			}
+			top[j] = *site;
+		}
+	}
+	UNLOCK(&ctx->samplelock);
+
+	return (n);
 }
+#endif /* if defined(HAVE_LIBXML2) || defined(HAVE_JSON_C) */
 
 /*
  * Private.
@@ -470,6 +866,7 @@ mem_create(isc_mem_t **ctxp, unsigned int flags) {
 	};
 
 	isc_mutex_init(&ctx->lock);
+	isc_mutex_init(&ctx->samplelock);
 	isc_refcount_init(&ctx->references, 1);
 
 	atomic_init(&ctx->total, 0);
@@ -486,6 +883,10 @@ mem_create(isc_mem_t **ctxp, unsigned int flags) {
 		atomic_init(&ctx->stats[i].gets, 0);
 		atomic_init(&ctx->stats[i].totalgets, 0);
 	}
+	for (size_t i = 0; i < STATS_SLOTS; i++) {
+		atomic_init(&ctx->slots[i].inuse, 0);
+		atomic_init(&ctx->slots[i].total, 0);
+	}
 	ISC_LIST_INIT(ctx->pools);
 
 #if ISC_MEM_TRACKLINES
@@ -520,6 +921,10 @@ destroy(isc_mem_t *ctx) {
 	unsigned int i;
 	size_t malloced;
 
+	for (i = 0; i < STATS_SLOTS; i++) {
+		slot_flush(ctx, &ctx->slots[i]);
+	}
+
 	LOCK(&contextslock);
 	ISC_LIST_UNLINK(contexts, ctx, link);
 	totallost += isc_mem_inuse(ctx);
@@ -529,6 +934,9 @@ destroy(isc_mem_t *ctx) {
 
 	INSIST(ISC_LIST_EMPTY(ctx->pools));
 
+	sample_destroy(ctx);
+	isc_mutex_destroy(&ctx->samplelock);
+
 #if ISC_MEM_TRACKLINES
 	if (ctx->debuglist != NULL) {
 		debuglink_t *dl;
@@ -636,6 +1044,7 @@ isc__mem_putanddetach(isc_mem_t **ctxp, void *ptr, size_t size,
 	*ctxp = NULL;
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
+	sample_put(ctx, ptr);
 
 	mem_putstats(ctx, ptr, size);
 	mem_put(ctx, ptr, size, MEM_ALIGN(alignment));
@@ -678,6 +1087,10 @@ isc__mem_destroy(isc_mem_t **ctxp FLARG) {
 	*ctxp = NULL;
 }
 
+/*
+ * The water marks are checked against the context counters only, which
+ * trail the slots by less than STATS_SLOTS * STATS_SLOT_FLUSH bytes.
+ */
 #define CALL_HI_WATER(ctx)                                             \
 	{                                                              \
 		if (ctx->water != NULL && hi_water(ctx)) {             \
@@ -762,6 +1175,7 @@ isc__mem_get(isc_mem_t *ctx, size_t size, size_t alignment FLARG) {
 
 	mem_getstats(ctx, size);
 	ADD_TRACE(ctx, ptr, size, file, line);
+	sample_get(ctx, ptr, size);
 
 	CALL_HI_WATER(ctx);
 
@@ -773,6 +1187,7 @@ isc__mem_put(isc_mem_t *ctx, void *ptr, size_t size, size_t alignment FLARG) {
 	REQUIRE(VALID_CONTEXT(ctx));
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
+	sample_put(ctx, ptr);
 
 	mem_putstats(ctx, ptr, size);
 	mem_put(ctx, ptr, size, MEM_ALIGN(alignment));
@@ -873,9 +1288,14 @@ isc_mem_stats(isc_mem_t *ctx, FILE *out) {
 	while (pool != NULL) {
 		fprintf(out,
 			"%15s %10zu %10zu %10zu %10zu %10zu %10zu %10zu %s\n",
-			pool->name, pool->size, (size_t)0, pool->allocated,
-			pool->freecount, pool->freemax, pool->fillcount,
-			pool->gets, "N");
+			pool->name, pool->size, (size_t)0,
+			(size_t)isc_mempool_getallocated(pool),
+			(size_t)isc_mempool_getfreecount(pool), pool->freemax,
+			pool->fillcount,
+			(pool->slots != NULL)
+				? atomic_load_relaxed(&pool->shared_gets)
+				: pool->gets,
+			"N");
 		pool = ISC_LIST_NEXT(pool, link);
 	}
 
@@ -899,6 +1319,7 @@ isc__mem_allocate(isc_mem_t *ctx, size_t size FLARG) {
 
 	mem_getstats(ctx, size);
 	ADD_TRACE(ctx, ptr, size, file, line);
+	sample_get(ctx, ptr, size);
 
 	CALL_HI_WATER(ctx);
 
@@ -917,6 +1338,7 @@ isc__mem_reget(isc_mem_t *ctx, void *old_ptr, size_t old_size, size_t new_size,
 		isc__mem_put(ctx, old_ptr, old_size, alignment FLARG_PASS);
 	} else {
 		DELETE_TRACE(ctx, old_ptr, old_size, file, line);
+		sample_put(ctx, old_ptr);
 		mem_putstats(ctx, old_ptr, old_size);
 
 		new_ptr = mem_realloc(ctx, old_ptr, old_size, new_size,
@@ -924,6 +1346,7 @@ isc__mem_reget(isc_mem_t *ctx, void *old_ptr, size_t old_size, size_t new_size,
 
 		mem_getstats(ctx, new_size);
 		ADD_TRACE(ctx, new_ptr, new_size, file, line);
+		sample_get(ctx, new_ptr, new_size);
 
 		/*
 		 * We want to postpone the call to water in edge case
@@ -951,6 +1374,7 @@ isc__mem_reallocate(isc_mem_t *ctx, void *old_ptr, size_t new_size FLARG) {
 		size_t old_size = sallocx(old_ptr, 0);
 
 		DELETE_TRACE(ctx, old_ptr, old_size, file, line);
+		sample_put(ctx, old_ptr);
 		mem_putstats(ctx, old_ptr, old_size);
 
 		new_ptr = mem_realloc(ctx, old_ptr, old_size, new_size, 0);
@@ -960,6 +1384,7 @@ isc__mem_reallocate(isc_mem_t *ctx, void *old_ptr, size_t new_size FLARG) {
 
 		mem_getstats(ctx, new_size);
 		ADD_TRACE(ctx, new_ptr, new_size, file, line);
+		sample_get(ctx, new_ptr, new_size);
 
 		/*
 		 * We want to postpone the call to water in edge case
@@ -982,6 +1407,7 @@ isc__mem_free(isc_mem_t *ctx, void *ptr FLARG) {
 	size = sallocx(ptr, 0);
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
+	sample_put(ctx, ptr);
 
 	mem_putstats(ctx, ptr, size);
 	mem_put(ctx, ptr, size, 0);
@@ -1046,7 +1472,7 @@ size_t
 isc_mem_inuse(isc_mem_t *ctx) {
 	REQUIRE(VALID_CONTEXT(ctx));
 
-	return (atomic_load_acquire(&ctx->inuse));
+	return (atomic_load_acquire(&ctx->inuse) + slots_inuse(ctx));
 }
 
 size_t
@@ -1058,16 +1484,23 @@ isc_mem_maxinuse(isc_mem_t *ctx) {
 
 size_t
 isc_mem_total(isc_mem_t *ctx) {
+	size_t total;
+
 	REQUIRE(VALID_CONTEXT(ctx));
 
-	return (atomic_load_acquire(&ctx->total));
+	total = atomic_load_acquire(&ctx->total);
+	for (size_t i = 0; i < STATS_SLOTS; i++) {
+		total += atomic_load_relaxed(&ctx->slots[i].total);
+	}
+
+	return (total);
 }
 
 size_t
 isc_mem_malloced(isc_mem_t *ctx) {
 	REQUIRE(VALID_CONTEXT(ctx));
 
-	return (atomic_load_acquire(&ctx->malloced));
+	return (atomic_load_acquire(&ctx->malloced) + slots_inuse(ctx));
 }
 
 size_t
@@ -1077,6 +1510,47 @@ isc_mem_maxmalloced(isc_mem_t *ctx) {
 	return (atomic_load_acquire(&ctx->maxmalloced));
 }
 
+uint64_t
+isc_mem_totalgets(void) {
+	uint64_t gets = 0;
+
+	LOCK(&contextslock);
+	for (isc_mem_t *ctx = ISC_LIST_HEAD(contexts); ctx != NULL;
+	     ctx = ISC_LIST_NEXT(ctx, link))
+	{
+		for (size_t i = 0; i <= STATS_BUCKETS; i++) {
+			gets += atomic_load_relaxed(&ctx->stats[i].totalgets);
+		}
+	}
+	UNLOCK(&contextslock);
+
+	return (gets);
+}
+
+void
+isc_mem_setsamplerate(size_t rate) {
+	atomic_store_relaxed(&sample_rate, rate);
+}
+
+size_t
+isc_mem_sampled(isc_mem_t *ctx) {
+	size_t bytes = 0;
+
+	REQUIRE(VALID_CONTEXT(ctx));
+
+	LOCK(&ctx->samplelock);
+	for (size_t i = 0; ctx->sites != NULL && i < SAMPLE_SITES; i++) {
+		for (sample_site_t *site = ctx->sites[i]; site != NULL;
+		     site = site->next)
+		{
+			bytes += site->bytes;
+		}
+	}
+	UNLOCK(&ctx->samplelock);
+
+	return (bytes);
+}
+
 void
 isc_mem_clearwater(isc_mem_t *mctx) {
 	isc_mem_setwater(mctx, NULL, NULL, 0, 0);
@@ -1121,7 +1595,7 @@ isc_mem_setwater(isc_mem_t *ctx, isc_mem_water_t water, void *water_arg,
 	atomic_store(&ctx->lo_water, lowater);
 
 	if (atomic_load_acquire(&ctx->hi_called) &&
-	    (atomic_load_acquire(&ctx->inuse) < lowater || lowater == 0U))
+	    (isc_mem_inuse(ctx) < lowater || lowater == 0U))
 	{
 		(oldwater)(oldwater_arg, ISC_MEM_LOWATER);
 	}
@@ -1213,6 +1687,179 @@ isc_mempool_setname(isc_mempool_t *restrict mpctx, const char *name) {
 	strlcpy(mpctx->name, name, sizeof(mpctx->name));
 }
 
+/*
+ * Shared pools.  Each thread takes items from and returns them to the
+ * magazines of its own slot, and exchanges whole magazines with the
+ * depot when both of them are empty or full (Bonwick and Adams,
+ * "Magazines and Vmem", USENIX 2001).
+ */
+
+static magazine_t *
+magazine_new(isc_mem_t *mctx) {
+	magazine_t *mag = isc_mem_get(mctx, sizeof(*mag));
+
+	*mag = (magazine_t){ .rounds = 0 };
+
+	return (mag);
+}
+
+static void
+magazine_free(isc_mempool_t *mpctx, magazine_t *mag) {
+	for (size_t i = 0; i < mag->rounds; i++) {
+		mem_putstats(mpctx->mctx, mag->round[i], mpctx->size);
+		mem_put(mpctx->mctx, mag->round[i], mpctx->size, 0);
+	}
+	isc_mem_put(mpctx->mctx, mag, sizeof(*mag));
+}
+
+void
+isc_mempool_setshared(isc_mempool_t *restrict mpctx, unsigned int nslots) {
+	REQUIRE(VALID_MEMPOOL(mpctx));
+	REQUIRE(mpctx->slots == NULL);
+	REQUIRE(mpctx->allocated == 0 && mpctx->items == NULL);
+	REQUIRE(nslots > 0);
+
+	mpctx->slots = isc_mem_get_aligned(mpctx->mctx,
+					   nslots * sizeof(mpctx->slots[0]),
+					   ISC_OS_CACHELINE_SIZE);
+	mpctx->nslots = nslots;
+	for (size_t i = 0; i < nslots; i++) {
+		mempool_slot_t *slot = &mpctx->slots[i];
+
+		isc_mutex_init(&slot->lock);
+		slot->loaded = magazine_new(mpctx->mctx);
+		slot->previous = magazine_new(mpctx->mctx);
+	}
+
+	isc_mutex_init(&mpctx->depotlock);
+	atomic_init(&mpctx->shared_allocated, 0);
+	atomic_init(&mpctx->shared_freecount, 0);
+	atomic_init(&mpctx->shared_gets, 0);
+}
+
+static void
+mempool_destroy_shared(isc_mempool_t *mpctx) {
+	magazine_t *mag = NULL;
+
+	for (size_t i = 0; i < mpctx->nslots; i++) {
+		mempool_slot_t *slot = &mpctx->slots[i];
+
+		magazine_free(mpctx, slot->loaded);
+		magazine_free(mpctx, slot->previous);
+		isc_mutex_destroy(&slot->lock);
+	}
+	isc_mem_put_aligned(mpctx->mctx, mpctx->slots,
+			    mpctx->nslots * sizeof(mpctx->slots[0]),
+			    ISC_OS_CACHELINE_SIZE);
+
+	while ((mag = mpctx->full) != NULL) {
+		mpctx->full = mag->next;
+		magazine_free(mpctx, mag);
+	}
+	while ((mag = mpctx->empty) != NULL) {
+		mpctx->empty = mag->next;
+		magazine_free(mpctx, mag);
+	}
+
+	isc_mutex_destroy(&mpctx->depotlock);
+}
+
+static void *
+mempool_get_shared(isc_mempool_t *mpctx) {
+	mempool_slot_t *slot = &mpctx->slots[isc_tid_v % mpctx->nslots];
+	void *item = NULL;
+
+	LOCK(&slot->lock);
+	if (slot->loaded->rounds == 0 && slot->previous->rounds != 0) {
+		ISC_SWAP(slot->loaded, slot->previous);
+	}
+	if (slot->loaded->rounds == 0) {
+		/*
+		 * Both magazines are empty; trade one for a full
+		 * magazine from the depot.
+		 */
+		LOCK(&mpctx->depotlock);
+		if (mpctx->full != NULL) {
+			slot->previous->next = mpctx->empty;
+			mpctx->empty = slot->previous;
+			slot->previous = slot->loaded;
+			slot->loaded = mpctx->full;
+			mpctx->full = slot->loaded->next;
+			mpctx->nfull--;
+		}
+		UNLOCK(&mpctx->depotlock);
+	}
+	if (slot->loaded->rounds != 0) {
+		item = slot->loaded->round[--slot->loaded->rounds];
+	}
+	UNLOCK(&slot->lock);
+
+	if (item != NULL) {
+		atomic_fetch_sub_relaxed(&mpctx->shared_freecount, 1);
+	} else {
+		item = mem_get(mpctx->mctx, mpctx->size, 0);
+		mem_getstats(mpctx->mctx, mpctx->size);
+	}
+
+	atomic_fetch_add_relaxed(&mpctx->shared_allocated, 1);
+	atomic_fetch_add_relaxed(&mpctx->shared_gets, 1);
+
+	return (item);
+}
+
+static void
+mempool_put_shared(isc_mempool_t *mpctx, void *mem) {
+	mempool_slot_t *slot = &mpctx->slots[isc_tid_v % mpctx->nslots];
+	magazine_t *empty = NULL;
+	bool cached = false;
+	size_t allocated;
+
+	allocated = atomic_fetch_sub_relaxed(&mpctx->shared_allocated, 1);
+	INSIST(allocated > 0);
+
+#if !__SANITIZE_ADDRESS__
+	LOCK(&slot->lock);
+	if (slot->loaded->rounds == MAGAZINE_SIZE &&
+	    slot->previous->rounds == 0)
+	{
+		ISC_SWAP(slot->loaded, slot->previous);
+	}
+	if (slot->loaded->rounds == MAGAZINE_SIZE) {
+		/*
+		 * Both magazines are full; hand one to the depot unless
+		 * it already holds 'freemax' items.
+		 */
+		LOCK(&mpctx->depotlock);
+		if ((mpctx->nfull + 1) * MAGAZINE_SIZE <= mpctx->freemax) {
+			empty = mpctx->empty;
+			if (empty != NULL) {
+				mpctx->empty = empty->next;
+			} else {
+				empty = magazine_new(mpctx->mctx);
+			}
+			slot->previous->next = mpctx->full;
+			mpctx->full = slot->previous;
+			mpctx->nfull++;
+			slot->previous = slot->loaded;
+			slot->loaded = empty;
+		}
+		UNLOCK(&mpctx->depotlock);
+	}
+	if (slot->loaded->rounds < MAGAZINE_SIZE) {
+		slot->loaded->round[slot->loaded->rounds++] = mem;
+		cached = true;
+	}
+	UNLOCK(&slot->lock);
+#endif
+
+	if (cached) {
+		atomic_fetch_add_relaxed(&mpctx->shared_freecount, 1);
+	} else {
+		mem_putstats(mpctx->mctx, mem, mpctx->size);
+		mem_put(mpctx->mctx, mem, mpctx->size, 0);
+	}
+}
+
 void
 isc__mempool_destroy(isc_mempool_t **restrict mpctxp FLARG) {
 	isc_mempool_t *restrict mpctx = NULL;
@@ -1234,10 +1881,14 @@ isc__mempool_destroy(isc_mempool_t **restrict mpctxp FLARG) {
 	}
 #endif
 
-	if (mpctx->allocated > 0) {
+	if (isc_mempool_getallocated(mpctx) > 0) {
 		UNEXPECTED_ERROR("mempool %s leaked memory", mpctx->name);
 	}
-	REQUIRE(mpctx->allocated == 0);
+	REQUIRE(isc_mempool_getallocated(mpctx) == 0);
+
+	if (mpctx->slots != NULL) {
+		mempool_destroy_shared(mpctx);
+	}
 
 	/*
 	 * Return any items on the free list
@@ -1272,6 +1923,12 @@ isc__mempool_get(isc_mempool_t *restrict mpctx FLARG) {
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
+	if (mpctx->slots != NULL) {
+		item = mempool_get_shared(mpctx);
+		ADD_TRACE(mpctx->mctx, item, mpctx->size, file, line);
+		return (item);
+	}
+
 	mpctx->allocated++;
 
 	if (mpctx->items == NULL) {
@@ -1315,6 +1972,12 @@ isc__mempool_put(isc_mempool_t *restrict mpctx, void *mem FLARG) {
 	REQUIRE(VALID_MEMPOOL(mpctx));
 	REQUIRE(mem != NULL);
 
+	if (mpctx->slots != NULL) {
+		DELETE_TRACE(mpctx->mctx, mem, mpctx->size, file, line);
+		mempool_put_shared(mpctx, mem);
+		return;
+	}
+
 	isc_mem_t *mctx = mpctx->mctx;
 	const size_t freecount = mpctx->freecount;
 #if !__SANITIZE_ADDRESS__
@@ -1368,6 +2031,10 @@ unsigned int
 isc_mempool_getfreecount(isc_mempool_t *restrict mpctx) {
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
+	if (mpctx->slots != NULL) {
+		return (atomic_load_relaxed(&mpctx->shared_freecount));
+	}
+
 	return (mpctx->freecount);
 }
 
@@ -1375,6 +2042,10 @@ unsigned int
 isc_mempool_getallocated(isc_mempool_t *restrict mpctx) {
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
+	if (mpctx->slots != NULL) {
+		return (atomic_load_relaxed(&mpctx->shared_allocated));
+	}
+
 	return (mpctx->allocated);
 }
 
@@ -1460,6 +2131,59 @@ typedef struct summarystat {
 		if (xmlrc < 0)      \
 			goto error; \
 	} while (0)
+static int
+xml_rendersamples(isc_mem_t *ctx, xmlTextWriterPtr writer) {
+	sample_site_t top[SAMPLE_TOP];
+	size_t n = sample_topsites(ctx, top);
+	char **symbols = NULL;
+	int xmlrc = 0;
+
+	if (n == 0) {
+		return (0);
+	}
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "samples"));
+	for (size_t i = 0; i < n; i++) {
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "sample"));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "bytes"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64 "",
+						    (uint64_t)top[i].bytes));
+		TRY0(xmlTextWriterEndElement(writer)); /* bytes */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "count"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64 "",
+						    (uint64_t)top[i].count));
+		TRY0(xmlTextWriterEndElement(writer)); /* count */
+
+		if (top[i].depth > 0) {
+			symbols = isc_backtrace_symbols(top[i].stack,
+							top[i].depth);
+		}
+		for (int j = 0; j < top[i].depth; j++) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "frame"));
+			if (symbols != NULL) {
+				TRY0(xmlTextWriterWriteFormatString(
+					writer, "%s", symbols[j]));
+			} else {
+				TRY0(xmlTextWriterWriteFormatString(
+					writer, "%p", top[i].stack[j]));
+			}
+			TRY0(xmlTextWriterEndElement(writer)); /* frame */
+		}
+		free(symbols);
+		symbols = NULL;
+
+		TRY0(xmlTextWriterEndElement(writer)); /* sample */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* samples */
+
+error:
+	free(symbols);
+	return (xmlrc);
+}
+
 static int
 xml_renderctx(isc_mem_t *ctx, summarystat_t *summary, xmlTextWriterPtr writer) {
 	REQUIRE(VALID_CONTEXT(ctx));
@@ -1539,6 +2263,8 @@ xml_renderctx(isc_mem_t *ctx, summarystat_t *summary, xmlTextWriterPtr writer) {
 		(uint64_t)atomic_load_relaxed(&ctx->lo_water)));
 	TRY0(xmlTextWriterEndElement(writer)); /* lowater */
 
+	TRY0(xml_rendersamples(ctx, writer));
+
 	TRY0(xmlTextWriterEndElement(writer)); /* context */
 
 error:
@@ -1608,6 +2334,60 @@ error:
 #ifdef HAVE_JSON_C
 #define CHECKMEM(m) RUNTIME_CHECK(m != NULL)
 
+static void
+json_rendersamples(isc_mem_t *ctx, json_object *ctxobj) {
+	sample_site_t top[SAMPLE_TOP];
+	size_t n = sample_topsites(ctx, top);
+	json_object *array, *siteobj, *stackobj, *obj;
+	char buf[64];
+
+	if (n == 0) {
+		return;
+	}
+
+	array = json_object_new_array();
+	CHECKMEM(array);
+
+	for (size_t i = 0; i < n; i++) {
+		char **symbols = NULL;
+
+		siteobj = json_object_new_object();
+		CHECKMEM(siteobj);
+
+		obj = json_object_new_int64(top[i].bytes);
+		CHECKMEM(obj);
+		json_object_object_add(siteobj, "bytes", obj);
+
+		obj = json_object_new_int64(top[i].count);
+		CHECKMEM(obj);
+		json_object_object_add(siteobj, "count", obj);
+
+		stackobj = json_object_new_array();
+		CHECKMEM(stackobj);
+		if (top[i].depth > 0) {
+			symbols = isc_backtrace_symbols(top[i].stack,
+							top[i].depth);
+		}
+		for (int j = 0; j < top[i].depth; j++) {
+			if (symbols != NULL) {
+				obj = json_object_new_string(symbols[j]);
+			} else {
+				snprintf(buf, sizeof(buf), "%p",
+					 top[i].stack[j]);
+				obj = json_object_new_string(buf);
+			}
+			CHECKMEM(obj);
+			json_object_array_add(stackobj, obj);
+		}
+		free(symbols);
+		json_object_object_add(siteobj, "stack", stackobj);
+
+		json_object_array_add(array, siteobj);
+	}
+
+	json_object_object_add(ctxobj, "samples", array);
+}
+
 static isc_result_t
 json_renderctx(isc_mem_t *ctx, summarystat_t *summary, json_object *array) {
 	REQUIRE(VALID_CONTEXT(ctx));
@@ -1683,6 +2463,8 @@ json_renderctx(isc_mem_t *ctx, summarystat_t *summary, json_object *array) {
 	CHECKMEM(obj);
 	json_object_object_add(ctxobj, "lowater", obj);
 
+	json_rendersamples(ctx, ctxobj);
+
 	MCTXUNLOCK(ctx);
 	json_object_array_add(array, ctxobj);
 	return (ISC_R_SUCCESS);
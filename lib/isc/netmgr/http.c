@@ -19,10 +19,12 @@
 #include <string.h>
 
 #include <isc/base64.h>
+#include <isc/hash.h>
 #include <isc/log.h>
 #include <isc/netmgr.h>
 #include <isc/print.h>
 #include <isc/sockaddr.h>
+#include <isc/stdtime.h>
 #include <isc/tls.h>
 #include <isc/url.h>
 #include <isc/util.h>
@@ -85,6 +87,23 @@
 
 #define INITIAL_DNS_MESSAGE_BUFFER_SIZE (512)
 
+/* The size of an HTTP/2 frame header, see RFC 7540, Section 4.1 */
+#define HTTP_FRAME_HEADER_SIZE (9)
+
+/*
+ * The size of the chunks the server side stream data are allocated from,
+ * and the largest allocation to take from them.
+ */
+#define HTTP_ARENA_CHUNK_SIZE (16 * 1024)
+#define HTTP_ARENA_MAX_ALLOC  (HTTP_ARENA_CHUNK_SIZE / 4)
+
+/*
+ * The number of the cached responses to GET requests per network thread,
+ * and the size of the largest response to cache.
+ */
+#define HTTP_GETCACHE_SIZE	   (1024)
+#define HTTP_GETCACHE_MAX_RESPONSE (4096)
+
 typedef struct isc_nm_http_response_status {
 	size_t code;
 	size_t content_length;
@@ -122,6 +141,47 @@ typedef struct http_cstream {
 	LINK(struct http_cstream) link;
 } http_cstream_t;
 
+/*
+ * The request paths, query strings and bodies of the server side streams
+ * are carved out of per-session chunks instead of being allocated one by
+ * one.  Each allocation holds a reference to its chunk, so it can outlive
+ * the session, and the chunk is rewound as soon as the session is the only
+ * one referencing it, which typically happens every time the session has
+ * no active streams.
+ */
+typedef struct http_arena_chunk {
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	size_t used;
+} http_arena_chunk_t;
+
+typedef struct http_arena_hdr {
+	http_arena_chunk_t *chunk; /* NULL if allocated from 'mctx' */
+	isc_mem_t *mctx;
+	size_t size;
+} http_arena_hdr_t;
+
+/*
+ * The responses to GET requests are cached in a direct-mapped table
+ * indexed by the hash of the query string, so that storing a response
+ * replaces whichever one was cached in its slot before.  The table
+ * belongs to a network thread and is only ever accessed from it.
+ */
+typedef struct http_getcache_entry {
+	uint32_t hash;
+	isc_stdtime_t expire;
+	isc_sockaddr_t local;
+	uint8_t *data; /* the request path, query string and response */
+	size_t size;
+	size_t pathlen;
+	size_t querylen;
+	size_t responselen;
+} http_getcache_entry_t;
+
+struct isc__nm_http_getcache {
+	http_getcache_entry_t entries[HTTP_GETCACHE_SIZE];
+};
+
 #define HTTP2_SESSION_MAGIC    ISC_MAGIC('H', '2', 'S', 'S')
 #define VALID_HTTP2_SESSION(t) ISC_MAGIC_VALID(t, HTTP2_SESSION_MAGIC)
 
@@ -155,6 +215,8 @@ struct isc_nm_http_session {
 
 	isc__nm_http_pending_callbacks_t pending_write_callbacks;
 	isc_buffer_t *pending_write_data;
+
+	http_arena_chunk_t *arena;
 };
 
 typedef enum isc_http_error_responses {
@@ -186,6 +248,11 @@ static bool
 http_send_outgoing(isc_nm_http_session_t *session, isc_nmhandle_t *httphandle,
 		   isc_nm_cb_t cb, void *cbarg);
 
+static char *
+server_base64url_to_base64(isc_nm_http_session_t *session,
+			   const char *base64url, const size_t base64url_len,
+			   size_t *res_len);
+
 static void
 http_do_bio(isc_nm_http_session_t *session, isc_nmhandle_t *send_httphandle,
 	    isc_nm_cb_t send_cb, void *send_cbarg);
@@ -280,6 +347,175 @@ init_nghttp2_mem(isc_mem_t *mctx, nghttp2_mem *mem) {
 			      .mem_user_data = mctx };
 }
 
+static void
+http_arena_chunk_detach(http_arena_chunk_t **chunkp) {
+	http_arena_chunk_t *chunk = *chunkp;
+
+	*chunkp = NULL;
+
+	if (isc_refcount_decrement(&chunk->references) == 1) {
+		isc_refcount_destroy(&chunk->references);
+		isc_mem_putanddetach(&chunk->mctx, chunk,
+				     sizeof(*chunk) + HTTP_ARENA_CHUNK_SIZE);
+	}
+}
+
+static void *
+http_session_alloc(isc_nm_http_session_t *session, size_t size) {
+	const size_t need = ISC_ALIGN(sizeof(http_arena_hdr_t) + size,
+				      sizeof(void *));
+	http_arena_chunk_t *chunk = session->arena;
+	http_arena_hdr_t *hdr = NULL;
+
+	if (need > HTTP_ARENA_MAX_ALLOC) {
+		hdr = isc_mem_get(session->mctx, sizeof(*hdr) + size);
+		*hdr = (http_arena_hdr_t){ .mctx = session->mctx,
+					   .size = size };
+		return (hdr + 1);
+	}
+
+	if (chunk != NULL && isc_refcount_current(&chunk->references) == 1) {
+		/* Nothing allocated from the chunk is in use anymore */
+		chunk->used = 0;
+	} else if (chunk != NULL && chunk->used + need > HTTP_ARENA_CHUNK_SIZE)
+	{
+		http_arena_chunk_detach(&session->arena);
+		chunk = NULL;
+	}
+
+	if (chunk == NULL) {
+		chunk = isc_mem_get(session->mctx,
+				    sizeof(*chunk) + HTTP_ARENA_CHUNK_SIZE);
+		*chunk = (http_arena_chunk_t){ .mctx = NULL };
+		isc_mem_attach(session->mctx, &chunk->mctx);
+		isc_refcount_init(&chunk->references, 1);
+		session->arena = chunk;
+	}
+
+	hdr = (http_arena_hdr_t *)((uint8_t *)(chunk + 1) + chunk->used);
+	chunk->used += need;
+	isc_refcount_increment(&chunk->references);
+	*hdr = (http_arena_hdr_t){ .chunk = chunk, .size = size };
+
+	return (hdr + 1);
+}
+
+static void
+http_session_free(void *ptr) {
+	http_arena_hdr_t *hdr = (http_arena_hdr_t *)ptr - 1;
+
+	if (hdr->chunk != NULL) {
+		http_arena_chunk_detach(&hdr->chunk);
+	} else {
+		isc_mem_put(hdr->mctx, hdr, sizeof(*hdr) + hdr->size);
+	}
+}
+
+static void
+http_getcache_entry_free(isc_mem_t *mctx, http_getcache_entry_t *entry) {
+	if (entry->data != NULL) {
+		isc_mem_put(mctx, entry->data, entry->size);
+	}
+	*entry = (http_getcache_entry_t){ .data = NULL };
+}
+
+void
+isc__nm_http_getcache_destroy(isc__networker_t *worker) {
+	struct isc__nm_http_getcache *cache = worker->http_getcache;
+
+	if (cache == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < HTTP_GETCACHE_SIZE; i++) {
+		http_getcache_entry_free(worker->mgr->mctx,
+					 &cache->entries[i]);
+	}
+
+	isc_mem_put(worker->mgr->mctx, cache, sizeof(*cache));
+	worker->http_getcache = NULL;
+}
+
+static http_getcache_entry_t *
+http_getcache_find(isc_nmsocket_t *sock, isc_stdtime_t now) {
+	isc__networker_t *worker = &sock->mgr->workers[sock->tid];
+	const size_t pathlen = strlen(sock->h2.request_path);
+	http_getcache_entry_t *entry = NULL;
+	isc_sockaddr_t local;
+	uint32_t hash;
+
+	if (worker->http_getcache == NULL) {
+		return (NULL);
+	}
+
+	hash = isc_hash32(sock->h2.query_data, sock->h2.query_data_len, true);
+	entry = &worker->http_getcache->entries[hash % HTTP_GETCACHE_SIZE];
+	if (entry->data == NULL || entry->hash != hash ||
+	    entry->expire <= now ||
+	    entry->querylen != sock->h2.query_data_len ||
+	    entry->pathlen != pathlen)
+	{
+		return (NULL);
+	}
+
+	local = isc_nmhandle_localaddr(sock->h2.session->handle);
+	if (!isc_sockaddr_equal(&entry->local, &local) ||
+	    memcmp(entry->data, sock->h2.request_path, pathlen) != 0 ||
+	    memcmp(entry->data + pathlen, sock->h2.query_data,
+		   entry->querylen) != 0)
+	{
+		return (NULL);
+	}
+
+	return (entry);
+}
+
+static void
+http_getcache_store(isc_nmsocket_t *sock, const isc_region_t *response) {
+	isc__networker_t *worker = &sock->mgr->workers[sock->tid];
+	uint32_t ttl = atomic_load_relaxed(&sock->mgr->http_getcache_ttl);
+	http_getcache_entry_t *entry = NULL;
+	isc_stdtime_t now;
+	size_t pathlen;
+	uint32_t hash;
+
+	if (ttl == 0 || sock->h2.min_ttl == 0 ||
+	    sock->h2.request_type != ISC_HTTP_REQ_GET ||
+	    sock->h2.request_path == NULL || sock->h2.query_data == NULL ||
+	    response->length > HTTP_GETCACHE_MAX_RESPONSE)
+	{
+		return;
+	}
+
+	if (worker->http_getcache == NULL) {
+		worker->http_getcache = isc_mem_get(
+			sock->mgr->mctx, sizeof(*worker->http_getcache));
+		memset(worker->http_getcache, 0,
+		       sizeof(*worker->http_getcache));
+	}
+
+	hash = isc_hash32(sock->h2.query_data, sock->h2.query_data_len, true);
+	entry = &worker->http_getcache->entries[hash % HTTP_GETCACHE_SIZE];
+	http_getcache_entry_free(sock->mgr->mctx, entry);
+
+	isc_stdtime_get(&now);
+	pathlen = strlen(sock->h2.request_path);
+	*entry = (http_getcache_entry_t){
+		.hash = hash,
+		.expire = now + ISC_MIN(ttl, sock->h2.min_ttl),
+		.local = isc_nmhandle_localaddr(sock->h2.session->handle),
+		.size = pathlen + sock->h2.query_data_len + response->length,
+		.pathlen = pathlen,
+		.querylen = sock->h2.query_data_len,
+		.responselen = response->length,
+	};
+	entry->data = isc_mem_get(sock->mgr->mctx, entry->size);
+	memmove(entry->data, sock->h2.request_path, pathlen);
+	memmove(entry->data + pathlen, sock->h2.query_data, entry->querylen);
+	memmove(entry->data + pathlen + entry->querylen, response->base,
+		response->length);
+}
+
 static void
 new_session(isc_mem_t *mctx, isc_tlsctx_t *tctx,
 	    isc_nm_http_session_t **sessionp) {
@@ -340,6 +576,10 @@ isc__nm_httpsession_detach(isc_nm_http_session_t **sessionp) {
 		isc_buffer_free(&session->buf);
 	}
 
+	if (session->arena != NULL) {
+		http_arena_chunk_detach(&session->arena);
+	}
+
 	/* We need an acquire memory barrier here */
 	(void)isc_refcount_current(&session->references);
 
@@ -555,8 +795,8 @@ on_server_data_chunk_recv_callback(int32_t stream_id, const uint8_t *data,
 			if (isc_buffer_base(&h2->rbuf) == NULL) {
 				isc_buffer_init(
 					&h2->rbuf,
-					isc_mem_allocate(session->mctx,
-							 h2->content_length),
+					http_session_alloc(session,
+							   h2->content_length),
 					MAX_DNS_MESSAGE_SIZE);
 			}
 			size_t new_bufsize = isc_buffer_usedlength(&h2->rbuf) +
@@ -1070,6 +1310,18 @@ move_pending_send_callbacks(isc_nm_http_session_t *session,
 	ISC_LIST_INIT(session->pending_write_callbacks);
 }
 
+static void
+http_pending_write_append(isc_nm_http_session_t *session, const uint8_t *data,
+			  size_t len) {
+	/* reallocate buffer if required */
+	if (session->pending_write_data == NULL) {
+		isc_buffer_allocate(session->mctx, &session->pending_write_data,
+				    INITIAL_DNS_MESSAGE_BUFFER_SIZE);
+		isc_buffer_setautorealloc(session->pending_write_data, true);
+	}
+	isc_buffer_putmem(session->pending_write_data, data, len);
+}
+
 static bool
 http_send_outgoing(isc_nm_http_session_t *session, isc_nmhandle_t *httphandle,
 		   isc_nm_cb_t cb, void *cbarg) {
@@ -1077,6 +1329,7 @@ http_send_outgoing(isc_nm_http_session_t *session, isc_nmhandle_t *httphandle,
 	size_t total = 0;
 	isc_region_t send_data = { 0 };
 	isc_nmhandle_t *transphandle = NULL;
+	size_t already_pending = 0;
 #ifdef ENABLE_HTTP_WRITE_BUFFERING
 	size_t max_total_write_size = 0;
 #endif /* ENABLE_HTTP_WRITE_BUFFERING */
@@ -1096,11 +1349,15 @@ http_send_outgoing(isc_nm_http_session_t *session, isc_nmhandle_t *httphandle,
 	 * called properly. */
 	isc_nmhandle_attach(session->handle, &transphandle);
 
+	if (session->pending_write_data != NULL) {
+		already_pending =
+			isc_buffer_usedlength(session->pending_write_data);
+	}
+
 	while (nghttp2_session_want_write(session->ngsession)) {
 		const uint8_t *data = NULL;
 		const size_t pending =
 			nghttp2_session_mem_send(session->ngsession, &data);
-		const size_t new_total = total + pending;
 
 		/* Sometimes nghttp2_session_mem_send() does not return any
 		 * data to send even though nghttp2_session_want_write()
@@ -1109,16 +1366,15 @@ http_send_outgoing(isc_nm_http_session_t *session, isc_nmhandle_t *httphandle,
 			break;
 		}
 
-		/* reallocate buffer if required */
-		if (session->pending_write_data == NULL) {
-			isc_buffer_allocate(session->mctx,
-					    &session->pending_write_data,
-					    INITIAL_DNS_MESSAGE_BUFFER_SIZE);
-			isc_buffer_setautorealloc(session->pending_write_data,
-						  true);
-		}
-		isc_buffer_putmem(session->pending_write_data, data, pending);
-		total = new_total;
+		http_pending_write_append(session, data, pending);
+	}
+
+	/* The DATA frames of the server responses are not returned by
+	 * nghttp2_session_mem_send(), but appended to the buffer directly
+	 * by server_send_data_callback(), so count what was added. */
+	if (session->pending_write_data != NULL) {
+		total = isc_buffer_usedlength(session->pending_write_data) -
+			already_pending;
 	}
 
 #ifdef ENABLE_HTTP_WRITE_BUFFERING
@@ -1694,13 +1950,15 @@ server_handle_path_header(isc_nmsocket_t *socket, const uint8_t *value,
 	}
 
 	if (socket->h2.request_path != NULL) {
-		isc_mem_free(socket->mgr->mctx, socket->h2.request_path);
+		http_session_free(socket->h2.request_path);
 	}
-	socket->h2.request_path = isc_mem_strndup(
-		socket->mgr->mctx, (const char *)value, vlen + 1);
+	socket->h2.request_path = http_session_alloc(socket->h2.session,
+						     vlen + 1);
+	memmove(socket->h2.request_path, value, vlen);
+	socket->h2.request_path[vlen] = '\0';
 
 	if (!isc_nm_http_path_isvalid(socket->h2.request_path)) {
-		isc_mem_free(socket->mgr->mctx, socket->h2.request_path);
+		http_session_free(socket->h2.request_path);
 		socket->h2.request_path = NULL;
 		return (ISC_HTTP_ERROR_BAD_REQUEST);
 	}
@@ -1713,7 +1971,7 @@ server_handle_path_header(isc_nmsocket_t *socket, const uint8_t *value,
 		socket->h2.cbarg = handler->cbarg;
 		socket->extrahandlesize = handler->extrahandlesize;
 	} else {
-		isc_mem_free(socket->mgr->mctx, socket->h2.request_path);
+		http_session_free(socket->h2.request_path);
 		socket->h2.request_path = NULL;
 		return (ISC_HTTP_ERROR_NOT_FOUND);
 	}
@@ -1728,12 +1986,12 @@ server_handle_path_header(isc_nmsocket_t *socket, const uint8_t *value,
 			const size_t decoded_size = dns_value_len / 4 * 3;
 			if (decoded_size <= MAX_DNS_MESSAGE_SIZE) {
 				if (socket->h2.query_data != NULL) {
-					isc_mem_free(socket->mgr->mctx,
-						     socket->h2.query_data);
+					http_session_free(
+						socket->h2.query_data);
 				}
 				socket->h2.query_data =
-					isc__nm_base64url_to_base64(
-						socket->mgr->mctx, dns_value,
+					server_base64url_to_base64(
+						socket->h2.session, dns_value,
 						dns_value_len,
 						&socket->h2.query_data_len);
 			} else {
@@ -1897,31 +2155,64 @@ server_read_callback(nghttp2_session *ngsession, int32_t stream_id,
 		     nghttp2_data_source *source, void *user_data) {
 	isc_nm_http_session_t *session = (isc_nm_http_session_t *)user_data;
 	isc_nmsocket_t *socket = (isc_nmsocket_t *)source->ptr;
-	size_t buflen;
+	size_t buflen, remaining;
 
 	REQUIRE(socket->h2.stream_id == stream_id);
 
 	UNUSED(ngsession);
 	UNUSED(session);
 
-	buflen = isc_buffer_remaininglength(&socket->h2.wbuf);
-	if (buflen > length) {
-		buflen = length;
-	}
+	UNUSED(buf);
 
+	remaining = isc_buffer_remaininglength(&socket->h2.wbuf);
+	buflen = ISC_MIN(remaining, length);
+
+	/*
+	 * Instead of copying the response into the frame buffer here, let
+	 * server_send_data_callback() take it straight from the send
+	 * buffer.
+	 */
 	if (buflen > 0) {
-		(void)memmove(buf, isc_buffer_current(&socket->h2.wbuf),
-			      buflen);
-		isc_buffer_forward(&socket->h2.wbuf, buflen);
+		*data_flags |= NGHTTP2_DATA_FLAG_NO_COPY;
 	}
 
-	if (isc_buffer_remaininglength(&socket->h2.wbuf) == 0) {
+	if (buflen == remaining) {
 		*data_flags |= NGHTTP2_DATA_FLAG_EOF;
 	}
 
 	return (buflen);
 }
 
+static int
+server_send_data_callback(nghttp2_session *ngsession, nghttp2_frame *frame,
+			  const uint8_t *framehd, size_t length,
+			  nghttp2_data_source *source, void *user_data) {
+	static const uint8_t padding[256] = { 0 };
+	isc_nm_http_session_t *session = (isc_nm_http_session_t *)user_data;
+	isc_nmsocket_t *socket = (isc_nmsocket_t *)source->ptr;
+	const size_t padlen = frame->data.padlen;
+
+	UNUSED(ngsession);
+
+	REQUIRE(socket->h2.stream_id == frame->hd.stream_id);
+	REQUIRE(isc_buffer_remaininglength(&socket->h2.wbuf) >= length);
+	INSIST(padlen <= sizeof(padding));
+
+	http_pending_write_append(session, framehd, HTTP_FRAME_HEADER_SIZE);
+	if (padlen > 0) {
+		const uint8_t padlen_field = (uint8_t)(padlen - 1);
+		http_pending_write_append(session, &padlen_field, 1);
+	}
+	http_pending_write_append(session, isc_buffer_current(&socket->h2.wbuf),
+				  length);
+	isc_buffer_forward(&socket->h2.wbuf, length);
+	if (padlen > 1) {
+		http_pending_write_append(session, padding, padlen - 1);
+	}
+
+	return (0);
+}
+
 static isc_result_t
 server_send_response(nghttp2_session *ngsession, int32_t stream_id,
 		     const nghttp2_nv *nva, size_t nvlen,
@@ -2000,6 +2291,73 @@ log_server_error_response(const isc_nmsocket_t *socket,
 		      response->desc);
 }
 
+static isc_result_t
+server_submit_dns_response(nghttp2_session *ngsession, isc_nmsocket_t *sock) {
+	size_t content_len_buf_len, cache_control_buf_len;
+
+	content_len_buf_len = snprintf(
+		sock->h2.clenbuf, sizeof(sock->h2.clenbuf), "%lu",
+		(unsigned long)isc_buffer_usedlength(&sock->h2.wbuf));
+	if (sock->h2.min_ttl == 0) {
+		cache_control_buf_len =
+			snprintf(sock->h2.cache_control_buf,
+				 sizeof(sock->h2.cache_control_buf), "%s",
+				 DEFAULT_CACHE_CONTROL);
+	} else {
+		cache_control_buf_len =
+			snprintf(sock->h2.cache_control_buf,
+				 sizeof(sock->h2.cache_control_buf),
+				 "max-age=%" PRIu32, sock->h2.min_ttl);
+	}
+	const nghttp2_nv hdrs[] = { MAKE_NV2(":status", "200"),
+				    MAKE_NV2("Content-Type", DNS_MEDIA_TYPE),
+				    MAKE_NV("Content-Length", sock->h2.clenbuf,
+					    content_len_buf_len),
+				    MAKE_NV("Cache-Control",
+					    sock->h2.cache_control_buf,
+					    cache_control_buf_len) };
+
+	return (server_send_response(ngsession, sock->h2.stream_id, hdrs,
+				     sizeof(hdrs) / sizeof(nghttp2_nv), sock));
+}
+
+/*
+ * Answer a GET request with the response cached for an identical one,
+ * if any; returns ISC_R_NOTFOUND if there is none.
+ */
+static isc_result_t
+server_send_cached_response(nghttp2_session *ngsession,
+			    isc_nmsocket_t *socket) {
+	http_getcache_entry_t *entry = NULL;
+	isc_stdtime_t now;
+
+	if (atomic_load_relaxed(&socket->mgr->http_getcache_ttl) == 0) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	isc_stdtime_get(&now);
+	entry = http_getcache_find(socket, now);
+	if (entry == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	/*
+	 * The cache entry may be replaced before the response is sent,
+	 * so send a copy.
+	 */
+	socket->h2.cached_response = http_session_alloc(socket->h2.session,
+							entry->responselen);
+	memmove(socket->h2.cached_response,
+		entry->data + entry->pathlen + entry->querylen,
+		entry->responselen);
+	isc_buffer_init(&socket->h2.wbuf, socket->h2.cached_response,
+			entry->responselen);
+	isc_buffer_add(&socket->h2.wbuf, entry->responselen);
+	socket->h2.min_ttl = entry->expire - now;
+
+	return (server_submit_dns_response(ngsession, socket));
+}
+
 static isc_result_t
 server_send_error_response(const isc_http_error_responses_t error,
 			   nghttp2_session *ngsession, isc_nmsocket_t *socket) {
@@ -2009,7 +2367,7 @@ server_send_error_response(const isc_http_error_responses_t error,
 
 	base = isc_buffer_base(&socket->h2.rbuf);
 	if (base != NULL) {
-		isc_mem_free(socket->h2.session->mctx, base);
+		http_session_free(base);
 		isc_buffer_initnull(&socket->h2.rbuf);
 	}
 
@@ -2118,6 +2476,15 @@ server_on_request_recv(nghttp2_session *ngsession,
 		goto error;
 	}
 
+	if (socket->h2.request_type == ISC_HTTP_REQ_GET) {
+		result = server_send_cached_response(ngsession, socket);
+		if (result == ISC_R_SUCCESS) {
+			return (0);
+		} else if (result != ISC_R_NOTFOUND) {
+			return (NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE);
+		}
+	}
+
 	if (socket->h2.request_type == ISC_HTTP_REQ_GET) {
 		isc_buffer_t decoded_buf;
 		isc_buffer_init(&decoded_buf, tmp_buf, sizeof(tmp_buf));
@@ -2208,7 +2575,6 @@ client_httpsend(isc_nmhandle_t *handle, isc_nmsocket_t *sock,
 static void
 server_httpsend(isc_nmhandle_t *handle, isc_nmsocket_t *sock,
 		isc__nm_uvreq_t *req) {
-	size_t content_len_buf_len, cache_control_buf_len;
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_nm_cb_t cb = req->cb.send;
 	void *cbarg = req->cbarg;
@@ -2226,33 +2592,12 @@ server_httpsend(isc_nmhandle_t *handle, isc_nmsocket_t *sock,
 	isc_buffer_init(&sock->h2.wbuf, req->uvbuf.base, req->uvbuf.len);
 	isc_buffer_add(&sock->h2.wbuf, req->uvbuf.len);
 
-	content_len_buf_len = snprintf(sock->h2.clenbuf,
-				       sizeof(sock->h2.clenbuf), "%lu",
-				       (unsigned long)req->uvbuf.len);
-	if (sock->h2.min_ttl == 0) {
-		cache_control_buf_len =
-			snprintf(sock->h2.cache_control_buf,
-				 sizeof(sock->h2.cache_control_buf), "%s",
-				 DEFAULT_CACHE_CONTROL);
-	} else {
-		cache_control_buf_len =
-			snprintf(sock->h2.cache_control_buf,
-				 sizeof(sock->h2.cache_control_buf),
-				 "max-age=%" PRIu32, sock->h2.min_ttl);
-	}
-	const nghttp2_nv hdrs[] = { MAKE_NV2(":status", "200"),
-				    MAKE_NV2("Content-Type", DNS_MEDIA_TYPE),
-				    MAKE_NV("Content-Length", sock->h2.clenbuf,
-					    content_len_buf_len),
-				    MAKE_NV("Cache-Control",
-					    sock->h2.cache_control_buf,
-					    cache_control_buf_len) };
-
-	result = server_send_response(handle->httpsession->ngsession,
-				      sock->h2.stream_id, hdrs,
-				      sizeof(hdrs) / sizeof(nghttp2_nv), sock);
-
+	result = server_submit_dns_response(handle->httpsession->ngsession,
+					    sock);
 	if (result == ISC_R_SUCCESS) {
+		http_getcache_store(sock, &(isc_region_t){
+						  (uint8_t *)req->uvbuf.base,
+						  req->uvbuf.len });
 		http_do_bio(handle->httpsession, handle, cb, cbarg);
 	} else {
 		cb(handle, result, cbarg);
@@ -2379,6 +2724,9 @@ initialize_nghttp2_server_session(isc_nm_http_session_t *session) {
 	nghttp2_session_callbacks_set_on_frame_recv_callback(
 		callbacks, server_on_frame_recv_callback);
 
+	nghttp2_session_callbacks_set_send_data_callback(
+		callbacks, server_send_data_callback);
+
 	RUNTIME_CHECK(nghttp2_session_server_new3(&session->ngsession,
 						  callbacks, session, NULL,
 						  &mem) == 0);
@@ -2877,6 +3225,20 @@ failed_read_cb(isc_result_t result, isc_nm_http_session_t *session) {
 	}
 }
 
+void
+isc_nm_sethttpgetcachettl(isc_nm_t *mgr, uint32_t ttl) {
+	REQUIRE(VALID_NM(mgr));
+
+	atomic_store(&mgr->http_getcache_ttl, ttl);
+}
+
+uint32_t
+isc_nm_gethttpgetcachettl(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (atomic_load(&mgr->http_getcache_ttl));
+}
+
 void
 isc__nm_http_set_maxage(isc_nmhandle_t *handle, const uint32_t ttl) {
 	isc_nm_http_session_t *session;
@@ -3081,19 +3443,20 @@ static const bool base64url_validation_table[256] = {
 	false, false, false, false, false, false
 };
 
-char *
-isc__nm_base64url_to_base64(isc_mem_t *mem, const char *base64url,
-			    const size_t base64url_len, size_t *res_len) {
-	char *res = NULL;
-	size_t i, k, len;
-
-	if (mem == NULL || base64url == NULL || base64url_len == 0) {
-		return (NULL);
-	}
+static size_t
+base64url_to_base64_len(const size_t base64url_len) {
+	return (base64url_len % 4 ? base64url_len + (4 - base64url_len % 4)
+				  : base64url_len);
+}
 
-	len = base64url_len % 4 ? base64url_len + (4 - base64url_len % 4)
-				: base64url_len;
-	res = isc_mem_allocate(mem, len + 1); /* '\0' */
+/*
+ * Convert 'base64url' into 'res', which must have room for
+ * base64url_to_base64_len(base64url_len) + 1 characters.
+ */
+static bool
+base64url_to_base64(const char *base64url, const size_t base64url_len,
+		    char *res) {
+	size_t i, k;
 
 	for (i = 0; i < base64url_len; i++) {
 		switch (base64url[i]) {
@@ -3107,8 +3470,7 @@ isc__nm_base64url_to_base64(isc_mem_t *mem, const char *base64url,
 			if (base64url_validation_table[(size_t)base64url[i]]) {
 				res[i] = base64url[i];
 			} else {
-				isc_mem_free(mem, res);
-				return (NULL);
+				return (false);
 			}
 			break;
 		}
@@ -3120,13 +3482,62 @@ isc__nm_base64url_to_base64(isc_mem_t *mem, const char *base64url,
 		}
 	}
 
-	INSIST(i == len);
+	INSIST(i == base64url_to_base64_len(base64url_len));
+
+	res[i] = '\0';
+
+	return (true);
+}
+
+char *
+isc__nm_base64url_to_base64(isc_mem_t *mem, const char *base64url,
+			    const size_t base64url_len, size_t *res_len) {
+	char *res = NULL;
+	size_t len;
+
+	if (mem == NULL || base64url == NULL || base64url_len == 0) {
+		return (NULL);
+	}
+
+	len = base64url_to_base64_len(base64url_len);
+	res = isc_mem_allocate(mem, len + 1); /* '\0' */
+
+	if (!base64url_to_base64(base64url, base64url_len, res)) {
+		isc_mem_free(mem, res);
+		return (NULL);
+	}
 
 	if (res_len != NULL) {
 		*res_len = len;
 	}
 
-	res[len] = '\0';
+	return (res);
+}
+
+/*
+ * Same as isc__nm_base64url_to_base64(), but allocate the result from the
+ * session arena, see http_session_alloc().
+ */
+static char *
+server_base64url_to_base64(isc_nm_http_session_t *session,
+			   const char *base64url, const size_t base64url_len,
+			   size_t *res_len) {
+	char *res = NULL;
+	size_t len;
+
+	if (base64url == NULL || base64url_len == 0) {
+		return (NULL);
+	}
+
+	len = base64url_to_base64_len(base64url_len);
+	res = http_session_alloc(session, len + 1); /* '\0' */
+
+	if (!base64url_to_base64(base64url, base64url_len, res)) {
+		http_session_free(res);
+		return (NULL);
+	}
+
+	*res_len = len;
 
 	return (res);
 }
@@ -3211,12 +3622,12 @@ isc__nm_http_cleanup_data(isc_nmsocket_t *sock) {
 		}
 
 		if (sock->h2.request_path != NULL) {
-			isc_mem_free(sock->mgr->mctx, sock->h2.request_path);
+			http_session_free(sock->h2.request_path);
 			sock->h2.request_path = NULL;
 		}
 
 		if (sock->h2.query_data != NULL) {
-			isc_mem_free(sock->mgr->mctx, sock->h2.query_data);
+			http_session_free(sock->h2.query_data);
 			sock->h2.query_data = NULL;
 		}
 
@@ -3224,9 +3635,14 @@ isc__nm_http_cleanup_data(isc_nmsocket_t *sock) {
 
 		if (isc_buffer_base(&sock->h2.rbuf) != NULL) {
 			void *base = isc_buffer_base(&sock->h2.rbuf);
-			isc_mem_free(sock->mgr->mctx, base);
+			http_session_free(base);
 			isc_buffer_initnull(&sock->h2.rbuf);
 		}
+
+		if (sock->h2.cached_response != NULL) {
+			http_session_free(sock->h2.cached_response);
+			sock->h2.cached_response = NULL;
+		}
 	}
 
 	if ((sock->type == isc_nm_httplistener ||
@@ -78,6 +78,24 @@
  */
 #define ISC_NETMGR_SENDBUF_SIZE (sizeof(uint16_t) + UINT16_MAX)
 
+/*
+ * The maximum number of outgoing UDP messages that can be queued on a
+ * single networker before they are flushed with sendmmsg(2)
+ */
+#define ISC_NETMGR_UDP_SENDBATCH_MAX 64
+
+/*
+ * The maximum number of outgoing TCP DNS messages that can be queued on
+ * a single networker before they are flushed with writev(2)
+ */
+#define ISC_NETMGR_TCP_SENDBATCH_MAX 64
+
+/*
+ * The maximum number of CPU-pinned sockets that can be steered by the
+ * SO_ATTACH_REUSEPORT_CBPF program (see isc__nm_socket_reuseport_cpu())
+ */
+#define ISC_NETMGR_MAXCPUFILTER 256
+
 /*
  * Make sure our RECVBUF size is large enough
  */
@@ -194,16 +212,22 @@ isc__nm_dump_active(isc_nm_t *nm);
 #endif
 
 /*
- * Queue types in the order of processing priority.
+ * Queue types in the order of processing priority.  Events for
+ * background tasks are processed after the network events, so that
+ * maintenance work does not delay answering queries.
  */
 typedef enum {
 	NETIEVENT_PRIORITY = 0,
 	NETIEVENT_PRIVILEGED = 1,
 	NETIEVENT_TASK = 2,
 	NETIEVENT_NORMAL = 3,
-	NETIEVENT_MAX = 4,
+	NETIEVENT_BACKGROUND = 4,
+	NETIEVENT_MAX = 5,
 } netievent_type_t;
 
+#define NETIEVENT_TASKQUEUE(type) \
+	((type) == NETIEVENT_TASK || (type) == NETIEVENT_BACKGROUND)
+
 typedef struct isc__nm_uvreq isc__nm_uvreq_t;
 typedef struct isc__netievent isc__netievent_t;
 
@@ -213,6 +237,7 @@ typedef struct ievent {
 	isc_mutex_t lock;
 	isc_condition_t cond;
 	isc__netievent_list_t list;
+	atomic_uint_fast32_t depth; /* only kept for the task queues */
 } ievent_t;
 
 /*
@@ -228,12 +253,49 @@ typedef struct isc__networker {
 	bool finished;
 	isc_thread_t thread;
 	ievent_t ievents[NETIEVENT_MAX];
+	atomic_uint_fast64_t stolen; /* task events taken from others */
 
 	isc_refcount_t references;
 	atomic_int_fast64_t pktcount;
 	char *recvbuf;
 	char *sendbuf;
 	bool recvbuf_inuse;
+
+	/*
+	 * Outgoing UDP messages waiting to be flushed at the end of the
+	 * current loop iteration (see isc__nm_udp_flush()).
+	 */
+	uv_check_t udpsend_check;
+	isc__nm_uvreq_t *udpsendq[ISC_NETMGR_UDP_SENDBATCH_MAX];
+	size_t udpsendq_len;
+	bool udpsend_nogso; /* UDP_SEGMENT is not supported */
+
+	/*
+	 * Outgoing TCP DNS messages waiting to be flushed at the end of
+	 * the current loop iteration (see isc__nm_tcpdns_flush()).
+	 */
+	uv_check_t tcpsend_check;
+	isc__nm_uvreq_t *tcpsendq[ISC_NETMGR_TCP_SENDBATCH_MAX];
+	size_t tcpsendq_len;
+
+	/*
+	 * Wakes the worker up to run the isc_timer timers it owns (see
+	 * isc__netmgr_settimercb()).
+	 */
+	uv_timer_t timers;
+
+	/*
+	 * Accepted TCP DNS connections, the least recently active first,
+	 * to choose from when an idle one needs to be evicted.
+	 */
+	ISC_LIST(isc_nmsocket_t) tcpdns_lru;
+
+#if HAVE_LIBNGHTTP2
+	/* Cached responses to DoH GET requests (see http.c) */
+	struct isc__nm_http_getcache *http_getcache;
+#endif /* HAVE_LIBNGHTTP2 */
+
+	int cpu; /* CPU the thread is pinned to, or -1 */
 } isc__networker_t;
 
 /*
@@ -324,6 +386,7 @@ typedef enum isc__netievent_type {
 	netievent_shutdown,
 	netievent_stop,
 	netievent_pause,
+	netievent_timers,
 
 	netievent_connectcb,
 	netievent_readcb,
@@ -331,6 +394,7 @@ typedef enum isc__netievent_type {
 
 	netievent_task,
 	netievent_privilegedtask,
+	netievent_backgroundtask,
 
 	netievent_settlsctx,
 
@@ -606,6 +670,7 @@ typedef struct isc__netievent__task {
 	isc__netievent_type type;
 	ISC_LINK(isc__netievent_t) link;
 	isc_task_t *task;
+	bool stealable; /* may be run by any worker */
 } isc__netievent__task_t;
 
 #define NETIEVENT_TASK_TYPE(type) \
@@ -623,6 +688,7 @@ typedef struct isc__netievent__task {
 		isc__netievent_##type##_t *ievent =                            \
 			isc__nm_get_netievent(nm, netievent_##type);           \
 		ievent->task = task;                                           \
+		ievent->stealable = false;                                     \
                                                                                \
 		return (ievent);                                               \
 	}                                                                      \
@@ -785,8 +851,13 @@ struct isc_nm {
 	uint_fast32_t workers_running;
 	atomic_uint_fast32_t workers_paused;
 	atomic_uint_fast32_t maxudp;
+	atomic_uint_fast32_t udpsendbatch;
+	atomic_uint_fast32_t tcpsendbatch;
+	atomic_uint_fast32_t http_getcache_ttl;
+	atomic_bool tcp_evict_idle;
 
 	bool load_balance_sockets;
+	bool cpu_affinity;
 
 	atomic_bool paused;
 
@@ -819,6 +890,13 @@ struct isc_nm {
 	isc_barrier_t pausing;
 	isc_barrier_t resuming;
 
+	/*
+	 * Runs the isc_timer timers owned by a worker; only changed
+	 * while the workers are paused.
+	 */
+	uint64_t (*timer_cb)(void *, int);
+	void *timer_cbarg;
+
 	/*
 	 * Socket SO_RCVBUF and SO_SNDBUF values
 	 */
@@ -854,7 +932,11 @@ typedef enum {
 	STATID_SENDFAIL = 8,
 	STATID_RECVFAIL = 9,
 	STATID_ACTIVE = 10,
-	STATID_MAX = 11,
+	STATID_SENDBATCH = 11,
+	STATID_SENDBATCHMSG = 12,
+	STATID_TLSHANDSHAKE = 13,
+	STATID_TLSRESUMED = 14,
+	STATID_MAX = 15,
 } isc__nm_statid_t;
 
 #if HAVE_LIBNGHTTP2
@@ -915,6 +997,7 @@ typedef struct isc_nmsocket_h2 {
 
 	isc_buffer_t rbuf;
 	isc_buffer_t wbuf;
+	void *cached_response; /* see server_send_cached_response() */
 
 	int32_t stream_id;
 	isc_nm_http_session_t *session;
@@ -1044,6 +1127,14 @@ struct isc_nmsocket {
 	isc_quota_t *pquota;
 	isc_quota_cb_t quotacb;
 
+	/*%
+	 * Link in the worker's LRU list of the accepted TCP DNS
+	 * connections, and the time (in nanoseconds) the connection was
+	 * accepted at until the first data arrives on it.
+	 */
+	ISC_LINK(isc_nmsocket_t) lru_link;
+	uint64_t accept_time;
+
 	/*%
 	 * Socket statistics
 	 */
@@ -1070,6 +1161,8 @@ struct isc_nmsocket {
 	/*% Child sockets for multi-socket setups */
 	isc_nmsocket_t *children;
 	uint_fast32_t nchildren;
+	/*% Position of this child socket in its SO_REUSEPORT group */
+	uint_fast32_t lbindex;
 	isc_sockaddr_t iface;
 	isc_nmhandle_t *statichandle;
 	isc_nmhandle_t *outerhandle;
@@ -1199,6 +1292,7 @@ struct isc_nmsocket {
 	/*% Buffer for TCPDNS processing */
 	size_t buf_size;
 	size_t buf_len;
+	size_t buf_off; /* Start of the unprocessed data in 'buf' */
 	unsigned char *buf;
 
 	/*%
@@ -1418,6 +1512,13 @@ isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
  * Back-end implementation of isc_nm_send() for UDP handles.
  */
 
+void
+isc__nm_udp_flush(isc__networker_t *worker);
+/*%<
+ * Send all UDP messages queued on 'worker', batching the messages
+ * for the same socket into as few sendmmsg(2) calls as possible.
+ */
+
 void
 isc__nm_udp_read(isc_nmhandle_t *handle, isc_nm_recv_cb_t cb, void *cbarg);
 /*
@@ -1593,6 +1694,13 @@ isc__nm_tcpdns_send(isc_nmhandle_t *handle, isc_region_t *region,
  * Back-end implementation of isc_nm_send() for TCPDNS handles.
  */
 
+void
+isc__nm_tcpdns_flush(isc__networker_t *worker);
+/*%<
+ * Send all TCPDNS messages queued on 'worker', writing the messages
+ * for the same socket with as few writev(2) calls as possible.
+ */
+
 void
 isc__nm_tcpdns_shutdown(isc_nmsocket_t *sock);
 
@@ -1892,6 +2000,12 @@ void
 isc__nm_http_set_max_streams(isc_nmsocket_t *listener,
 			     const uint32_t max_concurrent_streams);
 
+void
+isc__nm_http_getcache_destroy(isc__networker_t *worker);
+/*%<
+ * Free the DoH GET response cache of the network thread 'worker'.
+ */
+
 #endif
 
 void
@@ -1942,6 +2056,12 @@ isc__nm_decstats(isc_nmsocket_t *sock, isc__nm_statid_t id);
  * Decrement socket-related statistics counters.
  */
 
+void
+isc__nm_addstats(isc_nmsocket_t *sock, isc__nm_statid_t id, uint64_t value);
+/*%<
+ * Add 'value' to socket-related statistics counters.
+ */
+
 isc_result_t
 isc__nm_socket(int domain, int type, int protocol, uv_os_sock_t *sockp);
 /*%<
@@ -1978,6 +2098,15 @@ isc__nm_socket_incoming_cpu(uv_os_sock_t fd);
  * Set the SO_INCOMING_CPU socket option on the fd if available
  */
 
+isc_result_t
+isc__nm_socket_reuseport_cpu(uv_os_sock_t fd, const int *cpus, size_t ncpus);
+/*%<
+ * Attach a SO_ATTACH_REUSEPORT_CBPF program to the SO_REUSEPORT group
+ * of 'fd' that steers each packet to the socket at index 'i' of the
+ * group when it was received on CPU 'cpus[i]'; packets received on other
+ * CPUs are distributed by the kernel's hash as usual.
+ */
+
 isc_result_t
 isc__nm_socket_disable_pmtud(uv_os_sock_t fd, sa_family_t sa_family);
 /*%<
@@ -2112,9 +2241,11 @@ NETIEVENT_TYPE(pause);
 NETIEVENT_TYPE(resume);
 NETIEVENT_TYPE(shutdown);
 NETIEVENT_TYPE(stop);
+NETIEVENT_TYPE(timers);
 
 NETIEVENT_TASK_TYPE(task);
 NETIEVENT_TASK_TYPE(privilegedtask);
+NETIEVENT_TASK_TYPE(backgroundtask);
 
 NETIEVENT_SOCKET_TLSCTX_TYPE(settlsctx);
 NETIEVENT_SOCKET_TYPE(sockstop);
@@ -2185,9 +2316,11 @@ NETIEVENT_DECL(pause);
 NETIEVENT_DECL(resume);
 NETIEVENT_DECL(shutdown);
 NETIEVENT_DECL(stop);
+NETIEVENT_DECL(timers);
 
 NETIEVENT_TASK_DECL(task);
 NETIEVENT_TASK_DECL(privilegedtask);
+NETIEVENT_TASK_DECL(backgroundtask);
 
 NETIEVENT_SOCKET_TLSCTX_DECL(settlsctx);
 NETIEVENT_SOCKET_DECL(sockstop);
@@ -2270,3 +2403,10 @@ isc__nmsocket_writetimeout_cb(void *data, isc_result_t eresult);
 
 void
 isc__nmsocket_log_tls_session_reuse(isc_nmsocket_t *sock, isc_tls_t *tls);
+
+void
+isc__nmsocket_tls_handshake_stats(isc_nmsocket_t *sock, isc_tls_t *tls);
+/*%<
+ * Account for a completed server side TLS handshake in the statistics of
+ * the TCP socket 'sock', and whether the session was resumed.
+ */
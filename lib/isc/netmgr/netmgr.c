@@ -15,6 +15,14 @@
 #include <unistd.h>
 #include <uv.h>
 
+#if defined(HAVE_SCHED_H)
+#include <sched.h>
+#endif /* if defined(HAVE_SCHED_H) */
+
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif /* if defined(__linux__) */
+
 #include <isc/atomic.h>
 #include <isc/backtrace.h>
 #include <isc/barrier.h>
@@ -27,6 +35,7 @@
 #include <isc/mem.h>
 #include <isc/netmgr.h>
 #include <isc/print.h>
+#include <isc/profile.h>
 #include <isc/quota.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
@@ -67,7 +76,11 @@ static const isc_statscounter_t udp4statsindex[] = {
 	-1,
 	isc_sockstatscounter_udp4sendfail,
 	isc_sockstatscounter_udp4recvfail,
-	isc_sockstatscounter_udp4active
+	isc_sockstatscounter_udp4active,
+	isc_sockstatscounter_udp4sendbatch,
+	isc_sockstatscounter_udp4sendbatchmsg,
+	-1,
+	-1
 };
 
 static const isc_statscounter_t udp6statsindex[] = {
@@ -81,7 +94,11 @@ static const isc_statscounter_t udp6statsindex[] = {
 	-1,
 	isc_sockstatscounter_udp6sendfail,
 	isc_sockstatscounter_udp6recvfail,
-	isc_sockstatscounter_udp6active
+	isc_sockstatscounter_udp6active,
+	isc_sockstatscounter_udp6sendbatch,
+	isc_sockstatscounter_udp6sendbatchmsg,
+	-1,
+	-1
 };
 
 static const isc_statscounter_t tcp4statsindex[] = {
@@ -90,7 +107,11 @@ static const isc_statscounter_t tcp4statsindex[] = {
 	isc_sockstatscounter_tcp4connectfail, isc_sockstatscounter_tcp4connect,
 	isc_sockstatscounter_tcp4acceptfail,  isc_sockstatscounter_tcp4accept,
 	isc_sockstatscounter_tcp4sendfail,    isc_sockstatscounter_tcp4recvfail,
-	isc_sockstatscounter_tcp4active
+	isc_sockstatscounter_tcp4active,
+	isc_sockstatscounter_tcp4sendbatch,
+	isc_sockstatscounter_tcp4sendbatchmsg,
+	isc_sockstatscounter_tcp4tlshandshake,
+	isc_sockstatscounter_tcp4tlsresumed
 };
 
 static const isc_statscounter_t tcp6statsindex[] = {
@@ -99,7 +120,11 @@ static const isc_statscounter_t tcp6statsindex[] = {
 	isc_sockstatscounter_tcp6connectfail, isc_sockstatscounter_tcp6connect,
 	isc_sockstatscounter_tcp6acceptfail,  isc_sockstatscounter_tcp6accept,
 	isc_sockstatscounter_tcp6sendfail,    isc_sockstatscounter_tcp6recvfail,
-	isc_sockstatscounter_tcp6active
+	isc_sockstatscounter_tcp6active,
+	isc_sockstatscounter_tcp6sendbatch,
+	isc_sockstatscounter_tcp6sendbatchmsg,
+	isc_sockstatscounter_tcp6tlshandshake,
+	isc_sockstatscounter_tcp6tlsresumed
 };
 
 #if 0
@@ -115,7 +140,11 @@ static const isc_statscounter_t unixstatsindex[] = {
 	isc_sockstatscounter_unixaccept,
 	isc_sockstatscounter_unixsendfail,
 	isc_sockstatscounter_unixrecvfail,
-	isc_sockstatscounter_unixactive
+	isc_sockstatscounter_unixactive,
+	-1,
+	-1,
+	-1,
+	-1
 };
 #endif /* if 0 */
 
@@ -158,6 +187,8 @@ static void
 isc__nm_async_detach(isc__networker_t *worker, isc__netievent_t *ev0);
 static void
 isc__nm_async_close(isc__networker_t *worker, isc__netievent_t *ev0);
+static void
+isc__nm_async_timers(isc__networker_t *worker, isc__netievent_t *ev0);
 
 static void
 isc__nm_threadpool_initialize(uint32_t workers);
@@ -245,6 +276,10 @@ isc__netmgr_create(isc_mem_t *mctx, uint32_t workers, isc_nm_t **netmgrp) {
 	isc_condition_init(&mgr->wkpausecond);
 	isc_refcount_init(&mgr->references, 1);
 	atomic_init(&mgr->maxudp, 0);
+	atomic_init(&mgr->udpsendbatch, 0);
+	atomic_init(&mgr->tcpsendbatch, 0);
+	atomic_init(&mgr->http_getcache_ttl, 0);
+	atomic_init(&mgr->tcp_evict_idle, false);
 	atomic_init(&mgr->interlocked, ISC_NETMGR_NON_INTERLOCKED);
 	atomic_init(&mgr->workers_paused, 0);
 	atomic_init(&mgr->paused, false);
@@ -283,6 +318,7 @@ isc__netmgr_create(isc_mem_t *mctx, uint32_t workers, isc_nm_t **netmgrp) {
 		*worker = (isc__networker_t){
 			.mgr = mgr,
 			.id = i,
+			.cpu = -1,
 		};
 
 		r = uv_loop_init(&worker->loop);
@@ -293,11 +329,25 @@ isc__netmgr_create(isc_mem_t *mctx, uint32_t workers, isc_nm_t **netmgrp) {
 		r = uv_async_init(&worker->loop, &worker->async, async_cb);
 		UV_RUNTIME_CHECK(uv_async_init, r);
 
+		r = uv_check_init(&worker->loop, &worker->udpsend_check);
+		UV_RUNTIME_CHECK(uv_check_init, r);
+
+		r = uv_check_init(&worker->loop, &worker->tcpsend_check);
+		UV_RUNTIME_CHECK(uv_check_init, r);
+
+		r = uv_timer_init(&worker->loop, &worker->timers);
+		UV_RUNTIME_CHECK(uv_timer_init, r);
+		uv_handle_set_data((uv_handle_t *)&worker->timers, worker);
+
 		for (size_t type = 0; type < NETIEVENT_MAX; type++) {
 			isc_mutex_init(&worker->ievents[type].lock);
 			isc_condition_init(&worker->ievents[type].cond);
 			ISC_LIST_INIT(worker->ievents[type].list);
+			atomic_init(&worker->ievents[type].depth, 0);
 		}
+		atomic_init(&worker->stolen, 0);
+
+		ISC_LIST_INIT(worker->tcpdns_lru);
 
 		worker->recvbuf = isc_mem_get(mctx, ISC_NETMGR_RECVBUF_SIZE);
 		worker->sendbuf = isc_mem_get(mctx, ISC_NETMGR_SENDBUF_SIZE);
@@ -358,6 +408,10 @@ nm_destroy(isc_nm_t **mgr0) {
 			isc_mutex_destroy(&worker->ievents[type].lock);
 		}
 
+#if HAVE_LIBNGHTTP2
+		isc__nm_http_getcache_destroy(worker);
+#endif /* HAVE_LIBNGHTTP2 */
+
 		isc_mem_put(mgr->mctx, worker->sendbuf,
 			    ISC_NETMGR_SENDBUF_SIZE);
 		isc_mem_put(mgr->mctx, worker->recvbuf,
@@ -568,6 +622,56 @@ isc_nm_maxudp(isc_nm_t *mgr, uint32_t maxudp) {
 	atomic_store(&mgr->maxudp, maxudp);
 }
 
+void
+isc_nm_setudpsendbatch(isc_nm_t *mgr, uint32_t depth) {
+	REQUIRE(VALID_NM(mgr));
+
+	if (depth > ISC_NETMGR_UDP_SENDBATCH_MAX) {
+		depth = ISC_NETMGR_UDP_SENDBATCH_MAX;
+	}
+
+	atomic_store(&mgr->udpsendbatch, depth);
+}
+
+uint32_t
+isc_nm_getudpsendbatch(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (atomic_load(&mgr->udpsendbatch));
+}
+
+void
+isc_nm_settcpsendbatch(isc_nm_t *mgr, uint32_t depth) {
+	REQUIRE(VALID_NM(mgr));
+
+	if (depth > ISC_NETMGR_TCP_SENDBATCH_MAX) {
+		depth = ISC_NETMGR_TCP_SENDBATCH_MAX;
+	}
+
+	atomic_store(&mgr->tcpsendbatch, depth);
+}
+
+uint32_t
+isc_nm_gettcpsendbatch(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (atomic_load(&mgr->tcpsendbatch));
+}
+
+void
+isc_nm_settcpevictidle(isc_nm_t *mgr, bool evict) {
+	REQUIRE(VALID_NM(mgr));
+
+	atomic_store(&mgr->tcp_evict_idle, evict);
+}
+
+bool
+isc_nm_gettcpevictidle(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (atomic_load(&mgr->tcp_evict_idle));
+}
+
 void
 isc_nmhandle_setwritetimeout(isc_nmhandle_t *handle, uint64_t write_timeout) {
 	REQUIRE(VALID_NMHANDLE(handle));
@@ -614,6 +718,92 @@ isc_nm_setnetbuffers(isc_nm_t *mgr, int32_t recv_tcp, int32_t send_tcp,
 	atomic_store(&mgr->send_udp_buffer_size, send_udp);
 }
 
+static void
+run_timers(isc__networker_t *worker);
+
+static void
+timers_cb(uv_timer_t *handle) {
+	run_timers(uv_handle_get_data((uv_handle_t *)handle));
+}
+
+/*
+ * Run the expired timers of this worker and sleep until the next one
+ * is due.
+ */
+static void
+run_timers(isc__networker_t *worker) {
+	isc_nm_t *mgr = worker->mgr;
+	uint64_t timeout = UINT64_MAX;
+	int r;
+
+	REQUIRE(worker->id == isc_nm_tid());
+
+	if (worker->finished) {
+		return;
+	}
+
+	if (mgr->timer_cb != NULL) {
+		timeout = mgr->timer_cb(mgr->timer_cbarg, worker->id);
+	}
+
+	if (timeout == UINT64_MAX) {
+		r = uv_timer_stop(&worker->timers);
+		UV_RUNTIME_CHECK(uv_timer_stop, r);
+		return;
+	}
+
+	uv_update_time(&worker->loop);
+	r = uv_timer_start(&worker->timers, timers_cb, timeout, 0);
+	UV_RUNTIME_CHECK(uv_timer_start, r);
+}
+
+static void
+isc__nm_async_timers(isc__networker_t *worker, isc__netievent_t *ev0) {
+	UNUSED(ev0);
+
+	run_timers(worker);
+}
+
+void
+isc__netmgr_settimercb(isc_nm_t *mgr, isc__netmgr_timer_cb cb,
+		       void *cbarg) {
+	REQUIRE(VALID_NM(mgr));
+
+	/*
+	 * With the workers paused, none of them can be running the
+	 * old callback.
+	 */
+	isc_nm_pause(mgr);
+	mgr->timer_cb = cb;
+	mgr->timer_cbarg = cbarg;
+	isc_nm_resume(mgr);
+}
+
+void
+isc__netmgr_poketimers(isc_nm_t *mgr, int tid) {
+	isc__networker_t *worker = NULL;
+
+	REQUIRE(VALID_NM(mgr));
+	REQUIRE(tid >= 0 && tid < mgr->nworkers);
+
+	worker = &mgr->workers[tid];
+
+	if (isc_nm_tid() == tid) {
+		run_timers(worker);
+	} else {
+		isc__netievent_timers_t *event =
+			isc__nm_get_netievent_timers(mgr);
+		isc__nm_enqueue_ievent(worker, (isc__netievent_t *)event);
+	}
+}
+
+unsigned int
+isc_nm_getnworkers(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return ((unsigned int)mgr->nworkers);
+}
+
 bool
 isc_nm_getloadbalancesockets(isc_nm_t *mgr) {
 	REQUIRE(VALID_NM(mgr));
@@ -632,6 +822,59 @@ isc_nm_setloadbalancesockets(isc_nm_t *mgr, bool enabled) {
 #endif
 }
 
+bool
+isc_nm_getcpuaffinity(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (mgr->cpu_affinity);
+}
+
+isc_result_t
+isc_nm_setcpuaffinity(isc_nm_t *mgr) {
+#if defined(HAVE_SCHED_GETAFFINITY) && defined(CPU_SET)
+	cpu_set_t set;
+	int cpus[CPU_SETSIZE];
+	int ncpus = 0;
+
+	REQUIRE(VALID_NM(mgr));
+
+	/*
+	 * Spread the workers over the CPUs we are allowed to run on,
+	 * in order, wrapping around if there are more workers than CPUs.
+	 */
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+		return (ISC_R_FAILURE);
+	}
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &set)) {
+			cpus[ncpus++] = cpu;
+		}
+	}
+	INSIST(ncpus > 0);
+
+	for (int i = 0; i < mgr->nworkers; i++) {
+		isc__networker_t *worker = &mgr->workers[i];
+		int cpu = cpus[i % ncpus];
+		isc_result_t result;
+
+		result = isc_thread_setaffinity(worker->thread, cpu);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+		worker->cpu = cpu;
+	}
+
+	mgr->cpu_affinity = true;
+
+	return (ISC_R_SUCCESS);
+#else
+	REQUIRE(VALID_NM(mgr));
+
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
 void
 isc_nm_gettimeouts(isc_nm_t *mgr, uint32_t *initial, uint32_t *idle,
 		   uint32_t *keepalive, uint32_t *advertised) {
@@ -658,7 +901,7 @@ isc_nm_gettimeouts(isc_nm_t *mgr, uint32_t *initial, uint32_t *idle,
  * nm_thread is a single worker thread, that runs uv_run event loop
  * until asked to stop.
  *
- * There are four queues for asynchronous events:
+ * There are five queues for asynchronous events:
  *
  * 1. priority queue - netievents on the priority queue are run even when
  *    the taskmgr enters exclusive mode and the netmgr is paused.  This
@@ -669,16 +912,21 @@ isc_nm_gettimeouts(isc_nm_t *mgr, uint32_t *initial, uint32_t *idle,
  *    this is the first queue that gets processed when network manager
  *    is unpaused using isc_nm_resume().  All netmgr workers need to
  *    clean the privileged task queue before they all proceed to normal
- *    operation.  Both task queues are processed when the workers are
+ *    operation.  All task queues are processed when the workers are
  *    shutting down.
  *
  * 3. task queue - only (traditional) tasks are scheduled here, and this
  *    queue and the privileged task queue are both processed when the
  *    netmgr workers are finishing.  This is needed to process the task
- *    shutdown events.
+ *    shutdown events.  A worker with an empty task queue takes over
+ *    some of the events for unbound tasks from a busier worker.
  *
  * 4. normal queue - this is the queue with netmgr events, e.g. reading,
  *    sending, callbacks, etc.
+ *
+ * 5. background task queue - like the task queue, but for tasks with
+ *    the background flag set (see isc_task_setbackground()); it is
+ *    processed last.
  */
 
 static isc_threadresult_t
@@ -698,6 +946,12 @@ nm_thread(isc_threadarg_t worker0) {
 		int r = uv_run(&worker->loop, UV_RUN_DEFAULT);
 		INSIST(r > 0 || worker->finished);
 
+		/*
+		 * Don't hold the queued UDP and TCP messages while paused.
+		 */
+		isc__nm_udp_flush(worker);
+		isc__nm_tcpdns_flush(worker);
+
 		if (worker->paused) {
 			INSIST(atomic_load(&mgr->interlocked) != isc_nm_tid());
 
@@ -739,6 +993,7 @@ nm_thread(isc_threadarg_t worker0) {
 	 */
 	drain_queue(worker, NETIEVENT_PRIVILEGED);
 	drain_queue(worker, NETIEVENT_TASK);
+	drain_queue(worker, NETIEVENT_BACKGROUND);
 
 	for (size_t type = 0; type < NETIEVENT_MAX; type++) {
 		LOCK(&worker->ievents[type].lock);
@@ -808,6 +1063,12 @@ isc__nm_async_stop(isc__networker_t *worker, isc__netievent_t *ev0) {
 	worker->finished = true;
 	/* Close the async handler */
 	uv_close((uv_handle_t *)&worker->async, NULL);
+	/* Send out whatever is left in the UDP and TCP queues */
+	isc__nm_udp_flush(worker);
+	uv_close((uv_handle_t *)&worker->udpsend_check, NULL);
+	isc__nm_tcpdns_flush(worker);
+	uv_close((uv_handle_t *)&worker->tcpsend_check, NULL);
+	uv_close((uv_handle_t *)&worker->timers, NULL);
 }
 
 void
@@ -828,16 +1089,51 @@ isc_nm_task_enqueue(isc_nm_t *nm, isc_task_t *task, int threadid) {
 		event = (isc__netievent_t *)
 			isc__nm_get_netievent_privilegedtask(nm, task);
 	} else {
-		event = (isc__netievent_t *)isc__nm_get_netievent_task(nm,
-								       task);
+		isc__netievent_task_t *ievent = NULL;
+
+		if (isc_task_getbackground(task)) {
+			ievent = isc__nm_get_netievent_backgroundtask(nm, task);
+		} else {
+			ievent = isc__nm_get_netievent_task(nm, task);
+		}
+		/*
+		 * Unbound tasks may be run by whichever worker gets to
+		 * them first.
+		 */
+		ievent->stealable = (threadid == -1);
+		event = (isc__netievent_t *)ievent;
 	}
 
 	isc__nm_enqueue_ievent(worker, event);
 }
 
+void
+isc_nm_taskstats(isc_nm_t *nm, int tid, uint32_t *queuedp,
+		 uint64_t *stolenp) {
+	isc__networker_t *worker = NULL;
+
+	REQUIRE(VALID_NM(nm));
+	REQUIRE(tid >= 0 && tid < nm->nworkers);
+
+	worker = &nm->workers[tid];
+
+	if (queuedp != NULL) {
+		*queuedp = atomic_load_relaxed(
+				   &worker->ievents[NETIEVENT_TASK].depth) +
+			   atomic_load_relaxed(
+				   &worker->ievents[NETIEVENT_BACKGROUND].depth);
+	}
+	if (stolenp != NULL) {
+		*stolenp = atomic_load_relaxed(&worker->stolen);
+	}
+}
+
 #define isc__nm_async_privilegedtask(worker, ev0) \
 	isc__nm_async_task(worker, ev0)
 
+#define isc__nm_async_backgroundtask(worker, ev0) \
+	isc__nm_async_task(worker, ev0)
+
 static void
 isc__nm_async_task(isc__networker_t *worker, isc__netievent_t *ev0) {
 	isc__netievent_task_t *ievent = (isc__netievent_task_t *)ev0;
@@ -917,6 +1213,7 @@ process_netievent(isc__networker_t *worker, isc__netievent_t *ievent) {
 		NETIEVENT_CASE_NOMORE(stop);
 
 		NETIEVENT_CASE(privilegedtask);
+		NETIEVENT_CASE(backgroundtask);
 		NETIEVENT_CASE(task);
 
 		NETIEVENT_CASE(udpconnect);
@@ -982,6 +1279,7 @@ process_netievent(isc__networker_t *worker, isc__netievent_t *ievent) {
 
 		NETIEVENT_CASE(shutdown);
 		NETIEVENT_CASE(resume);
+		NETIEVENT_CASE(timers);
 		NETIEVENT_CASE_NOMORE(pause);
 	default:
 		UNREACHABLE();
@@ -989,11 +1287,120 @@ process_netievent(isc__networker_t *worker, isc__netievent_t *ievent) {
 	return (true);
 }
 
+/*
+ * Take up to half of the events for unbound tasks waiting in the 'type'
+ * queue of the first other worker that has a backlog, and move them to
+ * 'list' in their queue order.  The events are taken from the tail of
+ * the queue, which the owner would get to last.  Returns the number of
+ * events taken.
+ */
+static uint_fast32_t
+steal_tasks(isc__networker_t *worker, netievent_type_t type,
+	    isc__netievent_list_t *list) {
+	isc_nm_t *mgr = worker->mgr;
+
+	for (int i = 1; i < mgr->nworkers; i++) {
+		isc__networker_t *victim =
+			&mgr->workers[(worker->id + i) % mgr->nworkers];
+		ievent_t *queue = &victim->ievents[type];
+		isc__netievent_t *ievent = NULL, *prev = NULL;
+		uint_fast32_t want, taken = 0;
+
+		/*
+		 * A single waiting event will be run by its owner soon
+		 * enough; moving it to another thread costs more than it
+		 * saves.
+		 */
+		want = atomic_load_relaxed(&queue->depth) / 2;
+		if (want == 0) {
+			continue;
+		}
+
+		if (isc_mutex_trylock(&queue->lock) != ISC_R_SUCCESS) {
+			continue;
+		}
+		for (ievent = ISC_LIST_TAIL(queue->list);
+		     ievent != NULL && taken < want; ievent = prev)
+		{
+			prev = ISC_LIST_PREV(ievent, link);
+			if (!((isc__netievent_task_t *)ievent)->stealable) {
+				continue;
+			}
+			ISC_LIST_DEQUEUE(queue->list, ievent, link);
+			ISC_LIST_PREPEND(*list, ievent, link);
+			taken++;
+		}
+		if (taken > 0) {
+			atomic_fetch_sub_release(&queue->depth, taken);
+		}
+		UNLOCK(&queue->lock);
+
+		if (taken > 0) {
+			atomic_fetch_add_relaxed(&worker->stolen, taken);
+			return (taken);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * The task queues are processed one event at a time, so that the events
+ * still waiting can be stolen by idle workers while this one runs a long
+ * task.  Only the events queued on entry are processed, since tasks that
+ * used up their quantum are queued again.  When the queue is empty, help
+ * the other workers instead.
+ */
+static isc_result_t
+process_task_queue(isc__networker_t *worker, netievent_type_t type) {
+	ievent_t *queue = &worker->ievents[type];
+	isc__netievent_t *ievent = NULL;
+	isc__netievent_list_t list;
+	uint_fast32_t n;
+
+	n = atomic_load_acquire(&queue->depth);
+	if (n == 0) {
+		ISC_LIST_INIT(list);
+		if (worker->finished || steal_tasks(worker, type, &list) == 0)
+		{
+			return (ISC_R_EMPTY);
+		}
+		while ((ievent = ISC_LIST_HEAD(list)) != NULL) {
+			ISC_LIST_DEQUEUE(list, ievent, link);
+			(void)process_netievent(worker, ievent);
+		}
+		return (ISC_R_SUCCESS);
+	}
+
+	for (; n > 0; n--) {
+		LOCK(&queue->lock);
+		ievent = ISC_LIST_HEAD(queue->list);
+		if (ievent != NULL) {
+			ISC_LIST_DEQUEUE(queue->list, ievent, link);
+			atomic_fetch_sub_release(&queue->depth, 1);
+		}
+		UNLOCK(&queue->lock);
+
+		if (ievent == NULL) {
+			/* Stolen by another worker */
+			break;
+		}
+
+		(void)process_netievent(worker, ievent);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 process_queue(isc__networker_t *worker, netievent_type_t type) {
 	isc__netievent_t *ievent = NULL;
 	isc__netievent_list_t list;
 
+	if (NETIEVENT_TASKQUEUE(type)) {
+		return (process_task_queue(worker, type));
+	}
+
 	ISC_LIST_INIT(list);
 
 	LOCK(&worker->ievents[type].lock);
@@ -1008,9 +1415,15 @@ process_queue(isc__networker_t *worker, netievent_type_t type) {
 
 	while (ievent != NULL) {
 		isc__netievent_t *next = ISC_LIST_NEXT(ievent, link);
+		bool more;
+
 		ISC_LIST_DEQUEUE(list, ievent, link);
 
-		if (!process_netievent(worker, ievent)) {
+		isc_profile_enter(isc_profile_netmgr);
+		more = process_netievent(worker, ievent);
+		isc_profile_leave(isc_profile_netmgr);
+
+		if (!more) {
 			/* The netievent told us to stop */
 			if (!ISC_LIST_EMPTY(list)) {
 				/*
@@ -1109,9 +1522,11 @@ NETIEVENT_DEF(pause);
 NETIEVENT_DEF(resume);
 NETIEVENT_DEF(shutdown);
 NETIEVENT_DEF(stop);
+NETIEVENT_DEF(timers);
 
 NETIEVENT_TASK_DEF(task);
 NETIEVENT_TASK_DEF(privilegedtask);
+NETIEVENT_TASK_DEF(backgroundtask);
 
 NETIEVENT_SOCKET_TLSCTX_DEF(settlsctx);
 NETIEVENT_SOCKET_DEF(sockstop);
@@ -1148,6 +1563,9 @@ isc__nm_enqueue_ievent(isc__networker_t *worker, isc__netievent_t *event) {
 		case netievent_task:
 			type = NETIEVENT_TASK;
 			break;
+		case netievent_backgroundtask:
+			type = NETIEVENT_BACKGROUND;
+			break;
 		default:
 			type = NETIEVENT_NORMAL;
 			break;
@@ -1160,6 +1578,9 @@ isc__nm_enqueue_ievent(isc__networker_t *worker, isc__netievent_t *event) {
 	 */
 	LOCK(&worker->ievents[type].lock);
 	ISC_LIST_ENQUEUE(worker->ievents[type].list, event, link);
+	if (NETIEVENT_TASKQUEUE(type)) {
+		atomic_fetch_add_release(&worker->ievents[type].depth, 1);
+	}
 	if (type == NETIEVENT_PRIORITY) {
 		SIGNAL(&worker->ievents[type].cond);
 	}
@@ -1519,6 +1940,7 @@ isc___nmsocket_init(isc_nmsocket_t *sock, isc_nm_t *mgr, isc_nmsocket_type type,
 	sock->uv_handle.handle.data = sock;
 
 	ISC_LINK_INIT(&sock->quotacb, link);
+	ISC_LINK_INIT(sock, lru_link);
 
 	switch (type) {
 	case isc_nm_udpsocket:
@@ -1952,6 +2374,9 @@ isc__nm_failed_accept_cb(isc_nmsocket_t *sock, isc_result_t eresult) {
 	case ISC_R_NOTCONNECTED:
 		/* IGNORE: The client disconnected before we could accept */
 		break;
+	case ISC_R_QUOTA:
+		/* IGNORE: Refused by the accept callback, which logs it */
+		break;
 	default:
 		isc_log_write(isc_lctx, ISC_LOGCATEGORY_GENERAL,
 			      ISC_LOGMODULE_NETMGR, ISC_LOG_ERROR,
@@ -3139,6 +3564,16 @@ isc__nm_decstats(isc_nmsocket_t *sock, isc__nm_statid_t id) {
 	}
 }
 
+void
+isc__nm_addstats(isc_nmsocket_t *sock, isc__nm_statid_t id, uint64_t value) {
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(id < STATID_MAX);
+
+	if (sock->statsindex != NULL && sock->mgr->stats != NULL) {
+		isc_stats_add(sock->mgr->stats, sock->statsindex[id], value);
+	}
+}
+
 isc_result_t
 isc__nm_socket(int domain, int type, int protocol, uv_os_sock_t *sockp) {
 	int sock = socket(domain, type, protocol);
@@ -3279,6 +3714,51 @@ isc__nm_socket_incoming_cpu(uv_os_sock_t fd) {
 	return (ISC_R_NOTIMPLEMENTED);
 }
 
+isc_result_t
+isc__nm_socket_reuseport_cpu(uv_os_sock_t fd, const int *cpus, size_t ncpus) {
+#if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(SKF_AD_CPU)
+	/*
+	 * Attach a classic BPF program to the reuseport group that 'fd'
+	 * belongs to, returning the index of the socket whose worker is
+	 * pinned to the CPU that received the packet.  An index past the
+	 * end of the group makes the kernel fall back to hashing.
+	 */
+	struct sock_filter code[1 + 2 * ISC_NETMGR_MAXCPUFILTER + 1];
+	struct sock_fprog prog = { .filter = code };
+	size_t n = 0;
+
+	REQUIRE(cpus != NULL);
+
+	if (ncpus > ISC_NETMGR_MAXCPUFILTER) {
+		return (ISC_R_RANGE);
+	}
+
+	code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+						 SKF_AD_OFF + SKF_AD_CPU);
+	for (size_t i = 0; i < ncpus; i++) {
+		code[n++] = (struct sock_filter)BPF_JUMP(
+			BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)cpus[i], 0, 1);
+		code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K,
+							 (uint32_t)i);
+	}
+	code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, UINT32_MAX);
+	prog.len = n;
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+		       sizeof(prog)) == -1)
+	{
+		return (ISC_R_FAILURE);
+	}
+	return (ISC_R_SUCCESS);
+#else
+	UNUSED(fd);
+	UNUSED(cpus);
+	UNUSED(ncpus);
+
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
 isc_result_t
 isc__nm_socket_disable_pmtud(uv_os_sock_t fd, sa_family_t sa_family) {
 	/*
@@ -3871,6 +4351,21 @@ isc__nmsocket_log_tls_session_reuse(isc_nmsocket_t *sock, isc_tls_t *tls) {
 		      client_sabuf, local_sabuf);
 }
 
+void
+isc__nmsocket_tls_handshake_stats(isc_nmsocket_t *sock, isc_tls_t *tls) {
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(tls != NULL);
+
+	if (!SSL_is_server(tls)) {
+		return;
+	}
+
+	isc__nm_incstats(sock, STATID_TLSHANDSHAKE);
+	if (SSL_session_reused(tls)) {
+		isc__nm_incstats(sock, STATID_TLSRESUMED);
+	}
+}
+
 #ifdef NETMGR_TRACE
 /*
  * Dump all active sockets in netmgr. We output to stderr
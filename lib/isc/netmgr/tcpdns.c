@@ -24,14 +24,17 @@
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/netmgr.h>
+#include <isc/profile.h>
 #include <isc/quota.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/sockaddr.h>
+#include <isc/stats.h>
 #include <isc/stdtime.h>
 #include <isc/thread.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include "netmgr-int.h"
@@ -78,6 +81,12 @@ stop_tcpdns_parent(isc_nmsocket_t *sock);
 static void
 stop_tcpdns_child(isc_nmsocket_t *sock);
 
+static void
+tcpdns_evict_idle(isc_nmsocket_t *ssock);
+
+static void
+firstbyte_stats(isc_nmsocket_t *sock);
+
 static isc_result_t
 tcpdns_connect_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
 	isc__networker_t *worker = NULL;
@@ -616,6 +625,14 @@ tcpdns_connection_cb(uv_stream_t *server, int status) {
 					     &ssock->quotacb);
 		if (result == ISC_R_QUOTA) {
 			isc__nm_incstats(ssock, STATID_ACCEPTFAIL);
+			if (atomic_load_relaxed(&ssock->mgr->tcp_evict_idle)) {
+				/*
+				 * The quota released by the evicted
+				 * connection is passed on to the waiting
+				 * listener.
+				 */
+				tcpdns_evict_idle(ssock);
+			}
 			goto done;
 		}
 	}
@@ -764,6 +781,7 @@ isc__nm_async_tcpdnsread(isc__networker_t *worker, isc__netievent_t *ev0) {
 isc_result_t
 isc__nm_tcpdns_processbuffer(isc_nmsocket_t *sock) {
 	size_t len;
+	unsigned char *base = NULL;
 	isc__nm_uvreq_t *req = NULL;
 	isc_nmhandle_t *handle = NULL;
 
@@ -786,7 +804,8 @@ isc__nm_tcpdns_processbuffer(isc_nmsocket_t *sock) {
 	 * Process the first packet from the buffer, leaving
 	 * the rest (if any) for later.
 	 */
-	len = ntohs(*(uint16_t *)sock->buf);
+	base = sock->buf + sock->buf_off;
+	len = (base[0] << 8) | base[1];
 	if (len > sock->buf_len - 2) {
 		return (ISC_R_NOMORE);
 	}
@@ -808,6 +827,12 @@ isc__nm_tcpdns_processbuffer(isc_nmsocket_t *sock) {
 		return (ISC_R_CANCELED);
 	}
 
+	if (ISC_LINK_LINKED(sock, lru_link)) {
+		isc__networker_t *worker = &sock->mgr->workers[sock->tid];
+		ISC_LIST_UNLINK(worker->tcpdns_lru, sock, lru_link);
+		ISC_LIST_APPEND(worker->tcpdns_lru, sock, lru_link);
+	}
+
 	req = isc__nm_get_read_req(sock, NULL);
 	REQUIRE(VALID_UVREQ(req));
 
@@ -822,7 +847,7 @@ isc__nm_tcpdns_processbuffer(isc_nmsocket_t *sock) {
 	 * result is ISC_R_SUCCESS, so we don't need to have
 	 * the buffer on the heap
 	 */
-	req->uvbuf.base = (char *)sock->buf + 2;
+	req->uvbuf.base = (char *)base + 2;
 	req->uvbuf.len = len;
 
 	/*
@@ -839,13 +864,22 @@ isc__nm_tcpdns_processbuffer(isc_nmsocket_t *sock) {
 	 */
 	REQUIRE(sock->processing == false);
 	sock->processing = true;
+	isc_profile_enter(isc_profile_netmgr);
 	isc__nm_readcb(sock, req, ISC_R_SUCCESS);
+	isc_profile_leave(isc_profile_netmgr);
 	sock->processing = false;
 
+	/*
+	 * Don't move the rest of the buffer after every message; when
+	 * a client pipelines many queries in a single segment, they are
+	 * all processed in place and the remainder is moved only once,
+	 * when more data arrives.
+	 */
 	len += 2;
 	sock->buf_len -= len;
-	if (sock->buf_len > 0) {
-		memmove(sock->buf, sock->buf + len, sock->buf_len);
+	sock->buf_off += len;
+	if (sock->buf_len == 0) {
+		sock->buf_off = 0;
 	}
 
 	isc_nmhandle_detach(&handle);
@@ -883,6 +917,10 @@ isc__nm_tcpdns_read_cb(uv_stream_t *stream, ssize_t nread,
 	base = (uint8_t *)buf->base;
 	len = nread;
 
+	if (sock->accept_time != 0) {
+		firstbyte_stats(sock);
+	}
+
 	/*
 	 * FIXME: We can avoid the memmove here if we know we have received full
 	 * packet; e.g. we should be smarter, a.s. there are just few situations
@@ -892,6 +930,10 @@ isc__nm_tcpdns_read_cb(uv_stream_t *stream, ssize_t nread,
 	 * the data could be read directly into sock->buf.
 	 */
 
+	if (sock->buf_off > 0) {
+		memmove(sock->buf, sock->buf + sock->buf_off, sock->buf_len);
+		sock->buf_off = 0;
+	}
 	if (sock->buf_len + len > sock->buf_size) {
 		isc__nm_alloc_dnsbuf(sock, sock->buf_len + len);
 	}
@@ -919,6 +961,64 @@ free:
 	isc__nm_free_uvbuf(sock, buf);
 }
 
+static void
+firstbyte_stats(isc_nmsocket_t *sock) {
+	uint64_t elapsed = (uv_hrtime() - sock->accept_time) / NS_PER_MS;
+	isc_statscounter_t counter;
+
+	sock->accept_time = 0;
+
+	if (sock->mgr->stats == NULL) {
+		return;
+	}
+
+	if (elapsed < 1) {
+		counter = isc_sockstatscounter_tcpfirstbyte1ms;
+	} else if (elapsed < 10) {
+		counter = isc_sockstatscounter_tcpfirstbyte10ms;
+	} else if (elapsed < 100) {
+		counter = isc_sockstatscounter_tcpfirstbyte100ms;
+	} else if (elapsed < 1000) {
+		counter = isc_sockstatscounter_tcpfirstbyte1s;
+	} else {
+		counter = isc_sockstatscounter_tcpfirstbyteslow;
+	}
+
+	isc_stats_increment(sock->mgr->stats, counter);
+}
+
+/*
+ * Close the least recently active connection accepted on this thread
+ * that has no queries in progress, i.e. its only active handle is the
+ * one attached in accept_connection().
+ */
+static void
+tcpdns_evict_idle(isc_nmsocket_t *ssock) {
+	isc__networker_t *worker = &ssock->mgr->workers[ssock->tid];
+	isc_nmsocket_t *sock = NULL;
+
+	for (sock = ISC_LIST_HEAD(worker->tcpdns_lru); sock != NULL;
+	     sock = ISC_LIST_NEXT(sock, lru_link))
+	{
+		if (!isc__nmsocket_closing(sock) && !sock->processing &&
+		    atomic_load(&sock->ah) == 1)
+		{
+			break;
+		}
+	}
+
+	if (sock == NULL) {
+		return;
+	}
+
+	if (ssock->mgr->stats != NULL) {
+		isc_stats_increment(ssock->mgr->stats,
+				    isc_sockstatscounter_tcpidleevicted);
+	}
+
+	isc__nm_tcpdns_failed_read_cb(sock, ISC_R_QUOTA);
+}
+
 static void
 quota_accept_cb(isc_quota_t *quota, void *sock0) {
 	isc_nmsocket_t *sock = (isc_nmsocket_t *)sock0;
@@ -1047,6 +1147,9 @@ accept_connection(isc_nmsocket_t *ssock, isc_quota_t *quota) {
 
 	isc__nm_incstats(csock, STATID_ACCEPT);
 
+	csock->accept_time = uv_hrtime();
+	ISC_LIST_APPEND(worker->tcpdns_lru, csock, lru_link);
+
 	csock->read_timeout = atomic_load(&csock->mgr->init);
 
 	csock->closehandle_cb = isc__nm_resume_processing;
@@ -1148,6 +1251,48 @@ tcpdns_send_cb(uv_write_t *req, int status) {
 	isc__nm_sendcb(sock, uvreq, ISC_R_SUCCESS, false);
 }
 
+/*
+ * Write out the part of the message in 'uvreq' after the first 'sent'
+ * bytes (counting the two bytes of the length prefix) asynchronously.
+ */
+static isc_result_t
+tcpdns_send_queue(isc_nmsocket_t *sock, isc__nm_uvreq_t *uvreq, size_t sent) {
+	int r, nbufs = 2;
+	uv_buf_t bufs[2] = { { .base = uvreq->tcplen, .len = 2 },
+			     { .base = uvreq->uvbuf.base,
+			       .len = uvreq->uvbuf.len } };
+
+	INSIST(sent < bufs[0].len + bufs[1].len);
+
+	if (sent == 1) {
+		/* Partial write of DNSMSG length */
+		bufs[0].base = uvreq->tcplen + 1;
+		bufs[0].len = 1;
+	} else if (sent > 0) {
+		/* Partial write of DNSMSG */
+		nbufs = 1;
+		bufs[0].base = uvreq->uvbuf.base + (sent - 2);
+		bufs[0].len = uvreq->uvbuf.len - (sent - 2);
+	}
+
+	r = uv_write(&uvreq->uv_req.write, &sock->uv_handle.stream, bufs, nbufs,
+		     tcpdns_send_cb);
+	if (r < 0) {
+		return (isc__nm_uverr2result(r));
+	}
+
+	isc_nm_timer_create(uvreq->handle, isc__nmsocket_writetimeout_cb, uvreq,
+			    &uvreq->timer);
+	if (sock->write_timeout > 0) {
+		isc_nm_timer_start(uvreq->timer, sock->write_timeout);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static bool
+tcpdns_send_enqueue(isc_nmsocket_t *sock, isc__nm_uvreq_t *uvreq);
+
 /*
  * Handle 'tcpsend' async event - send a packet on the socket
  */
@@ -1158,7 +1303,7 @@ isc__nm_async_tcpdnssend(isc__networker_t *worker, isc__netievent_t *ev0) {
 		(isc__netievent_tcpdnssend_t *)ev0;
 	isc_nmsocket_t *sock = NULL;
 	isc__nm_uvreq_t *uvreq = NULL;
-	int r, nbufs = 2;
+	int r;
 
 	UNUSED(worker);
 
@@ -1186,7 +1331,11 @@ isc__nm_async_tcpdnssend(isc__networker_t *worker, isc__netievent_t *ev0) {
 		goto fail;
 	}
 
-	r = uv_try_write(&sock->uv_handle.stream, bufs, nbufs);
+	if (tcpdns_send_enqueue(sock, uvreq)) {
+		return;
+	}
+
+	r = uv_try_write(&sock->uv_handle.stream, bufs, 2);
 
 	if (r == (int)(bufs[0].len + bufs[1].len)) {
 		/* Wrote everything */
@@ -1194,40 +1343,170 @@ isc__nm_async_tcpdnssend(isc__networker_t *worker, isc__netievent_t *ev0) {
 		return;
 	}
 
-	if (r == 1) {
-		/* Partial write of DNSMSG length */
-		bufs[0].base = uvreq->tcplen + 1;
-		bufs[0].len = 1;
-	} else if (r > 0) {
-		/* Partial write of DNSMSG */
-		nbufs = 1;
-		bufs[0].base = uvreq->uvbuf.base + (r - 2);
-		bufs[0].len = uvreq->uvbuf.len - (r - 2);
-	} else if (r == UV_ENOSYS || r == UV_EAGAIN) {
+	if (r == UV_ENOSYS || r == UV_EAGAIN) {
 		/* uv_try_write not supported, send asynchronously */
-	} else {
+		r = 0;
+	} else if (r < 0) {
 		/* error sending data */
 		result = isc__nm_uverr2result(r);
 		goto fail;
 	}
 
-	r = uv_write(&uvreq->uv_req.write, &sock->uv_handle.stream, bufs, nbufs,
-		     tcpdns_send_cb);
-	if (r < 0) {
+	result = tcpdns_send_queue(sock, uvreq, r);
+	if (result != ISC_R_SUCCESS) {
+		goto fail;
+	}
+
+	return;
+fail:
+	isc__nm_incstats(sock, STATID_SENDFAIL);
+	isc__nm_failed_send_cb(sock, uvreq, result);
+}
+
+static void
+tcpdns_sendq_cb(uv_check_t *handle) {
+	isc__networker_t *worker = handle->loop->data;
+
+	isc__nm_tcpdns_flush(worker);
+}
+
+/*
+ * Queue the message on the current networker, so it can be written
+ * together with the other messages for the same connection at the end
+ * of the loop iteration.  Returns false when the message has to be
+ * sent right away.
+ */
+static bool
+tcpdns_send_enqueue(isc_nmsocket_t *sock, isc__nm_uvreq_t *uvreq) {
+	isc__networker_t *worker = &sock->mgr->workers[sock->tid];
+	uint32_t depth = atomic_load_relaxed(&sock->mgr->tcpsendbatch);
+	int r;
+
+	/*
+	 * Only the responses sent on the accepted connections are
+	 * batched, the outgoing client connections are sent directly.
+	 */
+	if (depth <= 1 || worker->finished || atomic_load(&sock->client)) {
+		return (false);
+	}
+
+	worker->tcpsendq[worker->tcpsendq_len++] = uvreq;
+
+	if (worker->tcpsendq_len == 1) {
+		r = uv_check_start(&worker->tcpsend_check, tcpdns_sendq_cb);
+		UV_RUNTIME_CHECK(uv_check_start, r);
+	}
+
+	if (worker->tcpsendq_len >= depth) {
+		isc__nm_tcpdns_flush(worker);
+	}
+
+	return (true);
+}
+
+/*
+ * Write all the messages in 'reqs' (queued for the same socket, in
+ * order) with a single uv_try_write() call, and pass whatever could not
+ * be written immediately to uv_write().
+ */
+static void
+tcpdns_send_batch(isc_nmsocket_t *sock, isc__nm_uvreq_t **reqs, size_t n) {
+	uv_buf_t bufs[2 * ISC_NETMGR_TCP_SENDBATCH_MAX];
+	isc_result_t result = ISC_R_SUCCESS;
+	size_t sent = 0;
+	size_t i = 0;
+	int r;
+
+	if (isc__nmsocket_closing(sock)) {
+		result = ISC_R_CANCELED;
+		goto fail;
+	}
+
+	for (i = 0; i < n; i++) {
+		bufs[2 * i] = (uv_buf_t){ .base = reqs[i]->tcplen, .len = 2 };
+		bufs[2 * i + 1] = (uv_buf_t){ .base = reqs[i]->uvbuf.base,
+					      .len = reqs[i]->uvbuf.len };
+	}
+
+	r = uv_try_write(&sock->uv_handle.stream, bufs, 2 * n);
+	if (r == UV_ENOSYS || r == UV_EAGAIN) {
+		r = 0;
+	} else if (r < 0) {
 		result = isc__nm_uverr2result(r);
+		i = 0;
 		goto fail;
 	}
+	sent = r;
 
-	isc_nm_timer_create(uvreq->handle, isc__nmsocket_writetimeout_cb, uvreq,
-			    &uvreq->timer);
-	if (sock->write_timeout > 0) {
-		isc_nm_timer_start(uvreq->timer, sock->write_timeout);
+	if (n > 1) {
+		isc__nm_incstats(sock, STATID_SENDBATCH);
+		isc__nm_addstats(sock, STATID_SENDBATCHMSG, n);
+	}
+
+	/*
+	 * Complete the messages that were written completely, and queue
+	 * the rest in libuv, starting with the partially written one.
+	 */
+	for (i = 0; i < n; i++) {
+		size_t len = 2 + reqs[i]->uvbuf.len;
+
+		if (sent >= len) {
+			sent -= len;
+			isc__nm_sendcb(sock, reqs[i], ISC_R_SUCCESS, false);
+			continue;
+		}
+
+		result = tcpdns_send_queue(sock, reqs[i], sent);
+		if (result != ISC_R_SUCCESS) {
+			goto fail;
+		}
+		sent = 0;
 	}
 
 	return;
 fail:
-	isc__nm_incstats(sock, STATID_SENDFAIL);
-	isc__nm_failed_send_cb(sock, uvreq, result);
+	for (; i < n; i++) {
+		isc__nm_incstats(sock, STATID_SENDFAIL);
+		isc__nm_failed_send_cb(sock, reqs[i], result);
+	}
+}
+
+void
+isc__nm_tcpdns_flush(isc__networker_t *worker) {
+	isc__nm_uvreq_t *reqs[ISC_NETMGR_TCP_SENDBATCH_MAX];
+	size_t nreqs = worker->tcpsendq_len;
+
+	if (nreqs == 0) {
+		return;
+	}
+
+	/*
+	 * The send callbacks may queue new messages, so take the current
+	 * queue contents out of the networker first.
+	 */
+	memmove(reqs, worker->tcpsendq, nreqs * sizeof(reqs[0]));
+	worker->tcpsendq_len = 0;
+	uv_check_stop(&worker->tcpsend_check);
+
+	for (size_t i = 0; i < nreqs; i++) {
+		isc__nm_uvreq_t *batch[ISC_NETMGR_TCP_SENDBATCH_MAX];
+		isc_nmsocket_t *sock = NULL;
+		size_t n = 0;
+
+		if (reqs[i] == NULL) {
+			continue;
+		}
+
+		sock = reqs[i]->sock;
+		for (size_t j = i; j < nreqs; j++) {
+			if (reqs[j] != NULL && reqs[j]->sock == sock) {
+				batch[n++] = reqs[j];
+				reqs[j] = NULL;
+			}
+		}
+
+		tcpdns_send_batch(sock, batch, n);
+	}
 }
 
 static void
@@ -1362,6 +1641,11 @@ tcpdns_close_direct(isc_nmsocket_t *sock) {
 		isc_quota_detach(&sock->quota);
 	}
 
+	if (ISC_LINK_LINKED(sock, lru_link)) {
+		isc__networker_t *worker = &sock->mgr->workers[sock->tid];
+		ISC_LIST_UNLINK(worker->tcpdns_lru, sock, lru_link);
+	}
+
 	if (sock->recv_handle != NULL) {
 		isc_nmhandle_detach(&sock->recv_handle);
 	}
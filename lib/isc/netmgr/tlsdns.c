@@ -1175,6 +1175,7 @@ tls_cycle_input(isc_nmsocket_t *sock) {
 		unsigned int alpnlen = 0;
 
 		isc__nmsocket_log_tls_session_reuse(sock, sock->tls.tls);
+		isc__nmsocket_tls_handshake_stats(sock, sock->tls.tls);
 
 		isc_tls_get_selected_alpn(sock->tls.tls, &alpn, &alpnlen);
 		if (alpn != NULL && alpnlen == ISC_TLS_DOT_PROTO_ALPN_ID_LEN &&
@@ -1299,6 +1300,7 @@ tls_cycle_output(isc_nmsocket_t *sock) {
 
 	while ((pending = BIO_pending(sock->tls.app_rbio)) > 0) {
 		isc__nm_uvreq_t *req = NULL;
+		uv_buf_t buf = { 0 };
 		size_t bytes;
 		int rv;
 		int r;
@@ -1309,6 +1311,33 @@ tls_cycle_output(isc_nmsocket_t *sock) {
 			break;
 		}
 
+		/*
+		 * Try to write the data straight from the BIO pair buffer
+		 * first; it needs to be copied only when the kernel doesn't
+		 * take all of it right away.
+		 */
+		rv = BIO_nread0(sock->tls.app_rbio, &buf.base);
+		INSIST(rv > 0);
+		buf.len = rv;
+
+		r = uv_try_write(&sock->uv_handle.stream, &buf, 1);
+		if (r > 0) {
+			rv = BIO_nread(sock->tls.app_rbio, &buf.base, r);
+			INSIST(rv == r);
+			if ((size_t)r == buf.len) {
+				/* Wrote everything, restart */
+				call_pending_send_callbacks(sock,
+							    ISC_R_SUCCESS);
+				continue;
+			}
+		} else if (r != UV_ENOSYS && r != UV_EAGAIN) {
+			result = isc__nm_uverr2result(r);
+			call_pending_send_callbacks(sock, result);
+			break;
+		}
+
+		/* Copy the rest and send it asynchronously */
+		pending = BIO_pending(sock->tls.app_rbio);
 		if (pending > (int)ISC_NETMGR_TCP_RECVBUF_SIZE) {
 			pending = (int)ISC_NETMGR_TCP_RECVBUF_SIZE;
 		}
@@ -1327,30 +1356,6 @@ tls_cycle_output(isc_nmsocket_t *sock) {
 		RUNTIME_CHECK(rv == 1);
 		INSIST((size_t)pending == bytes);
 
-		r = uv_try_write(&sock->uv_handle.stream, &req->uvbuf, 1);
-
-		if (r == pending) {
-			/* Wrote everything, restart */
-			isc__nm_uvreq_put(&req, sock);
-			free_senddata(sock, ISC_R_SUCCESS);
-			continue;
-		}
-
-		if (r > 0) {
-			/* Partial write, send rest asynchronously */
-			memmove(req->uvbuf.base, req->uvbuf.base + r,
-				req->uvbuf.len - r);
-			req->uvbuf.len = req->uvbuf.len - r;
-		} else if (r == UV_ENOSYS || r == UV_EAGAIN) {
-			/* uv_try_write is not supported, send
-			 * asynchronously */
-		} else {
-			result = isc__nm_uverr2result(r);
-			isc__nm_uvreq_put(&req, sock);
-			free_senddata(sock, result);
-			break;
-		}
-
 		r = uv_write(&req->uv_req.write, &sock->uv_handle.stream,
 			     &req->uvbuf, 1, tls_write_cb);
 		if (r < 0) {
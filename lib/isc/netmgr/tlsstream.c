@@ -343,6 +343,10 @@ tls_try_handshake(isc_nmsocket_t *sock, isc_result_t *presult) {
 		INSIST(SSL_is_init_finished(sock->tlsstream.tls) == 1);
 		INSIST(sock->statichandle == NULL);
 		isc__nmsocket_log_tls_session_reuse(sock, sock->tlsstream.tls);
+		if (sock->outerhandle != NULL) {
+			isc__nmsocket_tls_handshake_stats(
+				sock->outerhandle->sock, sock->tlsstream.tls);
+		}
 		tlshandle = isc__nmhandle_get(sock, &sock->peer, &sock->iface);
 
 		if (isc__nm_closing(sock)) {
@@ -14,6 +14,11 @@
 #include <unistd.h>
 #include <uv.h>
 
+#if HAVE_SENDMMSG
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#endif /* HAVE_SENDMMSG */
+
 #include <isc/atomic.h>
 #include <isc/barrier.h>
 #include <isc/buffer.h>
@@ -22,6 +27,7 @@
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/netmgr.h>
+#include <isc/profile.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/region.h>
@@ -70,6 +76,12 @@ udp_recv_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 static void
 udp_send_cb(uv_udp_send_t *req, int status);
 
+#if HAVE_SENDMMSG
+static bool
+udp_send_enqueue(isc_nmsocket_t *sock, isc__nm_uvreq_t *req,
+		 isc_sockaddr_t *peer);
+#endif /* HAVE_SENDMMSG */
+
 static void
 udp_close_cb(uv_handle_t *handle);
 
@@ -138,6 +150,29 @@ start_udp_child(isc_nm_t *mgr, isc_sockaddr_t *iface, isc_nmsocket_t *sock,
 				     (isc__netievent_t *)ievent);
 }
 
+static void
+udp_reuseport_cpu(isc_nmsocket_t *sock) {
+	int cpus[ISC_NETMGR_MAXCPUFILTER];
+
+	if (sock->nchildren > ISC_NETMGR_MAXCPUFILTER) {
+		return;
+	}
+
+	for (size_t i = 0; i < sock->nchildren; i++) {
+		isc_nmsocket_t *csock = &sock->children[i];
+
+		INSIST(csock->lbindex < sock->nchildren);
+		cpus[csock->lbindex] = sock->mgr->workers[csock->tid].cpu;
+	}
+
+	/*
+	 * The program is shared by the whole group, so attaching it to
+	 * any one of the children is enough.
+	 */
+	(void)isc__nm_socket_reuseport_cpu(sock->children[0].fd, cpus,
+					   sock->nchildren);
+}
+
 static void
 enqueue_stoplistening(isc_nmsocket_t *sock) {
 	isc__netievent_udpstop_t *ievent =
@@ -209,6 +244,9 @@ isc_nm_listenudp(isc_nm_t *mgr, isc_sockaddr_t *iface, isc_nm_recv_cb_t cb,
 
 	if (result == ISC_R_SUCCESS) {
 		REQUIRE(atomic_load(&sock->rchildren) == sock->nchildren);
+		if (mgr->load_balance_sockets && mgr->cpu_affinity) {
+			udp_reuseport_cpu(sock);
+		}
 		*sockp = sock;
 	} else {
 		atomic_store(&sock->active, false);
@@ -472,6 +510,11 @@ isc__nm_async_udplisten(isc__networker_t *worker, isc__netievent_t *ev0) {
 			isc__nm_incstats(sock, STATID_BINDFAIL);
 			goto done;
 		}
+		/*
+		 * The children are bound one at a time under the parent
+		 * lock, so they join the reuseport group in this order.
+		 */
+		sock->lbindex = atomic_load(&sock->parent->rchildren);
 	} else {
 		if (sock->parent->fd == -1) {
 			/* This thread is first, bind the socket */
@@ -647,7 +690,9 @@ udp_recv_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 
 	REQUIRE(!sock->processing);
 	sock->processing = true;
+	isc_profile_enter(isc_profile_netmgr);
 	isc__nm_readcb(sock, req, ISC_R_SUCCESS);
+	isc_profile_leave(isc_profile_netmgr);
 	sock->processing = false;
 
 free:
@@ -778,6 +823,12 @@ isc__nm_async_udpsend(isc__networker_t *worker, isc__netievent_t *ev0) {
 		return;
 	}
 
+#if HAVE_SENDMMSG
+	if (udp_send_enqueue(sock, uvreq, &ievent->peer)) {
+		return;
+	}
+#endif /* HAVE_SENDMMSG */
+
 	result = udp_send_direct(sock, uvreq, &ievent->peer);
 	if (result != ISC_R_SUCCESS) {
 		isc__nm_incstats(sock, STATID_SENDFAIL);
@@ -846,6 +897,296 @@ udp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req,
 	return (ISC_R_SUCCESS);
 }
 
+#if HAVE_SENDMMSG
+/*
+ * Limits for coalescing the messages for the same peer using UDP_SEGMENT:
+ * a single segment has to fit into an IPv6 packet without fragmentation
+ * and all the segments together into a single (super)datagram.
+ */
+#define UDP_SEGMENT_MAXSIZE  1232
+#define UDP_SEGMENT_MAXTOTAL (UINT16_MAX - 512)
+
+static void
+udp_sendq_cb(uv_check_t *handle) {
+	isc__networker_t *worker = handle->loop->data;
+
+	isc__nm_udp_flush(worker);
+}
+
+/*
+ * Queue the message on the current networker, so it can be sent
+ * together with other messages at the end of the loop iteration.
+ * Returns false when the message has to be sent right away.
+ */
+static bool
+udp_send_enqueue(isc_nmsocket_t *sock, isc__nm_uvreq_t *req,
+		 isc_sockaddr_t *peer) {
+	isc__networker_t *worker = &sock->mgr->workers[sock->tid];
+	uint32_t depth = atomic_load_relaxed(&sock->mgr->udpsendbatch);
+	int r;
+
+	/*
+	 * Only the responses sent from the listening sockets are
+	 * batched, the connected client sockets are sent directly.
+	 */
+	if (depth <= 1 || worker->finished || sock->parent == NULL ||
+	    atomic_load(&sock->client))
+	{
+		return (false);
+	}
+
+	req->peer = *peer;
+	worker->udpsendq[worker->udpsendq_len++] = req;
+
+	if (worker->udpsendq_len == 1) {
+		r = uv_check_start(&worker->udpsend_check, udp_sendq_cb);
+		UV_RUNTIME_CHECK(uv_check_start, r);
+	}
+
+	if (worker->udpsendq_len >= depth) {
+		isc__nm_udp_flush(worker);
+	}
+
+	return (true);
+}
+
+/*
+ * Hand the messages over to libuv, which will queue them if the socket
+ * is not writable.
+ */
+static void
+udp_send_fallback(isc_nmsocket_t *sock, isc__nm_uvreq_t **reqs,
+		  isc_result_t *results, size_t from, size_t to) {
+	for (size_t i = from; i < to; i++) {
+		results[i] = udp_send_direct(sock, reqs[i], &reqs[i]->peer);
+		if (results[i] == ISC_R_SUCCESS) {
+			/* udp_send_cb() will take care of the request */
+			reqs[i] = NULL;
+		} else {
+			isc__nm_incstats(sock, STATID_SENDFAIL);
+		}
+	}
+}
+
+#ifdef UDP_SEGMENT
+/*
+ * Check whether the message 'iov' can be appended as another segment to
+ * the UDP_SEGMENT message 'msg' starting with the request 'first'.
+ */
+static bool
+udp_gso_append(isc__nm_uvreq_t *first, struct msghdr *msg,
+	       isc__nm_uvreq_t *req, struct iovec *iov) {
+	size_t segsize = msg->msg_iov[0].iov_len;
+	size_t total = segsize * msg->msg_iovlen;
+
+	/*
+	 * All segments but the last one must be of the same size.
+	 */
+	if (segsize > UDP_SEGMENT_MAXSIZE ||
+	    msg->msg_iov[msg->msg_iovlen - 1].iov_len != segsize ||
+	    iov->iov_len > segsize || iov->iov_len == 0 ||
+	    total + iov->iov_len > UDP_SEGMENT_MAXTOTAL)
+	{
+		return (false);
+	}
+
+	return (isc_sockaddr_equal(&first->peer, &req->peer));
+}
+#endif /* UDP_SEGMENT */
+
+/*
+ * Send the queued messages for a single socket using as few sendmmsg(2)
+ * calls as possible, and then run the send callbacks.
+ */
+static void
+udp_send_batch(isc__networker_t *worker, isc_nmsocket_t *sock,
+	       isc__nm_uvreq_t **reqs, size_t nreqs) {
+	struct mmsghdr msgs[ISC_NETMGR_UDP_SENDBATCH_MAX];
+	struct iovec iovs[ISC_NETMGR_UDP_SENDBATCH_MAX];
+	isc_result_t results[ISC_NETMGR_UDP_SENDBATCH_MAX];
+	size_t first[ISC_NETMGR_UDP_SENDBATCH_MAX + 1];
+#ifdef UDP_SEGMENT
+	union {
+		char buf[CMSG_SPACE(sizeof(uint16_t))];
+		struct cmsghdr align;
+	} cmsgs[ISC_NETMGR_UDP_SENDBATCH_MAX];
+#endif /* UDP_SEGMENT */
+	size_t nmsgs = 0, sent = 0;
+	uv_os_fd_t fd = -1;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_nm_tid());
+	REQUIRE(nreqs > 0 && nreqs <= ISC_NETMGR_UDP_SENDBATCH_MAX);
+
+	for (size_t i = 0; i < nreqs; i++) {
+		results[i] = ISC_R_CANCELED;
+	}
+
+	if (isc__nmsocket_closing(sock) ||
+	    uv_fileno(&sock->uv_handle.handle, &fd) != 0)
+	{
+		goto done;
+	}
+
+	/*
+	 * Don't overtake the messages that libuv is still holding.
+	 */
+	if (sock->uv_handle.udp.send_queue_count > 0) {
+		udp_send_fallback(sock, reqs, results, 0, nreqs);
+		goto done;
+	}
+
+	for (size_t i = 0; i < nreqs; i++) {
+		isc__nm_uvreq_t *req = reqs[i];
+
+		iovs[i] = (struct iovec){ .iov_base = req->uvbuf.base,
+					  .iov_len = req->uvbuf.len };
+
+#ifdef UDP_SEGMENT
+		if (nmsgs > 0 && !worker->udpsend_nogso &&
+		    udp_gso_append(reqs[first[nmsgs - 1]],
+				   &msgs[nmsgs - 1].msg_hdr, req, &iovs[i]))
+		{
+			msgs[nmsgs - 1].msg_hdr.msg_iovlen++;
+			continue;
+		}
+#endif /* UDP_SEGMENT */
+
+		first[nmsgs] = i;
+		msgs[nmsgs] = (struct mmsghdr){
+			.msg_hdr = {
+				.msg_name = &req->peer.type.sa,
+				.msg_namelen = req->peer.length,
+				.msg_iov = &iovs[i],
+				.msg_iovlen = 1,
+			},
+		};
+		nmsgs++;
+	}
+	first[nmsgs] = nreqs;
+
+#ifdef UDP_SEGMENT
+	for (size_t m = 0; m < nmsgs; m++) {
+		struct msghdr *msg = &msgs[m].msg_hdr;
+		struct cmsghdr *cmsg = NULL;
+		uint16_t segsize;
+
+		if (msg->msg_iovlen == 1) {
+			continue;
+		}
+
+		segsize = msg->msg_iov[0].iov_len;
+		memset(&cmsgs[m], 0, sizeof(cmsgs[m]));
+		msg->msg_control = cmsgs[m].buf;
+		msg->msg_controllen = sizeof(cmsgs[m].buf);
+		cmsg = CMSG_FIRSTHDR(msg);
+		cmsg->cmsg_level = IPPROTO_UDP;
+		cmsg->cmsg_type = UDP_SEGMENT;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(segsize));
+		memmove(CMSG_DATA(cmsg), &segsize, sizeof(segsize));
+	}
+#endif /* UDP_SEGMENT */
+
+	while (sent < nmsgs) {
+		int r = sendmmsg(fd, &msgs[sent], nmsgs - sent, 0);
+		if (r > 0) {
+			isc__nm_incstats(sock, STATID_SENDBATCH);
+			isc__nm_addstats(sock, STATID_SENDBATCHMSG,
+					 first[sent + r] - first[sent]);
+			for (size_t i = first[sent]; i < first[sent + r]; i++)
+			{
+				results[i] = ISC_R_SUCCESS;
+			}
+			sent += r;
+			continue;
+		} else if (r < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (r == 0 || errno == EAGAIN || errno == EWOULDBLOCK ||
+		    errno == ENOBUFS)
+		{
+			udp_send_fallback(sock, reqs, results, first[sent],
+					  nreqs);
+			break;
+		}
+
+		if (msgs[sent].msg_hdr.msg_iovlen > 1) {
+			/*
+			 * The kernel or the network interface doesn't
+			 * support UDP segmentation offload; don't try it
+			 * again and send the rest the usual way.
+			 */
+			worker->udpsend_nogso = true;
+			udp_send_fallback(sock, reqs, results, first[sent],
+					  nreqs);
+			break;
+		}
+
+		/*
+		 * The first message couldn't be sent, skip it.
+		 */
+		results[first[sent]] = isc_errno_toresult(errno);
+		isc__nm_incstats(sock, STATID_SENDFAIL);
+		sent++;
+	}
+
+done:
+	for (size_t i = 0; i < nreqs; i++) {
+		if (reqs[i] == NULL) {
+			continue;
+		}
+		if (results[i] == ISC_R_SUCCESS) {
+			isc__nm_sendcb(sock, reqs[i], ISC_R_SUCCESS, false);
+		} else {
+			isc__nm_failed_send_cb(sock, reqs[i], results[i]);
+		}
+	}
+}
+#endif /* HAVE_SENDMMSG */
+
+void
+isc__nm_udp_flush(isc__networker_t *worker) {
+#if HAVE_SENDMMSG
+	isc__nm_uvreq_t *reqs[ISC_NETMGR_UDP_SENDBATCH_MAX];
+	size_t nreqs = worker->udpsendq_len;
+
+	if (nreqs == 0) {
+		return;
+	}
+
+	/*
+	 * The send callbacks may queue new messages, so take the current
+	 * queue contents out of the networker first.
+	 */
+	memmove(reqs, worker->udpsendq, nreqs * sizeof(reqs[0]));
+	worker->udpsendq_len = 0;
+	uv_check_stop(&worker->udpsend_check);
+
+	for (size_t i = 0; i < nreqs; i++) {
+		isc__nm_uvreq_t *batch[ISC_NETMGR_UDP_SENDBATCH_MAX];
+		isc_nmsocket_t *sock = NULL;
+		size_t n = 0;
+
+		if (reqs[i] == NULL) {
+			continue;
+		}
+
+		sock = reqs[i]->sock;
+		for (size_t j = i; j < nreqs; j++) {
+			if (reqs[j] != NULL && reqs[j]->sock == sock) {
+				batch[n++] = reqs[j];
+				reqs[j] = NULL;
+			}
+		}
+
+		udp_send_batch(worker, sock, batch, n);
+	}
+#else  /* HAVE_SENDMMSG */
+	INSIST(worker->udpsendq_len == 0);
+#endif /* HAVE_SENDMMSG */
+}
+
 static isc_result_t
 udp_connect_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
 	isc__networker_t *worker = NULL;
@@ -13,6 +13,8 @@
 
 #pragma once
 
+#include <inttypes.h>
+
 #include <isc/mem.h>
 #include <isc/result.h>
 
@@ -36,3 +38,27 @@ isc__netmgr_shutdown(isc_nm_t *mgr);
  * Shut down all active connections, freeing associated resources;
  * prevent new connections from being established.
  */
+
+typedef uint64_t (*isc__netmgr_timer_cb)(void *cbarg, int tid);
+/*%<
+ * Runs the expired timers owned by worker 'tid', and returns the
+ * number of milliseconds until the next one is due, or UINT64_MAX if
+ * the worker has no timers.
+ */
+
+void
+isc__netmgr_settimercb(isc_nm_t *mgr, isc__netmgr_timer_cb cb,
+		       void *cbarg);
+/*%<
+ * Set the callback the workers use to run their timers, or remove it
+ * if 'cb' is NULL.  The workers are paused while the callback is
+ * changed, so after this returns, none of them is running the old one.
+ */
+
+void
+isc__netmgr_poketimers(isc_nm_t *mgr, int tid);
+/*%<
+ * Make worker 'tid' run its timer callback, because a timer was
+ * scheduled earlier than the worker expected.  If called from the
+ * worker itself, the callback is run before this returns.
+ */
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <time.h>
+
+#include <isc/align.h>
+#include <isc/atomic.h>
+#include <isc/os.h>
+#include <isc/profile.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+/*%
+ * Totals are added to one of PROFILE_SLOTS slots, picked by thread id;
+ * with fewer threads than slots, no two threads share a cache line.
+ */
+#define PROFILE_SLOTS 64
+
+/*%
+ * Subsystems entered more than PROFILE_DEPTH deep are not tracked;
+ * their time goes to the last tracked one.
+ */
+#define PROFILE_DEPTH 16
+
+typedef struct profile_slot {
+	alignas(ISC_OS_CACHELINE_SIZE) atomic_uint_fast64_t
+		nsecs[isc_profile_max];
+	atomic_uint_fast64_t calls[isc_profile_max];
+} profile_slot_t;
+
+static profile_slot_t slots[PROFILE_SLOTS];
+
+static const char *names[isc_profile_max] = {
+	"netmgr", "query", "resolver", "validator", "db", "zone",
+};
+
+/*
+ * The subsystems this thread is in, the innermost last, and when the
+ * innermost one started being charged.
+ */
+static thread_local unsigned int depth = 0;
+static thread_local isc_profile_t stack[PROFILE_DEPTH];
+static thread_local uint64_t since = 0;
+
+static uint64_t
+now_ns(void) {
+	struct timespec ts;
+
+	RUNTIME_CHECK(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static void
+charge(uint64_t now) {
+	profile_slot_t *slot = &slots[isc_tid_v % PROFILE_SLOTS];
+	isc_profile_t category = stack[ISC_MIN(depth, PROFILE_DEPTH) - 1];
+
+	atomic_fetch_add_relaxed(&slot->nsecs[category], now - since);
+}
+
+void
+isc_profile_enter(isc_profile_t category) {
+	profile_slot_t *slot = &slots[isc_tid_v % PROFILE_SLOTS];
+	uint64_t now = now_ns();
+
+	REQUIRE(category < isc_profile_max);
+
+	if (depth > 0) {
+		charge(now);
+	}
+	if (depth < PROFILE_DEPTH) {
+		stack[depth] = category;
+	}
+	depth++;
+	since = now;
+
+	atomic_fetch_add_relaxed(&slot->calls[category], 1);
+}
+
+void
+isc_profile_leave(isc_profile_t category) {
+	uint64_t now = now_ns();
+
+	REQUIRE(depth > 0);
+	REQUIRE(depth > PROFILE_DEPTH || stack[depth - 1] == category);
+
+	charge(now);
+	depth--;
+	since = now;
+}
+
+void
+isc_profile_get(uint64_t *nsecs, uint64_t *calls) {
+	REQUIRE(nsecs != NULL && calls != NULL);
+
+	for (size_t i = 0; i < isc_profile_max; i++) {
+		nsecs[i] = 0;
+		calls[i] = 0;
+		for (size_t j = 0; j < PROFILE_SLOTS; j++) {
+			nsecs[i] += atomic_load_relaxed(&slots[j].nsecs[i]);
+			calls[i] += atomic_load_relaxed(&slots[j].calls[i]);
+		}
+	}
+}
+
+const char *
+isc_profile_name(isc_profile_t category) {
+	REQUIRE(category < isc_profile_max);
+
+	return (names[category]);
+}
@@ -16,7 +16,9 @@
 #include <stddef.h>
 
 #include <isc/atomic.h>
+#include <isc/mem.h>
 #include <isc/quota.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #define QUOTA_MAGIC    ISC_MAGIC('Q', 'U', 'O', 'T')
@@ -25,6 +27,22 @@
 #define QUOTA_CB_MAGIC	  ISC_MAGIC('Q', 'T', 'C', 'B')
 #define VALID_QUOTA_CB(p) ISC_MAGIC_VALID(p, QUOTA_CB_MAGIC)
 
+static unsigned int
+quota_used(isc_quota_t *quota) {
+	int_fast32_t avail = 0, used;
+
+	if (quota->slices == NULL) {
+		return (atomic_load_relaxed(&quota->used));
+	}
+
+	for (unsigned int i = 0; i < quota->nslices; i++) {
+		avail += atomic_load_relaxed(&quota->slices[i].avail);
+	}
+	used = (int_fast32_t)atomic_load_relaxed(&quota->max) - avail;
+
+	return (used > 0 ? (unsigned int)used : 0);
+}
+
 void
 isc_quota_init(isc_quota_t *quota, unsigned int max) {
 	atomic_init(&quota->max, max);
@@ -34,17 +52,50 @@ isc_quota_init(isc_quota_t *quota, unsigned int max) {
 	ISC_LIST_INIT(quota->cbs);
 	isc_mutex_init(&quota->cblock);
 	ISC_LINK_INIT(quota, link);
+	quota->mctx = NULL;
+	quota->slices = NULL;
+	quota->nslices = 0;
 	quota->magic = QUOTA_MAGIC;
 }
 
+void
+isc_quota_slice(isc_quota_t *quota, isc_mem_t *mctx, unsigned int nslices) {
+	uint_fast32_t max;
+
+	REQUIRE(VALID_QUOTA(quota));
+	REQUIRE(quota->slices == NULL);
+	REQUIRE(atomic_load(&quota->used) == 0);
+	REQUIRE(nslices > 0);
+
+	isc_mem_attach(mctx, &quota->mctx);
+	quota->slices = isc_mem_get(mctx, nslices * sizeof(quota->slices[0]));
+	quota->nslices = nslices;
+
+	/*
+	 * Each slice holds the spare capacity of the quota available to
+	 * it; the sum of all of them is the maximum minus the used quota.
+	 */
+	max = atomic_load_acquire(&quota->max);
+	for (unsigned int i = 0; i < nslices; i++) {
+		atomic_init(&quota->slices[i].avail,
+			    max / nslices + (i < max % nslices ? 1 : 0));
+	}
+}
+
 void
 isc_quota_destroy(isc_quota_t *quota) {
 	REQUIRE(VALID_QUOTA(quota));
 	quota->magic = 0;
 
-	INSIST(atomic_load(&quota->used) == 0);
+	INSIST(quota_used(quota) == 0);
 	INSIST(atomic_load(&quota->waiting) == 0);
 	INSIST(ISC_LIST_EMPTY(quota->cbs));
+	if (quota->slices != NULL) {
+		isc_mem_putanddetach(&quota->mctx, quota->slices,
+				     quota->nslices * sizeof(quota->slices[0]));
+		quota->slices = NULL;
+		quota->nslices = 0;
+	}
 	atomic_store_release(&quota->max, 0);
 	atomic_store_release(&quota->used, 0);
 	atomic_store_release(&quota->soft, 0);
@@ -59,8 +110,20 @@ isc_quota_soft(isc_quota_t *quota, unsigned int soft) {
 
 void
 isc_quota_max(isc_quota_t *quota, unsigned int max) {
+	uint_fast32_t oldmax;
+
 	REQUIRE(VALID_QUOTA(quota));
-	atomic_store_release(&quota->max, max);
+
+	oldmax = atomic_exchange_acq_rel(&quota->max, max);
+	if (quota->slices != NULL) {
+		/*
+		 * Add or take away the difference; the slice may become
+		 * negative, then it has to be repaid by released quota.
+		 */
+		atomic_fetch_add_release(&quota->slices[0].avail,
+					 (int_fast32_t)max -
+						 (int_fast32_t)oldmax);
+	}
 }
 
 unsigned int
@@ -78,7 +141,48 @@ isc_quota_getsoft(isc_quota_t *quota) {
 unsigned int
 isc_quota_getused(isc_quota_t *quota) {
 	REQUIRE(VALID_QUOTA(quota));
-	return (atomic_load_relaxed(&quota->used));
+	return (quota_used(quota));
+}
+
+static isc_quota_slice_t *
+quota_slice(isc_quota_t *quota) {
+	return (&quota->slices[isc_tid_v % quota->nslices]);
+}
+
+static isc_result_t
+quota_reserve_sliced(isc_quota_t *quota) {
+	isc_result_t result = ISC_R_SUCCESS;
+	uint_fast32_t max = atomic_load_acquire(&quota->max);
+	uint_fast32_t soft = atomic_load_acquire(&quota->soft);
+	size_t first = quota_slice(quota) - quota->slices;
+
+	if (soft != 0 && quota_used(quota) >= soft) {
+		result = ISC_R_SOFTQUOTA;
+	}
+
+	if (max == 0) {
+		atomic_fetch_sub_acq_rel(&quota->slices[first].avail, 1);
+		return (result);
+	}
+
+	/*
+	 * Try our own slice first, then steal the spare capacity of the
+	 * others.
+	 */
+	for (size_t i = 0; i < quota->nslices; i++) {
+		isc_quota_slice_t *slice =
+			&quota->slices[(first + i) % quota->nslices];
+		int_fast32_t avail = atomic_load_acquire(&slice->avail);
+		while (avail > 0) {
+			if (atomic_compare_exchange_weak_acq_rel(
+				    &slice->avail, &avail, avail - 1))
+			{
+				return (result);
+			}
+		}
+	}
+
+	return (ISC_R_QUOTA);
 }
 
 static isc_result_t
@@ -87,6 +191,11 @@ quota_reserve(isc_quota_t *quota) {
 	uint_fast32_t max = atomic_load_acquire(&quota->max);
 	uint_fast32_t soft = atomic_load_acquire(&quota->soft);
 	uint_fast32_t used = atomic_load_acquire(&quota->used);
+
+	if (quota->slices != NULL) {
+		return (quota_reserve_sliced(quota));
+	}
+
 	do {
 		if (max != 0 && used >= max) {
 			return (ISC_R_QUOTA);
@@ -143,6 +252,11 @@ quota_release(isc_quota_t *quota) {
 		}
 	}
 
+	if (quota->slices != NULL) {
+		atomic_fetch_add_release(&quota_slice(quota)->avail, 1);
+		return;
+	}
+
 	used = atomic_fetch_sub_release(&quota->used, 1);
 	INSIST(used > 0);
 }
@@ -16,6 +16,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <time.h>
 
 #if defined(sun) && (defined(__sparc) || defined(__sparc__))
 #include <synch.h> /* for smt_pause(3c) */
@@ -25,6 +26,8 @@
 #include <isc/magic.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
+#include <isc/thread.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #if USE_PTHREAD_RWLOCK
@@ -168,6 +171,8 @@ isc_rwlock_destroy(isc_rwlock_t *rwl) {
 
 static isc_result_t
 isc__rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type);
+static isc_result_t
+rwlock_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type);
 
 #ifdef ISC_RWLOCK_TRACE
 #include <stdio.h> /* Required for fprintf/stderr. */
@@ -220,6 +225,11 @@ isc_rwlock_init(isc_rwlock_t *rwl, unsigned int read_quota,
 	isc_condition_init(&rwl->readable);
 	isc_condition_init(&rwl->writeable);
 
+#if USE_BRAVO_RWLOCK
+	atomic_init(&rwl->rbias, true);
+	atomic_init(&rwl->inhibit_until, 0);
+#endif /* USE_BRAVO_RWLOCK */
+
 	rwl->magic = RWLOCK_MAGIC;
 }
 
@@ -426,8 +436,8 @@ isc__rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 	return (ISC_R_SUCCESS);
 }
 
-isc_result_t
-isc_rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
+static isc_result_t
+rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 	int32_t cnt = 0;
 	int32_t spins = atomic_load_acquire(&rwl->spins) * 2 + 10;
 	int32_t max_cnt = ISC_MAX(spins, RWLOCK_MAX_ADAPTIVE_COUNT);
@@ -439,15 +449,15 @@ isc_rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 			break;
 		}
 		isc_rwlock_pause();
-	} while (isc_rwlock_trylock(rwl, type) != ISC_R_SUCCESS);
+	} while (rwlock_trylock(rwl, type) != ISC_R_SUCCESS);
 
 	atomic_fetch_add_release(&rwl->spins, (cnt - spins) / 8);
 
 	return (result);
 }
 
-isc_result_t
-isc_rwlock_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
+static isc_result_t
+rwlock_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 	int32_t cntflag;
 
 	REQUIRE(VALID_RWLOCK(rwl));
@@ -513,8 +523,8 @@ isc_rwlock_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 	return (ISC_R_SUCCESS);
 }
 
-isc_result_t
-isc_rwlock_tryupgrade(isc_rwlock_t *rwl) {
+static isc_result_t
+rwlock_tryupgrade(isc_rwlock_t *rwl) {
 	REQUIRE(VALID_RWLOCK(rwl));
 
 	int_fast32_t reader_incr = READER_INCR;
@@ -542,8 +552,8 @@ isc_rwlock_tryupgrade(isc_rwlock_t *rwl) {
 	return (ISC_R_SUCCESS);
 }
 
-void
-isc_rwlock_downgrade(isc_rwlock_t *rwl) {
+static void
+rwlock_downgrade(isc_rwlock_t *rwl) {
 	int32_t prev_readers;
 
 	REQUIRE(VALID_RWLOCK(rwl));
@@ -566,8 +576,8 @@ isc_rwlock_downgrade(isc_rwlock_t *rwl) {
 	UNLOCK(&rwl->lock);
 }
 
-isc_result_t
-isc_rwlock_unlock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
+static isc_result_t
+rwlock_unlock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 	int32_t prev_cnt;
 
 	REQUIRE(VALID_RWLOCK(rwl));
@@ -641,4 +651,289 @@ isc_rwlock_unlock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 	return (ISC_R_SUCCESS);
 }
 
+#if USE_BRAVO_RWLOCK
+
+/*
+ * BRAVO (Biased Locking for Reader-Writer Locks, Dice and Kogan, 2019)
+ * layered on top of the lock above.
+ *
+ * With many CPUs, the atomic update of 'cnt_and_flag' by every reader
+ * makes the cache line holding it bounce between the CPUs, so readers
+ * slow each other down even though they never wait for each other.
+ *
+ * While the lock is reader-biased ('rbias' is set), a reader instead
+ * stores the address of the lock in a slot of its own row in the
+ * global 'visible_readers' table, picked by hashing the address, and
+ * then checks that the bias is still set.  Nothing that other readers
+ * write is touched.  If the slot is in use by another lock, the thread
+ * has no row, or the bias is not set, the reader falls back to the
+ * lock above.
+ *
+ * A writer first takes the write lock above, which keeps out new slow
+ * path readers, then clears 'rbias' and waits until the slot for the
+ * lock in every row no longer holds the lock.  Since this is expensive,
+ * the bias is not restored by slow path readers until 'inhibit_until',
+ * which is set to several times the time the revocation took; locks
+ * that are written often thus behave like the lock above.
+ */
+
+#define BRAVO_THREADS	       128
+#define BRAVO_SLOTS	       16 /* per thread, a power of 2 */
+#define BRAVO_INHIBIT_MULTIPLY 9
+
+static atomic_uintptr_t visible_readers[BRAVO_THREADS][BRAVO_SLOTS];
+
+static uint64_t
+bravo_now(void) {
+	struct timespec ts;
+
+	RUNTIME_CHECK(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+
+	return ((uint64_t)ts.tv_sec * NS_PER_SEC + (uint64_t)ts.tv_nsec);
+}
+
+static unsigned int
+bravo_hash(isc_rwlock_t *rwl) {
+	return (((uint32_t)((uintptr_t)rwl >> 4) * 2654435761U) >> 16) &
+	       (BRAVO_SLOTS - 1);
+}
+
+/*
+ * Return the slot of the calling thread for 'rwl', or NULL if the thread
+ * has no row in the table.
+ */
+static atomic_uintptr_t *
+bravo_slot(isc_rwlock_t *rwl) {
+	if (isc_tid_v >= BRAVO_THREADS) {
+		return (NULL);
+	}
+
+	return (&visible_readers[isc_tid_v][bravo_hash(rwl)]);
+}
+
+static bool
+bravo_read_lock(isc_rwlock_t *rwl) {
+	atomic_uintptr_t *slot = NULL;
+
+	if (!atomic_load_relaxed(&rwl->rbias)) {
+		return (false);
+	}
+
+	slot = bravo_slot(rwl);
+	if (slot == NULL || atomic_load_relaxed(slot) != 0) {
+		return (false);
+	}
+
+	/*
+	 * The store to the slot must be ordered before the load of the
+	 * bias, and the writers clear the bias before they scan the slots,
+	 * hence the sequentially consistent accesses.
+	 */
+	atomic_store(slot, (uintptr_t)rwl);
+	if (atomic_load(&rwl->rbias)) {
+		return (true);
+	}
+
+	atomic_store_release(slot, 0);
+	return (false);
+}
+
+static bool
+bravo_read_unlock(isc_rwlock_t *rwl) {
+	atomic_uintptr_t *slot = bravo_slot(rwl);
+
+	if (slot == NULL || atomic_load_relaxed(slot) != (uintptr_t)rwl) {
+		return (false);
+	}
+
+	atomic_store_release(slot, 0);
+	return (true);
+}
+
+/*
+ * Called by slow path readers: restore the bias once the inhibition
+ * period has passed.
+ */
+static void
+bravo_rebias(isc_rwlock_t *rwl) {
+	if (!atomic_load_relaxed(&rwl->rbias) &&
+	    bravo_now() >= atomic_load_relaxed(&rwl->inhibit_until))
+	{
+		atomic_store(&rwl->rbias, true);
+	}
+}
+
+/*
+ * Called with the write lock held: clear the bias and wait for the fast
+ * path readers to leave, ignoring the slot 'own' of a thread that is
+ * upgrading.  If 'wait' is false and there are fast path readers, the
+ * bias is set again and false is returned.
+ */
+static bool
+bravo_revoke(isc_rwlock_t *rwl, bool wait, atomic_uintptr_t *own) {
+	unsigned int hash = bravo_hash(rwl);
+	uint64_t start;
+
+	if (!atomic_load_relaxed(&rwl->rbias)) {
+		return (true);
+	}
+
+	atomic_store(&rwl->rbias, false);
+	start = bravo_now();
+	for (size_t i = 0; i < BRAVO_THREADS; i++) {
+		atomic_uintptr_t *slot = &visible_readers[i][hash];
+
+		if (slot == own) {
+			continue;
+		}
+		while (atomic_load(slot) == (uintptr_t)rwl) {
+			if (!wait) {
+				atomic_store(&rwl->rbias, true);
+				return (false);
+			}
+			isc_rwlock_pause();
+		}
+	}
+	atomic_store_relaxed(&rwl->inhibit_until,
+			     start + (bravo_now() - start) *
+					     BRAVO_INHIBIT_MULTIPLY);
+
+	return (true);
+}
+
+isc_result_t
+isc_rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
+	REQUIRE(VALID_RWLOCK(rwl));
+
+	switch (type) {
+	case isc_rwlocktype_read:
+		if (bravo_read_lock(rwl)) {
+			break;
+		}
+		RUNTIME_CHECK(rwlock_lock(rwl, type) == ISC_R_SUCCESS);
+		bravo_rebias(rwl);
+		break;
+	case isc_rwlocktype_write:
+		RUNTIME_CHECK(rwlock_lock(rwl, type) == ISC_R_SUCCESS);
+		(void)bravo_revoke(rwl, true, NULL);
+		break;
+	default:
+		UNREACHABLE();
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+isc_rwlock_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
+	isc_result_t result;
+
+	REQUIRE(VALID_RWLOCK(rwl));
+
+	switch (type) {
+	case isc_rwlocktype_read:
+		if (bravo_read_lock(rwl)) {
+			return (ISC_R_SUCCESS);
+		}
+		result = rwlock_trylock(rwl, type);
+		if (result == ISC_R_SUCCESS) {
+			bravo_rebias(rwl);
+		}
+		return (result);
+	case isc_rwlocktype_write:
+		result = rwlock_trylock(rwl, type);
+		if (result == ISC_R_SUCCESS && !bravo_revoke(rwl, false, NULL))
+		{
+			RUNTIME_CHECK(rwlock_unlock(rwl, type) ==
+				      ISC_R_SUCCESS);
+			result = ISC_R_LOCKBUSY;
+		}
+		return (result);
+	default:
+		UNREACHABLE();
+	}
+}
+
+isc_result_t
+isc_rwlock_tryupgrade(isc_rwlock_t *rwl) {
+	atomic_uintptr_t *own = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_RWLOCK(rwl));
+
+	own = bravo_slot(rwl);
+	if (own != NULL && atomic_load_relaxed(own) == (uintptr_t)rwl) {
+		/*
+		 * We are a fast path reader, so the write lock can be
+		 * taken as usual, as long as there are no other readers.
+		 */
+		result = rwlock_trylock(rwl, isc_rwlocktype_write);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+		if (!bravo_revoke(rwl, false, own)) {
+			RUNTIME_CHECK(rwlock_unlock(rwl, isc_rwlocktype_write) ==
+				      ISC_R_SUCCESS);
+			return (ISC_R_LOCKBUSY);
+		}
+		atomic_store_release(own, 0);
+		return (ISC_R_SUCCESS);
+	}
+
+	result = rwlock_tryupgrade(rwl);
+	if (result == ISC_R_SUCCESS && !bravo_revoke(rwl, false, NULL)) {
+		rwlock_downgrade(rwl);
+		result = ISC_R_LOCKBUSY;
+	}
+
+	return (result);
+}
+
+void
+isc_rwlock_downgrade(isc_rwlock_t *rwl) {
+	REQUIRE(VALID_RWLOCK(rwl));
+
+	rwlock_downgrade(rwl);
+}
+
+isc_result_t
+isc_rwlock_unlock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
+	REQUIRE(VALID_RWLOCK(rwl));
+
+	if (type == isc_rwlocktype_read && bravo_read_unlock(rwl)) {
+		return (ISC_R_SUCCESS);
+	}
+
+	return (rwlock_unlock(rwl, type));
+}
+
+#else /* USE_BRAVO_RWLOCK */
+
+isc_result_t
+isc_rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
+	return (rwlock_lock(rwl, type));
+}
+
+isc_result_t
+isc_rwlock_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
+	return (rwlock_trylock(rwl, type));
+}
+
+isc_result_t
+isc_rwlock_tryupgrade(isc_rwlock_t *rwl) {
+	return (rwlock_tryupgrade(rwl));
+}
+
+void
+isc_rwlock_downgrade(isc_rwlock_t *rwl) {
+	rwlock_downgrade(rwl);
+}
+
+isc_result_t
+isc_rwlock_unlock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
+	return (rwlock_unlock(rwl, type));
+}
+
+#endif /* USE_BRAVO_RWLOCK */
+
 #endif /* USE_PTHREAD_RWLOCK */
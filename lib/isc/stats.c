@@ -20,38 +20,117 @@
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/refcount.h>
 #include <isc/stats.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #define ISC_STATS_MAGIC	   ISC_MAGIC('S', 't', 'a', 't')
 #define ISC_STATS_VALID(x) ISC_MAGIC_VALID(x, ISC_STATS_MAGIC)
 
+/*
+ * Sharded statistics have a copy of every counter for each of
+ * ISC_STATS_SHARDS shards, picked by thread id; a counter is the sum of
+ * its copies.  The copies in a shard are padded to a whole number of
+ * cache lines, so threads updating different shards don't share them.
+ */
+#define ISC_STATS_SHARDS 16
+
 typedef atomic_int_fast64_t isc__atomic_statcounter_t;
 
+#define COUNTERS_PER_LINE \
+	(ISC_OS_CACHELINE_SIZE / sizeof(isc__atomic_statcounter_t))
+
 struct isc_stats {
 	unsigned int magic;
 	isc_mem_t *mctx;
 	isc_refcount_t references;
 	int ncounters;
+	int nshards;
+	int stride; /* the distance between the shards */
 	isc__atomic_statcounter_t *counters;
 };
 
+static isc__atomic_statcounter_t *
+counters_get(isc_mem_t *mctx, int nshards, int stride) {
+	isc__atomic_statcounter_t *counters = NULL;
+	size_t size = sizeof(counters[0]) * nshards * stride;
+
+	if (nshards > 1) {
+		counters = isc_mem_get_aligned(mctx, size,
+					       ISC_OS_CACHELINE_SIZE);
+	} else {
+		counters = isc_mem_get(mctx, size);
+	}
+	for (int i = 0; i < nshards * stride; i++) {
+		atomic_init(&counters[i], 0);
+	}
+
+	return (counters);
+}
+
+static void
+counters_put(isc_stats_t *stats) {
+	size_t size = sizeof(stats->counters[0]) * stats->nshards *
+		      stats->stride;
+
+	if (stats->nshards > 1) {
+		isc_mem_put_aligned(stats->mctx, stats->counters, size,
+				    ISC_OS_CACHELINE_SIZE);
+	} else {
+		isc_mem_put(stats->mctx, stats->counters, size);
+	}
+}
+
+static int
+counters_stride(int nshards, int ncounters) {
+	if (nshards == 1) {
+		return (ncounters);
+	}
+	return ((ncounters + COUNTERS_PER_LINE - 1) / COUNTERS_PER_LINE *
+		COUNTERS_PER_LINE);
+}
+
+/*
+ * The copy of 'counter' for this thread to update.
+ */
+static isc__atomic_statcounter_t *
+counter_shard(isc_stats_t *stats, isc_statscounter_t counter) {
+	size_t shard = 0;
+
+	if (stats->nshards > 1) {
+		shard = isc_tid_v % stats->nshards;
+	}
+
+	return (&stats->counters[shard * stats->stride + counter]);
+}
+
+static uint64_t
+counter_sum(isc_stats_t *stats, isc_statscounter_t counter) {
+	uint64_t value = 0;
+
+	for (int i = 0; i < stats->nshards; i++) {
+		value += atomic_load_acquire(
+			&stats->counters[i * stats->stride + counter]);
+	}
+
+	return (value);
+}
+
 static isc_result_t
-create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
+create_stats(isc_mem_t *mctx, int ncounters, int nshards,
+	     isc_stats_t **statsp) {
 	isc_stats_t *stats;
-	size_t counters_alloc_size;
 
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	stats = isc_mem_get(mctx, sizeof(*stats));
-	counters_alloc_size = sizeof(isc__atomic_statcounter_t) * ncounters;
-	stats->counters = isc_mem_get(mctx, counters_alloc_size);
+	stats->nshards = nshards;
+	stats->stride = counters_stride(nshards, ncounters);
+	stats->counters = counters_get(mctx, nshards, stats->stride);
 	isc_refcount_init(&stats->references, 1);
-	for (int i = 0; i < ncounters; i++) {
-		atomic_init(&stats->counters[i], 0);
-	}
 	stats->mctx = NULL;
 	isc_mem_attach(mctx, &stats->mctx);
 	stats->ncounters = ncounters;
@@ -81,9 +160,7 @@ isc_stats_detach(isc_stats_t **statsp) {
 
 	if (isc_refcount_decrement(&stats->references) == 1) {
 		isc_refcount_destroy(&stats->references);
-		isc_mem_put(stats->mctx, stats->counters,
-			    sizeof(isc__atomic_statcounter_t) *
-				    stats->ncounters);
+		counters_put(stats);
 		isc_mem_putanddetach(&stats->mctx, stats, sizeof(*stats));
 	}
 }
@@ -99,7 +176,15 @@ isc_result_t
 isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, ncounters, statsp));
+	return (create_stats(mctx, ncounters, 1, statsp));
+}
+
+isc_result_t
+isc_stats_create_sharded(isc_mem_t *mctx, isc_stats_t **statsp,
+			 int ncounters) {
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	return (create_stats(mctx, ncounters, ISC_STATS_SHARDS, statsp));
 }
 
 void
@@ -107,14 +192,22 @@ isc_stats_increment(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
-	atomic_fetch_add_relaxed(&stats->counters[counter], 1);
+	atomic_fetch_add_relaxed(counter_shard(stats, counter), 1);
 }
 
 void
 isc_stats_decrement(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
-	atomic_fetch_sub_release(&stats->counters[counter], 1);
+	atomic_fetch_sub_release(counter_shard(stats, counter), 1);
+}
+
+void
+isc_stats_add(isc_stats_t *stats, isc_statscounter_t counter, uint64_t val) {
+	REQUIRE(ISC_STATS_VALID(stats));
+	REQUIRE(counter < stats->ncounters);
+
+	atomic_fetch_add_relaxed(counter_shard(stats, counter), val);
 }
 
 void
@@ -125,7 +218,7 @@ isc_stats_dump(isc_stats_t *stats, isc_stats_dumper_t dump_fn, void *arg,
 	REQUIRE(ISC_STATS_VALID(stats));
 
 	for (i = 0; i < stats->ncounters; i++) {
-		uint32_t counter = atomic_load_acquire(&stats->counters[i]);
+		uint32_t counter = counter_sum(stats, i);
 		if ((options & ISC_STATSDUMP_VERBOSE) == 0 && counter == 0) {
 			continue;
 		}
@@ -138,6 +231,10 @@ isc_stats_set(isc_stats_t *stats, uint64_t val, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
+	for (int i = 1; i < stats->nshards; i++) {
+		atomic_store_release(
+			&stats->counters[i * stats->stride + counter], 0);
+	}
 	atomic_store_release(&stats->counters[counter], val);
 }
 
@@ -147,6 +244,10 @@ isc_stats_update_if_greater(isc_stats_t *stats, isc_statscounter_t counter,
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
+	/*
+	 * Counters only ever updated here keep their value in shard 0;
+	 * the copies in the other shards stay zero.
+	 */
 	isc_statscounter_t curr_value =
 		atomic_load_acquire(&stats->counters[counter]);
 	do {
@@ -162,14 +263,14 @@ isc_stats_get_counter(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
-	return (atomic_load_acquire(&stats->counters[counter]));
+	return (counter_sum(stats, counter));
 }
 
 void
 isc_stats_resize(isc_stats_t **statsp, int ncounters) {
 	isc_stats_t *stats;
-	size_t counters_alloc_size;
 	isc__atomic_statcounter_t *newcounters;
+	int newstride;
 
 	REQUIRE(statsp != NULL && *statsp != NULL);
 	REQUIRE(ISC_STATS_VALID(*statsp));
@@ -182,17 +283,14 @@ isc_stats_resize(isc_stats_t **statsp, int ncounters) {
 	}
 
 	/* Grow number of counters. */
-	counters_alloc_size = sizeof(isc__atomic_statcounter_t) * ncounters;
-	newcounters = isc_mem_get(stats->mctx, counters_alloc_size);
-	for (int i = 0; i < ncounters; i++) {
-		atomic_init(&newcounters[i], 0);
-	}
+	newstride = counters_stride(stats->nshards, ncounters);
+	newcounters = counters_get(stats->mctx, stats->nshards, newstride);
 	for (int i = 0; i < stats->ncounters; i++) {
-		uint32_t counter = atomic_load_acquire(&stats->counters[i]);
+		uint32_t counter = counter_sum(stats, i);
 		atomic_store_release(&newcounters[i], counter);
 	}
-	isc_mem_put(stats->mctx, stats->counters,
-		    sizeof(isc__atomic_statcounter_t) * stats->ncounters);
+	counters_put(stats);
 	stats->counters = newcounters;
+	stats->stride = newstride;
 	stats->ncounters = ncounters;
 }
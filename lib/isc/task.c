@@ -118,6 +118,7 @@ struct isc_task {
 	/* Protected by atomics */
 	atomic_bool shuttingdown;
 	atomic_bool privileged;
+	atomic_bool background;
 	/* Locked by task manager lock. */
 	LINK(isc_task_t) link;
 };
@@ -241,6 +242,7 @@ isc_task_create_bound(isc_taskmgr_t *manager, unsigned int quantum,
 	task->quantum = (quantum > 0) ? quantum : manager->default_quantum;
 	atomic_init(&task->shuttingdown, false);
 	atomic_init(&task->privileged, false);
+	atomic_init(&task->background, false);
 	task->now = 0;
 	isc_time_settoepoch(&task->tnow);
 	memset(task->name, 0, sizeof(task->name));
@@ -1179,6 +1181,20 @@ isc_task_privileged(isc_task_t *task) {
 	return (isc_taskmgr_mode(task->manager) && TASK_PRIVILEGED(task));
 }
 
+void
+isc_task_setbackground(isc_task_t *task, bool background) {
+	REQUIRE(VALID_TASK(task));
+
+	atomic_store_release(&task->background, background);
+}
+
+bool
+isc_task_getbackground(isc_task_t *task) {
+	REQUIRE(VALID_TASK(task));
+
+	return (atomic_load_acquire(&task->background));
+}
+
 bool
 isc_task_exiting(isc_task_t *task) {
 	REQUIRE(VALID_TASK(task));
@@ -1215,6 +1231,38 @@ isc_taskmgr_renderxml(isc_taskmgr_t *mgr, void *writer0) {
 					    mgr->default_quantum));
 	TRY0(xmlTextWriterEndElement(writer)); /* default-quantum */
 
+	if (mgr->netmgr != NULL) {
+		unsigned int nworkers = isc_nm_getnworkers(mgr->netmgr);
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "workers"));
+		for (unsigned int i = 0; i < nworkers; i++) {
+			uint32_t queued;
+			uint64_t stolen;
+
+			isc_nm_taskstats(mgr->netmgr, i, &queued, &stolen);
+
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "worker"));
+			TRY0(xmlTextWriterWriteFormatAttribute(
+				writer, ISC_XMLCHAR "id", "%u", i));
+
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "queued"));
+			TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu32,
+							    queued));
+			TRY0(xmlTextWriterEndElement(writer)); /* queued */
+
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "stolen"));
+			TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+							    stolen));
+			TRY0(xmlTextWriterEndElement(writer)); /* stolen */
+
+			TRY0(xmlTextWriterEndElement(writer)); /* worker */
+		}
+		TRY0(xmlTextWriterEndElement(writer)); /* workers */
+	}
+
 	TRY0(xmlTextWriterEndElement(writer)); /* thread-model */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks"));
@@ -1304,6 +1352,40 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr, void *tasks0) {
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "default-quantum", obj);
 
+	if (mgr->netmgr != NULL) {
+		unsigned int nworkers = isc_nm_getnworkers(mgr->netmgr);
+
+		array = json_object_new_array();
+		CHECKMEM(array);
+
+		for (unsigned int i = 0; i < nworkers; i++) {
+			json_object *workerobj = NULL;
+			uint32_t queued;
+			uint64_t stolen;
+
+			isc_nm_taskstats(mgr->netmgr, i, &queued, &stolen);
+
+			workerobj = json_object_new_object();
+			CHECKMEM(workerobj);
+			json_object_array_add(array, workerobj);
+
+			obj = json_object_new_int(i);
+			CHECKMEM(obj);
+			json_object_object_add(workerobj, "id", obj);
+
+			obj = json_object_new_int64(queued);
+			CHECKMEM(obj);
+			json_object_object_add(workerobj, "queued", obj);
+
+			obj = json_object_new_int64(stolen);
+			CHECKMEM(obj);
+			json_object_object_add(workerobj, "stolen", obj);
+		}
+
+		json_object_object_add(tasks, "workers", array);
+		array = NULL;
+	}
+
 	array = json_object_new_array();
 	CHECKMEM(array);
 
@@ -109,6 +109,27 @@ isc_thread_setname(isc_thread_t thread, const char *name) {
 #endif /* if defined(HAVE_PTHREAD_SETNAME_NP) && !defined(__APPLE__) */
 }
 
+isc_result_t
+isc_thread_setaffinity(isc_thread_t thread, int cpu) {
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(CPU_SET)
+	cpu_set_t set;
+
+	REQUIRE(cpu >= 0 && cpu < CPU_SETSIZE);
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0) {
+		return (ISC_R_FAILURE);
+	}
+	return (ISC_R_SUCCESS);
+#else  /* if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(CPU_SET) */
+	UNUSED(thread);
+	UNUSED(cpu);
+
+	return (ISC_R_NOTIMPLEMENTED);
+#endif /* if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(CPU_SET) */
+}
+
 void
 isc_thread_yield(void) {
 #if defined(HAVE_SCHED_YIELD)
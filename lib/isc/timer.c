@@ -16,21 +16,21 @@
 #include <stdbool.h>
 
 #include <isc/app.h>
-#include <isc/condition.h>
-#include <isc/heap.h>
+#include <isc/atomic.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/netmgr.h>
 #include <isc/once.h>
 #include <isc/print.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/task.h>
-#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
 
+#include "netmgr_p.h"
 #include "timer_p.h"
 
 #ifdef ISC_TIMER_TRACE
@@ -38,9 +38,6 @@
 #define XTRACEID(s, t) fprintf(stderr, "%s %p\n", (s), (t))
 #define XTRACETIME(s, d) \
 	fprintf(stderr, "%s %u.%09u\n", (s), (d).seconds, (d).nanoseconds)
-#define XTRACETIME2(s, d, n)                                      \
-	fprintf(stderr, "%s %u.%09u %u.%09u\n", (s), (d).seconds, \
-		(d).nanoseconds, (n).seconds, (n).nanoseconds)
 #define XTRACETIMER(s, t, d)                                      \
 	fprintf(stderr, "%s %p %u.%09u\n", (s), (t), (d).seconds, \
 		(d).nanoseconds)
@@ -48,30 +45,72 @@
 #define XTRACE(s)
 #define XTRACEID(s, t)
 #define XTRACETIME(s, d)
-#define XTRACETIME2(s, d, n)
 #define XTRACETIMER(s, t, d)
 #endif /* ISC_TIMER_TRACE */
 
+/*
+ * Every network manager worker runs the timers created on it (timers
+ * created elsewhere are spread over the workers) from a hierarchical
+ * timing wheel with a tick of one millisecond.  The first level has a
+ * slot for each of the next 256 ticks, and each of the other levels has
+ * 64 slots, each as long as a full turn of the level below.  A timer is
+ * put in the lowest level whose turn it fits in, and when a level
+ * completes a turn, the timers in the next slot of the level above are
+ * moved down.  Scheduling a timer, the frequent operation, is a list
+ * insertion, and only takes the lock of the wheel it belongs to.
+ *
+ * The worker sleeps until the next occupied slot of the first level,
+ * or the end of its turn.  If a timer is scheduled earlier than that
+ * from another thread, the worker is woken up with a netievent.
+ */
+#define WHEEL_LEVELS	5
+#define WHEEL_L0_BITS	8
+#define WHEEL_L0_SIZE	(1 << WHEEL_L0_BITS)
+#define WHEEL_L0_MASK	(WHEEL_L0_SIZE - 1)
+#define WHEEL_LN_BITS	6
+#define WHEEL_LN_SIZE	(1 << WHEEL_LN_BITS)
+#define WHEEL_LN_MASK	(WHEEL_LN_SIZE - 1)
+#define WHEEL_SHIFT(l)	(WHEEL_L0_BITS + ((l)-1) * WHEEL_LN_BITS)
+#define WHEEL_MAXTICKS	(UINT64_C(1) << WHEEL_SHIFT(WHEEL_LEVELS))
+#define WHEEL_BITMAPLEN (WHEEL_L0_SIZE / 64)
+
 #define TIMER_MAGIC    ISC_MAGIC('T', 'I', 'M', 'R')
 #define VALID_TIMER(t) ISC_MAGIC_VALID(t, TIMER_MAGIC)
 
+typedef ISC_LIST(isc_timer_t) timerlist_t;
+
+typedef struct timerwheel {
+	int tid;
+	isc_mutex_t lock;
+	/* Locked by wheel lock. */
+	uint64_t tick;	/* the next tick to run */
+	uint64_t armed; /* the worker will run by this tick */
+	unsigned int nscheduled;
+	uint64_t bitmap[WHEEL_BITMAPLEN]; /* the used slots of level 0 */
+	timerlist_t level0[WHEEL_L0_SIZE];
+	timerlist_t levels[WHEEL_LEVELS - 1][WHEEL_LN_SIZE];
+} timerwheel_t;
+
 struct isc_timer {
 	/*! Not locked. */
 	unsigned int magic;
 	isc_timermgr_t *manager;
+	timerwheel_t *wheel;
 	isc_mutex_t lock;
 	/*! Locked by timer lock. */
 	isc_time_t idle;
 	ISC_LIST(isc_timerevent_t) active;
-	/*! Locked by manager lock. */
+	/*! Locked by wheel lock. */
 	isc_timertype_t type;
 	isc_time_t expires;
 	isc_interval_t interval;
 	isc_task_t *task;
 	isc_taskaction_t action;
 	void *arg;
-	unsigned int index;
 	isc_time_t due;
+	uint64_t duetick;
+	int level; /* -1 if not scheduled */
+	unsigned int slot;
 	LINK(isc_timer_t) link;
 };
 
@@ -82,23 +121,141 @@ struct isc_timermgr {
 	/* Not locked. */
 	unsigned int magic;
 	isc_mem_t *mctx;
-	isc_mutex_t lock;
-	/* Locked by manager lock. */
-	bool done;
-	LIST(isc_timer_t) timers;
-	unsigned int nscheduled;
-	isc_time_t due;
-	isc_condition_t wakeup;
-	isc_thread_t thread;
-	isc_heap_t *heap;
+	isc_nm_t *netmgr;
+	atomic_uint_fast32_t ntimers;
+	atomic_uint_fast32_t nextwheel;
+	unsigned int nwheels;
+	timerwheel_t *wheels;
 };
 
 void
 isc_timermgr_poke(isc_timermgr_t *manager);
 
+/*
+ * Convert 'time' to wheel ticks, rounding up if 'roundup' is true.
+ */
+static uint64_t
+time_totick(const isc_time_t *time, bool roundup) {
+	uint64_t tick = (uint64_t)time->seconds * 1000 +
+			time->nanoseconds / 1000000;
+
+	if (roundup && time->nanoseconds % 1000000 != 0) {
+		tick++;
+	}
+
+	return (tick);
+}
+
+static timerlist_t *
+wheel_list(timerwheel_t *wheel, int level, unsigned int slot) {
+	if (level == 0) {
+		return (&wheel->level0[slot]);
+	}
+	return (&wheel->levels[level - 1][slot]);
+}
+
+static void
+wheel_insert(timerwheel_t *wheel, isc_timer_t *timer) {
+	uint64_t expires = timer->duetick;
+	uint64_t delta;
+
+	/*
+	 * A timer that is already due is run on the next tick.
+	 */
+	if (expires < wheel->tick) {
+		expires = wheel->tick;
+	}
+	delta = expires - wheel->tick;
+
+	if (delta < WHEEL_L0_SIZE) {
+		timer->level = 0;
+		timer->slot = expires & WHEEL_L0_MASK;
+		wheel->bitmap[timer->slot / 64] |= UINT64_C(1)
+						   << (timer->slot % 64);
+	} else {
+		/*
+		 * Timers further away than the top level reaches are put
+		 * in its last slot, and moved back up when they come
+		 * down from there.
+		 */
+		if (delta >= WHEEL_MAXTICKS) {
+			expires = wheel->tick + WHEEL_MAXTICKS - 1;
+			delta = WHEEL_MAXTICKS - 1;
+		}
+		timer->level = 1;
+		while (delta >= (UINT64_C(1) << WHEEL_SHIFT(timer->level + 1)))
+		{
+			timer->level++;
+		}
+		timer->slot = (expires >> WHEEL_SHIFT(timer->level)) &
+			      WHEEL_LN_MASK;
+	}
+
+	APPEND(*wheel_list(wheel, timer->level, timer->slot), timer, link);
+}
+
+static void
+wheel_remove(timerwheel_t *wheel, isc_timer_t *timer) {
+	timerlist_t *list = wheel_list(wheel, timer->level, timer->slot);
+
+	UNLINK(*list, timer, link);
+	if (timer->level == 0 && EMPTY(*list)) {
+		wheel->bitmap[timer->slot / 64] &= ~(UINT64_C(1)
+						     << (timer->slot % 64));
+	}
+	timer->level = -1;
+}
+
+/*
+ * Move the timers in the current slot of 'level' down to the levels
+ * below, and return the index of the slot.
+ */
+static unsigned int
+wheel_cascade(timerwheel_t *wheel, int level) {
+	unsigned int slot = (wheel->tick >> WHEEL_SHIFT(level)) &
+			    WHEEL_LN_MASK;
+	timerlist_t *list = wheel_list(wheel, level, slot);
+	isc_timer_t *timer = NULL;
+
+	while ((timer = HEAD(*list)) != NULL) {
+		UNLINK(*list, timer, link);
+		wheel_insert(wheel, timer);
+	}
+
+	return (slot);
+}
+
+/*
+ * Return the next tick the wheel has to run: the next occupied slot of
+ * level 0 in its current turn, or the end of the turn, when the timers
+ * from the levels above have to be moved down.
+ */
+static uint64_t
+wheel_next(const timerwheel_t *wheel) {
+	unsigned int slot = wheel->tick & WHEEL_L0_MASK;
+
+	if (slot == 0) {
+		return (wheel->tick);
+	}
+
+	for (unsigned int i = slot / 64; i < WHEEL_BITMAPLEN; i++) {
+		uint64_t bits = wheel->bitmap[i];
+
+		if (i == slot / 64) {
+			bits &= UINT64_MAX << (slot % 64);
+		}
+		if (bits != 0) {
+			return (wheel->tick - slot + i * 64 +
+				__builtin_ctzll(bits));
+		}
+	}
+
+	return ((wheel->tick | WHEEL_L0_MASK) + 1);
+}
+
 static inline isc_result_t
-schedule(isc_timer_t *timer, isc_time_t *now, bool signal_ok) {
-	isc_timermgr_t *manager;
+schedule(isc_timer_t *timer, isc_time_t *now, bool *pokep) {
+	timerwheel_t *wheel = timer->wheel;
 	isc_time_t due;
 
 	/*!
@@ -107,8 +264,6 @@ schedule(isc_timer_t *timer, isc_time_t *now, bool signal_ok) {
 
 	REQUIRE(timer->type != isc_timertype_inactive);
 
-	manager = timer->manager;
-
 	/*
 	 * Compute the new due time.
 	 */
@@ -139,41 +294,35 @@ schedule(isc_timer_t *timer, isc_time_t *now, bool signal_ok) {
 	 * Schedule the timer.
 	 */
 
-	if (timer->index > 0) {
-		/*
-		 * Already scheduled.
-		 */
-		int cmp = isc_time_compare(&due, &timer->due);
-		timer->due = due;
-		switch (cmp) {
-		case -1:
-			isc_heap_increased(manager->heap, timer->index);
-			break;
-		case 1:
-			isc_heap_decreased(manager->heap, timer->index);
-			break;
-		case 0:
-			/* Nothing to do. */
-			break;
-		}
+	if (timer->level >= 0) {
+		wheel_remove(wheel, timer);
 	} else {
-		timer->due = due;
-		isc_heap_insert(manager->heap, timer);
-		manager->nscheduled++;
+		wheel->nscheduled++;
 	}
 
+	/*
+	 * An empty wheel may not have run for a long time; catch up
+	 * with the clock instead of running the ticks in between.
+	 */
+	if (wheel->nscheduled == 1) {
+		wheel->tick = time_totick(now, false);
+	}
+
+	timer->due = due;
+	timer->duetick = time_totick(&due, true);
+	wheel_insert(wheel, timer);
+
 	XTRACETIMER("schedule", timer, due);
 
 	/*
-	 * If this timer is at the head of the queue, we need to ensure
-	 * that we won't miss it if it has a more recent due time than
-	 * the current "next" timer.  We do this either by waking up the
-	 * run thread, or explicitly setting the value in the manager.
+	 * If this timer is due before the worker wakes up, it has to be
+	 * woken up earlier.
 	 */
-
-	if (timer->index == 1 && signal_ok) {
-		XTRACE("signal (schedule)");
-		SIGNAL(&manager->wakeup);
+	if (timer->duetick < wheel->armed) {
+		wheel->armed = timer->duetick;
+		if (pokep != NULL) {
+			*pokep = true;
+		}
 	}
 
 	return (ISC_R_SUCCESS);
@@ -181,29 +330,25 @@ schedule(isc_timer_t *timer, isc_time_t *now, bool signal_ok) {
 
 static inline void
 deschedule(isc_timer_t *timer) {
-	isc_timermgr_t *manager;
+	timerwheel_t *wheel = timer->wheel;
 
 	/*
 	 * The caller must ensure locking.
 	 */
 
-	manager = timer->manager;
-	if (timer->index > 0) {
-		bool need_wakeup = false;
-		if (timer->index == 1) {
-			need_wakeup = true;
-		}
-		isc_heap_delete(manager->heap, timer->index);
-		timer->index = 0;
-		INSIST(manager->nscheduled > 0);
-		manager->nscheduled--;
-		if (need_wakeup) {
-			XTRACE("signal (deschedule)");
-			SIGNAL(&manager->wakeup);
-		}
+	if (timer->level >= 0) {
+		wheel_remove(wheel, timer);
+		INSIST(wheel->nscheduled > 0);
+		wheel->nscheduled--;
 	}
 }
 
+static void
+poke(isc_timer_t *timer) {
+	XTRACEID("poke", timer);
+	isc__netmgr_poketimers(timer->manager->netmgr, timer->wheel->tid);
+}
+
 static void
 timerevent_unlink(isc_timer_t *timer, isc_timerevent_t *event) {
 	REQUIRE(ISC_LINK_LINKED(event, ev_timerlink));
@@ -249,6 +394,8 @@ isc_timer_create(isc_timermgr_t *manager, isc_timertype_t type,
 	isc_timer_t *timer;
 	isc_result_t result;
 	isc_time_t now;
+	bool need_poke = false;
+	int tid;
 
 	/*
 	 * Create a new 'type' timer managed by 'manager'.  The timers
@@ -287,6 +434,17 @@ isc_timer_create(isc_timermgr_t *manager, isc_timertype_t type,
 
 	timer->manager = manager;
 
+	/*
+	 * The timer is run by the worker it is created on; timers created
+	 * by other threads are spread over all the workers.
+	 */
+	tid = isc_nm_tid();
+	if (tid < 0 || (unsigned int)tid >= manager->nwheels) {
+		tid = atomic_fetch_add_relaxed(&manager->nextwheel, 1) %
+		      manager->nwheels;
+	}
+	timer->wheel = &manager->wheels[tid];
+
 	if (type == isc_timertype_once && !isc_interval_iszero(interval)) {
 		result = isc_time_add(&now, interval, &timer->idle);
 		if (result != ISC_R_SUCCESS) {
@@ -314,7 +472,7 @@ isc_timer_create(isc_timermgr_t *manager, isc_timertype_t type,
 	 * keep track of whether arg started as a true const.
 	 */
 	DE_CONST(arg, timer->arg);
-	timer->index = 0;
+	timer->level = -1;
 	isc_mutex_init(&timer->lock);
 	ISC_LINK_INIT(timer, link);
 
@@ -322,24 +480,18 @@ isc_timer_create(isc_timermgr_t *manager, isc_timertype_t type,
 
 	timer->magic = TIMER_MAGIC;
 
-	LOCK(&manager->lock);
-
 	/*
 	 * Note we don't have to lock the timer like we normally would because
 	 * there are no external references to it yet.
 	 */
 
 	if (type != isc_timertype_inactive) {
-		result = schedule(timer, &now, true);
+		LOCK(&timer->wheel->lock);
+		result = schedule(timer, &now, &need_poke);
+		UNLOCK(&timer->wheel->lock);
 	} else {
 		result = ISC_R_SUCCESS;
 	}
-	if (result == ISC_R_SUCCESS) {
-		*timerp = timer;
-		APPEND(manager->timers, timer, link);
-	}
-
-	UNLOCK(&manager->lock);
 
 	if (result != ISC_R_SUCCESS) {
 		timer->magic = 0;
@@ -349,6 +501,13 @@ isc_timer_create(isc_timermgr_t *manager, isc_timertype_t type,
 		return (result);
 	}
 
+	atomic_fetch_add_relaxed(&manager->ntimers, 1);
+	*timerp = timer;
+
+	if (need_poke) {
+		poke(timer);
+	}
+
 	return (ISC_R_SUCCESS);
 }
 
@@ -359,6 +518,7 @@ isc_timer_reset(isc_timer_t *timer, isc_timertype_t type,
 	isc_time_t now;
 	isc_timermgr_t *manager;
 	isc_result_t result;
+	bool need_poke = false;
 
 	/*
 	 * Change the timer's type, expires, and interval values to the given
@@ -395,7 +555,7 @@ isc_timer_reset(isc_timer_t *timer, isc_timertype_t type,
 		isc_time_settoepoch(&now);
 	}
 
-	LOCK(&manager->lock);
+	LOCK(&timer->wheel->lock);
 	LOCK(&timer->lock);
 
 	if (purge) {
@@ -416,12 +576,16 @@ isc_timer_reset(isc_timer_t *timer, isc_timertype_t type,
 			deschedule(timer);
 			result = ISC_R_SUCCESS;
 		} else {
-			result = schedule(timer, &now, true);
+			result = schedule(timer, &now, &need_poke);
 		}
 	}
 
 	UNLOCK(&timer->lock);
-	UNLOCK(&manager->lock);
+	UNLOCK(&timer->wheel->lock);
+
+	if (need_poke) {
+		poke(timer);
+	}
 
 	return (result);
 }
@@ -457,7 +621,7 @@ isc_timer_touch(isc_timer_t *timer) {
 	 *
 	 *	REQUIRE(timer->type == isc_timertype_once);
 	 *
-	 * but we cannot without locking the manager lock too, which we
+	 * but we cannot without locking the wheel lock too, which we
 	 * don't want to do.
 	 */
 
@@ -481,16 +645,14 @@ isc_timer_destroy(isc_timer_t **timerp) {
 
 	manager = timer->manager;
 
-	LOCK(&manager->lock);
-
+	LOCK(&timer->wheel->lock);
 	LOCK(&timer->lock);
 	timer_purge(timer);
 	deschedule(timer);
 	UNLOCK(&timer->lock);
+	UNLOCK(&timer->wheel->lock);
 
-	UNLINK(manager->timers, timer, link);
-
-	UNLOCK(&manager->lock);
+	INSIST(atomic_fetch_sub_relaxed(&manager->ntimers, 1) > 0);
 
 	isc_task_detach(&timer->task);
 	isc_mutex_destroy(&timer->lock);
@@ -522,149 +684,149 @@ timer_post_event(isc_timermgr_t *manager, isc_timer_t *timer,
 }
 
 static void
-dispatch(isc_timermgr_t *manager, isc_time_t *now) {
-	bool done = false, post_event, need_schedule;
+dispatch(isc_timermgr_t *manager, isc_timer_t *timer, isc_time_t *now) {
+	bool post_event, need_schedule;
 	isc_eventtype_t type = 0;
-	isc_timer_t *timer;
 	isc_result_t result;
 	bool idle;
 
 	/*!
-	 * The caller must be holding the manager lock.
+	 * The caller must be holding the wheel lock.
 	 */
 
-	while (manager->nscheduled > 0 && !done) {
-		timer = isc_heap_element(manager->heap, 1);
-		INSIST(timer != NULL && timer->type != isc_timertype_inactive);
-		if (isc_time_compare(now, &timer->due) >= 0) {
-			if (timer->type == isc_timertype_ticker) {
-				type = ISC_TIMEREVENT_TICK;
-				post_event = true;
-				need_schedule = true;
-			} else if (timer->type == isc_timertype_limited) {
-				int cmp;
-				cmp = isc_time_compare(now, &timer->expires);
-				if (cmp >= 0) {
-					type = ISC_TIMEREVENT_LIFE;
-					post_event = true;
-					need_schedule = false;
-				} else {
-					type = ISC_TIMEREVENT_TICK;
-					post_event = true;
-					need_schedule = true;
-				}
-			} else if (!isc_time_isepoch(&timer->expires) &&
-				   isc_time_compare(now, &timer->expires) >= 0)
-			{
-				type = ISC_TIMEREVENT_LIFE;
-				post_event = true;
-				need_schedule = false;
-			} else {
-				idle = false;
-
-				LOCK(&timer->lock);
-				if (!isc_time_isepoch(&timer->idle) &&
-				    isc_time_compare(now, &timer->idle) >= 0)
-				{
-					idle = true;
-				}
-				UNLOCK(&timer->lock);
-				if (idle) {
-					type = ISC_TIMEREVENT_IDLE;
-					post_event = true;
-					need_schedule = false;
-				} else {
-					/*
-					 * Idle timer has been touched;
-					 * reschedule.
-					 */
-					XTRACEID("idle reschedule", timer);
-					post_event = false;
-					need_schedule = true;
-				}
-			}
+	INSIST(timer->type != isc_timertype_inactive);
+
+	if (timer->type == isc_timertype_ticker) {
+		type = ISC_TIMEREVENT_TICK;
+		post_event = true;
+		need_schedule = true;
+	} else if (timer->type == isc_timertype_limited) {
+		int cmp;
+		cmp = isc_time_compare(now, &timer->expires);
+		if (cmp >= 0) {
+			type = ISC_TIMEREVENT_LIFE;
+			post_event = true;
+			need_schedule = false;
+		} else {
+			type = ISC_TIMEREVENT_TICK;
+			post_event = true;
+			need_schedule = true;
+		}
+	} else if (!isc_time_isepoch(&timer->expires) &&
+		   isc_time_compare(now, &timer->expires) >= 0)
+	{
+		type = ISC_TIMEREVENT_LIFE;
+		post_event = true;
+		need_schedule = false;
+	} else {
+		idle = false;
 
-			if (post_event) {
-				timer_post_event(manager, timer, type);
-			}
+		LOCK(&timer->lock);
+		if (!isc_time_isepoch(&timer->idle) &&
+		    isc_time_compare(now, &timer->idle) >= 0)
+		{
+			idle = true;
+		}
+		UNLOCK(&timer->lock);
+		if (idle) {
+			type = ISC_TIMEREVENT_IDLE;
+			post_event = true;
+			need_schedule = false;
+		} else {
+			/*
+			 * Idle timer has been touched;
+			 * reschedule.
+			 */
+			XTRACEID("idle reschedule", timer);
+			post_event = false;
+			need_schedule = true;
+		}
+	}
 
-			timer->index = 0;
-			isc_heap_delete(manager->heap, 1);
-			manager->nscheduled--;
+	if (post_event) {
+		timer_post_event(manager, timer, type);
+	}
 
-			if (need_schedule) {
-				result = schedule(timer, now, false);
-				if (result != ISC_R_SUCCESS) {
-					UNEXPECTED_ERROR(
-						"couldn't schedule timer: %s",
-						isc_result_totext(result));
-				}
-			}
-		} else {
-			manager->due = timer->due;
-			done = true;
+	if (need_schedule) {
+		result = schedule(timer, now, NULL);
+		if (result != ISC_R_SUCCESS) {
+			UNEXPECTED_ERROR("couldn't schedule timer: %s",
+					 isc_result_totext(result));
 		}
 	}
 }
 
-static isc_threadresult_t
-run(void *uap) {
-	isc_timermgr_t *manager = uap;
+/*
+ * Run the timers of worker 'tid' that are due, and return the number of
+ * milliseconds until the worker has to run them again.
+ */
+static uint64_t
+run(void *arg, int tid) {
+	isc_timermgr_t *manager = arg;
+	timerwheel_t *wheel = NULL;
 	isc_time_t now;
-	isc_result_t result;
+	uint64_t nowtick, timeout = UINT64_MAX;
 
-	LOCK(&manager->lock);
-	while (!manager->done) {
-		TIME_NOW(&now);
+	REQUIRE(VALID_MANAGER(manager));
+	REQUIRE(tid >= 0 && (unsigned int)tid < manager->nwheels);
 
-		XTRACETIME("running", now);
+	wheel = &manager->wheels[tid];
 
-		dispatch(manager, &now);
+	TIME_NOW(&now);
+	nowtick = time_totick(&now, false);
 
-		if (manager->nscheduled > 0) {
-			XTRACETIME2("waituntil", manager->due, now);
-			result = WAITUNTIL(&manager->wakeup, &manager->lock,
-					   &manager->due);
-			INSIST(result == ISC_R_SUCCESS ||
-			       result == ISC_R_TIMEDOUT);
-		} else {
-			XTRACETIME("wait", now);
-			WAIT(&manager->wakeup, &manager->lock);
-		}
-		XTRACE("wakeup");
-	}
-	UNLOCK(&manager->lock);
+	XTRACETIME("running", now);
 
-	return ((isc_threadresult_t)0);
-}
+	LOCK(&wheel->lock);
+	while (wheel->nscheduled > 0 && wheel->tick <= nowtick) {
+		unsigned int slot = wheel->tick & WHEEL_L0_MASK;
+		timerlist_t list;
+		isc_timer_t *timer = NULL;
 
-static bool
-sooner(void *v1, void *v2) {
-	isc_timer_t *t1, *t2;
+		if (slot == 0) {
+			for (int level = 1; level < WHEEL_LEVELS; level++) {
+				if (wheel_cascade(wheel, level) != 0) {
+					break;
+				}
+			}
+		}
 
-	t1 = v1;
-	t2 = v2;
-	REQUIRE(VALID_TIMER(t1));
-	REQUIRE(VALID_TIMER(t2));
+		/*
+		 * Timers rescheduled by dispatch() go to the slots after
+		 * this one, even if they are due right away.
+		 */
+		list = wheel->level0[slot];
+		INIT_LIST(wheel->level0[slot]);
+		wheel->bitmap[slot / 64] &= ~(UINT64_C(1) << (slot % 64));
+		wheel->tick++;
+
+		while ((timer = HEAD(list)) != NULL) {
+			UNLINK(list, timer, link);
+			timer->level = -1;
+			INSIST(wheel->nscheduled > 0);
+			wheel->nscheduled--;
+			dispatch(manager, timer, &now);
+		}
 
-	if (isc_time_compare(&t1->due, &t2->due) < 0) {
-		return (true);
+		if (wheel->tick <= nowtick) {
+			wheel->tick = ISC_MIN(wheel_next(wheel), nowtick + 1);
+		}
 	}
-	return (false);
-}
 
-static void
-set_index(void *what, unsigned int index) {
-	isc_timer_t *timer;
-
-	REQUIRE(VALID_TIMER(what));
-	timer = what;
+	if (wheel->nscheduled > 0) {
+		wheel->armed = ISC_MAX(wheel_next(wheel), nowtick);
+		timeout = wheel->armed - nowtick;
+	} else {
+		wheel->armed = UINT64_MAX;
+	}
+	UNLOCK(&wheel->lock);
 
-	timer->index = index;
+	return (timeout);
 }
 
 isc_result_t
-isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
+isc__timermgr_create(isc_mem_t *mctx, isc_nm_t *netmgr,
+		     isc_timermgr_t **managerp) {
 	isc_timermgr_t *manager;
 
 	/*
@@ -672,22 +834,41 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	 */
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
+	REQUIRE(netmgr != NULL);
 
 	manager = isc_mem_get(mctx, sizeof(*manager));
+	*manager = (isc_timermgr_t){
+		.nwheels = isc_nm_getnworkers(netmgr),
+	};
 
-	manager->magic = TIMER_MANAGER_MAGIC;
-	manager->mctx = NULL;
-	manager->done = false;
-	INIT_LIST(manager->timers);
-	manager->nscheduled = 0;
-	isc_time_settoepoch(&manager->due);
-	manager->heap = NULL;
-	isc_heap_create(mctx, sooner, set_index, 0, &manager->heap);
-	isc_mutex_init(&manager->lock);
 	isc_mem_attach(mctx, &manager->mctx);
-	isc_condition_init(&manager->wakeup);
-	isc_thread_create(run, manager, &manager->thread);
-	isc_thread_setname(manager->thread, "isc-timer");
+	isc_nm_attach(netmgr, &manager->netmgr);
+	atomic_init(&manager->ntimers, 0);
+	atomic_init(&manager->nextwheel, 0);
+
+	manager->wheels = isc_mem_get(
+		mctx, manager->nwheels * sizeof(manager->wheels[0]));
+	for (unsigned int i = 0; i < manager->nwheels; i++) {
+		timerwheel_t *wheel = &manager->wheels[i];
+
+		*wheel = (timerwheel_t){
+			.tid = i,
+			.armed = UINT64_MAX,
+		};
+		isc_mutex_init(&wheel->lock);
+		for (size_t j = 0; j < WHEEL_L0_SIZE; j++) {
+			INIT_LIST(wheel->level0[j]);
+		}
+		for (size_t l = 0; l < WHEEL_LEVELS - 1; l++) {
+			for (size_t j = 0; j < WHEEL_LN_SIZE; j++) {
+				INIT_LIST(wheel->levels[l][j]);
+			}
+		}
+	}
+
+	manager->magic = TIMER_MANAGER_MAGIC;
+
+	isc__netmgr_settimercb(netmgr, run, manager);
 
 	*managerp = manager;
 
@@ -698,7 +879,9 @@ void
 isc_timermgr_poke(isc_timermgr_t *manager) {
 	REQUIRE(VALID_MANAGER(manager));
 
-	SIGNAL(&manager->wakeup);
+	for (unsigned int i = 0; i < manager->nwheels; i++) {
+		isc__netmgr_poketimers(manager->netmgr, i);
+	}
 }
 
 void
@@ -713,27 +896,23 @@ isc__timermgr_destroy(isc_timermgr_t **managerp) {
 	manager = *managerp;
 	REQUIRE(VALID_MANAGER(manager));
 
-	LOCK(&manager->lock);
-
-	REQUIRE(EMPTY(manager->timers));
-	manager->done = true;
-
-	XTRACE("signal (destroy)");
-	SIGNAL(&manager->wakeup);
-
-	UNLOCK(&manager->lock);
+	REQUIRE(atomic_load(&manager->ntimers) == 0);
 
 	/*
-	 * Wait for thread to exit.
+	 * Make sure no worker runs the timers anymore.
 	 */
-	isc_thread_join(manager->thread, NULL);
+	isc__netmgr_settimercb(manager->netmgr, NULL, NULL);
 
 	/*
 	 * Clean up.
 	 */
-	(void)isc_condition_destroy(&manager->wakeup);
-	isc_mutex_destroy(&manager->lock);
-	isc_heap_destroy(&manager->heap);
+	for (unsigned int i = 0; i < manager->nwheels; i++) {
+		INSIST(manager->wheels[i].nscheduled == 0);
+		isc_mutex_destroy(&manager->wheels[i].lock);
+	}
+	isc_mem_put(manager->mctx, manager->wheels,
+		    manager->nwheels * sizeof(manager->wheels[0]));
+	isc_nm_detach(&manager->netmgr);
 	manager->magic = 0;
 	isc_mem_putanddetach(&manager->mctx, manager, sizeof(*manager));
 
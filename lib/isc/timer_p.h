@@ -18,9 +18,11 @@
 #include <isc/timer.h>
 
 isc_result_t
-isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp);
+isc__timermgr_create(isc_mem_t *mctx, isc_nm_t *netmgr,
+		     isc_timermgr_t **managerp);
 /*%<
- * Create a timer manager.
+ * Create a timer manager, whose timers are run by the workers of
+ * 'netmgr'.
  *
  * Notes:
  *
@@ -30,6 +32,8 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp);
  *
  *\li	'mctx' is a valid memory context.
  *
+ *\li	'netmgr' is a valid network manager.
+ *
  *\li	'managerp' points to a NULL isc_timermgr_t.
  *
  * Ensures:
@@ -50,10 +54,8 @@ isc__timermgr_destroy(isc_timermgr_t **managerp);
  *
  * Notes:
  *
- *\li	This routine blocks until there are no timers left in the manager,
- *	so if the caller holds any timer references using the manager, it
- *	must detach them before calling isc_timermgr_destroy() or it will
- *	block forever.
+ *\li	The network manager must still be running, and there must be no
+ *	timers left in the manager.
  *
  * Requires:
  *
@@ -23,6 +23,9 @@
 
 #include <openssl/bn.h>
 #include <openssl/conf.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
 #include <openssl/crypto.h>
 #include <openssl/dh.h>
 #include <openssl/err.h>
@@ -43,7 +46,9 @@
 #include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/rwlock.h>
+#include <isc/safe.h>
 #include <isc/sockaddr.h>
+#include <isc/stdtime.h>
 #include <isc/thread.h>
 #include <isc/tls.h>
 #include <isc/util.h>
@@ -59,6 +64,26 @@ static isc_once_t shut_once = ISC_ONCE_INIT;
 static atomic_bool init_done = false;
 static atomic_bool shut_done = false;
 
+/*%
+ * Session ticket keys.  They are shared by all the server contexts, so a
+ * ticket issued by any of them (on any thread, or before the contexts were
+ * recreated on reconfiguration) can be used to resume the session.  New
+ * tickets are protected with the current key; tickets protected with the
+ * previous key are still accepted, and are renewed.
+ */
+#define TICKET_KEY_NAME_LEN 16
+#define TICKET_KEY_LEN	    32
+
+typedef struct tls_ticket_key {
+	unsigned char name[TICKET_KEY_NAME_LEN];
+	unsigned char aes_key[TICKET_KEY_LEN];
+	unsigned char hmac_key[TICKET_KEY_LEN];
+	isc_stdtime_t created;
+} tls_ticket_key_t;
+
+static isc_rwlock_t ticket_keys_lock;
+static tls_ticket_key_t ticket_keys[2]; /* current, previous */
+
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
 static isc_mutex_t *locks = NULL;
 static int nlocks;
@@ -80,6 +105,14 @@ isc__tls_set_thread_id(CRYPTO_THREADID *id) {
 }
 #endif
 
+static void
+ticket_key_generate(tls_ticket_key_t *key) {
+	RUNTIME_CHECK(RAND_bytes(key->name, sizeof(key->name)) == 1);
+	RUNTIME_CHECK(RAND_bytes(key->aes_key, sizeof(key->aes_key)) == 1);
+	RUNTIME_CHECK(RAND_bytes(key->hmac_key, sizeof(key->hmac_key)) == 1);
+	isc_stdtime_get(&key->created);
+}
+
 static void
 tls_initialize(void) {
 	REQUIRE(!atomic_load(&init_done));
@@ -127,6 +160,10 @@ tls_initialize(void) {
 			    "seeded' message in the OpenSSL FAQ)");
 	}
 
+	isc_rwlock_init(&ticket_keys_lock, 0, 0);
+	ticket_key_generate(&ticket_keys[1]);
+	ticket_key_generate(&ticket_keys[0]);
+
 	atomic_compare_exchange_enforced(&init_done, &(bool){ false }, true);
 }
 
@@ -142,6 +179,9 @@ tls_shutdown(void) {
 	REQUIRE(atomic_load(&init_done));
 	REQUIRE(!atomic_load(&shut_done));
 
+	isc_safe_memwipe(ticket_keys, sizeof(ticket_keys));
+	isc_rwlock_destroy(&ticket_keys_lock);
+
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
 	OPENSSL_cleanup();
 #else
@@ -287,6 +327,135 @@ isc_tlsctx_load_certificate(isc_tlsctx_t *ctx, const char *keyfile,
 	return (ISC_R_SUCCESS);
 }
 
+void
+isc_tls_ticket_keys_rotate(void) {
+	RWLOCK(&ticket_keys_lock, isc_rwlocktype_write);
+	ticket_keys[1] = ticket_keys[0];
+	ticket_key_generate(&ticket_keys[0]);
+	RWUNLOCK(&ticket_keys_lock, isc_rwlocktype_write);
+}
+
+/*
+ * Get a copy of the key to protect a new ticket with, rotating the keys
+ * first when the current one has expired.
+ */
+static void
+ticket_key_current(tls_ticket_key_t *key) {
+	isc_stdtime_t now;
+
+	isc_stdtime_get(&now);
+
+	RWLOCK(&ticket_keys_lock, isc_rwlocktype_read);
+	if (now - ticket_keys[0].created >= ISC_TLS_TICKET_KEY_LIFETIME) {
+		RWUNLOCK(&ticket_keys_lock, isc_rwlocktype_read);
+		RWLOCK(&ticket_keys_lock, isc_rwlocktype_write);
+		/* Another thread might have already done it. */
+		if (now - ticket_keys[0].created >=
+		    ISC_TLS_TICKET_KEY_LIFETIME)
+		{
+			ticket_keys[1] = ticket_keys[0];
+			ticket_key_generate(&ticket_keys[0]);
+		}
+		*key = ticket_keys[0];
+		RWUNLOCK(&ticket_keys_lock, isc_rwlocktype_write);
+		return;
+	}
+	*key = ticket_keys[0];
+	RWUNLOCK(&ticket_keys_lock, isc_rwlocktype_read);
+}
+
+/*
+ * Get a copy of the key named 'name'.  Returns 1 for the current key, 2 for
+ * the previous one (meaning that the ticket should be renewed) and 0 when
+ * the key is not known (anymore).
+ */
+static int
+ticket_key_find(const unsigned char *name, tls_ticket_key_t *key) {
+	int ret = 0;
+
+	RWLOCK(&ticket_keys_lock, isc_rwlocktype_read);
+	for (size_t i = 0; i < ARRAY_SIZE(ticket_keys); i++) {
+		if (memcmp(name, ticket_keys[i].name, TICKET_KEY_NAME_LEN) ==
+		    0)
+		{
+			*key = ticket_keys[i];
+			ret = (i == 0) ? 1 : 2;
+			break;
+		}
+	}
+	RWUNLOCK(&ticket_keys_lock, isc_rwlocktype_read);
+
+	return (ret);
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int
+ticket_key_mac_init(EVP_MAC_CTX *hctx, tls_ticket_key_t *key) {
+	OSSL_PARAM params[3];
+
+	params[0] = OSSL_PARAM_construct_octet_string(
+		OSSL_MAC_PARAM_KEY, key->hmac_key, sizeof(key->hmac_key));
+	params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+						     (char *)"SHA256", 0);
+	params[2] = OSSL_PARAM_construct_end();
+
+	return (EVP_MAC_CTX_set_params(hctx, params));
+}
+
+static int
+ticket_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv,
+	      EVP_CIPHER_CTX *cctx, EVP_MAC_CTX *hctx, int enc)
+#else  /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+static int
+ticket_key_mac_init(HMAC_CTX *hctx, tls_ticket_key_t *key) {
+	return (HMAC_Init_ex(hctx, key->hmac_key, sizeof(key->hmac_key),
+			     EVP_sha256(), NULL));
+}
+
+static int
+ticket_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv,
+	      EVP_CIPHER_CTX *cctx, HMAC_CTX *hctx, int enc)
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+{
+	const EVP_CIPHER *cipher = EVP_aes_256_cbc();
+	tls_ticket_key_t key;
+	int ret = 1;
+
+	UNUSED(ssl);
+
+	if (enc) {
+		ticket_key_current(&key);
+		if (RAND_bytes(iv, EVP_CIPHER_iv_length(cipher)) != 1) {
+			ret = -1;
+			goto cleanup;
+		}
+		memmove(key_name, key.name, TICKET_KEY_NAME_LEN);
+		if (EVP_EncryptInit_ex(cctx, cipher, NULL, key.aes_key, iv) !=
+			    1 ||
+		    ticket_key_mac_init(hctx, &key) != 1)
+		{
+			ret = -1;
+		}
+	} else {
+		ret = ticket_key_find(key_name, &key);
+		if (ret == 0) {
+			/* Unknown or expired key, do a full handshake */
+			return (0);
+		}
+		if (ticket_key_mac_init(hctx, &key) != 1 ||
+		    EVP_DecryptInit_ex(cctx, cipher, NULL, key.aes_key, iv) !=
+			    1)
+		{
+			ret = -1;
+		}
+	}
+
+cleanup:
+	isc_safe_memwipe(&key, sizeof(key));
+
+	return (ret);
+}
+
 isc_result_t
 isc_tlsctx_createserver(const char *keyfile, const char *certfile,
 			isc_tlsctx_t **ctxp) {
@@ -484,6 +653,12 @@ isc_tlsctx_createserver(const char *keyfile, const char *certfile,
 
 	sslkeylogfile_init(ctx);
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticket_key_cb);
+#else  /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+	SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticket_key_cb);
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+
 	*ctxp = ctx;
 	return (ISC_R_SUCCESS);
 
@@ -1670,3 +1845,30 @@ isc_tlsctx_set_random_session_id_context(isc_tlsctx_t *ctx) {
 	RUNTIME_CHECK(
 		SSL_CTX_set_session_id_context(ctx, session_id_ctx, len) == 1);
 }
+
+void
+isc_tlsctx_set_session_id_context(isc_tlsctx_t *ctx, const char *name,
+				  const char *ca_file) {
+	unsigned char session_id_ctx[EVP_MAX_MD_SIZE];
+	unsigned int len = 0;
+	EVP_MD_CTX *mdctx = NULL;
+
+	REQUIRE(ctx != NULL);
+	REQUIRE(name != NULL);
+
+	mdctx = EVP_MD_CTX_new();
+	RUNTIME_CHECK(mdctx != NULL);
+	RUNTIME_CHECK(EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL) == 1);
+	/* Include the terminating NUL to keep the two fields apart */
+	RUNTIME_CHECK(EVP_DigestUpdate(mdctx, name, strlen(name) + 1) == 1);
+	if (ca_file != NULL) {
+		RUNTIME_CHECK(EVP_DigestUpdate(mdctx, ca_file,
+					       strlen(ca_file)) == 1);
+	}
+	RUNTIME_CHECK(EVP_DigestFinal_ex(mdctx, session_id_ctx, &len) == 1);
+	EVP_MD_CTX_free(mdctx);
+
+	len = ISC_MIN(len, SSL_MAX_SID_CTX_LENGTH);
+	RUNTIME_CHECK(
+		SSL_CTX_set_session_id_context(ctx, session_id_ctx, len) == 1);
+}
@@ -17,6 +17,7 @@
 #include <stdlib.h>
 #include <uv.h>
 
+#include <isc/iterated_hash.h>
 #include <isc/mem.h>
 #include <isc/once.h>
 #include <isc/thread.h>
@@ -188,6 +189,8 @@ isc__trampoline_run(isc_threadarg_t arg) {
 	/* Run the main function */
 	result = (trampoline->start)(trampoline->arg);
 
+	isc__iterated_hash_shutdown();
+
 	isc__trampoline_detach(trampoline);
 
 	return (result);
@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/ht.h>
 #include <isc/lex.h>
 #include <isc/netaddr.h>
 #include <isc/region.h>
@@ -176,10 +177,14 @@ struct cfg_obj {
 		cfg_map_t	 map;
 		cfg_list_t	 list;
 		cfg_obj_t      **tuple;
-		isc_sockaddr_t	 sockaddr;
+		/*
+		 * Socket addresses are allocated separately so that they
+		 * do not inflate every other kind of object.
+		 */
+		isc_sockaddr_t *sockaddr;
 		struct {
-			isc_sockaddr_t sockaddr;
-			int32_t	       dscp;
+			isc_sockaddr_t *sockaddr;
+			int32_t		dscp;
 		} sockaddrdscp;
 		cfg_netprefix_t	  netprefix;
 		isccfg_duration_t duration;
@@ -255,6 +260,12 @@ struct cfg_parser {
 
 	cfg_parsecallback_t callback;
 	void		   *callbackarg;
+
+	/*%
+	 * Map clauses already looked up, by clause set array and
+	 * lowercased name.
+	 */
+	isc_ht_t *clauses;
 };
 
 /* Parser context flags */
@@ -92,6 +92,7 @@ static cfg_type_t cfg_type_bracketed_namesockaddrkeylist;
 static cfg_type_t cfg_type_bracketed_netaddrlist;
 static cfg_type_t cfg_type_bracketed_sockaddrnameportlist;
 static cfg_type_t cfg_type_bracketed_http_endpoint_list;
+static cfg_type_t cfg_type_cacheeviction;
 static cfg_type_t cfg_type_controls;
 static cfg_type_t cfg_type_controls_sockaddr;
 static cfg_type_t cfg_type_destinationlist;
@@ -1212,6 +1213,7 @@ static cfg_type_t cfg_type_fstrm_model = {
  * Clauses that can be found within the 'options' statement.
  */
 static cfg_clausedef_t options_clauses[] = {
+	{ "adaptive-recursive-clients", &cfg_type_boolean, 0 },
 	{ "answer-cookie", &cfg_type_boolean, 0 },
 	{ "automatic-interface-scan", &cfg_type_boolean, 0 },
 	{ "avoid-v4-udp-ports", &cfg_type_bracketed_portlist,
@@ -1220,9 +1222,12 @@ static cfg_clausedef_t options_clauses[] = {
 	  CFG_CLAUSEFLAG_DEPRECATED },
 	{ "bindkeys-file", &cfg_type_qstring, 0 },
 	{ "blackhole", &cfg_type_bracketed_aml, 0 },
+	{ "client-ipv4-prefix-length", &cfg_type_uint32, 0 },
+	{ "client-ipv6-prefix-length", &cfg_type_uint32, 0 },
 	{ "cookie-algorithm", &cfg_type_cookiealg, 0 },
 	{ "cookie-secret", &cfg_type_sstring, CFG_CLAUSEFLAG_MULTI },
 	{ "coresize", &cfg_type_size, CFG_CLAUSEFLAG_DEPRECATED },
+	{ "cpu-affinity", &cfg_type_boolean, 0 },
 	{ "datasize", &cfg_type_size, CFG_CLAUSEFLAG_DEPRECATED },
 	{ "deallocate-on-exit", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "directory", &cfg_type_qstring, CFG_CLAUSEFLAG_CALLBACK },
@@ -1280,12 +1285,14 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "hostname", &cfg_type_qstringornone, 0 },
 	{ "interface-interval", &cfg_type_duration, 0 },
 	{ "keep-response-order", &cfg_type_bracketed_aml, 0 },
+	{ "lazy-load-zones", &cfg_type_boolean, 0 },
 	{ "listen-on", &cfg_type_listenon, CFG_CLAUSEFLAG_MULTI },
 	{ "listen-on-v6", &cfg_type_listenon, CFG_CLAUSEFLAG_MULTI },
 	{ "lock-file", &cfg_type_qstringornone, 0 },
 	{ "managed-keys-directory", &cfg_type_qstring, 0 },
 	{ "match-mapped-addresses", &cfg_type_boolean, 0 },
 	{ "max-rsa-exponent-size", &cfg_type_uint32, 0 },
+	{ "memory-sample-interval", &cfg_type_sizeval, 0 },
 	{ "memstatistics", &cfg_type_boolean, 0 },
 	{ "memstatistics-file", &cfg_type_qstring, 0 },
 	{ "multiple-cnames", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -1295,11 +1302,14 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "port", &cfg_type_uint32, 0 },
 	{ "tls-port", &cfg_type_uint32, 0 },
 #if HAVE_LIBNGHTTP2
+	{ "http-get-cache-ttl", &cfg_type_uint32, 0 },
 	{ "http-port", &cfg_type_uint32, 0 },
 	{ "http-listener-clients", &cfg_type_uint32, 0 },
 	{ "http-streams-per-connection", &cfg_type_uint32, 0 },
 	{ "https-port", &cfg_type_uint32, 0 },
 #else
+	{ "http-get-cache-ttl", &cfg_type_uint32,
+	  CFG_CLAUSEFLAG_NOTCONFIGURED },
 	{ "http-port", &cfg_type_uint32, CFG_CLAUSEFLAG_NOTCONFIGURED },
 	{ "http-listener-clients", &cfg_type_uint32,
 	  CFG_CLAUSEFLAG_NOTCONFIGURED },
@@ -1308,15 +1318,18 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "https-port", &cfg_type_uint32, CFG_CLAUSEFLAG_NOTCONFIGURED },
 #endif
 	{ "querylog", &cfg_type_boolean, 0 },
+	{ "querylog-binary", &cfg_type_qstring, 0 },
 	{ "random-device", &cfg_type_qstringornone, CFG_CLAUSEFLAG_OBSOLETE },
 	{ "recursing-file", &cfg_type_qstring, 0 },
 	{ "recursive-clients", &cfg_type_uint32, 0 },
+	{ "recursive-clients-per-prefix", &cfg_type_uint32, 0 },
 	{ "reuseport", &cfg_type_boolean, 0 },
 	{ "reserved-sockets", &cfg_type_uint32, CFG_CLAUSEFLAG_DEPRECATED },
 	{ "secroots-file", &cfg_type_qstring, 0 },
 	{ "serial-queries", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "serial-query-rate", &cfg_type_uint32, 0 },
 	{ "server-id", &cfg_type_serverid, 0 },
+	{ "server-state-interval", &cfg_type_duration, 0 },
 	{ "session-keyalg", &cfg_type_astring, 0 },
 	{ "session-keyfile", &cfg_type_qstringornone, 0 },
 	{ "session-keyname", &cfg_type_astring, 0 },
@@ -1327,22 +1340,27 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "statistics-interval", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "tcp-advertised-timeout", &cfg_type_uint32, 0 },
 	{ "tcp-clients", &cfg_type_uint32, 0 },
+	{ "tcp-clients-per-prefix", &cfg_type_uint32, 0 },
+	{ "tcp-evict-idle", &cfg_type_boolean, 0 },
 	{ "tcp-idle-timeout", &cfg_type_uint32, 0 },
 	{ "tcp-initial-timeout", &cfg_type_uint32, 0 },
 	{ "tcp-keepalive-timeout", &cfg_type_uint32, 0 },
 	{ "tcp-listen-queue", &cfg_type_uint32, 0 },
 	{ "tcp-receive-buffer", &cfg_type_uint32, 0 },
+	{ "tcp-send-batch", &cfg_type_uint32, 0 },
 	{ "tcp-send-buffer", &cfg_type_uint32, 0 },
 	{ "tkey-dhkey", &cfg_type_tkey_dhkey, CFG_CLAUSEFLAG_DEPRECATED },
 	{ "tkey-domain", &cfg_type_qstring, 0 },
 	{ "tkey-gssapi-credential", &cfg_type_qstring, 0 },
 	{ "tkey-gssapi-keytab", &cfg_type_qstring, 0 },
+	{ "transfer-cache-size", &cfg_type_sizeval, 0 },
 	{ "transfer-message-size", &cfg_type_uint32, 0 },
 	{ "transfers-in", &cfg_type_uint32, 0 },
 	{ "transfers-out", &cfg_type_uint32, 0 },
 	{ "transfers-per-ns", &cfg_type_uint32, 0 },
 	{ "treat-cr-as-space", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "udp-receive-buffer", &cfg_type_uint32, 0 },
+	{ "udp-send-batch", &cfg_type_uint32, 0 },
 	{ "udp-send-buffer", &cfg_type_uint32, 0 },
 	{ "update-quota", &cfg_type_uint32, 0 },
 	{ "use-id-pool", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -1515,6 +1533,16 @@ static cfg_type_t cfg_type_dnstap = { "dnstap",
 				      &cfg_rep_list,
 				      &cfg_type_dnstap_entry };
 
+/*%
+ * dnstap-sample-types { <rrtype>; ... };
+ */
+static cfg_type_t cfg_type_dnstap_sampletypes = { "dnstap_sampletypes",
+						  cfg_parse_bracketed_list,
+						  cfg_print_bracketed_list,
+						  cfg_doc_bracketed_list,
+						  &cfg_rep_list,
+						  &cfg_type_astring };
+
 /*%
  * dnstap-output
  */
@@ -2039,8 +2067,15 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "allow-recursion-on", &cfg_type_bracketed_aml, 0 },
 	{ "allow-v6-synthesis", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "attach-cache", &cfg_type_astring, 0 },
+	{ "attach-resolver", &cfg_type_boolean, 0 },
+	{ "auth-answer-cache-size", &cfg_type_uint32, 0 },
 	{ "auth-nxdomain", &cfg_type_boolean, 0 },
+	{ "cache-dump-file", &cfg_type_qstring, 0 },
+	{ "cache-dump-interval", &cfg_type_duration, 0 },
+	{ "cache-eviction", &cfg_type_cacheeviction, 0 },
 	{ "cache-file", &cfg_type_qstring, CFG_CLAUSEFLAG_ANCIENT },
+	{ "cache-shards", &cfg_type_uint32, 0 },
+	{ "cache-top-domains", &cfg_type_uint32, 0 },
 	{ "catalog-zones", &cfg_type_catz, 0 },
 	{ "check-names", &cfg_type_checknames, CFG_CLAUSEFLAG_MULTI },
 	{ "cleaning-interval", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -2072,8 +2107,13 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "dnssec-validation", &cfg_type_boolorauto, 0 },
 #ifdef HAVE_DNSTAP
 	{ "dnstap", &cfg_type_dnstap, 0 },
+	{ "dnstap-sample", &cfg_type_uint32, 0 },
+	{ "dnstap-sample-types", &cfg_type_dnstap_sampletypes, 0 },
 #else  /* ifdef HAVE_DNSTAP */
 	{ "dnstap", &cfg_type_dnstap, CFG_CLAUSEFLAG_NOTCONFIGURED },
+	{ "dnstap-sample", &cfg_type_uint32, CFG_CLAUSEFLAG_NOTCONFIGURED },
+	{ "dnstap-sample-types", &cfg_type_dnstap_sampletypes,
+	  CFG_CLAUSEFLAG_NOTCONFIGURED },
 #endif /* HAVE_DNSTAP */
 	{ "dual-stack-servers", &cfg_type_nameportiplist, 0 },
 	{ "edns-udp-size", &cfg_type_uint32, 0 },
@@ -2122,8 +2162,11 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "nxdomain-redirect", &cfg_type_astring, 0 },
 	{ "preferred-glue", &cfg_type_astring, 0 },
 	{ "prefetch", &cfg_type_prefetch, 0 },
+	{ "prefetch-popular", &cfg_type_uint32, 0 },
+	{ "prime-domains", &cfg_type_namelist, 0 },
 	{ "provide-ixfr", &cfg_type_boolean, 0 },
 	{ "qname-minimization", &cfg_type_qminmethod, 0 },
+	{ "query-latency-statistics", &cfg_type_boolean, 0 },
 	/*
 	 * Note that the query-source option syntax is different
 	 * from the other -source options.
@@ -2139,6 +2182,8 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "require-server-cookie", &cfg_type_boolean, 0 },
 	{ "resolver-nonbackoff-tries", &cfg_type_uint32, 0 },
 	{ "resolver-query-timeout", &cfg_type_uint32, 0 },
+	{ "resolver-race-threshold", &cfg_type_uint32, 0 },
+	{ "resolver-share-fetches", &cfg_type_boolean, 0 },
 	{ "resolver-retry-interval", &cfg_type_uint32, 0 },
 	{ "response-padding", &cfg_type_resppadding, 0 },
 	{ "response-policy", &cfg_type_rpz, 0 },
@@ -2148,7 +2193,9 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "root-key-sentinel", &cfg_type_boolean, 0 },
 	{ "rrset-order", &cfg_type_rrsetorder, 0 },
 	{ "send-cookie", &cfg_type_boolean, 0 },
+	{ "server-state-file", &cfg_type_qstring, 0 },
 	{ "servfail-ttl", &cfg_type_duration, 0 },
+	{ "sort-additional-lookups", &cfg_type_boolean, 0 },
 	{ "sortlist", &cfg_type_bracketed_aml, 0 },
 	{ "stale-answer-enable", &cfg_type_boolean, 0 },
 	{ "stale-answer-client-timeout", &cfg_type_staleanswerclienttimeout,
@@ -2263,6 +2310,10 @@ static cfg_clausedef_t zone_clauses[] = {
 	{ "check-spf", &cfg_type_warn, CFG_ZONE_PRIMARY },
 	{ "check-srv-cname", &cfg_type_checkmode, CFG_ZONE_PRIMARY },
 	{ "check-wildcard", &cfg_type_boolean, CFG_ZONE_PRIMARY },
+	{ "compact-denial", &cfg_type_boolean,
+	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
+	{ "condense-ixfr", &cfg_type_boolean,
+	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR },
 	{ "dialup", &cfg_type_dialuptype,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY | CFG_ZONE_STUB },
 	{ "dnssec-dnskey-kskonly", &cfg_type_boolean,
@@ -2280,6 +2331,7 @@ static cfg_clausedef_t zone_clauses[] = {
 	{ "forwarders", &cfg_type_portiplist,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY | CFG_ZONE_STUB |
 		  CFG_ZONE_STATICSTUB | CFG_ZONE_FORWARD },
+	{ "journal-commit-delay", &cfg_type_uint32, CFG_ZONE_PRIMARY },
 	{ "key-directory", &cfg_type_qstring,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "maintain-ixfr-base", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -2338,10 +2390,14 @@ static cfg_clausedef_t zone_clauses[] = {
 	{ "request-ixfr", &cfg_type_boolean,
 	  CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR },
 	{ "serial-update-method", &cfg_type_updatemethod, CFG_ZONE_PRIMARY },
+	{ "sig-resigning-rate", &cfg_type_uint32,
+	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "sig-signing-nodes", &cfg_type_uint32,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "sig-signing-signatures", &cfg_type_uint32,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
+	{ "sig-signing-threads", &cfg_type_uint32,
+	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "sig-signing-type", &cfg_type_uint32,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "sig-validity-interval", &cfg_type_validityinterval,
@@ -2472,9 +2528,12 @@ cfg_type_t cfg_type_dnssecpolicyopts = {
 
 /*% The "dynamically loadable zones" statement syntax. */
 
-static cfg_clausedef_t dlz_clauses[] = { { "database", &cfg_type_astring, 0 },
-					 { "search", &cfg_type_boolean, 0 },
-					 { NULL, NULL, 0 } };
+static cfg_clausedef_t dlz_clauses[] = {
+	{ "database", &cfg_type_astring, 0 },
+	{ "lookup-cache-ttl", &cfg_type_duration, 0 },
+	{ "search", &cfg_type_boolean, 0 },
+	{ NULL, NULL, 0 }
+};
 static cfg_clausedef_t *dlz_clausesets[] = { dlz_clauses, NULL };
 static cfg_type_t cfg_type_dlz = { "dlz",	  cfg_parse_named_map,
 				   cfg_print_map, cfg_doc_map,
@@ -3003,6 +3062,13 @@ static cfg_type_t cfg_type_optional_keyref = {
 static const char *qminmethod_enums[] = { "strict", "relaxed", "disabled",
 					  "off", NULL };
 
+static const char *cacheeviction_enums[] = { "lru", "slru", NULL };
+
+static cfg_type_t cfg_type_cacheeviction = {
+	"cacheeviction", cfg_parse_enum,  cfg_print_ustring,
+	cfg_doc_enum,	 &cfg_rep_string, cacheeviction_enums
+};
+
 static cfg_type_t cfg_type_qminmethod = { "qminmethod",	     cfg_parse_enum,
 					  cfg_print_ustring, cfg_doc_enum,
 					  &cfg_rep_string,   qminmethod_enums };
@@ -3247,7 +3313,7 @@ parse_querysource(cfg_parser_t *pctx, const cfg_type_t *type, cfg_obj_t **ret) {
 	}
 
 	CHECK(cfg_create_obj(pctx, &cfg_type_querysource, &obj));
-	isc_sockaddr_fromnetaddr(&obj->value.sockaddr, &netaddr, port);
+	isc_sockaddr_fromnetaddr(obj->value.sockaddr, &netaddr, port);
 	obj->value.sockaddrdscp.dscp = dscp;
 	*ret = obj;
 	return (ISC_R_SUCCESS);
@@ -3261,11 +3327,11 @@ cleanup:
 static void
 print_querysource(cfg_printer_t *pctx, const cfg_obj_t *obj) {
 	isc_netaddr_t na;
-	isc_netaddr_fromsockaddr(&na, &obj->value.sockaddr);
+	isc_netaddr_fromsockaddr(&na, obj->value.sockaddr);
 	cfg_print_cstr(pctx, "address ");
 	cfg_print_rawaddr(pctx, &na);
 	cfg_print_cstr(pctx, " port ");
-	cfg_print_rawuint(pctx, isc_sockaddr_getport(&obj->value.sockaddr));
+	cfg_print_rawuint(pctx, isc_sockaddr_getport(obj->value.sockaddr));
 	if (obj->value.sockaddrdscp.dscp != -1) {
 		cfg_print_cstr(pctx, " dscp ");
 		cfg_print_rawuint(pctx, obj->value.sockaddrdscp.dscp);
@@ -51,6 +51,7 @@
 #include <isc/errno.h>
 #include <isc/formatcheck.h>
 #include <isc/glob.h>
+#include <isc/ht.h>
 #include <isc/lex.h>
 #include <isc/log.h>
 #include <isc/mem.h>
@@ -132,6 +133,9 @@ parse_symtab_elt(cfg_parser_t *pctx, const char *name, cfg_type_t *elttype,
 static void
 free_noop(cfg_parser_t *pctx, cfg_obj_t *obj);
 
+static void
+free_sockaddr(cfg_parser_t *pctx, cfg_obj_t *obj);
+
 static isc_result_t
 cfg_getstringtoken(cfg_parser_t *pctx);
 
@@ -163,7 +167,7 @@ cfg_rep_t cfg_rep_boolean = { "boolean", free_noop };
 cfg_rep_t cfg_rep_map = { "map", free_map };
 cfg_rep_t cfg_rep_list = { "list", free_list };
 cfg_rep_t cfg_rep_tuple = { "tuple", free_tuple };
-cfg_rep_t cfg_rep_sockaddr = { "sockaddr", free_noop };
+cfg_rep_t cfg_rep_sockaddr = { "sockaddr", free_sockaddr };
 cfg_rep_t cfg_rep_netprefix = { "netprefix", free_noop };
 cfg_rep_t cfg_rep_void = { "void", free_noop };
 cfg_rep_t cfg_rep_fixedpoint = { "fixedpoint", free_noop };
@@ -521,6 +525,7 @@ cfg_parser_create(isc_mem_t *mctx, isc_log_t *lctx, cfg_parser_t **ret) {
 	pctx->token.type = isc_tokentype_unknown;
 	pctx->flags = 0;
 	pctx->buf_name = NULL;
+	pctx->clauses = NULL;
 
 	memset(specials, 0, sizeof(specials));
 	specials['{'] = 1;
@@ -540,6 +545,8 @@ cfg_parser_create(isc_mem_t *mctx, isc_log_t *lctx, cfg_parser_t **ret) {
 	CHECK(cfg_create_list(pctx, &cfg_type_filelist, &pctx->open_files));
 	CHECK(cfg_create_list(pctx, &cfg_type_filelist, &pctx->closed_files));
 
+	isc_ht_init(&pctx->clauses, pctx->mctx, 6, ISC_HT_CASE_SENSITIVE);
+
 	*ret = pctx;
 	return (ISC_R_SUCCESS);
 
@@ -727,6 +734,7 @@ cfg_parser_destroy(cfg_parser_t **pctxp) {
 		 */
 		CLEANUP_OBJ(pctx->open_files);
 		CLEANUP_OBJ(pctx->closed_files);
+		isc_ht_destroy(&pctx->clauses);
 		isc_mem_putanddetach(&pctx->mctx, pctx, sizeof(*pctx));
 	}
 }
@@ -2173,6 +2181,56 @@ cfg_listelt_value(const cfg_listelt_t *elt) {
  * Maps.
  */
 
+/*%
+ * Longest clause name remembered in the parser's clause table.
+ */
+#define CLAUSE_MAXNAME 64
+
+/*
+ * Find the clause called 'name' in 'clausesets'; return NULL if there
+ * is none.  A large configuration repeats the same few clauses in
+ * every zone statement, so clauses found are remembered in the parser
+ * instead of comparing the name against each clause every time.
+ */
+static const cfg_clausedef_t *
+find_clause(cfg_parser_t *pctx, const cfg_clausedef_t *const *clausesets,
+	    const char *name) {
+	const cfg_clausedef_t *const *clauseset = NULL;
+	const cfg_clausedef_t *clause = NULL;
+	unsigned char key[sizeof(clausesets) + CLAUSE_MAXNAME];
+	size_t len = strlen(name), keysize = 0;
+	void *data = NULL;
+
+	if (len <= CLAUSE_MAXNAME) {
+		memmove(key, &clausesets, sizeof(clausesets));
+		for (size_t i = 0; i < len; i++) {
+			key[sizeof(clausesets) + i] =
+				tolower((unsigned char)name[i]);
+		}
+		keysize = sizeof(clausesets) + len;
+		if (isc_ht_find(pctx->clauses, key, keysize, &data) ==
+		    ISC_R_SUCCESS)
+		{
+			return (data);
+		}
+	}
+
+	for (clauseset = clausesets; *clauseset != NULL; clauseset++) {
+		for (clause = *clauseset; clause->name != NULL; clause++) {
+			if (strcasecmp(name, clause->name) == 0) {
+				if (keysize != 0) {
+					(void)isc_ht_add(pctx->clauses, key,
+							 keysize,
+							 (void *)clause);
+				}
+				return (clause);
+			}
+		}
+	}
+
+	return (NULL);
+}
+
 /*
  * Parse a map body.  That's something like
  *
@@ -2187,7 +2245,6 @@ isc_result_t
 cfg_parse_mapbody(cfg_parser_t *pctx, const cfg_type_t *type, cfg_obj_t **ret) {
 	const cfg_clausedef_t *const *clausesets;
 	isc_result_t result;
-	const cfg_clausedef_t *const *clauseset;
 	const cfg_clausedef_t *clause;
 	cfg_obj_t *value = NULL;
 	cfg_obj_t *obj = NULL;
@@ -2251,20 +2308,8 @@ cfg_parse_mapbody(cfg_parser_t *pctx, const cfg_type_t *type, cfg_obj_t **ret) {
 			goto redo;
 		}
 
-		clause = NULL;
-		for (clauseset = clausesets; *clauseset != NULL; clauseset++) {
-			for (clause = *clauseset; clause->name != NULL;
-			     clause++)
-			{
-				if (strcasecmp(TOKEN_STRING(pctx),
-					       clause->name) == 0)
-				{
-					goto done;
-				}
-			}
-		}
-	done:
-		if (clause == NULL || clause->name == NULL) {
+		clause = find_clause(pctx, clausesets, TOKEN_STRING(pctx));
+		if (clause == NULL) {
 			cfg_parser_error(pctx, CFG_LOG_NOPREP,
 					 "unknown option");
 			/*
@@ -3036,7 +3081,7 @@ parse_netaddr(cfg_parser_t *pctx, const cfg_type_t *type, cfg_obj_t **ret) {
 
 	CHECK(cfg_create_obj(pctx, type, &obj));
 	CHECK(cfg_parse_rawaddr(pctx, flags, &netaddr));
-	isc_sockaddr_fromnetaddr(&obj->value.sockaddr, &netaddr, 0);
+	isc_sockaddr_fromnetaddr(obj->value.sockaddr, &netaddr, 0);
 	obj->value.sockaddrdscp.dscp = -1;
 	*ret = obj;
 	return (ISC_R_SUCCESS);
@@ -3262,7 +3307,7 @@ parse_sockaddrsub(cfg_parser_t *pctx, const cfg_type_t *type, int flags,
 		result = ISC_R_UNEXPECTEDTOKEN;
 		goto cleanup;
 	}
-	isc_sockaddr_fromnetaddr(&obj->value.sockaddr, &netaddr, port);
+	isc_sockaddr_fromnetaddr(obj->value.sockaddr, &netaddr, port);
 	*ret = obj;
 	return (ISC_R_SUCCESS);
 
@@ -3306,10 +3351,10 @@ cfg_print_sockaddr(cfg_printer_t *pctx, const cfg_obj_t *obj) {
 	REQUIRE(pctx != NULL);
 	REQUIRE(obj != NULL);
 
-	isc_netaddr_fromsockaddr(&netaddr, &obj->value.sockaddr);
+	isc_netaddr_fromsockaddr(&netaddr, obj->value.sockaddr);
 	isc_netaddr_format(&netaddr, buf, sizeof(buf));
 	cfg_print_cstr(pctx, buf);
-	port = isc_sockaddr_getport(&obj->value.sockaddr);
+	port = isc_sockaddr_getport(obj->value.sockaddr);
 	if (port != 0) {
 		cfg_print_cstr(pctx, " port ");
 		cfg_print_rawuint(pctx, port);
@@ -3369,7 +3414,7 @@ cfg_obj_issockaddr(const cfg_obj_t *obj) {
 const isc_sockaddr_t *
 cfg_obj_assockaddr(const cfg_obj_t *obj) {
 	REQUIRE(obj != NULL && obj->type->rep == &cfg_rep_sockaddr);
-	return (&obj->value.sockaddr);
+	return (obj->value.sockaddr);
 }
 
 isc_result_t
@@ -3661,6 +3706,10 @@ cfg_create_obj(cfg_parser_t *pctx, const cfg_type_t *type, cfg_obj_t **ret) {
 	obj->file = current_file(pctx);
 	obj->line = pctx->line;
 	obj->pctx = pctx;
+	if (type->rep == &cfg_rep_sockaddr) {
+		obj->value.sockaddr = isc_mem_get(pctx->mctx,
+						  sizeof(isc_sockaddr_t));
+	}
 
 	isc_refcount_init(&obj->references, 1);
 
@@ -3750,6 +3799,11 @@ free_noop(cfg_parser_t *pctx, cfg_obj_t *obj) {
 	UNUSED(obj);
 }
 
+static void
+free_sockaddr(cfg_parser_t *pctx, cfg_obj_t *obj) {
+	isc_mem_put(pctx->mctx, obj->value.sockaddr, sizeof(isc_sockaddr_t));
+}
+
 void
 cfg_doc_obj(cfg_printer_t *pctx, const cfg_type_t *type) {
 	REQUIRE(pctx != NULL);
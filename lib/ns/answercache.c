@@ -0,0 +1,446 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/hash.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/netaddr.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#include <dns/acl.h>
+#include <dns/db.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdatatype.h>
+#include <dns/view.h>
+#include <dns/zone.h>
+
+#include <ns/answercache.h>
+#include <ns/client.h>
+#include <ns/query.h>
+
+#define ANSWERCACHE_MAGIC    ISC_MAGIC('A', 'n', 's', 'C')
+#define VALID_ANSWERCACHE(c) ISC_MAGIC_VALID(c, ANSWERCACHE_MAGIC)
+
+/*%
+ * Number of locks protecting the table; slot 'i' is protected by lock
+ * 'i % ANSWERCACHE_NLOCKS'.
+ */
+#define ANSWERCACHE_NLOCKS 64
+
+/*%
+ * Largest response (excluding the header and OPT) that is stored.
+ */
+#define ANSWERCACHE_MAXLEN 4096
+
+/*%
+ * Query properties that select between different responses to the
+ * same question.
+ */
+#define KEY_RD	    0x0001 /*%< recursion desired */
+#define KEY_CD	    0x0002 /*%< checking disabled */
+#define KEY_AD	    0x0004 /*%< authentic data requested */
+#define KEY_DO	    0x0008 /*%< DNSSEC OK */
+#define KEY_TCP	    0x0010 /*%< stream transport */
+#define KEY_EDNS    0x0020 /*%< EDNS in use */
+#define KEY_EDNS512 0x0040 /*%< EDNS buffer size of 512 or less */
+#define KEY_COOKIE  0x0080 /*%< valid server cookie */
+#define KEY_INET6   0x0100 /*%< IPv6 client */
+
+struct ns_answercache {
+	unsigned int	    magic;
+	isc_mem_t	   *mctx;
+	unsigned int	    size;
+	ns_cachedanswer_t **table;
+	isc_mutex_t	    locks[ANSWERCACHE_NLOCKS];
+};
+
+void
+ns_answercache_create(isc_mem_t *mctx, unsigned int size,
+		      ns_answercache_t **cachep) {
+	ns_answercache_t *cache = NULL;
+	unsigned int i;
+
+	REQUIRE(size > 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (ns_answercache_t){ .size = size };
+	isc_mem_attach(mctx, &cache->mctx);
+
+	cache->table = isc_mem_get(mctx, size * sizeof(cache->table[0]));
+	memset(cache->table, 0, size * sizeof(cache->table[0]));
+	for (i = 0; i < ANSWERCACHE_NLOCKS; i++) {
+		isc_mutex_init(&cache->locks[i]);
+	}
+
+	cache->magic = ANSWERCACHE_MAGIC;
+	*cachep = cache;
+}
+
+void
+ns_answercache_free(isc_mem_t *mctx, void **cachep) {
+	ns_answercache_t *cache = NULL;
+	unsigned int i;
+
+	UNUSED(mctx);
+
+	REQUIRE(cachep != NULL);
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	REQUIRE(VALID_ANSWERCACHE(cache));
+
+	cache->magic = 0;
+	for (i = 0; i < cache->size; i++) {
+		if (cache->table[i] != NULL) {
+			ns_answercache_detach(&cache->table[i]);
+		}
+	}
+	for (i = 0; i < ANSWERCACHE_NLOCKS; i++) {
+		isc_mutex_destroy(&cache->locks[i]);
+	}
+	isc_mem_put(cache->mctx, cache->table,
+		    cache->size * sizeof(cache->table[0]));
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+void
+ns_answercache_detach(ns_cachedanswer_t **answerp) {
+	ns_cachedanswer_t *answer = NULL;
+
+	REQUIRE(answerp != NULL && *answerp != NULL);
+
+	answer = *answerp;
+	*answerp = NULL;
+
+	if (isc_refcount_decrement(&answer->references) == 1) {
+		isc_refcount_destroy(&answer->references);
+		isc_mem_putanddetach(&answer->mctx, answer,
+				     sizeof(*answer) + answer->length);
+	}
+}
+
+/*
+ * Whether responses in 'view' depend only on the question, i.e. nothing
+ * in the view rewrites or reorders them per client.
+ */
+static bool
+view_cacheable(dns_view_t *view) {
+	return (!view->recursion && view->rpzs == NULL &&
+		view->rrl == NULL && view->sortlist == NULL &&
+		view->nocasecompress == NULL && view->hooktable == NULL &&
+		ISC_LIST_EMPTY(view->dns64) &&
+		ISC_LIST_EMPTY(view->dlz_searched));
+}
+
+unsigned int
+ns_answercache_keybits(ns_client_t *client) {
+	unsigned int bits = 0;
+
+	if ((client->query.attributes & NS_QUERYATTR_WANTRECURSION) != 0) {
+		bits |= KEY_RD;
+	}
+	if ((client->message->flags & DNS_MESSAGEFLAG_CD) != 0) {
+		bits |= KEY_CD;
+	}
+	if ((client->attributes & NS_CLIENTATTR_WANTAD) != 0) {
+		bits |= KEY_AD;
+	}
+	if ((client->attributes & NS_CLIENTATTR_WANTDNSSEC) != 0) {
+		bits |= KEY_DO;
+	}
+	if ((client->attributes & NS_CLIENTATTR_TCP) != 0) {
+		bits |= KEY_TCP;
+	}
+	if (client->ednsversion >= 0) {
+		bits |= KEY_EDNS;
+		if (client->udpsize <= 512U) {
+			bits |= KEY_EDNS512;
+		}
+	}
+	if ((client->attributes & NS_CLIENTATTR_HAVECOOKIE) != 0) {
+		bits |= KEY_COOKIE;
+	}
+	if (isc_sockaddr_pf(&client->peeraddr) == AF_INET6) {
+		bits |= KEY_INET6;
+	}
+
+	return (bits);
+}
+
+/*
+ * The space available for the response to 'client'; see
+ * client_allocsendbuf().
+ */
+static unsigned int
+client_limit(ns_client_t *client) {
+	unsigned int limit;
+
+	if ((client->attributes & NS_CLIENTATTR_TCP) != 0) {
+		return (NS_CLIENT_TCP_BUFFER_SIZE);
+	}
+
+	limit = client->udpsize;
+	if ((client->attributes & NS_CLIENTATTR_HAVECOOKIE) == 0 &&
+	    client->view->nocookieudp < limit)
+	{
+		limit = client->view->nocookieudp;
+	}
+
+	return (ISC_MIN(limit, NS_CLIENT_SEND_BUFFER_SIZE));
+}
+
+static uint32_t
+query_hash(const dns_name_t *qname, dns_rdatatype_t qtype,
+	   unsigned int keybits) {
+	uint32_t hash = isc_hash32(qname->ndata, qname->length, true);
+
+	return (hash ^ (((uint32_t)qtype << 16 | keybits) * 0x9e3779b1U));
+}
+
+static bool
+answer_matches(const ns_cachedanswer_t *answer, uint32_t hash,
+	       const dns_name_t *qname, dns_rdatatype_t qtype,
+	       dns_rdataclass_t qclass, unsigned int keybits) {
+	return (answer->hash == hash && answer->keybits == keybits &&
+		answer->qtype == qtype && answer->qclass == qclass &&
+		answer->namelen == qname->length &&
+		memcmp(answer->data, qname->ndata, qname->length) == 0);
+}
+
+isc_result_t
+ns_answercache_find(ns_answercache_t *cache, ns_client_t *client,
+		    ns_cachedanswer_t **answerp) {
+	ns_cachedanswer_t *answer = NULL, *stale = NULL;
+	dns_message_t *message = client->message;
+	const dns_name_t *qname = client->query.qname;
+	unsigned int keybits, slot;
+	uint32_t hash, generation;
+
+	REQUIRE(VALID_ANSWERCACHE(cache));
+	REQUIRE(answerp != NULL && *answerp == NULL);
+
+	if (!view_cacheable(client->view) || message->tsigkey != NULL ||
+	    message->sig0key != NULL ||
+	    (client->attributes & NS_CLIENTATTR_HAVEECS) != 0 ||
+	    dns_rdatatype_ismeta(client->query.qtype))
+	{
+		return (ISC_R_NOTFOUND);
+	}
+
+	/*
+	 * Read the generation before anything is looked up, so that a
+	 * response built from data that changes meanwhile is stored under
+	 * a generation which is already out of date.
+	 */
+	generation = dns_db_generation();
+	keybits = ns_answercache_keybits(client);
+	hash = query_hash(qname, client->query.qtype, keybits);
+	slot = hash % cache->size;
+
+	LOCK(&cache->locks[slot % ANSWERCACHE_NLOCKS]);
+	answer = cache->table[slot];
+	if (answer != NULL &&
+	    answer_matches(answer, hash, qname, client->query.qtype,
+			   message->rdclass, keybits))
+	{
+		if (answer->generation != generation) {
+			stale = answer;
+			cache->table[slot] = NULL;
+			answer = NULL;
+		} else if (!ns_cachedanswer_fits(answer, client)) {
+			answer = NULL;
+		} else {
+			isc_refcount_increment(&answer->references);
+		}
+	} else {
+		answer = NULL;
+	}
+	UNLOCK(&cache->locks[slot % ANSWERCACHE_NLOCKS]);
+
+	if (stale != NULL) {
+		ns_answercache_detach(&stale);
+	}
+
+	if (answer == NULL) {
+		client->query.attributes |= NS_QUERYATTR_ANSWERCACHE;
+		client->query.answergen = generation;
+		client->query.answerkey = keybits;
+		return (ISC_R_NOTFOUND);
+	}
+
+	*answerp = answer;
+	return (ISC_R_SUCCESS);
+}
+
+static bool
+acl_isopen(dns_acl_t *acl) {
+	return (acl == NULL || dns_acl_isany(acl));
+}
+
+/*
+ * Whether the response in 'client' may be given to any client asking
+ * the same question.
+ */
+static bool
+response_cacheable(ns_client_t *client) {
+	dns_zone_t *zone = client->query.authzone;
+	ns_dbversion_t *dbversion = NULL;
+	dns_acl_t *queryacl = NULL, *queryonacl = NULL;
+
+	if (client->message->rcode != dns_rcode_noerror &&
+	    client->message->rcode != dns_rcode_nxdomain)
+	{
+		return (false);
+	}
+	if ((client->message->flags & DNS_MESSAGEFLAG_TC) != 0 ||
+	    (client->query.attributes & NS_QUERYATTR_REDIRECT) != 0 ||
+	    client->ede != NULL)
+	{
+		return (false);
+	}
+	if (!client->query.authdbset || zone == NULL) {
+		return (false);
+	}
+
+	/*
+	 * All of the data must have come from the zone whose query ACLs
+	 * are checked below.
+	 */
+	for (dbversion = ISC_LIST_HEAD(client->query.activeversions);
+	     dbversion != NULL; dbversion = ISC_LIST_NEXT(dbversion, link))
+	{
+		if (dbversion->db != client->query.authdb) {
+			return (false);
+		}
+	}
+
+	queryacl = dns_zone_getqueryacl(zone);
+	if (queryacl == NULL) {
+		queryacl = client->view->queryacl;
+	}
+	queryonacl = dns_zone_getqueryonacl(zone);
+	if (queryonacl == NULL) {
+		queryonacl = client->view->queryonacl;
+	}
+
+	return (acl_isopen(queryacl) && acl_isopen(queryonacl));
+}
+
+isc_result_t
+ns_cachedanswer_create(isc_mem_t *mctx, ns_client_t *client,
+		       isc_buffer_t *buffer, ns_cachedanswer_t **answerp) {
+	ns_cachedanswer_t *answer = NULL;
+	dns_message_t *message = client->message;
+	const dns_name_t *qname = client->query.origqname;
+	unsigned char *wire = NULL;
+	unsigned int length;
+	int i;
+
+	REQUIRE(ISC_BUFFER_VALID(buffer));
+	REQUIRE(answerp != NULL && *answerp == NULL);
+
+	INSIST(isc_buffer_usedlength(buffer) > DNS_MESSAGE_HEADERLEN);
+	wire = (unsigned char *)isc_buffer_base(buffer) + DNS_MESSAGE_HEADERLEN;
+	length = isc_buffer_usedlength(buffer) - DNS_MESSAGE_HEADERLEN;
+	if (length > ANSWERCACHE_MAXLEN) {
+		return (ISC_R_NOSPACE);
+	}
+
+	/*
+	 * The question is rendered first and is never compressed, so the
+	 * stored sections begin with the query name exactly as it was
+	 * asked; ns_answercache_find() relies on this.
+	 */
+	if (length < qname->length ||
+	    memcmp(wire, qname->ndata, qname->length) != 0)
+	{
+		return (ISC_R_FAILURE);
+	}
+
+	answer = isc_mem_get(mctx, sizeof(*answer) + length);
+	*answer = (ns_cachedanswer_t){
+		.qtype = client->query.qtype,
+		.qclass = message->rdclass,
+		.namelen = qname->length,
+		.flags = message->flags,
+		.rcode = message->rcode,
+		.referral = client->query.isreferral,
+		.length = length,
+		.data = (unsigned char *)(answer + 1),
+	};
+	isc_mem_attach(mctx, &answer->mctx);
+	isc_refcount_init(&answer->references, 1);
+	for (i = 0; i < DNS_SECTION_MAX; i++) {
+		answer->counts[i] = message->counts[i];
+	}
+	memmove(answer->data, wire, length);
+
+	*answerp = answer;
+	return (ISC_R_SUCCESS);
+}
+
+void
+ns_answercache_store(ns_answercache_t *cache, ns_client_t *client,
+		     isc_buffer_t *buffer) {
+	ns_cachedanswer_t *answer = NULL, *old = NULL;
+	unsigned int slot;
+
+	REQUIRE(VALID_ANSWERCACHE(cache));
+	REQUIRE(ISC_BUFFER_VALID(buffer));
+
+	if ((client->query.attributes & NS_QUERYATTR_ANSWERCACHE) == 0 ||
+	    !response_cacheable(client) ||
+	    ns_cachedanswer_create(cache->mctx, client, buffer, &answer) !=
+		    ISC_R_SUCCESS)
+	{
+		return;
+	}
+
+	answer->generation = client->query.answergen;
+	answer->keybits = client->query.answerkey;
+	answer->hash = query_hash(client->query.origqname, answer->qtype,
+				  answer->keybits);
+
+	slot = answer->hash % cache->size;
+	LOCK(&cache->locks[slot % ANSWERCACHE_NLOCKS]);
+	old = cache->table[slot];
+	cache->table[slot] = answer;
+	UNLOCK(&cache->locks[slot % ANSWERCACHE_NLOCKS]);
+
+	if (old != NULL) {
+		ns_answercache_detach(&old);
+	}
+}
+
+bool
+ns_cachedanswer_fits(const ns_cachedanswer_t *answer, ns_client_t *client) {
+	return (DNS_MESSAGE_HEADERLEN + answer->length <= client_limit(client));
+}
+
+isc_result_t
+ns_answercache_render(ns_cachedanswer_t *answer, dns_message_t *msg) {
+	isc_region_t r = { .base = answer->data, .length = answer->length };
+
+	return (dns_message_renderwire(msg, &r, answer->counts));
+}
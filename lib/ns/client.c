@@ -25,6 +25,7 @@
 #include <isc/nonce.h>
 #include <isc/once.h>
 #include <isc/print.h>
+#include <isc/profile.h>
 #include <isc/random.h>
 #include <isc/safe.h>
 #include <isc/serial.h>
@@ -59,10 +60,13 @@
 #include <dns/view.h>
 #include <dns/zone.h>
 
+#include <ns/answercache.h>
 #include <ns/client.h>
+#include <ns/inflight.h>
 #include <ns/interfacemgr.h>
 #include <ns/log.h>
 #include <ns/notify.h>
+#include <ns/querylog.h>
 #include <ns/server.h>
 #include <ns/stats.h>
 #include <ns/update.h>
@@ -98,8 +102,9 @@
 
 #define TCP_CLIENT(c) (((c)->attributes & NS_CLIENTATTR_TCP) != 0)
 
-#define COOKIE_SIZE 24U /* 8 + 4 + 4 + 8 */
-#define ECS_SIZE    20U /* 2 + 1 + 1 + [0..16] */
+#define COOKIE_SIZE  24U   /* 8 + 4 + 4 + 8 */
+#define COOKIE_REUSE 1800U /* age up to which a cookie is returned as is */
+#define ECS_SIZE     20U   /* 2 + 1 + 1 + [0..16] */
 
 #define WANTNSID(x)	(((x)->attributes & NS_CLIENTATTR_WANTNSID) != 0)
 #define WANTEXPIRE(x)	(((x)->attributes & NS_CLIENTATTR_WANTEXPIRE) != 0)
@@ -122,6 +127,10 @@ static void
 clientmgr_attach(ns_clientmgr_t *source, ns_clientmgr_t **targetp);
 static void
 clientmgr_destroy(ns_clientmgr_t *manager);
+static bool
+clientmgr_getfree(ns_clientmgr_t *manager, ns_client_t *client);
+static bool
+clientmgr_putfree(ns_client_t *client);
 static void
 ns_client_endrequest(ns_client_t *client);
 static void
@@ -141,6 +150,18 @@ ns_client_recursing(ns_client_t *client) {
 	UNLOCK(&client->manager->reclock);
 }
 
+void
+ns_client_savebuffer(ns_client_t *client) {
+	REQUIRE(NS_CLIENT_VALID(client));
+
+	if (client->reqbuf == NULL) {
+		client->reqbuf = isc_mem_get(client->mctx,
+					     NS_CLIENT_REQ_BUFFER_SIZE);
+	}
+	dns_message_savebuffer(client->message, client->reqbuf,
+			       NS_CLIENT_REQ_BUFFER_SIZE);
+}
+
 void
 ns_client_killoldestquery(ns_client_t *client) {
 	ns_client_t *oldest;
@@ -253,6 +274,7 @@ ns_client_endrequest(ns_client_t *client) {
 
 	client_extendederror_reset(client);
 	client->signer = NULL;
+	client->naclcache = 0;
 	client->udpsize = 512;
 	client->extflags = 0;
 	client->ednsversion = -1;
@@ -269,6 +291,11 @@ ns_client_endrequest(ns_client_t *client) {
 		isc_quota_detach(&client->recursionquota);
 		ns_stats_decrement(client->sctx->nsstats,
 				   ns_statscounter_recursclients);
+		if (client->recprefix != NULL) {
+			ns_prefixlimit_release(client->sctx->prefixlimit,
+					       ns_prefixlimit_recursion,
+					       &client->recprefix);
+		}
 	}
 
 	/*
@@ -317,6 +344,13 @@ client_senddone(isc_nmhandle_t *handle, isc_result_t result, void *cbarg) {
 	 */
 	client->sendhandle = NULL;
 
+	if (result == ISC_R_SUCCESS && client->view != NULL) {
+		ns_latencystats_add(client->view->latencystats, ns_latency_send,
+				    &client->sendtime);
+		ns_latencystats_add(client->view->latencystats,
+				    ns_latency_total, &client->latencytime);
+	}
+
 	if (result != ISC_R_SUCCESS) {
 		if (!TCP_CLIENT(client) && result == ISC_R_MAXSIZE) {
 			ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
@@ -345,9 +379,21 @@ client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
 	REQUIRE(datap != NULL);
 
 	if (TCP_CLIENT(client)) {
+		ns_clientmgr_t *manager = client->manager;
+
 		INSIST(client->tcpbuf == NULL);
-		client->tcpbuf = isc_mem_get(client->mctx,
-					     NS_CLIENT_TCP_BUFFER_SIZE);
+		if (manager->tid == isc_nm_tid() && !manager->renderbuf_busy) {
+			if (manager->renderbuf == NULL) {
+				manager->renderbuf = isc_mem_get(
+					manager->mctx,
+					NS_CLIENT_TCP_BUFFER_SIZE);
+			}
+			manager->renderbuf_busy = true;
+			client->tcpbuf = manager->renderbuf;
+		} else {
+			client->tcpbuf = isc_mem_get(client->mctx,
+						     NS_CLIENT_TCP_BUFFER_SIZE);
+		}
 		client->tcpbuf_size = NS_CLIENT_TCP_BUFFER_SIZE;
 		data = client->tcpbuf;
 		isc_buffer_init(buffer, data, NS_CLIENT_TCP_BUFFER_SIZE);
@@ -373,6 +419,23 @@ client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
 	*datap = data;
 }
 
+static void
+client_freetcpbuf(ns_client_t *client) {
+	ns_clientmgr_t *manager = client->manager;
+
+	if (client->tcpbuf == NULL) {
+		return;
+	}
+	if (manager != NULL && client->tcpbuf == manager->renderbuf) {
+		INSIST(manager->renderbuf_busy);
+		manager->renderbuf_busy = false;
+	} else {
+		isc_mem_put(client->mctx, client->tcpbuf, client->tcpbuf_size);
+	}
+	client->tcpbuf = NULL;
+	client->tcpbuf_size = 0;
+}
+
 static void
 client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 	isc_result_t result;
@@ -381,7 +444,21 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 
 	REQUIRE(client->sendhandle == NULL);
 
-	if (isc_buffer_base(buffer) == client->tcpbuf) {
+	if (isc_buffer_base(buffer) == client->tcpbuf &&
+	    client->tcpbuf == client->manager->renderbuf)
+	{
+		/*
+		 * The manager's buffer is needed for the next response,
+		 * so the send gets a copy of just the rendered message.
+		 */
+		size_t used = isc_buffer_usedlength(buffer);
+		client->tcpbuf = isc_mem_get(client->mctx, used);
+		client->tcpbuf_size = used;
+		memmove(client->tcpbuf, isc_buffer_base(buffer), used);
+		client->manager->renderbuf_busy = false;
+		r.base = client->tcpbuf;
+		r.length = used;
+	} else if (isc_buffer_base(buffer) == client->tcpbuf) {
 		size_t used = isc_buffer_usedlength(buffer);
 		client->tcpbuf = isc_mem_reget(client->manager->mctx,
 					       client->tcpbuf,
@@ -394,6 +471,12 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 	}
 	isc_nmhandle_attach(client->handle, &client->sendhandle);
 
+	if (client->view != NULL && client->view->latencystats != NULL &&
+	    !isc_time_isepoch(&client->latencytime))
+	{
+		TIME_NOW_HIRES(&client->sendtime);
+	}
+
 	if (isc_nm_is_http_handle(client->handle)) {
 		result = dns_message_response_minttl(client->message, &min_ttl);
 		if (result == ISC_R_SUCCESS) {
@@ -460,9 +543,7 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 
 	return;
 done:
-	if (client->tcpbuf != NULL) {
-		isc_mem_put(client->mctx, client->tcpbuf, client->tcpbuf_size);
-	}
+	client_freetcpbuf(client);
 
 	ns_client_drop(client, result);
 }
@@ -480,8 +561,8 @@ ns_client_send(ns_client_t *client) {
 	bool opt_included = false;
 	size_t respsize;
 	dns_aclenv_t *env = NULL;
+	isc_time_t rendertime;
 #ifdef HAVE_DNSTAP
-	unsigned char zone[DNS_NAME_MAXWIRE];
 	dns_dtmsgtype_t dtmsgtype;
 	isc_region_t zr;
 #endif /* HAVE_DNSTAP */
@@ -492,6 +573,13 @@ ns_client_send(ns_client_t *client) {
 		return;
 	}
 
+	isc_time_settoepoch(&rendertime);
+	if (client->view != NULL && client->view->latencystats != NULL &&
+	    !isc_time_isepoch(&client->latencytime))
+	{
+		TIME_NOW_HIRES(&rendertime);
+	}
+
 	/*
 	 * XXXWPK TODO
 	 * Delay the response according to the -T delay option
@@ -581,6 +669,17 @@ ns_client_send(ns_client_t *client) {
 			goto cleanup;
 		}
 	}
+	if (client->query.cachedanswer != NULL) {
+		result = ns_answercache_render(client->query.cachedanswer,
+					       client->message);
+		ns_answercache_detach(&client->query.cachedanswer);
+		if (result == ISC_R_NOSPACE) {
+			client->message->flags |= DNS_MESSAGEFLAG_TC;
+		} else if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		goto renderend;
+	}
 	result = dns_message_rendersection(client->message,
 					   DNS_SECTION_QUESTION, 0);
 	if (result == ISC_R_NOSPACE) {
@@ -596,6 +695,16 @@ ns_client_send(ns_client_t *client) {
 	if ((client->message->flags & DNS_MESSAGEFLAG_TC) != 0) {
 		goto renderend;
 	}
+	/*
+	 * Don't spend time compressing a UDP answer that cannot fit;
+	 * the client will have to retry over TCP anyway.
+	 */
+	if (!TCP_CLIENT(client) &&
+	    !dns_message_sectionfits(client->message, DNS_SECTION_ANSWER))
+	{
+		client->message->flags |= DNS_MESSAGEFLAG_TC;
+		goto renderend;
+	}
 	result = dns_message_rendersection(client->message, DNS_SECTION_ANSWER,
 					   DNS_MESSAGERENDER_PARTIAL |
 						   render_opts);
@@ -622,27 +731,34 @@ ns_client_send(ns_client_t *client) {
 	if (result != ISC_R_SUCCESS && result != ISC_R_NOSPACE) {
 		goto cleanup;
 	}
+	if (result == ISC_R_SUCCESS && client->view != NULL &&
+	    client->view->answercache != NULL)
+	{
+		ns_answercache_store(client->view->answercache, client,
+				     &buffer);
+	}
+	if (result == ISC_R_SUCCESS && client->query.inflight != NULL) {
+		ns_inflight_done(client->sctx->inflight, client, &buffer);
+	}
 renderend:
 	result = dns_message_renderend(client->message);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup;
 	}
 
+	if (client->view != NULL) {
+		ns_latencystats_add(client->view->latencystats,
+				    ns_latency_render, &rendertime);
+	}
+
 #ifdef HAVE_DNSTAP
 	memset(&zr, 0, sizeof(zr));
 	if (((client->message->flags & DNS_MESSAGEFLAG_AA) != 0) &&
 	    (client->query.authzone != NULL))
 	{
-		isc_result_t eresult;
-		isc_buffer_t b;
-		dns_name_t *zo = dns_zone_getorigin(client->query.authzone);
-
-		isc_buffer_init(&b, zone, sizeof(zone));
-		dns_compress_setmethods(&cctx, DNS_COMPRESS_NONE);
-		eresult = dns_name_towire(zo, &cctx, &b);
-		if (eresult == ISC_R_SUCCESS) {
-			isc_buffer_usedregion(&b, &zr);
-		}
+		/* The origin is absolute, so this is its wire form. */
+		dns_name_toregion(dns_zone_getorigin(client->query.authzone),
+				  &zr);
 	}
 
 	if (client->message->opcode == dns_opcode_update) {
@@ -722,6 +838,9 @@ renderend:
 
 	dns_rcodestats_increment(client->sctx->rcodestats,
 				 client->message->rcode);
+	if (client->sctx->querylog != NULL) {
+		ns_querylog_log(client->sctx->querylog, client);
+	}
 	if (opt_included) {
 		ns_stats_increment(client->sctx->nsstats,
 				   ns_statscounter_edns0out);
@@ -744,9 +863,7 @@ renderend:
 	return;
 
 cleanup:
-	if (client->tcpbuf != NULL) {
-		isc_mem_put(client->mctx, client->tcpbuf, client->tcpbuf_size);
-	}
+	client_freetcpbuf(client);
 
 	if (cleanup_cctx) {
 		dns_compress_invalidate(&cctx);
@@ -1017,12 +1134,18 @@ no_nsid:
 		isc_stdtime_t now;
 		uint32_t nonce;
 
-		isc_buffer_init(&buf, cookie, sizeof(cookie));
-		isc_stdtime_get(&now);
+		if ((client->attributes & NS_CLIENTATTR_REUSECOOKIE) != 0) {
+			memmove(cookie, client->cookie, 8);
+			memmove(cookie + 8, client->servercookie, 16);
+		} else {
+			isc_buffer_init(&buf, cookie, sizeof(cookie));
+			isc_stdtime_get(&now);
 
-		isc_random_buf(&nonce, sizeof(nonce));
+			isc_random_buf(&nonce, sizeof(nonce));
 
-		compute_cookie(client, now, nonce, client->sctx->secret, &buf);
+			compute_cookie(client, now, nonce,
+				       client->sctx->secret, &buf);
+		}
 
 		INSIST(count < DNS_EDNSOPTIONS);
 		ednsopts[count].code = DNS_OPT_COOKIE;
@@ -1322,6 +1445,19 @@ process_cookie(ns_client_t *client, isc_buffer_t *buf, size_t optlen) {
 		ns_stats_increment(client->sctx->nsstats,
 				   ns_statscounter_cookiematch);
 		client->attributes |= NS_CLIENTATTR_HAVECOOKIE;
+
+		/*
+		 * A server cookie made with the current secret in the
+		 * last half hour is returned unchanged (RFC 9018,
+		 * section 4.3), which saves computing a new one.
+		 */
+		if (isc_serial_le(when, now) &&
+		    isc_serial_ge(when, now - COOKIE_REUSE))
+		{
+			memmove(client->servercookie, dbuf + 8,
+				sizeof(client->servercookie));
+			client->attributes |= NS_CLIENTATTR_REUSECOOKIE;
+		}
 		return;
 	}
 
@@ -1626,9 +1762,7 @@ ns__client_reset_cb(void *client0) {
 	}
 
 	ns_client_endrequest(client);
-	if (client->tcpbuf != NULL) {
-		isc_mem_put(client->mctx, client->tcpbuf, client->tcpbuf_size);
-	}
+	client_freetcpbuf(client);
 
 	if (client->keytag != NULL) {
 		isc_mem_put(client->mctx, client->keytag, client->keytag_len);
@@ -1658,7 +1792,6 @@ ns__client_put_cb(void *client0) {
 	client->magic = 0;
 	client->shuttingdown = true;
 
-	isc_mem_put(client->mctx, client->sendbuf, NS_CLIENT_SEND_BUFFER_SIZE);
 	if (client->opt != NULL) {
 		INSIST(dns_rdataset_isassociated(client->opt));
 		dns_rdataset_disassociate(client->opt);
@@ -1666,7 +1799,16 @@ ns__client_put_cb(void *client0) {
 	}
 	client_extendederror_reset(client);
 
-	dns_message_detach(&client->message);
+	if (!clientmgr_putfree(client)) {
+		isc_mem_put(client->mctx, client->sendbuf,
+			    NS_CLIENT_SEND_BUFFER_SIZE);
+		dns_message_detach(&client->message);
+	}
+
+	if (client->reqbuf != NULL) {
+		isc_mem_put(client->mctx, client->reqbuf,
+			    NS_CLIENT_REQ_BUFFER_SIZE);
+	}
 
 	if (client->manager != NULL) {
 		ns_clientmgr_detach(&client->manager);
@@ -1687,6 +1829,11 @@ ns__client_put_cb(void *client0) {
 	 */
 	isc_mutex_destroy(&client->query.fetchlock);
 
+	if (client->tcpprefix != NULL) {
+		ns_prefixlimit_release(client->sctx->prefixlimit,
+				       ns_prefixlimit_tcp, &client->tcpprefix);
+	}
+
 	if (client->sctx != NULL) {
 		ns_server_detach(&client->sctx);
 	}
@@ -1799,6 +1946,11 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	TIME_NOW(&client->requesttime);
 	client->tnow = client->requesttime;
 	client->now = isc_time_seconds(&client->tnow);
+	isc_time_settoepoch(&client->latencytime);
+	isc_time_settoepoch(&client->sendtime);
+	if (ns_server_getoption(client->sctx, NS_SERVER_LATENCYSTATS)) {
+		TIME_NOW_HIRES(&client->latencytime);
+	}
 
 	isc_netaddr_fromsockaddr(&netaddr, &client->peeraddr);
 
@@ -1827,6 +1979,29 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 		return;
 	}
 
+	/*
+	 * A TCP or TLS connection counts against tcp-clients-per-prefix
+	 * from its first request until it is closed.  ns__client_tcpconn()
+	 * has already refused it if the limit was reached then; this
+	 * catches connections accepted at the same time.
+	 */
+	if (client->tcpprefix == NULL &&
+	    (isc_nm_socket_type(handle) &
+	     (isc_nm_tcpdnssocket | isc_nm_tlsdnssocket)) != 0 &&
+	    ns_prefixlimit_acquire(client->sctx->prefixlimit, &netaddr,
+				   ns_prefixlimit_tcp,
+				   &client->tcpprefix) == ISC_R_QUOTA)
+	{
+		ns_stats_increment(client->sctx->nsstats,
+				   ns_statscounter_tcpprefixquota);
+		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
+			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(10),
+			      "dropped request: tcp-clients-per-prefix "
+			      "limit reached");
+		isc_nm_bad_request(handle);
+		return;
+	}
+
 	ns_client_log(client, NS_LOGCATEGORY_CLIENT, NS_LOGMODULE_CLIENT,
 		      ISC_LOG_DEBUG(3), "%s request",
 		      TCP_CLIENT(client) ? "TCP" : "UDP");
@@ -2075,6 +2250,9 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	ns_client_log(client, NS_LOGCATEGORY_CLIENT, NS_LOGMODULE_CLIENT,
 		      ISC_LOG_DEBUG(5), "using view '%s'", client->view->name);
 
+	ns_latencystats_add(client->view->latencystats, ns_latency_viewmatch,
+			    &client->latencytime);
+
 	/*
 	 * Check for a signature.  We log bad signatures regardless of
 	 * whether they ultimately cause the request to be rejected or
@@ -2082,6 +2260,7 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	 * debugging.
 	 */
 	client->signer = NULL;
+	client->naclcache = 0;
 	dns_name_init(&client->signername, NULL);
 	result = dns_message_signer(client->message, &client->signername);
 	if (result != ISC_R_NOTFOUND) {
@@ -2252,7 +2431,30 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 			    &client->requesttime, NULL, buffer);
 #endif /* HAVE_DNSTAP */
 
+		/*
+		 * Drop queries from a client that is over its
+		 * all-per-second limit before looking anything up.
+		 * TCP, valid cookies and recursive queries, which the
+		 * rate limiting in query.c may exempt, are left to it.
+		 */
+		if (client->view->rrl != NULL && !TCP_CLIENT(client) &&
+		    (client->attributes & NS_CLIENTATTR_HAVECOOKIE) == 0 &&
+		    !(ra &&
+		      (client->message->flags & DNS_MESSAGEFLAG_RD) != 0) &&
+		    dns_rrl_dropping(client->view, &client->peeraddr,
+				     client->now))
+		{
+			ns_stats_increment(client->sctx->nsstats,
+					   ns_statscounter_ratedropped);
+			ns_stats_increment(client->sctx->nsstats,
+					   ns_statscounter_dropped);
+			ns_client_drop(client, DNS_R_DROP);
+			break;
+		}
+
+		isc_profile_enter(isc_profile_query);
 		ns_query_start(client, handle);
+		isc_profile_leave(isc_profile_query);
 		break;
 	case dns_opcode_update:
 		CTRACE("update");
@@ -2279,6 +2481,27 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	}
 }
 
+static atomic_uint_fast32_t last_tcpprefix_log = 0;
+
+static void
+tcpprefix_log(const isc_netaddr_t *netaddr) {
+	char buf[ISC_NETADDR_FORMATSIZE];
+	isc_stdtime_t now, last;
+
+	isc_stdtime_get(&now);
+	last = atomic_exchange_relaxed(&last_tcpprefix_log, now);
+	if (now == last) {
+		return;
+	}
+
+	isc_netaddr_format(netaddr, buf, sizeof(buf));
+	isc_log_write(ns_lctx, NS_LOGCATEGORY_CLIENT, NS_LOGMODULE_CLIENT,
+		      ISC_LOG_WARNING,
+		      "TCP connection from %s refused: "
+		      "tcp-clients-per-prefix limit reached",
+		      buf);
+}
+
 isc_result_t
 ns__client_tcpconn(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	ns_interface_t *ifp = (ns_interface_t *)arg;
@@ -2304,6 +2527,15 @@ ns__client_tcpconn(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 		{
 			return (ISC_R_CONNREFUSED);
 		}
+
+		if (ns_prefixlimit_check(sctx->prefixlimit, &netaddr,
+					 ns_prefixlimit_tcp) == ISC_R_QUOTA)
+		{
+			ns_stats_increment(sctx->nsstats,
+					   ns_statscounter_tcpprefixquota);
+			tcpprefix_log(&netaddr);
+			return (ISC_R_QUOTA);
+		}
 	}
 
 	tcpquota = isc_quota_getused(&sctx->tcpquota);
@@ -2337,11 +2569,13 @@ ns__client_setup(ns_client_t *client, ns_clientmgr_t *mgr, bool new) {
 		ns_server_attach(mgr->sctx, &client->sctx);
 		isc_task_attach(mgr->task, &client->task);
 
-		dns_message_create(client->mctx, DNS_MESSAGE_INTENTPARSE,
-				   &client->message);
-
-		client->sendbuf = isc_mem_get(client->mctx,
-					      NS_CLIENT_SEND_BUFFER_SIZE);
+		if (!clientmgr_getfree(mgr, client)) {
+			dns_message_create(client->mctx,
+					   DNS_MESSAGE_INTENTPARSE,
+					   &client->message);
+			client->sendbuf = isc_mem_get(
+				client->mctx, NS_CLIENT_SEND_BUFFER_SIZE);
+		}
 		/*
 		 * Set magic earlier than usual because ns_query_init()
 		 * and the functions it calls will require it.
@@ -2359,9 +2593,11 @@ ns__client_setup(ns_client_t *client, ns_clientmgr_t *mgr, bool new) {
 		ns_server_t *sctx = client->sctx;
 		isc_task_t *task = client->task;
 		unsigned char *sendbuf = client->sendbuf;
+		unsigned char *reqbuf = client->reqbuf;
 		dns_message_t *message = client->message;
 		isc_mem_t *oldmctx = client->mctx;
 		ns_query_t query = client->query;
+		ns_prefixentry_t *tcpprefix = client->tcpprefix;
 		int tid = client->tid;
 
 		/*
@@ -2374,8 +2610,10 @@ ns__client_setup(ns_client_t *client, ns_clientmgr_t *mgr, bool new) {
 					 .sctx = sctx,
 					 .task = task,
 					 .sendbuf = sendbuf,
+					 .reqbuf = reqbuf,
 					 .message = message,
 					 .query = query,
+					 .tcpprefix = tcpprefix,
 					 .tid = tid };
 	}
 
@@ -2389,6 +2627,7 @@ ns__client_setup(ns_client_t *client, ns_clientmgr_t *mgr, bool new) {
 	client->formerrcache.time = 0;
 	client->formerrcache.id = 0;
 	ISC_LINK_INIT(client, rlink);
+	ISC_LINK_INIT(client, ilink);
 	client->rcode_override = -1; /* not set */
 
 	client->magic = NS_CLIENT_MAGIC;
@@ -2461,6 +2700,53 @@ ns_clientmgr_detach(ns_clientmgr_t **mp) {
 	}
 }
 
+/*
+ * Take a message and send buffer left behind by a freed client, if
+ * there is one, so that a new client can skip creating them.
+ */
+static bool
+clientmgr_getfree(ns_clientmgr_t *manager, ns_client_t *client) {
+	if (manager->nfree == 0) {
+		return (false);
+	}
+
+	manager->nfree--;
+	client->message = manager->freemessages[manager->nfree];
+	client->sendbuf = manager->freesendbufs[manager->nfree];
+	manager->freemessages[manager->nfree] = NULL;
+	manager->freesendbufs[manager->nfree] = NULL;
+
+	return (true);
+}
+
+/*
+ * Keep the message and send buffer of a client being freed for the
+ * next new client.  Clients served over TCP, TLS and HTTPS are freed
+ * along with their connection, so without this every connection
+ * would create a message (with its name and rdataset pools) anew.
+ * The free list is not locked, so it is only used from the manager's
+ * own thread.
+ */
+static bool
+clientmgr_putfree(ns_client_t *client) {
+	ns_clientmgr_t *manager = client->manager;
+
+	if (manager == NULL || manager->tid != isc_nm_tid() ||
+	    manager->nfree == NS_CLIENT_FREELIST_SIZE)
+	{
+		return (false);
+	}
+
+	dns_message_reset(client->message, DNS_MESSAGE_INTENTPARSE);
+	manager->freemessages[manager->nfree] = client->message;
+	manager->freesendbufs[manager->nfree] = client->sendbuf;
+	manager->nfree++;
+	client->message = NULL;
+	client->sendbuf = NULL;
+
+	return (true);
+}
+
 static void
 clientmgr_destroy(ns_clientmgr_t *manager) {
 	MTRACE("clientmgr_destroy");
@@ -2468,6 +2754,26 @@ clientmgr_destroy(ns_clientmgr_t *manager) {
 	isc_refcount_destroy(&manager->references);
 	manager->magic = 0;
 
+	while (manager->nfree > 0) {
+		manager->nfree--;
+		dns_message_detach(&manager->freemessages[manager->nfree]);
+		isc_mem_put(manager->mctx,
+			    manager->freesendbufs[manager->nfree],
+			    NS_CLIENT_SEND_BUFFER_SIZE);
+	}
+
+	if (manager->nsec3cache != NULL) {
+		isc_mem_put(manager->mctx, manager->nsec3cache,
+			    NS_CLIENT_NSEC3CACHE_SIZE *
+				    sizeof(manager->nsec3cache[0]));
+	}
+
+	if (manager->renderbuf != NULL) {
+		INSIST(!manager->renderbuf_busy);
+		isc_mem_put(manager->mctx, manager->renderbuf,
+			    NS_CLIENT_TCP_BUFFER_SIZE);
+	}
+
 	dns_aclenv_detach(&manager->aclenv);
 
 	isc_mutex_destroy(&manager->reclock);
@@ -2555,6 +2861,8 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 	isc_netaddr_t tmpnetaddr;
 	int match;
 	isc_sockaddr_t local;
+	bool cacheable, dest;
+	unsigned int i;
 
 	if (acl == NULL) {
 		if (default_allow) {
@@ -2564,6 +2872,22 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 		}
 	}
 
+	/*
+	 * Nothing but the address checked can change during a request,
+	 * so the outcome for the client's own addresses can be reused.
+	 */
+	dest = (netaddr != NULL);
+	cacheable = (netaddr == NULL || netaddr == &client->destaddr);
+	if (cacheable) {
+		for (i = 0; i < client->naclcache; i++) {
+			if (client->aclcache[i].acl == acl &&
+			    client->aclcache[i].dest == dest)
+			{
+				return (client->aclcache[i].result);
+			}
+		}
+	}
+
 	if (netaddr == NULL) {
 		isc_netaddr_fromsockaddr(&tmpnetaddr, &client->peeraddr);
 		netaddr = &tmpnetaddr;
@@ -2576,14 +2900,19 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 		isc_nm_has_encryption(client->handle), client->signer, acl, env,
 		&match, NULL);
 
-	if (result != ISC_R_SUCCESS) {
-		goto deny; /* Internal error, already logged. */
+	if (result != ISC_R_SUCCESS || match <= 0) {
+		/* Internal error (already logged), or no positive match. */
+		result = DNS_R_REFUSED;
 	}
 
-	if (match > 0) {
-		goto allow;
+	if (cacheable && client->naclcache < NS_CLIENT_ACLCACHE_SIZE) {
+		client->aclcache[client->naclcache].acl = acl;
+		client->aclcache[client->naclcache].dest = dest;
+		client->aclcache[client->naclcache].result = result;
+		client->naclcache++;
 	}
-	goto deny; /* Negative match or no match. */
+
+	return (result);
 
 allow:
 	return (ISC_R_SUCCESS);
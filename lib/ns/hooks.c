@@ -19,17 +19,20 @@
 #include <uv.h>
 
 #include <isc/errno.h>
+#include <isc/event.h>
 #include <isc/list.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/print.h>
 #include <isc/result.h>
+#include <isc/task.h>
 #include <isc/types.h>
 #include <isc/util.h>
 
 #include <dns/view.h>
 
+#include <ns/events.h>
 #include <ns/hooks.h>
 #include <ns/log.h>
 #include <ns/query.h>
@@ -361,3 +364,76 @@ ns_plugins_free(isc_mem_t *mctx, void **listp) {
 
 	isc_mem_put(mctx, list, sizeof(*list));
 }
+
+void
+ns_hookasync_create(isc_mem_t *mctx, ns_hook_cancelasync_t cancel,
+		    ns_hook_destroyasync_t destroy, void *data,
+		    ns_hookasync_t **ctxp) {
+	ns_hookasync_t *ctx = NULL;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(cancel != NULL);
+	REQUIRE(ctxp != NULL && *ctxp == NULL);
+
+	ctx = isc_mem_get(mctx, sizeof(*ctx));
+	*ctx = (ns_hookasync_t){
+		.cancel = cancel,
+		.destroy = (destroy != NULL) ? destroy : ns_hookasync_destroy,
+		.private = data,
+	};
+	isc_mem_attach(mctx, &ctx->mctx);
+
+	*ctxp = ctx;
+}
+
+void
+ns_hookasync_destroy(ns_hookasync_t **ctxp) {
+	ns_hookasync_t *ctx = NULL;
+
+	REQUIRE(ctxp != NULL && *ctxp != NULL);
+
+	ctx = *ctxp;
+	*ctxp = NULL;
+
+	isc_mem_putanddetach(&ctx->mctx, ctx, sizeof(*ctx));
+}
+
+ns_hook_resevent_t *
+ns_hook_resevent_create(query_ctx_t *qctx, isc_mem_t *mctx, isc_task_t *task,
+			isc_taskaction_t action, void *evarg,
+			ns_hookasync_t *ctx, ns_hookpoint_t hookpoint,
+			isc_result_t origresult) {
+	ns_hook_resevent_t *rev = NULL;
+
+	REQUIRE(qctx != NULL);
+	REQUIRE(mctx != NULL);
+	REQUIRE(task != NULL);
+	REQUIRE(action != NULL);
+	REQUIRE(ctx != NULL);
+
+	rev = (ns_hook_resevent_t *)isc_event_allocate(
+		mctx, task, NS_EVENT_HOOKASYNCDONE, action, evarg,
+		sizeof(*rev));
+	rev->ctx = ctx;
+	rev->hookpoint = hookpoint;
+	rev->origresult = origresult;
+	rev->saved_qctx = qctx;
+
+	return (rev);
+}
+
+void
+ns_hook_resume(ns_hook_resevent_t **revp) {
+	isc_event_t *event = NULL;
+
+	REQUIRE(revp != NULL && *revp != NULL);
+
+	event = (isc_event_t *)*revp;
+	*revp = NULL;
+
+	/*
+	 * The sender is the client task passed to 'runasync'; sending the
+	 * event there resumes the query on the worker that suspended it.
+	 */
+	isc_task_send(event->ev_sender, &event);
+}
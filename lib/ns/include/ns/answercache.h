@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file
+ * \brief
+ * Cache of rendered authoritative responses.
+ *
+ * The answer cache keeps the wire form of recent authoritative responses
+ * for a view, keyed by the question (case-sensitively), the header and
+ * EDNS bits of the query that influence the response, and the transport
+ * it arrived over.  A repeated question can then be answered by copying
+ * the rendered sections into the reply instead of looking the answer up
+ * in the zone database and rendering it again; only the header and any
+ * OPT record are produced afresh.
+ *
+ * Only views that neither recurse nor rewrite responses per client
+ * (response-policy, dns64, sortlist, rate-limit, plugins, DLZ) use the
+ * cache, and only answers taken from a single zone that any client may
+ * query are stored.  Entries are discarded once dns_db_generation()
+ * moves on.
+ */
+
+#include <isc/buffer.h>
+#include <isc/refcount.h>
+#include <isc/types.h>
+
+#include <dns/message.h>
+#include <dns/types.h>
+
+#include <ns/types.h>
+
+/*% A rendered response; read-only once stored. */
+struct ns_cachedanswer {
+	isc_mem_t	*mctx;
+	isc_refcount_t	 references;
+	uint32_t	 hash;
+	uint32_t	 generation;
+	unsigned int	 keybits;
+	dns_rdatatype_t	 qtype;
+	dns_rdataclass_t qclass;
+	unsigned int	 namelen;
+	uint16_t	 flags;
+	dns_rcode_t	 rcode;
+	bool		 referral;
+	unsigned int	 counts[DNS_SECTION_MAX];
+	unsigned int	 length;
+	unsigned char	*data;
+};
+
+void
+ns_answercache_create(isc_mem_t *mctx, unsigned int size,
+		      ns_answercache_t **cachep);
+/*%<
+ * Create an answer cache holding up to 'size' responses.
+ *
+ * Requires:
+ *\li	'size' is greater than zero.
+ *\li	'cachep' is not NULL and '*cachep' is NULL.
+ */
+
+void
+ns_answercache_free(isc_mem_t *mctx, void **cachep);
+/*%<
+ * Free an answer cache and all responses in it.  The signature matches
+ * the 'answercache_free' member of dns_view_t.
+ */
+
+isc_result_t
+ns_answercache_find(ns_answercache_t *cache, ns_client_t *client,
+		    ns_cachedanswer_t **answerp);
+/*%<
+ * Look up a rendered response to the query in 'client'.  Call this once
+ * the reply header has been set up by dns_message_reply().
+ *
+ * If the query may be answered from the cache but no usable response is
+ * stored, the client is marked so that ns_answercache_store() keeps the
+ * response once it has been rendered.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		-- '*answerp' is attached to the response.
+ *\li	#ISC_R_NOTFOUND		-- no usable response.
+ */
+
+unsigned int
+ns_answercache_keybits(ns_client_t *client);
+/*%<
+ * Return the properties of the query in 'client', other than the
+ * question, that select between different responses to it.  Two
+ * queries with the same question and key bits get the same response
+ * from a view that does not rewrite responses per client.
+ */
+
+void
+ns_answercache_store(ns_answercache_t *cache, ns_client_t *client,
+		     isc_buffer_t *buffer);
+/*%<
+ * Store the sections of a response rendered into 'buffer' for a client
+ * marked by ns_answercache_find(), if the response is cacheable.  Call
+ * this after the additional section has been rendered in full and before
+ * dns_message_renderend().
+ */
+
+isc_result_t
+ns_cachedanswer_create(isc_mem_t *mctx, ns_client_t *client,
+		       isc_buffer_t *buffer, ns_cachedanswer_t **answerp);
+/*%<
+ * Copy the sections of the response to 'client' rendered into 'buffer'
+ * into a new response in '*answerp', allocated from 'mctx'.  As for
+ * ns_answercache_store(), call this after the additional section has
+ * been rendered in full and before dns_message_renderend().  The
+ * hash, generation and key bits are left for the caller to set.
+ *
+ * Requires:
+ *\li	'answerp' is not NULL and '*answerp' is NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOSPACE	-- the response is too large to keep.
+ *\li	#ISC_R_FAILURE	-- the response does not start with the query
+ *				   name as it was asked.
+ */
+
+bool
+ns_cachedanswer_fits(const ns_cachedanswer_t *answer, ns_client_t *client);
+/*%<
+ * Whether 'answer' fits in a response to 'client' without truncation.
+ */
+
+isc_result_t
+ns_answercache_render(ns_cachedanswer_t *answer, dns_message_t *msg);
+/*%<
+ * Render the sections of 'answer' into 'msg', which must have had
+ * dns_message_renderbegin() called on it.  See dns_message_renderwire().
+ */
+
+void
+ns_answercache_detach(ns_cachedanswer_t **answerp);
+/*%<
+ * Detach from a response found by ns_answercache_find().
+ */
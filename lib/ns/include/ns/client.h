@@ -82,6 +82,9 @@
 
 #define NS_CLIENT_TCP_BUFFER_SIZE  65535
 #define NS_CLIENT_SEND_BUFFER_SIZE 4096
+#define NS_CLIENT_REQ_BUFFER_SIZE  512
+#define NS_CLIENT_FREELIST_SIZE	   64
+#define NS_CLIENT_NSEC3CACHE_SIZE  64
 
 /*!
  * Client object states.  Ordering is significant: higher-numbered
@@ -138,6 +141,20 @@ typedef enum {
 
 typedef ISC_LIST(ns_client_t) client_list_t;
 
+/*%
+ * A remembered NSEC3 hash: 'hashed' is the NSEC3 owner name of 'name'
+ * with the given parameters.
+ */
+typedef struct ns_nsec3hash {
+	bool		valid;
+	dns_hash_t	hash;
+	uint16_t	iterations;
+	size_t		salt_length;
+	unsigned char	salt[255];
+	dns_fixedname_t name;
+	dns_fixedname_t hashed;
+} ns_nsec3hash_t;
+
 /*% nameserver client manager structure */
 struct ns_clientmgr {
 	/* Unlocked. */
@@ -158,8 +175,34 @@ struct ns_clientmgr {
 	/* Lock covers the recursing list */
 	isc_mutex_t   reclock;
 	client_list_t recursing; /*%< Recursing clients */
+
+	/*
+	 * Messages and send buffers of freed clients, kept for reuse by
+	 * new ones.  Only accessed from the manager's own thread.
+	 */
+	unsigned int   nfree;
+	dns_message_t *freemessages[NS_CLIENT_FREELIST_SIZE];
+	unsigned char *freesendbufs[NS_CLIENT_FREELIST_SIZE];
+
+	/*
+	 * NSEC3 hashes of recently proven names (closest enclosers and
+	 * wildcards), allocated on first use.  Only accessed from the
+	 * manager's own thread.
+	 */
+	ns_nsec3hash_t *nsec3cache;
+
+	/*
+	 * Buffer that TCP responses are rendered into before being
+	 * copied to one of exactly the right size for sending,
+	 * allocated on first use.  Only accessed from the manager's own
+	 * thread.
+	 */
+	unsigned char *renderbuf;
+	bool	       renderbuf_busy;
 };
 
+#define NS_CLIENT_ACLCACHE_SIZE 8
+
 /*% nameserver client structure */
 struct ns_client {
 	unsigned int	 magic;
@@ -187,6 +230,7 @@ struct ns_client {
 	size_t		tcpbuf_size;
 	dns_message_t  *message;
 	unsigned char  *sendbuf;
+	unsigned char  *reqbuf;
 	dns_rdataset_t *opt;
 	dns_ednsopt_t  *ede;
 	uint16_t	udpsize;
@@ -198,11 +242,16 @@ struct ns_client {
 	isc_time_t    requesttime;
 	isc_stdtime_t now;
 	isc_time_t    tnow;
+	isc_time_t    latencytime; /*%< high resolution requesttime */
+	isc_time_t    sendtime;	   /*%< latency statistics */
 	dns_name_t    signername; /*%< [T]SIG key name */
 	dns_name_t   *signer;	  /*%< NULL if not valid sig */
 	bool	      mortal;	  /*%< Die after handling request */
 	isc_quota_t  *recursionquota;
 
+	ns_prefixentry_t *recprefix; /*%< recursive-clients-per-prefix */
+	ns_prefixentry_t *tcpprefix; /*%< tcp-clients-per-prefix */
+
 	isc_sockaddr_t peeraddr;
 	bool	       peeraddr_valid;
 	isc_netaddr_t  destaddr;
@@ -227,11 +276,26 @@ struct ns_client {
 	void (*sendcb)(isc_buffer_t *buf);
 
 	ISC_LINK(ns_client_t) rlink;
+	ISC_LINK(ns_client_t) ilink; /*%< waiting on an identical query */
 	unsigned char  cookie[8];
+	unsigned char  servercookie[16]; /*%< valid server cookie to reuse */
 	uint32_t       expire;
 	unsigned char *keytag;
 	uint16_t       keytag_len;
 
+	/*%
+	 * Outcomes of the ACL checks made so far for the current request,
+	 * against the client's source address or 'destaddr'.  Several
+	 * ACLs (allow-query-cache, allow-recursion, ...) are consulted
+	 * more than once per query; this avoids evaluating them again.
+	 */
+	struct {
+		const dns_acl_t *acl;
+		bool		 dest;
+		isc_result_t	 result;
+	} aclcache[NS_CLIENT_ACLCACHE_SIZE];
+	unsigned int naclcache;
+
 	/*%
 	 * Used to override the DNS response code in ns_client_error().
 	 * If set to -1, the rcode is determined from the result code,
@@ -262,7 +326,8 @@ struct ns_client {
 #define NS_CLIENTATTR_WANTPAD	   0x08000 /*%< pad reply */
 #define NS_CLIENTATTR_USEKEEPALIVE 0x10000 /*%< use TCP keepalive */
 
-#define NS_CLIENTATTR_NOSETFC 0x20000 /*%< don't set servfail cache */
+#define NS_CLIENTATTR_NOSETFC	  0x20000 /*%< don't set servfail cache */
+#define NS_CLIENTATTR_REUSECOOKIE 0x40000 /*%< return 'servercookie' */
 
 /*
  * Flag to use with the SERVFAIL cache to indicate
@@ -386,6 +451,9 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
  * If netaddr is NULL, check the ACL against client->peeraddr;
  * otherwise check it against netaddr.
  *
+ * Checks against client->peeraddr or &client->destaddr are
+ * remembered until the end of the request.
+ *
  * Notes:
  *\li	This is appropriate for checking allow-update,
  * 	allow-query, allow-transfer, etc.  It is not appropriate
@@ -444,6 +512,17 @@ ns_client_recursing(ns_client_t *client);
  * Add client to end of th recursing list.
  */
 
+void
+ns_client_savebuffer(ns_client_t *client);
+/*%<
+ * Preserve the request wire data in client->message before the request
+ * is processed asynchronously.  The request is received directly into
+ * the network manager's per-worker buffer, which is reused as soon as
+ * the read callback returns, so it must be copied to survive; requests
+ * of up to NS_CLIENT_REQ_BUFFER_SIZE bytes are copied into a buffer
+ * that is allocated once and kept for the lifetime of the client.
+ */
+
 void
 ns_client_killoldestquery(ns_client_t *client);
 /*%<
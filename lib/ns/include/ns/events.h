@@ -23,3 +23,4 @@
 #define NS_EVENT_CLIENTCONTROL (ISC_EVENTCLASS_NS + 0)
 #define NS_EVENT_HOOKASYNCDONE (ISC_EVENTCLASS_NS + 1)
 #define NS_EVENT_IFSCAN	       (ISC_EVENTCLASS_NS + 2)
+#define NS_EVENT_INFLIGHTDONE  (ISC_EVENTCLASS_NS + 3)
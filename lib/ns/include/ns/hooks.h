@@ -218,6 +218,9 @@
  *   intermediate data for resolving the query, and will be used to resume the
  *   query handling.  The 'runasync' implementation must not modify it.
  *
+ * ns_hook_resevent_create() allocates the event with all of these fields
+ * set, and ns_hookasync_create() below allocates the matching context.
+ *
  * The hook implementation should somehow maintain the created event
  * instance so that it can eventually send the event.
  *
@@ -276,28 +279,20 @@
  * And the 'runasync' function would be something like this:
  *
  * static isc_result_t
- * runasync(query_ctx_t *qctx, void *arg, isc_taskaction_t action,
- *	    void *evarg, isc_task_t *task, ns_hookasync_t **ctxp) {
+ * runasync(query_ctx_t *qctx, isc_mem_t *mctx, void *arg, isc_task_t *task,
+ *	    isc_taskaction_t action, void *evarg, ns_hookasync_t **ctxp) {
  * 	hookstate_t *state = arg;
- *	ns_hook_resevent_t *rev = isc_event_allocate(
- *		mctx, task, NS_EVENT_HOOKASYNCDONE, action, evarg,
- *		sizeof(*rev));
- *	ns_hookasync_t *ctx = isc_mem_get(mctx, sizeof(*ctx));
- *
- *	*ctx = (ns_hookasync_t){ .private = NULL };
- *	isc_mem_attach(mctx, &ctx->mctx);
- *	ctx->cancel = ...;  // set the cancel function, which cancels the
- *			    // internal asynchronous event (if necessary).
- *			    // it should eventually result in sending
- *			    // the 'rev' event to the calling task.
- *	ctx->destroy = ...; // set the destroy function, which frees 'ctx'
- *
- *	rev->hookpoint = state->hookpoint;
- *	rev->origresult = state->origresult;
- *	rev->saved_qctx = qctx;
- *	rev->ctx = ctx;
- *
- *	state->rev = rev; // store the resume event so we can send it later
+ *	ns_hookasync_t *ctx = NULL;
+ *
+ *	// 'cancel' cancels the internal asynchronous event (if necessary);
+ *	// it should eventually result in sending the 'rev' event to the
+ *	// calling task.  A NULL 'destroy' selects ns_hookasync_destroy().
+ *	ns_hookasync_create(mctx, cancel, NULL, state, &ctx);
+ *
+ *	// store the resume event so we can send it later
+ *	state->rev = ns_hook_resevent_create(qctx, mctx, task, action,
+ *					     evarg, ctx, state->hookpoint,
+ *					     state->origresult);
  *
  *	// initiate some asynchronous process here - for example, a
  *	// recursive fetch.
@@ -308,12 +303,14 @@
  *
  * Finally, in the completion handler for the asynchronous process, we
  * need to send a resumption event so that query processing can resume.
- * For example, the completion handler might call this function:
+ * The event is delivered to the client's task, so the query resumes on
+ * the same worker thread that suspended it, just as fetch_callback() does
+ * for recursion.  For example, the completion handler might call this
+ * function:
  *
  * static void
  * asyncproc_done(hookstate_t *state) {
- *	isc_event_t *ev = (isc_event_t *)state->rev;
- *	isc_task_send(ev->ev_sender, &ev);
+ *	ns_hook_resume(&state->rev);
  * }
  *
  * Caveats:
@@ -455,8 +452,8 @@ typedef struct ns_hook_resevent {
  * as well; if not, set NS_PLUGIN_AGE to 0.
  */
 #ifndef NS_PLUGIN_VERSION
-#define NS_PLUGIN_VERSION 1
-#define NS_PLUGIN_AGE	  0
+#define NS_PLUGIN_VERSION 2
+#define NS_PLUGIN_AGE	  1
 #endif /* ifndef NS_PLUGIN_VERSION */
 
 typedef isc_result_t
@@ -610,3 +607,63 @@ ns_hooktable_create(isc_mem_t *mctx, ns_hooktable_t **tablep);
 /*%<
  * Allocate and initialize a hook table.
  */
+
+void
+ns_hookasync_create(isc_mem_t *mctx, ns_hook_cancelasync_t cancel,
+		    ns_hook_destroyasync_t destroy, void *data,
+		    ns_hookasync_t **ctxp);
+/*%<
+ * Allocate (using memory context 'mctx') a context for a hook-initiated
+ * asynchronous process, with the hook-specific 'cancel' and 'destroy'
+ * functions; 'data' is stored in ctx->private.  If 'destroy' is NULL,
+ * ns_hookasync_destroy() is used.
+ *
+ * This is intended to be called from the 'runasync' function passed to
+ * ns_query_hookasync().
+ *
+ * Requires:
+ *\li 'mctx' is not NULL
+ *
+ *\li 'cancel' is not NULL
+ *
+ *\li 'ctxp' is not NULL and '*ctxp' is NULL
+ */
+
+void
+ns_hookasync_destroy(ns_hookasync_t **ctxp);
+/*%<
+ * Free a context allocated by ns_hookasync_create().  Hook-specific
+ * 'destroy' functions can call this after releasing their private data.
+ *
+ * Requires:
+ *\li 'ctxp' is not NULL and '*ctxp' is a valid context
+ */
+
+ns_hook_resevent_t *
+ns_hook_resevent_create(query_ctx_t *qctx, isc_mem_t *mctx, isc_task_t *task,
+			isc_taskaction_t action, void *evarg,
+			ns_hookasync_t *ctx, ns_hookpoint_t hookpoint,
+			isc_result_t origresult);
+/*%<
+ * Allocate the event that will resume query processing from 'hookpoint'
+ * on completion of the asynchronous process 'ctx'.  'qctx', 'mctx',
+ * 'task', 'action' and 'evarg' are the values passed to the 'runasync'
+ * function; 'origresult' is the result code that was passed to the
+ * hook action which started the process.
+ *
+ * The event is later sent with ns_hook_resume().
+ *
+ * Requires:
+ *\li 'qctx', 'mctx', 'task', 'action' and 'ctx' are not NULL
+ */
+
+void
+ns_hook_resume(ns_hook_resevent_t **revp);
+/*%<
+ * Send a resume event created by ns_hook_resevent_create() to the client
+ * task it was created for, so that query processing continues on the
+ * worker that started the asynchronous process.  '*revp' is set to NULL.
+ *
+ * Requires:
+ *\li 'revp' is not NULL and '*revp' is not NULL
+ */
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file
+ * \brief
+ * Recursive queries waiting on an identical query already in progress.
+ *
+ * When a client has to recurse for a question that another client of
+ * the same view is already recursing for, with the same key bits (see
+ * ns_answercache_keybits()), the second client does not start a fetch
+ * of its own.  It is added to the first client's list of waiters
+ * instead.  Once the first client's response has been rendered, its
+ * sections are handed to every waiter, which only has to add its own
+ * header and OPT record to reply; the cache is not searched again and
+ * nothing is rendered again for the waiters.  If no response can be
+ * shared, the waiters look the question up on their own.
+ *
+ * Only views and queries whose responses cannot differ between clients
+ * take part: see ns_inflight_join().
+ */
+
+#include <isc/buffer.h>
+#include <isc/event.h>
+#include <isc/types.h>
+
+#include <ns/types.h>
+
+/*% Sent to a waiting client when it stops waiting. */
+typedef struct ns_inflightevent {
+	ISC_EVENT_COMMON(struct ns_inflightevent);
+	/*%
+	 * #ISC_R_SUCCESS with the response in 'answer', #ISC_R_NOTFOUND
+	 * if the client has to look the question up itself, or
+	 * #ISC_R_CANCELED if the wait was canceled.
+	 */
+	isc_result_t	   result;
+	ns_cachedanswer_t *answer;
+} ns_inflightevent_t;
+
+void
+ns_inflight_create(isc_mem_t *mctx, ns_inflight_t **tablep);
+/*%<
+ * Create an empty table of recursive queries in progress.
+ *
+ * Requires:
+ *\li	'tablep' is not NULL and '*tablep' is NULL.
+ */
+
+void
+ns_inflight_destroy(ns_inflight_t **tablep);
+/*%<
+ * Destroy the table, which must be empty.
+ */
+
+bool
+ns_inflight_join(ns_inflight_t *table, ns_client_t *client,
+		 isc_taskaction_t action);
+/*%<
+ * Called by 'client' before it starts a fetch for its question.
+ *
+ * If an identical query is already in progress, add 'client' to its
+ * waiters and return true; 'action' will be sent an
+ * #ns_inflightevent_t on the client's task when it stops waiting.
+ * Otherwise, register 'client' as the query in progress if it may be
+ * shared, and return false: the client must start its fetch.
+ *
+ * Queries are only shared in recursive views without response-policy,
+ * dns64, sortlist, rate-limit, no-case-compress or plugins, for the
+ * original question of queries without TSIG, SIG(0) or ECS.
+ */
+
+void
+ns_inflight_done(ns_inflight_t *table, ns_client_t *client,
+		 isc_buffer_t *buffer);
+/*%<
+ * End the query in progress registered by 'client', if any, and
+ * release its waiters.  If 'buffer' is not NULL, it holds the
+ * client's response rendered up to the end of the additional section
+ * (as for ns_answercache_store()), and that response is handed to the
+ * waiters if it can be shared.
+ */
+
+void
+ns_inflight_cancel(ns_inflight_t *table, ns_client_t *client);
+/*%<
+ * If 'client' is waiting on another query, stop waiting; it is sent
+ * an event with #ISC_R_CANCELED.
+ */
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file
+ * \brief
+ * Per-prefix limits on concurrent recursive queries and TCP connections.
+ *
+ * Client addresses are grouped by network prefix (for instance /24 for
+ * IPv4 and /56 for IPv6), and the recursive queries and TCP connections
+ * of each prefix in progress are counted, so that a single network
+ * cannot take all of the recursive-clients or tcp-clients quota.
+ *
+ * The counts are kept in a table split into shards, each with its own
+ * lock.  The table holds at most #NS_PREFIXLIMIT_MAXENTRIES prefixes:
+ * when a shard is full, the prefix without anything in progress that
+ * was least recently used is dropped.  If every prefix of the shard
+ * has something in progress, new prefixes are not counted, and not
+ * limited, until one of them is done.  Since each prefix in the table
+ * holds at least one recursive client or TCP connection, this cannot
+ * happen unless those quotas are larger than the table.
+ */
+
+#include <stdbool.h>
+
+#include <isc/netaddr.h>
+#include <isc/types.h>
+
+#include <ns/types.h>
+
+/*% Most prefixes counted at a time */
+#define NS_PREFIXLIMIT_MAXENTRIES 65536
+
+/*% What is counted for a prefix */
+typedef enum {
+	ns_prefixlimit_recursion = 0, /*%< recursive queries */
+	ns_prefixlimit_tcp = 1,	      /*%< TCP connections */
+	ns_prefixlimit_kinds = 2
+} ns_prefixlimit_kind_t;
+
+void
+ns_prefixlimit_create(isc_mem_t *mctx, ns_prefixlimit_t **plp);
+/*%<
+ * Create an empty table, with no limits.
+ *
+ * Requires:
+ *\li	'plp' is not NULL and '*plp' is NULL.
+ */
+
+void
+ns_prefixlimit_destroy(ns_prefixlimit_t **plp);
+/*%<
+ * Destroy the table.  Nothing may be held on any of its prefixes.
+ */
+
+void
+ns_prefixlimit_configure(ns_prefixlimit_t *pl, unsigned int recursion,
+			 unsigned int tcp, unsigned int prefixlen4,
+			 unsigned int prefixlen6);
+/*%<
+ * Set the highest number of recursive queries and of TCP connections
+ * that a prefix may have in progress (zero for no limit), and the
+ * lengths of IPv4 and IPv6 prefixes.  What is already held stays
+ * counted on the prefix it was acquired for.
+ *
+ * Requires:
+ *\li	'prefixlen4' is at most 32 and 'prefixlen6' is at most 128.
+ */
+
+isc_result_t
+ns_prefixlimit_check(ns_prefixlimit_t *pl, const isc_netaddr_t *addr,
+		     ns_prefixlimit_kind_t kind);
+/*%<
+ * Check, without counting anything, whether the prefix of 'addr' has
+ * reached its limit of 'kind'.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS	the limit has not been reached
+ *\li	#ISC_R_QUOTA	the limit has been reached
+ */
+
+isc_result_t
+ns_prefixlimit_acquire(ns_prefixlimit_t *pl, const isc_netaddr_t *addr,
+		       ns_prefixlimit_kind_t kind, ns_prefixentry_t **entryp);
+/*%<
+ * Count one more 'kind' in progress for the prefix of 'addr', unless
+ * its limit has been reached.  On success, '*entryp' is set to the
+ * prefix the count is held on, to be passed to
+ * ns_prefixlimit_release(); it is left NULL if nothing was counted,
+ * because there is no limit or the table is full.
+ *
+ * Requires:
+ *\li	'entryp' is not NULL and '*entryp' is NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_QUOTA	the limit of the prefix has been reached
+ */
+
+void
+ns_prefixlimit_release(ns_prefixlimit_t *pl, ns_prefixlimit_kind_t kind,
+		       ns_prefixentry_t **entryp);
+/*%<
+ * Release a count held on '*entryp' by ns_prefixlimit_acquire() for
+ * the same 'kind', and set '*entryp' to NULL.
+ */
@@ -20,6 +20,7 @@
 #include <isc/buffer.h>
 #include <isc/netaddr.h>
 #include <isc/task.h>
+#include <isc/time.h>
 #include <isc/types.h>
 
 #include <dns/rdataset.h>
@@ -68,6 +69,7 @@ struct ns_query {
 	isc_mutex_t	 fetchlock;
 	dns_fetch_t	*fetch;
 	dns_fetch_t	*prefetch;
+	isc_time_t	 fetchtime; /*%< latency statistics */
 	ns_hookasync_t	*hookactx;
 	dns_rpz_st_t	*rpz_st;
 	isc_bufferlist_t namebufs;
@@ -99,6 +101,14 @@ struct ns_query {
 	dns_keytag_t root_key_sentinel_keyid;
 	bool	     root_key_sentinel_is_ta;
 	bool	     root_key_sentinel_not_ta;
+
+	ns_cachedanswer_t *cachedanswer; /* rendered response to send */
+	uint32_t	   answergen;	 /* zone data generation */
+	unsigned int	   answerkey;	 /* answer cache key bits */
+
+	ns_inflightentry_t *inflight; /* identical query in progress */
+	bool		    inflightleader;
+	unsigned int	    inflightbucket;
 };
 
 #define NS_QUERYATTR_RECURSIONOK     0x000001
@@ -121,6 +131,9 @@ struct ns_query {
 #define NS_QUERYATTR_ANSWERED	     0x040000
 #define NS_QUERYATTR_STALEOK	     0x080000
 #define NS_QUERYATTR_STALEPENDING    0x100000
+#define NS_QUERYATTR_ANSWERCACHE     0x200000
+#define NS_QUERYATTR_DLZASYNC	     0x400000
+#define NS_QUERYATTR_NOINFLIGHT	     0x800000
 
 typedef struct query_ctx query_ctx_t;
 
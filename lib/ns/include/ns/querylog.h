@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file
+ * \brief
+ * Binary query log.
+ *
+ * Every response sent is recorded as a fixed-size record, without any
+ * conversion to text, so that all queries can be logged at full rate
+ * and decoded offline.  Records are collected in per-thread buffers
+ * and appended to the log file a buffer at a time; a buffer is also
+ * written out when a record is added to it a second or more after its
+ * oldest one.  If a write fails or is short (for instance, to a FIFO
+ * without a reader), the records are dropped.
+ *
+ * A new file starts with a header of NS_QUERYLOG_RECORDSIZE bytes:
+ *
+ *\li	"BIND9QLG" magic, then the format version and the record size
+ *	as 32-bit integers; the rest is zero.
+ *
+ * followed by records of NS_QUERYLOG_RECORDSIZE bytes.  All integers
+ * are in network byte order:
+ *
+ *\li	offset 0: time the query was received, in microseconds since
+ *	the epoch (64 bits)
+ *\li	offset 8: time until the response was sent, in microseconds
+ *	(32 bits)
+ *\li	offset 12: query type (16 bits)
+ *\li	offset 14: query class (16 bits)
+ *\li	offset 16: NS_QUERYLOG_FLAG_* flags (16 bits)
+ *\li	offset 18: response code, including the extended bits (16 bits)
+ *\li	offset 20: client port (16 bits)
+ *\li	offset 22: client address family, 4 or 6 (8 bits)
+ *\li	offset 23: length of the query name (8 bits), zero if there was
+ *	no question
+ *\li	offset 24: client address (16 bytes, IPv4 in the first 4)
+ *\li	offset 40: query name in uncompressed wire format (256 bytes)
+ */
+
+#include <isc/types.h>
+
+#include <ns/types.h>
+
+#define NS_QUERYLOG_VERSION    1
+#define NS_QUERYLOG_RECORDSIZE 296
+
+#define NS_QUERYLOG_FLAG_RD	0x0001 /*%< recursion desired */
+#define NS_QUERYLOG_FLAG_CD	0x0002 /*%< checking disabled */
+#define NS_QUERYLOG_FLAG_DO	0x0004 /*%< DNSSEC OK */
+#define NS_QUERYLOG_FLAG_EDNS	0x0008 /*%< EDNS was used */
+#define NS_QUERYLOG_FLAG_TCP	0x0010 /*%< over TCP */
+#define NS_QUERYLOG_FLAG_SIGNED 0x0020 /*%< TSIG or SIG(0) signed */
+#define NS_QUERYLOG_FLAG_COOKIE 0x0040 /*%< valid server cookie */
+#define NS_QUERYLOG_FLAG_ECS	0x0080 /*%< EDNS client subnet */
+
+isc_result_t
+ns_querylog_create(isc_mem_t *mctx, const char *path, ns_querylog_t **qlogp);
+/*%<
+ * Open 'path' for appending, creating it if needed, and return a query
+ * log writing to it in '*qlogp'.
+ *
+ * Requires:
+ *\li	'path' is not NULL.
+ *\li	'qlogp' is not NULL and '*qlogp' is NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	Any error opening or writing to 'path'.
+ */
+
+void
+ns_querylog_destroy(ns_querylog_t **qlogp);
+/*%<
+ * Write out the buffered records, close the file and free the query
+ * log.
+ *
+ * Requires:
+ *\li	'*qlogp' is a valid query log, no longer used by other threads.
+ */
+
+void
+ns_querylog_log(ns_querylog_t *qlog, ns_client_t *client);
+/*%<
+ * Record the response about to be sent to 'client'.
+ *
+ * Requires:
+ *\li	'qlog' is a valid query log.
+ *\li	'client' is a valid client with a rendered response.
+ */
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file
+ * \brief
+ * Adaptive soft limit for recursive clients.
+ *
+ * The limiter watches how long recursive fetches take to complete and
+ * moves the soft quota of the recursive-clients quota between a floor
+ * and the configured soft quota.  Each window of completed fetches is
+ * compared with a baseline that follows the lowest latency seen
+ * recently: when fetches slow down, the soft quota shrinks in
+ * proportion, so that more of the oldest pending queries are dropped
+ * instead of piling up; when they speed up again, it grows back by
+ * roughly the square root of its current value per window.
+ *
+ * The hard quota is never changed.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/mutex.h>
+#include <isc/quota.h>
+#include <isc/types.h>
+
+#include <ns/stats.h>
+#include <ns/types.h>
+
+/*% Completed fetches per adjustment */
+#define NS_RECLIMIT_WINDOW 128
+
+struct ns_reclimit {
+	isc_mutex_t  lock;
+	isc_quota_t *quota;
+	atomic_bool  enabled;
+	unsigned int ceiling;  /*%< configured soft quota */
+	unsigned int floor;    /*%< lowest soft quota used */
+	unsigned int limit;    /*%< current soft quota */
+	unsigned int samples;  /*%< fetches in the current window */
+	uint64_t     total;    /*%< their total latency (microseconds) */
+	uint64_t     baseline; /*%< healthy window latency (microseconds) */
+};
+
+void
+ns_reclimit_init(ns_reclimit_t *rl, isc_quota_t *quota);
+/*%<
+ * Initialize a disabled limiter for 'quota'.
+ */
+
+void
+ns_reclimit_destroy(ns_reclimit_t *rl);
+/*%<
+ * Free the resources used by 'rl'.
+ */
+
+void
+ns_reclimit_configure(ns_reclimit_t *rl, bool enabled, unsigned int soft);
+/*%<
+ * Enable or disable adaptation and set its ceiling to 'soft', the soft
+ * quota that would be used without it.  The soft quota of the quota is
+ * set to 'soft', and adaptation starts again from there.
+ *
+ * Requires:
+ *\li	'soft' is greater than zero.
+ */
+
+void
+ns_reclimit_sample(ns_reclimit_t *rl, uint64_t usecs, ns_stats_t *stats);
+/*%<
+ * Account for a fetch that completed after 'usecs' microseconds, and
+ * adjust the soft quota at the end of a window.  Changes are counted
+ * in 'stats' (ns_statscounter_reclimitlowered and
+ * ns_statscounter_reclimitraised) if it is not NULL.
+ */
+
+bool
+ns_reclimit_enabled(ns_reclimit_t *rl);
+/*%<
+ * Return true if adaptation is enabled.
+ */
@@ -30,6 +30,8 @@
 #include <dns/types.h>
 
 #include <ns/events.h>
+#include <ns/prefixlimit.h>
+#include <ns/reclimit.h>
 #include <ns/types.h>
 
 #define NS_SERVER_LOGQUERIES	 0x00000001U /*%< log queries */
@@ -49,6 +51,7 @@
 #define NS_SERVER_TRANSFERINSECS 0x00008000U /*%< -T transferinsecs */
 #define NS_SERVER_TRANSFERSLOWLY 0x00010000U /*%< -T transferslowly */
 #define NS_SERVER_TRANSFERSTUCK	 0x00020000U /*%< -T transferstuck */
+#define NS_SERVER_LATENCYSTATS	 0x00040000U /*%< latency statistics */
 
 /*%
  * Type for callback function to get hostname.
@@ -91,6 +94,21 @@ struct ns_server {
 	ISC_LIST(isc_quota_t) http_quotas;
 	isc_mutex_t http_quotas_lock;
 
+	/*% Adaptive soft limit for recursionquota */
+	ns_reclimit_t reclimit;
+
+	/*% Per-prefix recursive clients and TCP connections */
+	ns_prefixlimit_t *prefixlimit;
+
+	/*% Recursive queries in progress, for identical queries to join */
+	ns_inflight_t *inflight;
+
+	/*% Rendered AXFR responses */
+	ns_xfrcache_t *xfrcache;
+
+	/*% Binary query log, or NULL */
+	ns_querylog_t *querylog;
+
 	/*% Test options and other configurables */
 	uint32_t options;
 
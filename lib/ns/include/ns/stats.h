@@ -15,6 +15,8 @@
 
 /*! \file include/ns/stats.h */
 
+#include <isc/time.h>
+
 #include <ns/types.h>
 
 /*%
@@ -109,9 +111,41 @@ enum {
 
 	ns_statscounter_updatequota = 67,
 
-	ns_statscounter_max = 68,
+	ns_statscounter_reclimitlowered = 68,
+	ns_statscounter_reclimitraised = 69,
+
+	ns_statscounter_xfrcached = 70,
+
+	ns_statscounter_recursjoined = 71,
+
+	ns_statscounter_recursprefixquota = 72,
+	ns_statscounter_tcpprefixquota = 73,
+
+	ns_statscounter_max = 74,
 };
 
+/*%
+ * Query latency statistics.  For each stage of query processing there is
+ * a histogram of NS_LATENCY_BUCKETS counters: the first counts durations
+ * below 1 microsecond, counter 'n' durations of at least 2^(n-1) and
+ * below 2^n microseconds, and the last one any longer duration.  Counter
+ * 'n' of stage 's' is counter s * NS_LATENCY_BUCKETS + n of the set.
+ */
+#define NS_LATENCY_BUCKETS 24
+
+typedef enum {
+	ns_latency_viewmatch = 0, /*%< request received to view match */
+	ns_latency_lookup = 1,	  /*%< each database lookup of a query */
+	ns_latency_recursion = 2, /*%< fetch started to fetch completed */
+	ns_latency_render = 3,	  /*%< rendering of the response */
+	ns_latency_send = 4,	  /*%< send started to send completed */
+	ns_latency_total = 5,	  /*%< request received to response sent */
+
+	ns_latency_max = 6,
+} ns_latency_t;
+
+#define ns_latencystatscounter_max (ns_latency_max * NS_LATENCY_BUCKETS)
+
 void
 ns_stats_attach(ns_stats_t *stats, ns_stats_t **statsp);
 
@@ -136,3 +170,18 @@ ns_stats_update_if_greater(ns_stats_t *stats, isc_statscounter_t counter,
 
 isc_statscounter_t
 ns_stats_get_counter(ns_stats_t *stats, isc_statscounter_t counter);
+
+isc_result_t
+ns_latencystats_create(isc_mem_t *mctx, isc_stats_t **statsp);
+/*%<
+ * Create a set of query latency statistics counters.
+ */
+
+void
+ns_latencystats_add(isc_stats_t *stats, ns_latency_t stage,
+		    const isc_time_t *start);
+/*%<
+ * Count the time from 'start' until now, taken with TIME_NOW_HIRES(), in
+ * the histogram of 'stage'.  Nothing is counted if 'stats' is NULL or
+ * 'start' is the epoch.
+ */
@@ -21,12 +21,21 @@ typedef struct ns_client    ns_client_t;
 typedef struct ns_clientmgr ns_clientmgr_t;
 typedef struct ns_plugin    ns_plugin_t;
 typedef ISC_LIST(ns_plugin_t) ns_plugins_t;
-typedef struct ns_interface    ns_interface_t;
-typedef struct ns_interfacemgr ns_interfacemgr_t;
-typedef struct ns_query	       ns_query_t;
-typedef struct ns_server       ns_server_t;
-typedef struct ns_stats	       ns_stats_t;
-typedef struct ns_hookasync    ns_hookasync_t;
+typedef struct ns_inflight	ns_inflight_t;
+typedef struct ns_inflightentry	ns_inflightentry_t;
+typedef struct ns_interface	ns_interface_t;
+typedef struct ns_interfacemgr	ns_interfacemgr_t;
+typedef struct ns_prefixentry	ns_prefixentry_t;
+typedef struct ns_prefixlimit	ns_prefixlimit_t;
+typedef struct ns_query		ns_query_t;
+typedef struct ns_querylog	ns_querylog_t;
+typedef struct ns_server	ns_server_t;
+typedef struct ns_stats		ns_stats_t;
+typedef struct ns_hookasync	ns_hookasync_t;
+typedef struct ns_answercache	ns_answercache_t;
+typedef struct ns_cachedanswer	ns_cachedanswer_t;
+typedef struct ns_reclimit	ns_reclimit_t;
+typedef struct ns_xfrcache	ns_xfrcache_t;
 
 typedef enum { ns_cookiealg_aes, ns_cookiealg_siphash24 } ns_cookiealg_t;
 
@@ -22,9 +22,41 @@
  * Outgoing zone transfers (AXFR + IXFR).
  */
 
+#include <stddef.h>
+
+#include <isc/types.h>
+
+#include <dns/types.h>
+
+#include <ns/types.h>
+
 /***
  *** Functions
  ***/
 
 void
 ns_xfr_start(ns_client_t *client, dns_rdatatype_t xfrtype);
+
+void
+ns_xfrcache_create(isc_mem_t *mctx, ns_xfrcache_t **cachep);
+/*%<
+ * Create an empty cache of rendered zone transfer responses.  Caching is
+ * disabled until a size is set with ns_xfrcache_setmaxsize().
+ *
+ * Requires:
+ *\li	'cachep' is not NULL and '*cachep' is NULL.
+ */
+
+void
+ns_xfrcache_destroy(ns_xfrcache_t **cachep);
+/*%<
+ * Destroy the cache.  Transfers still being served from it keep
+ * their responses until they are done.
+ */
+
+void
+ns_xfrcache_setmaxsize(ns_xfrcache_t *cache, size_t size);
+/*%<
+ * Set the total size of the responses kept in 'cache'; zero disables
+ * the cache.  Entries over the limit are freed.
+ */
@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/hash.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/result.h>
+#include <isc/task.h>
+#include <isc/util.h>
+
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdatatype.h>
+#include <dns/view.h>
+
+#include <ns/answercache.h>
+#include <ns/client.h>
+#include <ns/events.h>
+#include <ns/inflight.h>
+#include <ns/query.h>
+
+#define INFLIGHT_MAGIC	  ISC_MAGIC('I', 'n', 'F', 'l')
+#define VALID_INFLIGHT(t) ISC_MAGIC_VALID(t, INFLIGHT_MAGIC)
+
+/*%
+ * Number of hash buckets, and of locks protecting them; bucket 'i' is
+ * protected by lock 'i % INFLIGHT_NLOCKS'.
+ */
+#define INFLIGHT_BUCKETS 1024
+#define INFLIGHT_NLOCKS	 64
+
+/*% A query in progress and the clients waiting for its response. */
+struct ns_inflightentry {
+	uint32_t	 hash;
+	dns_view_t	*view; /*%< not attached; the leader holds it */
+	dns_rdatatype_t	 qtype;
+	dns_rdataclass_t qclass;
+	unsigned int	 keybits;
+	dns_fixedname_t	 fname;
+	dns_name_t	*name;
+	isc_taskaction_t action;
+	ISC_LIST(ns_client_t) waiters;
+	ISC_LINK(ns_inflightentry_t) link;
+};
+
+struct ns_inflight {
+	unsigned int magic;
+	isc_mem_t   *mctx;
+	ISC_LIST(ns_inflightentry_t) buckets[INFLIGHT_BUCKETS];
+	isc_mutex_t locks[INFLIGHT_NLOCKS];
+};
+
+#define BUCKETLOCK(t, b) (&(t)->locks[(b) % INFLIGHT_NLOCKS])
+
+void
+ns_inflight_create(isc_mem_t *mctx, ns_inflight_t **tablep) {
+	ns_inflight_t *table = NULL;
+
+	REQUIRE(tablep != NULL && *tablep == NULL);
+
+	table = isc_mem_get(mctx, sizeof(*table));
+	*table = (ns_inflight_t){ .magic = 0 };
+	isc_mem_attach(mctx, &table->mctx);
+	for (size_t i = 0; i < INFLIGHT_BUCKETS; i++) {
+		ISC_LIST_INIT(table->buckets[i]);
+	}
+	for (size_t i = 0; i < INFLIGHT_NLOCKS; i++) {
+		isc_mutex_init(&table->locks[i]);
+	}
+
+	table->magic = INFLIGHT_MAGIC;
+	*tablep = table;
+}
+
+void
+ns_inflight_destroy(ns_inflight_t **tablep) {
+	ns_inflight_t *table = NULL;
+
+	REQUIRE(tablep != NULL && VALID_INFLIGHT(*tablep));
+
+	table = *tablep;
+	*tablep = NULL;
+
+	table->magic = 0;
+	for (size_t i = 0; i < INFLIGHT_BUCKETS; i++) {
+		INSIST(ISC_LIST_EMPTY(table->buckets[i]));
+	}
+	for (size_t i = 0; i < INFLIGHT_NLOCKS; i++) {
+		isc_mutex_destroy(&table->locks[i]);
+	}
+	isc_mem_putanddetach(&table->mctx, table, sizeof(*table));
+}
+
+/*
+ * Whether responses in 'view' depend only on the question and the key
+ * bits; compare view_cacheable() in answercache.c.
+ */
+static bool
+view_shareable(dns_view_t *view) {
+	return (view->recursion && view->rpzs == NULL && view->rrl == NULL &&
+		view->sortlist == NULL && view->nocasecompress == NULL &&
+		view->hooktable == NULL && ISC_LIST_EMPTY(view->dns64));
+}
+
+static bool
+query_shareable(ns_client_t *client) {
+	dns_message_t *message = client->message;
+
+	return (view_shareable(client->view) && message->tsigkey == NULL &&
+		message->sig0key == NULL &&
+		(client->attributes & NS_CLIENTATTR_HAVEECS) == 0 &&
+		(client->query.attributes & NS_QUERYATTR_NOINFLIGHT) == 0 &&
+		client->query.restarts == 0 &&
+		client->query.qname == client->query.origqname &&
+		client->query.rpz_st == NULL &&
+		!dns_rdatatype_ismeta(client->query.qtype));
+}
+
+static bool
+entry_matches(const ns_inflightentry_t *entry, uint32_t hash,
+	      dns_view_t *view, const dns_name_t *qname,
+	      dns_rdatatype_t qtype, dns_rdataclass_t qclass,
+	      unsigned int keybits) {
+	return (entry->hash == hash && entry->view == view &&
+		entry->keybits == keybits && entry->qtype == qtype &&
+		entry->qclass == qclass &&
+		entry->name->length == qname->length &&
+		memcmp(entry->name->ndata, qname->ndata, qname->length) == 0);
+}
+
+bool
+ns_inflight_join(ns_inflight_t *table, ns_client_t *client,
+		 isc_taskaction_t action) {
+	ns_inflightentry_t *entry = NULL;
+	const dns_name_t *qname = client->query.qname;
+	dns_rdatatype_t qtype = client->query.qtype;
+	dns_rdataclass_t qclass = client->message->rdclass;
+	unsigned int keybits, bucket;
+	uint32_t hash;
+
+	REQUIRE(VALID_INFLIGHT(table));
+	REQUIRE(NS_CLIENT_VALID(client));
+
+	if (client->query.inflight != NULL || !query_shareable(client)) {
+		return (false);
+	}
+
+	/*
+	 * The name is compared case-sensitively, because the waiters get
+	 * the question section exactly as the leader asked it.
+	 */
+	keybits = ns_answercache_keybits(client);
+	hash = isc_hash32(qname->ndata, qname->length, true) ^
+	       (((uint32_t)qtype << 16 | keybits) * 0x9e3779b1U);
+	bucket = hash % INFLIGHT_BUCKETS;
+
+	LOCK(BUCKETLOCK(table, bucket));
+	for (entry = ISC_LIST_HEAD(table->buckets[bucket]); entry != NULL;
+	     entry = ISC_LIST_NEXT(entry, link))
+	{
+		if (entry_matches(entry, hash, client->view, qname, qtype,
+				  qclass, keybits))
+		{
+			ISC_LIST_APPEND(entry->waiters, client, ilink);
+			client->query.inflight = entry;
+			client->query.inflightleader = false;
+			client->query.inflightbucket = bucket;
+			UNLOCK(BUCKETLOCK(table, bucket));
+			return (true);
+		}
+	}
+
+	entry = isc_mem_get(table->mctx, sizeof(*entry));
+	*entry = (ns_inflightentry_t){
+		.hash = hash,
+		.view = client->view,
+		.qtype = qtype,
+		.qclass = qclass,
+		.keybits = keybits,
+		.action = action,
+		.waiters = ISC_LIST_INITIALIZER,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	entry->name = dns_fixedname_initname(&entry->fname);
+	dns_name_copy(qname, entry->name);
+	ISC_LIST_APPEND(table->buckets[bucket], entry, link);
+	client->query.inflight = entry;
+	client->query.inflightleader = true;
+	client->query.inflightbucket = bucket;
+	UNLOCK(BUCKETLOCK(table, bucket));
+
+	return (false);
+}
+
+/*
+ * Whether the rendered response to the leader 'client' may be given to
+ * its waiters.  Responses to the query alone (SERVFAIL, which may come
+ * from the leader being canceled, truncation, extended errors such as
+ * those of stale answers) are not shared.
+ */
+static bool
+response_shareable(ns_client_t *client) {
+	if (client->message->rcode != dns_rcode_noerror &&
+	    client->message->rcode != dns_rcode_nxdomain)
+	{
+		return (false);
+	}
+	return ((client->message->flags & DNS_MESSAGEFLAG_TC) == 0 &&
+		(client->query.attributes & NS_QUERYATTR_REDIRECT) == 0 &&
+		client->ede == NULL);
+}
+
+static void
+send_event(ns_client_t *client, isc_taskaction_t action, isc_result_t result,
+	   ns_cachedanswer_t *answer) {
+	ns_inflightevent_t *event = NULL;
+
+	event = (ns_inflightevent_t *)isc_event_allocate(
+		client->mctx, client, NS_EVENT_INFLIGHTDONE, action, client,
+		sizeof(*event));
+	event->result = result;
+	event->answer = NULL;
+	if (answer != NULL) {
+		isc_refcount_increment(&answer->references);
+		event->answer = answer;
+	}
+	isc_task_send(client->task, ISC_EVENT_PTR(&event));
+}
+
+void
+ns_inflight_done(ns_inflight_t *table, ns_client_t *client,
+		 isc_buffer_t *buffer) {
+	ns_inflightentry_t *entry = NULL;
+	ns_cachedanswer_t *answer = NULL;
+	ns_client_t *waiter = NULL;
+	unsigned int bucket;
+
+	REQUIRE(VALID_INFLIGHT(table));
+	REQUIRE(NS_CLIENT_VALID(client));
+
+	entry = client->query.inflight;
+	if (entry == NULL || !client->query.inflightleader) {
+		return;
+	}
+
+	if (buffer != NULL && response_shareable(client)) {
+		(void)ns_cachedanswer_create(table->mctx, client, buffer,
+					     &answer);
+	}
+
+	bucket = client->query.inflightbucket;
+	client->query.inflight = NULL;
+	client->query.inflightleader = false;
+
+	LOCK(BUCKETLOCK(table, bucket));
+	ISC_LIST_UNLINK(table->buckets[bucket], entry, link);
+	for (waiter = ISC_LIST_HEAD(entry->waiters); waiter != NULL;
+	     waiter = ISC_LIST_NEXT(waiter, ilink))
+	{
+		waiter->query.inflight = NULL;
+	}
+	UNLOCK(BUCKETLOCK(table, bucket));
+
+	/*
+	 * The waiters are no longer reachable through the table, so
+	 * ns_inflight_cancel() leaves them alone.  Unlink each one before
+	 * its event is sent: it may be reused as soon as it has run.
+	 */
+	while ((waiter = ISC_LIST_HEAD(entry->waiters)) != NULL) {
+		ISC_LIST_UNLINK(entry->waiters, waiter, ilink);
+		if (answer != NULL && ns_cachedanswer_fits(answer, waiter)) {
+			send_event(waiter, entry->action, ISC_R_SUCCESS,
+				   answer);
+		} else {
+			send_event(waiter, entry->action, ISC_R_NOTFOUND,
+				   NULL);
+		}
+	}
+
+	if (answer != NULL) {
+		ns_answercache_detach(&answer);
+	}
+	isc_mem_put(table->mctx, entry, sizeof(*entry));
+}
+
+void
+ns_inflight_cancel(ns_inflight_t *table, ns_client_t *client) {
+	ns_inflightentry_t *entry = NULL;
+	unsigned int bucket;
+
+	REQUIRE(VALID_INFLIGHT(table));
+	REQUIRE(NS_CLIENT_VALID(client));
+
+	if (client->query.inflight == NULL || client->query.inflightleader) {
+		return;
+	}
+
+	bucket = client->query.inflightbucket;
+	LOCK(BUCKETLOCK(table, bucket));
+	entry = client->query.inflight;
+	if (entry != NULL) {
+		ISC_LIST_UNLINK(entry->waiters, client, ilink);
+		client->query.inflight = NULL;
+	}
+	UNLOCK(BUCKETLOCK(table, bucket));
+
+	if (entry != NULL) {
+		send_event(client, entry->action, ISC_R_CANCELED, NULL);
+	}
+}
@@ -15,6 +15,7 @@
 
 #include <stdbool.h>
 
+#include <isc/ht.h>
 #include <isc/interfaceiter.h>
 #include <isc/netmgr.h>
 #include <isc/os.h>
@@ -84,13 +85,21 @@ struct ns_interfacemgr {
 	ns_listenlist_t *listenon6;
 	dns_aclenv_t *aclenv;		     /*%< Localhost/localnets ACLs */
 	ISC_LIST(ns_interface_t) interfaces; /*%< List of interfaces */
+	isc_ht_t *interfacesbyaddr;	     /*%< Interfaces by address */
 	ISC_LIST(isc_sockaddr_t) listenon;
+	isc_ht_t *listenonbyaddr; /*%< Listen-on addresses by address */
 	int backlog;		     /*%< Listen queue size */
 	atomic_bool shuttingdown;    /*%< Interfacemgr shutting down */
 	ns_clientmgr_t **clientmgrs; /*%< Client managers */
 	isc_nmhandle_t *route;
 };
 
+/*%
+ * Large enough for the family, port, address and scope of an IPv6
+ * socket address.
+ */
+#define SOCKADDR_KEYSIZE (1 + sizeof(in_port_t) + sizeof(struct in6_addr) + 4)
+
 static void
 purge_old_interfaces(ns_interfacemgr_t *mgr);
 
@@ -311,6 +320,8 @@ ns_interfacemgr_create(isc_mem_t *mctx, ns_server_t *sctx,
 
 	ISC_LIST_INIT(mgr->interfaces);
 	ISC_LIST_INIT(mgr->listenon);
+	isc_ht_init(&mgr->interfacesbyaddr, mctx, 4, ISC_HT_CASE_SENSITIVE);
+	isc_ht_init(&mgr->listenonbyaddr, mctx, 4, ISC_HT_CASE_SENSITIVE);
 
 	/*
 	 * The listen-on lists are initially empty.
@@ -366,6 +377,8 @@ cleanup_listenon:
 	ns_listenlist_detach(&mgr->listenon4);
 	ns_listenlist_detach(&mgr->listenon6);
 cleanup_task:
+	isc_ht_destroy(&mgr->interfacesbyaddr);
+	isc_ht_destroy(&mgr->listenonbyaddr);
 	isc_task_detach(&mgr->task);
 cleanup_lock:
 	isc_mutex_destroy(&mgr->lock);
@@ -384,6 +397,8 @@ ns_interfacemgr_destroy(ns_interfacemgr_t *mgr) {
 	ns_listenlist_detach(&mgr->listenon4);
 	ns_listenlist_detach(&mgr->listenon6);
 	clearlistenon(mgr);
+	isc_ht_destroy(&mgr->interfacesbyaddr);
+	isc_ht_destroy(&mgr->listenonbyaddr);
 	isc_mutex_destroy(&mgr->lock);
 	for (size_t i = 0; i < (size_t)mgr->ncpus; i++) {
 		ns_clientmgr_detach(&mgr->clientmgrs[i]);
@@ -461,6 +476,53 @@ ns_interfacemgr_shutdown(ns_interfacemgr_t *mgr) {
 	}
 }
 
+/*%
+ * Write to 'key' the fields of 'addr' that isc_sockaddr_equal() compares,
+ * and return their length.
+ */
+static uint32_t
+sockaddr_key(const isc_sockaddr_t *addr, unsigned char *key) {
+	const struct sockaddr_in6 *sin6 = &addr->type.sin6;
+	const struct sockaddr_in *sin = &addr->type.sin;
+	uint32_t len = 0;
+
+	key[len++] = (unsigned char)addr->type.sa.sa_family;
+	switch (addr->type.sa.sa_family) {
+	case AF_INET:
+		memmove(key + len, &sin->sin_port, sizeof(sin->sin_port));
+		len += sizeof(sin->sin_port);
+		memmove(key + len, &sin->sin_addr, sizeof(sin->sin_addr));
+		len += sizeof(sin->sin_addr);
+		break;
+	case AF_INET6:
+		memmove(key + len, &sin6->sin6_port, sizeof(sin6->sin6_port));
+		len += sizeof(sin6->sin6_port);
+		memmove(key + len, &sin6->sin6_addr, sizeof(sin6->sin6_addr));
+		len += sizeof(sin6->sin6_addr);
+		memmove(key + len, &sin6->sin6_scope_id, 4);
+		len += 4;
+		break;
+	default:
+		UNREACHABLE();
+	}
+
+	INSIST(len <= SOCKADDR_KEYSIZE);
+	return (len);
+}
+
+/*
+ * Requires the manager lock.  If several interfaces share an address,
+ * the first one in the list is the one that is indexed, as it is the
+ * one a linear search would find.
+ */
+static void
+index_interface(ns_interfacemgr_t *mgr, ns_interface_t *ifp) {
+	unsigned char key[SOCKADDR_KEYSIZE];
+	uint32_t keylen = sockaddr_key(&ifp->addr, key);
+
+	(void)isc_ht_add(mgr->interfacesbyaddr, key, keylen, ifp);
+}
+
 static void
 interface_create(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr, const char *name,
 		 ns_interface_t **ifpret) {
@@ -485,6 +547,7 @@ interface_create(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr, const char *name,
 
 	LOCK(&mgr->lock);
 	ISC_LIST_APPEND(mgr->interfaces, ifp, link);
+	index_interface(mgr, ifp);
 	UNLOCK(&mgr->lock);
 
 	*ifpret = ifp;
@@ -780,19 +843,20 @@ interface_destroy(ns_interface_t **interfacep) {
 }
 
 /*%
- * Search the interface list for an interface whose address and port
- * both match those of 'addr'.  Return a pointer to it, or NULL if not found.
+ * Look up an interface whose address and port both match those of 'addr'.
+ * Return a pointer to it, or NULL if not found.
  */
 static ns_interface_t *
 find_matching_interface(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr) {
-	ns_interface_t *ifp;
+	unsigned char key[SOCKADDR_KEYSIZE];
+	uint32_t keylen = sockaddr_key(addr, key);
+	void *ifp = NULL;
+
 	LOCK(&mgr->lock);
-	for (ifp = ISC_LIST_HEAD(mgr->interfaces); ifp != NULL;
-	     ifp = ISC_LIST_NEXT(ifp, link))
+	if (isc_ht_find(mgr->interfacesbyaddr, key, keylen, &ifp) !=
+	    ISC_R_SUCCESS)
 	{
-		if (isc_sockaddr_equal(&ifp->addr, addr)) {
-			break;
-		}
+		ifp = NULL;
 	}
 	UNLOCK(&mgr->lock);
 	return (ifp);
@@ -805,6 +869,7 @@ static void
 purge_old_interfaces(ns_interfacemgr_t *mgr) {
 	ns_interface_t *ifp = NULL, *next = NULL;
 	ISC_LIST(ns_interface_t) interfaces;
+	bool reindex = false;
 
 	ISC_LIST_INIT(interfaces);
 
@@ -813,10 +878,33 @@ purge_old_interfaces(ns_interfacemgr_t *mgr) {
 		INSIST(NS_INTERFACE_VALID(ifp));
 		next = ISC_LIST_NEXT(ifp, link);
 		if (ifp->generation != mgr->generation) {
+			unsigned char key[SOCKADDR_KEYSIZE];
+			uint32_t keylen = sockaddr_key(&ifp->addr, key);
+			void *found = NULL;
+
+			if (isc_ht_find(mgr->interfacesbyaddr, key, keylen,
+					&found) == ISC_R_SUCCESS &&
+			    found == ifp)
+			{
+				(void)isc_ht_delete(mgr->interfacesbyaddr, key,
+						    keylen);
+				reindex = true;
+			}
 			ISC_LIST_UNLINK(ifp->mgr->interfaces, ifp, link);
 			ISC_LIST_APPEND(interfaces, ifp, link);
 		}
 	}
+	if (reindex) {
+		/*
+		 * A remaining interface may share the address of one that
+		 * was removed from the index.
+		 */
+		for (ifp = ISC_LIST_HEAD(mgr->interfaces); ifp != NULL;
+		     ifp = ISC_LIST_NEXT(ifp, link))
+		{
+			index_interface(mgr, ifp);
+		}
+	}
 	UNLOCK(&mgr->lock);
 
 	for (ifp = ISC_LIST_HEAD(interfaces); ifp != NULL; ifp = next) {
@@ -893,26 +981,25 @@ setup_locals(isc_interface_t *interface, dns_acl_t *localhost,
 static void
 setup_listenon(ns_interfacemgr_t *mgr, isc_interface_t *interface,
 	       in_port_t port) {
+	unsigned char key[SOCKADDR_KEYSIZE];
+	uint32_t keylen;
 	isc_sockaddr_t *addr;
-	isc_sockaddr_t *old;
+	isc_result_t result;
 
 	addr = isc_mem_get(mgr->mctx, sizeof(*addr));
 
 	isc_sockaddr_fromnetaddr(addr, &interface->address, port);
+	keylen = sockaddr_key(addr, key);
 
 	LOCK(&mgr->lock);
-	for (old = ISC_LIST_HEAD(mgr->listenon); old != NULL;
-	     old = ISC_LIST_NEXT(old, link))
-	{
-		if (isc_sockaddr_equal(addr, old)) {
-			/* We found an existing address */
-			isc_mem_put(mgr->mctx, addr, sizeof(*addr));
-			goto unlock;
-		}
+	result = isc_ht_add(mgr->listenonbyaddr, key, keylen, addr);
+	if (result == ISC_R_EXISTS) {
+		/* We found an existing address */
+		isc_mem_put(mgr->mctx, addr, sizeof(*addr));
+	} else {
+		INSIST(result == ISC_R_SUCCESS);
+		ISC_LIST_APPEND(mgr->listenon, addr, link);
 	}
-
-	ISC_LIST_APPEND(mgr->listenon, addr, link);
-unlock:
 	UNLOCK(&mgr->lock);
 }
 
@@ -925,6 +1012,8 @@ clearlistenon(ns_interfacemgr_t *mgr) {
 
 	LOCK(&mgr->lock);
 	ISC_LIST_MOVE(listenon, mgr->listenon);
+	isc_ht_destroy(&mgr->listenonbyaddr);
+	isc_ht_init(&mgr->listenonbyaddr, mgr->mctx, 4, ISC_HT_CASE_SENSITIVE);
 	UNLOCK(&mgr->lock);
 
 	old = ISC_LIST_HEAD(listenon);
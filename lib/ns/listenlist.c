@@ -71,9 +71,12 @@ listenelt_create(isc_mem_t *mctx, in_port_t port, dns_acl_t *acl,
 			 * TLS) - otherwise resumption attempts will lead to
 			 * handshake failures. See OpenSSL documentation for
 			 * 'SSL_CTX_set_session_id_context()', the "Warnings"
-			 * section.
+			 * section. The context is derived from the
+			 * configuration so that the sessions can be resumed
+			 * after reconfiguration.
 			 */
-			isc_tlsctx_set_random_session_id_context(sslctx);
+			isc_tlsctx_set_session_id_context(
+				sslctx, tls_params->name, tls_params->ca_file);
 
 			/*
 			 * If CA-bundle file is specified - enable client
@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/atomic.h>
+#include <isc/hash.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/netaddr.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#include <ns/prefixlimit.h>
+
+#define PREFIXLIMIT_MAGIC    ISC_MAGIC('P', 'f', 'x', 'L')
+#define VALID_PREFIXLIMIT(p) ISC_MAGIC_VALID(p, PREFIXLIMIT_MAGIC)
+
+/*%
+ * Number of shards, and of hash buckets in each shard.
+ */
+#define PREFIXLIMIT_SHARDS  16
+#define PREFIXLIMIT_BUCKETS 1024
+#define SHARD_MAXENTRIES    (NS_PREFIXLIMIT_MAXENTRIES / PREFIXLIMIT_SHARDS)
+
+struct ns_prefixentry {
+	uint32_t      hash;
+	unsigned int  shard;
+	int	      family;
+	unsigned int  prefixlen;
+	unsigned char addr[16]; /*%< masked to 'prefixlen' */
+	unsigned int  counts[ns_prefixlimit_kinds];
+	ISC_LINK(ns_prefixentry_t) link;
+	ISC_LINK(ns_prefixentry_t) lru; /*%< only while nothing is held */
+};
+
+typedef struct prefixshard {
+	isc_mutex_t  lock;
+	unsigned int nentries;
+	/*% Prefixes without anything held, least recently used first */
+	ISC_LIST(ns_prefixentry_t) idle;
+	ISC_LIST(ns_prefixentry_t) buckets[PREFIXLIMIT_BUCKETS];
+} prefixshard_t;
+
+struct ns_prefixlimit {
+	unsigned int	     magic;
+	isc_mem_t	    *mctx;
+	atomic_uint_fast32_t limits[ns_prefixlimit_kinds];
+	atomic_uint_fast32_t prefixlen4;
+	atomic_uint_fast32_t prefixlen6;
+	prefixshard_t	     shards[PREFIXLIMIT_SHARDS];
+};
+
+#define BUCKET(e) (((e)->hash / PREFIXLIMIT_SHARDS) % PREFIXLIMIT_BUCKETS)
+
+void
+ns_prefixlimit_create(isc_mem_t *mctx, ns_prefixlimit_t **plp) {
+	ns_prefixlimit_t *pl = NULL;
+
+	REQUIRE(plp != NULL && *plp == NULL);
+
+	pl = isc_mem_get(mctx, sizeof(*pl));
+	*pl = (ns_prefixlimit_t){ .magic = 0 };
+	isc_mem_attach(mctx, &pl->mctx);
+	for (size_t i = 0; i < ns_prefixlimit_kinds; i++) {
+		atomic_init(&pl->limits[i], 0);
+	}
+	atomic_init(&pl->prefixlen4, 32);
+	atomic_init(&pl->prefixlen6, 128);
+	for (size_t i = 0; i < PREFIXLIMIT_SHARDS; i++) {
+		prefixshard_t *shard = &pl->shards[i];
+
+		isc_mutex_init(&shard->lock);
+		ISC_LIST_INIT(shard->idle);
+		for (size_t j = 0; j < PREFIXLIMIT_BUCKETS; j++) {
+			ISC_LIST_INIT(shard->buckets[j]);
+		}
+	}
+
+	pl->magic = PREFIXLIMIT_MAGIC;
+	*plp = pl;
+}
+
+void
+ns_prefixlimit_destroy(ns_prefixlimit_t **plp) {
+	ns_prefixlimit_t *pl = NULL;
+
+	REQUIRE(plp != NULL && VALID_PREFIXLIMIT(*plp));
+
+	pl = *plp;
+	*plp = NULL;
+
+	pl->magic = 0;
+	for (size_t i = 0; i < PREFIXLIMIT_SHARDS; i++) {
+		prefixshard_t *shard = &pl->shards[i];
+		ns_prefixentry_t *entry = NULL;
+
+		while ((entry = ISC_LIST_HEAD(shard->idle)) != NULL) {
+			ISC_LIST_UNLINK(shard->idle, entry, lru);
+			ISC_LIST_UNLINK(shard->buckets[BUCKET(entry)], entry,
+					link);
+			isc_mem_put(pl->mctx, entry, sizeof(*entry));
+			shard->nentries--;
+		}
+		INSIST(shard->nentries == 0);
+		isc_mutex_destroy(&shard->lock);
+	}
+	isc_mem_putanddetach(&pl->mctx, pl, sizeof(*pl));
+}
+
+void
+ns_prefixlimit_configure(ns_prefixlimit_t *pl, unsigned int recursion,
+			 unsigned int tcp, unsigned int prefixlen4,
+			 unsigned int prefixlen6) {
+	REQUIRE(VALID_PREFIXLIMIT(pl));
+	REQUIRE(prefixlen4 <= 32 && prefixlen6 <= 128);
+
+	atomic_store_relaxed(&pl->prefixlen4, prefixlen4);
+	atomic_store_relaxed(&pl->prefixlen6, prefixlen6);
+	atomic_store_relaxed(&pl->limits[ns_prefixlimit_recursion], recursion);
+	atomic_store_relaxed(&pl->limits[ns_prefixlimit_tcp], tcp);
+}
+
+/*
+ * Fill in the prefix of 'addr' in 'key', and return the shard it
+ * belongs to.
+ */
+static prefixshard_t *
+make_key(ns_prefixlimit_t *pl, const isc_netaddr_t *addr,
+	 ns_prefixentry_t *key) {
+	unsigned int len = 0;
+
+	*key = (ns_prefixentry_t){ .family = addr->family };
+	switch (addr->family) {
+	case AF_INET:
+		len = 4;
+		key->prefixlen = atomic_load_relaxed(&pl->prefixlen4);
+		memmove(key->addr, &addr->type.in, len);
+		break;
+	case AF_INET6:
+		len = 16;
+		key->prefixlen = atomic_load_relaxed(&pl->prefixlen6);
+		memmove(key->addr, &addr->type.in6, len);
+		break;
+	default:
+		break;
+	}
+
+	if (key->prefixlen < len * 8) {
+		unsigned int i = key->prefixlen / 8;
+		key->addr[i++] &= (uint8_t)(0xff00 >> (key->prefixlen % 8));
+		memset(key->addr + i, 0, len - i);
+	}
+
+	key->hash = isc_hash32(key->addr, len, true) ^
+		    ((uint32_t)key->family << 8 | key->prefixlen);
+	key->shard = key->hash % PREFIXLIMIT_SHARDS;
+
+	return (&pl->shards[key->shard]);
+}
+
+static ns_prefixentry_t *
+find_entry(prefixshard_t *shard, const ns_prefixentry_t *key) {
+	ns_prefixentry_t *entry = NULL;
+
+	for (entry = ISC_LIST_HEAD(shard->buckets[BUCKET(key)]);
+	     entry != NULL; entry = ISC_LIST_NEXT(entry, link))
+	{
+		if (entry->hash == key->hash && entry->family == key->family &&
+		    entry->prefixlen == key->prefixlen &&
+		    memcmp(entry->addr, key->addr, sizeof(key->addr)) == 0)
+		{
+			return (entry);
+		}
+	}
+
+	return (NULL);
+}
+
+isc_result_t
+ns_prefixlimit_check(ns_prefixlimit_t *pl, const isc_netaddr_t *addr,
+		     ns_prefixlimit_kind_t kind) {
+	ns_prefixentry_t key, *entry = NULL;
+	prefixshard_t *shard = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int limit;
+
+	REQUIRE(VALID_PREFIXLIMIT(pl));
+	REQUIRE(addr != NULL);
+	REQUIRE(kind < ns_prefixlimit_kinds);
+
+	limit = atomic_load_relaxed(&pl->limits[kind]);
+	if (limit == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	shard = make_key(pl, addr, &key);
+	LOCK(&shard->lock);
+	entry = find_entry(shard, &key);
+	if (entry != NULL && entry->counts[kind] >= limit) {
+		result = ISC_R_QUOTA;
+	}
+	UNLOCK(&shard->lock);
+
+	return (result);
+}
+
+isc_result_t
+ns_prefixlimit_acquire(ns_prefixlimit_t *pl, const isc_netaddr_t *addr,
+		       ns_prefixlimit_kind_t kind, ns_prefixentry_t **entryp) {
+	ns_prefixentry_t key, *entry = NULL;
+	prefixshard_t *shard = NULL;
+	unsigned int limit;
+
+	REQUIRE(VALID_PREFIXLIMIT(pl));
+	REQUIRE(addr != NULL);
+	REQUIRE(kind < ns_prefixlimit_kinds);
+	REQUIRE(entryp != NULL && *entryp == NULL);
+
+	limit = atomic_load_relaxed(&pl->limits[kind]);
+	if (limit == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	shard = make_key(pl, addr, &key);
+	LOCK(&shard->lock);
+	entry = find_entry(shard, &key);
+	if (entry == NULL) {
+		if (shard->nentries < SHARD_MAXENTRIES) {
+			entry = isc_mem_get(pl->mctx, sizeof(*entry));
+			shard->nentries++;
+		} else {
+			/*
+			 * Reuse the prefix that has been idle the longest;
+			 * if every prefix is busy, don't count this one.
+			 */
+			entry = ISC_LIST_HEAD(shard->idle);
+			if (entry == NULL) {
+				UNLOCK(&shard->lock);
+				return (ISC_R_SUCCESS);
+			}
+			ISC_LIST_UNLINK(shard->idle, entry, lru);
+			ISC_LIST_UNLINK(shard->buckets[BUCKET(entry)], entry,
+					link);
+		}
+		*entry = key;
+		ISC_LINK_INIT(entry, link);
+		ISC_LINK_INIT(entry, lru);
+		ISC_LIST_APPEND(shard->buckets[BUCKET(entry)], entry, link);
+	} else if (entry->counts[kind] >= limit) {
+		UNLOCK(&shard->lock);
+		return (ISC_R_QUOTA);
+	} else if (ISC_LINK_LINKED(entry, lru)) {
+		ISC_LIST_UNLINK(shard->idle, entry, lru);
+	}
+	entry->counts[kind]++;
+	UNLOCK(&shard->lock);
+
+	*entryp = entry;
+	return (ISC_R_SUCCESS);
+}
+
+void
+ns_prefixlimit_release(ns_prefixlimit_t *pl, ns_prefixlimit_kind_t kind,
+		       ns_prefixentry_t **entryp) {
+	ns_prefixentry_t *entry = NULL;
+	prefixshard_t *shard = NULL;
+	bool idle = true;
+
+	REQUIRE(VALID_PREFIXLIMIT(pl));
+	REQUIRE(kind < ns_prefixlimit_kinds);
+	REQUIRE(entryp != NULL && *entryp != NULL);
+
+	entry = *entryp;
+	*entryp = NULL;
+
+	shard = &pl->shards[entry->shard];
+	LOCK(&shard->lock);
+	INSIST(entry->counts[kind] > 0);
+	entry->counts[kind]--;
+	for (size_t i = 0; i < ns_prefixlimit_kinds; i++) {
+		if (entry->counts[i] != 0) {
+			idle = false;
+		}
+	}
+	if (idle) {
+		ISC_LIST_APPEND(shard->idle, entry, lru);
+	}
+	UNLOCK(&shard->lock);
+}
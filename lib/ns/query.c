@@ -18,10 +18,12 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include <isc/base32.h>
 #include <isc/hex.h>
 #include <isc/mem.h>
 #include <isc/once.h>
 #include <isc/print.h>
+#include <isc/profile.h>
 #include <isc/random.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
@@ -57,6 +59,7 @@
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
 #include <dns/result.h>
+#include <dns/sdlz.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
 #include <dns/types.h>
@@ -64,9 +67,11 @@
 #include <dns/zone.h>
 #include <dns/zt.h>
 
+#include <ns/answercache.h>
 #include <ns/client.h>
 #include <ns/events.h>
 #include <ns/hooks.h>
+#include <ns/inflight.h>
 #include <ns/interfacemgr.h>
 #include <ns/log.h>
 #include <ns/server.h>
@@ -230,7 +235,8 @@ static void
 query_findclosestnsec3(dns_name_t *qname, dns_db_t *db,
 		       dns_dbversion_t *version, ns_client_t *client,
 		       dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset,
-		       dns_name_t *fname, bool exact, dns_name_t *found);
+		       dns_name_t *fname, bool exact, dns_name_t *found,
+		       const dns_name_t *hashed);
 
 static void
 log_queryerror(ns_client_t *client, isc_result_t result, int line, int level);
@@ -464,6 +470,12 @@ query_sign_nodata(query_ctx_t *qctx);
 static void
 query_addnxrrsetnsec(query_ctx_t *qctx);
 
+static bool
+query_usecompactnsec(query_ctx_t *qctx);
+
+static isc_result_t
+query_addcompactnsec(query_ctx_t *qctx, bool nxname);
+
 static isc_result_t
 query_nxdomain(query_ctx_t *qctx, isc_result_t res);
 
@@ -563,7 +575,10 @@ query_send(ns_client_t *client) {
 
 	if (client->message->rcode == dns_rcode_noerror) {
 		dns_section_t answer = DNS_SECTION_ANSWER;
-		if (ISC_LIST_EMPTY(client->message->sections[answer])) {
+		if (ISC_LIST_EMPTY(client->message->sections[answer]) &&
+		    (client->query.cachedanswer == NULL ||
+		     client->query.cachedanswer->counts[answer] == 0))
+		{
 			if (client->query.isreferral) {
 				counter = ns_statscounter_referral;
 			} else {
@@ -671,6 +686,10 @@ ns_query_cancel(ns_client_t *client) {
 		client->query.hookactx = NULL;
 	}
 	UNLOCK(&client->query.fetchlock);
+
+	if (client->query.inflight != NULL) {
+		ns_inflight_cancel(client->sctx->inflight, client);
+	}
 }
 
 static void
@@ -689,6 +708,14 @@ query_reset(ns_client_t *client, bool everything) {
 	 */
 	ns_query_cancel(client);
 
+	/*
+	 * Release any clients waiting on this one's query; they will
+	 * look their question up on their own.
+	 */
+	if (client->query.inflight != NULL) {
+		ns_inflight_done(client->sctx->inflight, client, NULL);
+	}
+
 	/*
 	 * Cleanup any active versions.
 	 */
@@ -709,6 +736,9 @@ query_reset(ns_client_t *client, bool everything) {
 	if (client->query.authzone != NULL) {
 		dns_zone_detach(&client->query.authzone);
 	}
+	if (client->query.cachedanswer != NULL) {
+		ns_answercache_detach(&client->query.cachedanswer);
+	}
 
 	if (client->query.dns64_aaaa != NULL) {
 		ns_client_putrdataset(client, &client->query.dns64_aaaa);
@@ -780,6 +810,8 @@ query_reset(ns_client_t *client, bool everything) {
 	client->query.root_key_sentinel_keyid = 0;
 	client->query.root_key_sentinel_is_ta = false;
 	client->query.root_key_sentinel_not_ta = false;
+	client->query.answergen = 0;
+	client->query.answerkey = 0;
 }
 
 static void
@@ -819,6 +851,9 @@ ns_query_init(ns_client_t *client) {
 	client->query.authzone = NULL;
 	client->query.authdbset = false;
 	client->query.isreferral = false;
+	client->query.cachedanswer = NULL;
+	client->query.inflight = NULL;
+	client->query.inflightleader = false;
 	client->query.dns64_aaaa = NULL;
 	client->query.dns64_sigaaaa = NULL;
 	client->query.dns64_aaaaok = NULL;
@@ -2155,6 +2190,91 @@ query_setorder(query_ctx_t *qctx, dns_name_t *name, dns_rdataset_t *rdataset) {
 	rdataset->attributes |= DNS_RDATASETATTR_LOADORDER;
 }
 
+/*
+ * Targets of one RRset collected for sorted additional section lookups
+ * (see "sort-additional-lookups").
+ */
+#define ADDITIONAL_BATCH_SIZE 16
+
+typedef struct additional_target {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdatatype_t qtype;
+} additional_target_t;
+
+typedef struct additional_batch {
+	query_ctx_t *qctx;
+	unsigned int count;
+	additional_target_t targets[ADDITIONAL_BATCH_SIZE];
+	additional_target_t *sorted[ADDITIONAL_BATCH_SIZE];
+} additional_batch_t;
+
+static int
+additional_target_compare(const void *a, const void *b) {
+	const additional_target_t *ta = *(additional_target_t *const *)a;
+	const additional_target_t *tb = *(additional_target_t *const *)b;
+	int order = dns_name_compare(ta->name, tb->name);
+
+	if (order == 0) {
+		order = (int)ta->qtype - (int)tb->qtype;
+	}
+	return (order);
+}
+
+/*
+ * Look up the collected targets in DNSSEC order, which is the order the
+ * nodes are stored in an RBT database, skipping duplicates.  The
+ * targets hold fixed names, so they are sorted by reference.
+ */
+static void
+additional_batch_flush(additional_batch_t *batch) {
+	for (unsigned int i = 0; i < batch->count; i++) {
+		batch->sorted[i] = &batch->targets[i];
+	}
+	qsort(batch->sorted, batch->count, sizeof(batch->sorted[0]),
+	      additional_target_compare);
+
+	for (unsigned int i = 0; i < batch->count; i++) {
+		additional_target_t *target = batch->sorted[i];
+
+		if (i > 0 && additional_target_compare(&batch->sorted[i - 1],
+							&batch->sorted[i]) == 0)
+		{
+			continue;
+		}
+		(void)query_additional_cb(batch->qctx, target->name,
+					  target->qtype, NULL);
+	}
+
+	batch->count = 0;
+}
+
+/*
+ * dns_additionaldatafunc_t collecting the targets of an RRset.  Calls
+ * that pass an rdataset to fill in have to be answered at once.
+ */
+static isc_result_t
+additional_batch_add(void *arg, const dns_name_t *name, dns_rdatatype_t qtype,
+		     dns_rdataset_t *found) {
+	additional_batch_t *batch = arg;
+	additional_target_t *target = NULL;
+
+	if (found != NULL) {
+		return (query_additional_cb(batch->qctx, name, qtype, found));
+	}
+
+	if (batch->count == ADDITIONAL_BATCH_SIZE) {
+		additional_batch_flush(batch);
+	}
+
+	target = &batch->targets[batch->count++];
+	target->name = dns_fixedname_initname(&target->fixed);
+	dns_name_copy(name, target->name);
+	target->qtype = qtype;
+
+	return (ISC_R_SUCCESS);
+}
+
 /*
  * Handle glue and fetch any other needed additional data for 'rdataset'.
  */
@@ -2190,6 +2310,32 @@ query_additional(query_ctx_t *qctx, dns_name_t *name,
 		if (result == ISC_R_SUCCESS) {
 			return;
 		}
+	} else if (qctx->view->use_glue_cache &&
+		   rdataset->type == dns_rdatatype_ns &&
+		   client->query.gluedb == NULL &&
+		   (!client->query.authdbset || client->query.authdb == NULL) &&
+		   qctx->view->recursion && client->query.dboptions == 0 &&
+		   (qctx->view->minimalresponses != dns_minimal_yes ||
+		    client->query.qtype == dns_rdatatype_ns))
+	{
+		dns_db_t *db = NULL;
+
+		/*
+		 * An NS rdataset from the cache: query_additional_cb() would
+		 * find no authoritative data and look the addresses up in
+		 * the cache, so try the cache's glue cache first.
+		 */
+		result = query_getcachedb(client, name, dns_rdatatype_a, &db,
+					  DNS_GETDB_NOLOG);
+		if (result != ISC_R_SUCCESS) {
+			goto regular;
+		}
+		dns_db_detach(&db);
+
+		result = dns_rdataset_addglue(rdataset, NULL, client->message);
+		if (result == ISC_R_SUCCESS) {
+			return;
+		}
 	}
 
 regular:
@@ -2197,8 +2343,16 @@ regular:
 	 * Add other additional data if needed.
 	 * We don't care if dns_rdataset_additionaldata() fails.
 	 */
-	(void)dns_rdataset_additionaldata(rdataset, name, query_additional_cb,
-					  qctx);
+	if (qctx->view->sortadditional && dns_rdataset_count(rdataset) > 1) {
+		additional_batch_t batch = { .qctx = qctx };
+
+		(void)dns_rdataset_additionaldata(rdataset, name,
+						  additional_batch_add, &batch);
+		additional_batch_flush(&batch);
+	} else {
+		(void)dns_rdataset_additionaldata(rdataset, name,
+						  query_additional_cb, qctx);
+	}
 	CTRACE(ISC_LOG_DEBUG(3), "query_additional: done");
 }
 
@@ -2386,8 +2540,8 @@ get_key(ns_client_t *client, dns_db_t *db, dns_rdata_rrsig_t *rrsig,
 		dns_rdataset_current(keyrdataset, &rdata);
 		isc_buffer_init(&b, rdata.data, rdata.length);
 		isc_buffer_add(&b, rdata.length);
-		result = dst_key_fromdns(&rrsig->signer, rdata.rdclass, &b,
-					 client->mctx, keyp);
+		result = dst_key_fromdns_cached(&rrsig->signer, rdata.rdclass,
+						&b, keyp);
 		if (result != ISC_R_SUCCESS) {
 			continue;
 		}
@@ -2562,6 +2716,11 @@ prefetch_done(isc_task_t *task, isc_event_t *event) {
 		isc_quota_detach(&client->recursionquota);
 		ns_stats_decrement(client->sctx->nsstats,
 				   ns_statscounter_recursclients);
+		if (client->recprefix != NULL) {
+			ns_prefixlimit_release(client->sctx->prefixlimit,
+					       ns_prefixlimit_recursion,
+					       &client->recprefix);
+		}
 	}
 
 	free_devent(client, &event, &devent);
@@ -4683,17 +4842,126 @@ warn_rfc1918(ns_client_t *client, dns_name_t *fname, dns_rdataset_t *rdataset) {
 	}
 }
 
+/*%
+ * Look up the NSEC3 hash of 'name' in zone 'origin' in the client
+ * manager's cache, returning the cache slot for 'name' and setting
+ * '*hit' if it holds the hash.
+ */
+static ns_nsec3hash_t *
+query_nsec3cache_slot(ns_client_t *client, const dns_name_t *name,
+		      const dns_name_t *origin, dns_hash_t hash,
+		      unsigned int iterations, const unsigned char *salt,
+		      size_t salt_length, bool *hit) {
+	ns_clientmgr_t *manager = client->manager;
+	ns_nsec3hash_t *entry = NULL;
+	const dns_name_t *hashed = NULL;
+
+	*hit = false;
+
+	if (salt_length > sizeof(entry->salt)) {
+		return (NULL);
+	}
+
+	if (manager->nsec3cache == NULL) {
+		size_t size = NS_CLIENT_NSEC3CACHE_SIZE *
+			      sizeof(manager->nsec3cache[0]);
+		manager->nsec3cache = isc_mem_get(manager->mctx, size);
+		memset(manager->nsec3cache, 0, size);
+	}
+
+	entry = &manager->nsec3cache[dns_name_hash(name, false) %
+				     NS_CLIENT_NSEC3CACHE_SIZE];
+	if (!entry->valid || entry->hash != hash ||
+	    entry->iterations != iterations ||
+	    entry->salt_length != salt_length ||
+	    memcmp(entry->salt, salt, salt_length) != 0 ||
+	    !dns_name_equal(dns_fixedname_name(&entry->name), name))
+	{
+		return (entry);
+	}
+
+	/*
+	 * The hashed name is one label below the zone it was made for.
+	 */
+	hashed = dns_fixedname_name(&entry->hashed);
+	if (dns_name_countlabels(hashed) == dns_name_countlabels(origin) + 1 &&
+	    dns_name_issubdomain(hashed, origin))
+	{
+		*hit = true;
+	}
+	return (entry);
+}
+
+static void
+query_nsec3cache_store(ns_nsec3hash_t *entry, const dns_name_t *name,
+		       const dns_name_t *hashed, dns_hash_t hash,
+		       unsigned int iterations, const unsigned char *salt,
+		       size_t salt_length) {
+	if (entry == NULL) {
+		return;
+	}
+
+	entry->valid = true;
+	entry->hash = hash;
+	entry->iterations = iterations;
+	entry->salt_length = salt_length;
+	memmove(entry->salt, salt, salt_length);
+	dns_name_copy(name, dns_fixedname_initname(&entry->name));
+	dns_name_copy(hashed, dns_fixedname_initname(&entry->hashed));
+}
+
+/*%
+ * dns_nsec3_hashname() for the query path: the hashes of closest
+ * enclosers and wildcards are remembered, so that a flood of queries
+ * for random names below the same closest encloser only hashes the
+ * random part.  Only names for which 'remember' is true are stored,
+ * so that the random names do not evict the useful ones.
+ */
+static isc_result_t
+query_nsec3hashname(ns_client_t *client, dns_fixedname_t *result,
+		    const dns_name_t *name, const dns_name_t *origin,
+		    dns_hash_t hash, unsigned int iterations,
+		    const unsigned char *salt, size_t salt_length,
+		    bool remember) {
+	ns_nsec3hash_t *entry = NULL;
+	isc_result_t tresult;
+	bool hit;
+
+	entry = query_nsec3cache_slot(client, name, origin, hash, iterations,
+				      salt, salt_length, &hit);
+	if (hit) {
+		dns_name_copy(dns_fixedname_name(&entry->hashed),
+			      dns_fixedname_initname(result));
+		return (ISC_R_SUCCESS);
+	}
+
+	tresult = dns_nsec3_hashname(result, NULL, NULL, name, origin, hash,
+				     iterations, salt, salt_length);
+	if (tresult == ISC_R_SUCCESS && remember) {
+		query_nsec3cache_store(entry, name, dns_fixedname_name(result),
+				       hash, iterations, salt, salt_length);
+	}
+	return (tresult);
+}
+
+/*%
+ * Find the NSEC3 record that matches or covers 'qname', walking up to the
+ * closest provable encloser if 'found' is not NULL.  If 'hashed' is not
+ * NULL it is the already computed NSEC3 hash of 'qname'.
+ */
 static void
 query_findclosestnsec3(dns_name_t *qname, dns_db_t *db,
 		       dns_dbversion_t *version, ns_client_t *client,
 		       dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset,
-		       dns_name_t *fname, bool exact, dns_name_t *found) {
+		       dns_name_t *fname, bool exact, dns_name_t *found,
+		       const dns_name_t *hashed) {
 	unsigned char salt[256];
 	size_t salt_length;
 	uint16_t iterations;
 	isc_result_t result;
 	unsigned int dboptions;
 	dns_fixedname_t fixed;
+	const dns_name_t *hashname = NULL;
 	dns_hash_t hash;
 	dns_name_t name;
 	unsigned int skip = 0, labels;
@@ -4724,16 +4992,21 @@ query_findclosestnsec3(dns_name_t *qname, dns_db_t *db,
 	}
 
 again:
-	dns_fixedname_init(&fixed);
-	result = dns_nsec3_hashname(&fixed, NULL, NULL, &name,
-				    dns_db_origin(db), hash, iterations, salt,
-				    salt_length);
-	if (result != ISC_R_SUCCESS) {
-		return;
+	if (hashed != NULL && skip == 0) {
+		hashname = hashed;
+	} else {
+		result = query_nsec3hashname(client, &fixed, &name,
+					     dns_db_origin(db), hash,
+					     iterations, salt, salt_length,
+					     exact);
+		if (result != ISC_R_SUCCESS) {
+			return;
+		}
+		hashname = dns_fixedname_name(&fixed);
 	}
 
 	dboptions = client->query.dboptions | DNS_DBFIND_FORCENSEC3;
-	result = dns_db_findext(db, dns_fixedname_name(&fixed), version,
+	result = dns_db_findext(db, hashname, version,
 				dns_rdatatype_nsec3, dboptions, client->now,
 				NULL, fname, &cm, &ci, rdataset, sigrdataset);
 
@@ -5874,6 +6147,78 @@ stale_client_answer(isc_result_t result) {
 	UNREACHABLE();
 }
 
+/*
+ * The name looked up by query_lookup().
+ */
+static dns_name_t *
+query_lookupname(query_ctx_t *qctx) {
+	if (qctx->dns64 && qctx->rpz) {
+		return (qctx->client->query.rpz_st->p_name);
+	}
+	return (qctx->client->query.qname);
+}
+
+/*
+ * Cancelling does nothing: the DLZ driver always completes its lookup,
+ * and query_hookresume() then finds the query cancelled.
+ */
+static void
+query_dlzasync_cancel(ns_hookasync_t *ctx) {
+	UNUSED(ctx);
+}
+
+static void
+query_dlzasync_done(void *arg, isc_result_t result) {
+	ns_hook_resevent_t *rev = arg;
+
+	UNUSED(result);
+
+	ns_hook_resume(&rev);
+}
+
+/*
+ * Start an asynchronous DLZ lookup; the query is resumed at
+ * NS_QUERY_LOOKUP_BEGIN once the answer is in the DLZ lookup cache,
+ * or straight away if the lookup could not be started.
+ */
+static isc_result_t
+query_dlzasync_start(query_ctx_t *qctx, isc_mem_t *mctx, void *arg,
+		     isc_task_t *task, isc_taskaction_t action, void *evarg,
+		     ns_hookasync_t **ctxp) {
+	ns_hookasync_t *ctx = NULL;
+	ns_hook_resevent_t *rev = NULL;
+	dns_clientinfomethods_t cm;
+	dns_clientinfo_t ci;
+	isc_result_t result;
+
+	UNUSED(arg);
+
+	ns_hookasync_create(mctx, query_dlzasync_cancel, NULL, NULL, &ctx);
+	rev = ns_hook_resevent_create(qctx, mctx, task, action, evarg, ctx,
+				      NS_QUERY_LOOKUP_BEGIN, ISC_R_UNSET);
+
+	/*
+	 * The driver may complete the lookup on another thread before
+	 * dns_sdlz_lookupasync() returns, so the context has to be in
+	 * place first.
+	 */
+	*ctxp = ctx;
+
+	dns_clientinfomethods_init(&cm, ns_client_sourceip);
+	dns_clientinfo_init(&ci, qctx->client, NULL);
+	if (HAVEECS(qctx->client)) {
+		dns_clientinfo_setecs(&ci, &qctx->client->ecs);
+	}
+
+	result = dns_sdlz_lookupasync(qctx->db, query_lookupname(qctx), &cm,
+				      &ci, query_dlzasync_done, rev);
+	if (result != ISC_R_SUCCESS) {
+		ns_hook_resume(&rev);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 /*%
  * Perform a local database lookup, in either an authoritative or
  * cache database. If unable to answer, call ns_query_done(); otherwise
@@ -5895,11 +6240,26 @@ query_lookup(query_ctx_t *qctx) {
 	bool stale_found = false;
 	bool stale_refresh_window = false;
 	uint16_t ede = 0;
+	isc_time_t lookuptime;
 
 	CCTRACE(ISC_LOG_DEBUG(3), "query_lookup");
 
 	CALL_HOOK(NS_QUERY_LOOKUP_BEGIN, qctx);
 
+	/*
+	 * A DLZ driver that can look the name up asynchronously does so
+	 * first, without blocking this thread; we get back here once the
+	 * answer is cached, and the lookup below finds it there.
+	 */
+	if ((qctx->client->query.attributes & NS_QUERYATTR_DLZASYNC) != 0) {
+		qctx->client->query.attributes &= ~NS_QUERYATTR_DLZASYNC;
+	} else if (qctx->is_zone &&
+		   dns_sdlz_canlookupasync(qctx->db, query_lookupname(qctx)))
+	{
+		qctx->client->query.attributes |= NS_QUERYATTR_DLZASYNC;
+		return (ns_query_hookasync(qctx, query_dlzasync_start, NULL));
+	}
+
 	dns_clientinfomethods_init(&cm, ns_client_sourceip);
 	dns_clientinfo_init(&ci, qctx->client, NULL);
 	if (HAVEECS(qctx->client)) {
@@ -5918,11 +6278,7 @@ query_lookup(query_ctx_t *qctx) {
 	/*
 	 * Now look for an answer in the database.
 	 */
-	if (qctx->dns64 && qctx->rpz) {
-		rpzqname = qctx->client->query.rpz_st->p_name;
-	} else {
-		rpzqname = qctx->client->query.qname;
-	}
+	rpzqname = query_lookupname(qctx);
 
 	if ((qctx->options & DNS_GETDB_STALEFIRST) != 0) {
 		/*
@@ -5949,11 +6305,21 @@ query_lookup(query_ctx_t *qctx) {
 		dboptions |= DNS_DBFIND_STALEENABLED;
 	}
 
+	isc_time_settoepoch(&lookuptime);
+	if (qctx->view->latencystats != NULL &&
+	    !isc_time_isepoch(&qctx->client->latencytime))
+	{
+		TIME_NOW_HIRES(&lookuptime);
+	}
+
 	result = dns_db_findext(qctx->db, rpzqname, qctx->version, qctx->type,
 				dboptions, qctx->client->now, &qctx->node,
 				qctx->fname, &cm, &ci, qctx->rdataset,
 				qctx->sigrdataset);
 
+	ns_latencystats_add(qctx->view->latencystats, ns_latency_lookup,
+			    &lookuptime);
+
 	/*
 	 * Fixup fname and sigrdataset.
 	 */
@@ -6280,6 +6646,9 @@ fetch_callback(isc_task_t *task, isc_event_t *event) {
 		isc_event_free(ISC_EVENT_PTR(&event));
 		return;
 	}
+
+	isc_profile_enter(isc_profile_query);
+
 	/*
 	 * We are resuming from recursion. Reset any attributes, options
 	 * that a lookup due to stale-answer-client-timeout may have set.
@@ -6313,6 +6682,22 @@ fetch_callback(isc_task_t *task, isc_event_t *event) {
 		 * Update client->now.
 		 */
 		isc_stdtime_get(&client->now);
+
+		if (!isc_time_isepoch(&client->query.fetchtime) &&
+		    ns_reclimit_enabled(&client->sctx->reclimit))
+		{
+			isc_time_t now;
+
+			TIME_NOW_HIRES(&now);
+			ns_reclimit_sample(
+				&client->sctx->reclimit,
+				isc_time_microdiff(&now,
+						   &client->query.fetchtime),
+				client->sctx->nsstats);
+		}
+		ns_latencystats_add(client->view->latencystats,
+				    ns_latency_recursion,
+				    &client->query.fetchtime);
 	} else {
 		/*
 		 * This is a fetch completion event for a canceled fetch.
@@ -6333,6 +6718,11 @@ fetch_callback(isc_task_t *task, isc_event_t *event) {
 		isc_quota_detach(&client->recursionquota);
 		ns_stats_decrement(client->sctx->nsstats,
 				   ns_statscounter_recursclients);
+		if (client->recprefix != NULL) {
+			ns_prefixlimit_release(client->sctx->prefixlimit,
+					       ns_prefixlimit_recursion,
+					       &client->recprefix);
+		}
 	}
 
 	LOCK(&client->manager->reclock);
@@ -6404,6 +6794,80 @@ fetch_callback(isc_task_t *task, isc_event_t *event) {
 	}
 
 	dns_resolver_destroyfetch(&fetch);
+
+	isc_profile_leave(isc_profile_query);
+}
+
+/*%
+ * Called when a client waiting on an identical query in progress
+ * stops waiting: send the response to that query if it could be
+ * shared, or else start over, this time without waiting on others.
+ */
+static void
+inflight_callback(isc_task_t *task, isc_event_t *event) {
+	ns_inflightevent_t *ievent = (ns_inflightevent_t *)event;
+	ns_cachedanswer_t *answer = ievent->answer;
+	isc_result_t result = ievent->result;
+	ns_client_t *client = event->ev_arg;
+
+	UNUSED(task);
+
+	REQUIRE(event->ev_type == NS_EVENT_INFLIGHTDONE);
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(task == client->task);
+	REQUIRE(RECURSING(client));
+
+	CTRACE(ISC_LOG_DEBUG(3), "inflight_callback");
+
+	isc_event_free(&event);
+
+	/*
+	 * We're done recursing, detach from quota and unlink from
+	 * the manager's recursing-clients list.
+	 */
+	if (client->recursionquota != NULL) {
+		isc_quota_detach(&client->recursionquota);
+		ns_stats_decrement(client->sctx->nsstats,
+				   ns_statscounter_recursclients);
+		if (client->recprefix != NULL) {
+			ns_prefixlimit_release(client->sctx->prefixlimit,
+					       ns_prefixlimit_recursion,
+					       &client->recprefix);
+		}
+	}
+
+	LOCK(&client->manager->reclock);
+	if (ISC_LINK_LINKED(client, rlink)) {
+		ISC_LIST_UNLINK(client->manager->recursing, client, rlink);
+	}
+	UNLOCK(&client->manager->reclock);
+
+	client->query.attributes &= ~NS_QUERYATTR_RECURSING;
+	client->state = NS_CLIENTSTATE_WORKING;
+	isc_stdtime_get(&client->now);
+
+	if (result == ISC_R_CANCELED) {
+		CTRACE(ISC_LOG_ERROR, "inflight wait cancelled");
+		query_error(client, DNS_R_SERVFAIL, __LINE__);
+	} else if (ns_client_shuttingdown(client)) {
+		if (answer != NULL) {
+			ns_answercache_detach(&answer);
+		}
+		query_next(client, ISC_R_CANCELED);
+	} else if (answer != NULL) {
+		client->message->flags = answer->flags;
+		client->message->rcode = answer->rcode;
+		client->query.isreferral = answer->referral;
+		client->query.cachedanswer = answer;
+		inc_stats(client, ns_statscounter_recursjoined);
+		query_send(client);
+	} else {
+		client->query.attributes |= NS_QUERYATTR_NOINFLIGHT;
+		recparam_update(&client->query.recparam, 0, NULL, NULL);
+		(void)query_setup(client, client->query.qtype);
+	}
+
+	isc_nmhandle_detach(&client->fetchhandle);
 }
 
 /*%
@@ -6446,7 +6910,7 @@ recparam_update(ns_query_recparam_t *param, dns_rdatatype_t qtype,
 		dns_name_copy(qdomain, param->qdomain);
 	}
 }
-static atomic_uint_fast32_t last_soft, last_hard;
+static atomic_uint_fast32_t last_soft, last_hard, last_prefix;
 
 /*%
  * Check recursion quota before making the current client "recursing".
@@ -6466,6 +6930,34 @@ check_recursionquota(ns_client_t *client) {
 	 * connection was accepted (if allowed by the TCP quota).
 	 */
 	if (client->recursionquota == NULL) {
+		isc_netaddr_t netaddr;
+
+		/*
+		 * Check the share of the client's network first, so that
+		 * a network over its limit doesn't make other clients'
+		 * queries be dropped to make room for it.
+		 */
+		isc_netaddr_fromsockaddr(&netaddr, &client->peeraddr);
+		result = ns_prefixlimit_acquire(client->sctx->prefixlimit,
+						&netaddr,
+						ns_prefixlimit_recursion,
+						&client->recprefix);
+		if (result == ISC_R_QUOTA) {
+			isc_stdtime_t now;
+			ns_stats_increment(client->sctx->nsstats,
+					   ns_statscounter_recursprefixquota);
+			isc_stdtime_get(&now);
+			if (now != atomic_load_relaxed(&last_prefix)) {
+				atomic_store_relaxed(&last_prefix, now);
+				ns_client_log(client, NS_LOGCATEGORY_CLIENT,
+					      NS_LOGMODULE_QUERY,
+					      ISC_LOG_WARNING,
+					      "recursive-clients-per-prefix "
+					      "limit reached");
+			}
+			return (result);
+		}
+
 		result = isc_quota_attach(&client->sctx->recursionquota,
 					  &client->recursionquota);
 		if (result == ISC_R_SUCCESS || result == ISC_R_SOFTQUOTA) {
@@ -6514,10 +7006,16 @@ check_recursionquota(ns_client_t *client) {
 			ns_client_killoldestquery(client);
 		}
 		if (result != ISC_R_SUCCESS) {
+			if (client->recprefix != NULL) {
+				ns_prefixlimit_release(
+					client->sctx->prefixlimit,
+					ns_prefixlimit_recursion,
+					&client->recprefix);
+			}
 			return (result);
 		}
 
-		dns_message_clonebuffer(client->message);
+		ns_client_savebuffer(client);
 		ns_client_recursing(client);
 	}
 
@@ -6580,6 +7078,23 @@ ns_query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 		ns_client_settimeout(client, 60);
 	}
 
+	/*
+	 * If another client is already recursing for the same question,
+	 * wait for its response instead of starting a fetch; we'll resume
+	 * via inflight_callback().
+	 */
+	if (!resuming && qtype == client->query.qtype &&
+	    qname == client->query.qname && !REDIRECT(client) &&
+	    ns_inflight_join(client->sctx->inflight, client, inflight_callback))
+	{
+		ns_client_putrdataset(client, &rdataset);
+		if (sigrdataset != NULL) {
+			ns_client_putrdataset(client, &sigrdataset);
+		}
+		isc_nmhandle_attach(client->handle, &client->fetchhandle);
+		return (ISC_R_SUCCESS);
+	}
+
 	if (!TCP(client)) {
 		peeraddr = &client->peeraddr;
 	}
@@ -6591,6 +7106,14 @@ ns_query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 		client->query.fetchoptions |= DNS_FETCHOPT_TRYSTALE_ONTIMEOUT;
 	}
 
+	isc_time_settoepoch(&client->query.fetchtime);
+	if ((client->view->latencystats != NULL &&
+	     !isc_time_isepoch(&client->latencytime)) ||
+	    ns_reclimit_enabled(&client->sctx->reclimit))
+	{
+		TIME_NOW_HIRES(&client->query.fetchtime);
+	}
+
 	isc_nmhandle_attach(client->handle, &client->fetchhandle);
 	result = dns_resolver_createfetch(
 		client->view->resolver, qname, qtype, qdomain, nameservers,
@@ -6852,6 +7375,11 @@ query_hookresume(isc_task_t *task, isc_event_t *event) {
 		isc_quota_detach(&client->recursionquota);
 		ns_stats_decrement(client->sctx->nsstats,
 				   ns_statscounter_recursclients);
+		if (client->recprefix != NULL) {
+			ns_prefixlimit_release(client->sctx->prefixlimit,
+					       ns_prefixlimit_recursion,
+					       &client->recprefix);
+		}
 	}
 
 	LOCK(&client->manager->reclock);
@@ -6991,11 +7519,6 @@ ns_query_hookasync(query_ctx_t *qctx, ns_query_starthookasync_t runasync,
 
 	saved_qctx = isc_mem_get(client->mctx, sizeof(*saved_qctx));
 	qctx_save(qctx, saved_qctx);
-	result = runasync(saved_qctx, client->mctx, arg, client->task,
-			  query_hookresume, client, &client->query.hookactx);
-	if (result != ISC_R_SUCCESS) {
-		goto cleanup;
-	}
 
 	/*
 	 * Typically the runasync() function will trigger recursion, but
@@ -7004,12 +7527,19 @@ ns_query_hookasync(query_ctx_t *qctx, ns_query_starthookasync_t runasync,
 	 * attribute won't be checked anywhere.
 	 *
 	 * Hook-based asynchronous processing cannot coincide with normal
-	 * recursion, so we can safely use fetchhandle here.  Unlike in
-	 * ns_query_recurse(), we attach to the handle only if 'runasync'
-	 * succeeds. It should be safe since we're either in the client
-	 * task or pausing it.
+	 * recursion, so we can safely use fetchhandle here.  As in
+	 * ns_query_recurse(), we attach to the handle before 'runasync'
+	 * is called, since the asynchronous process may complete, and
+	 * query_hookresume() detach it, before 'runasync' returns.
 	 */
 	isc_nmhandle_attach(client->handle, &client->fetchhandle);
+	result = runasync(saved_qctx, client->mctx, arg, client->task,
+			  query_hookresume, client, &client->query.hookactx);
+	if (result != ISC_R_SUCCESS) {
+		isc_nmhandle_detach(&client->fetchhandle);
+		goto cleanup;
+	}
+
 	return (ISC_R_SUCCESS);
 
 cleanup:
@@ -8389,6 +8919,9 @@ query_dns64(query_ctx_t *qctx) {
 	dns_view_t *view = client->view;
 	isc_netaddr_t netaddr;
 	dns_dns64_t *dns64;
+	dns_dns64_t *stackprefixes[8];
+	dns_dns64_t **prefixes = stackprefixes;
+	unsigned int i, nprefixes = 0;
 	unsigned int flags = 0;
 	const dns_section_t section = DNS_SECTION_ANSWER;
 
@@ -8488,19 +9021,34 @@ query_dns64(query_ctx_t *qctx) {
 		flags |= DNS_DNS64_DNSSEC;
 	}
 
+	/*
+	 * Which of the view's dns64 prefixes apply to this client does
+	 * not depend on the A records, so work it out once.
+	 */
+	if (view->dns64cnt > ARRAY_SIZE(stackprefixes)) {
+		prefixes = isc_mem_get(client->mctx,
+				       view->dns64cnt * sizeof(prefixes[0]));
+	}
+	for (dns64 = ISC_LIST_HEAD(client->view->dns64); dns64 != NULL;
+	     dns64 = dns_dns64_next(dns64))
+	{
+		if (dns_dns64_clientok(dns64, &netaddr, client->signer, env,
+				       flags))
+		{
+			prefixes[nprefixes++] = dns64;
+		}
+	}
+
 	for (result = dns_rdataset_first(qctx->rdataset);
 	     result == ISC_R_SUCCESS;
 	     result = dns_rdataset_next(qctx->rdataset))
 	{
-		for (dns64 = ISC_LIST_HEAD(client->view->dns64); dns64 != NULL;
-		     dns64 = dns_dns64_next(dns64))
-		{
+		for (i = 0; i < nprefixes; i++) {
 			dns_rdataset_current(qctx->rdataset, &rdata);
 			isc_buffer_availableregion(buffer, &r);
 			INSIST(r.length >= 16);
-			result = dns_dns64_aaaafroma(dns64, &netaddr,
-						     client->signer, env, flags,
-						     rdata.data, r.base);
+			result = dns_dns64_map(prefixes[i], env, rdata.data,
+					       r.base);
 			if (result != ISC_R_SUCCESS) {
 				dns_rdata_reset(&rdata);
 				continue;
@@ -8548,6 +9096,11 @@ query_dns64(query_ctx_t *qctx) {
 	result = ISC_R_SUCCESS;
 
 cleanup:
+	if (prefixes != stackprefixes) {
+		isc_mem_put(client->mctx, prefixes,
+			    view->dns64cnt * sizeof(prefixes[0]));
+	}
+
 	if (buffer != NULL) {
 		isc_buffer_free(&buffer);
 	}
@@ -9237,7 +9790,7 @@ addnsec3:
 	name = dns_fixedname_name(&qctx->dsname);
 	query_findclosestnsec3(name, qctx->db, qctx->version, client, rdataset,
 			       sigrdataset, fname, true,
-			       dns_fixedname_name(&fixed));
+			       dns_fixedname_name(&fixed), NULL);
 	if (!dns_rdataset_isassociated(rdataset)) {
 		goto cleanup;
 	}
@@ -9260,7 +9813,7 @@ addnsec3:
 		}
 		query_findclosestnsec3(dns_fixedname_name(&fixed), qctx->db,
 				       qctx->version, client, rdataset,
-				       sigrdataset, fname, false, NULL);
+				       sigrdataset, fname, false, NULL, NULL);
 		if (!dns_rdataset_isassociated(rdataset)) {
 			goto cleanup;
 		}
@@ -9436,7 +9989,7 @@ query_sign_nodata(query_ctx_t *qctx) {
 			query_findclosestnsec3(qname, qctx->db, qctx->version,
 					       qctx->client, qctx->rdataset,
 					       qctx->sigrdataset, qctx->fname,
-					       true, found);
+					       true, found, NULL);
 			/*
 			 * Did we find the closest provable encloser
 			 * instead? If so add the nearest to the
@@ -9489,15 +10042,30 @@ query_sign_nodata(query_ctx_t *qctx) {
 					found, qctx->db, qctx->version,
 					qctx->client, qctx->rdataset,
 					qctx->sigrdataset, qctx->fname, false,
-					NULL);
+					NULL, NULL);
 			}
 		} else {
 			ns_client_releasename(qctx->client, &qctx->fname);
 			query_addwildcardproof(qctx, false, true);
 		}
 	}
-	if (dns_rdataset_isassociated(qctx->rdataset)) {
-		/*
+
+	/*
+	 * An empty non-terminal is answered with a synthesized NSEC
+	 * record at the query name instead of the covering NSEC.
+	 */
+	if (WANTDNSSEC(qctx->client) && query_usecompactnsec(qctx) &&
+	    !dns_name_equal(qctx->fname, qctx->client->query.qname) &&
+	    query_addcompactnsec(qctx, false) == ISC_R_SUCCESS)
+	{
+		dns_rdataset_disassociate(qctx->rdataset);
+		if (dns_rdataset_isassociated(qctx->sigrdataset)) {
+			dns_rdataset_disassociate(qctx->sigrdataset);
+		}
+	}
+
+	if (dns_rdataset_isassociated(qctx->rdataset)) {
+		/*
 		 * If we've got a NSEC record, we need to save the
 		 * name now because we're going call query_addsoa()
 		 * below, and it needs to use the name buffer.
@@ -9597,6 +10165,212 @@ query_addnxrrsetnsec(query_ctx_t *qctx) {
 		       DNS_SECTION_AUTHORITY);
 }
 
+/*%
+ * Can a negative answer from this zone use compact denial of existence,
+ * replacing the covering NSEC record in 'qctx->rdataset' with one
+ * synthesized at the query name?
+ */
+static bool
+query_usecompactnsec(query_ctx_t *qctx) {
+	if (qctx->zone == NULL ||
+	    (dns_zone_getoptions(qctx->zone) & DNS_ZONEOPT_COMPACTDENIAL) == 0)
+	{
+		return (false);
+	}
+	if (qctx->nxrewrite || qctx->redirected || qctx->fname == NULL) {
+		return (false);
+	}
+	if (qctx->rdataset == NULL ||
+	    !dns_rdataset_isassociated(qctx->rdataset) ||
+	    qctx->rdataset->type != dns_rdatatype_nsec)
+	{
+		return (false);
+	}
+	return ((qctx->fname->attributes & DNS_NAMEATTR_WILDCARD) == 0);
+}
+
+static void
+putrdatalist(dns_message_t *message, dns_rdatalist_t **rdatalistp) {
+	dns_rdatalist_t *rdatalist = *rdatalistp;
+	dns_rdata_t *rdata = NULL;
+
+	while ((rdata = ISC_LIST_HEAD(rdatalist->rdata)) != NULL) {
+		ISC_LIST_UNLINK(rdatalist->rdata, rdata, link);
+		dns_message_puttemprdata(message, &rdata);
+	}
+	dns_message_puttemprdatalist(message, rdatalistp);
+}
+
+static unsigned char zero_ndata[] = { "\001\000" };
+static unsigned char zero_offsets[] = { 0 };
+static const dns_name_t zerolabel = DNS_NAME_INITNONABSOLUTE(zero_ndata,
+							       zero_offsets);
+
+/*
+ * The NXNAME meta type (RFC 9824) marks a synthesized NSEC record as
+ * proving that its owner name does not exist.
+ */
+#define NXNAME_TYPE 128
+
+/*%
+ * Add a signed NSEC record owned by the query name whose next name is
+ * its immediate successor, so that it denies the query name and nothing
+ * else ("compact denial of existence", RFC 9824).  Unlike the NSEC
+ * chain, this discloses no other names in the zone.  If 'nxname' is
+ * true the NXNAME type is set to show that the name does not exist.
+ */
+static isc_result_t
+query_addcompactnsec(query_ctx_t *qctx, bool nxname) {
+	ns_client_t *client = qctx->client;
+	dns_name_t *qname = client->query.qname;
+	dns_name_t *name = NULL, *next = NULL;
+	dns_fixedname_t fnext;
+	dns_rdata_nsec_t nsec;
+	dns_rdata_t *rdata = NULL;
+	dns_rdata_t sigs[DNS_ZONE_DENIALMAXSIGS];
+	dns_rdatalist_t *rdatalist = NULL, *siglist = NULL;
+	dns_rdataset_t *rdataset = NULL, *sigrdataset = NULL;
+	isc_buffer_t *buffer = NULL;
+	isc_region_t r;
+	unsigned char raw[32], map[34];
+	unsigned int nsigs = 0;
+	isc_result_t result;
+
+	CCTRACE(ISC_LOG_DEBUG(3), "query_addcompactnsec");
+
+	next = dns_fixedname_initname(&fnext);
+	result = dns_name_concatenate(&zerolabel, qname, next, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	memset(raw, 0, sizeof(raw));
+	dns_nsec_setbit(raw, dns_rdatatype_rrsig, 1);
+	dns_nsec_setbit(raw, dns_rdatatype_nsec, 1);
+	if (nxname) {
+		dns_nsec_setbit(raw, NXNAME_TYPE, 1);
+	}
+
+	nsec.common.rdclass = client->message->rdclass;
+	nsec.common.rdtype = dns_rdatatype_nsec;
+	ISC_LINK_INIT(&nsec.common, link);
+	nsec.mctx = NULL;
+	dns_name_init(&nsec.next, NULL);
+	dns_name_clone(next, &nsec.next);
+	nsec.typebits = map;
+	nsec.len = dns_nsec_compressbitmap(map, raw, NXNAME_TYPE);
+
+	isc_buffer_allocate(client->mctx, &buffer, 4096);
+	result = dns_message_gettempname(client->message, &name);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	dns_name_copy(qname, name);
+	result = dns_message_gettemprdata(client->message, &rdata);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	result = dns_message_gettemprdatalist(client->message, &rdatalist);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	result = dns_message_gettemprdatalist(client->message, &siglist);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	result = dns_message_gettemprdataset(client->message, &rdataset);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	result = dns_message_gettemprdataset(client->message, &sigrdataset);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	result = dns_rdata_fromstruct(rdata, nsec.common.rdclass,
+				      dns_rdatatype_nsec, &nsec, buffer);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	rdatalist->type = dns_rdatatype_nsec;
+	rdatalist->rdclass = nsec.common.rdclass;
+	rdatalist->ttl = qctx->rdataset->ttl;
+	ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
+	rdata = NULL;
+	RUNTIME_CHECK(dns_rdatalist_tordataset(rdatalist, rdataset) ==
+		      ISC_R_SUCCESS);
+	rdataset->trust = dns_trust_secure;
+
+	result = dns_zone_signdenial(qctx->zone, qctx->db, qctx->version,
+				     qname, rdataset, buffer, sigs, &nsigs);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	siglist->type = dns_rdatatype_rrsig;
+	siglist->covers = dns_rdatatype_nsec;
+	siglist->rdclass = nsec.common.rdclass;
+	siglist->ttl = rdatalist->ttl;
+	for (unsigned int i = 0; i < nsigs; i++) {
+		result = dns_message_gettemprdata(client->message, &rdata);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		dns_rdata_toregion(&sigs[i], &r);
+		dns_rdata_fromregion(rdata, sigs[i].rdclass, sigs[i].type, &r);
+		ISC_LIST_APPEND(siglist->rdata, rdata, link);
+		rdata = NULL;
+	}
+	RUNTIME_CHECK(dns_rdatalist_tordataset(siglist, sigrdataset) ==
+		      ISC_R_SUCCESS);
+	sigrdataset->trust = dns_trust_secure;
+
+	dns_message_takebuffer(client->message, &buffer);
+	query_addrrset(qctx, &name, &rdataset, &sigrdataset, NULL,
+		       DNS_SECTION_AUTHORITY);
+
+	/*
+	 * The lists now belong to the message unless their rdatasets
+	 * were left with us.
+	 */
+	if (rdataset == NULL) {
+		rdatalist = NULL;
+	}
+	if (sigrdataset == NULL) {
+		siglist = NULL;
+	}
+
+cleanup:
+	if (rdataset != NULL) {
+		if (dns_rdataset_isassociated(rdataset)) {
+			dns_rdataset_disassociate(rdataset);
+		}
+		dns_message_puttemprdataset(client->message, &rdataset);
+	}
+	if (sigrdataset != NULL) {
+		if (dns_rdataset_isassociated(sigrdataset)) {
+			dns_rdataset_disassociate(sigrdataset);
+		}
+		dns_message_puttemprdataset(client->message, &sigrdataset);
+	}
+	if (rdata != NULL) {
+		dns_message_puttemprdata(client->message, &rdata);
+	}
+	if (rdatalist != NULL) {
+		putrdatalist(client->message, &rdatalist);
+	}
+	if (siglist != NULL) {
+		putrdatalist(client->message, &siglist);
+	}
+	if (name != NULL) {
+		dns_message_puttempname(client->message, &name);
+	}
+	if (buffer != NULL) {
+		isc_buffer_free(&buffer);
+	}
+	return (result);
+}
+
 /*%
  * Handle NXDOMAIN and empty wildcard responses.
  */
@@ -9606,6 +10380,7 @@ query_nxdomain(query_ctx_t *qctx, isc_result_t res) {
 	uint32_t ttl;
 	isc_result_t result = res;
 	bool empty_wild = (res == DNS_R_EMPTYWILD);
+	bool compact = false;
 
 	CCTRACE(ISC_LOG_DEBUG(3), "query_nxdomain");
 
@@ -9620,6 +10395,21 @@ query_nxdomain(query_ctx_t *qctx, isc_result_t res) {
 		}
 	}
 
+	/*
+	 * With compact denial of existence a single NSEC record at the
+	 * query name replaces the covering and wildcard NSEC records,
+	 * and the response code is NOERROR.
+	 */
+	if (WANTDNSSEC(qctx->client) && query_usecompactnsec(qctx) &&
+	    query_addcompactnsec(qctx, !empty_wild) == ISC_R_SUCCESS)
+	{
+		compact = true;
+		dns_rdataset_disassociate(qctx->rdataset);
+		if (dns_rdataset_isassociated(qctx->sigrdataset)) {
+			dns_rdataset_disassociate(qctx->sigrdataset);
+		}
+	}
+
 	if (dns_rdataset_isassociated(qctx->rdataset)) {
 		/*
 		 * If we've got a NSEC record, we need to save the
@@ -9663,7 +10453,7 @@ query_nxdomain(query_ctx_t *qctx, isc_result_t res) {
 		}
 	}
 
-	if (WANTDNSSEC(qctx->client)) {
+	if (WANTDNSSEC(qctx->client) && !compact) {
 		/*
 		 * Add NSEC record if we found one.
 		 */
@@ -9678,7 +10468,7 @@ query_nxdomain(query_ctx_t *qctx, isc_result_t res) {
 	/*
 	 * Set message rcode.
 	 */
-	if (empty_wild) {
+	if (empty_wild || compact) {
 		qctx->client->message->rcode = dns_rcode_noerror;
 	} else {
 		qctx->client->message->rcode = dns_rcode_nxdomain;
@@ -10168,6 +10958,515 @@ checksignames(dns_name_t *signer, dns_rdataset_t *sigrdataset) {
 	return (ISC_R_SUCCESS);
 }
 
+/*%
+ * An NSEC3 record of the cache used to prove that a name does not exist,
+ * or only exists without the query type.
+ */
+typedef struct nsec3proof {
+	dns_fixedname_t fowner;
+	dns_name_t *owner;
+	dns_rdataset_t rdataset;
+	dns_rdataset_t sigrdataset;
+	dns_rdata_t rdata;
+	bool match;  /*%< The owner is the hashed name; it covers it if not */
+	bool optout; /*%< The opt-out flag is set */
+} nsec3proof_t;
+
+static void
+nsec3proof_init(nsec3proof_t *proof) {
+	proof->owner = dns_fixedname_initname(&proof->fowner);
+	dns_rdataset_init(&proof->rdataset);
+	dns_rdataset_init(&proof->sigrdataset);
+	dns_rdata_init(&proof->rdata);
+	proof->match = false;
+	proof->optout = false;
+}
+
+static void
+nsec3proof_clear(nsec3proof_t *proof) {
+	if (dns_rdataset_isassociated(&proof->rdataset)) {
+		dns_rdataset_disassociate(&proof->rdataset);
+	}
+	if (dns_rdataset_isassociated(&proof->sigrdataset)) {
+		dns_rdataset_disassociate(&proof->sigrdataset);
+	}
+	nsec3proof_init(proof);
+}
+
+/*%
+ * Look for the secure NSEC3 record of 'zone' in the cache that matches or
+ * covers the hash of 'name' with the parameters of 'params', and store
+ * it in 'proof'.  Return false if there is none.
+ */
+static bool
+query_findnsec3(query_ctx_t *qctx, dns_db_t *db, const dns_name_t *name,
+		dns_name_t *zone, const dns_rdata_nsec3_t *params,
+		nsec3proof_t *proof) {
+	dns_clientinfomethods_t cm;
+	dns_clientinfo_t ci;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fhashed, fsigner;
+	dns_name_t *signer = NULL;
+	dns_rdata_nsec3_t nsec3;
+	dns_label_t label;
+	isc_buffer_t buffer;
+	isc_result_t result;
+	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
+	unsigned char owner[NSEC3_MAX_HASH_LENGTH];
+	size_t length;
+	int order;
+
+	nsec3proof_clear(proof);
+
+	result = dns_nsec3_hashname(&fhashed, hash, &length, name, zone,
+				    params->hash, params->iterations,
+				    params->salt, params->salt_length);
+	if (result != ISC_R_SUCCESS) {
+		return (false);
+	}
+
+	dns_clientinfomethods_init(&cm, ns_client_sourceip);
+	dns_clientinfo_init(&ci, qctx->client, NULL);
+
+	result = dns_db_findext(db, dns_fixedname_name(&fhashed), NULL,
+				dns_rdatatype_nsec3,
+				qctx->client->query.dboptions |
+					DNS_DBFIND_COVERINGNSEC,
+				qctx->client->now, &node, proof->owner, &cm,
+				&ci, &proof->rdataset, &proof->sigrdataset);
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+	if ((result != ISC_R_SUCCESS && result != DNS_R_COVERINGNSEC) ||
+	    proof->rdataset.type != dns_rdatatype_nsec3 ||
+	    proof->rdataset.trust != dns_trust_secure ||
+	    !dns_rdataset_isassociated(&proof->sigrdataset) ||
+	    proof->sigrdataset.trust != dns_trust_secure)
+	{
+		return (false);
+	}
+
+	/*
+	 * The record must belong to the NSEC3 chain of 'zone'.
+	 */
+	if (dns_name_countlabels(proof->owner) !=
+		    dns_name_countlabels(zone) + 1 ||
+	    !dns_name_issubdomain(proof->owner, zone))
+	{
+		return (false);
+	}
+	signer = dns_fixedname_initname(&fsigner);
+	if (checksignames(signer, &proof->sigrdataset) != ISC_R_SUCCESS ||
+	    !dns_name_equal(signer, zone))
+	{
+		return (false);
+	}
+
+	if (dns_rdataset_first(&proof->rdataset) != ISC_R_SUCCESS) {
+		return (false);
+	}
+	dns_rdataset_current(&proof->rdataset, &proof->rdata);
+	result = dns_rdata_tostruct(&proof->rdata, &nsec3, NULL);
+	if (result != ISC_R_SUCCESS || nsec3.hash != params->hash ||
+	    nsec3.iterations != params->iterations ||
+	    nsec3.salt_length != params->salt_length ||
+	    memcmp(nsec3.salt, params->salt, nsec3.salt_length) != 0 ||
+	    nsec3.next_length != length)
+	{
+		return (false);
+	}
+
+	/*
+	 * Recover the hash from the first label of the owner name.
+	 */
+	dns_name_getlabel(proof->owner, 0, &label);
+	isc_region_consume(&label, 1);
+	isc_buffer_init(&buffer, owner, sizeof(owner));
+	result = isc_base32hex_decoderegion(&label, &buffer);
+	if (result != ISC_R_SUCCESS || isc_buffer_usedlength(&buffer) != length)
+	{
+		return (false);
+	}
+
+	proof->optout = ((nsec3.flags & DNS_NSEC3FLAG_OPTOUT) != 0);
+	order = memcmp(hash, owner, length);
+	if (order == 0) {
+		proof->match = true;
+		return (true);
+	}
+
+	/*
+	 * The last record of the chain covers the hashes after its owner
+	 * and those before the first one.
+	 */
+	if (memcmp(owner, nsec3.next, length) < 0) {
+		return (order > 0 && memcmp(hash, nsec3.next, length) < 0);
+	}
+	return (order > 0 || memcmp(hash, nsec3.next, length) < 0);
+}
+
+/*%
+ * Synthesize a NXDOMAIN or NODATA response from the SOA record of
+ * 'signer' and the NSEC3 records in 'proofs'.
+ */
+static isc_result_t
+query_synthnsec3(query_ctx_t *qctx, bool nodata, nsec3proof_t **proofs,
+		 unsigned int nproofs, const dns_name_t *signer,
+		 dns_rdataset_t **soardatasetp,
+		 dns_rdataset_t **sigsoardatasetp) {
+	dns_name_t *name = NULL;
+	dns_rdataset_t *cloneset = NULL, *clonesigset = NULL;
+	dns_ttl_t ttl;
+	isc_buffer_t *dbuf, b;
+	isc_result_t result;
+
+	CCTRACE(ISC_LOG_DEBUG(3), "query_synthnsec3");
+
+	/*
+	 * Determine the correct TTL to use for the SOA and RRSIG
+	 */
+	ttl = query_synthttl(*soardatasetp, *sigsoardatasetp,
+			     &proofs[0]->rdataset, &proofs[0]->sigrdataset,
+			     NULL, NULL);
+	for (unsigned int i = 1; i < nproofs; i++) {
+		ttl = ISC_MIN(ttl, proofs[i]->rdataset.ttl);
+		ttl = ISC_MIN(ttl, proofs[i]->sigrdataset.ttl);
+	}
+	(*soardatasetp)->ttl = (*sigsoardatasetp)->ttl = ttl;
+
+	/*
+	 * The NSEC3 record that was found for the query name is only
+	 * used for its parameters.
+	 */
+	ns_client_releasename(qctx->client, &qctx->fname);
+
+	dbuf = ns_client_getnamebuf(qctx->client);
+	if (dbuf == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+
+	name = ns_client_newname(qctx->client, dbuf, &b);
+	if (name == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+
+	dns_name_copy(signer, name);
+
+	/*
+	 * Add SOA record. Omit the RRSIG if DNSSEC was not requested.
+	 */
+	if (!WANTDNSSEC(qctx->client)) {
+		sigsoardatasetp = NULL;
+	}
+	query_addrrset(qctx, &name, soardatasetp, sigsoardatasetp, dbuf,
+		       DNS_SECTION_AUTHORITY);
+
+	/*
+	 * Add the proofs; a record used for more than one is only added
+	 * once.
+	 */
+	for (unsigned int i = 0; WANTDNSSEC(qctx->client) && i < nproofs; i++)
+	{
+		dbuf = ns_client_getnamebuf(qctx->client);
+		if (dbuf == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+
+		name = ns_client_newname(qctx->client, dbuf, &b);
+		if (name == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+
+		dns_name_copy(proofs[i]->owner, name);
+
+		cloneset = ns_client_newrdataset(qctx->client);
+		clonesigset = ns_client_newrdataset(qctx->client);
+		if (cloneset == NULL || clonesigset == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+
+		dns_rdataset_clone(&proofs[i]->rdataset, cloneset);
+		dns_rdataset_clone(&proofs[i]->sigrdataset, clonesigset);
+
+		query_addrrset(qctx, &name, &cloneset, &clonesigset, dbuf,
+			       DNS_SECTION_AUTHORITY);
+		if (cloneset != NULL) {
+			ns_client_putrdataset(qctx->client, &cloneset);
+		}
+		if (clonesigset != NULL) {
+			ns_client_putrdataset(qctx->client, &clonesigset);
+		}
+	}
+
+	if (nodata) {
+		inc_stats(qctx->client, ns_statscounter_nodatasynth);
+	} else {
+		qctx->client->message->rcode = dns_rcode_nxdomain;
+		inc_stats(qctx->client, ns_statscounter_nxdomainsynth);
+	}
+	result = ISC_R_SUCCESS;
+
+cleanup:
+	if (name != NULL) {
+		ns_client_releasename(qctx->client, &name);
+	}
+	if (cloneset != NULL) {
+		ns_client_putrdataset(qctx->client, &cloneset);
+	}
+	if (clonesigset != NULL) {
+		ns_client_putrdataset(qctx->client, &clonesigset);
+	}
+	return (result);
+}
+
+/*%
+ * Handle a covering NSEC3 record for the query name, whose owner is in
+ * the zone 'signer'.  The record itself only provides the NSEC3
+ * parameters of the zone: the cached NSEC3 records that match or cover
+ * the hashes of the query name, of its closest encloser, and of the
+ * wildcard at the closest encloser are each found with one lookup of
+ * the hashed name in the cache.
+ *
+ * If an NSEC3 record matches the query name, but neither the query
+ * type nor CNAME are in its type map, synthesize a NODATA response.
+ *
+ * If the query name is covered, find its closest encloser.  If the next
+ * closer name is covered by an NSEC3 record without the opt-out flag,
+ * and the wildcard at the closest encloser is covered as well,
+ * synthesize an NXDOMAIN response (RFC 5155, section 7.2.2).
+ *
+ * Wildcard answers are not synthesized.  '*donep' is set if a response
+ * was synthesized.
+ */
+static isc_result_t
+query_coveringnsec3(query_ctx_t *qctx, dns_name_t *signer, bool *donep,
+		    bool *redirectedp) {
+	nsec3proof_t proofs[3];
+	nsec3proof_t *proof[3];
+	dns_clientinfomethods_t cm;
+	dns_clientinfo_t ci;
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fzone, fencloser, fwild, fsoa;
+	dns_name_t *zone = NULL, *encloser = NULL, *wild = NULL;
+	dns_name_t *qname = qctx->client->query.qname;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_nsec3_t params;
+	dns_rdataset_t *soardataset = NULL, *sigsoardataset = NULL;
+	unsigned int labels, nc = 0, ce = 1, nproofs;
+	bool nodata = false;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	CCTRACE(ISC_LOG_DEBUG(3), "query_coveringnsec3");
+
+	for (unsigned int i = 0; i < 3; i++) {
+		nsec3proof_init(&proofs[i]);
+	}
+
+	/*
+	 * Records at the parent side of a zone cut are not handled.
+	 */
+	if (dns_rdatatype_atparent(qctx->qtype)) {
+		goto cleanup;
+	}
+
+	/*
+	 * The NSEC3 record must be from the zone of the signer, and the
+	 * query name must be in that zone.
+	 */
+	zone = dns_fixedname_initname(&fzone);
+	labels = dns_name_countlabels(qctx->fname);
+	if (labels < 2) {
+		goto cleanup;
+	}
+	dns_name_getlabelsequence(qctx->fname, 1, labels - 1, zone);
+	if (!dns_name_equal(zone, signer) || !dns_name_issubdomain(qname, zone))
+	{
+		goto cleanup;
+	}
+
+	result = dns_rdataset_first(qctx->rdataset);
+	if (result != ISC_R_SUCCESS) {
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+	dns_rdataset_current(qctx->rdataset, &rdata);
+	result = dns_rdata_tostruct(&rdata, &params, NULL);
+	if (result != ISC_R_SUCCESS) {
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+	if (!dns_nsec3_supportedhash(params.hash) ||
+	    params.iterations > DNS_NSEC3_MAXITERATIONS)
+	{
+		goto cleanup;
+	}
+
+	dns_db_attach(qctx->db, &db);
+
+	if (!query_findnsec3(qctx, db, qname, zone, &params, &proofs[0])) {
+		goto cleanup;
+	}
+
+	if (proofs[0].match) {
+		/*
+		 * The name exists: it must not have the type, a CNAME, or
+		 * be a delegation.
+		 */
+		if (dns_nsec3_typepresent(&proofs[0].rdata, qctx->qtype) ||
+		    dns_nsec3_typepresent(&proofs[0].rdata,
+					  dns_rdatatype_cname) ||
+		    (dns_nsec3_typepresent(&proofs[0].rdata,
+					   dns_rdatatype_ns) &&
+		     !dns_nsec3_typepresent(&proofs[0].rdata,
+					    dns_rdatatype_soa)))
+		{
+			goto cleanup;
+		}
+		if (qctx->type == dns_rdatatype_any) { /* XXX not yet */
+			goto cleanup;
+		}
+		if (!ISC_LIST_EMPTY(qctx->view->dns64) &&
+		    (qctx->type == dns_rdatatype_a ||
+		     qctx->type == dns_rdatatype_aaaa)) /* XXX not yet */
+		{
+			goto cleanup;
+		}
+		if (!qctx->resuming && !STALE(&proofs[0].rdataset) &&
+		    proofs[0].rdataset.ttl == 0 && RECURSIONOK(qctx->client))
+		{
+			goto cleanup;
+		}
+		nodata = true;
+		proof[0] = &proofs[0];
+		nproofs = 1;
+	} else {
+		/*
+		 * Look for the closest encloser, keeping the record that
+		 * covers the name one label below it (the next closer
+		 * name) in proofs[nc].
+		 */
+		if (dns_name_countlabels(qname) == dns_name_countlabels(zone))
+		{
+			goto cleanup;
+		}
+		encloser = dns_fixedname_initname(&fencloser);
+		for (labels = dns_name_countlabels(qname) - 1;; labels--) {
+			unsigned int tmp;
+
+			dns_name_split(qname, labels, NULL, encloser);
+			if (!query_findnsec3(qctx, db, encloser, zone, &params,
+					     &proofs[ce]))
+			{
+				goto cleanup;
+			}
+			if (proofs[ce].match) {
+				break;
+			}
+			if (labels == dns_name_countlabels(zone)) {
+				goto cleanup;
+			}
+			tmp = nc;
+			nc = ce;
+			ce = tmp;
+		}
+
+		/*
+		 * The closest encloser must not be a delegation or a DNAME,
+		 * and an insecure delegation may hide in an opt-out range.
+		 */
+		if (dns_nsec3_typepresent(&proofs[ce].rdata,
+					  dns_rdatatype_dname) ||
+		    (dns_nsec3_typepresent(&proofs[ce].rdata,
+					   dns_rdatatype_ns) &&
+		     !dns_nsec3_typepresent(&proofs[ce].rdata,
+					    dns_rdatatype_soa)) ||
+		    proofs[nc].optout)
+		{
+			goto cleanup;
+		}
+
+		wild = dns_fixedname_initname(&fwild);
+		result = dns_name_concatenate(dns_wildcardname, encloser, wild,
+					      NULL);
+		if (result != ISC_R_SUCCESS) {
+			result = ISC_R_SUCCESS;
+			goto cleanup;
+		}
+		if (!query_findnsec3(qctx, db, wild, zone, &params,
+				     &proofs[3 - nc - ce]) ||
+		    proofs[3 - nc - ce].match)
+		{
+			goto cleanup;
+		}
+
+		proof[0] = &proofs[ce];
+		proof[1] = &proofs[nc];
+		proof[2] = &proofs[3 - nc - ce];
+		nproofs = 3;
+
+		/*
+		 * We now have the proof that we have an NXDOMAIN.  Apply
+		 * NXDOMAIN redirection if configured.
+		 */
+		result = query_redirect(qctx);
+		if (result != ISC_R_COMPLETE) {
+			*redirectedp = true;
+			goto cleanup;
+		}
+		result = ISC_R_SUCCESS;
+	}
+
+	soardataset = ns_client_newrdataset(qctx->client);
+	sigsoardataset = ns_client_newrdataset(qctx->client);
+	if (soardataset == NULL || sigsoardataset == NULL) {
+		goto cleanup;
+	}
+
+	/*
+	 * Look for SOA record to construct the response.
+	 */
+	dns_clientinfomethods_init(&cm, ns_client_sourceip);
+	dns_clientinfo_init(&ci, qctx->client, NULL);
+	result = dns_db_findext(db, zone, qctx->version, dns_rdatatype_soa,
+				qctx->client->query.dboptions,
+				qctx->client->now, &node,
+				dns_fixedname_initname(&fsoa), &cm, &ci,
+				soardataset, sigsoardataset);
+	if (result != ISC_R_SUCCESS ||
+	    !dns_rdataset_isassociated(sigsoardataset))
+	{
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+	(void)query_synthnsec3(qctx, nodata, proof, nproofs, zone,
+			       &soardataset, &sigsoardataset);
+	*donep = true;
+
+cleanup:
+	for (unsigned int i = 0; i < 3; i++) {
+		nsec3proof_clear(&proofs[i]);
+	}
+	if (soardataset != NULL) {
+		ns_client_putrdataset(qctx->client, &soardataset);
+	}
+	if (sigsoardataset != NULL) {
+		ns_client_putrdataset(qctx->client, &sigsoardataset);
+	}
+	if (db != NULL) {
+		if (node != NULL) {
+			dns_db_detachnode(db, &node);
+		}
+		dns_db_detach(&db);
+	}
+	return (result);
+}
+
 /*%
  * Handle covering NSEC responses.
  *
@@ -10261,6 +11560,11 @@ query_coveringnsec(query_ctx_t *qctx) {
 		goto cleanup;
 	}
 
+	if (qctx->rdataset->type == dns_rdatatype_nsec3) {
+		result = query_coveringnsec3(qctx, signer, &done, &redirected);
+		goto cleanup;
+	}
+
 	/*
 	 * If NSEC or RRSIG are missing from the type map
 	 * reject the NSEC RRset.
@@ -11407,6 +12711,107 @@ cleanup:
 	}
 }
 
+/*%
+ * Compute in one batch the NSEC3 hashes that the proofs for 'name' need:
+ * its closest encloser 'cname', the next closer name and, unless
+ * 'ispositive', the wildcard at the closest encloser.  Return how many
+ * of them were stored in 'hashed', or 0 on failure.
+ */
+static unsigned int
+query_hashnsec3proof(query_ctx_t *qctx, const dns_name_t *name,
+		     const dns_name_t *cname, bool ispositive,
+		     dns_fixedname_t hashed[3]) {
+	unsigned char salt[256];
+	size_t salt_length = sizeof(salt);
+	uint16_t iterations;
+	dns_hash_t hash;
+	dns_fixedname_t fnext, fwild, missed[3];
+	const dns_name_t *names[3], *misses[3];
+	ns_nsec3hash_t *entries[3];
+	unsigned int index[3];
+	dns_name_t *next, *wild;
+	unsigned int i, labels, count = 0, nmisses = 0;
+	isc_result_t result;
+	bool hit;
+
+	result = dns_db_getnsec3parameters(qctx->db, qctx->version, &hash,
+					   NULL, &iterations, salt,
+					   &salt_length);
+	if (result != ISC_R_SUCCESS) {
+		return (0);
+	}
+
+	/*
+	 * Map unknown algorithm to known value.
+	 */
+	if (hash == DNS_NSEC3_UNKNOWNALG) {
+		hash = 1;
+	}
+
+	names[count++] = cname;
+
+	next = dns_fixedname_initname(&fnext);
+	labels = dns_name_countlabels(cname) + 1;
+	if (dns_name_countlabels(name) == labels) {
+		dns_name_copy(name, next);
+	} else {
+		dns_name_split(name, labels, NULL, next);
+	}
+	names[count++] = next;
+
+	if (!ispositive) {
+		wild = dns_fixedname_initname(&fwild);
+		result = dns_name_concatenate(dns_wildcardname, cname, wild,
+					      NULL);
+		if (result == ISC_R_SUCCESS) {
+			names[count++] = wild;
+		}
+	}
+
+	/*
+	 * The closest encloser and the wildcard are usually the same for
+	 * many queries, so only hash the names that are not cached yet.
+	 */
+	for (i = 0; i < count; i++) {
+		entries[i] = query_nsec3cache_slot(
+			qctx->client, names[i], dns_db_origin(qctx->db), hash,
+			iterations, salt, salt_length, &hit);
+		if (hit) {
+			dns_name_copy(dns_fixedname_name(&entries[i]->hashed),
+				      dns_fixedname_initname(&hashed[i]));
+		} else {
+			index[nmisses] = i;
+			misses[nmisses++] = names[i];
+		}
+	}
+	if (nmisses == 0) {
+		return (count);
+	}
+
+	result = dns_nsec3_hashnames(missed, misses, nmisses,
+				     dns_db_origin(qctx->db), hash, iterations,
+				     salt, salt_length);
+	if (result != ISC_R_SUCCESS) {
+		return (0);
+	}
+
+	for (i = 0; i < nmisses; i++) {
+		const dns_name_t *hname = dns_fixedname_name(&missed[i]);
+
+		dns_name_copy(hname, dns_fixedname_initname(&hashed[index[i]]));
+		/*
+		 * The next closer name (index 1) is the random part.
+		 */
+		if (index[i] != 1) {
+			query_nsec3cache_store(entries[index[i]], misses[i],
+					       hname, hash, iterations, salt,
+					       salt_length);
+		}
+	}
+
+	return (count);
+}
+
 static void
 query_addwildcardproof(query_ctx_t *qctx, bool ispositive, bool nodata) {
 	ns_client_t *client = qctx->client;
@@ -11424,8 +12829,10 @@ query_addwildcardproof(query_ctx_t *qctx, bool ispositive, bool nodata) {
 	dns_rdata_nsec_t nsec;
 	bool have_wname;
 	int order;
-	dns_fixedname_t cfixed;
-	dns_name_t *cname;
+	dns_fixedname_t cfixed, efixed;
+	dns_name_t *cname, *encloser;
+	dns_fixedname_t hashed[3];
+	unsigned int nhashed;
 	dns_clientinfomethods_t cm;
 	dns_clientinfo_t ci;
 
@@ -11536,15 +12943,31 @@ again:
 						NULL, fname, &cm, &ci, NULL,
 						NULL);
 		}
+		/*
+		 * Hash the names of all the NSEC3 proofs at once.
+		 */
+		encloser = dns_fixedname_initname(&efixed);
+		dns_name_copy(cname, encloser);
+		nhashed = query_hashnsec3proof(qctx, name, cname, ispositive,
+					       hashed);
+
 		/*
 		 * Add closest (provable) encloser NSEC3.
 		 */
-		query_findclosestnsec3(cname, qctx->db, qctx->version, client,
-				       rdataset, sigrdataset, fname, true,
-				       cname);
+		query_findclosestnsec3(
+			cname, qctx->db, qctx->version, client, rdataset,
+			sigrdataset, fname, true, cname,
+			nhashed > 0 ? dns_fixedname_name(&hashed[0]) : NULL);
 		if (!dns_rdataset_isassociated(rdataset)) {
 			goto cleanup;
 		}
+		if (!dns_name_equal(cname, encloser)) {
+			/*
+			 * The closest provable encloser is higher up
+			 * because of opt-out; the other hashes are stale.
+			 */
+			nhashed = 0;
+		}
 		if (!ispositive) {
 			query_addrrset(qctx, &fname, &rdataset, &sigrdataset,
 				       dbuf, DNS_SECTION_AUTHORITY);
@@ -11586,9 +13009,10 @@ again:
 			dns_name_split(name, labels, NULL, wname);
 		}
 
-		query_findclosestnsec3(wname, qctx->db, qctx->version, client,
-				       rdataset, sigrdataset, fname, false,
-				       NULL);
+		query_findclosestnsec3(
+			wname, qctx->db, qctx->version, client, rdataset,
+			sigrdataset, fname, false, NULL,
+			nhashed > 1 ? dns_fixedname_name(&hashed[1]) : NULL);
 		if (!dns_rdataset_isassociated(rdataset)) {
 			goto cleanup;
 		}
@@ -11634,9 +13058,10 @@ again:
 			goto cleanup;
 		}
 
-		query_findclosestnsec3(wname, qctx->db, qctx->version, client,
-				       rdataset, sigrdataset, fname, nodata,
-				       NULL);
+		query_findclosestnsec3(
+			wname, qctx->db, qctx->version, client, rdataset,
+			sigrdataset, fname, nodata, NULL,
+			nhashed > 2 ? dns_fixedname_name(&hashed[2]) : NULL);
 		if (!dns_rdataset_isassociated(rdataset)) {
 			goto cleanup;
 		}
@@ -12438,5 +13863,19 @@ ns_query_start(ns_client_t *client, isc_nmhandle_t *handle) {
 		message->flags |= DNS_MESSAGEFLAG_AD;
 	}
 
+	/*
+	 * Answer from the view's cache of rendered responses if possible.
+	 */
+	if (client->view->answercache != NULL &&
+	    ns_answercache_find(client->view->answercache, client,
+				&client->query.cachedanswer) == ISC_R_SUCCESS)
+	{
+		message->flags = client->query.cachedanswer->flags;
+		message->rcode = client->query.cachedanswer->rcode;
+		client->query.isreferral = client->query.cachedanswer->referral;
+		query_send(client);
+		return;
+	}
+
 	(void)query_setup(client, qtype);
 }
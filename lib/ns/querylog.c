@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <isc/align.h>
+#include <isc/errno.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
+#include <isc/thread.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/message.h>
+#include <dns/name.h>
+
+#include <ns/client.h>
+#include <ns/querylog.h>
+
+#define QUERYLOG_MAGIC	  ISC_MAGIC('Q', 'L', 'o', 'g')
+#define VALID_QUERYLOG(q) ISC_MAGIC_VALID(q, QUERYLOG_MAGIC)
+
+/*%
+ * Records are buffered in one of QUERYLOG_BUFFERS buffers, picked by
+ * thread id, and written out QUERYLOG_RECORDS at a time.
+ */
+#define QUERYLOG_BUFFERS 16
+#define QUERYLOG_RECORDS 224
+
+typedef struct querylog_buffer {
+	alignas(ISC_OS_CACHELINE_SIZE) isc_mutex_t lock;
+	unsigned int count;
+	isc_stdtime_t first; /*%< when the oldest record was added */
+	unsigned char data[QUERYLOG_RECORDS * NS_QUERYLOG_RECORDSIZE];
+} querylog_buffer_t;
+
+struct ns_querylog {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	int fd;
+	querylog_buffer_t buffers[QUERYLOG_BUFFERS];
+};
+
+static void
+put16(unsigned char *p, uint16_t v) {
+	p[0] = v >> 8;
+	p[1] = v & 0xff;
+}
+
+static void
+put32(unsigned char *p, uint32_t v) {
+	put16(p, v >> 16);
+	put16(p + 2, v & 0xffff);
+}
+
+static void
+put64(unsigned char *p, uint64_t v) {
+	put32(p, v >> 32);
+	put32(p + 4, v & 0xffffffff);
+}
+
+static isc_result_t
+write_all(int fd, const unsigned char *data, size_t len) {
+	ssize_t n = write(fd, data, len);
+
+	if (n < 0) {
+		return (isc_errno_toresult(errno));
+	}
+	if ((size_t)n != len) {
+		return (ISC_R_NOSPACE);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Requires the buffer lock.
+ */
+static void
+flush_buffer(ns_querylog_t *qlog, querylog_buffer_t *buffer) {
+	if (buffer->count == 0) {
+		return;
+	}
+
+	/*
+	 * A single write per buffer, so that the records of different
+	 * buffers are never interleaved.
+	 */
+	(void)write_all(qlog->fd, buffer->data,
+			buffer->count * NS_QUERYLOG_RECORDSIZE);
+	buffer->count = 0;
+}
+
+isc_result_t
+ns_querylog_create(isc_mem_t *mctx, const char *path, ns_querylog_t **qlogp) {
+	ns_querylog_t *qlog = NULL;
+	unsigned char header[NS_QUERYLOG_RECORDSIZE] = { 0 };
+	struct stat sb;
+	isc_result_t result;
+	int fd;
+
+	REQUIRE(path != NULL);
+	REQUIRE(qlogp != NULL && *qlogp == NULL);
+
+	fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_NONBLOCK, 0644);
+	if (fd < 0) {
+		return (isc_errno_toresult(errno));
+	}
+
+	if (fstat(fd, &sb) < 0) {
+		result = isc_errno_toresult(errno);
+		goto cleanup;
+	}
+	if (!S_ISREG(sb.st_mode) || sb.st_size == 0) {
+		memmove(header, "BIND9QLG", 8);
+		put32(header + 8, NS_QUERYLOG_VERSION);
+		put32(header + 12, NS_QUERYLOG_RECORDSIZE);
+		result = write_all(fd, header, sizeof(header));
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	qlog = isc_mem_get_aligned(mctx, sizeof(*qlog), ISC_OS_CACHELINE_SIZE);
+	*qlog = (ns_querylog_t){ .fd = fd };
+	for (size_t i = 0; i < QUERYLOG_BUFFERS; i++) {
+		isc_mutex_init(&qlog->buffers[i].lock);
+	}
+	isc_mem_attach(mctx, &qlog->mctx);
+	qlog->magic = QUERYLOG_MAGIC;
+
+	*qlogp = qlog;
+	return (ISC_R_SUCCESS);
+
+cleanup:
+	(void)close(fd);
+	return (result);
+}
+
+void
+ns_querylog_destroy(ns_querylog_t **qlogp) {
+	ns_querylog_t *qlog = NULL;
+
+	REQUIRE(qlogp != NULL && VALID_QUERYLOG(*qlogp));
+
+	qlog = *qlogp;
+	*qlogp = NULL;
+
+	qlog->magic = 0;
+	for (size_t i = 0; i < QUERYLOG_BUFFERS; i++) {
+		LOCK(&qlog->buffers[i].lock);
+		flush_buffer(qlog, &qlog->buffers[i]);
+		UNLOCK(&qlog->buffers[i].lock);
+		isc_mutex_destroy(&qlog->buffers[i].lock);
+	}
+	(void)close(qlog->fd);
+
+	isc_mem_putanddetach_aligned(&qlog->mctx, qlog, sizeof(*qlog),
+				     ISC_OS_CACHELINE_SIZE);
+}
+
+void
+ns_querylog_log(ns_querylog_t *qlog, ns_client_t *client) {
+	querylog_buffer_t *buffer = NULL;
+	unsigned char *record = NULL;
+	isc_netaddr_t netaddr;
+	isc_time_t now;
+	uint64_t usecs, latency;
+	uint16_t flags = 0;
+
+	REQUIRE(VALID_QUERYLOG(qlog));
+	REQUIRE(NS_CLIENT_VALID(client));
+
+	TIME_NOW(&now);
+	usecs = isc_time_seconds(&client->requesttime) * UINT64_C(1000000) +
+		isc_time_nanoseconds(&client->requesttime) / 1000;
+	latency = isc_time_microdiff(&now, &client->requesttime);
+
+	if ((client->message->flags & DNS_MESSAGEFLAG_RD) != 0) {
+		flags |= NS_QUERYLOG_FLAG_RD;
+	}
+	if ((client->message->flags & DNS_MESSAGEFLAG_CD) != 0) {
+		flags |= NS_QUERYLOG_FLAG_CD;
+	}
+	if ((client->extflags & DNS_MESSAGEEXTFLAG_DO) != 0) {
+		flags |= NS_QUERYLOG_FLAG_DO;
+	}
+	if (client->ednsversion >= 0) {
+		flags |= NS_QUERYLOG_FLAG_EDNS;
+	}
+	if ((client->attributes & NS_CLIENTATTR_TCP) != 0) {
+		flags |= NS_QUERYLOG_FLAG_TCP;
+	}
+	if (client->signer != NULL) {
+		flags |= NS_QUERYLOG_FLAG_SIGNED;
+	}
+	if ((client->attributes & NS_CLIENTATTR_HAVECOOKIE) != 0) {
+		flags |= NS_QUERYLOG_FLAG_COOKIE;
+	}
+	if ((client->attributes & NS_CLIENTATTR_HAVEECS) != 0) {
+		flags |= NS_QUERYLOG_FLAG_ECS;
+	}
+
+	buffer = &qlog->buffers[isc_tid_v % QUERYLOG_BUFFERS];
+	LOCK(&buffer->lock);
+
+	if (buffer->count == 0) {
+		buffer->first = client->now;
+	}
+	record = buffer->data + buffer->count * NS_QUERYLOG_RECORDSIZE;
+	memset(record, 0, NS_QUERYLOG_RECORDSIZE);
+
+	put64(record, usecs);
+	put32(record + 8, ISC_MIN(latency, UINT32_MAX));
+	put16(record + 12, client->query.qtype);
+	put16(record + 14, client->message->rdclass);
+	put16(record + 16, flags);
+	put16(record + 18, client->message->rcode);
+	put16(record + 20, isc_sockaddr_getport(&client->peeraddr));
+
+	isc_netaddr_fromsockaddr(&netaddr, &client->peeraddr);
+	if (netaddr.family == AF_INET6) {
+		record[22] = 6;
+		memmove(record + 24, &netaddr.type.in6, 16);
+	} else if (netaddr.family == AF_INET) {
+		record[22] = 4;
+		memmove(record + 24, &netaddr.type.in, 4);
+	}
+
+	if (client->query.qname != NULL) {
+		isc_region_t r;
+
+		dns_name_toregion(client->query.qname, &r);
+		INSIST(r.length <= NS_QUERYLOG_RECORDSIZE - 40);
+		record[23] = r.length;
+		memmove(record + 40, r.base, r.length);
+	}
+
+	buffer->count++;
+	if (buffer->count == QUERYLOG_RECORDS ||
+	    client->now > buffer->first)
+	{
+		flush_buffer(qlog, buffer);
+	}
+
+	UNLOCK(&buffer->lock);
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <isc/atomic.h>
+#include <isc/mutex.h>
+#include <isc/quota.h>
+#include <isc/util.h>
+
+#include <ns/reclimit.h>
+#include <ns/stats.h>
+
+/*
+ * The baseline follows a lower window average at once, and a higher
+ * one by 1/16 of the difference, so that a lasting change in upstream
+ * latency is eventually accepted as the new normal.
+ */
+#define BASELINE_DRIFT 16
+
+static unsigned int
+isqrt(unsigned int n) {
+	unsigned int r = 0;
+
+	while ((r + 1) * (r + 1) <= n) {
+		r++;
+	}
+	return (r);
+}
+
+void
+ns_reclimit_init(ns_reclimit_t *rl, isc_quota_t *quota) {
+	REQUIRE(rl != NULL);
+	REQUIRE(quota != NULL);
+
+	*rl = (ns_reclimit_t){ .quota = quota };
+	isc_mutex_init(&rl->lock);
+	atomic_init(&rl->enabled, false);
+}
+
+void
+ns_reclimit_destroy(ns_reclimit_t *rl) {
+	REQUIRE(rl != NULL);
+
+	isc_mutex_destroy(&rl->lock);
+}
+
+void
+ns_reclimit_configure(ns_reclimit_t *rl, bool enabled, unsigned int soft) {
+	REQUIRE(rl != NULL);
+	REQUIRE(soft > 0);
+
+	LOCK(&rl->lock);
+	rl->ceiling = soft;
+	rl->floor = ISC_MIN(soft, ISC_MAX(soft / 10, 10));
+	rl->limit = soft;
+	rl->samples = 0;
+	rl->total = 0;
+	rl->baseline = 0;
+	isc_quota_soft(rl->quota, soft);
+	atomic_store_release(&rl->enabled, enabled);
+	UNLOCK(&rl->lock);
+}
+
+void
+ns_reclimit_sample(ns_reclimit_t *rl, uint64_t usecs, ns_stats_t *stats) {
+	uint64_t average;
+	unsigned int limit;
+
+	REQUIRE(rl != NULL);
+
+	if (!atomic_load_acquire(&rl->enabled)) {
+		return;
+	}
+
+	LOCK(&rl->lock);
+	rl->total += usecs;
+	if (++rl->samples < NS_RECLIMIT_WINDOW) {
+		UNLOCK(&rl->lock);
+		return;
+	}
+
+	average = ISC_MAX(rl->total / rl->samples, 1);
+	rl->samples = 0;
+	rl->total = 0;
+
+	if (rl->baseline == 0 || average < rl->baseline) {
+		rl->baseline = average;
+	} else {
+		rl->baseline += (average - rl->baseline) / BASELINE_DRIFT;
+	}
+
+	/*
+	 * Scale the limit by how much slower than the baseline the
+	 * window was (at most halving it), then allow some headroom
+	 * for growth.
+	 */
+	limit = (unsigned int)(rl->limit * rl->baseline / average);
+	limit = ISC_MAX(limit, rl->limit / 2) + isqrt(rl->limit);
+	limit = ISC_MIN(ISC_MAX(limit, rl->floor), rl->ceiling);
+
+	if (limit != rl->limit) {
+		if (stats != NULL) {
+			isc_statscounter_t counter =
+				(limit < rl->limit)
+					? ns_statscounter_reclimitlowered
+					: ns_statscounter_reclimitraised;
+			ns_stats_increment(stats, counter);
+		}
+		rl->limit = limit;
+		isc_quota_soft(rl->quota, limit);
+	}
+	UNLOCK(&rl->lock);
+}
+
+bool
+ns_reclimit_enabled(ns_reclimit_t *rl) {
+	REQUIRE(rl != NULL);
+
+	return (atomic_load_acquire(&rl->enabled));
+}
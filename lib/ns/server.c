@@ -22,9 +22,12 @@
 #include <dns/stats.h>
 #include <dns/tkey.h>
 
+#include <ns/inflight.h>
 #include <ns/query.h>
+#include <ns/querylog.h>
 #include <ns/server.h>
 #include <ns/stats.h>
+#include <ns/xfrout.h>
 
 #define SCTX_MAGIC    ISC_MAGIC('S', 'c', 't', 'x')
 #define SCTX_VALID(s) ISC_MAGIC_VALID(s, SCTX_MAGIC)
@@ -52,8 +55,12 @@ ns_server_create(isc_mem_t *mctx, ns_matchview_t matchingview,
 	isc_refcount_init(&sctx->references, 1);
 
 	isc_quota_init(&sctx->xfroutquota, 10);
+	ns_xfrcache_create(mctx, &sctx->xfrcache);
 	isc_quota_init(&sctx->tcpquota, 10);
 	isc_quota_init(&sctx->recursionquota, 100);
+	ns_reclimit_init(&sctx->reclimit, &sctx->recursionquota);
+	ns_prefixlimit_create(mctx, &sctx->prefixlimit);
+	ns_inflight_create(mctx, &sctx->inflight);
 	isc_quota_init(&sctx->updquota, 100);
 	ISC_LIST_INIT(sctx->http_quotas);
 	isc_mutex_init(&sctx->http_quotas_lock);
@@ -62,35 +69,36 @@ ns_server_create(isc_mem_t *mctx, ns_matchview_t matchingview,
 
 	CHECKFATAL(ns_stats_create(mctx, ns_statscounter_max, &sctx->nsstats));
 
-	CHECKFATAL(dns_rdatatypestats_create(mctx, &sctx->rcvquerystats));
+	CHECKFATAL(dns_rdatatypestats_create_sharded(mctx,
+						     &sctx->rcvquerystats));
 
 	CHECKFATAL(dns_opcodestats_create(mctx, &sctx->opcodestats));
 
 	CHECKFATAL(dns_rcodestats_create(mctx, &sctx->rcodestats));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->udpinstats4,
-				    dns_sizecounter_in_max));
+	CHECKFATAL(isc_stats_create_sharded(mctx, &sctx->udpinstats4,
+					    dns_sizecounter_in_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->udpoutstats4,
-				    dns_sizecounter_out_max));
+	CHECKFATAL(isc_stats_create_sharded(mctx, &sctx->udpoutstats4,
+					    dns_sizecounter_out_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->udpinstats6,
-				    dns_sizecounter_in_max));
+	CHECKFATAL(isc_stats_create_sharded(mctx, &sctx->udpinstats6,
+					    dns_sizecounter_in_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->udpoutstats6,
-				    dns_sizecounter_out_max));
+	CHECKFATAL(isc_stats_create_sharded(mctx, &sctx->udpoutstats6,
+					    dns_sizecounter_out_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->tcpinstats4,
-				    dns_sizecounter_in_max));
+	CHECKFATAL(isc_stats_create_sharded(mctx, &sctx->tcpinstats4,
+					    dns_sizecounter_in_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->tcpoutstats4,
-				    dns_sizecounter_out_max));
+	CHECKFATAL(isc_stats_create_sharded(mctx, &sctx->tcpoutstats4,
+					    dns_sizecounter_out_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->tcpinstats6,
-				    dns_sizecounter_in_max));
+	CHECKFATAL(isc_stats_create_sharded(mctx, &sctx->tcpinstats6,
+					    dns_sizecounter_in_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->tcpoutstats6,
-				    dns_sizecounter_out_max));
+	CHECKFATAL(isc_stats_create_sharded(mctx, &sctx->tcpoutstats6,
+					    dns_sizecounter_out_max));
 
 	sctx->udpsize = 1232;
 	sctx->transfer_tcp_message_size = 20480;
@@ -137,9 +145,16 @@ ns_server_detach(ns_server_t **sctxp) {
 		}
 
 		isc_quota_destroy(&sctx->updquota);
+		ns_inflight_destroy(&sctx->inflight);
+		ns_reclimit_destroy(&sctx->reclimit);
+		ns_prefixlimit_destroy(&sctx->prefixlimit);
 		isc_quota_destroy(&sctx->recursionquota);
 		isc_quota_destroy(&sctx->tcpquota);
 		isc_quota_destroy(&sctx->xfroutquota);
+		ns_xfrcache_destroy(&sctx->xfrcache);
+		if (sctx->querylog != NULL) {
+			ns_querylog_destroy(&sctx->querylog);
+		}
 
 		http_quota = ISC_LIST_HEAD(sctx->http_quotas);
 		while (http_quota != NULL) {
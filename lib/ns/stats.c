@@ -17,6 +17,7 @@
 #include <isc/mem.h>
 #include <isc/refcount.h>
 #include <isc/stats.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include <ns/stats.h>
@@ -70,7 +71,7 @@ ns_stats_create(isc_mem_t *mctx, int ncounters, ns_stats_t **statsp) {
 
 	isc_refcount_init(&stats->references, 1);
 
-	result = isc_stats_create(mctx, &stats->counters, ncounters);
+	result = isc_stats_create_sharded(mctx, &stats->counters, ncounters);
 	if (result != ISC_R_SUCCESS) {
 		goto clean_mem;
 	}
@@ -126,3 +127,31 @@ ns_stats_get_counter(ns_stats_t *stats, isc_statscounter_t counter) {
 
 	return (isc_stats_get_counter(stats->counters, counter));
 }
+
+isc_result_t
+ns_latencystats_create(isc_mem_t *mctx, isc_stats_t **statsp) {
+	return (isc_stats_create(mctx, statsp, ns_latencystatscounter_max));
+}
+
+void
+ns_latencystats_add(isc_stats_t *stats, ns_latency_t stage,
+		    const isc_time_t *start) {
+	isc_time_t now;
+	uint64_t usec;
+	int bucket = 0;
+
+	REQUIRE(stage < ns_latency_max);
+
+	if (stats == NULL || isc_time_isepoch(start)) {
+		return;
+	}
+
+	TIME_NOW_HIRES(&now);
+	usec = isc_time_microdiff(&now, start);
+	while (usec != 0 && bucket < NS_LATENCY_BUCKETS - 1) {
+		usec >>= 1;
+		bucket++;
+	}
+
+	isc_stats_increment(stats, stage * NS_LATENCY_BUCKETS + bucket);
+}
@@ -257,6 +257,11 @@ typedef struct {
 	dns_diff_t add_diff;
 } add_rr_prepare_ctx_t;
 
+/*%
+ * The most updates to a zone that are applied in a single version.
+ */
+#define UPDATE_BATCH_MAX 64
+
 /**************************************************************************/
 /*
  * Forward declarations.
@@ -1649,7 +1654,6 @@ static isc_result_t
 send_update_event(ns_client_t *client, dns_zone_t *zone) {
 	isc_result_t result = ISC_R_SUCCESS;
 	update_event_t *event = NULL;
-	isc_task_t *zonetask = NULL;
 	dns_ssutable_t *ssutable = NULL;
 	dns_message_t *request = client->message;
 	isc_mem_t *mctx = client->manager->mctx;
@@ -1897,8 +1901,7 @@ send_update_event(ns_client_t *client, dns_zone_t *zone) {
 	event->ev_arg = client;
 
 	isc_nmhandle_attach(client->handle, &client->updatehandle);
-	dns_zone_gettask(zone, &zonetask);
-	isc_task_send(zonetask, ISC_EVENT_PTR(&event));
+	dns_zone_queueupdate(zone, ISC_EVENT_PTR(&event));
 
 failure:
 	if (db != NULL) {
@@ -2016,12 +2019,12 @@ ns_update_start(ns_client_t *client, isc_nmhandle_t *handle,
 		if (sigresult != ISC_R_SUCCESS) {
 			FAIL(sigresult);
 		}
-		dns_message_clonebuffer(client->message);
+		ns_client_savebuffer(client);
 		CHECK(send_update_event(client, zone));
 		break;
 	case dns_zone_secondary:
 	case dns_zone_mirror:
-		dns_message_clonebuffer(client->message);
+		ns_client_savebuffer(client);
 		CHECK(send_forward_event(client, zone));
 		break;
 	default:
@@ -2874,20 +2877,23 @@ isdnssec(dns_db_t *db, dns_dbversion_t *ver, dns_rdatatype_t privatetype) {
 	return (build_nsec || build_nsec3);
 }
 
-static void
-update_action(isc_task_t *task, isc_event_t *event) {
-	update_event_t *uev = (update_event_t *)event;
+/*%
+ * Check the prerequisites of the update in 'uev' against version 'ver'
+ * of 'db', and perform its update section in that version, logging
+ * the changes in 'diff'.
+ *
+ * If this fails, '*clean' tells whether 'diff' still records every
+ * change that was made, so that they can be backed out.
+ */
+static isc_result_t
+update_apply(update_event_t *uev, dns_db_t *db, dns_dbversion_t *ver,
+	     dns_diff_t *diff, bool *soa_serial_changed, bool *clean) {
 	dns_zone_t *zone = uev->zone;
-	ns_client_t *client = (ns_client_t *)event->ev_arg;
+	ns_client_t *client = (ns_client_t *)uev->ev_arg;
 	const dns_ssurule_t **rules = uev->rules;
 	size_t rule = 0, ruleslen = uev->ruleslen;
 	isc_result_t result;
-	dns_db_t *db = NULL;
-	dns_dbversion_t *oldver = NULL;
-	dns_dbversion_t *ver = NULL;
-	dns_diff_t diff; /* Pending updates. */
 	dns_diff_t temp; /* Pending RR existence assertions. */
-	bool soa_serial_changed = false;
 	isc_mem_t *mctx = client->mctx;
 	dns_rdatatype_t covers;
 	dns_message_t *request = client->message;
@@ -2897,31 +2903,17 @@ update_action(isc_task_t *task, isc_event_t *event) {
 	dns_fixedname_t tmpnamefixed;
 	dns_name_t *tmpname = NULL;
 	dns_zoneopt_t options;
-	dns_difftuple_t *tuple;
-	dns_rdata_dnskey_t dnskey;
-	bool had_dnskey;
 	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
 	dns_ttl_t maxttl = 0;
-	uint32_t maxrecords;
-	uint64_t records;
-
-	INSIST(event->ev_type == DNS_EVENT_UPDATE);
 
-	dns_diff_init(mctx, &diff);
 	dns_diff_init(mctx, &temp);
+	*clean = true;
 
-	CHECK(dns_zone_getdb(zone, &db));
 	zonename = dns_db_origin(db);
 	zoneclass = dns_db_class(db);
 	dns_zone_getssutable(zone, &ssutable);
 	options = dns_zone_getoptions(zone);
 
-	/*
-	 * Get old and new versions now that queryacl has been checked.
-	 */
-	dns_db_currentversion(db, &oldver);
-	CHECK(dns_db_newversion(db, &ver));
-
 	/*
 	 * Check prerequisites.
 	 */
@@ -3050,8 +3042,10 @@ update_action(isc_task_t *task, isc_event_t *event) {
 	update_log(client, zone, LOGLEVEL_DEBUG, "prerequisites are OK");
 
 	/*
-	 * Process the Update Section.
+	 * Process the Update Section.  If it fails part of the way
+	 * through, 'diff' may not record all of the changes made.
 	 */
+	*clean = false;
 	INSIST(ssutable == NULL || rules != NULL);
 	for (rule = 0,
 	    result = dns_message_firstname(request, DNS_SECTION_UPDATE);
@@ -3147,7 +3141,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 						   "ignoring it");
 					continue;
 				}
-				soa_serial_changed = true;
+				*soa_serial_changed = true;
 			}
 
 			if (dns_rdatatype_atparent(rdata.type) &&
@@ -3267,7 +3261,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 				add_rr_prepare_ctx_t ctx;
 				ctx.db = db;
 				ctx.ver = ver;
-				ctx.diff = &diff;
+				ctx.diff = diff;
 				ctx.name = name;
 				ctx.oldname = name;
 				ctx.update_rr = &rdata;
@@ -3284,18 +3278,18 @@ update_action(isc_task_t *task, isc_event_t *event) {
 					dns_diff_clear(&ctx.add_diff);
 				} else {
 					result = do_diff(&ctx.del_diff, db, ver,
-							 &diff);
+							 diff);
 					if (result == ISC_R_SUCCESS) {
 						result = do_diff(&ctx.add_diff,
 								 db, ver,
-								 &diff);
+								 diff);
 					}
 					if (result != ISC_R_SUCCESS) {
 						dns_diff_clear(&ctx.del_diff);
 						dns_diff_clear(&ctx.add_diff);
 						goto failure;
 					}
-					CHECK(update_one_rr(db, ver, &diff,
+					CHECK(update_one_rr(db, ver, diff,
 							    DNS_DIFFOP_ADD,
 							    name, ttl, &rdata));
 				}
@@ -3318,12 +3312,12 @@ update_action(isc_task_t *task, isc_event_t *event) {
 					CHECK(delete_if(type_not_soa_nor_ns_p,
 							db, ver, name,
 							dns_rdatatype_any, 0,
-							&rdata, &diff));
+							&rdata, diff));
 				} else {
 					CHECK(delete_if(type_not_dnssec, db,
 							ver, name,
 							dns_rdatatype_any, 0,
-							&rdata, &diff));
+							&rdata, diff));
 				}
 			} else if (dns_name_equal(name, zonename) &&
 				   (rdata.type == dns_rdatatype_soa ||
@@ -3351,7 +3345,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 				}
 				CHECK(delete_if(true_p, db, ver, name,
 						rdata.type, covers, &rdata,
-						&diff));
+						diff));
 			}
 		} else if (update_class == dns_rdataclass_none) {
 			char namestr[DNS_NAME_FORMATSIZE];
@@ -3390,23 +3384,24 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			update_log(client, zone, LOGLEVEL_PROTOCOL,
 				   "deleting an RR at %s %s", namestr, typestr);
 			CHECK(delete_if(rr_equal_p, db, ver, name, rdata.type,
-					covers, &rdata, &diff));
+					covers, &rdata, diff));
 		}
 	}
 	if (result != ISC_R_NOMORE) {
 		FAIL(result);
 	}
+	*clean = true;
 
 	/*
 	 * Check that any changes to DNSKEY/NSEC3PARAM records make sense.
 	 * If they don't then back out all changes to DNSKEY/NSEC3PARAM
 	 * records.
 	 */
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
-		CHECK(check_dnssec(client, zone, db, ver, &diff));
+	if (!ISC_LIST_EMPTY(diff->tuples)) {
+		CHECK(check_dnssec(client, zone, db, ver, diff));
 	}
 
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
+	if (!ISC_LIST_EMPTY(diff->tuples)) {
 		unsigned int errors = 0;
 		CHECK(dns_zone_nscheck(zone, db, ver, &errors));
 		if (errors != 0) {
@@ -3417,7 +3412,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			goto failure;
 		}
 	}
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
+	if (!ISC_LIST_EMPTY(diff->tuples)) {
 		result = dns_zone_cdscheck(zone, db, ver);
 		if (result == DNS_R_BADCDS || result == DNS_R_BADCDNSKEY) {
 			update_log(client, zone, LOGLEVEL_PROTOCOL,
@@ -3431,14 +3426,83 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		}
 	}
 
+	result = ISC_R_SUCCESS;
+
+failure:
+	dns_diff_clear(&temp);
+
+	if (ssutable != NULL) {
+		dns_ssutable_detach(&ssutable);
+	}
+
+	return (result);
+}
+
+/*%
+ * Back out the changes in 'diff', which were made to version 'ver'
+ * of 'db' by an update that then failed.
+ */
+static isc_result_t
+update_undo(dns_db_t *db, dns_dbversion_t *ver, dns_diff_t *diff) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_difftuple_t *tuple = NULL;
+
+	while (result == ISC_R_SUCCESS &&
+	       (tuple = ISC_LIST_TAIL(diff->tuples)) != NULL)
+	{
+		dns_diff_t temp_diff;
+
+		ISC_LIST_UNLINK(diff->tuples, tuple, link);
+		switch (tuple->op) {
+		case DNS_DIFFOP_ADD:
+			tuple->op = DNS_DIFFOP_DEL;
+			break;
+		case DNS_DIFFOP_DEL:
+			tuple->op = DNS_DIFFOP_ADD;
+			break;
+		default:
+			dns_difftuple_free(&tuple);
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+		dns_diff_init(diff->mctx, &temp_diff);
+		ISC_LIST_APPEND(temp_diff.tuples, tuple, link);
+		result = dns_diff_apply(&temp_diff, db, ver);
+		dns_diff_clear(&temp_diff);
+	}
+
+	return (result);
+}
+
+/*%
+ * Finish the changes in 'diff', made by one or more updates from
+ * 'oldver' to '*verp': increment the SOA serial number, update RRSIGs
+ * and NSECs (if the zone is secure), write the changes to the journal
+ * and commit the version.  Problems are logged for 'client'.
+ *
+ * On failure, '*verp' is left open for the caller to roll back.
+ */
+static isc_result_t
+update_commit(ns_client_t *client, dns_zone_t *zone, dns_db_t *db,
+	      dns_dbversion_t *oldver, dns_dbversion_t **verp,
+	      dns_diff_t *diff, bool soa_serial_changed) {
+	isc_result_t result;
+	dns_dbversion_t *ver = *verp;
+	isc_mem_t *mctx = diff->mctx;
+	dns_name_t *zonename = dns_db_origin(db);
+	dns_difftuple_t *tuple;
+	dns_rdata_dnskey_t dnskey;
+	bool had_dnskey;
+	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
+	uint32_t maxrecords;
+	uint64_t records;
+
 	/*
 	 * If any changes were made, increment the SOA serial number,
 	 * update RRSIGs and NSECs (if zone is secure), and write the update
 	 * to the journal.
 	 */
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
+	if (!ISC_LIST_EMPTY(diff->tuples)) {
 		char *journalfile;
-		dns_journal_t *journal;
 		bool has_dnskey;
 
 		/*
@@ -3447,13 +3511,13 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		 */
 		if (!soa_serial_changed) {
 			CHECK(update_soa_serial(
-				db, ver, &diff, mctx,
+				db, ver, diff, mctx,
 				dns_zone_getserialupdatemethod(zone)));
 		}
 
-		CHECK(check_mx(client, zone, db, ver, &diff));
+		CHECK(check_mx(client, zone, db, ver, diff));
 
-		CHECK(remove_orphaned_ds(db, ver, &diff));
+		CHECK(remove_orphaned_ds(db, ver, diff));
 
 		CHECK(rrset_exists(db, ver, zonename, dns_rdatatype_dnskey, 0,
 				   &has_dnskey));
@@ -3475,11 +3539,11 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			}
 		}
 
-		CHECK(rollback_private(db, privatetype, ver, &diff));
+		CHECK(rollback_private(db, privatetype, ver, diff));
 
-		CHECK(add_signing_records(db, privatetype, ver, &diff));
+		CHECK(add_signing_records(db, privatetype, ver, diff));
 
-		CHECK(add_nsec3param_records(client, zone, db, ver, &diff));
+		CHECK(add_nsec3param_records(client, zone, db, ver, diff));
 
 		if (had_dnskey && !has_dnskey) {
 			/*
@@ -3489,7 +3553,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			 * remove any NSEC chain present will also be removed.
 			 */
 			CHECK(dns_nsec3param_deletechains(db, ver, zone, true,
-							  &diff));
+							  diff));
 		} else if (has_dnskey && isdnssec(db, ver, privatetype)) {
 			dns_update_log_t log;
 			uint32_t interval =
@@ -3498,7 +3562,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			log.func = update_log_cb;
 			log.arg = client;
 			result = dns_update_signatures(&log, zone, db, oldver,
-						       ver, &diff, interval);
+						       ver, diff, interval);
 
 			if (result != ISC_R_SUCCESS) {
 				update_log(client, zone, ISC_LOG_ERROR,
@@ -3526,20 +3590,15 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			update_log(client, zone, LOGLEVEL_DEBUG,
 				   "writing journal %s", journalfile);
 
-			journal = NULL;
-			result = dns_journal_open(mctx, journalfile,
-						  DNS_JOURNAL_CREATE, &journal);
-			if (result != ISC_R_SUCCESS) {
-				FAILS(result, "journal open failed");
-			}
-
-			result = dns_journal_write_transaction(journal, &diff);
+			/*
+			 * With a journal delay set, the transaction may
+			 * only be synced later; the response waits for
+			 * that below.
+			 */
+			result = dns_zone_writejournal(zone, diff);
 			if (result != ISC_R_SUCCESS) {
-				dns_journal_destroy(&journal);
 				FAILS(result, "journal write failed");
 			}
-
-			dns_journal_destroy(&journal);
 		}
 
 		/*
@@ -3550,7 +3609,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		update_log(client, zone, LOGLEVEL_DEBUG,
 			   "committing update transaction");
 
-		dns_db_closeversion(db, &ver, true);
+		dns_db_closeversion(db, verp, true);
 
 		/*
 		 * Mark the zone as dirty so that it will be written to disk.
@@ -3569,7 +3628,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		 *
 		 * Note: we are already committed to this course of action.
 		 */
-		for (tuple = ISC_LIST_HEAD(diff.tuples); tuple != NULL;
+		for (tuple = ISC_LIST_HEAD(diff->tuples); tuple != NULL;
 		     tuple = ISC_LIST_NEXT(tuple, link))
 		{
 			isc_region_t r;
@@ -3608,7 +3667,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		 *
 		 * Note: we are already committed to this course of action.
 		 */
-		for (tuple = ISC_LIST_HEAD(diff.tuples); tuple != NULL;
+		for (tuple = ISC_LIST_HEAD(diff->tuples); tuple != NULL;
 		     tuple = ISC_LIST_NEXT(tuple, link))
 		{
 			unsigned char buf[DNS_NSEC3PARAM_BUFFERSIZE];
@@ -3640,12 +3699,122 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		}
 	} else {
 		update_log(client, zone, LOGLEVEL_DEBUG, "redundant request");
-		dns_db_closeversion(db, &ver, true);
+		dns_db_closeversion(db, verp, true);
 	}
 	result = ISC_R_SUCCESS;
-	goto common;
 
 failure:
+	return (result);
+}
+
+/*%
+ * Apply the 'count' updates in 'uevs' to their zone in a single
+ * version, and store the result of each in its event.  Updates whose
+ * prerequisites or checks fail are backed out on their own.
+ *
+ * If the updates that succeeded can't be committed together, nothing
+ * is committed and 'retry' is set for each update that needs to be
+ * applied again on its own.
+ */
+static void
+update_batch(update_event_t **uevs, size_t count, bool *retry) {
+	dns_zone_t *zone = uevs[0]->zone;
+	ns_client_t *client = NULL;
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *oldver = NULL;
+	dns_dbversion_t *ver = NULL;
+	dns_diff_t diff; /* Pending updates. */
+	bool soa_serial_changed = false;
+	size_t i, nok = 0;
+
+	for (i = 0; i < count; i++) {
+		retry[i] = false;
+	}
+
+	dns_diff_init(((ns_client_t *)uevs[0]->ev_arg)->mctx, &diff);
+
+	CHECK(dns_zone_getdb(zone, &db));
+
+	/*
+	 * Get old and new versions now that queryacl has been checked.
+	 */
+	dns_db_currentversion(db, &oldver);
+	CHECK(dns_db_newversion(db, &ver));
+
+	for (i = 0; i < count; i++) {
+		dns_diff_t udiff;
+		dns_difftuple_t *tuple = NULL;
+		bool serial = false, clean = true;
+
+		dns_diff_init(diff.mctx, &udiff);
+		result = update_apply(uevs[i], db, ver, &udiff, &serial,
+				      &clean);
+		if (result == ISC_R_SUCCESS) {
+			while ((tuple = ISC_LIST_HEAD(udiff.tuples)) != NULL) {
+				ISC_LIST_UNLINK(udiff.tuples, tuple, link);
+				dns_diff_appendminimal(&diff, &tuple);
+			}
+			soa_serial_changed = soa_serial_changed || serial;
+			if (client == NULL) {
+				client = (ns_client_t *)uevs[i]->ev_arg;
+			}
+			nok++;
+		} else if (clean &&
+			   update_undo(db, ver, &udiff) == ISC_R_SUCCESS)
+		{
+			update_log((ns_client_t *)uevs[i]->ev_arg, zone,
+				   LOGLEVEL_DEBUG, "rolling back");
+		} else {
+			/*
+			 * The other updates can't be separated from the
+			 * partial changes of this one.
+			 */
+			dns_diff_clear(&udiff);
+			uevs[i]->result = result;
+			for (i = 0; i < count; i++) {
+				retry[i] = (uevs[i]->result == ISC_R_SUCCESS ||
+					    uevs[i]->result == ISC_R_UNSET);
+			}
+			goto failure;
+		}
+		dns_diff_clear(&udiff);
+		uevs[i]->result = result;
+	}
+
+	if (nok == 0) {
+		dns_db_closeversion(db, &ver, false);
+		goto cleanup;
+	}
+
+	result = update_commit(client, zone, db, oldver, &ver, &diff,
+			       soa_serial_changed);
+	if (result != ISC_R_SUCCESS && nok > 1) {
+		/*
+		 * One of the updates may be to blame, such as by
+		 * exceeding max-records; apply them separately.
+		 */
+		for (i = 0; i < count; i++) {
+			retry[i] = (uevs[i]->result == ISC_R_SUCCESS);
+		}
+		goto failure;
+	}
+	for (i = 0; i < count; i++) {
+		if (uevs[i]->result == ISC_R_SUCCESS) {
+			uevs[i]->result = result;
+		}
+	}
+	if (result != ISC_R_SUCCESS) {
+		goto failure;
+	}
+	goto cleanup;
+
+failure:
+	for (i = 0; i < count; i++) {
+		if (!retry[i] && uevs[i]->result == ISC_R_UNSET) {
+			uevs[i]->result = result;
+		}
+	}
 	/*
 	 * The reason for failure should have been logged at this point.
 	 */
@@ -3654,8 +3823,7 @@ failure:
 		dns_db_closeversion(db, &ver, false);
 	}
 
-common:
-	dns_diff_clear(&temp);
+cleanup:
 	dns_diff_clear(&diff);
 
 	if (oldver != NULL) {
@@ -3666,26 +3834,72 @@ common:
 		dns_db_detach(&db);
 	}
 
-	if (rules != NULL) {
-		isc_mem_put(mctx, rules, sizeof(*rules) * ruleslen);
-	}
+	INSIST(ver == NULL);
+}
 
-	if (ssutable != NULL) {
-		dns_ssutable_detach(&ssutable);
-	}
+/*%
+ * Return the result of the update in 'uev' to its client.
+ */
+static void
+update_done(update_event_t *uev) {
+	ns_client_t *client = (ns_client_t *)uev->ev_arg;
+	dns_zone_t *zone = uev->zone;
+	isc_event_t *event = (isc_event_t *)uev;
 
-	isc_task_detach(&task);
-	uev->result = result;
-	if (zone != NULL) {
-		INSIST(uev->zone == zone); /* we use this later */
+	if (uev->rules != NULL) {
+		isc_mem_put(client->mctx, uev->rules,
+			    sizeof(*uev->rules) * uev->ruleslen);
+		uev->rules = NULL;
 	}
+
 	uev->ev_type = DNS_EVENT_UPDATEDONE;
 	uev->ev_action = updatedone_action;
 
-	isc_task_send(client->task, &event);
+	if (uev->result == ISC_R_SUCCESS) {
+		dns_zone_sendaftersync(zone, client->task, &event);
+	} else {
+		isc_task_send(client->task, &event);
+	}
+}
 
-	INSIST(ver == NULL);
-	INSIST(event == NULL);
+static void
+update_action(isc_task_t *task, isc_event_t *event) {
+	update_event_t *uevs[UPDATE_BATCH_MAX];
+	bool retry[UPDATE_BATCH_MAX];
+	update_event_t *uev = (update_event_t *)event;
+	dns_zone_t *zone = uev->zone;
+	isc_eventlist_t events;
+	size_t i, count = 0;
+
+	UNUSED(task);
+
+	INSIST(event->ev_type == DNS_EVENT_UPDATE);
+
+	/*
+	 * Take the updates that have been queued for the zone behind
+	 * this one, so that they are all applied in one version.
+	 */
+	ISC_LIST_INIT(events);
+	dns_zone_takeupdates(zone, UPDATE_BATCH_MAX - 1, &events);
+	uevs[count++] = uev;
+	while ((event = ISC_LIST_HEAD(events)) != NULL) {
+		ISC_LIST_UNLINK(events, event, ev_link);
+		INSIST(event->ev_type == DNS_EVENT_UPDATE);
+		uevs[count++] = (update_event_t *)event;
+	}
+
+	for (i = 0; i < count; i++) {
+		uevs[i]->result = ISC_R_UNSET;
+	}
+	update_batch(uevs, count, retry);
+	for (i = 0; i < count; i++) {
+		if (retry[i]) {
+			uevs[i]->result = ISC_R_UNSET;
+			update_batch(&uevs[i], 1, &retry[i]);
+		}
+		INSIST(uevs[i]->result != ISC_R_UNSET);
+		update_done(uevs[i]);
+	}
 }
 
 static void
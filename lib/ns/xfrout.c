@@ -13,17 +13,23 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <isc/formatcheck.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/netmgr.h>
 #include <isc/print.h>
+#include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/stats.h>
+#include <isc/stdtime.h>
 #include <isc/util.h>
 
 #include <dns/db.h>
 #include <dns/dbiterator.h>
+#include <dns/diff.h>
 #include <dns/dlz.h>
 #include <dns/fixedname.h>
 #include <dns/journal.h>
@@ -288,6 +294,255 @@ static rrstream_methods_t ixfr_rrstream_methods = {
 	rrstream_noop_pause, ixfr_rrstream_destroy
 };
 
+/**************************************************************************/
+/*
+ * A 'condensed_rrstream_t' is an 'rrstream_t' that returns the net
+ * changes made by the transactions of an 'ixfr_rrstream_t' as a single
+ * sequence: the old SOA, the deletions, the new SOA and the additions.
+ * Changes that are undone later in the range, such as records that
+ * are added and removed again or RRSIGs that are replaced by newer
+ * ones, are left out.
+ *
+ * The journal is read when the stream is first positioned.
+ */
+
+typedef struct condensed_rrstream {
+	rrstream_t common;
+	rrstream_t *journal;
+	dns_diff_t diff;
+	dns_difftuple_t *current;
+} condensed_rrstream_t;
+
+typedef struct condensed_change {
+	dns_difftuple_t *tuple;
+	size_t seq; /* Position in the journal */
+} condensed_change_t;
+
+static rrstream_methods_t condensed_rrstream_methods;
+
+/*
+ * Takes ownership of '*journalp'.
+ */
+static void
+condensed_rrstream_create(isc_mem_t *mctx, rrstream_t **journalp,
+			  rrstream_t **sp) {
+	condensed_rrstream_t *s = NULL;
+
+	INSIST(sp != NULL && *sp == NULL);
+
+	s = isc_mem_get(mctx, sizeof(*s));
+	*s = (condensed_rrstream_t){ .common.methods =
+					     &condensed_rrstream_methods,
+				     .journal = *journalp };
+	isc_mem_attach(mctx, &s->common.mctx);
+	dns_diff_init(mctx, &s->diff);
+	*journalp = NULL;
+
+	*sp = (rrstream_t *)s;
+}
+
+/*
+ * Order changes by record, and the changes to each record in the order
+ * they were made.
+ */
+static int
+condensed_compare(const void *av, const void *bv) {
+	const condensed_change_t *a = av, *b = bv;
+	int order;
+
+	order = dns_name_compare(&a->tuple->name, &b->tuple->name);
+	if (order == 0) {
+		order = dns_rdata_compare(&a->tuple->rdata, &b->tuple->rdata);
+	}
+	if (order == 0 && a->tuple->ttl != b->tuple->ttl) {
+		order = (a->tuple->ttl < b->tuple->ttl) ? -1 : 1;
+	}
+	if (order == 0) {
+		order = (a->seq < b->seq) ? -1 : 1;
+	}
+	return (order);
+}
+
+/*
+ * Read the journal and compute the net changes.
+ */
+static isc_result_t
+condensed_rrstream_load(condensed_rrstream_t *s) {
+	isc_result_t result;
+	isc_mem_t *mctx = s->common.mctx;
+	rrstream_t *journal = s->journal;
+	dns_diff_t changes, adds;
+	dns_difftuple_t *tuple = NULL, *soa_begin = NULL, *soa_end = NULL;
+	condensed_change_t *array = NULL;
+	size_t count = 0, i, j;
+	unsigned int nsoa = 0;
+
+	dns_diff_init(mctx, &changes);
+	dns_diff_init(mctx, &adds);
+
+	/*
+	 * Each transaction starts with the old SOA, followed by the
+	 * deletions, the new SOA and the additions.
+	 */
+	for (result = journal->methods->first(journal);
+	     result == ISC_R_SUCCESS; result = journal->methods->next(journal))
+	{
+		dns_name_t *name = NULL;
+		uint32_t ttl;
+		dns_rdata_t *rdata = NULL;
+		dns_diffop_t op;
+
+		journal->methods->current(journal, &name, &ttl, &rdata);
+		if (rdata->type == dns_rdatatype_soa) {
+			nsoa++;
+		}
+		op = (nsoa % 2 != 0) ? DNS_DIFFOP_DEL : DNS_DIFFOP_ADD;
+		CHECK(dns_difftuple_create(mctx, op, name, ttl, rdata,
+					   &tuple));
+		if (rdata->type != dns_rdatatype_soa) {
+			ISC_LIST_APPEND(changes.tuples, tuple, link);
+			tuple = NULL;
+			count++;
+		} else if (soa_begin == NULL) {
+			soa_begin = tuple;
+			tuple = NULL;
+		} else {
+			if (soa_end != NULL) {
+				dns_difftuple_free(&soa_end);
+			}
+			soa_end = tuple;
+			tuple = NULL;
+		}
+	}
+	if (result != ISC_R_NOMORE) {
+		goto failure;
+	}
+	if (soa_begin == NULL || soa_end == NULL || nsoa % 2 != 0) {
+		CHECK(ISC_R_UNEXPECTEDEND);
+	}
+
+	/*
+	 * The changes to a record alternate between deleting and adding
+	 * it, so an even number of changes cancels out and an odd number
+	 * leaves the first one.
+	 */
+	if (count > 0) {
+		array = isc_mem_get(mctx, count * sizeof(array[0]));
+		for (i = 0; i < count; i++) {
+			tuple = ISC_LIST_HEAD(changes.tuples);
+			ISC_LIST_UNLINK(changes.tuples, tuple, link);
+			array[i] = (condensed_change_t){ .tuple = tuple,
+							 .seq = i };
+		}
+		tuple = NULL;
+		qsort(array, count, sizeof(array[0]), condensed_compare);
+	}
+
+	ISC_LIST_APPEND(s->diff.tuples, soa_begin, link);
+	soa_begin = NULL;
+	for (i = 0; i < count; i = j) {
+		dns_difftuple_t *first = array[i].tuple;
+
+		for (j = i + 1; j < count; j++) {
+			dns_difftuple_t *t = array[j].tuple;
+			if (!dns_name_equal(&t->name, &first->name) ||
+			    dns_rdata_compare(&t->rdata, &first->rdata) != 0 ||
+			    t->ttl != first->ttl)
+			{
+				break;
+			}
+		}
+		if ((j - i) % 2 != 0) {
+			if (first->op == DNS_DIFFOP_DEL) {
+				ISC_LIST_APPEND(s->diff.tuples, first, link);
+			} else {
+				ISC_LIST_APPEND(adds.tuples, first, link);
+			}
+			array[i].tuple = NULL;
+		}
+	}
+	ISC_LIST_APPEND(s->diff.tuples, soa_end, link);
+	soa_end = NULL;
+	ISC_LIST_APPENDLIST(s->diff.tuples, adds.tuples, link);
+
+	result = ISC_R_SUCCESS;
+
+failure:
+	if (array != NULL) {
+		for (i = 0; i < count; i++) {
+			if (array[i].tuple != NULL) {
+				dns_difftuple_free(&array[i].tuple);
+			}
+		}
+		isc_mem_put(mctx, array, count * sizeof(array[0]));
+	}
+	if (tuple != NULL) {
+		dns_difftuple_free(&tuple);
+	}
+	if (soa_begin != NULL) {
+		dns_difftuple_free(&soa_begin);
+	}
+	if (soa_end != NULL) {
+		dns_difftuple_free(&soa_end);
+	}
+	dns_diff_clear(&changes);
+	dns_diff_clear(&adds);
+	journal->methods->destroy(&s->journal);
+	s->journal = NULL;
+	return (result);
+}
+
+static isc_result_t
+condensed_rrstream_first(rrstream_t *rs) {
+	condensed_rrstream_t *s = (condensed_rrstream_t *)rs;
+
+	if (s->journal != NULL) {
+		isc_result_t result = condensed_rrstream_load(s);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+	s->current = ISC_LIST_HEAD(s->diff.tuples);
+	return (s->current != NULL ? ISC_R_SUCCESS : ISC_R_NOMORE);
+}
+
+static isc_result_t
+condensed_rrstream_next(rrstream_t *rs) {
+	condensed_rrstream_t *s = (condensed_rrstream_t *)rs;
+
+	s->current = ISC_LIST_NEXT(s->current, link);
+	return (s->current != NULL ? ISC_R_SUCCESS : ISC_R_NOMORE);
+}
+
+static void
+condensed_rrstream_current(rrstream_t *rs, dns_name_t **name, uint32_t *ttl,
+			   dns_rdata_t **rdata) {
+	condensed_rrstream_t *s = (condensed_rrstream_t *)rs;
+
+	*name = &s->current->name;
+	*ttl = s->current->ttl;
+	*rdata = &s->current->rdata;
+}
+
+static void
+condensed_rrstream_destroy(rrstream_t **rsp) {
+	condensed_rrstream_t *s = (condensed_rrstream_t *)*rsp;
+
+	*rsp = NULL;
+	if (s->journal != NULL) {
+		s->journal->methods->destroy(&s->journal);
+		s->journal = NULL;
+	}
+	dns_diff_clear(&s->diff);
+	isc_mem_putanddetach(&s->common.mctx, s, sizeof(*s));
+}
+
+static rrstream_methods_t condensed_rrstream_methods = {
+	condensed_rrstream_first, condensed_rrstream_next,
+	condensed_rrstream_current, rrstream_noop_pause,
+	condensed_rrstream_destroy
+};
+
 /**************************************************************************/
 /*
  * An 'axfr_rrstream_t' is an 'rrstream_t' that returns
@@ -623,6 +878,174 @@ static rrstream_methods_t compound_rrstream_methods = {
 	compound_rrstream_destroy
 };
 
+/**************************************************************************/
+/*
+ * Cache of rendered zone transfer responses.
+ *
+ * The messages of an AXFR or IXFR response are recorded while it is
+ * sent, and further transfers of the same zone version (from the same
+ * serial, for IXFR) are answered by copying them, with the message ID
+ * patched in, instead of walking the database or reading the journal
+ * and compressing every message again.  Only responses that do not
+ * depend on the client are cached: many-answers over TCP, without TSIG
+ * and without EDNS.
+ */
+
+#define XFRCACHE_MAXENTRIES 16
+#define XFRCACHE_MAXIDLE    300 /*%< Seconds an unused entry is kept */
+
+typedef struct xfrcache_msg {
+	unsigned char *base;
+	unsigned int length;
+	unsigned int nrecs;
+} xfrcache_msg_t;
+
+typedef struct xfrcache_entry xfrcache_entry_t;
+struct xfrcache_entry {
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	bool complete; /*%< false while the response is being recorded */
+
+	/* What the messages were rendered from */
+	dns_db_t *db;
+	uint32_t serial;
+	bool ixfr;	       /*%< Incremental, from 'begin_serial' */
+	bool condensed;	       /*%< Net changes only */
+	uint32_t begin_serial;
+	dns_rdatatype_t qtype;
+	bool ra;
+	uint16_t msgsize;
+	unsigned int qnamelen;
+	unsigned char qname[DNS_NAME_MAXWIRE];
+
+	xfrcache_msg_t *msgs;
+	unsigned int nmsgs;
+	unsigned int allocated;
+	size_t size;
+	size_t maxsize;
+	isc_stdtime_t lastused;
+	ISC_LINK(xfrcache_entry_t) link;
+};
+
+struct ns_xfrcache {
+	isc_mem_t *mctx;
+	isc_mutex_t lock;
+	size_t maxsize;
+	size_t size; /*%< Of the complete entries */
+	unsigned int count;
+	ISC_LIST(xfrcache_entry_t) entries; /*%< Most recently used first */
+};
+
+static void
+xfrcache_detach(xfrcache_entry_t **entryp) {
+	xfrcache_entry_t *entry = *entryp;
+
+	*entryp = NULL;
+	if (isc_refcount_decrement(&entry->references) > 1) {
+		return;
+	}
+
+	isc_refcount_destroy(&entry->references);
+	for (unsigned int i = 0; i < entry->nmsgs; i++) {
+		isc_mem_put(entry->mctx, entry->msgs[i].base,
+			    entry->msgs[i].length);
+	}
+	if (entry->msgs != NULL) {
+		isc_mem_put(entry->mctx, entry->msgs,
+			    entry->allocated * sizeof(entry->msgs[0]));
+	}
+	dns_db_detach(&entry->db);
+	isc_mem_putanddetach(&entry->mctx, entry, sizeof(*entry));
+}
+
+/*
+ * Remove 'entry' from the cache.  Must be called with the cache lock
+ * held.
+ */
+static void
+xfrcache_unlink(ns_xfrcache_t *cache, xfrcache_entry_t *entry) {
+	ISC_LIST_UNLINK(cache->entries, entry, link);
+	cache->count--;
+	if (entry->complete) {
+		INSIST(cache->size >= entry->size);
+		cache->size -= entry->size;
+	}
+	xfrcache_detach(&entry);
+}
+
+/*
+ * Free complete entries that have been idle for too long, then the
+ * least recently used ones until there is room for 'entries' more
+ * entries and 'size' more bytes.  Must be called with the cache lock
+ * held.
+ */
+static void
+xfrcache_trim(ns_xfrcache_t *cache, unsigned int entries, size_t size,
+	      isc_stdtime_t now) {
+	xfrcache_entry_t *entry = NULL, *prev = NULL;
+
+	for (entry = ISC_LIST_TAIL(cache->entries); entry != NULL;
+	     entry = prev)
+	{
+		prev = ISC_LIST_PREV(entry, link);
+		if (!entry->complete) {
+			continue;
+		}
+		if (entry->lastused + XFRCACHE_MAXIDLE < now ||
+		    cache->count + entries > XFRCACHE_MAXENTRIES ||
+		    cache->size + size > cache->maxsize)
+		{
+			xfrcache_unlink(cache, entry);
+		}
+	}
+}
+
+void
+ns_xfrcache_create(isc_mem_t *mctx, ns_xfrcache_t **cachep) {
+	ns_xfrcache_t *cache = NULL;
+
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (ns_xfrcache_t){ .maxsize = 0 };
+	isc_mem_attach(mctx, &cache->mctx);
+	isc_mutex_init(&cache->lock);
+	ISC_LIST_INIT(cache->entries);
+
+	*cachep = cache;
+}
+
+void
+ns_xfrcache_destroy(ns_xfrcache_t **cachep) {
+	ns_xfrcache_t *cache = NULL;
+	xfrcache_entry_t *entry = NULL;
+
+	REQUIRE(cachep != NULL && *cachep != NULL);
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	while ((entry = ISC_LIST_HEAD(cache->entries)) != NULL) {
+		xfrcache_unlink(cache, entry);
+	}
+	isc_mutex_destroy(&cache->lock);
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+void
+ns_xfrcache_setmaxsize(ns_xfrcache_t *cache, size_t size) {
+	isc_stdtime_t now;
+
+	REQUIRE(cache != NULL);
+
+	isc_stdtime_get(&now);
+
+	LOCK(&cache->lock);
+	cache->maxsize = size;
+	xfrcache_trim(cache, 0, 0, now);
+	UNLOCK(&cache->lock);
+}
+
 /**************************************************************************/
 
 /*%
@@ -671,6 +1094,10 @@ typedef struct {
 	uint32_t end_serial;	/* Serial number after XFR is done */
 	struct xfr_stats stats; /*%< Transfer statistics */
 
+	xfrcache_entry_t *cached; /* Cached response being sent */
+	unsigned int cachedmsg;	  /* Next message of 'cached' */
+	xfrcache_entry_t *record; /* Response being recorded */
+
 	/* Timeouts */
 	uint64_t maxtime; /*%< Maximum XFR timeout (in ms) */
 	isc_nm_timer_t *maxtime_timer;
@@ -691,6 +1118,12 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
 static void
 sendstream(xfrout_ctx_t *xfr);
 
+static void
+sendcached(xfrout_ctx_t *xfr);
+
+static void
+sendmessage(xfrout_ctx_t *xfr, isc_region_t *used);
+
 static void
 xfrout_senddone(isc_nmhandle_t *handle, isc_result_t result, void *arg);
 
@@ -716,6 +1149,199 @@ xfrout_log(xfrout_ctx_t *xfr, int level, const char *fmt, ...)
 
 /**************************************************************************/
 
+/*
+ * Look up the response to 'xfr' in the transfer cache.  On a hit it is
+ * sent from there; otherwise, unless another transfer is already
+ * recording it, the response will be recorded as it is sent.  For an
+ * incremental response, 'ixfr' is true and 'begin_serial' is the
+ * serial it starts from.
+ */
+static void
+xfrcache_begin(xfrout_ctx_t *xfr, bool ixfr, bool condensed,
+	       uint32_t begin_serial) {
+	ns_client_t *client = xfr->client;
+	ns_xfrcache_t *cache = client->sctx->xfrcache;
+	xfrcache_entry_t *entry = NULL;
+	bool ra = ((client->attributes & NS_CLIENTATTR_RA) != 0);
+	uint16_t msgsize = client->sctx->transfer_tcp_message_size;
+	isc_stdtime_t now;
+
+	if ((client->attributes & NS_CLIENTATTR_TCP) == 0 ||
+	    (client->attributes & NS_CLIENTATTR_WANTOPT) != 0 ||
+	    xfr->tsigkey != NULL || !xfr->many_answers ||
+	    ns_server_getoption(client->sctx, NS_SERVER_TRANSFERSLOWLY) ||
+	    ns_server_getoption(client->sctx, NS_SERVER_TRANSFERSTUCK))
+	{
+		return;
+	}
+
+	isc_stdtime_get(&now);
+
+	LOCK(&cache->lock);
+	if (cache->maxsize == 0) {
+		goto unlock;
+	}
+
+	xfrcache_trim(cache, 0, 0, now);
+	for (entry = ISC_LIST_HEAD(cache->entries); entry != NULL;
+	     entry = ISC_LIST_NEXT(entry, link))
+	{
+		if (entry->db == xfr->db && entry->serial == xfr->end_serial &&
+		    entry->ixfr == ixfr && entry->condensed == condensed &&
+		    (!ixfr || entry->begin_serial == begin_serial) &&
+		    entry->qtype == xfr->qtype && entry->ra == ra &&
+		    entry->msgsize == msgsize &&
+		    entry->qnamelen == xfr->qname->length &&
+		    memcmp(entry->qname, xfr->qname->ndata,
+			   entry->qnamelen) == 0)
+		{
+			break;
+		}
+	}
+
+	if (entry != NULL) {
+		if (entry->complete) {
+			isc_refcount_increment(&entry->references);
+			entry->lastused = now;
+			ISC_LIST_UNLINK(cache->entries, entry, link);
+			ISC_LIST_PREPEND(cache->entries, entry, link);
+			xfr->cached = entry;
+		}
+		goto unlock;
+	}
+
+	xfrcache_trim(cache, 1, 0, now);
+	if (cache->count >= XFRCACHE_MAXENTRIES) {
+		goto unlock;
+	}
+
+	entry = isc_mem_get(cache->mctx, sizeof(*entry));
+	*entry = (xfrcache_entry_t){
+		.serial = xfr->end_serial,
+		.ixfr = ixfr,
+		.condensed = condensed,
+		.begin_serial = begin_serial,
+		.qtype = xfr->qtype,
+		.ra = ra,
+		.msgsize = msgsize,
+		.qnamelen = xfr->qname->length,
+		.maxsize = cache->maxsize,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	isc_mem_attach(cache->mctx, &entry->mctx);
+	isc_refcount_init(&entry->references, 2);
+	dns_db_attach(xfr->db, &entry->db);
+	memmove(entry->qname, xfr->qname->ndata, entry->qnamelen);
+	ISC_LIST_PREPEND(cache->entries, entry, link);
+	cache->count++;
+	xfr->record = entry;
+
+unlock:
+	UNLOCK(&cache->lock);
+
+	if (xfr->cached != NULL) {
+		inc_stats(client, xfr->zone, ns_statscounter_xfrcached);
+		xfrout_log(xfr, ISC_LOG_DEBUG(1),
+			   "sending %u cached messages", xfr->cached->nmsgs);
+	}
+}
+
+/*
+ * Stop recording, and drop the incomplete entry.
+ */
+static void
+xfrcache_abort(xfrout_ctx_t *xfr) {
+	ns_xfrcache_t *cache = xfr->client->sctx->xfrcache;
+
+	LOCK(&cache->lock);
+	if (ISC_LINK_LINKED(xfr->record, link)) {
+		xfrcache_unlink(cache, xfr->record);
+	}
+	UNLOCK(&cache->lock);
+	xfrcache_detach(&xfr->record);
+}
+
+/*
+ * Add a copy of a message that has been rendered for sending to the
+ * response being recorded.
+ */
+static void
+xfrcache_record(xfrout_ctx_t *xfr, isc_region_t *r, unsigned int nrecs) {
+	xfrcache_entry_t *entry = xfr->record;
+	xfrcache_msg_t *msg = NULL;
+
+	if (entry->size + r->length > entry->maxsize) {
+		xfrcache_abort(xfr);
+		return;
+	}
+
+	if (entry->nmsgs == entry->allocated) {
+		unsigned int allocated = ISC_MAX(16, entry->allocated * 2);
+		xfrcache_msg_t *msgs = isc_mem_get(
+			entry->mctx, allocated * sizeof(msgs[0]));
+		if (entry->msgs != NULL) {
+			memmove(msgs, entry->msgs,
+				entry->nmsgs * sizeof(msgs[0]));
+			isc_mem_put(entry->mctx, entry->msgs,
+				    entry->allocated * sizeof(msgs[0]));
+		}
+		entry->msgs = msgs;
+		entry->allocated = allocated;
+	}
+
+	msg = &entry->msgs[entry->nmsgs++];
+	msg->base = isc_mem_get(entry->mctx, r->length);
+	msg->length = r->length;
+	msg->nrecs = nrecs;
+	memmove(msg->base, r->base, r->length);
+	entry->size += r->length;
+}
+
+/*
+ * The recorded response has been sent completely; make it available
+ * to further transfers, replacing older versions of the zone.
+ */
+static void
+xfrcache_end(xfrout_ctx_t *xfr) {
+	ns_xfrcache_t *cache = xfr->client->sctx->xfrcache;
+	xfrcache_entry_t *entry = xfr->record, *next = NULL;
+	isc_stdtime_t now;
+
+	isc_stdtime_get(&now);
+
+	LOCK(&cache->lock);
+	if (!ISC_LINK_LINKED(entry, link)) {
+		goto unlock;
+	}
+
+	for (xfrcache_entry_t *e = ISC_LIST_HEAD(cache->entries); e != NULL;
+	     e = next)
+	{
+		next = ISC_LIST_NEXT(e, link);
+		if (e->complete && e->db == entry->db &&
+		    e->serial != entry->serial)
+		{
+			xfrcache_unlink(cache, e);
+		}
+	}
+
+	xfrcache_trim(cache, 0, entry->size, now);
+	if (cache->size + entry->size > cache->maxsize) {
+		xfrcache_unlink(cache, entry);
+		goto unlock;
+	}
+
+	entry->complete = true;
+	entry->lastused = now;
+	cache->size += entry->size;
+
+unlock:
+	UNLOCK(&cache->lock);
+	xfrcache_detach(&xfr->record);
+}
+
+/**************************************************************************/
+
 void
 ns_xfr_start(ns_client_t *client, dns_rdatatype_t reqtype) {
 	isc_result_t result;
@@ -749,6 +1375,7 @@ ns_xfr_start(ns_client_t *client, dns_rdatatype_t reqtype) {
 	bool is_dlz = false;
 	bool is_ixfr = false;
 	bool useviewacl = false;
+	bool condense = false;
 	uint32_t begin_serial = 0, current_serial;
 
 	switch (reqtype) {
@@ -1063,6 +1690,17 @@ got_soa:
 					    jsize, dbsize);
 			}
 		}
+		if ((dns_zone_getoptions(zone) & DNS_ZONEOPT_CONDENSEIXFR) !=
+		    0)
+		{
+			rrstream_t *journal_stream = data_stream;
+
+			data_stream = NULL;
+			condensed_rrstream_create(mctx, &journal_stream,
+						  &data_stream);
+			mnemonic = "condensed IXFR";
+			condense = true;
+		}
 		is_ixfr = true;
 	} else {
 	axfr_fallback:
@@ -1107,7 +1745,12 @@ have_stream:
 	stream = NULL;
 	quota = NULL;
 
-	CHECK(xfr->stream->methods->first(xfr->stream));
+	if (!is_poll && !is_dlz) {
+		xfrcache_begin(xfr, is_ixfr, condense, begin_serial);
+	}
+	if (xfr->cached == NULL) {
+		CHECK(xfr->stream->methods->first(xfr->stream));
+	}
 
 	if (xfr->tsigkey != NULL) {
 		dns_name_format(&xfr->tsigkey->name, keyname, sizeof(keyname));
@@ -1306,10 +1949,19 @@ sendstream(xfrout_ctx_t *xfr) {
 	dns_rdata_t *msgrdata = NULL;
 	dns_rdatalist_t *msgrdl = NULL;
 	dns_rdataset_t *msgrds = NULL;
+	dns_name_t *lastname = NULL;
+	dns_rdatalist_t *lastrdl = NULL;
 	dns_compress_t cctx;
 	bool cleanup_cctx = false;
 	bool is_tcp;
 	int n_rrs;
+	unsigned int used;
+	uint64_t nrecs = xfr->stats.nrecs;
+
+	if (xfr->cached != NULL) {
+		sendcached(xfr);
+		return;
+	}
 
 	isc_buffer_clear(&xfr->buf);
 	isc_buffer_clear(&xfr->txbuf);
@@ -1326,9 +1978,9 @@ sendstream(xfrout_ctx_t *xfr) {
 		/*
 		 * TCP. Build a response dns_message_t, temporarily storing
 		 * the raw, uncompressed owner names and RR data contiguously
-		 * in xfr->buf.  We know that if the uncompressed data fits
-		 * in xfr->buf, the compressed data will surely fit in a TCP
-		 * message.
+		 * in xfr->buf.  We know that if the uncompressed size of the
+		 * data fits in xfr->buf, the compressed data will surely fit
+		 * in a TCP message.
 		 */
 
 		dns_message_create(xfr->mctx, DNS_MESSAGE_INTENTRENDER,
@@ -1421,8 +2073,12 @@ sendstream(xfrout_ctx_t *xfr) {
 
 	/*
 	 * Try to fit in as many RRs as possible, unless "one-answer"
-	 * format has been requested.
+	 * format has been requested.  'used' is the uncompressed size of
+	 * the message so far, which decides where messages end; it can be
+	 * more than what xfr->buf holds, as consecutive RRs of an RRset
+	 * share their owner name.
 	 */
+	used = isc_buffer_usedlength(&xfr->buf);
 	for (n_rrs = 0;; n_rrs++) {
 		dns_name_t *name = NULL;
 		uint32_t ttl;
@@ -1438,8 +2094,7 @@ sendstream(xfrout_ctx_t *xfr) {
 
 		xfr->stream->methods->current(xfr->stream, &name, &ttl, &rdata);
 		size = name->length + 10 + rdata->length;
-		isc_buffer_availableregion(&xfr->buf, &r);
-		if (size >= r.length) {
+		if (size >= xfr->buf.length - used) {
 			/*
 			 * RR would not fit.  If there are other RRs in the
 			 * buffer, send them now and leave this RR to the
@@ -1467,6 +2122,37 @@ sendstream(xfrout_ctx_t *xfr) {
 		if (isc_log_wouldlog(ns_lctx, XFROUT_RR_LOGLEVEL)) {
 			log_rr(name, rdata, ttl); /* XXX */
 		}
+		used += size;
+
+		/*
+		 * An RR with the same owner name (in the same case), type
+		 * and TTL as the previous one is added to its rdataset,
+		 * rather than getting a name and rdataset of its own.  SOA
+		 * records delimit transfers and are kept apart.
+		 */
+		if (lastrdl != NULL && rdata->type != dns_rdatatype_soa &&
+		    rdata->type == lastrdl->type &&
+		    rdata->rdclass == lastrdl->rdclass &&
+		    ttl == lastrdl->ttl && name->length == lastname->length &&
+		    memcmp(name->ndata, lastname->ndata, name->length) == 0 &&
+		    (lastrdl->covers == dns_rdatatype_none ||
+		     dns_rdata_covers(rdata) == lastrdl->covers))
+		{
+			result = dns_message_gettemprdata(msg, &msgrdata);
+			if (result != ISC_R_SUCCESS) {
+				goto failure;
+			}
+			isc_buffer_availableregion(&xfr->buf, &r);
+			r.length = rdata->length;
+			isc_buffer_putmem(&xfr->buf, rdata->data,
+					  rdata->length);
+			dns_rdata_init(msgrdata);
+			dns_rdata_fromregion(msgrdata, rdata->rdclass,
+					     rdata->type, &r);
+			ISC_LIST_APPEND(lastrdl->rdata, msgrdata, link);
+			msgrdata = NULL;
+			goto next;
+		}
 
 		result = dns_message_gettempname(msg, &msgname);
 		if (result != ISC_R_SUCCESS) {
@@ -1478,9 +2164,6 @@ sendstream(xfrout_ctx_t *xfr) {
 		isc_buffer_putmem(&xfr->buf, name->ndata, name->length);
 		dns_name_fromregion(msgname, &r);
 
-		/* Reserve space for RR header. */
-		isc_buffer_add(&xfr->buf, 10);
-
 		result = dns_message_gettemprdata(msg, &msgrdata);
 		if (result != ISC_R_SUCCESS) {
 			goto failure;
@@ -1517,8 +2200,11 @@ sendstream(xfrout_ctx_t *xfr) {
 		ISC_LIST_APPEND(msgname->list, msgrds, link);
 
 		dns_message_addname(msg, msgname, DNS_SECTION_ANSWER);
+		lastname = msgname;
+		lastrdl = msgrdl;
 		msgname = NULL;
 
+	next:
 		xfr->stats.nrecs++;
 
 		result = xfr->stream->methods->next(xfr->stream);
@@ -1536,8 +2222,7 @@ sendstream(xfrout_ctx_t *xfr) {
 		 * the message. Check if we want to clamp this message
 		 * here (TCP only).
 		 */
-		if ((isc_buffer_usedlength(&xfr->buf) >=
-		     xfr->client->sctx->transfer_tcp_message_size) &&
+		if (used >= xfr->client->sctx->transfer_tcp_message_size &&
 		    is_tcp)
 		{
 			break;
@@ -1558,35 +2243,12 @@ sendstream(xfrout_ctx_t *xfr) {
 
 		isc_buffer_usedregion(&xfr->txbuf, &used);
 
-		xfrout_log(xfr, ISC_LOG_DEBUG(8),
-			   "sending TCP message of %d bytes", used.length);
-
-		/* System test helper options to simulate network issues. */
-		if (ns_server_getoption(xfr->client->manager->sctx,
-					NS_SERVER_TRANSFERSLOWLY))
-		{
-			/* Sleep for a bit over a second. */
-			select(0, NULL, NULL, NULL,
-			       &(struct timeval){ 1, 1000 });
-		}
-		if (ns_server_getoption(xfr->client->manager->sctx,
-					NS_SERVER_TRANSFERSTUCK))
-		{
-			/* Sleep for a bit over a minute. */
-			select(0, NULL, NULL, NULL,
-			       &(struct timeval){ 60, 1000 });
+		if (xfr->record != NULL) {
+			nrecs = xfr->stats.nrecs - nrecs;
+			xfrcache_record(xfr, &used, (unsigned int)nrecs);
 		}
 
-		isc_nmhandle_attach(xfr->client->handle,
-				    &xfr->client->sendhandle);
-		if (xfr->idletime > 0) {
-			isc_nmhandle_setwritetimeout(xfr->client->sendhandle,
-						     xfr->idletime);
-		}
-		isc_nm_send(xfr->client->sendhandle, &used, xfrout_senddone,
-			    xfr);
-		xfr->sends++;
-		xfr->cbytes = used.length;
+		sendmessage(xfr, &used);
 	} else {
 		xfrout_log(xfr, ISC_LOG_DEBUG(8), "sending IXFR UDP response");
 
@@ -1658,6 +2320,62 @@ failure:
 	xfrout_fail(xfr, result, "sending zone data");
 }
 
+/*
+ * Send the next message of a cached response.
+ */
+static void
+sendcached(xfrout_ctx_t *xfr) {
+	xfrcache_msg_t *cmsg = &xfr->cached->msgs[xfr->cachedmsg++];
+	isc_region_t used;
+
+	isc_buffer_clear(&xfr->txbuf);
+	isc_buffer_putmem(&xfr->txbuf, cmsg->base, cmsg->length);
+	isc_buffer_usedregion(&xfr->txbuf, &used);
+
+	/* The cached message carries the ID of the transfer it came from */
+	used.base[0] = (xfr->id >> 8) & 0xff;
+	used.base[1] = xfr->id & 0xff;
+
+	xfr->stats.nrecs += cmsg->nrecs;
+	if (xfr->cachedmsg == xfr->cached->nmsgs) {
+		xfr->end_of_stream = true;
+	}
+
+	sendmessage(xfr, &used);
+}
+
+/*
+ * Send a rendered TCP message.
+ */
+static void
+sendmessage(xfrout_ctx_t *xfr, isc_region_t *used) {
+	xfrout_log(xfr, ISC_LOG_DEBUG(8), "sending TCP message of %d bytes",
+		   used->length);
+
+	/* System test helper options to simulate network issues. */
+	if (ns_server_getoption(xfr->client->manager->sctx,
+				NS_SERVER_TRANSFERSLOWLY))
+	{
+		/* Sleep for a bit over a second. */
+		select(0, NULL, NULL, NULL, &(struct timeval){ 1, 1000 });
+	}
+	if (ns_server_getoption(xfr->client->manager->sctx,
+				NS_SERVER_TRANSFERSTUCK))
+	{
+		/* Sleep for a bit over a minute. */
+		select(0, NULL, NULL, NULL, &(struct timeval){ 60, 1000 });
+	}
+
+	isc_nmhandle_attach(xfr->client->handle, &xfr->client->sendhandle);
+	if (xfr->idletime > 0) {
+		isc_nmhandle_setwritetimeout(xfr->client->sendhandle,
+					     xfr->idletime);
+	}
+	isc_nm_send(xfr->client->sendhandle, used, xfrout_senddone, xfr);
+	xfr->sends++;
+	xfr->cbytes = used->length;
+}
+
 static void
 xfrout_ctx_destroy(xfrout_ctx_t **xfrp) {
 	xfrout_ctx_t *xfr = *xfrp;
@@ -1671,6 +2389,12 @@ xfrout_ctx_destroy(xfrout_ctx_t **xfrp) {
 	if (xfr->stream != NULL) {
 		xfr->stream->methods->destroy(&xfr->stream);
 	}
+	if (xfr->record != NULL) {
+		xfrcache_abort(xfr);
+	}
+	if (xfr->cached != NULL) {
+		xfrcache_detach(&xfr->cached);
+	}
 	if (xfr->buf.base != NULL) {
 		isc_mem_put(xfr->mctx, xfr->buf.base, xfr->buf.length);
 	}
@@ -1728,6 +2452,10 @@ xfrout_senddone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 		/* End of zone transfer stream. */
 		uint64_t msecs, persec;
 
+		if (xfr->record != NULL) {
+			xfrcache_end(xfr);
+		}
+
 		inc_stats(xfr->client, xfr->zone, ns_statscounter_xfrdone);
 		isc_time_now(&xfr->stats.end);
 		msecs = isc_time_microdiff(&xfr->stats.end, &xfr->stats.start);
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <isc/commandline.h>
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/print.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include "bench.h"
+
+#define MAXTHREADS 128
+
+isc_mem_t *mctx = NULL;
+size_t bench_ops = 1000000;
+size_t bench_threads = 0;
+
+static char **names = NULL;
+static int nnames = 0;
+
+typedef struct bench_thread {
+	bench_func_t func;
+	void *arg;
+	size_t tid;
+	size_t ops;
+} bench_thread_t;
+
+static void
+usage(const char *progname) {
+	fprintf(stderr, "usage: %s [-n ops] [-t threads] [benchmark...]\n",
+		progname);
+	exit(1);
+}
+
+void
+bench_init(int argc, char **argv) {
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "n:t:")) != -1) {
+		switch (ch) {
+		case 'n':
+			bench_ops = strtoul(isc_commandline_argument, NULL, 10);
+			break;
+		case 't':
+			bench_threads = strtoul(isc_commandline_argument, NULL,
+						10);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (bench_ops == 0 || bench_threads > MAXTHREADS) {
+		usage(argv[0]);
+	}
+	if (bench_threads == 0) {
+		bench_threads = ISC_MIN(isc_os_ncpus(), MAXTHREADS);
+	}
+
+	names = argv + isc_commandline_index;
+	nnames = argc - isc_commandline_index;
+
+	isc_mem_create(&mctx);
+}
+
+bool
+bench_wanted(const char *name) {
+	if (nnames == 0) {
+		return (true);
+	}
+	for (int i = 0; i < nnames; i++) {
+		if (strcmp(names[i], name) == 0) {
+			return (true);
+		}
+	}
+	return (false);
+}
+
+uint64_t
+bench_now(void) {
+	struct timespec ts;
+
+	RUNTIME_CHECK(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+void
+bench_report(const char *name, size_t nthreads, uint64_t ops,
+	     uint64_t nsecs) {
+	printf("{\"benchmark\":\"%s\",\"threads\":%zu,\"ops\":%" PRIu64
+	       ",\"nsecs\":%" PRIu64 ",\"ns_per_op\":%.2f,"
+	       "\"ops_per_sec\":%.0f}\n",
+	       name, nthreads, ops, nsecs, (double)nsecs / ops,
+	       nsecs == 0 ? 0.0 : ops * 1e9 / nsecs);
+	fflush(stdout);
+}
+
+static isc_threadresult_t
+bench_thread(isc_threadarg_t arg) {
+	bench_thread_t *thread = arg;
+
+	thread->func(thread->arg, thread->tid, thread->ops);
+
+	return ((isc_threadresult_t)0);
+}
+
+void
+bench_run(const char *name, size_t nthreads, size_t ops, bench_func_t func,
+	  void *arg) {
+	isc_thread_t threads[MAXTHREADS];
+	bench_thread_t args[MAXTHREADS];
+	uint64_t start;
+
+	REQUIRE(nthreads > 0 && nthreads <= MAXTHREADS);
+
+	if (!bench_wanted(name)) {
+		return;
+	}
+
+	start = bench_now();
+	if (nthreads == 1) {
+		func(arg, 0, ops);
+	} else {
+		for (size_t i = 0; i < nthreads; i++) {
+			args[i] = (bench_thread_t){ .func = func,
+						    .arg = arg,
+						    .tid = i,
+						    .ops = ops };
+			isc_thread_create(bench_thread, &args[i], &threads[i]);
+		}
+		for (size_t i = 0; i < nthreads; i++) {
+			isc_thread_join(threads[i], NULL);
+		}
+	}
+	bench_report(name, nthreads, (uint64_t)ops * nthreads,
+		     bench_now() - start);
+}
+
+void
+bench_shutdown(void) {
+	isc_mem_destroy(&mctx);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file
+ * \brief
+ * Common code of the micro-benchmarks.
+ *
+ * Each result is printed to stdout as one line of JSON:
+ *
+ *\code
+ * {"benchmark":"isc_ht_find","threads":1,"ops":1000000,"nsecs":31536415,
+ *  "ns_per_op":31.54,"ops_per_sec":31709581}
+ *\endcode
+ *
+ * where 'ops' is the total over all threads, so that the output of two
+ * releases can be compared line by line.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <isc/mem.h>
+
+/*%
+ * A benchmark body: do 'ops' operations as thread number 'tid'.
+ */
+typedef void (*bench_func_t)(void *arg, size_t tid, size_t ops);
+
+extern isc_mem_t *mctx;
+
+/*%
+ * Operations per thread and the number of threads of the concurrent
+ * benchmarks, set from the command line by bench_init().
+ */
+extern size_t bench_ops;
+extern size_t bench_threads;
+
+void
+bench_init(int argc, char **argv);
+/*%<
+ * Parse the command line ("-n ops", "-t threads" and benchmark names)
+ * and create 'mctx'.
+ */
+
+bool
+bench_wanted(const char *name);
+/*%<
+ * Return true if 'name' was given on the command line, or if no names
+ * were given.
+ */
+
+uint64_t
+bench_now(void);
+/*%<
+ * Return a monotonic time in nanoseconds.
+ */
+
+void
+bench_report(const char *name, size_t nthreads, uint64_t ops,
+	     uint64_t nsecs);
+/*%<
+ * Print the result of benchmark 'name'.
+ */
+
+void
+bench_run(const char *name, size_t nthreads, size_t ops, bench_func_t func,
+	  void *arg);
+/*%<
+ * Unless bench_wanted(name) is false, run 'func' in 'nthreads' threads
+ * at once, each doing 'ops' operations, and report the time from the
+ * start of the first thread to the end of the last one.
+ */
+
+void
+bench_shutdown(void);
+/*%<
+ * Destroy 'mctx'.
+ */
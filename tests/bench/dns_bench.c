@@ -0,0 +1,363 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file
+ * \brief
+ * Micro-benchmarks of libdns: names, the red-black tree, the cache
+ * database, and message parsing, rendering and compression.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/result.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rbt.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include "bench.h"
+
+#define NAMES 4096
+
+static dns_fixedname_t fnames[NAMES];
+static dns_name_t *names[NAMES];
+
+/*
+ * A response to "www.example.com/A" with a CNAME, two NS records and
+ * their glue, all compressed.
+ */
+static unsigned char response[] = {
+	0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x02, 0x00, 0x02, 0x00, 0x02,
+	0x03, 0x77, 0x77, 0x77, 0x07, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65,
+	0x03, 0x63, 0x6f, 0x6d, 0x00, 0x00, 0x01, 0x00, 0x01, 0xc0, 0x0c, 0x00,
+	0x05, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2c, 0x00, 0x06, 0x03, 0x77, 0x65,
+	0x62, 0xc0, 0x10, 0xc0, 0x2d, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x01,
+	0x2c, 0x00, 0x04, 0xc0, 0x00, 0x02, 0x01, 0xc0, 0x10, 0x00, 0x02, 0x00,
+	0x01, 0x00, 0x00, 0x01, 0x2c, 0x00, 0x06, 0x03, 0x6e, 0x73, 0x31, 0xc0,
+	0x10, 0xc0, 0x10, 0x00, 0x02, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2c, 0x00,
+	0x06, 0x03, 0x6e, 0x73, 0x32, 0xc0, 0x10, 0xc0, 0x4f, 0x00, 0x01, 0x00,
+	0x01, 0x00, 0x00, 0x01, 0x2c, 0x00, 0x04, 0xc0, 0x00, 0x02, 0x35, 0xc0,
+	0x61, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2c, 0x00, 0x04, 0xc0,
+	0x00, 0x02, 0x36,
+};
+
+static void
+init_names(void) {
+	for (size_t i = 0; i < NAMES; i++) {
+		char text[64];
+
+		snprintf(text, sizeof(text), "host%zu.zone%zu.example.", i,
+			 i % 64);
+		names[i] = dns_fixedname_initname(&fnames[i]);
+		RUNTIME_CHECK(dns_name_fromstring(names[i], text, 0, NULL) ==
+			      ISC_R_SUCCESS);
+	}
+}
+
+/*
+ * dns_name
+ */
+
+static void
+name_fullcompare(void *arg, size_t tid, size_t ops) {
+	UNUSED(arg);
+	UNUSED(tid);
+
+	for (size_t i = 0; i < ops; i++) {
+		unsigned int nlabels;
+		int order;
+
+		(void)dns_name_fullcompare(names[i % NAMES],
+					   names[(i * 7 + 1) % NAMES], &order,
+					   &nlabels);
+	}
+}
+
+static void
+name_hash(void *arg, size_t tid, size_t ops) {
+	UNUSED(arg);
+	UNUSED(tid);
+
+	for (size_t i = 0; i < ops; i++) {
+		(void)dns_name_hash(names[i % NAMES], false);
+	}
+}
+
+/*
+ * dns_rbt
+ */
+
+static void
+rbt_findname(void *arg, size_t tid, size_t ops) {
+	dns_rbt_t *rbt = arg;
+	dns_fixedname_t ffound;
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+
+	UNUSED(tid);
+
+	for (size_t i = 0; i < ops; i++) {
+		void *data = NULL;
+
+		RUNTIME_CHECK(dns_rbt_findname(rbt, names[(i * 7) % NAMES], 0,
+					       found, &data) == ISC_R_SUCCESS);
+	}
+}
+
+static void
+bench_rbt(void) {
+	dns_rbt_t *rbt = NULL;
+
+	RUNTIME_CHECK(dns_rbt_create(mctx, NULL, NULL, &rbt) == ISC_R_SUCCESS);
+	for (size_t i = 0; i < NAMES; i++) {
+		RUNTIME_CHECK(dns_rbt_addname(rbt, names[i], names[i]) ==
+			      ISC_R_SUCCESS);
+	}
+
+	bench_run("dns_rbt_findname", 1, bench_ops, rbt_findname, rbt);
+
+	dns_rbt_destroy(&rbt);
+}
+
+/*
+ * The cache database
+ */
+
+typedef struct db_arg {
+	dns_db_t *db;
+	isc_stdtime_t now;
+	unsigned int adds; /* per 100 */
+} db_arg_t;
+
+static void
+db_add(db_arg_t *arg, const dns_name_t *name, unsigned char last) {
+	unsigned char data[4] = { 192, 0, 2, last };
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_region_t region = { data, sizeof(data) };
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_a,
+			     &region);
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 300;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	RUNTIME_CHECK(dns_rdatalist_tordataset(&rdatalist, &rdataset) ==
+		      ISC_R_SUCCESS);
+
+	RUNTIME_CHECK(dns_db_findnode(arg->db, name, true, &node) ==
+		      ISC_R_SUCCESS);
+	result = dns_db_addrdataset(arg->db, node, NULL, arg->now, &rdataset,
+				    0, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS || result == DNS_R_UNCHANGED);
+	dns_db_detachnode(arg->db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static void
+db_find(db_arg_t *arg, const dns_name_t *name) {
+	dns_fixedname_t ffound;
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(arg->db, name, NULL, dns_rdatatype_a, 0,
+			     arg->now, &node, found, &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (node != NULL) {
+		dns_db_detachnode(arg->db, &node);
+	}
+	UNUSED(result);
+}
+
+static void
+db_mixed(void *varg, size_t tid, size_t ops) {
+	db_arg_t *arg = varg;
+
+	for (size_t i = 0; i < ops; i++) {
+		const dns_name_t *name = names[(i * 7 + tid * 613) % NAMES];
+
+		if (i % 100 < arg->adds) {
+			db_add(arg, name, i & 0xff);
+		} else {
+			db_find(arg, name);
+		}
+	}
+}
+
+static void
+bench_db(void) {
+	db_arg_t arg = { .adds = 100 };
+
+	RUNTIME_CHECK(dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+				    dns_rdataclass_in, 0, NULL,
+				    &arg.db) == ISC_R_SUCCESS);
+	isc_stdtime_get(&arg.now);
+
+	bench_run("dns_db_add", 1, bench_ops, db_mixed, &arg);
+	bench_run("dns_db_add_mt", bench_threads, bench_ops, db_mixed, &arg);
+	arg.adds = 0;
+	bench_run("dns_db_find", 1, bench_ops, db_mixed, &arg);
+	bench_run("dns_db_find_mt", bench_threads, bench_ops, db_mixed, &arg);
+	arg.adds = 10;
+	bench_run("dns_db_find90_mt", bench_threads, bench_ops, db_mixed,
+		  &arg);
+
+	dns_db_detach(&arg.db);
+}
+
+/*
+ * dns_message
+ */
+
+static void
+message_parse(void *arg, size_t tid, size_t ops) {
+	UNUSED(arg);
+	UNUSED(tid);
+
+	for (size_t i = 0; i < ops; i++) {
+		dns_message_t *message = NULL;
+		isc_buffer_t source;
+
+		isc_buffer_init(&source, response, sizeof(response));
+		isc_buffer_add(&source, sizeof(response));
+
+		dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &message);
+		RUNTIME_CHECK(dns_message_parse(message, &source, 0) ==
+			      ISC_R_SUCCESS);
+		dns_message_detach(&message);
+	}
+}
+
+static void
+message_render(void *arg, size_t tid, size_t ops) {
+	dns_message_t *message = arg;
+	unsigned char data[512];
+
+	UNUSED(tid);
+
+	for (size_t i = 0; i < ops; i++) {
+		dns_compress_t cctx;
+		isc_buffer_t target;
+
+		isc_buffer_init(&target, data, sizeof(data));
+		RUNTIME_CHECK(dns_compress_init(&cctx, -1, mctx) ==
+			      ISC_R_SUCCESS);
+		RUNTIME_CHECK(dns_message_renderbegin(message, &cctx,
+						      &target) ==
+			      ISC_R_SUCCESS);
+		for (dns_section_t section = DNS_SECTION_QUESTION;
+		     section < DNS_SECTION_MAX; section++)
+		{
+			RUNTIME_CHECK(dns_message_rendersection(message,
+								section, 0) ==
+				      ISC_R_SUCCESS);
+		}
+		RUNTIME_CHECK(dns_message_renderend(message) == ISC_R_SUCCESS);
+		dns_message_renderreset(message);
+		dns_compress_invalidate(&cctx);
+	}
+}
+
+static void
+bench_message(void) {
+	dns_message_t *message = NULL;
+	isc_buffer_t source;
+
+	bench_run("dns_message_parse", 1, bench_ops, message_parse, NULL);
+
+	/*
+	 * Render a parsed message, the same way as bin/tests/wire_test.
+	 */
+	isc_buffer_init(&source, response, sizeof(response));
+	isc_buffer_add(&source, sizeof(response));
+	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &message);
+	RUNTIME_CHECK(dns_message_parse(message, &source, 0) == ISC_R_SUCCESS);
+	message->from_to_wire = DNS_MESSAGE_INTENTRENDER;
+	for (size_t i = 0; i < DNS_SECTION_MAX; i++) {
+		message->counts[i] = 0;
+	}
+
+	bench_run("dns_message_render", 1, bench_ops, message_render, message);
+
+	message->from_to_wire = DNS_MESSAGE_INTENTPARSE;
+	dns_message_detach(&message);
+}
+
+/*
+ * Name compression
+ */
+
+static void
+name_towire(void *arg, size_t tid, size_t ops) {
+	unsigned char data[4096];
+
+	UNUSED(arg);
+	UNUSED(tid);
+
+	for (size_t i = 0; i < ops; i += 16) {
+		dns_compress_t cctx;
+		isc_buffer_t target;
+
+		isc_buffer_init(&target, data, sizeof(data));
+		RUNTIME_CHECK(dns_compress_init(&cctx, -1, mctx) ==
+			      ISC_R_SUCCESS);
+		dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+		for (size_t j = 0; j < 16; j++) {
+			RUNTIME_CHECK(dns_name_towire(names[(i + j) % NAMES],
+						      &cctx, &target) ==
+				      ISC_R_SUCCESS);
+		}
+		dns_compress_invalidate(&cctx);
+	}
+}
+
+int
+main(int argc, char **argv) {
+	bench_init(argc, argv);
+	init_names();
+
+	bench_run("dns_name_fullcompare", 1, bench_ops, name_fullcompare,
+		  NULL);
+	bench_run("dns_name_hash", 1, bench_ops, name_hash, NULL);
+	bench_rbt();
+	bench_db();
+	bench_message();
+	bench_run("dns_name_towire", 1, bench_ops, name_towire, NULL);
+
+	bench_shutdown();
+
+	return (0);
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file
+ * \brief
+ * Micro-benchmarks of libisc: isc_ht, isc_radix, isc_mem and isc_rwlock.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/ht.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/radix.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/rwlock.h>
+#include <isc/util.h>
+
+#include "bench.h"
+
+#define HT_KEYS	      (1 << 16)
+#define RADIX_PREFIXES 10000
+
+/*
+ * isc_ht
+ */
+
+static void
+ht_add(void *arg, size_t tid, size_t ops) {
+	isc_ht_t *ht = NULL;
+
+	UNUSED(arg);
+	UNUSED(tid);
+
+	for (size_t done = 0; done < ops; done += HT_KEYS) {
+		isc_ht_init(&ht, mctx, 1, ISC_HT_CASE_SENSITIVE);
+		for (uint64_t i = 0; i < HT_KEYS && done + i < ops; i++) {
+			RUNTIME_CHECK(isc_ht_add(ht, (unsigned char *)&i,
+						 sizeof(i),
+						 NULL) == ISC_R_SUCCESS);
+		}
+		isc_ht_destroy(&ht);
+	}
+}
+
+static void
+ht_find(void *arg, size_t tid, size_t ops) {
+	isc_ht_t *ht = arg;
+
+	UNUSED(tid);
+
+	for (size_t i = 0; i < ops; i++) {
+		uint64_t key = i % (2 * HT_KEYS);
+		void *value = NULL;
+
+		(void)isc_ht_find(ht, (unsigned char *)&key, sizeof(key),
+				  &value);
+	}
+}
+
+static void
+bench_ht(void) {
+	isc_ht_t *ht = NULL;
+
+	bench_run("isc_ht_add", 1, bench_ops, ht_add, NULL);
+
+	/* Half of the lookups are for keys which are not there. */
+	isc_ht_init(&ht, mctx, 1, ISC_HT_CASE_SENSITIVE);
+	for (uint64_t i = 0; i < HT_KEYS; i++) {
+		RUNTIME_CHECK(isc_ht_add(ht, (unsigned char *)&i, sizeof(i),
+					 NULL) == ISC_R_SUCCESS);
+	}
+	bench_run("isc_ht_find", 1, bench_ops, ht_find, ht);
+	isc_ht_destroy(&ht);
+}
+
+/*
+ * isc_radix
+ */
+
+static void
+radix_search(void *arg, size_t tid, size_t ops) {
+	isc_radix_tree_t *radix = arg;
+
+	UNUSED(tid);
+
+	for (size_t i = 0; i < ops; i++) {
+		isc_radix_node_t *node = NULL;
+		struct in_addr ina = { .s_addr = isc_random32() };
+		isc_netaddr_t netaddr;
+		isc_prefix_t prefix;
+
+		isc_netaddr_fromin(&netaddr, &ina);
+		NETADDR_TO_PREFIX_T(&netaddr, prefix, 32);
+		(void)isc_radix_search(radix, &node, &prefix);
+		isc_refcount_destroy(&prefix.refcount);
+	}
+}
+
+static void
+bench_radix(void) {
+	isc_radix_tree_t *radix = NULL;
+
+	RUNTIME_CHECK(isc_radix_create(mctx, &radix, 128) == ISC_R_SUCCESS);
+	for (size_t i = 0; i < RADIX_PREFIXES; i++) {
+		isc_radix_node_t *node = NULL;
+		struct in_addr ina = { .s_addr = isc_random32() };
+		isc_netaddr_t netaddr;
+		isc_prefix_t prefix;
+
+		isc_netaddr_fromin(&netaddr, &ina);
+		NETADDR_TO_PREFIX_T(&netaddr, prefix, 8 + i % 17);
+		RUNTIME_CHECK(isc_radix_insert(radix, &node, NULL, &prefix) ==
+			      ISC_R_SUCCESS);
+		if (node->data[0] == NULL) {
+			node->data[0] = (void *)1;
+		}
+		isc_refcount_destroy(&prefix.refcount);
+	}
+
+	bench_run("isc_radix_search", 1, bench_ops, radix_search, radix);
+
+	isc_radix_destroy(radix, NULL);
+}
+
+/*
+ * isc_mem
+ */
+
+static void
+mem_getput(void *arg, size_t tid, size_t ops) {
+	void *ptrs[16];
+
+	UNUSED(arg);
+	UNUSED(tid);
+
+	for (size_t i = 0; i < ops; i += 16) {
+		for (size_t j = 0; j < 16; j++) {
+			ptrs[j] = isc_mem_get(mctx, 64 + j * 16);
+		}
+		for (size_t j = 0; j < 16; j++) {
+			isc_mem_put(mctx, ptrs[j], 64 + j * 16);
+		}
+	}
+}
+
+static void
+bench_mem(void) {
+	bench_run("isc_mem_getput", 1, bench_ops, mem_getput, NULL);
+	bench_run("isc_mem_getput_mt", bench_threads, bench_ops, mem_getput,
+		  NULL);
+}
+
+/*
+ * isc_rwlock
+ */
+
+typedef struct rwlock_arg {
+	isc_rwlock_t lock;
+	uint64_t value;
+	unsigned int writes; /* per 100 */
+} rwlock_arg_t;
+
+static void
+rwlock_mixed(void *arg, size_t tid, size_t ops) {
+	rwlock_arg_t *rw = arg;
+
+	UNUSED(tid);
+
+	for (size_t i = 0; i < ops; i++) {
+		if (i % 100 < rw->writes) {
+			RWLOCK(&rw->lock, isc_rwlocktype_write);
+			rw->value++;
+			RWUNLOCK(&rw->lock, isc_rwlocktype_write);
+		} else {
+			RWLOCK(&rw->lock, isc_rwlocktype_read);
+			(void)*(volatile uint64_t *)&rw->value;
+			RWUNLOCK(&rw->lock, isc_rwlocktype_read);
+		}
+	}
+}
+
+static void
+bench_rwlock(void) {
+	rwlock_arg_t rw = { .writes = 0 };
+
+	isc_rwlock_init(&rw.lock, 0, 0);
+	bench_run("isc_rwlock_read", bench_threads, bench_ops, rwlock_mixed,
+		  &rw);
+	rw.writes = 10;
+	bench_run("isc_rwlock_read90", bench_threads, bench_ops, rwlock_mixed,
+		  &rw);
+	isc_rwlock_destroy(&rw.lock);
+}
+
+int
+main(int argc, char **argv) {
+	bench_init(argc, argv);
+
+	bench_ht();
+	bench_radix();
+	bench_mem();
+	bench_rwlock();
+
+	bench_shutdown();
+
+	return (0);
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file
+ * \brief
+ * UDP request/response throughput of the network manager over the
+ * loopback interface.
+ *
+ * FLOWS clients each send a query, wait for the echoed reply and send
+ * the next one, until 'bench_ops' replies have been received in total.
+ * A lost datagram ends its flow, so the result counts the replies
+ * actually received.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/atomic.h>
+#include <isc/condition.h>
+#include <isc/managers.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/netmgr.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/util.h>
+
+#include "bench.h"
+
+#define FLOWS	64
+#define TIMEOUT 5000 /* milliseconds */
+
+static unsigned char query[64];
+static isc_region_t query_region = { query, sizeof(query) };
+
+static atomic_int_fast64_t remaining;
+static atomic_uint_fast64_t replies;
+
+static isc_mutex_t lock;
+static isc_condition_t cond;
+static unsigned int flows;
+
+static void
+flow_done(void) {
+	LOCK(&lock);
+	INSIST(flows > 0);
+	flows--;
+	SIGNAL(&cond);
+	UNLOCK(&lock);
+}
+
+static void
+echo_send_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *cbarg) {
+	UNUSED(eresult);
+	UNUSED(cbarg);
+
+	isc_nmhandle_detach(&handle);
+}
+
+static void
+echo_read_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+	     isc_region_t *region, void *cbarg) {
+	isc_nmhandle_t *sendhandle = NULL;
+
+	UNUSED(region);
+	UNUSED(cbarg);
+
+	if (eresult != ISC_R_SUCCESS) {
+		return;
+	}
+
+	/* The received data is only valid during the callback. */
+	isc_nmhandle_attach(handle, &sendhandle);
+	isc_nm_send(sendhandle, &query_region, echo_send_cb, NULL);
+}
+
+static void
+client_send_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *cbarg) {
+	UNUSED(eresult);
+	UNUSED(cbarg);
+
+	isc_nmhandle_detach(&handle);
+}
+
+static void
+client_send(isc_nmhandle_t *handle) {
+	isc_nmhandle_t *sendhandle = NULL;
+
+	isc_nmhandle_attach(handle, &sendhandle);
+	isc_nm_send(sendhandle, &query_region, client_send_cb, NULL);
+}
+
+static void
+client_read_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+	       isc_region_t *region, void *cbarg) {
+	UNUSED(region);
+	UNUSED(cbarg);
+
+	if (eresult == ISC_R_SUCCESS) {
+		atomic_fetch_add_relaxed(&replies, 1);
+		if (atomic_fetch_sub_relaxed(&remaining, 1) > FLOWS) {
+			client_send(handle);
+			return;
+		}
+	}
+
+	/* Detach the reference taken in client_connect_cb(). */
+	isc_nmhandle_detach(&handle);
+	flow_done();
+}
+
+static void
+client_connect_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+		  void *cbarg) {
+	isc_nmhandle_t *readhandle = NULL;
+
+	UNUSED(cbarg);
+
+	if (eresult != ISC_R_SUCCESS) {
+		fprintf(stderr, "udpconnect: %s\n", isc_result_totext(eresult));
+		flow_done();
+		return;
+	}
+
+	isc_nmhandle_attach(handle, &readhandle);
+	isc_nm_read(handle, client_read_cb, NULL);
+	client_send(handle);
+}
+
+int
+main(int argc, char **argv) {
+	isc_nm_t *netmgr = NULL;
+	isc_nmsocket_t *listener = NULL;
+	isc_sockaddr_t local, server;
+	struct in_addr loopback = { .s_addr = htonl(INADDR_LOOPBACK) };
+	socklen_t len = sizeof(server.type.sin);
+	uint64_t start;
+	int fd;
+
+	bench_init(argc, argv);
+	if (!bench_wanted("isc_nm_udp_echo")) {
+		bench_shutdown();
+		return (0);
+	}
+
+	/* Let the kernel pick a free port. */
+	isc_sockaddr_fromin(&server, &loopback, 0);
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	RUNTIME_CHECK(fd >= 0);
+	RUNTIME_CHECK(bind(fd, &server.type.sa, len) == 0);
+	RUNTIME_CHECK(getsockname(fd, &server.type.sa, &len) == 0);
+	close(fd);
+	isc_sockaddr_fromin(&local, &loopback, 0);
+
+	isc_mutex_init(&lock);
+	isc_condition_init(&cond);
+	atomic_init(&remaining, bench_ops);
+	atomic_init(&replies, 0);
+
+	isc_managers_create(mctx, bench_threads, 0, &netmgr, NULL, NULL);
+	RUNTIME_CHECK(isc_nm_listenudp(netmgr, &server, echo_read_cb, NULL, 0,
+				       &listener) == ISC_R_SUCCESS);
+
+	start = bench_now();
+	LOCK(&lock);
+	for (size_t i = 0; i < FLOWS; i++) {
+		flows++;
+		isc_nm_udpconnect(netmgr, &local, &server, client_connect_cb,
+				  NULL, TIMEOUT, 0);
+	}
+	while (flows > 0) {
+		WAIT(&cond, &lock);
+	}
+	UNLOCK(&lock);
+	bench_report("isc_nm_udp_echo", bench_threads,
+		     atomic_load_relaxed(&replies), bench_now() - start);
+
+	isc_nm_stoplistening(listener);
+	isc_nmsocket_close(&listener);
+	isc_managers_destroy(&netmgr, NULL, NULL);
+
+	isc_condition_destroy(&cond);
+	isc_mutex_destroy(&lock);
+	bench_shutdown();
+
+	return (0);
+}
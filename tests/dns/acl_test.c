@@ -24,6 +24,7 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/netaddr.h>
 #include <isc/print.h>
 #include <isc/string.h>
 #include <isc/util.h>
@@ -112,8 +113,127 @@ ISC_RUN_TEST_IMPL(dns_acl_isinsecure) {
 #endif /* HAVE_GEOIP2 */
 }
 
+static void
+add_prefix(dns_acl_t *acl, const char *text, uint16_t bitlen, bool pos) {
+	isc_netaddr_t addr;
+	struct in_addr in4;
+	struct in6_addr in6;
+	isc_result_t result;
+
+	if (inet_pton(AF_INET6, text, &in6) == 1) {
+		isc_netaddr_fromin6(&addr, &in6);
+	} else {
+		assert_int_equal(inet_pton(AF_INET, text, &in4), 1);
+		isc_netaddr_fromin(&addr, &in4);
+	}
+
+	result = dns_iptable_addprefix(acl->iptable, &addr, bitlen, pos);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+/* test that dns_aclindex_find agrees with dns_acl_allowed */
+ISC_RUN_TEST_IMPL(dns_aclindex) {
+	isc_result_t result;
+	dns_acl_t *acls[6] = { NULL };
+	dns_aclindex_t *index = NULL;
+	dns_aclenv_t *env = NULL;
+	dns_aclelement_t *de = NULL;
+	const char *addrs[] = { "10.0.0.1",	   "10.1.2.3",
+				"10.2.0.1",	   "192.0.2.1",
+				"198.51.100.1",	   "2001:db8::1",
+				"2001:db8:1::1",   "2001:db9::1",
+				"::1",		   "::ffff:10.1.0.1",
+				"::ffff:10.2.0.1" };
+	size_t i;
+	unsigned int j;
+
+	UNUSED(state);
+
+	result = dns_aclenv_create(mctx, &env);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	env->match_mapped = true;
+
+	result = dns_acl_any(mctx, &acls[0]);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* !10.1/16; 10/8; */
+	result = dns_acl_create(mctx, 0, &acls[1]);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	add_prefix(acls[1], "10.1.0.0", 16, false);
+	add_prefix(acls[1], "10.0.0.0", 8, true);
+
+	result = dns_acl_none(mctx, &acls[2]);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* 192.0.2/24; !2001:db8:1::/48; 2001:db8::/32; 10/8; */
+	result = dns_acl_create(mctx, 0, &acls[3]);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	add_prefix(acls[3], "192.0.2.0", 24, true);
+	add_prefix(acls[3], "2001:db8:1::", 48, false);
+	add_prefix(acls[3], "2001:db8::", 32, true);
+	add_prefix(acls[3], "10.0.0.0", 8, true);
+
+	/* localhost; */
+	result = dns_acl_create(mctx, 1, &acls[4]);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	de = acls[4]->elements;
+	de->type = dns_aclelementtype_localhost;
+	de->negative = false;
+	dns_acl_node_count(acls[4])++;
+	de->node_num = dns_acl_node_count(acls[4]);
+	acls[4]->length++;
+
+	/* acls[5] is NULL, matching everything */
+
+	result = dns_aclindex_create(mctx, acls, ARRAY_SIZE(acls), &index);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	assert_true(dns_aclindex_isexact(index, 1));
+	assert_true(dns_aclindex_isexact(index, 3));
+	assert_false(dns_aclindex_isexact(index, 4));
+	assert_true(dns_aclindex_isexact(index, 5));
+
+	for (i = 0; i < ARRAY_SIZE(addrs); i++) {
+		isc_netaddr_t addr;
+		struct in_addr in4;
+		struct in6_addr in6;
+		const uint64_t *bitmap = NULL;
+
+		if (inet_pton(AF_INET6, addrs[i], &in6) == 1) {
+			isc_netaddr_fromin6(&addr, &in6);
+		} else {
+			assert_int_equal(inet_pton(AF_INET, addrs[i], &in4), 1);
+			isc_netaddr_fromin(&addr, &in4);
+		}
+
+		bitmap = dns_aclindex_find(index, &addr, env);
+		for (j = 0; j < ARRAY_SIZE(acls); j++) {
+			bool found = ((bitmap[0] >> j) & 1) != 0;
+
+			if (dns_aclindex_isexact(index, j)) {
+				assert_int_equal(found,
+						 dns_acl_allowed(&addr, NULL,
+								 acls[j], env));
+			} else {
+				assert_true(found);
+			}
+		}
+	}
+
+	dns_aclindex_destroy(&index);
+	assert_null(index);
+
+	for (j = 0; j < ARRAY_SIZE(acls); j++) {
+		if (acls[j] != NULL) {
+			dns_acl_detach(&acls[j]);
+		}
+	}
+	dns_aclenv_detach(&env);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(dns_acl_isinsecure)
+ISC_TEST_ENTRY(dns_aclindex)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
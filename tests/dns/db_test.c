@@ -22,11 +22,16 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/os.h>
+#include <isc/stats.h>
+
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/journal.h>
+#include <dns/message.h>
 #include <dns/name.h>
 #include <dns/rdatalist.h>
+#include <dns/stats.h>
 
 #include <tests/dns.h>
 
@@ -243,6 +248,203 @@ ISC_RUN_TEST_IMPL(dns_dbfind_staleok) {
 	dns_db_detach(&db);
 }
 
+static void
+addcacheattr(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+	     const char *text, unsigned int attributes) {
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_fixedname_t fixed;
+	dns_dbnode_t *node = NULL;
+	unsigned char data[BUFLEN];
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fixed);
+	result = dns_test_rdatafromstring(&rdata, dns_rdataclass_in, type, data,
+					  sizeof(data), text, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.ttl = 300;
+	rdatalist.type = type;
+	rdatalist.rdclass = dns_rdataclass_in;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	rdataset.trust = dns_trust_answer;
+	rdataset.attributes |= attributes;
+
+	result = dns_db_findnode(db, dns_fixedname_name(&fixed), true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, 0, &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static void
+addcache(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+	 const char *text) {
+	addcacheattr(db, owner, type, text, 0);
+}
+
+static isc_result_t
+findstale(dns_db_t *db, const char *owner, unsigned int options,
+	  isc_stdtime_t now, unsigned int *attributesp) {
+	dns_rdataset_t rdataset;
+	dns_fixedname_t fixed, found;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fixed);
+	dns_fixedname_init(&found);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, dns_fixedname_name(&fixed), NULL,
+			     dns_rdatatype_a, options, now, &node,
+			     dns_fixedname_name(&found), &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		*attributesp = rdataset.attributes;
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+	return (result);
+}
+
+/*
+ * Add glue for the NS rdataset at 'owner' to a new message, and return
+ * the number of rdatasets that were added to its additional section.
+ */
+static unsigned int
+cacheglue(dns_db_t *db, const char *owner, isc_result_t expect) {
+	dns_message_t *msg = NULL;
+	dns_rdataset_t rdataset;
+	dns_fixedname_t fixed, found;
+	dns_dbnode_t *node = NULL;
+	dns_name_t *name = NULL;
+	dns_rdataset_t *glue = NULL;
+	unsigned int count = 0;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fixed);
+	dns_fixedname_init(&found);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, dns_fixedname_name(&fixed), NULL,
+			     dns_rdatatype_ns, 0, 0, &node,
+			     dns_fixedname_name(&found), &rdataset, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, &msg);
+	result = dns_rdataset_addglue(&rdataset, NULL, msg);
+	assert_int_equal(result, expect);
+
+	for (result = dns_message_firstname(msg, DNS_SECTION_ADDITIONAL);
+	     result == ISC_R_SUCCESS;
+	     result = dns_message_nextname(msg, DNS_SECTION_ADDITIONAL))
+	{
+		name = NULL;
+		dns_message_currentname(msg, DNS_SECTION_ADDITIONAL, &name);
+		for (glue = ISC_LIST_HEAD(name->list); glue != NULL;
+		     glue = ISC_LIST_NEXT(glue, link))
+		{
+			assert_true(glue->ttl <= 300);
+			count++;
+		}
+	}
+
+	dns_message_detach(&msg);
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+
+	return (count);
+}
+
+/* serving stale data during "stale-refresh-time" after a failure */
+ISC_RUN_TEST_IMPL(stalerefresh) {
+	dns_db_t *db = NULL;
+	unsigned int attributes = 0;
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_db_setservestalettl(db, 3600), ISC_R_SUCCESS);
+	assert_int_equal(dns_db_setservestalerefresh(db, 30), ISC_R_SUCCESS);
+
+	addcache(db, "example.", dns_rdatatype_a, "10.0.0.1");
+	isc_stdtime_get(&now);
+	now += 400;
+
+	/* Stale data is only returned when asked for */
+	result = findstale(db, "example.", DNS_DBFIND_STALEENABLED, now,
+			   &attributes);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	result = findstale(db, "example.", DNS_DBFIND_STALEOK, now,
+			   &attributes);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true((attributes & DNS_RDATASETATTR_STALE) != 0);
+
+	/* After a refresh failed, it is used for "stale-refresh-time" */
+	result = findstale(db, "example.",
+			   DNS_DBFIND_STALEOK | DNS_DBFIND_STALESTART, now,
+			   &attributes);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = findstale(db, "example.", DNS_DBFIND_STALEENABLED, now + 10,
+			   &attributes);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true((attributes & DNS_RDATASETATTR_STALE_WINDOW) != 0);
+	result = findstale(db, "example.", DNS_DBFIND_STALEENABLED, now + 30,
+			   &attributes);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_db_detach(&db);
+}
+
+/* glue for NS rdatasets from a cache database */
+ISC_RUN_TEST_IMPL(cacheglue) {
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	addcache(db, "example", dns_rdatatype_ns, "ns.example.");
+	addcache(db, "ns.example", dns_rdatatype_a, "10.0.0.1");
+
+	/* Built on first use, then reused */
+	assert_int_equal(cacheglue(db, "example", ISC_R_SUCCESS), 1);
+	assert_int_equal(cacheglue(db, "example", ISC_R_SUCCESS), 1);
+
+	/* New addresses are picked up */
+	addcache(db, "ns.example", dns_rdatatype_aaaa, "fd00::1");
+	assert_int_equal(cacheglue(db, "example", ISC_R_SUCCESS), 2);
+	addcache(db, "ns.example", dns_rdatatype_a, "10.0.0.2");
+	assert_int_equal(cacheglue(db, "example", ISC_R_SUCCESS), 2);
+
+	/* A target without addresses leaves the caller to look it up */
+	addcache(db, "other", dns_rdatatype_ns, "ns.other.");
+	assert_int_equal(cacheglue(db, "other", ISC_R_NOTFOUND), 0);
+	assert_int_equal(cacheglue(db, "other", ISC_R_NOTFOUND), 0);
+	addcache(db, "ns.other", dns_rdatatype_a, "10.0.0.3");
+	assert_int_equal(cacheglue(db, "other", ISC_R_SUCCESS), 1);
+
+	/* A changed NS rdataset gets a new entry */
+	addcache(db, "example", dns_rdatatype_ns, "ns.other.");
+	assert_int_equal(cacheglue(db, "example", ISC_R_SUCCESS), 1);
+
+	dns_db_detach(&db);
+}
+
 /* database class */
 ISC_RUN_TEST_IMPL(class) {
 	isc_result_t result;
@@ -360,13 +562,581 @@ ISC_RUN_TEST_IMPL(version) {
 	dns_db_detach(&db);
 }
 
+static isc_result_t
+findwild(dns_db_t *db, dns_dbversion_t *ver, const char *namestr) {
+	isc_result_t result;
+	dns_fixedname_t fname, ffound;
+	dns_name_t *foundname = dns_fixedname_initname(&ffound);
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+
+	dns_test_namefromstring(namestr, &fname);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, dns_fixedname_name(&fname), ver,
+			     dns_rdatatype_a, 0, 0, &node, foundname,
+			     &rdataset, NULL);
+	if (result == ISC_R_SUCCESS) {
+		assert_true(dns_name_equal(foundname,
+					   dns_fixedname_name(&fname)));
+		assert_true((foundname->attributes & DNS_NAMEATTR_WILDCARD) !=
+			    0);
+	}
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+
+	return (result);
+}
+
+/* wildcard matches, repeated and in different versions */
+ISC_RUN_TEST_IMPL(wildcard) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *ver = NULL, *new = NULL;
+	dns_dbnode_t *node = NULL;
+
+	UNUSED(state);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "test.test",
+				 TESTS_DIR "/testdata/db/wild.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_currentversion(db, &ver);
+	for (int i = 0; i < 2; i++) {
+		assert_int_equal(findwild(db, ver, "x.w.test.test"),
+				 ISC_R_SUCCESS);
+		assert_int_equal(findwild(db, ver, "y.x.w.test.test"),
+				 ISC_R_SUCCESS);
+		/* Below an empty non-terminal, the wildcard does not match */
+		assert_int_equal(findwild(db, ver, "x.ent.w.test.test"),
+				 DNS_R_NXDOMAIN);
+	}
+
+	/* Remove the wildcard in a new version */
+	result = dns_db_newversion(db, &new);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_test_namefromstring("*.w.test.test", &fname);
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), false, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_deleterdataset(db, node, new, dns_rdatatype_a, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	assert_int_equal(findwild(db, new, "x.w.test.test"), DNS_R_NXDOMAIN);
+	dns_db_closeversion(db, &new, true);
+
+	/* The old version still has it, the current one does not */
+	for (int i = 0; i < 2; i++) {
+		assert_int_equal(findwild(db, ver, "x.w.test.test"),
+				 ISC_R_SUCCESS);
+		assert_int_equal(findwild(db, NULL, "x.w.test.test"),
+				 DNS_R_NXDOMAIN);
+	}
+	dns_db_closeversion(db, &ver, false);
+
+	dns_db_detach(&db);
+}
+
+/* zone data generation */
+ISC_RUN_TEST_IMPL(generation) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *ver = NULL;
+	uint32_t generation;
+
+	UNUSED(state);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "test.test",
+				 TESTS_DIR "/testdata/db/data.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Reading does not change the generation */
+	generation = dns_db_generation();
+	dns_db_currentversion(db, &ver);
+	dns_db_closeversion(db, &ver, false);
+	assert_int_equal(dns_db_generation(), generation);
+
+	/* Neither does discarding a new version */
+	result = dns_db_newversion(db, &ver);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &ver, false);
+	assert_int_equal(dns_db_generation(), generation);
+
+	/* Committing one does */
+	result = dns_db_newversion(db, &ver);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &ver, true);
+	assert_int_not_equal(dns_db_generation(), generation);
+
+	dns_db_detach(&db);
+}
+
+static isc_result_t
+findcache(dns_db_t *db, const char *owner) {
+	dns_rdataset_t rdataset;
+	dns_fixedname_t fixed, found;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fixed);
+	dns_fixedname_init(&found);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, dns_fixedname_name(&fixed), NULL,
+			     dns_rdatatype_a, 0, 0, &node,
+			     dns_fixedname_name(&found), &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+
+	return (result);
+}
+
+static void
+water(void *arg, int mark) {
+	isc_mem_waterack(arg, mark);
+}
+
+/* purging names looked up only once before popular ones */
+ISC_RUN_TEST_IMPL(cacheslru) {
+	char namebuf[32];
+
+	UNUSED(state);
+
+	for (int pass = 0; pass < 2; pass++) {
+		dns_cachepolicy_t policy = (pass == 0) ? dns_cachepolicy_lru
+						       : dns_cachepolicy_slru;
+		isc_mem_t *dbmctx = NULL;
+		isc_stats_t *stats = NULL;
+		dns_db_t *db = NULL;
+		unsigned int found = 0;
+		isc_result_t result;
+		size_t inuse;
+
+		isc_mem_create(&dbmctx);
+		result = dns_db_create(dbmctx, "rbt", dns_rootname,
+				       dns_dbtype_cache, dns_rdataclass_in, 0,
+				       NULL, &db);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = isc_stats_create(mctx, &stats,
+					  dns_cachestatscounter_max);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_db_setcachestats(db, stats);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_db_setcachepolicy(db, policy);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		/* Popular names are looked up twice */
+		for (int i = 0; i < 20; i++) {
+			snprintf(namebuf, sizeof(namebuf), "hot%d.", i);
+			addcache(db, namebuf, dns_rdatatype_a, "10.0.0.1");
+			assert_int_equal(findcache(db, namebuf),
+					 ISC_R_SUCCESS);
+			assert_int_equal(findcache(db, namebuf),
+					 ISC_R_SUCCESS);
+		}
+		assert_int_equal(
+			isc_stats_get_counter(stats,
+					      dns_cachestatscounter_promotions),
+			(pass == 0) ? 0 : 20);
+
+		/* Then the cache fills up with names used only once */
+		inuse = isc_mem_inuse(dbmctx);
+		isc_mem_setwater(dbmctx, water, dbmctx, inuse + 256 * 1024,
+				 inuse + 128 * 1024);
+		for (int i = 0; i < 20000; i++) {
+			snprintf(namebuf, sizeof(namebuf), "cold%d.", i);
+			addcache(db, namebuf, dns_rdatatype_a, "10.0.0.2");
+		}
+		assert_int_not_equal(
+			isc_stats_get_counter(stats,
+					      dns_cachestatscounter_deletelru),
+			0);
+		assert_int_equal(isc_stats_get_counter(
+					 stats,
+					 dns_cachestatscounter_deleteprotected),
+				 0);
+
+		for (int i = 0; i < 20; i++) {
+			snprintf(namebuf, sizeof(namebuf), "hot%d.", i);
+			if (findcache(db, namebuf) == ISC_R_SUCCESS) {
+				found++;
+			}
+		}
+		if (pass == 0) {
+			assert_true(found < 20);
+		} else {
+			assert_int_equal(found, 20);
+		}
+
+		dns_db_detach(&db);
+		isc_stats_detach(&stats);
+		isc_mem_setwater(dbmctx, NULL, NULL, 0, 0);
+		isc_mem_destroy(&dbmctx);
+	}
+}
+
+/* finding the most looked up cache records that are about to expire */
+ISC_RUN_TEST_IMPL(findpopular) {
+	dns_dbpopular_t popular[4];
+	dns_fixedname_t fixed;
+	dns_name_t *name = NULL;
+	unsigned int count;
+	isc_stdtime_t now;
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	dns_test_namefromstring("hot.", &fixed);
+	name = dns_fixedname_name(&fixed);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	addcacheattr(db, "hot.", dns_rdatatype_a, "10.0.0.1",
+		     DNS_RDATASETATTR_PREFETCH);
+	addcacheattr(db, "warm.", dns_rdatatype_a, "10.0.0.2",
+		     DNS_RDATASETATTR_PREFETCH);
+	addcache(db, "plain.", dns_rdatatype_a, "10.0.0.3");
+
+	for (int i = 0; i < 3; i++) {
+		assert_int_equal(findcache(db, "hot."), ISC_R_SUCCESS);
+		assert_int_equal(findcache(db, "plain."), ISC_R_SUCCESS);
+	}
+	assert_int_equal(findcache(db, "warm."), ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+
+	/* Nothing expires within the window */
+	count = 0;
+	dns_db_findpopular(db, now, 10, 1, popular, 4, &count);
+	assert_int_equal(count, 0);
+
+	/* Records not eligible for prefetching are never returned */
+	count = 0;
+	dns_db_findpopular(db, now, 600, 1, popular, 4, &count);
+	assert_int_equal(count, 2);
+
+	count = 0;
+	dns_db_findpopular(db, now, 600, 2, popular, 4, &count);
+	assert_int_equal(count, 1);
+	assert_true(dns_name_equal(dns_fixedname_name(&popular[0].fixed),
+				   name));
+	assert_int_equal(popular[0].type, dns_rdatatype_a);
+	assert_int_equal(popular[0].hits, 3);
+
+	/* Only the most popular records are kept */
+	count = 0;
+	dns_db_findpopular(db, now, 600, 1, popular, 1, &count);
+	assert_int_equal(count, 1);
+	assert_true(dns_name_equal(dns_fixedname_name(&popular[0].fixed),
+				   name));
+
+	dns_db_detach(&db);
+}
+
+/* finding the NSEC3 record that may cover a hashed name in a cache */
+ISC_RUN_TEST_IMPL(coveringnsec3) {
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset, sigrdataset;
+	dns_fixedname_t fname, ffound, fowner;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	addcache(db, "f3uprjfm4jmhp9m5r1543flkarbiq1aa.example.",
+		 dns_rdatatype_nsec3,
+		 "1 0 0 AABB SCPJCLOD9NH4SNIS80BPP1JK8EDJG6T9 MX RRSIG");
+	addcache(db, "scpjclod9nh4snis80bpp1jk8edjg6t9.example.",
+		 dns_rdatatype_nsec3,
+		 "1 0 0 AABB F3UPRJFM4JMHP9M5R1543FLKARBIQ1AA NS SOA RRSIG");
+
+	dns_test_namefromstring("gooooooooooooooooooooooooooooooo.example.",
+				&fname);
+	dns_test_namefromstring("f3uprjfm4jmhp9m5r1543flkarbiq1aa.example.",
+				&fowner);
+	dns_fixedname_init(&ffound);
+	dns_rdataset_init(&rdataset);
+	dns_rdataset_init(&sigrdataset);
+
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL,
+			     dns_rdatatype_nsec3, DNS_DBFIND_COVERINGNSEC, 0,
+			     &node, dns_fixedname_name(&ffound), &rdataset,
+			     &sigrdataset);
+	assert_int_equal(result, DNS_R_COVERINGNSEC);
+	assert_int_equal(rdataset.type, dns_rdatatype_nsec3);
+	assert_true(dns_name_equal(dns_fixedname_name(&ffound),
+				   dns_fixedname_name(&fowner)));
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+
+	/* Without the option, the name is simply not found */
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL,
+			     dns_rdatatype_nsec3, 0, 0, &node,
+			     dns_fixedname_name(&ffound), &rdataset,
+			     &sigrdataset);
+	assert_int_not_equal(result, DNS_R_COVERINGNSEC);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+
+	dns_db_detach(&db);
+}
+
+/* deleting the expired records of a cache one bucket at a time */
+ISC_RUN_TEST_IMPL(cleanbucket) {
+	dns_db_t *db = NULL;
+	unsigned int nbuckets, count, total = 0;
+	bool partial = false;
+	isc_stdtime_t now;
+	isc_result_t result;
+	char namebuf[32];
+
+	UNUSED(state);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	nbuckets = dns_db_nodelockwaits(db, NULL, 0);
+	assert_true(nbuckets > 0);
+
+	/* More names than buckets, so some bucket holds several */
+	for (unsigned int i = 0; i < 2 * nbuckets + 1; i++) {
+		snprintf(namebuf, sizeof(namebuf), "name%u.", i);
+		addcache(db, namebuf, dns_rdatatype_a, "10.0.0.1");
+	}
+
+	/* Nothing has expired yet */
+	isc_stdtime_get(&now);
+	for (unsigned int b = 0; b < nbuckets; b++) {
+		result = dns_db_cleanbucket(db, b, now, 100, &count);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(count, 0);
+	}
+
+	/* After the TTL, every record is deleted, one at a time */
+	for (unsigned int b = 0; b < nbuckets; b++) {
+		do {
+			result = dns_db_cleanbucket(db, b, now + 3600, 1,
+						    &count);
+			total += count;
+			if (result == DNS_R_CONTINUE) {
+				assert_int_equal(count, 1);
+				partial = true;
+			}
+		} while (result == DNS_R_CONTINUE);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	assert_int_equal(total, 2 * nbuckets + 1);
+	assert_true(partial);
+	assert_int_equal(findcache(db, "name0."), ISC_R_NOTFOUND);
+
+	result = dns_db_cleanbucket(db, nbuckets, now, 100, &count);
+	assert_int_equal(result, ISC_R_RANGE);
+
+	dns_db_detach(&db);
+}
+
+/* accounting the memory used by a cache to the domains of the names */
+ISC_RUN_TEST_IMPL(topdomains) {
+	dns_dbdomainusage_t top[4];
+	dns_fixedname_t fixed;
+	dns_name_t *name = NULL;
+	dns_db_t *db = NULL;
+	unsigned int nbuckets, count;
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	dns_test_namefromstring("example.com.", &fixed);
+	name = dns_fixedname_name(&fixed);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Nothing is accounted until it is enabled */
+	addcache(db, "www.example.org.", dns_rdatatype_a, "10.0.0.1");
+	dns_db_setdomainusage(db, true);
+
+	addcache(db, "www.example.com.", dns_rdatatype_a, "10.0.0.1");
+	addcache(db, "Mail.Example.COM.", dns_rdatatype_a, "10.0.0.2");
+	addcache(db, "a.b.example.com.", dns_rdatatype_a, "10.0.0.3");
+	addcache(db, "www.example.net.", dns_rdatatype_a, "10.0.0.4");
+
+	count = 0;
+	dns_db_topdomains(db, top, 4, &count);
+	assert_int_equal(count, 2);
+	for (unsigned int i = 0; i < count; i++) {
+		if (dns_name_equal(dns_fixedname_name(&top[i].fixed), name)) {
+			assert_int_equal(top[i].rdatasets, 3);
+		} else {
+			assert_int_equal(top[i].rdatasets, 1);
+		}
+		assert_true(top[i].bytes > 0);
+	}
+
+	/* Only the largest domains are kept */
+	count = 0;
+	dns_db_topdomains(db, top, 1, &count);
+	assert_int_equal(count, 1);
+	assert_true(dns_name_equal(dns_fixedname_name(&top[0].fixed), name));
+
+	/* Domains are forgotten when their records expire */
+	isc_stdtime_get(&now);
+	nbuckets = dns_db_nodelockwaits(db, NULL, 0);
+	for (unsigned int b = 0; b < nbuckets; b++) {
+		result = dns_db_cleanbucket(db, b, now + 3600, 100, &count);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	count = 0;
+	dns_db_topdomains(db, top, 4, &count);
+	assert_int_equal(count, 0);
+
+	dns_db_detach(&db);
+}
+
+/* growing the hash table of a cache from its task */
+ISC_RUN_TEST_IMPL(cacherehash) {
+	dns_db_t *db = NULL;
+	dns_dbnode_t *nodes[1000] = { NULL };
+	dns_fixedname_t fname;
+	isc_stats_t *stats = NULL;
+	isc_result_t result;
+	size_t hashsize;
+	char namebuf[32];
+
+	UNUSED(state);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_stats_create(mctx, &stats, dns_cachestatscounter_max);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_setcachestats(db, stats);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_settask(db, maintask);
+	hashsize = dns_db_hashsize(db);
+
+	/* Empty cache nodes would go away when detached */
+	for (size_t i = 0; i < ARRAY_SIZE(nodes); i++) {
+		snprintf(namebuf, sizeof(namebuf), "name%zu.", i);
+		dns_test_namefromstring(namebuf, &fname);
+		result = dns_db_findnode(db, dns_fixedname_name(&fname), true,
+					 &nodes[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	for (int i = 0; i < 500; i++) {
+		if (isc_stats_get_counter(stats,
+					  dns_cachestatscounter_rehashes) != 0)
+		{
+			break;
+		}
+		usleep(10000);
+	}
+	assert_int_not_equal(
+		isc_stats_get_counter(stats, dns_cachestatscounter_rehashes),
+		0);
+	assert_true(dns_db_hashsize(db) > hashsize);
+
+	for (size_t i = 0; i < ARRAY_SIZE(nodes); i++) {
+		dns_db_detachnode(db, &nodes[i]);
+	}
+	dns_db_settask(db, NULL);
+	dns_db_detach(&db);
+	isc_stats_detach(&stats);
+}
+
+/* sizing node locks from a size hint */
+ISC_RUN_TEST_IMPL(sizehint) {
+	isc_result_t result;
+	dns_fixedname_t fname, ffound;
+	dns_name_t *name, *foundname;
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+	unsigned int nodelocks;
+	uint64_t waits[1];
+
+	UNUSED(state);
+
+	dns_test_namefromstring("test.test", &fname);
+	result = dns_db_create(mctx, "rbt", dns_fixedname_name(&fname),
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	nodelocks = dns_db_nodelockwaits(db, NULL, 0);
+	assert_int_not_equal(nodelocks, 0);
+
+	/* A small zone keeps the default */
+	dns_db_setsizehint(db, 5);
+	assert_int_equal(dns_db_nodelockwaits(db, NULL, 0), nodelocks);
+
+	/* A large one gets more locks if there are CPUs to use them */
+	dns_db_setsizehint(db, 10000000);
+	if (isc_os_ncpus() > 2) {
+		assert_true(dns_db_nodelockwaits(db, NULL, 0) > nodelocks);
+	}
+	nodelocks = dns_db_nodelockwaits(db, waits, 1);
+
+	/* The database still works after being resized */
+	result = dns_db_load(db, TESTS_DIR "/testdata/db/data.db",
+			     dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("b.test.test", &fname);
+	name = dns_fixedname_name(&fname);
+	foundname = dns_fixedname_initname(&ffound);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, name, NULL, dns_rdatatype_a, 0, 0, &node,
+			     foundname, &rdataset, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+
+	/* Once loaded, the hint is ignored */
+	dns_db_setsizehint(db, 5);
+	assert_int_equal(dns_db_nodelockwaits(db, NULL, 0), nodelocks);
+
+	dns_db_detach(&db);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(getoriginnode)
 ISC_TEST_ENTRY(getsetservestalettl)
 ISC_TEST_ENTRY(dns_dbfind_staleok)
+ISC_TEST_ENTRY(stalerefresh)
+ISC_TEST_ENTRY(cacheglue)
+ISC_TEST_ENTRY(cacheslru)
 ISC_TEST_ENTRY(class)
 ISC_TEST_ENTRY(dbtype)
 ISC_TEST_ENTRY(version)
+ISC_TEST_ENTRY(wildcard)
+ISC_TEST_ENTRY(generation)
+ISC_TEST_ENTRY(findpopular)
+ISC_TEST_ENTRY(coveringnsec3)
+ISC_TEST_ENTRY(cleanbucket)
+ISC_TEST_ENTRY(topdomains)
+ISC_TEST_ENTRY(sizehint)
+ISC_TEST_ENTRY_CUSTOM(cacherehash, setup_managers, teardown_managers)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
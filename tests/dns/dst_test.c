@@ -30,6 +30,7 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/buffer.h>
 #include <isc/file.h>
 #include <isc/hex.h>
 #include <isc/result.h>
@@ -479,9 +480,93 @@ ISC_RUN_TEST_IMPL(cmp_test) {
 	}
 }
 
+/* Parsed public keys are shared by name, class and rdata */
+ISC_RUN_TEST_IMPL(fromdns_cached_test) {
+	isc_result_t result;
+	dst_key_t *key = NULL, *key1 = NULL, *key2 = NULL, *key3 = NULL;
+	unsigned char data[1024];
+	isc_buffer_t b;
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	const char *keyname = "example-d.";
+
+	name = dns_fixedname_initname(&fname);
+	isc_buffer_constinit(&b, keyname, strlen(keyname));
+	isc_buffer_add(&b, strlen(keyname));
+	result = dns_name_fromtext(name, &b, dns_rootname, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dst_key_fromfile(name, 53461, DST_ALG_RSASHA256,
+				  DST_TYPE_PUBLIC, TESTS_DIR "/comparekeys",
+				  mctx, &key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dst_key_todns(key, &b);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dst_key_fromdns_cached(name, dns_rdataclass_in, &b, &key1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_buffer_remaininglength(&b), 0);
+	assert_true(dst_key_compare(key, key1));
+
+	isc_buffer_first(&b);
+	result = dst_key_fromdns_cached(name, dns_rdataclass_in, &b, &key2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_buffer_remaininglength(&b), 0);
+	assert_ptr_equal(key1, key2);
+
+	isc_buffer_first(&b);
+	result = dst_key_fromdns_cached(name, dns_rdataclass_ch, &b, &key3);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_not_equal(key1, key3);
+
+	dst_key_free(&key3);
+	dst_key_free(&key2);
+	dst_key_free(&key1);
+	dst_key_free(&key);
+}
+
+/* Private key files are found by name, without regard to case */
+ISC_RUN_TEST_IMPL(privatefiles_test) {
+	isc_result_t result;
+	isc_buffer_t *files = NULL;
+	const char *file = NULL;
+	bool rsa = false, ecdsa = false;
+
+	for (int i = 0; i < 2; i++) {
+		result = dst_key_privatefiles(TESTS_DIR "/testdata/dst", "TEST.",
+					      mctx, &files);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		for (file = isc_buffer_base(files);
+		     file < (char *)isc_buffer_used(files);
+		     file += strlen(file) + 1)
+		{
+			if (strcmp(file, "Ktest.+008+11349.private") == 0) {
+				rsa = true;
+			} else if (strcmp(file, "Ktest.+013+49130.private") ==
+				   0)
+			{
+				ecdsa = true;
+			} else {
+				fail_msg("unexpected file %s", file);
+			}
+		}
+		assert_true(rsa && ecdsa);
+		isc_buffer_free(&files);
+	}
+
+	result = dst_key_privatefiles(TESTS_DIR "/testdata/dst", "test",
+				      mctx, &files);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	assert_null(files);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(sig_test, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(cmp_test, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(fromdns_cached_test, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(privatefiles_test, setup_test, teardown_test)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/netaddr.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#include <dns/ecs.h>
+#include <dns/ecscache.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include <tests/dns.h>
+
+/*
+ * Store one A record holding 'last' as the last octet for the subnet
+ * 'addr'/'source' with scope 'scope'.
+ */
+static void
+add_a(dns_ecscache_t *cache, const dns_name_t *name, const char *addr,
+      unsigned int source, unsigned int scope, unsigned char last,
+      dns_ttl_t ttl, isc_stdtime_t now) {
+	unsigned char data[4] = { 192, 0, 2, last };
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_region_t region = { data, sizeof(data) };
+	struct in_addr ina;
+	struct in6_addr in6a;
+	dns_ecs_t ecs;
+	isc_result_t result;
+
+	dns_ecs_init(&ecs);
+	if (inet_pton(AF_INET, addr, &ina) == 1) {
+		isc_netaddr_fromin(&ecs.addr, &ina);
+	} else {
+		assert_int_equal(inet_pton(AF_INET6, addr, &in6a), 1);
+		isc_netaddr_fromin6(&ecs.addr, &in6a);
+	}
+	ecs.source = source;
+	ecs.scope = scope;
+
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_a,
+			     &region);
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = ttl;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_ecscache_add(cache, name, &ecs, &rdataset, now);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+/*
+ * Look up the A record for 'client'; return its last octet, or -1 if
+ * there is none.
+ */
+static int
+find_a(dns_ecscache_t *cache, const dns_name_t *name, const char *client,
+       isc_stdtime_t now, unsigned int *scopep) {
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdataset_t rdataset;
+	isc_netaddr_t addr;
+	struct in_addr ina;
+	struct in6_addr in6a;
+	isc_result_t result;
+	int last;
+
+	if (inet_pton(AF_INET, client, &ina) == 1) {
+		isc_netaddr_fromin(&addr, &ina);
+	} else {
+		assert_int_equal(inet_pton(AF_INET6, client, &in6a), 1);
+		isc_netaddr_fromin6(&addr, &in6a);
+	}
+
+	dns_rdataset_init(&rdataset);
+	result = dns_ecscache_find(cache, name, dns_rdatatype_a, &addr, now,
+				   &rdataset, scopep);
+	if (result == ISC_R_NOTFOUND) {
+		return (-1);
+	}
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	assert_int_equal(dns_rdataset_count(&rdataset), 1);
+	result = dns_rdataset_first(&rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_current(&rdataset, &rdata);
+	assert_int_equal(rdata.length, 4);
+	last = rdata.data[3];
+	dns_rdataset_disassociate(&rdataset);
+
+	return (last);
+}
+
+/* answers are returned for the longest matching scope */
+ISC_RUN_TEST_IMPL(dns_ecscache_scope) {
+	dns_ecscache_t *cache = NULL;
+	dns_fixedname_t fname, fupper;
+	dns_name_t *name = NULL, *upper = NULL;
+	unsigned int scope = 0;
+	isc_result_t result;
+
+	result = dns_test_namefromstring("www.example.", &fname);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	name = dns_fixedname_name(&fname);
+	result = dns_test_namefromstring("WWW.Example.", &fupper);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	upper = dns_fixedname_name(&fupper);
+
+	dns_ecscache_create(mctx, &cache);
+
+	assert_int_equal(find_a(cache, name, "198.51.100.1", 0, NULL), -1);
+
+	add_a(cache, name, "198.51.100.0", 24, 0, 1, 300, 0);
+	add_a(cache, name, "198.51.100.0", 24, 16, 2, 300, 0);
+	add_a(cache, name, "198.51.100.0", 24, 24, 3, 300, 0);
+	add_a(cache, name, "2001:db8::", 56, 48, 4, 300, 0);
+
+	assert_int_equal(find_a(cache, name, "198.51.100.7", 0, &scope), 3);
+	assert_int_equal(scope, 24);
+	assert_int_equal(find_a(cache, upper, "198.51.100.7", 0, NULL), 3);
+	assert_int_equal(find_a(cache, name, "198.51.7.7", 0, &scope), 2);
+	assert_int_equal(scope, 16);
+	assert_int_equal(find_a(cache, name, "203.0.113.7", 0, &scope), 1);
+	assert_int_equal(scope, 0);
+	assert_int_equal(find_a(cache, name, "2001:db8:0:ff::1", 0, &scope),
+			 4);
+	assert_int_equal(scope, 48);
+	assert_int_equal(find_a(cache, name, "2001:db9::1", 0, NULL), 1);
+
+	/* A scope longer than the source is cut to the source. */
+	add_a(cache, name, "203.0.113.128", 25, 32, 5, 300, 0);
+	assert_int_equal(find_a(cache, name, "203.0.113.200", 0, &scope), 5);
+	assert_int_equal(scope, 25);
+	assert_int_equal(find_a(cache, name, "203.0.113.100", 0, NULL), 1);
+
+	/* Adding for the same subnet replaces the answer. */
+	add_a(cache, name, "198.51.100.99", 24, 24, 6, 300, 0);
+	assert_int_equal(find_a(cache, name, "198.51.100.7", 0, NULL), 6);
+
+	dns_ecscache_destroy(&cache);
+}
+
+/* expired answers are not returned and are removed */
+ISC_RUN_TEST_IMPL(dns_ecscache_expire) {
+	dns_ecscache_t *cache = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	dns_rdataset_t rdataset;
+	isc_netaddr_t addr;
+	struct in_addr ina;
+	isc_result_t result;
+
+	result = dns_test_namefromstring("www.example.", &fname);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	name = dns_fixedname_name(&fname);
+
+	dns_ecscache_create(mctx, &cache);
+
+	add_a(cache, name, "198.51.100.0", 24, 0, 1, 600, 1000);
+	add_a(cache, name, "198.51.100.0", 24, 24, 2, 100, 1000);
+
+	inet_pton(AF_INET, "198.51.100.7", &ina);
+	isc_netaddr_fromin(&addr, &ina);
+	dns_rdataset_init(&rdataset);
+	result = dns_ecscache_find(cache, name, dns_rdatatype_a, &addr, 1050,
+				   &rdataset, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(rdataset.ttl, 50);
+
+	/* The rdataset outlives the entry and the cache. */
+	dns_ecscache_clean(cache, 1100);
+	assert_int_equal(find_a(cache, name, "198.51.100.7", 1100, NULL), 1);
+	assert_int_equal(find_a(cache, name, "198.51.100.7", 1600, NULL), -1);
+
+	dns_ecscache_destroy(&cache);
+
+	result = dns_rdataset_first(&rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(dns_ecscache_scope)
+ISC_TEST_ENTRY(dns_ecscache_expire)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -26,6 +26,7 @@
 
 #include <isc/dir.h>
 #include <isc/print.h>
+#include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
@@ -459,6 +460,8 @@ ISC_RUN_TEST_IMPL(dumpraw) {
 	isc_buffer_t source, target;
 	unsigned char namebuf[BUFLEN];
 	int len;
+	FILE *f = NULL;
+	int c;
 
 	UNUSED(state);
 
@@ -515,11 +518,205 @@ ISC_RUN_TEST_IMPL(dumpraw) {
 	assert_true((header.flags & DNS_MASTERRAW_SOURCESERIALSET) != 0);
 	assert_int_equal(header.sourceserial, 12345);
 
+	/* Format version 2: chunked and checksummed */
+	dns_master_initrawheader(&header);
+	header.flags |= DNS_MASTERRAW_CHUNKED;
+
+	unlink("test.dump");
+	result = dns_master_dump(mctx, db, version, &dns_master_style_default,
+				 "test.dump", dns_masterformat_raw, &header);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = test_master(NULL, "test.dump", dns_masterformat_raw, nullmsg,
+			     nullmsg);
+	assert_string_equal(isc_result_totext(result), "success");
+	assert_true(headerset);
+	assert_int_equal(header.version, DNS_RAWFORMAT_VERSION);
+	assert_true((header.flags & DNS_MASTERRAW_CHUNKED) != 0);
+
+	/* A damaged chunk is rejected */
+	f = fopen("test.dump", "r+b");
+	assert_non_null(f);
+	assert_int_equal(fseek(f, -1, SEEK_END), 0);
+	c = fgetc(f);
+	assert_int_equal(fseek(f, -1, SEEK_END), 0);
+	assert_int_equal(fputc(c ^ 0xff, f), c ^ 0xff);
+	assert_int_equal(fclose(f), 0);
+
+	result = test_master(NULL, "test.dump", dns_masterformat_raw, nullmsg,
+			     nullmsg);
+	assert_int_not_equal(result, ISC_R_SUCCESS);
+
 	unlink("test.dump");
 	dns_db_closeversion(db, &version, false);
 	dns_db_detach(&db);
 }
 
+static unsigned int cache_added;
+static dns_trust_t cache_trust[2];
+static dns_ttl_t cache_ttl[2];
+
+static isc_result_t
+cache_callback(void *arg, const dns_name_t *owner, dns_rdataset_t *dataset) {
+	UNUSED(arg);
+	UNUSED(owner);
+
+	if (cache_added < ARRAY_SIZE(cache_trust)) {
+		cache_trust[cache_added] = dataset->trust;
+		cache_ttl[cache_added] = dataset->ttl;
+	}
+	cache_added++;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+load_cache(const char *file) {
+	dns_rdatacallbacks_t cb;
+	dns_name_t *root = NULL;
+
+	dns_rdatacallbacks_init_stdio(&cb);
+	cb.add = cache_callback;
+	cb.error = nullmsg;
+	cache_added = 0;
+
+	DE_CONST(dns_rootname, root);
+	return (dns_master_loadfile(file, root, root, dns_rdataclass_in,
+				    DNS_MASTER_CACHE, 0, &cb, NULL, NULL, mctx,
+				    dns_masterformat_raw, 0));
+}
+
+static void
+add_cache(dns_db_t *db, const char *owner, const char *text, dns_ttl_t ttl,
+	  dns_trust_t trust) {
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_fixedname_t fixed;
+	dns_dbnode_t *node = NULL;
+	unsigned char data[BUFLEN];
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fixed);
+	result = dns_test_rdatafromstring(&rdata, dns_rdataclass_in,
+					  dns_rdatatype_a, data, sizeof(data),
+					  text, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.ttl = ttl;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.rdclass = dns_rdataclass_in;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	rdataset.trust = trust;
+
+	result = dns_db_findnode(db, dns_fixedname_name(&fixed), true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, 0, &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static void
+put_cache_rrset(isc_buffer_t *b, uint32_t expire, dns_trust_t trust) {
+	static const unsigned char owner[] = { 3, 'w', 'w', 'w', 0 };
+	static const unsigned char addr[] = { 10, 0, 0, 1 };
+	uint32_t totallen = 4 + 2 + 2 + 2 + 4 + 4 + 2 + 2 + sizeof(owner) +
+			    2 + sizeof(addr);
+
+	isc_buffer_putuint32(b, totallen);
+	isc_buffer_putuint16(b, dns_rdataclass_in);
+	isc_buffer_putuint16(b, dns_rdatatype_a);
+	isc_buffer_putuint16(b, 0);
+	isc_buffer_putuint32(b, expire);
+	isc_buffer_putuint32(b, 1);
+	isc_buffer_putuint16(b, trust);
+	isc_buffer_putuint16(b, sizeof(owner));
+	isc_buffer_putmem(b, owner, sizeof(owner));
+	isc_buffer_putuint16(b, sizeof(addr));
+	isc_buffer_putmem(b, addr, sizeof(addr));
+}
+
+/*
+ * Raw cache dump test:
+ * cache dumps keep trust levels and expiry times, and expired RRsets
+ * are not loaded
+ */
+ISC_RUN_TEST_IMPL(dumprawcache) {
+	unsigned char data[256];
+	isc_buffer_t b;
+	isc_stdtime_t now;
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	FILE *f = NULL;
+
+	UNUSED(state);
+
+	result = isc_dir_chdir(BUILDDIR);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	add_cache(db, "www.test.", "10.0.0.1", 300, dns_trust_answer);
+	add_cache(db, "ns.test.", "10.0.0.2", 600, dns_trust_glue);
+
+	/* A dump without DNS_MASTERRAW_CACHE is not a cache dump */
+	result = dns_master_dump(mctx, db, NULL, &dns_master_style_cache,
+				 "test.dump", dns_masterformat_raw, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = load_cache("test.dump");
+	assert_int_equal(result, ISC_R_NOTIMPLEMENTED);
+	unlink("test.dump");
+
+	dns_master_initrawheader(&header);
+	header.flags = DNS_MASTERRAW_CACHE;
+	result = dns_master_dump(mctx, db, NULL, &dns_master_style_cache,
+				 "test.dump", dns_masterformat_raw, &header);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = load_cache("test.dump");
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(cache_added, 2);
+	/* ns.test sorts before www.test */
+	assert_int_equal(cache_trust[0], dns_trust_glue);
+	assert_in_range(cache_ttl[0], 590, 600);
+	assert_int_equal(cache_trust[1], dns_trust_answer);
+	assert_in_range(cache_ttl[1], 290, 300);
+	unlink("test.dump");
+	dns_db_detach(&db);
+
+	/* RRsets that expired after the dump are discarded */
+	isc_stdtime_get(&now);
+	isc_buffer_init(&b, data, sizeof(data));
+	isc_buffer_putuint32(&b, dns_masterformat_raw);
+	isc_buffer_putuint32(&b, DNS_RAWFORMAT_VERSION);
+	isc_buffer_putuint32(&b, now - 100);
+	isc_buffer_putuint32(&b, DNS_MASTERRAW_CACHE);
+	isc_buffer_putuint32(&b, 0);
+	isc_buffer_putuint32(&b, 0);
+	put_cache_rrset(&b, now - 10, dns_trust_answer);
+	put_cache_rrset(&b, now + 100, dns_trust_authanswer);
+
+	result = isc_stdio_open("test.dump", "wb", &f);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_stdio_write(data, 1, isc_buffer_usedlength(&b), f, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_stdio_close(f);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = load_cache("test.dump");
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(cache_added, 1);
+	assert_int_equal(cache_trust[0], dns_trust_authanswer);
+	assert_in_range(cache_ttl[0], 99, 100);
+	unlink("test.dump");
+}
+
 static const char *warn_expect_value;
 static bool warn_expect_result;
 
@@ -574,6 +771,7 @@ ISC_TEST_ENTRY(leadingzero)
 ISC_TEST_ENTRY(totext)
 ISC_TEST_ENTRY(loadraw)
 ISC_TEST_ENTRY(dumpraw)
+ISC_TEST_ENTRY(dumprawcache)
 ISC_TEST_ENTRY(toobig)
 ISC_TEST_ENTRY(maxrdata)
 ISC_TEST_ENTRY(neworigin)
@@ -0,0 +1,442 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include <tests/dns.h>
+
+/* Query for "example./A/IN" with ID 0x1234 and RD set */
+static unsigned char query[] = { 0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00,
+				 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 'e',
+				 'x',  'a',  'm',  'p',	 'l',  'e',  0x00,
+				 0x00, 0x01, 0x00, 0x01 };
+
+static void
+parse_borrowed(dns_message_t *msg, unsigned char *wire) {
+	isc_buffer_t buf;
+	isc_result_t result;
+
+	memmove(wire, query, sizeof(query));
+	isc_buffer_init(&buf, wire, sizeof(query));
+	isc_buffer_add(&buf, sizeof(query));
+
+	result = dns_message_parse(msg, &buf, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(dns_message_getrawmessage(msg)->base, wire);
+}
+
+/* dns_message_savebuffer() into caller storage and onto the heap */
+ISC_RUN_TEST_IMPL(dns_message_savebuffer) {
+	dns_message_t *msg = NULL;
+	unsigned char wire[sizeof(query)];
+	unsigned char storage[sizeof(query)];
+	isc_region_t *raw = NULL;
+
+	UNUSED(state);
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+
+	/*
+	 * The request fits: it is copied into the supplied storage and
+	 * survives the original buffer being overwritten.
+	 */
+	parse_borrowed(msg, wire);
+	dns_message_savebuffer(msg, storage, sizeof(storage));
+	memset(wire, 0xff, sizeof(wire));
+
+	raw = dns_message_getrawmessage(msg);
+	assert_ptr_equal(raw->base, storage);
+	assert_int_equal(raw->length, sizeof(query));
+	assert_memory_equal(raw->base, query, sizeof(query));
+
+	/*
+	 * Saving again is a no-op.
+	 */
+	dns_message_savebuffer(msg, storage, sizeof(storage));
+	assert_ptr_equal(dns_message_getrawmessage(msg)->base, storage);
+
+	/*
+	 * The reply keeps referring to the same storage.
+	 */
+	assert_int_equal(dns_message_reply(msg, true), ISC_R_SUCCESS);
+	dns_message_savebuffer(msg, storage, sizeof(storage));
+
+	dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+
+	/*
+	 * The request does not fit: it is copied onto the heap and freed
+	 * with the message.
+	 */
+	parse_borrowed(msg, wire);
+	dns_message_savebuffer(msg, storage, sizeof(query) - 1);
+	memset(wire, 0xff, sizeof(wire));
+
+	raw = dns_message_getrawmessage(msg);
+	assert_ptr_not_equal(raw->base, wire);
+	assert_ptr_not_equal(raw->base, storage);
+	assert_memory_equal(raw->base, query, sizeof(query));
+
+	dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+
+	/*
+	 * No storage at all behaves like dns_message_clonebuffer().
+	 */
+	parse_borrowed(msg, wire);
+	dns_message_savebuffer(msg, NULL, 0);
+	memset(wire, 0xff, sizeof(wire));
+
+	raw = dns_message_getrawmessage(msg);
+	assert_ptr_not_equal(raw->base, wire);
+	assert_memory_equal(raw->base, query, sizeof(query));
+
+	dns_message_detach(&msg);
+}
+
+static dns_fixedname_t example;
+
+/*
+ * Build an authoritative "example./A/IN" response with one answer record.
+ */
+static void
+make_response(dns_message_t **msgp, dns_rdata_t *rdata) {
+	dns_message_t *msg = NULL;
+	dns_name_t *qname = NULL, *aname = NULL;
+	dns_rdataset_t *qrdataset = NULL, *ardataset = NULL;
+	dns_rdatalist_t *rdatalist = NULL;
+	isc_result_t result;
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, msgp);
+	msg = *msgp;
+	msg->id = 0x1234;
+	msg->flags = DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_AA;
+
+	result = dns_message_gettempname(msg, &qname);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_name_clone(dns_fixedname_name(&example), qname);
+	result = dns_message_gettemprdataset(msg, &qrdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_makequestion(qrdataset, dns_rdataclass_in,
+				  dns_rdatatype_a);
+	ISC_LIST_APPEND(qname->list, qrdataset, link);
+	dns_message_addname(msg, qname, DNS_SECTION_QUESTION);
+
+	result = dns_message_gettempname(msg, &aname);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_name_clone(dns_fixedname_name(&example), aname);
+	result = dns_message_gettemprdatalist(msg, &rdatalist);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	rdatalist->rdclass = dns_rdataclass_in;
+	rdatalist->type = dns_rdatatype_a;
+	rdatalist->ttl = 300;
+	ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
+	result = dns_message_gettemprdataset(msg, &ardataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_rdatalist_tordataset(rdatalist, ardataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	ISC_LIST_APPEND(aname->list, ardataset, link);
+	dns_message_addname(msg, aname, DNS_SECTION_ANSWER);
+}
+
+/* dns_message_renderwire() reproduces rendered sections */
+ISC_RUN_TEST_IMPL(dns_message_renderwire) {
+	dns_message_t *msg = NULL;
+	dns_compress_t cctx;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	unsigned char rdatabuf[4] = { 192, 0, 2, 1 };
+	unsigned char wire[512], rewire[512];
+	unsigned int counts[DNS_SECTION_MAX];
+	isc_buffer_t buf, rebuf;
+	isc_region_t sections;
+	isc_result_t result;
+	int i;
+
+	UNUSED(state);
+
+	dns_test_namefromstring("example.", &example);
+	sections = (isc_region_t){ .base = rdatabuf, .length = 4 };
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_a,
+			     &sections);
+
+	/*
+	 * Render a response the usual way and keep its sections.
+	 */
+	make_response(&msg, &rdata);
+	result = dns_compress_init(&cctx, -1, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_buffer_init(&buf, wire, sizeof(wire));
+	result = dns_message_renderbegin(msg, &cctx, &buf);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	sections.base = wire + DNS_MESSAGE_HEADERLEN;
+	sections.length = isc_buffer_usedlength(&buf) - DNS_MESSAGE_HEADERLEN;
+	for (i = 0; i < DNS_SECTION_MAX; i++) {
+		counts[i] = msg->counts[i];
+	}
+	result = dns_message_renderend(msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+	dns_message_detach(&msg);
+
+	/*
+	 * Rendering the kept sections gives the same message.
+	 */
+	dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, &msg);
+	msg->id = 0x1234;
+	msg->flags = DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_AA;
+	result = dns_compress_init(&cctx, -1, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_buffer_init(&rebuf, rewire, sizeof(rewire));
+	result = dns_message_renderbegin(msg, &cctx, &rebuf);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_renderwire(msg, &sections, counts);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_renderend(msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+	dns_message_detach(&msg);
+
+	assert_int_equal(isc_buffer_usedlength(&rebuf),
+			 isc_buffer_usedlength(&buf));
+	assert_memory_equal(rewire, wire, isc_buffer_usedlength(&buf));
+
+	/*
+	 * Sections that do not fit are not written at all.
+	 */
+	dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, &msg);
+	result = dns_compress_init(&cctx, -1, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_buffer_init(&rebuf, rewire,
+			DNS_MESSAGE_HEADERLEN + sections.length - 1);
+	result = dns_message_renderbegin(msg, &cctx, &rebuf);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_renderwire(msg, &sections, counts);
+	assert_int_equal(result, ISC_R_NOSPACE);
+	assert_int_equal(isc_buffer_usedlength(&rebuf), DNS_MESSAGE_HEADERLEN);
+	result = dns_message_renderend(msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+	dns_message_detach(&msg);
+}
+
+/* dns_message_sectionfits() agrees with dns_message_rendersection() */
+ISC_RUN_TEST_IMPL(dns_message_sectionfits) {
+	dns_message_t *msg = NULL;
+	dns_compress_t cctx;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	unsigned char rdatabuf[4] = { 192, 0, 2, 1 };
+	unsigned char wire[512];
+	/* header, "example./A/IN" and a compressed A record */
+	unsigned int size = DNS_MESSAGE_HEADERLEN + 13 + 16;
+	isc_buffer_t buf;
+	isc_region_t r;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	dns_test_namefromstring("example.", &example);
+	r = (isc_region_t){ .base = rdatabuf, .length = 4 };
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_a, &r);
+
+	/*
+	 * The answer takes exactly the space that is left.
+	 */
+	make_response(&msg, &rdata);
+	result = dns_compress_init(&cctx, -1, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_buffer_init(&buf, wire, size);
+	result = dns_message_renderbegin(msg, &cctx, &buf);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dns_message_sectionfits(msg, DNS_SECTION_ANSWER));
+	result = dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_buffer_usedlength(&buf), size);
+	result = dns_message_renderend(msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+	dns_message_detach(&msg);
+
+	/*
+	 * One byte less, and the answer is known not to fit.
+	 */
+	dns_rdata_init(&rdata);
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_a, &r);
+	make_response(&msg, &rdata);
+	result = dns_compress_init(&cctx, -1, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_buffer_init(&buf, wire, size - 1);
+	result = dns_message_renderbegin(msg, &cctx, &buf);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_false(dns_message_sectionfits(msg, DNS_SECTION_ANSWER));
+	result = dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0);
+	assert_int_equal(result, ISC_R_NOSPACE);
+	result = dns_message_renderend(msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+	dns_message_detach(&msg);
+}
+
+/* dns_message_getednsopt() finds options in and beyond its index */
+ISC_RUN_TEST_IMPL(dns_message_getednsopt) {
+	dns_message_t *msg = NULL;
+	dns_rdataset_t *opt = NULL;
+	dns_compress_t cctx;
+	dns_ednsopt_t ednsopts[DNS_MESSAGE_EDNSOPTS + 2];
+	unsigned char cookie[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	unsigned char wire[512];
+	isc_buffer_t buf;
+	isc_region_t region;
+	isc_result_t result;
+	size_t i;
+
+	UNUSED(state);
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, &msg);
+	result = dns_compress_init(&cctx, -1, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_buffer_init(&buf, wire, sizeof(wire));
+	result = dns_message_renderbegin(msg, &cctx, &buf);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_message_getednsopt(msg, DNS_OPT_COOKIE, &region);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	/*
+	 * A cookie, then more options than are indexed, the last of
+	 * them with some data.
+	 */
+	ednsopts[0] = (dns_ednsopt_t){ .code = DNS_OPT_COOKIE,
+				       .length = sizeof(cookie),
+				       .value = cookie };
+	for (i = 1; i < ARRAY_SIZE(ednsopts); i++) {
+		ednsopts[i] = (dns_ednsopt_t){ .code = 65000 + i };
+	}
+	ednsopts[i - 1].length = 4;
+	ednsopts[i - 1].value = cookie + 4;
+
+	result = dns_message_buildopt(msg, &opt, 0, 1232, 0, ednsopts,
+				      ARRAY_SIZE(ednsopts));
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_setopt(msg, opt);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_message_getednsopt(msg, DNS_OPT_COOKIE, &region);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(region.length, sizeof(cookie));
+	assert_memory_equal(region.base, cookie, sizeof(cookie));
+
+	result = dns_message_getednsopt(msg, 65001, &region);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(region.length, 0);
+
+	result = dns_message_getednsopt(msg, 65000 + i - 1, &region);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(region.length, 4);
+	assert_memory_equal(region.base, cookie + 4, 4);
+
+	result = dns_message_getednsopt(msg, DNS_OPT_PAD, &region);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	result = dns_message_renderend(msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+	dns_message_detach(&msg);
+}
+
+/* EDNS padding rounds the message up without overflowing the buffer */
+ISC_RUN_TEST_IMPL(dns_message_padding) {
+	dns_message_t *msg = NULL;
+	dns_rdataset_t *opt = NULL;
+	dns_compress_t cctx;
+	dns_ednsopt_t ednsopt = { .code = DNS_OPT_PAD };
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	unsigned char rdatabuf[4] = { 192, 0, 2, 1 };
+	unsigned char wire[512];
+	unsigned int sizes[] = { sizeof(wire), 100 };
+	unsigned int expect[] = { 128, 100 };
+	isc_buffer_t buf;
+	isc_region_t r;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	dns_test_namefromstring("example.", &example);
+	r = (isc_region_t){ .base = rdatabuf, .length = 4 };
+
+	for (size_t i = 0; i < ARRAY_SIZE(sizes); i++) {
+		dns_rdata_init(&rdata);
+		dns_rdata_fromregion(&rdata, dns_rdataclass_in,
+				     dns_rdatatype_a, &r);
+		make_response(&msg, &rdata);
+		dns_message_setpadding(msg, 128);
+		result = dns_message_buildopt(msg, &opt, 0, 1232, 0, &ednsopt,
+					      1);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_message_setopt(msg, opt);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		opt = NULL;
+
+		result = dns_compress_init(&cctx, -1, mctx);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		isc_buffer_init(&buf, wire, sizes[i]);
+		result = dns_message_renderbegin(msg, &cctx, &buf);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_message_rendersection(msg, DNS_SECTION_QUESTION,
+						   0);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_message_renderend(msg);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(isc_buffer_usedlength(&buf), expect[i]);
+		dns_compress_invalidate(&cctx);
+		dns_message_detach(&msg);
+	}
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(dns_message_savebuffer)
+ISC_TEST_ENTRY(dns_message_renderwire)
+ISC_TEST_ENTRY(dns_message_sectionfits)
+ISC_TEST_ENTRY(dns_message_getednsopt)
+ISC_TEST_ENTRY(dns_message_padding)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -271,6 +271,64 @@ ISC_RUN_TEST_IMPL(compression) {
 	dns_compress_invalidate(&cctx);
 }
 
+/* longest suffix compression test */
+ISC_RUN_TEST_IMPL(compression_suffix) {
+	dns_compress_t cctx;
+	dns_fixedname_t f1, f2, f3;
+	dns_name_t *name1 = dns_fixedname_initname(&f1);
+	dns_name_t *name2 = dns_fixedname_initname(&f2);
+	dns_name_t *name3 = dns_fixedname_initname(&f3);
+	isc_buffer_t source;
+	unsigned char buf[1024];
+	unsigned int used;
+
+	UNUSED(state);
+
+	assert_int_equal(dns_name_fromstring(name1, "a.b.c.d.example.", 0,
+					     NULL),
+			 ISC_R_SUCCESS);
+	assert_int_equal(dns_name_fromstring(name2, "x.y.C.D.example.", 0,
+					     NULL),
+			 ISC_R_SUCCESS);
+	assert_int_equal(dns_name_fromstring(name3, "z.example.", 0, NULL),
+			 ISC_R_SUCCESS);
+
+	assert_int_equal(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&source, buf, sizeof(buf));
+
+	assert_int_equal(dns_name_towire(name1, &cctx, &source), ISC_R_SUCCESS);
+	assert_int_equal(source.used, name1->length);
+
+	/* "x.y" followed by a pointer to "c.d.example". */
+	used = source.used;
+	assert_int_equal(dns_name_towire(name2, &cctx, &source), ISC_R_SUCCESS);
+	assert_int_equal(source.used - used, 4 + 2);
+	assert_int_equal(buf[source.used - 1], 4);
+
+	/* "z" followed by a pointer to "example". */
+	used = source.used;
+	assert_int_equal(dns_name_towire(name3, &cctx, &source), ISC_R_SUCCESS);
+	assert_int_equal(source.used - used, 2 + 2);
+	assert_int_equal(buf[source.used - 1], 8);
+
+	/* After a rollback "z.example" is rendered the same way again. */
+	dns_compress_rollback(&cctx, used);
+	source.used = used;
+	assert_int_equal(dns_name_towire(name3, &cctx, &source), ISC_R_SUCCESS);
+	assert_int_equal(source.used - used, 2 + 2);
+	assert_int_equal(buf[source.used - 1], 8);
+
+	/* The whole of "x.y.c.d.example" is now a single pointer. */
+	used = source.used;
+	assert_int_equal(dns_name_towire(name2, &cctx, &source), ISC_R_SUCCESS);
+	assert_int_equal(source.used - used, 2);
+	assert_int_equal(buf[source.used - 1], name1->length);
+
+	dns_compress_rollback(&cctx, 0);
+	dns_compress_invalidate(&cctx);
+}
+
 /* is trust-anchor-telemetry test */
 ISC_RUN_TEST_IMPL(istat) {
 	dns_fixedname_t fixed;
@@ -713,6 +771,7 @@ ISC_RUN_TEST_IMPL(benchmark) {
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(fullcompare)
 ISC_TEST_ENTRY(compression)
+ISC_TEST_ENTRY(compression_suffix)
 ISC_TEST_ENTRY(istat)
 ISC_TEST_ENTRY(init)
 ISC_TEST_ENTRY(invalidate)
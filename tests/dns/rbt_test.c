@@ -1067,6 +1067,331 @@ ISC_RUN_TEST_IMPL(rbt_deletename) {
 	test_context_teardown(ctx);
 }
 
+static void
+count_rehash(void *arg) {
+	unsigned int *calls = arg;
+
+	(*calls)++;
+}
+
+/* Test rehashing the hash table on behalf of the caller */
+ISC_RUN_TEST_IMPL(rbt_rehash) {
+	isc_result_t result;
+	dns_rbt_t *rbt = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	unsigned int calls = 0;
+	size_t hashsize;
+	char namebuf[32];
+	void *data = NULL;
+	static int value;
+
+	isc_mem_debugging = ISC_MEM_DEBUGRECORD;
+
+	result = dns_rbt_create(mctx, NULL, NULL, &rbt);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rbt_setrehashaction(rbt, count_rehash, &calls);
+	hashsize = dns_rbt_hashsize(rbt);
+
+	/* Adding names asks for a rehash once, and does not grow the table */
+	for (int i = 0; i < 1000; i++) {
+		snprintf(namebuf, sizeof(namebuf), "name%d.", i);
+		dns_test_namefromstring(namebuf, &fname);
+		name = dns_fixedname_name(&fname);
+		result = dns_rbt_addname(rbt, name, &value);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	assert_int_equal(calls, 1);
+	assert_int_equal(dns_rbt_hashsize(rbt), hashsize);
+
+	/* The first slice grows the table, and the names can still be found */
+	result = dns_rbt_rehash(rbt, 1);
+	assert_int_equal(result, ISC_R_QUOTA);
+	assert_true(dns_rbt_hashsize(rbt) > hashsize);
+	for (int i = 0; i < 1000; i++) {
+		snprintf(namebuf, sizeof(namebuf), "name%d.", i);
+		dns_test_namefromstring(namebuf, &fname);
+		name = dns_fixedname_name(&fname);
+		data = NULL;
+		result = dns_rbt_findname(rbt, name, 0, NULL, &data);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(data, &value);
+	}
+
+	do {
+		result = dns_rbt_rehash(rbt, 1);
+	} while (result == ISC_R_QUOTA);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Once done, more names may ask for another rehash */
+	for (int i = 1000; i < 4000; i++) {
+		snprintf(namebuf, sizeof(namebuf), "name%d.", i);
+		dns_test_namefromstring(namebuf, &fname);
+		name = dns_fixedname_name(&fname);
+		result = dns_rbt_addname(rbt, name, &value);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	assert_int_equal(calls, 2);
+
+	dns_rbt_destroy(&rbt);
+}
+
+/* Test that a size hint grows the hash table ahead of the names */
+ISC_RUN_TEST_IMPL(rbt_sizehint) {
+	isc_result_t result;
+	dns_rbt_t *rbt = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	size_t hashsize;
+	char namebuf[32];
+	void *data = NULL;
+	static int value;
+
+	isc_mem_debugging = ISC_MEM_DEBUGRECORD;
+
+	result = dns_rbt_create(mctx, NULL, NULL, &rbt);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (int i = 0; i < 10; i++) {
+		snprintf(namebuf, sizeof(namebuf), "name%d.", i);
+		dns_test_namefromstring(namebuf, &fname);
+		name = dns_fixedname_name(&fname);
+		result = dns_rbt_addname(rbt, name, &value);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	hashsize = dns_rbt_hashsize(rbt);
+
+	/* The table grows at once, and existing names can still be found */
+	dns_rbt_sizehint(rbt, 10000);
+	assert_true(dns_rbt_hashsize(rbt) > hashsize);
+	hashsize = dns_rbt_hashsize(rbt);
+	for (int i = 0; i < 10; i++) {
+		snprintf(namebuf, sizeof(namebuf), "name%d.", i);
+		dns_test_namefromstring(namebuf, &fname);
+		name = dns_fixedname_name(&fname);
+		data = NULL;
+		result = dns_rbt_findname(rbt, name, 0, NULL, &data);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(data, &value);
+	}
+
+	/* Adding the hinted number of names does not grow it again */
+	for (int i = 10; i < 10000; i++) {
+		snprintf(namebuf, sizeof(namebuf), "name%d.", i);
+		dns_test_namefromstring(namebuf, &fname);
+		name = dns_fixedname_name(&fname);
+		result = dns_rbt_addname(rbt, name, &value);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	assert_int_equal(dns_rbt_hashsize(rbt), hashsize);
+
+	/* A smaller hint does not shrink it */
+	dns_rbt_sizehint(rbt, 10);
+	assert_int_equal(dns_rbt_hashsize(rbt), hashsize);
+
+	dns_rbt_destroy(&rbt);
+}
+
+static isc_result_t
+addfrom_both(dns_rbt_t *ref, dns_rbt_t *rbt, const char *namestr,
+	     dns_rbtnode_t **fingerp) {
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	dns_rbtnode_t *node = NULL;
+	isc_result_t refresult, result;
+
+	dns_test_namefromstring(namestr, &fname);
+	name = dns_fixedname_name(&fname);
+
+	refresult = dns_rbt_addnode(ref, name, &node);
+	node = NULL;
+	result = dns_rbt_addnodefrom(rbt, *fingerp, name, &node);
+	assert_int_equal(result, refresult);
+	if (result == ISC_R_SUCCESS || result == ISC_R_EXISTS) {
+		*fingerp = node;
+	}
+
+	return (result);
+}
+
+/* Test adding names next to the previous one */
+ISC_RUN_TEST_IMPL(rbt_addnodefrom) {
+	static const char *labels[] = { "a", "b", "c", "d", "e" };
+	dns_rbt_t *ref = NULL, *rbt = NULL;
+	dns_rbtnodechain_t refchain, chain;
+	dns_rbtnode_t *finger = NULL, *refnode = NULL, *node = NULL;
+	dns_fixedname_t frefname, fname;
+	dns_name_t *refname = NULL, *name = NULL;
+	isc_result_t result, refresult;
+	char namebuf[DNS_NAME_FORMATSIZE];
+	unsigned int n = 0;
+
+	isc_mem_debugging = ISC_MEM_DEBUGRECORD;
+
+	result = dns_rbt_create(mctx, NULL, NULL, &ref);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_rbt_create(mctx, NULL, NULL, &rbt);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/*
+	 * Names in canonical order, leaving some of them out so that
+	 * multi-label nodes are created and later split.
+	 */
+	(void)addfrom_both(ref, rbt, "example.", &finger);
+	for (size_t z = 0; z < ARRAY_SIZE(labels); z++) {
+		if (z % 2 == 0) {
+			snprintf(namebuf, sizeof(namebuf), "%s.example.",
+				 labels[z]);
+			(void)addfrom_both(ref, rbt, namebuf, &finger);
+		}
+		for (size_t y = 0; y < ARRAY_SIZE(labels); y++) {
+			if ((y + z) % 3 != 0) {
+				snprintf(namebuf, sizeof(namebuf),
+					 "%s.%s.example.", labels[y],
+					 labels[z]);
+				(void)addfrom_both(ref, rbt, namebuf, &finger);
+			}
+			for (size_t x = 0; x < ARRAY_SIZE(labels); x++) {
+				if ((x * 7 + y * 3 + z) % 4 == 0) {
+					continue;
+				}
+				snprintf(namebuf, sizeof(namebuf),
+					 "%s.%s.%s.example.", labels[x],
+					 labels[y], labels[z]);
+				(void)addfrom_both(ref, rbt, namebuf, &finger);
+			}
+		}
+	}
+
+	/* Then names in no particular order, and some already there */
+	for (int i = 0; i < 500; i++) {
+		snprintf(namebuf, sizeof(namebuf), "%s.%s.%s.%s.example.",
+			 labels[isc_random_uniform(ARRAY_SIZE(labels))],
+			 labels[isc_random_uniform(ARRAY_SIZE(labels))],
+			 labels[isc_random_uniform(ARRAY_SIZE(labels))],
+			 labels[isc_random_uniform(ARRAY_SIZE(labels))]);
+		(void)addfrom_both(ref, rbt, namebuf + 2 * (i % 4), &finger);
+	}
+
+	assert_int_equal(dns_rbt_nodecount(rbt), dns_rbt_nodecount(ref));
+	assert_true(dns__rbt_checkproperties(rbt));
+
+	/* Both trees hold the same names in the same order */
+	refname = dns_fixedname_initname(&frefname);
+	name = dns_fixedname_initname(&fname);
+	dns_rbtnodechain_init(&refchain);
+	dns_rbtnodechain_init(&chain);
+	refresult = dns_rbtnodechain_first(&refchain, ref, NULL, NULL);
+	result = dns_rbtnodechain_first(&chain, rbt, NULL, NULL);
+	while (refresult == ISC_R_SUCCESS || refresult == DNS_R_NEWORIGIN) {
+		assert_int_equal(result, refresult);
+		refnode = node = NULL;
+		dns_rbtnodechain_current(&refchain, NULL, NULL, &refnode);
+		dns_rbtnodechain_current(&chain, NULL, NULL, &node);
+		assert_int_equal(dns_rbt_fullnamefromnode(refnode, refname),
+				 ISC_R_SUCCESS);
+		assert_int_equal(dns_rbt_fullnamefromnode(node, name),
+				 ISC_R_SUCCESS);
+		assert_true(dns_name_equal(refname, name));
+		n++;
+		refresult = dns_rbtnodechain_next(&refchain, NULL, NULL);
+		result = dns_rbtnodechain_next(&chain, NULL, NULL);
+	}
+	assert_int_equal(refresult, ISC_R_NOMORE);
+	assert_int_equal(result, ISC_R_NOMORE);
+	assert_int_equal(n, dns_rbt_nodecount(rbt));
+
+	dns_rbtnodechain_invalidate(&refchain);
+	dns_rbtnodechain_invalidate(&chain);
+	dns_rbt_destroy(&ref);
+	dns_rbt_destroy(&rbt);
+}
+
+/* Test that kept absolute names match the assembled ones */
+ISC_RUN_TEST_IMPL(rbt_fullnames) {
+	static const char *names[] = {
+		"d.c.b.a.EXAMPLE.", "c.B.a.example.", "x.c.b.A.example.",
+		"Example.",	    "b.a.example.",   "y.b.a.example.",
+		"a.Example.",	    "z.example.",
+	};
+	dns_rbt_t *ref = NULL, *rbt = NULL;
+	dns_rbtnodechain_t chain;
+	dns_rbtnode_t *node = NULL;
+	dns_fixedname_t fname, frefname, ffound;
+	dns_name_t *name = NULL, *refname = NULL, *found = NULL;
+	isc_result_t result;
+
+	isc_mem_debugging = ISC_MEM_DEBUGRECORD;
+
+	result = dns_rbt_create(mctx, NULL, NULL, &ref);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_rbt_create(mctx, NULL, NULL, &rbt);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rbt_setfullnames(rbt);
+
+	/* This order splits nodes several times */
+	for (size_t i = 0; i < ARRAY_SIZE(names); i++) {
+		dns_test_namefromstring(names[i], &fname);
+		name = dns_fixedname_name(&fname);
+		node = NULL;
+		assert_int_equal(dns_rbt_addnode(ref, name, &node),
+				 ISC_R_SUCCESS);
+		node = NULL;
+		assert_int_equal(dns_rbt_addnode(rbt, name, &node),
+				 ISC_R_SUCCESS);
+		assert_non_null(node->fullname);
+		node->data = node;
+	}
+	assert_int_equal(dns_rbt_nodecount(rbt), dns_rbt_nodecount(ref));
+
+	/* Every node has the name, and case, it would be given anyway */
+	name = dns_fixedname_initname(&fname);
+	refname = dns_fixedname_initname(&frefname);
+	found = dns_fixedname_initname(&ffound);
+	dns_rbtnodechain_init(&chain);
+	result = dns_rbtnodechain_first(&chain, rbt, NULL, NULL);
+	while (result == ISC_R_SUCCESS || result == DNS_R_NEWORIGIN) {
+		dns_rbtnode_t *refnode = NULL;
+
+		node = NULL;
+		dns_rbtnodechain_current(&chain, NULL, NULL, &node);
+		assert_non_null(node->fullname);
+		assert_int_equal(dns_rbt_fullnamefromnode(node, name),
+				 ISC_R_SUCCESS);
+
+		assert_int_equal(dns_rbt_findnode(ref, name, NULL, &refnode,
+						  NULL, DNS_RBTFIND_EMPTYDATA,
+						  NULL, NULL),
+				 ISC_R_SUCCESS);
+		assert_int_equal(dns_rbt_fullnamefromnode(refnode, refname),
+				 ISC_R_SUCCESS);
+		assert_true(dns_name_caseequal(name, refname));
+
+		node = NULL;
+		assert_int_equal(dns_rbt_findnode(rbt, name, found, &node,
+						  NULL, DNS_RBTFIND_EMPTYDATA,
+						  NULL, NULL),
+				 ISC_R_SUCCESS);
+		assert_true(dns_name_caseequal(found, refname));
+
+		result = dns_rbtnodechain_next(&chain, NULL, NULL);
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+
+	/* A partial match yields the name of the closest enclosing node */
+	dns_test_namefromstring("q.y.b.a.example.", &fname);
+	node = NULL;
+	result = dns_rbt_findnode(rbt, dns_fixedname_name(&fname), found,
+				  &node, NULL, 0, NULL, NULL);
+	assert_int_equal(result, DNS_R_PARTIALMATCH);
+	dns_test_namefromstring("y.b.a.example.", &frefname);
+	assert_true(dns_name_equal(found, dns_fixedname_name(&frefname)));
+
+	dns_rbtnodechain_invalidate(&chain);
+	dns_rbt_destroy(&ref);
+	dns_rbt_destroy(&rbt);
+}
+
 /* Test nodechain */
 ISC_RUN_TEST_IMPL(rbt_nodechain) {
 	isc_result_t result;
@@ -1289,6 +1614,10 @@ ISC_TEST_ENTRY(rbt_insert_and_remove)
 ISC_TEST_ENTRY(rbt_findname)
 ISC_TEST_ENTRY(rbt_addname)
 ISC_TEST_ENTRY(rbt_deletename)
+ISC_TEST_ENTRY(rbt_rehash)
+ISC_TEST_ENTRY(rbt_sizehint)
+ISC_TEST_ENTRY(rbt_addnodefrom)
+ISC_TEST_ENTRY(rbt_fullnames)
 ISC_TEST_ENTRY(rbt_nodechain)
 ISC_TEST_ENTRY(rbtnode_namelen)
 #if defined(DNS_BENCHMARK_TESTS) && !defined(__SANITIZE_THREAD__)
@@ -23,8 +23,12 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/buffer.h>
 #include <isc/util.h>
 
+#include <dns/compress.h>
+#include <dns/name.h>
+#include <dns/rdatalist.h>
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 
@@ -101,8 +105,105 @@ ISC_RUN_TEST_IMPL(trimttl) {
 	assert_int_equal(sigrdataset.ttl, 0);
 }
 
+#define NRDATA 6
+#define RRSIZE 15 /* root owner, type, class, TTL, rdlen and an address */
+
+/*
+ * Render 'rdataset' owned by the root and return the last octet of each
+ * address in the order they were rendered.
+ */
+static void
+render(dns_rdataset_t *rdataset, dns_rdatasetorderfunc_t order,
+       unsigned char *last) {
+	unsigned char buf[NRDATA * RRSIZE];
+	isc_buffer_t target;
+	dns_compress_t cctx;
+	unsigned int count = 0;
+	isc_result_t result;
+
+	isc_buffer_init(&target, buf, sizeof(buf));
+	result = dns_compress_init(&cctx, -1, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_rdataset_towiresorted(rdataset, dns_rootname, &cctx,
+					   &target, order, NULL, 0, &count);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(count, NRDATA);
+	assert_int_equal(isc_buffer_usedlength(&target), NRDATA * RRSIZE);
+
+	for (size_t i = 0; i < NRDATA; i++) {
+		last[i] = buf[i * RRSIZE + RRSIZE - 1];
+	}
+
+	dns_compress_invalidate(&cctx);
+}
+
+static int
+odd_first(const dns_rdata_t *rdata, const void *arg) {
+	UNUSED(arg);
+
+	return ((rdata->data[3] % 2 == 1) ? 0 : 1);
+}
+
+/* records are rendered in cyclic, random and sortlist order */
+ISC_RUN_TEST_IMPL(towire_order) {
+	unsigned char data[NRDATA][4];
+	dns_rdata_t rdata[NRDATA];
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	unsigned char last[NRDATA];
+	unsigned int seen = 0;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 300;
+	for (size_t i = 0; i < NRDATA; i++) {
+		isc_region_t region = { data[i], sizeof(data[i]) };
+
+		data[i][0] = 192;
+		data[i][1] = 0;
+		data[i][2] = 2;
+		data[i][3] = i;
+		dns_rdata_init(&rdata[i]);
+		dns_rdata_fromregion(&rdata[i], dns_rdataclass_in,
+				     dns_rdatatype_a, &region);
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata[i], link);
+	}
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Cyclic order starts at the rdataset's count. */
+	rdataset.attributes |= DNS_RDATASETATTR_CYCLIC;
+	rdataset.count = 8;
+	render(&rdataset, NULL, last);
+	assert_memory_equal(last, ((unsigned char[]){ 2, 3, 4, 5, 0, 1 }),
+			    NRDATA);
+
+	/* A sortlist keeps the cyclic order between equal keys. */
+	render(&rdataset, odd_first, last);
+	assert_memory_equal(last, ((unsigned char[]){ 3, 5, 1, 2, 4, 0 }),
+			    NRDATA);
+
+	/* Random order renders every record once. */
+	rdataset.attributes &= ~DNS_RDATASETATTR_CYCLIC;
+	rdataset.attributes |= DNS_RDATASETATTR_RANDOMIZE;
+	render(&rdataset, NULL, last);
+	for (size_t i = 0; i < NRDATA; i++) {
+		seen |= 1 << last[i];
+	}
+	assert_int_equal(seen, (1 << NRDATA) - 1);
+
+	dns_rdataset_disassociate(&rdataset);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(trimttl)
+ISC_TEST_ENTRY(towire_order)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
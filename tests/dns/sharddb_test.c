@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/util.h>
+
+#include <dns/cache.h>
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/name.h>
+#include <dns/rbt.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include "sharddb.h"
+
+#include <tests/dns.h>
+
+#define NSHARDS 4
+#define NNAMES	200
+
+static void
+addrdata(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+	 const char *text) {
+	dns_fixedname_t fname;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	unsigned char buf[256];
+	isc_result_t result;
+
+	result = dns_test_rdatafromstring(&rdata, dns_rdataclass_in, type, buf,
+					  sizeof(buf), text, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.ttl = 3600;
+	rdatalist.type = type;
+	rdatalist.rdclass = dns_rdataclass_in;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	rdataset.trust = dns_trust_authanswer;
+
+	dns_test_namefromstring(owner, &fname);
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, 0, &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static isc_result_t
+finda(dns_db_t *db, const char *owner, dns_name_t *foundname) {
+	dns_fixedname_t fname;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fname);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL,
+			     dns_rdatatype_a, 0, 0, &node, foundname,
+			     &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+
+	return (result);
+}
+
+static unsigned int
+shardof(dns_db_t *db, const char *owner) {
+	dns_fixedname_t fname;
+	dns_dbnode_t *node = NULL;
+	unsigned int shard;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fname);
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	shard = ((dns_rbtnode_t *)node)->shard;
+	dns_db_detachnode(db, &node);
+
+	return (shard);
+}
+
+static void
+makename(char *buf, size_t size, unsigned int i) {
+	static const char *tlds[] = { "com", "net", "org" };
+
+	snprintf(buf, size, "host%u.domain%u.%s", i, i % 17, tlds[i % 3]);
+}
+
+/* names are found in whichever shard they were put in */
+ISC_RUN_TEST_IMPL(sharddb_find) {
+	dns_db_t *db = NULL;
+	dns_fixedname_t ffound;
+	dns_name_t *foundname = dns_fixedname_initname(&ffound);
+	bool used[NSHARDS] = { false };
+	isc_result_t result;
+	char namebuf[64];
+
+	UNUSED(state);
+
+	result = dns_sharddb_create(mctx, mctx, dns_rdataclass_in, NSHARDS,
+				    &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dns_db_iscache(db));
+
+	for (unsigned int i = 0; i < NNAMES; i++) {
+		makename(namebuf, sizeof(namebuf), i);
+		addrdata(db, namebuf, dns_rdatatype_a, "10.0.0.1");
+	}
+
+	for (unsigned int i = 0; i < NNAMES; i++) {
+		makename(namebuf, sizeof(namebuf), i);
+		result = finda(db, namebuf, foundname);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		used[shardof(db, namebuf)] = true;
+	}
+
+	/* Names below the same second level domain stay together */
+	assert_int_equal(shardof(db, "host0.domain0.com"),
+			 shardof(db, "domain0.com"));
+	assert_int_equal(shardof(db, "a.b.host0.domain0.com"),
+			 shardof(db, "domain0.com"));
+
+	/* 51 domains should use more than one shard */
+	assert_true(used[0] + used[1] + used[2] + used[3] > 1);
+
+	result = finda(db, "missing.domain0.com", foundname);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	assert_true(dns_db_nodecount(db, dns_dbtree_main) > NNAMES);
+
+	dns_db_detach(&db);
+}
+
+/* delegations kept in the shard of an ancestor are found */
+ISC_RUN_TEST_IMPL(sharddb_delegation) {
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t ffound, fname, fdc;
+	dns_name_t *foundname = dns_fixedname_initname(&ffound);
+	dns_name_t *dcname = dns_fixedname_initname(&fdc);
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+	unsigned int comshard;
+	char namebuf[64];
+	unsigned int i;
+
+	UNUSED(state);
+
+	result = dns_sharddb_create(mctx, mctx, dns_rdataclass_in, NSHARDS,
+				    &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	addrdata(db, "com", dns_rdatatype_ns, "ns.com.");
+	comshard = shardof(db, "com");
+
+	/* Find a domain that lives in another shard than its parent */
+	for (i = 0; i < 100; i++) {
+		snprintf(namebuf, sizeof(namebuf), "www.example%u.com", i);
+		if (shardof(db, namebuf) != comshard) {
+			break;
+		}
+	}
+	assert_int_not_equal(i, 100);
+
+	result = finda(db, namebuf, foundname);
+	assert_int_equal(result, DNS_R_DELEGATION);
+	dns_test_namefromstring("com", &fname);
+	assert_true(dns_name_equal(foundname, dns_fixedname_name(&fname)));
+
+	dns_test_namefromstring(namebuf, &fname);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findzonecut(db, dns_fixedname_name(&fname), 0, 0,
+				    &node, foundname, dcname, &rdataset, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(rdataset.type, dns_rdatatype_ns);
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+	dns_test_namefromstring("com", &fname);
+	assert_true(dns_name_equal(foundname, dns_fixedname_name(&fname)));
+
+	/* A closer delegation in the name's own shard wins */
+	snprintf(namebuf, sizeof(namebuf), "example%u.com", i);
+	addrdata(db, namebuf, dns_rdatatype_ns, "ns.example.");
+	snprintf(namebuf, sizeof(namebuf), "www.example%u.com", i);
+	result = finda(db, namebuf, foundname);
+	assert_int_equal(result, DNS_R_DELEGATION);
+	assert_int_equal(dns_name_countlabels(foundname), 3);
+
+	dns_db_detach(&db);
+}
+
+/* iterators return the names of all shards in DNSSEC order */
+ISC_RUN_TEST_IMPL(sharddb_iterate) {
+	dns_db_t *db = NULL;
+	dns_dbiterator_t *iter = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fprev, fname, fseek;
+	dns_name_t *prev = dns_fixedname_initname(&fprev);
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	unsigned int found = 0;
+	isc_result_t result;
+	char namebuf[64];
+
+	UNUSED(state);
+
+	result = dns_sharddb_create(mctx, mctx, dns_rdataclass_in, NSHARDS,
+				    &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (unsigned int i = 0; i < NNAMES; i++) {
+		makename(namebuf, sizeof(namebuf), i);
+		addrdata(db, namebuf, dns_rdatatype_a, "10.0.0.1");
+	}
+
+	result = dns_db_createiterator(db, 0, &iter);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_name_copy(dns_rootname, prev);
+	for (result = dns_dbiterator_first(iter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(iter))
+	{
+		dns_rdataset_t rdataset;
+
+		result = dns_dbiterator_current(iter, &node, name);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_true(dns_name_isabsolute(name));
+		assert_true(dns_name_compare(prev, name) <= 0);
+		dns_name_copy(name, prev);
+
+		dns_rdataset_init(&rdataset);
+		result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_a,
+					     0, 0, &rdataset, NULL);
+		if (result == ISC_R_SUCCESS) {
+			found++;
+			dns_rdataset_disassociate(&rdataset);
+		}
+		dns_db_detachnode(db, &node);
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	assert_int_equal(found, NNAMES);
+
+	/* Seeking goes to the first name at or after the one given */
+	dns_test_namefromstring("domain5.org", &fseek);
+	result = dns_dbiterator_seek(iter, dns_fixedname_name(&fseek));
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_current(iter, &node, name);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	assert_true(dns_name_equal(name, dns_fixedname_name(&fseek)));
+
+	dns_test_namefromstring("domain5a.org", &fseek);
+	result = dns_dbiterator_seek(iter, dns_fixedname_name(&fseek));
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_current(iter, &node, name);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	assert_true(dns_name_compare(name, dns_fixedname_name(&fseek)) > 0);
+
+	assert_int_equal(dns_dbiterator_prev(iter), ISC_R_NOTIMPLEMENTED);
+	assert_int_equal(dns_dbiterator_last(iter), ISC_R_NOTIMPLEMENTED);
+
+	dns_dbiterator_destroy(&iter);
+	dns_db_detach(&db);
+}
+
+/* a cache made of shards can be flushed by name and by tree */
+ISC_RUN_TEST_IMPL(sharddb_flushtree) {
+	dns_cache_t *cache = NULL;
+	dns_db_t *db = NULL;
+	dns_fixedname_t ffound, fname;
+	dns_name_t *foundname = dns_fixedname_initname(&ffound);
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_cache_create(mctx, mctx, NULL, NULL, dns_rdataclass_in,
+				  "", "rbt", 0, NULL, NSHARDS, &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_cache_getshards(cache), NSHARDS);
+	dns_cache_attachdb(cache, &db);
+
+	addrdata(db, "example.com", dns_rdatatype_a, "10.0.0.1");
+	addrdata(db, "www.example.com", dns_rdatatype_a, "10.0.0.2");
+	addrdata(db, "a.b.example.com", dns_rdatatype_a, "10.0.0.3");
+	addrdata(db, "example.net", dns_rdatatype_a, "10.0.0.4");
+	addrdata(db, "www.example.net", dns_rdatatype_a, "10.0.0.5");
+	addrdata(db, "xexample.com", dns_rdatatype_a, "10.0.0.6");
+
+	dns_test_namefromstring("example.com", &fname);
+	result = dns_cache_flushnode(cache, dns_fixedname_name(&fname), true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	assert_int_equal(finda(db, "example.com", foundname), ISC_R_NOTFOUND);
+	assert_int_equal(finda(db, "www.example.com", foundname),
+			 ISC_R_NOTFOUND);
+	assert_int_equal(finda(db, "a.b.example.com", foundname),
+			 ISC_R_NOTFOUND);
+	assert_int_equal(finda(db, "example.net", foundname), ISC_R_SUCCESS);
+	assert_int_equal(finda(db, "www.example.net", foundname),
+			 ISC_R_SUCCESS);
+	assert_int_equal(finda(db, "xexample.com", foundname), ISC_R_SUCCESS);
+
+	dns_test_namefromstring("net", &fname);
+	result = dns_cache_flushnode(cache, dns_fixedname_name(&fname), true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(finda(db, "example.net", foundname), ISC_R_NOTFOUND);
+	assert_int_equal(finda(db, "www.example.net", foundname),
+			 ISC_R_NOTFOUND);
+	assert_int_equal(finda(db, "xexample.com", foundname), ISC_R_SUCCESS);
+
+	dns_db_detach(&db);
+
+	/* Flushing the whole cache replaces the database */
+	result = dns_cache_flush(cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_cache_attachdb(cache, &db);
+	assert_int_equal(finda(db, "xexample.com", foundname), ISC_R_NOTFOUND);
+	addrdata(db, "xexample.com", dns_rdatatype_a, "10.0.0.6");
+	assert_int_equal(finda(db, "xexample.com", foundname), ISC_R_SUCCESS);
+	dns_db_detach(&db);
+
+	dns_cache_detach(&cache);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(sharddb_find)
+ISC_TEST_ENTRY(sharddb_delegation)
+ISC_TEST_ENTRY(sharddb_iterate)
+ISC_TEST_ENTRY(sharddb_flushtree)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/result.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/ssu.h>
+
+#include <tests/dns.h>
+
+static void
+addrule(dns_ssutable_t *table, bool grant, const char *identity,
+	dns_ssumatchtype_t matchtype, const char *name, dns_rdatatype_t type) {
+	dns_fixedname_t fidentity, fname;
+	dns_ssuruletype_t types[1] = { { type, 0 } };
+	isc_result_t result;
+
+	result = dns_test_namefromstring(identity, &fidentity);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_test_namefromstring(name, &fname);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_ssutable_addrule(table, grant, dns_fixedname_name(&fidentity),
+			     matchtype, dns_fixedname_name(&fname),
+			     type == dns_rdatatype_none ? 0 : 1, types);
+}
+
+/*
+ * Check an update of 'type' at 'name' signed by 'signer'; if it is
+ * granted, return the matching rule in '*rulep'.
+ */
+static bool
+check(dns_ssutable_t *table, const char *signer, const char *name,
+      dns_rdatatype_t type, const dns_ssurule_t **rulep) {
+	dns_fixedname_t fsigner, fname;
+	isc_result_t result;
+
+	result = dns_test_namefromstring(signer, &fsigner);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_test_namefromstring(name, &fname);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (dns_ssutable_checkrules(
+		table, dns_fixedname_name(&fsigner), dns_fixedname_name(&fname),
+		NULL, false, NULL, type, NULL, NULL, rulep));
+}
+
+/* rules are applied in order, whether they are indexed or not */
+ISC_RUN_TEST_IMPL(dns_ssutable_checkrules) {
+	dns_ssutable_t *table = NULL;
+	const dns_ssurule_t *rule = NULL;
+
+	dns_ssutable_create(mctx, &table);
+
+	addrule(table, false, "a.example.", dns_ssumatchtype_name,
+		"h1.example.", dns_rdatatype_none);
+	addrule(table, false, "*.example.", dns_ssumatchtype_name,
+		"secret.example.", dns_rdatatype_none);
+	addrule(table, true, "b.example.", dns_ssumatchtype_name,
+		"h2.example.", dns_rdatatype_a);
+	addrule(table, true, "a.example.", dns_ssumatchtype_subdomain,
+		"example.", dns_rdatatype_none);
+	addrule(table, true, "*.example.", dns_ssumatchtype_subdomain,
+		"sub.example.", dns_rdatatype_none);
+
+	assert_false(check(table, "a.example.", "h1.example.", dns_rdatatype_a,
+			   NULL));
+	assert_false(check(table, "a.example.", "secret.example.",
+			   dns_rdatatype_a, NULL));
+	assert_true(check(table, "a.example.", "h3.example.", dns_rdatatype_a,
+			  &rule));
+	assert_int_equal(dns_ssurule_matchtype(rule),
+			 dns_ssumatchtype_subdomain);
+	assert_false(check(table, "a.example.", "other.", dns_rdatatype_a,
+			   NULL));
+
+	/* Identities are matched regardless of case. */
+	rule = NULL;
+	assert_true(check(table, "B.EXAMPLE.", "h2.example.", dns_rdatatype_a,
+			  &rule));
+	assert_int_equal(dns_ssurule_matchtype(rule), dns_ssumatchtype_name);
+	assert_false(check(table, "b.example.", "h2.example.",
+			   dns_rdatatype_txt, NULL));
+
+	rule = NULL;
+	assert_true(check(table, "b.example.", "x.sub.example.",
+			  dns_rdatatype_txt, &rule));
+	assert_true(dns_name_iswildcard(dns_ssurule_identity(rule)));
+	assert_false(check(table, "c.example.", "secret.example.",
+			   dns_rdatatype_a, NULL));
+	assert_false(check(table, "c.example.", "h3.example.", dns_rdatatype_a,
+			   NULL));
+
+	/* Updates that are not signed match no rule. */
+	assert_false(dns_ssutable_checkrules(
+		table, NULL, dns_rootname, NULL, false, NULL, dns_rdatatype_a,
+		NULL, NULL, NULL));
+
+	dns_ssutable_detach(&table);
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(dns_ssutable_checkrules)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -33,6 +33,7 @@
 #include <isc/util.h>
 
 #include <dns/db.h>
+#include <dns/fixedname.h>
 #include <dns/name.h>
 #include <dns/view.h>
 #include <dns/zone.h>
@@ -149,6 +150,80 @@ ISC_RUN_TEST_IMPL(dns_zt_apply) {
 	dns_zone_detach(&zone);
 }
 
+/*
+ * Find 'name' in 'zt'; check the result, and the origin of the zone
+ * found against 'origin'.
+ */
+static void
+check_find(dns_zt_t *zt, const char *name, unsigned int options,
+	   isc_result_t expect, const char *origin) {
+	dns_fixedname_t fname, ffound, forigin;
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	dns_zone_t *zone = NULL;
+	isc_result_t result;
+
+	result = dns_test_namefromstring(name, &fname);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_zt_find(zt, dns_fixedname_name(&fname), options, found,
+			     &zone);
+	assert_int_equal(result, expect);
+	if (origin == NULL) {
+		assert_null(zone);
+		return;
+	}
+
+	result = dns_test_namefromstring(origin, &forigin);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dns_name_equal(found, dns_fixedname_name(&forigin)));
+	assert_true(dns_name_equal(dns_zone_getorigin(zone),
+				   dns_fixedname_name(&forigin)));
+	dns_zone_detach(&zone);
+}
+
+/* find the deepest zone for a name */
+ISC_RUN_TEST_IMPL(dns_zt_find) {
+	isc_result_t result;
+	dns_zt_t *zt = NULL;
+	dns_zone_t *example = NULL, *sub = NULL;
+
+	UNUSED(state);
+
+	result = dns_zt_create(mctx, dns_rdataclass_in, &zt);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_test_makezone("example.", &example, NULL, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_test_makezone("Sub.Example.", &sub, NULL, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_zt_mount(zt, example);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_zt_mount(zt, sub);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_zt_mount(zt, sub);
+	assert_int_equal(result, ISC_R_EXISTS);
+
+	check_find(zt, "example.", 0, ISC_R_SUCCESS, "example.");
+	check_find(zt, "sub.example.", 0, ISC_R_SUCCESS, "sub.example.");
+	check_find(zt, "WWW.SUB.EXAMPLE.", 0, DNS_R_PARTIALMATCH,
+		   "sub.example.");
+	check_find(zt, "www.example.", 0, DNS_R_PARTIALMATCH, "example.");
+	check_find(zt, "sub.example.", DNS_ZTFIND_NOEXACT, DNS_R_PARTIALMATCH,
+		   "example.");
+	check_find(zt, "example.", DNS_ZTFIND_NOEXACT, ISC_R_NOTFOUND, NULL);
+	check_find(zt, "example.org.", 0, ISC_R_NOTFOUND, NULL);
+	check_find(zt, ".", 0, ISC_R_NOTFOUND, NULL);
+
+	result = dns_zt_unmount(zt, sub);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	check_find(zt, "www.sub.example.", 0, DNS_R_PARTIALMATCH, "example.");
+
+	dns_zt_detach(&zt);
+	dns_zone_detach(&sub);
+	dns_zone_detach(&example);
+}
+
 /* asynchronous zone load */
 ISC_RUN_TEST_IMPL(dns_zt_asyncload_zone) {
 	isc_result_t result;
@@ -344,6 +419,7 @@ ISC_RUN_TEST_IMPL(dns_zt_asyncload_zt) {
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY_CUSTOM(dns_zt_apply, _setup, _teardown)
+ISC_TEST_ENTRY_CUSTOM(dns_zt_find, _setup, _teardown)
 ISC_TEST_ENTRY_CUSTOM(dns_zt_asyncload_zone, _setup, _teardown)
 ISC_TEST_ENTRY_CUSTOM(dns_zt_asyncload_zt, _setup, _teardown)
 
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/* ! \file */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/ascii.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+/* every byte value against the obvious definition */
+ISC_RUN_TEST_IMPL(isc_ascii_tolower8) {
+	for (unsigned int c = 0; c < 256; c++) {
+		uint8_t bytes[8], lower[8];
+		uint64_t word;
+
+		for (unsigned int i = 0; i < 8; i++) {
+			bytes[i] = (uint8_t)(c + i * 37);
+		}
+		memmove(&word, bytes, sizeof(word));
+		word = isc_ascii_tolower8(word);
+		memmove(lower, &word, sizeof(lower));
+
+		for (unsigned int i = 0; i < 8; i++) {
+			uint8_t b = bytes[i];
+			uint8_t expect = (b >= 'A' && b <= 'Z') ? b + 32 : b;
+			assert_int_equal(lower[i], expect);
+			assert_int_equal(isc_ascii_tolower(b), expect);
+		}
+	}
+}
+
+/* equality and ordering at every length and alignment */
+ISC_RUN_TEST_IMPL(isc_ascii_lowercmp) {
+	const uint8_t upper[] = "\x07" "EXAMPLE\x03" "COM-WITH-A-LONG-LABEL";
+	const uint8_t lower[] = "\x07" "example\x03" "com-with-a-long-label";
+	uint8_t copy[sizeof(upper)];
+
+	for (unsigned int off = 0; off < 8; off++) {
+		for (unsigned int len = 0; len + off < sizeof(upper); len++) {
+			assert_true(isc_ascii_lowerequal(upper + off,
+							 lower + off, len));
+			assert_int_equal(
+				isc_ascii_lowercmp(upper + off, lower + off,
+						   len),
+				0);
+
+			isc_ascii_lowercopy(copy, upper + off, len);
+			assert_memory_equal(copy, lower + off, len);
+		}
+	}
+
+	memmove(copy, lower, sizeof(copy));
+	for (unsigned int i = 0; i < sizeof(copy) - 1; i++) {
+		copy[i] ^= 0x01;
+		assert_false(isc_ascii_lowerequal(upper, copy, sizeof(copy)));
+		assert_int_equal(isc_ascii_lowercmp(upper, copy, sizeof(copy)),
+				 (int)lower[i] - (int)copy[i]);
+		copy[i] ^= 0x01;
+	}
+
+	/* '[' sorts after 'Z' but before 'a' when not lowered */
+	assert_true(isc_ascii_lowercmp((const uint8_t *)"[",
+				       (const uint8_t *)"Z", 1) < 0);
+	assert_false(isc_ascii_lowerequal((const uint8_t *)"@",
+					  (const uint8_t *)"`", 1));
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(isc_ascii_tolower8)
+ISC_TEST_ENTRY(isc_ascii_lowercmp)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -1045,6 +1045,120 @@ ISC_RUN_TEST_IMPL(doh_recv_two_GET_TLS_quota) {
 	doh_recv_two(state);
 }
 
+static void
+doh_receive_request_cacheable_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+				 isc_region_t *region, void *cbarg) {
+	if (eresult == ISC_R_SUCCESS) {
+		isc_nm_set_maxage(handle, 60);
+	}
+	doh_receive_request_cb(handle, eresult, region, cbarg);
+}
+
+static void
+doh_receive_reply_send_again_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+				isc_region_t *region, void *cbarg) {
+	doh_receive_reply_cb(handle, eresult, region, cbarg);
+
+	/* Repeat the request once the response is in the cache */
+	if (eresult == ISC_R_SUCCESS && cbarg == NULL) {
+		eresult = isc__nm_http_request(
+			handle,
+			&(isc_region_t){ .base = (uint8_t *)send_msg.base,
+					 .length = send_msg.len },
+			doh_receive_reply_cb, (void *)1);
+		if (eresult != ISC_R_SUCCESS) {
+			atomic_store(&was_error, true);
+		}
+	}
+}
+
+static void
+doh_connect_send_cached_cb(isc_nmhandle_t *handle, isc_result_t result,
+			   void *arg) {
+	REQUIRE(VALID_NMHANDLE(handle));
+	if (result != ISC_R_SUCCESS) {
+		goto error;
+	}
+
+	result = isc__nm_http_request(
+		handle,
+		&(isc_region_t){ .base = (uint8_t *)send_msg.base,
+				 .length = send_msg.len },
+		doh_receive_reply_send_again_cb, arg);
+	if (result != ISC_R_SUCCESS) {
+		goto error;
+	}
+	return;
+error:
+	atomic_store(&was_error, true);
+}
+
+/* The second of two identical GET requests is answered from the cache */
+ISC_RUN_TEST_IMPL(doh_recv_two_GET_cached) {
+	isc_nm_t **nm = (isc_nm_t **)*state;
+	isc_nm_t *listen_nm = nm[0];
+	isc_nm_t *connect_nm = nm[1];
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_nmsocket_t *listen_sock = NULL;
+	char req_url[256];
+
+	SKIP_IN_CI;
+
+	atomic_store(&total_sends, 2);
+
+	atomic_store(&nsends, atomic_load(&total_sends));
+
+	isc_nm_sethttpgetcachettl(listen_nm, 30);
+	assert_int_equal(isc_nm_gethttpgetcachettl(listen_nm), 30);
+
+	result = isc_nm_http_endpoints_add(endpoints, ISC_NM_HTTP_DEFAULT_PATH,
+					   doh_receive_request_cacheable_cb,
+					   NULL, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_nm_listenhttp(listen_nm, &tcp_listen_addr, 0, NULL, NULL,
+				   endpoints, 0, &listen_sock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	sockaddr_to_url(&tcp_listen_addr, false, req_url, sizeof(req_url),
+			ISC_NM_HTTP_DEFAULT_PATH);
+
+	isc_nm_httpconnect(connect_nm, NULL, &tcp_listen_addr, req_url, false,
+			   doh_connect_send_cached_cb, NULL, NULL,
+			   client_sess_cache, 5000, 0);
+
+	while (atomic_load(&nsends) > 0) {
+		if (atomic_load(&was_error)) {
+			break;
+		}
+		isc_thread_yield();
+	}
+
+	while (atomic_load(&ssends) == 0 || atomic_load(&csends) != 2) {
+		if (atomic_load(&was_error)) {
+			break;
+		}
+		isc_thread_yield();
+	}
+
+	isc_nm_stoplistening(listen_sock);
+	isc_nmsocket_close(&listen_sock);
+	assert_null(listen_sock);
+	isc__netmgr_shutdown(connect_nm);
+	isc_nm_sethttpgetcachettl(listen_nm, 0);
+
+	X(total_sends);
+	X(csends);
+	X(creads);
+	X(sreads);
+	X(ssends);
+
+	assert_int_equal(atomic_load(&csends), 2);
+	assert_int_equal(atomic_load(&creads), 2);
+	assert_int_equal(atomic_load(&sreads), 1);
+	assert_int_equal(atomic_load(&ssends), 1);
+}
+
 static void
 doh_recv_send(void **state) {
 	isc_nm_t **nm = (isc_nm_t **)*state;
@@ -2259,6 +2373,7 @@ ISC_TEST_ENTRY_CUSTOM(doh_recv_two_POST_quota, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(doh_recv_two_GET_quota, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(doh_recv_two_POST_TLS_quota, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(doh_recv_two_GET_TLS_quota, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(doh_recv_two_GET_cached, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(doh_recv_send_GET, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(doh_recv_send_POST, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(doh_recv_send_GET_TLS, setup_test, teardown_test)
@@ -199,6 +199,42 @@ ISC_RUN_TEST_IMPL(isc_hmac_reset) {
 #endif /* if 0 */
 }
 
+/* a copy of a keyed context gives the same digest as the original */
+ISC_RUN_TEST_IMPL(isc_hmac_copy) {
+	isc_hmac_t *hmac = *state;
+	unsigned char expected[ISC_MAX_MD_SIZE];
+	unsigned int expectedlen = sizeof(expected);
+	assert_non_null(hmac);
+
+	expect_assert_failure(isc_hmac_copy(NULL, hmac));
+	expect_assert_failure(isc_hmac_copy(hmac, NULL));
+
+	assert_int_equal(isc_hmac(ISC_MD_SHA256, TEST_INPUT("key"),
+				  (const unsigned char *)"message", 7,
+				  expected, &expectedlen),
+			 ISC_R_SUCCESS);
+
+	assert_int_equal(isc_hmac_init(hmac, TEST_INPUT("key"), ISC_MD_SHA256),
+			 ISC_R_SUCCESS);
+
+	for (size_t i = 0; i < 2; i++) {
+		isc_hmac_t *copy = isc_hmac_new();
+		unsigned char digest[ISC_MAX_MD_SIZE];
+		unsigned int digestlen = sizeof(digest);
+
+		assert_int_equal(isc_hmac_copy(copy, hmac), ISC_R_SUCCESS);
+		assert_int_equal(
+			isc_hmac_update(copy, (const unsigned char *)"message",
+					7),
+			ISC_R_SUCCESS);
+		assert_int_equal(isc_hmac_final(copy, digest, &digestlen),
+				 ISC_R_SUCCESS);
+		assert_int_equal(digestlen, expectedlen);
+		assert_memory_equal(digest, expected, digestlen);
+		isc_hmac_free(copy);
+	}
+}
+
 ISC_RUN_TEST_IMPL(isc_hmac_final) {
 	isc_hmac_t *hmac = *state;
 	assert_non_null(hmac);
@@ -918,6 +954,7 @@ ISC_TEST_ENTRY(isc_hmac_sha512)
 
 ISC_TEST_ENTRY_CUSTOM(isc_hmac_update, _reset, _reset)
 ISC_TEST_ENTRY_CUSTOM(isc_hmac_final, _reset, _reset)
+ISC_TEST_ENTRY_CUSTOM(isc_hmac_copy, _reset, _reset)
 
 ISC_TEST_ENTRY(isc_hmac_free)
 
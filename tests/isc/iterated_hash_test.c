@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/hex.h>
+#include <isc/iterated_hash.h>
+#include <isc/random.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+/*
+ * Test vectors from RFC 5155, Appendix A: salt "aabbccdd", 12 iterations.
+ */
+static const struct {
+	const char *name;
+	const char *hash;
+} vectors[] = {
+	{ "\007example", "065368abeed7ec6e9feba96b8c8bc3e8b791f716" },
+	{ "\001a\007example", "196dd8c3306783a8190f52c262d2b7e5e836e7f5" },
+	{ "\002ai\007example", "84dda71446cd56f0c116a57254baef69d09bce12" },
+	{ "\003ns1\007example", "174eb2409fe28bcb4887a1836f957f0a8425e27b" },
+	{ "\003ns2\007example", "d0093a31dfd7ede41760091876d16a1a3009c8bb" },
+	{ "\001w\007example", "a23cd75bf90cc4f3ba069b979e04ffc8ee891511" },
+	{ "\001*\001w\007example", "d946bd1d8c17bf6f2dfe2e196b1b2edf13da25d7" },
+	{ "\001x\001w\007example", "593d6419d08c5bc35dca0a4dcb7ed5c131be2525" },
+	{ "\001y\001w\007example", "9c8d77614ecfd0b2e0d423be31a9715223d4be0c" },
+	{ "\001x\001y\001w\007example",
+	  "17f3df17b2b2adaef615257de4d2020b80ac6c7c" },
+	{ "\002xx\007example", "e988472f544ae4b65d4839212fecd3c4cc2b563f" },
+};
+
+static const unsigned char salt[] = { 0xaa, 0xbb, 0xcc, 0xdd };
+
+static void
+expected(size_t i, unsigned char digest[20]) {
+	isc_buffer_t b;
+
+	isc_buffer_init(&b, digest, 20);
+	assert_int_equal(isc_hex_decodestring(vectors[i].hash, &b),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_buffer_usedlength(&b), 20);
+}
+
+/* isc_iterated_hash() matches the RFC 5155 examples */
+ISC_RUN_TEST_IMPL(isc_iterated_hash) {
+	unsigned char digest[20], out[NSEC3_MAX_HASH_LENGTH];
+
+	UNUSED(state);
+
+	for (size_t i = 0; i < ARRAY_SIZE(vectors); i++) {
+		const unsigned char *in = (const unsigned char *)vectors[i].name;
+		int len = (int)strlen(vectors[i].name) + 1;
+
+		expected(i, digest);
+		assert_int_equal(isc_iterated_hash(out, 1, 12, salt,
+						   sizeof(salt), in, len),
+				 20);
+		assert_memory_equal(out, digest, 20);
+	}
+}
+
+/* isc_iterated_hash_batch() matches the RFC 5155 examples */
+ISC_RUN_TEST_IMPL(isc_iterated_hash_batch) {
+	unsigned char out[ARRAY_SIZE(vectors)][NSEC3_MAX_HASH_LENGTH];
+	unsigned char *outp[ARRAY_SIZE(vectors)];
+	const unsigned char *in[ARRAY_SIZE(vectors)];
+	int inlength[ARRAY_SIZE(vectors)];
+	unsigned char digest[20];
+
+	UNUSED(state);
+
+	for (size_t i = 0; i < ARRAY_SIZE(vectors); i++) {
+		in[i] = (const unsigned char *)vectors[i].name;
+		inlength[i] = (int)strlen(vectors[i].name) + 1;
+		outp[i] = out[i];
+	}
+
+	/* Every batch size, so that all the partial lane groups are used. */
+	for (size_t count = 1; count <= ARRAY_SIZE(vectors); count++) {
+		memset(out, 0, sizeof(out));
+		assert_int_equal(isc_iterated_hash_batch(outp, 1, 12, salt,
+							 sizeof(salt), in,
+							 inlength, count),
+				 20);
+		for (size_t i = 0; i < count; i++) {
+			expected(i, digest);
+			assert_memory_equal(out[i], digest, 20);
+		}
+	}
+
+	assert_int_equal(isc_iterated_hash_batch(outp, 2, 12, salt,
+						 sizeof(salt), in, inlength,
+						 1),
+			 0);
+}
+
+/* isc_iterated_hash_batch() matches isc_iterated_hash() */
+ISC_RUN_TEST_IMPL(isc_iterated_hash_batch_random) {
+	unsigned char data[9][255];
+	unsigned char rsalt[255];
+	unsigned char out[9][NSEC3_MAX_HASH_LENGTH];
+	unsigned char *outp[9];
+	const unsigned char *in[9];
+	int inlength[9];
+	unsigned char digest[NSEC3_MAX_HASH_LENGTH];
+
+	UNUSED(state);
+
+	for (size_t n = 0; n < 200; n++) {
+		unsigned int count = 1 + isc_random_uniform(ARRAY_SIZE(data));
+		int iterations = isc_random_uniform(20);
+		int saltlength = isc_random_uniform(sizeof(rsalt) + 1);
+
+		isc_random_buf(rsalt, saltlength);
+		for (size_t i = 0; i < count; i++) {
+			inlength[i] = isc_random_uniform(sizeof(data[i]) + 1);
+			isc_random_buf(data[i], inlength[i]);
+			in[i] = data[i];
+			outp[i] = out[i];
+		}
+
+		assert_int_equal(isc_iterated_hash_batch(outp, 1, iterations,
+							 rsalt, saltlength, in,
+							 inlength, count),
+				 20);
+		for (size_t i = 0; i < count; i++) {
+			assert_int_equal(isc_iterated_hash(digest, 1,
+							   iterations, rsalt,
+							   saltlength, in[i],
+							   inlength[i]),
+					 20);
+			assert_memory_equal(out[i], digest, 20);
+		}
+	}
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(isc_iterated_hash)
+ISC_TEST_ENTRY(isc_iterated_hash_batch)
+ISC_TEST_ENTRY(isc_iterated_hash_batch_random)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
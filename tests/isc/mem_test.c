@@ -18,6 +18,7 @@
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #define UNIT_TESTING
@@ -128,6 +129,69 @@ ISC_RUN_TEST_IMPL(isc_mem) {
 	isc_mempool_destroy(&mp1);
 }
 
+#define SHARED_THREADS 4
+#define SHARED_ITEMS   1000
+
+static isc_mempool_t *shared_mp = NULL;
+static void *shared_items[SHARED_THREADS][SHARED_ITEMS];
+
+static isc_threadresult_t
+mempool_thread(isc_threadarg_t arg) {
+	void **items = arg;
+	void *own[SHARED_ITEMS];
+
+	/* Return the items another thread got, and churn our own. */
+	for (int i = 0; i < SHARED_ITEMS; i++) {
+		isc_mempool_put(shared_mp, items[i]);
+	}
+	for (int n = 0; n < 100; n++) {
+		for (int i = 0; i < SHARED_ITEMS; i++) {
+			own[i] = isc_mempool_get(shared_mp);
+			memset(own[i], n, 24);
+		}
+		for (int i = 0; i < SHARED_ITEMS; i++) {
+			isc_mempool_put(shared_mp, own[i]);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+/* shared memory pools */
+ISC_RUN_TEST_IMPL(isc_mempool_shared) {
+	isc_thread_t threads[SHARED_THREADS];
+	size_t inuse;
+
+	UNUSED(state);
+
+	inuse = isc_mem_inuse(mctx);
+
+	isc_mempool_create(mctx, 24, &shared_mp);
+	isc_mempool_setfreemax(shared_mp, 256);
+	isc_mempool_setshared(shared_mp, SHARED_THREADS);
+
+	for (int t = 0; t < SHARED_THREADS; t++) {
+		for (int i = 0; i < SHARED_ITEMS; i++) {
+			shared_items[t][i] = isc_mempool_get(shared_mp);
+		}
+	}
+	assert_int_equal(isc_mempool_getallocated(shared_mp),
+			 SHARED_THREADS * SHARED_ITEMS);
+
+	for (int t = 0; t < SHARED_THREADS; t++) {
+		isc_thread_create(mempool_thread, shared_items[t],
+				  &threads[t]);
+	}
+	for (int t = 0; t < SHARED_THREADS; t++) {
+		isc_thread_join(threads[t], NULL);
+	}
+
+	assert_int_equal(isc_mempool_getallocated(shared_mp), 0);
+
+	isc_mempool_destroy(&shared_mp);
+	assert_int_equal(isc_mem_inuse(mctx), inuse);
+}
+
 #if defined(HAVE_MALLOC_NP_H) || defined(HAVE_JEMALLOC)
 /* aligned memory system tests */
 ISC_RUN_TEST_IMPL(isc_mem_aligned) {
@@ -211,6 +275,56 @@ ISC_RUN_TEST_IMPL(isc_mem_total) {
 	isc_mem_destroy(&mctx2);
 }
 
+/* test isc_mem_totalgets() counts allocations in every context */
+ISC_RUN_TEST_IMPL(isc_mem_totalgets) {
+	isc_mem_t *mctx2 = NULL;
+	uint64_t before;
+	void *ptr1, *ptr2;
+
+	UNUSED(state);
+
+	isc_mem_create(&mctx2);
+
+	before = isc_mem_totalgets();
+	ptr1 = isc_mem_get(mctx, 64);
+	ptr2 = isc_mem_get(mctx2, 4096);
+	isc_mem_put(mctx, ptr1, 64);
+	isc_mem_put(mctx2, ptr2, 4096);
+	assert_int_equal(isc_mem_totalgets() - before, 2);
+
+	isc_mem_destroy(&mctx2);
+}
+
+/* test sampled allocations are accounted for until they are freed */
+ISC_RUN_TEST_IMPL(isc_mem_sampled) {
+	isc_mem_t *mctx2 = NULL;
+	void *ptrs[10];
+
+	UNUSED(state);
+
+	isc_mem_create(&mctx2);
+
+	/* Sample every allocation. */
+	isc_mem_setsamplerate(1);
+	for (size_t i = 0; i < ARRAY_SIZE(ptrs); i++) {
+		ptrs[i] = isc_mem_get(mctx2, 100);
+	}
+	isc_mem_setsamplerate(0);
+	assert_int_equal(isc_mem_sampled(mctx2), 1000);
+
+	for (size_t i = 0; i < 5; i++) {
+		isc_mem_put(mctx2, ptrs[i], 100);
+	}
+	assert_int_equal(isc_mem_sampled(mctx2), 500);
+
+	for (size_t i = 5; i < ARRAY_SIZE(ptrs); i++) {
+		isc_mem_put(mctx2, ptrs[i], 100);
+	}
+	assert_int_equal(isc_mem_sampled(mctx2), 0);
+
+	isc_mem_destroy(&mctx2);
+}
+
 /* test InUse calculation */
 ISC_RUN_TEST_IMPL(isc_mem_inuse) {
 	isc_mem_t *mctx2 = NULL;
@@ -494,10 +608,13 @@ ISC_RUN_TEST_IMPL(isc_mem_benchmark) {
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_mem)
+ISC_TEST_ENTRY(isc_mempool_shared)
 #if defined(HAVE_MALLOC_NP_H) || defined(HAVE_JEMALLOC)
 ISC_TEST_ENTRY(isc_mem_aligned)
 #endif /* defined(HAVE_MALLOC_NP_H) || defined(HAVE_JEMALLOC) */
 ISC_TEST_ENTRY(isc_mem_total)
+ISC_TEST_ENTRY(isc_mem_totalgets)
+ISC_TEST_ENTRY(isc_mem_sampled)
 ISC_TEST_ENTRY(isc_mem_inuse)
 ISC_TEST_ENTRY(isc_mem_zeroget)
 ISC_TEST_ENTRY(isc_mem_reget)
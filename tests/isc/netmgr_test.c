@@ -35,6 +35,7 @@
 #include <isc/quota.h>
 #include <isc/refcount.h>
 #include <isc/sockaddr.h>
+#include <isc/stats.h>
 #include <isc/thread.h>
 #include <isc/tls.h>
 #include <isc/util.h>
@@ -977,6 +978,105 @@ ISC_RUN_TEST_IMPL(udp_recv_send) {
 	CHECK_RANGE_FULL(ssends);
 }
 
+ISC_RUN_TEST_IMPL(udp_recv_send_batched) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_nmsocket_t *listen_sock = NULL;
+	isc_thread_t threads[workers];
+
+	SKIP_IN_CI;
+
+	isc_nm_setudpsendbatch(listen_nm, 16);
+	assert_int_equal(isc_nm_getudpsendbatch(listen_nm), 16);
+
+	result = isc_nm_listenudp(listen_nm, &udp_listen_addr, listen_read_cb,
+				  NULL, 0, &listen_sock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	memset(threads, 0, sizeof(threads));
+	for (size_t i = 0; i < workers; i++) {
+		isc_thread_create(connect_thread, udp_connect, &threads[i]);
+	}
+
+	WAIT_FOR_GE(cconnects, esends);
+	WAIT_FOR_GE(csends, esends);
+	WAIT_FOR_GE(sreads, esends);
+	WAIT_FOR_GE(ssends, esends / 2);
+	WAIT_FOR_GE(creads, esends / 2);
+
+	DONE();
+	for (size_t i = 0; i < workers; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	isc__netmgr_shutdown(connect_nm);
+	isc_nm_stoplistening(listen_sock);
+	isc_nmsocket_close(&listen_sock);
+	assert_null(listen_sock);
+
+	X(cconnects);
+	X(csends);
+	X(creads);
+	X(sreads);
+	X(ssends);
+
+	CHECK_RANGE_FULL(csends);
+	CHECK_RANGE_FULL(creads);
+	CHECK_RANGE_FULL(sreads);
+	CHECK_RANGE_FULL(ssends);
+}
+
+ISC_RUN_TEST_IMPL(udp_recv_send_cpuaffinity) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_nmsocket_t *listen_sock = NULL;
+	isc_thread_t threads[workers];
+
+	SKIP_IN_CI;
+
+	result = isc_nm_setcpuaffinity(listen_nm);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		skip();
+		return;
+	}
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(isc_nm_getcpuaffinity(listen_nm));
+
+	result = isc_nm_listenudp(listen_nm, &udp_listen_addr, listen_read_cb,
+				  NULL, 0, &listen_sock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	memset(threads, 0, sizeof(threads));
+	for (size_t i = 0; i < workers; i++) {
+		isc_thread_create(connect_thread, udp_connect, &threads[i]);
+	}
+
+	WAIT_FOR_GE(cconnects, esends);
+	WAIT_FOR_GE(csends, esends);
+	WAIT_FOR_GE(sreads, esends);
+	WAIT_FOR_GE(ssends, esends / 2);
+	WAIT_FOR_GE(creads, esends / 2);
+
+	DONE();
+	for (size_t i = 0; i < workers; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	isc__netmgr_shutdown(connect_nm);
+	isc_nm_stoplistening(listen_sock);
+	isc_nmsocket_close(&listen_sock);
+	assert_null(listen_sock);
+
+	X(cconnects);
+	X(csends);
+	X(creads);
+	X(sreads);
+	X(ssends);
+
+	CHECK_RANGE_FULL(csends);
+	CHECK_RANGE_FULL(creads);
+	CHECK_RANGE_FULL(sreads);
+	CHECK_RANGE_FULL(ssends);
+}
+
 ISC_RUN_TEST_IMPL(udp_recv_half_send) {
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_nmsocket_t *listen_sock = NULL;
@@ -1761,6 +1861,65 @@ ISC_RUN_TEST_IMPL(tcpdns_noresponse) {
 	atomic_assert_int_eq(ssends, 0);
 }
 
+ISC_RUN_TEST_IMPL(tcpdns_evict_idle) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_nmsocket_t *listen_sock = NULL;
+	isc_stats_t *stats = NULL;
+	isc_nm_t *nm = NULL;
+	uint64_t firstbyte = 0;
+
+	/* A single thread, so that it accepts both connections */
+	isc__netmgr_create(mctx, 1, &nm);
+	isc_nm_settimeouts(nm, T_INIT, T_IDLE, T_KEEPALIVE, T_ADVERTISED);
+	isc_stats_create(mctx, &stats, isc_sockstatscounter_max);
+	isc_nm_setstats(nm, stats);
+	isc_nm_settcpevictidle(nm, true);
+	assert_true(isc_nm_gettcpevictidle(nm));
+
+	isc_quota_max(&listener_quota, 1);
+
+	noanswer = true;
+	result = isc_nm_listentcpdns(nm, &tcp_listen_addr, listen_read_cb,
+				     NULL, noop_accept_cb, NULL, 0, 0,
+				     &listener_quota, &listen_sock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_refcount_increment0(&active_cconnects);
+	isc_nm_tcpdnsconnect(connect_nm, &tcp_connect_addr, &tcp_listen_addr,
+			     connect_connect_cb, NULL, T_CONNECT, 0);
+
+	WAIT_FOR_EQ(saccepts, 1);
+	WAIT_FOR_EQ(sreads, 1);
+
+	/*
+	 * The first connection is idle now, so it is closed to make room
+	 * for the second one.
+	 */
+	isc_refcount_increment0(&active_cconnects);
+	isc_nm_tcpdnsconnect(connect_nm, &tcp_connect_addr, &tcp_listen_addr,
+			     connect_connect_cb, NULL, T_CONNECT, 0);
+
+	WAIT_FOR_EQ(saccepts, 2);
+
+	isc_nm_stoplistening(listen_sock);
+	isc_nmsocket_close(&listen_sock);
+	assert_null(listen_sock);
+	isc__netmgr_shutdown(connect_nm);
+
+	assert_int_equal(isc_stats_get_counter(
+				 stats, isc_sockstatscounter_tcpidleevicted),
+			 1);
+	for (isc_statscounter_t i = isc_sockstatscounter_tcpfirstbyte1ms;
+	     i <= isc_sockstatscounter_tcpfirstbyteslow; i++)
+	{
+		firstbyte += isc_stats_get_counter(stats, i);
+	}
+	assert_true(firstbyte >= 1);
+
+	isc__netmgr_destroy(&nm);
+	isc_stats_detach(&stats);
+}
+
 ISC_RUN_TEST_IMPL(tcpdns_timeout_recovery) {
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_nmsocket_t *listen_sock = NULL;
@@ -1934,6 +2093,54 @@ ISC_RUN_TEST_IMPL(tcpdns_recv_send) {
 	CHECK_RANGE_FULL(ssends);
 }
 
+ISC_RUN_TEST_IMPL(tcpdns_recv_send_batched) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_nmsocket_t *listen_sock = NULL;
+	isc_thread_t threads[workers];
+
+	SKIP_IN_CI;
+
+	isc_nm_settcpsendbatch(listen_nm, 16);
+	assert_int_equal(isc_nm_gettcpsendbatch(listen_nm), 16);
+
+	result = isc_nm_listentcpdns(listen_nm, &tcp_listen_addr,
+				     listen_read_cb, NULL, listen_accept_cb,
+				     NULL, 0, 0, NULL, &listen_sock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	memset(threads, 0, sizeof(threads));
+	for (size_t i = 0; i < workers; i++) {
+		isc_thread_create(connect_thread, tcpdns_connect, &threads[i]);
+	}
+
+	WAIT_FOR_GE(cconnects, esends);
+	WAIT_FOR_GE(csends, esends);
+	WAIT_FOR_GE(sreads, esends);
+	WAIT_FOR_GE(ssends, esends / 2);
+	WAIT_FOR_GE(creads, esends / 2);
+
+	DONE();
+	for (size_t i = 0; i < workers; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	isc__netmgr_shutdown(connect_nm);
+	isc_nm_stoplistening(listen_sock);
+	isc_nmsocket_close(&listen_sock);
+	assert_null(listen_sock);
+
+	X(cconnects);
+	X(csends);
+	X(creads);
+	X(sreads);
+	X(ssends);
+
+	CHECK_RANGE_FULL(csends);
+	CHECK_RANGE_FULL(creads);
+	CHECK_RANGE_FULL(sreads);
+	CHECK_RANGE_FULL(ssends);
+}
+
 ISC_RUN_TEST_IMPL(tcpdns_recv_half_send) {
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_nmsocket_t *listen_sock = NULL;
@@ -2401,6 +2608,67 @@ ISC_RUN_TEST_IMPL(tlsdns_recv_one) {
 	atomic_assert_int_eq(ssends, 0);
 }
 
+static uint64_t
+tls_stats_get(isc_stats_t *stats, isc_statscounter_t tcp4,
+	      isc_statscounter_t tcp6) {
+	return (isc_stats_get_counter(stats, tcp4) +
+		isc_stats_get_counter(stats, tcp6));
+}
+
+ISC_RUN_TEST_IMPL(tlsdns_recv_send_resumed) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_nmsocket_t *listen_sock = NULL;
+	isc_stats_t *stats = NULL;
+
+	isc_stats_create(mctx, &stats, isc_sockstatscounter_max);
+	isc_nm_setstats(listen_nm, stats);
+
+	result = isc_nm_listentlsdns(listen_nm, &tcp_listen_addr,
+				     listen_read_cb, NULL, listen_accept_cb,
+				     NULL, 0, 0, NULL, tcp_listen_tlsctx,
+				     &listen_sock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/*
+	 * The second connection resumes the session with a ticket protected
+	 * by the previous key; after two more rotations the key is gone
+	 * and the third connection needs a full handshake.
+	 */
+	for (int i = 0; i < 3; i++) {
+		if (i == 1) {
+			isc_tls_ticket_keys_rotate();
+		} else if (i == 2) {
+			isc_tls_ticket_keys_rotate();
+			isc_tls_ticket_keys_rotate();
+		}
+
+		atomic_store(&nsends, 2);
+		isc_refcount_increment0(&active_cconnects);
+		tlsdns_connect(connect_nm);
+
+		WAIT_FOR_EQ(creads, i + 1);
+		WAIT_FOR_EQ(active_creads, 0);
+		/* Let the client store the session */
+		isc_test_nap(100);
+	}
+
+	isc_nm_stoplistening(listen_sock);
+	isc_nmsocket_close(&listen_sock);
+	assert_null(listen_sock);
+	isc__netmgr_shutdown(connect_nm);
+
+	assert_int_equal(tls_stats_get(stats,
+				       isc_sockstatscounter_tcp4tlshandshake,
+				       isc_sockstatscounter_tcp6tlshandshake),
+			 3);
+	assert_int_equal(tls_stats_get(stats,
+				       isc_sockstatscounter_tcp4tlsresumed,
+				       isc_sockstatscounter_tcp6tlsresumed),
+			 1);
+
+	isc_stats_detach(&stats);
+}
+
 ISC_RUN_TEST_IMPL(tlsdns_recv_two) {
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_nmsocket_t *listen_sock = NULL;
@@ -2798,6 +3066,8 @@ ISC_TEST_ENTRY_CUSTOM(udp_timeout_recovery, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(udp_recv_one, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(udp_recv_two, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(udp_recv_send, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(udp_recv_send_batched, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(udp_recv_send_cpuaffinity, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(udp_recv_half_send, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(udp_half_recv_send, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(udp_half_recv_half_send, setup_test, teardown_test)
@@ -2838,8 +3108,10 @@ ISC_TEST_ENTRY_CUSTOM(tcpdns_recv_one, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(tcpdns_recv_two, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(tcpdns_noop, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(tcpdns_noresponse, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(tcpdns_evict_idle, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(tcpdns_timeout_recovery, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(tcpdns_recv_send, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(tcpdns_recv_send_batched, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(tcpdns_recv_half_send, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(tcpdns_half_recv_send, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(tcpdns_half_recv_half_send, setup_test, teardown_test)
@@ -2880,6 +3152,7 @@ ISC_TEST_ENTRY_CUSTOM(tls_half_recv_half_send_quota_sendback, setup_test,
 /* TLSDNS */
 ISC_TEST_ENTRY_CUSTOM(tlsdns_recv_one, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(tlsdns_recv_two, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(tlsdns_recv_send_resumed, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(tlsdns_noop, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(tlsdns_noresponse, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(tlsdns_timeout_recovery, setup_test, teardown_test)
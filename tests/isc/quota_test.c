@@ -137,6 +137,56 @@ ISC_RUN_TEST_IMPL(isc_quota_soft) {
 	isc_quota_destroy(&quota);
 }
 
+ISC_RUN_TEST_IMPL(isc_quota_sliced) {
+	isc_quota_t quota;
+	isc_quota_t *quotas[110];
+	int i;
+	UNUSED(state);
+
+	isc_quota_init(&quota, 100);
+	isc_quota_slice(&quota, mctx, 4);
+	isc_quota_soft(&quota, 50);
+
+	/* Once our own slice is exhausted, we take from the others */
+	for (i = 0; i < 50; i++) {
+		add_quota(&quota, &quotas[i], ISC_R_SUCCESS, i + 1);
+	}
+	for (i = 50; i < 100; i++) {
+		add_quota(&quota, &quotas[i], ISC_R_SOFTQUOTA, i + 1);
+	}
+
+	add_quota(&quota, &quotas[100], ISC_R_QUOTA, 100);
+
+	/* Lowering the maximum below the used quota */
+	isc_quota_soft(&quota, 0);
+	isc_quota_max(&quota, 50);
+	assert_int_equal(isc_quota_getused(&quota), 100);
+	add_quota(&quota, &quotas[100], ISC_R_QUOTA, 100);
+
+	for (i = 99; i >= 50; i--) {
+		isc_quota_detach(&quotas[i]);
+		assert_int_equal(isc_quota_getused(&quota), i);
+	}
+	add_quota(&quota, &quotas[50], ISC_R_QUOTA, 50);
+
+	isc_quota_detach(&quotas[49]);
+	add_quota(&quota, &quotas[49], ISC_R_SUCCESS, 50);
+
+	/* Raising it again */
+	isc_quota_max(&quota, 60);
+	for (i = 50; i < 60; i++) {
+		add_quota(&quota, &quotas[i], ISC_R_SUCCESS, i + 1);
+	}
+	add_quota(&quota, &quotas[60], ISC_R_QUOTA, 60);
+
+	for (i = 59; i >= 0; i--) {
+		isc_quota_detach(&quotas[i]);
+		assert_null(quotas[i]);
+		assert_int_equal(isc_quota_getused(&quota), i);
+	}
+	isc_quota_destroy(&quota);
+}
+
 static atomic_uint_fast32_t cb_calls = 0;
 static isc_quota_cb_t cbs[30];
 static isc_quota_t *qp;
@@ -333,6 +383,7 @@ ISC_TEST_LIST_START
 ISC_TEST_ENTRY(isc_quota_get_set)
 ISC_TEST_ENTRY(isc_quota_hard)
 ISC_TEST_ENTRY(isc_quota_soft)
+ISC_TEST_ENTRY(isc_quota_sliced)
 ISC_TEST_ENTRY(isc_quota_callback)
 ISC_TEST_ENTRY(isc_quota_callback_mt)
 
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/rwlock.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+#define NTHREADS 8
+#define NLOCKS	 4
+#define NLOOPS	 100000
+
+static isc_rwlock_t locks[NLOCKS];
+/* Both halves are always updated together under the write lock */
+static uint64_t values[NLOCKS][2];
+
+/* readers exclude writers, but not each other */
+ISC_RUN_TEST_IMPL(isc_rwlock_trylock) {
+	isc_rwlock_t rwl;
+
+	UNUSED(state);
+
+	isc_rwlock_init(&rwl, 0, 0);
+
+	assert_int_equal(isc_rwlock_lock(&rwl, isc_rwlocktype_read),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_rwlock_trylock(&rwl, isc_rwlocktype_read),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_rwlock_trylock(&rwl, isc_rwlocktype_write),
+			 ISC_R_LOCKBUSY);
+	assert_int_equal(isc_rwlock_unlock(&rwl, isc_rwlocktype_read),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_rwlock_unlock(&rwl, isc_rwlocktype_read),
+			 ISC_R_SUCCESS);
+
+	assert_int_equal(isc_rwlock_lock(&rwl, isc_rwlocktype_write),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_rwlock_trylock(&rwl, isc_rwlocktype_read),
+			 ISC_R_LOCKBUSY);
+	assert_int_equal(isc_rwlock_trylock(&rwl, isc_rwlocktype_write),
+			 ISC_R_LOCKBUSY);
+	assert_int_equal(isc_rwlock_unlock(&rwl, isc_rwlocktype_write),
+			 ISC_R_SUCCESS);
+
+	assert_int_equal(isc_rwlock_trylock(&rwl, isc_rwlocktype_write),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_rwlock_unlock(&rwl, isc_rwlocktype_write),
+			 ISC_R_SUCCESS);
+
+	isc_rwlock_destroy(&rwl);
+}
+
+/* only the sole reader can upgrade */
+ISC_RUN_TEST_IMPL(isc_rwlock_upgrade) {
+	isc_rwlock_t rwl;
+
+	UNUSED(state);
+
+	isc_rwlock_init(&rwl, 0, 0);
+
+	assert_int_equal(isc_rwlock_lock(&rwl, isc_rwlocktype_read),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_rwlock_lock(&rwl, isc_rwlocktype_read),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_rwlock_tryupgrade(&rwl), ISC_R_LOCKBUSY);
+	assert_int_equal(isc_rwlock_unlock(&rwl, isc_rwlocktype_read),
+			 ISC_R_SUCCESS);
+
+#if !USE_PTHREAD_RWLOCK
+	assert_int_equal(isc_rwlock_tryupgrade(&rwl), ISC_R_SUCCESS);
+	assert_int_equal(isc_rwlock_trylock(&rwl, isc_rwlocktype_read),
+			 ISC_R_LOCKBUSY);
+	isc_rwlock_downgrade(&rwl);
+#endif /* !USE_PTHREAD_RWLOCK */
+
+	assert_int_equal(isc_rwlock_trylock(&rwl, isc_rwlocktype_read),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_rwlock_unlock(&rwl, isc_rwlocktype_read),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_rwlock_unlock(&rwl, isc_rwlocktype_read),
+			 ISC_R_SUCCESS);
+
+	isc_rwlock_destroy(&rwl);
+}
+
+static isc_threadresult_t
+mixed_thread(isc_threadarg_t arg) {
+	UNUSED(arg);
+
+	for (size_t i = 0; i < NLOOPS; i++) {
+		uint32_t r = isc_random_uniform(100);
+		size_t l = isc_random_uniform(NLOCKS);
+
+		if (r < 90) {
+			isc_rwlock_lock(&locks[l], isc_rwlocktype_read);
+			INSIST(values[l][0] == values[l][1]);
+			if (r == 0 &&
+			    isc_rwlock_tryupgrade(&locks[l]) == ISC_R_SUCCESS)
+			{
+				values[l][0]++;
+				values[l][1]++;
+				isc_rwlock_unlock(&locks[l],
+						  isc_rwlocktype_write);
+				continue;
+			}
+			isc_rwlock_unlock(&locks[l], isc_rwlocktype_read);
+		} else {
+			isc_rwlock_lock(&locks[l], isc_rwlocktype_write);
+			values[l][0]++;
+			values[l][1]++;
+			if (r == 90) {
+				isc_rwlock_downgrade(&locks[l]);
+				INSIST(values[l][0] == values[l][1]);
+				isc_rwlock_unlock(&locks[l],
+						  isc_rwlocktype_read);
+			} else {
+				isc_rwlock_unlock(&locks[l],
+						  isc_rwlocktype_write);
+			}
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+/* concurrent readers never see a half-done write */
+ISC_RUN_TEST_IMPL(isc_rwlock_threads) {
+	isc_thread_t threads[NTHREADS];
+
+	UNUSED(state);
+
+	for (size_t i = 0; i < NLOCKS; i++) {
+		isc_rwlock_init(&locks[i], 0, 0);
+	}
+
+	for (size_t i = 0; i < NTHREADS; i++) {
+		isc_thread_create(mixed_thread, NULL, &threads[i]);
+	}
+	for (size_t i = 0; i < NTHREADS; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	for (size_t i = 0; i < NLOCKS; i++) {
+		assert_int_equal(values[i][0], values[i][1]);
+		isc_rwlock_destroy(&locks[i]);
+	}
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(isc_rwlock_trylock)
+ISC_TEST_ENTRY(isc_rwlock_upgrade)
+ISC_TEST_ENTRY(isc_rwlock_threads)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
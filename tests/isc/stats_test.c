@@ -61,6 +61,14 @@ ISC_RUN_TEST_IMPL(isc_stats_basic) {
 		assert_int_equal(isc_stats_get_counter(stats, i), 0);
 	}
 
+	/* Test add. */
+	for (int i = 0; i < isc_stats_ncounters(stats); i++) {
+		isc_stats_add(stats, i, i);
+		assert_int_equal(isc_stats_get_counter(stats, i), i);
+		isc_stats_add(stats, i, 1);
+		assert_int_equal(isc_stats_get_counter(stats, i), i + 1);
+	}
+
 	/* Test set. */
 	for (int i = 0; i < isc_stats_ncounters(stats); i++) {
 		isc_stats_set(stats, i, i);
@@ -288,6 +288,65 @@ ISC_RUN_TEST_IMPL(privileged_events) {
 	assert_null(task2);
 }
 
+/* Background events run after the events of other tasks */
+ISC_RUN_TEST_IMPL(background_events) {
+	isc_result_t result;
+	isc_task_t *task1 = NULL, *task2 = NULL;
+	isc_event_t *event = NULL;
+	atomic_int_fast32_t a, b;
+	int i = 0;
+
+	UNUSED(state);
+
+	atomic_init(&counter, 1);
+	atomic_init(&a, -1);
+	atomic_init(&b, -1);
+
+	/*
+	 * Pause the net/task manager so we can fill up the work
+	 * queues without things happening while we do it.
+	 */
+	isc_nm_pause(netmgr);
+
+	result = isc_task_create_bound(taskmgr, 0, &task1, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_task_setname(task1, "background", NULL);
+	assert_false(isc_task_getbackground(task1));
+	isc_task_setbackground(task1, true);
+	assert_true(isc_task_getbackground(task1));
+
+	result = isc_task_create_bound(taskmgr, 0, &task2, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_task_setname(task2, "normal", NULL);
+
+	/* First event: background */
+	event = isc_event_allocate(mctx, task1, ISC_TASKEVENT_TEST, set, &a,
+				   sizeof(isc_event_t));
+	assert_non_null(event);
+	isc_task_send(task1, &event);
+
+	/* Second event: normal */
+	event = isc_event_allocate(mctx, task2, ISC_TASKEVENT_TEST, set, &b,
+				   sizeof(isc_event_t));
+	assert_non_null(event);
+	isc_task_send(task2, &event);
+
+	isc_nm_resume(netmgr);
+
+	while ((atomic_load(&a) < 0 || atomic_load(&b) < 0) && i++ < 5000) {
+		isc_test_nap(1000);
+	}
+
+	/* The normal event was sent last, but ran first */
+	assert_int_equal(atomic_load(&b), 1);
+	assert_int_equal(atomic_load(&a), 2);
+
+	isc_task_destroy(&task1);
+	assert_null(task1);
+	isc_task_destroy(&task2);
+	assert_null(task2);
+}
+
 /*
  * Edge case: this tests that the task manager behaves as expected when
  * we explicitly set it into normal mode *while* running privileged.
@@ -1393,6 +1452,7 @@ ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY_CUSTOM(manytasks, _setup4, _teardown)
 ISC_TEST_ENTRY_CUSTOM(all_events, _setup, _teardown)
+ISC_TEST_ENTRY_CUSTOM(background_events, _setup, _teardown)
 ISC_TEST_ENTRY_CUSTOM(basic, _setup2, _teardown)
 ISC_TEST_ENTRY_CUSTOM(create_task, _setup, _teardown)
 ISC_TEST_ENTRY_CUSTOM(post_shutdown, _setup2, _teardown)
@@ -184,6 +184,63 @@ ISC_RUN_TEST_IMPL(parse_buffer) {
 	cfg_parser_destroy(&p2);
 }
 
+/* clauses repeated across zone statements, in any case */
+ISC_RUN_TEST_IMPL(zone_clauses) {
+	isc_result_t result;
+	const char text[] = "zone \"a.example\" { type secondary; "
+			    "notify-source 192.0.2.1 port 5300; };\n"
+			    "zone \"b.example\" { TYPE secondary; "
+			    "Notify-Source 192.0.2.2 port 5301; };\n";
+	isc_buffer_t b;
+	cfg_parser_t *p = NULL;
+
+	result = cfg_parser_create(mctx, lctx, &p);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (int pass = 0; pass < 2; pass++) {
+		cfg_obj_t *conf = NULL;
+		const cfg_obj_t *zlist = NULL;
+		const cfg_listelt_t *elt = NULL;
+		in_port_t port = 5300;
+
+		isc_buffer_constinit(&b, text, sizeof(text) - 1);
+		isc_buffer_add(&b, sizeof(text) - 1);
+
+		result = cfg_parse_buffer(p, &b, "text", 0, &cfg_type_namedconf,
+					  0, &conf);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		result = cfg_map_get(conf, "zone", &zlist);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		for (elt = cfg_list_first(zlist); elt != NULL;
+		     elt = cfg_list_next(elt))
+		{
+			const cfg_obj_t *options = NULL, *obj = NULL;
+
+			options = cfg_tuple_get(cfg_listelt_value(elt),
+						"options");
+			result = cfg_map_get(options, "type", &obj);
+			assert_int_equal(result, ISC_R_SUCCESS);
+			assert_string_equal(cfg_obj_asstring(obj),
+					    "secondary");
+
+			obj = NULL;
+			result = cfg_map_get(options, "notify-source", &obj);
+			assert_int_equal(result, ISC_R_SUCCESS);
+			assert_int_equal(
+				isc_sockaddr_getport(cfg_obj_assockaddr(obj)),
+				port++);
+		}
+		assert_int_equal(port, 5302);
+
+		cfg_obj_destroy(p, &conf);
+		cfg_parser_reset(p);
+	}
+
+	cfg_parser_destroy(&p);
+}
+
 /* test cfg_map_firstclause() */
 ISC_RUN_TEST_IMPL(cfg_map_firstclause) {
 	const char *name = NULL;
@@ -222,6 +279,7 @@ ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(addzoneconf)
 ISC_TEST_ENTRY(parse_buffer)
+ISC_TEST_ENTRY(zone_clauses)
 ISC_TEST_ENTRY(cfg_map_firstclause)
 ISC_TEST_ENTRY(cfg_map_nextclause)
 
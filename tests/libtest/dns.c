@@ -73,7 +73,7 @@ dns_test_makeview(const char *name, bool with_cache, dns_view_t **viewp) {
 	if (with_cache) {
 		result = dns_cache_create(mctx, mctx, taskmgr, timermgr,
 					  dns_rdataclass_in, "", "rbt", 0, NULL,
-					  &cache);
+					  1, &cache);
 		if (result != ISC_R_SUCCESS) {
 			dns_view_detach(&view);
 			return (result);
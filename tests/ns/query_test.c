@@ -664,22 +664,13 @@ test_hookasync(query_ctx_t *qctx, isc_mem_t *memctx, void *arg,
 		return (asdata->start_result);
 	}
 
-	ctx = isc_mem_get(memctx, sizeof(*ctx));
-	rev = (ns_hook_resevent_t *)isc_event_allocate(
-		memctx, task, NS_EVENT_HOOKASYNCDONE, action, evarg,
-		sizeof(*rev));
-
-	rev->hookpoint = asdata->hookpoint;
-	rev->origresult = DNS_R_NXDOMAIN;
-	rev->saved_qctx = qctx;
-	rev->ctx = ctx;
+	ns_hookasync_create(memctx, cancel_hookactx, destroy_hookactx, asdata,
+			    &ctx);
+	rev = ns_hook_resevent_create(qctx, memctx, task, action, evarg, ctx,
+				      asdata->hookpoint, DNS_R_NXDOMAIN);
+	INSIST(rev->saved_qctx == qctx && rev->ctx == ctx);
 	asdata->rev = rev;
 
-	*ctx = (ns_hookasync_t){ .private = asdata };
-	isc_mem_attach(memctx, &ctx->mctx);
-	ctx->destroy = destroy_hookactx;
-	ctx->cancel = cancel_hookactx;
-
 	*ctxp = ctx;
 	return (ISC_R_SUCCESS);
 }
@@ -1305,7 +1296,8 @@ test_hookasync_e2e(query_ctx_t *qctx, isc_mem_t *memctx, void *arg,
 		return (asdata->start_result);
 	}
 
-	ctx = isc_mem_get(memctx, sizeof(*ctx));
+	/* Use the default destroy function, ns_hookasync_destroy(). */
+	ns_hookasync_create(memctx, cancel_e2ehookactx, NULL, asdata, &ctx);
 	rev = (ns_hook_resevent_t *)isc_event_allocate(
 		memctx, task, NS_EVENT_HOOKASYNCDONE, action, evarg,
 		sizeof(*rev));
@@ -1315,11 +1307,6 @@ test_hookasync_e2e(query_ctx_t *qctx, isc_mem_t *memctx, void *arg,
 	rev->ctx = ctx;
 	asdata->rev = rev;
 
-	*ctx = (ns_hookasync_t){ .private = asdata };
-	isc_mem_attach(memctx, &ctx->mctx);
-	ctx->destroy = destroy_hookactx;
-	ctx->cancel = cancel_e2ehookactx;
-
 	*ctxp = ctx;
 	return (ISC_R_SUCCESS);
 }